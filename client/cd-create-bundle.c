@@ -0,0 +1,231 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the same as CdIccStore uses */
+#define CD_CREATE_BUNDLE_PREFIX		"/org/freedesktop/colord/bundle"
+#define CD_CREATE_BUNDLE_HEADER_SIZE	128
+#define CD_CREATE_BUNDLE_ID_OFFSET	84
+#define CD_CREATE_BUNDLE_ID_SIZE	16
+
+static gboolean
+cd_create_bundle_has_profile_id (const gchar *filename, GError **error)
+{
+	gsize bytes_read = 0;
+	guint8 header[CD_CREATE_BUNDLE_HEADER_SIZE];
+	g_autoptr(GFile) file = g_file_new_for_path (filename);
+	g_autoptr(GFileInputStream) stream = NULL;
+
+	stream = g_file_read (file, NULL, error);
+	if (stream == NULL)
+		return FALSE;
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream),
+				      header, sizeof (header),
+				      &bytes_read, NULL, error))
+		return FALSE;
+	if (bytes_read != sizeof (header)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is too small to be a profile", filename);
+		return FALSE;
+	}
+
+	/* the daemon can only tell the file is unchanged using the ID */
+	for (guint i = 0; i < CD_CREATE_BUNDLE_ID_SIZE; i++) {
+		if (header[CD_CREATE_BUNDLE_ID_OFFSET + i] != 0)
+			return TRUE;
+	}
+	g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+		     "%s has no profile ID", filename);
+	return FALSE;
+}
+
+static gboolean
+cd_create_bundle_add_directory (GString *xml, GFile *directory, guint *n_profiles, GError **error)
+{
+	g_autoptr(GFileEnumerator) enumerator = NULL;
+
+	enumerator = g_file_enumerate_children (directory,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						NULL,
+						error);
+	if (enumerator == NULL)
+		return FALSE;
+	for (;;) {
+		GFileInfo *info;
+		GFileType file_type;
+		const gchar *name;
+		g_autofree gchar *filename = NULL;
+		g_autofree gchar *filename_escaped = NULL;
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GFile) child = NULL;
+
+		if (!g_file_enumerator_iterate (enumerator, &info, NULL, NULL, error))
+			return FALSE;
+		if (info == NULL)
+			break;
+		name = g_file_info_get_name (info);
+		child = g_file_get_child (directory, name);
+		file_type = g_file_info_get_file_type (info);
+		if (file_type == G_FILE_TYPE_DIRECTORY) {
+			if (!cd_create_bundle_add_directory (xml, child, n_profiles, error))
+				return FALSE;
+			continue;
+		}
+		if (file_type != G_FILE_TYPE_REGULAR)
+			continue;
+		if (!g_str_has_suffix (name, ".icc") &&
+		    !g_str_has_suffix (name, ".ICC") &&
+		    !g_str_has_suffix (name, ".icm") &&
+		    !g_str_has_suffix (name, ".ICM"))
+			continue;
+
+		/* not an error, the daemon just reads it from disk */
+		filename = g_file_get_path (child);
+		if (!cd_create_bundle_has_profile_id (filename, &error_local)) {
+			g_print ("skipped\t%s\t%s\n", filename, error_local->message);
+			continue;
+		}
+
+		/* the alias is the absolute filename below the prefix */
+		filename_escaped = g_markup_escape_text (filename, -1);
+		g_string_append_printf (xml, "<file alias=\"%s\" compressed=\"true\">%s</file>\n",
+					filename_escaped + 1, filename_escaped);
+		g_print ("added\t%s\n", filename);
+		(*n_profiles)++;
+	}
+	return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+	gboolean ret;
+	gint exit_status = -1;
+	guint i;
+	guint n_profiles = 0;
+	guint retval = EXIT_FAILURE;
+	g_autofree gchar *standard_error = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autofree gchar *xml_fn = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	g_autoptr(GString) xml = NULL;
+
+	setlocale (LC_ALL, "");
+
+	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	context = g_option_context_new ("OUTPUT [DIRECTORY...]");
+
+	/* TRANSLATORS: program name */
+	g_set_application_name (_("ICC profile bundle creation program"));
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s: %s\n", _("Failed to parse arguments"),
+			 error->message);
+		goto out;
+	}
+	if (argc < 3) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s\n", _("No output file or directories specified"));
+		goto out;
+	}
+
+	/* find all the profiles */
+	xml = g_string_new ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	g_string_append (xml, "<gresources>\n");
+	g_string_append (xml, "<gresource prefix=\"" CD_CREATE_BUNDLE_PREFIX "\">\n");
+	for (i = 2; i < (guint) argc; i++) {
+		g_autofree gchar *path = NULL;
+		g_autoptr(GFile) dir = g_file_new_for_commandline_arg (argv[i]);
+
+		/* the daemon looks up the absolute filename */
+		path = g_file_get_path (dir);
+		g_clear_object (&dir);
+		dir = g_file_new_for_path (path);
+		if (!cd_create_bundle_add_directory (xml, dir, &n_profiles, &error)) {
+			g_print ("%s\n", error->message);
+			goto out;
+		}
+	}
+	g_string_append (xml, "</gresource>\n");
+	g_string_append (xml, "</gresources>\n");
+	if (n_profiles == 0) {
+		/* TRANSLATORS: nothing could be bundled */
+		g_print ("%s\n", _("No profiles with a profile ID found"));
+		goto out;
+	}
+
+	/* compile the bundle */
+	tmpdir = g_dir_make_tmp ("cd-create-bundle-XXXXXX", &error);
+	if (tmpdir == NULL) {
+		g_print ("%s\n", error->message);
+		goto out;
+	}
+	xml_fn = g_build_filename (tmpdir, "bundle.gresource.xml", NULL);
+	if (!g_file_set_contents (xml_fn, xml->str, (gssize) xml->len, &error)) {
+		g_print ("%s\n", error->message);
+		goto out;
+	}
+	{
+		const gchar *argv_compile[] = { "glib-compile-resources",
+						"--sourcedir", "/",
+						"--target", argv[1],
+						xml_fn, NULL };
+		ret = g_spawn_sync (NULL, (gchar **) argv_compile, NULL,
+				    G_SPAWN_SEARCH_PATH |
+				    G_SPAWN_STDOUT_TO_DEV_NULL,
+				    NULL, NULL, NULL, &standard_error,
+				    &exit_status, &error);
+	}
+	if (!ret) {
+		g_print ("%s\n", error->message);
+		goto out;
+	}
+	if (!g_spawn_check_exit_status (exit_status, &error)) {
+		g_print ("%s: %s\n", error->message, standard_error);
+		goto out;
+	}
+
+	/* TRANSLATORS: summary of the results */
+	g_printerr ("%s: %u\n", _("Profiles"), n_profiles);
+
+	/* success */
+	retval = EXIT_SUCCESS;
+out:
+	if (xml_fn != NULL)
+		g_unlink (xml_fn);
+	if (tmpdir != NULL)
+		g_rmdir (tmpdir);
+	return retval;
+}
@@ -35,6 +35,7 @@ typedef struct {
 	GOptionContext		*context;
 	cmsHPROFILE		 lcms_profile;
 	CdIcc			*icc;
+	CdIcc			*icc_srgb;	/* reused for each coverage */
 } CdUtilPrivate;
 
 static gboolean
@@ -298,14 +299,6 @@ cd_util_create_named_color (CdUtilPrivate *priv,
 	cmsSetPCS (priv->lcms_profile, cmsSigLabData);
 	cmsSetColorSpace (priv->lcms_profile, cmsSigLabData);
 
-	/* create a named color structure */
-	prefix = cd_dom_get_node (dom, root, "prefix");
-	suffix = cd_dom_get_node (dom, root, "suffix");
-	nc2 = cmsAllocNamedColorList (NULL, 1, /* will realloc more as required */
-				      3,
-				      prefix != NULL ? cd_dom_get_node_data (prefix) : "",
-				      suffix != NULL ? cd_dom_get_node_data (suffix) : "");
-
 	named = cd_dom_get_node (dom, root, "named");
 	if (named == NULL) {
 		ret = FALSE;
@@ -313,6 +306,15 @@ cd_util_create_named_color (CdUtilPrivate *priv,
 				     "XML error: missing named");
 		goto out;
 	}
+
+	/* create a named color structure big enough for all the colors */
+	prefix = cd_dom_get_node (dom, root, "prefix");
+	suffix = cd_dom_get_node (dom, root, "suffix");
+	nc2 = cmsAllocNamedColorList (cd_icc_get_context (priv->icc),
+				      MAX (g_node_n_children ((GNode *) named), 1),
+				      3,
+				      prefix != NULL ? cd_dom_get_node_data (prefix) : "",
+				      suffix != NULL ? cd_dom_get_node_data (suffix) : "");
 	for (tmp = named->children; tmp != NULL; tmp = tmp->next) {
 		name = cd_dom_get_node (dom, tmp, "name");
 		if (name == NULL) {
@@ -654,12 +656,11 @@ cd_util_create_temperature (CdUtilPrivate *priv,
 }
 
 static gboolean
-cd_util_icc_set_metadata_coverage (CdIcc *icc, GError **error)
+cd_util_icc_set_metadata_coverage (CdUtilPrivate *priv, CdIcc *icc, GError **error)
 {
 	const gchar *tmp;
 	gdouble coverage = 0.0f;
 	g_autofree gchar *coverage_tmp = NULL;
-	g_autoptr(CdIcc) icc_srgb = NULL;
 
 	/* is sRGB? */
 	tmp = cd_icc_get_metadata_item (icc, CD_PROFILE_METADATA_STANDARD_SPACE);
@@ -667,10 +668,13 @@ cd_util_icc_set_metadata_coverage (CdIcc *icc, GError **error)
 		return TRUE;
 
 	/* calculate coverage (quite expensive to calculate, hence metadata) */
-	icc_srgb = cd_icc_new ();
-	if (!cd_icc_create_default (icc_srgb, error))
-		return FALSE;
-	if (!cd_icc_utils_get_coverage (icc_srgb, icc, &coverage, error))
+	if (priv->icc_srgb == NULL) {
+		g_autoptr(CdIcc) icc_srgb = cd_icc_new ();
+		if (!cd_icc_create_default (icc_srgb, error))
+			return FALSE;
+		priv->icc_srgb = g_steal_pointer (&icc_srgb);
+	}
+	if (!cd_icc_utils_get_coverage (priv->icc_srgb, icc, &coverage, error))
 		return FALSE;
 	if (coverage > 0.0) {
 		coverage_tmp = g_strdup_printf ("%.2f", coverage);
@@ -793,7 +797,7 @@ cd_util_create_from_xml (CdUtilPrivate *priv,
 		cd_icc_add_metadata (priv->icc,
 				     CD_PROFILE_METADATA_STANDARD_SPACE,
 				     cd_dom_get_node_data (tmp));
-		if (!cd_util_icc_set_metadata_coverage (priv->icc, error))
+		if (!cd_util_icc_set_metadata_coverage (priv, priv->icc, error))
 			return FALSE;
 	}
 	tmp = cd_dom_get_node (dom, profile, "data_source");
@@ -836,6 +840,129 @@ cd_util_create_from_xml (CdUtilPrivate *priv,
 	return TRUE;
 }
 
+static gboolean
+cd_util_create_file (CdUtilPrivate *priv,
+		     const gchar *filename_out,
+		     const gchar *filename_in,
+		     GError **error)
+{
+	g_autoptr(GFile) file = NULL;
+
+	/* each profile gets a fresh object */
+	g_clear_object (&priv->icc);
+	priv->icc = cd_icc_new ();
+	priv->lcms_profile = NULL;
+	if (!cd_util_create_from_xml (priv, filename_in, error))
+		return FALSE;
+
+	/* write file */
+	file = g_file_new_for_path (filename_out);
+	return cd_icc_save_file (priv->icc,
+				 file,
+				 CD_ICC_SAVE_FLAGS_NONE,
+				 NULL,
+				 error);
+}
+
+typedef struct {
+	GPtrArray		*outputs;
+	GPtrArray		*inputs;
+	GError			**errors;
+	gint			 next;
+} CdUtilBatch;
+
+static gpointer
+cd_util_batch_worker_cb (gpointer user_data)
+{
+	CdUtilBatch *batch = (CdUtilBatch *) user_data;
+	CdUtilPrivate worker = { NULL, NULL, NULL, NULL };
+
+	/* take the next spec until there are none left */
+	for (;;) {
+		guint idx = (guint) g_atomic_int_add (&batch->next, 1);
+		if (idx >= batch->inputs->len)
+			break;
+		cd_util_create_file (&worker,
+				     g_ptr_array_index (batch->outputs, idx),
+				     g_ptr_array_index (batch->inputs, idx),
+				     &batch->errors[idx]);
+	}
+	g_clear_object (&worker.icc);
+	g_clear_object (&worker.icc_srgb);
+	return NULL;
+}
+
+static gboolean
+cd_util_create_from_manifest (const gchar *manifest, guint jobs, GError **error)
+{
+	CdUtilBatch batch = { NULL, NULL, NULL, 0 };
+	guint i;
+	guint n_failed = 0;
+	g_autofree gchar *data = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autoptr(GPtrArray) inputs = NULL;
+	g_autoptr(GPtrArray) outputs = NULL;
+	g_autoptr(GPtrArray) threads = NULL;
+
+	/* each line is the output filename then the XML spec */
+	if (!g_file_get_contents (manifest, &data, NULL, error))
+		return FALSE;
+	outputs = g_ptr_array_new_with_free_func (g_free);
+	inputs = g_ptr_array_new_with_free_func (g_free);
+	lines = g_strsplit (data, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		g_auto(GStrv) split = NULL;
+		g_strstrip (lines[i]);
+		if (lines[i][0] == '\0' || lines[i][0] == '#')
+			continue;
+		split = g_strsplit_set (lines[i], " \t", 2);
+		if (g_strv_length (split) != 2) {
+			g_set_error (error, 1, 0,
+				     "%s:%u: expected OUTPUT.icc INPUT.xml",
+				     manifest, i + 1);
+			return FALSE;
+		}
+		g_ptr_array_add (outputs, g_strdup (split[0]));
+		g_ptr_array_add (inputs, g_strdup (g_strchug (split[1])));
+	}
+
+	/* the workers share nothing apart from the next index */
+	batch.outputs = outputs;
+	batch.inputs = inputs;
+	batch.errors = g_new0 (GError *, inputs->len);
+	threads = g_ptr_array_new_with_free_func ((GDestroyNotify) g_thread_join);
+	for (i = 1; i < MIN (jobs, inputs->len); i++) {
+		GThread *thread;
+		thread = g_thread_try_new ("cd-create-profile",
+					   cd_util_batch_worker_cb,
+					   &batch, NULL);
+		if (thread == NULL)
+			break;
+		g_ptr_array_add (threads, thread);
+	}
+	cd_util_batch_worker_cb (&batch);
+	g_ptr_array_set_size (threads, 0);
+
+	/* report in manifest order so the output does not depend on timing */
+	for (i = 0; i < inputs->len; i++) {
+		if (batch.errors[i] == NULL)
+			continue;
+		g_printerr ("%s: %s\n",
+			    (const gchar *) g_ptr_array_index (inputs, i),
+			    batch.errors[i]->message);
+		g_error_free (batch.errors[i]);
+		n_failed++;
+	}
+	g_free (batch.errors);
+	if (n_failed > 0) {
+		g_set_error (error, 1, 0,
+			     "%u of %u profiles failed",
+			     n_failed, inputs->len);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -844,12 +971,19 @@ main (int argc, char **argv)
 	guint retval = EXIT_FAILURE;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *cmd_descriptions = NULL;
+	gint jobs = 0;
 	g_autofree gchar *filename = NULL;
-	g_autoptr(GFile) file = NULL;
+	g_autofree gchar *manifest = NULL;
 	const GOptionEntry options[] = {
 		{ "output", 'o', 0, G_OPTION_ARG_STRING, &filename,
 		/* TRANSLATORS: command line option */
 		  _("Profile to create"), NULL },
+		{ "manifest", 'm', 0, G_OPTION_ARG_FILENAME, &manifest,
+		/* TRANSLATORS: command line option */
+		  _("File listing the profiles to create and their XML sources"), NULL },
+		{ "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+		/* TRANSLATORS: command line option */
+		  _("Number of profiles to create at the same time"), NULL },
 		{ NULL}
 	};
 
@@ -860,7 +994,6 @@ main (int argc, char **argv)
 	textdomain (GETTEXT_PACKAGE);
 
 	priv = g_new0 (CdUtilPrivate, 1);
-	priv->icc = cd_icc_new ();
 	priv->context = g_option_context_new (NULL);
 
 	/* TRANSLATORS: program name */
@@ -874,6 +1007,19 @@ main (int argc, char **argv)
 		goto out;
 	}
 
+	/* many profiles at once */
+	if (manifest != NULL) {
+		if (jobs <= 0)
+			jobs = g_get_num_processors ();
+		ret = cd_util_create_from_manifest (manifest, jobs, &error);
+		if (!ret) {
+			g_print ("%s\n", error->message);
+			goto out;
+		}
+		retval = EXIT_SUCCESS;
+		goto out;
+	}
+
 	/* nothing specified */
 	if (filename == NULL) {
 		/* TRANSLATORS: the user forgot to use -o */
@@ -882,19 +1028,7 @@ main (int argc, char **argv)
 	}
 
 	/* run the specified command */
-	ret = cd_util_create_from_xml (priv, argv[1], &error);
-	if (!ret) {
-		g_print ("%s\n", error->message);
-		goto out;
-	}
-
-	/* write file */
-	file = g_file_new_for_path (filename);
-	ret = cd_icc_save_file (priv->icc,
-				file,
-				CD_ICC_SAVE_FLAGS_NONE,
-				NULL,
-				&error);
+	ret = cd_util_create_file (priv, filename, argv[1], &error);
 	if (!ret) {
 		g_print ("%s\n", error->message);
 		goto out;
@@ -905,7 +1039,8 @@ main (int argc, char **argv)
 out:
 	if (priv != NULL) {
 		g_option_context_free (priv->context);
-		g_object_unref (priv->icc);
+		g_clear_object (&priv->icc);
+		g_clear_object (&priv->icc_srgb);
 		g_free (priv);
 	}
 	return retval;
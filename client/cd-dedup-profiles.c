@@ -0,0 +1,455 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <colord-private.h>
+
+typedef struct {
+	gboolean		 verify;
+	GKeyFile		*checksum_cache;	/* may be NULL */
+	GHashTable		*checksum_cache_used;	/* key */
+	GMutex			 mutex;
+} CdDedupPrivate;
+
+typedef struct {
+	CdDedupPrivate		*priv;
+	gchar			*filename;
+	gchar			*checksum;
+	gchar			*error;
+	GPtrArray		*warnings;
+	guint64			 device;
+	guint64			 inode;
+} CdDedupItem;
+
+static void
+cd_dedup_item_free (CdDedupItem *item)
+{
+	g_free (item->filename);
+	g_free (item->checksum);
+	g_free (item->error);
+	if (item->warnings != NULL)
+		g_ptr_array_unref (item->warnings);
+	g_free (item);
+}
+
+static gint
+cd_dedup_item_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const CdDedupItem *item_a = *((const CdDedupItem **) a);
+	const CdDedupItem *item_b = *((const CdDedupItem **) b);
+	return g_strcmp0 (item_a->filename, item_b->filename);
+}
+
+static gchar *
+cd_dedup_get_checksum_cache_key (const gchar *filename)
+{
+	GStatBuf st;
+
+	/* the same key as CdIccStore uses */
+	if (g_stat (filename, &st) != 0)
+		return NULL;
+	return g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+				(guint64) st.st_ino,
+				(gint64) st.st_mtime,
+				(gint64) st.st_size);
+}
+
+static gchar *
+cd_dedup_get_cached_checksum (CdDedupPrivate *priv, const gchar *filename)
+{
+	gchar *checksum;
+	g_autofree gchar *key = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (priv->checksum_cache == NULL)
+		return NULL;
+	key = cd_dedup_get_checksum_cache_key (filename);
+	if (key == NULL)
+		return NULL;
+	locker = g_mutex_locker_new (&priv->mutex);
+	checksum = g_key_file_get_string (priv->checksum_cache, "checksums", key, NULL);
+	if (checksum != NULL)
+		g_hash_table_add (priv->checksum_cache_used, g_steal_pointer (&key));
+	return checksum;
+}
+
+static gboolean
+cd_dedup_process_item (CdDedupItem *item, GError **error)
+{
+	CdDedupPrivate *priv = item->priv;
+	GStatBuf st;
+	const guint8 *data;
+	gsize len;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+
+	/* files that are already hard links are not reported */
+	if (g_stat (item->filename, &st) == 0) {
+		item->device = st.st_dev;
+		item->inode = st.st_ino;
+	}
+	mapped_file = g_mapped_file_new (item->filename, FALSE, error);
+	if (mapped_file == NULL)
+		return FALSE;
+	data = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+	len = g_mapped_file_get_length (mapped_file);
+	if (len == 0) {
+		g_set_error_literal (error, 1, 0, "file is empty");
+		return FALSE;
+	}
+
+	/* only parse the header unless we have to check everything */
+	icc = cd_icc_new ();
+	if (priv->verify) {
+		GArray *warnings;
+		guint i;
+		if (!cd_icc_load_data (icc, data, len, CD_ICC_LOAD_FLAGS_NONE, error))
+			return FALSE;
+		warnings = cd_icc_get_warnings (icc);
+		item->warnings = g_ptr_array_new ();
+		for (i = 0; i < warnings->len; i++) {
+			CdProfileWarning warning = g_array_index (warnings, CdProfileWarning, i);
+			g_ptr_array_add (item->warnings,
+					 (gpointer) cd_profile_warning_to_string (warning));
+		}
+		g_array_unref (warnings);
+	} else {
+		if (!cd_icc_peek_data (icc, data, len, error))
+			return FALSE;
+	}
+
+	/* prefer the embedded profile ID, then the daemon cache, then hash */
+	item->checksum = g_strdup (cd_icc_get_checksum (icc));
+	if (item->checksum == NULL)
+		item->checksum = cd_dedup_get_cached_checksum (priv, item->filename);
+	if (item->checksum == NULL)
+		item->checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5, data, len);
+	return TRUE;
+}
+
+static void
+cd_dedup_thread_cb (gpointer data, gpointer user_data)
+{
+	CdDedupItem *item = (CdDedupItem *) data;
+	g_autoptr(GError) error = NULL;
+	if (!cd_dedup_process_item (item, &error))
+		item->error = g_strdup (error->message);
+}
+
+static gboolean
+cd_dedup_add_directory (CdDedupPrivate *priv,
+			GPtrArray *items,
+			GFile *directory,
+			GError **error)
+{
+	g_autoptr(GFileEnumerator) enumerator = NULL;
+
+	enumerator = g_file_enumerate_children (directory,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						NULL,
+						error);
+	if (enumerator == NULL)
+		return FALSE;
+	for (;;) {
+		CdDedupItem *item;
+		GFileInfo *info;
+		GFileType file_type;
+		const gchar *name;
+		g_autoptr(GFile) child = NULL;
+
+		if (!g_file_enumerator_iterate (enumerator, &info, NULL, NULL, error))
+			return FALSE;
+		if (info == NULL)
+			break;
+		name = g_file_info_get_name (info);
+		child = g_file_get_child (directory, name);
+		file_type = g_file_info_get_file_type (info);
+		if (file_type == G_FILE_TYPE_DIRECTORY) {
+			if (!cd_dedup_add_directory (priv, items, child, error))
+				return FALSE;
+			continue;
+		}
+
+		/* symlinks are already as small as they can be */
+		if (file_type != G_FILE_TYPE_REGULAR)
+			continue;
+		if (!g_str_has_suffix (name, ".icc") &&
+		    !g_str_has_suffix (name, ".ICC") &&
+		    !g_str_has_suffix (name, ".icm") &&
+		    !g_str_has_suffix (name, ".ICM"))
+			continue;
+		item = g_new0 (CdDedupItem, 1);
+		item->priv = priv;
+		item->filename = g_file_get_path (child);
+		g_ptr_array_add (items, item);
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_dedup_files_equal (const gchar *filename1, const gchar *filename2, GError **error)
+{
+	g_autoptr(GMappedFile) mapped1 = NULL;
+	g_autoptr(GMappedFile) mapped2 = NULL;
+
+	/* the checksum may only be the embedded profile ID */
+	mapped1 = g_mapped_file_new (filename1, FALSE, error);
+	if (mapped1 == NULL)
+		return FALSE;
+	mapped2 = g_mapped_file_new (filename2, FALSE, error);
+	if (mapped2 == NULL)
+		return FALSE;
+	if (g_mapped_file_get_length (mapped1) != g_mapped_file_get_length (mapped2))
+		return FALSE;
+	return memcmp (g_mapped_file_get_contents (mapped1),
+		       g_mapped_file_get_contents (mapped2),
+		       g_mapped_file_get_length (mapped1)) == 0;
+}
+
+static gboolean
+cd_dedup_hardlink (const gchar *filename, const gchar *original, GError **error)
+{
+	g_autofree gchar *tmp = NULL;
+
+	/* link to a temporary name first so the file never goes missing */
+	tmp = g_strdup_printf ("%s.cd-dedup-profiles", filename);
+	if (link (original, tmp) != 0) {
+		g_set_error (error, 1, 0, "failed to link %s: %s",
+			     original, g_strerror (errno));
+		return FALSE;
+	}
+	if (g_rename (tmp, filename) != 0) {
+		g_set_error (error, 1, 0, "failed to replace %s: %s",
+			     filename, g_strerror (errno));
+		g_unlink (tmp);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+cd_dedup_print_stale_index (const gchar *index_fn)
+{
+	guint i;
+	g_auto(GStrv) groups = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	if (!g_key_file_load_from_file (kf, index_fn, G_KEY_FILE_NONE, &error)) {
+		g_debug ("failed to load %s: %s", index_fn, error->message);
+		return;
+	}
+
+	/* each group is a filename, with the stat key it was indexed with */
+	groups = g_key_file_get_groups (kf, NULL);
+	for (i = 0; groups[i] != NULL; i++) {
+		g_autofree gchar *key = NULL;
+		g_autofree gchar *stat_key = NULL;
+		key = cd_dedup_get_checksum_cache_key (groups[i]);
+		stat_key = g_key_file_get_string (kf, groups[i], "Stat", NULL);
+		if (key == NULL || g_strcmp0 (key, stat_key) != 0)
+			g_print ("stale\tindex\t%s\n", groups[i]);
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	CdDedupPrivate *priv;
+	GThreadPool *pool;
+	gboolean hardlink = FALSE;
+	gboolean verify = FALSE;
+	guint i;
+	guint n_duplicates = 0;
+	guint n_invalid = 0;
+	gint jobs = 0;
+	guint retval = EXIT_FAILURE;
+	g_autofree gchar *checksum_cache_fn = NULL;
+	g_autofree gchar *index_fn = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) originals = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	g_autoptr(GPtrArray) items = NULL;
+	const GOptionEntry options[] = {
+		{ "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+			/* TRANSLATORS: command line option */
+			_("Number of profiles to read at the same time"), NULL },
+		{ "verify", '\0', 0, G_OPTION_ARG_NONE, &verify,
+			/* TRANSLATORS: command line option */
+			_("Fully load each profile and show any warnings"), NULL },
+		{ "hardlink", '\0', 0, G_OPTION_ARG_NONE, &hardlink,
+			/* TRANSLATORS: command line option */
+			_("Replace byte-identical duplicates with hard links"), NULL },
+		{ "checksum-cache", '\0', 0, G_OPTION_ARG_FILENAME, &checksum_cache_fn,
+			/* TRANSLATORS: command line option */
+			_("Checksum cache written by the daemon"), NULL },
+		{ "index", '\0', 0, G_OPTION_ARG_FILENAME, &index_fn,
+			/* TRANSLATORS: command line option */
+			_("Profile index written by the daemon"), NULL },
+		{ NULL}
+	};
+
+	setlocale (LC_ALL, "");
+
+	bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
+	textdomain (GETTEXT_PACKAGE);
+
+	priv = g_new0 (CdDedupPrivate, 1);
+	g_mutex_init (&priv->mutex);
+	priv->checksum_cache_used = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, NULL);
+	context = g_option_context_new ("[DIRECTORY...]");
+
+	/* TRANSLATORS: program name */
+	g_set_application_name (_("ICC profile deduplication program"));
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s: %s\n", _("Failed to parse arguments"),
+			 error->message);
+		goto out;
+	}
+	if (argc < 2) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s\n", _("No directories specified"));
+		goto out;
+	}
+	priv->verify = verify;
+
+	/* the daemon cache saves hashing profiles with no profile ID */
+	if (checksum_cache_fn == NULL)
+		checksum_cache_fn = g_strdup (LOCALSTATEDIR "/lib/colord/checksums.ini");
+	if (index_fn == NULL)
+		index_fn = g_strdup (LOCALSTATEDIR "/lib/colord/profiles.ini");
+	priv->checksum_cache = g_key_file_new ();
+	if (!g_key_file_load_from_file (priv->checksum_cache, checksum_cache_fn,
+					G_KEY_FILE_NONE, &error)) {
+		g_debug ("failed to load %s: %s", checksum_cache_fn, error->message);
+		g_clear_error (&error);
+		g_key_file_free (priv->checksum_cache);
+		priv->checksum_cache = NULL;
+	}
+
+	/* find all the profiles */
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_dedup_item_free);
+	for (i = 1; i < (guint) argc; i++) {
+		g_autoptr(GFile) dir = g_file_new_for_path (argv[i]);
+		if (!cd_dedup_add_directory (priv, items, dir, &error)) {
+			g_print ("%s\n", error->message);
+			goto out;
+		}
+	}
+
+	/* read them in parallel */
+	if (jobs <= 0)
+		jobs = g_get_num_processors ();
+	pool = g_thread_pool_new (cd_dedup_thread_cb, NULL, jobs, TRUE, &error);
+	if (pool == NULL) {
+		g_print ("%s\n", error->message);
+		goto out;
+	}
+	for (i = 0; i < items->len; i++)
+		g_thread_pool_push (pool, g_ptr_array_index (items, i), NULL);
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* the first filename in sort order is kept as the original */
+	g_ptr_array_sort (items, cd_dedup_item_sort_cb);
+	originals = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < items->len; i++) {
+		CdDedupItem *item = g_ptr_array_index (items, i);
+		CdDedupItem *item_original;
+		const gchar *original;
+		guint j;
+
+		if (item->error != NULL) {
+			g_print ("invalid\t%s\t%s\n", item->filename, item->error);
+			n_invalid++;
+			continue;
+		}
+		for (j = 0; item->warnings != NULL && j < item->warnings->len; j++) {
+			g_print ("warning\t%s\t%s\n", item->filename,
+				 (const gchar *) g_ptr_array_index (item->warnings, j));
+		}
+		item_original = g_hash_table_lookup (originals, item->checksum);
+		if (item_original == NULL) {
+			g_hash_table_insert (originals, item->checksum, item);
+			continue;
+		}
+		if (item->device == item_original->device &&
+		    item->inode == item_original->inode)
+			continue;
+		original = item_original->filename;
+		g_print ("duplicate\t%s\t%s\t%s\n",
+			 item->checksum, item->filename, original);
+		n_duplicates++;
+		if (hardlink) {
+			g_autoptr(GError) error_local = NULL;
+			if (!cd_dedup_files_equal (item->filename, original, &error_local)) {
+				if (error_local != NULL)
+					g_printerr ("%s\n", error_local->message);
+				continue;
+			}
+			if (!cd_dedup_hardlink (item->filename, original, &error_local)) {
+				g_printerr ("%s\n", error_local->message);
+				continue;
+			}
+			g_print ("linked\t%s\t%s\n", item->filename, original);
+		}
+	}
+
+	/* entries the daemon will never use again */
+	if (priv->checksum_cache != NULL) {
+		g_auto(GStrv) keys = NULL;
+		keys = g_key_file_get_keys (priv->checksum_cache, "checksums", NULL, NULL);
+		for (i = 0; keys != NULL && keys[i] != NULL; i++) {
+			if (!g_hash_table_contains (priv->checksum_cache_used, keys[i]))
+				g_print ("stale\tchecksum-cache\t%s\n", keys[i]);
+		}
+	}
+	cd_dedup_print_stale_index (index_fn);
+
+	/* TRANSLATORS: summary of the results */
+	g_printerr ("%s: %u, %s: %u, %s: %u\n",
+		    _("Profiles"), items->len,
+		    _("Duplicates"), n_duplicates,
+		    _("Invalid"), n_invalid);
+
+	/* success */
+	retval = EXIT_SUCCESS;
+out:
+	if (priv->checksum_cache != NULL)
+		g_key_file_free (priv->checksum_cache);
+	g_hash_table_unref (priv->checksum_cache_used);
+	g_mutex_clear (&priv->mutex);
+	g_free (priv);
+	return retval;
+}
@@ -37,8 +37,19 @@ typedef struct {
 	CdIcc			*icc;
 	gchar			*locale;
 	gboolean		 rewrite_file;
+	GHashTable		*standard_spaces;	/* CdStandardSpace:CdIcc */
 } CdUtilPrivate;
 
+typedef struct {
+	CdUtilPrivate		*priv;
+	gchar			*filename;
+	gchar			**values;
+	gboolean		 ret;
+} CdUtilBatchItem;
+
+/* the client is shared by all the batch workers */
+G_LOCK_DEFINE_STATIC (cd_util_client);
+
 typedef gboolean (*CdUtilPrivateCb)	(CdUtilPrivate	*util,
 					 gchar		**values,
 					 GError		**error);
@@ -156,7 +167,7 @@ cd_util_run (CdUtilPrivate *priv, const gchar *command, gchar **values, GError *
 		g_string_append_printf (string, " * %s\n", item->name);
 	}
 	g_set_error_literal (error, 1, 0, string->str);
-	return TRUE;
+	return FALSE;
 }
 
 static gboolean
@@ -262,80 +273,92 @@ cd_util_get_standard_space_filename (CdUtilPrivate *priv,
 	return filename;
 }
 
+static CdIcc *
+cd_util_get_standard_space (CdUtilPrivate *priv,
+			    CdStandardSpace standard_space,
+			    GError **error)
+{
+	CdIcc *icc;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(CdIcc) icc_tmp = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	/* only ask the daemon and load the profile once per run */
+	G_LOCK (cd_util_client);
+	icc = g_hash_table_lookup (priv->standard_spaces,
+				   GUINT_TO_POINTER (standard_space));
+	if (icc != NULL) {
+		g_object_ref (icc);
+		G_UNLOCK (cd_util_client);
+		return icc;
+	}
+	filename = cd_util_get_standard_space_filename (priv,
+							standard_space,
+							error);
+	if (filename == NULL) {
+		G_UNLOCK (cd_util_client);
+		return NULL;
+	}
+	icc_tmp = cd_icc_new ();
+	file = g_file_new_for_path (filename);
+	if (!cd_icc_load_file (icc_tmp, file, CD_ICC_LOAD_FLAGS_NONE, NULL, error)) {
+		G_UNLOCK (cd_util_client);
+		return NULL;
+	}
+	g_hash_table_insert (priv->standard_spaces,
+			     GUINT_TO_POINTER (standard_space),
+			     g_object_ref (icc_tmp));
+	G_UNLOCK (cd_util_client);
+	return g_steal_pointer (&icc_tmp);
+}
+
 /**
- * cd_util_get_coverage:
- * @profile: A valid #CdUtil
- * @filename_in: A filename to proof against
+ * cd_util_get_profile_coverage:
+ * @priv: A valid #CdUtilPrivate
+ * @standard_space: A #CdStandardSpace to proof against
  * @error: A #GError, or %NULL
  *
- * Gets the gamut coverage of two profiles
+ * Gets the gamut coverage of the standard space on the profile. The
+ * result is cached by libcolord for the pair of profile checksums.
  *
  * Return value: A positive value for success, or -1.0 for error.
  **/
-static gdouble
-cd_util_get_coverage (cmsHPROFILE profile_proof,
-		      const gchar *filename_in,
-		      GError **error)
-{
-	gdouble coverage = -1.0;
-	gboolean ret;
-	GFile *file = NULL;
-	CdIcc *icc = NULL;
-	CdIcc *icc_ref;
-
-	/* load proofing profile */
-	icc_ref = cd_icc_new ();
-	ret = cd_icc_load_handle (icc_ref, profile_proof,
-				  CD_ICC_LOAD_FLAGS_NONE, error);
-	if (!ret)
-		goto out;
-
-	/* load target profile */
-	icc = cd_icc_new ();
-	file = g_file_new_for_path (filename_in);
-	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_NONE, NULL, error);
-	if (!ret)
-		goto out;
-
-	/* get coverage */
-	ret = cd_icc_utils_get_coverage (icc, icc_ref, &coverage, error);
-	if (!ret)
-		return FALSE;
-out:
-	if (file != NULL)
-		g_object_unref (file);
-	if (icc != NULL)
-		g_object_unref (icc);
-	g_object_unref (icc_ref);
-	return ret;
-}
-
 static gdouble
 cd_util_get_profile_coverage (CdUtilPrivate *priv,
 			      CdStandardSpace standard_space,
 			      GError **error)
 {
-	gchar *filename = NULL;
 	gdouble coverage = -1.0f;
-	cmsHPROFILE profile;
+	g_autoptr(CdIcc) icc_ref = NULL;
 
 	/* get the correct standard space */
-	filename = cd_util_get_standard_space_filename (priv,
-							standard_space,
-							error);
-	if (filename == NULL)
-		goto out;
+	icc_ref = cd_util_get_standard_space (priv, standard_space, error);
+	if (icc_ref == NULL)
+		return -1.0f;
 
 	/* work out the coverage */
-	profile = cd_icc_get_handle (priv->icc);
-	coverage = cd_util_get_coverage (profile, filename, error);
-	if (coverage < 0.0f)
-		goto out;
-out:
-	g_free (filename);
+	if (!cd_icc_utils_get_coverage (icc_ref, priv->icc, &coverage, error))
+		return -1.0f;
 	return coverage;
 }
 
+typedef struct {
+	CdUtilPrivate		*priv;
+	CdStandardSpace		 standard_space;
+	gdouble			 coverage;
+	GError			*error;
+} CdUtilCoverageHelper;
+
+static gpointer
+cd_util_get_profile_coverage_thread_cb (gpointer user_data)
+{
+	CdUtilCoverageHelper *helper = (CdUtilCoverageHelper *) user_data;
+	helper->coverage = cd_util_get_profile_coverage (helper->priv,
+							 helper->standard_space,
+							 &helper->error);
+	return NULL;
+}
+
 static gboolean
 cd_util_set_version (CdUtilPrivate *priv, gchar **values, GError **error)
 {
@@ -415,26 +438,38 @@ cd_util_set_fix_metadata (CdUtilPrivate *priv, gchar **values, GError **error)
 
 	/* get coverages of common spaces */
 	if (cd_icc_get_colorspace (priv->icc) == CD_COLORSPACE_RGB) {
+		CdUtilCoverageHelper helper = { priv, CD_STANDARD_SPACE_ADOBE_RGB, -1.0f, NULL };
+		GThread *thread;
+
+		/* get the gamut coverage for AdobeRGB in parallel */
+		thread = g_thread_try_new ("cd-fix-profile-coverage",
+					   cd_util_get_profile_coverage_thread_cb,
+					   &helper, NULL);
+		if (thread == NULL)
+			cd_util_get_profile_coverage_thread_cb (&helper);
 
 		/* get the gamut coverage for sRGB */
 		coverage = cd_util_get_profile_coverage (priv,
-							 CD_STANDARD_SPACE_ADOBE_RGB,
+							 CD_STANDARD_SPACE_SRGB,
 							 error);
-		if (coverage < 0.0)
+		if (thread != NULL)
+			g_thread_join (thread);
+		if (coverage < 0.0) {
+			g_clear_error (&helper.error);
 			return FALSE;
-		coverage_tmp = g_strdup_printf ("%f", coverage);
+		}
+		if (helper.coverage < 0.0) {
+			g_propagate_error (error, helper.error);
+			return FALSE;
+		}
+
+		coverage_tmp = g_strdup_printf ("%f", helper.coverage);
 		cd_icc_add_metadata (priv->icc,
 				     "GAMUT_coverage(adobe-rgb)",
 				     coverage_tmp);
 		g_free (coverage_tmp);
-		g_debug ("coverage of AdobeRGB: %f%%", coverage * 100.0f);
+		g_debug ("coverage of AdobeRGB: %f%%", helper.coverage * 100.0f);
 
-		/* get the gamut coverage for AdobeRGB */
-		coverage = cd_util_get_profile_coverage (priv,
-							 CD_STANDARD_SPACE_SRGB,
-							 error);
-		if (coverage < 0.0)
-			return FALSE;
 		coverage_tmp = g_strdup_printf ("%.2f", coverage);
 		cd_icc_add_metadata (priv->icc,
 				     "GAMUT_coverage(srgb)",
@@ -551,6 +586,160 @@ cd_util_extract_vcgt (CdUtilPrivate *priv, gchar **values, GError **error)
 	return TRUE;
 }
 
+static gboolean
+cd_util_process_file (CdUtilPrivate *priv,
+		      const gchar *filename,
+		      gchar **values,
+		      GError **error)
+{
+	CdUtilPrivate tmp = *priv;
+	gboolean ret;
+	g_autoptr(CdIcc) icc = cd_icc_new ();
+	g_autoptr(GFile) file = g_file_new_for_path (filename);
+
+	/* each file gets its own profile, sharing everything else */
+	if (!cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_ALL, NULL, error))
+		return FALSE;
+	tmp.icc = icc;
+	tmp.rewrite_file = TRUE;
+	ret = cd_util_run (&tmp, values[0], values, error);
+	if (!ret)
+		return FALSE;
+
+	/* cd_icc_save_file() only replaces the file when complete */
+	if (!tmp.rewrite_file)
+		return TRUE;
+	return cd_icc_save_file (icc, file, CD_ICC_SAVE_FLAGS_NONE, NULL, error);
+}
+
+static void
+cd_util_batch_thread_cb (gpointer data, gpointer user_data)
+{
+	CdUtilBatchItem *item = (CdUtilBatchItem *) data;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *msg = NULL;
+
+	/* one line per file, with the message on the same line */
+	item->ret = cd_util_process_file (item->priv,
+					  item->filename,
+					  item->values,
+					  &error);
+	if (item->ret) {
+		g_print ("ok\t%s\n", item->filename);
+		return;
+	}
+	msg = g_strdelimit (g_strdup (error->message), "\t\n", ' ');
+	g_print ("failed\t%s\t%s\n", item->filename, msg);
+}
+
+static gboolean
+cd_util_add_directory (GPtrArray *filenames, GFile *directory, GError **error)
+{
+	g_autoptr(GFileEnumerator) enumerator = NULL;
+
+	enumerator = g_file_enumerate_children (directory,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NONE,
+						NULL,
+						error);
+	if (enumerator == NULL)
+		return FALSE;
+	for (;;) {
+		GFileInfo *info;
+		const gchar *name;
+		g_autoptr(GFile) child = NULL;
+
+		if (!g_file_enumerator_iterate (enumerator, &info, NULL, NULL, error))
+			return FALSE;
+		if (info == NULL)
+			break;
+		name = g_file_info_get_name (info);
+		child = g_file_get_child (directory, name);
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			if (!cd_util_add_directory (filenames, child, error))
+				return FALSE;
+			continue;
+		}
+		if (g_str_has_suffix (name, ".icc") ||
+		    g_str_has_suffix (name, ".ICC") ||
+		    g_str_has_suffix (name, ".icm") ||
+		    g_str_has_suffix (name, ".ICM"))
+			g_ptr_array_add (filenames, g_file_get_path (child));
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_util_add_files_from (GPtrArray *filenames, const gchar *list, GError **error)
+{
+	guint i;
+	g_autofree gchar *data = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (!g_file_get_contents (list, &data, NULL, error))
+		return FALSE;
+	lines = g_strsplit (data, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0')
+			continue;
+		g_ptr_array_add (filenames, g_strdup (lines[i]));
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_util_run_batch (CdUtilPrivate *priv,
+		   GPtrArray *filenames,
+		   gchar **values,
+		   guint jobs,
+		   GError **error)
+{
+	GThreadPool *pool;
+	guint i;
+	guint n_failed = 0;
+	g_autofree CdUtilBatchItem *items = NULL;
+
+	/* check the command exists before starting */
+	if (values[0] == NULL) {
+		g_set_error_literal (error, 1, 0, "No command specified");
+		return FALSE;
+	}
+	for (i = 0; i < priv->cmd_array->len; i++) {
+		CdUtilItem *item = g_ptr_array_index (priv->cmd_array, i);
+		if (g_strcmp0 (item->name, values[0]) == 0)
+			break;
+	}
+	if (i == priv->cmd_array->len)
+		return cd_util_run (priv, values[0], values, error);
+
+	items = g_new0 (CdUtilBatchItem, filenames->len);
+	pool = g_thread_pool_new (cd_util_batch_thread_cb, NULL,
+				  MAX (jobs, 1), TRUE, error);
+	if (pool == NULL)
+		return FALSE;
+	for (i = 0; i < filenames->len; i++) {
+		items[i].priv = priv;
+		items[i].filename = g_ptr_array_index (filenames, i);
+		items[i].values = values;
+		g_thread_pool_push (pool, &items[i], NULL);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* the results have already been printed */
+	for (i = 0; i < filenames->len; i++) {
+		if (!items[i].ret)
+			n_failed++;
+	}
+	if (n_failed > 0) {
+		g_set_error (error, 1, 0,
+			     "%u of %u profiles failed",
+			     n_failed, filenames->len);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 static void
 cd_util_ignore_cb (const gchar *log_domain, GLogLevelFlags log_level,
 		   const gchar *message, gpointer user_data)
@@ -575,7 +764,10 @@ main (int argc, char *argv[])
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *cmd_descriptions = NULL;
 	g_autofree gchar *locale = NULL;
+	g_autofree gchar *directory = NULL;
+	g_autofree gchar *files_from = NULL;
 	g_autoptr(GFile) file = NULL;
+	gint jobs = 0;
 	const GOptionEntry options[] = {
 		{ "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
 			/* TRANSLATORS: command line option */
@@ -583,6 +775,15 @@ main (int argc, char *argv[])
 		{ "locale", '\0', 0, G_OPTION_ARG_STRING, &locale,
 			/* TRANSLATORS: command line option */
 			_("The locale to use when setting localized text"), NULL },
+		{ "directory", '\0', 0, G_OPTION_ARG_FILENAME, &directory,
+			/* TRANSLATORS: command line option */
+			_("Run the command on every profile in a directory"), NULL },
+		{ "files-from", '\0', 0, G_OPTION_ARG_FILENAME, &files_from,
+			/* TRANSLATORS: command line option */
+			_("Run the command on every profile listed in a file"), NULL },
+		{ "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+			/* TRANSLATORS: command line option */
+			_("The number of profiles to process at once"), NULL },
 		{ NULL}
 	};
 
@@ -597,6 +798,10 @@ main (int argc, char *argv[])
 	priv = g_new0 (CdUtilPrivate, 1);
 	priv->rewrite_file = TRUE;
 	priv->client = cd_client_new ();
+	priv->standard_spaces = g_hash_table_new_full (g_direct_hash,
+						       g_direct_equal,
+						       NULL,
+						       g_object_unref);
 
 	/* add commands */
 	priv->cmd_array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_util_item_free);
@@ -692,6 +897,32 @@ main (int argc, char *argv[])
 				   cd_util_ignore_cb, NULL);
 	}
 
+	/* batch mode, where the first option is the command */
+	if (directory != NULL || files_from != NULL) {
+		g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
+		if (directory != NULL) {
+			g_autoptr(GFile) dir = g_file_new_for_path (directory);
+			if (!cd_util_add_directory (filenames, dir, &error)) {
+				g_print ("%s\n", error->message);
+				goto out;
+			}
+		}
+		if (files_from != NULL) {
+			if (!cd_util_add_files_from (filenames, files_from, &error)) {
+				g_print ("%s\n", error->message);
+				goto out;
+			}
+		}
+		if (jobs <= 0)
+			jobs = g_get_num_processors ();
+		if (!cd_util_run_batch (priv, filenames, &argv[1], jobs, &error)) {
+			g_printerr ("%s\n", error->message);
+			goto out;
+		}
+		retval = 0;
+		goto out;
+	}
+
 	/* the first option is always the filename */
 	if (argc < 2) {
 		g_print ("%s\n", "Filename must be the first argument");
@@ -741,6 +972,7 @@ out:
 		if (priv->icc != NULL)
 			g_object_unref (priv->icc);
 		g_object_unref (priv->client);
+		g_hash_table_unref (priv->standard_spaces);
 		g_free (priv->locale);
 		g_free (priv);
 	}
@@ -25,6 +25,7 @@
 #include <locale.h>
 #include <lcms2.h>
 #include <lcms2_plugin.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <colord-private.h>
@@ -42,6 +43,305 @@ cd_fix_profile_error_cb (cmsContext ContextID,
 	lcms_error_code = errorcode;
 }
 
+typedef enum {
+	CD_ICCDUMP_FIELD_FILENAME,
+	CD_ICCDUMP_FIELD_KIND,
+	CD_ICCDUMP_FIELD_COLORSPACE,
+	CD_ICCDUMP_FIELD_VERSION,
+	CD_ICCDUMP_FIELD_CREATED,
+	CD_ICCDUMP_FIELD_CHECKSUM,
+	CD_ICCDUMP_FIELD_SIZE,
+	CD_ICCDUMP_FIELD_DESCRIPTION,
+	CD_ICCDUMP_FIELD_METADATA,
+	CD_ICCDUMP_FIELD_LAST
+} CdIccdumpField;
+
+static const gchar *cd_iccdump_field_names[] = {
+	"filename",
+	"kind",
+	"colorspace",
+	"version",
+	"created",
+	"checksum",
+	"size",
+	"description",
+	"metadata",
+	NULL };
+
+typedef struct {
+	gboolean		 json;
+	GArray			*fields;	/* of CdIccdumpField */
+	GString			*str;
+} CdIccdumpPrivate;
+
+static gboolean
+cd_iccdump_parse_fields (CdIccdumpPrivate *priv,
+			 const gchar *fields,
+			 GError **error)
+{
+	guint i;
+	guint j;
+	g_auto(GStrv) split = NULL;
+
+	/* default to everything the header parser knows about */
+	if (fields == NULL) {
+		for (i = 0; i < CD_ICCDUMP_FIELD_LAST; i++)
+			g_array_append_val (priv->fields, i);
+		return TRUE;
+	}
+	split = g_strsplit (fields, ",", -1);
+	for (i = 0; split[i] != NULL; i++) {
+		for (j = 0; cd_iccdump_field_names[j] != NULL; j++) {
+			if (g_strcmp0 (split[i], cd_iccdump_field_names[j]) == 0)
+				break;
+		}
+		if (cd_iccdump_field_names[j] == NULL) {
+			g_set_error (error, 1, 0,
+				     "Unknown field '%s', valid fields are: %s",
+				     split[i], "filename, kind, colorspace, "
+				     "version, created, checksum, size, "
+				     "description, metadata");
+			return FALSE;
+		}
+		g_array_append_val (priv->fields, j);
+	}
+	return TRUE;
+}
+
+static void
+cd_iccdump_append_json_string (GString *str, const gchar *value)
+{
+	const gchar *tmp;
+
+	if (value == NULL) {
+		g_string_append (str, "null");
+		return;
+	}
+	g_string_append_c (str, '"');
+	for (tmp = value; *tmp != '\0'; tmp++) {
+		switch (*tmp) {
+		case '"':
+			g_string_append (str, "\\\"");
+			break;
+		case '\\':
+			g_string_append (str, "\\\\");
+			break;
+		case '\n':
+			g_string_append (str, "\\n");
+			break;
+		case '\r':
+			g_string_append (str, "\\r");
+			break;
+		case '\t':
+			g_string_append (str, "\\t");
+			break;
+		default:
+			if ((guchar) *tmp < 0x20) {
+				g_string_append_printf (str, "\\u%04x",
+							(guchar) *tmp);
+				break;
+			}
+			g_string_append_c (str, *tmp);
+			break;
+		}
+	}
+	g_string_append_c (str, '"');
+}
+
+static void
+cd_iccdump_append_string (CdIccdumpPrivate *priv, const gchar *value)
+{
+	const gchar *tmp;
+
+	if (priv->json) {
+		cd_iccdump_append_json_string (priv->str, value);
+		return;
+	}
+	if (value == NULL)
+		return;
+
+	/* keep each file on one tab-separated line */
+	for (tmp = value; *tmp != '\0'; tmp++) {
+		if (*tmp == '\t' || *tmp == '\n' || *tmp == '\r')
+			g_string_append_c (priv->str, ' ');
+		else
+			g_string_append_c (priv->str, *tmp);
+	}
+}
+
+static void
+cd_iccdump_append_metadata (CdIccdumpPrivate *priv, CdIcc *icc)
+{
+	GHashTable *metadata;
+	GList *l;
+	g_autoptr(GList) keys = NULL;
+
+	metadata = cd_icc_get_metadata (icc);
+	keys = g_hash_table_get_keys (metadata);
+	keys = g_list_sort (keys, (GCompareFunc) g_strcmp0);
+	if (priv->json)
+		g_string_append_c (priv->str, '{');
+	for (l = keys; l != NULL; l = l->next) {
+		const gchar *key = l->data;
+		if (l != keys)
+			g_string_append_c (priv->str, priv->json ? ',' : ';');
+		cd_iccdump_append_string (priv, key);
+		g_string_append_c (priv->str, priv->json ? ':' : '=');
+		cd_iccdump_append_string (priv, g_hash_table_lookup (metadata, key));
+	}
+	if (priv->json)
+		g_string_append_c (priv->str, '}');
+}
+
+static void
+cd_iccdump_append_field (CdIccdumpPrivate *priv,
+			 CdIcc *icc,
+			 const gchar *filename,
+			 CdIccdumpField field)
+{
+	g_autoptr(GDateTime) created = NULL;
+	g_autofree gchar *description = NULL;
+
+	switch (field) {
+	case CD_ICCDUMP_FIELD_FILENAME:
+		cd_iccdump_append_string (priv, filename);
+		break;
+	case CD_ICCDUMP_FIELD_KIND:
+		cd_iccdump_append_string (priv, cd_profile_kind_to_string (cd_icc_get_kind (icc)));
+		break;
+	case CD_ICCDUMP_FIELD_COLORSPACE:
+		cd_iccdump_append_string (priv, cd_colorspace_to_string (cd_icc_get_colorspace (icc)));
+		break;
+	case CD_ICCDUMP_FIELD_VERSION:
+		g_string_append_printf (priv->str, "%.2f", cd_icc_get_version (icc));
+		break;
+	case CD_ICCDUMP_FIELD_CREATED:
+		created = cd_icc_get_created (icc);
+		if (created != NULL) {
+			g_string_append_printf (priv->str, "%" G_GINT64_FORMAT,
+						g_date_time_to_unix (created));
+		} else if (priv->json) {
+			g_string_append (priv->str, "null");
+		}
+		break;
+	case CD_ICCDUMP_FIELD_CHECKSUM:
+		cd_iccdump_append_string (priv, cd_icc_get_checksum (icc));
+		break;
+	case CD_ICCDUMP_FIELD_SIZE:
+		g_string_append_printf (priv->str, "%" G_GUINT32_FORMAT,
+					cd_icc_get_size (icc));
+		break;
+	case CD_ICCDUMP_FIELD_DESCRIPTION:
+		description = g_strdup (cd_icc_get_description (icc, NULL, NULL));
+		if (description != NULL && !g_utf8_validate (description, -1, NULL)) {
+			gchar *tmp = g_utf8_make_valid (description, -1);
+			g_free (description);
+			description = tmp;
+		}
+		cd_iccdump_append_string (priv, description);
+		break;
+	case CD_ICCDUMP_FIELD_METADATA:
+		cd_iccdump_append_metadata (priv, icc);
+		break;
+	default:
+		break;
+	}
+}
+
+static gboolean
+cd_iccdump_print_fields (CdIccdumpPrivate *priv,
+			 const gchar *filename,
+			 GError **error)
+{
+	guint i;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	/* only the header, tag table, description and metadata are parsed */
+	icc = cd_icc_new ();
+	file = g_file_new_for_path (filename);
+	if (!cd_icc_peek_file (icc, file, NULL, error))
+		return FALSE;
+
+	/* one line per file so the output can be streamed */
+	g_string_truncate (priv->str, 0);
+	if (priv->json)
+		g_string_append_c (priv->str, '{');
+	for (i = 0; i < priv->fields->len; i++) {
+		CdIccdumpField field = g_array_index (priv->fields, CdIccdumpField, i);
+		if (i > 0)
+			g_string_append_c (priv->str, priv->json ? ',' : '\t');
+		if (priv->json) {
+			cd_iccdump_append_json_string (priv->str,
+						       cd_iccdump_field_names[field]);
+			g_string_append_c (priv->str, ':');
+		}
+		cd_iccdump_append_field (priv, icc, filename, field);
+	}
+	if (priv->json)
+		g_string_append_c (priv->str, '}');
+	g_string_append_c (priv->str, '\n');
+	fwrite (priv->str->str, 1, priv->str->len, stdout);
+	return TRUE;
+}
+
+static void
+cd_iccdump_print_failure (CdIccdumpPrivate *priv,
+			  const gchar *filename,
+			  const GError *error)
+{
+	/* keep the NDJSON stream parsable when a file cannot be read */
+	if (!priv->json) {
+		g_printerr ("Failed to dump %s: %s\n", filename, error->message);
+		return;
+	}
+	g_string_truncate (priv->str, 0);
+	g_string_append (priv->str, "{\"filename\":");
+	cd_iccdump_append_json_string (priv->str, filename);
+	g_string_append (priv->str, ",\"error\":");
+	cd_iccdump_append_json_string (priv->str, error->message);
+	g_string_append (priv->str, "}\n");
+	fwrite (priv->str->str, 1, priv->str->len, stdout);
+}
+
+static gboolean
+cd_iccdump_add_directory (GPtrArray *filenames, GFile *directory, GError **error)
+{
+	g_autoptr(GFileEnumerator) enumerator = NULL;
+
+	enumerator = g_file_enumerate_children (directory,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NONE,
+						NULL,
+						error);
+	if (enumerator == NULL)
+		return FALSE;
+	for (;;) {
+		GFileInfo *info;
+		const gchar *name;
+		g_autoptr(GFile) child = NULL;
+
+		if (!g_file_enumerator_iterate (enumerator, &info, NULL, NULL, error))
+			return FALSE;
+		if (info == NULL)
+			break;
+		name = g_file_info_get_name (info);
+		child = g_file_get_child (directory, name);
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			if (!cd_iccdump_add_directory (filenames, child, error))
+				return FALSE;
+			continue;
+		}
+		if (g_str_has_suffix (name, ".icc") ||
+		    g_str_has_suffix (name, ".ICC") ||
+		    g_str_has_suffix (name, ".icm") ||
+		    g_str_has_suffix (name, ".ICM"))
+			g_ptr_array_add (filenames, g_file_get_path (child));
+	}
+	return TRUE;
+}
+
 static gboolean
 cd_iccdump_print_file (const gchar *filename, GError **error)
 {
@@ -61,14 +361,52 @@ cd_iccdump_print_file (const gchar *filename, GError **error)
 	return TRUE;
 }
 
+static gboolean
+cd_iccdump_add_files_from (GPtrArray *filenames, const gchar *list, GError **error)
+{
+	guint i;
+	g_autofree gchar *data = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (!g_file_get_contents (list, &data, NULL, error))
+		return FALSE;
+	lines = g_strsplit (data, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		if (lines[i][0] == '\0')
+			continue;
+		g_ptr_array_add (filenames, g_strdup (lines[i]));
+	}
+	return TRUE;
+}
+
 int
 main (int argc, char **argv)
 {
+	CdIccdumpPrivate *priv;
 	gboolean ret;
 	GOptionContext *context;
 	gint i;
+	guint j;
+	guint n_failed = 0;
 	guint retval = EXIT_FAILURE;
+	g_autofree gchar *fields = NULL;
+	g_autofree gchar *files_from = NULL;
+	g_autofree gchar *output = NULL;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) filenames = NULL;
+
+	const GOptionEntry options[] = {
+		{ "output", 'o', 0, G_OPTION_ARG_STRING, &output,
+			/* TRANSLATORS: command line option */
+			_("Output format, either 'text' or 'json'"), NULL },
+		{ "fields", 'f', 0, G_OPTION_ARG_STRING, &fields,
+			/* TRANSLATORS: command line option */
+			_("Comma separated list of fields to show"), NULL },
+		{ "files-from", '\0', 0, G_OPTION_ARG_FILENAME, &files_from,
+			/* TRANSLATORS: command line option */
+			_("Read the list of profiles from a file"), NULL },
+		{ NULL}
+	};
 
 	setlocale (LC_ALL, "");
 
@@ -76,9 +414,14 @@ main (int argc, char **argv)
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	textdomain (GETTEXT_PACKAGE);
 
+	priv = g_new0 (CdIccdumpPrivate, 1);
+	priv->fields = g_array_new (FALSE, FALSE, sizeof (CdIccdumpField));
+	priv->str = g_string_new (NULL);
+
 	/* setup LCMS */
 	cmsSetLogErrorHandler (cd_fix_profile_error_cb);
 	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
 
 	/* TRANSLATORS: program name */
 	g_set_application_name (_("ICC profile dump program"));
@@ -90,19 +433,66 @@ main (int argc, char **argv)
 		goto out;
 	}
 
-	/* dump each option */
+	if (output != NULL && g_strcmp0 (output, "json") != 0 &&
+	    g_strcmp0 (output, "text") != 0) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s: %s\n", _("Failed to parse arguments"),
+			 "output must be 'text' or 'json'");
+		goto out;
+	}
+	priv->json = g_strcmp0 (output, "json") == 0;
+	if (!cd_iccdump_parse_fields (priv, fields, &error)) {
+		/* TRANSLATORS: the user didn't read the man page */
+		g_print ("%s: %s\n", _("Failed to parse arguments"),
+			 error->message);
+		goto out;
+	}
+
+	/* expand directories so whole trees can be indexed in one go */
+	filenames = g_ptr_array_new_with_free_func (g_free);
 	for (i = 1; i < argc; i++) {
-		ret = cd_iccdump_print_file (argv[i], &error);
-		if (!ret) {
-			g_warning ("Failed to dump %s: %s",
-				   argv[i], error->message);
+		if (g_file_test (argv[i], G_FILE_TEST_IS_DIR)) {
+			g_autoptr(GFile) dir = g_file_new_for_path (argv[i]);
+			if (!cd_iccdump_add_directory (filenames, dir, &error)) {
+				g_warning ("Failed to read %s: %s",
+					   argv[i], error->message);
+				goto out;
+			}
+			continue;
+		}
+		g_ptr_array_add (filenames, g_strdup (argv[i]));
+	}
+	if (files_from != NULL) {
+		if (!cd_iccdump_add_files_from (filenames, files_from, &error)) {
+			g_warning ("Failed to read %s: %s",
+				   files_from, error->message);
 			goto out;
 		}
 	}
 
+	/* dump each file, carrying on past any that fail */
+	for (j = 0; j < filenames->len; j++) {
+		const gchar *filename = g_ptr_array_index (filenames, j);
+		g_autoptr(GError) error_local = NULL;
+
+		if (priv->json || fields != NULL)
+			ret = cd_iccdump_print_fields (priv, filename, &error_local);
+		else
+			ret = cd_iccdump_print_file (filename, &error_local);
+		if (!ret) {
+			cd_iccdump_print_failure (priv, filename, error_local);
+			n_failed++;
+		}
+	}
+	if (n_failed > 0)
+		goto out;
+
 	/* success */
 	retval = EXIT_SUCCESS;
 out:
+	g_array_unref (priv->fields);
+	g_string_free (priv->str, TRUE);
+	g_free (priv);
 	g_option_context_free (context);
 	return retval;
 }
@@ -24,18 +24,26 @@
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <locale.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <colord/colord.h>
 
 #define CD_ERROR			1
 #define CD_ERROR_INVALID_ARGUMENTS	0
 #define CD_ERROR_NO_SUCH_CMD		1
 
+#define CD_UTIL_VERIFY_OUTLIERS_MAX	10
+#define CD_UTIL_REFERENCE_RESOLUTION	1.f	/* nm */
+
 typedef struct {
 	GOptionContext		*context;
 	GPtrArray		*cmd_array;
 	gboolean		 timestamps;
+	guint			 jobs;
+	CdIt8UtilsPlan		*report_plan;
+	CdIt8UtilsCri		*report_cri;
 } CdUtilPrivate;
 
 typedef gboolean (*CdUtilPrivateCb)	(CdUtilPrivate	*util,
@@ -172,130 +180,343 @@ cd_util_run (CdUtilPrivate *priv, const gchar *command, gchar **values, GError *
 	return FALSE;
 }
 
+/* parsed CSV data, with @n_values values for each wavelength in @values */
 typedef struct {
-	guint		 nm;
-	CdColorXYZ	 xyz;
-} CdSpectrumData;
+	GArray		*nm;		/* of gdouble */
+	GArray		*values;	/* of gdouble */
+	guint		 n_values;
+} CdUtilCsv;
 
 static void
-cd_csv2cmf_data_free (CdSpectrumData *data)
+cd_util_csv_free (CdUtilCsv *csv)
 {
-	g_slice_free (CdSpectrumData, data);
+	g_array_unref (csv->nm);
+	g_array_unref (csv->values);
+	g_free (csv);
 }
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdUtilCsv, cd_util_csv_free)
+
 static gboolean
-cd_util_create_cmf (CdUtilPrivate *priv,
-		    gchar **values,
-		    GError **error)
+cd_util_csv_is_separator (gchar c)
 {
-	gboolean ret = TRUE;
-	CdSpectrum *spectrum[3] = { NULL, NULL, NULL };
-	CdSpectrumData *tmp;
-	gchar *dot;
-	guint i;
-	gdouble norm;
-	g_autofree gchar *data = NULL;
-	g_autofree gchar *title = NULL;
-	g_autoptr(CdIt8) cmf = NULL;
-	g_autoptr(GFile) file = NULL;
-	g_autoptr(GPtrArray) array = NULL;
-	g_auto(GStrv) lines = NULL;
-
-	if (g_strv_length (values) != 3) {
-		g_set_error_literal (error,
-				     CD_ERROR,
-				     CD_ERROR_INVALID_ARGUMENTS,
-				     "Not enough arguments, expected: "
-				     "file.cmf file.csv norm");
-		return FALSE;
-	}
-
-	/* get data */
-	if (!g_file_get_contents (values[1], &data, NULL, error))
-		return FALSE;
+	return c == ',' || c == ' ' || c == '\t' || c == '\r';
+}
 
-	/* parse lines */
-	norm = g_strtod (values[2], NULL);
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_csv2cmf_data_free);
-	lines = g_strsplit (data, "\n", -1);
-	for (i = 0; lines[i] != NULL; i++) {
-		g_auto(GStrv) split = NULL;
-		if (lines[i][0] == '\0')
+static CdUtilCsv *
+cd_util_csv_parse (const gchar *data, guint n_values, gdouble norm, GError **error)
+{
+	const gchar *line;
+	const gchar *next;
+	g_autoptr(CdUtilCsv) csv = NULL;
+
+	csv = g_new0 (CdUtilCsv, 1);
+	csv->n_values = n_values;
+	csv->nm = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	csv->values = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	/* parse in place, without splitting into lines and fields */
+	for (line = data; line != NULL && *line != '\0'; line = next) {
+		const gchar *end;
+		const gchar *tmp;
+		gchar *endptr;
+		gdouble row[4];
+		guint i;
+		guint n_row = 0;
+
+		end = strchr (line, '\n');
+		next = end != NULL ? end + 1 : NULL;
+		if (end == NULL)
+			end = line + strlen (line);
+		if (line == end || line[0] == '#' || line[0] == '\r')
 			continue;
-		if (lines[i][0] == '#')
+		for (tmp = line; tmp < end;) {
+			while (tmp < end && cd_util_csv_is_separator (*tmp))
+				tmp++;
+			if (tmp == end)
+				break;
+			if (n_row == n_values + 1) {
+				n_row++;
+				break;
+			}
+			row[n_row] = g_ascii_strtod (tmp, &endptr);
+			if (endptr == tmp || endptr > end ||
+			    (endptr < end && !cd_util_csv_is_separator (*endptr))) {
+				n_row = 0;
+				break;
+			}
+			n_row++;
+			tmp = endptr;
+		}
+		if (n_row != n_values + 1) {
+			g_printerr ("Ignoring data line: %.*s\n",
+				    (gint) (end - line), line);
 			continue;
-		split = g_strsplit_set (lines[i], ", \t", -1);
-		if (g_strv_length (split) == 4) {
-			tmp = g_slice_new0 (CdSpectrumData);
-			tmp->nm = atoi (split[0]);
-			cd_color_xyz_set (&tmp->xyz,
-					  g_strtod (split[1], NULL) / norm,
-					  g_strtod (split[2], NULL) / norm,
-					  g_strtod (split[3], NULL) / norm);
-			g_ptr_array_add (array, tmp);
-		} else {
-			g_printerr ("Ignoring data line: %s", lines[i]);
+		}
+		g_array_append_val (csv->nm, row[0]);
+		for (i = 1; i <= n_values; i++) {
+			gdouble val = row[i] / norm;
+			g_array_append_val (csv->values, val);
 		}
 	}
 
 	/* did we get enough data */
-	if (array->len < 3) {
+	if (csv->nm->len < 3) {
 		g_set_error_literal (error,
 				     CD_ERROR,
 				     CD_ERROR_INVALID_ARGUMENTS,
 				     "Not enough data in the CSV file");
-		return FALSE;
+		return NULL;
 	}
+	return g_steal_pointer (&csv);
+}
 
-	for (i = 0; i < 3; i++) {
-		spectrum[i] = cd_spectrum_sized_new (array->len);
-		cd_spectrum_set_norm (spectrum[i], 1.f);
+static CdUtilCsv *
+cd_util_csv_load (const gchar *filename, guint n_values, gdouble norm, GError **error)
+{
+	g_autofree gchar *data = NULL;
+	if (!g_file_get_contents (filename, &data, NULL, error))
+		return NULL;
+	return cd_util_csv_parse (data, n_values, norm, error);
+}
+
+static CdSpectrum *
+cd_util_csv_get_spectrum (CdUtilCsv *csv, guint idx, const gchar *id)
+{
+	CdSpectrum *spectrum;
+	guint i;
+	g_autoptr(GArray) data = NULL;
+
+	/* copy the column out into one contiguous array */
+	data = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), csv->nm->len);
+	for (i = 0; i < csv->nm->len; i++) {
+		gdouble val = g_array_index (csv->values, gdouble,
+					     i * csv->n_values + idx);
+		g_array_append_val (data, val);
 	}
+	spectrum = cd_spectrum_new ();
+	cd_spectrum_set_data (spectrum, data);
+	cd_spectrum_set_norm (spectrum, 1.f);
+	cd_spectrum_set_start (spectrum, (guint) g_array_index (csv->nm, gdouble, 0));
+	cd_spectrum_set_end (spectrum, (guint) g_array_index (csv->nm, gdouble, csv->nm->len - 1));
+	if (id != NULL)
+		cd_spectrum_set_id (spectrum, id);
+	return spectrum;
+}
 
-	/* set ID */
-	cd_spectrum_set_id (spectrum[0], "X");
-	cd_spectrum_set_id (spectrum[1], "Y");
-	cd_spectrum_set_id (spectrum[2], "Z");
+static void
+cd_util_it8_set_title_from_csv (CdIt8 *it8, const gchar *filename)
+{
+	gchar *dot;
+	g_autofree gchar *title = NULL;
 
-	/* get the first point */
-	tmp = g_ptr_array_index (array, 0);
-	for (i = 0; i < 3; i++)
-		cd_spectrum_set_start (spectrum[i], tmp->nm);
+	title = g_path_get_basename (filename);
+	dot = g_strrstr (title, ".csv");
+	if (dot != NULL)
+		*dot = '\0';
+	cd_it8_set_title (it8, title);
+}
 
-	/* get the last point */
-	tmp = g_ptr_array_index (array, array->len - 1);
-	for (i = 0; i < 3; i++)
-		cd_spectrum_set_end (spectrum[i], tmp->nm);
+static gboolean
+cd_util_convert_cmf (CdUtilPrivate *priv,
+		     const gchar *filename_out,
+		     const gchar *filename_in,
+		     gdouble norm,
+		     GError **error)
+{
+	const gchar *ids[] = { "X", "Y", "Z" };
+	guint i;
+	g_autoptr(CdIt8) cmf = NULL;
+	g_autoptr(CdUtilCsv) csv = NULL;
+	g_autoptr(GFile) file = NULL;
 
-	/* add data to the spectra */
-	for (i = 0; i < array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		cd_spectrum_add_value (spectrum[0], tmp->xyz.X);
-		cd_spectrum_add_value (spectrum[1], tmp->xyz.Y);
-		cd_spectrum_add_value (spectrum[2], tmp->xyz.Z);
-	}
+	csv = cd_util_csv_load (filename_in, 3, norm, error);
+	if (csv == NULL)
+		return FALSE;
 
 	/* add spectra to the CMF file */
 	cmf = cd_it8_new_with_kind (CD_IT8_KIND_CMF);
-	for (i = 0; i < 3; i++)
-		cd_it8_add_spectrum (cmf, spectrum[i]);
+	for (i = 0; i < 3; i++) {
+		g_autoptr(CdSpectrum) spectrum = cd_util_csv_get_spectrum (csv, i, ids[i]);
+		cd_it8_add_spectrum (cmf, spectrum);
+	}
+	cd_it8_set_originator (cmf, "cd-it8");
+	cd_util_it8_set_title_from_csv (cmf, filename_in);
+	cd_it8_set_enable_created (cmf, priv->timestamps);
+
+	/* save */
+	file = g_file_new_for_path (filename_out);
+	return cd_it8_save_to_file (cmf, file, error);
+}
+
+static gboolean
+cd_util_convert_sp (CdUtilPrivate *priv,
+		    const gchar *filename_out,
+		    const gchar *filename_in,
+		    gdouble norm,
+		    GError **error)
+{
+	g_autoptr(CdIt8) cmf = NULL;
+	g_autoptr(CdSpectrum) spectrum = NULL;
+	g_autoptr(CdUtilCsv) csv = NULL;
+	g_autoptr(GFile) file = NULL;
 
+	csv = cd_util_csv_load (filename_in, 1, norm, error);
+	if (csv == NULL)
+		return FALSE;
+	spectrum = cd_util_csv_get_spectrum (csv, 0, NULL);
+
+	/* add spectra to the CMF file */
+	cmf = cd_it8_new_with_kind (CD_IT8_KIND_SPECT);
+	cd_it8_add_spectrum (cmf, spectrum);
 	cd_it8_set_originator (cmf, "cd-it8");
-	title = g_path_get_basename (values[1]);
-	dot = g_strrstr (title, ".csv");
-	if (dot != NULL)
-		*dot = '\0';
-	cd_it8_set_title (cmf, title);
+	cd_util_it8_set_title_from_csv (cmf, filename_in);
 	cd_it8_set_enable_created (cmf, priv->timestamps);
 
 	/* save */
-	file = g_file_new_for_path (values[0]);
-	ret = cd_it8_save_to_file (cmf, file, error);
-	for (i = 0; i < 3; i++) {
-		if (spectrum[i] != NULL)
-			cd_spectrum_free (spectrum[i]);
+	file = g_file_new_for_path (filename_out);
+	if (!cd_it8_save_to_file (cmf, file, error))
+		return FALSE;
+
+	/* print the colorimetry from the data we already have */
+	if (priv->report_plan != NULL) {
+		CdColorXYZ xyz;
+		gdouble cri = 0.f;
+		cd_it8_utils_plan_calculate_xyz (priv->report_plan, spectrum, &xyz);
+		if (!cd_it8_utils_cri_calculate (priv->report_cri, spectrum, &cri, error)) {
+			g_prefix_error (error, "failed to calculate CRI: ");
+			return FALSE;
+		}
+		g_print ("%s\t%.6f\t%.6f\t%.6f\t%.0f\t%.1f\n",
+			 filename_in, xyz.X, xyz.Y, xyz.Z,
+			 cd_color_xyz_to_cct (&xyz), cri);
+	}
+	return TRUE;
+}
+
+typedef gboolean (*CdUtilConvertFunc)	(CdUtilPrivate	*priv,
+					 const gchar	*filename_out,
+					 const gchar	*filename_in,
+					 gdouble	 norm,
+					 GError		**error);
+
+typedef struct {
+	CdUtilPrivate		*priv;
+	CdUtilConvertFunc	 func;
+	gchar			*filename_in;
+	gchar			*filename_out;
+	gdouble			 norm;
+	gboolean		 ret;
+} CdUtilBatchItem;
+
+static void
+cd_util_batch_thread_cb (gpointer data, gpointer user_data)
+{
+	CdUtilBatchItem *item = (CdUtilBatchItem *) data;
+	g_autoptr(GError) error = NULL;
+
+	item->ret = item->func (item->priv,
+				item->filename_out,
+				item->filename_in,
+				item->norm,
+				&error);
+	if (!item->ret)
+		g_printerr ("Failed to convert %s: %s\n",
+			    item->filename_in, error->message);
+}
+
+static gboolean
+cd_util_convert_directory (CdUtilPrivate *priv,
+			   const gchar *directory_out,
+			   const gchar *directory_in,
+			   const gchar *suffix,
+			   gdouble norm,
+			   CdUtilConvertFunc func,
+			   GError **error)
+{
+	GThreadPool *pool;
+	const gchar *name;
+	guint i;
+	guint n_failed = 0;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GArray) items = NULL;
+
+	/* find all the CSV files */
+	dir = g_dir_open (directory_in, 0, error);
+	if (dir == NULL)
+		return FALSE;
+	if (g_mkdir_with_parents (directory_out, 0755) != 0) {
+		g_set_error (error,
+			     CD_ERROR,
+			     CD_ERROR_INVALID_ARGUMENTS,
+			     "Failed to create %s", directory_out);
+		return FALSE;
+	}
+	items = g_array_new (FALSE, TRUE, sizeof (CdUtilBatchItem));
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		CdUtilBatchItem item = { priv, func, NULL, NULL, norm, FALSE };
+		g_autofree gchar *basename = NULL;
+		if (!g_str_has_suffix (name, ".csv"))
+			continue;
+		basename = g_strndup (name, strlen (name) - 4);
+		item.filename_in = g_build_filename (directory_in, name, NULL);
+		item.filename_out = g_strdup_printf ("%s/%s.%s", directory_out,
+						     basename, suffix);
+		g_array_append_val (items, item);
+	}
+	if (items->len == 0) {
+		g_set_error (error,
+			     CD_ERROR,
+			     CD_ERROR_INVALID_ARGUMENTS,
+			     "No CSV files found in %s", directory_in);
+		return FALSE;
+	}
+
+	/* each file is independent */
+	pool = g_thread_pool_new (cd_util_batch_thread_cb, NULL,
+				  MAX (priv->jobs, 1), TRUE, error);
+	if (pool == NULL)
+		return FALSE;
+	for (i = 0; i < items->len; i++)
+		g_thread_pool_push (pool, &g_array_index (items, CdUtilBatchItem, i), NULL);
+	g_thread_pool_free (pool, FALSE, TRUE);
+	for (i = 0; i < items->len; i++) {
+		CdUtilBatchItem *item = &g_array_index (items, CdUtilBatchItem, i);
+		if (!item->ret)
+			n_failed++;
+		g_free (item->filename_in);
+		g_free (item->filename_out);
+	}
+	if (n_failed > 0) {
+		g_set_error (error,
+			     CD_ERROR,
+			     CD_ERROR_INVALID_ARGUMENTS,
+			     "%u of %u files failed", n_failed, items->len);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_util_create_cmf (CdUtilPrivate *priv,
+		    gchar **values,
+		    GError **error)
+{
+	if (g_strv_length (values) != 3) {
+		g_set_error_literal (error,
+				     CD_ERROR,
+				     CD_ERROR_INVALID_ARGUMENTS,
+				     "Not enough arguments, expected: "
+				     "file.cmf file.csv norm");
+		return FALSE;
+	}
+	if (g_file_test (values[1], G_FILE_TEST_IS_DIR)) {
+		return cd_util_convert_directory (priv, values[0], values[1], "cmf",
+						  g_strtod (values[2], NULL),
+						  cd_util_convert_cmf, error);
 	}
-	return ret;
+	return cd_util_convert_cmf (priv, values[0], values[1],
+				    g_strtod (values[2], NULL), error);
 }
 
 static gboolean
@@ -351,99 +572,197 @@ cd_util_calculate_ccmx (CdUtilPrivate *priv,
 	return TRUE;
 }
 
+static gint
+cd_util_sort_delta_e_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const gdouble *delta_e = (const gdouble *) user_data;
+	gdouble value_a = delta_e[*((const guint *) a)];
+	gdouble value_b = delta_e[*((const guint *) b)];
+	if (value_a > value_b)
+		return -1;
+	if (value_a < value_b)
+		return 1;
+	return 0;
+}
+
 static gboolean
-cd_util_create_sp (CdUtilPrivate *priv,
-		   gchar **values,
-		   GError **error)
+cd_util_verify_profile (CdUtilPrivate *priv,
+			gchar **values,
+			GError **error)
 {
-	CdSpectrumData *tmp;
-	gchar *dot;
-	gdouble norm;
+	const gdouble percentiles[] = { 50.f, 90.f, 95.f, 99.f, -1.f };
+	gdouble mean = 0.f;
 	guint i;
-	g_autofree gchar *data = NULL;
-	g_autofree gchar *title = NULL;
-	g_auto(GStrv) lines = NULL;
-	g_autoptr(CdIt8) cmf = NULL;
-	g_autoptr(CdSpectrum) spectrum = NULL;
-	g_autoptr(GFile) file = NULL;
-	g_autoptr(GPtrArray) array = NULL;
+	guint len;
+	g_autofree gdouble *delta_e = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIt8) it8_meas = NULL;
+	g_autoptr(GArray) order = NULL;
+	g_autoptr(GFile) file_icc = NULL;
+	g_autoptr(GFile) file_meas = NULL;
 
-	if (g_strv_length (values) < 1) {
+	/* check args */
+	if (g_strv_length (values) != 2) {
 		g_set_error_literal (error,
 				     CD_ERROR,
 				     CD_ERROR_INVALID_ARGUMENTS,
-				     "Not enough arguments, expected: file");
+				     "Not enough arguments, expected: file.ti3, file.icc");
 		return FALSE;
 	}
 
-	/* get data */
-	if (!g_file_get_contents (values[1], &data, NULL, error))
+	/* load measurement */
+	it8_meas = cd_it8_new ();
+	file_meas = g_file_new_for_path (values[0]);
+	if (!cd_it8_load_from_file (it8_meas, file_meas, error))
 		return FALSE;
 
-	/* parse lines */
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_csv2cmf_data_free);
-	lines = g_strsplit (data, "\n", -1);
-	norm = g_strtod (values[2], NULL);
-	for (i = 0; lines[i] != NULL; i++) {
-		g_auto(GStrv) split = NULL;
-		if (lines[i][0] == '\0')
-			continue;
-		if (lines[i][0] == '#')
+	/* load profile */
+	icc = cd_icc_new ();
+	file_icc = g_file_new_for_path (values[1]);
+	if (!cd_icc_load_file (icc, file_icc, CD_ICC_LOAD_FLAGS_NONE, NULL, error))
+		return FALSE;
+
+	/* compare every patch in one go */
+	len = cd_it8_get_data_size (it8_meas);
+	delta_e = g_new0 (gdouble, len);
+	if (!cd_it8_utils_verify_profile (it8_meas, icc, delta_e, error))
+		return FALSE;
+	for (i = 0; i < len; i++)
+		mean += delta_e[i] / len;
+	g_print ("Patches:\t%u\n", len);
+	g_print ("Mean ΔE:\t%.2f\n", mean);
+	for (i = 0; percentiles[i] > 0; i++) {
+		g_print ("P%.0f ΔE:\t%.2f\n", percentiles[i],
+			 cd_it8_utils_get_percentile (delta_e, len, percentiles[i]));
+	}
+	g_print ("Max ΔE:\t%.2f\n",
+		 cd_it8_utils_get_percentile (delta_e, len, 100.f));
+
+	/* show the worst patches */
+	order = g_array_sized_new (FALSE, FALSE, sizeof (guint), len);
+	for (i = 0; i < len; i++)
+		g_array_append_val (order, i);
+	g_array_sort_with_data (order, cd_util_sort_delta_e_cb, delta_e);
+	g_print ("Outliers:\n");
+	for (i = 0; i < MIN (len, CD_UTIL_VERIFY_OUTLIERS_MAX); i++) {
+		CdColorRGB rgb;
+		guint idx = g_array_index (order, guint, i);
+		if (!cd_it8_get_data_item (it8_meas, idx, &rgb, NULL))
 			continue;
-		split = g_strsplit_set (lines[i], ", \t", -1);
-		if (g_strv_length (split) == 2) {
-			tmp = g_slice_new0 (CdSpectrumData);
-			tmp->nm = atoi (split[0]);
-			cd_color_xyz_set (&tmp->xyz,
-					  g_strtod (split[1], NULL) / norm,
-					  0.f,
-					  0.f);
-			g_ptr_array_add (array, tmp);
-		} else {
-			g_printerr ("Ignoring data line: %s", lines[i]);
-		}
+		g_print ("  %u\tRGB %.3f,%.3f,%.3f\tΔE %.2f\n",
+			 idx + 1, rgb.R, rgb.G, rgb.B, delta_e[idx]);
 	}
+	return TRUE;
+}
 
-	/* did we get enough data */
-	if (array->len < 3) {
+static gboolean
+cd_util_create_sp (CdUtilPrivate *priv,
+		   gchar **values,
+		   GError **error)
+{
+	if (g_strv_length (values) != 3) {
 		g_set_error_literal (error,
 				     CD_ERROR,
 				     CD_ERROR_INVALID_ARGUMENTS,
-				     "Not enough data in the CSV file");
+				     "Not enough arguments, expected: "
+				     "file.sp file.csv norm");
 		return FALSE;
 	}
+	if (g_file_test (values[1], G_FILE_TEST_IS_DIR)) {
+		return cd_util_convert_directory (priv, values[0], values[1], "sp",
+						  g_strtod (values[2], NULL),
+						  cd_util_convert_sp, error);
+	}
+	return cd_util_convert_sp (priv, values[0], values[1],
+				   g_strtod (values[2], NULL), error);
+}
 
-	spectrum = cd_spectrum_sized_new (array->len);
-	cd_spectrum_set_norm (spectrum, 1.f);
+static gboolean
+cd_util_create_ref (CdUtilPrivate *priv,
+		    gchar **values,
+		    GError **error)
+{
+	CdSpectrum *spectrum;
+	gdouble end = G_MAXDOUBLE;
+	gdouble start = 0.f;
+	guint i;
+	g_autoptr(CdIt8) it8 = NULL;
+	g_autoptr(GBytes) data = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GPtrArray) spectra = NULL;
 
-	/* get the first point */
-	tmp = g_ptr_array_index (array, 0);
-	cd_spectrum_set_start (spectrum, tmp->nm);
+	if (g_strv_length (values) != 2) {
+		g_set_error_literal (error,
+				     CD_ERROR,
+				     CD_ERROR_INVALID_ARGUMENTS,
+				     "Not enough arguments, expected: "
+				     "file.ref file.cmf");
+		return FALSE;
+	}
 
-	/* get the last point */
-	tmp = g_ptr_array_index (array, array->len - 1);
-	cd_spectrum_set_end (spectrum, tmp->nm);
+	/* load the CMF or spectrum */
+	it8 = cd_it8_new ();
+	file = g_file_new_for_path (values[1]);
+	if (!cd_it8_load_from_file (it8, file, error))
+		return FALSE;
+	spectra = cd_it8_get_spectrum_array (it8);
+	if (spectra->len == 0) {
+		g_set_error (error,
+			     CD_ERROR,
+			     CD_ERROR_INVALID_ARGUMENTS,
+			     "No spectral data in %s", values[1]);
+		return FALSE;
+	}
 
-	/* add data to the spectra */
-	for (i = 0; i < array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		cd_spectrum_add_value (spectrum, tmp->xyz.X);
+	/* resample the range every channel covers to whole nanometers */
+	for (i = 0; i < spectra->len; i++) {
+		spectrum = g_ptr_array_index (spectra, i);
+		start = MAX (start, ceil (cd_spectrum_get_start (spectrum)));
+		end = MIN (end, floor (cd_spectrum_get_end (spectrum)));
+	}
+	data = cd_spectrum_reference_to_bytes (spectra, start, end,
+					       CD_UTIL_REFERENCE_RESOLUTION);
+	if (data == NULL) {
+		g_set_error (error,
+			     CD_ERROR,
+			     CD_ERROR_INVALID_ARGUMENTS,
+			     "Invalid spectral range in %s", values[1]);
+		return FALSE;
 	}
+	return g_file_set_contents (values[0],
+				    g_bytes_get_data (data, NULL),
+				    (gssize) g_bytes_get_size (data),
+				    error);
+}
 
-	/* add spectra to the CMF file */
-	cmf = cd_it8_new_with_kind (CD_IT8_KIND_SPECT);
-	cd_it8_add_spectrum (cmf, spectrum);
-	cd_it8_set_originator (cmf, "cd-it8");
-	title = g_path_get_basename (values[1]);
-	dot = g_strrstr (title, ".csv");
-	if (dot != NULL)
-		*dot = '\0';
-	cd_it8_set_title (cmf, title);
-	cd_it8_set_enable_created (cmf, priv->timestamps);
+static gboolean
+cd_util_setup_report (CdUtilPrivate *priv, GError **error)
+{
+	g_autoptr(CdIt8) cmf = NULL;
+	g_autoptr(CdIt8) tcs = NULL;
+	g_autoptr(CdSpectrum) unity = NULL;
+	g_autoptr(GFile) file_cmf = NULL;
+	g_autoptr(GFile) file_tcs = NULL;
+
+	/* load the installed observer and test color samples */
+	cmf = cd_it8_new ();
+	file_cmf = g_file_new_for_path (DATADIR "/colord/cmf/CIE1931-2deg-XYZ.cmf");
+	if (!cd_it8_load_from_file (cmf, file_cmf, error))
+		return FALSE;
+	tcs = cd_it8_new ();
+	file_tcs = g_file_new_for_path (DATADIR "/colord/ref/CIE-TCS.sp");
+	if (!cd_it8_load_from_file (tcs, file_tcs, error))
+		return FALSE;
 
-	/* save */
-	file = g_file_new_for_path (values[0]);
-	return cd_it8_save_to_file (cmf, file, error);
+	/* an empty spectrum is 1.0 everywhere, so the sample is the source */
+	unity = cd_spectrum_new ();
+	priv->report_plan = cd_it8_utils_plan_new (cmf, unity, 1.f, error);
+	if (priv->report_plan == NULL)
+		return FALSE;
+	priv->report_cri = cd_it8_utils_cri_new (cmf, tcs, 1.f, error);
+	if (priv->report_cri == NULL)
+		return FALSE;
+	return TRUE;
 }
 
 static void
@@ -459,6 +778,8 @@ main (int argc, char *argv[])
 	gboolean ret;
 	gboolean verbose = FALSE;
 	gboolean enable_timestamps = FALSE;
+	gboolean report = FALSE;
+	gint jobs = 0;
 	guint retval = 1;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *cmd_descriptions = NULL;
@@ -469,6 +790,12 @@ main (int argc, char *argv[])
 		{ "enable-timestamps", 'd', 0, G_OPTION_ARG_NONE, &enable_timestamps,
 			/* TRANSLATORS: command line option */
 			_("Write embedded creation timestamps"), NULL },
+		{ "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+			/* TRANSLATORS: command line option */
+			_("Number of files to convert at the same time"), NULL },
+		{ "report", 'r', 0, G_OPTION_ARG_NONE, &report,
+			/* TRANSLATORS: command line option */
+			_("Print the XYZ, CCT and CRI of each spectrum"), NULL },
 		{ NULL}
 	};
 
@@ -480,28 +807,39 @@ main (int argc, char *argv[])
 
 	/* create helper object */
 	priv = g_new0 (CdUtilPrivate, 1);
-	priv->timestamps = enable_timestamps;
 
 	/* add commands */
 	priv->cmd_array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_util_item_free);
 	cd_util_add (priv->cmd_array,
 		     "create-cmf",
-		     "[OUTPUT.cmf] [INPUT.csv] [norm]",
+		     "[OUTPUT.cmf|OUTDIR] [INPUT.csv|INDIR] [norm]",
 		     /* TRANSLATORS: command description */
 		     _("Create a CMF from CSV data"),
 		     cd_util_create_cmf);
 	cd_util_add (priv->cmd_array,
 		     "create-sp",
-		     "[OUTPUT.sp] [INPUT.csv] [norm]",
+		     "[OUTPUT.sp|OUTDIR] [INPUT.csv|INDIR] [norm]",
 		     /* TRANSLATORS: command description */
 		     _("Create a spectrum from CSV data"),
 		     cd_util_create_sp);
+	cd_util_add (priv->cmd_array,
+		     "create-ref",
+		     "[OUTPUT.ref] [INPUT.cmf|INPUT.sp]",
+		     /* TRANSLATORS: command description */
+		     _("Create precompiled reference data"),
+		     cd_util_create_ref);
 	cd_util_add (priv->cmd_array,
 		     "calculate-ccmx",
 		     "[REFERENCE.ti3] [MEASURED.ti3] [OUTPUT.ccmx]",
 		     /* TRANSLATORS: command description */
 		     _("Create a CCMX from reference and measurement data"),
 		     cd_util_calculate_ccmx);
+	cd_util_add (priv->cmd_array,
+		     "verify-profile",
+		     "[MEASURED.ti3] [PROFILE.icc]",
+		     /* TRANSLATORS: command description */
+		     _("Compare measured chart data with a profile"),
+		     cd_util_verify_profile);
 
 	/* sort by command name */
 	g_ptr_array_sort (priv->cmd_array,
@@ -532,6 +870,14 @@ main (int argc, char *argv[])
 				   cd_util_ignore_cb, NULL);
 	}
 
+	/* these are only known after parsing */
+	priv->timestamps = enable_timestamps;
+	priv->jobs = jobs > 0 ? (guint) jobs : g_get_num_processors ();
+	if (report && !cd_util_setup_report (priv, &error)) {
+		g_print ("%s\n", error->message);
+		goto out;
+	}
+
 	/* run the specified command */
 	ret = cd_util_run (priv, argv[1], (gchar**) &argv[2], &error);
 	if (!ret) {
@@ -553,6 +899,10 @@ out:
 		if (priv->cmd_array != NULL)
 			g_ptr_array_unref (priv->cmd_array);
 		g_option_context_free (priv->context);
+		if (priv->report_plan != NULL)
+			cd_it8_utils_plan_free (priv->report_plan);
+		if (priv->report_cri != NULL)
+			cd_it8_utils_cri_free (priv->report_cri);
 		g_free (priv);
 	}
 	return retval;
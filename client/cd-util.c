@@ -43,6 +43,9 @@ typedef struct {
 	GPtrArray		*cmd_array;
 	gboolean		 value_only;
 	gchar			**filters;
+	GPtrArray		*snapshot_devices;
+	GPtrArray		*snapshot_profiles;
+	GHashTable		*profile_cache;		/* object-path:CdProfile */
 } CdUtilPrivate;
 
 typedef gboolean (*CdUtilPrivateCb)	(CdUtilPrivate	*util,
@@ -243,13 +246,204 @@ cd_util_show_profile (CdUtilPrivate *priv, CdProfile *profile)
 		cd_util_print_field (_("Warning"), "warnings", priv, warnings[i]);
 }
 
+/* tiny helper to run many async requests against one main loop */
+typedef struct {
+	GMainLoop	*loop;
+	guint		 pending;
+	GError		*error;
+	GPtrArray	*devices;
+	GPtrArray	*profiles;
+} CdUtilAsyncHelper;
+
+static void
+cd_util_async_helper_done (CdUtilAsyncHelper *helper, GError *error)
+{
+	/* only keep the first failure */
+	if (error != NULL && helper->error == NULL)
+		helper->error = error;
+	else if (error != NULL)
+		g_error_free (error);
+	if (--helper->pending == 0)
+		g_main_loop_quit (helper->loop);
+}
+
+static void
+cd_util_connect_device_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdUtilAsyncHelper *helper = (CdUtilAsyncHelper *) user_data;
+	GError *error = NULL;
+	if (!cd_device_connect_finish (CD_DEVICE (source), res, &error))
+		g_prefix_error (&error, "%s: ", cd_device_get_object_path (CD_DEVICE (source)));
+	cd_util_async_helper_done (helper, error);
+}
+
+static void
+cd_util_connect_profile_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdUtilAsyncHelper *helper = (CdUtilAsyncHelper *) user_data;
+	GError *error = NULL;
+	if (!cd_profile_connect_finish (CD_PROFILE (source), res, &error))
+		g_prefix_error (&error, "%s: ", cd_profile_get_object_path (CD_PROFILE (source)));
+	cd_util_async_helper_done (helper, error);
+}
+
+static void
+cd_util_connect_sensor_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdUtilAsyncHelper *helper = (CdUtilAsyncHelper *) user_data;
+	GError *error = NULL;
+	if (!cd_sensor_connect_finish (CD_SENSOR (source), res, &error))
+		g_prefix_error (&error, "%s: ", cd_sensor_get_object_path (CD_SENSOR (source)));
+	cd_util_async_helper_done (helper, error);
+}
+
+static void
+cd_util_get_devices_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdUtilAsyncHelper *helper = (CdUtilAsyncHelper *) user_data;
+	GError *error = NULL;
+	helper->devices = cd_client_get_devices_finish (CD_CLIENT (source), res, &error);
+	cd_util_async_helper_done (helper, error);
+}
+
+static void
+cd_util_get_profiles_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdUtilAsyncHelper *helper = (CdUtilAsyncHelper *) user_data;
+	GError *error = NULL;
+	helper->profiles = cd_client_get_profiles_finish (CD_CLIENT (source), res, &error);
+	cd_util_async_helper_done (helper, error);
+}
+
+static gboolean
+cd_util_async_helper_run (CdUtilAsyncHelper *helper, GError **error)
+{
+	/* the latency is the slowest request, not the sum of them all */
+	if (helper->pending > 0)
+		g_main_loop_run (helper->loop);
+	g_main_loop_unref (helper->loop);
+	if (helper->error != NULL) {
+		g_propagate_error (error, helper->error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_util_connect_all (GPtrArray *devices,
+		     GPtrArray *profiles,
+		     GPtrArray *sensors,
+		     GError **error)
+{
+	CdUtilAsyncHelper helper = { NULL, 0, NULL, NULL, NULL };
+	guint i;
+
+	/* fire off every request before waiting for any of them */
+	helper.loop = g_main_loop_new (NULL, FALSE);
+	for (i = 0; devices != NULL && i < devices->len; i++) {
+		helper.pending++;
+		cd_device_connect (g_ptr_array_index (devices, i), NULL,
+				   cd_util_connect_device_cb, &helper);
+	}
+	for (i = 0; profiles != NULL && i < profiles->len; i++) {
+		helper.pending++;
+		cd_profile_connect (g_ptr_array_index (profiles, i), NULL,
+				    cd_util_connect_profile_cb, &helper);
+	}
+	for (i = 0; sensors != NULL && i < sensors->len; i++) {
+		helper.pending++;
+		cd_sensor_connect (g_ptr_array_index (sensors, i), NULL,
+				   cd_util_connect_sensor_cb, &helper);
+	}
+	return cd_util_async_helper_run (&helper, error);
+}
+
+static gboolean
+cd_util_get_all (CdUtilPrivate *priv,
+		 GPtrArray **devices,
+		 GPtrArray **profiles,
+		 GError **error)
+{
+	CdUtilAsyncHelper helper = { NULL, 2, NULL, NULL, NULL };
+
+	helper.loop = g_main_loop_new (NULL, FALSE);
+	cd_client_get_devices (priv->client, NULL, cd_util_get_devices_cb, &helper);
+	cd_client_get_profiles (priv->client, NULL, cd_util_get_profiles_cb, &helper);
+	if (!cd_util_async_helper_run (&helper, error)) {
+		if (helper.devices != NULL)
+			g_ptr_array_unref (helper.devices);
+		if (helper.profiles != NULL)
+			g_ptr_array_unref (helper.profiles);
+		return FALSE;
+	}
+	*devices = helper.devices;
+	*profiles = helper.profiles;
+	return TRUE;
+}
+
+static gboolean
+cd_util_load_snapshot (CdUtilPrivate *priv, GError **error)
+{
+	CdProfile *profile;
+	guint i;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) profiles = NULL;
+
+	/* already done */
+	if (priv->profile_cache != NULL)
+		return TRUE;
+
+	/* everything in one round trip */
+	if (!cd_client_get_snapshot_sync (priv->client, &devices, &profiles,
+					  NULL, &error_local)) {
+		g_debug ("failed to get snapshot, falling back: %s",
+			 error_local->message);
+
+		/* older daemons need each object connected, so do it concurrently */
+		if (!cd_util_get_all (priv, &devices, &profiles, error))
+			return FALSE;
+		if (!cd_util_connect_all (devices, profiles, NULL, error))
+			return FALSE;
+	}
+
+	/* the device profiles only have an object path, so share these */
+	priv->profile_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     NULL, g_object_unref);
+	for (i = 0; i < profiles->len; i++) {
+		profile = g_ptr_array_index (profiles, i);
+		g_hash_table_insert (priv->profile_cache,
+				     (gpointer) cd_profile_get_object_path (profile),
+				     g_object_ref (profile));
+	}
+	priv->snapshot_devices = g_steal_pointer (&devices);
+	priv->snapshot_profiles = g_steal_pointer (&profiles);
+	return TRUE;
+}
+
+static CdProfile *
+cd_util_get_connected_profile (CdUtilPrivate *priv, CdProfile *profile, GError **error)
+{
+	CdProfile *tmp;
+
+	/* use the snapshot if we have one */
+	if (priv->profile_cache != NULL) {
+		tmp = g_hash_table_lookup (priv->profile_cache,
+					   cd_profile_get_object_path (profile));
+		if (tmp != NULL)
+			return tmp;
+	}
+	if (!cd_profile_connect_sync (profile, NULL, error))
+		return NULL;
+	return profile;
+}
+
 static void
 cd_util_show_device (CdUtilPrivate *priv, CdDevice *device)
 {
 	CdObjectScope scope;
 	CdProfile *profile_tmp;
 	const gchar *tmp;
-	gboolean ret;
 	gchar *str_tmp;
 	GError *error = NULL;
 	GList *l;
@@ -348,14 +542,21 @@ cd_util_show_device (CdUtilPrivate *priv, CdDevice *device)
 			     "device-id", priv,
 			     cd_device_get_id (device));
 
-	/* print profiles */
+	/* connect any profiles not in the snapshot at the same time */
 	profiles = cd_device_get_profiles (device);
+	if (priv->profile_cache == NULL) {
+		if (!cd_util_connect_all (NULL, profiles, NULL, &error))
+			g_clear_error (&error);
+	}
+
+	/* print profiles, where any failures are shown below */
 	for (i = 0; i < profiles->len; i++) {
+		CdProfile *profile_connected;
 		profile_tmp = g_ptr_array_index (profiles, i);
 		/* TRANSLATORS: the profile for the device */
 		str_tmp = g_strdup_printf ("%s %u", _("Profile"), i+1);
-		ret = cd_profile_connect_sync (profile_tmp, NULL, &error);
-		if (!ret) {
+		profile_connected = cd_util_get_connected_profile (priv, profile_tmp, &error);
+		if (profile_connected == NULL) {
 			cd_util_print_field (str_tmp,
 					     "profiles", priv,
 					     cd_profile_get_object_path (profile_tmp));
@@ -366,10 +567,10 @@ cd_util_show_device (CdUtilPrivate *priv, CdDevice *device)
 		} else {
 			cd_util_print_field (str_tmp,
 					     "profiles", priv,
-					     cd_profile_get_id (profile_tmp));
+					     cd_profile_get_id (profile_connected));
 			cd_util_print_field (NULL,
 					     "profiles-filename", priv,
-					     cd_profile_get_filename (profile_tmp));
+					     cd_profile_get_filename (profile_connected));
 		}
 		g_free (str_tmp);
 	}
@@ -776,11 +977,10 @@ cd_util_dump (CdUtilPrivate *priv, gchar **values, GError **error)
 	gboolean ret = TRUE;
 	gchar *tmp;
 	GDateTime *dt;
-	GError *error_local = NULL;
+	GPtrArray *devices;
+	GPtrArray *profiles;
 	guint i;
 	g_autofree gchar *mapping_db = NULL;
-	g_autoptr(GPtrArray) devices = NULL;
-	g_autoptr(GPtrArray) profiles = NULL;
 	g_autoptr(GString) str = NULL;
 
 	/* header */
@@ -799,51 +999,30 @@ cd_util_dump (CdUtilPrivate *priv, gchar **values, GError **error)
 	g_string_append_printf (str, "system-model\t%s\n",
 				cd_client_get_system_model (priv->client));
 
-	/* get profiles */
-	profiles = cd_client_get_profiles_sync (priv->client, NULL, error);
-	if (profiles == NULL) {
-		ret = FALSE;
+	/* get devices and profiles */
+	ret = cd_util_load_snapshot (priv, error);
+	if (!ret)
 		goto out;
-	}
+	profiles = priv->snapshot_profiles;
 	g_string_append_printf (str, "no-profile\t%u\n", profiles->len);
 	for (i = 0; i < profiles->len; i++) {
 		profile = g_ptr_array_index (profiles, i);
-		ret = cd_profile_connect_sync (profile, NULL, &error_local);
-		if (!ret) {
-			g_string_append_printf (str, "profile-%02u\t%s\tERROR: %s\n",
-						(guint) i,
-						cd_profile_get_object_path (profile),
-						error_local->message);
-			g_clear_error (&error_local);
-		}
 		g_string_append_printf (str, "profile-%02u\t%s\t%s\n",
 					(guint) i,
 					cd_profile_get_id (profile),
 					cd_profile_get_filename (profile));
 	}
-
-	/* get devices */
-	devices = cd_client_get_devices_sync (priv->client, NULL, error);
-	if (devices == NULL) {
-		ret = FALSE;
-		goto out;
-	}
+	devices = priv->snapshot_devices;
 	g_string_append_printf (str, "no-devices\t%u\n", devices->len);
 	for (i = 0; i < devices->len; i++) {
 		device = g_ptr_array_index (devices, i);
-		ret = cd_device_connect_sync (device, NULL, &error_local);
-		if (!ret) {
-			g_string_append_printf (str, "device-%02u\t%s\tERROR: %s\n",
-						(guint) i,
-						cd_device_get_object_path (device),
-						error_local->message);
-			g_clear_error (&error_local);
-		}
 		profile = cd_device_get_default_profile (device);
 		if (profile != NULL) {
-			ret = cd_profile_connect_sync (profile, NULL, error);
-			if (!ret)
+			profile = cd_util_get_connected_profile (priv, profile, error);
+			if (profile == NULL) {
+				ret = FALSE;
 				goto out;
+			}
 		}
 		g_string_append_printf (str, "device-%02u\t%s\t%s\n",
 					(guint) i,
@@ -879,17 +1058,15 @@ static gboolean
 cd_util_get_devices (CdUtilPrivate *priv, gchar **values, GError **error)
 {
 	CdDevice *device;
+	GPtrArray *array;
 	guint i;
-	g_autoptr(GPtrArray) array = NULL;
 
-	/* execute sync method */
-	array = cd_client_get_devices_sync (priv->client, NULL, error);
-	if (array == NULL)
+	/* one round trip for the devices and all their profiles */
+	if (!cd_util_load_snapshot (priv, error))
 		return FALSE;
+	array = priv->snapshot_devices;
 	for (i = 0; i < array->len; i++) {
 		device = g_ptr_array_index (array, i);
-		if (!cd_device_connect_sync (device, NULL, error))
-			return FALSE;
 		cd_util_show_device (priv, device);
 		if (i != array->len - 1 && !priv->value_only)
 			g_print ("\n");
@@ -901,8 +1078,10 @@ static gboolean
 cd_util_get_devices_by_kind (CdUtilPrivate *priv, gchar **values, GError **error)
 {
 	CdDevice *device;
+	CdDeviceKind kind;
+	GPtrArray *array;
 	guint i;
-	g_autoptr(GPtrArray) array = NULL;
+	gboolean first = TRUE;
 
 	if (g_strv_length (values) < 1) {
 		g_set_error_literal (error,
@@ -914,20 +1093,19 @@ cd_util_get_devices_by_kind (CdUtilPrivate *priv, gchar **values, GError **error
 		return FALSE;
 	}
 
-	/* execute sync method */
-	array = cd_client_get_devices_by_kind_sync (priv->client,
-						    cd_device_kind_from_string (values[0]),
-						    NULL,
-						    error);
-	if (array == NULL)
+	/* filter the snapshot rather than connecting to each device */
+	if (!cd_util_load_snapshot (priv, error))
 		return FALSE;
+	kind = cd_device_kind_from_string (values[0]);
+	array = priv->snapshot_devices;
 	for (i = 0; i < array->len; i++) {
 		device = g_ptr_array_index (array, i);
-		if (!cd_device_connect_sync (device, NULL, error))
-			return FALSE;
-		cd_util_show_device (priv, device);
-		if (i != array->len - 1 && !priv->value_only)
+		if (cd_device_get_kind (device) != kind)
+			continue;
+		if (!first && !priv->value_only)
 			g_print ("\n");
+		cd_util_show_device (priv, device);
+		first = FALSE;
 	}
 	return TRUE;
 }
@@ -936,17 +1114,15 @@ static gboolean
 cd_util_get_profiles (CdUtilPrivate *priv, gchar **values, GError **error)
 {
 	CdProfile *profile;
+	GPtrArray *array;
 	guint i;
-	g_autoptr(GPtrArray) array = NULL;
 
-	/* execute sync method */
-	array = cd_client_get_profiles_sync (priv->client, NULL, error);
-	if (array == NULL)
+	/* one round trip for all the profiles */
+	if (!cd_util_load_snapshot (priv, error))
 		return FALSE;
+	array = priv->snapshot_profiles;
 	for (i = 0; i < array->len; i++) {
 		profile = g_ptr_array_index (array, i);
-		if (!cd_profile_connect_sync (profile, NULL, error))
-			return FALSE;
 		cd_util_show_profile (priv, profile);
 		if (i != array->len - 1 && !priv->value_only)
 			g_print ("\n");
@@ -971,10 +1147,10 @@ cd_util_get_sensors (CdUtilPrivate *priv, gchar **values, GError **error)
 				     _("There are no supported sensors attached"));
 		return FALSE;
 	}
+	if (!cd_util_connect_all (NULL, NULL, array, error))
+		return FALSE;
 	for (i = 0; i < array->len; i++) {
 		sensor = g_ptr_array_index (array, i);
-		if (!cd_sensor_connect_sync (sensor, NULL, error))
-			return FALSE;
 		cd_util_show_sensor (priv, sensor);
 		if (i != array->len - 1 && !priv->value_only)
 			g_print ("\n");
@@ -1138,6 +1314,162 @@ cd_util_get_sensor_reading (CdUtilPrivate *priv, gchar **values, GError **error)
 	return TRUE;
 }
 
+static gint
+cd_util_sort_double_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble da = *((const gdouble *) a);
+	gdouble db = *((const gdouble *) b);
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
+
+static gdouble
+cd_util_get_percentile (GArray *sorted, guint percentile)
+{
+	guint idx;
+
+	/* nearest rank */
+	if (sorted->len == 0)
+		return 0.f;
+	idx = (percentile * sorted->len + 99) / 100;
+	idx = CLAMP (idx, 1, sorted->len) - 1;
+	return g_array_index (sorted, gdouble, idx);
+}
+
+static gboolean
+cd_util_sensor_benchmark (CdUtilPrivate *priv, gchar **values, GError **error)
+{
+	CdSensor *sensor;
+	CdSensorCap cap;
+	gchar *endptr = NULL;
+	gdouble elapsed;
+	gdouble rate;
+	gint64 duration = 0;
+	gint64 start;
+	gint64 now;
+	guint n_errors = 0;
+	guint n_samples = 0;
+	guint n;
+	g_autoptr(GArray) latencies = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	if (g_strv_length (values) < 3) {
+		g_set_error_literal (error,
+				     CD_ERROR,
+				     CD_ERROR_INVALID_ARGUMENTS,
+				     "Not enough arguments, "
+				     "expected device type, rate in Hz and "
+				     "number of samples, e.g. 'lcd 10 100' "
+				     "or seconds, e.g. 'lcd 0 30s'");
+		return FALSE;
+	}
+	cap = cd_sensor_cap_from_string (values[0]);
+	rate = g_ascii_strtod (values[1], NULL);
+	n = (guint) g_ascii_strtoull (values[2], &endptr, 10);
+	if (endptr != NULL && *endptr == 's') {
+		duration = (gint64) n * G_USEC_PER_SEC;
+		n = 0;
+	}
+	if (n == 0 && duration == 0) {
+		g_set_error_literal (error,
+				     CD_ERROR,
+				     CD_ERROR_INVALID_ARGUMENTS,
+				     "No samples or duration specified");
+		return FALSE;
+	}
+
+	/* use the first sensor */
+	array = cd_client_get_sensors_sync (priv->client, NULL, error);
+	if (array == NULL)
+		return FALSE;
+	if (array->len == 0) {
+		/* TRANSLATORS: the user does not have a colorimeter attached */
+		g_set_error_literal (error, CD_ERROR, CD_ERROR_INVALID_ARGUMENTS,
+				     _("There are no supported sensors attached"));
+		return FALSE;
+	}
+	sensor = g_ptr_array_index (array, 0);
+	if (!cd_sensor_connect_sync (sensor, NULL, error))
+		return FALSE;
+
+	/* TRANSLATORS: this is the sensor title */
+	g_print ("%s: %s - %s\n", _("Sensor"),
+		 cd_sensor_get_vendor (sensor),
+		 cd_sensor_get_model (sensor));
+	if (!cd_sensor_lock_sync (sensor, NULL, error))
+		return FALSE;
+
+	/* take samples at a fixed schedule so slow readings do not drift */
+	latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	start = g_get_monotonic_time ();
+	for (;;) {
+		gdouble latency;
+		gint64 before;
+		g_autoptr(CdColorXYZ) xyz = NULL;
+		g_autoptr(GError) error_local = NULL;
+
+		now = g_get_monotonic_time ();
+		if (n > 0 && n_samples + n_errors >= n)
+			break;
+		if (duration > 0 && now - start >= duration)
+			break;
+		if (rate > 0.f) {
+			gint64 next = start + (gint64) ((n_samples + n_errors) *
+							G_USEC_PER_SEC / rate);
+			if (next > now)
+				g_usleep (next - now);
+		}
+
+		before = g_get_monotonic_time ();
+		xyz = cd_sensor_get_sample_sync (sensor, cap, NULL, &error_local);
+		latency = (g_get_monotonic_time () - before) / 1000.f;
+		if (xyz == NULL) {
+			/* the user has to do something, so stop here */
+			if (g_error_matches (error_local, CD_SENSOR_ERROR,
+					     CD_SENSOR_ERROR_REQUIRED_POSITION_CALIBRATE) ||
+			    g_error_matches (error_local, CD_SENSOR_ERROR,
+					     CD_SENSOR_ERROR_REQUIRED_POSITION_SURFACE) ||
+			    g_error_matches (error_local, CD_SENSOR_ERROR,
+					     CD_SENSOR_ERROR_REQUIRED_DARK_CALIBRATION) ||
+			    g_error_matches (error_local, CD_SENSOR_ERROR,
+					     CD_SENSOR_ERROR_REQUIRED_IRRADIANCE_CALIBRATION)) {
+				g_propagate_error (error, g_steal_pointer (&error_local));
+				if (!cd_sensor_unlock_sync (sensor, NULL, NULL))
+					g_warning ("failed to unlock sensor");
+				return FALSE;
+			}
+			g_debug ("failed to get sample: %s", error_local->message);
+			n_errors++;
+			continue;
+		}
+		g_array_append_val (latencies, latency);
+		n_samples++;
+	}
+	elapsed = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+
+	if (!cd_sensor_unlock_sync (sensor, NULL, error))
+		return FALSE;
+
+	/* print the results */
+	g_array_sort (latencies, cd_util_sort_double_cb);
+	g_print ("Samples\t%u\n", n_samples);
+	g_print ("Errors\t%u\n", n_errors);
+	g_print ("Elapsed\t%.3fs\n", elapsed);
+	g_print ("Rate\t%.2fHz\n", elapsed > 0.f ? n_samples / elapsed : 0.f);
+	if (latencies->len > 0) {
+		g_print ("Min\t%.2fms\n", g_array_index (latencies, gdouble, 0));
+		g_print ("P50\t%.2fms\n", cd_util_get_percentile (latencies, 50));
+		g_print ("P90\t%.2fms\n", cd_util_get_percentile (latencies, 90));
+		g_print ("P99\t%.2fms\n", cd_util_get_percentile (latencies, 99));
+		g_print ("Max\t%.2fms\n", g_array_index (latencies, gdouble,
+							 latencies->len - 1));
+	}
+	return TRUE;
+}
+
 static gboolean
 cd_util_get_spectral_reading (CdUtilPrivate *priv, gchar **values, GError **error)
 {
@@ -2076,6 +2408,12 @@ main (int argc, char *argv[])
 		     /* TRANSLATORS: command description */
 		     _("Gets a reading from a sensor"),
 		     cd_util_get_sensor_reading);
+	cd_util_add (priv->cmd_array,
+		     "sensor-benchmark",
+		     "[KIND] [RATE] [SAMPLES|SECONDSs]",
+		     /* TRANSLATORS: command description */
+		     _("Measures the sample rate and latency of a sensor"),
+		     cd_util_sensor_benchmark);
 	cd_util_add (priv->cmd_array,
 		     "sensor-lock",
 		     NULL,
@@ -2293,6 +2631,12 @@ out:
 		if (priv->cmd_array != NULL)
 			g_ptr_array_unref (priv->cmd_array);
 		g_strfreev (priv->filters);
+		if (priv->snapshot_devices != NULL)
+			g_ptr_array_unref (priv->snapshot_devices);
+		if (priv->snapshot_profiles != NULL)
+			g_ptr_array_unref (priv->snapshot_profiles);
+		if (priv->profile_cache != NULL)
+			g_hash_table_unref (priv->profile_cache);
 		g_option_context_free (priv->context);
 		g_free (priv);
 	}
@@ -34,7 +34,11 @@ typedef struct {
 	gchar		*argv0;
 	CdClient	*client;
 	GMainLoop	*loop;
-	GPtrArray	*array; /* of CdMainDev's */
+	GHashTable	*devices; /* id : CdMainDev */
+	GPtrArray	*sane_devices; /* of CdMainSaneDev */
+	guint		 pending;
+	gboolean	 synced;
+	gboolean	 failed;
 } CdMainPrivate;
 
 typedef struct {
@@ -43,6 +47,14 @@ typedef struct {
 	gboolean	 valid;
 } CdMainDev;
 
+/* a copy of the SANE_Device, as the list is owned by the worker */
+typedef struct {
+	gchar		*id;
+	gchar		*name;
+	gchar		*model;
+	gchar		*vendor;
+} CdMainSaneDev;
+
 static void
 cd_main_dev_free (CdMainDev *tmp)
 {
@@ -51,22 +63,21 @@ cd_main_dev_free (CdMainDev *tmp)
 	g_free (tmp);
 }
 
+static void
+cd_main_sane_dev_free (CdMainSaneDev *tmp)
+{
+	g_free (tmp->id);
+	g_free (tmp->name);
+	g_free (tmp->model);
+	g_free (tmp->vendor);
+	g_free (tmp);
+}
+
 static CdMainDev *
 cd_main_dev_find_by_id (CdMainPrivate *priv,
 			const gchar *id)
 {
-	CdMainDev *tmp;
-	guint i;
-
-	/* nothing to find */
-	if (priv->array->len == 0)
-		return NULL;
-	for (i = 0; i < priv->array->len; i++) {
-		tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (tmp->id, id) == 0)
-			return tmp;
-	}
-	return NULL;
+	return g_hash_table_lookup (priv->devices, id);
 }
 
 static gchar *
@@ -75,10 +86,24 @@ cd_client_get_id_for_sane_device (const SANE_Device *sane_device)
 	return g_strdup_printf ("sane-%s", sane_device->model);
 }
 
-typedef struct {
-	CdMainPrivate	*priv;
-	gchar		*id;
-} CdMainCreateDeviceHelper;
+/* every D-Bus request and the SANE worker hold a reference, and the
+ * changes are only worked out when all of those have completed */
+static void cd_sane_client_sync (CdMainPrivate *priv);
+
+static void
+cd_main_pending_done (CdMainPrivate *priv)
+{
+	g_assert (priv->pending > 0);
+	if (--priv->pending > 0)
+		return;
+	if (!priv->synced && !priv->failed) {
+		priv->synced = TRUE;
+		cd_sane_client_sync (priv);
+		if (priv->pending > 0)
+			return;
+	}
+	g_main_loop_quit (priv->loop);
+}
 
 static void
 cd_main_colord_create_device_cb (GObject *source_object,
@@ -86,6 +111,7 @@ cd_main_colord_create_device_cb (GObject *source_object,
 				 gpointer user_data)
 {
 	CdClient *client = CD_CLIENT (source_object);
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(CdDevice) device = NULL;
 
@@ -93,29 +119,19 @@ cd_main_colord_create_device_cb (GObject *source_object,
 	device = cd_client_create_device_finish (client, res, &error);
 	if (device == NULL)
 		g_warning ("failed to create device: %s", error->message);
+	cd_main_pending_done (priv);
 }
 
 static void
-cd_sane_client_add (CdMainPrivate *priv, const SANE_Device *sane_device)
+cd_sane_client_add (CdMainPrivate *priv, const CdMainSaneDev *sane_device)
 {
 	CdMainDev *dev;
-	g_autofree gchar *id = NULL;
 	g_autofree gchar *model = NULL;
 	g_autofree gchar *vendor = NULL;
 	g_autoptr(GHashTable) properties = NULL;
 
-	/* ignore noname, no support devices */
-	if (g_strcmp0 (sane_device->vendor, "Noname") == 0) {
-		g_debug ("CdSaneClient: Ignoring sane device %s",
-			 sane_device->name);
-		return;
-	}
-
-	/* convert device_id 'plustek:libusb:004:002' to suitable id */
-	id = cd_client_get_id_for_sane_device (sane_device);
-
 	/* see if this device already exists */
-	dev = cd_main_dev_find_by_id (priv, id);
+	dev = cd_main_dev_find_by_id (priv, sane_device->id);
 	if (dev != NULL) {
 		dev->valid = TRUE;
 		return;
@@ -153,13 +169,14 @@ cd_sane_client_add (CdMainPrivate *priv, const SANE_Device *sane_device)
 			     (gpointer) CD_DEVICE_METADATA_OWNER_CMDLINE,
 			     (gpointer) priv->argv0);
 #endif
+	priv->pending++;
 	cd_client_create_device (priv->client,
-				 id,
+				 sane_device->id,
 				 CD_OBJECT_SCOPE_NORMAL,
 				 properties,
 				 NULL,
 				 cd_main_colord_create_device_cb,
-				 NULL);
+				 priv);
 }
 
 static void
@@ -168,17 +185,20 @@ cd_main_colord_delete_device_cb (GObject *source_object,
 				 gpointer user_data)
 {
 	CdClient *client = CD_CLIENT (source_object);
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	g_autoptr(GError) error = NULL;
 
 	/* get result */
 	if (!cd_client_delete_device_finish (client, res, &error))
 		g_warning ("failed to delete device: %s", error->message);
+	cd_main_pending_done (priv);
 }
 
 static void
 cd_sane_client_remove (CdMainPrivate *priv, CdDevice *device)
 {
 	g_debug ("Deleting device: %s", cd_device_get_object_path (device));
+	priv->pending++;
 	cd_client_delete_device (priv->client,
 				 device,
 				 NULL,
@@ -186,65 +206,122 @@ cd_sane_client_remove (CdMainPrivate *priv, CdDevice *device)
 				 priv);
 }
 
+/* only sends the requests for devices that have changed, all at once */
 static void
-cd_sane_client_refresh (CdMainPrivate *priv)
+cd_sane_client_sync (CdMainPrivate *priv)
 {
 	CdMainDev *tmp;
+	GHashTableIter iter;
+	guint i;
+
+	/* add them */
+	for (i = 0; i < priv->sane_devices->len; i++)
+		cd_sane_client_add (priv, g_ptr_array_index (priv->sane_devices, i));
+
+	/* remove any that are invalid */
+	g_hash_table_iter_init (&iter, priv->devices);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tmp)) {
+		if (tmp->valid)
+			continue;
+		cd_sane_client_remove (priv, tmp->device);
+	}
+}
+
+/* SANE can take seconds to probe the buses, so this runs in a worker */
+static void
+cd_sane_client_refresh_thread_cb (GTask *task,
+				  gpointer source_object,
+				  gpointer task_data,
+				  GCancellable *cancellable)
+{
+	CdMainSaneDev *tmp;
 	const SANE_Device **device_list = NULL;
 	gint idx;
-	guint i;
 	SANE_Status status;
+	g_autoptr(GPtrArray) array = NULL;
 
 	status = sane_init (NULL, NULL);
 	if (status != SANE_STATUS_GOOD) {
-		g_warning ("failed to init SANE: %s",
-			   sane_strstatus (status));
-		goto out;
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+					 "failed to init SANE: %s",
+					 sane_strstatus (status));
+		return;
 	}
 
 	/* get scanners on the local server */
 	status = sane_get_devices (&device_list, TRUE);
 	if (status != SANE_STATUS_GOOD) {
-		g_warning ("failed to get devices from SANE: %s",
-			   sane_strstatus (status));
-		goto out;
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+					 "failed to get devices from SANE: %s",
+					 sane_strstatus (status));
+		return;
 	}
 
-	/* nothing */
-	if (device_list == NULL || device_list[0] == NULL)
-		goto out;
-
-	/* add them */
-	for (idx = 0; device_list[idx] != NULL; idx++)
-		cd_sane_client_add (priv, device_list[idx]);
+	/* copy them */
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_main_sane_dev_free);
+	for (idx = 0; device_list != NULL && device_list[idx] != NULL; idx++) {
 
-	/* remove any that are invalid */
-	for (i = 0; i < priv->array->len; i++) {
-		tmp = g_ptr_array_index (priv->array, i);
-		if (tmp->valid)
+		/* ignore noname, no support devices */
+		if (g_strcmp0 (device_list[idx]->vendor, "Noname") == 0) {
+			g_debug ("CdSaneClient: Ignoring sane device %s",
+				 device_list[idx]->name);
 			continue;
-		cd_sane_client_remove (priv, tmp->device);
+		}
+
+		/* convert device_id 'plustek:libusb:004:002' to suitable id */
+		tmp = g_new0 (CdMainSaneDev, 1);
+		tmp->id = cd_client_get_id_for_sane_device (device_list[idx]);
+		tmp->name = g_strdup (device_list[idx]->name);
+		tmp->model = g_strdup (device_list[idx]->model);
+		tmp->vendor = g_strdup (device_list[idx]->vendor);
+		g_ptr_array_add (array, tmp);
 	}
-out:
-	g_main_loop_quit (priv->loop);
+	g_task_return_pointer (task,
+			       g_steal_pointer (&array),
+			       (GDestroyNotify) g_ptr_array_unref);
 }
 
 static void
-cd_sane_add_device_if_from_colord_sane (gpointer data,
-				        gpointer user_data)
+cd_sane_client_refresh_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
 {
-	CdDevice *device = (CdDevice *) data;
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	g_autoptr(GError) error = NULL;
+
+	priv->sane_devices = g_task_propagate_pointer (G_TASK (res), &error);
+	if (priv->sane_devices == NULL) {
+		g_warning ("%s", error->message);
+		priv->failed = TRUE;
+	}
+	cd_main_pending_done (priv);
+}
+
+static void
+cd_sane_client_refresh (CdMainPrivate *priv)
+{
+	g_autoptr(GTask) task = NULL;
+
+	priv->pending++;
+	task = g_task_new (NULL, NULL, cd_sane_client_refresh_cb, priv);
+	g_task_run_in_thread (task, cd_sane_client_refresh_thread_cb);
+}
+
+static void
+cd_sane_device_connect_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	CdDevice *device = CD_DEVICE (source_object);
 	CdMainDev *sane_device;
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	const gchar *cmdline;
-	gboolean ret;
 	g_autoptr(GError) error = NULL;
 
-	ret = cd_device_connect_sync (device, NULL, &error);
-
-	if (!ret) {
+	if (!cd_device_connect_finish (device, res, &error)) {
 		g_warning ("failed to receive list of devices: %s",
 			   error->message);
+		cd_main_pending_done (priv);
 		return;
 	}
 
@@ -253,10 +330,11 @@ cd_sane_add_device_if_from_colord_sane (gpointer data,
 	if (g_strcmp0 (cmdline, priv->argv0) == 0) {
 		sane_device = g_new (CdMainDev, 1);
 		sane_device->device = g_object_ref (device);
-		sane_device->id = (gchar *)cd_device_get_id (device);
+		sane_device->id = g_strdup (cd_device_get_id (device));
 		sane_device->valid = FALSE;
-		g_ptr_array_add (priv->array, sane_device);
+		g_hash_table_insert (priv->devices, sane_device->id, sane_device);
 	}
+	cd_main_pending_done (priv);
 }
 
 static void
@@ -265,21 +343,27 @@ cd_sane_populate_existing_devices_cb (GObject *source_object,
 				      gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	GPtrArray *devices;
+	CdDevice *device;
+	guint i;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
 
 	devices = cd_client_get_devices_by_kind_finish (priv->client, res, &error);
-	if (error != NULL) {
+	if (devices == NULL) {
 		g_warning ("failed to receive list of devices: %s",
 			   error->message);
+		priv->failed = TRUE;
+		cd_main_pending_done (priv);
 		return;
 	}
 
-	g_ptr_array_foreach (devices,
-			     cd_sane_add_device_if_from_colord_sane,
-			     priv);
-
-	cd_sane_client_refresh (priv);
+	/* connect to all of them at the same time */
+	for (i = 0; i < devices->len; i++) {
+		device = g_ptr_array_index (devices, i);
+		priv->pending++;
+		cd_device_connect (device, NULL, cd_sane_device_connect_cb, priv);
+	}
+	cd_main_pending_done (priv);
 }
 
 static void
@@ -296,6 +380,8 @@ cd_main_colord_connect_cb (GObject *source_object,
 	if (!ret) {
 		g_warning ("failed to connect to colord: %s",
 			   error->message);
+		priv->failed = TRUE;
+		cd_main_pending_done (priv);
 		return;
 	}
 
@@ -320,9 +406,14 @@ main (int argc, char *argv[])
 	priv->loop = g_main_loop_new (NULL, FALSE);
 	priv->client = cd_client_new ();
 	priv->argv0 = g_strdup (argv[0]);
-	priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_main_dev_free);
+	priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       NULL, (GDestroyNotify) cd_main_dev_free);
+
+	/* probe SANE while finding out what colord already knows */
+	cd_sane_client_refresh (priv);
 
 	/* connect to daemon */
+	priv->pending++;
 	cd_client_connect (priv->client,
 			   NULL,
 			   cd_main_colord_connect_cb,
@@ -336,8 +427,10 @@ main (int argc, char *argv[])
 
 	if (priv != NULL) {
 		g_free (priv->argv0);
-		if (priv->array != NULL)
-			g_ptr_array_unref (priv->array);
+		if (priv->devices != NULL)
+			g_hash_table_unref (priv->devices);
+		if (priv->sane_devices != NULL)
+			g_ptr_array_unref (priv->sane_devices);
 		if (priv->client != NULL)
 			g_object_unref (priv->client);
 		g_main_loop_unref (priv->loop);
@@ -40,6 +40,7 @@ typedef struct {
 	GtkBuilder		*builder;
 	CdDevice		*device;
 	GDBusProxy		*proxy;
+	GPtrArray		*gamma;
 } CdExamplePrivate;
 
 static guint
@@ -245,6 +246,7 @@ cd_example_signal_cb (GDBusProxy *proxy,
 	GtkLabel *label;
 	GVariantIter *iter;
 	GVariant *dict = NULL;
+	guint idx;
 
 	if (g_strcmp0 (signal_name, "Finished") == 0) {
 
@@ -306,8 +308,32 @@ cd_example_signal_cb (GDBusProxy *proxy,
 			g_ptr_array_add (array, color_tmp);
 		}
 		g_variant_iter_free (iter);
+		if (priv->gamma != NULL)
+			g_ptr_array_unref (priv->gamma);
+		priv->gamma = array;
 		ret = cd_example_calib_set_output_gamma (priv,
-							 array,
+							 priv->gamma,
+							 &error);
+		if (!ret) {
+			g_warning ("failed to update gamma: %s",
+				   error->message);
+			goto out;
+		}
+		goto out;
+	}
+	if (g_strcmp0 (signal_name, "UpdateGammaPoint") == 0) {
+		g_variant_get (parameters, "(uddd)",
+			       &idx,
+			       &color.R,
+			       &color.G,
+			       &color.B);
+		if (priv->gamma == NULL || idx >= priv->gamma->len) {
+			g_warning ("got gamma point %u before the ramp", idx);
+			goto out;
+		}
+		cd_color_rgb_copy (&color, g_ptr_array_index (priv->gamma, idx));
+		ret = cd_example_calib_set_output_gamma (priv,
+							 priv->gamma,
 							 &error);
 		if (!ret) {
 			g_warning ("failed to update gamma: %s",
@@ -607,6 +633,10 @@ main (int argc, char **argv)
 			       "{sv}",
 			       "Gamma",
 			       g_variant_new_double (gamma));
+	g_variant_builder_add (&builder,
+			       "{sv}",
+			       "UpdateGammaPoint",
+			       g_variant_new_boolean (TRUE));
 	retvax = g_dbus_proxy_call_sync (priv->proxy,
 					 "Start",
 					 g_variant_new ("(ssa{sv})",
@@ -673,6 +703,8 @@ out:
 			g_object_unref (priv->device);
 		if (priv->proxy != NULL)
 			g_object_unref (priv->proxy);
+		if (priv->gamma != NULL)
+			g_ptr_array_unref (priv->gamma);
 		g_free (priv);
 	}
 	if (client != NULL)
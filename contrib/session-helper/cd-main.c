@@ -26,21 +26,38 @@
 #include <locale.h>
 #include <lcms2.h>
 #include <math.h>
+#include <string.h>
 
 #include <colord/colord.h>
 
+#include "cd-dbus-interfaces.h"
 #include "cd-debug.h"
 #include "cd-state.h"
 #include "cd-session.h"
 
 typedef struct {
-	/* global */
 	CdClient		*client;
-	CdSessionStatus		 status;
 	GDBusConnection		*connection;
-	GDBusNodeInfo		*introspection;
 	GMainLoop		*loop;
 	GSettings		*settings;
+	GPtrArray		*sessions;	/* of CdMainPrivate */
+	guint			 sessions_created;
+	gchar			*trace_filename;
+	gchar			*replay_filename;
+	gboolean		 simulate;
+} CdMainDaemon;
+
+typedef struct {
+	/* global */
+	CdMainDaemon		*daemon;
+	CdClient		*client;
+	CdSessionStatus		 status;
+	GDBusConnection		*connection;
+	gchar			*object_path;
+	guint			 registration_id;
+	GThread			*thread;
+	GError			*thread_error;
+	gboolean		 finished;
 	guint32			 progress;
 	guint			 sample_delay;
 	guint			 watcher_id;
@@ -58,6 +75,21 @@ typedef struct {
 	gdouble			 native_whitepoint;
 	gdouble			 target_gamma;
 	gdouble			 gamma_scale_factor;
+	CdMat3x3		 calib_jacobian;
+	CdColorRGB		 calib_jacobian_color;
+	gboolean		 calib_jacobian_valid;
+	gboolean		 drift_check;
+	gboolean		 gamma_point_updates;
+	GArray			*gamma_sent;	/* of CdColorRGB */
+	GOutputStream		*trace_out;
+	gchar			**trace_lines;
+	guint			 trace_idx;
+	GError			*trace_error;
+	GArray			*sim_gamma;	/* of CdColorRGB */
+	CdColorRGB		 sim_patch;
+	gboolean		 calib_drifted;
+	CdIt8			*it8_ti3_cached;
+	CdIt8			*it8_ccmx;
 	guint			 target_whitepoint;
 	guint			 screen_brightness;
 	CdIt8			*it8_cal;
@@ -75,9 +107,25 @@ typedef struct {
 	CdColorRGB		 best_so_far;
 	gdouble			 error;
 	gdouble			 index_factor; /* 0.0 for first point, 1.0 for last and linear in between */
+	gdouble			 error_cached; /* from the last calibration, or G_MAXDOUBLE */
+	gboolean		 verified;
 } CdMainCalibrateItem;
 
 #define CD_SESSION_ERROR			cd_main_error_quark()
+#define CD_MAIN_BATCH_MARGIN			50 /* ms */
+#define CD_MAIN_CALIB_SOLVE_SAMPLES_MAX		12
+#define CD_MAIN_CALIB_SOLVE_STEP_MAX		0.2
+#define CD_MAIN_CALIB_DRIFT_SUBSET		4 /* points */
+#define CD_MAIN_CALIB_DRIFT_TOLERANCE		0.5
+#define CD_MAIN_SETTLE_MIN			20 /* ms */
+#define CD_MAIN_SETTLE_TOLERANCE		0.01 /* of Y */
+#define CD_MAIN_SETTLE_VERIFY_INTERVAL		8 /* patches */
+#define CD_MAIN_SIMULATE_BLACK			0.002 /* of Y */
+
+/* the simulated display is a little too blue and each channel has a
+ * slightly different response, so the calibration has work to do */
+static const gdouble cd_main_simulate_gamma[] = { 2.3, 2.2, 2.1 };
+static const gdouble cd_main_simulate_gain[] = { 0.92, 0.97, 1.0 };
 
 static const gchar *
 cd_main_error_to_string (CdSessionError error_enum)
@@ -127,29 +175,228 @@ cd_main_calib_idle_delay_cb (gpointer user_data)
 	return G_SOURCE_REMOVE;
 }
 
+/* each session runs in its own thread with its own main context */
+static GSource *
+cd_main_timeout_add (guint ms, GSourceFunc func, gpointer user_data)
+{
+	GSource *source = g_timeout_source_new (ms);
+	g_source_set_callback (source, func, user_data, NULL);
+	g_source_attach (source, g_main_context_get_thread_default ());
+	return source;
+}
+
+/* no display or sensor to wait for when simulating or replaying */
+static gboolean
+cd_main_is_offline (CdMainPrivate *priv)
+{
+	return priv->daemon->simulate || priv->daemon->replay_filename != NULL;
+}
+
 static void
-cd_main_calib_idle_delay (guint ms)
+cd_main_calib_idle_delay (CdMainPrivate *priv, guint ms)
 {
 	GMainLoop *loop;
-	loop = g_main_loop_new (NULL, FALSE);
-	g_timeout_add (ms, cd_main_calib_idle_delay_cb, loop);
+	GSource *source;
+	if (cd_main_is_offline (priv))
+		return;
+	loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
+	source = cd_main_timeout_add (ms, cd_main_calib_idle_delay_cb, loop);
 	g_main_loop_run (loop);
 	g_main_loop_unref (loop);
+	g_source_unref (source);
+}
+
+static gchar *
+cd_main_trace_get_filename (CdMainPrivate *priv, const gchar *filename)
+{
+	/* sessions other than the default get a suffix */
+	if (g_strcmp0 (priv->object_path, CD_SESSION_DBUS_PATH) == 0)
+		return g_strdup (filename);
+	return g_strdup_printf ("%s.%s", filename,
+				strrchr (priv->object_path, '/') + 1);
 }
 
 static gboolean
-cd_main_emit_update_sample (CdMainPrivate *priv,
-			    CdColorRGB *color,
-			    GError **error)
+cd_main_trace_setup (CdMainPrivate *priv, GError **error)
 {
-	g_autoptr(GHashTable) hash = NULL;
+	CdMainDaemon *daemon = priv->daemon;
+
+	/* record */
+	if (daemon->trace_filename != NULL && priv->trace_out == NULL) {
+		g_autofree gchar *filename = NULL;
+		g_autoptr(GFile) file = NULL;
+		filename = cd_main_trace_get_filename (priv, daemon->trace_filename);
+		file = g_file_new_for_path (filename);
+		priv->trace_out = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE,
+								   G_FILE_CREATE_NONE,
+								   NULL, error));
+		if (priv->trace_out == NULL)
+			return FALSE;
+		g_debug ("recording trace to %s", filename);
+	}
+
+	/* replay */
+	if (daemon->replay_filename != NULL && priv->trace_lines == NULL) {
+		g_autofree gchar *data = NULL;
+		g_autofree gchar *filename = NULL;
+		filename = cd_main_trace_get_filename (priv, daemon->replay_filename);
+		if (!g_file_get_contents (filename, &data, NULL, error))
+			return FALSE;
+		priv->trace_lines = g_strsplit (data, "\n", -1);
+		g_debug ("replaying trace from %s", filename);
+	}
+	return TRUE;
+}
+
+/* records one event, and when replaying checks it matches the trace */
+static void
+cd_main_trace_event (CdMainPrivate *priv,
+		     const gchar *kind,
+		     const gdouble *values,
+		     guint values_len)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	guint i;
+	g_autoptr(GString) str = NULL;
+
+	if (priv->trace_out == NULL && priv->trace_lines == NULL)
+		return;
+
+	/* round trips exactly, so a replay makes the same decisions */
+	str = g_string_new (kind);
+	for (i = 0; i < values_len; i++) {
+		g_string_append_c (str, '\t');
+		g_string_append (str, g_ascii_dtostr (buf, sizeof (buf), values[i]));
+	}
+
+	/* measurements are returned by cd_main_trace_replay_sample() */
+	if (priv->trace_lines != NULL &&
+	    priv->trace_error == NULL &&
+	    g_strcmp0 (kind, "xyz") != 0) {
+		const gchar *line = priv->trace_lines[priv->trace_idx];
+		if (g_strcmp0 (line, str->str) != 0) {
+			g_set_error (&priv->trace_error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_INTERNAL,
+				     "replay diverged at line %u: expected '%s', got '%s'",
+				     priv->trace_idx + 1, line, str->str);
+		} else {
+			priv->trace_idx++;
+		}
+	}
+
+	if (priv->trace_out != NULL) {
+		g_autoptr(GError) error_local = NULL;
+		g_string_append_c (str, '\n');
+		if (!g_output_stream_write_all (priv->trace_out,
+						str->str, str->len,
+						NULL, NULL, &error_local)) {
+			g_warning ("failed to write trace: %s", error_local->message);
+			g_clear_object (&priv->trace_out);
+		}
+	}
+}
+
+static void
+cd_main_trace_xyz (CdMainPrivate *priv, const CdColorXYZ *xyz)
+{
+	const gdouble values[] = { xyz->X, xyz->Y, xyz->Z };
+	cd_main_trace_event (priv, "xyz", values, 3);
+}
+
+static gboolean
+cd_main_trace_replay_sample (CdMainPrivate *priv,
+			     CdColorXYZ *xyz,
+			     GError **error)
+{
+	const gchar *line = priv->trace_lines[priv->trace_idx];
+	g_auto(GStrv) split = NULL;
+
+	if (line == NULL || !g_str_has_prefix (line, "xyz\t")) {
+		g_set_error (error,
+			     CD_SESSION_ERROR,
+			     CD_SESSION_ERROR_INTERNAL,
+			     "replay diverged at line %u: expected '%s', got a measurement",
+			     priv->trace_idx + 1, line != NULL ? line : "EOF");
+		return FALSE;
+	}
+	split = g_strsplit (line, "\t", -1);
+	if (g_strv_length (split) != 4) {
+		g_set_error (error,
+			     CD_SESSION_ERROR,
+			     CD_SESSION_ERROR_INVALID_VALUE,
+			     "invalid trace line %u: '%s'",
+			     priv->trace_idx + 1, line);
+		return FALSE;
+	}
+	cd_color_xyz_set (xyz,
+			  g_ascii_strtod (split[1], NULL),
+			  g_ascii_strtod (split[2], NULL),
+			  g_ascii_strtod (split[3], NULL));
+	priv->trace_idx++;
+	return TRUE;
+}
+
+static gdouble
+cd_main_simulate_lookup (CdMainPrivate *priv, gdouble value, guint idx)
+{
+	CdColorRGB tmp;
+	CdColorRGB *p1;
+	CdColorRGB *p2;
+	gdouble mix;
+
+	/* linear until the first ramp is set */
+	value = CLAMP (value, 0.f, 1.f);
+	if (priv->sim_gamma == NULL || priv->sim_gamma->len < 2)
+		return value;
+	mix = value * (gdouble) (priv->sim_gamma->len - 1);
+	p1 = &g_array_index (priv->sim_gamma, CdColorRGB, (guint) floor (mix));
+	p2 = &g_array_index (priv->sim_gamma, CdColorRGB, (guint) ceil (mix));
+	cd_color_rgb_interpolate (p1, p2, mix - floor (mix), &tmp);
+	if (idx == 0)
+		return tmp.R;
+	if (idx == 1)
+		return tmp.G;
+	return tmp.B;
+}
+
+static void
+cd_main_simulate_sample (CdMainPrivate *priv, CdColorXYZ *xyz)
+{
+	gdouble lin[3];
+	gdouble patch[3];
+	guint k;
+
+	patch[0] = cd_main_simulate_lookup (priv, priv->sim_patch.R, 0);
+	patch[1] = cd_main_simulate_lookup (priv, priv->sim_patch.G, 1);
+	patch[2] = cd_main_simulate_lookup (priv, priv->sim_patch.B, 2);
+	for (k = 0; k < 3; k++) {
+		lin[k] = cd_main_simulate_gain[k] *
+			 pow (CLAMP (patch[k], 0.f, 1.f), cd_main_simulate_gamma[k]) +
+			 CD_MAIN_SIMULATE_BLACK;
+	}
+
+	/* sRGB primaries */
+	cd_color_xyz_set (xyz,
+			  0.4124 * lin[0] + 0.3576 * lin[1] + 0.1805 * lin[2],
+			  0.2126 * lin[0] + 0.7152 * lin[1] + 0.0722 * lin[2],
+			  0.0193 * lin[0] + 0.1192 * lin[1] + 0.9505 * lin[2]);
+}
+
+static void
+cd_main_emit_update_sample_signal (CdMainPrivate *priv, CdColorRGB *color)
+{
+	const gdouble values[] = { color->R, color->G, color->B };
+
+	cd_main_trace_event (priv, "sample", values, 3);
+	cd_color_rgb_copy (color, &priv->sim_patch);
 
 	/* emit signal */
 	g_debug ("CdMain: Emitting UpdateSample(%f,%f,%f)",
 		 color->R, color->G, color->B);
 	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       CD_SESSION_DBUS_PATH,
+				       priv->object_path,
 				       CD_SESSION_DBUS_INTERFACE_DISPLAY,
 				       "UpdateSample",
 				       g_variant_new ("(ddd)",
@@ -157,29 +404,48 @@ cd_main_emit_update_sample (CdMainPrivate *priv,
 						      color->G,
 						      color->B),
 				       NULL);
+}
 
-	/* if this is the dummy sensor then set the sample RGB value */
-	if (cd_sensor_get_kind (priv->sensor) == CD_SENSOR_KIND_DUMMY) {
-		hash = g_hash_table_new_full (g_str_hash,
-					      g_str_equal,
-					      g_free,
-					      (GDestroyNotify) g_variant_unref);
-		g_hash_table_insert (hash,
-				     g_strdup ("sample[red]"),
-				     g_variant_take_ref (g_variant_new_double (color->R)));
-		g_hash_table_insert (hash,
-				     g_strdup ("sample[green]"),
-				     g_variant_take_ref (g_variant_new_double (color->G)));
-		g_hash_table_insert (hash,
-				     g_strdup ("sample[blue]"),
-				     g_variant_take_ref (g_variant_new_double (color->B)));
-		if (!cd_sensor_set_options_sync (priv->sensor,
-						 hash,
-						 priv->cancellable,
-						 error))
-			return FALSE;
-	}
-	cd_main_calib_idle_delay (priv->sample_delay);
+/* if this is the dummy sensor then set the sample RGB value */
+static gboolean
+cd_main_set_dummy_sample (CdMainPrivate *priv,
+			  CdColorRGB *color,
+			  GError **error)
+{
+	g_autoptr(GHashTable) hash = NULL;
+
+	if (cd_main_is_offline (priv))
+		return TRUE;
+	if (cd_sensor_get_kind (priv->sensor) != CD_SENSOR_KIND_DUMMY)
+		return TRUE;
+	hash = g_hash_table_new_full (g_str_hash,
+				      g_str_equal,
+				      g_free,
+				      (GDestroyNotify) g_variant_unref);
+	g_hash_table_insert (hash,
+			     g_strdup ("sample[red]"),
+			     g_variant_take_ref (g_variant_new_double (color->R)));
+	g_hash_table_insert (hash,
+			     g_strdup ("sample[green]"),
+			     g_variant_take_ref (g_variant_new_double (color->G)));
+	g_hash_table_insert (hash,
+			     g_strdup ("sample[blue]"),
+			     g_variant_take_ref (g_variant_new_double (color->B)));
+	return cd_sensor_set_options_sync (priv->sensor,
+					   hash,
+					   priv->cancellable,
+					   error);
+}
+
+static gboolean
+cd_main_emit_update_sample (CdMainPrivate *priv,
+			    CdColorRGB *color,
+			    GError **error)
+{
+	cd_main_emit_update_sample_signal (priv, color);
+	if (!cd_main_set_dummy_sample (priv, color, error))
+		return FALSE;
+	cd_main_calib_idle_delay (priv, priv->sample_delay);
 	return TRUE;
 }
 
@@ -237,7 +503,7 @@ cd_main_emit_interaction_required (CdMainPrivate *priv,
 		 code, message, image);
 	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       CD_SESSION_DBUS_PATH,
+				       priv->object_path,
 				       CD_SESSION_DBUS_INTERFACE_DISPLAY,
 				       "InteractionRequired",
 				       g_variant_new ("(uss)",
@@ -253,7 +519,68 @@ cd_main_emit_update_gamma (CdMainPrivate *priv,
 {
 	GVariantBuilder builder;
 	guint i;
+	guint changed = 0;
+	guint changed_idx = 0;
 	CdColorRGB *color;
+	CdColorRGB *color_sent;
+	g_autofree gdouble *values = NULL;
+
+	/* record the whole ramp, whatever is sent to the client */
+	values = g_new (gdouble, array->len * 3);
+	for (i = 0; i < array->len; i++) {
+		color = g_ptr_array_index (array, i);
+		values[i * 3 + 0] = color->R;
+		values[i * 3 + 1] = color->G;
+		values[i * 3 + 2] = color->B;
+	}
+	cd_main_trace_event (priv, "gamma", values, array->len * 3);
+	if (cd_main_is_offline (priv)) {
+		if (priv->sim_gamma == NULL)
+			priv->sim_gamma = g_array_new (FALSE, FALSE, sizeof (CdColorRGB));
+		g_array_set_size (priv->sim_gamma, array->len);
+		memcpy (priv->sim_gamma->data, values, array->len * sizeof (CdColorRGB));
+	}
+
+	/* the client already has the ramp, so only send what moved */
+	if (priv->gamma_point_updates &&
+	    priv->gamma_sent != NULL &&
+	    priv->gamma_sent->len == array->len) {
+		for (i = 0; i < array->len; i++) {
+			color = g_ptr_array_index (array, i);
+			color_sent = &g_array_index (priv->gamma_sent, CdColorRGB, i);
+			if (color->R != color_sent->R ||
+			    color->G != color_sent->G ||
+			    color->B != color_sent->B) {
+				changed_idx = i;
+				changed++;
+			}
+		}
+		if (changed == 0) {
+			g_debug ("CdMain: gamma unchanged, not emitting");
+			return;
+		}
+		if (changed == 1) {
+			color = g_ptr_array_index (array, changed_idx);
+			g_debug ("CdMain: Emitting UpdateGammaPoint(%u)",
+				 changed_idx);
+			g_dbus_connection_emit_signal (priv->connection,
+						       NULL,
+						       priv->object_path,
+						       CD_SESSION_DBUS_INTERFACE_DISPLAY,
+						       "UpdateGammaPoint",
+						       g_variant_new ("(uddd)",
+								      changed_idx,
+								      color->R,
+								      color->G,
+								      color->B),
+						       NULL);
+			cd_color_rgb_copy (color, &g_array_index (priv->gamma_sent,
+								  CdColorRGB,
+								  changed_idx));
+			cd_main_calib_idle_delay (priv, 200);
+			return;
+		}
+	}
 
 	/* emit signal */
 	g_debug ("CdMain: Emitting UpdateGamma(%u elements)",
@@ -271,13 +598,25 @@ cd_main_emit_update_gamma (CdMainPrivate *priv,
 	}
 	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       CD_SESSION_DBUS_PATH,
+				       priv->object_path,
 				       CD_SESSION_DBUS_INTERFACE_DISPLAY,
 				       "UpdateGamma",
 				       g_variant_new ("(a(ddd))",
 						      &builder),
 				       NULL);
-	cd_main_calib_idle_delay (200);
+
+	/* remember what the client has */
+	if (priv->gamma_point_updates) {
+		if (priv->gamma_sent == NULL)
+			priv->gamma_sent = g_array_new (FALSE, FALSE, sizeof (CdColorRGB));
+		g_array_set_size (priv->gamma_sent, array->len);
+		for (i = 0; i < array->len; i++) {
+			color = g_ptr_array_index (array, i);
+			cd_color_rgb_copy (color, &g_array_index (priv->gamma_sent,
+								  CdColorRGB, i));
+		}
+	}
+	cd_main_calib_idle_delay (priv, 200);
 }
 
 static void
@@ -311,7 +650,7 @@ cd_main_emit_finished (CdMainPrivate *priv,
 
 	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       CD_SESSION_DBUS_PATH,
+				       priv->object_path,
 				       CD_SESSION_DBUS_INTERFACE_DISPLAY,
 				       "Finished",
 				       g_variant_new ("(ua{sv})",
@@ -327,13 +666,33 @@ cd_main_calib_get_sample (CdMainPrivate *priv,
 {
 	g_autoptr(CdColorXYZ) xyz_tmp = NULL;
 
-	xyz_tmp = cd_sensor_get_sample_sync (priv->sensor,
-					     priv->device_kind,
-					     priv->cancellable,
-					     error);
-	if (xyz_tmp == NULL)
+	/* an earlier update did not match what was recorded */
+	if (priv->trace_error != NULL) {
+		g_propagate_error (error, g_error_copy (priv->trace_error));
 		return FALSE;
-	cd_color_xyz_copy (xyz_tmp, xyz);
+	}
+
+	if (priv->trace_lines != NULL) {
+		if (!cd_main_trace_replay_sample (priv, xyz, error))
+			return FALSE;
+	} else if (priv->daemon->simulate) {
+		cd_main_simulate_sample (priv, xyz);
+	} else {
+		xyz_tmp = cd_sensor_get_sample_sync (priv->sensor,
+						     priv->device_kind,
+						     priv->cancellable,
+						     error);
+		if (xyz_tmp == NULL)
+			return FALSE;
+		if (priv->it8_ccmx != NULL) {
+			cd_mat33_vector_multiply (cd_it8_get_matrix (priv->it8_ccmx),
+						  (const CdVec3 *) xyz_tmp,
+						  (CdVec3 *) xyz);
+		} else {
+			cd_color_xyz_copy (xyz_tmp, xyz);
+		}
+	}
+	cd_main_trace_xyz (priv, xyz);
 	return TRUE;
 }
 
@@ -369,8 +728,10 @@ static gboolean
 cd_main_calib_try_item (CdMainPrivate *priv,
 		        CdMainCalibrateItem *item,
 		        gboolean *new_best,
+		        CdVec3 *residual,
 		        GError **error)
 {
+	CdColorLab neutral;
 	CdColorXYZ xyz;
 	cmsCIELab lab;
 	gdouble error_tmp;
@@ -393,14 +754,21 @@ cd_main_calib_try_item (CdMainPrivate *priv,
 	g_debug ("Absolute luminance at this point should be %f but is %f",
 		 lumi_target, lumi_measured);
 
-	/* get sum or squares difference of a,b */
-	error_tmp = sqrt (lab.a * lab.a + lab.b * lab.b);
+	/* get the distance from the gray axis at the same lightness */
+	cd_color_lab_set (&neutral, lab.L, 0.f, 0.f);
+	error_tmp = cd_color_lab_delta_e76 (&neutral, (const CdColorLab *) &lab);
 	g_debug ("Lab: %f\t%f\t%f error %f", lab.L, lab.a, lab.b, error_tmp);
 
 	/* add in gamma error */
 	error_tmp += priv->gamma_scale_factor * ABS (lumi_target - lumi_measured);
 	g_debug ("Total error %f", error_tmp);
 
+	/* the same terms, but signed so the solver knows which way to go */
+	if (residual != NULL) {
+		cd_vec3_init (residual, lab.a, lab.b,
+			      priv->gamma_scale_factor * (lumi_measured - lumi_target));
+	}
+
 	/* is it better than we ever got before */
 	if (error_tmp < item->error) {
 		cd_color_rgb_copy (&item->color, &item->best_so_far);
@@ -411,56 +779,36 @@ cd_main_calib_try_item (CdMainPrivate *priv,
 	return TRUE;
 }
 
+static gdouble
+cd_main_calib_get_good_enough_interval (CdMainPrivate *priv)
+{
+	/* use a different smallest interval for each quality */
+	if (priv->quality == CD_PROFILE_QUALITY_LOW)
+		return 0.009;
+	if (priv->quality == CD_PROFILE_QUALITY_MEDIUM)
+		return 0.006;
+	if (priv->quality == CD_PROFILE_QUALITY_HIGH)
+		return 0.003;
+	return 0.0f;
+}
+
 static gboolean
-cd_main_calib_process_item (CdMainPrivate *priv,
-			    CdMainCalibrateItem *item,
-			    CdState *state,
-			    GError **error)
+cd_main_calib_search_item (CdMainPrivate *priv,
+			   CdMainCalibrateItem *item,
+			   CdState *state,
+			   GError **error)
 {
-	CdState *state_local;
 	gboolean new_best = FALSE;
-	gboolean ret = TRUE;
-	gdouble good_enough_interval = 0.0f;
+	gdouble good_enough_interval = cd_main_calib_get_good_enough_interval (priv);
 	gdouble interval = 0.05;
 	gdouble tmp;
 	guint i;
 	guint number_steps = 0;
 
-	/* reset the state */
-	ret = cd_state_set_steps (state,
-				  error,
-				  3,	/* get baseline sample */
-				  97,	/* get other samples */
-				  -1);
-	if (!ret)
-		return FALSE;
-
-	/* copy the current color balance as the best */
-	cd_color_rgb_copy (&item->color, &item->best_so_far);
-
-	/* get a baseline error */
-	ret = cd_main_calib_try_item (priv, item, NULL, error);
-	if (!ret)
-		return FALSE;
-
-	/* done */
-	if (!cd_state_done (state, error))
-		return FALSE;
-
-	/* use a different smallest interval for each quality */
-	if (priv->quality == CD_PROFILE_QUALITY_LOW) {
-		good_enough_interval = 0.009;
-	} else if (priv->quality == CD_PROFILE_QUALITY_MEDIUM) {
-		good_enough_interval = 0.006;
-	} else if (priv->quality == CD_PROFILE_QUALITY_HIGH) {
-		good_enough_interval = 0.003;
-	}
-
 	/* do the progress the best we can */
-	state_local = cd_state_get_child (state);
 	for (tmp = interval; tmp > good_enough_interval; tmp /= 2)
 		number_steps++;
-	cd_state_set_number_steps (state_local, number_steps);
+	cd_state_set_number_steps (state, number_steps);
 	for (i = 0; i < 500; i++) {
 
 		/* check if cancelled */
@@ -471,7 +819,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		cd_color_rgb_copy (&item->best_so_far, &item->color);
 		if (item->best_so_far.B > interval) {
 			item->color.B = item->best_so_far.B - interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: blue down by %f", interval);
@@ -481,7 +829,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		}
 		if (item->best_so_far.B < 1.0 - interval) {
 			item->color.B = item->best_so_far.B + interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: blue up by %f", interval);
@@ -494,7 +842,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		cd_color_rgb_copy (&item->best_so_far, &item->color);
 		if (item->best_so_far.R > interval) {
 			item->color.R = item->best_so_far.R - interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: red down by %f", interval);
@@ -504,7 +852,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		}
 		if (item->best_so_far.R < 1.0 - interval) {
 			item->color.R = item->best_so_far.R + interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: red up by %f", interval);
@@ -517,7 +865,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		cd_color_rgb_copy (&item->best_so_far, &item->color);
 		if (item->best_so_far.G > interval) {
 			item->color.G = item->best_so_far.G - interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: green down by %f", interval);
@@ -527,7 +875,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		}
 		if (item->best_so_far.G < 1.0 - interval) {
 			item->color.G = item->best_so_far.G + interval;
-			if (!cd_main_calib_try_item (priv, item, &new_best, error))
+			if (!cd_main_calib_try_item (priv, item, &new_best, NULL, error))
 				return FALSE;
 			if (new_best) {
 				g_debug ("New best: green up by %f", interval);
@@ -537,7 +885,7 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		}
 
 		/* done */
-		if (!cd_state_done (state_local, error))
+		if (!cd_state_done (state, error))
 			return FALSE;
 
 		/* done */
@@ -551,92 +899,730 @@ cd_main_calib_process_item (CdMainPrivate *priv,
 		}
 	}
 
-	/* save this */
-	cd_color_rgb_copy (&item->best_so_far,
-			   &item->color);
+	return TRUE;
+}
 
-	/* done */
-	return cd_state_done (state, error);
+static gdouble
+cd_main_calib_rgb_get_component (const CdColorRGB *rgb, guint idx)
+{
+	if (idx == 0)
+		return rgb->R;
+	if (idx == 1)
+		return rgb->G;
+	return rgb->B;
+}
+
+static void
+cd_main_calib_rgb_set_component (CdColorRGB *rgb, guint idx, gdouble value)
+{
+	if (idx == 0)
+		rgb->R = value;
+	else if (idx == 1)
+		rgb->G = value;
+	else
+		rgb->B = value;
 }
 
+/* solves the damped least squares step (JᵀJ + λI)·dx = -Jᵀ·r */
 static gboolean
-cd_main_calib_interpolate_up (CdMainPrivate *priv,
-			      guint new_size,
-			      GError **error)
+cd_main_calib_model_get_step (const CdMat3x3 *jacobian,
+			      const CdVec3 *residual,
+			      CdVec3 *step)
 {
-	CdMainCalibrateItem *p1;
-	CdMainCalibrateItem *p2;
-	CdMainCalibrateItem *result;
-	gboolean ret = TRUE;
-	gdouble mix;
-	guint i;
-	g_autoptr(GPtrArray) old_array = NULL;
+	CdMat3x3 jtj;
+	CdMat3x3 jtj_inv;
+	CdVec3 jtr;
+	const gdouble *j = cd_mat33_get_data (jacobian);
+	const gdouble *r = cd_vec3_get_data (residual);
+	gdouble *a = cd_mat33_get_data (&jtj);
+	gdouble *g = cd_vec3_get_data (&jtr);
+	gdouble lambda;
+	guint col;
+	guint k;
+	guint row;
+
+	for (row = 0; row < 3; row++) {
+		g[row] = 0.f;
+		for (k = 0; k < 3; k++)
+			g[row] += j[k * 3 + row] * r[k];
+		for (col = 0; col < 3; col++) {
+			a[row * 3 + col] = 0.f;
+			for (k = 0; k < 3; k++)
+				a[row * 3 + col] += j[k * 3 + row] * j[k * 3 + col];
+		}
+	}
 
-	/* make a deep copy */
-	old_array = g_ptr_array_new_with_free_func (g_free);
-	for (i = 0; i < priv->array->len; i++) {
-		p1 = g_ptr_array_index (priv->array, i);
-		result = g_new (CdMainCalibrateItem, 1);
-		result->error = p1->error;
-		cd_color_rgb_copy (&p1->color, &result->color);
-		g_ptr_array_add (old_array, result);
+	/* keep the step sane when one channel hardly changes anything */
+	lambda = 1e-3 * (a[0] + a[4] + a[8]) / 3.f;
+	a[0] += lambda;
+	a[4] += lambda;
+	a[8] += lambda;
+	if (!cd_mat33_reciprocal (&jtj, &jtj_inv))
+		return FALSE;
+	cd_mat33_vector_multiply (&jtj_inv, &jtr, step);
+	cd_vec3_scalar_multiply (step, -1.f, step);
+	return TRUE;
+}
+
+/* Broyden's rank-one update: J += ((dr - J·dx)·dxᵀ) / (dxᵀ·dx) */
+static void
+cd_main_calib_model_update (CdMat3x3 *jacobian,
+			    const CdVec3 *dx,
+			    const CdVec3 *dr)
+{
+	CdVec3 predicted;
+	gdouble *j = cd_mat33_get_data (jacobian);
+	const gdouble *x = cd_vec3_get_data (dx);
+	const gdouble *p = cd_vec3_get_data (&predicted);
+	const gdouble *r = cd_vec3_get_data (dr);
+	gdouble norm = x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+	guint col;
+	guint row;
+
+	if (norm < 1e-12)
+		return;
+	cd_mat33_vector_multiply (jacobian, dx, &predicted);
+	for (row = 0; row < 3; row++) {
+		for (col = 0; col < 3; col++)
+			j[row * 3 + col] += (r[row] - p[row]) * x[col] / norm;
 	}
+}
 
-	/* interpolate the new array */
-	g_ptr_array_set_size (priv->array, 0);
-	for (i = 0; i < new_size; i++) {
-		mix = (gdouble) (old_array->len - 1) /
-			(gdouble) (new_size - 1) *
-			(gdouble) i;
-		p1 = g_ptr_array_index (old_array, (guint) floor (mix));
-		p2 = g_ptr_array_index (old_array, (guint) ceil (mix));
-		result = g_new (CdMainCalibrateItem, 1);
-		result->error = G_MAXDOUBLE;
-		result->index_factor = (gdouble) i / (gdouble) (new_size - 1);
-		cd_color_rgb_set (&result->color, 1.0, 1.0, 1.0);
-		cd_color_rgb_interpolate (&p1->color,
-					  &p2->color,
-					  mix - (gint) mix,
-					  &result->color);
-		g_ptr_array_add (priv->array, result);
+/* each channel follows roughly x^gamma, so the slope scales with x^(gamma-1) */
+static void
+cd_main_calib_model_rescale (CdMainPrivate *priv, const CdColorRGB *color)
+{
+	gdouble *j = cd_mat33_get_data (&priv->calib_jacobian);
+	gdouble scale;
+	gdouble value_new;
+	gdouble value_old;
+	guint col;
+	guint row;
+
+	for (col = 0; col < 3; col++) {
+		value_old = cd_main_calib_rgb_get_component (&priv->calib_jacobian_color, col);
+		value_new = cd_main_calib_rgb_get_component (color, col);
+		if (value_old < 0.01 || value_new < 0.01)
+			continue;
+		scale = pow (value_new / value_old, priv->target_gamma - 1.f);
+		for (row = 0; row < 3; row++)
+			j[row * 3 + col] *= scale;
 	}
-	return ret;
+	cd_color_rgb_copy (color, &priv->calib_jacobian_color);
 }
 
 static gboolean
-cd_main_calib_process (CdMainPrivate *priv,
-		       CdState *state,
-		       GError **error)
+cd_main_calib_model_estimate (CdMainPrivate *priv,
+			      CdMainCalibrateItem *item,
+			      const CdColorRGB *color,
+			      const CdVec3 *residual,
+			      CdVec3 *residual_best,
+			      guint *samples,
+			      GError **error)
 {
-	CdColorRGB rgb;
-	CdColorRGB *rgb_tmp;
-	CdMainCalibrateItem *item;
-	CdState *state_local;
-	CdState *state_loop;
-	cmsCIExyY whitepoint_tmp;
-	gboolean ret;
-	gdouble temp;
-	guint i;
-	guint precision_steps = 0;
-	g_autoptr(GString) error_str = NULL;
-	g_autoptr(GPtrArray) gamma_data = NULL;
-	g_autoptr(GPtrArray) vcgt_smoothed = NULL;
-
-	/* reset the state */
-	ret = cd_state_set_steps (state,
-				  error,
-				  1,	/* get native whitepoint */
-				  3,	/* normalize white */
-				  94,	/* refine other points */
-				  1,	/* get new whitepoint */
-				  1,	/* write calibrate point */
-				  -1);
-	if (!ret)
-		return FALSE;
+	CdVec3 residual_tmp;
+	const gdouble *r0 = cd_vec3_get_data (residual);
+	const gdouble *r1 = cd_vec3_get_data (&residual_tmp);
+	gdouble *j = cd_mat33_get_data (&priv->calib_jacobian);
+	gdouble delta = 0.05;
+	gdouble step;
+	gdouble value;
+	guint col;
+	guint row;
+
+	/* one finite difference per channel, away from the clipped end */
+	for (col = 0; col < 3; col++) {
+		gboolean new_best = FALSE;
+		value = cd_main_calib_rgb_get_component (color, col);
+		step = value > delta ? -delta : delta;
+
+		cd_color_rgb_copy (color, &item->color);
+		cd_main_calib_rgb_set_component (&item->color, col, value + step);
+		if (!cd_main_calib_try_item (priv, item, &new_best, &residual_tmp, error))
+			return FALSE;
+		if (new_best)
+			cd_vec3_copy (&residual_tmp, residual_best);
+		for (row = 0; row < 3; row++)
+			j[row * 3 + col] = (r1[row] - r0[row]) / step;
+		(*samples)++;
+	}
+	cd_color_rgb_copy (color, &priv->calib_jacobian_color);
+	priv->calib_jacobian_valid = TRUE;
+	return TRUE;
+}
 
-	/* clear gamma ramp to linear */
-	priv->array = g_ptr_array_new_with_free_func (g_free);
-	item = g_new0 (CdMainCalibrateItem, 1);
+static gboolean
+cd_main_calib_solve_item (CdMainPrivate *priv,
+			  CdMainCalibrateItem *item,
+			  const CdVec3 *residual_baseline,
+			  CdState *state,
+			  gboolean *converged,
+			  GError **error)
+{
+	CdColorRGB color;
+	CdVec3 residual;
+	gdouble good_enough_interval = cd_main_calib_get_good_enough_interval (priv);
+	gdouble trust = 0.05;
+	guint k;
+	guint samples = 0;
+
+	*converged = FALSE;
+	cd_state_set_number_steps (state, CD_MAIN_CALIB_SOLVE_SAMPLES_MAX);
+	cd_color_rgb_copy (&item->best_so_far, &color);
+	cd_vec3_copy (residual_baseline, &residual);
+
+	/* the first point needs a real model, later ones reuse the last */
+	if (priv->calib_jacobian_valid) {
+		cd_main_calib_model_rescale (priv, &color);
+	} else {
+		if (!cd_main_calib_model_estimate (priv, item, &color,
+						   residual_baseline, &residual,
+						   &samples, error))
+			return FALSE;
+		cd_color_rgb_copy (&item->best_so_far, &color);
+	}
+
+	while (samples < CD_MAIN_CALIB_SOLVE_SAMPLES_MAX) {
+		CdVec3 dr;
+		CdVec3 dx;
+		CdVec3 residual_tmp;
+		CdVec3 step;
+		const gdouble *s = cd_vec3_get_data (&step);
+		gboolean new_best = FALSE;
+		gdouble step_max = 0.f;
+
+		if (g_cancellable_set_error_if_cancelled (priv->cancellable, error))
+			return FALSE;
+
+		/* the model is broken, so let the caller search instead */
+		if (!cd_main_calib_model_get_step (&priv->calib_jacobian,
+						   &residual, &step)) {
+			g_debug ("singular response model, giving up");
+			priv->calib_jacobian_valid = FALSE;
+			break;
+		}
+		for (k = 0; k < 3; k++)
+			step_max = MAX (step_max, ABS (s[k]));
+		if (step_max < good_enough_interval) {
+			*converged = TRUE;
+			break;
+		}
+		if (step_max > trust)
+			cd_vec3_scalar_multiply (&step, trust / step_max, &step);
+
+		/* the gamma ramp cannot go outside 0..1 */
+		cd_color_rgb_set (&item->color,
+				  CLAMP (color.R + s[0], 0.f, 1.f),
+				  CLAMP (color.G + s[1], 0.f, 1.f),
+				  CLAMP (color.B + s[2], 0.f, 1.f));
+		cd_vec3_init (&dx,
+			      item->color.R - color.R,
+			      item->color.G - color.G,
+			      item->color.B - color.B);
+		if (!cd_main_calib_try_item (priv, item, &new_best, &residual_tmp, error))
+			return FALSE;
+		samples++;
+		if (!cd_state_done (state, error))
+			return FALSE;
+
+		/* learn from every reading, good or bad */
+		cd_vec3_subtract (&residual_tmp, &residual, &dr);
+		cd_main_calib_model_update (&priv->calib_jacobian, &dx, &dr);
+		if (new_best) {
+			cd_color_rgb_copy (&item->color, &color);
+			cd_vec3_copy (&residual_tmp, &residual);
+			trust = MIN (trust * 2, CD_MAIN_CALIB_SOLVE_STEP_MAX);
+			continue;
+		}
+
+		/* overshot, so be more careful next time */
+		trust /= 2;
+		if (trust < good_enough_interval) {
+			*converged = TRUE;
+			break;
+		}
+	}
+	cd_color_rgb_copy (&color, &priv->calib_jacobian_color);
+	g_debug ("model %s after %u samples, best RGB was: %f,%f,%f",
+		 *converged ? "converged" : "did not converge", samples,
+		 item->best_so_far.R, item->best_so_far.G, item->best_so_far.B);
+	return cd_state_finished (state, error);
+}
+
+static gboolean
+cd_main_calib_process_item (CdMainPrivate *priv,
+			    CdMainCalibrateItem *item,
+			    CdState *state,
+			    GError **error)
+{
+	CdState *state_local;
+	CdVec3 residual;
+	gboolean converged = FALSE;
+	gboolean ret = TRUE;
+
+	/* reset the state */
+	ret = cd_state_set_steps (state,
+				  error,
+				  3,	/* get baseline sample */
+				  27,	/* solve using the response model */
+				  70,	/* search if that failed */
+				  -1);
+	if (!ret)
+		return FALSE;
+
+	/* copy the current color balance as the best */
+	cd_color_rgb_copy (&item->color, &item->best_so_far);
+
+	/* get a baseline error */
+	ret = cd_main_calib_try_item (priv, item, NULL, &residual, error);
+	if (!ret)
+		return FALSE;
+
+	/* done */
+	if (!cd_state_done (state, error))
+		return FALSE;
+
+	/* converge using a local model of the display response */
+	state_local = cd_state_get_child (state);
+	if (!cd_main_calib_solve_item (priv, item, &residual,
+				       state_local, &converged, error))
+		return FALSE;
+
+	/* done */
+	if (!cd_state_done (state, error))
+		return FALSE;
+
+	/* fall back to trial and error */
+	if (!converged) {
+		state_local = cd_state_get_child (state);
+		if (!cd_main_calib_search_item (priv, item, state_local, error))
+			return FALSE;
+	}
+
+	/* done */
+	if (!cd_state_done (state, error))
+		return FALSE;
+
+	/* save this */
+	cd_color_rgb_copy (&item->best_so_far,
+			   &item->color);
+	return TRUE;
+}
+
+static gboolean
+cd_main_calib_interpolate_up (CdMainPrivate *priv,
+			      guint new_size,
+			      GError **error)
+{
+	CdMainCalibrateItem *p1;
+	CdMainCalibrateItem *p2;
+	CdMainCalibrateItem *result;
+	gboolean ret = TRUE;
+	gdouble mix;
+	guint i;
+	g_autoptr(GPtrArray) old_array = NULL;
+
+	/* make a deep copy */
+	old_array = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < priv->array->len; i++) {
+		p1 = g_ptr_array_index (priv->array, i);
+		result = g_new (CdMainCalibrateItem, 1);
+		result->error = p1->error;
+		cd_color_rgb_copy (&p1->color, &result->color);
+		g_ptr_array_add (old_array, result);
+	}
+
+	/* interpolate the new array */
+	g_ptr_array_set_size (priv->array, 0);
+	for (i = 0; i < new_size; i++) {
+		mix = (gdouble) (old_array->len - 1) /
+			(gdouble) (new_size - 1) *
+			(gdouble) i;
+		p1 = g_ptr_array_index (old_array, (guint) floor (mix));
+		p2 = g_ptr_array_index (old_array, (guint) ceil (mix));
+		result = g_new (CdMainCalibrateItem, 1);
+		result->error = G_MAXDOUBLE;
+		result->error_cached = G_MAXDOUBLE;
+		result->verified = FALSE;
+		result->index_factor = (gdouble) i / (gdouble) (new_size - 1);
+		cd_color_rgb_set (&result->color, 1.0, 1.0, 1.0);
+		cd_color_rgb_interpolate (&p1->color,
+					  &p2->color,
+					  mix - (gint) mix,
+					  &result->color);
+		g_ptr_array_add (priv->array, result);
+	}
+	return ret;
+}
+
+static guint
+cd_main_calib_get_precision_steps (CdMainPrivate *priv)
+{
+	if (priv->quality == CD_PROFILE_QUALITY_LOW)
+		return 5;
+	if (priv->quality == CD_PROFILE_QUALITY_MEDIUM)
+		return 11;
+	if (priv->quality == CD_PROFILE_QUALITY_HIGH)
+		return 21;
+	return 0;
+}
+
+static gchar *
+cd_main_calib_cache_get_filename (CdMainPrivate *priv, const gchar *suffix)
+{
+	const gchar *device_key;
+	const gchar *sensor_serial;
+	g_autofree gchar *basename = NULL;
+
+	/* the EDID survives the output being renamed or replugged */
+	device_key = cd_device_get_metadata_item (priv->device,
+						  CD_DEVICE_METADATA_OUTPUT_EDID_MD5);
+	if (device_key == NULL)
+		device_key = cd_device_get_id (priv->device);
+	sensor_serial = cd_sensor_get_serial (priv->sensor);
+	if (sensor_serial == NULL)
+		sensor_serial = "unknown";
+	basename = g_strdup_printf ("%s-%s-%s%s",
+				    device_key,
+				    cd_sensor_kind_to_string (cd_sensor_get_kind (priv->sensor)),
+				    sensor_serial,
+				    suffix);
+	g_strdelimit (basename, "/\\\"*?: ", '_');
+	return g_build_filename (g_get_user_cache_dir (),
+				 "colord-session",
+				 basename,
+				 NULL);
+}
+
+static GPtrArray *
+cd_main_calib_cache_load (CdMainPrivate *priv, GError **error)
+{
+	CdMainCalibrateItem *item;
+	gdouble *errors;
+	gdouble *points;
+	gsize len_errors = 0;
+	gsize len_points = 0;
+	guint i;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *filename_ti3 = NULL;
+	g_autoptr(GKeyFile) kf = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	filename = cd_main_calib_cache_get_filename (priv, ".ini");
+	kf = g_key_file_new ();
+	if (!g_key_file_load_from_file (kf, filename, G_KEY_FILE_NONE, error))
+		return NULL;
+
+	/* only valid for the same targets */
+	if (g_key_file_get_integer (kf, "calibration", "Quality", NULL) != (gint) priv->quality ||
+	    g_key_file_get_integer (kf, "calibration", "DeviceKind", NULL) != (gint) priv->device_kind ||
+	    g_key_file_get_integer (kf, "calibration", "Whitepoint", NULL) != (gint) priv->target_whitepoint ||
+	    g_key_file_get_integer (kf, "calibration", "Brightness", NULL) != (gint) priv->screen_brightness ||
+	    ABS (g_key_file_get_double (kf, "calibration", "Gamma", NULL) - priv->target_gamma) > 0.001) {
+		g_set_error (error,
+			     CD_SESSION_ERROR,
+			     CD_SESSION_ERROR_INVALID_VALUE,
+			     "%s was made with different targets",
+			     filename);
+		return NULL;
+	}
+
+	/* one RGB triplet and one error for each point */
+	points = g_key_file_get_double_list (kf, "calibration", "Points",
+					     &len_points, error);
+	if (points == NULL)
+		return NULL;
+	errors = g_key_file_get_double_list (kf, "calibration", "Errors",
+					     &len_errors, error);
+	if (errors == NULL) {
+		g_free (points);
+		return NULL;
+	}
+	if (len_errors != cd_main_calib_get_precision_steps (priv) ||
+	    len_points != len_errors * 3) {
+		g_set_error (error,
+			     CD_SESSION_ERROR,
+			     CD_SESSION_ERROR_INVALID_VALUE,
+			     "%s has %" G_GSIZE_FORMAT " points",
+			     filename, len_errors);
+		g_free (points);
+		g_free (errors);
+		return NULL;
+	}
+	array = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < len_errors; i++) {
+		item = g_new0 (CdMainCalibrateItem, 1);
+		item->index_factor = (gdouble) i / (gdouble) (len_errors - 1);
+		item->error = errors[i];
+		item->error_cached = errors[i];
+		cd_color_rgb_set (&item->color,
+				  points[i * 3 + 0],
+				  points[i * 3 + 1],
+				  points[i * 3 + 2]);
+		cd_color_rgb_copy (&item->color, &item->best_so_far);
+		g_ptr_array_add (array, item);
+	}
+	g_free (points);
+	g_free (errors);
+	g_debug ("using calibration from %s, native whitepoint was %.0fK",
+		 filename,
+		 g_key_file_get_double (kf, "calibration", "NativeWhitepoint", NULL));
+
+	/* the samples are only useful if the ramp does not change */
+	filename_ti3 = cd_main_calib_cache_get_filename (priv, ".ti3");
+	if (g_file_test (filename_ti3, G_FILE_TEST_EXISTS)) {
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GFile) file = g_file_new_for_path (filename_ti3);
+		priv->it8_ti3_cached = cd_it8_new ();
+		if (!cd_it8_load_from_file (priv->it8_ti3_cached, file, &error_local)) {
+			g_debug ("failed to load %s: %s",
+				 filename_ti3, error_local->message);
+			g_clear_object (&priv->it8_ti3_cached);
+		}
+	}
+	return g_steal_pointer (&array);
+}
+
+static gboolean
+cd_main_calib_cache_save (CdMainPrivate *priv, GError **error)
+{
+	CdMainCalibrateItem *item;
+	guint i;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *filename_ti3 = NULL;
+	g_autofree gdouble *errors = NULL;
+	g_autofree gdouble *points = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GKeyFile) kf = NULL;
+
+	filename = cd_main_calib_cache_get_filename (priv, ".ini");
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0700) != 0) {
+		g_set_error (error,
+			     CD_SESSION_ERROR,
+			     CD_SESSION_ERROR_INTERNAL,
+			     "failed to create %s",
+			     dirname);
+		return FALSE;
+	}
+
+	/* save the unsmoothed points so they can be refined later */
+	kf = g_key_file_new ();
+	g_key_file_set_integer (kf, "calibration", "Quality", priv->quality);
+	g_key_file_set_integer (kf, "calibration", "DeviceKind", priv->device_kind);
+	g_key_file_set_integer (kf, "calibration", "Whitepoint", priv->target_whitepoint);
+	g_key_file_set_integer (kf, "calibration", "Brightness", priv->screen_brightness);
+	g_key_file_set_double (kf, "calibration", "Gamma", priv->target_gamma);
+	g_key_file_set_double (kf, "calibration", "NativeWhitepoint", priv->native_whitepoint);
+	points = g_new0 (gdouble, priv->array->len * 3);
+	errors = g_new0 (gdouble, priv->array->len);
+	for (i = 0; i < priv->array->len; i++) {
+		item = g_ptr_array_index (priv->array, i);
+		points[i * 3 + 0] = item->color.R;
+		points[i * 3 + 1] = item->color.G;
+		points[i * 3 + 2] = item->color.B;
+		errors[i] = item->error;
+	}
+	g_key_file_set_double_list (kf, "calibration", "Points",
+				    points, priv->array->len * 3);
+	g_key_file_set_double_list (kf, "calibration", "Errors",
+				    errors, priv->array->len);
+	if (!g_key_file_save_to_file (kf, filename, error))
+		return FALSE;
+
+	/* save the samples measured through this ramp */
+	filename_ti3 = cd_main_calib_cache_get_filename (priv, ".ti3");
+	file = g_file_new_for_path (filename_ti3);
+	return cd_it8_save_to_file (priv->it8_ti3, file, error);
+}
+
+static gboolean
+cd_main_calib_check_item (CdMainPrivate *priv,
+			  CdMainCalibrateItem *item,
+			  GError **error)
+{
+	/* one reading is enough to tell if the display has drifted */
+	item->error = G_MAXDOUBLE;
+	if (!cd_main_calib_try_item (priv, item, NULL, NULL, error))
+		return FALSE;
+	item->verified = item->error < item->error_cached + CD_MAIN_CALIB_DRIFT_TOLERANCE;
+	g_debug ("point %.2f error %f, was %f: %s",
+		 item->index_factor, item->error, item->error_cached,
+		 item->verified ? "unchanged" : "drifted");
+
+	/* no need to check this again before refining it */
+	if (!item->verified)
+		item->error_cached = G_MAXDOUBLE;
+	return TRUE;
+}
+
+static gboolean
+cd_main_calib_process_white (CdMainPrivate *priv,
+			     CdMainCalibrateItem *item,
+			     CdState *state,
+			     GError **error)
+{
+	gdouble temp;
+
+	if (!cd_main_calib_process_item (priv, item, state, error))
+		return FALSE;
+
+	/* ensure white is normalised to 1 */
+	temp = 1.0f / (gdouble) MAX (MAX (item->color.R, item->color.G), item->color.B);
+	item->color.R *= temp;
+	item->color.G *= temp;
+	item->color.B *= temp;
+	return TRUE;
+}
+
+static gboolean
+cd_main_calib_verify_cached (CdMainPrivate *priv,
+			     CdState *state,
+			     GError **error)
+{
+	CdColorRGB rgb;
+	CdMainCalibrateItem *item;
+	CdState *state_local;
+	gboolean drifted = FALSE;
+	guint i;
+	guint j;
+	guint len = priv->array->len;
+	guint stride;
+
+	/* white is always in the subset as it was checked first */
+	stride = MAX (1, (len - 1) / CD_MAIN_CALIB_DRIFT_SUBSET);
+	cd_state_set_number_steps (state, (len - 2) / stride + 2);
+	cd_main_emit_update_gamma (priv, priv->array);
+	for (j = 0; j * stride < len - 1; j++) {
+		i = len - 1 - j * stride;
+		rgb.R = 1.0 / (gdouble) (len - 1) * (gdouble) i;
+		rgb.G = rgb.R;
+		rgb.B = rgb.R;
+		if (!cd_main_emit_update_sample (priv, &rgb, error))
+			return FALSE;
+		item = g_ptr_array_index (priv->array, i);
+		if (!cd_main_calib_check_item (priv, item, error))
+			return FALSE;
+		if (!item->verified)
+			drifted = TRUE;
+		if (!cd_state_done (state, error))
+			return FALSE;
+	}
+
+	/* trust the points in between if none of the subset moved */
+	if (!drifted) {
+		for (i = 0; i < len; i++) {
+			item = g_ptr_array_index (priv->array, i);
+			item->verified = TRUE;
+		}
+	}
+
+	/* white moves every point, so fix it before the others */
+	item = g_ptr_array_index (priv->array, len - 1);
+	if (!item->verified) {
+		rgb.R = 1.0;
+		rgb.G = 1.0;
+		rgb.B = 1.0;
+		if (!cd_main_emit_update_sample (priv, &rgb, error))
+			return FALSE;
+		state_local = cd_state_get_child (state);
+		if (!cd_main_calib_process_white (priv, item, state_local, error))
+			return FALSE;
+		item->verified = TRUE;
+		priv->calib_drifted = TRUE;
+	}
+	return cd_state_done (state, error);
+}
+
+static gboolean
+cd_main_calib_refine_points (CdMainPrivate *priv,
+			     CdState *state,
+			     GError **error)
+{
+	CdColorRGB rgb;
+	CdMainCalibrateItem *item;
+	CdState *state_loop;
+	guint i;
+
+	cd_state_set_number_steps (state, priv->array->len - 1);
+	for (i = priv->array->len - 2; i > 0 ; i--) {
+
+		/* already checked against the last calibration */
+		item = g_ptr_array_index (priv->array, i);
+		if (item->verified) {
+			if (!cd_state_done (state, error))
+				return FALSE;
+			continue;
+		}
+
+		/* set new sample patch */
+		rgb.R = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
+		rgb.G = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
+		rgb.B = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
+		if (!cd_main_emit_update_sample (priv, &rgb, error))
+			return FALSE;
+
+		/* only refine the points that moved since last time */
+		if (item->error_cached < G_MAXDOUBLE) {
+			if (!cd_main_calib_check_item (priv, item, error))
+				return FALSE;
+		}
+		if (!item->verified) {
+			state_loop = cd_state_get_child (state);
+			if (!cd_main_calib_process_item (priv, item, state_loop, error))
+				return FALSE;
+			priv->calib_drifted = TRUE;
+		}
+
+		/* done */
+		if (!cd_state_done (state, error))
+			return FALSE;
+	}
+	return cd_state_finished (state, error);
+}
+
+static gboolean
+cd_main_calib_process (CdMainPrivate *priv,
+		       CdState *state,
+		       GError **error)
+{
+	CdColorRGB *rgb_tmp;
+	CdMainCalibrateItem *item;
+	CdState *state_local;
+	cmsCIExyY whitepoint_tmp;
+	gboolean ret;
+	gdouble temp;
+	guint i;
+	g_autoptr(GString) error_str = NULL;
+	g_autoptr(GPtrArray) array_cached = NULL;
+	g_autoptr(GPtrArray) gamma_data = NULL;
+	g_autoptr(GPtrArray) vcgt_smoothed = NULL;
+
+	/* reset the state */
+	ret = cd_state_set_steps (state,
+				  error,
+				  1,	/* get native whitepoint */
+				  3,	/* normalize white, or verify */
+				  94,	/* refine other points */
+				  1,	/* get new whitepoint */
+				  1,	/* write calibrate point */
+				  -1);
+	if (!ret)
+		return FALSE;
+
+	/* start from the last calibration of this display and sensor */
+	if (priv->drift_check) {
+		g_autoptr(GError) error_local = NULL;
+		array_cached = cd_main_calib_cache_load (priv, &error_local);
+		if (array_cached == NULL)
+			g_debug ("doing full calibration: %s", error_local->message);
+	}
+
+	/* clear gamma ramp to linear */
+	priv->calib_jacobian_valid = FALSE;
+	priv->array = g_ptr_array_new_with_free_func (g_free);
+	item = g_new0 (CdMainCalibrateItem, 1);
 	item->error = G_MAXDOUBLE;
 	item->index_factor = 0.0f;
 	cd_color_rgb_set (&item->color, 0.0, 0.0, 0.0);
@@ -676,64 +1662,44 @@ cd_main_calib_process (CdMainPrivate *priv,
 	if (!cd_state_done (state, error))
 		return FALSE;
 
-	/* should we seed the first value with a good approximation */
-	if (priv->target_whitepoint > 0) {
-		CdColorRGB tmp;
-		cd_color_get_blackbody_rgb (6500 - (priv->native_whitepoint - priv->target_whitepoint), &tmp);
-		g_debug ("Seeding with %f,%f,%f",
-			 tmp.R, tmp.G, tmp.B);
-		cd_color_rgb_copy (&tmp, &item->color);
-	}
+	/* only check a few points if the display was calibrated before */
+	if (array_cached != NULL) {
+		g_ptr_array_unref (priv->array);
+		priv->array = g_steal_pointer (&array_cached);
+		state_local = cd_state_get_child (state);
+		if (!cd_main_calib_verify_cached (priv, state_local, error))
+			return FALSE;
+	} else {
+		/* should we seed the first value with a good approximation */
+		if (priv->target_whitepoint > 0) {
+			CdColorRGB tmp;
+			cd_color_get_blackbody_rgb (6500 - (priv->native_whitepoint - priv->target_whitepoint), &tmp);
+			g_debug ("Seeding with %f,%f,%f",
+				 tmp.R, tmp.G, tmp.B);
+			cd_color_rgb_copy (&tmp, &item->color);
+		}
 
-	/* process the last item in the array (255,255,255) */
-	item = g_ptr_array_index (priv->array, 1);
-	state_local = cd_state_get_child (state);
-	if (!cd_main_calib_process_item (priv, item, state_local, error))
-		return FALSE;
+		/* process the last item in the array (255,255,255) */
+		item = g_ptr_array_index (priv->array, 1);
+		state_local = cd_state_get_child (state);
+		if (!cd_main_calib_process_white (priv, item, state_local, error))
+			return FALSE;
 
-	/* ensure white is normalised to 1 */
-	temp = 1.0f / (gdouble) MAX (MAX (item->color.R, item->color.G), item->color.B);
-	item->color.R *= temp;
-	item->color.G *= temp;
-	item->color.B *= temp;
+		/* expand out the array into more points (interpolating) */
+		if (!cd_main_calib_interpolate_up (priv,
+						   cd_main_calib_get_precision_steps (priv),
+						   error))
+			return FALSE;
+	}
 
 	/* done */
 	if (!cd_state_done (state, error))
 		return FALSE;
 
-	/* expand out the array into more points (interpolating) */
-	if (priv->quality == CD_PROFILE_QUALITY_LOW) {
-		precision_steps = 5;
-	} else if (priv->quality == CD_PROFILE_QUALITY_MEDIUM) {
-		precision_steps = 11;
-	} else if (priv->quality == CD_PROFILE_QUALITY_HIGH) {
-		precision_steps = 21;
-	}
-	if (!cd_main_calib_interpolate_up (priv, precision_steps, error))
-		return FALSE;
-
 	/* refine the other points */
 	state_local = cd_state_get_child (state);
-	cd_state_set_number_steps (state_local, priv->array->len - 1);
-	for (i = priv->array->len - 2; i > 0 ; i--) {
-
-		/* set new sample patch */
-		rgb.R = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
-		rgb.G = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
-		rgb.B = 1.0 / (gdouble) (priv->array->len - 1) * (gdouble) i;
-		if (!cd_main_emit_update_sample (priv, &rgb, error))
-			return FALSE;
-
-		/* process this section */
-		item = g_ptr_array_index (priv->array, i);
-		state_loop = cd_state_get_child (state_local);
-		if (!cd_main_calib_process_item (priv, item, state_loop, error))
-			return FALSE;
-
-		/* done */
-		if (!cd_state_done (state_local, error))
-			return FALSE;
-	}
+	if (!cd_main_calib_refine_points (priv, state_local, error))
+		return FALSE;
 
 	/* done */
 	if (!cd_state_done (state, error))
@@ -781,29 +1747,132 @@ cd_main_calib_process (CdMainPrivate *priv,
 				     error_str->str);
 		return FALSE;
 	}
-
-	/* write the new smoothed monotonic data */
-	for (i = 0; i < vcgt_smoothed->len; i++) {
-		rgb_tmp = g_ptr_array_index (vcgt_smoothed, i);
-		cd_it8_add_data (priv->it8_cal, rgb_tmp, NULL);
+
+	/* write the new smoothed monotonic data */
+	for (i = 0; i < vcgt_smoothed->len; i++) {
+		rgb_tmp = g_ptr_array_index (vcgt_smoothed, i);
+		cd_it8_add_data (priv->it8_cal, rgb_tmp, NULL);
+	}
+
+	/* done */
+	return cd_state_done (state, error);
+}
+
+static gboolean
+cd_main_session_is_busy (CdMainPrivate *priv)
+{
+	if (priv->finished)
+		return FALSE;
+	if (priv->thread != NULL || priv->status != CD_SESSION_STATUS_IDLE)
+		return TRUE;
+
+	/* created sessions are kept until they have been used */
+	return g_strcmp0 (priv->object_path, CD_SESSION_DBUS_PATH) != 0;
+}
+
+/* the daemon quits when the last calibration has finished */
+static void
+cd_main_session_done (CdMainPrivate *priv)
+{
+	CdMainDaemon *daemon = priv->daemon;
+	guint i;
+
+	/* the thread will call this again when it has stopped */
+	if (priv->thread != NULL)
+		return;
+	if (!priv->finished) {
+		if (priv->sensor)
+			cd_sensor_unlock_sync(priv->sensor, NULL, NULL);
+		if (priv->device)
+			cd_device_profiling_uninhibit_sync(priv->device, NULL, NULL);
+		if (priv->watcher_id != 0) {
+			g_bus_unwatch_name (priv->watcher_id);
+			priv->watcher_id = 0;
+		}
+		if (priv->registration_id != 0 &&
+		    g_strcmp0 (priv->object_path, CD_SESSION_DBUS_PATH) != 0) {
+			g_dbus_connection_unregister_object (priv->connection,
+							     priv->registration_id);
+			priv->registration_id = 0;
+		}
+		priv->status = CD_SESSION_STATUS_IDLE;
+		priv->finished = TRUE;
+	}
+	for (i = 0; i < daemon->sessions->len; i++) {
+		CdMainPrivate *priv_tmp = g_ptr_array_index (daemon->sessions, i);
+		if (cd_main_session_is_busy (priv_tmp)) {
+			g_debug ("%s finished, %s still running",
+				 priv->object_path, priv_tmp->object_path);
+			return;
+		}
 	}
-
-	/* done */
-	return cd_state_done (state, error);
+	g_main_loop_quit (daemon->loop);
 }
 
 static gboolean
 cd_main_finished_quit_cb (gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	if (priv->sensor)
-		cd_sensor_unlock_sync(priv->sensor, NULL, NULL);
-	if (priv->device)
-		cd_device_profiling_uninhibit_sync(priv->device, NULL, NULL);
-	g_main_loop_quit (priv->loop);
+	cd_main_session_done (priv);
 	return G_SOURCE_REMOVE;
 }
 
+static void
+cd_main_load_correction (CdMainPrivate *priv)
+{
+	const gchar *instrument;
+	CdSensorKind sensor_kind;
+	g_autofree gchar *index_fn = NULL;
+	g_autoptr(CdIt8Store) store = cd_it8_store_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) locations = g_ptr_array_new_with_free_func (g_free);
+
+	/* only the headers are read, and only once per file */
+	index_fn = g_build_filename (g_get_user_cache_dir (),
+				     "colord",
+				     "corrections.ini",
+				     NULL);
+	if (!cd_it8_store_set_index (store, index_fn, &error)) {
+		g_debug ("failed to load correction index: %s", error->message);
+		g_clear_error (&error);
+	}
+	/* the correction has to name the instrument */
+	instrument = cd_sensor_get_model (priv->sensor);
+	sensor_kind = cd_sensor_get_kind (priv->sensor);
+	if (instrument == NULL && sensor_kind != CD_SENSOR_KIND_UNKNOWN)
+		instrument = cd_sensor_kind_to_string (sensor_kind);
+	if (instrument == NULL) {
+		g_debug ("not using a correction for an unknown instrument");
+		return;
+	}
+
+	g_ptr_array_add (locations, g_build_filename (g_get_user_data_dir (),
+						      "colord", "corrections", NULL));
+	g_ptr_array_add (locations, g_build_filename (DATADIR,
+						      "colord", "corrections", NULL));
+	for (guint i = 0; i < locations->len; i++) {
+		const gchar *location = g_ptr_array_index (locations, i);
+		if (!cd_it8_store_search_location (store, location, NULL, &error)) {
+			g_debug ("failed to search %s: %s", location, error->message);
+			g_clear_error (&error);
+		}
+	}
+
+	/* find the best match for the instrument and the display */
+	priv->it8_ccmx = cd_it8_store_find (store,
+					    CD_IT8_KIND_CCMX,
+					    instrument,
+					    priv->device_kind,
+					    cd_device_get_model (priv->device),
+					    &error);
+	if (priv->it8_ccmx == NULL) {
+		g_debug ("not using a correction: %s", error->message);
+		return;
+	}
+	g_debug ("using correction %s for %s",
+		 cd_it8_get_title (priv->it8_ccmx), instrument);
+}
+
 static gboolean
 cd_main_load_samples (CdMainPrivate *priv, GError **error)
 {
@@ -823,6 +1892,15 @@ cd_main_load_samples (CdMainPrivate *priv, GError **error)
 	return cd_it8_load_from_file (priv->it8_ti1, file, error);
 }
 
+static gboolean
+cd_main_make_working_path (CdMainPrivate *priv, GError **error)
+{
+	if (priv->working_path != NULL)
+		return TRUE;
+	priv->working_path = g_dir_make_tmp ("colord-session-XXXXXX", error);
+	return priv->working_path != NULL;
+}
+
 static gboolean
 cd_main_write_colprof_files (CdMainPrivate *priv, GError **error)
 {
@@ -833,11 +1911,6 @@ cd_main_write_colprof_files (CdMainPrivate *priv, GError **error)
 	g_autofree gchar *filename_ti3 = NULL;
 	g_autofree gchar *path_ti3 = NULL;
 
-	/* build temp path */
-	priv->working_path = g_dir_make_tmp ("colord-session-XXXXXX", error);
-	if (priv->working_path == NULL)
-		return FALSE;
-
 	/* save .ti3 with ti1 and cal data appended together */
 	ret = cd_it8_save_to_data (priv->it8_ti3,
 				   &data_ti3,
@@ -1029,15 +2102,111 @@ cd_main_set_profile_metadata (CdMainPrivate *priv, GError **error)
 	return TRUE;
 }
 
+typedef struct {
+	GMainLoop		*loop;
+	GSubprocess		*subprocess;
+	GDataInputStream	*stream;
+	GCancellable		*cancellable;
+	CdState			*state;
+	GString			*output;
+	GError			*error;
+} CdMainColprofHelper;
+
+static void
+cd_main_colprof_wait_cb (GObject *source_object,
+			 GAsyncResult *res,
+			 gpointer user_data)
+{
+	CdMainColprofHelper *helper = (CdMainColprofHelper *) user_data;
+	g_autoptr(GError) error_local = NULL;
+
+	if (!g_subprocess_wait_check_finish (G_SUBPROCESS (source_object),
+					     res, &error_local)) {
+		if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			helper->error = g_steal_pointer (&error_local);
+		} else {
+			g_set_error (&helper->error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_FAILED_TO_GENERATE_PROFILE,
+				     "colprof failed: %s", helper->output->str);
+		}
+	}
+	g_main_loop_quit (helper->loop);
+}
+
+/* colprof prints a running percentage for the slow parts */
+static void
+cd_main_colprof_parse_line (CdMainColprofHelper *helper, const gchar *line)
+{
+	gchar *endptr = NULL;
+	guint64 percentage;
+	const gchar *tmp;
+
+	g_debug ("colprof: %s", line);
+	tmp = strrchr (line, '%');
+	if (tmp == NULL || tmp == line)
+		return;
+	while (tmp > line && g_ascii_isdigit (tmp[-1]))
+		tmp--;
+	percentage = g_ascii_strtoull (tmp, &endptr, 10);
+	if (endptr == tmp || *endptr != '%' || percentage > 100)
+		return;
+	if (percentage > cd_state_get_percentage (helper->state))
+		cd_state_set_percentage (helper->state, (guint) percentage);
+}
+
+static void
+cd_main_colprof_read_cb (GObject *source_object,
+			 GAsyncResult *res,
+			 gpointer user_data)
+{
+	CdMainColprofHelper *helper = (CdMainColprofHelper *) user_data;
+	gsize len = 0;
+	g_autoptr(GError) error_local = NULL;
+	g_autofree gchar *line = NULL;
+
+	line = g_data_input_stream_read_upto_finish (helper->stream, res,
+						     &len, &error_local);
+	if (line == NULL) {
+		/* stop the tool if it was cancelled while running */
+		if (error_local != NULL) {
+			g_debug ("failed to read colprof output: %s",
+				 error_local->message);
+			g_subprocess_force_exit (helper->subprocess);
+		}
+		g_subprocess_wait_check_async (helper->subprocess,
+					       helper->cancellable,
+					       cd_main_colprof_wait_cb,
+					       helper);
+		return;
+	}
+
+	/* skip the \r or \n, which is already in the buffer */
+	if (g_buffered_input_stream_get_available (G_BUFFERED_INPUT_STREAM (helper->stream)) > 0)
+		g_data_input_stream_read_byte (helper->stream, NULL, NULL);
+	if (len > 0) {
+		cd_main_colprof_parse_line (helper, line);
+
+		/* only keep the end of the output for the error message */
+		g_string_append_printf (helper->output, "%s\n", line);
+		if (helper->output->len > 4096)
+			g_string_erase (helper->output, 0, helper->output->len - 4096);
+	}
+	g_data_input_stream_read_upto_async (helper->stream, "\r\n", 2,
+					     G_PRIORITY_DEFAULT,
+					     helper->cancellable,
+					     cd_main_colprof_read_cb,
+					     helper);
+}
+
 static gboolean
-cd_main_generate_profile (CdMainPrivate *priv, GError **error)
+cd_main_generate_profile (CdMainPrivate *priv, CdState *state, GError **error)
 {
-	gboolean ret;
-	gint exit_status = 0;
+	CdMainColprofHelper helper = { 0 };
 	g_autofree gchar *cmd_debug = NULL;
 	g_autofree gchar *command = NULL;
-	g_autofree gchar *stderr_data = NULL;
 	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GSubprocessLauncher) launcher = NULL;
 
 	/* get correct name of the command */
 	command = cd_main_find_argyll_tool ("colprof", error);
@@ -1059,34 +2228,488 @@ cd_main_generate_profile (CdMainPrivate *priv, GError **error)
 	g_ptr_array_add (array, g_strdup (priv->basename));
 	g_ptr_array_add (array, NULL);
 
-	/* run the command */
+	/* run the command without blocking the D-Bus interface */
 	cmd_debug = g_strjoinv (" ", (gchar **) array->pdata);
 	g_debug ("running '%s'", cmd_debug);
-	ret = g_spawn_sync (priv->working_path,
-			    (gchar **) array->pdata,
-			    NULL,
-			    0,
-			    NULL, NULL,
-			    NULL,
-			    &stderr_data,
-			    &exit_status,
-			    error);
-	if (!ret)
+	launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+					      G_SUBPROCESS_FLAGS_STDERR_MERGE);
+	g_subprocess_launcher_set_cwd (launcher, priv->working_path);
+	helper.subprocess = g_subprocess_launcher_spawnv (launcher,
+							  (const gchar * const *) array->pdata,
+							  error);
+	if (helper.subprocess == NULL)
+		return FALSE;
+	helper.stream = g_data_input_stream_new (g_subprocess_get_stdout_pipe (helper.subprocess));
+	helper.cancellable = priv->cancellable;
+	helper.state = state;
+	helper.output = g_string_new (NULL);
+	helper.loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
+	g_data_input_stream_read_upto_async (helper.stream, "\r\n", 2,
+					     G_PRIORITY_DEFAULT,
+					     helper.cancellable,
+					     cd_main_colprof_read_cb,
+					     &helper);
+	g_main_loop_run (helper.loop);
+	g_main_loop_unref (helper.loop);
+	g_object_unref (helper.stream);
+	g_object_unref (helper.subprocess);
+	g_string_free (helper.output, TRUE);
+	if (helper.error != NULL) {
+		g_propagate_error (error, helper.error);
+		return FALSE;
+	}
+	return cd_state_finished (state, error);
+}
+
+static void
+cd_main_xyz_add (CdColorXYZ *dest, const CdColorXYZ *src)
+{
+	dest->X += src->X;
+	dest->Y += src->Y;
+	dest->Z += src->Z;
+}
+
+/* the same single gamma and matrix profile that colprof -aG makes, but
+ * built in-process from the primaries and grey ramps in the .ti3 data */
+static gboolean
+cd_main_generate_profile_builtin (CdMainPrivate *priv, GError **error)
+{
+	CdColorRGB rgb;
+	CdColorRGB *rgb_tmp;
+	CdColorXYZ black = { 0.f, 0.f, 0.f };
+	CdColorXYZ primaries[3];
+	CdColorXYZ white = { 0.f, 0.f, 0.f };
+	CdColorXYZ xyz;
+	CdColorYxy yxy_primaries[3];
+	CdColorYxy yxy_white;
+	gdouble full;
+	gdouble gamma;
+	gdouble sum_xx = 0.f;
+	gdouble sum_xy = 0.f;
+	gdouble value;
+	gdouble y;
+	guint black_cnt = 0;
+	guint i;
+	guint j;
+	guint primaries_cnt[3] = { 0, 0, 0 };
+	guint size;
+	guint white_cnt = 0;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *path = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GPtrArray) vcgt = NULL;
+
+	/* average the black, white and primary patches */
+	memset (primaries, 0, sizeof (primaries));
+	size = cd_it8_get_data_size (priv->it8_ti3);
+	for (i = 0; i < size; i++) {
+		guint n_full = 0;
+		guint n_zero = 0;
+		cd_it8_get_data_item (priv->it8_ti3, i, &rgb, &xyz);
+		for (j = 0; j < 3; j++) {
+			value = cd_main_calib_rgb_get_component (&rgb, j);
+			if (value > 0.999)
+				n_full++;
+			else if (value < 0.001)
+				n_zero++;
+		}
+		if (n_zero == 3) {
+			cd_main_xyz_add (&black, &xyz);
+			black_cnt++;
+		} else if (n_full == 3) {
+			cd_main_xyz_add (&white, &xyz);
+			white_cnt++;
+		} else if (n_full == 1 && n_zero == 2) {
+			j = rgb.R > 0.999 ? 0 : rgb.G > 0.999 ? 1 : 2;
+			cd_main_xyz_add (&primaries[j], &xyz);
+			primaries_cnt[j]++;
+		}
+	}
+	if (black_cnt == 0 || white_cnt == 0 || primaries_cnt[0] == 0 ||
+	    primaries_cnt[1] == 0 || primaries_cnt[2] == 0) {
+		g_set_error_literal (error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_FAILED_TO_GENERATE_PROFILE,
+				     "samples do not include black, white and primaries");
+		return FALSE;
+	}
+	cd_color_xyz_set (&black, black.X / black_cnt, black.Y / black_cnt, black.Z / black_cnt);
+	cd_color_xyz_set (&white, white.X / white_cnt, white.Y / white_cnt, white.Z / white_cnt);
+	for (j = 0; j < 3; j++) {
+		cd_color_xyz_set (&primaries[j],
+				  primaries[j].X / primaries_cnt[j] - black.X,
+				  primaries[j].Y / primaries_cnt[j] - black.Y,
+				  primaries[j].Z / primaries_cnt[j] - black.Z);
+		cd_color_xyz_to_yxy (&primaries[j], &yxy_primaries[j]);
+	}
+	cd_color_xyz_to_yxy (&white, &yxy_white);
+
+	/* fit one gamma to the single channel and grey ramps in log space */
+	for (i = 0; i < size; i++) {
+		gint channel = -1;
+		cd_it8_get_data_item (priv->it8_ti3, i, &rgb, &xyz);
+		if (ABS (rgb.R - rgb.G) < 0.001 && ABS (rgb.G - rgb.B) < 0.001) {
+			value = rgb.R;
+			full = white.Y;
+		} else {
+			for (j = 0; j < 3; j++) {
+				if (cd_main_calib_rgb_get_component (&rgb, j) < 0.001)
+					continue;
+				if (channel != -1) {
+					channel = -2;
+					break;
+				}
+				channel = (gint) j;
+			}
+			if (channel < 0)
+				continue;
+			value = cd_main_calib_rgb_get_component (&rgb, channel);
+			full = primaries[channel].Y + black.Y;
+		}
+		if (value < 0.05 || value > 0.95 || full - black.Y <= 0.f)
+			continue;
+		y = (xyz.Y - black.Y) / (full - black.Y);
+		if (y <= 0.f || y >= 1.f)
+			continue;
+		sum_xy += log (y) * log (value);
+		sum_xx += log (value) * log (value);
+	}
+	if (sum_xx <= 0.f) {
+		g_set_error_literal (error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_FAILED_TO_GENERATE_PROFILE,
+				     "samples do not include any ramps");
 		return FALSE;
-	if (exit_status != 0) {
+	}
+	gamma = sum_xy / sum_xx;
+	g_debug ("fitted gamma %f", gamma);
+	if (gamma < 1.f || gamma > 4.f) {
 		g_set_error (error,
 			     CD_SESSION_ERROR,
 			     CD_SESSION_ERROR_FAILED_TO_GENERATE_PROFILE,
-			     "colprof failed: %s", stderr_data);
+			     "fitted gamma %.2f is not sane", gamma);
+		return FALSE;
+	}
+
+	/* create the profile */
+	icc = cd_icc_new ();
+	if (!cd_icc_create_from_edid (icc, gamma,
+				      &yxy_primaries[0],
+				      &yxy_primaries[1],
+				      &yxy_primaries[2],
+				      &yxy_white, error))
+		return FALSE;
+	cd_icc_set_description (icc, NULL, priv->title);
+	cd_icc_set_model (icc, NULL, cd_device_get_model (priv->device));
+	cd_icc_set_copyright (icc, NULL, CD_PROFILE_DEFAULT_COPYRIGHT_STRING);
+
+	/* the calibration curves go in as a VCGT like colprof -aG does */
+	vcgt = cd_color_rgb_array_new ();
+	for (i = 0; i < cd_it8_get_data_size (priv->it8_cal); i++) {
+		cd_it8_get_data_item (priv->it8_cal, i, &rgb, NULL);
+		rgb_tmp = cd_color_rgb_dup (&rgb);
+		g_ptr_array_add (vcgt, rgb_tmp);
+	}
+	if (vcgt->len > 0 && !cd_icc_set_vcgt (icc, vcgt, error))
+		return FALSE;
+
+	/* save where colprof would have */
+	filename = g_strdup_printf ("%s.icc", priv->basename);
+	path = g_build_filename (priv->working_path, filename, NULL);
+	file = g_file_new_for_path (path);
+	g_debug ("saving built-in profile %s", path);
+	return cd_icc_save_file (icc, file, CD_ICC_SAVE_FLAGS_NONE,
+				 priv->cancellable, error);
+}
+
+typedef struct {
+	GMainLoop		*loop;
+	GPtrArray		*samples;
+	GError			*error;
+	gboolean		 done;
+} CdMainBatchHelper;
+
+static void
+cd_main_display_get_samples_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	CdMainBatchHelper *helper = (CdMainBatchHelper *) user_data;
+	helper->samples = cd_sensor_get_samples_finish (CD_SENSOR (source_object),
+							res,
+							&helper->error);
+	helper->done = TRUE;
+	if (helper->loop != NULL)
+		g_main_loop_quit (helper->loop);
+}
+
+/* shows the patches on a fixed schedule while the sensor samples them,
+ * setting @batched to FALSE if the sensor could not keep up */
+static gboolean
+cd_main_display_get_samples_batched (CdMainPrivate *priv,
+				     CdState *state,
+				     gboolean *batched,
+				     GError **error)
+{
+	CdColorRGB rgb;
+	CdColorXYZ xyz;
+	CdMainBatchHelper helper = { NULL, NULL, NULL, FALSE };
+	gint64 sample_time;
+	gint64 start;
+	guint i;
+	guint period;
+	guint size;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GPtrArray) samples = NULL;
+
+	/* time one sample the slow way to size the schedule */
+	size = cd_it8_get_data_size (priv->it8_ti1);
+	cd_it8_get_data_item (priv->it8_ti1, 0, &rgb, NULL);
+	if (!cd_main_emit_update_sample (priv, &rgb, error))
+		return FALSE;
+	sample_time = g_get_monotonic_time ();
+	if (!cd_main_calib_get_sample (priv, &xyz, error))
+		return FALSE;
+	sample_time = (g_get_monotonic_time () - sample_time) / 1000;
+	if (!cd_state_done (state, error))
+		return FALSE;
+
+	/* leave some headroom as readings take longer for dark patches */
+	period = priv->sample_delay + (guint) (sample_time * 3 / 2) + CD_MAIN_BATCH_MARGIN;
+	start = g_get_monotonic_time () + CD_MAIN_BATCH_MARGIN * 1000;
+	g_debug ("batching %u samples every %ums", size - 1, period);
+	cd_sensor_get_samples (priv->sensor,
+			       priv->device_kind,
+			       start,
+			       size - 1,
+			       period,
+			       priv->sample_delay,
+			       priv->cancellable,
+			       cd_main_display_get_samples_cb,
+			       &helper);
+
+	/* show each patch on time, without waiting for the readings */
+	for (i = 1; i < size; i++) {
+		gint64 due = start + (gint64) (i - 1) * period * 1000;
+		gint64 now = g_get_monotonic_time ();
+		if (due > now)
+			cd_main_calib_idle_delay (priv, (guint) ((due - now) / 1000));
+		if (helper.done)
+			break;
+		cd_it8_get_data_item (priv->it8_ti1, i, &rgb, NULL);
+		cd_main_emit_update_sample_signal (priv, &rgb);
+		if (!cd_state_done (state, &error_local))
+			break;
+	}
+
+	/* the helper is on the stack, so always wait for the reply */
+	if (!helper.done) {
+		helper.loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
+		g_main_loop_run (helper.loop);
+		g_main_loop_unref (helper.loop);
+	}
+	samples = helper.samples;
+	if (error_local != NULL) {
+		g_clear_error (&helper.error);
+		g_propagate_error (error, g_steal_pointer (&error_local));
 		return FALSE;
 	}
+	if (samples == NULL || samples->len != size - 1) {
+		g_debug ("failed to batch samples: %s",
+			 helper.error != NULL ? helper.error->message : "wrong size");
+		g_clear_error (&helper.error);
+		*batched = FALSE;
+		return TRUE;
+	}
+
+	/* success */
+	cd_it8_get_data_item (priv->it8_ti1, 0, &rgb, NULL);
+	cd_it8_add_data (priv->it8_ti3, &rgb, &xyz);
+	for (i = 1; i < size; i++) {
+		cd_it8_get_data_item (priv->it8_ti1, i, &rgb, NULL);
+		cd_it8_add_data (priv->it8_ti3, &rgb, g_ptr_array_index (samples, i - 1));
+		cd_main_trace_xyz (priv, g_ptr_array_index (samples, i - 1));
+	}
+	*batched = TRUE;
 	return TRUE;
 }
 
+typedef struct {
+	CdMainPrivate		*priv;
+	CdState			*state;
+	GMainLoop		*loop;
+	GError			*error;
+	CdColorXYZ		 xyz_first;
+	guint			 idx;
+	guint			 size;
+	guint			 settle;	/* ms */
+	GSource			*settle_source;
+	gboolean		 verifying;
+	gboolean		 unsettled;
+} CdMainPipelineHelper;
+
+static void cd_main_display_pipeline_show (CdMainPipelineHelper *helper);
+
+static void
+cd_main_display_pipeline_fail (CdMainPipelineHelper *helper, GError *error)
+{
+	if (helper->settle_source != NULL) {
+		g_source_destroy (helper->settle_source);
+		g_source_unref (helper->settle_source);
+		helper->settle_source = NULL;
+	}
+	helper->error = error;
+	g_main_loop_quit (helper->loop);
+}
+
+/* re-reading a patch now and again shows if it had finished changing */
 static gboolean
-cd_main_display_get_samples (CdMainPrivate *priv,
-			     CdState *state,
-			     GError **error)
+cd_main_display_pipeline_should_verify (CdMainPipelineHelper *helper)
+{
+	if (helper->unsettled || helper->idx < 4)
+		return TRUE;
+	return helper->idx % CD_MAIN_SETTLE_VERIFY_INTERVAL == 0;
+}
+
+static void
+cd_main_display_pipeline_adapt (CdMainPipelineHelper *helper,
+				const CdColorXYZ *xyz)
+{
+	CdMainPrivate *priv = helper->priv;
+	gdouble diff = ABS (xyz->Y - helper->xyz_first.Y);
+
+	/* still moving when the first reading was taken */
+	if (diff > CD_MAIN_SETTLE_TOLERANCE * MAX (xyz->Y, 10.f)) {
+		helper->settle = MIN (helper->settle * 2, priv->sample_delay * 2);
+		helper->settle = MAX (helper->settle, CD_MAIN_SETTLE_MIN * 2);
+		helper->unsettled = TRUE;
+	} else {
+		helper->settle = MAX (helper->settle * 3 / 4, CD_MAIN_SETTLE_MIN);
+		helper->unsettled = FALSE;
+	}
+	g_debug ("patch %u changed by %f, settle delay now %ums",
+		 helper->idx, diff, helper->settle);
+}
+
+static void
+cd_main_display_pipeline_sample_cb (GObject *source_object,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	CdMainPipelineHelper *helper = (CdMainPipelineHelper *) user_data;
+	CdColorRGB rgb;
+	GError *error = NULL;
+	g_autoptr(CdColorXYZ) xyz = NULL;
+
+	xyz = cd_sensor_get_sample_finish (CD_SENSOR (source_object), res, &error);
+	if (xyz == NULL) {
+		cd_main_display_pipeline_fail (helper, error);
+		return;
+	}
+	cd_main_trace_xyz (helper->priv, xyz);
+
+	/* take a second reading of the same patch */
+	if (!helper->verifying && cd_main_display_pipeline_should_verify (helper)) {
+		cd_color_xyz_copy (xyz, &helper->xyz_first);
+		helper->verifying = TRUE;
+		cd_sensor_get_sample (helper->priv->sensor,
+				      helper->priv->device_kind,
+				      helper->priv->cancellable,
+				      cd_main_display_pipeline_sample_cb,
+				      helper);
+		return;
+	}
+	if (helper->verifying) {
+		cd_main_display_pipeline_adapt (helper, xyz);
+		helper->verifying = FALSE;
+	}
+
+	/* let the next patch render and settle while this one is saved */
+	cd_it8_get_data_item (helper->priv->it8_ti1, helper->idx, &rgb, NULL);
+	helper->idx++;
+	if (helper->idx < helper->size) {
+		cd_main_display_pipeline_show (helper);
+		if (helper->error != NULL)
+			return;
+	}
+	cd_it8_add_data (helper->priv->it8_ti3, &rgb, xyz);
+	if (!cd_state_done (helper->state, &error)) {
+		cd_main_display_pipeline_fail (helper, error);
+		return;
+	}
+	if (helper->idx == helper->size)
+		g_main_loop_quit (helper->loop);
+}
+
+static gboolean
+cd_main_display_pipeline_settle_cb (gpointer user_data)
+{
+	CdMainPipelineHelper *helper = (CdMainPipelineHelper *) user_data;
+	g_source_unref (helper->settle_source);
+	helper->settle_source = NULL;
+	cd_sensor_get_sample (helper->priv->sensor,
+			      helper->priv->device_kind,
+			      helper->priv->cancellable,
+			      cd_main_display_pipeline_sample_cb,
+			      helper);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_main_display_pipeline_show (CdMainPipelineHelper *helper)
+{
+	CdColorRGB rgb;
+	GError *error = NULL;
+
+	cd_it8_get_data_item (helper->priv->it8_ti1, helper->idx, &rgb, NULL);
+	cd_main_emit_update_sample_signal (helper->priv, &rgb);
+	if (!cd_main_set_dummy_sample (helper->priv, &rgb, &error)) {
+		cd_main_display_pipeline_fail (helper, error);
+		return;
+	}
+	helper->settle_source = cd_main_timeout_add (helper->settle,
+						     cd_main_display_pipeline_settle_cb,
+						     helper);
+}
+
+/* measures one patch at a time, but overlaps the render and settle of each
+ * patch with saving the previous reading, and learns how long the display
+ * really takes to settle rather than always waiting the full sample delay */
+static gboolean
+cd_main_display_get_samples_pipelined (CdMainPrivate *priv,
+				       CdState *state,
+				       GError **error)
+{
+	CdMainPipelineHelper helper = { 0 };
+
+	helper.priv = priv;
+	helper.state = state;
+	helper.size = cd_it8_get_data_size (priv->it8_ti1);
+	helper.settle = MAX (priv->sample_delay, CD_MAIN_SETTLE_MIN);
+	if (helper.size == 0)
+		return TRUE;
+
+	helper.loop = g_main_loop_new (g_main_context_get_thread_default (), FALSE);
+	cd_main_display_pipeline_show (&helper);
+	if (helper.error == NULL)
+		g_main_loop_run (helper.loop);
+	g_main_loop_unref (helper.loop);
+
+	/* the sensor reply is always received before the loop quits */
+	if (helper.error != NULL) {
+		g_propagate_error (error, helper.error);
+		return FALSE;
+	}
+	g_debug ("final settle delay %ums", helper.settle);
+	return TRUE;
+}
+
+/* one patch at a time, as there is nothing to overlap */
+static gboolean
+cd_main_display_get_samples_offline (CdMainPrivate *priv,
+				     CdState *state,
+				     GError **error)
 {
 	CdColorRGB rgb;
 	CdColorXYZ xyz;
@@ -1094,25 +2717,48 @@ cd_main_display_get_samples (CdMainPrivate *priv,
 	guint size;
 
 	size = cd_it8_get_data_size (priv->it8_ti1);
-	cd_state_set_number_steps (state, size);
 	for (i = 0; i < size; i++) {
-		cd_it8_get_data_item (priv->it8_ti1,
-				      i,
-				      &rgb,
-				      NULL);
+		cd_it8_get_data_item (priv->it8_ti1, i, &rgb, NULL);
 		if (!cd_main_emit_update_sample (priv, &rgb, error))
 			return FALSE;
 		if (!cd_main_calib_get_sample (priv, &xyz, error))
 			return FALSE;
 		cd_it8_add_data (priv->it8_ti3, &rgb, &xyz);
-
-		/* done */
 		if (!cd_state_done (state, error))
 			return FALSE;
 	}
 	return TRUE;
 }
 
+static gboolean
+cd_main_display_get_samples (CdMainPrivate *priv,
+			     CdState *state,
+			     GError **error)
+{
+	guint size;
+
+	size = cd_it8_get_data_size (priv->it8_ti1);
+	cd_state_set_number_steps (state, size);
+	if (cd_main_is_offline (priv))
+		return cd_main_display_get_samples_offline (priv, state, error);
+
+	/* the dummy sensor is told each color, so cannot be scheduled */
+	if (size > 1 &&
+	    cd_sensor_get_kind (priv->sensor) != CD_SENSOR_KIND_DUMMY) {
+		gboolean batched = FALSE;
+		if (!cd_main_display_get_samples_batched (priv, state, &batched, error))
+			return FALSE;
+		if (batched)
+			return TRUE;
+
+		/* start again one sample at a time */
+		cd_state_reset (state);
+		cd_state_set_number_steps (state, size);
+	}
+
+	return cd_main_display_get_samples_pipelined (priv, state, error);
+}
+
 static gboolean
 cd_main_display_characterize (CdMainPrivate *priv,
 			      CdState *state,
@@ -1125,8 +2771,8 @@ cd_main_display_characterize (CdMainPrivate *priv,
 	ret = cd_state_set_steps (state,
 				  error,
 				  1,	/* load samples */
-				  96,	/* measure samples */
-				  1,	/* run colprof */
+				  91,	/* measure samples */
+				  6,	/* run colprof */
 				  1,	/* set metadata */
 				  1,	/* import profile */
 				  -1);
@@ -1141,33 +2787,53 @@ cd_main_display_characterize (CdMainPrivate *priv,
 	if (!cd_state_done (state, error))
 		return FALSE;
 
-	/* create the ti3 file */
-	priv->it8_ti3 = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
-	cd_it8_set_normalized (priv->it8_ti3, TRUE);
-	cd_it8_set_originator (priv->it8_ti3, "colord-session");
-	cd_it8_set_title (priv->it8_ti3, priv->title);
-	cd_it8_set_spectral (priv->it8_ti3, FALSE);
-	cd_it8_set_instrument (priv->it8_ti3, cd_sensor_get_model (priv->sensor));
-
-	/* measure each sample */
-	state_local = cd_state_get_child (state);
-	ret = cd_main_display_get_samples (priv, state_local, error);
-	if (!ret)
-		return FALSE;
+	/* nothing moved since the last calibration measured these */
+	if (priv->it8_ti3_cached != NULL && !priv->calib_drifted) {
+		g_debug ("reusing samples from the last calibration");
+		priv->it8_ti3 = g_object_ref (priv->it8_ti3_cached);
+		cd_it8_set_title (priv->it8_ti3, priv->title);
+	} else {
+		/* create the ti3 file */
+		priv->it8_ti3 = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+		cd_it8_set_normalized (priv->it8_ti3, TRUE);
+		cd_it8_set_originator (priv->it8_ti3, "colord-session");
+		cd_it8_set_title (priv->it8_ti3, priv->title);
+		cd_it8_set_spectral (priv->it8_ti3, FALSE);
+		cd_it8_set_instrument (priv->it8_ti3, cd_sensor_get_model (priv->sensor));
+
+		/* measure each sample */
+		state_local = cd_state_get_child (state);
+		ret = cd_main_display_get_samples (priv, state_local, error);
+		if (!ret)
+			return FALSE;
+	}
 
 	/* done */
 	if (!cd_state_done (state, error))
 		return FALSE;
 
-	/* write out files */
-	ret = cd_main_write_colprof_files (priv, error);
+	/* the low quality profile does not need an external tool */
+	ret = cd_main_make_working_path (priv, error);
 	if (!ret)
 		return FALSE;
+	if (priv->quality == CD_PROFILE_QUALITY_LOW) {
+		g_autoptr(GError) error_local = NULL;
+		ret = cd_main_generate_profile_builtin (priv, &error_local);
+		if (!ret)
+			g_debug ("falling back to colprof: %s", error_local->message);
+	}
+	if (!ret) {
+		/* write out files */
+		ret = cd_main_write_colprof_files (priv, error);
+		if (!ret)
+			return FALSE;
 
-	/* run colprof */
-	ret = cd_main_generate_profile (priv, error);
-	if (!ret)
-		return FALSE;
+		/* run colprof */
+		state_local = cd_state_get_child (state);
+		ret = cd_main_generate_profile (priv, state_local, error);
+		if (!ret)
+			return FALSE;
+	}
 
 	/* done */
 	if (!cd_state_done (state, error))
@@ -1244,6 +2910,10 @@ cd_main_start_calibration (CdMainPrivate *priv,
 	gboolean ret;
 	g_autoptr(GError) error_local = NULL;
 
+	/* open the trace files, unless resuming */
+	if (!cd_main_trace_setup (priv, error))
+		return FALSE;
+
 	/* reset the state */
 	ret = cd_state_set_steps (state,
 				  error,
@@ -1287,6 +2957,10 @@ cd_main_start_calibration (CdMainPrivate *priv,
 	if (!ret)
 		return FALSE;
 
+	/* let the next calibration start from this one */
+	if (!cd_main_calib_cache_save (priv, &error_local))
+		g_warning ("failed to save calibration: %s", error_local->message);
+
 	/* done */
 	if (!cd_state_done (state, error))
 		return FALSE;
@@ -1301,14 +2975,14 @@ cd_main_start_calibration (CdMainPrivate *priv,
 }
 
 static gboolean
-cd_main_start_calibration_cb (gpointer user_data)
+cd_main_calibration_done_cb (gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	g_autoptr(GError) error = NULL;
+	g_autoptr(GError) error = g_steal_pointer (&priv->thread_error);
 
-	/* reset the state */
-	cd_state_reset (priv->state);
-	if (!cd_main_start_calibration (priv, priv->state, &error)) {
+	g_thread_join (priv->thread);
+	priv->thread = NULL;
+	if (error != NULL) {
 		/* use the error code if it's our error domain */
 		if (error->domain == CD_SESSION_ERROR) {
 			cd_main_emit_finished (priv,
@@ -1333,6 +3007,26 @@ cd_main_start_calibration_cb (gpointer user_data)
 	return FALSE;
 }
 
+/* the calibration blocks in nested main loops, so every session gets a
+ * thread and a main context so that the displays are measured in parallel */
+static gpointer
+cd_main_calibration_thread_cb (gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	GMainContext *context = g_main_context_new ();
+
+	g_main_context_push_thread_default (context);
+	cd_state_reset (priv->state);
+	if (!cd_main_start_calibration (priv, priv->state, &priv->thread_error))
+		g_debug ("%s failed: %s", priv->object_path, priv->thread_error->message);
+	g_main_context_pop_thread_default (context);
+	g_main_context_unref (context);
+
+	/* the D-Bus replies and clean up happen in the main thread */
+	g_idle_add (cd_main_calibration_done_cb, priv);
+	return NULL;
+}
+
 static const gchar *
 cd_main_status_to_text (CdSessionStatus status)
 {
@@ -1353,9 +3047,9 @@ cd_main_sender_vanished_cb (GDBusConnection *connection,
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 
 	/* FIXME: make configurable? */
-	g_debug ("Quitting daemon as sender has quit");
+	g_debug ("Stopping %s as sender has quit", priv->object_path);
 	g_cancellable_cancel (priv->cancellable);
-	g_main_loop_quit (priv->loop);
+	cd_main_session_done (priv);
 }
 
 static CdDevice *
@@ -1504,14 +3198,45 @@ static gboolean
 cd_main_quit_loop_cb (gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	if (priv->sensor)
-		cd_sensor_unlock_sync(priv->sensor, NULL, NULL);
-	if (priv->device)
-		cd_device_profiling_uninhibit_sync(priv->device, NULL, NULL);
-	g_main_loop_quit (priv->loop);
+	cd_main_session_done (priv);
 	return G_SOURCE_REMOVE;
 }
 
+static gboolean
+cd_main_session_check_unused (CdMainPrivate *priv,
+			      const gchar *device_id,
+			      const gchar *sensor_id,
+			      GError **error)
+{
+	GPtrArray *sessions = priv->daemon->sessions;
+	guint i;
+
+	for (i = 0; i < sessions->len; i++) {
+		CdMainPrivate *priv_tmp = g_ptr_array_index (sessions, i);
+		if (priv_tmp == priv || priv_tmp->finished)
+			continue;
+		if (priv_tmp->device != NULL &&
+		    g_strcmp0 (cd_device_get_id (priv_tmp->device), device_id) == 0) {
+			g_set_error (error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_INTERNAL,
+				     "%s is already being calibrated by %s",
+				     device_id, priv_tmp->object_path);
+			return FALSE;
+		}
+		if (priv_tmp->sensor != NULL &&
+		    g_strcmp0 (cd_sensor_get_id (priv_tmp->sensor), sensor_id) == 0) {
+			g_set_error (error,
+				     CD_SESSION_ERROR,
+				     CD_SESSION_ERROR_INTERNAL,
+				     "%s is already being used by %s",
+				     sensor_id, priv_tmp->object_path);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 static void
 cd_main_daemon_method_call (GDBusConnection *connection,
 			    const gchar *sender,
@@ -1577,6 +3302,14 @@ cd_main_daemon_method_call (GDBusConnection *connection,
 			} else if (g_strcmp0 (prop_key, "Gamma") == 0) {
 				priv->target_gamma = g_variant_get_double (prop_value);
 				g_debug ("Gamma: %.2f", priv->target_gamma);
+			} else if (g_strcmp0 (prop_key, "UpdateGammaPoint") == 0) {
+				priv->gamma_point_updates = g_variant_get_boolean (prop_value);
+				g_debug ("Gamma point updates: %s",
+					 priv->gamma_point_updates ? "yes" : "no");
+			} else if (g_strcmp0 (prop_key, "DriftCheck") == 0) {
+				priv->drift_check = g_variant_get_boolean (prop_value);
+				g_debug ("Drift check: %s",
+					 priv->drift_check ? "yes" : "no");
 			} else {
 				/* not a fatal warning */
 				g_warning ("option %s unsupported", prop_key);
@@ -1595,6 +3328,20 @@ cd_main_daemon_method_call (GDBusConnection *connection,
 							       cd_main_status_to_text (priv->status));
 			return;
 		}
+		if (priv->finished || priv->device != NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SESSION_ERROR,
+							       CD_SESSION_ERROR_INTERNAL,
+							       "cannot start as %s has already been used",
+							       priv->object_path);
+			return;
+		}
+
+		/* one sensor can only measure one display */
+		if (!cd_main_session_check_unused (priv, device_id, sensor_id, &error)) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
 
 		/* check the quality argument */
 		if (priv->quality > 2) {
@@ -1659,6 +3406,9 @@ cd_main_daemon_method_call (GDBusConnection *connection,
 		/* set the filename of all the calibrated files */
 		cd_main_set_basename (priv);
 
+		/* use a correction for this sensor and display if installed */
+		cd_main_load_correction (priv);
+
 		/* ask the user to attach the device to the screen if
 		 * the sensor is external, otherwise to shut the lid */
 		if (cd_sensor_get_embedded (priv->sensor)) {
@@ -1702,9 +3452,19 @@ cd_main_daemon_method_call (GDBusConnection *connection,
 			return;
 		}
 
+		if (priv->thread != NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SESSION_ERROR,
+							       CD_SESSION_ERROR_INTERNAL,
+							       "cannot resume as still stopping");
+			return;
+		}
+
 		/* actually start the process now */
 		priv->status = CD_SESSION_STATUS_RUNNING;
-		g_idle_add (cd_main_start_calibration_cb, priv);
+		priv->thread = g_thread_new ("colord-session",
+					     cd_main_calibration_thread_cb,
+					     priv);
 		g_dbus_method_invocation_return_value (invocation, NULL);
 		return;
 	}
@@ -1721,14 +3481,6 @@ cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 
-	/* main interface */
-	if (g_strcmp0 (interface_name, CD_SESSION_DBUS_INTERFACE) == 0) {
-		if (g_strcmp0 (property_name, "DaemonVersion") == 0)
-			return g_variant_new_string (VERSION);
-		g_critical ("failed to get %s property %s", interface_name, property_name);
-		return NULL;
-	}
-
 	/* display interface */
 	if (g_strcmp0 (interface_name, CD_SESSION_DBUS_INTERFACE_DISPLAY) == 0) {
 		if (g_strcmp0 (property_name, "Progress") == 0)
@@ -1740,74 +3492,6 @@ cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
 	return NULL;
 }
 
-static void
-cd_main_on_bus_acquired_cb (GDBusConnection *connection,
-			    const gchar *name,
-			    gpointer user_data)
-{
-	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	guint registration_id;
-	guint i;
-	static const GDBusInterfaceVTable interface_vtable = {
-		cd_main_daemon_method_call,
-		cd_main_daemon_get_property,
-		NULL
-	};
-
-	priv->connection = g_object_ref (connection);
-	for (i = 0; i < 2; i++) {
-		registration_id = g_dbus_connection_register_object (connection,
-								     CD_SESSION_DBUS_PATH,
-								     priv->introspection->interfaces[i],
-								     &interface_vtable,
-								     priv,  /* user_data */
-								     NULL,  /* user_data_free_func */
-								     NULL); /* GError** */
-		g_assert (registration_id > 0);
-	}
-}
-
-static void
-cd_main_on_name_acquired_cb (GDBusConnection *connection,
-			     const gchar *name,
-			     gpointer user_data)
-{
-	g_debug ("CdMain: acquired name: %s", name);
-}
-
-static void
-cd_main_on_name_lost_cb (GDBusConnection *connection,
-			 const gchar *name,
-			 gpointer user_data)
-{
-	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	g_debug ("CdMain: lost name: %s", name);
-	g_main_loop_quit (priv->loop);
-}
-
-static gboolean
-cd_main_timed_exit_cb (gpointer user_data)
-{
-	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	g_main_loop_quit (priv->loop);
-	return G_SOURCE_REMOVE;
-}
-
-static GDBusNodeInfo *
-cd_main_load_introspection (const gchar *filename, GError **error)
-{
-	g_autofree gchar *data = NULL;
-	g_autoptr(GFile) file = NULL;
-
-	/* load file */
-	file = g_file_new_for_path (filename);
-	if (!g_file_load_contents (file, NULL, &data, NULL, NULL, error))
-		return NULL;
-
-	/* build introspection from XML */
-	return g_dbus_node_info_new_for_xml (data, error);
-}
-
 static void
 cd_main_emit_property_changed (CdMainPrivate *priv,
 			       const gchar *property_name,
@@ -1825,7 +3509,7 @@ cd_main_emit_property_changed (CdMainPrivate *priv,
 			       property_value);
 	g_dbus_connection_emit_signal (priv->connection,
 				       NULL,
-				       CD_SESSION_DBUS_PATH,
+				       priv->object_path,
 				       "org.freedesktop.DBus.Properties",
 				       "PropertiesChanged",
 				       g_variant_new ("(sa{sv}as)",
@@ -1841,46 +3525,246 @@ cd_main_percentage_changed_cb (CdState *state,
 			       CdMainPrivate *priv)
 {
 	g_debug ("CdMain: Emitting PropertiesChanged(Progress) %u", value);
+	priv->progress = value;
 	cd_main_emit_property_changed (priv,
 				       "Progress",
 				       g_variant_new_uint32 (value));
 }
 
-int
-main (int argc, char *argv[])
+static void
+cd_main_session_free (CdMainPrivate *priv)
+{
+	if (priv->registration_id != 0)
+		g_dbus_connection_unregister_object (priv->connection,
+						     priv->registration_id);
+	if (priv->watcher_id != 0)
+		g_bus_unwatch_name (priv->watcher_id);
+	if (priv->array != NULL)
+		g_ptr_array_unref (priv->array);
+	if (priv->sensor != NULL)
+		g_object_unref (priv->sensor);
+	if (priv->device != NULL)
+		g_object_unref (priv->device);
+	if (priv->profile != NULL)
+		g_object_unref (priv->profile);
+	if (priv->cancellable != NULL)
+		g_object_unref (priv->cancellable);
+	if (priv->it8_cal != NULL)
+		g_object_unref (priv->it8_cal);
+	if (priv->it8_ti1 != NULL)
+		g_object_unref (priv->it8_ti1);
+	if (priv->it8_ti3 != NULL)
+		g_object_unref (priv->it8_ti3);
+	if (priv->it8_ti3_cached != NULL)
+		g_object_unref (priv->it8_ti3_cached);
+	if (priv->it8_ccmx != NULL)
+		g_object_unref (priv->it8_ccmx);
+	if (priv->gamma_sent != NULL)
+		g_array_unref (priv->gamma_sent);
+	if (priv->sim_gamma != NULL)
+		g_array_unref (priv->sim_gamma);
+	if (priv->trace_out != NULL) {
+		g_output_stream_close (priv->trace_out, NULL, NULL);
+		g_object_unref (priv->trace_out);
+	}
+	g_strfreev (priv->trace_lines);
+	g_clear_error (&priv->trace_error);
+	if (priv->state != NULL)
+		g_object_unref (priv->state);
+	g_clear_error (&priv->thread_error);
+	g_free (priv->object_path);
+	g_free (priv->working_path);
+	g_free (priv->basename);
+	g_free (priv->title);
+	g_free (priv);
+}
+
+static CdMainPrivate *
+cd_main_session_new (CdMainDaemon *daemon,
+		     const gchar *object_path,
+		     GError **error)
 {
 	CdMainPrivate *priv;
-	gboolean ret;
-	gboolean timed_exit = FALSE;
-	GOptionContext *context;
-	guint owner_id = 0;
-	guint retval = 1;
-	const GOptionEntry options[] = {
-		{ "timed-exit", '\0', 0, G_OPTION_ARG_NONE, &timed_exit,
-		  "Exit after a small delay", NULL },
-		{ NULL}
+	static const GDBusInterfaceVTable interface_vtable = {
+		cd_main_daemon_method_call,
+		cd_main_daemon_get_property,
+		NULL
 	};
-	g_autoptr(GError) error = NULL;
-
-	setlocale (LC_ALL, "");
 
 	priv = g_new0 (CdMainPrivate, 1);
+	priv->daemon = daemon;
+	priv->client = daemon->client;
+	priv->connection = daemon->connection;
+	priv->object_path = g_strdup (object_path);
 	priv->gamma_scale_factor = 10.0f;
 	priv->status = CD_SESSION_STATUS_IDLE;
 	priv->interaction_code_last = CD_SESSION_INTERACTION_NONE;
 	priv->cancellable = g_cancellable_new ();
-	priv->loop = g_main_loop_new (NULL, FALSE);
-	priv->settings = g_settings_new ("org.freedesktop.ColorHelper");
-	priv->sample_delay = g_settings_get_int (priv->settings, "sample-delay");
+	priv->sample_delay = g_settings_get_int (daemon->settings, "sample-delay");
 
 	/* track progress of the calibration */
 	priv->state = cd_state_new ();
 	cd_state_set_enable_profile (priv->state, TRUE);
+	cd_state_set_emit_interval (priv->state, 250);
 	g_signal_connect (priv->state,
 			  "percentage-changed",
 			  G_CALLBACK (cd_main_percentage_changed_cb),
 			  priv);
 
+	/* each session gets its own display interface */
+	priv->registration_id = g_dbus_connection_register_object (daemon->connection,
+								   object_path,
+								   (GDBusInterfaceInfo *) &cd_color_helper_display_interface,
+								   &interface_vtable,
+								   priv,  /* user_data */
+								   NULL,  /* user_data_free_func */
+								   error);
+	if (priv->registration_id == 0) {
+		cd_main_session_free (priv);
+		return NULL;
+	}
+	g_ptr_array_add (daemon->sessions, priv);
+	return priv;
+}
+
+static void
+cd_main_daemon_main_method_call (GDBusConnection *connection,
+				 const gchar *sender,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *method_name,
+				 GVariant *parameters,
+				 GDBusMethodInvocation *invocation,
+				 gpointer user_data)
+{
+	CdMainDaemon *daemon = (CdMainDaemon *) user_data;
+	CdMainPrivate *priv;
+	g_autofree gchar *session_path = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (g_strcmp0 (method_name, "CreateSession") == 0) {
+		session_path = g_strdup_printf ("%s/%u",
+						CD_SESSION_DBUS_PATH_SESSIONS,
+						++daemon->sessions_created);
+		g_debug ("CdMain: %s:CreateSession() = %s", sender, session_path);
+		priv = cd_main_session_new (daemon, session_path, &error);
+		if (priv == NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SESSION_ERROR,
+							       CD_SESSION_ERROR_INTERNAL,
+							       "failed to create session: %s",
+							       error->message);
+			return;
+		}
+		g_dbus_method_invocation_return_value (invocation,
+						       g_variant_new ("(o)", session_path));
+		return;
+	}
+
+	/* we suck */
+	g_critical ("failed to process method %s", method_name);
+}
+
+static GVariant *
+cd_main_daemon_main_get_property (GDBusConnection *connection_, const gchar *sender,
+				  const gchar *object_path, const gchar *interface_name,
+				  const gchar *property_name, GError **error,
+				  gpointer user_data)
+{
+	if (g_strcmp0 (property_name, "DaemonVersion") == 0)
+		return g_variant_new_string (VERSION);
+	g_critical ("failed to get %s property %s", interface_name, property_name);
+	return NULL;
+}
+
+static void
+cd_main_on_bus_acquired_cb (GDBusConnection *connection,
+			    const gchar *name,
+			    gpointer user_data)
+{
+	CdMainDaemon *daemon = (CdMainDaemon *) user_data;
+	CdMainPrivate *priv;
+	guint registration_id;
+	static const GDBusInterfaceVTable interface_vtable = {
+		cd_main_daemon_main_method_call,
+		cd_main_daemon_main_get_property,
+		NULL
+	};
+
+	daemon->connection = g_object_ref (connection);
+	registration_id = g_dbus_connection_register_object (connection,
+							     CD_SESSION_DBUS_PATH,
+							     (GDBusInterfaceInfo *) &cd_color_helper_interface,
+							     &interface_vtable,
+							     daemon,  /* user_data */
+							     NULL,  /* user_data_free_func */
+							     NULL); /* GError** */
+	g_assert (registration_id > 0);
+
+	/* the session that existing clients use */
+	priv = cd_main_session_new (daemon, CD_SESSION_DBUS_PATH, NULL);
+	g_assert (priv != NULL);
+}
+
+static void
+cd_main_on_name_acquired_cb (GDBusConnection *connection,
+			     const gchar *name,
+			     gpointer user_data)
+{
+	g_debug ("CdMain: acquired name: %s", name);
+}
+
+static void
+cd_main_on_name_lost_cb (GDBusConnection *connection,
+			 const gchar *name,
+			 gpointer user_data)
+{
+	CdMainDaemon *daemon = (CdMainDaemon *) user_data;
+	g_debug ("CdMain: lost name: %s", name);
+	g_main_loop_quit (daemon->loop);
+}
+
+static gboolean
+cd_main_timed_exit_cb (gpointer user_data)
+{
+	CdMainDaemon *daemon = (CdMainDaemon *) user_data;
+	g_main_loop_quit (daemon->loop);
+	return G_SOURCE_REMOVE;
+}
+
+int
+main (int argc, char *argv[])
+{
+	CdMainDaemon *daemon;
+	gboolean ret;
+	gboolean simulate = FALSE;
+	gboolean timed_exit = FALSE;
+	gchar *replay_filename = NULL;
+	gchar *trace_filename = NULL;
+	GOptionContext *context;
+	guint i;
+	guint owner_id = 0;
+	guint retval = 1;
+	const GOptionEntry options[] = {
+		{ "timed-exit", '\0', 0, G_OPTION_ARG_NONE, &timed_exit,
+		  "Exit after a small delay", NULL },
+		{ "trace", '\0', 0, G_OPTION_ARG_FILENAME, &trace_filename,
+		  "Record every update and measurement to a file", NULL },
+		{ "replay", '\0', 0, G_OPTION_ARG_FILENAME, &replay_filename,
+		  "Take measurements from a recorded trace", NULL },
+		{ "simulate", '\0', 0, G_OPTION_ARG_NONE, &simulate,
+		  "Measure a simulated display rather than using the sensor", NULL },
+		{ NULL}
+	};
+	g_autoptr(GError) error = NULL;
+
+	setlocale (LC_ALL, "");
+
+	daemon = g_new0 (CdMainDaemon, 1);
+	daemon->loop = g_main_loop_new (NULL, FALSE);
+	daemon->settings = g_settings_new ("org.freedesktop.ColorHelper");
+	daemon->sessions = g_ptr_array_new ();
+
 	/* TRANSLATORS: program name */
 	g_set_application_name ("Color Management");
 	context = g_option_context_new (NULL);
@@ -1893,20 +3777,13 @@ main (int argc, char *argv[])
 		goto out;
 	}
 	g_option_context_free (context);
-
-	/* load introspection from file */
-	priv->introspection = cd_main_load_introspection (DATADIR "/dbus-1/interfaces/"
-							  CD_SESSION_DBUS_INTERFACE ".xml",
-							  &error);
-	if (priv->introspection == NULL) {
-		g_warning ("CdMain: failed to load introspection: %s",
-			   error->message);
-		goto out;
-	}
+	daemon->trace_filename = trace_filename;
+	daemon->replay_filename = replay_filename;
+	daemon->simulate = simulate;
 
 	/* get client */
-	priv->client = cd_client_new ();
-	ret = cd_client_connect_sync (priv->client, NULL, &error);
+	daemon->client = cd_client_new ();
+	ret = cd_client_connect_sync (daemon->client, NULL, &error);
 	if (!ret) {
 		g_warning ("failed to contact colord: %s", error->message);
 		goto out;
@@ -1920,51 +3797,40 @@ main (int argc, char *argv[])
 				   cd_main_on_bus_acquired_cb,
 				   cd_main_on_name_acquired_cb,
 				   cd_main_on_name_lost_cb,
-				   priv, NULL);
+				   daemon, NULL);
 
 	/* Only timeout and close the mainloop if we have specified it
 	 * on the command line */
 	if (timed_exit)
-		g_timeout_add_seconds (5, cd_main_timed_exit_cb, priv);
+		g_timeout_add_seconds (5, cd_main_timed_exit_cb, daemon);
 
 	/* wait */
-	g_main_loop_run (priv->loop);
+	g_main_loop_run (daemon->loop);
 
 	/* success */
 	retval = 0;
 out:
 	if (owner_id > 0)
 		g_bus_unown_name (owner_id);
-	g_main_loop_unref (priv->loop);
-	if (priv->settings != NULL)
-		g_object_unref (priv->settings);
-	if (priv->client != NULL)
-		g_object_unref (priv->client);
-	if (priv->connection != NULL)
-		g_object_unref (priv->connection);
-	if (priv->introspection != NULL)
-		g_dbus_node_info_unref (priv->introspection);
-	if (priv->array != NULL)
-		g_ptr_array_unref (priv->array);
-	if (priv->sensor != NULL)
-		g_object_unref (priv->sensor);
-	if (priv->device != NULL)
-		g_object_unref (priv->device);
-	if (priv->profile != NULL)
-		g_object_unref (priv->profile);
-	if (priv->cancellable != NULL)
-		g_object_unref (priv->cancellable);
-	if (priv->it8_cal != NULL)
-		g_object_unref (priv->it8_cal);
-	if (priv->it8_ti1 != NULL)
-		g_object_unref (priv->it8_ti1);
-	if (priv->it8_ti3 != NULL)
-		g_object_unref (priv->it8_ti3);
-	if (priv->state != NULL)
-		g_object_unref (priv->state);
-	g_free (priv->working_path);
-	g_free (priv->basename);
-	g_free (priv->title);
-	g_free (priv);
+
+	/* let any thread that is still measuring notice it was cancelled */
+	for (i = 0; i < daemon->sessions->len; i++) {
+		CdMainPrivate *priv = g_ptr_array_index (daemon->sessions, i);
+		g_cancellable_cancel (priv->cancellable);
+		if (priv->thread != NULL)
+			g_thread_join (priv->thread);
+		cd_main_session_free (priv);
+	}
+	g_ptr_array_unref (daemon->sessions);
+	g_main_loop_unref (daemon->loop);
+	if (daemon->settings != NULL)
+		g_object_unref (daemon->settings);
+	if (daemon->client != NULL)
+		g_object_unref (daemon->client);
+	if (daemon->connection != NULL)
+		g_object_unref (daemon->connection);
+	g_free (daemon->trace_filename);
+	g_free (daemon->replay_filename);
+	g_free (daemon);
 	return retval;
 }
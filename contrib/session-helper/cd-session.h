@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 
 #define CD_SESSION_DBUS_SERVICE			"org.freedesktop.ColorHelper"
 #define CD_SESSION_DBUS_PATH			"/"
+#define CD_SESSION_DBUS_PATH_SESSIONS		"/sessions"
 #define CD_SESSION_DBUS_INTERFACE		"org.freedesktop.ColorHelper"
 #define CD_SESSION_DBUS_INTERFACE_DISPLAY	"org.freedesktop.ColorHelper.Display"
 
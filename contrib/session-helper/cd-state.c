@@ -41,6 +41,9 @@ struct _CdStatePrivate
 	GTimer			*timer;
 	guint			 current;
 	guint			 last_percentage;
+	GSource			*emit_source;
+	guint			 emit_interval;
+	gint64			 emit_last;
 	guint			*step_data;
 	guint			 steps;
 	gulong			 percentage_child_id;
@@ -83,6 +86,41 @@ cd_state_set_enable_profile (CdState *state, gboolean enable_profile)
 	state->priv->enable_profile = enable_profile;
 }
 
+/* emit percentage-changed at most every @emit_interval ms, although the
+ * last value always gets sent and 100% is never delayed */
+void
+cd_state_set_emit_interval (CdState *state, guint emit_interval)
+{
+	g_return_if_fail (CD_IS_STATE (state));
+	state->priv->emit_interval = emit_interval;
+}
+
+static void
+cd_state_cancel_emit (CdState *state)
+{
+	if (state->priv->emit_source == NULL)
+		return;
+	g_source_destroy (state->priv->emit_source);
+	g_source_unref (state->priv->emit_source);
+	state->priv->emit_source = NULL;
+}
+
+static void
+cd_state_emit_percentage (CdState *state, guint percentage)
+{
+	cd_state_cancel_emit (state);
+	state->priv->emit_last = g_get_monotonic_time ();
+	g_signal_emit (state, signals [SIGNAL_PERCENTAGE_CHANGED], 0, percentage);
+}
+
+static gboolean
+cd_state_emit_percentage_cb (gpointer user_data)
+{
+	CdState *state = CD_STATE (user_data);
+	cd_state_emit_percentage (state, state->priv->last_percentage);
+	return G_SOURCE_REMOVE;
+}
+
 static gfloat
 cd_state_discrete_to_percent (guint discrete, guint steps)
 {
@@ -137,8 +175,26 @@ cd_state_set_percentage (CdState *state, guint percentage)
 	if (state->priv->global_share < 0.001)
 		return FALSE;
 
+	/* too soon after the last one, so send the latest value later */
+	if (state->priv->emit_interval > 0 && percentage < 100) {
+		gint64 elapsed = (g_get_monotonic_time () - state->priv->emit_last) / 1000;
+		if (elapsed < state->priv->emit_interval) {
+			/* in whatever context is driving this state */
+			if (state->priv->emit_source == NULL) {
+				state->priv->emit_source =
+					g_timeout_source_new (state->priv->emit_interval - (guint) elapsed);
+				g_source_set_callback (state->priv->emit_source,
+						       cd_state_emit_percentage_cb,
+						       state, NULL);
+				g_source_attach (state->priv->emit_source,
+						 g_main_context_get_thread_default ());
+			}
+			return TRUE;
+		}
+	}
+
 	/* emit */
-	g_signal_emit (state, signals [SIGNAL_PERCENTAGE_CHANGED], 0, percentage);
+	cd_state_emit_percentage (state, percentage);
 	return TRUE;
 }
 
@@ -239,6 +295,7 @@ cd_state_reset (CdState *state)
 	state->priv->steps = 0;
 	state->priv->current = 0;
 	state->priv->last_percentage = 0;
+	cd_state_cancel_emit (state);
 
 	/* only use the timer if profiling; it's expensive */
 	if (state->priv->enable_profile)
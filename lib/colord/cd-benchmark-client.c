@@ -0,0 +1,489 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "cd-client.h"
+#include "cd-client-sync.h"
+#include "cd-device.h"
+#include "cd-device-sync.h"
+#include "cd-profile.h"
+#include "cd-profile-sync.h"
+#include "cd-test-shared.h"
+
+/* what meson counts as a skipped test */
+#define CD_BENCHMARK_EXIT_SKIP		77
+
+typedef enum {
+	CD_BENCHMARK_OP_FIND_DEVICE,
+	CD_BENCHMARK_OP_FIND_PROFILE_BY_FILENAME,
+	CD_BENCHMARK_OP_GET_PROFILE_FOR_QUALIFIERS,
+	CD_BENCHMARK_OP_GET_DEVICES,
+	CD_BENCHMARK_OP_CREATE_DEVICE,
+	CD_BENCHMARK_OP_LAST
+} CdBenchmarkOp;
+
+/* these are the D-Bus method names, so the results can be compared with
+ * the daemon metrics */
+static const gchar *cd_benchmark_op_names[] = {
+	"FindDeviceById",
+	"FindProfileByFilename",
+	"GetProfileForQualifiers",
+	"GetDevices",
+	"CreateDevice",
+	NULL
+};
+
+typedef struct {
+	CdClient	*client;
+	CdDevice	*device;
+	CdProfile	*profile;
+	gchar		*filename;
+	GMainLoop	*loop;
+	GRand		*rand;
+	GArray		*latencies[CD_BENCHMARK_OP_LAST];	/* of gdouble, in us */
+	guint		 errors[CD_BENCHMARK_OP_LAST];
+	guint		 weights[CD_BENCHMARK_OP_LAST];
+	guint		 weight_total;
+	guint		 in_flight;
+	guint		 created;
+	gint64		 end_time;
+	gboolean	 json;
+	gboolean	 first_result;
+} CdBenchmarkPriv;
+
+/* one request that is waiting for the daemon to reply */
+typedef struct {
+	CdBenchmarkPriv	*priv;
+	CdBenchmarkOp	 op;
+	gint64		 start;
+} CdBenchmarkRequest;
+
+static void cd_benchmark_request_send (CdBenchmarkPriv *priv);
+
+static CdBenchmarkOp
+cd_benchmark_op_from_string (const gchar *op)
+{
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++) {
+		if (g_strcmp0 (op, cd_benchmark_op_names[i]) == 0)
+			return i;
+	}
+	return CD_BENCHMARK_OP_LAST;
+}
+
+/* e.g. "FindDeviceById=4,GetDevices=1" */
+static gboolean
+cd_benchmark_parse_mix (CdBenchmarkPriv *priv, const gchar *mix, GError **error)
+{
+	g_auto(GStrv) split = g_strsplit (mix, ",", -1);
+
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++)
+		priv->weights[i] = 0;
+	priv->weight_total = 0;
+	for (guint i = 0; split[i] != NULL; i++) {
+		CdBenchmarkOp op;
+		guint64 weight = 1;
+		g_auto(GStrv) kv = g_strsplit (g_strstrip (split[i]), "=", 2);
+		op = cd_benchmark_op_from_string (kv[0]);
+		if (op == CD_BENCHMARK_OP_LAST) {
+			g_set_error (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_INVALID_ARGUMENT,
+				     "unknown method '%s'", kv[0]);
+			return FALSE;
+		}
+		if (kv[1] != NULL &&
+		    !g_ascii_string_to_unsigned (kv[1], 10, 0, G_MAXUINT16,
+						 &weight, error))
+			return FALSE;
+		priv->weights[op] += weight;
+		priv->weight_total += weight;
+	}
+	if (priv->weight_total == 0) {
+		g_set_error_literal (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_INVALID_ARGUMENT,
+				     "no methods in the mix");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static CdBenchmarkOp
+cd_benchmark_op_random (CdBenchmarkPriv *priv)
+{
+	guint val = g_rand_int_range (priv->rand, 0, priv->weight_total);
+
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++) {
+		if (val < priv->weights[i])
+			return i;
+		val -= priv->weights[i];
+	}
+	g_assert_not_reached ();
+}
+
+/* a temporary device with one profile, removed when we disconnect */
+static gboolean
+cd_benchmark_setup (CdBenchmarkPriv *priv, GError **error)
+{
+	g_autofree gchar *device_id = NULL;
+	g_autofree gchar *profile_id = NULL;
+	g_autoptr(GHashTable) device_props = NULL;
+	g_autoptr(GHashTable) profile_props = NULL;
+
+	device_id = g_strdup_printf ("colord-benchmark-client-%i", (gint) getpid ());
+	device_props = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_insert (device_props,
+			     g_strdup (CD_DEVICE_PROPERTY_KIND),
+			     g_strdup ("printer"));
+	priv->device = cd_client_create_device_sync (priv->client,
+						     device_id,
+						     CD_OBJECT_SCOPE_TEMP,
+						     device_props,
+						     NULL,
+						     error);
+	if (priv->device == NULL)
+		return FALSE;
+	if (!cd_device_connect_sync (priv->device, NULL, error))
+		return FALSE;
+
+	profile_id = g_strdup_printf ("colord-benchmark-client-%i", (gint) getpid ());
+	profile_props = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_insert (profile_props,
+			     g_strdup (CD_PROFILE_PROPERTY_FILENAME),
+			     g_strdup (priv->filename));
+	g_hash_table_insert (profile_props,
+			     g_strdup (CD_PROFILE_PROPERTY_FORMAT),
+			     g_strdup ("ColorSpace.Paper.Resolution"));
+	g_hash_table_insert (profile_props,
+			     g_strdup (CD_PROFILE_PROPERTY_QUALIFIER),
+			     g_strdup ("RGB.Plain.300dpi"));
+	priv->profile = cd_client_create_profile_sync (priv->client,
+						       profile_id,
+						       CD_OBJECT_SCOPE_TEMP,
+						       profile_props,
+						       NULL,
+						       error);
+	if (priv->profile == NULL)
+		return FALSE;
+	return cd_device_add_profile_sync (priv->device,
+					   CD_DEVICE_RELATION_HARD,
+					   priv->profile,
+					   NULL,
+					   error);
+}
+
+static void
+cd_benchmark_request_done (CdBenchmarkRequest *req, gboolean ret, const GError *error)
+{
+	CdBenchmarkPriv *priv = req->priv;
+	gdouble elapsed = g_get_monotonic_time () - req->start;
+
+	if (ret) {
+		g_array_append_val (priv->latencies[req->op], elapsed);
+	} else {
+		g_debug ("%s failed: %s",
+			 cd_benchmark_op_names[req->op], error->message);
+		priv->errors[req->op]++;
+	}
+	g_free (req);
+
+	/* each client sends the next request as soon as it has the reply */
+	if (g_get_monotonic_time () < priv->end_time) {
+		cd_benchmark_request_send (priv);
+		return;
+	}
+	if (--priv->in_flight == 0)
+		g_main_loop_quit (priv->loop);
+}
+
+static void
+cd_benchmark_object_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdBenchmarkRequest *req = (CdBenchmarkRequest *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GObject) obj = NULL;
+
+	switch (req->op) {
+	case CD_BENCHMARK_OP_FIND_DEVICE:
+		obj = G_OBJECT (cd_client_find_device_finish (CD_CLIENT (source), res, &error));
+		break;
+	case CD_BENCHMARK_OP_FIND_PROFILE_BY_FILENAME:
+		obj = G_OBJECT (cd_client_find_profile_by_filename_finish (CD_CLIENT (source), res, &error));
+		break;
+	case CD_BENCHMARK_OP_GET_PROFILE_FOR_QUALIFIERS:
+		obj = G_OBJECT (cd_device_get_profile_for_qualifiers_finish (CD_DEVICE (source), res, &error));
+		break;
+	case CD_BENCHMARK_OP_CREATE_DEVICE:
+		obj = G_OBJECT (cd_client_create_device_finish (CD_CLIENT (source), res, &error));
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+	cd_benchmark_request_done (req, obj != NULL, error);
+}
+
+static void
+cd_benchmark_array_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdBenchmarkRequest *req = (CdBenchmarkRequest *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	array = cd_client_get_devices_finish (CD_CLIENT (source), res, &error);
+	cd_benchmark_request_done (req, array != NULL, error);
+}
+
+static void
+cd_benchmark_request_send (CdBenchmarkPriv *priv)
+{
+	CdBenchmarkRequest *req = g_new0 (CdBenchmarkRequest, 1);
+	const gchar *qualifiers[] = { "RGB.*.300dpi", NULL };
+
+	req->priv = priv;
+	req->op = cd_benchmark_op_random (priv);
+	req->start = g_get_monotonic_time ();
+	switch (req->op) {
+	case CD_BENCHMARK_OP_FIND_DEVICE:
+		cd_client_find_device (priv->client,
+				       cd_device_get_id (priv->device),
+				       NULL, cd_benchmark_object_cb, req);
+		break;
+	case CD_BENCHMARK_OP_FIND_PROFILE_BY_FILENAME:
+		cd_client_find_profile_by_filename (priv->client,
+						    priv->filename,
+						    NULL, cd_benchmark_object_cb, req);
+		break;
+	case CD_BENCHMARK_OP_GET_PROFILE_FOR_QUALIFIERS:
+		cd_device_get_profile_for_qualifiers (priv->device,
+						      qualifiers,
+						      NULL, cd_benchmark_object_cb, req);
+		break;
+	case CD_BENCHMARK_OP_GET_DEVICES:
+		cd_client_get_devices (priv->client,
+				       NULL, cd_benchmark_array_cb, req);
+		break;
+	case CD_BENCHMARK_OP_CREATE_DEVICE:
+	{
+		g_autofree gchar *device_id = NULL;
+		device_id = g_strdup_printf ("colord-benchmark-client-%i-%u",
+					     (gint) getpid (), priv->created++);
+		cd_client_create_device (priv->client,
+					 device_id,
+					 CD_OBJECT_SCOPE_TEMP,
+					 NULL,
+					 NULL, cd_benchmark_object_cb, req);
+		break;
+	}
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static gint
+cd_benchmark_sort_double_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble da = *((const gdouble *) a);
+	gdouble db = *((const gdouble *) b);
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
+
+/* nearest rank, on an already sorted array */
+static gdouble
+cd_benchmark_percentile (GArray *latencies, gdouble percentile)
+{
+	guint idx;
+
+	if (latencies->len == 0)
+		return 0.f;
+	idx = (guint) (percentile * (latencies->len - 1) + 0.5);
+	return g_array_index (latencies, gdouble, idx);
+}
+
+static void
+cd_benchmark_print_result (CdBenchmarkPriv *priv,
+			   const gchar *name,
+			   guint clients,
+			   GArray *latencies,
+			   guint errors,
+			   gdouble elapsed)
+{
+	gdouble p50;
+	gdouble p99;
+	gdouble throughput = 0.f;
+
+	g_array_sort (latencies, cd_benchmark_sort_double_cb);
+	p50 = cd_benchmark_percentile (latencies, 0.50);
+	p99 = cd_benchmark_percentile (latencies, 0.99);
+	if (elapsed > 0.f)
+		throughput = latencies->len / elapsed;
+	if (priv->json) {
+		g_print ("%s\n  {\"name\": \"%s\", \"clients\": %u, "
+			 "\"requests\": %u, \"errors\": %u, \"elapsed\": %.6f, "
+			 "\"throughput\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f}",
+			 priv->first_result ? "" : ",",
+			 name, clients, latencies->len, errors, elapsed,
+			 throughput, p50, p99);
+	} else {
+		g_print ("%s,%u,%u,%u,%.6f,%.1f,%.1f,%.1f\n",
+			 name, clients, latencies->len, errors, elapsed,
+			 throughput, p50, p99);
+	}
+	priv->first_result = FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+	CdBenchmarkPriv priv = { 0 };
+	gboolean json = FALSE;
+	gboolean lookup_cache = FALSE;
+	gdouble elapsed;
+	gint clients = 8;
+	gint duration = 5;
+	gint retval = EXIT_SUCCESS;
+	guint errors_total = 0;
+	g_autofree gchar *mix = NULL;
+	g_autoptr(GArray) latencies_total = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	g_autoptr(GTimer) timer = NULL;
+	const GOptionEntry options[] = {
+		{ "json", '\0', 0, G_OPTION_ARG_NONE, &json,
+		  "Output JSON rather than CSV", NULL },
+		{ "clients", '\0', 0, G_OPTION_ARG_INT, &clients,
+		  "Number of requests kept in flight", "N" },
+		{ "duration", '\0', 0, G_OPTION_ARG_INT, &duration,
+		  "How long to send requests for", "SECONDS" },
+		{ "mix", '\0', 0, G_OPTION_ARG_STRING, &mix,
+		  "Weighted methods to call, e.g. FindDeviceById=4,GetDevices=1", "MIX" },
+		{ "lookup-cache", '\0', 0, G_OPTION_ARG_NONE, &lookup_cache,
+		  "Let the client cache lookups", NULL },
+		{ NULL }
+	};
+
+	setlocale (LC_ALL, "");
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context,
+				      "Measures the throughput and latency of the daemon");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse arguments: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	/* the numbers are printed in the C locale */
+	setlocale (LC_NUMERIC, "C");
+
+	priv.json = json;
+	priv.first_result = TRUE;
+	priv.rand = g_rand_new ();
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++)
+		priv.latencies[i] = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	if (!cd_benchmark_parse_mix (&priv,
+				     mix != NULL ? mix :
+				     "FindDeviceById=4,"
+				     "FindProfileByFilename=2,"
+				     "GetProfileForQualifiers=2,"
+				     "GetDevices=1,"
+				     "CreateDevice=1",
+				     &error)) {
+		g_printerr ("Failed to parse mix: %s\n", error->message);
+		retval = EXIT_FAILURE;
+		goto out;
+	}
+	priv.filename = cd_test_get_filename ("ibm-t61.icc");
+	if (priv.filename == NULL) {
+		g_printerr ("No test data\n");
+		retval = CD_BENCHMARK_EXIT_SKIP;
+		goto out;
+	}
+
+	/* all the requests share one connection, like a busy session would */
+	priv.client = cd_client_new ();
+	cd_client_set_lookup_cache (priv.client, lookup_cache);
+	if (!cd_client_get_has_server (priv.client)) {
+		g_printerr ("No colord daemon running\n");
+		retval = CD_BENCHMARK_EXIT_SKIP;
+		goto out;
+	}
+	if (!cd_client_connect_sync (priv.client, NULL, &error) ||
+	    !cd_benchmark_setup (&priv, &error)) {
+		g_printerr ("Failed to set up: %s\n", error->message);
+		retval = EXIT_FAILURE;
+		goto out;
+	}
+
+	/* closed loop: each client waits for its reply before sending more */
+	priv.loop = g_main_loop_new (NULL, FALSE);
+	priv.in_flight = MAX (clients, 1);
+	timer = g_timer_new ();
+	priv.end_time = g_get_monotonic_time () + (gint64) MAX (duration, 1) * G_USEC_PER_SEC;
+	for (guint i = 0; i < priv.in_flight; i++)
+		cd_benchmark_request_send (&priv);
+	g_main_loop_run (priv.loop);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	if (priv.json)
+		g_print ("[");
+	else
+		g_print ("name,clients,requests,errors,elapsed,throughput,p50_us,p99_us\n");
+	latencies_total = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++) {
+		if (priv.weights[i] == 0)
+			continue;
+		g_array_append_vals (latencies_total,
+				     priv.latencies[i]->data,
+				     priv.latencies[i]->len);
+		errors_total += priv.errors[i];
+		cd_benchmark_print_result (&priv, cd_benchmark_op_names[i],
+					   MAX (clients, 1), priv.latencies[i],
+					   priv.errors[i], elapsed);
+	}
+	cd_benchmark_print_result (&priv, "all", MAX (clients, 1),
+				   latencies_total, errors_total, elapsed);
+	if (priv.json)
+		g_print ("\n]\n");
+out:
+	for (guint i = 0; i < CD_BENCHMARK_OP_LAST; i++)
+		g_array_unref (priv.latencies[i]);
+	if (priv.loop != NULL)
+		g_main_loop_unref (priv.loop);
+	if (priv.profile != NULL)
+		g_object_unref (priv.profile);
+	if (priv.device != NULL)
+		g_object_unref (priv.device);
+	if (priv.client != NULL)
+		g_object_unref (priv.client);
+	g_rand_free (priv.rand);
+	g_free (priv.filename);
+	return retval;
+}
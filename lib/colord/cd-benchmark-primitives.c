@@ -0,0 +1,610 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "cd-color.h"
+#include "cd-edid.h"
+#include "cd-enum.h"
+#include "cd-icc.h"
+#include "cd-icc-utils.h"
+#include "cd-it8.h"
+#include "cd-it8-utils.h"
+#include "cd-spectrum.h"
+#include "cd-test-shared.h"
+
+typedef struct {
+	GPtrArray	*profile_data;		/* of GBytes */
+	GPtrArray	*profiles;		/* of CdIcc */
+	GPtrArray	*it8_data;		/* of GBytes */
+	GPtrArray	*edid_data;		/* of GBytes */
+	GPtrArray	*illuminants;		/* of CdSpectrum */
+	CdIt8		*cmf;
+	CdIcc		*icc_reference;
+	gdouble		 min_time;
+	gboolean	 json;
+	gboolean	 first_result;
+} CdBenchmarkPriv;
+
+/* one call of this processes every item in the set once */
+typedef gboolean (*CdBenchmarkFunc)	(CdBenchmarkPriv	*priv,
+					 gconstpointer		 user_data,
+					 guint			*items,
+					 GError			**error);
+
+static void
+cd_benchmark_print_result (CdBenchmarkPriv *priv,
+			   const gchar *name,
+			   const gchar *variant,
+			   guint iterations,
+			   guint items,
+			   gdouble elapsed,
+			   const gchar *error_msg)
+{
+	gdouble ns_per_item = 0.f;
+
+	if (items > 0)
+		ns_per_item = elapsed * 1e9 / items;
+	if (priv->json) {
+		g_autofree gchar *error_esc = NULL;
+		g_print ("%s\n  {\"name\": \"%s\", \"variant\": \"%s\", "
+			 "\"iterations\": %u, \"items\": %u, "
+			 "\"elapsed\": %.6f, \"ns_per_item\": %.1f",
+			 priv->first_result ? "" : ",",
+			 name, variant != NULL ? variant : "",
+			 iterations, items, elapsed, ns_per_item);
+		if (error_msg != NULL) {
+			error_esc = g_strescape (error_msg, NULL);
+			g_print (", \"error\": \"%s\"", error_esc);
+		}
+		g_print ("}");
+	} else {
+		g_print ("%s,%s,%u,%u,%.6f,%.1f,%s\n",
+			 name, variant != NULL ? variant : "",
+			 iterations, items, elapsed, ns_per_item,
+			 error_msg != NULL ? error_msg : "");
+	}
+	priv->first_result = FALSE;
+}
+
+static void
+cd_benchmark_run (CdBenchmarkPriv *priv,
+		  const gchar *name,
+		  const gchar *variant,
+		  CdBenchmarkFunc func,
+		  gconstpointer user_data,
+		  gdouble min_time)
+{
+	gdouble elapsed = 0.f;
+	guint items = 0;
+	guint iterations = 0;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = NULL;
+
+	/* repeat until the result is not just noise */
+	timer = g_timer_new ();
+	do {
+		guint items_tmp = 0;
+		if (!func (priv, user_data, &items_tmp, &error)) {
+			cd_benchmark_print_result (priv, name, variant,
+						   0, 0, 0.f, error->message);
+			return;
+		}
+		items += items_tmp;
+		iterations++;
+		elapsed = g_timer_elapsed (timer, NULL);
+	} while (elapsed < min_time);
+	cd_benchmark_print_result (priv, name, variant,
+				   iterations, items, elapsed, NULL);
+}
+
+static gboolean
+cd_benchmark_icc_load_data (CdBenchmarkPriv *priv,
+			    gconstpointer user_data,
+			    guint *items,
+			    GError **error)
+{
+	CdIccLoadFlags flags = GPOINTER_TO_UINT (user_data);
+
+	for (guint i = 0; i < priv->profile_data->len; i++) {
+		GBytes *blob = g_ptr_array_index (priv->profile_data, i);
+		g_autoptr(CdIcc) icc = cd_icc_new ();
+		if (!cd_icc_load_data (icc,
+				       g_bytes_get_data (blob, NULL),
+				       g_bytes_get_size (blob),
+				       flags, error))
+			return FALSE;
+	}
+	*items = priv->profile_data->len;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_icc_save_data (CdBenchmarkPriv *priv,
+			    gconstpointer user_data,
+			    guint *items,
+			    GError **error)
+{
+	for (guint i = 0; i < priv->profiles->len; i++) {
+		CdIcc *icc = g_ptr_array_index (priv->profiles, i);
+		g_autoptr(GBytes) blob = NULL;
+		blob = cd_icc_save_data (icc, CD_ICC_SAVE_FLAGS_NONE, error);
+		if (blob == NULL)
+			return FALSE;
+	}
+	*items = priv->profiles->len;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_spectrum_get_value_for_nm (CdBenchmarkPriv *priv,
+					gconstpointer user_data,
+					guint *items,
+					GError **error)
+{
+	gdouble sum = 0.f;
+
+	/* deliberately off the sample points so it interpolates */
+	for (guint i = 0; i < priv->illuminants->len; i++) {
+		CdSpectrum *sp = g_ptr_array_index (priv->illuminants, i);
+		for (guint j = 0; j < 1600; j++)
+			sum += cd_spectrum_get_value_for_nm (sp, 380.f + j * 0.25f + 0.1f);
+	}
+	if (sum < 0.f) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "illuminant has negative power");
+		return FALSE;
+	}
+	*items = priv->illuminants->len * 1600;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_spectrum_resample (CdBenchmarkPriv *priv,
+				gconstpointer user_data,
+				guint *items,
+				GError **error)
+{
+	gdouble resolution = *((const gdouble *) user_data);
+
+	for (guint i = 0; i < priv->illuminants->len; i++) {
+		CdSpectrum *sp = g_ptr_array_index (priv->illuminants, i);
+		g_autoptr(CdSpectrum) sp_tmp = NULL;
+		sp_tmp = cd_spectrum_resample (sp, 380.f, 780.f, resolution);
+		if (sp_tmp == NULL) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "failed to resample %s",
+				     cd_spectrum_get_id (sp));
+			return FALSE;
+		}
+	}
+	*items = priv->illuminants->len;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_it8_load_from_data (CdBenchmarkPriv *priv,
+				 gconstpointer user_data,
+				 guint *items,
+				 GError **error)
+{
+	for (guint i = 0; i < priv->it8_data->len; i++) {
+		GBytes *blob = g_ptr_array_index (priv->it8_data, i);
+		g_autoptr(CdIt8) it8 = cd_it8_new ();
+		if (!cd_it8_load_from_data (it8,
+					    g_bytes_get_data (blob, NULL),
+					    g_bytes_get_size (blob),
+					    error))
+			return FALSE;
+	}
+	*items = priv->it8_data->len;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_it8_utils_calculate_xyz_from_cmf (CdBenchmarkPriv *priv,
+					       gconstpointer user_data,
+					       guint *items,
+					       GError **error)
+{
+	gdouble resolution = *((const gdouble *) user_data);
+	g_autoptr(CdSpectrum) unity = cd_spectrum_new ();
+
+	/* the emissive case, so the reflectance is always 1.0 */
+	for (guint i = 0; i < priv->illuminants->len; i++) {
+		CdColorXYZ value;
+		CdSpectrum *sp = g_ptr_array_index (priv->illuminants, i);
+		if (!cd_it8_utils_calculate_xyz_from_cmf (priv->cmf, sp, unity,
+							  &value, resolution,
+							  error))
+			return FALSE;
+	}
+	*items = priv->illuminants->len;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_color_rgb_array_interpolate (CdBenchmarkPriv *priv,
+					  gconstpointer user_data,
+					  guint *items,
+					  GError **error)
+{
+	guint new_length = GPOINTER_TO_UINT (user_data);
+	g_autoptr(GPtrArray) array = cd_color_rgb_array_new ();
+	g_autoptr(GPtrArray) result = NULL;
+
+	/* a typical VCGT-sized gamma ramp */
+	for (guint i = 0; i < 256; i++) {
+		CdColorRGB *rgb = cd_color_rgb_new ();
+		gdouble tmp = (gdouble) i / 255.f;
+		cd_color_rgb_set (rgb, tmp * tmp, tmp, tmp * 0.9f);
+		g_ptr_array_add (array, rgb);
+	}
+	result = cd_color_rgb_array_interpolate (array, new_length);
+	if (result == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "failed to interpolate to %u", new_length);
+		return FALSE;
+	}
+	*items = 1;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_icc_utils_get_coverage (CdBenchmarkPriv *priv,
+				     gconstpointer user_data,
+				     guint *items,
+				     GError **error)
+{
+	guint cnt = 0;
+
+	for (guint i = 0; i < priv->profiles->len; i++) {
+		CdIcc *icc = g_ptr_array_index (priv->profiles, i);
+		gdouble coverage = 0.f;
+		if (icc == priv->icc_reference)
+			continue;
+		if (cd_icc_get_colorspace (icc) != CD_COLORSPACE_RGB)
+			continue;
+		if (cd_icc_get_kind (icc) != CD_PROFILE_KIND_DISPLAY_DEVICE &&
+		    cd_icc_get_kind (icc) != CD_PROFILE_KIND_COLORSPACE_CONVERSION)
+			continue;
+		if (!cd_icc_utils_get_coverage (icc, priv->icc_reference,
+						&coverage, error))
+			return FALSE;
+		cnt++;
+	}
+	*items = cnt;
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_edid_parse (CdBenchmarkPriv *priv,
+			 gconstpointer user_data,
+			 guint *items,
+			 GError **error)
+{
+	for (guint i = 0; i < priv->edid_data->len; i++) {
+		GBytes *blob = g_ptr_array_index (priv->edid_data, i);
+		g_autoptr(CdEdid) edid = cd_edid_new ();
+		if (!cd_edid_parse (edid, blob, error))
+			return FALSE;
+	}
+	*items = priv->edid_data->len;
+	return TRUE;
+}
+
+static gint
+cd_benchmark_sort_filename_cb (gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+/* sorted, so that the order of the results is reproducible */
+static GPtrArray *
+cd_benchmark_get_filenames (const gchar *path, const gchar *suffix)
+{
+	const gchar *tmp;
+	GPtrArray *filenames = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GDir) dir = NULL;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return filenames;
+	while ((tmp = g_dir_read_name (dir)) != NULL) {
+		if (!g_str_has_suffix (tmp, suffix))
+			continue;
+		g_ptr_array_add (filenames, g_build_filename (path, tmp, NULL));
+	}
+	g_ptr_array_sort (filenames, cd_benchmark_sort_filename_cb);
+	return filenames;
+}
+
+static gboolean
+cd_benchmark_add_file (GPtrArray *array, const gchar *filename, GError **error)
+{
+	gchar *data = NULL;
+	gsize len = 0;
+
+	if (!g_file_get_contents (filename, &data, &len, error)) {
+		g_prefix_error (error, "failed to load %s: ", filename);
+		return FALSE;
+	}
+	g_ptr_array_add (array, g_bytes_new_take (data, len));
+	return TRUE;
+}
+
+static gboolean
+cd_benchmark_add_test_file (GPtrArray *array, const gchar *basename, GError **error)
+{
+	g_autofree gchar *filename = cd_test_get_filename (basename);
+	if (filename == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+			     "failed to find %s, set TESTDATADIR", basename);
+		return FALSE;
+	}
+	return cd_benchmark_add_file (array, filename, error);
+}
+
+static gboolean
+cd_benchmark_load_data (CdBenchmarkPriv *priv,
+			const gchar *profile_dir,
+			const gchar *cmf_dir,
+			const gchar *illuminant_dir,
+			GError **error)
+{
+	const gchar *test_edids[] = { "DELL-U2713H.bin",
+				      "LG-L225W-External.bin",
+				      "Lenovo-T61-Internal.bin",
+				      NULL };
+	const gchar *test_it8s[] = { "calibration.ccmx",
+				     "example.cmf",
+				     "example.sp",
+				     "measured.ti3",
+				     "normalised.ti3",
+				     "raw.ti3",
+				     "reference.ti3",
+				     "test.ccss",
+				     "test.sp",
+				     NULL };
+	g_autofree gchar *cmf_filename = NULL;
+
+	/* the bundled profiles, plus the ones only found in the tests */
+	if (profile_dir != NULL) {
+		g_autoptr(GPtrArray) filenames = NULL;
+		filenames = cd_benchmark_get_filenames (profile_dir, ".icc");
+		for (guint i = 0; i < filenames->len; i++) {
+			if (!cd_benchmark_add_file (priv->profile_data,
+						    g_ptr_array_index (filenames, i),
+						    error))
+				return FALSE;
+		}
+	}
+	if (!cd_benchmark_add_test_file (priv->profile_data, "ibm-t61.icc", error))
+		return FALSE;
+	if (!cd_benchmark_add_test_file (priv->profile_data, "crayons.icc", error))
+		return FALSE;
+	for (guint i = 0; i < priv->profile_data->len; i++) {
+		GBytes *blob = g_ptr_array_index (priv->profile_data, i);
+		g_autoptr(CdIcc) icc = cd_icc_new ();
+		if (!cd_icc_load_data (icc,
+				       g_bytes_get_data (blob, NULL),
+				       g_bytes_get_size (blob),
+				       CD_ICC_LOAD_FLAGS_ALL, error))
+			return FALSE;
+		if (priv->icc_reference == NULL &&
+		    g_strcmp0 (cd_icc_get_metadata_item (icc, CD_PROFILE_METADATA_STANDARD_SPACE),
+			       "srgb") == 0)
+			priv->icc_reference = icc;
+		g_ptr_array_add (priv->profiles, g_steal_pointer (&icc));
+	}
+
+	/* the built sRGB profile is not always available */
+	if (priv->icc_reference == NULL) {
+		priv->icc_reference = cd_icc_new ();
+		if (!cd_icc_create_default_full (priv->icc_reference,
+						 CD_ICC_LOAD_FLAGS_FALLBACK_MD5,
+						 error))
+			return FALSE;
+		g_ptr_array_add (priv->profiles, priv->icc_reference);
+	}
+
+	/* CMF, falling back to the test data */
+	if (cmf_dir != NULL) {
+		cmf_filename = g_build_filename (cmf_dir, "CIE1931-2deg-XYZ.cmf", NULL);
+		if (!g_file_test (cmf_filename, G_FILE_TEST_EXISTS))
+			g_clear_pointer (&cmf_filename, g_free);
+	}
+	if (cmf_filename == NULL)
+		cmf_filename = cd_test_get_filename ("example.cmf");
+	if (cmf_filename == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				     "no CMF, use --cmf-dir");
+		return FALSE;
+	} else {
+		g_autoptr(GFile) file = g_file_new_for_path (cmf_filename);
+		priv->cmf = cd_it8_new ();
+		if (!cd_it8_load_from_file (priv->cmf, file, error))
+			return FALSE;
+		if (!cd_benchmark_add_file (priv->it8_data, cmf_filename, error))
+			return FALSE;
+	}
+
+	/* illuminants, which are also good IT8 parser input */
+	if (illuminant_dir != NULL) {
+		g_autoptr(GPtrArray) filenames = NULL;
+		filenames = cd_benchmark_get_filenames (illuminant_dir, ".sp");
+		for (guint i = 0; i < filenames->len; i++) {
+			if (!cd_benchmark_add_file (priv->it8_data,
+						    g_ptr_array_index (filenames, i),
+						    error))
+				return FALSE;
+		}
+	}
+	for (guint i = 0; test_it8s[i] != NULL; i++) {
+		if (!cd_benchmark_add_test_file (priv->it8_data, test_it8s[i], error))
+			return FALSE;
+	}
+	for (guint i = 0; i < priv->it8_data->len; i++) {
+		GBytes *blob = g_ptr_array_index (priv->it8_data, i);
+		GPtrArray *spectra;
+		g_autoptr(CdIt8) it8 = cd_it8_new ();
+		if (!cd_it8_load_from_data (it8,
+					    g_bytes_get_data (blob, NULL),
+					    g_bytes_get_size (blob),
+					    error))
+			return FALSE;
+		if (cd_it8_get_kind (it8) != CD_IT8_KIND_SPECT)
+			continue;
+		spectra = cd_it8_get_spectrum_array (it8);
+		for (guint j = 0; j < spectra->len; j++) {
+			CdSpectrum *sp = g_ptr_array_index (spectra, j);
+			g_ptr_array_add (priv->illuminants, cd_spectrum_dup (sp));
+		}
+	}
+	if (priv->illuminants->len == 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				     "no spectra, use --illuminant-dir");
+		return FALSE;
+	}
+
+	/* EDIDs */
+	for (guint i = 0; test_edids[i] != NULL; i++) {
+		if (!cd_benchmark_add_test_file (priv->edid_data, test_edids[i], error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+	CdBenchmarkPriv priv = { 0 };
+	gboolean json = FALSE;
+	gboolean quick = FALSE;
+	const gdouble resolutions[] = { 1.f, 5.f, 0.f };
+	const guint lengths[] = { 256, 1024, 4096, 0 };
+	g_autofree gchar *cmf_dir = NULL;
+	g_autofree gchar *illuminant_dir = NULL;
+	g_autofree gchar *profile_dir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	const GOptionEntry options[] = {
+		{ "json", '\0', 0, G_OPTION_ARG_NONE, &json,
+		  "Output JSON rather than CSV", NULL },
+		{ "quick", '\0', 0, G_OPTION_ARG_NONE, &quick,
+		  "Only run each benchmark once", NULL },
+		{ "profile-dir", '\0', 0, G_OPTION_ARG_FILENAME, &profile_dir,
+		  "Directory of built profiles to use", "DIRECTORY" },
+		{ "cmf-dir", '\0', 0, G_OPTION_ARG_FILENAME, &cmf_dir,
+		  "Directory of built CMF files to use", "DIRECTORY" },
+		{ "illuminant-dir", '\0', 0, G_OPTION_ARG_FILENAME, &illuminant_dir,
+		  "Directory of built illuminant spectra to use", "DIRECTORY" },
+		{ NULL }
+	};
+
+	setlocale (LC_ALL, "");
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context,
+				      "Measures the speed of the libcolord primitives");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse arguments: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	/* the numbers are printed in the C locale */
+	setlocale (LC_NUMERIC, "C");
+
+	priv.json = json;
+	priv.first_result = TRUE;
+	priv.min_time = quick ? 0.f : 0.25f;
+	priv.profile_data = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+	priv.profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	priv.it8_data = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+	priv.edid_data = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+	priv.illuminants = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_spectrum_free);
+	if (!cd_benchmark_load_data (&priv, profile_dir, cmf_dir,
+				     illuminant_dir, &error)) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	if (priv.json)
+		g_print ("[");
+	else
+		g_print ("name,variant,iterations,items,elapsed,ns_per_item,error\n");
+
+	/* every combination of the flags that change what gets parsed */
+	for (guint flags = 0; flags < CD_ICC_LOAD_FLAGS_CHARACTERIZATION << 1; flags++) {
+		g_autofree gchar *variant = g_strdup_printf ("flags=0x%02x", flags);
+		cd_benchmark_run (&priv, "cd_icc_load_data", variant,
+				  cd_benchmark_icc_load_data,
+				  GUINT_TO_POINTER (flags), priv.min_time);
+	}
+	cd_benchmark_run (&priv, "cd_icc_save_data", NULL,
+			  cd_benchmark_icc_save_data, NULL, priv.min_time);
+	cd_benchmark_run (&priv, "cd_spectrum_get_value_for_nm", NULL,
+			  cd_benchmark_spectrum_get_value_for_nm,
+			  NULL, priv.min_time);
+	for (guint i = 0; resolutions[i] > 0.f; i++) {
+		g_autofree gchar *variant = g_strdup_printf ("resolution=%.1f", resolutions[i]);
+		cd_benchmark_run (&priv, "cd_spectrum_resample", variant,
+				  cd_benchmark_spectrum_resample,
+				  &resolutions[i], priv.min_time);
+	}
+	cd_benchmark_run (&priv, "cd_it8_load_from_data", NULL,
+			  cd_benchmark_it8_load_from_data, NULL, priv.min_time);
+	for (guint i = 0; resolutions[i] > 0.f; i++) {
+		g_autofree gchar *variant = g_strdup_printf ("resolution=%.1f", resolutions[i]);
+		cd_benchmark_run (&priv, "cd_it8_utils_calculate_xyz_from_cmf", variant,
+				  cd_benchmark_it8_utils_calculate_xyz_from_cmf,
+				  &resolutions[i], priv.min_time);
+	}
+	for (guint i = 0; lengths[i] != 0; i++) {
+		g_autofree gchar *variant = g_strdup_printf ("length=%u", lengths[i]);
+		cd_benchmark_run (&priv, "cd_color_rgb_array_interpolate", variant,
+				  cd_benchmark_color_rgb_array_interpolate,
+				  GUINT_TO_POINTER (lengths[i]), priv.min_time);
+	}
+
+	/* the results are cached by checksum, so only the first pass is real */
+	cd_benchmark_run (&priv, "cd_icc_utils_get_coverage", "uncached",
+			  cd_benchmark_icc_utils_get_coverage, NULL, 0.f);
+	cd_benchmark_run (&priv, "cd_icc_utils_get_coverage", "cached",
+			  cd_benchmark_icc_utils_get_coverage, NULL, priv.min_time);
+	cd_benchmark_run (&priv, "cd_edid_parse", NULL,
+			  cd_benchmark_edid_parse, NULL, priv.min_time);
+	if (priv.json)
+		g_print ("\n]\n");
+
+	g_ptr_array_unref (priv.profile_data);
+	g_ptr_array_unref (priv.profiles);
+	g_ptr_array_unref (priv.it8_data);
+	g_ptr_array_unref (priv.edid_data);
+	g_ptr_array_unref (priv.illuminants);
+	g_object_unref (priv.cmf);
+	return EXIT_SUCCESS;
+}
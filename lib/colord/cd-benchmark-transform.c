@@ -0,0 +1,394 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <lcms2.h>
+#include <glib.h>
+
+#include "cd-enum.h"
+#include "cd-icc.h"
+#include "cd-transform.h"
+#include "cd-transform-private.h"
+#include "cd-test-shared.h"
+
+typedef struct {
+	CdIcc		*output_rgb;
+	CdIcc		*input_cmyk;
+	CdIcc		*abstract;
+	guint		 max_size;
+	guint		 max_threads;
+	gdouble		 min_time;
+	gboolean	 json;
+	gboolean	 first_result;
+} CdBenchmarkPriv;
+
+static const CdPixelFormat cd_benchmark_formats[] = {
+	CD_PIXEL_FORMAT_ARGB32,
+	CD_PIXEL_FORMAT_RGB24,
+	CD_PIXEL_FORMAT_CMYK32,
+	CD_PIXEL_FORMAT_BGRA32,
+	CD_PIXEL_FORMAT_RGBA32,
+	CD_PIXEL_FORMAT_RGB48,
+	CD_PIXEL_FORMAT_RGBA64,
+	CD_PIXEL_FORMAT_CMYK64,
+	CD_PIXEL_FORMAT_RGB_HALF,
+	CD_PIXEL_FORMAT_RGBA_HALF,
+	CD_PIXEL_FORMAT_RGB_FLOAT,
+	CD_PIXEL_FORMAT_RGBA_FLOAT,
+	CD_PIXEL_FORMAT_RGB24_PLANAR,
+	CD_PIXEL_FORMAT_RGB48_PLANAR,
+	CD_PIXEL_FORMAT_RGB_FLOAT_PLANAR,
+	CD_PIXEL_FORMAT_CMYK32_PLANAR,
+	CD_PIXEL_FORMAT_RGB_DOUBLE,
+	CD_PIXEL_FORMAT_XYZ_DOUBLE,
+	CD_PIXEL_FORMAT_LAB_DOUBLE,
+	CD_PIXEL_FORMAT_UNKNOWN
+};
+
+/* 64x64 up to 8K UHD */
+static const guint cd_benchmark_sizes[][2] = {
+	{ 64, 64 },
+	{ 256, 256 },
+	{ 1024, 1024 },
+	{ 1920, 1080 },
+	{ 3840, 2160 },
+	{ 7680, 4320 },
+	{ 0, 0 }
+};
+
+/* the output is always RGB so that the real display profile is used */
+static CdPixelFormat
+cd_benchmark_get_output_format (CdPixelFormat format)
+{
+	switch (format) {
+	case CD_PIXEL_FORMAT_CMYK32:
+		return CD_PIXEL_FORMAT_RGBA32;
+	case CD_PIXEL_FORMAT_CMYK64:
+		return CD_PIXEL_FORMAT_RGBA64;
+	case CD_PIXEL_FORMAT_CMYK32_PLANAR:
+		return CD_PIXEL_FORMAT_RGB24_PLANAR;
+	case CD_PIXEL_FORMAT_XYZ_DOUBLE:
+	case CD_PIXEL_FORMAT_LAB_DOUBLE:
+		return CD_PIXEL_FORMAT_RGB_DOUBLE;
+	default:
+		break;
+	}
+	return format;
+}
+
+static gsize
+cd_benchmark_get_size (CdPixelFormat format,
+		       guint bpp,
+		       guint width,
+		       guint height,
+		       gsize *rowstride,
+		       gsize *planestride)
+{
+	if (T_PLANAR (format)) {
+		*rowstride = (gsize) width * bpp;
+		*planestride = *rowstride * height;
+		return *planestride * (T_CHANNELS (format) + T_EXTRA (format));
+	}
+	*rowstride = (gsize) width * bpp;
+	*planestride = 0;
+	return *rowstride * height;
+}
+
+static void
+cd_benchmark_print_result (CdBenchmarkPriv *priv,
+			   CdPixelFormat format,
+			   guint width,
+			   guint height,
+			   guint threads,
+			   gboolean bpc,
+			   gboolean abstract,
+			   guint iterations,
+			   gdouble elapsed,
+			   const gchar *error_msg)
+{
+	gdouble mpix = 0.f;
+
+	if (elapsed > 0.f)
+		mpix = (gdouble) width * height * iterations / elapsed / 1e6;
+	if (priv->json) {
+		g_autofree gchar *error_esc = NULL;
+		g_print ("%s\n  {\"format\": \"%s\", \"width\": %u, "
+			 "\"height\": %u, \"threads\": %u, \"bpc\": %s, "
+			 "\"abstract\": %s, \"iterations\": %u, "
+			 "\"elapsed\": %.6f, \"mpix_per_sec\": %.3f",
+			 priv->first_result ? "" : ",",
+			 cd_pixel_format_to_string (format),
+			 width, height, threads,
+			 bpc ? "true" : "false",
+			 abstract ? "true" : "false",
+			 iterations, elapsed, mpix);
+		if (error_msg != NULL) {
+			error_esc = g_strescape (error_msg, NULL);
+			g_print (", \"error\": \"%s\"", error_esc);
+		}
+		g_print ("}");
+	} else {
+		g_print ("%s,%u,%u,%u,%i,%i,%u,%.6f,%.3f,%s\n",
+			 cd_pixel_format_to_string (format),
+			 width, height, threads, bpc, abstract,
+			 iterations, elapsed, mpix,
+			 error_msg != NULL ? error_msg : "");
+	}
+	priv->first_result = FALSE;
+}
+
+static void
+cd_benchmark_run (CdBenchmarkPriv *priv,
+		  CdPixelFormat format,
+		  guint width,
+		  guint height,
+		  guint threads,
+		  gboolean bpc,
+		  gboolean abstract)
+{
+	CdPixelFormat format_out = cd_benchmark_get_output_format (format);
+	gdouble elapsed = 0.f;
+	gsize planestride_in;
+	gsize planestride_out;
+	gsize rowstride_in;
+	gsize rowstride_out;
+	gsize size_in;
+	gsize size_out;
+	guint iterations = 0;
+	g_autofree guint8 *data_in = NULL;
+	g_autofree guint8 *data_out = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = NULL;
+
+	/* CMYK needs a real profile to convert from */
+	if (T_COLORSPACE (format) == PT_CMYK && priv->input_cmyk == NULL) {
+		cd_benchmark_print_result (priv, format, width, height,
+					   threads, bpc, abstract, 0, 0.f,
+					   "no CMYK profile");
+		return;
+	}
+
+	transform = cd_transform_new ();
+	cd_transform_set_input_pixel_format (transform, format);
+	cd_transform_set_output_pixel_format (transform, format_out);
+	cd_transform_set_output_icc (transform, priv->output_rgb);
+	if (T_COLORSPACE (format) == PT_CMYK)
+		cd_transform_set_input_icc (transform, priv->input_cmyk);
+	if (abstract)
+		cd_transform_set_abstract_icc (transform, priv->abstract);
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_bpc (transform, bpc);
+	cd_transform_set_max_threads (transform, threads);
+
+	/* compile the transform outside of the timed section */
+	if (!cd_transform_prepare (transform, &error)) {
+		cd_benchmark_print_result (priv, format, width, height,
+					   threads, bpc, abstract, 0, 0.f,
+					   error->message);
+		return;
+	}
+
+	/* the 8K double formats need nearly a gigabyte each */
+	size_in = cd_benchmark_get_size (format,
+					 cd_transform_get_bpp_input (transform),
+					 width, height,
+					 &rowstride_in, &planestride_in);
+	size_out = cd_benchmark_get_size (format_out,
+					  cd_transform_get_bpp_output (transform),
+					  width, height,
+					  &rowstride_out, &planestride_out);
+	data_in = g_try_malloc0 (size_in);
+	data_out = g_try_malloc0 (size_out);
+	if (data_in == NULL || data_out == NULL) {
+		cd_benchmark_print_result (priv, format, width, height,
+					   threads, bpc, abstract, 0, 0.f,
+					   "not enough memory");
+		return;
+	}
+
+	/* repeat until the result is not just noise */
+	timer = g_timer_new ();
+	do {
+		if (!cd_transform_process_full (transform,
+						data_in, data_out,
+						width, height,
+						rowstride_in, rowstride_out,
+						planestride_in, planestride_out,
+						NULL, &error)) {
+			cd_benchmark_print_result (priv, format, width, height,
+						   threads, bpc, abstract, 0, 0.f,
+						   error->message);
+			return;
+		}
+		iterations++;
+		elapsed = g_timer_elapsed (timer, NULL);
+	} while (elapsed < priv->min_time);
+
+	cd_benchmark_print_result (priv, format, width, height,
+				   threads, bpc, abstract,
+				   iterations, elapsed, NULL);
+}
+
+static CdIcc *
+cd_benchmark_load_icc (const gchar *filename, GError **error)
+{
+	g_autoptr(CdIcc) icc = cd_icc_new ();
+	g_autoptr(GFile) file = g_file_new_for_path (filename);
+	if (!cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_FALLBACK_MD5,
+			       NULL, error))
+		return NULL;
+	return g_steal_pointer (&icc);
+}
+
+static CdIcc *
+cd_benchmark_create_abstract (GError **error)
+{
+	cmsHPROFILE lcms_profile;
+	g_autoptr(CdIcc) icc = cd_icc_new ();
+
+	/* a typical "warm and saturated" look */
+	lcms_profile = cmsCreateBCHSWabstractProfileTHR (cd_icc_get_context (icc),
+							 17, 0.f, 1.1f, 0.f, 10.f,
+							 6500, 5000);
+	if (lcms_profile == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				     "failed to create abstract profile");
+		return NULL;
+	}
+	if (!cd_icc_load_handle (icc, lcms_profile,
+				 CD_ICC_LOAD_FLAGS_NONE, error))
+		return NULL;
+	return g_steal_pointer (&icc);
+}
+
+int
+main (int argc, char **argv)
+{
+	CdBenchmarkPriv priv = { 0 };
+	gboolean json = FALSE;
+	gboolean quick = FALSE;
+	gint max_size = 7680;
+	gint max_threads = 0;
+	g_autofree gchar *cmyk_profile = NULL;
+	g_autofree gchar *output_profile = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	const GOptionEntry options[] = {
+		{ "json", '\0', 0, G_OPTION_ARG_NONE, &json,
+		  "Output JSON rather than CSV", NULL },
+		{ "quick", '\0', 0, G_OPTION_ARG_NONE, &quick,
+		  "Only run each conversion once", NULL },
+		{ "max-size", '\0', 0, G_OPTION_ARG_INT, &max_size,
+		  "Largest image width to test", "WIDTH" },
+		{ "max-threads", '\0', 0, G_OPTION_ARG_INT, &max_threads,
+		  "Largest number of threads to test", "THREADS" },
+		{ "cmyk-profile", '\0', 0, G_OPTION_ARG_FILENAME, &cmyk_profile,
+		  "CMYK profile to use for the CMYK formats", "FILENAME" },
+		{ "output-profile", '\0', 0, G_OPTION_ARG_FILENAME, &output_profile,
+		  "RGB profile to convert to", "FILENAME" },
+		{ NULL }
+	};
+
+	setlocale (LC_ALL, "");
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context,
+				      "Measures the throughput of CdTransform");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse arguments: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	/* the numbers are printed in the C locale */
+	setlocale (LC_NUMERIC, "C");
+
+	priv.json = json;
+	priv.first_result = TRUE;
+	priv.max_size = (guint) max_size;
+	priv.min_time = quick ? 0.f : 0.25f;
+	priv.max_threads = max_threads > 0 ? (guint) max_threads :
+					     g_get_num_processors ();
+
+	/* load profiles */
+	if (output_profile == NULL)
+		output_profile = cd_test_get_filename ("ibm-t61.icc");
+	if (output_profile == NULL) {
+		g_printerr ("No output profile, use --output-profile\n");
+		return EXIT_FAILURE;
+	}
+	priv.output_rgb = cd_benchmark_load_icc (output_profile, &error);
+	if (priv.output_rgb == NULL) {
+		g_printerr ("Failed to load %s: %s\n",
+			    output_profile, error->message);
+		return EXIT_FAILURE;
+	}
+	if (cmyk_profile != NULL) {
+		priv.input_cmyk = cd_benchmark_load_icc (cmyk_profile, &error);
+		if (priv.input_cmyk == NULL) {
+			g_printerr ("Failed to load %s: %s\n",
+				    cmyk_profile, error->message);
+			return EXIT_FAILURE;
+		}
+	}
+	priv.abstract = cd_benchmark_create_abstract (&error);
+	if (priv.abstract == NULL) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	/* run every combination */
+	if (priv.json)
+		g_print ("[");
+	else
+		g_print ("format,width,height,threads,bpc,abstract,"
+			 "iterations,elapsed,mpix_per_sec,error\n");
+	for (guint i = 0; cd_benchmark_formats[i] != CD_PIXEL_FORMAT_UNKNOWN; i++) {
+		for (guint j = 0; cd_benchmark_sizes[j][0] != 0; j++) {
+			if (cd_benchmark_sizes[j][0] > priv.max_size)
+				break;
+			for (guint threads = 1; ; threads = MIN (threads * 2, priv.max_threads)) {
+				for (guint k = 0; k < 4; k++) {
+					cd_benchmark_run (&priv,
+							  cd_benchmark_formats[i],
+							  cd_benchmark_sizes[j][0],
+							  cd_benchmark_sizes[j][1],
+							  threads,
+							  (k & 1) > 0,
+							  (k & 2) > 0);
+				}
+				if (threads == priv.max_threads)
+					break;
+			}
+		}
+	}
+	if (priv.json)
+		g_print ("\n]\n");
+
+	g_object_unref (priv.output_rgb);
+	g_object_unref (priv.abstract);
+	if (priv.input_cmyk != NULL)
+		g_object_unref (priv.input_cmyk);
+	return EXIT_SUCCESS;
+}
@@ -164,6 +164,219 @@ cd_buffer_read_uint32_le (const guint8 *buffer)
 	return GUINT32_FROM_LE (tmp);
 }
 
+/* no branches or calls in the loops so they can be vectorized */
+static void G_GNUC_UNUSED
+cd_buffer_swap_uint16 (guint16 *data, guint len)
+{
+	for (guint i = 0; i < len; i++)
+		data[i] = GUINT16_SWAP_LE_BE (data[i]);
+}
+
+static void G_GNUC_UNUSED
+cd_buffer_swap_uint32 (guint32 *data, guint len)
+{
+	for (guint i = 0; i < len; i++)
+		data[i] = GUINT32_SWAP_LE_BE (data[i]);
+}
+
+static void G_GNUC_UNUSED
+cd_buffer_swap_uint16_unaligned (guint8 *data, guint len)
+{
+	for (guint i = 0; i < len; i++) {
+		guint16 tmp;
+		memcpy (&tmp, data + i * sizeof(tmp), sizeof(tmp));
+		tmp = GUINT16_SWAP_LE_BE (tmp);
+		memcpy (data + i * sizeof(tmp), &tmp, sizeof(tmp));
+	}
+}
+
+static void G_GNUC_UNUSED
+cd_buffer_swap_uint32_unaligned (guint8 *data, guint len)
+{
+	for (guint i = 0; i < len; i++) {
+		guint32 tmp;
+		memcpy (&tmp, data + i * sizeof(tmp), sizeof(tmp));
+		tmp = GUINT32_SWAP_LE_BE (tmp);
+		memcpy (data + i * sizeof(tmp), &tmp, sizeof(tmp));
+	}
+}
+
+/**
+ * cd_buffer_read_uint16_be_array:
+ * @buffer: the data buffer of at least @len values
+ * @dest: (array length=len): the native endian values to write to
+ * @len: the number of values
+ *
+ * Reads an array of native endian values from a big endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_read_uint16_be_array (const guint8 *buffer, guint16 *dest, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	memcpy (dest, buffer, len * sizeof(guint16));
+#if G_BYTE_ORDER != G_BIG_ENDIAN
+	cd_buffer_swap_uint16 (dest, len);
+#endif
+}
+
+/**
+ * cd_buffer_write_uint16_be_array:
+ * @buffer: the writable data buffer of at least @len values
+ * @src: (array length=len): the native endian values to write
+ * @len: the number of values
+ *
+ * Writes an array of native endian values into a big endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_write_uint16_be_array (guint8 *buffer, const guint16 *src, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (src != NULL || len == 0);
+	memcpy (buffer, src, len * sizeof(guint16));
+#if G_BYTE_ORDER != G_BIG_ENDIAN
+	cd_buffer_swap_uint16_unaligned (buffer, len);
+#endif
+}
+
+/**
+ * cd_buffer_read_uint16_le_array:
+ * @buffer: the data buffer of at least @len values
+ * @dest: (array length=len): the native endian values to write to
+ * @len: the number of values
+ *
+ * Reads an array of native endian values from a little endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_read_uint16_le_array (const guint8 *buffer, guint16 *dest, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	memcpy (dest, buffer, len * sizeof(guint16));
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+	cd_buffer_swap_uint16 (dest, len);
+#endif
+}
+
+/**
+ * cd_buffer_write_uint16_le_array:
+ * @buffer: the writable data buffer of at least @len values
+ * @src: (array length=len): the native endian values to write
+ * @len: the number of values
+ *
+ * Writes an array of native endian values into a little endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_write_uint16_le_array (guint8 *buffer, const guint16 *src, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (src != NULL || len == 0);
+	memcpy (buffer, src, len * sizeof(guint16));
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+	cd_buffer_swap_uint16_unaligned (buffer, len);
+#endif
+}
+
+/**
+ * cd_buffer_read_uint32_be_array:
+ * @buffer: the data buffer of at least @len values
+ * @dest: (array length=len): the native endian values to write to
+ * @len: the number of values
+ *
+ * Reads an array of native endian values from a big endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_read_uint32_be_array (const guint8 *buffer, guint32 *dest, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	memcpy (dest, buffer, len * sizeof(guint32));
+#if G_BYTE_ORDER != G_BIG_ENDIAN
+	cd_buffer_swap_uint32 (dest, len);
+#endif
+}
+
+/**
+ * cd_buffer_write_uint32_be_array:
+ * @buffer: the writable data buffer of at least @len values
+ * @src: (array length=len): the native endian values to write
+ * @len: the number of values
+ *
+ * Writes an array of native endian values into a big endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_write_uint32_be_array (guint8 *buffer, const guint32 *src, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (src != NULL || len == 0);
+	memcpy (buffer, src, len * sizeof(guint32));
+#if G_BYTE_ORDER != G_BIG_ENDIAN
+	cd_buffer_swap_uint32_unaligned (buffer, len);
+#endif
+}
+
+/**
+ * cd_buffer_read_uint32_le_array:
+ * @buffer: the data buffer of at least @len values
+ * @dest: (array length=len): the native endian values to write to
+ * @len: the number of values
+ *
+ * Reads an array of native endian values from a little endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_read_uint32_le_array (const guint8 *buffer, guint32 *dest, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	memcpy (dest, buffer, len * sizeof(guint32));
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+	cd_buffer_swap_uint32 (dest, len);
+#endif
+}
+
+/**
+ * cd_buffer_write_uint32_le_array:
+ * @buffer: the writable data buffer of at least @len values
+ * @src: (array length=len): the native endian values to write
+ * @len: the number of values
+ *
+ * Writes an array of native endian values into a little endian data buffer.
+ * NOTE: No validation is done on the buffer to ensure it's big enough.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_buffer_write_uint32_le_array (guint8 *buffer, const guint32 *src, guint len)
+{
+	g_return_if_fail (buffer != NULL || len == 0);
+	g_return_if_fail (src != NULL || len == 0);
+	memcpy (buffer, src, len * sizeof(guint32));
+#if G_BYTE_ORDER != G_LITTLE_ENDIAN
+	cd_buffer_swap_uint32_unaligned (buffer, len);
+#endif
+}
+
 /**
  * cd_buffer_debug:
  * @buffer_kind: the debug mode, e.g %CD_BUFFER_KIND_REQUEST
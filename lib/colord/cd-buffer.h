@@ -51,6 +51,30 @@ void		 cd_buffer_write_uint32_be	(guint8		*buffer,
 						 guint32	 value);
 void		 cd_buffer_write_uint32_le	(guint8		*buffer,
 						 guint32	 value);
+void		 cd_buffer_read_uint16_be_array	(const guint8	*buffer,
+						 guint16	*dest,
+						 guint		 len);
+void		 cd_buffer_write_uint16_be_array	(guint8		*buffer,
+						 const guint16	*src,
+						 guint		 len);
+void		 cd_buffer_read_uint16_le_array	(const guint8	*buffer,
+						 guint16	*dest,
+						 guint		 len);
+void		 cd_buffer_write_uint16_le_array	(guint8		*buffer,
+						 const guint16	*src,
+						 guint		 len);
+void		 cd_buffer_read_uint32_be_array	(const guint8	*buffer,
+						 guint32	*dest,
+						 guint		 len);
+void		 cd_buffer_write_uint32_be_array	(guint8		*buffer,
+						 const guint32	*src,
+						 guint		 len);
+void		 cd_buffer_read_uint32_le_array	(const guint8	*buffer,
+						 guint32	*dest,
+						 guint		 len);
+void		 cd_buffer_write_uint32_le_array	(guint8		*buffer,
+						 const guint32	*src,
+						 guint		 len);
 
 G_END_DECLS
 
@@ -39,16 +39,18 @@
 #include "cd-device.h"
 #include "cd-client.h"
 #include "cd-client-sync.h"
+#include "cd-sync-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainLoop	*loop;
+	gboolean	 done;
 	gboolean	 ret;
 	CdProfile	*profile;
 	CdDevice	*device;
 	CdSensor	*sensor;
 	GPtrArray	*array;
+	GPtrArray	*array_profiles;
 } CdClientHelper;
 
 static void
@@ -57,7 +59,7 @@ cd_client_connect_finish_sync (CdClient *client,
 			       CdClientHelper *helper)
 {
 	helper->ret = cd_client_connect_finish (client, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -81,19 +83,20 @@ cd_client_connect_sync (CdClient *client,
 			GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = g_main_context_ref_thread_default ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_connect (client, cancellable,
 			   (GAsyncReadyCallback) cd_client_connect_finish_sync, &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
 
 	return helper.ret;
 }
@@ -106,7 +109,7 @@ cd_client_delete_profile_finish_sync (CdClient *client,
 				      CdClientHelper *helper)
 {
 	helper->ret = cd_client_delete_profile_finish (client, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -132,19 +135,20 @@ cd_client_delete_profile_sync (CdClient *client,
 			       GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_delete_profile (client, profile, cancellable,
 				  (GAsyncReadyCallback) cd_client_delete_profile_finish_sync, &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -157,7 +161,7 @@ cd_client_delete_device_finish_sync (CdClient *client,
 				      CdClientHelper *helper)
 {
 	helper->ret = cd_client_delete_device_finish (client, res, helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -183,19 +187,20 @@ cd_client_delete_device_sync (CdClient *client,
 			      GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_delete_device (client, device, cancellable,
 				  (GAsyncReadyCallback) cd_client_delete_device_finish_sync, &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -210,7 +215,7 @@ cd_client_find_profile_finish_sync (CdClient *client,
 	helper->profile = cd_client_find_profile_finish (client,
 							 res,
 							 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -236,10 +241,11 @@ cd_client_find_profile_sync (CdClient *client,
 			     GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.profile = NULL;
 
@@ -247,10 +253,10 @@ cd_client_find_profile_sync (CdClient *client,
 	cd_client_find_profile (client, id, cancellable,
 				(GAsyncReadyCallback) cd_client_find_profile_finish_sync,
 				&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -265,7 +271,7 @@ cd_client_find_profile_by_filename_finish_sync (CdClient *client,
 	helper->profile = cd_client_find_profile_by_filename_finish (client,
 								     res,
 								     helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -291,10 +297,11 @@ cd_client_find_profile_by_filename_sync (CdClient *client,
 					 GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.profile = NULL;
 
@@ -302,10 +309,10 @@ cd_client_find_profile_by_filename_sync (CdClient *client,
 	cd_client_find_profile_by_filename (client, filename, cancellable,
 					    (GAsyncReadyCallback) cd_client_find_profile_by_filename_finish_sync,
 					    &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -320,7 +327,7 @@ cd_client_create_profile_finish_sync (CdClient *client,
 	helper->profile = cd_client_create_profile_finish (client,
 							   res,
 							   helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -351,10 +358,11 @@ cd_client_create_profile_sync (CdClient *client,
 			       GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.profile = NULL;
 
@@ -363,10 +371,10 @@ cd_client_create_profile_sync (CdClient *client,
 				  properties, cancellable,
 				  (GAsyncReadyCallback) cd_client_create_profile_finish_sync,
 				  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -381,7 +389,7 @@ cd_client_create_profile_for_icc_finish_sync (CdClient *client,
 	helper->profile = cd_client_create_profile_for_icc_finish (client,
 								   res,
 								   helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -409,10 +417,11 @@ cd_client_create_profile_for_icc_sync (CdClient *client,
 				       GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.profile = NULL;
 
@@ -421,10 +430,10 @@ cd_client_create_profile_for_icc_sync (CdClient *client,
 					  cancellable,
 					  (GAsyncReadyCallback) cd_client_create_profile_for_icc_finish_sync,
 					  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -439,7 +448,7 @@ cd_client_import_profile_finish_sync (CdClient *client,
 	helper->profile = cd_client_import_profile_finish (client,
 							   res,
 							   helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -465,20 +474,31 @@ cd_client_import_profile_sync (CdClient *client,
 			       GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* import temp object */
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	memset (&helper, 0, sizeof (CdClientHelper));
+#ifdef __unix__
+	context = cd_sync_context_push ();
+#else
+	/* the daemon announces the copy with ::profile-added, which is
+	 * dispatched on the context the client subscribed on */
+	context = g_main_context_ref_thread_default ();
+#endif
 	helper.error = error;
-	helper.profile = NULL;
 
 	/* run async method */
 	cd_client_import_profile (client, file, cancellable,
 				  (GAsyncReadyCallback) cd_client_import_profile_finish_sync,
 				  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+#ifdef __unix__
+	cd_sync_context_pop (context);
+#else
+	g_main_context_unref (context);
+#endif
 
 	return helper.profile;
 }
@@ -493,7 +513,7 @@ cd_client_create_device_finish_sync (CdClient *client,
 	helper->device = cd_client_create_device_finish (client,
 							   res,
 							   helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -524,10 +544,11 @@ cd_client_create_device_sync (CdClient *client,
 			       GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.device = NULL;
 
@@ -536,10 +557,10 @@ cd_client_create_device_sync (CdClient *client,
 				  properties, cancellable,
 				  (GAsyncReadyCallback) cd_client_create_device_finish_sync,
 				  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.device;
 }
@@ -554,7 +575,7 @@ cd_client_get_devices_finish_sync (CdClient *client,
 	helper->array = cd_client_get_devices_finish (client,
 						      res,
 						      helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -579,10 +600,11 @@ cd_client_get_devices_sync (CdClient *client,
 			    GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.array = NULL;
 
@@ -590,10 +612,10 @@ cd_client_get_devices_sync (CdClient *client,
 	cd_client_get_devices (client, cancellable,
 			       (GAsyncReadyCallback) cd_client_get_devices_finish_sync,
 			       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.array;
 }
@@ -608,7 +630,7 @@ cd_client_get_profiles_finish_sync (CdClient *client,
 	helper->array = cd_client_get_profiles_finish (client,
 						       res,
 						       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -633,10 +655,11 @@ cd_client_get_profiles_sync (CdClient *client,
 			     GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.array = NULL;
 
@@ -644,16 +667,141 @@ cd_client_get_profiles_sync (CdClient *client,
 	cd_client_get_profiles (client, cancellable,
 			        (GAsyncReadyCallback) cd_client_get_profiles_finish_sync,
 			        &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.array;
 }
 
 /**********************************************************************/
 
+static void
+cd_client_get_snapshot_finish_sync (CdClient *client,
+				    GAsyncResult *res,
+				    CdClientHelper *helper)
+{
+	helper->ret = cd_client_get_snapshot_finish (client,
+						     res,
+						     &helper->array,
+						     &helper->array_profiles,
+						     helper->error);
+	helper->done = TRUE;
+}
+
+/**
+ * cd_client_get_snapshot_sync:
+ * @client: a #CdClient instance.
+ * @devices: (out) (optional) (element-type CdDevice) (transfer container): the devices
+ * @profiles: (out) (optional) (element-type CdProfile) (transfer container): the profiles
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Gets all the devices and profiles in one request. The returned objects
+ * are already connected.
+ *
+ * WARNING: This function is synchronous, and may block.
+ * Do not use it in GUI applications.
+ *
+ * Return value: success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_get_snapshot_sync (CdClient *client,
+			     GPtrArray **devices,
+			     GPtrArray **profiles,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	CdClientHelper helper;
+	GMainContext *context;
+
+	/* create temp object */
+	memset (&helper, 0, sizeof (CdClientHelper));
+	context = g_main_context_ref_thread_default ();
+	helper.error = error;
+
+	/* run async method */
+	cd_client_get_snapshot (client, cancellable,
+				(GAsyncReadyCallback) cd_client_get_snapshot_finish_sync,
+				&helper);
+	cd_sync_context_run (context, &helper.done);
+
+	/* free temp object */
+	g_main_context_unref (context);
+
+	if (helper.ret) {
+		if (devices != NULL)
+			*devices = g_steal_pointer (&helper.array);
+		if (profiles != NULL)
+			*profiles = g_steal_pointer (&helper.array_profiles);
+	}
+	if (helper.array != NULL)
+		g_ptr_array_unref (helper.array);
+	if (helper.array_profiles != NULL)
+		g_ptr_array_unref (helper.array_profiles);
+	return helper.ret;
+}
+
+/**********************************************************************/
+
+static void
+cd_client_connect_objects_finish_sync (CdClient *client,
+				       GAsyncResult *res,
+				       CdClientHelper *helper)
+{
+	helper->ret = cd_client_connect_objects_finish (client,
+							res,
+							helper->error);
+	helper->done = TRUE;
+}
+
+/**
+ * cd_client_connect_objects_sync:
+ * @client: a #CdClient instance.
+ * @objects: (element-type GObject): an array of #CdDevice, #CdProfile or #CdSensor objects
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Connects all the objects in the array.
+ *
+ * WARNING: This function is synchronous, and may block.
+ * Do not use it in GUI applications.
+ *
+ * Return value: success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_connect_objects_sync (CdClient *client,
+				GPtrArray *objects,
+				GCancellable *cancellable,
+				GError **error)
+{
+	CdClientHelper helper;
+	GMainContext *context;
+
+	/* create temp object */
+	memset (&helper, 0, sizeof (CdClientHelper));
+	context = g_main_context_ref_thread_default ();
+	helper.error = error;
+
+	/* run async method */
+	cd_client_connect_objects (client, objects, cancellable,
+				   (GAsyncReadyCallback) cd_client_connect_objects_finish_sync,
+				   &helper);
+	cd_sync_context_run (context, &helper.done);
+
+	/* free temp object */
+	g_main_context_unref (context);
+
+	return helper.ret;
+}
+
+/**********************************************************************/
+
 static void
 cd_client_get_sensors_finish_sync (CdClient *client,
 				   GAsyncResult *res,
@@ -662,7 +810,7 @@ cd_client_get_sensors_finish_sync (CdClient *client,
 	helper->array = cd_client_get_sensors_finish (client,
 						      res,
 						      helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -687,10 +835,11 @@ cd_client_get_sensors_sync (CdClient *client,
 			    GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.array = NULL;
 
@@ -698,10 +847,10 @@ cd_client_get_sensors_sync (CdClient *client,
 	cd_client_get_sensors (client, cancellable,
 			       (GAsyncReadyCallback) cd_client_get_sensors_finish_sync,
 			       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.array;
 }
@@ -716,7 +865,7 @@ cd_client_find_device_finish_sync (CdClient *client,
 	helper->device = cd_client_find_device_finish (client,
 						       res,
 						       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -742,20 +891,21 @@ cd_client_find_device_sync (CdClient *client,
 			    GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_find_device (client, id, cancellable,
 			       (GAsyncReadyCallback) cd_client_find_device_finish_sync,
 			       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.device;
 }
@@ -770,7 +920,7 @@ cd_client_find_device_by_property_finish_sync (CdClient *client,
 	helper->device = cd_client_find_device_by_property_finish (client,
 								   res,
 								   helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -798,20 +948,21 @@ cd_client_find_device_by_property_sync (CdClient *client,
 					GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_find_device_by_property (client, key, value, cancellable,
 					   (GAsyncReadyCallback) cd_client_find_device_by_property_finish_sync,
 					   &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.device;
 }
@@ -826,7 +977,7 @@ cd_client_get_standard_space_finish_sync (CdClient *client,
 	helper->profile = cd_client_get_standard_space_finish (client,
 							       res,
 							       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -852,10 +1003,11 @@ cd_client_get_standard_space_sync (CdClient *client,
 				   GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 	helper.profile = NULL;
 
@@ -863,10 +1015,10 @@ cd_client_get_standard_space_sync (CdClient *client,
 	cd_client_get_standard_space (client, standard_space, cancellable,
 				      (GAsyncReadyCallback) cd_client_get_standard_space_finish_sync,
 				      &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -881,7 +1033,7 @@ cd_client_get_devices_by_kind_finish_sync (CdClient *client,
 	helper->array = cd_client_get_devices_by_kind_finish (client,
 							      res,
 							      helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -908,20 +1060,21 @@ cd_client_get_devices_by_kind_sync (CdClient *client,
 				    GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_get_devices_by_kind (client, kind, cancellable,
 				       (GAsyncReadyCallback) cd_client_get_devices_by_kind_finish_sync,
 				       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.array;
 }
@@ -936,7 +1089,7 @@ cd_client_find_profile_by_property_finish_sync (CdClient *client,
 	helper->profile = cd_client_find_profile_by_property_finish (client,
 								     res,
 								     helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -964,20 +1117,21 @@ cd_client_find_profile_by_property_sync (CdClient *client,
 					 GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_find_profile_by_property (client, key, value, cancellable,
 					    (GAsyncReadyCallback) cd_client_find_profile_by_property_finish_sync,
 					    &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -992,7 +1146,7 @@ cd_client_find_sensor_finish_sync (CdClient *client,
 	helper->sensor = cd_client_find_sensor_finish (client,
 						       res,
 						       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -1018,20 +1172,65 @@ cd_client_find_sensor_sync (CdClient *client,
 			    GError **error)
 {
 	CdClientHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdClientHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_client_find_sensor (client, id, cancellable,
 			       (GAsyncReadyCallback) cd_client_find_sensor_finish_sync,
 			       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
+
+	/* free temp object */
+	cd_sync_context_pop (context);
+
+	return helper.sensor;
+}
+
+/**********************************************************************/
+
+/**
+ * cd_client_create_sensor_group_sync:
+ * @client: a #CdClient instance.
+ * @sensors: (element-type CdSensor): the sensors to group
+ * @cancellable: a #GCancellable or %NULL
+ * @error: a #GError, or %NULL.
+ *
+ * Creates a sensor that drives several sensors at once.
+ *
+ * WARNING: This function is synchronous, and may block.
+ * Do not use it in GUI applications.
+ *
+ * Return value: (transfer full): A #CdSensor object, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdSensor *
+cd_client_create_sensor_group_sync (CdClient *client,
+				    GPtrArray *sensors,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	CdClientHelper helper;
+	GMainContext *context;
+
+	/* create temp object */
+	memset (&helper, 0, sizeof (CdClientHelper));
+	context = cd_sync_context_push ();
+	helper.error = error;
+
+	/* run async method */
+	cd_client_create_sensor_group (client, sensors, cancellable,
+				       (GAsyncReadyCallback) cd_client_find_sensor_finish_sync,
+				       &helper);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.sensor;
 }
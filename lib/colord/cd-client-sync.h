@@ -91,6 +91,17 @@ GPtrArray	*cd_client_get_profiles_sync		(CdClient	*client,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_client_get_snapshot_sync		(CdClient	*client,
+							 GPtrArray	**devices,
+							 GPtrArray	**profiles,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_client_connect_objects_sync		(CdClient	*client,
+							 GPtrArray	*objects,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 GPtrArray	*cd_client_get_sensors_sync		(CdClient	*client,
 							 GCancellable	*cancellable,
 							 GError		**error)
@@ -127,6 +138,11 @@ CdSensor	*cd_client_find_sensor_sync		(CdClient	*client,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+CdSensor	*cd_client_create_sensor_group_sync	(CdClient	*client,
+							 GPtrArray	*sensors,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -40,6 +40,7 @@
 #include <gio/gio.h>
 #ifdef __unix__
 #include <gio/gunixfdlist.h>
+#include <unistd.h>
 #endif
 #include <glib/gstdio.h>
 #include <glib.h>
@@ -49,7 +50,9 @@
 #include "cd-client-sync.h"
 #include "cd-device.h"
 #include "cd-device-sync.h"
+#include "cd-device-private.h"
 #include "cd-sensor.h"
+#include "cd-profile-private.h"
 #include "cd-profile-sync.h"
 
 static void	cd_client_class_init	(CdClientClass	*klass);
@@ -63,6 +66,8 @@ static void	cd_client_finalize	(GObject	*object);
 #define COLORD_DBUS_SERVICE		"org.freedesktop.ColorManager"
 #define COLORD_DBUS_PATH		"/org/freedesktop/ColorManager"
 #define COLORD_DBUS_INTERFACE		"org.freedesktop.ColorManager"
+#define COLORD_DBUS_INTERFACE_DEVICE	"org.freedesktop.ColorManager.Device"
+#define COLORD_DBUS_INTERFACE_PROFILE	"org.freedesktop.ColorManager.Profile"
 
 /**
  * CdClientPrivate:
@@ -75,6 +80,17 @@ typedef struct
 	gchar			*daemon_version;
 	gchar			*system_vendor;
 	gchar			*system_model;
+	GHashTable		*objects;	/* object_path:GWeakRef */
+	guint			 objects_prune_size;
+	GMutex			 objects_mutex;
+	gboolean		 shared_proxy;
+	GDBusConnection		*shared_connection;
+	gchar			*shared_name_owner;
+	guint			 shared_subscription_id;
+	gboolean		 lookup_cache;
+	GHashTable		*lookups;	/* query:object_path */
+	guint			 lookups_generation;
+	GDBusProxy		*server_proxy;	/* from cd_client_get_has_server() */
 } CdClientPrivate;
 
 enum {
@@ -88,6 +104,8 @@ enum {
 	SIGNAL_SENSOR_ADDED,
 	SIGNAL_SENSOR_REMOVED,
 	SIGNAL_SENSOR_CHANGED,
+	SIGNAL_DEVICES_ADDED,
+	SIGNAL_PROFILES_ADDED,
 	SIGNAL_LAST
 };
 
@@ -128,6 +146,98 @@ cd_client_error_quark (void)
 	return quark;
 }
 
+static void
+cd_client_set_property_from_variant (gchar **value, GVariant *variant)
+{
+	if (variant == NULL)
+		return;
+	g_free (*value);
+	*value = g_variant_dup_string (variant, NULL);
+}
+
+static void
+cd_client_load_properties_cb (GObject *source_object,
+			      GAsyncResult *res,
+			      gpointer user_data)
+{
+	g_autoptr(GTask) task = G_TASK (user_data);
+	CdClient *client = CD_CLIENT (g_task_get_source_object (task));
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) daemon_version = NULL;
+	g_autoptr(GVariant) dict = NULL;
+	g_autoptr(GVariant) result = NULL;
+	g_autoptr(GVariant) system_model = NULL;
+	g_autoptr(GVariant) system_vendor = NULL;
+
+	/* like a proxy loading its properties, this is not fatal */
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+						res, &error);
+	if (result == NULL) {
+		g_debug ("failed to get daemon properties: %s", error->message);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+	dict = g_variant_get_child_value (result, 0);
+	daemon_version = g_variant_lookup_value (dict,
+						 CD_CLIENT_PROPERTY_DAEMON_VERSION,
+						 G_VARIANT_TYPE_STRING);
+	system_vendor = g_variant_lookup_value (dict,
+						CD_CLIENT_PROPERTY_SYSTEM_VENDOR,
+						G_VARIANT_TYPE_STRING);
+	system_model = g_variant_lookup_value (dict,
+					       CD_CLIENT_PROPERTY_SYSTEM_MODEL,
+					       G_VARIANT_TYPE_STRING);
+	cd_client_set_property_from_variant (&priv->daemon_version, daemon_version);
+	cd_client_set_property_from_variant (&priv->system_vendor, system_vendor);
+	cd_client_set_property_from_variant (&priv->system_model, system_model);
+	g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * cd_client_load_properties:
+ *
+ * The daemon properties never change while it is running, so they are
+ * fetched once when connecting instead of being watched by the proxy.
+ * This takes ownership of @task, which completes when they are loaded.
+ */
+static void
+cd_client_load_properties (CdClient *client, GTask *task)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GVariant) daemon_version = NULL;
+	g_autoptr(GVariant) system_model = NULL;
+	g_autoptr(GVariant) system_vendor = NULL;
+
+	/* the proxy may have loaded them already */
+	daemon_version = g_dbus_proxy_get_cached_property (priv->proxy,
+							   CD_CLIENT_PROPERTY_DAEMON_VERSION);
+	if (daemon_version != NULL) {
+		system_vendor = g_dbus_proxy_get_cached_property (priv->proxy,
+								  CD_CLIENT_PROPERTY_SYSTEM_VENDOR);
+		system_model = g_dbus_proxy_get_cached_property (priv->proxy,
+								 CD_CLIENT_PROPERTY_SYSTEM_MODEL);
+		cd_client_set_property_from_variant (&priv->daemon_version, daemon_version);
+		cd_client_set_property_from_variant (&priv->system_vendor, system_vendor);
+		cd_client_set_property_from_variant (&priv->system_model, system_model);
+		g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
+		return;
+	}
+	g_dbus_connection_call (g_dbus_proxy_get_connection (priv->proxy),
+				COLORD_DBUS_SERVICE,
+				COLORD_DBUS_PATH,
+				"org.freedesktop.DBus.Properties",
+				"GetAll",
+				g_variant_new ("(s)", COLORD_DBUS_INTERFACE),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				CD_CLIENT_MESSAGE_TIMEOUT,
+				g_task_get_cancellable (task),
+				cd_client_load_properties_cb,
+				task);
+}
+
 /**
  * cd_client_get_daemon_version:
  * @client: a #CdClient instance.
@@ -185,6 +295,99 @@ cd_client_get_system_model (CdClient *client)
 	return priv->system_model;
 }
 
+/**
+ * cd_client_get_shared_proxy:
+ * @client: a #CdClient instance.
+ *
+ * Gets if objects returned by cd_client_get_snapshot() share one signal
+ * subscription rather than each having their own proxy.
+ *
+ * Return value: %TRUE if shared proxy mode is enabled
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_get_shared_proxy (CdClient *client)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_return_val_if_fail (CD_IS_CLIENT (client), FALSE);
+	return priv->shared_proxy;
+}
+
+/**
+ * cd_client_set_shared_proxy:
+ * @client: a #CdClient instance.
+ * @shared_proxy: whether to enable shared proxy mode
+ *
+ * Sets if devices and profiles returned by cd_client_get_snapshot() should
+ * be connected without a proxy of their own. All property changes and
+ * signals are then received using a single subscription on the connection
+ * for all objects, and each object only creates a proxy when a method is
+ * first called on it.
+ *
+ * This is useful for clients holding thousands of objects, where a proxy
+ * and match rules for each would put a lot of load on the system bus.
+ *
+ * Objects that have already been connected are not affected.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_client_set_shared_proxy (CdClient *client, gboolean shared_proxy)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_return_if_fail (CD_IS_CLIENT (client));
+	priv->shared_proxy = shared_proxy;
+}
+
+/**
+ * cd_client_get_lookup_cache:
+ * @client: a #CdClient instance.
+ *
+ * Gets if the results of lookups are cached.
+ *
+ * Return value: %TRUE if the lookup cache is enabled
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_get_lookup_cache (CdClient *client)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_return_val_if_fail (CD_IS_CLIENT (client), FALSE);
+	return priv->lookup_cache;
+}
+
+/**
+ * cd_client_set_lookup_cache:
+ * @client: a #CdClient instance.
+ * @lookup_cache: whether to cache lookups
+ *
+ * Sets if the results of cd_client_find_device_by_property(),
+ * cd_client_find_profile_by_filename() and cd_client_get_standard_space()
+ * should be remembered, so that repeating the same query does not need a
+ * round trip to the daemon.
+ *
+ * The cache is cleared whenever the daemon signals that a device, profile
+ * or sensor was added, removed or changed, so signals have to be processed
+ * using the main context for the results to stay correct.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_client_set_lookup_cache (CdClient *client, gboolean lookup_cache)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_if_fail (CD_IS_CLIENT (client));
+
+	locker = g_mutex_locker_new (&priv->objects_mutex);
+	priv->lookup_cache = lookup_cache;
+	g_hash_table_remove_all (priv->lookups);
+	priv->lookups_generation++;
+}
+
 /**
  * cd_client_get_connected:
  * @client: a #CdClient instance.
@@ -211,6 +414,9 @@ cd_client_get_connected (CdClient *client)
  * WARNING: This function may block for up to 5 seconds waiting for the daemon
  * to start if it is not already running.
  *
+ * The result is tracked using the name owner, so calling this again, or
+ * calling cd_client_connect() afterwards, does not need another round trip.
+ *
  * Return value: %TRUE if the colord process is running
  *
  * Since: 0.1.12
@@ -218,23 +424,36 @@ cd_client_get_connected (CdClient *client)
 gboolean
 cd_client_get_has_server (CdClient *client)
 {
+	CdClientPrivate *priv = GET_PRIVATE (client);
 	g_autofree gchar *name_owner = NULL;
-	g_autoptr(GDBusProxy) proxy = NULL;
 
 	g_return_val_if_fail (CD_IS_CLIENT (client), FALSE);
 
-	/* get name owner */
-	proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-					       G_DBUS_PROXY_FLAGS_NONE,
-					       NULL,
-					       COLORD_DBUS_SERVICE,
-					       COLORD_DBUS_PATH,
-					       COLORD_DBUS_INTERFACE,
-					       NULL,
-					       NULL);
-	if (proxy == NULL)
+	/* the proxies track the name owner, so no round trip is needed */
+	if (priv->proxy != NULL) {
+		name_owner = g_dbus_proxy_get_name_owner (priv->proxy);
+		if (name_owner != NULL)
+			return TRUE;
+	}
+	if (priv->server_proxy != NULL) {
+		name_owner = g_dbus_proxy_get_name_owner (priv->server_proxy);
+		if (name_owner != NULL)
+			return TRUE;
+		g_clear_object (&priv->server_proxy);
+	}
+
+	/* get name owner, starting the daemon if required */
+	priv->server_proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+							    G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+							    NULL,
+							    COLORD_DBUS_SERVICE,
+							    COLORD_DBUS_PATH,
+							    COLORD_DBUS_INTERFACE,
+							    NULL,
+							    NULL);
+	if (priv->server_proxy == NULL)
 		return FALSE;
-	name_owner = g_dbus_proxy_get_name_owner (proxy);
+	name_owner = g_dbus_proxy_get_name_owner (priv->server_proxy);
 	if (name_owner == NULL)
 		return FALSE;
 
@@ -244,6 +463,241 @@ cd_client_get_has_server (CdClient *client)
 
 /**********************************************************************/
 
+#define CD_CLIENT_OBJECTS_PRUNE_SIZE	64
+
+static void
+cd_client_object_ref_free (GWeakRef *weak)
+{
+	g_weak_ref_clear (weak);
+	g_free (weak);
+}
+
+static gboolean
+cd_client_object_ref_is_dead_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	g_autoptr(GObject) obj = g_weak_ref_get ((GWeakRef *) value);
+	return obj == NULL;
+}
+
+/*
+ * cd_client_object_new:
+ *
+ * Returns the object already handed out for this object path if the caller
+ * still holds it, so that signals, lookups and snapshots for the same daemon
+ * object all share one connected proxy, otherwise creates a new one.
+ */
+static gpointer
+cd_client_object_new (CdClient *client, GType gtype, const gchar *object_path)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	GObject *obj;
+	GWeakRef *weak;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+
+	weak = g_hash_table_lookup (priv->objects, object_path);
+	if (weak != NULL) {
+		obj = g_weak_ref_get (weak);
+		if (obj != NULL && G_TYPE_CHECK_INSTANCE_TYPE (obj, gtype))
+			return obj;
+		g_clear_object (&obj);
+	}
+
+	obj = g_object_new (gtype, "object-path", object_path, NULL);
+	if (weak != NULL) {
+		g_weak_ref_set (weak, obj);
+		return obj;
+	}
+
+	/* drop entries for objects nobody holds any more */
+	if (g_hash_table_size (priv->objects) >= priv->objects_prune_size) {
+		g_hash_table_foreach_remove (priv->objects,
+					     cd_client_object_ref_is_dead_cb,
+					     NULL);
+		priv->objects_prune_size = MAX (g_hash_table_size (priv->objects) * 2,
+						CD_CLIENT_OBJECTS_PRUNE_SIZE);
+	}
+	weak = g_new0 (GWeakRef, 1);
+	g_weak_ref_init (weak, obj);
+	g_hash_table_insert (priv->objects, g_strdup (object_path), weak);
+	return obj;
+}
+
+static void
+cd_client_object_remove (CdClient *client, const gchar *object_path)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+	g_hash_table_remove (priv->objects, object_path);
+}
+
+static gpointer
+cd_client_object_lookup (CdClient *client, const gchar *object_path)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	GWeakRef *weak;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+
+	weak = g_hash_table_lookup (priv->objects, object_path);
+	if (weak == NULL)
+		return NULL;
+	return g_weak_ref_get (weak);
+}
+
+static void
+cd_client_shared_signal_cb (GDBusConnection *connection,
+			    const gchar *sender_name,
+			    const gchar *object_path,
+			    const gchar *interface_name,
+			    const gchar *signal_name,
+			    GVariant *parameters,
+			    gpointer user_data)
+{
+	CdClient *client = CD_CLIENT (user_data);
+	const gchar *iface = interface_name;
+	g_autoptr(GObject) obj = NULL;
+	g_autoptr(GVariant) changed = NULL;
+
+	/* property changes are sent on the standard interface */
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties") == 0) {
+		if (g_strcmp0 (signal_name, "PropertiesChanged") != 0)
+			return;
+		if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sa{sv}as)")))
+			return;
+		g_variant_get (parameters, "(&s@a{sv}@as)", &iface, &changed, NULL);
+	}
+
+	/* only objects handed out by this client are interesting */
+	if (g_strcmp0 (iface, COLORD_DBUS_INTERFACE_DEVICE) != 0 &&
+	    g_strcmp0 (iface, COLORD_DBUS_INTERFACE_PROFILE) != 0)
+		return;
+	obj = cd_client_object_lookup (client, object_path);
+	if (obj == NULL)
+		return;
+
+	if (CD_IS_DEVICE (obj) && g_strcmp0 (iface, COLORD_DBUS_INTERFACE_DEVICE) == 0) {
+		if (changed != NULL)
+			cd_device_shared_properties_changed (CD_DEVICE (obj), changed);
+		else
+			cd_device_shared_signal (CD_DEVICE (obj), signal_name, parameters);
+	} else if (CD_IS_PROFILE (obj) && g_strcmp0 (iface, COLORD_DBUS_INTERFACE_PROFILE) == 0) {
+		if (changed != NULL)
+			cd_profile_shared_properties_changed (CD_PROFILE (obj), changed);
+		else
+			cd_profile_shared_signal (CD_PROFILE (obj), signal_name, parameters);
+	}
+}
+
+static void
+cd_client_shared_unsubscribe (CdClient *client)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	if (priv->shared_subscription_id != 0) {
+		g_dbus_connection_signal_unsubscribe (priv->shared_connection,
+						      priv->shared_subscription_id);
+		priv->shared_subscription_id = 0;
+	}
+	g_clear_object (&priv->shared_connection);
+	g_clear_pointer (&priv->shared_name_owner, g_free);
+}
+
+/*
+ * cd_client_shared_subscribe:
+ *
+ * Adds one match rule for every signal the daemon instance sends, which
+ * replaces the two rules each per-object proxy would otherwise add.
+ */
+static void
+cd_client_shared_subscribe (CdClient *client,
+			    GDBusConnection *connection,
+			    const gchar *name_owner)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+
+	/* already watching this instance */
+	if (priv->shared_subscription_id != 0 &&
+	    priv->shared_connection == connection &&
+	    g_strcmp0 (priv->shared_name_owner, name_owner) == 0)
+		return;
+
+	cd_client_shared_unsubscribe (client);
+	priv->shared_connection = g_object_ref (connection);
+	priv->shared_name_owner = g_strdup (name_owner);
+	priv->shared_subscription_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    name_owner,
+						    NULL, /* interface */
+						    NULL, /* member */
+						    NULL, /* path */
+						    NULL, /* arg0 */
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    cd_client_shared_signal_cb,
+						    client, NULL);
+}
+
+typedef struct {
+	gchar		*query;
+	guint		 generation;
+} CdClientLookupHelper;
+
+static void
+cd_client_lookup_helper_free (CdClientLookupHelper *helper)
+{
+	g_free (helper->query);
+	g_free (helper);
+}
+
+static void
+cd_client_lookup_cache_invalidate (CdClient *client)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+	g_hash_table_remove_all (priv->lookups);
+	priv->lookups_generation++;
+}
+
+/*
+ * cd_client_lookup_cache_get:
+ *
+ * Returns the cached object path for the query, or %NULL. If the cache is
+ * enabled @helper is set up so the result of the D-Bus call can be added.
+ */
+static gchar *
+cd_client_lookup_cache_get (CdClient *client,
+			    const gchar *query,
+			    CdClientLookupHelper **helper)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+	const gchar *object_path;
+
+	*helper = NULL;
+	if (!priv->lookup_cache)
+		return NULL;
+	object_path = g_hash_table_lookup (priv->lookups, query);
+	if (object_path != NULL)
+		return g_strdup (object_path);
+	*helper = g_new0 (CdClientLookupHelper, 1);
+	(*helper)->query = g_strdup (query);
+	(*helper)->generation = priv->lookups_generation;
+	return NULL;
+}
+
+static void
+cd_client_lookup_cache_add (CdClient *client,
+			    CdClientLookupHelper *helper,
+			    const gchar *object_path)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+
+	/* the objects may have changed while the call was in flight */
+	if (helper == NULL || helper->generation != priv->lookups_generation)
+		return;
+	g_hash_table_insert (priv->lookups,
+			     g_strdup (helper->query),
+			     g_strdup (object_path));
+}
+
 static void
 cd_client_dbus_signal_cb (GDBusProxy *proxy,
 			  gchar      *sender_name,
@@ -252,55 +706,77 @@ cd_client_dbus_signal_cb (GDBusProxy *proxy,
 			  CdClient   *client)
 {
 	g_autofree gchar *object_path_tmp = NULL;
+	g_autofree const gchar **object_paths = NULL;
 	g_autoptr(CdDevice) device = NULL;
 	g_autoptr(CdProfile) profile = NULL;
 	g_autoptr(CdSensor) sensor = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	/* any change to the objects may affect a cached lookup */
+	cd_client_lookup_cache_invalidate (client);
 
 	if (g_strcmp0 (signal_name, "Changed") == 0) {
 		g_warning ("changed");
 	} else if (g_strcmp0 (signal_name, "DeviceAdded") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		device = cd_device_new_with_object_path (object_path_tmp);
+		device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_DEVICE_ADDED], 0,
 			       device);
+	} else if (g_strcmp0 (signal_name, "DevicesAdded") == 0) {
+		g_variant_get (parameters, "(^a&o)", &object_paths);
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (guint i = 0; object_paths[i] != NULL; i++)
+			g_ptr_array_add (array, cd_client_object_new (client, CD_TYPE_DEVICE, object_paths[i]));
+		g_signal_emit (client, signals[SIGNAL_DEVICES_ADDED], 0,
+			       array);
 	} else if (g_strcmp0 (signal_name, "DeviceRemoved") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		device = cd_device_new_with_object_path (object_path_tmp);
+		device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_DEVICE_REMOVED], 0,
 			       device);
+		cd_client_object_remove (client, object_path_tmp);
 	} else if (g_strcmp0 (signal_name, "DeviceChanged") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		device = cd_device_new_with_object_path (object_path_tmp);
+		device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_DEVICE_CHANGED], 0,
 			       device);
 	} else if (g_strcmp0 (signal_name, "ProfileAdded") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		profile = cd_profile_new_with_object_path (object_path_tmp);
+		profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_PROFILE_ADDED], 0,
 			       profile);
+	} else if (g_strcmp0 (signal_name, "ProfilesAdded") == 0) {
+		g_variant_get (parameters, "(^a&o)", &object_paths);
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (guint i = 0; object_paths[i] != NULL; i++)
+			g_ptr_array_add (array, cd_client_object_new (client, CD_TYPE_PROFILE, object_paths[i]));
+		g_signal_emit (client, signals[SIGNAL_PROFILES_ADDED], 0,
+			       array);
 	} else if (g_strcmp0 (signal_name, "ProfileRemoved") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		profile = cd_profile_new_with_object_path (object_path_tmp);
+		profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_PROFILE_REMOVED], 0,
 			       profile);
+		cd_client_object_remove (client, object_path_tmp);
 	} else if (g_strcmp0 (signal_name, "ProfileChanged") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		profile = cd_profile_new_with_object_path (object_path_tmp);
+		profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_PROFILE_CHANGED], 0,
 			       profile);
 	} else if (g_strcmp0 (signal_name, "SensorAdded") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		sensor = cd_sensor_new_with_object_path (object_path_tmp);
+		sensor = cd_client_object_new (client, CD_TYPE_SENSOR, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_SENSOR_ADDED], 0,
 			       sensor);
 	} else if (g_strcmp0 (signal_name, "SensorRemoved") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		sensor = cd_sensor_new_with_object_path (object_path_tmp);
+		sensor = cd_client_object_new (client, CD_TYPE_SENSOR, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_SENSOR_REMOVED], 0,
 			       sensor);
+		cd_client_object_remove (client, object_path_tmp);
 	} else if (g_strcmp0 (signal_name, "SensorChanged") == 0) {
 		g_variant_get (parameters, "(o)", &object_path_tmp);
-		sensor = cd_sensor_new_with_object_path (object_path_tmp);
+		sensor = cd_client_object_new (client, CD_TYPE_SENSOR, object_path_tmp);
 		g_signal_emit (client, signals[SIGNAL_SENSOR_CHANGED], 0,
 			       sensor);
 	} else {
@@ -313,7 +789,21 @@ cd_client_owner_notify_cb (GObject *object,
 			   GParamSpec *pspec,
 			   CdClient *client)
 {
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	g_autofree gchar *name_owner = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->objects_mutex);
+
 	/* daemon has quit, clearing caches */
+	g_hash_table_remove_all (priv->objects);
+	g_hash_table_remove_all (priv->lookups);
+	priv->lookups_generation++;
+	g_clear_pointer (&locker, g_mutex_locker_free);
+	cd_client_shared_unsubscribe (client);
+
+	/* a new daemon may be a different version */
+	name_owner = g_dbus_proxy_get_name_owner (priv->proxy);
+	if (name_owner != NULL)
+		cd_client_load_properties (client, g_task_new (client, NULL, NULL, NULL));
 }
 
 /**********************************************************************/
@@ -339,6 +829,24 @@ cd_client_connect_finish (CdClient *client,
 	return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+static void
+cd_client_setup_proxy (CdClient *client)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+
+	/* get signals from DBus */
+	g_signal_connect_object (priv->proxy,
+				 "g-signal",
+				 G_CALLBACK (cd_client_dbus_signal_cb),
+				 client, 0);
+
+	/* watch to see if it's fallen off the bus */
+	g_signal_connect_object (priv->proxy,
+				 "notify::g-name-owner",
+				 G_CALLBACK (cd_client_owner_notify_cb),
+				 client, 0);
+}
+
 static void
 cd_client_connect_cb (GObject *source_object,
 		      GAsyncResult *res,
@@ -346,9 +854,6 @@ cd_client_connect_cb (GObject *source_object,
 {
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GTask) task = G_TASK (user_data);
-	g_autoptr(GVariant) daemon_version = NULL;
-	g_autoptr(GVariant) system_model = NULL;
-	g_autoptr(GVariant) system_vendor = NULL;
 	CdClient *client = CD_CLIENT (g_task_get_source_object (task));
 	CdClientPrivate *priv = GET_PRIVATE (client);
 
@@ -362,45 +867,10 @@ cd_client_connect_cb (GObject *source_object,
 					 error->message);
 		return;
 	}
+	cd_client_setup_proxy (client);
 
-	/* get daemon version */
-	daemon_version = g_dbus_proxy_get_cached_property (priv->proxy,
-							   CD_CLIENT_PROPERTY_DAEMON_VERSION);
-	if (daemon_version != NULL) {
-		g_free (priv->daemon_version);
-		priv->daemon_version = g_variant_dup_string (daemon_version, NULL);
-	}
-
-	/* get system info */
-	system_vendor = g_dbus_proxy_get_cached_property (priv->proxy,
-							  CD_CLIENT_PROPERTY_SYSTEM_VENDOR);
-	if (system_vendor != NULL) {
-		g_free (priv->system_vendor);
-		priv->system_vendor = g_variant_dup_string (system_vendor, NULL);
-	}
-
-	/* get system model */
-	system_model = g_dbus_proxy_get_cached_property (priv->proxy,
-							 CD_CLIENT_PROPERTY_SYSTEM_MODEL);
-	if (system_model != NULL) {
-		g_free (priv->system_model);
-		priv->system_model = g_variant_dup_string (system_model, NULL);
-	}
-
-	/* get signals from DBus */
-	g_signal_connect_object (priv->proxy,
-				 "g-signal",
-				 G_CALLBACK (cd_client_dbus_signal_cb),
-				 client, 0);
-
-	/* watch to see if it's fallen off the bus */
-	g_signal_connect_object (priv->proxy,
-				 "notify::g-name-owner",
-				 G_CALLBACK (cd_client_owner_notify_cb),
-				 client, 0);
-
-	/* success */
-	g_task_return_boolean (task, TRUE);
+	/* completes when the properties are loaded */
+	cd_client_load_properties (client, g_steal_pointer (&task));
 }
 
 /**
@@ -412,6 +882,9 @@ cd_client_connect_cb (GObject *source_object,
  *
  * Connects to the colord daemon.
  *
+ * This uses the shared system bus connection, and the daemon properties
+ * are loaded with a single call rather than being watched by the proxy.
+ *
  * Since: 0.1.6
  **/
 void
@@ -435,9 +908,17 @@ cd_client_connect (CdClient *client,
 		return;
 	}
 
-	/* connect async */
+	/* reuse the proxy from checking the daemon was running */
+	if (priv->server_proxy != NULL) {
+		priv->proxy = g_steal_pointer (&priv->server_proxy);
+		cd_client_setup_proxy (client);
+		cd_client_load_properties (client, task);
+		return;
+	}
+
+	/* connect async, the properties are fetched with one call after */
 	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
 				  NULL,
 				  COLORD_DBUS_SERVICE,
 				  COLORD_DBUS_PATH,
@@ -885,7 +1366,9 @@ typedef struct {
 	CdClient		*client;
 	GFile			*dest;
 	GFile			*file;
+	gchar			*profile_id;
 	guint			 hangcheck_id;
+	GMainContext		*hangcheck_context;
 	guint			 profile_added_id;
 } CdClientImportTaskData;
 
@@ -915,15 +1398,24 @@ cd_client_import_task_data_free (CdClientImportTaskData *tdata)
 {
 	g_object_unref (tdata->file);
 	g_object_unref (tdata->dest);
+	g_free (tdata->profile_id);
 	if (tdata->profile_added_id > 0)
 		g_signal_handler_disconnect (tdata->client, tdata->profile_added_id);
 	if (tdata->client != NULL)
 		g_object_unref (tdata->client);
-	if (tdata->hangcheck_id > 0)
-		g_source_remove (tdata->hangcheck_id);
+	if (tdata->hangcheck_id > 0) {
+		GSource *source;
+		source = g_main_context_find_source_by_id (tdata->hangcheck_context,
+							   tdata->hangcheck_id);
+		if (source != NULL)
+			g_source_destroy (source);
+	}
+	if (tdata->hangcheck_context != NULL)
+		g_main_context_unref (tdata->hangcheck_context);
 	g_free (tdata);
 }
 
+#ifndef __unix__
 static void
 cd_client_import_profile_added_cb (CdClient *client,
 				   CdProfile *profile,
@@ -947,24 +1439,145 @@ cd_client_import_hangcheck_cb (gpointer user_data)
 	g_object_unref (task);
 	return G_SOURCE_REMOVE;
 }
-
+#else
 static void
-cd_client_import_profile_find_filename_cb (GObject *source_object,
-					   GAsyncResult *res,
-					   gpointer user_data)
+cd_client_import_profile_existing_cb (GObject *source_object,
+				      GAsyncResult *res,
+				      gpointer user_data)
 {
 	GTask *task = G_TASK (user_data);
-	CdClient *client = CD_CLIENT (source_object);
-	CdClientImportTaskData *tdata = g_task_get_task_data (task);
-	gboolean ret;
+	CdProfile *profile;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(CdProfile) profile = NULL;
 
-	/* does the profile already exist */
-	profile = cd_client_find_profile_by_filename_finish (client, res, &error);
-	if (profile != NULL) {
-		g_autofree gchar *filename = NULL;
-		filename = g_file_get_path (tdata->dest);
+	profile = cd_client_find_profile_finish (CD_CLIENT (source_object),
+						 res, &error);
+	if (profile == NULL) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		g_object_unref (task);
+		return;
+	}
+	g_task_return_pointer (task, profile, (GDestroyNotify) g_object_unref);
+	g_object_unref (task);
+}
+
+static void
+cd_client_import_profile_created_cb (GObject *source_object,
+				     GAsyncResult *res,
+				     gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	CdClient *client = CD_CLIENT (source_object);
+	CdClientImportTaskData *tdata = g_task_get_task_data (task);
+	CdProfile *profile;
+	g_autoptr(GError) error = NULL;
+
+	profile = cd_client_create_profile_finish (client, res, &error);
+	if (profile == NULL) {
+		/* the user already has this profile from another file */
+		if (g_error_matches (error,
+				     CD_CLIENT_ERROR,
+				     CD_CLIENT_ERROR_ALREADY_EXISTS)) {
+			cd_client_find_profile (client,
+						tdata->profile_id,
+						g_task_get_cancellable (task),
+						cd_client_import_profile_existing_cb,
+						task);
+			return;
+		}
+		g_task_return_error (task, g_steal_pointer (&error));
+		g_object_unref (task);
+		return;
+	}
+	g_task_return_pointer (task, profile, (GDestroyNotify) g_object_unref);
+	g_object_unref (task);
+}
+
+static void
+cd_client_import_profile_loaded_cb (GObject *source_object,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	CdClient *client = CD_CLIENT (g_task_get_source_object (task));
+	CdClientImportTaskData *tdata = g_task_get_task_data (task);
+	const gchar *checksum;
+	gsize len = 0;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *md5 = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) profile_props = NULL;
+
+	if (!g_file_load_contents_finish (G_FILE (source_object), res,
+					  &data, &len, NULL, &error)) {
+		g_task_return_new_error (task,
+					 CD_CLIENT_ERROR,
+					 CD_CLIENT_ERROR_INTERNAL,
+					 "Failed to read: %s",
+					 error->message);
+		g_object_unref (task);
+		return;
+	}
+
+	/* only the ID is needed, as the daemon parses the fd itself */
+	icc = cd_icc_new ();
+	if (!cd_icc_peek_data (icc, (const guint8 *) data, len, &error)) {
+		g_task_return_new_error (task,
+					 CD_CLIENT_ERROR,
+					 CD_CLIENT_ERROR_FILE_INVALID,
+					 "Failed to load: %s",
+					 error->message);
+		g_object_unref (task);
+		return;
+	}
+
+	/* use the same ID the daemon's file monitor would */
+	checksum = cd_icc_get_checksum (icc);
+	if (checksum == NULL) {
+		md5 = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+						   (const guchar *) data, len);
+		checksum = md5;
+	}
+	tdata->profile_id = g_strdup_printf ("icc-%s", checksum);
+	filename = g_file_get_path (tdata->dest);
+	profile_props = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (profile_props,
+			     (gpointer) CD_PROFILE_PROPERTY_FILENAME,
+			     (gpointer) filename);
+	g_hash_table_insert (profile_props,
+			     (gpointer) CD_PROFILE_METADATA_FILE_CHECKSUM,
+			     (gpointer) checksum);
+	cd_client_create_profile (client,
+				  tdata->profile_id,
+				  CD_OBJECT_SCOPE_NORMAL,
+				  profile_props,
+				  g_task_get_cancellable (task),
+				  cd_client_import_profile_created_cb,
+				  task);
+}
+#endif
+
+static void
+cd_client_import_profile_find_filename_cb (GObject *source_object,
+					   GAsyncResult *res,
+					   gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	CdClient *client = CD_CLIENT (source_object);
+	CdClientImportTaskData *tdata = g_task_get_task_data (task);
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(CdProfile) profile = NULL;
+#ifndef __unix__
+	g_autoptr(GSource) hangcheck = NULL;
+#endif
+
+	/* does the profile already exist */
+	profile = cd_client_find_profile_by_filename_finish (client, res, &error);
+	if (profile != NULL) {
+		g_autofree gchar *filename = NULL;
+		filename = g_file_get_path (tdata->dest);
 		g_task_return_new_error (task,
 					 CD_CLIENT_ERROR,
 					 CD_CLIENT_ERROR_ALREADY_EXISTS,
@@ -985,15 +1598,18 @@ cd_client_import_profile_find_filename_cb (GObject *source_object,
 	/* reset the error */
 	g_clear_error (&error);
 
+#ifndef __unix__
 	/* watch for a new profile to be detected and added,
 	 * but time out after a couple of seconds */
 	tdata->client = g_object_ref(client);
-	tdata->hangcheck_id = g_timeout_add (CD_CLIENT_IMPORT_DAEMON_TIMEOUT,
-					     cd_client_import_hangcheck_cb,
-					     task);
+	hangcheck = g_timeout_source_new (CD_CLIENT_IMPORT_DAEMON_TIMEOUT);
+	g_source_set_callback (hangcheck, cd_client_import_hangcheck_cb, task, NULL);
+	tdata->hangcheck_context = g_main_context_ref (g_task_get_context (task));
+	tdata->hangcheck_id = g_source_attach (hangcheck, tdata->hangcheck_context);
 	tdata->profile_added_id = g_signal_connect (client, "profile-added",
 						    G_CALLBACK (cd_client_import_profile_added_cb),
 						    task);
+#endif
 
 	/* copy profile to the correct place */
 	ret = cd_client_import_mkdir_and_copy (tdata->file,
@@ -1007,7 +1623,17 @@ cd_client_import_profile_find_filename_cb (GObject *source_object,
 					 "Failed to copy: %s",
 					 error->message);
 		g_object_unref (task);
+		return;
 	}
+
+#ifdef __unix__
+	/* register the copy with the daemon by passing the fd, rather
+	 * than waiting for the file monitor to notice it */
+	g_file_load_contents_async (tdata->dest,
+				    g_task_get_cancellable (task),
+				    cd_client_import_profile_loaded_cb,
+				    task);
+#endif
 }
 
 static void
@@ -1069,6 +1695,9 @@ cd_client_import_profile_query_info_cb (GObject *source_object,
  *
  * Imports a color profile into the users home directory.
  *
+ * The copy is registered with the daemon straight away by passing a file
+ * descriptor, rather than waiting for the daemon to notice the new file.
+ *
  * If the profile should be accessible for all users, then call
  * cd_profile_install_system_wide() on the result.
  *
@@ -1393,6 +2022,7 @@ cd_client_find_device_by_property_cb (GObject *source_object,
 				      GAsyncResult *res,
 				      gpointer user_data)
 {
+	CdClient *client = CD_CLIENT (g_task_get_source_object (G_TASK (user_data)));
 	CdDevice *device;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *object_path = NULL;
@@ -1411,8 +2041,8 @@ cd_client_find_device_by_property_cb (GObject *source_object,
 
 	/* create a device object */
 	g_variant_get (result, "(o)", &object_path);
-	device = cd_device_new ();
-	cd_device_set_object_path (device, object_path);
+	device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path);
+	cd_client_lookup_cache_add (client, g_task_get_task_data (task), object_path);
 
 	/* success */
 	g_task_return_pointer (task, device, (GDestroyNotify) g_object_unref);
@@ -1440,7 +2070,10 @@ cd_client_find_device_by_property (CdClient *client,
 				   gpointer user_data)
 {
 	CdClientPrivate *priv = GET_PRIVATE (client);
+	CdClientLookupHelper *helper = NULL;
 	GTask *task = NULL;
+	g_autofree gchar *object_path = NULL;
+	g_autofree gchar *query = NULL;
 
 	g_return_if_fail (CD_IS_CLIENT (client));
 	g_return_if_fail (key != NULL);
@@ -1448,6 +2081,19 @@ cd_client_find_device_by_property (CdClient *client,
 	g_return_if_fail (priv->proxy != NULL);
 
 	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+
+	/* already looked up */
+	query = g_strjoin ("\x1f", "FindDeviceByProperty", key, value, NULL);
+	object_path = cd_client_lookup_cache_get (client, query, &helper);
+	if (object_path != NULL) {
+		g_task_return_pointer (task,
+				       cd_client_object_new (client, CD_TYPE_DEVICE, object_path),
+				       (GDestroyNotify) g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+	if (helper != NULL)
+		g_task_set_task_data (task, helper, (GDestroyNotify) cd_client_lookup_helper_free);
 	g_dbus_proxy_call (priv->proxy,
 			   "FindDeviceByProperty",
 			   g_variant_new ("(ss)", key, value),
@@ -1577,6 +2223,7 @@ cd_client_find_profile_by_filename_cb (GObject *source_object,
 				       GAsyncResult *res,
 				       gpointer user_data)
 {
+	CdClient *client = CD_CLIENT (g_task_get_source_object (G_TASK (user_data)));
 	CdProfile *profile;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *object_path = NULL;
@@ -1595,8 +2242,8 @@ cd_client_find_profile_by_filename_cb (GObject *source_object,
 
 	/* create a profile object */
 	g_variant_get (result, "(o)", &object_path);
-	profile = cd_profile_new ();
-	cd_profile_set_object_path (profile, object_path);
+	profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path);
+	cd_client_lookup_cache_add (client, g_task_get_task_data (task), object_path);
 
 	/* success */
 	g_task_return_pointer (task, profile, (GDestroyNotify) g_object_unref);
@@ -1622,7 +2269,10 @@ cd_client_find_profile_by_filename (CdClient *client,
 				    gpointer user_data)
 {
 	CdClientPrivate *priv = GET_PRIVATE (client);
+	CdClientLookupHelper *helper = NULL;
 	GTask *task = NULL;
+	g_autofree gchar *object_path = NULL;
+	g_autofree gchar *query = NULL;
 
 	g_return_if_fail (CD_IS_CLIENT (client));
 	g_return_if_fail (filename != NULL);
@@ -1630,6 +2280,19 @@ cd_client_find_profile_by_filename (CdClient *client,
 	g_return_if_fail (priv->proxy != NULL);
 
 	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+
+	/* already looked up */
+	query = g_strjoin ("\x1f", "FindProfileByFilename", filename, NULL);
+	object_path = cd_client_lookup_cache_get (client, query, &helper);
+	if (object_path != NULL) {
+		g_task_return_pointer (task,
+				       cd_client_object_new (client, CD_TYPE_PROFILE, object_path),
+				       (GDestroyNotify) g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+	if (helper != NULL)
+		g_task_set_task_data (task, helper, (GDestroyNotify) cd_client_lookup_helper_free);
 	g_dbus_proxy_call (priv->proxy,
 			   "FindProfileByFilename",
 			   g_variant_new ("(s)", filename),
@@ -1668,6 +2331,7 @@ cd_client_get_standard_space_cb (GObject *source_object,
 				 GAsyncResult *res,
 				 gpointer user_data)
 {
+	CdClient *client = CD_CLIENT (g_task_get_source_object (G_TASK (user_data)));
 	CdProfile *profile;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *object_path = NULL;
@@ -1686,8 +2350,8 @@ cd_client_get_standard_space_cb (GObject *source_object,
 
 	/* create a profile object */
 	g_variant_get (result, "(o)", &object_path);
-	profile = cd_profile_new ();
-	cd_profile_set_object_path (profile, object_path);
+	profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path);
+	cd_client_lookup_cache_add (client, g_task_get_task_data (task), object_path);
 
 	/* success */
 	g_task_return_pointer (task, profile, (GDestroyNotify) g_object_unref);
@@ -1713,13 +2377,30 @@ cd_client_get_standard_space (CdClient *client,
 			      gpointer user_data)
 {
 	CdClientPrivate *priv = GET_PRIVATE (client);
+	CdClientLookupHelper *helper = NULL;
 	GTask *task = NULL;
+	g_autofree gchar *object_path = NULL;
+	g_autofree gchar *query = NULL;
 
 	g_return_if_fail (CD_IS_CLIENT (client));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
 	g_return_if_fail (priv->proxy != NULL);
 
 	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+
+	/* already looked up */
+	query = g_strjoin ("\x1f", "GetStandardSpace",
+			   cd_standard_space_to_string (standard_space), NULL);
+	object_path = cd_client_lookup_cache_get (client, query, &helper);
+	if (object_path != NULL) {
+		g_task_return_pointer (task,
+				       cd_client_object_new (client, CD_TYPE_PROFILE, object_path),
+				       (GDestroyNotify) g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+	if (helper != NULL)
+		g_task_set_task_data (task, helper, (GDestroyNotify) cd_client_lookup_helper_free);
 	g_dbus_proxy_call (priv->proxy,
 			   "GetStandardSpace",
 			   g_variant_new ("(s)",
@@ -1752,7 +2433,7 @@ cd_client_get_device_array_from_variant (CdClient *client,
 		g_autofree gchar *object_path_tmp = NULL;
 		g_variant_get_child (child, i,
 				     "o", &object_path_tmp);
-		device = cd_device_new_with_object_path (object_path_tmp);
+		device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path_tmp);
 		g_ptr_array_add (array, device);
 	}
 	return array;
@@ -1956,7 +2637,7 @@ cd_client_get_profile_array_from_variant (CdClient *client,
 		g_autofree gchar *object_path_tmp = NULL;
 		g_variant_get_child (child, i,
 				     "o", &object_path_tmp);
-		profile = cd_profile_new_with_object_path (object_path_tmp);
+		profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path_tmp);
 		g_ptr_array_add (array, profile);
 	}
 	return array;
@@ -2069,7 +2750,7 @@ cd_client_get_sensor_array_from_variant (CdClient *client,
 		g_autofree gchar *object_path_tmp = NULL;
 		g_variant_get_child (child, i,
 				     "o", &object_path_tmp);
-		sensor = cd_sensor_new_with_object_path (object_path_tmp);
+		sensor = cd_client_object_new (client, CD_TYPE_SENSOR, object_path_tmp);
 		g_ptr_array_add (array, sensor);
 	}
 	return array;
@@ -2163,6 +2844,593 @@ cd_client_get_sensors (CdClient *client,
 
 /**********************************************************************/
 
+typedef struct {
+	GPtrArray	*devices;
+	GPtrArray	*profiles;
+} CdClientSnapshot;
+
+static void
+cd_client_snapshot_free (CdClientSnapshot *snapshot)
+{
+	g_ptr_array_unref (snapshot->devices);
+	g_ptr_array_unref (snapshot->profiles);
+	g_free (snapshot);
+}
+
+/**
+ * cd_client_get_snapshot_finish:
+ * @client: a #CdClient instance.
+ * @res: the #GAsyncResult
+ * @devices: (out) (optional) (element-type CdDevice) (transfer container): the devices
+ * @profiles: (out) (optional) (element-type CdProfile) (transfer container): the profiles
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_get_snapshot_finish (CdClient *client,
+			       GAsyncResult *res,
+			       GPtrArray **devices,
+			       GPtrArray **profiles,
+			       GError **error)
+{
+	CdClientSnapshot *snapshot;
+
+	g_return_val_if_fail (g_task_is_valid (res, client), FALSE);
+
+	snapshot = g_task_propagate_pointer (G_TASK (res), error);
+	if (snapshot == NULL)
+		return FALSE;
+	if (devices != NULL)
+		*devices = g_ptr_array_ref (snapshot->devices);
+	if (profiles != NULL)
+		*profiles = g_ptr_array_ref (snapshot->profiles);
+	cd_client_snapshot_free (snapshot);
+	return TRUE;
+}
+
+static void
+cd_client_get_snapshot_process (GTask *task, GDBusProxy *proxy, GVariant *result)
+{
+	CdClient *client = CD_CLIENT (g_task_get_source_object (task));
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	CdClientSnapshot *snapshot;
+	GDBusConnection *connection;
+	GHashTable *object_paths = g_task_get_task_data (task);
+	GVariant *properties;
+	const gchar *object_path;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *name_owner = NULL;
+	g_autoptr(GVariantIter) iter_devices = NULL;
+	g_autoptr(GVariantIter) iter_profiles = NULL;
+
+	/* the objects are connected to the instance that replied */
+	name_owner = g_dbus_proxy_get_name_owner (proxy);
+	if (name_owner == NULL) {
+		g_task_return_new_error (task,
+					 CD_CLIENT_ERROR,
+					 CD_CLIENT_ERROR_INTERNAL,
+					 "%s has no owner",
+					 COLORD_DBUS_SERVICE);
+		return;
+	}
+	connection = g_dbus_proxy_get_connection (proxy);
+
+	/* one subscription delivers changes for all the objects */
+	if (priv->shared_proxy)
+		cd_client_shared_subscribe (client, connection, name_owner);
+
+	/* create objects with all their properties already set, reusing any
+	 * that are already connected, and only the ones asked for if set */
+	snapshot = g_new0 (CdClientSnapshot, 1);
+	snapshot->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	snapshot->profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_variant_get (result, "(a(oa{sv})a(oa{sv}))", &iter_devices, &iter_profiles);
+	while (g_variant_iter_loop (iter_devices, "(&o@a{sv})", &object_path, &properties)) {
+		gboolean ret;
+		g_autoptr(CdDevice) device = NULL;
+		if (object_paths != NULL && !g_hash_table_contains (object_paths, object_path))
+			continue;
+		device = cd_client_object_new (client, CD_TYPE_DEVICE, object_path);
+		if (priv->shared_proxy) {
+			ret = cd_device_connect_shared (device, connection, name_owner,
+							properties, &error);
+		} else {
+			ret = cd_device_connect_from_properties (device, connection, name_owner,
+								 properties, &error);
+		}
+		if (!ret) {
+			g_variant_unref (properties);
+			cd_client_snapshot_free (snapshot);
+			g_task_return_error (task, g_steal_pointer (&error));
+			return;
+		}
+		g_ptr_array_add (snapshot->devices, g_steal_pointer (&device));
+	}
+	while (g_variant_iter_loop (iter_profiles, "(&o@a{sv})", &object_path, &properties)) {
+		gboolean ret;
+		g_autoptr(CdProfile) profile = NULL;
+		if (object_paths != NULL && !g_hash_table_contains (object_paths, object_path))
+			continue;
+		profile = cd_client_object_new (client, CD_TYPE_PROFILE, object_path);
+		if (priv->shared_proxy) {
+			ret = cd_profile_connect_shared (profile, connection, name_owner,
+							 properties, &error);
+		} else {
+			ret = cd_profile_connect_from_properties (profile, connection, name_owner,
+								  properties, &error);
+		}
+		if (!ret) {
+			g_variant_unref (properties);
+			cd_client_snapshot_free (snapshot);
+			g_task_return_error (task, g_steal_pointer (&error));
+			return;
+		}
+		g_ptr_array_add (snapshot->profiles, g_steal_pointer (&profile));
+	}
+
+	/* success */
+	g_task_return_pointer (task, snapshot, (GDestroyNotify) cd_client_snapshot_free);
+}
+
+static void
+cd_client_get_snapshot_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GVariant) result = NULL;
+
+	result = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (result == NULL) {
+		cd_client_fixup_dbus_error (error);
+		g_task_return_error (task, error);
+		error = NULL;
+		return;
+	}
+	cd_client_get_snapshot_process (task, proxy, result);
+}
+
+#ifdef __unix__
+#define CD_CLIENT_SNAPSHOT_VERSION	1
+
+/* maps the sealed memfd from the daemon, returning the inner snapshot */
+static GVariant *
+cd_client_get_snapshot_from_fd (GDBusProxy *proxy,
+				GAsyncResult *res,
+				GError **error)
+{
+	gint fd;
+	guint32 version = 0;
+	guint64 generation = 0;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GUnixFDList) fd_list = NULL;
+	g_autoptr(GVariant) result = NULL;
+	g_autoptr(GVariant) snapshot = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	result = g_dbus_proxy_call_with_unix_fd_list_finish (proxy, &fd_list, res, error);
+	if (result == NULL)
+		return NULL;
+	if (fd_list == NULL || g_unix_fd_list_get_length (fd_list) != 1) {
+		g_set_error_literal (error,
+				     CD_CLIENT_ERROR,
+				     CD_CLIENT_ERROR_INTERNAL,
+				     "no snapshot fd returned");
+		return NULL;
+	}
+	fd = g_unix_fd_list_get (fd_list, 0, error);
+	if (fd < 0)
+		return NULL;
+	mapped_file = g_mapped_file_new_from_fd (fd, FALSE, error);
+	close (fd);
+	if (mapped_file == NULL)
+		return NULL;
+
+	/* the variant keeps the mapping alive */
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	value = g_variant_new_from_bytes (G_VARIANT_TYPE ("(ut(a(oa{sv})a(oa{sv})))"),
+					  bytes, FALSE);
+	g_variant_ref_sink (value);
+	g_variant_get (value, "(ut@(a(oa{sv})a(oa{sv})))",
+		       &version, &generation, &snapshot);
+	if (version != CD_CLIENT_SNAPSHOT_VERSION) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_NOT_SUPPORTED,
+			     "snapshot version %u not supported",
+			     version);
+		return NULL;
+	}
+	g_debug ("mapped snapshot generation %" G_GUINT64_FORMAT
+		 " of %" G_GSIZE_FORMAT " bytes",
+		 generation, g_bytes_get_size (bytes));
+	return g_steal_pointer (&snapshot);
+}
+
+static void
+cd_client_get_snapshot_fd_cb (GObject *source_object,
+			      GAsyncResult *res,
+			      gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GTask *task = G_TASK (user_data);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) snapshot = NULL;
+
+	/* fall back to copying the snapshot over the bus, e.g. for an
+	 * older daemon or a platform without memfd support */
+	snapshot = cd_client_get_snapshot_from_fd (proxy, res, &error);
+	if (snapshot == NULL &&
+	    g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		g_object_unref (task);
+		return;
+	}
+	if (snapshot == NULL) {
+		g_debug ("failed to get snapshot fd, falling back: %s",
+			 error->message);
+		g_dbus_proxy_call (proxy,
+				   "GetSnapshot",
+				   NULL,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   -1,
+				   g_task_get_cancellable (task),
+				   cd_client_get_snapshot_cb,
+				   task);
+		return;
+	}
+	cd_client_get_snapshot_process (task, proxy, snapshot);
+	g_object_unref (task);
+}
+#endif
+
+/*
+ * cd_client_get_snapshot_internal:
+ *
+ * Like cd_client_get_snapshot() but when @object_paths is set only the
+ * objects with those paths are created and connected.
+ */
+static void
+cd_client_get_snapshot_internal (CdClient *client,
+				 GHashTable *object_paths,
+				 GCancellable *cancellable,
+				 GAsyncReadyCallback callback,
+				 gpointer user_data)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	GTask *task = NULL;
+
+	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+	if (object_paths != NULL) {
+		g_task_set_task_data (task,
+				      g_hash_table_ref (object_paths),
+				      (GDestroyNotify) g_hash_table_unref);
+	}
+#ifdef __unix__
+	g_dbus_proxy_call_with_unix_fd_list (priv->proxy,
+					     "GetSnapshotFd",
+					     NULL,
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1,
+					     NULL,
+					     cancellable,
+					     cd_client_get_snapshot_fd_cb,
+					     task);
+#else
+	g_dbus_proxy_call (priv->proxy,
+			   "GetSnapshot",
+			   NULL,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   cancellable,
+			   cd_client_get_snapshot_cb,
+			   task);
+#endif
+}
+
+/**
+ * cd_client_get_snapshot:
+ * @client: a #CdClient instance.
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets all the devices and profiles in one request. The returned objects
+ * are already connected and have all their properties set, so there is
+ * no need to call cd_device_connect() or cd_profile_connect() on them.
+ *
+ * Where possible the daemon shares the data as a sealed memory file that
+ * is mapped rather than copied over the bus.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_client_get_snapshot (CdClient *client,
+			GCancellable *cancellable,
+			GAsyncReadyCallback callback,
+			gpointer user_data)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+
+	g_return_if_fail (CD_IS_CLIENT (client));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_return_if_fail (priv->proxy != NULL);
+
+	cd_client_get_snapshot_internal (client, NULL, cancellable, callback, user_data);
+}
+
+/**********************************************************************/
+
+#define CD_CLIENT_CONNECT_OBJECTS_MAX_PENDING	8
+#define CD_CLIENT_CONNECT_OBJECTS_SNAPSHOT_MIN	4
+
+typedef struct {
+	GPtrArray	*objects;	/* not yet connected */
+	guint		 idx;
+	guint		 pending;
+	GError		*error;
+} CdClientConnectHelper;
+
+static void
+cd_client_connect_helper_free (CdClientConnectHelper *helper)
+{
+	g_ptr_array_unref (helper->objects);
+	if (helper->error != NULL)
+		g_error_free (helper->error);
+	g_free (helper);
+}
+
+static gboolean
+cd_client_object_get_connected (GObject *obj)
+{
+	if (CD_IS_DEVICE (obj))
+		return cd_device_get_connected (CD_DEVICE (obj));
+	if (CD_IS_PROFILE (obj))
+		return cd_profile_get_connected (CD_PROFILE (obj));
+	if (CD_IS_SENSOR (obj))
+		return cd_sensor_get_connected (CD_SENSOR (obj));
+	return TRUE;
+}
+
+/*
+ * cd_client_object_adopt:
+ *
+ * Puts an object the caller created into the object table so that the
+ * snapshot connects it in place, unless another live instance for the same
+ * object path is already there.
+ */
+static void
+cd_client_object_adopt (CdClient *client, GObject *obj)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	GWeakRef *weak;
+	const gchar *object_path;
+	g_autoptr(GObject) obj_tmp = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (CD_IS_DEVICE (obj))
+		object_path = cd_device_get_object_path (CD_DEVICE (obj));
+	else if (CD_IS_PROFILE (obj))
+		object_path = cd_profile_get_object_path (CD_PROFILE (obj));
+	else
+		return;
+	if (object_path == NULL)
+		return;
+
+	locker = g_mutex_locker_new (&priv->objects_mutex);
+	weak = g_hash_table_lookup (priv->objects, object_path);
+	if (weak == NULL) {
+		weak = g_new0 (GWeakRef, 1);
+		g_weak_ref_init (weak, obj);
+		g_hash_table_insert (priv->objects, g_strdup (object_path), weak);
+		return;
+	}
+	obj_tmp = g_weak_ref_get (weak);
+	if (obj_tmp == NULL)
+		g_weak_ref_set (weak, obj);
+}
+
+static void	cd_client_connect_objects_start	(GTask *task);
+
+static void
+cd_client_connect_objects_cb (GObject *source_object,
+			      GAsyncResult *res,
+			      gpointer user_data)
+{
+	CdClientConnectHelper *helper;
+	gboolean ret = FALSE;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+
+	if (CD_IS_DEVICE (source_object))
+		ret = cd_device_connect_finish (CD_DEVICE (source_object), res, &error);
+	else if (CD_IS_PROFILE (source_object))
+		ret = cd_profile_connect_finish (CD_PROFILE (source_object), res, &error);
+	else if (CD_IS_SENSOR (source_object))
+		ret = cd_sensor_connect_finish (CD_SENSOR (source_object), res, &error);
+
+	/* keep the first error and do not start any more */
+	helper = g_task_get_task_data (task);
+	helper->pending--;
+	if (!ret && helper->error == NULL) {
+		helper->error = g_steal_pointer (&error);
+		helper->idx = helper->objects->len;
+	}
+	cd_client_connect_objects_start (task);
+}
+
+static void
+cd_client_connect_objects_start (GTask *task)
+{
+	CdClientConnectHelper *helper = g_task_get_task_data (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	/* keep a bounded number of connections in flight */
+	while (helper->pending < CD_CLIENT_CONNECT_OBJECTS_MAX_PENDING &&
+	       helper->idx < helper->objects->len) {
+		GObject *obj = g_ptr_array_index (helper->objects, helper->idx++);
+		if (cd_client_object_get_connected (obj))
+			continue;
+		helper->pending++;
+		if (CD_IS_DEVICE (obj)) {
+			cd_device_connect (CD_DEVICE (obj), cancellable,
+					   cd_client_connect_objects_cb,
+					   g_object_ref (task));
+		} else if (CD_IS_PROFILE (obj)) {
+			cd_profile_connect (CD_PROFILE (obj), cancellable,
+					    cd_client_connect_objects_cb,
+					    g_object_ref (task));
+		} else {
+			cd_sensor_connect (CD_SENSOR (obj), cancellable,
+					   cd_client_connect_objects_cb,
+					   g_object_ref (task));
+		}
+	}
+
+	/* all done */
+	if (helper->pending > 0 || helper->idx < helper->objects->len)
+		return;
+	if (helper->error != NULL) {
+		g_task_return_error (task, g_steal_pointer (&helper->error));
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+cd_client_connect_objects_snapshot_cb (GObject *source_object,
+				       GAsyncResult *res,
+				       gpointer user_data)
+{
+	CdClient *client = CD_CLIENT (source_object);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+
+	/* older daemons do not have the method, so connect one by one */
+	if (!cd_client_get_snapshot_finish (client, res, NULL, NULL, &error)) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_task_return_error (task, g_steal_pointer (&error));
+			return;
+		}
+		g_debug ("failed to get snapshot, connecting objects: %s",
+			 error->message);
+	}
+
+	/* anything not in the snapshot, or that already had another
+	 * instance, is connected individually */
+	cd_client_connect_objects_start (task);
+}
+
+/**
+ * cd_client_connect_objects_finish:
+ * @client: a #CdClient instance.
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_client_connect_objects_finish (CdClient *client,
+				  GAsyncResult *res,
+				  GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, client), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * cd_client_connect_objects:
+ * @client: a #CdClient instance.
+ * @objects: (element-type GObject): an array of #CdDevice, #CdProfile or #CdSensor objects
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Connects all the objects in the array, calling @callback once when they
+ * have all been connected or the first one failed.
+ *
+ * When there are several devices or profiles to connect these are filled
+ * in from a single cd_client_get_snapshot() request where the daemon
+ * supports it, and no other objects are connected as a side effect. Any remaining objects are connected concurrently, with a
+ * limit on the number of requests in flight.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_client_connect_objects (CdClient *client,
+			   GPtrArray *objects,
+			   GCancellable *cancellable,
+			   GAsyncReadyCallback callback,
+			   gpointer user_data)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	CdClientConnectHelper *helper;
+	const gchar *object_path;
+	guint i;
+	g_autoptr(GHashTable) object_paths = NULL;
+	g_autoptr(GTask) task = NULL;
+
+	g_return_if_fail (CD_IS_CLIENT (client));
+	g_return_if_fail (objects != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+	helper = g_new0 (CdClientConnectHelper, 1);
+	helper->objects = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	object_paths = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < objects->len; i++) {
+		GObject *obj = g_ptr_array_index (objects, i);
+		if (!CD_IS_DEVICE (obj) && !CD_IS_PROFILE (obj) && !CD_IS_SENSOR (obj)) {
+			g_task_return_new_error (task,
+						 CD_CLIENT_ERROR,
+						 CD_CLIENT_ERROR_INTERNAL,
+						 "cannot connect object of type %s",
+						 G_OBJECT_TYPE_NAME (obj));
+			cd_client_connect_helper_free (helper);
+			return;
+		}
+		if (cd_client_object_get_connected (obj))
+			continue;
+		if (CD_IS_DEVICE (obj))
+			object_path = cd_device_get_object_path (CD_DEVICE (obj));
+		else if (CD_IS_PROFILE (obj))
+			object_path = cd_profile_get_object_path (CD_PROFILE (obj));
+		else
+			object_path = NULL;
+		if (object_path != NULL)
+			g_hash_table_add (object_paths, (gpointer) object_path);
+		g_ptr_array_add (helper->objects, g_object_ref (obj));
+	}
+	g_task_set_task_data (task, helper, (GDestroyNotify) cd_client_connect_helper_free);
+
+	/* one request is cheaper than many once there are a few objects,
+	 * although only the ones asked for are connected from it */
+	if (priv->proxy != NULL &&
+	    g_hash_table_size (object_paths) >= CD_CLIENT_CONNECT_OBJECTS_SNAPSHOT_MIN) {
+		for (i = 0; i < helper->objects->len; i++)
+			cd_client_object_adopt (client, g_ptr_array_index (helper->objects, i));
+		cd_client_get_snapshot_internal (client, object_paths, cancellable,
+						 cd_client_connect_objects_snapshot_cb,
+						 g_steal_pointer (&task));
+		return;
+	}
+	cd_client_connect_objects_start (task);
+}
+
+/**********************************************************************/
+
 /**
  * cd_client_find_profile_by_property_finish:
  * @client: a #CdClient instance.
@@ -2347,6 +3615,78 @@ cd_client_find_sensor (CdClient *client,
 
 /**********************************************************************/
 
+/**
+ * cd_client_create_sensor_group_finish:
+ * @client: a #CdClient instance.
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: (transfer full): a #CdSensor or %NULL
+ *
+ * Since: 1.4.10
+ **/
+CdSensor *
+cd_client_create_sensor_group_finish (CdClient *client,
+				      GAsyncResult *res,
+				      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, client), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * cd_client_create_sensor_group:
+ * @client: a #CdClient instance.
+ * @sensors: (element-type CdSensor): the sensors to group, at least two
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Creates a sensor that locks and samples all of @sensors at the same
+ * time. The group is removed when this client disconnects.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_client_create_sensor_group (CdClient *client,
+			       GPtrArray *sensors,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	CdClientPrivate *priv = GET_PRIVATE (client);
+	GTask *task = NULL;
+	GVariantBuilder builder;
+	guint i;
+
+	g_return_if_fail (CD_IS_CLIENT (client));
+	g_return_if_fail (sensors != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_return_if_fail (priv->proxy != NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("ao"));
+	for (i = 0; i < sensors->len; i++) {
+		CdSensor *sensor = g_ptr_array_index (sensors, i);
+		g_variant_builder_add (&builder, "o",
+				       cd_sensor_get_object_path (sensor));
+	}
+
+	/* the reply is the same as FindSensorById */
+	task = g_task_new (G_OBJECT (client), cancellable, callback, user_data);
+	g_dbus_proxy_call (priv->proxy,
+			   "CreateSensorGroup",
+			   g_variant_new ("(ao)", &builder),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   cancellable,
+			   cd_client_find_sensor_cb,
+			   task);
+}
+
+/**********************************************************************/
+
 /*
  * cd_client_get_property:
  */
@@ -2461,6 +3801,25 @@ cd_client_class_init (CdClientClass *klass)
 			      NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
 			      G_TYPE_NONE, 1, CD_TYPE_DEVICE);
 
+	/**
+	 * CdClient::devices-added:
+	 * @client: the #CdClient instance that emitted the signal
+	 * @devices: (element-type CdDevice): the #CdDevice objects that were added.
+	 *
+	 * The ::devices-added signal is emitted shortly after one or more
+	 * devices are added, after the ::device-added signal for each one.
+	 * This is useful for clients that want to do work only once when many
+	 * devices are added at the same time.
+	 *
+	 * Since: 1.4.10
+	 **/
+	signals [SIGNAL_DEVICES_ADDED] =
+		g_signal_new ("devices-added",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (CdClientClass, devices_added),
+			      NULL, NULL, g_cclosure_marshal_VOID__BOXED,
+			      G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
 	/**
 	 * CdClient::device-removed:
 	 * @client: the #CdClient instance that emitted the signal
@@ -2507,6 +3866,26 @@ cd_client_class_init (CdClientClass *klass)
 			      NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
 			      G_TYPE_NONE, 1, CD_TYPE_PROFILE);
 
+	/**
+	 * CdClient::profiles-added:
+	 * @client: the #CdClient instance that emitted the signal
+	 * @profiles: (element-type CdProfile): the #CdProfile objects that were added.
+	 *
+	 * The ::profiles-added signal is emitted shortly after one or more
+	 * profiles are added, after the ::profile-added signal for each one.
+	 * This is useful for clients that want to do work only once when many
+	 * profiles are added at the same time, for instance when the daemon
+	 * starts.
+	 *
+	 * Since: 1.4.10
+	 **/
+	signals [SIGNAL_PROFILES_ADDED] =
+		g_signal_new ("profiles-added",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (CdClientClass, profiles_added),
+			      NULL, NULL, g_cclosure_marshal_VOID__BOXED,
+			      G_TYPE_NONE, 1, G_TYPE_PTR_ARRAY);
+
 	/**
 	 * CdClient::profile-removed:
 	 * @client: the #CdClient instance that emitted the signal
@@ -2607,6 +3986,16 @@ cd_client_class_init (CdClientClass *klass)
 static void
 cd_client_init (CdClient *client)
 {
+	CdClientPrivate *priv = GET_PRIVATE (client);
+
+	g_mutex_init (&priv->objects_mutex);
+	priv->objects = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free,
+					       (GDestroyNotify) cd_client_object_ref_free);
+	priv->objects_prune_size = CD_CLIENT_OBJECTS_PRUNE_SIZE;
+	priv->lookups = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, g_free);
+
 	/* ensure the remote errors are registered */
 	cd_client_error_quark ();
 }
@@ -2625,6 +4014,12 @@ cd_client_finalize (GObject *object)
 	g_free (priv->daemon_version);
 	g_free (priv->system_vendor);
 	g_free (priv->system_model);
+	cd_client_shared_unsubscribe (client);
+	g_hash_table_unref (priv->objects);
+	g_hash_table_unref (priv->lookups);
+	g_mutex_clear (&priv->objects_mutex);
+	if (priv->server_proxy != NULL)
+		g_object_unref (priv->server_proxy);
 	if (priv->proxy != NULL)
 		g_object_unref (priv->proxy);
 
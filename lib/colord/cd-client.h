@@ -63,10 +63,12 @@ struct _CdClientClass
 	void			(*sensor_changed)	(CdClient		*client,
 							 CdSensor		*sensor);
 	void			(*changed)              (CdClient		*client);
+	void			(*devices_added)	(CdClient		*client,
+							 GPtrArray		*devices);
+	void			(*profiles_added)	(CdClient		*client,
+							 GPtrArray		*profiles);
 	/*< private >*/
 	/* Padding for future expansion */
-	void (*_cd_client_reserved1) (void);
-	void (*_cd_client_reserved2) (void);
 	void (*_cd_client_reserved3) (void);
 	void (*_cd_client_reserved4) (void);
 	void (*_cd_client_reserved5) (void);
@@ -226,6 +228,23 @@ GPtrArray	*cd_client_get_sensors_finish		(CdClient	*client,
 							 GAsyncResult	*res,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_client_get_snapshot			(CdClient	*client,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 cd_client_get_snapshot_finish		(CdClient	*client,
+							 GAsyncResult	*res,
+							 GPtrArray	**devices,
+							 GPtrArray	**profiles,
+							 GError		**error);
+void		 cd_client_connect_objects		(CdClient	*client,
+							 GPtrArray	*objects,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 cd_client_connect_objects_finish	(CdClient	*client,
+							 GAsyncResult	*res,
+							 GError		**error);
 void		cd_client_find_profile_by_property	(CdClient	*client,
 							 const gchar	*key,
 							 const gchar	*value,
@@ -245,6 +264,15 @@ CdSensor	*cd_client_find_sensor_finish 		(CdClient	*client,
 							 GAsyncResult	*res,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+void		cd_client_create_sensor_group		(CdClient	*client,
+							 GPtrArray	*sensors,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+CdSensor	*cd_client_create_sensor_group_finish	(CdClient	*client,
+							 GAsyncResult	*res,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 /* getters */
 gboolean	 cd_client_get_connected		(CdClient	*client);
@@ -252,6 +280,14 @@ gboolean	 cd_client_get_has_server		(CdClient	*client);
 const gchar	*cd_client_get_daemon_version		(CdClient	*client);
 const gchar	*cd_client_get_system_vendor		(CdClient	*client);
 const gchar	*cd_client_get_system_model		(CdClient	*client);
+gboolean	 cd_client_get_shared_proxy		(CdClient	*client);
+gboolean	 cd_client_get_lookup_cache		(CdClient	*client);
+
+/* setters */
+void		 cd_client_set_shared_proxy		(CdClient	*client,
+							 gboolean	 shared_proxy);
+void		 cd_client_set_lookup_cache		(CdClient	*client,
+							 gboolean	 lookup_cache);
 
 G_END_DECLS
 
@@ -34,8 +34,7 @@
 
 #include "cd-color.h"
 #include "cd-interp.h"
-#include "cd-interp-akima.h"
-#include "cd-interp-linear.h"
+#include "cd-interp-monotone.h"
 
 /* this is private */
 struct _CdColorSwatch {
@@ -555,12 +554,156 @@ cd_color_lab_set (CdColorLab *dest, gdouble L, gdouble a, gdouble b)
  *
  * Since: 0.1.32
  **/
+static inline gdouble
+cd_color_lab_delta_e76_internal (const CdColorLab *p1, const CdColorLab *p2)
+{
+	gdouble dL = p2->L - p1->L;
+	gdouble da = p2->a - p1->a;
+	gdouble db = p2->b - p1->b;
+	return sqrt (dL * dL + da * da + db * db);
+}
+
 gdouble
 cd_color_lab_delta_e76 (const CdColorLab *p1, const CdColorLab *p2)
 {
-	return sqrt (pow (p2->L - p1->L, 2) +
-		     pow (p2->a - p1->a, 2) +
-		     pow (p2->b - p1->b, 2));
+	return cd_color_lab_delta_e76_internal (p1, p2);
+}
+
+/* the graphic arts weights, with @p1 as the reference */
+static inline gdouble
+cd_color_lab_delta_e94_internal (const CdColorLab *p1, const CdColorLab *p2)
+{
+	gdouble c1 = sqrt (p1->a * p1->a + p1->b * p1->b);
+	gdouble c2 = sqrt (p2->a * p2->a + p2->b * p2->b);
+	gdouble dL = p1->L - p2->L;
+	gdouble da = p1->a - p2->a;
+	gdouble db = p1->b - p2->b;
+	gdouble dC = c1 - c2;
+	gdouble dH2 = da * da + db * db - dC * dC;
+	gdouble sc = 1.f + 0.045f * c1;
+	gdouble sh = 1.f + 0.015f * c1;
+
+	/* rounding can make this slightly negative for neutral colors */
+	if (dH2 < 0.f)
+		dH2 = 0.f;
+	return sqrt (dL * dL + (dC * dC) / (sc * sc) + dH2 / (sh * sh));
+}
+
+/**
+ * cd_color_lab_delta_e94:
+ * @p1: Lab value 1, the reference color
+ * @p2: Lab value 2, the sample color
+ *
+ * Calculates the ΔE of two colors using the CIE94 formula with the
+ * graphic arts weighting factors. Unlike the other formulas the result
+ * depends on which color is the reference.
+ *
+ * Return value: distance metric, where JND ΔE ≈ 1
+ *
+ * Since: 1.4.10
+ **/
+gdouble
+cd_color_lab_delta_e94 (const CdColorLab *p1, const CdColorLab *p2)
+{
+	return cd_color_lab_delta_e94_internal (p1, p2);
+}
+
+/**
+ * cd_color_lab_delta_e2000:
+ * @p1: Lab value 1
+ * @p2: Lab value 2
+ *
+ * Calculates the ΔE of two colors using the CIEDE2000 formula, with
+ * all the weighting factors set to 1.
+ *
+ * Return value: distance metric, where JND ΔE ≈ 1
+ *
+ * Since: 1.4.10
+ **/
+gdouble
+cd_color_lab_delta_e2000 (const CdColorLab *p1, const CdColorLab *p2)
+{
+	return cmsCIE2000DeltaE ((const cmsCIELab *) p1,
+				 (const cmsCIELab *) p2,
+				 1.f, 1.f, 1.f);
+}
+
+/**
+ * cd_color_lab_delta_e76_array:
+ * @src1: (array length=len): the reference colors
+ * @src2: (array length=len): the sample colors
+ * @dest: (array length=len): the ΔE of each pair of colors
+ * @len: the number of colors
+ *
+ * Calculates the ΔE of each pair of colors using the 1976 formula, for
+ * instance when comparing a chart or image against a reference.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_lab_delta_e76_array (const CdColorLab *src1,
+			      const CdColorLab *src2,
+			      gdouble *dest,
+			      guint len)
+{
+	g_return_if_fail (src1 != NULL || len == 0);
+	g_return_if_fail (src2 != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	for (guint i = 0; i < len; i++)
+		dest[i] = cd_color_lab_delta_e76_internal (&src1[i], &src2[i]);
+}
+
+/**
+ * cd_color_lab_delta_e94_array:
+ * @src1: (array length=len): the reference colors
+ * @src2: (array length=len): the sample colors
+ * @dest: (array length=len): the ΔE of each pair of colors
+ * @len: the number of colors
+ *
+ * Calculates the ΔE of each pair of colors in the same way as
+ * cd_color_lab_delta_e94().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_lab_delta_e94_array (const CdColorLab *src1,
+			      const CdColorLab *src2,
+			      gdouble *dest,
+			      guint len)
+{
+	g_return_if_fail (src1 != NULL || len == 0);
+	g_return_if_fail (src2 != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	for (guint i = 0; i < len; i++)
+		dest[i] = cd_color_lab_delta_e94_internal (&src1[i], &src2[i]);
+}
+
+/**
+ * cd_color_lab_delta_e2000_array:
+ * @src1: (array length=len): the reference colors
+ * @src2: (array length=len): the sample colors
+ * @dest: (array length=len): the ΔE of each pair of colors
+ * @len: the number of colors
+ *
+ * Calculates the ΔE of each pair of colors in the same way as
+ * cd_color_lab_delta_e2000().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_lab_delta_e2000_array (const CdColorLab *src1,
+				const CdColorLab *src2,
+				gdouble *dest,
+				guint len)
+{
+	g_return_if_fail (src1 != NULL || len == 0);
+	g_return_if_fail (src2 != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+	for (guint i = 0; i < len; i++) {
+		dest[i] = cmsCIE2000DeltaE ((const cmsCIELab *) &src1[i],
+					    (const cmsCIELab *) &src2[i],
+					    1.f, 1.f, 1.f);
+	}
 }
 
 /**
@@ -870,6 +1013,188 @@ cd_color_xyz_to_cct (const CdColorXYZ *src)
 	return value;
 }
 
+/**
+ * cd_color_xyz_to_cct_array:
+ * @src: (array length=len): the source colors
+ * @dest: (array length=len): the correlated color temperatures
+ * @len: the number of colors
+ *
+ * Gets the correlated color temperature for each XYZ value, as
+ * cd_color_xyz_to_cct(). Values that cannot be converted are set to -1.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_xyz_to_cct_array (const CdColorXYZ *src, gdouble *dest, guint len)
+{
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	for (i = 0; i < len; i++)
+		dest[i] = cd_color_xyz_to_cct (&src[i]);
+}
+
+/* the table spans the range of the cd_color_uvw_set_planckian_locus() fit */
+#define CD_COLOR_CCT_TABLE_MIN		1000.f	/* K */
+#define CD_COLOR_CCT_TABLE_MAX		15000.f	/* K */
+#define CD_COLOR_CCT_TABLE_STEP		1.01f	/* ratio between entries */
+
+/* above this distance from the locus the triangular solution is poor */
+#define CD_COLOR_CCT_DUV_PARABOLIC	0.002f
+
+typedef struct {
+	gdouble		 T;
+	gdouble		 u;
+	gdouble		 v;
+} CdColorCctEntry;
+
+static const CdColorCctEntry *
+cd_color_cct_get_table (guint *len)
+{
+	static CdColorCctEntry *table = NULL;
+	static gsize table_len = 0;
+
+	if (g_once_init_enter (&table_len)) {
+		CdColorCctEntry *tmp;
+		CdColorUVW uvw;
+		guint i;
+		guint n;
+
+		n = ceil (log (CD_COLOR_CCT_TABLE_MAX / CD_COLOR_CCT_TABLE_MIN) /
+			  log (CD_COLOR_CCT_TABLE_STEP)) + 1;
+		tmp = g_new (CdColorCctEntry, n);
+		for (i = 0; i < n; i++) {
+			tmp[i].T = MIN (CD_COLOR_CCT_TABLE_MIN *
+					pow (CD_COLOR_CCT_TABLE_STEP, i),
+					CD_COLOR_CCT_TABLE_MAX);
+			cd_color_uvw_set_planckian_locus (&uvw, tmp[i].T);
+			tmp[i].u = uvw.U;
+			tmp[i].v = uvw.V;
+		}
+		table = tmp;
+		g_once_init_leave (&table_len, n);
+	}
+	*len = table_len;
+	return table;
+}
+
+/**
+ * cd_color_xyz_to_cct_duv:
+ * @src: the source color
+ * @duv: (out) (optional): the distance from the Planckian locus, or %NULL
+ *
+ * Gets the correlated color temperature and the signed distance from the
+ * Planckian locus in the CIE 1960 UCS, using the combined triangular and
+ * parabolic method from Ohno (2014) on a precomputed table of the locus.
+ * Colors above the locus have a positive @duv.
+ *
+ * Return value: the temperature in Kelvin, or -1 if outside 1000K to 15000K
+ *
+ * Since: 1.4.10
+ **/
+gdouble
+cd_color_xyz_to_cct_duv (const CdColorXYZ *src, gdouble *duv)
+{
+	const CdColorCctEntry *table;
+	const CdColorCctEntry *p0, *p1, *p2;
+	gdouble best = G_MAXDOUBLE;
+	gdouble d0, d1, d2;
+	gdouble D, T;
+	gdouble l, x;
+	gdouble sign;
+	gdouble sum;
+	gdouble u, v;
+	guint best_idx = 0;
+	guint len;
+	guint i;
+
+	g_return_val_if_fail (src != NULL, -1.f);
+
+	/* no chromaticity */
+	sum = src->X + 15 * src->Y + 3 * src->Z;
+	if (fabs (sum) < 1e-6)
+		return -1.f;
+	u = 4 * src->X / sum;
+	v = 6 * src->Y / sum;
+
+	/* find the closest entry */
+	table = cd_color_cct_get_table (&len);
+	for (i = 0; i < len; i++) {
+		gdouble du = u - table[i].u;
+		gdouble dv = v - table[i].v;
+		gdouble dist = du * du + dv * dv;
+		if (dist < best) {
+			best = dist;
+			best_idx = i;
+		}
+	}
+
+	/* the closest point has to be bracketed */
+	if (best_idx == 0 || best_idx == len - 1)
+		return -1.f;
+	p0 = &table[best_idx - 1];
+	p1 = &table[best_idx];
+	p2 = &table[best_idx + 1];
+	d0 = hypot (u - p0->u, v - p0->v);
+	d1 = sqrt (best);
+	d2 = hypot (u - p2->u, v - p2->v);
+
+	/* triangular solution */
+	l = hypot (p2->u - p0->u, p2->v - p0->v);
+	x = (d0 * d0 - d2 * d2 + l * l) / (2 * l);
+	T = p0->T + (p2->T - p0->T) * x / l;
+	sign = v - (p0->v + (p2->v - p0->v) * x / l) >= 0 ? 1.f : -1.f;
+	D = sqrt (MAX (d0 * d0 - x * x, 0.f));
+
+	/* parabolic solution when further from the locus */
+	if (D >= CD_COLOR_CCT_DUV_PARABOLIC) {
+		gdouble X = (p2->T - p1->T) * (p0->T - p2->T) * (p1->T - p0->T);
+		gdouble a = (p0->T * (d2 - d1) +
+			     p1->T * (d0 - d2) +
+			     p2->T * (d1 - d0)) / X;
+		gdouble b = -(p0->T * p0->T * (d2 - d1) +
+			      p1->T * p1->T * (d0 - d2) +
+			      p2->T * p2->T * (d1 - d0)) / X;
+		gdouble c = -(d0 * (p2->T - p1->T) * p1->T * p2->T +
+			      d1 * (p0->T - p2->T) * p0->T * p2->T +
+			      d2 * (p1->T - p0->T) * p0->T * p1->T) / X;
+		T = -b / (2 * a);
+		D = a * T * T + b * T + c;
+	}
+	if (duv != NULL)
+		*duv = sign * D;
+	return T;
+}
+
+/**
+ * cd_color_xyz_to_cct_duv_array:
+ * @src: (array length=len): the source colors
+ * @cct: (array length=len): the correlated color temperatures
+ * @duv: (array length=len) (optional): the distances from the locus, or %NULL
+ * @len: the number of colors
+ *
+ * Gets the correlated color temperature and distance from the Planckian
+ * locus for each XYZ value, as cd_color_xyz_to_cct_duv().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_xyz_to_cct_duv_array (const CdColorXYZ *src,
+			       gdouble *cct,
+			       gdouble *duv,
+			       guint len)
+{
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (cct != NULL || len == 0);
+
+	for (i = 0; i < len; i++)
+		cct[i] = cd_color_xyz_to_cct_duv (&src[i], duv != NULL ? &duv[i] : NULL);
+}
+
 /**
  * cd_color_uvw_get_chroma_difference:
  * @p1: color
@@ -1002,6 +1327,207 @@ cd_color_yxy_to_uvw (const CdColorYxy *src, CdColorUVW *dest)
 	dest->W = src->Y;
 }
 
+/**
+ * cd_color_xyz_to_yxy_array:
+ * @src: (array length=len): the source colors
+ * @dest: (array length=len): the destination colors
+ * @len: the number of colors
+ *
+ * Converts an array of colors in one pass, as cd_color_xyz_to_yxy().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_xyz_to_yxy_array (const CdColorXYZ *src, CdColorYxy *dest, guint len)
+{
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	for (i = 0; i < len; i++) {
+		gdouble sum = src[i].X + src[i].Y + src[i].Z;
+		gdouble Y = src[i].Y;
+		gdouble x = 0.f;
+		gdouble y = 0.f;
+
+		/* prevent division by zero */
+		if (fabs (sum) < 1e-6) {
+			Y = 0.f;
+		} else {
+			x = src[i].X / sum;
+			y = src[i].Y / sum;
+		}
+		dest[i].Y = Y;
+		dest[i].x = x;
+		dest[i].y = y;
+	}
+}
+
+/**
+ * cd_color_yxy_to_xyz_array:
+ * @src: (array length=len): the source colors
+ * @dest: (array length=len): the destination colors
+ * @len: the number of colors
+ *
+ * Converts an array of colors in one pass, as cd_color_yxy_to_xyz().
+ * Unlike the single color version the values are not range checked.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_yxy_to_xyz_array (const CdColorYxy *src, CdColorXYZ *dest, guint len)
+{
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	for (i = 0; i < len; i++) {
+		gdouble Y = src[i].Y;
+		gdouble scale;
+
+		/* very small luminance */
+		if (Y < 1e-6) {
+			cd_color_xyz_clear (&dest[i]);
+			continue;
+		}
+		scale = Y / src[i].y;
+		dest[i].X = src[i].x * scale;
+		dest[i].Y = Y;
+		dest[i].Z = (1.0f - src[i].x - src[i].y) * scale;
+	}
+}
+
+/* CIE 1976 companding function, with its linear toe */
+static inline gdouble
+cd_color_lab_f (gdouble t)
+{
+	const gdouble delta = 6.f / 29.f;
+	if (t > delta * delta * delta)
+		return cbrt (t);
+	return t / (3 * delta * delta) + 4.f / 29.f;
+}
+
+static inline gdouble
+cd_color_lab_f_inv (gdouble t)
+{
+	const gdouble delta = 6.f / 29.f;
+	if (t > delta)
+		return t * t * t;
+	return 3 * delta * delta * (t - 4.f / 29.f);
+}
+
+/**
+ * cd_color_xyz_to_lab_array:
+ * @src: (array length=len): the source colors
+ * @whitepoint: the reference white, in the same scale as @src
+ * @dest: (array length=len): the destination colors
+ * @len: the number of colors
+ *
+ * Converts an array of colors to CIE 1976 L*a*b*.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_xyz_to_lab_array (const CdColorXYZ *src,
+			   const CdColorXYZ *whitepoint,
+			   CdColorLab *dest,
+			   guint len)
+{
+	gdouble wx, wy, wz;
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (whitepoint != NULL);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	wx = 1.f / whitepoint->X;
+	wy = 1.f / whitepoint->Y;
+	wz = 1.f / whitepoint->Z;
+	for (i = 0; i < len; i++) {
+		gdouble fx = cd_color_lab_f (src[i].X * wx);
+		gdouble fy = cd_color_lab_f (src[i].Y * wy);
+		gdouble fz = cd_color_lab_f (src[i].Z * wz);
+		dest[i].L = 116.f * fy - 16.f;
+		dest[i].a = 500.f * (fx - fy);
+		dest[i].b = 200.f * (fy - fz);
+	}
+}
+
+/**
+ * cd_color_lab_to_xyz_array:
+ * @src: (array length=len): the source colors
+ * @whitepoint: the reference white
+ * @dest: (array length=len): the destination colors
+ * @len: the number of colors
+ *
+ * Converts an array of CIE 1976 L*a*b* colors to XYZ, in the same scale
+ * as @whitepoint.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_lab_to_xyz_array (const CdColorLab *src,
+			   const CdColorXYZ *whitepoint,
+			   CdColorXYZ *dest,
+			   guint len)
+{
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (whitepoint != NULL);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	for (i = 0; i < len; i++) {
+		gdouble fy = (src[i].L + 16.f) / 116.f;
+		gdouble fx = fy + src[i].a / 500.f;
+		gdouble fz = fy - src[i].b / 200.f;
+		dest[i].X = whitepoint->X * cd_color_lab_f_inv (fx);
+		dest[i].Y = whitepoint->Y * cd_color_lab_f_inv (fy);
+		dest[i].Z = whitepoint->Z * cd_color_lab_f_inv (fz);
+	}
+}
+
+/**
+ * cd_color_xyz_to_uvw_array:
+ * @src: (array length=len): the source colors
+ * @whitepoint: the whitepoint
+ * @dest: (array length=len): the destination colors
+ * @len: the number of colors
+ *
+ * Converts an array of colors in one pass, as cd_color_xyz_to_uvw().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_color_xyz_to_uvw_array (const CdColorXYZ *src,
+			   const CdColorXYZ *whitepoint,
+			   CdColorUVW *dest,
+			   guint len)
+{
+	CdColorYuv wp;
+	gdouble scale;
+	guint i;
+
+	g_return_if_fail (src != NULL || len == 0);
+	g_return_if_fail (whitepoint != NULL);
+	g_return_if_fail (dest != NULL || len == 0);
+
+	/* the whitepoint terms are shared by every color */
+	cd_color_xyz_to_yuv (whitepoint, &wp);
+	scale = 100.f / wp.Y;
+	for (i = 0; i < len; i++) {
+		gdouble sum = src[i].X + 15 * src[i].Y + 3 * src[i].Z;
+		gdouble u = 4 * src[i].X / sum;
+		gdouble v = 6 * src[i].Y / sum;
+		gdouble W = 25 * cbrt (src[i].Y * scale) - 17.f;
+		dest[i].U = 13 * W * (u - wp.u);
+		dest[i].V = 13 * W * (v - wp.v);
+		dest[i].W = W;
+	}
+}
+
 /* source: https://github.com/jonls/redshift/blob/master/README-colorramp
  * use a Planckian curve below 5000K */
 static const CdColorRGB blackbody_data_d65plankian[] = {
@@ -1337,92 +1863,225 @@ cd_color_rgb_array_new (void)
 }
 
 /**
- * cd_color_rgb_array_interpolate:
+ * cd_color_rgb_garray_new:
+ * @reserved_size: number of elements to preallocate
+ *
+ * Creates a new RGB array where the values are stored contiguously rather
+ * than being allocated individually.
+ *
+ * Return value: (element-type CdColorRGB) (transfer full): New array
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_color_rgb_garray_new (guint reserved_size)
+{
+	return g_array_sized_new (FALSE, FALSE, sizeof (CdColorRGB), reserved_size);
+}
+
+/**
+ * cd_color_xyz_garray_new:
+ * @reserved_size: number of elements to preallocate
+ *
+ * Creates a new XYZ array where the values are stored contiguously rather
+ * than being allocated individually.
+ *
+ * Return value: (element-type CdColorXYZ) (transfer full): New array
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_color_xyz_garray_new (guint reserved_size)
+{
+	return g_array_sized_new (FALSE, FALSE, sizeof (CdColorXYZ), reserved_size);
+}
+
+/**
+ * cd_color_rgb_garray_from_array:
  * @array: (element-type CdColorRGB): Input array
+ *
+ * Copies an array of allocated RGB values into a contiguous array.
+ *
+ * Return value: (element-type CdColorRGB) (transfer full): New array
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_color_rgb_garray_from_array (const GPtrArray *array)
+{
+	GArray *result;
+	guint i;
+
+	g_return_val_if_fail (array != NULL, NULL);
+
+	result = cd_color_rgb_garray_new (array->len);
+	for (i = 0; i < array->len; i++) {
+		const CdColorRGB *rgb = g_ptr_array_index (array, i);
+		g_array_append_vals (result, rgb, 1);
+	}
+	return result;
+}
+
+/**
+ * cd_color_rgb_array_from_garray:
+ * @array: (element-type CdColorRGB): Input contiguous array
+ *
+ * Copies a contiguous array of RGB values into an array of allocated values,
+ * as used by the older API.
+ *
+ * Return value: (element-type CdColorRGB) (transfer full): New array
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_color_rgb_array_from_garray (const GArray *array)
+{
+	GPtrArray *result;
+	guint i;
+
+	g_return_val_if_fail (array != NULL, NULL);
+
+	result = g_ptr_array_new_full (array->len, (GDestroyNotify) cd_color_rgb_free);
+	for (i = 0; i < array->len; i++)
+		g_ptr_array_add (result, cd_color_rgb_dup (&g_array_index (array, CdColorRGB, i)));
+	return result;
+}
+
+/**
+ * cd_color_rgb_garray_is_monotonic:
+ * @array: (element-type CdColorRGB): Input contiguous array
+ *
+ * Checks the RGB array for monotonicity.
+ *
+ * Return value: %TRUE if monotonic
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_color_rgb_garray_is_monotonic (const GArray *array)
+{
+	CdColorRGB last_rgb;
+	guint i;
+
+	g_return_val_if_fail (array != NULL, FALSE);
+
+	/* check if monotonic */
+	cd_color_rgb_set (&last_rgb, 0.0, 0.0, 0.0);
+	for (i = 0; i < array->len; i++) {
+		const CdColorRGB *rgb = &g_array_index (array, CdColorRGB, i);
+		if (rgb->R < last_rgb.R)
+			return FALSE;
+		if (rgb->G < last_rgb.G)
+			return FALSE;
+		if (rgb->B < last_rgb.B)
+			return FALSE;
+		last_rgb = *rgb;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_color_rgb_garray_interpolate:
+ * @array: (element-type CdColorRGB): Input contiguous array
  * @new_length: the target length of the return array
  *
  * Interpolate the RGB array to a different size.
- * This uses the Akima interpolation algorithm unless the array would become
- * non-monotonic, in which case it falls back to linear interpolation.
+ * This uses monotone cubic interpolation, so the result is always monotonic.
  *
  * Return value: (element-type CdColorRGB) (transfer full): An array of size @new_length or %NULL
  *
- * Since: 0.1.31
+ * Since: 1.4.10
  **/
-GPtrArray *
-cd_color_rgb_array_interpolate (const GPtrArray *array, guint new_length)
+GArray *
+cd_color_rgb_garray_interpolate (const GArray *array, guint new_length)
 {
-	CdColorRGB *rgb;
 	CdInterp *interp[3];
-	gboolean ret;
+	gboolean ret = TRUE;
 	gdouble tmp;
-	GPtrArray *result = NULL;
+	GArray *result = NULL;
 	guint i;
 	guint j;
-	guint m;
+	g_autofree gdouble *values = NULL;
+	g_autofree gdouble *results = NULL;
 
 	g_return_val_if_fail (array != NULL, NULL);
 	g_return_val_if_fail (new_length > 0, NULL);
 
 	/* check if monotonic */
-	ret = cd_color_rgb_array_is_monotonic (array);
-	if (!ret)
-		goto out;
+	if (!cd_color_rgb_garray_is_monotonic (array))
+		return NULL;
 
-	/* create new array */
-	result = cd_color_rgb_array_new ();
-	for (i = 0; i < new_length; i++) {
-		rgb = cd_color_rgb_new ();
-		g_ptr_array_add (result, rgb);
-	}
+	/* setup interpolation */
+	for (j = 0; j < 3; j++)
+		interp[j] = cd_interp_monotone_new ();
 
-	/* try each interpolation method in turn */
-	for (m = 0; m < 2; m++) {
+	/* add data */
+	for (i = 0; i < array->len; i++) {
+		const CdColorRGB *rgb = &g_array_index (array, CdColorRGB, i);
+		tmp = (gdouble) i / (gdouble) (array->len - 1);
+		cd_interp_insert (interp[0], tmp, rgb->R);
+		cd_interp_insert (interp[1], tmp, rgb->G);
+		cd_interp_insert (interp[2], tmp, rgb->B);
+	}
 
-		/* setup interpolation */
-		for (j = 0; j < 3; j++) {
-			if (m == 0)
-				interp[j] = cd_interp_akima_new ();
-			else if (m == 1)
-				interp[j] = cd_interp_linear_new ();
-		}
+	/* do interpolation of array */
+	values = g_new (gdouble, new_length);
+	for (i = 0; i < new_length; i++)
+		values[i] = (gdouble) i / (gdouble) (new_length - 1);
+	results = g_new0 (gdouble, new_length * 3);
+	for (j = 0; j < 3 && ret; j++) {
+		ret = cd_interp_prepare (interp[j], NULL);
+		if (!ret)
+			break;
+		ret = cd_interp_eval_many (interp[j], values,
+					   results + j * new_length,
+					   new_length, NULL);
+	}
 
-		/* add data */
-		for (i = 0; i < array->len; i++) {
-			rgb = g_ptr_array_index (array, i);
-			tmp = (gdouble) i / (gdouble) (array->len - 1);
-			cd_interp_insert (interp[0], tmp, rgb->R);
-			cd_interp_insert (interp[1], tmp, rgb->G);
-			cd_interp_insert (interp[2], tmp, rgb->B);
-		}
+	/* tear down the interpolation */
+	for (j = 0; j < 3; j++)
+		g_object_unref (interp[j]);
+	if (!ret)
+		return NULL;
 
-		/* do interpolation of array */
-		for (j = 0; j < 3; j++) {
-			ret = cd_interp_prepare (interp[j], NULL);
-			if (!ret)
-				break;
-		}
-		for (i = 0; i < new_length; i++) {
-			tmp = (gdouble) i / (gdouble) (new_length - 1);
-			rgb = g_ptr_array_index (result, i);
-			rgb->R = cd_interp_eval (interp[0], tmp, NULL);
-			rgb->G = cd_interp_eval (interp[1], tmp, NULL);
-			rgb->B = cd_interp_eval (interp[2], tmp, NULL);
-		}
+	/* create new array */
+	result = cd_color_rgb_garray_new (new_length);
+	g_array_set_size (result, new_length);
+	for (i = 0; i < new_length; i++) {
+		CdColorRGB *rgb = &g_array_index (result, CdColorRGB, i);
+		rgb->R = results[i];
+		rgb->G = results[new_length + i];
+		rgb->B = results[new_length * 2 + i];
+	}
+	return result;
+}
 
-		/* tear down the interpolation */
-		for (j = 0; j < 3; j++)
-			g_object_unref (interp[j]);
+/**
+ * cd_color_rgb_array_interpolate:
+ * @array: (element-type CdColorRGB): Input array
+ * @new_length: the target length of the return array
+ *
+ * Interpolate the RGB array to a different size.
+ * This uses monotone cubic interpolation, so the result is always monotonic.
+ *
+ * Return value: (element-type CdColorRGB) (transfer full): An array of size @new_length or %NULL
+ *
+ * Since: 0.1.31
+ **/
+GPtrArray *
+cd_color_rgb_array_interpolate (const GPtrArray *array, guint new_length)
+{
+	g_autoptr(GArray) flat = NULL;
+	g_autoptr(GArray) result = NULL;
 
-		/* check if monotonic */
-		ret = cd_color_rgb_array_is_monotonic (result);
-		if (ret)
-			break;
+	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (new_length > 0, NULL);
 
-		/* try harder */
-	}
-out:
-	return result;
+	flat = cd_color_rgb_garray_from_array (array);
+	result = cd_color_rgb_garray_interpolate (flat, new_length);
+	if (result == NULL)
+		return NULL;
+	return cd_color_rgb_array_from_garray (result);
 }
 
 /**
@@ -165,6 +165,22 @@ void		 cd_color_lab_copy			(const CdColorLab	*src,
 							 CdColorLab		*dest);
 gdouble		 cd_color_lab_delta_e76			(const CdColorLab	*p1,
 							 const CdColorLab	*p2);
+gdouble		 cd_color_lab_delta_e94			(const CdColorLab	*p1,
+							 const CdColorLab	*p2);
+gdouble		 cd_color_lab_delta_e2000		(const CdColorLab	*p1,
+							 const CdColorLab	*p2);
+void		 cd_color_lab_delta_e76_array		(const CdColorLab	*src1,
+							 const CdColorLab	*src2,
+							 gdouble		*dest,
+							 guint			 len);
+void		 cd_color_lab_delta_e94_array		(const CdColorLab	*src1,
+							 const CdColorLab	*src2,
+							 gdouble		*dest,
+							 guint			 len);
+void		 cd_color_lab_delta_e2000_array		(const CdColorLab	*src1,
+							 const CdColorLab	*src2,
+							 gdouble		*dest,
+							 guint			 len);
 void		 cd_color_xyz_clear			(CdColorXYZ		*dest);
 void		 cd_color_rgb_copy			(const CdColorRGB	*src,
 							 CdColorRGB		*dest);
@@ -181,6 +197,24 @@ void		 cd_color_xyz_to_uvw			(const CdColorXYZ	*src,
 							 CdColorUVW		*dest);
 void		 cd_color_yxy_to_uvw			(const CdColorYxy	*src,
 							 CdColorUVW		*dest);
+void		 cd_color_xyz_to_yxy_array		(const CdColorXYZ	*src,
+							 CdColorYxy		*dest,
+							 guint			 len);
+void		 cd_color_yxy_to_xyz_array		(const CdColorYxy	*src,
+							 CdColorXYZ		*dest,
+							 guint			 len);
+void		 cd_color_xyz_to_lab_array		(const CdColorXYZ	*src,
+							 const CdColorXYZ	*whitepoint,
+							 CdColorLab		*dest,
+							 guint			 len);
+void		 cd_color_lab_to_xyz_array		(const CdColorLab	*src,
+							 const CdColorXYZ	*whitepoint,
+							 CdColorXYZ		*dest,
+							 guint			 len);
+void		 cd_color_xyz_to_uvw_array		(const CdColorXYZ	*src,
+							 const CdColorXYZ	*whitepoint,
+							 CdColorUVW		*dest,
+							 guint			 len);
 void		 cd_color_uvw_set_planckian_locus	(CdColorUVW		*dest,
 							 gdouble		 temp);
 gdouble		 cd_color_uvw_get_chroma_difference	(const CdColorUVW	*p1,
@@ -197,6 +231,15 @@ void		 cd_color_rgb_interpolate		(const CdColorRGB	*p1,
 void		 cd_color_rgb_from_wavelength		(CdColorRGB		*dest,
 							 gdouble		 wavelength);
 gdouble		 cd_color_xyz_to_cct			(const CdColorXYZ	*src);
+void		 cd_color_xyz_to_cct_array		(const CdColorXYZ	*src,
+							 gdouble		*dest,
+							 guint			 len);
+gdouble		 cd_color_xyz_to_cct_duv		(const CdColorXYZ	*src,
+							 gdouble		*duv);
+void		 cd_color_xyz_to_cct_duv_array		(const CdColorXYZ	*src,
+							 gdouble		*cct,
+							 gdouble		*duv,
+							 guint			 len);
 void		 cd_color_xyz_normalize			(const CdColorXYZ	*src,
 							 gdouble		 max,
 							 CdColorXYZ		*dest);
@@ -206,6 +249,16 @@ gboolean	 cd_color_rgb_array_is_monotonic	(const GPtrArray	*array);
 GPtrArray	*cd_color_rgb_array_interpolate		(const GPtrArray	*array,
 							 guint			 new_length)
 							 G_GNUC_WARN_UNUSED_RESULT;
+GArray		*cd_color_rgb_garray_new		(guint			 reserved_size);
+GArray		*cd_color_xyz_garray_new		(guint			 reserved_size);
+GArray		*cd_color_rgb_garray_from_array		(const GPtrArray	*array)
+							 G_GNUC_WARN_UNUSED_RESULT;
+GPtrArray	*cd_color_rgb_array_from_garray		(const GArray		*array)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_color_rgb_garray_is_monotonic	(const GArray		*array);
+GArray		*cd_color_rgb_garray_interpolate	(const GArray		*array,
+							 guint			 new_length)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -36,10 +36,34 @@
 /*< private >*/
 #define LCMS_CURVE_PLUGIN_TYPE_REC709	1024
 
+static void
+cd_context_lcms_error_slot_free (gpointer data)
+{
+	GError **error_ctx = (GError **) data;
+	g_clear_error (error_ctx);
+	g_free (error_ctx);
+}
+
+/* errors from the shared context are stored per-thread */
+static GPrivate cd_context_lcms_error_slot = G_PRIVATE_INIT (cd_context_lcms_error_slot_free);
+
 static GError **
 cd_context_lcms_get_error (gpointer ctx)
 {
-	return cmsGetContextUserData (ctx);
+	GError **error_ctx;
+
+	/* a private context */
+	error_ctx = cmsGetContextUserData (ctx);
+	if (error_ctx != NULL)
+		return error_ctx;
+
+	/* the shared context */
+	error_ctx = g_private_get (&cd_context_lcms_error_slot);
+	if (error_ctx == NULL) {
+		error_ctx = g_new0 (GError *, 1);
+		g_private_set (&cd_context_lcms_error_slot, error_ctx);
+	}
+	return error_ctx;
 }
 
 static void
@@ -134,6 +158,8 @@ cmsPluginParametricCurves cd_icc_lcms_plugins = {
 	cd_context_lcms_plugins_cb		/* evaluator */
 };
 
+static gint cd_context_lcms_live_count = 0;
+
 /**
  * cd_context_lcms_new:
  *
@@ -148,11 +174,42 @@ cd_context_lcms_new (void)
 	ctx = cmsCreateContext (NULL, error_ctx);
 	cmsSetLogErrorHandlerTHR (ctx, cd_context_lcms2_error_cb);
 	cmsPluginTHR (ctx, &cd_icc_lcms_plugins);
+	g_atomic_int_inc (&cd_context_lcms_live_count);
+	return ctx;
+}
+
+/**
+ * cd_context_lcms_get_shared:
+ *
+ * Gets a LCMS context that is shared by the whole process. Errors are
+ * reported to the thread that caused them, so callers must clear and
+ * check the error in the same thread as the LCMS call. Nothing must
+ * change the state of this context, e.g. the alarm codes, and so
+ * anything that does should use cd_context_lcms_new() instead.
+ *
+ * Return value: (transfer none): The shared LCMS context
+ **/
+gpointer
+cd_context_lcms_get_shared (void)
+{
+	static gsize ctx_once = 0;
+	static cmsContext ctx = NULL;
+
+	if (g_once_init_enter (&ctx_once)) {
+		ctx = cmsCreateContext (NULL, NULL);
+		cmsSetLogErrorHandlerTHR (ctx, cd_context_lcms2_error_cb);
+		cmsPluginTHR (ctx, &cd_icc_lcms_plugins);
+		g_atomic_int_inc (&cd_context_lcms_live_count);
+		g_once_init_leave (&ctx_once, 1);
+	}
 	return ctx;
 }
 
 /**
  * cd_context_lcms_free:
+ *
+ * Frees a context from cd_context_lcms_new(), and does nothing for the
+ * shared context.
  **/
 void
 cd_context_lcms_free (gpointer ctx)
@@ -160,10 +217,27 @@ cd_context_lcms_free (gpointer ctx)
 	GError **error_ctx;
 
 	error_ctx = cmsGetContextUserData (ctx);
+	if (error_ctx == NULL)
+		return;
 	g_clear_error (error_ctx);
 	g_free (error_ctx);
 
 	cmsDeleteContext (ctx);
+	g_atomic_int_add (&cd_context_lcms_live_count, -1);
+}
+
+/**
+ * cd_context_lcms_get_live_count:
+ *
+ * Gets the number of LCMS contexts, including the shared one, which the
+ * daemon uses to find leaks.
+ *
+ * Return value: the number of contexts
+ **/
+guint
+cd_context_lcms_get_live_count (void)
+{
+	return (guint) g_atomic_int_get (&cd_context_lcms_live_count);
 }
 
 /**
@@ -30,10 +30,12 @@
 #include <glib.h>
 
 gpointer	 cd_context_lcms_new		(void);
+gpointer	 cd_context_lcms_get_shared	(void);
 void		 cd_context_lcms_free		(gpointer	 ctx);
 void		 cd_context_lcms_error_clear	(gpointer	 ctx);
 gboolean	 cd_context_lcms_error_check	(gpointer	 ctx,
 						 GError		**error);
+guint		 cd_context_lcms_get_live_count	(void);
 
 G_END_DECLS
 
@@ -38,11 +38,12 @@
 #include "cd-profile.h"
 #include "cd-device.h"
 #include "cd-device-sync.h"
+#include "cd-sync-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainLoop	*loop;
+	gboolean	 done;
 	gboolean	 ret;
 	CdDevice	*device;
 	CdProfile	*profile;
@@ -56,7 +57,7 @@ cd_device_connect_finish_sync (CdDevice *device,
 	helper->ret = cd_device_connect_finish (device,
 						res,
 						helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -80,20 +81,21 @@ cd_device_connect_sync (CdDevice *device,
 			GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = g_main_context_ref_thread_default ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_connect (device, cancellable,
 			   (GAsyncReadyCallback) cd_device_connect_finish_sync,
 			   &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
 
 	return helper.ret;
 }
@@ -108,7 +110,7 @@ cd_device_set_property_finish_sync (CdDevice *device,
 	helper->ret = cd_device_set_property_finish (device,
 						     res,
 						     helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -136,20 +138,21 @@ cd_device_set_property_sync (CdDevice *device,
 			     GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_set_property (device, key, value, cancellable,
 				(GAsyncReadyCallback) cd_device_set_property_finish_sync,
 				&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -164,7 +167,7 @@ cd_device_add_profile_finish_sync (CdDevice *device,
 	helper->ret = cd_device_add_profile_finish (device,
 						    res,
 						    helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -192,20 +195,21 @@ cd_device_add_profile_sync (CdDevice *device,
 			    GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_add_profile (device, relation, profile, cancellable,
 			    (GAsyncReadyCallback) cd_device_add_profile_finish_sync,
 			    &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -220,7 +224,7 @@ cd_device_remove_profile_finish_sync (CdDevice *device,
 	helper->ret = cd_device_remove_profile_finish (device,
 						       res,
 						       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -246,20 +250,21 @@ cd_device_remove_profile_sync (CdDevice *device,
 			       GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_remove_profile (device, profile, cancellable,
 				  (GAsyncReadyCallback) cd_device_remove_profile_finish_sync,
 				  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -274,7 +279,7 @@ cd_device_get_profile_for_qualifiers_finish_sync (CdDevice *device,
 	helper->profile = cd_device_get_profile_for_qualifiers_finish (device,
 								       res,
 								       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -300,20 +305,21 @@ cd_device_get_profile_for_qualifiers_sync (CdDevice *device,
 					   GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_get_profile_for_qualifiers (device, qualifiers, cancellable,
 					      (GAsyncReadyCallback) cd_device_get_profile_for_qualifiers_finish_sync,
 					     &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.profile;
 }
@@ -328,7 +334,7 @@ cd_device_make_profile_default_finish_sync (CdDevice *device,
 	helper->ret = cd_device_make_profile_default_finish (device,
 						 res,
 						 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -354,20 +360,21 @@ cd_device_make_profile_default_sync (CdDevice *device,
 				     GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_make_profile_default (device, profile, cancellable,
 					(GAsyncReadyCallback) cd_device_make_profile_default_finish_sync,
 					&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -382,7 +389,7 @@ cd_device_profiling_inhibit_finish_sync (CdDevice *device,
 	helper->ret = cd_device_profiling_inhibit_finish (device,
 							  res,
 							  helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -407,20 +414,21 @@ cd_device_profiling_inhibit_sync (CdDevice *device,
 				  GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_profiling_inhibit (device, cancellable,
 				     (GAsyncReadyCallback) cd_device_profiling_inhibit_finish_sync,
 				     &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -435,7 +443,7 @@ cd_device_profiling_uninhibit_finish_sync (CdDevice *device,
 	helper->ret = cd_device_profiling_uninhibit_finish (device,
 							    res,
 							    helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -460,20 +468,21 @@ cd_device_profiling_uninhibit_sync (CdDevice *device,
 				    GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_profiling_uninhibit (device, cancellable,
 				       (GAsyncReadyCallback) cd_device_profiling_uninhibit_finish_sync,
 				       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -488,7 +497,7 @@ cd_device_get_profile_relation_finish_sync (CdDevice *device,
 	helper->ret = cd_device_get_profile_relation_finish (device,
 						 res,
 						 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -514,20 +523,21 @@ cd_device_get_profile_relation_sync (CdDevice *device,
 				     GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_get_profile_relation (device, profile, cancellable,
 					(GAsyncReadyCallback) cd_device_get_profile_relation_finish_sync,
 					&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -542,7 +552,7 @@ cd_device_set_enabled_finish_sync (CdDevice *device,
 	helper->ret = cd_device_set_enabled_finish (device,
 						    res,
 						    helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -568,20 +578,21 @@ cd_device_set_enabled_sync (CdDevice *device,
 			    GError **error)
 {
 	CdDeviceHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdDeviceHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_device_set_enabled (device, enabled, cancellable,
 				(GAsyncReadyCallback) cd_device_set_enabled_finish_sync,
 				&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -37,6 +37,7 @@
 #include <string.h>
 
 #include "cd-device.h"
+#include "cd-device-private.h"
 #include "cd-profile.h"
 #include "cd-profile-sync.h"
 
@@ -57,6 +58,8 @@ static void	cd_device_finalize	(GObject		*object);
 typedef struct
 {
 	GDBusProxy		*proxy;
+	GDBusConnection		*connection;	/* shared mode */
+	gchar			*name_owner;
 	gchar			*object_path;
 	gchar			*id;
 	gchar			*model;
@@ -159,7 +162,7 @@ cd_device_get_id (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->id;
 }
 
@@ -178,7 +181,7 @@ cd_device_get_model (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->model;
 }
 
@@ -197,7 +200,7 @@ cd_device_get_vendor (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->vendor;
 }
 
@@ -216,7 +219,7 @@ cd_device_get_serial (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->serial;
 }
 
@@ -235,7 +238,7 @@ cd_device_get_seat (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->seat;
 }
 
@@ -254,7 +257,7 @@ cd_device_get_format (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return priv->format;
 }
 
@@ -273,7 +276,7 @@ cd_device_get_profiling_inhibitors (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return (const gchar **) priv->profiling_inhibitors;
 }
 
@@ -292,7 +295,7 @@ cd_device_get_created (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), 0);
-	g_return_val_if_fail (priv->proxy != NULL, 0);
+	g_return_val_if_fail (cd_device_get_connected (device), 0);
 	return priv->created;
 }
 
@@ -311,7 +314,7 @@ cd_device_get_modified (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), 0);
-	g_return_val_if_fail (priv->proxy != NULL, 0);
+	g_return_val_if_fail (cd_device_get_connected (device), 0);
 	return priv->modified;
 }
 
@@ -330,7 +333,7 @@ cd_device_get_kind (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), CD_DEVICE_KIND_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_DEVICE_KIND_UNKNOWN);
+	g_return_val_if_fail (cd_device_get_connected (device), CD_DEVICE_KIND_UNKNOWN);
 	return priv->kind;
 }
 
@@ -349,7 +352,7 @@ cd_device_get_colorspace (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), CD_COLORSPACE_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_COLORSPACE_UNKNOWN);
+	g_return_val_if_fail (cd_device_get_connected (device), CD_COLORSPACE_UNKNOWN);
 	return priv->colorspace;
 }
 
@@ -368,7 +371,7 @@ cd_device_get_mode (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), CD_DEVICE_MODE_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_DEVICE_MODE_UNKNOWN);
+	g_return_val_if_fail (cd_device_get_connected (device), CD_DEVICE_MODE_UNKNOWN);
 	return priv->mode;
 }
 
@@ -387,7 +390,7 @@ cd_device_get_enabled (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), FALSE);
-	g_return_val_if_fail (priv->proxy != NULL, FALSE);
+	g_return_val_if_fail (cd_device_get_connected (device), FALSE);
 	return priv->enabled;
 }
 
@@ -407,7 +410,7 @@ cd_device_get_embedded (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), FALSE);
-	g_return_val_if_fail (priv->proxy != NULL, FALSE);
+	g_return_val_if_fail (cd_device_get_connected (device), FALSE);
 	return priv->embedded;
 }
 
@@ -426,7 +429,7 @@ cd_device_get_scope (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), CD_OBJECT_SCOPE_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_OBJECT_SCOPE_UNKNOWN);
+	g_return_val_if_fail (cd_device_get_connected (device), CD_OBJECT_SCOPE_UNKNOWN);
 	return priv->scope;
 }
 
@@ -445,7 +448,7 @@ cd_device_get_owner (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), G_MAXUINT);
-	g_return_val_if_fail (priv->proxy != NULL, G_MAXUINT);
+	g_return_val_if_fail (cd_device_get_connected (device), G_MAXUINT);
 	return priv->owner;
 }
 
@@ -464,7 +467,7 @@ cd_device_get_profiles (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return g_ptr_array_ref (priv->profiles);
 }
 
@@ -484,7 +487,7 @@ cd_device_get_default_profile (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	if (priv->profiles->len == 0)
 		return NULL;
 	if (!priv->enabled)
@@ -532,7 +535,7 @@ cd_device_get_metadata (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return g_hash_table_ref (priv->metadata);
 }
 
@@ -552,7 +555,7 @@ cd_device_get_metadata_item (CdDevice *device, const gchar *key)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_device_get_connected (device), NULL);
 	return g_hash_table_lookup (priv->metadata, key);
 }
 
@@ -890,6 +893,247 @@ cd_device_connect_cb (GObject *source_object,
 	g_task_return_boolean (task, TRUE);
 }
 
+typedef struct {
+	gchar			*method_name;
+	GVariant		*parameters;
+	GAsyncReadyCallback	 callback;
+	GTask			*task;
+} CdDeviceCallHelper;
+
+static void
+cd_device_call_helper_free (CdDeviceCallHelper *helper)
+{
+	if (helper->parameters != NULL)
+		g_variant_unref (helper->parameters);
+	if (helper->task != NULL)
+		g_object_unref (helper->task);
+	g_free (helper->method_name);
+	g_free (helper);
+}
+
+static void
+cd_device_call_proxy_cb (GObject *source_object,
+			 GAsyncResult *res,
+			 gpointer user_data)
+{
+	CdDeviceCallHelper *helper = (CdDeviceCallHelper *) user_data;
+	CdDevice *device = CD_DEVICE (g_task_get_source_object (helper->task));
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_autoptr(GDBusProxy) proxy = NULL;
+	g_autoptr(GError) error = NULL;
+
+	proxy = g_dbus_proxy_new_finish (res, &error);
+	if (proxy == NULL) {
+		g_task_return_new_error (helper->task,
+					 CD_DEVICE_ERROR,
+					 CD_DEVICE_ERROR_INTERNAL,
+					 "failed to create proxy for %s: %s",
+					 priv->object_path, error->message);
+		cd_device_call_helper_free (helper);
+		return;
+	}
+
+	/* another call may have created one first */
+	if (priv->proxy == NULL)
+		priv->proxy = g_steal_pointer (&proxy);
+	g_dbus_proxy_call (priv->proxy,
+			   helper->method_name,
+			   helper->parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   g_task_get_cancellable (helper->task),
+			   helper->callback,
+			   g_steal_pointer (&helper->task));
+	cd_device_call_helper_free (helper);
+}
+
+/*
+ * cd_device_call:
+ *
+ * Calls a method on the device, taking ownership of @task. Objects connected
+ * in shared mode only create a proxy on first use, and it never loads
+ * properties or subscribes to signals as the #CdClient dispatches those for
+ * all objects.
+ */
+static void
+cd_device_call (CdDevice *device,
+		const gchar *method_name,
+		GVariant *parameters,
+		GCancellable *cancellable,
+		GAsyncReadyCallback callback,
+		GTask *task)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	CdDeviceCallHelper *helper;
+
+	if (priv->proxy != NULL) {
+		g_dbus_proxy_call (priv->proxy,
+				   method_name,
+				   parameters,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   -1,
+				   cancellable,
+				   callback,
+				   task);
+		return;
+	}
+	helper = g_new0 (CdDeviceCallHelper, 1);
+	helper->method_name = g_strdup (method_name);
+	if (parameters != NULL)
+		helper->parameters = g_variant_ref_sink (parameters);
+	helper->callback = callback;
+	helper->task = task;
+	g_dbus_proxy_new (priv->connection,
+			  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+			  G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+			  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+			  NULL,
+			  priv->name_owner,
+			  priv->object_path,
+			  COLORD_DBUS_INTERFACE_DEVICE,
+			  cancellable,
+			  cd_device_call_proxy_cb,
+			  helper);
+}
+
+/*
+ * cd_device_connect_shared:
+ *
+ * Like cd_device_connect_from_properties() but without creating a proxy or
+ * adding any match rules; the caller is expected to forward property changes
+ * and signals using cd_device_shared_properties_changed() and
+ * cd_device_shared_signal().
+ */
+gboolean
+cd_device_connect_shared (CdDevice *device,
+			 GDBusConnection *connection,
+			 const gchar *name_owner,
+			 GVariant *properties,
+			 GError **error)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_autoptr(GVariant) id = NULL;
+
+	g_return_val_if_fail (CD_IS_DEVICE (device), FALSE);
+
+	/* already connected */
+	if (cd_device_get_connected (device))
+		return TRUE;
+
+	/* if the device is missing, then fail */
+	id = g_variant_lookup_value (properties, CD_DEVICE_PROPERTY_ID, NULL);
+	if (id == NULL) {
+		g_set_error (error,
+			     CD_DEVICE_ERROR,
+			     CD_DEVICE_ERROR_INTERNAL,
+			     "Failed to connect to missing device %s",
+			     cd_device_get_object_path (device));
+		return FALSE;
+	}
+	priv->connection = g_object_ref (connection);
+	priv->name_owner = g_strdup (name_owner);
+	priv->id = cd_device_get_nullable_str (id);
+	cd_device_dbus_properties_changed_cb (NULL, properties, NULL, device);
+	return TRUE;
+}
+
+/*
+ * cd_device_shared_properties_changed:
+ */
+void
+cd_device_shared_properties_changed (CdDevice *device, GVariant *changed_properties)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_if_fail (CD_IS_DEVICE (device));
+	if (priv->connection == NULL)
+		return;
+	cd_device_dbus_properties_changed_cb (NULL, changed_properties, NULL, device);
+}
+
+/*
+ * cd_device_shared_signal:
+ */
+void
+cd_device_shared_signal (CdDevice *device,
+			const gchar *signal_name,
+			GVariant *parameters)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_if_fail (CD_IS_DEVICE (device));
+	if (priv->connection == NULL)
+		return;
+	cd_device_dbus_signal_cb (NULL, NULL, (gchar *) signal_name, parameters, device);
+}
+
+/*
+ * cd_device_connect_from_properties:
+ *
+ * Connects to the object using properties that were already fetched, for
+ * instance by cd_client_get_snapshot(). Using the unique name of the daemon
+ * and not loading the properties means no method calls are made.
+ */
+gboolean
+cd_device_connect_from_properties (CdDevice *device,
+				   GDBusConnection *connection,
+				   const gchar *name_owner,
+				   GVariant *properties,
+				   GError **error)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GVariant) id = NULL;
+
+	g_return_val_if_fail (CD_IS_DEVICE (device), FALSE);
+
+	/* already connected */
+	if (cd_device_get_connected (device))
+		return TRUE;
+
+	/* if the device is missing, then fail */
+	id = g_variant_lookup_value (properties, CD_DEVICE_PROPERTY_ID, NULL);
+	if (id == NULL) {
+		g_set_error (error,
+			     CD_DEVICE_ERROR,
+			     CD_DEVICE_ERROR_INTERNAL,
+			     "Failed to connect to missing device %s",
+			     cd_device_get_object_path (device));
+		return FALSE;
+	}
+
+	priv->proxy = g_dbus_proxy_new_sync (connection,
+					     G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+					     NULL,
+					     name_owner,
+					     priv->object_path,
+					     COLORD_DBUS_INTERFACE_DEVICE,
+					     NULL,
+					     &error_local);
+	if (priv->proxy == NULL) {
+		g_set_error (error,
+			     CD_DEVICE_ERROR,
+			     CD_DEVICE_ERROR_INTERNAL,
+			     "Failed to connect to device %s: %s",
+			     cd_device_get_object_path (device),
+			     error_local->message);
+		return FALSE;
+	}
+	priv->id = cd_device_get_nullable_str (id);
+	cd_device_dbus_properties_changed_cb (priv->proxy, properties, NULL, device);
+
+	/* get signals from DBus */
+	g_signal_connect_object (priv->proxy,
+				 "g-signal",
+				 G_CALLBACK (cd_device_dbus_signal_cb),
+				 device, 0);
+
+	/* watch if any remote properties change */
+	g_signal_connect_object (priv->proxy,
+				 "g-properties-changed",
+				 G_CALLBACK (cd_device_dbus_properties_changed_cb),
+				 device, 0);
+	return TRUE;
+}
+
 /**
  * cd_device_connect:
  * @device: a #CdDevice instance.
@@ -916,7 +1160,7 @@ cd_device_connect (CdDevice *device,
 	task = g_task_new (device, cancellable, callback, user_data);
 
 	/* already connected */
-	if (priv->proxy != NULL) {
+	if (cd_device_get_connected (device)) {
 		g_task_return_boolean (task, TRUE);
 		return;
 	}
@@ -1017,25 +1261,22 @@ cd_device_set_property (CdDevice *device,
 			GAsyncReadyCallback callback,
 			gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (key != NULL);
 	g_return_if_fail (value != NULL);
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "SetProperty",
-			   g_variant_new ("(ss)",
-			   		  key, value),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_set_property_cb,
-			   task);
+	cd_device_call (device,
+			"SetProperty",
+			g_variant_new ("(ss)",
+				       key, value),
+			cancellable,
+			cd_device_set_property_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1105,25 +1346,22 @@ cd_device_add_profile (CdDevice *device,
 		       GAsyncReadyCallback callback,
 		       gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "AddProfile",
-			   g_variant_new ("(so)",
-					  cd_device_relation_to_string (relation),
-					  cd_profile_get_object_path (profile)),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_add_profile_cb,
-			   task);
+	cd_device_call (device,
+			"AddProfile",
+			g_variant_new ("(so)",
+				       cd_device_relation_to_string (relation),
+				       cd_profile_get_object_path (profile)),
+			cancellable,
+			cd_device_add_profile_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1191,24 +1429,21 @@ cd_device_remove_profile (CdDevice *device,
 			  GAsyncReadyCallback callback,
 			  gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "RemoveProfile",
-			   g_variant_new ("(o)",
-					  cd_profile_get_object_path (profile)),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_remove_profile_cb,
-			   task);
+	cd_device_call (device,
+			"RemoveProfile",
+			g_variant_new ("(o)",
+				       cd_profile_get_object_path (profile)),
+			cancellable,
+			cd_device_remove_profile_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1276,24 +1511,21 @@ cd_device_make_profile_default (CdDevice *device,
 				GAsyncReadyCallback callback,
 				gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "MakeProfileDefault",
-			   g_variant_new ("(o)",
-					  cd_profile_get_object_path (profile)),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_make_profile_default_cb,
-			   task);
+	cd_device_call (device,
+			"MakeProfileDefault",
+			g_variant_new ("(o)",
+				       cd_profile_get_object_path (profile)),
+			cancellable,
+			cd_device_make_profile_default_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1360,22 +1592,19 @@ cd_device_profiling_inhibit (CdDevice *device,
 			     GAsyncReadyCallback callback,
 			     gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "ProfilingInhibit",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_profiling_inhibit_cb,
-			   task);
+	cd_device_call (device,
+			"ProfilingInhibit",
+			NULL,
+			cancellable,
+			cd_device_profiling_inhibit_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1442,22 +1671,19 @@ cd_device_profiling_uninhibit (CdDevice *device,
 			       GAsyncReadyCallback callback,
 			       gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "ProfilingUninhibit",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_profiling_uninhibit_cb,
-			   task);
+	cd_device_call (device,
+			"ProfilingUninhibit",
+			NULL,
+			cancellable,
+			cd_device_profiling_uninhibit_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1532,14 +1758,13 @@ cd_device_get_profile_for_qualifiers (CdDevice *device,
 				      GAsyncReadyCallback callback,
 				      gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;	guint i;
 	GVariantBuilder builder;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (qualifiers != NULL);
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	/* squash char** into an array of strings */
 	g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
@@ -1547,15 +1772,13 @@ cd_device_get_profile_for_qualifiers (CdDevice *device,
 		g_variant_builder_add (&builder, "s", qualifiers[i]);
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "GetProfileForQualifiers",
-			   g_variant_new ("(as)",
-					  &builder),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_get_profile_for_qualifiers_cb,
-			   task);
+	cd_device_call (device,
+			"GetProfileForQualifiers",
+			g_variant_new ("(as)",
+				       &builder),
+			cancellable,
+			cd_device_get_profile_for_qualifiers_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1631,24 +1854,21 @@ cd_device_get_profile_relation (CdDevice *device,
 				GAsyncReadyCallback callback,
 				gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "GetProfileRelation",
-			   g_variant_new ("(o)",
-					  cd_profile_get_object_path (profile)),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_get_profile_relation_cb,
-			   task);
+	cd_device_call (device,
+			"GetProfileRelation",
+			g_variant_new ("(o)",
+				       cd_profile_get_object_path (profile)),
+			cancellable,
+			cd_device_get_profile_relation_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1716,22 +1936,19 @@ cd_device_set_enabled (CdDevice *device,
 		       GAsyncReadyCallback callback,
 		       gpointer user_data)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_DEVICE (device));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_device_get_connected (device));
 
 	task = g_task_new (device, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "SetEnabled",
-			   g_variant_new ("(b)", enabled),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_device_set_enabled_cb,
-			   task);
+	cd_device_call (device,
+			"SetEnabled",
+			g_variant_new ("(b)", enabled),
+			cancellable,
+			cd_device_set_enabled_cb,
+			task);
 }
 
 /**********************************************************************/
@@ -1769,7 +1986,7 @@ cd_device_get_connected (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	g_return_val_if_fail (CD_IS_DEVICE (device), FALSE);
-	return priv->proxy != NULL;
+	return priv->proxy != NULL || priv->connection != NULL;
 }
 
 /**
@@ -1862,7 +2079,7 @@ cd_device_get_property (GObject *object, guint prop_id, GValue *value, GParamSpe
 		g_value_set_string (value, priv->object_path);
 		break;
 	case PROP_CONNECTED:
-		g_value_set_boolean (value, priv->proxy != NULL);
+		g_value_set_boolean (value, cd_device_get_connected (device));
 		break;
 	case PROP_CREATED:
 		g_value_set_uint64 (value, priv->created);
@@ -2229,6 +2446,9 @@ cd_device_finalize (GObject *object)
 	g_free (priv->vendor);
 	g_strfreev (priv->profiling_inhibitors);
 	g_ptr_array_unref (priv->profiles);
+	g_free (priv->name_owner);
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
 	if (priv->proxy != NULL)
 		g_object_unref (priv->proxy);
 
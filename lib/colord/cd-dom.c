@@ -27,12 +27,15 @@
 #include "config.h"
 
 #include <glib.h>
+#include <string.h>
 
 #include "cd-dom.h"
 
 static void	cd_dom_class_init	(CdDomClass	*klass);
 static void	cd_dom_init		(CdDom		*dom);
 static void	cd_dom_finalize		(GObject	*object);
+static gboolean	cd_dom_destroy_node_cb	(GNode		*node,
+					 gpointer	 user_data);
 
 #define GET_PRIVATE(o) (cd_dom_get_instance_private (o))
 
@@ -45,6 +48,9 @@ typedef struct
 {
 	GNode			*root;
 	GNode			*current;
+	CdDomPath		*stream_path;
+	CdDomNodeFunc		 stream_func;
+	gpointer		 stream_user_data;
 } CdDomPrivate;
 
 typedef struct
@@ -52,8 +58,18 @@ typedef struct
 	gchar		*name;
 	GString		*cdata;
 	GHashTable	*attributes;
+	GHashTable	*children;	/* name:GNode, built on demand */
 } CdDomNodeData;
 
+struct _CdDomPath
+{
+	guint		 len;
+	gchar		**names;
+};
+
+/* nodes with fewer children than this are always scanned linearly */
+#define CD_DOM_CHILD_INDEX_MIN		8
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdDom, cd_dom, G_TYPE_OBJECT)
 
 /**
@@ -131,6 +147,7 @@ cd_dom_start_element_cb (GMarkupParseContext *context,
 	CdDom *dom = (CdDom *) user_data;
 	CdDomPrivate *priv = GET_PRIVATE (dom);
 	CdDomNodeData *data;
+	CdDomNodeData *parent;
 	GNode *new;
 	guint i;
 
@@ -138,6 +155,7 @@ cd_dom_start_element_cb (GMarkupParseContext *context,
 	data = g_slice_new (CdDomNodeData);
 	data->name = g_strdup (element_name);
 	data->cdata = g_string_new (NULL);
+	data->children = NULL;
 	data->attributes = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
@@ -151,9 +169,33 @@ cd_dom_start_element_cb (GMarkupParseContext *context,
 	/* add the node to the DOM */
 	new = g_node_new (data);
 	g_node_append (priv->current, new);
+
+	/* keep the parent index valid, where the first child wins */
+	parent = priv->current->data;
+	if (parent != NULL && parent->children != NULL &&
+	    !g_hash_table_contains (parent->children, data->name))
+		g_hash_table_insert (parent->children, data->name, new);
 	priv->current = new;
 }
 
+static gboolean
+cd_dom_path_matches_node (const CdDomPath *path, GNode *node)
+{
+	CdDomNodeData *data;
+	guint i;
+
+	/* check the names from the leaf upwards */
+	for (i = path->len; i > 0; i--) {
+		data = node->data;
+		if (data == NULL)
+			return FALSE;
+		if (g_strcmp0 (data->name, path->names[i - 1]) != 0)
+			return FALSE;
+		node = node->parent;
+	}
+	return node != NULL && node->parent == NULL;
+}
+
 static void
 cd_dom_end_element_cb (GMarkupParseContext *context,
 		       const gchar         *element_name,
@@ -162,7 +204,39 @@ cd_dom_end_element_cb (GMarkupParseContext *context,
 {
 	CdDom *dom = (CdDom *) user_data;
 	CdDomPrivate *priv = GET_PRIVATE (dom);
-	priv->current = priv->current->parent;
+	CdDomNodeData *parent;
+	GNode *node = priv->current;
+
+	priv->current = node->parent;
+
+	/* not streaming, or not an interesting node */
+	if (priv->stream_func == NULL)
+		return;
+	if (!cd_dom_path_matches_node (priv->stream_path, node))
+		return;
+
+	/* hand the complete subtree to the caller before dropping it */
+	if (!priv->stream_func (dom, node, priv->stream_user_data, error)) {
+		if (error != NULL && *error == NULL) {
+			g_set_error_literal (error,
+					     G_MARKUP_ERROR,
+					     G_MARKUP_ERROR_INVALID_CONTENT,
+					     "cancelled by node callback");
+		}
+	}
+
+	/* the parent index may point at this node */
+	parent = priv->current->data;
+	if (parent != NULL && parent->children != NULL)
+		g_clear_pointer (&parent->children, g_hash_table_unref);
+	g_node_unlink (node);
+	g_node_traverse (node,
+			 G_PRE_ORDER,
+			 G_TRAVERSE_ALL,
+			 -1,
+			 cd_dom_destroy_node_cb,
+			 NULL);
+	g_node_destroy (node);
 }
 
 static void
@@ -193,7 +267,7 @@ cd_dom_text_cb (GMarkupParseContext *context,
 
 	/* save cdata */
 	data = priv->current->data;
-	g_string_append (data->cdata, text);
+	g_string_append_len (data->cdata, text, text_len);
 }
 
 /**
@@ -236,11 +310,80 @@ cd_dom_parse_xml_data (CdDom *dom,
 	return TRUE;
 }
 
+/**
+ * cd_dom_parse_xml_data_stream:
+ * @dom: a #CdDom instance.
+ * @data: (array length=data_len): XML data
+ * @data_len: Length of @data, or -1 if NULL terminated
+ * @path: a #CdDomPath, e.g. for "named/color"
+ * @func: (scope call): a function to call for each node matching @path
+ * @user_data: user data to pass to @func
+ * @error: A #GError or %NULL
+ *
+ * Parses data, calling @func for each complete node that matches @path.
+ * Each matching node is removed from the DOM tree once @func returns, so
+ * large documents with many repeated elements can be processed without
+ * keeping all of them in memory.
+ *
+ * If @func returns %FALSE then parsing stops and this function fails.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_dom_parse_xml_data_stream (CdDom *dom,
+			      const gchar *data,
+			      gssize data_len,
+			      const CdDomPath *path,
+			      CdDomNodeFunc func,
+			      gpointer user_data,
+			      GError **error)
+{
+	CdDomPrivate *priv = GET_PRIVATE (dom);
+	gboolean ret;
+
+	g_return_val_if_fail (CD_IS_DOM (dom), FALSE);
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+	g_return_val_if_fail (priv->stream_func == NULL, FALSE);
+
+	priv->stream_path = (CdDomPath *) path;
+	priv->stream_func = func;
+	priv->stream_user_data = user_data;
+	ret = cd_dom_parse_xml_data (dom, data, data_len, error);
+	priv->stream_path = NULL;
+	priv->stream_func = NULL;
+	priv->stream_user_data = NULL;
+	return ret;
+}
+
+static GHashTable *
+cd_dom_build_child_index (const GNode *root)
+{
+	CdDomNodeData *data;
+	GHashTable *hash;
+	GNode *node;
+
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (node = root->children; node != NULL; node = node->next) {
+		data = node->data;
+		if (g_hash_table_contains (hash, data->name))
+			continue;
+		g_hash_table_insert (hash, data->name, node);
+	}
+	return hash;
+}
+
 static GNode *
 cd_dom_get_child_node (const GNode *root, const gchar *name)
 {
+	CdDomNodeData *root_data = root->data;
 	GNode *node;
 	CdDomNodeData *data;
+	guint i = 0;
+
+	/* already indexed */
+	if (root_data != NULL && root_data->children != NULL)
+		return g_hash_table_lookup (root_data->children, name);
 
 	/* find a node called name */
 	for (node = root->children; node != NULL; node = node->next) {
@@ -249,6 +392,12 @@ cd_dom_get_child_node (const GNode *root, const gchar *name)
 			return NULL;
 		if (g_strcmp0 (data->name, name) == 0)
 			return node;
+
+		/* a wide node is worth indexing for the next lookup */
+		if (root_data != NULL && ++i == CD_DOM_CHILD_INDEX_MIN) {
+			root_data->children = cd_dom_build_child_index (root);
+			return g_hash_table_lookup (root_data->children, name);
+		}
 	}
 	return NULL;
 }
@@ -393,11 +542,101 @@ cd_dom_get_node_attribute (const GNode *node, const gchar *key)
  **/
 const GNode *
 cd_dom_get_node (CdDom *dom, const GNode *root, const gchar *path)
+{
+	CdDomPrivate *priv = GET_PRIVATE (dom);
+	const GNode *node;
+	const gchar *end;
+	gchar buf[64];
+	gsize len;
+
+	g_return_val_if_fail (CD_IS_DOM (dom), NULL);
+	g_return_val_if_fail (path != NULL, NULL);
+
+	/* default value */
+	if (root == NULL)
+		root = priv->root;
+
+	/* walk each section without splitting the whole path */
+	node = root;
+	for (;;) {
+		end = strchr (path, '/');
+		len = end != NULL ? (gsize) (end - path) : strlen (path);
+		if (len < sizeof (buf)) {
+			memcpy (buf, path, len);
+			buf[len] = '\0';
+			node = cd_dom_get_child_node (node, buf);
+		} else {
+			g_autofree gchar *name = g_strndup (path, len);
+			node = cd_dom_get_child_node (node, name);
+		}
+		if (node == NULL)
+			return NULL;
+		if (end == NULL)
+			break;
+		path = end + 1;
+	}
+	return node;
+}
+
+/**
+ * cd_dom_path_new:
+ * @path: a path in the DOM, e.g. "html/body"
+ *
+ * Compiles a path so that it can be used many times with
+ * cd_dom_get_node_for_path() or cd_dom_parse_xml_data_stream().
+ *
+ * Return value: (transfer full): a new #CdDomPath
+ *
+ * Since: 1.4.10
+ **/
+CdDomPath *
+cd_dom_path_new (const gchar *path)
+{
+	CdDomPath *dom_path;
+
+	g_return_val_if_fail (path != NULL, NULL);
+
+	dom_path = g_new0 (CdDomPath, 1);
+	dom_path->names = g_strsplit (path, "/", -1);
+	dom_path->len = g_strv_length (dom_path->names);
+	return dom_path;
+}
+
+/**
+ * cd_dom_path_free:
+ * @path: a #CdDomPath, or %NULL
+ *
+ * Frees a path created with cd_dom_path_new().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_dom_path_free (CdDomPath *path)
+{
+	if (path == NULL)
+		return;
+	g_strfreev (path->names);
+	g_free (path);
+}
+
+/**
+ * cd_dom_get_node_for_path:
+ * @dom: a #CdDom instance.
+ * @root: a root node, or %NULL
+ * @path: a #CdDomPath
+ *
+ * Gets a node from the DOM tree using a precompiled path.
+ *
+ * Return value: A #GNode, or %NULL if not found
+ *
+ * Since: 1.4.10
+ **/
+const GNode *
+cd_dom_get_node_for_path (CdDom *dom, const GNode *root, const CdDomPath *path)
 {
 	CdDomPrivate *priv = GET_PRIVATE (dom);
 	const GNode *node;
 	guint i;
-	g_auto(GStrv) split = NULL;
 
 	g_return_val_if_fail (CD_IS_DOM (dom), NULL);
 	g_return_val_if_fail (path != NULL, NULL);
@@ -407,9 +646,8 @@ cd_dom_get_node (CdDom *dom, const GNode *root, const gchar *path)
 		root = priv->root;
 
 	node = root;
-	split = g_strsplit (path, "/", -1);
-	for (i = 0; split[i] != NULL; i++) {
-		node = cd_dom_get_child_node (node, split[i]);
+	for (i = 0; i < path->len; i++) {
+		node = cd_dom_get_child_node (node, path->names[i]);
 		if (node == NULL)
 			return NULL;
 	}
@@ -602,6 +840,8 @@ cd_dom_destroy_node_cb (GNode *node, gpointer user_data)
 	g_free (data->name);
 	g_string_free (data->cdata, TRUE);
 	g_hash_table_unref (data->attributes);
+	if (data->children != NULL)
+		g_hash_table_unref (data->children);
 	g_slice_free (CdDomNodeData, data);
 	return FALSE;
 }
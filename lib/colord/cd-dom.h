@@ -38,6 +38,29 @@ G_BEGIN_DECLS
 #define CD_TYPE_DOM (cd_dom_get_type ())
 G_DECLARE_DERIVABLE_TYPE (CdDom, cd_dom, CD, DOM, GObject)
 
+/**
+ * CdDomPath:
+ *
+ * An opaque precompiled path into a #CdDom tree.
+ **/
+typedef struct _CdDomPath	CdDomPath;
+
+/**
+ * CdDomNodeFunc:
+ * @dom: a #CdDom instance.
+ * @node: a complete #GNode matching the path
+ * @user_data: user data
+ * @error: A #GError or %NULL
+ *
+ * The callback used by cd_dom_parse_xml_data_stream().
+ *
+ * Return value: %FALSE to stop parsing
+ **/
+typedef gboolean (*CdDomNodeFunc)		(CdDom		*dom,
+						 const GNode	*node,
+						 gpointer	 user_data,
+						 GError		**error);
+
 struct _CdDomClass
 {
 	GObjectClass		 parent_class;
@@ -61,10 +84,24 @@ gboolean	 cd_dom_parse_xml_data			(CdDom		*dom,
 							 gssize		 data_len,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_dom_parse_xml_data_stream		(CdDom		*dom,
+							 const gchar	*data,
+							 gssize		 data_len,
+							 const CdDomPath *path,
+							 CdDomNodeFunc	 func,
+							 gpointer	 user_data,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 const GNode	*cd_dom_get_node			(CdDom		*dom,
 							 const GNode	*root,
 							 const gchar	*path)
 							 G_GNUC_WARN_UNUSED_RESULT;
+CdDomPath	*cd_dom_path_new			(const gchar	*path);
+void		 cd_dom_path_free			(CdDomPath	*path);
+const GNode	*cd_dom_get_node_for_path		(CdDom		*dom,
+							 const GNode	*root,
+							 const CdDomPath *path)
+							 G_GNUC_WARN_UNUSED_RESULT;
 const gchar	*cd_dom_get_node_name			(const GNode	*node);
 const gchar	*cd_dom_get_node_data			(const GNode	*node);
 gint		 cd_dom_get_node_data_as_int		(const GNode	*node);
@@ -80,6 +117,8 @@ gboolean	 cd_dom_get_node_lab			(const GNode	*node,
 GHashTable	*cd_dom_get_node_localized		(const GNode	*node,
 							 const gchar	*key);
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdDomPath, cd_dom_path_free)
+
 G_END_DECLS
 
 #endif /* __CD_DOM_H */
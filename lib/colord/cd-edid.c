@@ -103,67 +103,100 @@ cd_edid_get_monitor_name (CdEdid *edid)
 	return priv->monitor_name;
 }
 
+/* the vendor names are shared by all the EDIDs in the process */
+G_LOCK_DEFINE_STATIC (cd_edid_vendors);
+static GHashTable *cd_edid_vendors = NULL;	/* pnp_id : vendor_name or NULL */
+
+#ifndef PNP_IDS
+static struct udev *cd_edid_udev = NULL;
+static struct udev_hwdb *cd_edid_hwdb = NULL;
+
 static gchar *
-cd_edid_convert_pnp_id_to_string (const gchar *pnp_id)
+cd_edid_lookup_hwdb (const gchar *pnp_id)
 {
-#ifndef PNP_IDS
-	gchar *vendor = NULL;
-	struct udev_hwdb *hwdb = NULL;
 	struct udev_list_entry *e;
 	struct udev_list_entry *v;
-	struct udev *udev;
 	g_autofree gchar *modalias = NULL;
 
-	/* connect to the hwdb */
-	udev = udev_new ();
-	if (udev == NULL)
-		goto out;
-	hwdb = udev_hwdb_new (udev);
-	if (hwdb == NULL)
-		goto out;
+	/* connect to the hwdb, which is kept open for the next lookup */
+	if (cd_edid_udev == NULL) {
+		cd_edid_udev = udev_new ();
+		if (cd_edid_udev == NULL)
+			return NULL;
+	}
+	if (cd_edid_hwdb == NULL) {
+		cd_edid_hwdb = udev_hwdb_new (cd_edid_udev);
+		if (cd_edid_hwdb == NULL)
+			return NULL;
+	}
 
 	/* search the hash */
 	modalias = g_strdup_printf ("acpi:%s:", pnp_id);
-	e = udev_hwdb_get_properties_list_entry (hwdb, modalias, 0);
+	e = udev_hwdb_get_properties_list_entry (cd_edid_hwdb, modalias, 0);
 	if (e == NULL)
-		goto out;
+		return NULL;
 
 	/* the hwdb only contains this key at the moment, but future proof */
 	v = udev_list_entry_get_by_name (e, "ID_VENDOR_FROM_DATABASE");
 	if (v == NULL)
-		goto out;
+		return NULL;
 
 	/* quirk the name */
-	vendor = cd_quirk_vendor_name (udev_list_entry_get_value (v));
-out:
-	if (hwdb != NULL)
-		udev_hwdb_unref (hwdb);
-	if (udev != NULL)
-		udev_unref (udev);
-	return vendor;
+	return cd_quirk_vendor_name (udev_list_entry_get_value (v));
+}
 #else
+static void
+cd_edid_load_pnp_ids (GHashTable *vendors)
+{
 	g_autofree gchar *data = NULL;
+	g_auto(GStrv) lines = NULL;
 
 	/* load pnp.ids */
 	if (!g_file_get_contents (PNP_IDS, &data, NULL, NULL))
-		return NULL;
-	if (data == NULL)
-		return NULL;
+		return;
 
-	/* get the vendor name from the tab delimited data */
-	for (gchar *idx = data; idx != NULL; ) {
-		if (strncmp (idx, pnp_id, 3) == 0) {
-			gchar *idx2 = g_strstr_len (idx, -1, "\n");
-			if (idx2 != NULL)
-				*idx2 = '\0';
-			return g_strdup (idx + 4);
-		}
-		idx = g_strstr_len (idx, -1, "\n");
-		if (idx != NULL)
-			idx++;
+	/* get the vendor names from the tab delimited data */
+	lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		g_autofree gchar *pnp_id = NULL;
+		if (strlen (lines[i]) < 4)
+			continue;
+		pnp_id = g_strndup (lines[i], 3);
+		if (g_hash_table_contains (vendors, pnp_id))
+			continue;
+		g_hash_table_insert (vendors,
+				     g_steal_pointer (&pnp_id),
+				     g_strdup (lines[i] + 4));
 	}
-	return NULL;
+}
 #endif
+
+static gchar *
+cd_edid_convert_pnp_id_to_string (const gchar *pnp_id)
+{
+	gchar *vendor;
+	gpointer value = NULL;
+
+	G_LOCK (cd_edid_vendors);
+	if (cd_edid_vendors == NULL) {
+		cd_edid_vendors = g_hash_table_new_full (g_str_hash, g_str_equal,
+							 g_free, g_free);
+#ifdef PNP_IDS
+		cd_edid_load_pnp_ids (cd_edid_vendors);
+#endif
+	}
+#ifndef PNP_IDS
+	/* also remember the IDs that are not in the hwdb */
+	if (!g_hash_table_lookup_extended (cd_edid_vendors, pnp_id, NULL, &value)) {
+		value = cd_edid_lookup_hwdb (pnp_id);
+		g_hash_table_insert (cd_edid_vendors, g_strdup (pnp_id), value);
+	}
+#else
+	value = g_hash_table_lookup (cd_edid_vendors, pnp_id);
+#endif
+	vendor = g_strdup (value);
+	G_UNLOCK (cd_edid_vendors);
+	return vendor;
 }
 
 /**
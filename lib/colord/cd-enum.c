@@ -45,6 +45,21 @@ typedef struct {
 	const gchar	*string;
 } CdEnumMatch;
 
+/**
+ * CdEnumIndex:
+ *
+ * Direct lookups into a #CdEnumMatch table, in both directions
+ **/
+typedef struct {
+	const CdEnumMatch	*table;
+	gsize			 once;
+	const gchar		**values;	/* indexed by value */
+	guint			 n_values;
+	GHashTable		*strings;	/* string : value */
+} CdEnumIndex;
+
+#define CD_ENUM_INDEX(t)	{ (t), 0, NULL, 0, NULL }
+
 static const CdEnumMatch enum_sensor_kind[] = {
 	{CD_SENSOR_KIND_UNKNOWN,			"unknown"},	/* fall though value */
 	{CD_SENSOR_KIND_COLORHUG,			"colorhug"},
@@ -113,6 +128,20 @@ static const CdEnumMatch enum_pixel_format[] = {
 	{CD_PIXEL_FORMAT_ARGB32,			"argb32"},
 	{CD_PIXEL_FORMAT_RGB24,				"rgb24"},
 	{CD_PIXEL_FORMAT_CMYK32,			"cmyk32"},
+	{CD_PIXEL_FORMAT_RGB48,				"rgb48"},
+	{CD_PIXEL_FORMAT_RGBA64,			"rgba64"},
+	{CD_PIXEL_FORMAT_CMYK64,			"cmyk64"},
+	{CD_PIXEL_FORMAT_RGB_HALF,			"rgb-half"},
+	{CD_PIXEL_FORMAT_RGBA_HALF,			"rgba-half"},
+	{CD_PIXEL_FORMAT_RGB_FLOAT,			"rgb-float"},
+	{CD_PIXEL_FORMAT_RGBA_FLOAT,			"rgba-float"},
+	{CD_PIXEL_FORMAT_RGB24_PLANAR,			"rgb24-planar"},
+	{CD_PIXEL_FORMAT_RGB48_PLANAR,			"rgb48-planar"},
+	{CD_PIXEL_FORMAT_RGB_FLOAT_PLANAR,		"rgb-float-planar"},
+	{CD_PIXEL_FORMAT_CMYK32_PLANAR,			"cmyk32-planar"},
+	{CD_PIXEL_FORMAT_RGB_DOUBLE,			"rgb-double"},
+	{CD_PIXEL_FORMAT_XYZ_DOUBLE,			"xyz-double"},
+	{CD_PIXEL_FORMAT_LAB_DOUBLE,			"lab-double"},
 	{0, NULL}
 };
 
@@ -217,9 +246,60 @@ static const CdEnumMatch enum_profile_quality[] = {
 	{0, NULL}
 };
 
+/* built on first use from the tables above */
+static CdEnumIndex enum_sensor_kind_index = CD_ENUM_INDEX (enum_sensor_kind);
+static CdEnumIndex enum_device_kind_index = CD_ENUM_INDEX (enum_device_kind);
+static CdEnumIndex enum_profile_kind_index = CD_ENUM_INDEX (enum_profile_kind);
+static CdEnumIndex enum_rendering_intent_index = CD_ENUM_INDEX (enum_rendering_intent);
+static CdEnumIndex enum_pixel_format_index = CD_ENUM_INDEX (enum_pixel_format);
+static CdEnumIndex enum_colorspace_index = CD_ENUM_INDEX (enum_colorspace);
+static CdEnumIndex enum_device_relation_index = CD_ENUM_INDEX (enum_device_relation);
+static CdEnumIndex enum_device_mode_index = CD_ENUM_INDEX (enum_device_mode);
+static CdEnumIndex enum_object_scope_index = CD_ENUM_INDEX (enum_object_scope);
+static CdEnumIndex enum_sensor_state_index = CD_ENUM_INDEX (enum_sensor_state);
+static CdEnumIndex enum_sensor_cap_index = CD_ENUM_INDEX (enum_sensor_cap);
+static CdEnumIndex enum_standard_space_index = CD_ENUM_INDEX (enum_standard_space);
+static CdEnumIndex enum_profile_warning_index = CD_ENUM_INDEX (enum_profile_warning);
+static CdEnumIndex enum_profile_quality_index = CD_ENUM_INDEX (enum_profile_quality);
+
+/* called once per table, from whichever thread converts a value first */
+static void
+cd_enum_index_init (CdEnumIndex *idx)
+{
+	const CdEnumMatch *table = idx->table;
+	guint n_values = 0;
+
+	for (guint i = 0; table[i].string != NULL; i++)
+		n_values = MAX (n_values, table[i].value + 1);
+	idx->values = g_new0 (const gchar *, n_values);
+	idx->n_values = n_values;
+	idx->strings = g_hash_table_new (g_str_hash, g_str_equal);
+
+	/* the first entry wins, as it did for the linear search */
+	for (guint i = 0; table[i].string != NULL; i++) {
+		if (idx->values[table[i].value] == NULL)
+			idx->values[table[i].value] = table[i].string;
+		if (!g_hash_table_contains (idx->strings, table[i].string)) {
+			g_hash_table_insert (idx->strings,
+					     (gpointer) table[i].string,
+					     GUINT_TO_POINTER (table[i].value));
+		}
+	}
+}
+
+static CdEnumIndex *
+cd_enum_index_get (CdEnumIndex *idx)
+{
+	if (g_once_init_enter (&idx->once)) {
+		cd_enum_index_init (idx);
+		g_once_init_leave (&idx->once, 1);
+	}
+	return idx;
+}
+
 /**
  * cd_enum_from_string:
- * @table: A #CdEnumMatch enum table of values
+ * @idx: A #CdEnumIndex of a table of values
  * @string: the string constant to search for, e.g. "desktop-gnome"
  *
  * Search for a string value in a table of constants.
@@ -227,27 +307,22 @@ static const CdEnumMatch enum_profile_quality[] = {
  * Return value: the enumerated constant value, e.g. PK_SIGTYPE_ENUM_GPG
  */
 static guint
-cd_enum_from_string (const CdEnumMatch *table, const gchar *string)
+cd_enum_from_string (CdEnumIndex *idx, const gchar *string)
 {
-	const gchar *string_tmp;
-	guint i;
+	gpointer value;
 
 	/* return the first entry on non-found or error */
 	if (string == NULL)
-		return table[0].value;
-	for (i = 0; ; i++) {
-		string_tmp = table[i].string;
-		if (string_tmp == NULL)
-			break;
-		if (g_strcmp0 (string, string_tmp) == 0)
-			return table[i].value;
-	}
-	return table[0].value;
+		return idx->table[0].value;
+	cd_enum_index_get (idx);
+	if (!g_hash_table_lookup_extended (idx->strings, string, NULL, &value))
+		return idx->table[0].value;
+	return GPOINTER_TO_UINT (value);
 }
 
 /**
  * cd_enum_to_string:
- * @table: A #CdEnumMatch enum table of values
+ * @idx: A #CdEnumIndex of a table of values
  * @value: the enumerated constant value, e.g. PK_SIGTYPE_ENUM_GPG
  *
  * Search for a enum value in a table of constants.
@@ -255,21 +330,12 @@ cd_enum_from_string (const CdEnumMatch *table, const gchar *string)
  * Return value: the string constant, e.g. "desktop-gnome"
  */
 static const gchar *
-cd_enum_to_string (const CdEnumMatch *table, guint value)
+cd_enum_to_string (CdEnumIndex *idx, guint value)
 {
-	guint i;
-	guint tmp;
-	const gchar *string_tmp;
-
-	for (i=0;;i++) {
-		string_tmp = table[i].string;
-		if (string_tmp == NULL)
-			break;
-		tmp = table[i].value;
-		if (tmp == value)
-			return table[i].string;
-	}
-	return table[0].string;
+	cd_enum_index_get (idx);
+	if (value >= idx->n_values || idx->values[value] == NULL)
+		return idx->table[0].string;
+	return idx->values[value];
 }
 
 /**
@@ -284,7 +350,7 @@ cd_enum_to_string (const CdEnumMatch *table, guint value)
 const gchar *
 cd_device_kind_to_string (CdDeviceKind kind_enum)
 {
-	return cd_enum_to_string (enum_device_kind, kind_enum);
+	return cd_enum_to_string (&enum_device_kind_index, kind_enum);
 }
 
 /**
@@ -299,7 +365,7 @@ cd_device_kind_to_string (CdDeviceKind kind_enum)
 CdDeviceKind
 cd_device_kind_from_string (const gchar *type)
 {
-	return cd_enum_from_string (enum_device_kind, type);
+	return cd_enum_from_string (&enum_device_kind_index, type);
 }
 
 /**
@@ -310,7 +376,7 @@ cd_device_kind_from_string (const gchar *type)
 const gchar *
 cd_profile_kind_to_string (CdProfileKind kind)
 {
-	return cd_enum_to_string (enum_profile_kind, kind);
+	return cd_enum_to_string (&enum_profile_kind_index, kind);
 }
 
 /**
@@ -321,7 +387,7 @@ cd_profile_kind_to_string (CdProfileKind kind)
 CdProfileKind
 cd_profile_kind_from_string (const gchar *profile_kind)
 {
-	return cd_enum_from_string (enum_profile_kind, profile_kind);
+	return cd_enum_from_string (&enum_profile_kind_index, profile_kind);
 }
 
 /**
@@ -330,7 +396,7 @@ cd_profile_kind_from_string (const gchar *profile_kind)
 const gchar *
 cd_rendering_intent_to_string (CdRenderingIntent rendering_intent)
 {
-	return cd_enum_to_string (enum_rendering_intent, rendering_intent);
+	return cd_enum_to_string (&enum_rendering_intent_index, rendering_intent);
 }
 
 /**
@@ -339,7 +405,7 @@ cd_rendering_intent_to_string (CdRenderingIntent rendering_intent)
 CdRenderingIntent
 cd_rendering_intent_from_string (const gchar *rendering_intent)
 {
-	return cd_enum_from_string (enum_rendering_intent, rendering_intent);
+	return cd_enum_from_string (&enum_rendering_intent_index, rendering_intent);
 }
 
 /**
@@ -348,7 +414,7 @@ cd_rendering_intent_from_string (const gchar *rendering_intent)
 const gchar *
 cd_pixel_format_to_string (CdPixelFormat pixel_format)
 {
-	return cd_enum_to_string (enum_pixel_format, pixel_format);
+	return cd_enum_to_string (&enum_pixel_format_index, pixel_format);
 }
 
 /**
@@ -357,7 +423,7 @@ cd_pixel_format_to_string (CdPixelFormat pixel_format)
 CdPixelFormat
 cd_pixel_format_from_string (const gchar *pixel_format)
 {
-	return cd_enum_from_string (enum_pixel_format, pixel_format);
+	return cd_enum_from_string (&enum_pixel_format_index, pixel_format);
 }
 
 /**
@@ -366,7 +432,7 @@ cd_pixel_format_from_string (const gchar *pixel_format)
 const gchar *
 cd_colorspace_to_string (CdColorspace colorspace)
 {
-	return cd_enum_to_string (enum_colorspace, colorspace);
+	return cd_enum_to_string (&enum_colorspace_index, colorspace);
 }
 
 /**
@@ -375,7 +441,7 @@ cd_colorspace_to_string (CdColorspace colorspace)
 CdColorspace
 cd_colorspace_from_string (const gchar *colorspace)
 {
-	return cd_enum_from_string (enum_colorspace, colorspace);
+	return cd_enum_from_string (&enum_colorspace_index, colorspace);
 }
 
 /**
@@ -384,7 +450,7 @@ cd_colorspace_from_string (const gchar *colorspace)
 const gchar *
 cd_device_mode_to_string (CdDeviceMode device_mode)
 {
-	return cd_enum_to_string (enum_device_mode, device_mode);
+	return cd_enum_to_string (&enum_device_mode_index, device_mode);
 }
 
 /**
@@ -393,7 +459,7 @@ cd_device_mode_to_string (CdDeviceMode device_mode)
 CdDeviceMode
 cd_device_mode_from_string (const gchar *device_mode)
 {
-	return cd_enum_from_string (enum_device_mode, device_mode);
+	return cd_enum_from_string (&enum_device_mode_index, device_mode);
 }
 
 /**
@@ -402,7 +468,7 @@ cd_device_mode_from_string (const gchar *device_mode)
 const gchar *
 cd_device_relation_to_string (CdDeviceRelation device_relation)
 {
-	return cd_enum_to_string (enum_device_relation, device_relation);
+	return cd_enum_to_string (&enum_device_relation_index, device_relation);
 }
 
 /**
@@ -411,7 +477,7 @@ cd_device_relation_to_string (CdDeviceRelation device_relation)
 CdDeviceRelation
 cd_device_relation_from_string (const gchar *device_relation)
 {
-	return cd_enum_from_string (enum_device_relation, device_relation);
+	return cd_enum_from_string (&enum_device_relation_index, device_relation);
 }
 
 /**
@@ -420,7 +486,7 @@ cd_device_relation_from_string (const gchar *device_relation)
 const gchar *
 cd_object_scope_to_string (CdObjectScope object_scope)
 {
-	return cd_enum_to_string (enum_object_scope, object_scope);
+	return cd_enum_to_string (&enum_object_scope_index, object_scope);
 }
 
 /**
@@ -429,7 +495,7 @@ cd_object_scope_to_string (CdObjectScope object_scope)
 CdObjectScope
 cd_object_scope_from_string (const gchar *object_scope)
 {
-	return cd_enum_from_string (enum_object_scope, object_scope);
+	return cd_enum_from_string (&enum_object_scope_index, object_scope);
 }
 
 /**
@@ -443,7 +509,7 @@ cd_object_scope_from_string (const gchar *object_scope)
 const gchar *
 cd_sensor_kind_to_string (CdSensorKind sensor_kind)
 {
-	return cd_enum_to_string (enum_sensor_kind, sensor_kind);
+	return cd_enum_to_string (&enum_sensor_kind_index, sensor_kind);
 }
 
 /**
@@ -457,7 +523,7 @@ cd_sensor_kind_to_string (CdSensorKind sensor_kind)
 CdSensorKind
 cd_sensor_kind_from_string (const gchar *sensor_kind)
 {
-	return cd_enum_from_string (enum_sensor_kind, sensor_kind);
+	return cd_enum_from_string (&enum_sensor_kind_index, sensor_kind);
 }
 
 /**
@@ -471,7 +537,7 @@ cd_sensor_kind_from_string (const gchar *sensor_kind)
 const gchar *
 cd_sensor_state_to_string (CdSensorState sensor_state)
 {
-	return cd_enum_to_string (enum_sensor_state, sensor_state);
+	return cd_enum_to_string (&enum_sensor_state_index, sensor_state);
 }
 
 /**
@@ -485,7 +551,7 @@ cd_sensor_state_to_string (CdSensorState sensor_state)
 CdSensorState
 cd_sensor_state_from_string (const gchar *sensor_state)
 {
-	return cd_enum_from_string (enum_sensor_state, sensor_state);
+	return cd_enum_from_string (&enum_sensor_state_index, sensor_state);
 }
 
 /**
@@ -499,7 +565,7 @@ cd_sensor_state_from_string (const gchar *sensor_state)
 const gchar *
 cd_sensor_cap_to_string (CdSensorCap sensor_cap)
 {
-	return cd_enum_to_string (enum_sensor_cap, sensor_cap);
+	return cd_enum_to_string (&enum_sensor_cap_index, sensor_cap);
 }
 
 /**
@@ -513,7 +579,7 @@ cd_sensor_cap_to_string (CdSensorCap sensor_cap)
 CdSensorCap
 cd_sensor_cap_from_string (const gchar *sensor_cap)
 {
-	return cd_enum_from_string (enum_sensor_cap, sensor_cap);
+	return cd_enum_from_string (&enum_sensor_cap_index, sensor_cap);
 }
 
 /**
@@ -527,7 +593,7 @@ cd_sensor_cap_from_string (const gchar *sensor_cap)
 const gchar *
 cd_standard_space_to_string (CdStandardSpace standard_space)
 {
-	return cd_enum_to_string (enum_standard_space, standard_space);
+	return cd_enum_to_string (&enum_standard_space_index, standard_space);
 }
 
 /**
@@ -541,7 +607,7 @@ cd_standard_space_to_string (CdStandardSpace standard_space)
 CdStandardSpace
 cd_standard_space_from_string (const gchar *standard_space)
 {
-	return cd_enum_from_string (enum_standard_space, standard_space);
+	return cd_enum_from_string (&enum_standard_space_index, standard_space);
 }
 
 /**
@@ -556,7 +622,7 @@ cd_standard_space_from_string (const gchar *standard_space)
 const gchar *
 cd_profile_warning_to_string (CdProfileWarning kind_enum)
 {
-	return cd_enum_to_string (enum_profile_warning, kind_enum);
+	return cd_enum_to_string (&enum_profile_warning_index, kind_enum);
 }
 
 /**
@@ -571,7 +637,7 @@ cd_profile_warning_to_string (CdProfileWarning kind_enum)
 CdProfileWarning
 cd_profile_warning_from_string (const gchar *type)
 {
-	return cd_enum_from_string (enum_profile_warning, type);
+	return cd_enum_from_string (&enum_profile_warning_index, type);
 }
 
 /**
@@ -586,7 +652,7 @@ cd_profile_warning_from_string (const gchar *type)
 const gchar *
 cd_profile_quality_to_string (CdProfileQuality quality_enum)
 {
-	return cd_enum_to_string (enum_profile_quality, quality_enum);
+	return cd_enum_to_string (&enum_profile_quality_index, quality_enum);
 }
 
 /**
@@ -601,7 +667,7 @@ cd_profile_quality_to_string (CdProfileQuality quality_enum)
 CdProfileQuality
 cd_profile_quality_from_string (const gchar *quality)
 {
-	return cd_enum_from_string (enum_profile_quality, quality);
+	return cd_enum_from_string (&enum_profile_quality_index, quality);
 }
 
 /**
@@ -671,6 +737,8 @@ cd_sensor_error_to_string (CdSensorError error_enum)
 		return CD_DBUS_INTERFACE_SENSOR ".RequiredDarkCalibration";
 	if (error_enum == CD_SENSOR_ERROR_REQUIRED_IRRADIANCE_CALIBRATION)
 		return CD_DBUS_INTERFACE_SENSOR ".RequiredIrradianceCalibration";
+	if (error_enum == CD_SENSOR_ERROR_INVALID_VALUE)
+		return CD_DBUS_INTERFACE_SENSOR ".InvalidValue";
 	return NULL;
 }
 
@@ -708,6 +776,8 @@ cd_sensor_error_from_string (const gchar *error_desc)
 		return CD_SENSOR_ERROR_REQUIRED_DARK_CALIBRATION;
 	if (g_strcmp0 (error_desc, CD_DBUS_INTERFACE_SENSOR ".RequiredIrradianceCalibration") == 0)
 		return CD_SENSOR_ERROR_REQUIRED_IRRADIANCE_CALIBRATION;
+	if (g_strcmp0 (error_desc, CD_DBUS_INTERFACE_SENSOR ".InvalidValue") == 0)
+		return CD_SENSOR_ERROR_INVALID_VALUE;
 	return CD_SENSOR_ERROR_LAST;
 }
 
@@ -112,6 +112,20 @@ typedef guint32 CdPixelFormat;
 #define	CD_PIXEL_FORMAT_CMYK32		0x00060021	/* Since: 1.0.0 */
 #define	CD_PIXEL_FORMAT_BGRA32		0x00044499	/* Since: 1.0.0 */
 #define	CD_PIXEL_FORMAT_RGBA32		0x00040099	/* Since: 1.1.8 */
+#define	CD_PIXEL_FORMAT_RGB48		0x0004001a	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGBA64		0x0004009a	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_CMYK64		0x00060022	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB_HALF	0x0044001a	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGBA_HALF	0x0044009a	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB_FLOAT	0x0044001c	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGBA_FLOAT	0x0044009c	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB24_PLANAR	0x00041019	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB48_PLANAR	0x0004101a	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB_FLOAT_PLANAR 0x0044101c	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_CMYK32_PLANAR	0x00061021	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_RGB_DOUBLE	0x00440018	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_XYZ_DOUBLE	0x00490018	/* Since: 1.4.10 */
+#define	CD_PIXEL_FORMAT_LAB_DOUBLE	0x004a0018	/* Since: 1.4.10 */
 
 /**
  * CdColorspace:
@@ -324,6 +338,7 @@ typedef enum {
  * @CD_SENSOR_ERROR_REQUIRED_POSITION_SURFACE:		The sensor needs to be in the surface position
  * @CD_SENSOR_ERROR_REQUIRED_DARK_CALIBRATION:		The sensor needs dark calibration
  * @CD_SENSOR_ERROR_REQUIRED_IRRADIANCE_CALIBRATION:	The sensor needs irradiance calibration
+ * @CD_SENSOR_ERROR_INVALID_VALUE:	A value passed to the sensor is out of range
  *
  * The sensor error code.
  *
@@ -341,6 +356,7 @@ typedef enum {
 	CD_SENSOR_ERROR_REQUIRED_POSITION_SURFACE,	/* Since: 0.1.26 */
 	CD_SENSOR_ERROR_REQUIRED_DARK_CALIBRATION,	/* Since: 1.2.13 */
 	CD_SENSOR_ERROR_REQUIRED_IRRADIANCE_CALIBRATION, /* Since: 1.1.1 */
+	CD_SENSOR_ERROR_INVALID_VALUE,			/* Since: 1.4.10 */
 	/*< private >*/
 	CD_SENSOR_ERROR_LAST
 } CdSensorError;
@@ -429,6 +445,7 @@ typedef enum {
 #define CD_CLIENT_PROPERTY_DAEMON_VERSION	"DaemonVersion"		/* Since: 0.1.0 */
 #define CD_CLIENT_PROPERTY_SYSTEM_VENDOR	"SystemVendor"		/* Since: 1.0.2 */
 #define CD_CLIENT_PROPERTY_SYSTEM_MODEL		"SystemModel"		/* Since: 1.0.2 */
+#define CD_CLIENT_PROPERTY_STARTUP_STAGE	"StartupStage"		/* Since: 1.4.10 */
 
 /* defined in metadata-spec.txt */
 #define CD_PROFILE_METADATA_STANDARD_SPACE	"STANDARD_space"	/* Since: 0.1.8 */
@@ -26,10 +26,15 @@
 
 #include "config.h"
 
+#include <string.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
+#include "cd-icc-private.h"
 #include "cd-icc-store.h"
+#include "cd-icc-store-private.h"
+#include "cd-trace-private.h"
 
 static void	cd_icc_store_finalize	(GObject	*object);
 
@@ -38,14 +43,36 @@ static void	cd_icc_store_finalize	(GObject	*object);
 typedef struct
 {
 	CdIccLoadFlags		 load_flags;
+	gboolean		 metadata_only;
 	GPtrArray		*directory_array;
 	GPtrArray		*icc_array;
+	GHashTable		*directory_hash;	/* path : CdIccStoreDirHelper */
+	GHashTable		*filename_hash;		/* filename : CdIcc */
+	GHashTable		*checksum_hash;		/* checksum : CdIcc */
 	GResource		*cache;
+	GPtrArray		*bundles;	/* of CdIccStoreBundle */
+	gchar			*checksum_cache_fn;
+	GHashTable		*checksum_cache;	/* key is inode:mtime:size */
+	GHashTable		*checksum_cache_used;
+	guint			 checksum_cache_id;
+	gchar			*index_fn;
+	GKeyFile		*index;		/* group is the filename */
+	GKeyFile		*index_used;
+	GMutex			 index_mutex;
+	guint			 index_id;
+	GPtrArray		*pending;	/* of CdIccStoreLoadItem */
+	GHashTable		*changes;	/* path : CdIccStoreChange */
+	guint			 changes_id;
+	guint			 changes_cnt;
+	GPtrArray		*cold_roots;	/* of path */
+	guint			 sweep_id;
+	guint			 sweep_interval;	/* s */
 } CdIccStorePrivate;
 
 enum {
 	SIGNAL_ADDED,
 	SIGNAL_REMOVED,
+	SIGNAL_CHANGED,
 	SIGNAL_LAST
 };
 
@@ -54,6 +81,16 @@ static guint signals[SIGNAL_LAST] = { 0 };
 G_DEFINE_TYPE_WITH_PRIVATE (CdIccStore, cd_icc_store, G_TYPE_OBJECT)
 
 #define CD_ICC_STORE_MAX_RECURSION_LEVELS	  2
+#define CD_ICC_STORE_CHECKSUM_CACHE_DELAY	  5 /* s */
+#define CD_ICC_STORE_INDEX_DELAY		  5 /* s */
+#define CD_ICC_STORE_LOAD_THREADS_MAX		  8
+#define CD_ICC_STORE_CHANGES_DELAY		250 /* ms */
+#define CD_ICC_STORE_SWEEP_INTERVAL		 60 /* s */
+
+typedef enum {
+	CD_ICC_STORE_CHANGE_DELETED	= 1 << 0,
+	CD_ICC_STORE_CHANGE_CREATED	= 1 << 1,
+} CdIccStoreChange;
 
 static gboolean
 cd_icc_store_search_path (CdIccStore *store,
@@ -71,7 +108,8 @@ cd_icc_store_search_path_child (CdIccStore *store,
 
 typedef struct {
 	gchar		*path;
-	GFileMonitor	*monitor;
+	GFileMonitor	*monitor;	/* NULL if only swept */
+	guint64		 mtime;		/* us */
 } CdIccStoreDirHelper;
 
 static void
@@ -83,6 +121,67 @@ cd_icc_store_helper_free (CdIccStoreDirHelper *helper)
 	g_free (helper);
 }
 
+/* a profile bundle made with glib-compile-resources */
+typedef struct {
+	GResource	*resource;
+	gchar		*filename;
+	gint64		 mtime;
+} CdIccStoreBundle;
+
+#define CD_ICC_STORE_BUNDLE_PREFIX	"/org/freedesktop/colord/bundle"
+#define CD_ICC_STORE_HEADER_SIZE	128
+#define CD_ICC_STORE_PROFILE_ID_OFFSET	84
+#define CD_ICC_STORE_PROFILE_ID_SIZE	16
+
+static void
+cd_icc_store_bundle_free (CdIccStoreBundle *bundle)
+{
+	g_resource_unref (bundle->resource);
+	g_free (bundle->filename);
+	g_free (bundle);
+}
+
+/* a profile that is parsed in a worker thread and then added to the store
+ * in the thread that searched the location */
+typedef struct {
+	GFile		*file;
+	gchar		*filename;
+	CdIcc		*icc;
+	gchar		*checksum_key;
+	gboolean	 checksum_cached;
+	gchar		*duplicate;	/* checksum of an earlier copy */
+	gchar		*index_key;
+	GKeyFile	*index_entry;	/* new entry, or %NULL if unchanged */
+	GError		*error;
+	gboolean	 done;
+} CdIccStoreLoadItem;
+
+static CdIccStoreLoadItem *
+cd_icc_store_load_item_new (GFile *file)
+{
+	CdIccStoreLoadItem *item = g_new0 (CdIccStoreLoadItem, 1);
+	item->file = g_object_ref (file);
+	item->filename = g_file_get_path (file);
+	return item;
+}
+
+static void
+cd_icc_store_load_item_free (CdIccStoreLoadItem *item)
+{
+	g_object_unref (item->file);
+	g_free (item->filename);
+	if (item->icc != NULL)
+		g_object_unref (item->icc);
+	g_free (item->checksum_key);
+	g_free (item->duplicate);
+	g_free (item->index_key);
+	if (item->index_entry != NULL)
+		g_key_file_unref (item->index_entry);
+	if (item->error != NULL)
+		g_error_free (item->error);
+	g_free (item);
+}
+
 /**
  * cd_icc_store_find_by_filename:
  * @store: a #CdIccStore instance.
@@ -99,18 +198,14 @@ cd_icc_store_find_by_filename (CdIccStore *store, const gchar *filename)
 {
 	CdIccStorePrivate *priv = GET_PRIVATE (store);
 	CdIcc *tmp;
-	guint i;
-	GPtrArray *array = priv->icc_array;
 
 	g_return_val_if_fail (CD_IS_ICC_STORE (store), NULL);
 	g_return_val_if_fail (filename != NULL, NULL);
 
-	for (i = 0; i < array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		if (g_strcmp0 (filename, cd_icc_get_filename (tmp)) == 0)
-			return g_object_ref (tmp);
-	}
-	return NULL;
+	tmp = g_hash_table_lookup (priv->filename_hash, filename);
+	if (tmp == NULL)
+		return NULL;
+	return g_object_ref (tmp);
 }
 
 /**
@@ -129,34 +224,37 @@ cd_icc_store_find_by_checksum (CdIccStore *store, const gchar *checksum)
 {
 	CdIccStorePrivate *priv = GET_PRIVATE (store);
 	CdIcc *tmp;
-	guint i;
-	GPtrArray *array = priv->icc_array;
 
 	g_return_val_if_fail (CD_IS_ICC_STORE (store), NULL);
 	g_return_val_if_fail (checksum != NULL, NULL);
 
-	for (i = 0; i < array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		if (g_strcmp0 (checksum, cd_icc_get_checksum (tmp)) == 0)
-			return g_object_ref (tmp);
-	}
-	return NULL;
+	tmp = g_hash_table_lookup (priv->checksum_hash, checksum);
+	if (tmp == NULL)
+		return NULL;
+	return g_object_ref (tmp);
 }
 
 static CdIccStoreDirHelper *
 cd_icc_store_find_by_directory (CdIccStore *store, const gchar *path)
 {
 	CdIccStorePrivate *priv = GET_PRIVATE (store);
-	CdIccStoreDirHelper *tmp;
-	guint i;
-	GPtrArray *array = priv->directory_array;
+	return g_hash_table_lookup (priv->directory_hash, path);
+}
 
-	for (i = 0; i < array->len; i++) {
-		tmp = g_ptr_array_index (array, i);
-		if (g_strcmp0 (path, tmp->path) == 0)
-			return tmp;
-	}
-	return NULL;
+static void
+cd_icc_store_add_directory (CdIccStore *store, CdIccStoreDirHelper *helper)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_hash_table_insert (priv->directory_hash, g_strdup (helper->path), helper);
+	g_ptr_array_add (priv->directory_array, helper);
+}
+
+static void
+cd_icc_store_remove_directory (CdIccStore *store, CdIccStoreDirHelper *helper)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_hash_table_remove (priv->directory_hash, helper->path);
+	g_ptr_array_remove (priv->directory_array, helper);
 }
 
 static gboolean
@@ -175,30 +273,314 @@ cd_icc_store_remove_icc (CdIccStore *store, const gchar *filename)
 		g_warning ("failed to remove %s", filename);
 		return FALSE;
 	}
+	g_hash_table_remove (priv->filename_hash, filename);
+	if (cd_icc_get_checksum (icc) != NULL)
+		g_hash_table_remove (priv->checksum_hash, cd_icc_get_checksum (icc));
+
+	/* a profile with different contents may have been added for the
+	 * same filename, for instance if the file was replaced */
+	for (guint i = 0; i < priv->icc_array->len; i++) {
+		CdIcc *tmp = g_ptr_array_index (priv->icc_array, i);
+		if (g_strcmp0 (cd_icc_get_filename (tmp), filename) == 0) {
+			g_hash_table_insert (priv->filename_hash,
+					     g_strdup (filename), tmp);
+			break;
+		}
+	}
 
 	/* emit a signal */
+	priv->changes_cnt++;
 	g_signal_emit (store, signals[SIGNAL_REMOVED], 0, icc);
 	return TRUE;
 }
 
+static gchar *
+cd_icc_store_get_checksum_cache_key (const gchar *filename)
+{
+	GStatBuf st;
+	if (g_stat (filename, &st) != 0)
+		return NULL;
+	return g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+				(guint64) st.st_ino,
+				(gint64) st.st_mtime,
+				(gint64) st.st_size);
+}
+
 static gboolean
-cd_icc_store_add_icc (CdIccStore *store, GFile *file, GError **error)
+cd_icc_store_checksum_cache_save (CdIccStore *store, GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	GHashTableIter iter;
+	gpointer key, value;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	/* entries for profiles that have gone away are dropped */
+	g_hash_table_iter_init (&iter, priv->checksum_cache_used);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_key_file_set_string (kf, "checksums", key, value);
+	data = g_key_file_to_data (kf, NULL, error);
+	if (data == NULL)
+		return FALSE;
+	dirname = g_path_get_dirname (priv->checksum_cache_fn);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		return FALSE;
+	}
+	return g_file_set_contents (priv->checksum_cache_fn, data, -1, error);
+}
+
+static gboolean
+cd_icc_store_checksum_cache_save_cb (gpointer user_data)
+{
+	CdIccStore *store = CD_ICC_STORE (user_data);
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GError) error = NULL;
+
+	priv->checksum_cache_id = 0;
+	if (!cd_icc_store_checksum_cache_save (store, &error))
+		g_warning ("CdIccStore: failed to save checksum cache: %s", error->message);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_icc_store_index_copy_group (GKeyFile *src, GKeyFile *dest, const gchar *group)
+{
+	g_auto(GStrv) keys = NULL;
+
+	g_key_file_remove_group (dest, group, NULL);
+	keys = g_key_file_get_keys (src, group, NULL, NULL);
+	for (guint i = 0; keys != NULL && keys[i] != NULL; i++) {
+		g_autofree gchar *value = NULL;
+		value = g_key_file_get_value (src, group, keys[i], NULL);
+		if (value != NULL)
+			g_key_file_set_value (dest, group, keys[i], value);
+	}
+}
+
+static gboolean
+cd_icc_store_index_save (CdIccStore *store, GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autofree gchar *dirname = NULL;
+
+	/* entries for profiles that have gone away are dropped */
+	dirname = g_path_get_dirname (priv->index_fn);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		return FALSE;
+	}
+	return g_key_file_save_to_file (priv->index_used, priv->index_fn, error);
+}
+
+static gboolean
+cd_icc_store_index_save_cb (gpointer user_data)
+{
+	CdIccStore *store = CD_ICC_STORE (user_data);
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GError) error = NULL;
+
+	priv->index_id = 0;
+	if (!cd_icc_store_index_save (store, &error))
+		g_warning ("CdIccStore: failed to save index: %s", error->message);
+	return G_SOURCE_REMOVE;
+}
+
+/* the index only has what cd_icc_peek_data() provides, and the metadata */
+static gboolean
+cd_icc_store_index_is_usable (CdIccStore *store, const gchar *filename)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	if (priv->index == NULL || filename == NULL)
+		return FALSE;
+	if ((priv->load_flags & ~(CD_ICC_LOAD_FLAGS_METADATA |
+				  CD_ICC_LOAD_FLAGS_FALLBACK_MD5)) != 0)
+		return FALSE;
+	return strpbrk (filename, "[]\n") == NULL;
+}
+
+/* this is called from worker threads, so must not modify the store */
+static gboolean
+cd_icc_store_load_index (CdIccStore *store, CdIccStoreLoadItem *item)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	gboolean ret;
+	g_autofree gchar *key = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	item->index_key = cd_icc_store_get_checksum_cache_key (item->filename);
+	if (item->index_key == NULL)
+		return FALSE;
+
+	/* the file has changed since it was indexed */
+	locker = g_mutex_locker_new (&priv->index_mutex);
+	key = g_key_file_get_string (priv->index, item->filename, "Stat", NULL);
+	if (g_strcmp0 (key, item->index_key) != 0)
+		return FALSE;
+	if ((priv->load_flags & CD_ICC_LOAD_FLAGS_METADATA) > 0 &&
+	    !g_key_file_get_boolean (priv->index, item->filename, "HasMetadata", NULL))
+		return FALSE;
+	ret = cd_icc_load_from_index (item->icc, priv->index, item->filename, NULL);
+	return ret && cd_icc_get_checksum (item->icc) != NULL;
+}
+
+/* this is called from worker threads, so must not modify the store */
+static void
+cd_icc_store_index_entry_new (CdIccStore *store, CdIccStoreLoadItem *item)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+
+	if (item->index_key == NULL || cd_icc_get_checksum (item->icc) == NULL)
+		return;
+	item->index_entry = g_key_file_new ();
+	cd_icc_save_to_index (item->icc, item->index_entry, item->filename);
+	g_key_file_set_string (item->index_entry, item->filename, "Stat", item->index_key);
+	g_key_file_set_boolean (item->index_entry, item->filename, "HasMetadata",
+				(priv->load_flags & CD_ICC_LOAD_FLAGS_METADATA) > 0);
+}
+
+/* this is called from worker threads, so must not modify the store */
+static gboolean
+cd_icc_store_load_file (CdIccStore *store,
+			CdIccStoreLoadItem *item,
+			GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	const gchar *checksum;
+
+	/* no cache */
+	if (priv->checksum_cache == NULL || item->filename == NULL)
+		return cd_icc_load_file (item->icc, item->file, priv->load_flags, NULL, error);
+
+	/* we already know the checksum from the last time */
+	if (item->checksum_key == NULL)
+		item->checksum_key = cd_icc_store_get_checksum_cache_key (item->filename);
+	checksum = item->checksum_key != NULL ?
+		g_hash_table_lookup (priv->checksum_cache, item->checksum_key) : NULL;
+	if (checksum != NULL) {
+		if (!cd_icc_load_file (item->icc,
+				       item->file,
+				       priv->load_flags & ~CD_ICC_LOAD_FLAGS_FALLBACK_MD5,
+				       NULL,
+				       error))
+			return FALSE;
+		if (cd_icc_get_checksum (item->icc) == NULL)
+			cd_icc_set_checksum (item->icc, checksum);
+		item->checksum_cached = TRUE;
+		return TRUE;
+	}
+	return cd_icc_load_file (item->icc, item->file, priv->load_flags, NULL, error);
+}
+
+/* the profile ID is an MD5 of the profile contents, so a bundled profile
+ * with an ID is the same as the file if the headers are the same */
+static gboolean
+cd_icc_store_bundle_check_header (const gchar *filename, GBytes *data)
+{
+	const guint8 *header = g_bytes_get_data (data, NULL);
+	guint8 buf[CD_ICC_STORE_HEADER_SIZE];
+	gsize len = 0;
+	gboolean has_id = FALSE;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileInputStream) stream = NULL;
+
+	if (g_bytes_get_size (data) < CD_ICC_STORE_HEADER_SIZE)
+		return FALSE;
+	for (guint i = 0; i < CD_ICC_STORE_PROFILE_ID_SIZE; i++) {
+		if (header[CD_ICC_STORE_PROFILE_ID_OFFSET + i] != 0) {
+			has_id = TRUE;
+			break;
+		}
+	}
+	if (!has_id)
+		return FALSE;
+	file = g_file_new_for_path (filename);
+	stream = g_file_read (file, NULL, NULL);
+	if (stream == NULL)
+		return FALSE;
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream), buf, sizeof (buf),
+				      &len, NULL, NULL))
+		return FALSE;
+	if (len != sizeof (buf))
+		return FALSE;
+	return memcmp (buf, header, sizeof (buf)) == 0;
+}
+
+/* this is called from worker threads, so must not modify the store */
+static GBytes *
+cd_icc_store_bundle_lookup (CdIccStore *store, const gchar *filename)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	GStatBuf stat_buf;
+	g_autofree gchar *cache_key = NULL;
+
+	if (priv->bundles->len == 0)
+		return NULL;
+	cache_key = g_build_filename (CD_ICC_STORE_BUNDLE_PREFIX, filename, NULL);
+	for (guint i = 0; i < priv->bundles->len; i++) {
+		CdIccStoreBundle *bundle = g_ptr_array_index (priv->bundles, i);
+		gsize size = 0;
+		g_autoptr(GBytes) data = NULL;
+
+		if (!g_resource_get_info (bundle->resource,
+					  cache_key,
+					  G_RESOURCE_LOOKUP_FLAGS_NONE,
+					  &size, NULL, NULL))
+			continue;
+
+		/* the file has been changed since the bundle was made */
+		if (g_stat (filename, &stat_buf) != 0)
+			continue;
+		if ((gsize) stat_buf.st_size != size ||
+		    (gint64) stat_buf.st_mtime > bundle->mtime) {
+			g_debug ("CdIccStore: %s is newer than %s",
+				 filename, bundle->filename);
+			continue;
+		}
+		data = g_resource_lookup_data (bundle->resource,
+					       cache_key,
+					       G_RESOURCE_LOOKUP_FLAGS_NONE,
+					       NULL);
+		if (data == NULL)
+			continue;
+
+		/* the same size and age is not enough */
+		if (!cd_icc_store_bundle_check_header (filename, data)) {
+			g_debug ("CdIccStore: %s does not match %s",
+				 filename, bundle->filename);
+			continue;
+		}
+		return g_steal_pointer (&data);
+	}
+	return NULL;
+}
+
+/* this is called from worker threads, so must not modify the store */
+static void
+cd_icc_store_load_item_parse (CdIccStore *store, CdIccStoreLoadItem *item)
 {
 	CdIccStorePrivate *priv = GET_PRIVATE (store);
 	g_autoptr(GBytes) data = NULL;
-	g_autofree gchar *filename = NULL;
-	g_autoptr(CdIcc) icc = NULL;
-	g_autoptr(CdIcc) icc_tmp = NULL;
+
+	/* a copy of a profile that will already have been added */
+	if (item->duplicate != NULL)
+		return;
 
 	/* use the GResource cache if available */
-	icc = cd_icc_new ();
-	filename = g_file_get_path (file);
+	item->icc = cd_icc_new ();
 	if (priv->cache != NULL) {
-		if (g_str_has_prefix (filename, "/usr/share/color/icc/colord/")) {
+		if (g_str_has_prefix (item->filename, "/usr/share/color/icc/colord/")) {
 			g_autofree gchar *cache_key = NULL;
 			cache_key = g_build_filename ("/org/freedesktop/colord",
 						      "profiles",
-						      filename + 28,
+						      item->filename + 28,
 						      NULL);
 			data = g_resource_lookup_data (priv->cache,
 						       cache_key,
@@ -206,28 +588,118 @@ cd_icc_store_add_icc (CdIccStore *store, GFile *file, GError **error)
 						       NULL);
 		}
 	}
+	if (data == NULL)
+		data = cd_icc_store_bundle_lookup (store, item->filename);
 
 	/* parse new icc object */
 	if (data != NULL) {
 		g_autofree gchar *basename = NULL;
-		basename = g_path_get_basename (filename);
+		basename = g_path_get_basename (item->filename);
 		g_debug ("Using built-in %s", basename);
-		cd_icc_set_filename (icc, filename);
-		if (!cd_icc_load_data (icc,
+		cd_icc_set_filename (item->icc, item->filename);
+		if (!cd_icc_load_data (item->icc,
 					g_bytes_get_data (data, NULL),
 					g_bytes_get_size (data),
 					CD_ICC_LOAD_FLAGS_METADATA,
-					error)) {
-			return FALSE;
+					&item->error)) {
+			g_clear_object (&item->icc);
+		}
+	} else if (cd_icc_store_index_is_usable (store, item->filename)) {
+		if (cd_icc_store_load_index (store, item))
+			return;
+		g_clear_object (&item->icc);
+		item->icc = cd_icc_new ();
+		if (!cd_icc_store_load_file (store, item, &item->error)) {
+			g_clear_object (&item->icc);
+			return;
 		}
+		cd_icc_store_index_entry_new (store, item);
 	} else {
-		if (!cd_icc_load_file (icc,
-					file,
-					priv->load_flags,
-					NULL,
-					error)) {
-			return FALSE;
+		if (!cd_icc_store_load_file (store, item, &item->error))
+			g_clear_object (&item->icc);
+	}
+}
+
+static void
+cd_icc_store_load_item (CdIccStore *store, CdIccStoreLoadItem *item)
+{
+	CD_TRACE1 (icc_store_load_begin, item->filename);
+	cd_icc_store_load_item_parse (store, item);
+	CD_TRACE2 (icc_store_load_end, item->filename, item->icc != NULL);
+}
+
+static gboolean
+cd_icc_store_add_item (CdIccStore *store, CdIccStoreLoadItem *item, GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	CdIcc *icc;
+	g_autoptr(CdIcc) icc_tmp = NULL;
+
+	/* skipped by the search, so only costs a lookup */
+	if (item->duplicate != NULL) {
+		icc_tmp = cd_icc_store_find_by_checksum (store, item->duplicate);
+		if (icc_tmp != NULL) {
+			g_debug ("CdIccStore: not loading %s as profile %s "
+				 "already exists with the same checksum of %s",
+				 item->filename,
+				 cd_icc_get_filename (icc_tmp),
+				 item->duplicate);
+			if (item->checksum_key != NULL) {
+				g_hash_table_insert (priv->checksum_cache_used,
+						     g_steal_pointer (&item->checksum_key),
+						     g_steal_pointer (&item->duplicate));
+			}
+			return TRUE;
+		}
+
+		/* the earlier copy failed to load, so this one has to */
+		g_clear_pointer (&item->duplicate, g_free);
+		cd_icc_store_load_item (store, item);
+	}
+	icc = item->icc;
+
+	/* failed to parse */
+	if (icc == NULL) {
+		g_propagate_error (error, g_steal_pointer (&item->error));
+		return FALSE;
+	}
+
+	/* write the checksum cache in one go once the burst of new files is over */
+	if (priv->checksum_cache != NULL &&
+	    item->checksum_key != NULL &&
+	    cd_icc_get_checksum (icc) != NULL) {
+		g_hash_table_insert (priv->checksum_cache_used,
+				     g_steal_pointer (&item->checksum_key),
+				     g_strdup (cd_icc_get_checksum (icc)));
+		if (!item->checksum_cached) {
+			if (priv->checksum_cache_id != 0)
+				g_source_remove (priv->checksum_cache_id);
+			priv->checksum_cache_id =
+				g_timeout_add_seconds (CD_ICC_STORE_CHECKSUM_CACHE_DELAY,
+						       cd_icc_store_checksum_cache_save_cb,
+						       store);
+		}
+	}
+
+	/* remember the entry, and write the index once the burst of new
+	 * files is over */
+	if (priv->index != NULL && item->index_key != NULL) {
+		g_mutex_lock (&priv->index_mutex);
+		if (item->index_entry != NULL) {
+			cd_icc_store_index_copy_group (item->index_entry,
+						       priv->index_used,
+						       item->filename);
+			if (priv->index_id != 0)
+				g_source_remove (priv->index_id);
+			priv->index_id = g_timeout_add_seconds (CD_ICC_STORE_INDEX_DELAY,
+								cd_icc_store_index_save_cb,
+								store);
+		} else if (g_key_file_has_group (priv->index, item->filename)) {
+			cd_icc_store_index_copy_group (priv->index,
+						       priv->index_used,
+						       item->filename);
 		}
+		g_mutex_unlock (&priv->index_mutex);
 	}
 
 	/* check it's not a duplicate */
@@ -235,7 +707,7 @@ cd_icc_store_add_icc (CdIccStore *store, GFile *file, GError **error)
 	if (icc_tmp != NULL) {
 		g_debug ("CdIccStore: Failed to add %s as profile %s "
 			 "already exists with the same checksum of %s",
-			 filename,
+			 item->filename,
 			 cd_icc_get_filename (icc_tmp),
 			 cd_icc_get_checksum (icc_tmp));
 		return TRUE;
@@ -243,34 +715,162 @@ cd_icc_store_add_icc (CdIccStore *store, GFile *file, GError **error)
 
 	/* add to list */
 	g_ptr_array_add (priv->icc_array, g_object_ref (icc));
+	if (!g_hash_table_contains (priv->filename_hash, cd_icc_get_filename (icc))) {
+		g_hash_table_insert (priv->filename_hash,
+				     g_strdup (cd_icc_get_filename (icc)), icc);
+	}
+	if (cd_icc_get_checksum (icc) != NULL) {
+		g_hash_table_insert (priv->checksum_hash,
+				     g_strdup (cd_icc_get_checksum (icc)), icc);
+	}
 
 	/* emit a signal */
+	priv->changes_cnt++;
+	CD_TRACE1 (icc_store_add_begin, item->filename);
 	g_signal_emit (store, signals[SIGNAL_ADDED], 0, icc);
+	CD_TRACE1 (icc_store_add_end, item->filename);
+
+	/* the handlers have taken what they need */
+	if (priv->metadata_only)
+		cd_icc_release_handle (icc);
 	return TRUE;
 }
 
+typedef struct {
+	CdIccStore	*store;
+	GAsyncQueue	*done;
+} CdIccStoreLoadHelper;
+
 static void
-cd_icc_store_created_query_info_cb (GObject *source_object,
-				    GAsyncResult *res,
-				    gpointer user_data)
+cd_icc_store_load_thread_cb (gpointer data, gpointer user_data)
 {
-	CdIccStore *store = CD_ICC_STORE (user_data);
-	GFile *file = G_FILE (source_object);
-	gboolean ret;
-	g_autoptr(GError) error = NULL;
-	g_autofree gchar *path = NULL;
-	g_autoptr(GFileInfo) info = NULL;
-	g_autoptr(GFile) parent = NULL;
+	CdIccStoreLoadItem *item = (CdIccStoreLoadItem *) data;
+	CdIccStoreLoadHelper *helper = (CdIccStoreLoadHelper *) user_data;
+	cd_icc_store_load_item (helper->store, item);
+	g_async_queue_push (helper->done, item);
+}
 
-	info = g_file_query_info_finish (file, res, NULL);
-	if (info == NULL)
+/* parses all the files found by the search in parallel, and then adds them
+ * in the order they were found so that duplicates are handled the same way
+ * each time */
+static gboolean
+cd_icc_store_add_item_safe (CdIccStore *store,
+			    CdIccStoreLoadItem *item,
+			    gboolean stop_on_error,
+			    GError **error)
+{
+	g_autoptr(GError) error_local = NULL;
+
+	if (stop_on_error)
+		return cd_icc_store_add_item (store, item, error);
+	if (!cd_icc_store_add_item (store, item, &error_local))
+		g_warning ("failed to add %s: %s", item->filename, error_local->message);
+	return TRUE;
+}
+
+/* uses the checksum from the last time the file was seen, so that copies of
+ * a profile in another location cost a stat rather than a parse */
+static void
+cd_icc_store_load_pending_dedupe (CdIccStore *store, GPtrArray *pending)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GHashTable) seen = NULL;
+
+	if (priv->checksum_cache == NULL)
 		return;
-	parent = g_file_get_parent (file);
-	path = g_file_get_path (parent);
-	ret = cd_icc_store_search_path_child (store, path, info,
-					      0, NULL, &error);
-	if (!ret)
-		g_warning ("failed to search file: %s", error->message);
+	seen = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < pending->len; i++) {
+		CdIccStoreLoadItem *item = g_ptr_array_index (pending, i);
+		const gchar *checksum;
+
+		if (item->filename == NULL)
+			continue;
+		item->checksum_key = cd_icc_store_get_checksum_cache_key (item->filename);
+		if (item->checksum_key == NULL)
+			continue;
+		checksum = g_hash_table_lookup (priv->checksum_cache, item->checksum_key);
+		if (checksum == NULL)
+			continue;
+		item->checksum_cached = TRUE;
+
+		/* items are added in order, so the first copy always wins */
+		if (g_hash_table_contains (priv->checksum_hash, checksum) ||
+		    !g_hash_table_add (seen, (gpointer) checksum))
+			item->duplicate = g_strdup (checksum);
+	}
+}
+
+static gboolean
+cd_icc_store_load_pending (CdIccStore *store, gboolean stop_on_error, GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	CdIccStoreLoadHelper helper;
+	CdIccStoreLoadItem *item;
+	GThreadPool *pool = NULL;
+	gboolean ret = TRUE;
+	guint i;
+	guint n_done = 0;
+	guint n_added = 0;
+	guint n_threads;
+	g_autoptr(GPtrArray) pending = NULL;
+
+	/* the search may be re-entered from a signal handler */
+	pending = g_steal_pointer (&priv->pending);
+	priv->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_icc_store_load_item_free);
+	if (pending->len == 0)
+		return TRUE;
+	cd_icc_store_load_pending_dedupe (store, pending);
+
+	/* not worth using threads */
+	n_threads = MIN (g_get_num_processors (), CD_ICC_STORE_LOAD_THREADS_MAX);
+	if (pending->len > 1 && n_threads > 1) {
+		helper.store = store;
+		helper.done = g_async_queue_new ();
+		pool = g_thread_pool_new (cd_icc_store_load_thread_cb,
+					  &helper, n_threads, FALSE, NULL);
+	}
+	if (pool == NULL) {
+		for (i = 0; i < pending->len; i++) {
+			item = g_ptr_array_index (pending, i);
+			cd_icc_store_load_item (store, item);
+			if (!cd_icc_store_add_item_safe (store, item, stop_on_error, error))
+				return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* add each batch of profiles as soon as the ones before it are done */
+	for (i = 0; i < pending->len; i++)
+		g_thread_pool_push (pool, g_ptr_array_index (pending, i), NULL);
+	while (n_done < pending->len) {
+		item = g_async_queue_pop (helper.done);
+		item->done = TRUE;
+		n_done++;
+		while (ret && n_added < pending->len) {
+			item = g_ptr_array_index (pending, n_added);
+			if (!item->done)
+				break;
+			ret = cd_icc_store_add_item_safe (store, item, stop_on_error, error);
+			n_added++;
+		}
+
+		/* stop on the first failure, as the search would have */
+		if (!ret)
+			break;
+	}
+	g_thread_pool_free (pool, TRUE, TRUE);
+	g_async_queue_unref (helper.done);
+	return ret;
+}
+
+static gboolean
+cd_icc_store_add_icc (CdIccStore *store, GFile *file, GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+
+	/* parsed once the search has finished */
+	g_ptr_array_add (priv->pending, cd_icc_store_load_item_new (file));
+	return TRUE;
 }
 
 static void
@@ -280,14 +880,118 @@ cd_icc_store_remove_from_prefix (CdIccStore *store, const gchar *prefix)
 	CdIcc *tmp;
 	const gchar *filename;
 	guint i;
+	g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
 
+	/* removing modifies the array */
 	for (i = 0; i < priv->icc_array->len; i++) {
 		tmp = g_ptr_array_index (priv->icc_array, i);
 		filename = cd_icc_get_filename (tmp);
-		if (g_str_has_prefix (filename, prefix)) {
-			g_debug ("auto-removed %s as path removed", prefix);
-			cd_icc_store_remove_icc (store, filename);
-		}
+		if (g_str_has_prefix (filename, prefix))
+			g_ptr_array_add (filenames, g_strdup (filename));
+	}
+	for (i = 0; i < filenames->len; i++) {
+		g_debug ("auto-removed %s as path removed", prefix);
+		cd_icc_store_remove_icc (store, g_ptr_array_index (filenames, i));
+	}
+}
+
+static void
+cd_icc_store_remove_path (CdIccStore *store, const gchar *path)
+{
+	CdIccStoreDirHelper *helper;
+	g_autoptr(CdIcc) tmp = NULL;
+
+	/* we can either have two things here, a directory or a
+	 * file. We can't call g_file_query_info() as the
+	 * inode doesn't exist anymore */
+	tmp = cd_icc_store_find_by_filename (store, path);
+	if (tmp != NULL) {
+		/* is a file */
+		cd_icc_store_remove_icc (store, path);
+		return;
+	}
+
+	/* is a directory, urgh. Remove all ICCs there. */
+	cd_icc_store_remove_from_prefix (store, path);
+	helper = cd_icc_store_find_by_directory (store, path);
+	if (helper != NULL)
+		cd_icc_store_remove_directory (store, helper);
+}
+
+static void
+cd_icc_store_add_path (CdIccStore *store, const gchar *path)
+{
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *parent = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	g_autoptr(GFileInfo) info = NULL;
+
+	/* it may have gone again already */
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_NAME ","
+				  G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+				  G_FILE_ATTRIBUTE_STANDARD_TYPE,
+				  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+				  NULL,
+				  NULL);
+	if (info == NULL)
+		return;
+	parent = g_path_get_dirname (path);
+	if (!cd_icc_store_search_path_child (store, parent, info, 0, NULL, &error))
+		g_warning ("failed to search file: %s", error->message);
+}
+
+static gboolean
+cd_icc_store_changes_cb (gpointer user_data)
+{
+	CdIccStore *store = CD_ICC_STORE (user_data);
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	GList *l;
+	guint changes_cnt = priv->changes_cnt;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) changes = NULL;
+	g_autoptr(GList) paths = NULL;
+
+	/* new events go into the next batch */
+	priv->changes_id = 0;
+	changes = g_steal_pointer (&priv->changes);
+	priv->changes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	paths = g_list_sort (g_hash_table_get_keys (changes), (GCompareFunc) g_strcmp0);
+
+	/* removals first, so that replaced files get added again */
+	for (l = paths; l != NULL; l = l->next) {
+		CdIccStoreChange change = GPOINTER_TO_UINT (g_hash_table_lookup (changes, l->data));
+		if (change & CD_ICC_STORE_CHANGE_DELETED)
+			cd_icc_store_remove_path (store, l->data);
+	}
+	for (l = paths; l != NULL; l = l->next) {
+		CdIccStoreChange change = GPOINTER_TO_UINT (g_hash_table_lookup (changes, l->data));
+		if (change & CD_ICC_STORE_CHANGE_CREATED)
+			cd_icc_store_add_path (store, l->data);
+	}
+
+	/* parse everything that was found in one go */
+	if (!cd_icc_store_load_pending (store, FALSE, &error))
+		g_warning ("failed to load profiles: %s", error->message);
+	if (priv->changes_cnt != changes_cnt)
+		g_signal_emit (store, signals[SIGNAL_CHANGED], 0);
+	return G_SOURCE_REMOVE;
+}
+
+/* deal with everything that happens in a short window at once */
+static void
+cd_icc_store_queue_change (CdIccStore *store, gchar *path, CdIccStoreChange change)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+
+	/* a creation after a deletion is a replacement */
+	if (change == CD_ICC_STORE_CHANGE_CREATED)
+		change |= GPOINTER_TO_UINT (g_hash_table_lookup (priv->changes, path));
+	g_hash_table_insert (priv->changes, path, GUINT_TO_POINTER (change));
+	if (priv->changes_id == 0) {
+		priv->changes_id = g_timeout_add (CD_ICC_STORE_CHANGES_DELAY,
+						  cd_icc_store_changes_cb,
+						  store);
 	}
 }
 
@@ -298,57 +1002,147 @@ cd_icc_store_file_monitor_changed_cb (GFileMonitor *monitor,
 				      GFileMonitorEvent event_type,
 				      CdIccStore *store)
 {
-	CdIccStorePrivate *priv = GET_PRIVATE (store);
-	CdIcc *tmp;
-	CdIccStoreDirHelper *helper;
+	CdIccStoreChange change;
 	g_autofree gchar *path = NULL;
 
-	/* icc was deleted */
+	path = g_file_get_path (file);
+	if (path == NULL)
+		return;
+
+	/* icc was deleted, which cancels out any earlier creation */
 	if (event_type == G_FILE_MONITOR_EVENT_DELETED) {
+		change = CD_ICC_STORE_CHANGE_DELETED;
 
-		/* we can either have two things here, a directory or a
-		 * file. We can't call g_file_query_info_async() as the
-		 * inode doesn't exist anymore */
-		path = g_file_get_path (file);
-		tmp = cd_icc_store_find_by_filename (store, path);
-		if (tmp != NULL) {
-			/* is a file */
-			cd_icc_store_remove_icc (store, path);
+	/* only care about created objects */
+	} else if (event_type == G_FILE_MONITOR_EVENT_CREATED) {
+		/* ignore temp files */
+		if (g_strrstr (path, ".goutputstream") != NULL) {
+			g_debug ("ignoring gvfs temporary file");
 			return;
 		}
-
-		/* is a directory, urgh. Remove all ICCs there. */
-		cd_icc_store_remove_from_prefix (store, path);
-		helper = cd_icc_store_find_by_directory (store, path);
-		if (helper != NULL) {
-			g_ptr_array_remove (priv->directory_array,
-					    helper);
-		}
+		change = CD_ICC_STORE_CHANGE_CREATED;
+	} else {
 		return;
 	}
 
-	/* ignore temp files */
-	path = g_file_get_path (file);
-	if (g_strrstr (path, ".goutputstream") != NULL) {
-		g_debug ("ignoring gvfs temporary file");
+	cd_icc_store_queue_change (store, g_steal_pointer (&path), change);
+}
+
+/* seconds are too coarse, as a sweep can happen just after a change */
+static gboolean
+cd_icc_store_get_mtime (const gchar *path, guint64 *mtime)
+{
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	g_autoptr(GFileInfo) info = NULL;
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+				  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+				  NULL,
+				  NULL);
+	if (info == NULL)
+		return FALSE;
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		 g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	return TRUE;
+}
+
+/* finds what changed in a directory that has no monitor of its own */
+static void
+cd_icc_store_sweep_directory (CdIccStore *store, CdIccStoreDirHelper *helper)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	const gchar *fn;
+	guint64 mtime = 0;
+	guint i;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GHashTable) present = NULL;
+
+	if (!cd_icc_store_get_mtime (helper->path, &mtime)) {
+		cd_icc_store_queue_change (store, g_strdup (helper->path),
+					   CD_ICC_STORE_CHANGE_DELETED);
 		return;
 	}
 
-	/* only care about created objects */
-	if (event_type == G_FILE_MONITOR_EVENT_CREATED) {
-		g_file_query_info_async (file,
-					 G_FILE_ATTRIBUTE_STANDARD_NAME ","
-					 G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
-					 G_FILE_ATTRIBUTE_STANDARD_TYPE,
-					 G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-					 G_PRIORITY_LOW,
-					 NULL,
-					 cd_icc_store_created_query_info_cb,
-					 store);
+	/* adding, removing or renaming an entry changes the mtime */
+	if (mtime == helper->mtime)
+		return;
+	helper->mtime = mtime;
+	dir = g_dir_open (helper->path, 0, NULL);
+	if (dir == NULL)
 		return;
+	present = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		gchar *path = g_build_filename (helper->path, fn, NULL);
+		if (!g_hash_table_contains (priv->filename_hash, path) &&
+		    cd_icc_store_find_by_directory (store, path) == NULL) {
+			cd_icc_store_queue_change (store, g_strdup (path),
+						   CD_ICC_STORE_CHANGE_CREATED);
+		}
+		g_hash_table_add (present, path);
+	}
+
+	/* anything that was here before and has gone */
+	for (i = 0; i < priv->icc_array->len; i++) {
+		CdIcc *icc = g_ptr_array_index (priv->icc_array, i);
+		const gchar *filename = cd_icc_get_filename (icc);
+		g_autofree gchar *dirname = g_path_get_dirname (filename);
+		if (g_strcmp0 (dirname, helper->path) == 0 &&
+		    !g_hash_table_contains (present, filename)) {
+			cd_icc_store_queue_change (store, g_strdup (filename),
+						   CD_ICC_STORE_CHANGE_DELETED);
+		}
+	}
+	for (i = 0; i < priv->directory_array->len; i++) {
+		CdIccStoreDirHelper *tmp = g_ptr_array_index (priv->directory_array, i);
+		g_autofree gchar *dirname = g_path_get_dirname (tmp->path);
+		if (g_strcmp0 (dirname, helper->path) == 0 &&
+		    !g_hash_table_contains (present, tmp->path)) {
+			cd_icc_store_queue_change (store, g_strdup (tmp->path),
+						   CD_ICC_STORE_CHANGE_DELETED);
+		}
 	}
 }
 
+static gboolean
+cd_icc_store_sweep_cb (gpointer user_data)
+{
+	CdIccStore *store = CD_ICC_STORE (user_data);
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	for (guint i = 0; i < priv->directory_array->len; i++) {
+		CdIccStoreDirHelper *helper = g_ptr_array_index (priv->directory_array, i);
+		if (helper->monitor == NULL)
+			cd_icc_store_sweep_directory (store, helper);
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+cd_icc_store_is_cold_root (CdIccStore *store, const gchar *path)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	for (guint i = 0; i < priv->cold_roots->len; i++) {
+		if (g_strcmp0 (g_ptr_array_index (priv->cold_roots, i), path) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* TRUE if @path is below a location searched with %CD_ICC_STORE_SEARCH_FLAGS_COLD */
+static gboolean
+cd_icc_store_is_cold (CdIccStore *store, const gchar *path)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	for (guint i = 0; i < priv->cold_roots->len; i++) {
+		const gchar *root = g_ptr_array_index (priv->cold_roots, i);
+		gsize len = strlen (root);
+		if (strncmp (path, root, len) == 0 && path[len] == G_DIR_SEPARATOR)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 static gboolean
 cd_icc_store_search_path_child (CdIccStore *store,
 				const gchar *path,
@@ -398,7 +1192,6 @@ cd_icc_store_search_path (CdIccStore *store,
 			  GCancellable *cancellable,
 			  GError **error)
 {
-	CdIccStorePrivate *priv = GET_PRIVATE (store);
 	CdIccStoreDirHelper *helper;
 	GError *error_local = NULL;
 	gboolean ret = TRUE;
@@ -416,10 +1209,17 @@ cd_icc_store_search_path (CdIccStore *store,
 		return FALSE;
 	}
 
-	/* add an inotify watch if not already added */
+	/* add an inotify watch if not already added, but directories in
+	 * cold locations are only swept to save watches */
 	file = g_file_new_for_path (path);
 	helper = cd_icc_store_find_by_directory (store, path);
-	if (helper == NULL) {
+	if (helper == NULL && cd_icc_store_is_cold (store, path)) {
+		helper = g_new0 (CdIccStoreDirHelper, 1);
+		helper->path = g_strdup (path);
+		if (!cd_icc_store_get_mtime (path, &helper->mtime))
+			helper->mtime = 0;
+		cd_icc_store_add_directory (store, helper);
+	} else if (helper == NULL) {
 		helper = g_new0 (CdIccStoreDirHelper, 1);
 		helper->path = g_strdup (path);
 		helper->monitor = g_file_monitor_directory (file,
@@ -433,7 +1233,7 @@ cd_icc_store_search_path (CdIccStore *store,
 		g_signal_connect (helper->monitor, "changed",
 				  G_CALLBACK(cd_icc_store_file_monitor_changed_cb),
 				  store);
-		g_ptr_array_add (priv->directory_array, helper);
+		cd_icc_store_add_directory (store, helper);
 	}
 
 	/* get contents of directory */
@@ -447,7 +1247,7 @@ cd_icc_store_search_path (CdIccStore *store,
 	if (enumerator == NULL) {
 		helper = cd_icc_store_find_by_directory (store, path);
 		if (helper != NULL)
-			g_ptr_array_remove (priv->directory_array, helper);
+			cd_icc_store_remove_directory (store, helper);
 		return FALSE;
 	}
 
@@ -495,6 +1295,45 @@ cd_icc_store_set_load_flags (CdIccStore *store, CdIccLoadFlags load_flags)
 	priv->load_flags = load_flags | CD_ICC_LOAD_FLAGS_FALLBACK_MD5;
 }
 
+/**
+ * cd_icc_store_set_metadata_only:
+ * @store: a #CdIccStore instance.
+ * @metadata_only: %TRUE to release the decoded profile data
+ *
+ * Sets if the lcms profile of each newly added profile should be released
+ * once the ::added signal has been emitted, keeping only the header,
+ * description, metadata, tags and warnings. This saves a lot of memory
+ * for large LUT-based profiles. Anything that needs the profile data
+ * again transparently reloads it from the file.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_icc_store_set_metadata_only (CdIccStore *store, gboolean metadata_only)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_return_if_fail (CD_IS_ICC_STORE (store));
+	priv->metadata_only = metadata_only;
+}
+
+/**
+ * cd_icc_store_get_metadata_only:
+ * @store: a #CdIccStore instance.
+ *
+ * Gets if the lcms profile is released after profiles are added.
+ *
+ * Return value: %TRUE if only the metadata is kept
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_store_get_metadata_only (CdIccStore *store)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_return_val_if_fail (CD_IS_ICC_STORE (store), FALSE);
+	return priv->metadata_only;
+}
+
 /**
  * cd_icc_store_get_load_flags:
  * @store: a #CdIccStore instance.
@@ -513,6 +1352,27 @@ cd_icc_store_get_load_flags (CdIccStore *store)
 	return priv->load_flags;
 }
 
+/**
+ * cd_icc_store_set_sweep_interval:
+ * @store: a #CdIccStore instance.
+ * @sweep_interval: the interval in seconds
+ *
+ * Sets how often the directories below locations searched with
+ * %CD_ICC_STORE_SEARCH_FLAGS_COLD are checked for changes. The default is
+ * once a minute. This function should be called before any locations are
+ * searched.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_icc_store_set_sweep_interval (CdIccStore *store, guint sweep_interval)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_return_if_fail (CD_IS_ICC_STORE (store));
+	g_return_if_fail (sweep_interval > 0);
+	priv->sweep_interval = sweep_interval;
+}
+
 /**
  * cd_icc_store_set_cache:
  * @store: a #CdIccStore instance.
@@ -532,6 +1392,168 @@ cd_icc_store_set_cache (CdIccStore *store, GResource *cache)
 	priv->cache = g_resource_ref (cache);
 }
 
+/**
+ * cd_icc_store_add_cache_file:
+ * @store: a #CdIccStore instance.
+ * @filename: a GResource bundle filename
+ * @error: A #GError or %NULL
+ *
+ * Adds a bundle of profiles to use when reading profiles, so that a large
+ * number of profiles can be read from one mapped file rather than from
+ * each file in turn.
+ *
+ * The bundle is made using glib-compile-resources, where each profile is
+ * found at its absolute filename below `/org/freedesktop/colord/bundle`.
+ * The files can be compressed, and cd-create-bundle can be used to make
+ * the bundle. A profile in the bundle is only used if it has a profile
+ * ID, which is an MD5 checksum of the contents, and the file on disk has
+ * the same header, is the same size and is not newer than the bundle
+ * itself. Only the header of the file on disk is read in that case, and
+ * the file is read as normal otherwise.
+ *
+ * This function should be called before any locations are searched.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_store_add_cache_file (CdIccStore *store,
+			     const gchar *filename,
+			     GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	CdIccStoreBundle *bundle;
+	GResource *resource;
+	GStatBuf stat_buf;
+
+	g_return_val_if_fail (CD_IS_ICC_STORE (store), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (g_stat (filename, &stat_buf) != 0) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_OPEN,
+			     "failed to get info about %s",
+			     filename);
+		return FALSE;
+	}
+	resource = g_resource_load (filename, error);
+	if (resource == NULL)
+		return FALSE;
+	bundle = g_new0 (CdIccStoreBundle, 1);
+	bundle->resource = resource;
+	bundle->filename = g_strdup (filename);
+	bundle->mtime = stat_buf.st_mtime;
+	g_ptr_array_add (priv->bundles, bundle);
+	return TRUE;
+}
+
+/**
+ * cd_icc_store_set_checksum_cache:
+ * @store: a #CdIccStore instance.
+ * @filename: a filename for the cache
+ * @error: A #GError or %NULL
+ *
+ * Sets a file to remember the checksums of profiles that do not have an
+ * embedded profile ID, so that they do not have to be computed each time.
+ * The checksums are looked up by the inode, modification time and size of
+ * the profile, so any change to the file will cause it to be re-hashed.
+ * This function can only be called once, and should be called before any
+ * locations are searched.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_store_set_checksum_cache (CdIccStore *store,
+				 const gchar *filename,
+				 GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_auto(GStrv) keys = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	g_return_val_if_fail (CD_IS_ICC_STORE (store), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (priv->checksum_cache == NULL, FALSE);
+
+	priv->checksum_cache_fn = g_strdup (filename);
+	priv->checksum_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, g_free);
+	priv->checksum_cache_used = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, g_free);
+
+	/* a missing cache is fine */
+	if (!g_key_file_load_from_file (kf, filename, G_KEY_FILE_NONE, &error_local)) {
+		if (g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			return TRUE;
+		g_propagate_error (error, g_steal_pointer (&error_local));
+		return FALSE;
+	}
+	keys = g_key_file_get_keys (kf, "checksums", NULL, NULL);
+	for (guint i = 0; keys != NULL && keys[i] != NULL; i++) {
+		gchar *value = g_key_file_get_string (kf, "checksums", keys[i], NULL);
+		if (value == NULL)
+			continue;
+		g_hash_table_insert (priv->checksum_cache, g_strdup (keys[i]), value);
+	}
+	g_debug ("CdIccStore: loaded %u cached checksums",
+		 g_hash_table_size (priv->checksum_cache));
+	return TRUE;
+}
+
+/**
+ * cd_icc_store_set_index:
+ * @store: a #CdIccStore instance.
+ * @filename: a filename for the index
+ * @error: A #GError or %NULL
+ *
+ * Sets a file to remember the details of each profile that has been added,
+ * so that profiles that have not changed since the last time can be added
+ * without reading them at all. The profiles are matched using the inode,
+ * modification time and size of the file.
+ *
+ * Profiles added from the index behave as if cd_icc_peek_data() had been
+ * used to load them, although the tags and warnings are also available.
+ * The index is not used if the load flags need anything other than
+ * %CD_ICC_LOAD_FLAGS_METADATA.
+ *
+ * This function can only be called once, and should be called before any
+ * locations are searched.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_store_set_index (CdIccStore *store,
+			const gchar *filename,
+			GError **error)
+{
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	g_return_val_if_fail (CD_IS_ICC_STORE (store), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (priv->index == NULL, FALSE);
+
+	/* a missing index is fine */
+	if (!g_key_file_load_from_file (kf, filename, G_KEY_FILE_NONE, &error_local)) {
+		if (!g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+	}
+	priv->index_fn = g_strdup (filename);
+	priv->index = g_steal_pointer (&kf);
+	priv->index_used = g_key_file_new ();
+	return TRUE;
+}
+
 /**
  * cd_icc_store_get_all:
  * @store: a #CdIccStore instance.
@@ -550,6 +1572,40 @@ cd_icc_store_get_all (CdIccStore *store)
 	return g_ptr_array_ref (priv->icc_array);
 }
 
+/*
+ * cd_icc_store_get_search_locations:
+ *
+ * Returns the locations that cd_icc_store_search_kind() searches, so that
+ * the daemon can search the same ones below another root.
+ */
+GPtrArray *
+cd_icc_store_get_search_locations (CdIccStoreSearchKind search_kind)
+{
+	GPtrArray *locations = g_ptr_array_new_with_free_func (g_free);
+	gchar *tmp;
+
+	switch (search_kind) {
+	case CD_ICC_STORE_SEARCH_KIND_USER:
+		tmp = g_build_filename (g_get_user_data_dir (), "icc", NULL);
+		g_ptr_array_add (locations, tmp);
+		tmp = g_build_filename (g_get_home_dir (), ".color", "icc", NULL);
+		g_ptr_array_add (locations, tmp);
+		break;
+	case CD_ICC_STORE_SEARCH_KIND_MACHINE:
+		g_ptr_array_add (locations, g_strdup (CD_SYSTEM_PROFILES_DIR));
+		g_ptr_array_add (locations, g_strdup ("/var/lib/color/icc"));
+		break;
+	case CD_ICC_STORE_SEARCH_KIND_SYSTEM:
+		g_ptr_array_add (locations, g_strdup ("/usr/share/color/icc"));
+		g_ptr_array_add (locations, g_strdup ("/usr/local/share/color/icc"));
+		g_ptr_array_add (locations, g_strdup ("/Library/ColorSync/Profiles/Displays"));
+		break;
+	default:
+		break;
+	}
+	return locations;
+}
+
 /**
  * cd_icc_store_search_kind:
  * @store: a #CdIccStore instance.
@@ -579,26 +1635,7 @@ cd_icc_store_search_kind (CdIccStore *store,
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
 	/* get the locations for each kind */
-	locations = g_ptr_array_new_with_free_func (g_free);
-	switch (search_kind) {
-	case CD_ICC_STORE_SEARCH_KIND_USER:
-		tmp = g_build_filename (g_get_user_data_dir (), "icc", NULL);
-		g_ptr_array_add (locations, tmp);
-		tmp = g_build_filename (g_get_home_dir (), ".color", "icc", NULL);
-		g_ptr_array_add (locations, tmp);
-		break;
-	case CD_ICC_STORE_SEARCH_KIND_MACHINE:
-		g_ptr_array_add (locations, g_strdup (CD_SYSTEM_PROFILES_DIR));
-		g_ptr_array_add (locations, g_strdup ("/var/lib/color/icc"));
-		break;
-	case CD_ICC_STORE_SEARCH_KIND_SYSTEM:
-		g_ptr_array_add (locations, g_strdup ("/usr/share/color/icc"));
-		g_ptr_array_add (locations, g_strdup ("/usr/local/share/color/icc"));
-		g_ptr_array_add (locations, g_strdup ("/Library/ColorSync/Profiles/Displays"));
-		break;
-	default:
-		break;
-	}
+	locations = cd_icc_store_get_search_locations (search_kind);
 
 	/* add any found locations */
 	for (i = 0; i < locations->len; i++) {
@@ -637,6 +1674,8 @@ cd_icc_store_search_location (CdIccStore *store,
 			      GCancellable *cancellable,
 			      GError **error)
 {
+	CdIccStorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GError) error_local = NULL;
 	g_autoptr(GFile) file = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC_STORE (store), FALSE);
@@ -655,8 +1694,25 @@ cd_icc_store_search_location (CdIccStore *store,
 		}
 	}
 
-	/* search all */
-	return cd_icc_store_search_path (store, location, 0, cancellable, error);
+	/* only the location itself is watched, everything below is swept */
+	if ((search_flags & CD_ICC_STORE_SEARCH_FLAGS_COLD) > 0) {
+		if (!cd_icc_store_is_cold_root (store, location))
+			g_ptr_array_add (priv->cold_roots, g_strdup (location));
+		if (priv->sweep_id == 0) {
+			priv->sweep_id = g_timeout_add_seconds (priv->sweep_interval,
+								cd_icc_store_sweep_cb,
+								store);
+		}
+	}
+
+	/* search all, and then parse what was found */
+	if (!cd_icc_store_search_path (store, location, 0, cancellable, error)) {
+		/* still add the profiles found before the failure */
+		if (!cd_icc_store_load_pending (store, TRUE, &error_local))
+			g_debug ("CdIccStore: %s", error_local->message);
+		return FALSE;
+	}
+	return cd_icc_store_load_pending (store, TRUE, error);
 }
 
 static void
@@ -695,6 +1751,21 @@ cd_icc_store_class_init (CdIccStoreClass *klass)
 			      G_STRUCT_OFFSET (CdIccStoreClass, removed),
 			      NULL, NULL, g_cclosure_marshal_generic,
 			      G_TYPE_NONE, 1, CD_TYPE_ICC);
+	/**
+	 * CdIccStore::changed:
+	 * @profile: the #CdIccStore instance that emitted the signal
+	 *
+	 * The ::changed signal is emitted once after the profiles found by
+	 * the directory monitors have been added or removed, so that users
+	 * can deal with a large update in one go.
+	 *
+	 * Since: 1.4.10
+	 **/
+	signals[SIGNAL_CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 0);
 }
 
 static void
@@ -704,6 +1775,15 @@ cd_icc_store_init (CdIccStore *store)
 	priv->load_flags = CD_ICC_LOAD_FLAGS_FALLBACK_MD5;
 	priv->icc_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	priv->directory_array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_icc_store_helper_free);
+	priv->directory_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->filename_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->checksum_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_icc_store_load_item_free);
+	g_mutex_init (&priv->index_mutex);
+	priv->changes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->bundles = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_icc_store_bundle_free);
+	priv->cold_roots = g_ptr_array_new_with_free_func (g_free);
+	priv->sweep_interval = CD_ICC_STORE_SWEEP_INTERVAL;
 }
 
 static void
@@ -712,10 +1792,42 @@ cd_icc_store_finalize (GObject *object)
 	CdIccStore *store = CD_ICC_STORE (object);
 	CdIccStorePrivate *priv = GET_PRIVATE (store);
 
+	/* flush any pending changes */
+	if (priv->changes_id != 0)
+		g_source_remove (priv->changes_id);
+	if (priv->sweep_id != 0)
+		g_source_remove (priv->sweep_id);
+	if (priv->checksum_cache_id != 0) {
+		g_source_remove (priv->checksum_cache_id);
+		cd_icc_store_checksum_cache_save_cb (store);
+	}
+	if (priv->index_id != 0) {
+		g_source_remove (priv->index_id);
+		cd_icc_store_index_save_cb (store);
+	}
+
+	g_hash_table_unref (priv->filename_hash);
+	g_hash_table_unref (priv->checksum_hash);
+	g_hash_table_unref (priv->directory_hash);
 	g_ptr_array_unref (priv->icc_array);
 	g_ptr_array_unref (priv->directory_array);
+	g_ptr_array_unref (priv->pending);
+	g_hash_table_unref (priv->changes);
 	if (priv->cache != NULL)
 		g_resource_unref (priv->cache);
+	g_ptr_array_unref (priv->bundles);
+	g_ptr_array_unref (priv->cold_roots);
+	if (priv->checksum_cache != NULL) {
+		g_hash_table_unref (priv->checksum_cache);
+		g_hash_table_unref (priv->checksum_cache_used);
+	}
+	g_free (priv->checksum_cache_fn);
+	if (priv->index != NULL) {
+		g_key_file_unref (priv->index);
+		g_key_file_unref (priv->index_used);
+	}
+	g_free (priv->index_fn);
+	g_mutex_clear (&priv->index_mutex);
 
 	G_OBJECT_CLASS (cd_icc_store_parent_class)->finalize (object);
 }
@@ -46,6 +46,7 @@ struct _CdIccStoreClass
  * CdIccStoreSearchFlags:
  * @CD_ICC_STORE_SEARCH_FLAGS_NONE:			No flags set.
  * @CD_ICC_STORE_SEARCH_FLAGS_CREATE_LOCATION:		Create the location if it does not exist
+ * @CD_ICC_STORE_SEARCH_FLAGS_COLD:			Only watch the location itself, and check the directories below it periodically
  *
  * Flags used when adding scan locations.
  *
@@ -54,6 +55,7 @@ struct _CdIccStoreClass
 typedef enum {
 	CD_ICC_STORE_SEARCH_FLAGS_NONE			= 0,	/* Since: 1.0.2 */
 	CD_ICC_STORE_SEARCH_FLAGS_CREATE_LOCATION	= 1,	/* Since: 1.0.2 */
+	CD_ICC_STORE_SEARCH_FLAGS_COLD			= 2,	/* Since: 1.4.10 */
 	/*< private >*/
 	CD_ICC_STORE_SEARCH_FLAGS_LAST
 } CdIccStoreSearchFlags;
@@ -90,8 +92,22 @@ gboolean	 cd_icc_store_search_kind	(CdIccStore	*store,
 void		 cd_icc_store_set_load_flags	(CdIccStore	*store,
 						 CdIccLoadFlags	 load_flags);
 CdIccLoadFlags	 cd_icc_store_get_load_flags	(CdIccStore	*store);
+void		 cd_icc_store_set_sweep_interval (CdIccStore	*store,
+						 guint		 sweep_interval);
+void		 cd_icc_store_set_metadata_only	(CdIccStore	*store,
+						 gboolean	 metadata_only);
+gboolean	 cd_icc_store_get_metadata_only	(CdIccStore	*store);
 void		 cd_icc_store_set_cache		(CdIccStore	*store,
 						 GResource	*cache);
+gboolean	 cd_icc_store_add_cache_file	(CdIccStore	*store,
+						 const gchar	*filename,
+						 GError		**error);
+gboolean	 cd_icc_store_set_checksum_cache (CdIccStore	*store,
+						 const gchar	*filename,
+						 GError		**error);
+gboolean	 cd_icc_store_set_index		(CdIccStore	*store,
+						 const gchar	*filename,
+						 GError		**error);
 GPtrArray	*cd_icc_store_get_all		(CdIccStore	*store);
 CdIcc		*cd_icc_store_find_by_filename	(CdIccStore	*store,
 						 const gchar	*filename);
@@ -32,6 +32,7 @@
 #include <glib-object.h>
 #include <lcms2.h>
 
+#include "cd-context-lcms.h"
 #include "cd-icc-utils.h"
 
 typedef struct {
@@ -51,27 +52,39 @@ cd_icc_utils_get_coverage_sample_cb (const cmsFloat32Number in[],
 	return 1;
 }
 
+/* the number of profile pairs to remember the coverage of */
+#define CD_ICC_UTILS_COVERAGE_CACHE_SIZE_MAX	1024
+
+typedef struct {
+	gdouble			 coverage_icc;
+	gdouble			 coverage_reference;
+} CdIccUtilsCoverageItem;
+
+static GMutex	 cd_icc_utils_coverage_mutex;
+static GHashTable *cd_icc_utils_coverage_cache = NULL; /* key:CdIccUtilsCoverageItem */
+
 static gboolean
 cd_icc_utils_get_coverage_calc (CdIcc *icc,
 				CdIcc *icc_reference,
+				guint cube_size,
+				cmsContext context_lcms,
 				gdouble *coverage,
 				GError **error)
 {
-	const guint cube_size = 33;
 	cmsHPROFILE profile_null = NULL;
 	cmsHTRANSFORM transform = NULL;
 	cmsUInt32Number dimensions[] = { cube_size, cube_size, cube_size };
+	cmsUInt16Number alarm_codes[cmsMAXCHANNELS] = { 0xffff };
 	CdIccUtilsGamutCheckHelper helper;
 	gboolean ret = TRUE;
 	guint cnt = 0;
 	guint data_len = cube_size * cube_size * cube_size;
 	guint i;
 	g_autofree cmsFloat32Number *data = NULL;
-	g_autofree cmsUInt16Number *alarm_codes = NULL;
 
 	/* create a proofing transform with gamut check */
-	profile_null = cmsCreateNULLProfileTHR (cd_icc_get_context (icc));
-	transform = cmsCreateProofingTransformTHR (cd_icc_get_context (icc),
+	profile_null = cmsCreateNULLProfileTHR (context_lcms);
+	transform = cmsCreateProofingTransformTHR (context_lcms,
 						   cd_icc_get_handle (icc),
 						   TYPE_RGB_FLT,
 						   profile_null,
@@ -92,10 +105,8 @@ cd_icc_utils_get_coverage_calc (CdIcc *icc,
 		goto out;
 	}
 
-	/* set gamut alarm to 0xffff */
-	alarm_codes = g_new0 (cmsUInt16Number, cmsMAXCHANNELS);
-	alarm_codes[0] = 0xffff;
-	cmsSetAlarmCodesTHR(cd_icc_get_context (icc), alarm_codes);
+	/* set gamut alarm to 0xffff, only in our own context */
+	cmsSetAlarmCodesTHR (context_lcms, alarm_codes);
 
 	/* slice profile in regular intervals */
 	data = g_new0 (cmsFloat32Number, data_len * 3);
@@ -131,6 +142,158 @@ out:
 	return ret;
 }
 
+typedef struct {
+	CdIcc			*icc;
+	CdIcc			*icc_reference;
+	guint			 cube_size;
+	gdouble			 coverage;
+	gboolean		 ret;
+	GError			*error;
+} CdIccUtilsCoverageHelper;
+
+static gpointer
+cd_icc_utils_get_coverage_thread_cb (gpointer user_data)
+{
+	CdIccUtilsCoverageHelper *helper = (CdIccUtilsCoverageHelper *) user_data;
+	cmsContext context_lcms;
+
+	/* the alarm codes and error handler are per-context */
+	context_lcms = cd_context_lcms_new ();
+	helper->ret = cd_icc_utils_get_coverage_calc (helper->icc,
+						      helper->icc_reference,
+						      helper->cube_size,
+						      context_lcms,
+						      &helper->coverage,
+						      &helper->error);
+	cd_context_lcms_free (context_lcms);
+	return NULL;
+}
+
+/**
+ * cd_icc_utils_get_coverage_full:
+ * @icc: The profile to test
+ * @icc_reference: The reference profile, e.g. sRGB
+ * @cube_size: The number of samples on each RGB axis, e.g. 33
+ * @coverage_icc: (out) (optional): The fraction of @icc inside @icc_reference
+ * @coverage_reference: (out) (optional): The fraction of @icc_reference inside @icc
+ * @error: A #GError, or %NULL
+ *
+ * Gets the gamut coverage of two profiles in both directions at once, by
+ * checking a cube of RGB values against the other gamut. The two directions
+ * are calculated in parallel.
+ *
+ * The results are cached for the profile checksums, so asking for the same
+ * pair of profiles again is fast.
+ *
+ * Return value: TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_utils_get_coverage_full (CdIcc *icc,
+				CdIcc *icc_reference,
+				guint cube_size,
+				gdouble *coverage_icc,
+				gdouble *coverage_reference,
+				GError **error)
+{
+	CdIccUtilsCoverageHelper helper;
+	CdIccUtilsCoverageItem *item;
+	GThread *thread;
+	cmsContext context_lcms;
+	gdouble coverage_tmp = 0.f;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (CD_IS_ICC (icc_reference), FALSE);
+	g_return_val_if_fail (cube_size >= 2, FALSE);
+
+	/* already calculated by this or another instance */
+	if (cd_icc_get_checksum (icc) != NULL &&
+	    cd_icc_get_checksum (icc_reference) != NULL) {
+		key = g_strdup_printf ("%s:%s:%u",
+				       cd_icc_get_checksum (icc),
+				       cd_icc_get_checksum (icc_reference),
+				       cube_size);
+	}
+	if (key != NULL) {
+		g_mutex_lock (&cd_icc_utils_coverage_mutex);
+		if (cd_icc_utils_coverage_cache != NULL) {
+			item = g_hash_table_lookup (cd_icc_utils_coverage_cache, key);
+			if (item != NULL) {
+				if (coverage_icc != NULL)
+					*coverage_icc = item->coverage_icc;
+				if (coverage_reference != NULL)
+					*coverage_reference = item->coverage_reference;
+				g_mutex_unlock (&cd_icc_utils_coverage_mutex);
+				return TRUE;
+			}
+		}
+		g_mutex_unlock (&cd_icc_utils_coverage_mutex);
+	}
+
+	/* do the reverse direction in another thread */
+	helper.icc = icc_reference;
+	helper.icc_reference = icc;
+	helper.cube_size = cube_size;
+	helper.coverage = 0.f;
+	helper.ret = FALSE;
+	helper.error = NULL;
+	thread = g_thread_try_new ("colord-coverage",
+				   cd_icc_utils_get_coverage_thread_cb,
+				   &helper, NULL);
+	if (thread == NULL)
+		cd_icc_utils_get_coverage_thread_cb (&helper);
+
+	/* first see if icc has a smaller gamut volume to the reference */
+	context_lcms = cd_context_lcms_new ();
+	if (!cd_icc_utils_get_coverage_calc (icc,
+					     icc_reference,
+					     cube_size,
+					     context_lcms,
+					     &coverage_tmp,
+					     error)) {
+		cd_context_lcms_free (context_lcms);
+		if (thread != NULL)
+			g_thread_join (thread);
+		g_clear_error (&helper.error);
+		return FALSE;
+	}
+	cd_context_lcms_free (context_lcms);
+	if (thread != NULL)
+		g_thread_join (thread);
+	if (!helper.ret) {
+		g_propagate_error (error, helper.error);
+		return FALSE;
+	}
+
+	/* add to the cache, forgetting everything if it gets too big */
+	if (key != NULL) {
+		item = g_new0 (CdIccUtilsCoverageItem, 1);
+		item->coverage_icc = coverage_tmp;
+		item->coverage_reference = helper.coverage;
+		g_mutex_lock (&cd_icc_utils_coverage_mutex);
+		if (cd_icc_utils_coverage_cache == NULL) {
+			cd_icc_utils_coverage_cache = g_hash_table_new_full (g_str_hash,
+									     g_str_equal,
+									     g_free,
+									     g_free);
+		}
+		if (g_hash_table_size (cd_icc_utils_coverage_cache) >= CD_ICC_UTILS_COVERAGE_CACHE_SIZE_MAX)
+			g_hash_table_remove_all (cd_icc_utils_coverage_cache);
+		g_hash_table_insert (cd_icc_utils_coverage_cache,
+				     g_steal_pointer (&key), item);
+		g_mutex_unlock (&cd_icc_utils_coverage_mutex);
+	}
+
+	/* success */
+	if (coverage_icc != NULL)
+		*coverage_icc = coverage_tmp;
+	if (coverage_reference != NULL)
+		*coverage_reference = helper.coverage;
+	return TRUE;
+}
+
 /**
  * cd_icc_utils_get_coverage:
  * @icc: The profile to test
@@ -149,31 +312,291 @@ cd_icc_utils_get_coverage (CdIcc *icc,
 			   gdouble *coverage,
 			   GError **error)
 {
-	gdouble coverage_tmp;
+	gdouble coverage_icc;
+	gdouble coverage_reference;
 
-	/* first see if icc has a smaller gamut volume to the reference */
-	if (!cd_icc_utils_get_coverage_calc (icc,
+	if (!cd_icc_utils_get_coverage_full (icc,
 					     icc_reference,
-					     &coverage_tmp,
+					     33,
+					     &coverage_icc,
+					     &coverage_reference,
 					     error))
 		return FALSE;
 
-	/* now try the other way around */
-	if (coverage_tmp >= 1.0f) {
-		if (!cd_icc_utils_get_coverage_calc (icc_reference,
-						     icc,
-						     &coverage_tmp,
-						     error))
-			return FALSE;
-		coverage_tmp = 1 / coverage_tmp;
-	}
+	/* use the other direction if icc is not smaller than the reference */
+	if (coverage_icc >= 1.0f)
+		coverage_icc = 1 / coverage_reference;
 
 	/* success */
 	if (coverage != NULL)
-		*coverage = coverage_tmp;
+		*coverage = coverage_icc;
 	return TRUE;
 }
 
+/* the number of profile gamut hulls to keep around */
+#define CD_ICC_UTILS_GAMUT_CACHE_SIZE_MAX	64
+
+typedef struct {
+	GArray			*vertices;	/* of CdColorLab */
+	GArray			*triangles;	/* of guint, 3 per triangle */
+	gdouble			 volume;
+} CdIccUtilsGamutItem;
+
+static GMutex	 cd_icc_utils_gamut_mutex;
+static GHashTable *cd_icc_utils_gamut_cache = NULL; /* key:CdIccUtilsGamutItem */
+
+static void
+cd_icc_utils_gamut_item_free (CdIccUtilsGamutItem *item)
+{
+	g_array_unref (item->vertices);
+	g_array_unref (item->triangles);
+	g_free (item);
+}
+
+static GArray *
+cd_icc_utils_array_dup (GArray *array, guint element_size)
+{
+	GArray *dest = g_array_sized_new (FALSE, FALSE, element_size, array->len);
+	g_array_append_vals (dest, array->data, array->len);
+	return dest;
+}
+
+static guint
+cd_icc_utils_gamut_add_vertex (GArray *rgb, gint *index, guint grid_size, const guint *c)
+{
+	CdColorRGB tmp;
+	guint idx = (c[0] * grid_size + c[1]) * grid_size + c[2];
+
+	/* share the vertices on the edges between faces */
+	if (index[idx] < 0) {
+		tmp.R = (gdouble) c[0] / (gdouble) (grid_size - 1);
+		tmp.G = (gdouble) c[1] / (gdouble) (grid_size - 1);
+		tmp.B = (gdouble) c[2] / (gdouble) (grid_size - 1);
+		index[idx] = rgb->len;
+		g_array_append_val (rgb, tmp);
+	}
+	return index[idx];
+}
+
+static CdIccUtilsGamutItem *
+cd_icc_utils_get_gamut_hull_uncached (CdIcc *icc, guint grid_size, GError **error)
+{
+	CdIccUtilsGamutItem *item;
+	cmsContext context_lcms;
+	cmsHPROFILE profile_lab;
+	cmsHTRANSFORM transform;
+	gdouble volume = 0.f;
+	guint a, i, j, side;
+	guint c[3];
+	guint v[4];
+	guint *tri;
+	g_autofree gint *index = NULL;
+	g_autoptr(GArray) rgb = NULL;
+	g_autoptr(GArray) triangles = NULL;
+	g_autoptr(GArray) vertices = NULL;
+
+	/* only the faces of the RGB cube are on the gamut boundary */
+	index = g_new (gint, grid_size * grid_size * grid_size);
+	for (i = 0; i < grid_size * grid_size * grid_size; i++)
+		index[i] = -1;
+	rgb = g_array_new (FALSE, FALSE, sizeof (CdColorRGB));
+	triangles = g_array_new (FALSE, FALSE, sizeof (guint));
+	for (a = 0; a < 3; a++) {
+		for (side = 0; side < grid_size; side += grid_size - 1) {
+			c[a] = side;
+			for (i = 0; i < grid_size - 1; i++) {
+				for (j = 0; j < grid_size - 1; j++) {
+					c[(a + 1) % 3] = i;
+					c[(a + 2) % 3] = j;
+					v[0] = cd_icc_utils_gamut_add_vertex (rgb, index, grid_size, c);
+					c[(a + 1) % 3] = i + 1;
+					v[1] = cd_icc_utils_gamut_add_vertex (rgb, index, grid_size, c);
+					c[(a + 2) % 3] = j + 1;
+					v[2] = cd_icc_utils_gamut_add_vertex (rgb, index, grid_size, c);
+					c[(a + 1) % 3] = i;
+					v[3] = cd_icc_utils_gamut_add_vertex (rgb, index, grid_size, c);
+
+					/* wind each face outwards in RGB */
+					if (side == 0) {
+						guint tmp = v[1];
+						v[1] = v[3];
+						v[3] = tmp;
+					}
+					g_array_append_vals (triangles, v, 3);
+					g_array_append_val (triangles, v[0]);
+					g_array_append_vals (triangles, &v[2], 2);
+				}
+			}
+		}
+	}
+
+	/* convert the surface to Lab */
+	context_lcms = cd_context_lcms_new ();
+	profile_lab = cmsCreateLab4ProfileTHR (context_lcms, cmsD50_xyY ());
+	transform = cmsCreateTransformTHR (context_lcms,
+					   cd_icc_get_handle (icc), TYPE_RGB_DBL,
+					   profile_lab, TYPE_Lab_DBL,
+					   INTENT_RELATIVE_COLORIMETRIC,
+					   cmsFLAGS_NOOPTIMIZE);
+	cmsCloseProfile (profile_lab);
+	if (transform == NULL) {
+		cd_context_lcms_free (context_lcms);
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_INVALID_COLORSPACE,
+			     "Failed to setup RGB -> Lab transform for %s",
+			     cd_icc_get_filename (icc));
+		return NULL;
+	}
+	vertices = g_array_sized_new (FALSE, FALSE, sizeof (CdColorLab), rgb->len);
+	g_array_set_size (vertices, rgb->len);
+	cmsDoTransform (transform, rgb->data, vertices->data, rgb->len);
+	cmsDeleteTransform (transform);
+	cd_context_lcms_free (context_lcms);
+
+	/* the volume of a closed mesh is the sum of the signed volumes
+	 * of the tetrahedra from the origin to each triangle */
+	tri = (guint *) triangles->data;
+	for (i = 0; i < triangles->len; i += 3) {
+		const CdColorLab *p0 = &g_array_index (vertices, CdColorLab, tri[i + 0]);
+		const CdColorLab *p1 = &g_array_index (vertices, CdColorLab, tri[i + 1]);
+		const CdColorLab *p2 = &g_array_index (vertices, CdColorLab, tri[i + 2]);
+		volume += p0->L * (p1->a * p2->b - p1->b * p2->a) +
+			  p0->a * (p1->b * p2->L - p1->L * p2->b) +
+			  p0->b * (p1->L * p2->a - p1->a * p2->L);
+	}
+	volume /= 6.f;
+
+	/* the profile turned the mesh inside out */
+	if (volume < 0) {
+		for (i = 0; i < triangles->len; i += 3) {
+			guint tmp = tri[i + 1];
+			tri[i + 1] = tri[i + 2];
+			tri[i + 2] = tmp;
+		}
+		volume = -volume;
+	}
+
+	item = g_new0 (CdIccUtilsGamutItem, 1);
+	item->vertices = g_steal_pointer (&vertices);
+	item->triangles = g_steal_pointer (&triangles);
+	item->volume = volume;
+	return item;
+}
+
+/**
+ * cd_icc_utils_get_gamut_hull:
+ * @icc: The RGB profile to use
+ * @grid_size: The number of samples on each edge of the RGB cube, e.g. 17
+ * @vertices: (out) (optional) (element-type CdColorLab): The hull vertices, or %NULL
+ * @triangles: (out) (optional) (element-type guint): The vertex indices, or %NULL
+ * @volume: (out) (optional): The gamut volume in cubic Lab units, or %NULL
+ * @error: A #GError, or %NULL
+ *
+ * Gets the boundary of the gamut of an RGB profile as a closed triangle
+ * mesh in D50 CIE Lab, using relative colorimetric intent.
+ *
+ * Only the six faces of the RGB cube are sampled, and vertices are shared
+ * between neighbouring triangles. The @triangles array holds three vertex
+ * indices for each triangle, wound counter-clockwise when viewed from
+ * outside. The surface may be concave, and @volume is the volume it
+ * encloses.
+ *
+ * The results are cached for the profile checksum.
+ *
+ * Return value: TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_utils_get_gamut_hull (CdIcc *icc,
+			     guint grid_size,
+			     GArray **vertices,
+			     GArray **triangles,
+			     gdouble *volume,
+			     GError **error)
+{
+	CdIccUtilsGamutItem *item = NULL;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (grid_size >= 2, FALSE);
+
+	if (cd_icc_get_colorspace (icc) != CD_COLORSPACE_RGB) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_INVALID_COLORSPACE,
+			     "Not an RGB profile: %s",
+			     cd_icc_get_filename (icc));
+		return FALSE;
+	}
+
+	/* already calculated by this or another instance */
+	if (cd_icc_get_checksum (icc) != NULL)
+		key = g_strdup_printf ("%s:%u", cd_icc_get_checksum (icc), grid_size);
+	g_mutex_lock (&cd_icc_utils_gamut_mutex);
+	if (key != NULL && cd_icc_utils_gamut_cache != NULL)
+		item = g_hash_table_lookup (cd_icc_utils_gamut_cache, key);
+	if (item != NULL) {
+		if (vertices != NULL)
+			*vertices = cd_icc_utils_array_dup (item->vertices, sizeof (CdColorLab));
+		if (triangles != NULL)
+			*triangles = cd_icc_utils_array_dup (item->triangles, sizeof (guint));
+		if (volume != NULL)
+			*volume = item->volume;
+		g_mutex_unlock (&cd_icc_utils_gamut_mutex);
+		return TRUE;
+	}
+	g_mutex_unlock (&cd_icc_utils_gamut_mutex);
+
+	item = cd_icc_utils_get_gamut_hull_uncached (icc, grid_size, error);
+	if (item == NULL)
+		return FALSE;
+	if (vertices != NULL)
+		*vertices = cd_icc_utils_array_dup (item->vertices, sizeof (CdColorLab));
+	if (triangles != NULL)
+		*triangles = cd_icc_utils_array_dup (item->triangles, sizeof (guint));
+	if (volume != NULL)
+		*volume = item->volume;
+
+	/* add to the cache, forgetting everything if it gets too big */
+	if (key == NULL) {
+		cd_icc_utils_gamut_item_free (item);
+		return TRUE;
+	}
+	g_mutex_lock (&cd_icc_utils_gamut_mutex);
+	if (cd_icc_utils_gamut_cache == NULL) {
+		cd_icc_utils_gamut_cache = g_hash_table_new_full (g_str_hash,
+								  g_str_equal,
+								  g_free,
+								  (GDestroyNotify) cd_icc_utils_gamut_item_free);
+	}
+	if (g_hash_table_size (cd_icc_utils_gamut_cache) >= CD_ICC_UTILS_GAMUT_CACHE_SIZE_MAX)
+		g_hash_table_remove_all (cd_icc_utils_gamut_cache);
+	g_hash_table_insert (cd_icc_utils_gamut_cache, g_steal_pointer (&key), item);
+	g_mutex_unlock (&cd_icc_utils_gamut_mutex);
+	return TRUE;
+}
+
+/**
+ * cd_icc_utils_get_gamut_volume:
+ * @icc: The RGB profile to use
+ * @volume: (out): The gamut volume in cubic Lab units
+ * @error: A #GError, or %NULL
+ *
+ * Gets the volume of the gamut of an RGB profile in D50 CIE Lab, where
+ * sRGB is about 830,000.
+ *
+ * Return value: TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_utils_get_gamut_volume (CdIcc *icc, gdouble *volume, GError **error)
+{
+	return cd_icc_utils_get_gamut_hull (icc, 17, NULL, NULL, volume, error);
+}
+
 /**
  * cd_icc_utils_get_chroma_matrix:
  * @icc: The profile to use.
@@ -38,6 +38,21 @@ gboolean	 cd_icc_utils_get_coverage		(CdIcc		*icc,
 							 CdIcc		*icc_reference,
 							 gdouble	*coverage,
 							 GError		**error);
+gboolean	 cd_icc_utils_get_coverage_full		(CdIcc		*icc,
+							 CdIcc		*icc_reference,
+							 guint		 cube_size,
+							 gdouble	*coverage_icc,
+							 gdouble	*coverage_reference,
+							 GError		**error);
+gboolean	 cd_icc_utils_get_gamut_hull		(CdIcc		*icc,
+							 guint		 grid_size,
+							 GArray		**vertices,
+							 GArray		**triangles,
+							 gdouble	*volume,
+							 GError		**error);
+gboolean	 cd_icc_utils_get_gamut_volume		(CdIcc		*icc,
+							 gdouble	*volume,
+							 GError		**error);
 
 gboolean	cd_icc_utils_get_adaptation_matrix (CdIcc		*icc,
 						    CdIcc		*icc_reference,
@@ -23,6 +23,11 @@
 /**
  * SECTION:cd-icc
  * @short_description: An object to read and write a binary ICC profile
+ *
+ * Once loaded, a #CdIcc can be shared between threads that only call the
+ * getters, including the ones that fill caches or reopen a released
+ * handle on first use. Anything that loads, sets or saves must not run
+ * at the same time as any other call on the same object.
  */
 
 #include "config.h"
@@ -36,14 +41,25 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <math.h>
+#include <sys/stat.h>
+
+#ifdef __unix__
+#include <gio/gunixoutputstream.h>
+#endif
 
+#include "cd-buffer.h"
 #include "cd-context-lcms.h"
 #include "cd-icc.h"
+#include "cd-icc-private.h"
+#include "cd-memory-private.h"
 
 static void	cd_icc_class_init	(CdIccClass	*klass);
 static void	cd_icc_init		(CdIcc		*icc);
 static gboolean	cd_icc_load_named_colors (CdIcc		*icc, GError **error);
 static void	cd_icc_finalize		(GObject	*object);
+static void	cd_icc_load_mluc_defaults (CdIcc	*icc);
+static void	cd_icc_load_mluc_translations (CdIcc	*icc);
+static void	cd_icc_peek_reset	(CdIcc		*icc);
 
 #define GET_PRIVATE(o) (cd_icc_get_instance_private (o))
 
@@ -72,10 +88,24 @@ typedef struct
 	gchar			*characterization_data;
 	gdouble			 version;
 	GHashTable		*mluc_data[CD_MLUC_LAST]; /* key is 'en_GB' or '' for default */
+	GRWLock			 mluc_lock;	/* for the getters filling mluc_data */
+	GMutex			 reload_mutex;
+	gboolean		 mluc_defaults_loaded;
+	gboolean		 peeked;
+	gchar			**peek_tags;
+	GArray			*peek_warnings;
+	gboolean		 modified;	/* since loaded */
+	gboolean		 released;	/* lcms_profile can be reloaded */
+	gint64			 released_mtime;
 	GHashTable		*metadata;
 	gint64			 creation_time;
 	guint32			 size;
 	GPtrArray		*named_colors;
+	GHashTable		*named_colors_hash;	/* name : CdColorSwatch */
+	gdouble			*named_colors_L;	/* sorted by L */
+	gdouble			*named_colors_a;
+	gdouble			*named_colors_b;
+	guint			*named_colors_idx;	/* into named_colors */
 	guint			 temperature;
 	CdColorXYZ		 white;
 	CdColorXYZ		 red;
@@ -85,6 +115,15 @@ typedef struct
 
 G_DEFINE_TYPE_WITH_PRIVATE (CdIcc, cd_icc, G_TYPE_OBJECT)
 
+/* the number of profile checksums to remember warnings for */
+#define CD_ICC_WARNINGS_CACHE_SIZE_MAX		1024
+
+static GMutex	 cd_icc_warnings_mutex;
+static GHashTable *cd_icc_warnings_cache = NULL; /* checksum:GArray */
+
+/* for the daemon memory accounting */
+static gint	 cd_icc_live_count = 0;
+
 enum {
 	PROP_0,
 	PROP_SIZE,
@@ -158,6 +197,40 @@ cd_icc_uint32_to_str (guint32 id, gchar *str)
 	str[4] = '\0';
 }
 
+/* reopens the file if the handle was dropped by cd_icc_release_handle() */
+static void
+cd_icc_reload_handle (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	GStatBuf stat_buf;
+	cmsHPROFILE lcms_profile;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	/* readers in other threads may get here at the same time, so the
+	 * handle is only published once it is completely opened */
+	if (g_atomic_pointer_get (&priv->lcms_profile) != NULL || !priv->released)
+		return;
+	locker = g_mutex_locker_new (&priv->reload_mutex);
+	if (priv->lcms_profile != NULL)
+		return;
+
+	/* the descriptor no longer matches the file */
+	if (g_stat (priv->filename, &stat_buf) != 0 ||
+	    stat_buf.st_size != priv->size ||
+	    stat_buf.st_mtime != priv->released_mtime) {
+		g_warning ("CdIcc: %s changed since it was loaded", priv->filename);
+		return;
+	}
+	lcms_profile = cmsOpenProfileFromFileTHR (priv->context_lcms,
+						  priv->filename, "r");
+	if (lcms_profile == NULL) {
+		g_warning ("CdIcc: failed to reload %s", priv->filename);
+		return;
+	}
+	g_atomic_pointer_set (&priv->lcms_profile, lcms_profile);
+	priv->released = FALSE;
+}
+
 static gpointer
 cd_icc_read_tag (CdIcc *icc, cmsTagSignature sig, GError **error)
 {
@@ -165,6 +238,17 @@ cd_icc_read_tag (CdIcc *icc, cmsTagSignature sig, GError **error)
 	gchar sig_string[5];
 	gpointer tmp;
 
+	cd_icc_reload_handle (icc);
+
+	/* only the header was parsed */
+	if (priv->lcms_profile == NULL) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_NO_DATA,
+				     "profile has not been loaded");
+		return NULL;
+	}
+
 	/* ensure context error is not present to aid debugging */
 	cd_context_lcms_error_clear (priv->context_lcms);
 
@@ -192,6 +276,8 @@ cd_icc_write_tag (CdIcc *icc, cmsTagSignature sig, gpointer data, GError **error
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	gchar sig_string[5];
 
+	cd_icc_reload_handle (icc);
+
 	/* ensure context error is not present to aid debugging */
 	cd_context_lcms_error_clear (priv->context_lcms);
 
@@ -218,15 +304,13 @@ cd_icc_write_tag (CdIcc *icc, cmsTagSignature sig, gpointer data, GError **error
 }
 
 static gchar *
-cd_icc_get_precooked_md5 (cmsHPROFILE lcms_profile)
+cd_icc_profile_id_to_md5 (const guint8 *icc_id)
 {
-	cmsUInt8Number icc_id[16];
 	gboolean md5_precooked = FALSE;
 	gchar *md5 = NULL;
 	guint i;
 
 	/* check to see if we have a pre-cooked MD5 */
-	cmsGetHeaderProfileID (lcms_profile, icc_id);
 	for (i = 0; i < 16; i++) {
 		if (icc_id[i] != 0) {
 			md5_precooked = TRUE;
@@ -243,6 +327,14 @@ cd_icc_get_precooked_md5 (cmsHPROFILE lcms_profile)
 	return md5;
 }
 
+static gchar *
+cd_icc_get_precooked_md5 (cmsHPROFILE lcms_profile)
+{
+	cmsUInt8Number icc_id[16];
+	cmsGetHeaderProfileID (lcms_profile, icc_id);
+	return cd_icc_profile_id_to_md5 (icc_id);
+}
+
 /**
  * cd_icc_to_string:
  * @icc: a #CdIcc instance.
@@ -273,6 +365,7 @@ cd_icc_to_string (CdIcc *icc)
 	g_autofree gchar *profile_id = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	cd_icc_reload_handle (icc);
 
 	/* setup error handler */
 
@@ -698,6 +791,20 @@ cd_icc_get_tags (CdIcc *icc, GError **error)
 	guint32 i;
 	guint32 number_tags;
 
+	cd_icc_reload_handle (icc);
+
+	/* only the tag table was parsed */
+	if (priv->lcms_profile == NULL) {
+		if (priv->peek_tags == NULL) {
+			g_set_error_literal (error,
+					     CD_ICC_ERROR,
+					     CD_ICC_ERROR_NO_DATA,
+					     "no tag table loaded");
+			return NULL;
+		}
+		return g_strdupv (priv->peek_tags);
+	}
+
 	tags = g_ptr_array_new ();
 	number_tags = cmsGetTagCount (priv->lcms_profile);
 	for (i = 0; i < number_tags; i++) {
@@ -741,6 +848,8 @@ cd_icc_get_tag_data (CdIcc *icc, const gchar *tag, GError **error)
 	cmsTagSignature sig;
 	gchar *tmp;
 
+	cd_icc_reload_handle (icc);
+
 	/* read tag */
 	sig = cd_icc_str_to_tag (tag);
 	if (sig == 0) {
@@ -784,6 +893,8 @@ cd_icc_set_tag_data (CdIcc *icc, const gchar *tag, GBytes *data, GError **error)
 	cmsTagSignature sig;
 	gboolean ret;
 
+	cd_icc_reload_handle (icc);
+
 	/* work around an LCMS API quirk in that you can't do cmsWriteRawTag()
 	 * if the tag already exists. Use the undocumented usage of
 	 * cmsWriteTag() to delete the tag first */
@@ -795,6 +906,7 @@ cd_icc_set_tag_data (CdIcc *icc, const gchar *tag, GBytes *data, GError **error)
 			     "Tag '%s' was not valid", tag);
 		return FALSE;
 	}
+	priv->modified = TRUE;
 	cmsWriteTag (priv->lcms_profile, sig, NULL);
 	ret = cmsWriteRawTag (priv->lcms_profile,
 			      sig,
@@ -810,38 +922,113 @@ cd_icc_set_tag_data (CdIcc *icc, const gchar *tag, GBytes *data, GError **error)
 	return ret;
 }
 
-/* map lcms profile class to colord type */
-const struct {
-	cmsProfileClassSignature	lcms;
-	CdProfileKind			colord;
-} map_profile_kind[] = {
-	{ cmsSigInputClass,		CD_PROFILE_KIND_INPUT_DEVICE },
-	{ cmsSigDisplayClass,		CD_PROFILE_KIND_DISPLAY_DEVICE },
-	{ cmsSigOutputClass,		CD_PROFILE_KIND_OUTPUT_DEVICE },
-	{ cmsSigLinkClass,		CD_PROFILE_KIND_DEVICELINK },
-	{ cmsSigColorSpaceClass,	CD_PROFILE_KIND_COLORSPACE_CONVERSION },
-	{ cmsSigAbstractClass,		CD_PROFILE_KIND_ABSTRACT },
-	{ cmsSigNamedColorClass,	CD_PROFILE_KIND_NAMED_COLOR },
-	{ 0,				CD_PROFILE_KIND_LAST }
-};
+/* map lcms profile class to colord type, or %CD_PROFILE_KIND_LAST */
+static CdProfileKind
+cd_icc_profile_kind_from_lcms (guint32 profile_class)
+{
+	switch (profile_class) {
+	case cmsSigInputClass:
+		return CD_PROFILE_KIND_INPUT_DEVICE;
+	case cmsSigDisplayClass:
+		return CD_PROFILE_KIND_DISPLAY_DEVICE;
+	case cmsSigOutputClass:
+		return CD_PROFILE_KIND_OUTPUT_DEVICE;
+	case cmsSigLinkClass:
+		return CD_PROFILE_KIND_DEVICELINK;
+	case cmsSigColorSpaceClass:
+		return CD_PROFILE_KIND_COLORSPACE_CONVERSION;
+	case cmsSigAbstractClass:
+		return CD_PROFILE_KIND_ABSTRACT;
+	case cmsSigNamedColorClass:
+		return CD_PROFILE_KIND_NAMED_COLOR;
+	default:
+		return CD_PROFILE_KIND_LAST;
+	}
+}
 
-/* map lcms colorspace to colord type */
-const struct {
-	cmsColorSpaceSignature		lcms;
-	CdColorspace			colord;
-} map_colorspace[] = {
-	{ cmsSigXYZData,		CD_COLORSPACE_XYZ },
-	{ cmsSigLabData,		CD_COLORSPACE_LAB },
-	{ cmsSigLuvData,		CD_COLORSPACE_LUV },
-	{ cmsSigYCbCrData,		CD_COLORSPACE_YCBCR },
-	{ cmsSigYxyData,		CD_COLORSPACE_YXY },
-	{ cmsSigRgbData,		CD_COLORSPACE_RGB },
-	{ cmsSigGrayData,		CD_COLORSPACE_GRAY },
-	{ cmsSigHsvData,		CD_COLORSPACE_HSV },
-	{ cmsSigCmykData,		CD_COLORSPACE_CMYK },
-	{ cmsSigCmyData,		CD_COLORSPACE_CMY },
-	{ 0,				CD_COLORSPACE_LAST }
-};
+/* map colord type to lcms profile class, or 0 */
+static cmsProfileClassSignature
+cd_icc_profile_kind_to_lcms (CdProfileKind kind)
+{
+	switch (kind) {
+	case CD_PROFILE_KIND_INPUT_DEVICE:
+		return cmsSigInputClass;
+	case CD_PROFILE_KIND_DISPLAY_DEVICE:
+		return cmsSigDisplayClass;
+	case CD_PROFILE_KIND_OUTPUT_DEVICE:
+		return cmsSigOutputClass;
+	case CD_PROFILE_KIND_DEVICELINK:
+		return cmsSigLinkClass;
+	case CD_PROFILE_KIND_COLORSPACE_CONVERSION:
+		return cmsSigColorSpaceClass;
+	case CD_PROFILE_KIND_ABSTRACT:
+		return cmsSigAbstractClass;
+	case CD_PROFILE_KIND_NAMED_COLOR:
+		return cmsSigNamedColorClass;
+	default:
+		return 0;
+	}
+}
+
+/* map lcms colorspace to colord type, or %CD_COLORSPACE_LAST */
+static CdColorspace
+cd_icc_colorspace_from_lcms (guint32 colorspace)
+{
+	switch (colorspace) {
+	case cmsSigXYZData:
+		return CD_COLORSPACE_XYZ;
+	case cmsSigLabData:
+		return CD_COLORSPACE_LAB;
+	case cmsSigLuvData:
+		return CD_COLORSPACE_LUV;
+	case cmsSigYCbCrData:
+		return CD_COLORSPACE_YCBCR;
+	case cmsSigYxyData:
+		return CD_COLORSPACE_YXY;
+	case cmsSigRgbData:
+		return CD_COLORSPACE_RGB;
+	case cmsSigGrayData:
+		return CD_COLORSPACE_GRAY;
+	case cmsSigHsvData:
+		return CD_COLORSPACE_HSV;
+	case cmsSigCmykData:
+		return CD_COLORSPACE_CMYK;
+	case cmsSigCmyData:
+		return CD_COLORSPACE_CMY;
+	default:
+		return CD_COLORSPACE_LAST;
+	}
+}
+
+/* map colord type to lcms colorspace, or 0 */
+static cmsColorSpaceSignature
+cd_icc_colorspace_to_lcms (CdColorspace colorspace)
+{
+	switch (colorspace) {
+	case CD_COLORSPACE_XYZ:
+		return cmsSigXYZData;
+	case CD_COLORSPACE_LAB:
+		return cmsSigLabData;
+	case CD_COLORSPACE_LUV:
+		return cmsSigLuvData;
+	case CD_COLORSPACE_YCBCR:
+		return cmsSigYCbCrData;
+	case CD_COLORSPACE_YXY:
+		return cmsSigYxyData;
+	case CD_COLORSPACE_RGB:
+		return cmsSigRgbData;
+	case CD_COLORSPACE_GRAY:
+		return cmsSigGrayData;
+	case CD_COLORSPACE_HSV:
+		return cmsSigHsvData;
+	case CD_COLORSPACE_CMYK:
+		return cmsSigCmykData;
+	case CD_COLORSPACE_CMY:
+		return cmsSigCmyData;
+	default:
+		return 0;
+	}
+}
 
 static gboolean
 cd_icc_calc_whitepoint (CdIcc *icc, GError **error)
@@ -1089,28 +1276,29 @@ cd_icc_load (CdIcc *icc, CdIccLoadFlags flags, GError **error)
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	cmsColorSpaceSignature colorspace;
 	cmsProfileClassSignature profile_class;
-	guint i;
+	CdColorspace colorspace_tmp;
+	CdProfileKind kind;
+
+	/* forget anything from cd_icc_peek_data() */
+	if (priv->peeked)
+		cd_icc_peek_reset (icc);
+	priv->modified = FALSE;
+	priv->released = FALSE;
 
 	/* get version */
 	priv->version = cmsGetProfileVersion (priv->lcms_profile);
 
 	/* convert profile kind */
 	profile_class = cmsGetDeviceClass (priv->lcms_profile);
-	for (i = 0; map_profile_kind[i].colord != CD_PROFILE_KIND_LAST; i++) {
-		if (map_profile_kind[i].lcms == profile_class) {
-			priv->kind = map_profile_kind[i].colord;
-			break;
-		}
-	}
+	kind = cd_icc_profile_kind_from_lcms (profile_class);
+	if (kind != CD_PROFILE_KIND_LAST)
+		priv->kind = kind;
 
 	/* convert colorspace */
 	colorspace = cmsGetColorSpace (priv->lcms_profile);
-	for (i = 0; map_colorspace[i].colord != CD_COLORSPACE_LAST; i++) {
-		if (map_colorspace[i].lcms == colorspace) {
-			priv->colorspace = map_colorspace[i].colord;
-			break;
-		}
-	}
+	colorspace_tmp = cd_icc_colorspace_from_lcms (colorspace);
+	if (colorspace_tmp != CD_COLORSPACE_LAST)
+		priv->colorspace = colorspace_tmp;
 
 	/* read optional metadata? */
 	if ((flags & CD_ICC_LOAD_FLAGS_METADATA) > 0) {
@@ -1121,14 +1309,10 @@ cd_icc_load (CdIcc *icc, CdIccLoadFlags flags, GError **error)
 	/* get precooked profile ID if one exists */
 	priv->checksum = cd_icc_get_precooked_md5 (priv->lcms_profile);
 
-	/* read default translations */
-	cd_icc_get_description (icc, NULL, NULL);
-	cd_icc_get_copyright (icc, NULL, NULL);
-	cd_icc_get_manufacturer (icc, NULL, NULL);
-	cd_icc_get_model (icc, NULL, NULL);
-	if ((flags & CD_ICC_LOAD_FLAGS_TRANSLATIONS) > 0) {
-		/* FIXME: get the locale list from LCMS */
-	}
+	/* the default translations are only read when first used, but the
+	 * client can ask for every translation to be read up front */
+	if ((flags & CD_ICC_LOAD_FLAGS_TRANSLATIONS) > 0)
+		cd_icc_load_mluc_translations (icc);
 
 	/* read named colors if the client cares */
 	if ((flags & CD_ICC_LOAD_FLAGS_NAMED_COLORS) > 0) {
@@ -1513,6 +1697,8 @@ cd_icc_serialize_profile (CdIcc *icc, GError **error)
 	gboolean ret;
 	g_autofree gchar *data_tmp = NULL;
 
+	cd_icc_reload_handle (icc);
+
 	/* get size of profile */
 	ret = cmsSaveProfileToMem (priv->lcms_profile,
 				   NULL, &length);
@@ -1551,52 +1737,35 @@ cd_icc_serialize_profile (CdIcc *icc, GError **error)
 	return g_bytes_new (data_tmp, length);
 }
 
-/**
- * cd_icc_save_data:
- * @icc: a #CdIcc instance.
- * @flags: a set of #CdIccSaveFlags
- * @error: A #GError or %NULL
- *
- * Saves an ICC profile to an allocated memory location.
- *
- * Return vale: A #GBytes structure, or %NULL for error
- *
- * Since: 1.0.2
- **/
-GBytes *
-cd_icc_save_data (CdIcc *icc,
-		  CdIccSaveFlags flags,
-		  GError **error)
+/* writes the cached values back into the lcms profile */
+static gboolean
+cd_icc_save_prepare (CdIcc *icc, GError **error)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	cmsHANDLE dict = NULL;
 	const gchar *key;
 	const gchar *value;
 	gboolean ret = FALSE;
-	GBytes *data = NULL;
 	GList *l;
-	guint i;
+	cmsColorSpaceSignature colorspace;
+	cmsProfileClassSignature profile_class;
 	g_autoptr(GList) md_keys = NULL;
 
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	cd_icc_reload_handle (icc);
+
+	/* the translations are written from the cache, so make sure the
+	 * defaults from the original profile are not lost */
+	cd_icc_load_mluc_defaults (icc);
 
 	/* convert profile kind */
-	for (i = 0; map_profile_kind[i].colord != CD_PROFILE_KIND_LAST; i++) {
-		if (map_profile_kind[i].colord == priv->kind) {
-			cmsSetDeviceClass (priv->lcms_profile,
-					   map_profile_kind[i].lcms);
-			break;
-		}
-	}
+	profile_class = cd_icc_profile_kind_to_lcms (priv->kind);
+	if (profile_class != 0)
+		cmsSetDeviceClass (priv->lcms_profile, profile_class);
 
 	/* convert colorspace */
-	for (i = 0; map_colorspace[i].colord != CD_COLORSPACE_LAST; i++) {
-		if (map_colorspace[i].colord == priv->colorspace) {
-			cmsSetColorSpace (priv->lcms_profile,
-					  map_colorspace[i].lcms);
-			break;
-		}
-	}
+	colorspace = cd_icc_colorspace_to_lcms (priv->colorspace);
+	if (colorspace != 0)
+		cmsSetColorSpace (priv->lcms_profile, colorspace);
 
 	/* set version */
 	if (priv->version > 0.0)
@@ -1701,6 +1870,37 @@ cd_icc_save_data (CdIcc *icc,
 		if (!ret)
 			goto out;
 	}
+out:
+	if (dict != NULL)
+		cmsDictFree (dict);
+	return ret;
+}
+
+/**
+ * cd_icc_save_data:
+ * @icc: a #CdIcc instance.
+ * @flags: a set of #CdIccSaveFlags
+ * @error: A #GError or %NULL
+ *
+ * Saves an ICC profile to an allocated memory location.
+ *
+ * Return vale: A #GBytes structure, or %NULL for error
+ *
+ * Since: 1.0.2
+ **/
+GBytes *
+cd_icc_save_data (CdIcc *icc,
+		  CdIccSaveFlags flags,
+		  GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	gboolean ret = FALSE;
+	GBytes *data = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+
+	if (!cd_icc_save_prepare (icc, error))
+		return NULL;
 
 	/* finally, optionally override the created date */
 	if (priv->creation_time != -1) {
@@ -1751,145 +1951,493 @@ cd_icc_save_data (CdIcc *icc,
 	}
 	data = cd_icc_serialize_profile (icc, error);
 out:
-	if (dict != NULL)
-		cmsDictFree (dict);
 	return data;
 }
 
-/**
- * cd_icc_get_characterization_data:
- * @icc: a #CdIcc instance.
- *
- * Gets any characterization data used to build the profile.
- * This function will only return results if the profile was loaded with the
- * %CD_ICC_LOAD_FLAGS_CHARACTERIZATION flag.
- *
- * Return value: TI3 string data
- *
- * Since: 1.1.1
- **/
-const gchar *
-cd_icc_get_characterization_data (CdIcc *icc)
-{
-	CdIccPrivate *priv = GET_PRIVATE (icc);
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
-	return priv->characterization_data;
-}
+typedef struct {
+	cmsTagSignature		 sig;
+	guint32			 offset;
+	guint32			 size;
+	gboolean		 linked;
+} CdIccStreamTag;
 
-/**
- * cd_icc_set_characterization_data:
- * @icc: a #CdIcc instance.
- * @data: TI3 string data, or %NULL
- *
- * Sets the characterization data used to build the profile.
- *
- * Since: 1.1.1
- **/
-void
-cd_icc_set_characterization_data (CdIcc *icc, const gchar *data)
-{
-	CdIccPrivate *priv = GET_PRIVATE (icc);
-	g_return_if_fail (CD_IS_ICC (icc));
-	g_free (priv->characterization_data);
-	priv->characterization_data = g_strdup (data);
-}
+#define CD_ICC_STREAM_ALIGN(x)		(((x) + 3) & ~3u)
 
-/**
- * cd_icc_save_file:
- * @icc: a #CdIcc instance.
- * @file: a #GFile
- * @flags: a set of #CdIccSaveFlags
- * @cancellable: A #GCancellable or %NULL
- * @error: A #GError or %NULL
- *
- * Saves an ICC profile to a local or remote file.
- *
- * Return vale: %TRUE for success.
- *
- * Since: 0.1.32
- **/
-gboolean
-cd_icc_save_file (CdIcc *icc,
-		  GFile *file,
-		  CdIccSaveFlags flags,
-		  GCancellable *cancellable,
-		  GError **error)
+static gboolean
+cd_icc_stream_write (GOutputStream *stream,
+		     GChecksum *csum,
+		     const guint8 *data,
+		     gsize len,
+		     GCancellable *cancellable,
+		     GError **error)
 {
-	gboolean ret;
-	g_autoptr(GBytes) data = NULL;
 	g_autoptr(GError) error_local = NULL;
 
-	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
-	g_return_val_if_fail (G_IS_FILE (file), FALSE);
-
-	/* get data */
-	data = cd_icc_save_data (icc, flags, error);
-	if (data == NULL)
-		return FALSE;
-
-	/* ensure parent directories exist */
-	if (!cd_icc_save_file_mkdir_parents (file, error))
-		return FALSE;
-
-	/* actually write file */
-	ret = g_file_replace_contents (file,
-				       g_bytes_get_data (data, NULL),
-				       g_bytes_get_size (data),
-				       NULL,
-				       FALSE,
-				       G_FILE_CREATE_NONE,
-				       NULL,
-				       cancellable,
-				       &error_local);
-	if (!ret) {
+	if (csum != NULL)
+		g_checksum_update (csum, data, len);
+	if (stream == NULL)
+		return TRUE;
+	if (!g_output_stream_write_all (stream, data, len, NULL,
+					cancellable, &error_local)) {
 		g_set_error (error,
 			     CD_ICC_ERROR,
 			     CD_ICC_ERROR_FAILED_TO_SAVE,
-			     "failed to save ICC file: %s",
+			     "failed to write ICC data: %s",
 			     error_local->message);
 		return FALSE;
 	}
 	return TRUE;
 }
 
-/**
- * cd_icc_save_default:
- * @icc: a #CdIcc instance.
- * @flags: a set of #CdIccSaveFlags
- * @cancellable: A #GCancellable or %NULL
- * @error: A #GError or %NULL
- *
- * Saves an ICC profile to the default per-user location.
- *
- * Return vale: %TRUE for success.
- *
- * Since: 1.1.1
- **/
-gboolean
-cd_icc_save_default (CdIcc *icc,
-		     CdIccSaveFlags flags,
-		     GCancellable *cancellable,
-		     GError **error)
+/* gets the tag directory with the offsets the data will be written at */
+static GArray *
+cd_icc_stream_get_tags (CdIcc *icc, guint32 *size, GError **error)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	const gchar *root = "edid"; /* TODO: only for cd_icc_create_from_edid() */
-	g_autofree gchar *basename = NULL;
-	g_autofree gchar *filename = NULL;
-	g_autoptr(GFile) file = NULL;
-
-	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	CdIccStreamTag *tag;
+	CdIccStreamTag *tmp;
+	cmsTagSignature link;
+	guint64 offset;
+	guint i;
+	guint j;
+	guint tag_count;
+	g_autoptr(GArray) tags = NULL;
+
+	/* deleted tags are left in the directory with no signature */
+	tags = g_array_new (FALSE, TRUE, sizeof (CdIccStreamTag));
+	tag_count = cmsGetTagCount (priv->lcms_profile);
+	for (i = 0; i < tag_count; i++) {
+		CdIccStreamTag item = { 0 };
+		item.sig = cmsGetTagSignature (priv->lcms_profile, i);
+		if (item.sig == 0)
+			continue;
+		g_array_append_val (tags, item);
+	}
 
-	/* build a per-user filename */
-	basename = g_strdup_printf ("%s-%s.icc", root, priv->checksum);
-	filename = g_build_filename (g_get_user_data_dir (), "icc", basename, NULL);
-	file = g_file_new_for_path (filename);
-	return cd_icc_save_file (icc, file, flags, cancellable, error);
-}
+	/* linked tags share the data of the tag they point to */
+	for (i = 0; i < tags->len; i++) {
+		tag = &g_array_index (tags, CdIccStreamTag, i);
+		link = cmsTagLinkedTo (priv->lcms_profile, tag->sig);
+		if (link == 0)
+			continue;
+		for (j = 0; j < tags->len; j++) {
+			tmp = &g_array_index (tags, CdIccStreamTag, j);
+			if (tmp->sig == link && tmp->sig != tag->sig) {
+				tag->linked = TRUE;
+				break;
+			}
+		}
+	}
 
-/**
- * cd_icc_set_filename:
- * @icc: a #CdIcc instance.
- * @filename: a filename, or %NULL
+	/* lcms serializes any tags that have been changed to get the size */
+	offset = sizeof(cmsICCHeader) + sizeof(cmsUInt32Number) +
+		 tags->len * sizeof(cmsTagEntry);
+	for (i = 0; i < tags->len; i++) {
+		tag = &g_array_index (tags, CdIccStreamTag, i);
+		if (tag->linked)
+			continue;
+		tag->size = cmsReadRawTag (priv->lcms_profile, tag->sig, NULL, 0);
+		if (tag->size == 0) {
+			gchar sig_string[5];
+			cd_icc_uint32_to_str (GUINT32_FROM_BE (tag->sig), sig_string);
+			g_set_error (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_SAVE,
+				     "failed to serialize tag %s",
+				     sig_string);
+			return NULL;
+		}
+		tag->offset = offset;
+		offset += CD_ICC_STREAM_ALIGN (tag->size);
+		if (offset > G_MAXUINT32) {
+			g_set_error_literal (error,
+					     CD_ICC_ERROR,
+					     CD_ICC_ERROR_FAILED_TO_SAVE,
+					     "ICC profile is too large");
+			return NULL;
+		}
+	}
+	for (i = 0; i < tags->len; i++) {
+		tag = &g_array_index (tags, CdIccStreamTag, i);
+		if (!tag->linked)
+			continue;
+		link = cmsTagLinkedTo (priv->lcms_profile, tag->sig);
+		for (j = 0; j < tags->len; j++) {
+			tmp = &g_array_index (tags, CdIccStreamTag, j);
+			if (tmp->sig == link) {
+				tag->offset = tmp->offset;
+				tag->size = tmp->size;
+				break;
+			}
+		}
+	}
+	*size = offset;
+	return g_steal_pointer (&tags);
+}
+
+/* builds the header and tag directory the same way as lcms does */
+static GByteArray *
+cd_icc_stream_get_header (CdIcc *icc,
+			  GArray *tags,
+			  guint32 size,
+			  gboolean for_checksum,
+			  const guint8 *profile_id,
+			  GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	CdIccStreamTag *tag;
+	GByteArray *buf;
+	cmsICCHeader header;
+	cmsTagEntry entry;
+	cmsUInt32Number tag_count;
+	cmsUInt64Number attributes;
+	struct tm created;
+	guint i;
+
+	/* get the creation time, which may have been overridden */
+	if (priv->creation_time != -1) {
+		time_t creation_time_timet = priv->creation_time;
+		if (!gmtime_r (&creation_time_timet, &created)) {
+			g_set_error (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_SAVE,
+				     "failed to translate creation time: %s (%i)",
+				     g_strerror (errno),
+				     errno);
+			return NULL;
+		}
+	} else if (!cmsGetHeaderCreationDateTime (priv->lcms_profile, &created)) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_SAVE,
+				     "failed to get creation time");
+		return NULL;
+	}
+
+	/* the profile ID is calculated with the flags and intent cleared */
+	memset (&header, 0, sizeof(header));
+	header.size = _cmsAdjustEndianess32 (size);
+	header.cmmId = _cmsAdjustEndianess32 (lcmsSignature);
+	header.version = _cmsAdjustEndianess32 (cmsGetEncodedICCversion (priv->lcms_profile));
+	header.deviceClass = _cmsAdjustEndianess32 (cmsGetDeviceClass (priv->lcms_profile));
+	header.colorSpace = _cmsAdjustEndianess32 (cmsGetColorSpace (priv->lcms_profile));
+	header.pcs = _cmsAdjustEndianess32 (cmsGetPCS (priv->lcms_profile));
+	_cmsEncodeDateTimeNumber (&header.date, &created);
+	header.magic = _cmsAdjustEndianess32 (cmsMagicNumber);
+#ifdef G_OS_WIN32
+	header.platform = _cmsAdjustEndianess32 (cmsSigMicrosoft);
+#else
+	header.platform = _cmsAdjustEndianess32 (cmsSigMacintosh);
+#endif
+	header.manufacturer = _cmsAdjustEndianess32 (cmsGetHeaderManufacturer (priv->lcms_profile));
+	header.model = _cmsAdjustEndianess32 (cmsGetHeaderModel (priv->lcms_profile));
+	cmsGetHeaderAttributes (priv->lcms_profile, &attributes);
+	_cmsAdjustEndianess64 (&header.attributes, &attributes);
+	header.illuminant.X = _cmsAdjustEndianess32 (_cmsDoubleTo15Fixed16 (cmsD50_XYZ()->X));
+	header.illuminant.Y = _cmsAdjustEndianess32 (_cmsDoubleTo15Fixed16 (cmsD50_XYZ()->Y));
+	header.illuminant.Z = _cmsAdjustEndianess32 (_cmsDoubleTo15Fixed16 (cmsD50_XYZ()->Z));
+	header.creator = _cmsAdjustEndianess32 (lcmsSignature);
+	if (!for_checksum) {
+		header.flags = _cmsAdjustEndianess32 (cmsGetHeaderFlags (priv->lcms_profile));
+		header.renderingIntent = _cmsAdjustEndianess32 (cmsGetHeaderRenderingIntent (priv->lcms_profile));
+		memcpy (header.profileID.ID8, profile_id, 16);
+	}
+
+	/* add the tag directory */
+	buf = g_byte_array_sized_new (sizeof(header) + sizeof(tag_count) +
+				      tags->len * sizeof(cmsTagEntry));
+	g_byte_array_append (buf, (const guint8 *) &header, sizeof(header));
+	tag_count = _cmsAdjustEndianess32 (tags->len);
+	g_byte_array_append (buf, (const guint8 *) &tag_count, sizeof(tag_count));
+	for (i = 0; i < tags->len; i++) {
+		tag = &g_array_index (tags, CdIccStreamTag, i);
+		entry.sig = _cmsAdjustEndianess32 (tag->sig);
+		entry.offset = _cmsAdjustEndianess32 (tag->offset);
+		entry.size = _cmsAdjustEndianess32 (tag->size);
+		g_byte_array_append (buf, (const guint8 *) &entry, sizeof(entry));
+	}
+	return buf;
+}
+
+/* only one tag is held in memory at any time */
+static gboolean
+cd_icc_stream_write_tags (CdIcc *icc,
+			  GArray *tags,
+			  GOutputStream *stream,
+			  GChecksum *csum,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	CdIccStreamTag *tag;
+	guint i;
+
+	for (i = 0; i < tags->len; i++) {
+		guint32 len;
+		g_autofree guint8 *data = NULL;
+
+		tag = &g_array_index (tags, CdIccStreamTag, i);
+		if (tag->linked)
+			continue;
+		len = CD_ICC_STREAM_ALIGN (tag->size);
+		data = g_malloc0 (len);
+		if (cmsReadRawTag (priv->lcms_profile, tag->sig,
+				   data, tag->size) != tag->size) {
+			g_set_error_literal (error,
+					     CD_ICC_ERROR,
+					     CD_ICC_ERROR_FAILED_TO_SAVE,
+					     "failed to serialize tag data");
+			return FALSE;
+		}
+		if (!cd_icc_stream_write (stream, csum, data, len,
+					  cancellable, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_icc_save_stream:
+ * @icc: a #CdIcc instance.
+ * @stream: a #GOutputStream
+ * @flags: a set of #CdIccSaveFlags
+ * @cancellable: A #GCancellable or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Writes an ICC profile to a stream. Unlike cd_icc_save_data() the profile is
+ * never built in memory, and only the data of one tag is held at any time.
+ *
+ * The tags are serialized twice, once to compute the profile ID and once to
+ * write the data, and so @stream does not have to be seekable.
+ *
+ * Return vale: %TRUE for success.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_save_stream (CdIcc *icc,
+		    GOutputStream *stream,
+		    CdIccSaveFlags flags,
+		    GCancellable *cancellable,
+		    GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	guint32 size = 0;
+	guint8 profile_id[16];
+	gsize profile_id_len = sizeof(profile_id);
+	g_autoptr(GArray) tags = NULL;
+	g_autoptr(GByteArray) header = NULL;
+	g_autoptr(GChecksum) csum = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+	g_return_val_if_fail (priv->lcms_profile != NULL, FALSE);
+
+	if (!cd_icc_save_prepare (icc, error))
+		return FALSE;
+
+	/* compute the layout */
+	tags = cd_icc_stream_get_tags (icc, &size, error);
+	if (tags == NULL)
+		return FALSE;
+
+	/* compute the profile ID */
+	csum = g_checksum_new (G_CHECKSUM_MD5);
+	header = cd_icc_stream_get_header (icc, tags, size, TRUE, NULL, error);
+	if (header == NULL)
+		return FALSE;
+	g_checksum_update (csum, header->data, header->len);
+	if (!cd_icc_stream_write_tags (icc, tags, NULL, csum, cancellable, error))
+		return FALSE;
+	g_checksum_get_digest (csum, profile_id, &profile_id_len);
+
+	/* write the real thing */
+	g_byte_array_unref (header);
+	header = cd_icc_stream_get_header (icc, tags, size, FALSE, profile_id, error);
+	if (header == NULL)
+		return FALSE;
+	if (!cd_icc_stream_write (stream, NULL, header->data, header->len,
+				  cancellable, error))
+		return FALSE;
+	return cd_icc_stream_write_tags (icc, tags, stream, NULL, cancellable, error);
+}
+
+/**
+ * cd_icc_get_characterization_data:
+ * @icc: a #CdIcc instance.
+ *
+ * Gets any characterization data used to build the profile.
+ * This function will only return results if the profile was loaded with the
+ * %CD_ICC_LOAD_FLAGS_CHARACTERIZATION flag.
+ *
+ * Return value: TI3 string data
+ *
+ * Since: 1.1.1
+ **/
+const gchar *
+cd_icc_get_characterization_data (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	return priv->characterization_data;
+}
+
+/**
+ * cd_icc_set_characterization_data:
+ * @icc: a #CdIcc instance.
+ * @data: TI3 string data, or %NULL
+ *
+ * Sets the characterization data used to build the profile.
+ *
+ * Since: 1.1.1
+ **/
+void
+cd_icc_set_characterization_data (CdIcc *icc, const gchar *data)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_if_fail (CD_IS_ICC (icc));
+	g_free (priv->characterization_data);
+	priv->characterization_data = g_strdup (data);
+}
+
+/**
+ * cd_icc_save_file:
+ * @icc: a #CdIcc instance.
+ * @file: a #GFile
+ * @flags: a set of #CdIccSaveFlags
+ * @cancellable: A #GCancellable or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Saves an ICC profile to a local or remote file.
+ *
+ * Return vale: %TRUE for success.
+ *
+ * Since: 0.1.32
+ **/
+gboolean
+cd_icc_save_file (CdIcc *icc,
+		  GFile *file,
+		  CdIccSaveFlags flags,
+		  GCancellable *cancellable,
+		  GError **error)
+{
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GFileOutputStream) stream = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
+
+	/* ensure parent directories exist */
+	if (!cd_icc_save_file_mkdir_parents (file, error))
+		return FALSE;
+
+	/* the file is only replaced when the stream is closed */
+	stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+				 cancellable, &error_local);
+	if (stream == NULL) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_SAVE,
+			     "failed to save ICC file: %s",
+			     error_local->message);
+		return FALSE;
+	}
+	if (!cd_icc_save_stream (icc, G_OUTPUT_STREAM (stream), flags,
+				 cancellable, error)) {
+		g_autoptr(GCancellable) cancellable_close = g_cancellable_new ();
+
+		/* do not replace the original file with a partial one */
+		g_cancellable_cancel (cancellable_close);
+		g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable_close, NULL);
+		return FALSE;
+	}
+	if (!g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, &error_local)) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_SAVE,
+			     "failed to save ICC file: %s",
+			     error_local->message);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_icc_save_fd:
+ * @icc: a #CdIcc instance.
+ * @fd: a file descriptor open for writing
+ * @flags: a set of #CdIccSaveFlags
+ * @cancellable: A #GCancellable or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Writes an ICC profile to an open file descriptor, which is not closed.
+ *
+ * Return vale: %TRUE for success.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_save_fd (CdIcc *icc,
+		gint fd,
+		CdIccSaveFlags flags,
+		GCancellable *cancellable,
+		GError **error)
+{
+#ifdef __unix__
+	g_autoptr(GOutputStream) stream = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (fd >= 0, FALSE);
+
+	stream = g_unix_output_stream_new (fd, FALSE);
+	return cd_icc_save_stream (icc, stream, flags, cancellable, error);
+#else
+	g_set_error_literal (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_SAVE,
+			     "saving to a file descriptor is not supported");
+	return FALSE;
+#endif
+}
+
+/**
+ * cd_icc_save_default:
+ * @icc: a #CdIcc instance.
+ * @flags: a set of #CdIccSaveFlags
+ * @cancellable: A #GCancellable or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Saves an ICC profile to the default per-user location.
+ *
+ * Return vale: %TRUE for success.
+ *
+ * Since: 1.1.1
+ **/
+gboolean
+cd_icc_save_default (CdIcc *icc,
+		     CdIccSaveFlags flags,
+		     GCancellable *cancellable,
+		     GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	const gchar *root = "edid"; /* TODO: only for cd_icc_create_from_edid() */
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+
+	/* build a per-user filename */
+	basename = g_strdup_printf ("%s-%s.icc", root, priv->checksum);
+	filename = g_build_filename (g_get_user_data_dir (), "icc", basename, NULL);
+	file = g_file_new_for_path (filename);
+	return cd_icc_save_file (icc, file, flags, cancellable, error);
+}
+
+/**
+ * cd_icc_set_filename:
+ * @icc: a #CdIcc instance.
+ * @filename: a filename, or %NULL
  *
  * Sets the filename, which may be required if the ICC profile has been loaded
  * using cd_icc_load_fd() from a disk cache.
@@ -1899,9 +2447,225 @@ cd_icc_save_default (CdIcc *icc,
 void
 cd_icc_set_filename (CdIcc *icc, const gchar *filename)
 {
-	CdIccPrivate *priv = GET_PRIVATE (icc);
-	g_free (priv->filename);
-	priv->filename = g_strdup (filename);
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_free (priv->filename);
+	priv->filename = g_strdup (filename);
+}
+
+/**
+ * cd_icc_set_checksum:
+ * @icc: a #CdIcc instance.
+ * @checksum: a MD5 checksum, or %NULL
+ *
+ * Sets the checksum, which may be required if the file checksum has been
+ * saved in an external cache rather than computed using
+ * %CD_ICC_LOAD_FLAGS_FALLBACK_MD5.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_icc_set_checksum (CdIcc *icc, const gchar *checksum)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_if_fail (CD_IS_ICC (icc));
+	g_free (priv->checksum);
+	priv->checksum = g_strdup (checksum);
+}
+
+/*
+ * Touching a mapped page after the file has been truncated raises SIGBUS,
+ * so only files that just root can write to are mapped. These are the
+ * system profiles, which package managers replace rather than rewrite in
+ * place. Anything else is read into memory.
+ */
+static gboolean
+cd_icc_file_can_map (const gchar *filename)
+{
+#ifdef __unix__
+	GStatBuf st;
+
+	if (g_stat (filename, &st) != 0)
+		return FALSE;
+	if (!S_ISREG (st.st_mode) || st.st_uid != 0)
+		return FALSE;
+	return (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+#else
+	return FALSE;
+#endif
+}
+
+/* reads an ICC profile directly from a mapped file, so that only the
+ * header, the tag table and the tags that are used are ever paged in */
+typedef struct {
+	GMappedFile		*mapped_file;
+	const guint8		*data;
+	cmsUInt32Number		 size;
+	cmsUInt32Number		 pointer;
+} CdIccMappedStream;
+
+static cmsUInt32Number
+cd_icc_mapped_stream_read (cmsIOHANDLER *iohandler,
+			   void *buffer,
+			   cmsUInt32Number size,
+			   cmsUInt32Number count)
+{
+	CdIccMappedStream *stream = (CdIccMappedStream *) iohandler->stream;
+	cmsUInt32Number len;
+
+	if (!g_uint_checked_mul (&len, size, count))
+		return 0;
+	if (len > stream->size - stream->pointer)
+		return 0;
+	memcpy (buffer, stream->data + stream->pointer, len);
+	stream->pointer += len;
+	return count;
+}
+
+static cmsBool
+cd_icc_mapped_stream_seek (cmsIOHANDLER *iohandler, cmsUInt32Number offset)
+{
+	CdIccMappedStream *stream = (CdIccMappedStream *) iohandler->stream;
+	if (offset > stream->size)
+		return FALSE;
+	stream->pointer = offset;
+	return TRUE;
+}
+
+static cmsUInt32Number
+cd_icc_mapped_stream_tell (cmsIOHANDLER *iohandler)
+{
+	CdIccMappedStream *stream = (CdIccMappedStream *) iohandler->stream;
+	return stream->pointer;
+}
+
+static cmsBool
+cd_icc_mapped_stream_write (cmsIOHANDLER *iohandler,
+			    cmsUInt32Number size,
+			    const void *buffer)
+{
+	return FALSE;
+}
+
+static cmsBool
+cd_icc_mapped_stream_close (cmsIOHANDLER *iohandler)
+{
+	CdIccMappedStream *stream = (CdIccMappedStream *) iohandler->stream;
+	g_mapped_file_unref (stream->mapped_file);
+	g_free (stream);
+	g_free (iohandler);
+	return TRUE;
+}
+
+static gboolean
+cd_icc_load_mapped (CdIcc *icc,
+		    const gchar *filename,
+		    CdIccLoadFlags flags,
+		    GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	CdIccMappedStream *stream;
+	cmsIOHANDLER *iohandler;
+	gsize length;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+
+	mapped_file = g_mapped_file_new (filename, FALSE, &error_local);
+	if (mapped_file == NULL) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_OPEN,
+			     "failed to load file: %s",
+			     error_local->message);
+		return FALSE;
+	}
+
+	/* ensure we have the header */
+	length = g_mapped_file_get_length (mapped_file);
+	if (length < 0x84) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "icc was not valid (file size too small)");
+		return FALSE;
+	}
+	if (length > G_MAXUINT32) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "icc was not valid (file size too large)");
+		return FALSE;
+	}
+
+	/* lcms owns the handler and closes it with the profile */
+	stream = g_new0 (CdIccMappedStream, 1);
+	stream->mapped_file = g_mapped_file_ref (mapped_file);
+	stream->data = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+	stream->size = length;
+	iohandler = g_new0 (cmsIOHANDLER, 1);
+	iohandler->stream = stream;
+	iohandler->ContextID = priv->context_lcms;
+	iohandler->ReportedSize = length;
+	iohandler->Read = cd_icc_mapped_stream_read;
+	iohandler->Seek = cd_icc_mapped_stream_seek;
+	iohandler->Close = cd_icc_mapped_stream_close;
+	iohandler->Tell = cd_icc_mapped_stream_tell;
+	iohandler->Write = cd_icc_mapped_stream_write;
+	g_strlcpy (iohandler->PhysicalFile, filename, sizeof (iohandler->PhysicalFile));
+	priv->lcms_profile = cmsOpenProfileFromIOhandlerTHR (priv->context_lcms,
+							     iohandler);
+	if (priv->lcms_profile == NULL) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "failed to load: not an ICC icc");
+		return FALSE;
+	}
+
+	/* save length to avoid trusting the profile */
+	priv->size = length;
+
+	/* load cached data */
+	if (!cd_icc_load (icc, flags, error))
+		return FALSE;
+
+	/* calculate the data MD5 if there was no embedded profile */
+	if (priv->checksum == NULL &&
+	    (flags & CD_ICC_LOAD_FLAGS_FALLBACK_MD5) > 0) {
+		priv->checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+							      (const guchar *) g_mapped_file_get_contents (mapped_file),
+							      length);
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_icc_load_remote (CdIcc *icc,
+		    GFile *file,
+		    CdIccLoadFlags flags,
+		    GCancellable *cancellable,
+		    GError **error)
+{
+	gsize length;
+	g_autoptr(GError) error_local = NULL;
+	g_autofree gchar *data = NULL;
+
+	/* load files */
+	if (!g_file_load_contents (file, cancellable, &data, &length,
+				   NULL, &error_local)) {
+		g_set_error (error,
+			     CD_ICC_ERROR,
+			     CD_ICC_ERROR_FAILED_TO_OPEN,
+			     "failed to load file: %s",
+			     error_local->message);
+		return FALSE;
+	}
+
+	/* parse the data */
+	return cd_icc_load_data (icc,
+				 (const guint8 *) data,
+				 length,
+				 flags,
+				 error);
 }
 
 /**
@@ -1914,6 +2678,11 @@ cd_icc_set_filename (CdIcc *icc, const gchar *filename)
  *
  * Loads an ICC profile from a local or remote file.
  *
+ * Local files that only root can write to are mapped into memory rather
+ * than being read, and the tags are only decoded when they are first used.
+ * Other files are read, as truncating a mapped file would crash the
+ * process.
+ *
  * Since: 0.1.32
  **/
 gboolean
@@ -1925,32 +2694,19 @@ cd_icc_load_file (CdIcc *icc,
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	gboolean ret = FALSE;
-	gsize length;
 	g_autoptr(GError) error_local = NULL;
-	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
 	g_autoptr(GFileInfo) info = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
-	/* load files */
-	ret = g_file_load_contents (file, cancellable, &data, &length,
-				    NULL, &error_local);
-	if (!ret) {
-		g_set_error (error,
-			     CD_ICC_ERROR,
-			     CD_ICC_ERROR_FAILED_TO_OPEN,
-			     "failed to load file: %s",
-			     error_local->message);
-		return FALSE;
-	}
-
-	/* parse the data */
-	ret = cd_icc_load_data (icc,
-				(const guint8 *) data,
-				length,
-				flags,
-				error);
+	/* load system files without copying them */
+	filename = g_file_get_path (file);
+	if (filename != NULL && cd_icc_file_can_map (filename))
+		ret = cd_icc_load_mapped (icc, filename, flags, error);
+	else
+		ret = cd_icc_load_remote (icc, file, flags, cancellable, error);
 	if (!ret)
 		return FALSE;
 
@@ -1972,7 +2728,7 @@ cd_icc_load_file (CdIcc *icc,
 							      G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE);
 
 	/* save filename for later */
-	priv->filename = g_file_get_path (file);
+	priv->filename = g_steal_pointer (&filename);
 	return TRUE;
 }
 
@@ -2015,103 +2771,450 @@ cd_icc_load_fd (CdIcc *icc,
 	if (priv->lcms_profile == NULL) {
 		g_set_error_literal (error,
 				     CD_ICC_ERROR,
-				     CD_ICC_ERROR_FAILED_TO_OPEN,
-				     "failed to open stream");
+				     CD_ICC_ERROR_FAILED_TO_OPEN,
+				     "failed to open stream");
+		return FALSE;
+	}
+
+	/* load cached data */
+	return cd_icc_load (icc, flags, error);
+}
+
+/**
+ * cd_icc_get_handle:
+ * @icc: a #CdIcc instance.
+ *
+ * Return the cmsHPROFILE instance used locally. This may be required if you
+ * are using the profile in a transform.
+ *
+ * Return value: (transfer none): Do not call cmsCloseProfile() on this value!
+ **/
+gpointer
+cd_icc_get_handle (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	cd_icc_reload_handle (icc);
+	return priv->lcms_profile;
+}
+
+/**
+ * cd_icc_get_context:
+ * @icc: a #CdIcc instance.
+ *
+ * Return the cmsContext instance used locally. This may be required if you
+ * are using native LCMS calls and then cd_icc_load_handle().
+ *
+ * The context is shared with every other #CdIcc instance in the process,
+ * so do not change its state, for instance by calling cmsSetAlarmCodesTHR().
+ *
+ * Return value: (transfer none): Do not call cmsDeleteContext() on this value!
+ *
+ * Since: 1.1.7
+ **/
+gpointer
+cd_icc_get_context (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	return priv->context_lcms;
+}
+
+/**
+ * cd_icc_load_handle:
+ * @icc: a #CdIcc instance.
+ * @handle: a cmsHPROFILE instance
+ * @flags: a set of #CdIccLoadFlags
+ * @error: A #GError or %NULL
+ *
+ * Set the internal cmsHPROFILE instance. This may be required if you create
+ * the profile using cmsCreateRGBProfileTHR() and then want to use the
+ * functionality in #CdIcc.
+ *
+ * Do not call cmsCloseProfile() on @handle in the caller, this will be done
+ * when the @icc object is finalized. Treat the profile like it's been adopted
+ * by this module.
+ *
+ * To handle the internal error callback, you should use the thread-safe
+ * creation function, e.g. cmsCreateNULLProfileTHR(). The @context_id should be
+ * set as the value of cd_icc_get_context() for this object.
+ *
+ * Additionally, this function cannot be called more than once, and also can't
+ * be called if cd_icc_load_file() has previously been used on the @icc object.
+ *
+ * Since: 0.1.33
+ **/
+gboolean
+cd_icc_load_handle (CdIcc *icc,
+		    gpointer handle,
+		    CdIccLoadFlags flags,
+		    GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	cmsContext context;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (handle != NULL, FALSE);
+	g_return_val_if_fail (priv->lcms_profile == NULL, FALSE);
+
+	/* check the THR version has been correctly set up */
+	context = cmsGetProfileContextID (handle);
+	if (context == NULL) {
+		cmsCloseProfile (handle);
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_CREATE,
+				     "lcms2 threadsafe version (THR) not used, "
+				     "or context not set");
+		return FALSE;
+	}
+
+	/* load profile */
+	priv->lcms_profile = handle;
+	return cd_icc_load (icc, flags, error);
+}
+
+/* the header and tag table can be parsed without lcms */
+#define CD_ICC_HEADER_SIZE		128
+
+static guint32
+cd_icc_peek_uint32 (const guint8 *data)
+{
+	guint32 tmp;
+	memcpy (&tmp, data, sizeof (tmp));
+	return GUINT32_FROM_BE (tmp);
+}
+
+static guint16
+cd_icc_peek_uint16 (const guint8 *data)
+{
+	guint16 tmp;
+	memcpy (&tmp, data, sizeof (tmp));
+	return GUINT16_FROM_BE (tmp);
+}
+
+/* converts big endian UTF-16 to UTF-8 */
+static gchar *
+cd_icc_peek_utf16 (const guint8 *data, gsize len)
+{
+	gsize n = len / 2;
+	g_autofree gunichar2 *tmp = g_new (gunichar2, n + 1);
+
+	cd_buffer_read_uint16_be_array (data, tmp, n);
+	tmp[n] = 0;
+	return g_utf16_to_utf8 (tmp, n, NULL, NULL, NULL);
+}
+
+static gchar *
+cd_icc_peek_text (const guint8 *tag, gsize tag_len)
+{
+	guint32 type;
+
+	if (tag_len < 12)
+		return NULL;
+	type = cd_icc_peek_uint32 (tag);
+
+	/* ICC v2 textDescriptionType with a 7-bit ASCII description */
+	if (type == cmsSigTextDescriptionType) {
+		guint32 count = cd_icc_peek_uint32 (tag + 8);
+		g_autoptr(GString) str = NULL;
+		if (count == 0 || count > tag_len - 12)
+			return NULL;
+		str = g_string_new_len ((const gchar *) tag + 12, count);
+		g_string_truncate (str, strnlen (str->str, count));
+		if (!g_utf8_validate (str->str, str->len, NULL) &&
+		    !cd_icc_fix_utf8_string (str))
+			return NULL;
+		return g_string_free (g_steal_pointer (&str), FALSE);
+	}
+
+	/* ICC v4 multiLocalizedUnicodeType, preferring en_US */
+	if (type == cmsSigMultiLocalizedUnicodeType) {
+		const guint8 *rec;
+		guint32 len;
+		guint32 n_records;
+		guint32 offset;
+		guint32 record_size;
+		guint idx = 0;
+
+		if (tag_len < 16)
+			return NULL;
+		n_records = cd_icc_peek_uint32 (tag + 8);
+		record_size = cd_icc_peek_uint32 (tag + 12);
+		if (n_records == 0 || record_size < 12 ||
+		    n_records > (tag_len - 16) / record_size)
+			return NULL;
+		for (guint i = 0; i < n_records; i++) {
+			if (memcmp (tag + 16 + i * record_size, "enUS", 4) == 0) {
+				idx = i;
+				break;
+			}
+		}
+		rec = tag + 16 + idx * record_size;
+		len = cd_icc_peek_uint32 (rec + 4);
+		offset = cd_icc_peek_uint32 (rec + 8);
+		if (offset > tag_len || len > tag_len - offset)
+			return NULL;
+		return cd_icc_peek_utf16 (tag + offset, len);
+	}
+	return NULL;
+}
+
+static void
+cd_icc_peek_metadata (CdIcc *icc, const guint8 *tag, gsize tag_len)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	guint32 n_records;
+	guint32 record_size;
+
+	if (tag_len < 16 || cd_icc_peek_uint32 (tag) != cmsSigDictType)
+		return;
+	n_records = cd_icc_peek_uint32 (tag + 8);
+	record_size = cd_icc_peek_uint32 (tag + 12);
+	if (record_size < 16 || n_records > (tag_len - 16) / record_size)
+		return;
+	for (guint i = 0; i < n_records; i++) {
+		const guint8 *rec = tag + 16 + i * record_size;
+		guint32 key_offset = cd_icc_peek_uint32 (rec + 0);
+		guint32 key_len = cd_icc_peek_uint32 (rec + 4);
+		guint32 value_offset = cd_icc_peek_uint32 (rec + 8);
+		guint32 value_len = cd_icc_peek_uint32 (rec + 12);
+		gchar *key;
+		gchar *value;
+
+		if (key_offset > tag_len || key_len > tag_len - key_offset)
+			continue;
+		if (value_offset > tag_len || value_len > tag_len - value_offset)
+			continue;
+		key = cd_icc_peek_utf16 (tag + key_offset, key_len);
+		value = cd_icc_peek_utf16 (tag + value_offset, value_len);
+		if (key == NULL || value == NULL) {
+			g_free (key);
+			g_free (value);
+			continue;
+		}
+		g_hash_table_insert (priv->metadata, key, value);
+	}
+}
+
+static void
+cd_icc_peek_reset (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	for (guint i = 0; i < CD_MLUC_LAST; i++)
+		g_hash_table_remove_all (priv->mluc_data[i]);
+	g_hash_table_remove_all (priv->metadata);
+	g_clear_pointer (&priv->checksum, g_free);
+	g_clear_pointer (&priv->filename, g_free);
+	g_clear_pointer (&priv->peek_tags, g_strfreev);
+	g_clear_pointer (&priv->peek_warnings, g_array_unref);
+	priv->creation_time = -1;
+	priv->peeked = FALSE;
+}
+
+/**
+ * cd_icc_peek_data:
+ * @icc: a #CdIcc instance.
+ * @data: (array length=data_len): binary data
+ * @data_len: Length of @data
+ * @error: A #GError or %NULL
+ *
+ * Parses the header, the tag table, the description and the metadata of an
+ * ICC profile without using lcms. This is much faster than a full load and
+ * is useful when enumerating a large number of profiles.
+ *
+ * Only the kind, colorspace, version, created time, checksum, default
+ * description and metadata are available afterwards, and cd_icc_get_handle()
+ * returns %NULL. If more is needed, the same object can be loaded fully
+ * using cd_icc_load_data() or cd_icc_load_file().
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_peek_data (CdIcc *icc,
+		  const guint8 *data,
+		  gsize data_len,
+		  GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	const guint8 *description_tag = NULL;
+	struct tm created_tm = { 0 };
+	time_t created_t;
+	CdColorspace colorspace;
+	CdProfileKind kind;
+	guint32 n_tags;
+	gsize description_len = 0;
+	guint i;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (priv->lcms_profile == NULL, FALSE);
+
+	/* ensure we have the header and a valid signature */
+	if (data_len < CD_ICC_HEADER_SIZE + 4) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "icc was not valid (file size too small)");
+		return FALSE;
+	}
+	if (memcmp (data + 36, "acsp", 4) != 0) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "failed to load: not an ICC icc");
+		return FALSE;
+	}
+	if (priv->peeked)
+		cd_icc_peek_reset (icc);
+
+	/* version is encoded as BCD, e.g. 0x04300000 is 4.3 */
+	priv->version = data[8] + (data[9] >> 4) / 10.0 + (data[9] & 0x0f) / 100.0;
+
+	/* convert profile kind */
+	kind = cd_icc_profile_kind_from_lcms (cd_icc_peek_uint32 (data + 12));
+	if (kind != CD_PROFILE_KIND_LAST)
+		priv->kind = kind;
+
+	/* convert colorspace */
+	colorspace = cd_icc_colorspace_from_lcms (cd_icc_peek_uint32 (data + 16));
+	if (colorspace != CD_COLORSPACE_LAST)
+		priv->colorspace = colorspace;
+
+	/* creation time, in the same way as cmsGetHeaderCreationDateTime() */
+	created_tm.tm_year = cd_icc_peek_uint16 (data + 24) - 1900;
+	created_tm.tm_mon = cd_icc_peek_uint16 (data + 26) - 1;
+	created_tm.tm_mday = cd_icc_peek_uint16 (data + 28);
+	created_tm.tm_hour = cd_icc_peek_uint16 (data + 30);
+	created_tm.tm_min = cd_icc_peek_uint16 (data + 32);
+	created_tm.tm_sec = cd_icc_peek_uint16 (data + 34);
+	created_tm.tm_isdst = -1;
+	created_t = mktime (&created_tm);
+	if (created_t != (time_t) -1)
+		priv->creation_time = created_t;
+
+	/* get precooked profile ID if one exists */
+	priv->checksum = cd_icc_profile_id_to_md5 (data + 84);
+
+	/* find the tags we care about */
+	n_tags = cd_icc_peek_uint32 (data + CD_ICC_HEADER_SIZE);
+	if (n_tags > (data_len - CD_ICC_HEADER_SIZE - 4) / 12) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_PARSE,
+				     "icc was not valid (tag table too large)");
 		return FALSE;
 	}
+	priv->peek_tags = g_new0 (gchar *, n_tags + 1);
+	for (i = 0; i < n_tags; i++) {
+		const guint8 *entry = data + CD_ICC_HEADER_SIZE + 4 + i * 12;
+		guint32 sig = cd_icc_peek_uint32 (entry);
+		guint32 offset = cd_icc_peek_uint32 (entry + 4);
+		guint32 size = cd_icc_peek_uint32 (entry + 8);
+
+		priv->peek_tags[i] = g_strndup ((const gchar *) entry, 4);
+		if (offset > data_len || size > data_len - offset)
+			continue;
 
-	/* load cached data */
-	return cd_icc_load (icc, flags, error);
-}
-
-/**
- * cd_icc_get_handle:
- * @icc: a #CdIcc instance.
- *
- * Return the cmsHPROFILE instance used locally. This may be required if you
- * are using the profile in a transform.
- *
- * Return value: (transfer none): Do not call cmsCloseProfile() on this value!
- **/
-gpointer
-cd_icc_get_handle (CdIcc *icc)
-{
-	CdIccPrivate *priv = GET_PRIVATE (icc);
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
-	return priv->lcms_profile;
-}
+		/* the same order of preference as cd_icc_get_description() */
+		if (sig == cmsSigProfileDescriptionMLTag ||
+		    (sig == cmsSigProfileDescriptionTag && description_tag == NULL)) {
+			description_tag = data + offset;
+			description_len = size;
+		} else if (sig == cmsSigMetaTag) {
+			cd_icc_peek_metadata (icc, data + offset, size);
+		}
+	}
+	if (description_tag != NULL) {
+		gchar *description;
+		description = cd_icc_peek_text (description_tag, description_len);
+		if (description != NULL) {
+			g_hash_table_insert (priv->mluc_data[CD_MLUC_DESCRIPTION],
+					     g_strdup (""),
+					     description);
+		}
+	}
 
-/**
- * cd_icc_get_context:
- * @icc: a #CdIcc instance.
- *
- * Return the cmsContext instance used locally. This may be required if you
- * are using native LCMS calls and then cd_icc_load_handle().
- *
- * Return value: (transfer none): Do not call cmsDeleteContext() on this value!
- *
- * Since: 1.1.7
- **/
-gpointer
-cd_icc_get_context (CdIcc *icc)
-{
-	CdIccPrivate *priv = GET_PRIVATE (icc);
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
-	return priv->context_lcms;
+	/* save length to avoid trusting the profile */
+	priv->size = data_len;
+	priv->peeked = TRUE;
+	return TRUE;
 }
 
 /**
- * cd_icc_load_handle:
+ * cd_icc_peek_file:
  * @icc: a #CdIcc instance.
- * @handle: a cmsHPROFILE instance
- * @flags: a set of #CdIccLoadFlags
+ * @file: a #GFile
+ * @cancellable: A #GCancellable or %NULL
  * @error: A #GError or %NULL
  *
- * Set the internal cmsHPROFILE instance. This may be required if you create
- * the profile using cmsCreateRGBProfileTHR() and then want to use the
- * functionality in #CdIcc.
- *
- * Do not call cmsCloseProfile() on @handle in the caller, this will be done
- * when the @icc object is finalized. Treat the profile like it's been adopted
- * by this module.
- *
- * To handle the internal error callback, you should use the thread-safe
- * creation function, e.g. cmsCreateNULLProfileTHR(). The @context_id should be
- * set as the value of cd_icc_get_context() for this object.
+ * Parses the header of an ICC profile from a local or remote file.
+ * See cd_icc_peek_data() for which details are available afterwards.
  *
- * Additionally, this function cannot be called more than once, and also can't
- * be called if cd_icc_load_file() has previously been used on the @icc object.
+ * Return value: %TRUE for success
  *
- * Since: 0.1.33
+ * Since: 1.4.10
  **/
 gboolean
-cd_icc_load_handle (CdIcc *icc,
-		    gpointer handle,
-		    CdIccLoadFlags flags,
-		    GError **error)
+cd_icc_peek_file (CdIcc *icc,
+		  GFile *file,
+		  GCancellable *cancellable,
+		  GError **error)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	cmsContext context;
+	gsize length;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
-	g_return_val_if_fail (handle != NULL, FALSE);
-	g_return_val_if_fail (priv->lcms_profile == NULL, FALSE);
+	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
-	/* check the THR version has been correctly set up */
-	context = cmsGetProfileContextID (handle);
-	if (context == NULL) {
-		cmsCloseProfile (handle);
-		g_set_error_literal (error,
+	/* only the pages with the header and tags we read are touched */
+	filename = g_file_get_path (file);
+	if (filename != NULL && cd_icc_file_can_map (filename)) {
+		mapped_file = g_mapped_file_new (filename, FALSE, &error_local);
+		if (mapped_file == NULL) {
+			g_set_error (error,
 				     CD_ICC_ERROR,
-				     CD_ICC_ERROR_FAILED_TO_CREATE,
-				     "lcms2 threadsafe version (THR) not used, "
-				     "or context not set");
-		return FALSE;
+				     CD_ICC_ERROR_FAILED_TO_OPEN,
+				     "failed to load file: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		length = g_mapped_file_get_length (mapped_file);
+		if (length == 0) {
+			g_set_error_literal (error,
+					     CD_ICC_ERROR,
+					     CD_ICC_ERROR_FAILED_TO_PARSE,
+					     "icc was not valid (file size too small)");
+			return FALSE;
+		}
+		if (!cd_icc_peek_data (icc,
+				       (const guint8 *) g_mapped_file_get_contents (mapped_file),
+				       length,
+				       error))
+			return FALSE;
+	} else {
+		if (!g_file_load_contents (file, cancellable, &data, &length,
+					   NULL, &error_local)) {
+			g_set_error (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_OPEN,
+				     "failed to load file: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		if (!cd_icc_peek_data (icc, (const guint8 *) data, length, error))
+			return FALSE;
 	}
 
-	/* load profile */
-	priv->lcms_profile = handle;
-	return cd_icc_load (icc, flags, error);
+	/* save filename for later */
+	priv->filename = g_steal_pointer (&filename);
+	return TRUE;
 }
 
 /**
@@ -2338,6 +3441,67 @@ cd_icc_remove_metadata (CdIcc *icc, const gchar *key)
 	g_hash_table_remove (priv->metadata, key);
 }
 
+static gint
+cd_icc_named_colors_sort_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	GPtrArray *named_colors = (GPtrArray *) user_data;
+	const CdColorLab *lab_a;
+	const CdColorLab *lab_b;
+
+	lab_a = cd_color_swatch_get_value (g_ptr_array_index (named_colors, *((const guint *) a)));
+	lab_b = cd_color_swatch_get_value (g_ptr_array_index (named_colors, *((const guint *) b)));
+	if (lab_a->L < lab_b->L)
+		return -1;
+	if (lab_a->L > lab_b->L)
+		return 1;
+	return 0;
+}
+
+static void
+cd_icc_named_colors_index_clear (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_clear_pointer (&priv->named_colors_hash, g_hash_table_unref);
+	g_clear_pointer (&priv->named_colors_L, g_free);
+	g_clear_pointer (&priv->named_colors_a, g_free);
+	g_clear_pointer (&priv->named_colors_b, g_free);
+	g_clear_pointer (&priv->named_colors_idx, g_free);
+}
+
+/* built once when loaded, so that readers in other threads never see
+ * it change: a hash for names, and the Lab values as separate arrays
+ * ordered by lightness for the nearest match */
+static void
+cd_icc_named_colors_index (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	guint n = priv->named_colors->len;
+
+	cd_icc_named_colors_index_clear (icc);
+	priv->named_colors_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->named_colors_idx = g_new (guint, n);
+	for (guint i = 0; i < n; i++) {
+		CdColorSwatch *swatch = g_ptr_array_index (priv->named_colors, i);
+		const gchar *name = cd_color_swatch_get_name (swatch);
+		if (name != NULL && !g_hash_table_contains (priv->named_colors_hash, name))
+			g_hash_table_insert (priv->named_colors_hash, (gpointer) name, swatch);
+		priv->named_colors_idx[i] = i;
+	}
+	g_qsort_with_data (priv->named_colors_idx, n, sizeof (guint),
+			   cd_icc_named_colors_sort_cb, priv->named_colors);
+	priv->named_colors_L = g_new (gdouble, n);
+	priv->named_colors_a = g_new (gdouble, n);
+	priv->named_colors_b = g_new (gdouble, n);
+	for (guint i = 0; i < n; i++) {
+		CdColorSwatch *swatch = g_ptr_array_index (priv->named_colors,
+							   priv->named_colors_idx[i]);
+		const CdColorLab *lab = cd_color_swatch_get_value (swatch);
+		priv->named_colors_L[i] = lab->L;
+		priv->named_colors_a[i] = lab->a;
+		priv->named_colors_b[i] = lab->b;
+	}
+}
+
 static gboolean
 cd_icc_load_named_colors (CdIcc *icc, GError **error)
 {
@@ -2404,6 +3568,7 @@ cd_icc_load_named_colors (CdIcc *icc, GError **error)
 		}
 		g_string_free (string, TRUE);
 	}
+	cd_icc_named_colors_index (icc);
 	return TRUE;
 }
 
@@ -2427,6 +3592,127 @@ cd_icc_get_named_colors (CdIcc *icc)
 	return g_ptr_array_ref (priv->named_colors);
 }
 
+/**
+ * cd_icc_get_named_color_by_name:
+ * @icc: a #CdIcc instance.
+ * @name: a color name, including any prefix and suffix
+ *
+ * Gets a named color from the profile by name, which only works if the
+ * profile was loaded with the %CD_ICC_LOAD_FLAGS_NAMED_COLORS flag.
+ *
+ * Return value: (transfer none): a color swatch, or %NULL if not found
+ *
+ * Since: 1.4.10
+ **/
+const CdColorSwatch *
+cd_icc_get_named_color_by_name (CdIcc *icc, const gchar *name)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+	if (priv->named_colors_hash == NULL)
+		return NULL;
+	return g_hash_table_lookup (priv->named_colors_hash, name);
+}
+
+/* the CIEDE2000 lightness weighting, which only grows away from L=50 */
+static gdouble
+cd_icc_delta_e2000_sl (gdouble lbar)
+{
+	gdouble tmp = (lbar - 50.f) * (lbar - 50.f);
+	return 1.f + 0.015f * tmp / sqrt (20.f + tmp);
+}
+
+/**
+ * cd_icc_get_named_colors_nearest:
+ * @icc: a #CdIcc instance.
+ * @lab: the color to match
+ * @max_results: the most colors to return
+ *
+ * Gets the named colors closest to @lab using CIEDE2000, closest first.
+ * This only works if the profile was loaded with the
+ * %CD_ICC_LOAD_FLAGS_NAMED_COLORS flag.
+ *
+ * The colors are searched outwards in lightness from @lab, and the search
+ * stops once the difference in lightness alone is more than the worst
+ * match so far, so large color books are not compared in full.
+ *
+ * Return value: (transfer container) (element-type CdColorSwatch): color swatches
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_icc_get_named_colors_nearest (CdIcc *icc,
+				 const CdColorLab *lab,
+				 guint max_results)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	const gdouble *L = priv->named_colors_L;
+	gdouble sl_max;
+	guint hi = 0;
+	guint lo;
+	guint n;
+	guint n_best = 0;
+	GPtrArray *results;
+	g_autofree gdouble *best_de = NULL;
+	g_autofree guint *best_idx = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	g_return_val_if_fail (lab != NULL, NULL);
+
+	results = g_ptr_array_new ();
+	if (L == NULL || priv->named_colors->len == 0 || max_results == 0)
+		return results;
+	n = priv->named_colors->len;
+	max_results = MIN (max_results, n);
+	best_de = g_new (gdouble, max_results);
+	best_idx = g_new (guint, max_results);
+
+	/* the ΔE can never be less than ΔL over the largest weighting */
+	sl_max = MAX (cd_icc_delta_e2000_sl ((lab->L + L[0]) / 2.f),
+		      cd_icc_delta_e2000_sl ((lab->L + L[n - 1]) / 2.f));
+
+	/* find the first color at least as light, and walk both ways */
+	for (guint step = n; step > 0; step /= 2) {
+		while (hi + step <= n && L[hi + step - 1] < lab->L)
+			hi += step;
+	}
+	lo = hi;
+	while (lo > 0 || hi < n) {
+		CdColorLab tmp;
+		gdouble de;
+		guint i;
+		guint j;
+
+		if (hi >= n || (lo > 0 && lab->L - L[lo - 1] < L[hi] - lab->L))
+			i = --lo;
+		else
+			i = hi++;
+
+		/* nothing further out can be any closer */
+		if (n_best == max_results &&
+		    fabs (L[i] - lab->L) / sl_max >= best_de[n_best - 1])
+			break;
+
+		cd_color_lab_set (&tmp, L[i], priv->named_colors_a[i], priv->named_colors_b[i]);
+		de = cd_color_lab_delta_e2000 (lab, &tmp);
+		if (n_best == max_results && de >= best_de[n_best - 1])
+			continue;
+
+		/* keep the results sorted */
+		j = n_best < max_results ? n_best++ : n_best - 1;
+		for (; j > 0 && best_de[j - 1] > de; j--) {
+			best_de[j] = best_de[j - 1];
+			best_idx[j] = best_idx[j - 1];
+		}
+		best_de[j] = de;
+		best_idx[j] = priv->named_colors_idx[i];
+	}
+	for (guint i = 0; i < n_best; i++)
+		g_ptr_array_add (results, g_ptr_array_index (priv->named_colors, best_idx[i]));
+	return results;
+}
+
 /**
  * cd_icc_get_can_delete:
  * @icc: a #CdIcc instance.
@@ -2471,6 +3757,8 @@ cd_icc_get_created (CdIcc *icc)
 		return g_date_time_new_from_unix_local (priv->creation_time);
 
 	/* get the profile creation time and date */
+	if (priv->lcms_profile == NULL)
+		return NULL;
 	if (!cmsGetHeaderCreationDateTime (priv->lcms_profile, &created_tm))
 		return NULL;
 
@@ -2536,6 +3824,36 @@ cd_icc_get_locale_key (const gchar *locale)
 	return locale_key;
 }
 
+static gchar *
+cd_icc_mlu_get_utf8 (cmsMLU *mlu,
+		     const gchar *language_code,
+		     const gchar *country_code,
+		     GError **error)
+{
+	guint32 text_size;
+	g_autofree gunichar *wtext = NULL;
+
+	/* get required size for wide chars */
+	text_size = cmsMLUgetWide (mlu,
+				   language_code,
+				   country_code,
+				   NULL,
+				   0);
+	if (text_size == 0)
+		return NULL;
+
+	/* load wide chars */
+	wtext = g_new (gunichar, text_size);
+	text_size = cmsMLUgetWide (mlu,
+				   language_code,
+				   country_code,
+				   (wchar_t *) wtext,
+				   text_size);
+	if (text_size == 0)
+		return NULL;
+	return g_ucs4_to_utf8 (wtext, -1, NULL, NULL, error);
+}
+
 static const gchar *
 cd_icc_get_mluc_data (CdIcc *icc,
 		      const gchar *locale,
@@ -2549,17 +3867,17 @@ cd_icc_get_mluc_data (CdIcc *icc,
 	const gchar *language_code = "\0\0\0";
 	const gchar *value;
 	gchar *tmp;
-	guint32 text_size;
 	guint i;
+	g_autofree gchar *codes = NULL;
 	g_autofree gchar *locale_key = NULL;
-	g_autofree gchar *text_buffer = NULL;
-	g_autofree gunichar *wtext = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
 
 	/* does cache entry exist already? */
 	locale_key = cd_icc_get_locale_key (locale);
+	g_rw_lock_reader_lock (&priv->mluc_lock);
 	value = g_hash_table_lookup (priv->mluc_data[mluc], locale_key);
+	g_rw_lock_reader_unlock (&priv->mluc_lock);
 	if (value != NULL)
 		goto out;
 
@@ -2568,9 +3886,11 @@ cd_icc_get_mluc_data (CdIcc *icc,
 	 * 'fr'          -> 'fr' */
 	if (locale_key[0] != '\0') {
 
-		/* decompose it into language and country codes */
-		tmp = g_strstr_len (locale_key, -1, "_");
-		language_code = locale_key;
+		/* decompose it into language and country codes, keeping
+		 * the whole key for the cache */
+		codes = g_strdup (locale_key);
+		tmp = g_strstr_len (codes, -1, "_");
+		language_code = codes;
 		if (tmp != NULL) {
 			country_code = tmp + 1;
 			*tmp = '\0';
@@ -2613,36 +3933,115 @@ cd_icc_get_mluc_data (CdIcc *icc,
 		goto out;
 	}
 
-	/* get required size for wide chars */
-	text_size = cmsMLUgetWide (mlu,
-				   language_code,
-				   country_code,
-				   NULL,
-				   0);
-	if (text_size == 0)
+	/* insert UTF-8 value into locale cache */
+	tmp = cd_icc_mlu_get_utf8 (mlu, language_code, country_code, error);
+	if (tmp == NULL)
 		goto out;
 
-	/* load wide chars */
-	wtext = g_new (gunichar, text_size);
-	text_size = cmsMLUgetWide (mlu,
-				   language_code,
-				   country_code,
-				   (wchar_t *) wtext,
-				   text_size);
-	if (text_size == 0)
-		goto out;
+	/* another thread may have got there first, and the values already
+	 * returned to its caller have to stay valid */
+	g_rw_lock_writer_lock (&priv->mluc_lock);
+	value = g_hash_table_lookup (priv->mluc_data[mluc], locale_key);
+	if (value == NULL) {
+		g_hash_table_insert (priv->mluc_data[mluc],
+				     g_strdup (locale_key),
+				     tmp);
+		value = tmp;
+	} else {
+		g_free (tmp);
+	}
+	g_rw_lock_writer_unlock (&priv->mluc_lock);
+out:
+	return value;
+}
+
+/* adds every translation of the tag to the locale cache */
+static void
+cd_icc_load_mluc_translations_for_tag (CdIcc *icc,
+				       CdIccMluc mluc,
+				       const cmsTagSignature *sigs)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	cmsMLU *mlu = NULL;
+	cmsUInt32Number n;
+	gchar country_code[3];
+	gchar language_code[3];
+	gchar *text;
+	guint i;
+
+	for (i = 0; sigs[i] != 0; i++) {
+		mlu = cd_icc_read_tag (icc, sigs[i], NULL);
+		if (mlu != NULL)
+			break;
+	}
+	if (mlu == NULL)
+		return;
+
+	n = cmsMLUtranslationsCount (mlu);
+	for (i = 0; i < n; i++) {
+		g_autofree gchar *locale_key = NULL;
+
+		if (!cmsMLUtranslationsCodes (mlu, i, language_code, country_code))
+			continue;
+		if (!g_ascii_isalpha (language_code[0]) ||
+		    !g_ascii_isalpha (language_code[1]))
+			continue;
+
+		/* use the same keys as cd_icc_get_locale_key(), and keep
+		 * any value that has already been set or cleared */
+		if (g_strcmp0 (language_code, "en") == 0 &&
+		    g_strcmp0 (country_code, "US") == 0) {
+			locale_key = g_strdup ("");
+		} else if (country_code[0] == '\0') {
+			locale_key = g_strdup (language_code);
+		} else {
+			locale_key = g_strdup_printf ("%s_%s",
+						      language_code,
+						      country_code);
+		}
+		if (g_hash_table_contains (priv->mluc_data[mluc], locale_key))
+			continue;
+		text = cd_icc_mlu_get_utf8 (mlu, language_code, country_code, NULL);
+		if (text == NULL)
+			continue;
+		g_hash_table_insert (priv->mluc_data[mluc],
+				     g_steal_pointer (&locale_key),
+				     text);
+	}
+}
+
+static void
+cd_icc_load_mluc_translations (CdIcc *icc)
+{
+	const cmsTagSignature sigs[CD_MLUC_LAST][3] = {
+		{ cmsSigProfileDescriptionMLTag, cmsSigProfileDescriptionTag, 0 },
+		{ cmsSigCopyrightTag, 0, 0 },
+		{ cmsSigDeviceMfgDescTag, 0, 0 },
+		{ cmsSigDeviceModelDescTag, 0, 0 } };
+	guint i;
+
+	for (i = 0; i < CD_MLUC_LAST; i++)
+		cd_icc_load_mluc_translations_for_tag (icc, i, sigs[i]);
+}
+
+static void
+cd_icc_load_mluc_defaults (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
 
-	/* insert UTF-8 value into locale cache */
-	text_buffer = g_ucs4_to_utf8 (wtext, -1, NULL, NULL, error);
-	if (text_buffer == NULL)
-		goto out;
-	tmp = g_strdup (text_buffer);
-	g_hash_table_insert (priv->mluc_data[mluc],
-			     g_strdup (locale_key),
-			     tmp);
-	value = tmp;
-out:
-	return value;
+	if (priv->mluc_defaults_loaded || priv->lcms_profile == NULL)
+		return;
+	priv->mluc_defaults_loaded = TRUE;
+
+	/* a default that has already been set or cleared is kept */
+	if (!g_hash_table_contains (priv->mluc_data[CD_MLUC_DESCRIPTION], ""))
+		cd_icc_get_description (icc, NULL, NULL);
+	if (!g_hash_table_contains (priv->mluc_data[CD_MLUC_COPYRIGHT], ""))
+		cd_icc_get_copyright (icc, NULL, NULL);
+	if (!g_hash_table_contains (priv->mluc_data[CD_MLUC_MANUFACTURER], ""))
+		cd_icc_get_manufacturer (icc, NULL, NULL);
+	if (!g_hash_table_contains (priv->mluc_data[CD_MLUC_MODEL], ""))
+		cd_icc_get_model (icc, NULL, NULL);
 }
 
 /**
@@ -3179,6 +4578,107 @@ cd_icc_create_from_edid_data (CdIcc *icc, CdEdid *edid, GError **error)
 	return TRUE;
 }
 
+/* bump this when the profile generated from the EDID changes */
+#define CD_ICC_EDID_CACHE_VERSION	1
+
+static GFile *
+cd_icc_get_edid_cache_file (CdEdid *edid, GFile *cache_dir)
+{
+	const CdColorYxy *red = cd_edid_get_red (edid);
+	const CdColorYxy *green = cd_edid_get_green (edid);
+	const CdColorYxy *blue = cd_edid_get_blue (edid);
+	const CdColorYxy *white = cd_edid_get_white (edid);
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *key = NULL;
+
+	/* the primaries and gamma all come from the EDID, but include them
+	 * anyway so that a change to how they are parsed is not hidden */
+	key = g_strdup_printf ("%i:%s:%.6f:%.6f,%.6f:%.6f,%.6f:%.6f,%.6f:%.6f,%.6f",
+			       CD_ICC_EDID_CACHE_VERSION,
+			       cd_edid_get_checksum (edid),
+			       cd_edid_get_gamma (edid),
+			       red->x, red->y,
+			       green->x, green->y,
+			       blue->x, blue->y,
+			       white->x, white->y);
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	basename = g_strdup_printf ("edid-%s.icc", checksum);
+	return g_file_get_child (cache_dir, basename);
+}
+
+/**
+ * cd_icc_create_from_edid_data_cached:
+ * @icc: A valid #CdIcc
+ * @edid: EDID data
+ * @cache_dir: a directory to store the generated profiles
+ * @error: A #GError, or %NULL
+ *
+ * Creates an ICC profile from EDID data, like cd_icc_create_from_edid_data(),
+ * but loads a profile previously generated for the same EDID from
+ * @cache_dir if one exists. Otherwise the new profile is saved into
+ * @cache_dir for next time.
+ *
+ * A missing, invalid or unwritable cache is not an error.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_create_from_edid_data_cached (CdIcc *icc,
+				     CdEdid *edid,
+				     GFile *cache_dir,
+				     GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	gsize len = 0;
+	g_autofree gchar *data = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (CD_IS_EDID (edid), FALSE);
+	g_return_val_if_fail (G_IS_FILE (cache_dir), FALSE);
+
+	/* not loaded */
+	if (priv->lcms_profile != NULL) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_FAILED_TO_CREATE,
+				     "already loaded or generated");
+		return FALSE;
+	}
+	if (cd_edid_get_checksum (edid) == NULL)
+		return cd_icc_create_from_edid_data (icc, edid, error);
+
+	/* use the profile generated last time, checking it into a
+	 * temporary object so that a bad file does not leave @icc loaded */
+	file = cd_icc_get_edid_cache_file (edid, cache_dir);
+	if (g_file_load_contents (file, NULL, &data, &len, NULL, NULL)) {
+		g_autoptr(CdIcc) icc_tmp = cd_icc_new ();
+		if (!cd_icc_load_data (icc_tmp, (const guint8 *) data, len,
+				       CD_ICC_LOAD_FLAGS_METADATA, &error_local)) {
+			g_debug ("ignoring cached EDID profile: %s",
+				 error_local->message);
+			g_clear_error (&error_local);
+		} else if (g_strcmp0 (cd_icc_get_metadata_item (icc_tmp, CD_PROFILE_METADATA_EDID_MD5),
+				      cd_edid_get_checksum (edid)) != 0) {
+			g_debug ("ignoring cached EDID profile for other EDID");
+		} else {
+			return cd_icc_load_data (icc, (const guint8 *) data, len,
+						 CD_ICC_LOAD_FLAGS_METADATA, error);
+		}
+	}
+
+	/* generate and save for next time */
+	if (!cd_icc_create_from_edid_data (icc, edid, error))
+		return FALSE;
+	if (!cd_icc_save_file (icc, file, CD_ICC_SAVE_FLAGS_NONE, NULL, &error_local))
+		g_debug ("failed to cache EDID profile: %s", error_local->message);
+	return TRUE;
+}
+
 /**
  * cd_icc_create_from_edid:
  * @icc: A valid #CdIcc
@@ -3272,73 +4772,382 @@ out:
 	return ret;
 }
 
+static const cmsToneCurve **
+cd_icc_get_vcgt_curves (CdIcc *icc, GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	const cmsToneCurve **vcgt;
+
+	cd_icc_reload_handle (icc);
+
+	/* get tone curves from icc */
+	vcgt = cmsReadTag (priv->lcms_profile, cmsSigVcgtType);
+	if (vcgt == NULL || vcgt[0] == NULL) {
+		g_set_error_literal (error,
+				     CD_ICC_ERROR,
+				     CD_ICC_ERROR_NO_DATA,
+				     "icc does not have any VCGT data");
+		return NULL;
+	}
+	return vcgt;
+}
+
 /**
- * cd_icc_get_vcgt:
+ * cd_icc_get_vcgt_float:
  * @icc: A valid #CdIcc
  * @size: the desired size of the table data
+ * @red: (array length=size): an array to fill with red values from 0.0 to 1.0
+ * @green: (array length=size): an array to fill with green values
+ * @blue: (array length=size): an array to fill with blue values
  * @error: A #GError or %NULL
  *
- * Gets the video card calibration data from the profile.
+ * Gets the video card calibration data from the profile without allocating
+ * any memory. A @size of 1 gives the value for zero input.
  *
- * Return value: (transfer container) (element-type CdColorRGB): VCGT data, or %NULL for error
+ * Return value: %TRUE for success
  *
- * Since: 0.1.34
+ * Since: 1.4.10
  **/
-GPtrArray *
-cd_icc_get_vcgt (CdIcc *icc, guint size, GError **error)
+gboolean
+cd_icc_get_vcgt_float (CdIcc *icc,
+		       guint size,
+		       gfloat *red,
+		       gfloat *green,
+		       gfloat *blue,
+		       GError **error)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	CdColorRGB *tmp;
-	cmsFloat32Number in;
 	const cmsToneCurve **vcgt;
-	GPtrArray *array = NULL;
 	guint i;
 
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
-	g_return_val_if_fail (priv->lcms_profile != NULL, NULL);
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	cd_icc_reload_handle (icc);
+	g_return_val_if_fail (priv->lcms_profile != NULL, FALSE);
 
-	/* get tone curves from icc */
-	vcgt = cmsReadTag (priv->lcms_profile, cmsSigVcgtType);
-	if (vcgt == NULL || vcgt[0] == NULL) {
-		g_set_error_literal (error,
-				     CD_ICC_ERROR,
-				     CD_ICC_ERROR_NO_DATA,
-				     "icc does not have any VCGT data");
-		goto out;
+	vcgt = cd_icc_get_vcgt_curves (icc, error);
+	if (vcgt == NULL)
+		return FALSE;
+	for (i = 0; i < size; i++) {
+		cmsFloat32Number in = size > 1 ? (gdouble) i / (gdouble) (size - 1) : 0.f;
+		red[i] = cmsEvalToneCurveFloat (vcgt[0], in);
+		green[i] = cmsEvalToneCurveFloat (vcgt[1], in);
+		blue[i] = cmsEvalToneCurveFloat (vcgt[2], in);
+	}
+	return TRUE;
+}
+
+/* linearly resamples a 16 bit table using 16.16 fixed point */
+static void
+cd_icc_resample_table (const guint16 *table, guint n, guint16 *out, guint size)
+{
+	guint64 step;
+	guint64 pos = 0;
+	guint i;
+
+	/* a single entry is the value for zero input, like the float table */
+	if (n < 2 || size < 2) {
+		for (i = 0; i < size; i++)
+			out[i] = n > 0 ? table[0] : 0;
+		return;
+	}
+	step = ((guint64) (n - 1) << 16) / (size - 1);
+	for (i = 0; i < size - 1; i++, pos += step) {
+		guint idx = pos >> 16;
+		guint32 frac = pos & 0xffff;
+		out[i] = (table[idx] * (0x10000 - frac) +
+			  table[idx + 1] * frac + 0x8000) >> 16;
+	}
+	out[size - 1] = table[n - 1];
+}
+
+/**
+ * cd_icc_get_vcgt_uint16:
+ * @icc: A valid #CdIcc
+ * @size: the desired size of the table data, e.g. the gamma ramp size
+ * @red: (array length=size): an array to fill with red values from 0 to 0xffff
+ * @green: (array length=size): an array to fill with green values
+ * @blue: (array length=size): an array to fill with blue values
+ * @error: A #GError or %NULL
+ *
+ * Gets the video card calibration data from the profile in the format used
+ * by most gamma ramp interfaces. The 16 bit table that lcms keeps for each
+ * curve is resampled directly, which is much faster than evaluating the
+ * curve for each entry. A @size of 1 gives the value for zero input.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_get_vcgt_uint16 (CdIcc *icc,
+			guint size,
+			guint16 *red,
+			guint16 *green,
+			guint16 *blue,
+			GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	const cmsToneCurve **vcgt;
+	guint16 *out[] = { red, green, blue };
+	guint i;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (priv->lcms_profile != NULL, FALSE);
+
+	vcgt = cd_icc_get_vcgt_curves (icc, error);
+	if (vcgt == NULL)
+		return FALSE;
+	for (i = 0; i < 3; i++) {
+		cd_icc_resample_table (cmsGetToneCurveEstimatedTable (vcgt[i]),
+				       cmsGetToneCurveEstimatedTableEntries (vcgt[i]),
+				       out[i],
+				       size);
+	}
+	return TRUE;
+}
+
+/* one distinct profile and ramp size */
+typedef struct {
+	CdIcc		*icc;
+	guint		 size;
+	GBytes		*data;		/* NULL if there is no VCGT */
+} CdIccVcgtJob;
+
+static void
+cd_icc_vcgt_job_free (CdIccVcgtJob *job)
+{
+	if (job->data != NULL)
+		g_bytes_unref (job->data);
+	g_free (job);
+}
+
+static void
+cd_icc_vcgt_job_run (CdIccVcgtJob *job)
+{
+	guint16 *ramp;
+
+	/* the profile may have been released after loading */
+	cd_icc_reload_handle (job->icc);
+	ramp = g_new (guint16, job->size * 3);
+	if (!cd_icc_get_vcgt_uint16 (job->icc, job->size,
+				     ramp,
+				     ramp + job->size,
+				     ramp + job->size * 2,
+				     NULL)) {
+		g_free (ramp);
+		return;
+	}
+	job->data = g_bytes_new_take (ramp, sizeof (guint16) * job->size * 3);
+}
+
+static void
+cd_icc_vcgt_thread_cb (gpointer data, gpointer user_data)
+{
+	cd_icc_vcgt_job_run ((CdIccVcgtJob *) data);
+}
+
+static void
+cd_icc_vcgt_bytes_free (GBytes *data)
+{
+	if (data != NULL)
+		g_bytes_unref (data);
+}
+
+/**
+ * cd_icc_get_vcgt_batch:
+ * @iccs: (array length=n_requests): the profile for each request
+ * @sizes: (array length=n_requests): the gamma ramp size for each request
+ * @n_requests: the number of requests
+ *
+ * Gets the video card calibration data for many outputs at once, for
+ * instance a compositor driving a video wall. Requests for the same
+ * profile checksum and ramp size are only generated once and share the
+ * same #GBytes, and the distinct ramps are generated in parallel.
+ *
+ * Each result holds the red, then green, then blue ramp as consecutive
+ * arrays of @size host-endian 16 bit values, in the same format as
+ * cd_icc_get_vcgt_uint16(), so the channels can be passed directly to
+ * gamma ramp interfaces such as drmModeCrtcSetGamma().
+ *
+ * Return value: (transfer container) (element-type GBytes): the ramp for
+ * each request, in order, or %NULL entries for profiles without VCGT data
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_icc_get_vcgt_batch (CdIcc **iccs, const guint *sizes, guint n_requests)
+{
+	CdIccVcgtJob *job;
+	GPtrArray *results;
+	guint i;
+	guint n_threads;
+	g_autofree CdIccVcgtJob **request_jobs = NULL;
+	g_autoptr(GHashTable) keys = NULL;
+	g_autoptr(GPtrArray) jobs = NULL;
+
+	g_return_val_if_fail (iccs != NULL || n_requests == 0, NULL);
+	g_return_val_if_fail (sizes != NULL || n_requests == 0, NULL);
+	for (i = 0; i < n_requests; i++) {
+		g_return_val_if_fail (CD_IS_ICC (iccs[i]), NULL);
+		g_return_val_if_fail (sizes[i] > 1, NULL);
+	}
+
+	/* find the distinct ramps */
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_icc_vcgt_job_free);
+	keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	request_jobs = g_new (CdIccVcgtJob *, n_requests);
+	for (i = 0; i < n_requests; i++) {
+		CdIccPrivate *priv = GET_PRIVATE (iccs[i]);
+		gchar *key;
+
+		/* a modified profile no longer matches its checksum */
+		if (priv->checksum != NULL && !priv->modified)
+			key = g_strdup_printf ("%s:%u", priv->checksum, sizes[i]);
+		else
+			key = g_strdup_printf ("%p:%u", iccs[i], sizes[i]);
+		job = g_hash_table_lookup (keys, key);
+		if (job == NULL) {
+			job = g_new0 (CdIccVcgtJob, 1);
+			job->icc = iccs[i];
+			job->size = sizes[i];
+			g_ptr_array_add (jobs, job);
+			g_hash_table_insert (keys, key, job);
+		} else {
+			g_free (key);
+		}
+		request_jobs[i] = job;
+	}
+
+	/* generate them */
+	n_threads = MIN (jobs->len, g_get_num_processors ());
+	if (n_threads > 1) {
+		GThreadPool *pool;
+		pool = g_thread_pool_new (cd_icc_vcgt_thread_cb, NULL,
+					  (gint) n_threads, TRUE, NULL);
+		for (i = 0; i < jobs->len; i++)
+			g_thread_pool_push (pool, g_ptr_array_index (jobs, i), NULL);
+		g_thread_pool_free (pool, FALSE, TRUE);
+	} else {
+		for (i = 0; i < jobs->len; i++)
+			cd_icc_vcgt_job_run (g_ptr_array_index (jobs, i));
 	}
 
-	/* create array */
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_rgb_free);
+	/* share the results */
+	results = g_ptr_array_new_full (n_requests, (GDestroyNotify) cd_icc_vcgt_bytes_free);
+	for (i = 0; i < n_requests; i++) {
+		job = request_jobs[i];
+		g_ptr_array_add (results, job->data != NULL ? g_bytes_ref (job->data) : NULL);
+	}
+	return results;
+}
+
+/*
+ * cd_icc_rgb_garray_from_float:
+ *
+ * Packs the separate channels into one contiguous array.
+ */
+static GArray *
+cd_icc_rgb_garray_from_float (const gfloat *red,
+			      const gfloat *green,
+			      const gfloat *blue,
+			      guint size)
+{
+	GArray *array;
+	guint i;
+
+	array = cd_color_rgb_garray_new (size);
+	g_array_set_size (array, size);
 	for (i = 0; i < size; i++) {
-		in = (gdouble) i / (gdouble) (size - 1);
-		tmp = cd_color_rgb_new ();
-		cd_color_rgb_set (tmp,
-				  cmsEvalToneCurveFloat(vcgt[0], in),
-				  cmsEvalToneCurveFloat(vcgt[1], in),
-				  cmsEvalToneCurveFloat(vcgt[2], in));
-		g_ptr_array_add (array, tmp);
+		cd_color_rgb_set (&g_array_index (array, CdColorRGB, i),
+				  red[i], green[i], blue[i]);
 	}
-out:
 	return array;
 }
 
 /**
- * cd_icc_get_response:
+ * cd_icc_get_vcgt_garray:
  * @icc: A valid #CdIcc
- * @size: the size of the curve to generate
- * @error: a valid #GError, or %NULL
+ * @size: the desired size of the table data
+ * @error: A #GError or %NULL
  *
- * Generates a response curve of a specified size.
+ * Gets the video card calibration data from the profile as one
+ * contiguous array.
  *
- * Return value: (transfer container) (element-type CdColorRGB): response data, or %NULL for error
+ * Return value: (transfer full) (element-type CdColorRGB): VCGT data, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_icc_get_vcgt_garray (CdIcc *icc, guint size, GError **error)
+{
+	g_autofree gfloat *red = NULL;
+	g_autofree gfloat *green = NULL;
+	g_autofree gfloat *blue = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+
+	red = g_new (gfloat, size);
+	green = g_new (gfloat, size);
+	blue = g_new (gfloat, size);
+	if (!cd_icc_get_vcgt_float (icc, size, red, green, blue, error))
+		return NULL;
+	return cd_icc_rgb_garray_from_float (red, green, blue, size);
+}
+
+/**
+ * cd_icc_get_vcgt:
+ * @icc: A valid #CdIcc
+ * @size: the desired size of the table data
+ * @error: A #GError or %NULL
+ *
+ * Gets the video card calibration data from the profile.
+ *
+ * Callers that need large tables should use cd_icc_get_vcgt_garray(),
+ * cd_icc_get_vcgt_uint16() or cd_icc_get_vcgt_float() instead.
+ *
+ * Return value: (transfer container) (element-type CdColorRGB): VCGT data, or %NULL for error
  *
  * Since: 0.1.34
  **/
 GPtrArray *
-cd_icc_get_response (CdIcc *icc, guint size, GError **error)
+cd_icc_get_vcgt (CdIcc *icc, guint size, GError **error)
+{
+	g_autoptr(GArray) array = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+
+	array = cd_icc_get_vcgt_garray (icc, size, error);
+	if (array == NULL)
+		return NULL;
+	return cd_color_rgb_array_from_garray (array);
+}
+
+/**
+ * cd_icc_get_response_float:
+ * @icc: A valid #CdIcc
+ * @size: the size of the curve to generate
+ * @red: (array length=size): an array to fill with the red response
+ * @green: (array length=size): an array to fill with the green response
+ * @blue: (array length=size): an array to fill with the blue response
+ * @error: a valid #GError, or %NULL
+ *
+ * Generates a response curve of a specified size into caller-provided
+ * arrays. Negative values are clipped to zero, and a @size of 1 gives the
+ * response for zero input.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_icc_get_response_float (CdIcc *icc,
+			   guint size,
+			   gfloat *red,
+			   gfloat *green,
+			   gfloat *blue,
+			   GError **error)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	CdColorRGB *data;
 	CdColorspace colorspace;
 	cmsHPROFILE srgb_profile = NULL;
 	cmsHTRANSFORM transform = NULL;
@@ -3346,11 +5155,13 @@ cd_icc_get_response (CdIcc *icc, guint size, GError **error)
 	gdouble tmp;
 	gfloat divadd;
 	gfloat divamount;
-	GPtrArray *array = NULL;
 	guint i;
 	g_autofree gdouble *values_in = NULL;
 	g_autofree gdouble *values_out = NULL;
 
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	cd_icc_reload_handle (icc);
+
 	/* run through the icc */
 	colorspace = cd_icc_get_colorspace (icc);
 	if (colorspace != CD_COLORSPACE_RGB) {
@@ -3358,12 +5169,12 @@ cd_icc_get_response (CdIcc *icc, guint size, GError **error)
 				     CD_ICC_ERROR,
 				     CD_ICC_ERROR_INVALID_COLORSPACE,
 				     "Only RGB colorspaces are supported");
-		goto out;
+		return FALSE;
 	}
 
 	/* create input array */
 	values_in = g_new0 (gdouble, size * 3 * component_width);
-	divamount = 1.0f / (gfloat) (size - 1);
+	divamount = size > 1 ? 1.0f / (gfloat) (size - 1) : 0.0f;
 	for (i = 0; i < size; i++) {
 		divadd = divamount * (gfloat) i;
 
@@ -3390,39 +5201,81 @@ cd_icc_get_response (CdIcc *icc, guint size, GError **error)
 					   priv->lcms_profile, TYPE_RGB_DBL,
 					   srgb_profile, TYPE_RGB_DBL,
 					   INTENT_PERCEPTUAL, 0);
+	cmsCloseProfile (srgb_profile);
 	if (transform == NULL) {
 		g_set_error_literal (error,
 				     CD_ICC_ERROR,
 				     CD_ICC_ERROR_NO_DATA,
 				     "Failed to setup transform");
-		goto out;
+		return FALSE;
 	}
 	cmsDoTransform (transform, values_in, values_out, size * 3);
+	cmsDeleteTransform (transform);
+
+	/* only save curve data if it is positive */
+	for (i = 0; i < size; i++) {
+		tmp = values_out[(i * 3 * component_width) + 0];
+		red[i] = tmp > 0.0f ? tmp : 0.0f;
+		tmp = values_out[(i * 3 * component_width) + 4];
+		green[i] = tmp > 0.0f ? tmp : 0.0f;
+		tmp = values_out[(i * 3 * component_width) + 8];
+		blue[i] = tmp > 0.0f ? tmp : 0.0f;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_icc_get_response_garray:
+ * @icc: A valid #CdIcc
+ * @size: the size of the curve to generate
+ * @error: a valid #GError, or %NULL
+ *
+ * Generates a response curve of a specified size as one contiguous array.
+ *
+ * Return value: (transfer full) (element-type CdColorRGB): response data, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_icc_get_response_garray (CdIcc *icc, guint size, GError **error)
+{
+	g_autofree gfloat *red = NULL;
+	g_autofree gfloat *green = NULL;
+	g_autofree gfloat *blue = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+
+	red = g_new (gfloat, size);
+	green = g_new (gfloat, size);
+	blue = g_new (gfloat, size);
+	if (!cd_icc_get_response_float (icc, size, red, green, blue, error))
+		return NULL;
+	return cd_icc_rgb_garray_from_float (red, green, blue, size);
+}
+
+/**
+ * cd_icc_get_response:
+ * @icc: A valid #CdIcc
+ * @size: the size of the curve to generate
+ * @error: a valid #GError, or %NULL
+ *
+ * Generates a response curve of a specified size.
+ *
+ * Return value: (transfer container) (element-type CdColorRGB): response data, or %NULL for error
+ *
+ * Since: 0.1.34
+ **/
+GPtrArray *
+cd_icc_get_response (CdIcc *icc, guint size, GError **error)
+{
+	g_autoptr(GArray) array = NULL;
 
-	/* create output array */
-	array = cd_color_rgb_array_new ();
-	for (i = 0; i < size; i++) {
-		data = cd_color_rgb_new ();
-		cd_color_rgb_set (data, 0.0f, 0.0f, 0.0f);
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
 
-		/* only save curve data if it is positive */
-		tmp = values_out[(i * 3 * component_width) + 0];
-		if (tmp > 0.0f)
-			data->R = tmp;
-		tmp = values_out[(i * 3 * component_width) + 4];
-		if (tmp > 0.0f)
-			data->G = tmp;
-		tmp = values_out[(i * 3 * component_width) + 8];
-		if (tmp > 0.0f)
-			data->B = tmp;
-		g_ptr_array_add (array, data);
-	}
-out:
-	if (transform != NULL)
-		cmsDeleteTransform (transform);
-	if (srgb_profile != NULL)
-		cmsCloseProfile (srgb_profile);
-	return array;
+	array = cd_icc_get_response_garray (icc, size, error);
+	if (array == NULL)
+		return NULL;
+	return cd_color_rgb_array_from_garray (array);
 }
 
 /**
@@ -3450,9 +5303,11 @@ cd_icc_set_vcgt (CdIcc *icc, GPtrArray *vcgt, GError **error)
 	g_autofree guint16 *red = NULL;
 
 	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	cd_icc_reload_handle (icc);
 	g_return_val_if_fail (priv->lcms_profile != NULL, FALSE);
 
 	/* unwrap data */
+	priv->modified = TRUE;
 	red = g_new0 (guint16, vcgt->len);
 	green = g_new0 (guint16, vcgt->len);
 	blue = g_new0 (guint16, vcgt->len);
@@ -3505,14 +5360,13 @@ cd_icc_check_whitepoint (CdIcc *icc)
 }
 
 static CdProfileWarning
-cd_icc_check_vcgt (CdIcc *icc)
+cd_icc_check_vcgt (CdIcc *icc, guint size)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	cmsFloat32Number in;
 	cmsFloat32Number now[3];
 	cmsFloat32Number previous[3] = { -1, -1, -1};
 	const cmsToneCurve **vcgt;
-	const guint size = 32;
 	guint i;
 
 	/* does profile have monotonic VCGT */
@@ -3541,18 +5395,16 @@ cd_icc_check_vcgt (CdIcc *icc)
 }
 
 static CdProfileWarning
-cd_profile_check_scum_dot (CdIcc *icc)
+cd_profile_check_scum_dot (CdIcc *icc, cmsContext context_lcms, cmsHPROFILE profile_lab)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 	CdProfileWarning warning = CD_PROFILE_WARNING_NONE;
 	cmsCIELab white;
-	cmsHPROFILE profile_lab;
 	cmsHTRANSFORM transform;
 	guint8 rgb[3] = { 0, 0, 0 };
 
 	/* do Lab to RGB transform of 100,0,0 */
-	profile_lab = cmsCreateLab2ProfileTHR (priv->context_lcms, cmsD50_xyY ());
-	transform = cmsCreateTransformTHR (priv->context_lcms,
+	transform = cmsCreateTransformTHR (context_lcms,
 					   profile_lab, TYPE_Lab_DBL,
 					   priv->lcms_profile, TYPE_RGB_8,
 					   INTENT_RELATIVE_COLORIMETRIC,
@@ -3570,8 +5422,6 @@ cd_profile_check_scum_dot (CdIcc *icc)
 		goto out;
 	}
 out:
-	if (profile_lab != NULL)
-		cmsCloseProfile (profile_lab);
 	if (transform != NULL)
 		cmsDeleteTransform (transform);
 	return warning;
@@ -3621,147 +5471,78 @@ cd_icc_check_primaries (CdIcc *icc)
 	return CD_PROFILE_WARNING_NONE;
 }
 
+/* checks the grey ramp at the start of the probes */
 static CdProfileWarning
-cd_icc_check_gray_axis (CdIcc *icc)
+cd_icc_check_gray_axis (CdIcc *icc, const cmsCIELab *gray, guint n_gray)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	CdProfileWarning warning = CD_PROFILE_WARNING_NONE;
-	cmsCIELab gray[16];
-	cmsHPROFILE profile_lab = NULL;
-	cmsHTRANSFORM transform = NULL;
 	const gdouble gray_error = 5.0f;
 	gdouble last_l = -1;
-	guint8 rgb[3*16];
-	guint8 tmp;
 	guint i;
 
 	/* only do this for display profiles */
 	if (cmsGetDeviceClass (priv->lcms_profile) != cmsSigDisplayClass)
-		goto out;
-
-	/* do Lab to RGB transform of 100,0,0 */
-	profile_lab = cmsCreateLab2ProfileTHR (priv->context_lcms, cmsD50_xyY ());
-	transform = cmsCreateTransformTHR (priv->context_lcms,
-					   priv->lcms_profile, TYPE_RGB_8,
-					   profile_lab, TYPE_Lab_DBL,
-					   INTENT_RELATIVE_COLORIMETRIC,
-					   cmsFLAGS_NOOPTIMIZE);
-	if (transform == NULL) {
-		g_warning ("failed to setup RGB -> Lab transform");
-		goto out;
-	}
-
-	/* run a 16 item gray ramp through the transform */
-	for (i = 0; i < 16; i++) {
-		tmp = (255.0f / (16.0f - 1)) * i;
-		rgb[(i * 3) + 0] = tmp;
-		rgb[(i * 3) + 1] = tmp;
-		rgb[(i * 3) + 2] = tmp;
-	}
-	cmsDoTransform (transform, rgb, gray, 16);
+		return CD_PROFILE_WARNING_NONE;
 
 	/* check a/b is small */
-	for (i = 0; i < 16; i++) {
+	for (i = 0; i < n_gray; i++) {
 		if (gray[i].a > gray_error ||
-		    gray[i].b > gray_error) {
-			warning = CD_PROFILE_WARNING_GRAY_AXIS_INVALID;
-			goto out;
-		}
+		    gray[i].b > gray_error)
+			return CD_PROFILE_WARNING_GRAY_AXIS_INVALID;
 	}
 
 	/* check it's monotonic */
-	for (i = 0; i < 16; i++) {
-		if (last_l > 0 && gray[i].L < last_l) {
-			warning = CD_PROFILE_WARNING_GRAY_AXIS_NON_MONOTONIC;
-			goto out;
-		}
+	for (i = 0; i < n_gray; i++) {
+		if (last_l > 0 && gray[i].L < last_l)
+			return CD_PROFILE_WARNING_GRAY_AXIS_NON_MONOTONIC;
 		last_l = gray[i].L;
 	}
-out:
-	if (profile_lab != NULL)
-		cmsCloseProfile (profile_lab);
-	if (transform != NULL)
-		cmsDeleteTransform (transform);
-	return warning;
+	return CD_PROFILE_WARNING_NONE;
 }
 
+/* checks the red, green, blue and white probes */
 static CdProfileWarning
-cd_icc_check_d50_whitepoint (CdIcc *icc)
+cd_icc_check_d50_whitepoint (CdIcc *icc, const cmsCIELab *lab)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
-	CdProfileWarning warning = CD_PROFILE_WARNING_NONE;
 	cmsCIExyY tmp;
 	cmsCIEXYZ additive;
 	cmsCIEXYZ primaries[4];
-	cmsHPROFILE profile_lab;
-	cmsHTRANSFORM transform;
 	const cmsCIEXYZ *d50;
 	const gdouble rgb_error = 0.05;
 	const gdouble additive_error = 0.1f;
 	const gdouble white_error = 0.05;
-	guint8 rgb[3*4];
 	guint i;
 
-	/* do Lab to RGB transform to get primaries */
-	profile_lab = cmsCreateXYZProfileTHR (priv->context_lcms);
-	transform = cmsCreateTransformTHR (priv->context_lcms,
-					   priv->lcms_profile, TYPE_RGB_8,
-					   profile_lab, TYPE_XYZ_DBL,
-					   INTENT_RELATIVE_COLORIMETRIC,
-					   cmsFLAGS_NOOPTIMIZE);
-	if (transform == NULL) {
-		g_warning ("failed to setup RGB -> XYZ transform");
-		goto out;
-	}
-
-	/* Run RGBW through the transform */
-	rgb[0 + 0] = 255;
-	rgb[0 + 1] = 0;
-	rgb[0 + 2] = 0;
-	rgb[3 + 0] = 0;
-	rgb[3 + 1] = 255;
-	rgb[3 + 2] = 0;
-	rgb[6 + 0] = 0;
-	rgb[6 + 1] = 0;
-	rgb[6 + 2] = 255;
-	rgb[9 + 0] = 255;
-	rgb[9 + 1] = 255;
-	rgb[9 + 2] = 255;
-	cmsDoTransform (transform, rgb, primaries, 4);
+	/* the probes are D50 Lab */
+	for (i = 0; i < 4; i++)
+		cmsLab2XYZ (NULL, &primaries[i], &lab[i]);
 
 	/* check red is in gamut */
 	cmsXYZ2xyY (&tmp, &primaries[0]);
-	if (tmp.x - 0.735 > rgb_error || 0.265 - tmp.y > rgb_error) {
-		warning = CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
-		goto out;
-	}
+	if (tmp.x - 0.735 > rgb_error || 0.265 - tmp.y > rgb_error)
+		return CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
 
 	/* check green is in gamut */
 	cmsXYZ2xyY (&tmp, &primaries[1]);
-	if (0.160 - tmp.x > rgb_error || tmp.y - 0.840 > rgb_error) {
-		warning = CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
-		goto out;
-	}
+	if (0.160 - tmp.x > rgb_error || tmp.y - 0.840 > rgb_error)
+		return CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
 
 	/* check blue is in gamut */
 	cmsXYZ2xyY (&tmp, &primaries[2]);
-	if (0.037 - tmp.x > rgb_error || tmp.y - 0.358 > rgb_error) {
-		warning = CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
-		goto out;
-	}
+	if (0.037 - tmp.x > rgb_error || tmp.y - 0.358 > rgb_error)
+		return CD_PROFILE_WARNING_PRIMARIES_UNLIKELY;
 
 	/* only do the rest for display profiles */
 	if (cmsGetDeviceClass (priv->lcms_profile) != cmsSigDisplayClass)
-		goto out;
+		return CD_PROFILE_WARNING_NONE;
 
 	/* check white is D50 */
 	d50 = cmsD50_XYZ();
 	if (fabs (primaries[3].X - d50->X) > white_error ||
 	    fabs (primaries[3].Y - d50->Y) > white_error ||
-	    fabs (primaries[3].Z - d50->Z) > white_error) {
-		warning = CD_PROFILE_WARNING_WHITEPOINT_INVALID;
-		goto out;
-	}
+	    fabs (primaries[3].Z - d50->Z) > white_error)
+		return CD_PROFILE_WARNING_WHITEPOINT_INVALID;
 
 	/* check primaries add up to D50 */
 	additive.X = 0;
@@ -3774,40 +5555,75 @@ cd_icc_check_d50_whitepoint (CdIcc *icc)
 	}
 	if (fabs (additive.X - d50->X) > additive_error ||
 	    fabs (additive.Y - d50->Y) > additive_error ||
-	    fabs (additive.Z - d50->Z) > additive_error) {
-		warning = CD_PROFILE_WARNING_PRIMARIES_NON_ADDITIVE;
-		goto out;
+	    fabs (additive.Z - d50->Z) > additive_error)
+		return CD_PROFILE_WARNING_PRIMARIES_NON_ADDITIVE;
+	return CD_PROFILE_WARNING_NONE;
+}
+
+/* the grey ramp and the primaries go through the profile in one transform */
+typedef struct {
+	CdIcc			*icc;
+	cmsHPROFILE		 profile_lab;
+	guint			 n_gray;
+	CdProfileWarning	 gray_axis;
+	CdProfileWarning	 d50_whitepoint;
+} CdIccCheckHelper;
+
+static void
+cd_icc_check_probes (CdIccCheckHelper *helper, cmsContext context_lcms)
+{
+	CdIccPrivate *priv = GET_PRIVATE (helper->icc);
+	cmsHTRANSFORM transform;
+	const guint n_probes = helper->n_gray + 4;
+	guint i;
+	g_autofree cmsCIELab *lab = g_new (cmsCIELab, n_probes);
+	g_autofree guint16 *rgb = g_new0 (guint16, n_probes * 3);
+
+	helper->gray_axis = CD_PROFILE_WARNING_NONE;
+	helper->d50_whitepoint = CD_PROFILE_WARNING_NONE;
+	transform = cmsCreateTransformTHR (context_lcms,
+					   priv->lcms_profile, TYPE_RGB_16,
+					   helper->profile_lab, TYPE_Lab_DBL,
+					   INTENT_RELATIVE_COLORIMETRIC,
+					   cmsFLAGS_NOOPTIMIZE);
+	if (transform == NULL) {
+		g_warning ("failed to setup RGB -> Lab transform");
+		return;
 	}
-out:
-	if (profile_lab != NULL)
-		cmsCloseProfile (profile_lab);
-	if (transform != NULL)
-		cmsDeleteTransform (transform);
-	return warning;
+
+	/* a gray ramp, then red, green, blue and white */
+	for (i = 0; i < helper->n_gray; i++) {
+		guint16 tmp = (65535.0f / (helper->n_gray - 1)) * i;
+		rgb[(i * 3) + 0] = tmp;
+		rgb[(i * 3) + 1] = tmp;
+		rgb[(i * 3) + 2] = tmp;
+	}
+	for (i = 0; i < 3; i++)
+		rgb[(helper->n_gray + i) * 3 + i] = 65535;
+	for (i = 0; i < 3; i++)
+		rgb[(helper->n_gray + 3) * 3 + i] = 65535;
+	cmsDoTransform (transform, rgb, lab, n_probes);
+	cmsDeleteTransform (transform);
+
+	helper->gray_axis = cd_icc_check_gray_axis (helper->icc, lab, helper->n_gray);
+	helper->d50_whitepoint = cd_icc_check_d50_whitepoint (helper->icc, lab + helper->n_gray);
 }
 
-/**
- * cd_icc_get_warnings:
- * @icc: a #CdIcc instance.
- *
- * Returns any warnings with profiles
- *
- * Return value: (transfer container) (element-type CdProfileWarning): An array of warning values
- *
- * Since: 0.1.34
- **/
-GArray *
-cd_icc_get_warnings (CdIcc *icc)
+#define CD_ICC_CHECK_GRAY_SAMPLES	16
+#define CD_ICC_CHECK_VCGT_SAMPLES	32
+
+static GArray *
+cd_icc_get_warnings_uncached (CdIcc *icc, guint n_samples)
 {
 	CdIccPrivate *priv = GET_PRIVATE (icc);
+	CdIccCheckHelper probes;
+	CdProfileWarning scum_dot;
 	GArray *flags;
+	cmsHPROFILE profile_lab;
 	gboolean ret;
 	gchar ascii_name[1024];
 	CdProfileWarning warning;
 
-	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
-	g_return_val_if_fail (priv->lcms_profile != NULL, NULL);
-
 	flags = g_array_new (FALSE, FALSE, sizeof (CdProfileWarning));
 
 	/* check that the profile has a description and a copyright */
@@ -3830,26 +5646,39 @@ cd_icc_get_warnings (CdIcc *icc)
 	if (cmsGetColorSpace (priv->lcms_profile) != cmsSigRgbData)
 		goto out;
 
+	/* one Lab profile is used by both transforms */
+	profile_lab = cmsCreateLab2ProfileTHR (priv->context_lcms, cmsD50_xyY ());
+	if (profile_lab == NULL) {
+		g_warning ("failed to create Lab profile");
+		goto out;
+	}
+	scum_dot = cd_profile_check_scum_dot (icc, priv->context_lcms, profile_lab);
+
+	/* the gray ramp and the primaries share one transform */
+	probes.icc = icc;
+	probes.profile_lab = profile_lab;
+	probes.n_gray = n_samples > 0 ? n_samples : CD_ICC_CHECK_GRAY_SAMPLES;
+	cd_icc_check_probes (&probes, priv->context_lcms);
+	cmsCloseProfile (profile_lab);
+
 	/* does profile have an unlikely whitepoint */
 	warning = cd_icc_check_whitepoint (icc);
 	if (warning != CD_PROFILE_WARNING_NONE)
 		g_array_append_val (flags, warning);
 
 	/* does profile have monotonic VCGT */
-	warning = cd_icc_check_vcgt (icc);
+	warning = cd_icc_check_vcgt (icc, n_samples > 0 ? n_samples : CD_ICC_CHECK_VCGT_SAMPLES);
 	if (warning != CD_PROFILE_WARNING_NONE)
 		g_array_append_val (flags, warning);
 
 	/* if Lab 100,0,0 does not map to RGB 255,255,255 for relative
 	 * colorimetric then white it will not work on printers */
-	warning = cd_profile_check_scum_dot (icc);
-	if (warning != CD_PROFILE_WARNING_NONE)
-		g_array_append_val (flags, warning);
+	if (scum_dot != CD_PROFILE_WARNING_NONE)
+		g_array_append_val (flags, scum_dot);
 
 	/* gray should give low a/b and should be monotonic */
-	warning = cd_icc_check_gray_axis (icc);
-	if (warning != CD_PROFILE_WARNING_NONE)
-		g_array_append_val (flags, warning);
+	if (probes.gray_axis != CD_PROFILE_WARNING_NONE)
+		g_array_append_val (flags, probes.gray_axis);
 
 	/* tristimulus values cannot be negative */
 	warning = cd_icc_check_primaries (icc);
@@ -3857,13 +5686,353 @@ cd_icc_get_warnings (CdIcc *icc)
 		g_array_append_val (flags, warning);
 
 	/* check whitepoint works out to D50 */
-	warning = cd_icc_check_d50_whitepoint (icc);
-	if (warning != CD_PROFILE_WARNING_NONE)
-		g_array_append_val (flags, warning);
+	if (probes.d50_whitepoint != CD_PROFILE_WARNING_NONE)
+		g_array_append_val (flags, probes.d50_whitepoint);
 out:
 	return flags;
 }
 
+static GArray *
+cd_icc_warnings_copy (GArray *flags)
+{
+	GArray *copy;
+	copy = g_array_sized_new (FALSE, FALSE, sizeof (CdProfileWarning), flags->len);
+	g_array_append_vals (copy, flags->data, flags->len);
+	return copy;
+}
+
+/**
+ * cd_icc_get_warnings:
+ * @icc: a #CdIcc instance.
+ *
+ * Returns any warnings with profiles
+ *
+ * The result is remembered for the profile checksum, so loading the same
+ * profile again does not repeat the analysis.
+ *
+ * Return value: (transfer container) (element-type CdProfileWarning): An array of warning values
+ *
+ * Since: 0.1.34
+ **/
+GArray *
+cd_icc_get_warnings (CdIcc *icc)
+{
+	return cd_icc_get_warnings_full (icc, 0);
+}
+
+/**
+ * cd_icc_get_warnings_full:
+ * @icc: a #CdIcc instance.
+ * @n_samples: the number of gray and VCGT samples, or 0 for the default
+ *
+ * Returns any warnings with profiles, checking the gray axis and the VCGT
+ * at @n_samples points. Denser sampling finds smaller problems, and only
+ * costs the extra evaluations as the transform is set up once.
+ *
+ * Only the results with the default sampling are remembered.
+ *
+ * Return value: (transfer container) (element-type CdProfileWarning): An array of warning values
+ *
+ * Since: 1.4.10
+ **/
+GArray *
+cd_icc_get_warnings_full (CdIcc *icc, guint n_samples)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	GArray *flags;
+	GArray *tmp;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), NULL);
+	g_return_val_if_fail (n_samples != 1, NULL);
+
+	/* remembered from an earlier full load */
+	if (n_samples == 0 && priv->lcms_profile == NULL && priv->peek_warnings != NULL)
+		return cd_icc_warnings_copy (priv->peek_warnings);
+	g_return_val_if_fail (priv->lcms_profile != NULL, NULL);
+
+	/* the checksum no longer describes the profile */
+	if (n_samples != 0 || priv->checksum == NULL || priv->modified)
+		return cd_icc_get_warnings_uncached (icc, n_samples);
+
+	/* already analyzed by this or another instance */
+	g_mutex_lock (&cd_icc_warnings_mutex);
+	if (cd_icc_warnings_cache != NULL) {
+		tmp = g_hash_table_lookup (cd_icc_warnings_cache, priv->checksum);
+		if (tmp != NULL) {
+			flags = cd_icc_warnings_copy (tmp);
+			g_mutex_unlock (&cd_icc_warnings_mutex);
+			return flags;
+		}
+	}
+	g_mutex_unlock (&cd_icc_warnings_mutex);
+
+	/* add to the cache, forgetting everything if it gets too big */
+	flags = cd_icc_get_warnings_uncached (icc, 0);
+	g_mutex_lock (&cd_icc_warnings_mutex);
+	if (cd_icc_warnings_cache == NULL) {
+		cd_icc_warnings_cache = g_hash_table_new_full (g_str_hash,
+							       g_str_equal,
+							       g_free,
+							       (GDestroyNotify) g_array_unref);
+	}
+	if (g_hash_table_size (cd_icc_warnings_cache) >= CD_ICC_WARNINGS_CACHE_SIZE_MAX)
+		g_hash_table_remove_all (cd_icc_warnings_cache);
+	g_hash_table_insert (cd_icc_warnings_cache,
+			     g_strdup (priv->checksum),
+			     cd_icc_warnings_copy (flags));
+	g_mutex_unlock (&cd_icc_warnings_mutex);
+	return flags;
+}
+
+#define CD_ICC_INDEX_METADATA_PREFIX	"Metadata-"
+
+/**
+ * cd_icc_save_to_index:
+ * @icc: a #CdIcc instance.
+ * @kf: a #GKeyFile
+ * @group: the group to use, typically the filename
+ *
+ * Saves the details that cd_icc_peek_data() makes available, and also the
+ * tag table and warnings, so that cd_icc_load_from_index() can recreate the
+ * object without reading the file. The profile must have been loaded fully.
+ **/
+void
+cd_icc_save_to_index (CdIcc *icc, GKeyFile *kf, const gchar *group)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	GHashTableIter iter;
+	const gchar *description;
+	gpointer key, value;
+	g_autoptr(GArray) warnings = NULL;
+	g_autoptr(GDateTime) created = NULL;
+	g_autoptr(GPtrArray) warnings_str = NULL;
+	g_auto(GStrv) tags = NULL;
+
+	g_return_if_fail (CD_IS_ICC (icc));
+	g_return_if_fail (priv->lcms_profile != NULL);
+
+	g_key_file_remove_group (kf, group, NULL);
+	g_key_file_set_string (kf, group, "Kind",
+			       cd_profile_kind_to_string (priv->kind));
+	g_key_file_set_string (kf, group, "Colorspace",
+			       cd_colorspace_to_string (priv->colorspace));
+	g_key_file_set_double (kf, group, "Version", priv->version);
+	g_key_file_set_uint64 (kf, group, "Size", priv->size);
+	created = cd_icc_get_created (icc);
+	if (created != NULL)
+		g_key_file_set_int64 (kf, group, "Created", g_date_time_to_unix (created));
+	if (priv->checksum != NULL)
+		g_key_file_set_string (kf, group, "Checksum", priv->checksum);
+	description = cd_icc_get_description (icc, NULL, NULL);
+	if (description != NULL)
+		g_key_file_set_string (kf, group, "Description", description);
+	tags = cd_icc_get_tags (icc, NULL);
+	if (tags != NULL) {
+		g_key_file_set_string_list (kf, group, "Tags",
+					    (const gchar * const *) tags,
+					    g_strv_length (tags));
+	}
+
+	/* analyzing the profile is the most expensive part of adding it */
+	warnings = cd_icc_get_warnings (icc);
+	warnings_str = g_ptr_array_new ();
+	for (guint i = 0; i < warnings->len; i++) {
+		CdProfileWarning warning = g_array_index (warnings, CdProfileWarning, i);
+		g_ptr_array_add (warnings_str, (gpointer) cd_profile_warning_to_string (warning));
+	}
+	g_key_file_set_string_list (kf, group, "Warnings",
+				    (const gchar * const *) warnings_str->pdata,
+				    warnings_str->len);
+
+	/* only what was loaded */
+	g_hash_table_iter_init (&iter, priv->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_autofree gchar *kf_key = NULL;
+		kf_key = g_strconcat (CD_ICC_INDEX_METADATA_PREFIX, key, NULL);
+		g_key_file_set_string (kf, group, kf_key, value);
+	}
+}
+
+/**
+ * cd_icc_load_from_index:
+ * @icc: a #CdIcc instance.
+ * @kf: a #GKeyFile
+ * @group: the group to use, typically the filename
+ * @error: A #GError or %NULL
+ *
+ * Recreates a profile saved using cd_icc_save_to_index(). Afterwards the
+ * object behaves as if cd_icc_peek_data() had been used, although
+ * cd_icc_get_tags() and cd_icc_get_warnings() also work.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+cd_icc_load_from_index (CdIcc *icc,
+			GKeyFile *kf,
+			const gchar *group,
+			GError **error)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	gsize n_warnings = 0;
+	g_autofree gchar *colorspace = NULL;
+	g_autofree gchar *description = NULL;
+	g_autofree gchar *kind = NULL;
+	g_auto(GStrv) keys = NULL;
+	g_auto(GStrv) warnings = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (priv->lcms_profile == NULL, FALSE);
+
+	/* the kind is always saved */
+	kind = g_key_file_get_string (kf, group, "Kind", error);
+	if (kind == NULL)
+		return FALSE;
+	if (priv->peeked)
+		cd_icc_peek_reset (icc);
+	priv->kind = cd_profile_kind_from_string (kind);
+	colorspace = g_key_file_get_string (kf, group, "Colorspace", NULL);
+	priv->colorspace = cd_colorspace_from_string (colorspace);
+	priv->version = g_key_file_get_double (kf, group, "Version", NULL);
+	priv->size = g_key_file_get_uint64 (kf, group, "Size", NULL);
+	if (g_key_file_has_key (kf, group, "Created", NULL))
+		priv->creation_time = g_key_file_get_int64 (kf, group, "Created", NULL);
+	priv->checksum = g_key_file_get_string (kf, group, "Checksum", NULL);
+	description = g_key_file_get_string (kf, group, "Description", NULL);
+	if (description != NULL) {
+		g_hash_table_insert (priv->mluc_data[CD_MLUC_DESCRIPTION],
+				     g_strdup (""),
+				     g_steal_pointer (&description));
+	}
+	priv->peek_tags = g_key_file_get_string_list (kf, group, "Tags", NULL, NULL);
+	warnings = g_key_file_get_string_list (kf, group, "Warnings", &n_warnings, NULL);
+	priv->peek_warnings = g_array_new (FALSE, FALSE, sizeof (CdProfileWarning));
+	for (guint i = 0; i < n_warnings; i++) {
+		CdProfileWarning warning = cd_profile_warning_from_string (warnings[i]);
+		g_array_append_val (priv->peek_warnings, warning);
+	}
+	keys = g_key_file_get_keys (kf, group, NULL, NULL);
+	for (guint i = 0; keys != NULL && keys[i] != NULL; i++) {
+		if (!g_str_has_prefix (keys[i], CD_ICC_INDEX_METADATA_PREFIX))
+			continue;
+		g_hash_table_insert (priv->metadata,
+				     g_strdup (keys[i] + strlen (CD_ICC_INDEX_METADATA_PREFIX)),
+				     g_key_file_get_string (kf, group, keys[i], NULL));
+	}
+	priv->filename = g_strdup (group);
+	priv->peeked = TRUE;
+	return TRUE;
+}
+
+/**
+ * cd_icc_release_handle:
+ * @icc: a #CdIcc instance.
+ *
+ * Closes the lcms profile of a profile loaded from a file, keeping only
+ * what the getters need, e.g. the description, metadata, tags and
+ * warnings. This saves the memory used by the decoded LUTs. Anything
+ * that needs the lcms profile again reopens the file, as long as it has
+ * not changed.
+ *
+ * Return value: %TRUE if the handle was released
+ **/
+gboolean
+cd_icc_release_handle (CdIcc *icc)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	GStatBuf stat_buf;
+	g_autoptr(GDateTime) created = NULL;
+
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+
+	/* not possible to get back, or not worth it */
+	if (priv->lcms_profile == NULL || priv->filename == NULL || priv->modified)
+		return FALSE;
+	if (g_stat (priv->filename, &stat_buf) != 0 ||
+	    stat_buf.st_size != priv->size)
+		return FALSE;
+
+	/* cache everything that would need the handle */
+	cd_icc_get_description (icc, NULL, NULL);
+	created = cd_icc_get_created (icc);
+	if (created != NULL)
+		priv->creation_time = g_date_time_to_unix (created);
+	g_clear_pointer (&priv->peek_tags, g_strfreev);
+	priv->peek_tags = cd_icc_get_tags (icc, NULL);
+	g_clear_pointer (&priv->peek_warnings, g_array_unref);
+	priv->peek_warnings = cd_icc_get_warnings (icc);
+
+	cmsCloseProfile (priv->lcms_profile);
+	priv->lcms_profile = NULL;
+	priv->released = TRUE;
+	priv->released_mtime = stat_buf.st_mtime;
+	return TRUE;
+}
+
+/**
+ * cd_icc_get_live_count:
+ *
+ * Gets the number of #CdIcc objects that have not been finalized, which
+ * the daemon uses to find leaks.
+ *
+ * Return value: the number of objects
+ **/
+guint
+cd_icc_get_live_count (void)
+{
+	return (guint) g_atomic_int_get (&cd_icc_live_count);
+}
+
+/**
+ * cd_icc_get_memory_size:
+ * @icc: a #CdIcc instance.
+ * @has_handle: (out) (optional): set to %TRUE if the lcms profile is open
+ *
+ * Estimates the heap used by the object. An open lcms profile is counted
+ * as the size of the file, as lcms keeps a copy of it and the decoded
+ * tags are usually of the same order.
+ *
+ * Return value: the size in bytes
+ **/
+gsize
+cd_icc_get_memory_size (CdIcc *icc, gboolean *has_handle)
+{
+	CdIccPrivate *priv = GET_PRIVATE (icc);
+	gsize size = sizeof (CdIcc) + sizeof (CdIccPrivate);
+
+	g_return_val_if_fail (CD_IS_ICC (icc), 0);
+
+	if (priv->filename != NULL)
+		size += strlen (priv->filename) + 1;
+	if (priv->checksum != NULL)
+		size += strlen (priv->checksum) + 1;
+	if (priv->characterization_data != NULL)
+		size += strlen (priv->characterization_data) + 1;
+	if (priv->peek_tags != NULL) {
+		for (guint i = 0; priv->peek_tags[i] != NULL; i++)
+			size += strlen (priv->peek_tags[i]) + 1 + sizeof (gchar *);
+	}
+	size += cd_memory_get_hash_table_size (priv->metadata);
+	g_rw_lock_reader_lock (&priv->mluc_lock);
+	for (guint i = 0; i < CD_MLUC_LAST; i++)
+		size += cd_memory_get_hash_table_size (priv->mluc_data[i]);
+	g_rw_lock_reader_unlock (&priv->mluc_lock);
+	for (guint i = 0; i < priv->named_colors->len; i++) {
+		CdColorSwatch *swatch = g_ptr_array_index (priv->named_colors, i);
+		const gchar *name = cd_color_swatch_get_name (swatch);
+		size += sizeof (gpointer) + sizeof (CdColorLab) + sizeof (gchar *);
+		if (name != NULL)
+			size += strlen (name) + 1;
+	}
+	if (priv->named_colors_L != NULL)
+		size += priv->named_colors->len * (4 * sizeof (gdouble) + sizeof (guint));
+
+	if (has_handle != NULL)
+		*has_handle = priv->lcms_profile != NULL;
+	if (priv->lcms_profile != NULL)
+		size += priv->size;
+	return size;
+}
+
 static void
 cd_icc_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
 {
@@ -4046,7 +6215,8 @@ cd_icc_init (CdIcc *icc)
 	guint i;
 	CdIccPrivate *priv = GET_PRIVATE (icc);
 
-	priv->context_lcms = cd_context_lcms_new ();
+	g_atomic_int_inc (&cd_icc_live_count);
+	priv->context_lcms = cd_context_lcms_get_shared ();
 	priv->kind = CD_PROFILE_KIND_UNKNOWN;
 	priv->colorspace = CD_COLORSPACE_UNKNOWN;
 	priv->named_colors = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_swatch_free);
@@ -4055,6 +6225,8 @@ cd_icc_init (CdIcc *icc)
 						     g_free,
 						     g_free);
 	priv->creation_time = -1;
+	g_rw_lock_init (&priv->mluc_lock);
+	g_mutex_init (&priv->reload_mutex);
 	for (i = 0; i < CD_MLUC_LAST; i++) {
 		priv->mluc_data[i] = g_hash_table_new_full (g_str_hash,
 								 g_str_equal,
@@ -4077,13 +6249,20 @@ cd_icc_finalize (GObject *object)
 	g_free (priv->filename);
 	g_free (priv->checksum);
 	g_free (priv->characterization_data);
+	g_strfreev (priv->peek_tags);
+	if (priv->peek_warnings != NULL)
+		g_array_unref (priv->peek_warnings);
 	g_ptr_array_unref (priv->named_colors);
+	cd_icc_named_colors_index_clear (icc);
 	g_hash_table_destroy (priv->metadata);
 	for (i = 0; i < CD_MLUC_LAST; i++)
 		g_hash_table_destroy (priv->mluc_data[i]);
+	g_rw_lock_clear (&priv->mluc_lock);
+	g_mutex_clear (&priv->reload_mutex);
 	if (priv->lcms_profile != NULL)
 		cmsCloseProfile (priv->lcms_profile);
 	cd_context_lcms_free (priv->context_lcms);
+	g_atomic_int_add (&cd_icc_live_count, -1);
 
 	G_OBJECT_CLASS (cd_icc_parent_class)->finalize (object);
 }
@@ -153,6 +153,16 @@ gboolean	 cd_icc_load_handle			(CdIcc		*icc,
 							 CdIccLoadFlags	 flags,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_peek_data			(CdIcc		*icc,
+							 const guint8	*data,
+							 gsize		 data_len,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_peek_file			(CdIcc		*icc,
+							 GFile		*file,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 GBytes		*cd_icc_save_data			(CdIcc		*icc,
 							 CdIccSaveFlags	 flags,
 							 GError		**error)
@@ -163,6 +173,18 @@ gboolean	 cd_icc_save_file			(CdIcc		*icc,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_save_stream			(CdIcc		*icc,
+							 GOutputStream	*stream,
+							 CdIccSaveFlags	 flags,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_save_fd				(CdIcc		*icc,
+							 gint		 fd,
+							 CdIccSaveFlags	 flags,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_icc_save_default			(CdIcc		*icc,
 							 CdIccSaveFlags	 flags,
 							 GCancellable	*cancellable,
@@ -194,11 +216,18 @@ void		 cd_icc_add_metadata			(CdIcc		*icc,
 void		 cd_icc_remove_metadata			(CdIcc		*icc,
 							 const gchar	*key);
 GPtrArray	*cd_icc_get_named_colors		(CdIcc		*icc);
+const CdColorSwatch *cd_icc_get_named_color_by_name	(CdIcc		*icc,
+							 const gchar	*name);
+GPtrArray	*cd_icc_get_named_colors_nearest	(CdIcc		*icc,
+							 const CdColorLab *lab,
+							 guint		 max_results);
 gboolean	 cd_icc_get_can_delete			(CdIcc		*icc);
 GDateTime	*cd_icc_get_created			(CdIcc		*icc);
 void		 cd_icc_set_created			(CdIcc		*icc,
 							 GDateTime	*creation_time);
 const gchar	*cd_icc_get_checksum			(CdIcc		*icc);
+void		 cd_icc_set_checksum			(CdIcc		*icc,
+							 const gchar	*checksum);
 const gchar	*cd_icc_get_description			(CdIcc		*icc,
 							 const gchar	*locale,
 							 GError		**error);
@@ -241,6 +270,9 @@ const CdColorXYZ *cd_icc_get_white			(CdIcc		*icc);
 guint		 cd_icc_get_temperature			(CdIcc		*icc);
 GArray		*cd_icc_get_warnings			(CdIcc		*icc)
 							 G_GNUC_WARN_UNUSED_RESULT;
+GArray		*cd_icc_get_warnings_full		(CdIcc		*icc,
+							 guint		 n_samples)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_icc_create_from_edid		(CdIcc		*icc,
 							 gdouble	 gamma_value,
 							 const CdColorYxy *red,
@@ -253,6 +285,11 @@ gboolean	 cd_icc_create_from_edid_data		(CdIcc		*icc,
 							 CdEdid		*edid,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_create_from_edid_data_cached	(CdIcc		*icc,
+							 CdEdid		*edid,
+							 GFile		*cache_dir,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_icc_create_default			(CdIcc		*icc,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
@@ -264,6 +301,27 @@ GPtrArray	*cd_icc_get_vcgt			(CdIcc		*icc,
 							 guint		 size,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+GArray		*cd_icc_get_vcgt_garray			(CdIcc		*icc,
+							 guint		 size,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_get_vcgt_float			(CdIcc		*icc,
+							 guint		 size,
+							 gfloat		*red,
+							 gfloat		*green,
+							 gfloat		*blue,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_get_vcgt_uint16			(CdIcc		*icc,
+							 guint		 size,
+							 guint16	*red,
+							 guint16	*green,
+							 guint16	*blue,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+GPtrArray	*cd_icc_get_vcgt_batch			(CdIcc		**iccs,
+							 const guint	*sizes,
+							 guint		 n_requests);
 gboolean	 cd_icc_set_vcgt			(CdIcc		*icc,
 							 GPtrArray	*vcgt,
 							 GError		**error)
@@ -272,6 +330,17 @@ GPtrArray	*cd_icc_get_response			(CdIcc		*icc,
 							 guint		 size,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+GArray		*cd_icc_get_response_garray		(CdIcc		*icc,
+							 guint		 size,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_icc_get_response_float		(CdIcc		*icc,
+							 guint		 size,
+							 gfloat		*red,
+							 gfloat		*green,
+							 gfloat		*blue,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gchar		**cd_icc_get_tags			(CdIcc		*icc,
 							 GError		**error);
 GBytes		*cd_icc_get_tag_data			(CdIcc		*icc,
@@ -174,6 +174,41 @@ cd_interp_akima_eval (CdInterp *interp, gdouble value, GError **error)
 	return result;
 }
 
+static gboolean
+cd_interp_akima_eval_many (CdInterp *interp,
+			   const gdouble *values,
+			   gdouble *results,
+			   guint n_values,
+			   GError **error)
+{
+	CdInterpAkima *interp_akima = CD_INTERP_AKIMA (interp);
+	CdInterpAkimaPrivate *priv = GET_PRIVATE (interp_akima);
+	const gdouble *x;
+	const gdouble *y;
+	gdouble xd;
+	gint n;
+	gint p = 2;
+	guint i;
+
+	x = &g_array_index (cd_interp_get_x (interp), gdouble, 0);
+	y = &g_array_index (cd_interp_get_y (interp), gdouble, 0);
+	n = cd_interp_get_x (interp)->len;
+	for (i = 0; i < n_values; i++) {
+		gdouble value = values[i];
+
+		/* only go back to the start if the values are not sorted */
+		if (value < x[p-1])
+			p = 2;
+		while (p < n - 1 && value >= x[p])
+			p++;
+
+		/* evaluate polynomials */
+		xd = value - x[p-1];
+		results[i] = y[p-1] + (priv->slope_t[p-1] + (priv->polynom_c[p-1] + priv->polynom_d[p-1] * xd) * xd) * xd;
+	}
+	return TRUE;
+}
+
 /*
  * cd_interp_akima_class_init:
  */
@@ -185,6 +220,7 @@ cd_interp_akima_class_init (CdInterpAkimaClass *klass)
 
 	interp_class->prepare = cd_interp_akima_prepare;
 	interp_class->eval = cd_interp_akima_eval;
+	interp_class->eval_many = cd_interp_akima_eval_many;
 	object_class->finalize = cd_interp_akima_finalize;
 }
 
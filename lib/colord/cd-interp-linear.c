@@ -57,6 +57,37 @@ cd_interp_linear_eval (CdInterp *interp, gdouble value, GError **error)
 	return y[p] + ((value - x[p]) / (x[p+1] - x[p])) * (y[p+1] - y[p]);
 }
 
+static gboolean
+cd_interp_linear_eval_many (CdInterp *interp,
+			    const gdouble *values,
+			    gdouble *results,
+			    guint n_values,
+			    GError **error)
+{
+	const gdouble *x;
+	const gdouble *y;
+	gint p = 0;
+	gint size;
+	guint i;
+
+	x = &g_array_index (cd_interp_get_x (interp), gdouble, 0);
+	y = &g_array_index (cd_interp_get_y (interp), gdouble, 0);
+	size = cd_interp_get_y (interp)->len;
+	for (i = 0; i < n_values; i++) {
+		gdouble value = values[i];
+
+		/* only go back to the start if the values are not sorted */
+		if (p > 0 && x[p] >= value)
+			p = 0;
+		for (; p < size - 2; p++) {
+			if (x[p+1] >= value)
+				break;
+		}
+		results[i] = y[p] + ((value - x[p]) / (x[p+1] - x[p])) * (y[p+1] - y[p]);
+	}
+	return TRUE;
+}
+
 /*
  * cd_interp_linear_class_init:
  */
@@ -65,6 +96,7 @@ cd_interp_linear_class_init (CdInterpLinearClass *klass)
 {
 	CdInterpClass *interp_class = CD_INTERP_CLASS (klass);
 	interp_class->eval = cd_interp_linear_eval;
+	interp_class->eval_many = cd_interp_linear_eval_many;
 }
 
 static void
@@ -0,0 +1,261 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:cd-interp-monotone
+ * @short_description: Interpolate data using a monotone cubic spline
+ *
+ * This object implements Fritsch-Carlson monotone cubic interpolation of
+ * 2D ordered data. If the data is monotonic then so is the result.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <math.h>
+
+#include "cd-interp-monotone.h"
+
+static void	cd_interp_monotone_class_init	(CdInterpMonotoneClass	*klass);
+static void	cd_interp_monotone_init		(CdInterpMonotone	*interp_monotone);
+static void	cd_interp_monotone_finalize	(GObject		*object);
+
+#define GET_PRIVATE(o) (cd_interp_monotone_get_instance_private (o))
+
+/**
+ * CdInterpMonotonePrivate:
+ *
+ * Private #CdInterpMonotone data
+ **/
+typedef struct
+{
+	gdouble			*coef;		/* all the coefficients */
+	gdouble			*coef_b;	/* the tangent at each point */
+	gdouble			*coef_c;	/* the 2nd order coefficient */
+	gdouble			*coef_d;	/* the 3rd order coefficient */
+} CdInterpMonotonePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (CdInterpMonotone, cd_interp_monotone, CD_TYPE_INTERP)
+
+static gboolean
+cd_interp_monotone_prepare (CdInterp *interp, GError **error)
+{
+	CdInterpMonotone *interp_monotone = CD_INTERP_MONOTONE (interp);
+	CdInterpMonotonePrivate *priv = GET_PRIVATE (interp_monotone);
+	const gdouble *x;
+	const gdouble *y;
+	gdouble *m;
+	guint i;
+	guint n;
+	g_autofree gdouble *delta = NULL;
+
+	/* only add the coefficients if they are going to be used */
+	n = cd_interp_get_size (interp);
+	if (n <= 2)
+		return TRUE;
+
+	/* the secant of each segment */
+	x = &g_array_index (cd_interp_get_x (interp), gdouble, 0);
+	y = &g_array_index (cd_interp_get_y (interp), gdouble, 0);
+	delta = g_new0 (gdouble, n);
+	for (i = 0; i < n - 1; i++) {
+		if (x[i+1] <= x[i]) {
+			g_set_error (error,
+				     CD_INTERP_ERROR,
+				     CD_INTERP_ERROR_FAILED,
+				     "X data not increasing at %u", i + 1);
+			return FALSE;
+		}
+		delta[i] = (y[i+1] - y[i]) / (x[i+1] - x[i]);
+	}
+
+	/* one block, so each coefficient is contiguous */
+	priv->coef = g_new0 (gdouble, n * 3);
+	priv->coef_b = priv->coef;
+	priv->coef_c = priv->coef + n;
+	priv->coef_d = priv->coef + n * 2;
+
+	/* initial tangents, flat at any local extremum */
+	m = priv->coef_b;
+	m[0] = delta[0];
+	m[n-1] = delta[n-2];
+	for (i = 1; i < n - 1; i++) {
+		if (delta[i-1] * delta[i] <= 0.0)
+			m[i] = 0.0;
+		else
+			m[i] = (delta[i-1] + delta[i]) / 2.0;
+	}
+
+	/* limit the tangents so that each segment cannot overshoot */
+	for (i = 0; i < n - 1; i++) {
+		gdouble alpha, beta, tau;
+		if (fpclassify (delta[i]) == FP_ZERO) {
+			m[i] = 0.0;
+			m[i+1] = 0.0;
+			continue;
+		}
+		alpha = m[i] / delta[i];
+		beta = m[i+1] / delta[i];
+		if (alpha * alpha + beta * beta > 9.0) {
+			tau = 3.0 / sqrt (alpha * alpha + beta * beta);
+			m[i] = tau * alpha * delta[i];
+			m[i+1] = tau * beta * delta[i];
+		}
+	}
+
+	/* calculate polynomial coefficients */
+	for (i = 0; i < n - 1; i++) {
+		gdouble h = x[i+1] - x[i];
+		priv->coef_c[i] = (3 * delta[i] - 2 * m[i] - m[i+1]) / h;
+		priv->coef_d[i] = (m[i] + m[i+1] - 2 * delta[i]) / (h * h);
+	}
+	return TRUE;
+}
+
+static gdouble
+cd_interp_monotone_eval_segment (CdInterpMonotonePrivate *priv,
+				 const gdouble *x,
+				 const gdouble *y,
+				 guint n,
+				 guint p,
+				 gdouble value)
+{
+	gdouble xd;
+
+	/* extrapolate linearly so the result stays monotonic */
+	if (value <= x[0])
+		return y[0] + priv->coef_b[0] * (value - x[0]);
+	if (value >= x[n-1])
+		return y[n-1] + priv->coef_b[n-1] * (value - x[n-1]);
+
+	/* evaluate polynomial */
+	xd = value - x[p];
+	return y[p] + (priv->coef_b[p] + (priv->coef_c[p] + priv->coef_d[p] * xd) * xd) * xd;
+}
+
+static gdouble
+cd_interp_monotone_eval (CdInterp *interp, gdouble value, GError **error)
+{
+	CdInterpMonotone *interp_monotone = CD_INTERP_MONOTONE (interp);
+	CdInterpMonotonePrivate *priv = GET_PRIVATE (interp_monotone);
+	const gdouble *x;
+	const gdouble *y;
+	guint lo = 0;
+	guint hi;
+	guint n;
+
+	/* find the segment with a binary search */
+	x = &g_array_index (cd_interp_get_x (interp), gdouble, 0);
+	y = &g_array_index (cd_interp_get_y (interp), gdouble, 0);
+	n = cd_interp_get_size (interp);
+	hi = n - 2;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo + 1) / 2;
+		if (x[mid] <= value)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return cd_interp_monotone_eval_segment (priv, x, y, n, lo, value);
+}
+
+static gboolean
+cd_interp_monotone_eval_many (CdInterp *interp,
+			      const gdouble *values,
+			      gdouble *results,
+			      guint n_values,
+			      GError **error)
+{
+	CdInterpMonotone *interp_monotone = CD_INTERP_MONOTONE (interp);
+	CdInterpMonotonePrivate *priv = GET_PRIVATE (interp_monotone);
+	const gdouble *x;
+	const gdouble *y;
+	guint i;
+	guint n;
+	guint p = 0;
+
+	x = &g_array_index (cd_interp_get_x (interp), gdouble, 0);
+	y = &g_array_index (cd_interp_get_y (interp), gdouble, 0);
+	n = cd_interp_get_size (interp);
+	for (i = 0; i < n_values; i++) {
+		gdouble value = values[i];
+
+		/* only go back to the start if the values are not sorted */
+		if (value < x[p])
+			p = 0;
+		while (p < n - 2 && x[p+1] <= value)
+			p++;
+		results[i] = cd_interp_monotone_eval_segment (priv, x, y, n, p, value);
+	}
+	return TRUE;
+}
+
+/*
+ * cd_interp_monotone_class_init:
+ */
+static void
+cd_interp_monotone_class_init (CdInterpMonotoneClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	CdInterpClass *interp_class = CD_INTERP_CLASS (klass);
+
+	interp_class->prepare = cd_interp_monotone_prepare;
+	interp_class->eval = cd_interp_monotone_eval;
+	interp_class->eval_many = cd_interp_monotone_eval_many;
+	object_class->finalize = cd_interp_monotone_finalize;
+}
+
+static void
+cd_interp_monotone_init (CdInterpMonotone *interp_monotone)
+{
+}
+
+static void
+cd_interp_monotone_finalize (GObject *object)
+{
+	CdInterpMonotone *interp_monotone = CD_INTERP_MONOTONE (object);
+	CdInterpMonotonePrivate *priv = GET_PRIVATE (interp_monotone);
+
+	g_return_if_fail (CD_IS_INTERP_MONOTONE (object));
+
+	g_free (priv->coef);
+
+	G_OBJECT_CLASS (cd_interp_monotone_parent_class)->finalize (object);
+}
+
+/**
+ * cd_interp_monotone_new:
+ *
+ * Creates a new #CdInterpMonotone object.
+ *
+ * Return value: a new CdInterp object.
+ *
+ * Since: 1.4.10
+ **/
+CdInterp *
+cd_interp_monotone_new (void)
+{
+	CdInterpMonotone *interp_monotone;
+	interp_monotone = g_object_new (CD_TYPE_INTERP_MONOTONE,
+					"kind", CD_INTERP_KIND_MONOTONE,
+					NULL);
+	return CD_INTERP (interp_monotone);
+}
@@ -249,7 +249,7 @@ cd_interp_eval (CdInterp *interp, gdouble value, GError **error)
 		dx = x[1] - x[0];
 		dy = y[1] - y[0];
 		m = dy / dx;
-		return y[0] + m * value;
+		return y[0] + m * (value - x[0]);
 	}
 
 	/* no support */
@@ -265,6 +265,85 @@ cd_interp_eval (CdInterp *interp, gdouble value, GError **error)
 	return klass->eval (interp, value, error);
 }
 
+/**
+ * cd_interp_eval_many:
+ * @interp: a #CdInterp instance.
+ * @values: (array length=n_values): The X co-ordinates
+ * @results: (array length=n_values): The Y co-ordinates
+ * @n_values: the number of values
+ * @error: a #GError or %NULL
+ *
+ * Evaluate the interpolation function at many points.
+ * You must have called cd_interp_insert() and cd_interp_prepare() before
+ * calling this method.
+ *
+ * This is much faster than calling cd_interp_eval() for each point,
+ * especially if @values is sorted in ascending order.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_interp_eval_many (CdInterp *interp,
+		     const gdouble *values,
+		     gdouble *results,
+		     guint n_values,
+		     GError **error)
+{
+	CdInterpClass *klass = CD_INTERP_GET_CLASS (interp);
+	CdInterpPrivate *priv = GET_PRIVATE (interp);
+	const gdouble *x;
+	const gdouble *y;
+	guint i;
+
+	g_return_val_if_fail (CD_IS_INTERP (interp), FALSE);
+	g_return_val_if_fail (priv->prepared, FALSE);
+	g_return_val_if_fail (values != NULL || n_values == 0, FALSE);
+	g_return_val_if_fail (results != NULL || n_values == 0, FALSE);
+
+	/* only one point */
+	x = &g_array_index (priv->x, gdouble, 0);
+	y = &g_array_index (priv->y, gdouble, 0);
+	if (priv->size == 1) {
+		for (i = 0; i < n_values; i++)
+			results[i] = y[0];
+		return TRUE;
+	}
+
+	/* only 2 points */
+	if (priv->size == 2) {
+		gdouble m = (y[1] - y[0]) / (x[1] - x[0]);
+		for (i = 0; i < n_values; i++)
+			results[i] = y[0] + m * (values[i] - x[0]);
+		return TRUE;
+	}
+
+	/* the klass can do them all at once */
+	if (klass != NULL && klass->eval_many != NULL)
+		return klass->eval_many (interp, values, results, n_values, error);
+
+	/* no support */
+	if (klass == NULL || klass->eval == NULL) {
+		g_set_error_literal (error,
+				     CD_INTERP_ERROR,
+				     CD_INTERP_ERROR_FAILED,
+				     "no superclass");
+		return FALSE;
+	}
+
+	/* call the klass function for each point */
+	for (i = 0; i < n_values; i++) {
+		g_autoptr(GError) error_local = NULL;
+		results[i] = klass->eval (interp, values[i], &error_local);
+		if (error_local != NULL) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 /**
  * cd_interp_get_kind:
  * @interp: a #CdInterp instance.
@@ -293,6 +372,8 @@ cd_interp_kind_to_string (CdInterpKind kind)
 		return "linear";
 	if (kind == CD_INTERP_KIND_AKIMA)
 		return "akima";
+	if (kind == CD_INTERP_KIND_MONOTONE)
+		return "monotone";
 	return "unknown";
 }
 
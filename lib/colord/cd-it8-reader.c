@@ -0,0 +1,560 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:cd-it8-reader
+ * @short_description: Read CGATS data one set at a time
+ *
+ * This object reads the header and then each data set of a CGATS file
+ * such as those read by #CdIt8, without needing a copy of the data or
+ * storing all the sets in memory.
+ *
+ * See also: #CdIt8
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "cd-it8.h"
+#include "cd-it8-reader.h"
+
+struct _CdIt8Reader {
+	GBytes			*bytes;
+	const gchar		*data;
+	gsize			 size;
+	gsize			 pos;
+	gchar			*sheet_type;
+	GHashTable		*properties;	/* key : value */
+	GPtrArray		*keys;		/* in file order */
+	GPtrArray		*fields;
+	guint			 number_of_fields;
+	guint			 number_of_sets;
+	guint			 sets_read;
+	gboolean		 in_data;
+	const gchar		**set_ptr;	/* tokens of the current set */
+	gsize			*set_len;
+	GString			*scratch;
+};
+
+/* far more than the spectral bands of any real instrument */
+#define CD_IT8_READER_FIELDS_MAX		65536
+
+typedef struct {
+	const gchar		*ptr;
+	gsize			 len;
+	gboolean		 newline;	/* a newline came before it */
+	gboolean		 quoted;
+} CdIt8ReaderToken;
+
+static gboolean
+cd_it8_reader_next_token (CdIt8Reader *reader, CdIt8ReaderToken *tok)
+{
+	const gchar *data = reader->data;
+	gsize pos = reader->pos;
+	gsize size = reader->size;
+
+	tok->newline = FALSE;
+	tok->quoted = FALSE;
+
+	/* skip whitespace and comments */
+	while (pos < size) {
+		if (data[pos] == '\n') {
+			tok->newline = TRUE;
+			pos++;
+			continue;
+		}
+		if (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r') {
+			pos++;
+			continue;
+		}
+		if (data[pos] == '#') {
+			while (pos < size && data[pos] != '\n')
+				pos++;
+			continue;
+		}
+		break;
+	}
+	if (pos >= size) {
+		reader->pos = pos;
+		return FALSE;
+	}
+
+	/* quoted string, which is allowed to run to the end of the line */
+	if (data[pos] == '"' || data[pos] == '\'') {
+		gchar quote = data[pos++];
+		tok->quoted = TRUE;
+		tok->ptr = data + pos;
+		while (pos < size && data[pos] != quote && data[pos] != '\n')
+			pos++;
+		tok->len = (gsize) (data + pos - tok->ptr);
+		if (pos < size && data[pos] == quote)
+			pos++;
+		reader->pos = pos;
+		return TRUE;
+	}
+
+	/* keyword or number */
+	tok->ptr = data + pos;
+	while (pos < size && !g_ascii_isspace (data[pos]))
+		pos++;
+	tok->len = (gsize) (data + pos - tok->ptr);
+	reader->pos = pos;
+	return TRUE;
+}
+
+static gboolean
+cd_it8_reader_token_is (const CdIt8ReaderToken *tok, const gchar *str)
+{
+	if (tok->quoted)
+		return FALSE;
+	if (tok->len != strlen (str))
+		return FALSE;
+	return memcmp (tok->ptr, str, tok->len) == 0;
+}
+
+static guint
+cd_it8_reader_get_property_uint (CdIt8Reader *reader, const gchar *key)
+{
+	const gchar *tmp;
+	guint64 value;
+
+	tmp = g_hash_table_lookup (reader->properties, key);
+	if (tmp == NULL)
+		return 0;
+	value = g_ascii_strtoull (tmp, NULL, 10);
+	if (value > G_MAXUINT)
+		return 0;
+	return value;
+}
+
+/**
+ * cd_it8_reader_new:
+ * @bytes: the CGATS data
+ *
+ * Creates a reader for CGATS data. The data is not copied, and so
+ * @bytes can be a mapped file.
+ *
+ * Return value: (transfer full): a new #CdIt8Reader
+ *
+ * Since: 1.4.10
+ **/
+CdIt8Reader *
+cd_it8_reader_new (GBytes *bytes)
+{
+	CdIt8Reader *reader;
+
+	g_return_val_if_fail (bytes != NULL, NULL);
+
+	reader = g_new0 (CdIt8Reader, 1);
+	reader->bytes = g_bytes_ref (bytes);
+	reader->data = g_bytes_get_data (bytes, &reader->size);
+	reader->properties = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, g_free);
+	reader->keys = g_ptr_array_new ();
+	reader->fields = g_ptr_array_new_with_free_func (g_free);
+	reader->scratch = g_string_new (NULL);
+	return reader;
+}
+
+/**
+ * cd_it8_reader_free:
+ * @reader: a #CdIt8Reader, or %NULL
+ *
+ * Frees a reader created with cd_it8_reader_new().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_reader_free (CdIt8Reader *reader)
+{
+	if (reader == NULL)
+		return;
+	g_bytes_unref (reader->bytes);
+	g_free (reader->sheet_type);
+	g_hash_table_unref (reader->properties);
+	g_ptr_array_unref (reader->keys);
+	g_ptr_array_unref (reader->fields);
+	g_free (reader->set_ptr);
+	g_free (reader->set_len);
+	g_string_free (reader->scratch, TRUE);
+	g_free (reader);
+}
+
+/**
+ * cd_it8_reader_parse_header:
+ * @reader: a #CdIt8Reader
+ * @error: a #GError, or %NULL
+ *
+ * Reads the sheet type, the properties and the data format, stopping at
+ * the first data set.
+ *
+ * Return value: %TRUE if the header was valid
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_reader_parse_header (CdIt8Reader *reader, GError **error)
+{
+	CdIt8ReaderToken tok;
+	CdIt8ReaderToken value;
+
+	g_return_val_if_fail (reader != NULL, FALSE);
+	g_return_val_if_fail (reader->sheet_type == NULL, FALSE);
+
+	/* the sheet type is the first line of the file */
+	if (!cd_it8_reader_next_token (reader, &tok)) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "No sheet type");
+		return FALSE;
+	}
+	reader->sheet_type = g_strndup (tok.ptr, tok.len);
+	while (reader->pos < reader->size && reader->data[reader->pos] != '\n')
+		reader->pos++;
+
+	/* properties and the data format, in any order */
+	while (TRUE) {
+		gchar *key;
+		gsize pos;
+
+		if (!cd_it8_reader_next_token (reader, &tok)) {
+			g_set_error_literal (error,
+					     CD_IT8_ERROR,
+					     CD_IT8_ERROR_INVALID_FORMAT,
+					     "Invalid format, BEGIN_DATA required");
+			return FALSE;
+		}
+		if (cd_it8_reader_token_is (&tok, "BEGIN_DATA"))
+			break;
+		if (cd_it8_reader_token_is (&tok, "BEGIN_DATA_FORMAT")) {
+			while (TRUE) {
+				if (!cd_it8_reader_next_token (reader, &tok)) {
+					g_set_error_literal (error,
+							     CD_IT8_ERROR,
+							     CD_IT8_ERROR_INVALID_FORMAT,
+							     "Invalid format, END_DATA_FORMAT required");
+					return FALSE;
+				}
+				if (cd_it8_reader_token_is (&tok, "END_DATA_FORMAT"))
+					break;
+				g_ptr_array_add (reader->fields,
+						 g_strndup (tok.ptr, tok.len));
+			}
+			continue;
+		}
+
+		/* the value has to be on the same line */
+		pos = reader->pos;
+		if (!cd_it8_reader_next_token (reader, &value) || value.newline) {
+			reader->pos = pos;
+			value.ptr = "";
+			value.len = 0;
+		}
+
+		/* this just declares a non-standard property */
+		if (cd_it8_reader_token_is (&tok, "KEYWORD"))
+			continue;
+		key = g_strndup (tok.ptr, tok.len);
+		if (!g_hash_table_contains (reader->properties, key))
+			g_ptr_array_add (reader->keys, key);
+
+		/* keeps the existing key, which is referenced by keys */
+		g_hash_table_insert (reader->properties, key,
+				     g_strndup (value.ptr, value.len));
+	}
+
+	/* check the data format */
+	reader->number_of_fields = cd_it8_reader_get_property_uint (reader, "NUMBER_OF_FIELDS");
+	if (reader->number_of_fields == 0)
+		reader->number_of_fields = reader->fields->len;
+	if (reader->number_of_fields == 0) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "Invalid format, NUMBER_OF_FIELDS required");
+		return FALSE;
+	}
+	if (reader->fields->len > 0 &&
+	    reader->fields->len != reader->number_of_fields) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_INVALID_FORMAT,
+			     "Invalid format, %u fields but NUMBER_OF_FIELDS is %u",
+			     reader->fields->len, reader->number_of_fields);
+		return FALSE;
+	}
+	if (reader->number_of_fields > CD_IT8_READER_FIELDS_MAX) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_INVALID_FORMAT,
+			     "Invalid format, NUMBER_OF_FIELDS %u is more than %u",
+			     reader->number_of_fields,
+			     (guint) CD_IT8_READER_FIELDS_MAX);
+		return FALSE;
+	}
+
+	/* each value takes at least one character and a separator, so the
+	 * counts cannot be more than what is left of the file */
+	reader->number_of_sets = cd_it8_reader_get_property_uint (reader, "NUMBER_OF_SETS");
+	if (reader->number_of_sets > 0 &&
+	    (guint64) reader->number_of_fields * reader->number_of_sets >
+	    (reader->size - reader->pos + 1) / 2) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_INVALID_FORMAT,
+			     "Invalid format, %u sets of %u fields cannot fit in the data",
+			     reader->number_of_sets, reader->number_of_fields);
+		return FALSE;
+	}
+	reader->set_ptr = g_new0 (const gchar *, reader->number_of_fields);
+	reader->set_len = g_new0 (gsize, reader->number_of_fields);
+	reader->in_data = TRUE;
+	return TRUE;
+}
+
+/**
+ * cd_it8_reader_get_sheet_type:
+ * @reader: a #CdIt8Reader
+ *
+ * Gets the sheet type, e.g. "CTI3".
+ *
+ * Return value: the sheet type, or %NULL if the header has not been parsed
+ *
+ * Since: 1.4.10
+ **/
+const gchar *
+cd_it8_reader_get_sheet_type (CdIt8Reader *reader)
+{
+	g_return_val_if_fail (reader != NULL, NULL);
+	return reader->sheet_type;
+}
+
+/**
+ * cd_it8_reader_get_property:
+ * @reader: a #CdIt8Reader
+ * @key: the property name, e.g. "COLOR_REP"
+ *
+ * Gets a property from the header, without any quotes.
+ *
+ * Return value: the property value, or %NULL if not set
+ *
+ * Since: 1.4.10
+ **/
+const gchar *
+cd_it8_reader_get_property (CdIt8Reader *reader, const gchar *key)
+{
+	g_return_val_if_fail (reader != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+	return g_hash_table_lookup (reader->properties, key);
+}
+
+/**
+ * cd_it8_reader_get_properties:
+ * @reader: a #CdIt8Reader
+ *
+ * Gets the names of all the properties in the header, in file order.
+ *
+ * Return value: (transfer none) (element-type utf8): the property names
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_it8_reader_get_properties (CdIt8Reader *reader)
+{
+	g_return_val_if_fail (reader != NULL, NULL);
+	return reader->keys;
+}
+
+/**
+ * cd_it8_reader_get_number_of_fields:
+ * @reader: a #CdIt8Reader
+ *
+ * Gets the number of fields in each data set.
+ *
+ * Return value: the number of fields
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_it8_reader_get_number_of_fields (CdIt8Reader *reader)
+{
+	g_return_val_if_fail (reader != NULL, 0);
+	return reader->number_of_fields;
+}
+
+/**
+ * cd_it8_reader_get_number_of_sets:
+ * @reader: a #CdIt8Reader
+ *
+ * Gets the number of data sets declared in the header.
+ *
+ * Return value: the number of sets, or 0 if not declared
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_it8_reader_get_number_of_sets (CdIt8Reader *reader)
+{
+	g_return_val_if_fail (reader != NULL, 0);
+	return reader->number_of_sets;
+}
+
+/**
+ * cd_it8_reader_get_field_name:
+ * @reader: a #CdIt8Reader
+ * @idx: the field index
+ *
+ * Gets the name of a field from the data format, e.g. "RGB_R".
+ *
+ * Return value: the field name, or %NULL if there is no data format
+ *
+ * Since: 1.4.10
+ **/
+const gchar *
+cd_it8_reader_get_field_name (CdIt8Reader *reader, guint idx)
+{
+	g_return_val_if_fail (reader != NULL, NULL);
+	if (idx >= reader->fields->len)
+		return NULL;
+	return g_ptr_array_index (reader->fields, idx);
+}
+
+/**
+ * cd_it8_reader_find_field:
+ * @reader: a #CdIt8Reader
+ * @name: the field name, e.g. "XYZ_X"
+ *
+ * Finds a field in the data format.
+ *
+ * Return value: the field index, or -1 if not found
+ *
+ * Since: 1.4.10
+ **/
+gint
+cd_it8_reader_find_field (CdIt8Reader *reader, const gchar *name)
+{
+	guint i;
+
+	g_return_val_if_fail (reader != NULL, -1);
+	g_return_val_if_fail (name != NULL, -1);
+
+	for (i = 0; i < reader->fields->len; i++) {
+		if (g_strcmp0 (g_ptr_array_index (reader->fields, i), name) == 0)
+			return (gint) i;
+	}
+	return -1;
+}
+
+/**
+ * cd_it8_reader_next_set:
+ * @reader: a #CdIt8Reader
+ * @values: (array) (allow-none): space for each field of the set, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Reads the next data set. cd_it8_reader_parse_header() must have been
+ * called first. Fields that are not numbers are set to 0.
+ *
+ * If there are no more sets then %FALSE is returned and @error is not set.
+ *
+ * Return value: %TRUE if a set was read
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_reader_next_set (CdIt8Reader *reader, gdouble *values, GError **error)
+{
+	CdIt8ReaderToken tok;
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	guint i;
+
+	g_return_val_if_fail (reader != NULL, FALSE);
+	g_return_val_if_fail (reader->in_data, FALSE);
+
+	/* all done */
+	if (reader->number_of_sets > 0 &&
+	    reader->sets_read >= reader->number_of_sets)
+		return FALSE;
+
+	for (i = 0; i < reader->number_of_fields; i++) {
+		gsize len;
+		if (!cd_it8_reader_next_token (reader, &tok) ||
+		    cd_it8_reader_token_is (&tok, "END_DATA")) {
+			/* not declared, so read to the end of the data */
+			if (i == 0 && reader->number_of_sets == 0)
+				return FALSE;
+			if (i == 0) {
+				g_set_error (error,
+					     CD_IT8_ERROR,
+					     CD_IT8_ERROR_INVALID_FORMAT,
+					     "Invalid format, expected %u sets, got %u",
+					     reader->number_of_sets,
+					     reader->sets_read);
+				return FALSE;
+			}
+			g_set_error (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "Invalid format, set %u has %u fields",
+				     reader->sets_read + 1, i);
+			return FALSE;
+		}
+		reader->set_ptr[i] = tok.ptr;
+		reader->set_len[i] = tok.len;
+		if (values == NULL)
+			continue;
+
+		/* the data may not be NUL terminated */
+		len = MIN (tok.len, sizeof (buf) - 1);
+		memcpy (buf, tok.ptr, len);
+		buf[len] = '\0';
+		values[i] = g_ascii_strtod (buf, NULL);
+	}
+	reader->sets_read++;
+	return TRUE;
+}
+
+/**
+ * cd_it8_reader_get_string:
+ * @reader: a #CdIt8Reader
+ * @idx: the field index
+ *
+ * Gets a field of the last set read by cd_it8_reader_next_set() as text,
+ * without any quotes. The value is only valid until this is next called.
+ *
+ * Return value: the field text, or %NULL for invalid
+ *
+ * Since: 1.4.10
+ **/
+const gchar *
+cd_it8_reader_get_string (CdIt8Reader *reader, guint idx)
+{
+	g_return_val_if_fail (reader != NULL, NULL);
+	g_return_val_if_fail (reader->sets_read > 0, NULL);
+	g_return_val_if_fail (idx < reader->number_of_fields, NULL);
+	g_string_truncate (reader->scratch, 0);
+	g_string_append_len (reader->scratch,
+			     reader->set_ptr[idx],
+			     (gssize) reader->set_len[idx]);
+	return reader->scratch->str;
+}
@@ -0,0 +1,61 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__COLORD_H_INSIDE__) && !defined (CD_COMPILATION)
+#error "Only <colord.h> can be included directly."
+#endif
+
+#ifndef __CD_IT8_READER_H
+#define __CD_IT8_READER_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CdIt8Reader	CdIt8Reader;
+
+CdIt8Reader	*cd_it8_reader_new			(GBytes		*bytes);
+void		 cd_it8_reader_free			(CdIt8Reader	*reader);
+gboolean	 cd_it8_reader_parse_header		(CdIt8Reader	*reader,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+const gchar	*cd_it8_reader_get_sheet_type		(CdIt8Reader	*reader);
+const gchar	*cd_it8_reader_get_property		(CdIt8Reader	*reader,
+							 const gchar	*key);
+GPtrArray	*cd_it8_reader_get_properties		(CdIt8Reader	*reader);
+guint		 cd_it8_reader_get_number_of_fields	(CdIt8Reader	*reader);
+guint		 cd_it8_reader_get_number_of_sets	(CdIt8Reader	*reader);
+const gchar	*cd_it8_reader_get_field_name		(CdIt8Reader	*reader,
+							 guint		 idx);
+gint		 cd_it8_reader_find_field		(CdIt8Reader	*reader,
+							 const gchar	*name);
+gboolean	 cd_it8_reader_next_set			(CdIt8Reader	*reader,
+							 gdouble	*values,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+const gchar	*cd_it8_reader_get_string		(CdIt8Reader	*reader,
+							 guint		 idx);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdIt8Reader, cd_it8_reader_free)
+
+G_END_DECLS
+
+#endif /* __CD_IT8_READER_H */
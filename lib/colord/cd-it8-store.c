@@ -0,0 +1,912 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:cd-it8-store
+ * @short_description: An index of colorimeter correction files
+ *
+ * This object finds CCMX and CCSS correction files in one or more
+ * locations and remembers which instrument, display technology and
+ * display model each one was made for. Only the header of each file is
+ * read when searching, and the full file is only parsed when the
+ * correction is actually used.
+ *
+ * See also: #CdIt8
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib-object.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "cd-it8-reader.h"
+#include "cd-it8-store.h"
+
+static void	cd_it8_store_finalize	(GObject	*object);
+
+#define GET_PRIVATE(o) (cd_it8_store_get_instance_private (o))
+
+typedef struct
+{
+	GPtrArray		*items;		/* of CdIt8StoreItem */
+	GHashTable		*filename_hash;	/* filename : CdIt8StoreItem */
+	GHashTable		*instrument_hash; /* instrument : GPtrArray */
+	GPtrArray		*spectral; /* of CdIt8StoreItem, CCSS with no instrument */
+	gchar			*index_fn;
+	GKeyFile		*index;		/* group is the filename */
+	GKeyFile		*index_used;
+	gboolean		 index_dirty;
+} CdIt8StorePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (CdIt8Store, cd_it8_store, G_TYPE_OBJECT)
+
+#define CD_IT8_STORE_MAX_RECURSION_LEVELS	2
+
+/* the match scores, where more specific is better */
+#define CD_IT8_STORE_SCORE_KIND_FAMILY		1
+#define CD_IT8_STORE_SCORE_KIND_EXACT		2
+#define CD_IT8_STORE_SCORE_DISPLAY_PARTIAL	4
+#define CD_IT8_STORE_SCORE_DISPLAY_EXACT	8
+
+typedef struct {
+	gchar		*filename;
+	gchar		*index_key;
+	CdIt8Kind	 kind;
+	gchar		*instrument;
+	gchar		**instrument_keys;	/* normalized */
+	guint32		 display_kinds;		/* bitfield of CdSensorCap */
+	gchar		*display;
+	gchar		*display_key;		/* normalized */
+	CdIt8		*it8;			/* only set when loaded */
+} CdIt8StoreItem;
+
+static void
+cd_it8_store_item_free (CdIt8StoreItem *item)
+{
+	g_free (item->filename);
+	g_free (item->index_key);
+	g_free (item->instrument);
+	g_strfreev (item->instrument_keys);
+	g_free (item->display);
+	g_free (item->display_key);
+	if (item->it8 != NULL)
+		g_object_unref (item->it8);
+	g_free (item);
+}
+
+/* only keep the letters and numbers, so that "i1 Display-Pro" and
+ * "i1DisplayPro" are the same thing */
+static gchar *
+cd_it8_store_normalize (const gchar *text)
+{
+	GString *str;
+
+	if (text == NULL)
+		return NULL;
+	str = g_string_new (NULL);
+	for (guint i = 0; text[i] != '\0'; i++) {
+		if (g_ascii_isalnum (text[i]))
+			g_string_append_c (str, g_ascii_tolower (text[i]));
+	}
+	if (str->len == 0) {
+		g_string_free (str, TRUE);
+		return NULL;
+	}
+	return g_string_free (str, FALSE);
+}
+
+/* a CCMX file can be shared by several instruments with the same
+ * sensor, e.g. "i1 DisplayPro, ColorMunki Display" */
+static gchar **
+cd_it8_store_split_instrument (const gchar *instrument)
+{
+	GPtrArray *keys;
+	g_auto(GStrv) split = NULL;
+
+	if (instrument == NULL)
+		return NULL;
+	keys = g_ptr_array_new ();
+	split = g_strsplit (instrument, ",", -1);
+	for (guint i = 0; split[i] != NULL; i++) {
+		gchar *key = cd_it8_store_normalize (split[i]);
+		if (key != NULL)
+			g_ptr_array_add (keys, key);
+	}
+	if (keys->len == 0) {
+		g_ptr_array_free (keys, TRUE);
+		return NULL;
+	}
+	g_ptr_array_add (keys, NULL);
+	return (gchar **) g_ptr_array_free (keys, FALSE);
+}
+
+static gboolean
+cd_it8_store_display_kind_is_lcd (CdSensorCap display_kind)
+{
+	switch (display_kind) {
+	case CD_SENSOR_CAP_LCD:
+	case CD_SENSOR_CAP_LCD_CCFL:
+	case CD_SENSOR_CAP_LCD_RGB_LED:
+	case CD_SENSOR_CAP_LCD_WHITE_LED:
+	case CD_SENSOR_CAP_WIDE_GAMUT_LCD_CCFL:
+	case CD_SENSOR_CAP_WIDE_GAMUT_LCD_RGB_LED:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static guint32
+cd_it8_store_get_lcd_mask (void)
+{
+	guint32 mask = 0;
+	for (guint i = 0; i < CD_SENSOR_CAP_LAST; i++) {
+		if (cd_it8_store_display_kind_is_lcd (i))
+			mask |= 1u << i;
+	}
+	return mask;
+}
+
+/* CCMX files made by colord use TYPE_x options, and files made by
+ * ArgyllCMS use a free-form TECHNOLOGY such as "LCD White LED IPS" */
+static guint32
+cd_it8_store_get_display_kinds (CdIt8Reader *reader)
+{
+	const gchar *tmp;
+	guint32 display_kinds = 0;
+	g_autofree gchar *tech = NULL;
+	struct {
+		const gchar	*key;
+		CdSensorCap	 display_kind;
+	} options[] = {
+		{ "TYPE_LCD",		CD_SENSOR_CAP_LCD },
+		{ "TYPE_LED",		CD_SENSOR_CAP_LED },
+		{ "TYPE_CRT",		CD_SENSOR_CAP_CRT },
+		{ "TYPE_PROJECTOR",	CD_SENSOR_CAP_PROJECTOR },
+		{ NULL,			CD_SENSOR_CAP_UNKNOWN } };
+
+	for (guint i = 0; options[i].key != NULL; i++) {
+		tmp = cd_it8_reader_get_property (reader, options[i].key);
+		if (g_strcmp0 (tmp, "YES") == 0)
+			display_kinds |= 1u << options[i].display_kind;
+	}
+
+	tmp = cd_it8_reader_get_property (reader, "TECHNOLOGY");
+	if (tmp == NULL)
+		return display_kinds;
+	tech = g_ascii_strdown (tmp, -1);
+	if (strstr (tech, "crt") != NULL)
+		display_kinds |= 1u << CD_SENSOR_CAP_CRT;
+	if (strstr (tech, "projector") != NULL)
+		display_kinds |= 1u << CD_SENSOR_CAP_PROJECTOR;
+	if (strstr (tech, "plasma") != NULL)
+		display_kinds |= 1u << CD_SENSOR_CAP_PLASMA;
+	if (strstr (tech, "lcd") != NULL) {
+		gboolean wide = strstr (tech, "wide") != NULL;
+		if (strstr (tech, "ccfl") != NULL) {
+			display_kinds |= 1u << (wide ? CD_SENSOR_CAP_WIDE_GAMUT_LCD_CCFL :
+						       CD_SENSOR_CAP_LCD_CCFL);
+		} else if (strstr (tech, "rgb led") != NULL) {
+			display_kinds |= 1u << (wide ? CD_SENSOR_CAP_WIDE_GAMUT_LCD_RGB_LED :
+						       CD_SENSOR_CAP_LCD_RGB_LED);
+		} else if (strstr (tech, "white led") != NULL) {
+			display_kinds |= 1u << CD_SENSOR_CAP_LCD_WHITE_LED;
+		} else {
+			display_kinds |= 1u << CD_SENSOR_CAP_LCD;
+		}
+	} else if (strstr (tech, "led") != NULL) {
+		display_kinds |= 1u << CD_SENSOR_CAP_LED;
+	}
+	return display_kinds;
+}
+
+static gchar *
+cd_it8_store_get_index_key (const gchar *filename)
+{
+	GStatBuf st;
+	if (g_stat (filename, &st) != 0)
+		return NULL;
+	return g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+				(guint64) st.st_ino,
+				(gint64) st.st_mtime,
+				(gint64) st.st_size);
+}
+
+static gboolean
+cd_it8_store_index_is_usable (CdIt8Store *store, const gchar *filename)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	if (priv->index == NULL)
+		return FALSE;
+	return strpbrk (filename, "[]\n") == NULL;
+}
+
+static gboolean
+cd_it8_store_item_load_index (CdIt8Store *store, CdIt8StoreItem *item)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	g_autofree gchar *key = NULL;
+	g_auto(GStrv) display_kinds = NULL;
+
+	key = g_key_file_get_string (priv->index, item->filename, "Stat", NULL);
+	if (g_strcmp0 (key, item->index_key) != 0)
+		return FALSE;
+	item->kind = g_key_file_get_integer (priv->index, item->filename, "Kind", NULL);
+	if (item->kind != CD_IT8_KIND_CCMX && item->kind != CD_IT8_KIND_CCSS)
+		return FALSE;
+	item->instrument = g_key_file_get_string (priv->index, item->filename,
+						  "Instrument", NULL);
+	item->display = g_key_file_get_string (priv->index, item->filename,
+					       "Display", NULL);
+	display_kinds = g_key_file_get_string_list (priv->index, item->filename,
+						    "DisplayKinds", NULL, NULL);
+	for (guint i = 0; display_kinds != NULL && display_kinds[i] != NULL; i++) {
+		CdSensorCap display_kind = cd_sensor_cap_from_string (display_kinds[i]);
+		if (display_kind != CD_SENSOR_CAP_UNKNOWN)
+			item->display_kinds |= 1u << display_kind;
+	}
+	return TRUE;
+}
+
+static void
+cd_it8_store_item_save_index (CdIt8Store *store, CdIt8StoreItem *item)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GPtrArray) display_kinds = g_ptr_array_new ();
+
+	g_key_file_remove_group (priv->index_used, item->filename, NULL);
+	g_key_file_set_string (priv->index_used, item->filename, "Stat", item->index_key);
+	g_key_file_set_integer (priv->index_used, item->filename, "Kind", item->kind);
+	if (item->instrument != NULL) {
+		g_key_file_set_string (priv->index_used, item->filename,
+				       "Instrument", item->instrument);
+	}
+	if (item->display != NULL) {
+		g_key_file_set_string (priv->index_used, item->filename,
+				       "Display", item->display);
+	}
+	for (guint i = 0; i < CD_SENSOR_CAP_LAST; i++) {
+		if ((item->display_kinds & (1u << i)) > 0)
+			g_ptr_array_add (display_kinds, (gpointer) cd_sensor_cap_to_string (i));
+	}
+	if (display_kinds->len > 0) {
+		g_key_file_set_string_list (priv->index_used, item->filename,
+					    "DisplayKinds",
+					    (const gchar * const *) display_kinds->pdata,
+					    display_kinds->len);
+	}
+}
+
+/* only the header is parsed, the data is not needed until it is used */
+static gboolean
+cd_it8_store_item_load_header (CdIt8StoreItem *item, GError **error)
+{
+	const gchar *tmp;
+	g_autoptr(CdIt8Reader) reader = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GMappedFile) mapped = NULL;
+
+	mapped = g_mapped_file_new (item->filename, FALSE, error);
+	if (mapped == NULL)
+		return FALSE;
+	bytes = g_mapped_file_get_bytes (mapped);
+	reader = cd_it8_reader_new (bytes);
+	if (!cd_it8_reader_parse_header (reader, error))
+		return FALSE;
+
+	tmp = cd_it8_reader_get_sheet_type (reader);
+	if (g_str_has_prefix (tmp, "CCMX")) {
+		item->kind = CD_IT8_KIND_CCMX;
+		tmp = cd_it8_reader_get_property (reader, "INSTRUMENT");
+	} else if (g_str_has_prefix (tmp, "CCSS")) {
+		item->kind = CD_IT8_KIND_CCSS;
+		tmp = cd_it8_reader_get_property (reader, "TARGET_INSTRUMENT");
+	} else {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_UNKNOWN_KIND,
+			     "Not a correction sheet type: %s", tmp);
+		return FALSE;
+	}
+	item->instrument = g_strdup (tmp);
+	item->display = g_strdup (cd_it8_reader_get_property (reader, "DISPLAY"));
+	item->display_kinds = cd_it8_store_get_display_kinds (reader);
+	return TRUE;
+}
+
+static void
+cd_it8_store_add_item (CdIt8Store *store, CdIt8StoreItem *item)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	GPtrArray *array;
+
+	item->instrument_keys = cd_it8_store_split_instrument (item->instrument);
+	item->display_key = cd_it8_store_normalize (item->display);
+	g_ptr_array_add (priv->items, item);
+	g_hash_table_insert (priv->filename_hash, item->filename, item);
+
+	/* a CCMX is only ever used for the instrument it names, but a
+	 * spectral set without one is usable by any instrument */
+	if (item->instrument_keys == NULL) {
+		if (item->kind == CD_IT8_KIND_CCSS)
+			g_ptr_array_add (priv->spectral, item);
+		return;
+	}
+	for (guint i = 0; item->instrument_keys[i] != NULL; i++) {
+		const gchar *key = item->instrument_keys[i];
+		array = g_hash_table_lookup (priv->instrument_hash, key);
+		if (array == NULL) {
+			array = g_ptr_array_new ();
+			g_hash_table_insert (priv->instrument_hash,
+					     g_strdup (key), array);
+		}
+		g_ptr_array_add (array, item);
+	}
+}
+
+static void
+cd_it8_store_remove_item (CdIt8Store *store, CdIt8StoreItem *item)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+
+	g_ptr_array_remove (priv->spectral, item);
+	for (guint i = 0; item->instrument_keys != NULL &&
+			  item->instrument_keys[i] != NULL; i++) {
+		GPtrArray *array;
+		array = g_hash_table_lookup (priv->instrument_hash,
+					     item->instrument_keys[i]);
+		if (array != NULL)
+			g_ptr_array_remove (array, item);
+	}
+	g_hash_table_remove (priv->filename_hash, item->filename);
+	g_ptr_array_remove (priv->items, item);
+}
+
+static void
+cd_it8_store_add_file (CdIt8Store *store, const gchar *filename)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	CdIt8StoreItem *item;
+	CdIt8StoreItem *old;
+	g_autoptr(GError) error_local = NULL;
+
+	item = g_new0 (CdIt8StoreItem, 1);
+	item->filename = g_strdup (filename);
+	item->index_key = cd_it8_store_get_index_key (filename);
+
+	/* already added and not changed */
+	old = g_hash_table_lookup (priv->filename_hash, filename);
+	if (old != NULL && g_strcmp0 (old->index_key, item->index_key) == 0) {
+		cd_it8_store_item_free (item);
+		return;
+	}
+
+	/* use the index if the file has not changed since it was added */
+	if (item->index_key != NULL &&
+	    cd_it8_store_index_is_usable (store, filename) &&
+	    cd_it8_store_item_load_index (store, item)) {
+		g_debug ("CdIt8Store: using index for %s", filename);
+	} else {
+		g_clear_pointer (&item->instrument, g_free);
+		g_clear_pointer (&item->display, g_free);
+		item->display_kinds = 0;
+		if (!cd_it8_store_item_load_header (item, &error_local)) {
+			/* one bad file should not hide all the others */
+			g_debug ("CdIt8Store: ignoring %s: %s",
+				 filename, error_local->message);
+			cd_it8_store_item_free (item);
+			return;
+		}
+	}
+
+	/* remember for next time */
+	if (item->index_key != NULL &&
+	    cd_it8_store_index_is_usable (store, filename)) {
+		cd_it8_store_item_save_index (store, item);
+		priv->index_dirty = TRUE;
+	}
+
+	if (old != NULL)
+		cd_it8_store_remove_item (store, old);
+	cd_it8_store_add_item (store, item);
+}
+
+static gboolean
+cd_it8_store_search_path (CdIt8Store *store,
+			  const gchar *path,
+			  guint depth,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	GError *error_local = NULL;
+	g_autoptr(GFileEnumerator) enumerator = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	/* get contents of directory */
+	file = g_file_new_for_path (path);
+	enumerator = g_file_enumerate_children (file,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						cancellable,
+						error);
+	if (enumerator == NULL)
+		return FALSE;
+
+	/* get all the files */
+	while (TRUE) {
+		const gchar *name;
+		g_autofree gchar *full_path = NULL;
+		g_autoptr(GFileInfo) info = NULL;
+
+		info = g_file_enumerator_next_file (enumerator,
+						    cancellable,
+						    &error_local);
+		if (info == NULL && error_local != NULL) {
+			g_propagate_error (error, error_local);
+			return FALSE;
+		}
+
+		/* special value, meaning "no more files to process" */
+		if (info == NULL)
+			break;
+
+		/* further down the worm-hole */
+		name = g_file_info_get_name (info);
+		full_path = g_build_filename (path, name, NULL);
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			g_autoptr(GError) error_subdir = NULL;
+
+			/* a bad subdirectory does not stop the others loading */
+			if (depth >= CD_IT8_STORE_MAX_RECURSION_LEVELS) {
+				g_debug ("CdIt8Store: ignoring %s: more than %i levels deep",
+					 full_path, CD_IT8_STORE_MAX_RECURSION_LEVELS);
+				continue;
+			}
+			if (!cd_it8_store_search_path (store,
+						       full_path,
+						       depth + 1,
+						       cancellable,
+						       &error_subdir)) {
+				if (g_error_matches (error_subdir,
+						     G_IO_ERROR,
+						     G_IO_ERROR_CANCELLED)) {
+					g_propagate_error (error,
+							   g_steal_pointer (&error_subdir));
+					return FALSE;
+				}
+				g_debug ("CdIt8Store: ignoring %s: %s",
+					 full_path, error_subdir->message);
+			}
+			continue;
+		}
+
+		/* the content type is not known for these */
+		if (!g_str_has_suffix (name, ".ccmx") &&
+		    !g_str_has_suffix (name, ".ccss"))
+			continue;
+		cd_it8_store_add_file (store, full_path);
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_it8_store_index_save (CdIt8Store *store, GError **error)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	g_autofree gchar *dirname = NULL;
+
+	/* entries for files that have gone away are dropped */
+	dirname = g_path_get_dirname (priv->index_fn);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		return FALSE;
+	}
+	return g_key_file_save_to_file (priv->index_used, priv->index_fn, error);
+}
+
+/**
+ * cd_it8_store_set_index:
+ * @store: a #CdIt8Store instance.
+ * @filename: a filename for the index
+ * @error: A #GError or %NULL
+ *
+ * Sets a file to remember the header details of each correction, so that
+ * files that have not changed since the last time can be added without
+ * reading them at all. The files are matched using the inode,
+ * modification time and size of the file.
+ *
+ * The index is written at the end of each cd_it8_store_search_location()
+ * if anything has changed.
+ *
+ * This function can only be called once, and should be called before any
+ * locations are searched.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_store_set_index (CdIt8Store *store,
+			const gchar *filename,
+			GError **error)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (priv->index == NULL, FALSE);
+
+	/* a missing index is fine */
+	if (!g_key_file_load_from_file (kf, filename, G_KEY_FILE_NONE, &error_local)) {
+		if (!g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+	}
+	priv->index_fn = g_strdup (filename);
+	priv->index = g_steal_pointer (&kf);
+	priv->index_used = g_key_file_new ();
+	return TRUE;
+}
+
+/**
+ * cd_it8_store_search_location:
+ * @store: a #CdIt8Store instance.
+ * @location: a fully qualified path
+ * @cancellable: A #GCancellable or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Adds all the CCMX and CCSS files found in a location. Files that cannot
+ * be parsed and subdirectories that cannot be read or are nested too
+ * deeply are ignored, and a location that does not exist is not an
+ * error. Searching a location again adds any files that have changed.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_store_search_location (CdIt8Store *store,
+			      const gchar *location,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), FALSE);
+	g_return_val_if_fail (location != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* the directory does not exist */
+	if (!g_file_test (location, G_FILE_TEST_IS_DIR))
+		return TRUE;
+	if (!cd_it8_store_search_path (store, location, 0, cancellable, error))
+		return FALSE;
+
+	/* save the index if anything was added */
+	if (priv->index_dirty) {
+		if (!cd_it8_store_index_save (store, error))
+			return FALSE;
+		priv->index_dirty = FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_it8_store_get_size:
+ * @store: a #CdIt8Store instance.
+ *
+ * Gets the number of correction files in the store.
+ *
+ * Return value: the number of files
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_it8_store_get_size (CdIt8Store *store)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), 0);
+	return priv->items->len;
+}
+
+typedef struct {
+	CdIt8StoreItem	*item;
+	guint		 score;
+} CdIt8StoreMatch;
+
+static gint
+cd_it8_store_match_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const CdIt8StoreMatch *match_a = a;
+	const CdIt8StoreMatch *match_b = b;
+	if (match_a->score != match_b->score)
+		return match_a->score > match_b->score ? -1 : 1;
+	return g_strcmp0 (match_a->item->filename, match_b->item->filename);
+}
+
+/* returns FALSE if the file cannot be used for this display at all */
+static gboolean
+cd_it8_store_item_get_score (CdIt8StoreItem *item,
+			     CdSensorCap display_kind,
+			     const gchar *display_key,
+			     guint *score)
+{
+	*score = 0;
+
+	/* a file for any kind of display is usable but not preferred */
+	if (display_kind != CD_SENSOR_CAP_UNKNOWN && item->display_kinds != 0) {
+		if ((item->display_kinds & (1u << display_kind)) > 0) {
+			*score += CD_IT8_STORE_SCORE_KIND_EXACT;
+		} else if (cd_it8_store_display_kind_is_lcd (display_kind) &&
+			   (item->display_kinds & (1u << CD_SENSOR_CAP_LCD)) > 0) {
+			/* a generic LCD file for a specific backlight */
+			*score += CD_IT8_STORE_SCORE_KIND_FAMILY;
+		} else if (display_kind == CD_SENSOR_CAP_LCD &&
+			   (item->display_kinds & cd_it8_store_get_lcd_mask ()) > 0) {
+			/* a specific backlight file for a generic LCD */
+			*score += CD_IT8_STORE_SCORE_KIND_FAMILY;
+		} else {
+			return FALSE;
+		}
+	}
+
+	/* a file made for a different model is still better than nothing */
+	if (display_key != NULL && item->display_key != NULL) {
+		if (g_strcmp0 (display_key, item->display_key) == 0)
+			*score += CD_IT8_STORE_SCORE_DISPLAY_EXACT;
+		else if (strstr (item->display_key, display_key) != NULL)
+			*score += CD_IT8_STORE_SCORE_DISPLAY_PARTIAL;
+	}
+	return TRUE;
+}
+
+static void
+cd_it8_store_query_array (GArray *matches,
+			  GPtrArray *items,
+			  CdIt8Kind kind,
+			  CdSensorCap display_kind,
+			  const gchar *display_key)
+{
+	for (guint i = 0; items != NULL && i < items->len; i++) {
+		CdIt8StoreMatch match;
+		match.item = g_ptr_array_index (items, i);
+		if (kind != CD_IT8_KIND_UNKNOWN && match.item->kind != kind)
+			continue;
+		if (!cd_it8_store_item_get_score (match.item,
+						  display_kind,
+						  display_key,
+						  &match.score))
+			continue;
+		g_array_append_val (matches, match);
+	}
+}
+
+/**
+ * cd_it8_store_query:
+ * @store: a #CdIt8Store instance.
+ * @kind: a #CdIt8Kind, e.g. %CD_IT8_KIND_CCMX, or %CD_IT8_KIND_UNKNOWN for any
+ * @instrument: (nullable): the instrument model, e.g. "ColorMunki Display"
+ * @display_kind: a #CdSensorCap, e.g. %CD_SENSOR_CAP_LCD_WHITE_LED, or %CD_SENSOR_CAP_UNKNOWN
+ * @display: (nullable): the display model, e.g. from cd_edid_get_monitor_name()
+ *
+ * Finds the corrections that can be used for an instrument and display.
+ *
+ * The instrument has to match, ignoring case, spaces and punctuation.
+ * A CCMX file that does not say what instrument it was made for is only
+ * returned when @instrument is %NULL, but a CCSS file without one is
+ * returned for any instrument.
+ * A file made for a different kind of display is never returned, and a
+ * file made for the same display model is preferred. Only the index is
+ * used, and no files are read.
+ *
+ * Return value: (transfer container) (element-type utf8): filenames, best match first
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_it8_store_query (CdIt8Store *store,
+		    CdIt8Kind kind,
+		    const gchar *instrument,
+		    CdSensorCap display_kind,
+		    const gchar *display)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	GPtrArray *filenames;
+	g_autofree gchar *display_key = NULL;
+	g_autofree gchar *instrument_key = NULL;
+	g_autoptr(GArray) matches = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), NULL);
+
+	matches = g_array_new (FALSE, FALSE, sizeof (CdIt8StoreMatch));
+	display_key = cd_it8_store_normalize (display);
+	instrument_key = cd_it8_store_normalize (instrument);
+	if (instrument_key != NULL) {
+		GPtrArray *items;
+		items = g_hash_table_lookup (priv->instrument_hash, instrument_key);
+		cd_it8_store_query_array (matches, items, kind,
+					  display_kind, display_key);
+		if (kind != CD_IT8_KIND_CCMX) {
+			cd_it8_store_query_array (matches, priv->spectral, kind,
+						  display_kind, display_key);
+		}
+	} else {
+		cd_it8_store_query_array (matches, priv->items, kind,
+					  display_kind, display_key);
+	}
+
+	/* best first, and then in a stable order */
+	g_array_sort (matches, cd_it8_store_match_sort_cb);
+	filenames = g_ptr_array_new_with_free_func (g_free);
+	for (guint i = 0; i < matches->len; i++) {
+		CdIt8StoreMatch *match = &g_array_index (matches, CdIt8StoreMatch, i);
+		g_ptr_array_add (filenames, g_strdup (match->item->filename));
+	}
+	return filenames;
+}
+
+/**
+ * cd_it8_store_load:
+ * @store: a #CdIt8Store instance.
+ * @filename: a filename returned from cd_it8_store_query()
+ * @error: A #GError or %NULL
+ *
+ * Loads a correction from the store. The file is only parsed the first
+ * time, and the same object is returned after that.
+ *
+ * Return value: (transfer full): a #CdIt8, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdIt8 *
+cd_it8_store_load (CdIt8Store *store, const gchar *filename, GError **error)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	CdIt8StoreItem *item;
+	g_autoptr(CdIt8) it8 = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	item = g_hash_table_lookup (priv->filename_hash, filename);
+	if (item == NULL) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "%s is not in the store", filename);
+		return NULL;
+	}
+	if (item->it8 != NULL)
+		return g_object_ref (item->it8);
+
+	it8 = cd_it8_new ();
+	file = g_file_new_for_path (filename);
+	if (!cd_it8_load_from_file (it8, file, error))
+		return NULL;
+	item->it8 = g_object_ref (it8);
+	return g_steal_pointer (&it8);
+}
+
+/**
+ * cd_it8_store_find:
+ * @store: a #CdIt8Store instance.
+ * @kind: a #CdIt8Kind, e.g. %CD_IT8_KIND_CCMX, or %CD_IT8_KIND_UNKNOWN for any
+ * @instrument: (nullable): the instrument model, e.g. "ColorMunki Display"
+ * @display_kind: a #CdSensorCap, e.g. %CD_SENSOR_CAP_LCD_WHITE_LED, or %CD_SENSOR_CAP_UNKNOWN
+ * @display: (nullable): the display model, e.g. from cd_edid_get_monitor_name()
+ * @error: A #GError or %NULL
+ *
+ * Loads the best correction for an instrument and display.
+ * See cd_it8_store_query() for how the files are matched.
+ *
+ * Return value: (transfer full): a #CdIt8, or %NULL if no file matched
+ *
+ * Since: 1.4.10
+ **/
+CdIt8 *
+cd_it8_store_find (CdIt8Store *store,
+		   CdIt8Kind kind,
+		   const gchar *instrument,
+		   CdSensorCap display_kind,
+		   const gchar *display,
+		   GError **error)
+{
+	g_autoptr(GPtrArray) filenames = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8_STORE (store), NULL);
+
+	filenames = cd_it8_store_query (store, kind, instrument,
+					display_kind, display);
+	if (filenames->len == 0) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "no correction for %s",
+			     instrument != NULL ? instrument : "any instrument");
+		return NULL;
+	}
+	return cd_it8_store_load (store, g_ptr_array_index (filenames, 0), error);
+}
+
+static void
+cd_it8_store_class_init (CdIt8StoreClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = cd_it8_store_finalize;
+}
+
+static void
+cd_it8_store_init (CdIt8Store *store)
+{
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+	priv->items = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_it8_store_item_free);
+	priv->filename_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->instrument_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free,
+						       (GDestroyNotify) g_ptr_array_unref);
+	priv->spectral = g_ptr_array_new ();
+}
+
+static void
+cd_it8_store_finalize (GObject *object)
+{
+	CdIt8Store *store = CD_IT8_STORE (object);
+	CdIt8StorePrivate *priv = GET_PRIVATE (store);
+
+	g_hash_table_unref (priv->filename_hash);
+	g_hash_table_unref (priv->instrument_hash);
+	g_ptr_array_unref (priv->spectral);
+	g_ptr_array_unref (priv->items);
+	g_free (priv->index_fn);
+	if (priv->index != NULL) {
+		g_key_file_unref (priv->index);
+		g_key_file_unref (priv->index_used);
+	}
+
+	G_OBJECT_CLASS (cd_it8_store_parent_class)->finalize (object);
+}
+
+/**
+ * cd_it8_store_new:
+ *
+ * Creates a new #CdIt8Store object.
+ *
+ * Return value: a new CdIt8Store object.
+ *
+ * Since: 1.4.10
+ **/
+CdIt8Store *
+cd_it8_store_new (void)
+{
+	CdIt8Store *store;
+	store = g_object_new (CD_TYPE_IT8_STORE, NULL);
+	return CD_IT8_STORE (store);
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__COLORD_H_INSIDE__) && !defined (CD_COMPILATION)
+#error "Only <colord.h> can be included directly."
+#endif
+
+#ifndef __CD_IT8_STORE_H
+#define __CD_IT8_STORE_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "cd-enum.h"
+#include "cd-it8.h"
+
+G_BEGIN_DECLS
+
+#define CD_TYPE_IT8_STORE (cd_it8_store_get_type ())
+G_DECLARE_DERIVABLE_TYPE (CdIt8Store, cd_it8_store, CD, IT8_STORE, GObject)
+
+struct _CdIt8StoreClass
+{
+	GObjectClass		 parent_class;
+	/*< private >*/
+	/* Padding for future expansion */
+	void (*_cd_it8_store_reserved1) (void);
+	void (*_cd_it8_store_reserved2) (void);
+	void (*_cd_it8_store_reserved3) (void);
+	void (*_cd_it8_store_reserved4) (void);
+};
+
+CdIt8Store	*cd_it8_store_new		(void);
+gboolean	 cd_it8_store_set_index		(CdIt8Store	*store,
+						 const gchar	*filename,
+						 GError		**error);
+gboolean	 cd_it8_store_search_location	(CdIt8Store	*store,
+						 const gchar	*location,
+						 GCancellable	*cancellable,
+						 GError		**error);
+guint		 cd_it8_store_get_size		(CdIt8Store	*store);
+GPtrArray	*cd_it8_store_query		(CdIt8Store	*store,
+						 CdIt8Kind	 kind,
+						 const gchar	*instrument,
+						 CdSensorCap	 display_kind,
+						 const gchar	*display);
+CdIt8		*cd_it8_store_load		(CdIt8Store	*store,
+						 const gchar	*filename,
+						 GError		**error);
+CdIt8		*cd_it8_store_find		(CdIt8Store	*store,
+						 CdIt8Kind	 kind,
+						 const gchar	*instrument,
+						 CdSensorCap	 display_kind,
+						 const gchar	*display,
+						 GError		**error);
+
+G_END_DECLS
+
+#endif /* __CD_IT8_STORE_H */
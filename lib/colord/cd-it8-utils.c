@@ -30,11 +30,14 @@
 
 #include <glib-object.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <lcms2.h>
 
 #include "cd-color.h"
 #include "cd-it8-utils.h"
 #include "cd-math.h"
+#include "cd-transform.h"
 
 static gboolean
 ch_it8_utils_4color_read_data (CdIt8 *it8,
@@ -44,13 +47,13 @@ ch_it8_utils_4color_read_data (CdIt8 *it8,
 			       GError **error)
 {
 	CdColorXYZ ave_XYZ[5];
-	CdColorXYZ tmp_XYZ;
 	CdColorYxy tmp_Yxy[5];
+	const gdouble *data_xyz;
 	guint i, j;
 	guint len;
 
 	/* ensur we have multiple of 5s */
-	len = cd_it8_get_data_size (it8);
+	data_xyz = cd_it8_get_data_xyz (it8, &len);
 	if (len % 5 != 0) {
 		g_set_error_literal (error, 1, 0,
 				     "expected black, white, red, green, blue");
@@ -63,10 +66,10 @@ ch_it8_utils_4color_read_data (CdIt8 *it8,
 	for (i = 0; i < len; i += 5) {
 		/* black, white, red, green, blue */
 		for (j = 0; j < 5; j++) {
-			cd_it8_get_data_item (it8, i + j, NULL, &tmp_XYZ);
-			ave_XYZ[j].X += tmp_XYZ.X;
-			ave_XYZ[j].Y += tmp_XYZ.Y;
-			ave_XYZ[j].Z += tmp_XYZ.Z;
+			const gdouble *tmp_XYZ = data_xyz + (i + j) * 3;
+			ave_XYZ[j].X += tmp_XYZ[0];
+			ave_XYZ[j].Y += tmp_XYZ[1];
+			ave_XYZ[j].Z += tmp_XYZ[2];
 		}
 	}
 
@@ -225,6 +228,375 @@ cd_it8_utils_calculate_ccmx (CdIt8 *it8_reference,
 	return TRUE;
 }
 
+/**
+ * cd_it8_utils_calculate_ccmx_lsq:
+ * @it8_reference: The reference data
+ * @it8_measured: The measured data, with the same patches as @it8_reference
+ * @weights: (array) (allow-none): The weight for each patch, or %NULL
+ * @it8_ccmx: The calculated correction matrix
+ * @loo_error: (out) (allow-none): The leave-one-out error, or %NULL
+ * @error: A #GError, or %NULL
+ *
+ * This calculates the colorimeter correction matrix that maps the measured
+ * XYZ values onto the reference values with the smallest weighted squared
+ * error, which can use any number of patches rather than just the black,
+ * white, red, green and blue patches needed by cd_it8_utils_calculate_ccmx().
+ *
+ * If @loo_error is set then it is set to the RMS XYZ error for each patch
+ * when the matrix is fitted without that patch, which is a measure of how
+ * well the matrix will correct readings that are not in the training set.
+ * Patches with a weight of zero are not included.
+ *
+ * Return value: %TRUE if a correction matrix was found.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_utils_calculate_ccmx_lsq (CdIt8 *it8_reference,
+				 CdIt8 *it8_measured,
+				 const gdouble *weights,
+				 CdIt8 *it8_ccmx,
+				 gdouble *loo_error,
+				 GError **error)
+{
+	CdMat3x3 calibration;
+	CdMat3x3 mm;
+	CdMat3x3 mm_inv;
+	CdMat3x3 rm;
+	const gdouble *meas;
+	const gdouble *ref;
+	gdouble *mm_data = cd_mat33_get_data (&mm);
+	gdouble *rm_data = cd_mat33_get_data (&rm);
+	gdouble scale = 0.f;
+	guint i, j, k;
+	guint len;
+	guint len_meas;
+	guint used = 0;
+
+	g_return_val_if_fail (CD_IS_IT8 (it8_reference), FALSE);
+	g_return_val_if_fail (CD_IS_IT8 (it8_measured), FALSE);
+	g_return_val_if_fail (CD_IS_IT8 (it8_ccmx), FALSE);
+
+	ref = cd_it8_get_data_xyz (it8_reference, &len);
+	meas = cd_it8_get_data_xyz (it8_measured, &len_meas);
+	if (len != len_meas) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "reference has %u patches but measured has %u",
+			     len, len_meas);
+		return FALSE;
+	}
+
+	/* accumulate the normal equations, M = (R W Mᵀ)(M W Mᵀ)⁻¹ */
+	cd_mat33_clear (&rm);
+	cd_mat33_clear (&mm);
+	for (i = 0; i < len; i++) {
+		const gdouble *r = ref + i * 3;
+		const gdouble *m = meas + i * 3;
+		gdouble w = weights != NULL ? weights[i] : 1.f;
+		if (!isfinite (w) || w < 0.f) {
+			g_set_error (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "invalid weight %f for patch %u",
+				     w, i);
+			return FALSE;
+		}
+		if (w == 0.f)
+			continue;
+		for (j = 0; j < 3; j++) {
+			for (k = 0; k < 3; k++) {
+				rm_data[j * 3 + k] += w * r[j] * m[k];
+				mm_data[j * 3 + k] += w * m[j] * m[k];
+			}
+		}
+		used++;
+	}
+	if (used < 3) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "at least 3 weighted patches are required, got %u",
+			     used);
+		return FALSE;
+	}
+
+	/* invert at unit scale so the tolerance does not depend on the units */
+	for (i = 0; i < 9; i++)
+		scale = MAX (scale, fabs (mm_data[i]));
+	cd_mat33_scalar_multiply (&mm, 1.f / scale, &mm);
+	if (!cd_mat33_reciprocal (&mm, &mm_inv)) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "the measured patches do not cover enough colors");
+		return FALSE;
+	}
+	cd_mat33_scalar_multiply (&mm_inv, 1.f / scale, &mm_inv);
+	cd_mat33_matrix_multiply (&rm, &mm_inv, &calibration);
+	if (!cd_mat33_is_finite (&calibration, error))
+		return FALSE;
+
+	/* the leave-one-out residual is the residual scaled by the leverage */
+	if (loo_error != NULL) {
+		gdouble sum = 0.f;
+		for (i = 0; i < len; i++) {
+			CdVec3 m;
+			CdVec3 pred;
+			CdVec3 tmp;
+			gdouble h;
+			gdouble w = weights != NULL ? weights[i] : 1.f;
+			if (w == 0.f)
+				continue;
+			cd_vec3_init (&m, meas[i * 3 + 0], meas[i * 3 + 1], meas[i * 3 + 2]);
+			cd_mat33_vector_multiply (&mm_inv, &m, &tmp);
+			h = w * (m.v0 * tmp.v0 + m.v1 * tmp.v1 + m.v2 * tmp.v2);
+			if (h > 1.f - 1e-9) {
+				g_set_error (error,
+					     CD_IT8_ERROR,
+					     CD_IT8_ERROR_FAILED,
+					     "the matrix cannot be fitted without patch %u",
+					     i);
+				return FALSE;
+			}
+			cd_mat33_vector_multiply (&calibration, &m, &pred);
+			cd_vec3_init (&tmp, ref[i * 3 + 0], ref[i * 3 + 1], ref[i * 3 + 2]);
+			sum += cd_vec3_squared_error (&tmp, &pred) / ((1.f - h) * (1.f - h));
+		}
+		*loo_error = sqrt (sum / used);
+	}
+
+	/* save to ccmx file */
+	cd_it8_set_matrix (it8_ccmx, &calibration);
+	cd_it8_set_instrument (it8_ccmx, cd_it8_get_instrument (it8_measured));
+	cd_it8_set_reference (it8_ccmx, cd_it8_get_instrument (it8_reference));
+	return TRUE;
+}
+
+/* the weights for each channel, with the illuminant and the scale folded in */
+struct _CdIt8UtilsPlan {
+	guint			 size;
+	gdouble			 resolution;
+	gdouble			*wavelengths;
+	gdouble			*weights[3];
+};
+
+#define CD_IT8_UTILS_PLAN_STACK_SIZE	1024
+
+/**
+ * cd_it8_utils_plan_new:
+ * @cmf: The color match function
+ * @illuminant: The illuminant (you can use cd_spectrum_new() for type E)
+ * @resolution: The resolution in nm, typically 1.0
+ * @error: A #GError, or %NULL
+ *
+ * Precomputes the parts of cd_it8_utils_calculate_xyz_from_cmf() that only
+ * depend on the CMF and illuminant, so that many spectra can be converted
+ * to XYZ cheaply.
+ *
+ * Return value: (transfer full): a #CdIt8UtilsPlan, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdIt8UtilsPlan *
+cd_it8_utils_plan_new (CdIt8 *cmf,
+		       CdSpectrum *illuminant,
+		       gdouble resolution,
+		       GError **error)
+{
+	CdIt8UtilsPlan *plan;
+	CdSpectrum *observer[3];
+	gdouble end;
+	gdouble i_val;
+	gdouble scale = 0.f;
+	gdouble start;
+	gdouble wl;
+	guint i;
+	guint j;
+
+	g_return_val_if_fail (CD_IS_IT8 (cmf), NULL);
+	g_return_val_if_fail (illuminant != NULL, NULL);
+	g_return_val_if_fail (resolution > 0.f, NULL);
+
+	/* check this is a CMF */
+	if (cd_it8_get_kind (cmf) != CD_IT8_KIND_CMF) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "not a CMF IT8 object");
+		return NULL;
+	}
+	observer[0] = cd_it8_get_spectrum_by_id (cmf, "X");
+	observer[1] = cd_it8_get_spectrum_by_id (cmf, "Y");
+	observer[2] = cd_it8_get_spectrum_by_id (cmf, "Z");
+	if (observer[0] == NULL || observer[1] == NULL || observer[2] == NULL) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "CMF IT8 object has no X,Y,Y channel");
+		return NULL;
+	}
+
+	/* use exactly the same wavelengths as stepping through would */
+	start = cd_spectrum_get_start (observer[0]);
+	end = cd_spectrum_get_end (observer[0]);
+	plan = g_new0 (CdIt8UtilsPlan, 1);
+	plan->resolution = resolution;
+	for (wl = start; wl <= end; wl += resolution)
+		plan->size++;
+	plan->wavelengths = g_new (gdouble, plan->size);
+	for (j = 0; j < 3; j++)
+		plan->weights[j] = g_new (gdouble, plan->size);
+	for (i = 0, wl = start; i < plan->size; i++, wl += resolution) {
+		plan->wavelengths[i] = wl;
+		i_val = cd_spectrum_get_value_for_nm (illuminant, wl);
+		for (j = 0; j < 3; j++)
+			plan->weights[j][i] = i_val * cd_spectrum_get_value_for_nm (observer[j], wl);
+		scale += plan->weights[1][i];
+	}
+
+	/* scale by Y */
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < plan->size; i++)
+			plan->weights[j][i] /= scale;
+	}
+	return plan;
+}
+
+/**
+ * cd_it8_utils_plan_free:
+ * @plan: a #CdIt8UtilsPlan, or %NULL
+ *
+ * Frees a plan created with cd_it8_utils_plan_new().
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_utils_plan_free (CdIt8UtilsPlan *plan)
+{
+	guint j;
+	if (plan == NULL)
+		return;
+	for (j = 0; j < 3; j++)
+		g_free (plan->weights[j]);
+	g_free (plan->wavelengths);
+	g_free (plan);
+}
+
+/* gets the spectrum values at evenly spaced wavelengths */
+static void
+cd_it8_utils_sample_grid (const gdouble *wavelengths,
+			  guint size,
+			  gdouble resolution,
+			  CdSpectrum *spectrum,
+			  gdouble *samples)
+{
+	GArray *data = cd_spectrum_get_data (spectrum);
+	gdouble c2 = 0.f;
+	gdouble c3 = 0.f;
+	gdouble norm = cd_spectrum_get_norm (spectrum);
+	guint i = 0;
+
+	/* the spectrum is on the same grid, so use the values as-is */
+	cd_spectrum_get_wavelength_cal (spectrum, NULL, &c2, &c3);
+	if (size > 0 && data->len > 1 && c2 == 0.f && c3 == 0.f &&
+	    fabs (cd_spectrum_get_start (spectrum) - wavelengths[0]) < 1e-6 &&
+	    fabs (cd_spectrum_get_wavelength (spectrum, 1) -
+		  cd_spectrum_get_start (spectrum) - resolution) < 1e-6) {
+		const gdouble *raw = (const gdouble *) data->data;
+		guint size_raw = MIN (size, data->len);
+		gdouble end = cd_spectrum_get_end (spectrum);
+		for (; i < size_raw && wavelengths[i] <= end; i++)
+			samples[i] = raw[i] * norm;
+	}
+
+	/* interpolate the rest */
+	for (; i < size; i++)
+		samples[i] = cd_spectrum_get_value_for_nm (spectrum, wavelengths[i]);
+}
+
+static void
+cd_it8_utils_plan_integrate (const CdIt8UtilsPlan *plan,
+			     const gdouble *samples,
+			     CdColorXYZ *value)
+{
+	const gdouble *wx = plan->weights[0];
+	const gdouble *wy = plan->weights[1];
+	const gdouble *wz = plan->weights[2];
+	gdouble x = 0.f;
+	gdouble y = 0.f;
+	gdouble z = 0.f;
+	guint i;
+
+	/* one pass, no calls, so the compiler can vectorize this */
+	for (i = 0; i < plan->size; i++) {
+		x += wx[i] * samples[i];
+		y += wy[i] * samples[i];
+		z += wz[i] * samples[i];
+	}
+	value->X = x;
+	value->Y = y;
+	value->Z = z;
+}
+
+/**
+ * cd_it8_utils_plan_calculate_xyz:
+ * @plan: a #CdIt8UtilsPlan
+ * @spectrum: The #CdSpectrum input data
+ * @value: The #CdColorXYZ result
+ *
+ * This calculates the XYZ of a spectrum using the CMF and illuminant of
+ * the plan.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_utils_plan_calculate_xyz (const CdIt8UtilsPlan *plan,
+				 CdSpectrum *spectrum,
+				 CdColorXYZ *value)
+{
+	cd_it8_utils_plan_calculate_xyz_batch (plan, &spectrum, value, 1);
+}
+
+/**
+ * cd_it8_utils_plan_calculate_xyz_batch:
+ * @plan: a #CdIt8UtilsPlan
+ * @spectra: (array length=n_spectra): The #CdSpectrum input data
+ * @values: (array length=n_spectra): The #CdColorXYZ results
+ * @n_spectra: the number of spectra
+ *
+ * This calculates the XYZ of many spectra using the CMF and illuminant of
+ * the plan. The plan is not modified and so can be shared between threads.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_utils_plan_calculate_xyz_batch (const CdIt8UtilsPlan *plan,
+				       CdSpectrum **spectra,
+				       CdColorXYZ *values,
+				       guint n_spectra)
+{
+	gdouble samples_stack[CD_IT8_UTILS_PLAN_STACK_SIZE];
+	gdouble *samples = samples_stack;
+	g_autofree gdouble *samples_heap = NULL;
+	guint i;
+
+	g_return_if_fail (plan != NULL);
+	g_return_if_fail (spectra != NULL || n_spectra == 0);
+	g_return_if_fail (values != NULL || n_spectra == 0);
+
+	if (plan->size > CD_IT8_UTILS_PLAN_STACK_SIZE) {
+		samples_heap = g_new (gdouble, plan->size);
+		samples = samples_heap;
+	}
+	for (i = 0; i < n_spectra; i++) {
+		cd_it8_utils_sample_grid (plan->wavelengths, plan->size,
+					  plan->resolution, spectra[i], samples);
+		cd_it8_utils_plan_integrate (plan, samples, &values[i]);
+	}
+}
+
 /**
  * cd_it8_utils_calculate_xyz_from_cmf:
  * @cmf: The color match function
@@ -246,18 +618,64 @@ cd_it8_utils_calculate_xyz_from_cmf (CdIt8 *cmf,
 				     gdouble resolution,
 				     GError **error)
 {
+	g_autoptr(CdIt8UtilsPlan) plan = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8 (cmf), FALSE);
+	g_return_val_if_fail (illuminant != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	plan = cd_it8_utils_plan_new (cmf, illuminant, resolution, error);
+	if (plan == NULL)
+		return FALSE;
+	cd_it8_utils_plan_calculate_xyz (plan, spectrum, value);
+	return TRUE;
+}
+
+/* the CMF and TCS sampled once, shared by every illuminant */
+#define CD_IT8_UTILS_CRI_TCS_SIZE	8
+
+struct _CdIt8UtilsCri {
+	guint			 size;
+	gdouble			 resolution;
+	gdouble			 y_sum;
+	gdouble			*wavelengths;
+	gdouble			*cmf[3];
+	gdouble			*tcs[CD_IT8_UTILS_CRI_TCS_SIZE];
+};
+
+/**
+ * cd_it8_utils_cri_new:
+ * @cmf: The color match function
+ * @tcs: The CIE TCS test patches
+ * @resolution: The resolution in nm, typically 1.0
+ * @error: A #GError, or %NULL
+ *
+ * Precomputes the parts of cd_it8_utils_calculate_cri_from_cmf() that only
+ * depend on the CMF and test color samples, so that the CRI of many
+ * illuminants can be calculated cheaply.
+ *
+ * Return value: (transfer full): a #CdIt8UtilsCri, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdIt8UtilsCri *
+cd_it8_utils_cri_new (CdIt8 *cmf,
+		      CdIt8 *tcs,
+		      gdouble resolution,
+		      GError **error)
+{
+	CdIt8UtilsCri *cri;
 	CdSpectrum *observer[3];
+	GPtrArray *samples;
 	gdouble end;
-	gdouble i_val;
-	gdouble o_val;
-	gdouble s_val;
-	gdouble scale = 0.f;
 	gdouble start;
 	gdouble wl;
+	guint i;
+	guint j;
 
-	g_return_val_if_fail (CD_IS_IT8 (cmf), FALSE);
-	g_return_val_if_fail (illuminant != NULL, FALSE);
-	g_return_val_if_fail (value != NULL, FALSE);
+	g_return_val_if_fail (CD_IS_IT8 (cmf), NULL);
+	g_return_val_if_fail (CD_IS_IT8 (tcs), NULL);
+	g_return_val_if_fail (resolution > 0.f, NULL);
 
 	/* check this is a CMF */
 	if (cd_it8_get_kind (cmf) != CD_IT8_KIND_CMF) {
@@ -265,7 +683,7 @@ cd_it8_utils_calculate_xyz_from_cmf (CdIt8 *cmf,
 				     CD_IT8_ERROR,
 				     CD_IT8_ERROR_FAILED,
 				     "not a CMF IT8 object");
-		return FALSE;
+		return NULL;
 	}
 	observer[0] = cd_it8_get_spectrum_by_id (cmf, "X");
 	observer[1] = cd_it8_get_spectrum_by_id (cmf, "Y");
@@ -275,82 +693,141 @@ cd_it8_utils_calculate_xyz_from_cmf (CdIt8 *cmf,
 				     CD_IT8_ERROR,
 				     CD_IT8_ERROR_FAILED,
 				     "CMF IT8 object has no X,Y,Y channel");
-		return FALSE;
+		return NULL;
+	}
+	samples = cd_it8_get_spectrum_array (tcs);
+	if (samples->len < CD_IT8_UTILS_CRI_TCS_SIZE) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "expected %i TCS samples, got %u",
+			     CD_IT8_UTILS_CRI_TCS_SIZE, samples->len);
+		return NULL;
 	}
 
-	/* calculate the integrals */
+	/* use exactly the same wavelengths as stepping through would */
 	start = cd_spectrum_get_start (observer[0]);
 	end = cd_spectrum_get_end (observer[0]);
-	cd_color_xyz_clear (value);
-	for (wl = start; wl <= end; wl += resolution) {
-		i_val = cd_spectrum_get_value_for_nm (illuminant, wl);
-		s_val = cd_spectrum_get_value_for_nm (spectrum, wl);
-		o_val = cd_spectrum_get_value_for_nm (observer[0], wl);
-		value->X += i_val * o_val * s_val;
-		o_val = cd_spectrum_get_value_for_nm (observer[1], wl);
-		scale += i_val * o_val;
-		value->Y += i_val * o_val * s_val;
-		o_val = cd_spectrum_get_value_for_nm (observer[2], wl);
-		value->Z += i_val * o_val * s_val;
+	cri = g_new0 (CdIt8UtilsCri, 1);
+	cri->resolution = resolution;
+	for (wl = start; wl <= end; wl += resolution)
+		cri->size++;
+	cri->wavelengths = g_new (gdouble, cri->size);
+	for (i = 0, wl = start; i < cri->size; i++, wl += resolution)
+		cri->wavelengths[i] = wl;
+	for (j = 0; j < 3; j++) {
+		cri->cmf[j] = g_new (gdouble, cri->size);
+		cd_it8_utils_sample_grid (cri->wavelengths, cri->size,
+					  resolution, observer[j], cri->cmf[j]);
 	}
-
-	/* scale by Y */
-	value->X /= scale;
-	value->Y /= scale;
-	value->Z /= scale;
-	return TRUE;
+	for (i = 0; i < cri->size; i++)
+		cri->y_sum += cri->cmf[1][i];
+	for (j = 0; j < CD_IT8_UTILS_CRI_TCS_SIZE; j++) {
+		cri->tcs[j] = g_new (gdouble, cri->size);
+		cd_it8_utils_sample_grid (cri->wavelengths, cri->size,
+					  resolution,
+					  g_ptr_array_index (samples, j),
+					  cri->tcs[j]);
+	}
+	return cri;
 }
 
 /**
- * cd_it8_utils_calculate_cri_from_cmf:
- * @cmf: The color match function
- * @tcs: The CIE TCS test patches
- * @illuminant: The illuminant
- * @value: The CRI result
- * @resolution: The resolution in nm, typically 1.0
- * @error: A #GError, or %NULL
+ * cd_it8_utils_cri_free:
+ * @cri: a #CdIt8UtilsCri, or %NULL
  *
- * This calculates the CRI for a specific illuminant.
+ * Frees a context created with cd_it8_utils_cri_new().
  *
- * Return value: %TRUE if a XYZ value was set.
+ * Since: 1.4.10
  **/
-gboolean
-cd_it8_utils_calculate_cri_from_cmf (CdIt8 *cmf,
-				     CdIt8 *tcs,
+void
+cd_it8_utils_cri_free (CdIt8UtilsCri *cri)
+{
+	guint j;
+	if (cri == NULL)
+		return;
+	for (j = 0; j < 3; j++)
+		g_free (cri->cmf[j]);
+	for (j = 0; j < CD_IT8_UTILS_CRI_TCS_SIZE; j++)
+		g_free (cri->tcs[j]);
+	g_free (cri->wavelengths);
+	g_free (cri);
+}
+
+/* gets the UVW of each TCS lit by an illuminant already on the grid */
+static void
+cd_it8_utils_cri_get_tcs_uvw (const CdIt8UtilsCri *cri,
+			      const gdouble *light,
+			      const CdColorXYZ *white,
+			      CdColorUVW *uvw)
+{
+	CdColorXYZ xyz;
+	const gdouble *r;
+	gdouble scale = 0.f;
+	gdouble w;
+	guint i;
+	guint j;
+
+	for (i = 0; i < cri->size; i++)
+		scale += light[i] * cri->cmf[1][i];
+	for (j = 0; j < CD_IT8_UTILS_CRI_TCS_SIZE; j++) {
+		r = cri->tcs[j];
+		xyz.X = 0.f;
+		xyz.Y = 0.f;
+		xyz.Z = 0.f;
+		for (i = 0; i < cri->size; i++) {
+			w = light[i] * r[i];
+			xyz.X += w * cri->cmf[0][i];
+			xyz.Y += w * cri->cmf[1][i];
+			xyz.Z += w * cri->cmf[2][i];
+		}
+		xyz.X /= scale;
+		xyz.Y /= scale;
+		xyz.Z /= scale;
+		cd_color_xyz_to_uvw (&xyz, white, &uvw[j]);
+	}
+}
+
+static gboolean
+cd_it8_utils_cri_calculate_internal (const CdIt8UtilsCri *cri,
 				     CdSpectrum *illuminant,
+				     gdouble *light,
+				     gdouble *reference,
 				     gdouble *value,
-				     gdouble resolution,
 				     GError **error)
 {
-	CdColorUVW d1;
-	CdColorUVW d2;
-	CdColorUVW reference_uvw[8];
-	CdColorUVW unknown_uvw[8];
+	CdColorUVW reference_uvw[CD_IT8_UTILS_CRI_TCS_SIZE];
+	CdColorUVW unknown_uvw[CD_IT8_UTILS_CRI_TCS_SIZE];
 	CdColorXYZ illuminant_xyz;
-	CdColorXYZ reference_illuminant_xyz;
-	CdColorXYZ sample_xyz;
-	CdColorYxy yxy;
-	CdSpectrum *sample;
-	CdSpectrum *unity;
-	GPtrArray *samples;
-	gboolean ret;
 	gdouble cct;
+	gdouble duv;
 	gdouble ri_sum = 0.f;
 	gdouble val;
 	guint i;
 	g_autoptr(CdSpectrum) reference_illuminant = NULL;
 
 	/* get the illuminant CCT */
-	unity = cd_spectrum_new ();
-	ret = cd_it8_utils_calculate_xyz_from_cmf (cmf,
-						   unity,
-						   illuminant,
-						   &illuminant_xyz,
-						   resolution,
-						   error);
-	if (!ret)
+	cd_it8_utils_sample_grid (cri->wavelengths, cri->size,
+				  cri->resolution, illuminant, light);
+	illuminant_xyz.X = 0.f;
+	illuminant_xyz.Y = 0.f;
+	illuminant_xyz.Z = 0.f;
+	for (i = 0; i < cri->size; i++) {
+		illuminant_xyz.X += light[i] * cri->cmf[0][i];
+		illuminant_xyz.Y += light[i] * cri->cmf[1][i];
+		illuminant_xyz.Z += light[i] * cri->cmf[2][i];
+	}
+	illuminant_xyz.X /= cri->y_sum;
+	illuminant_xyz.Y /= cri->y_sum;
+	illuminant_xyz.Z /= cri->y_sum;
+	cct = cd_color_xyz_to_cct_duv (&illuminant_xyz, &duv);
+	if (cct < 0) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "failed to get the illuminant CCT");
 		return FALSE;
-	cct = cd_color_xyz_to_cct (&illuminant_xyz);
+	}
 	cd_color_xyz_normalize (&illuminant_xyz, 1.0, &illuminant_xyz);
 
 	/* get the reference illuminant */
@@ -363,21 +840,12 @@ cd_it8_utils_calculate_cri_from_cmf (CdIt8 *cmf,
 				     "need to use CIE standard illuminant D");
 		return FALSE;
 	}
-	cd_spectrum_normalize (reference_illuminant, 560, 1.0);
-	ret = cd_it8_utils_calculate_xyz_from_cmf (cmf,
-						   unity,
-						   reference_illuminant,
-						   &reference_illuminant_xyz,
-						   resolution,
-						   error);
-	if (!ret)
-		return FALSE;
+	cd_it8_utils_sample_grid (cri->wavelengths, cri->size,
+				  cri->resolution, reference_illuminant,
+				  reference);
 
 	/* check the source is white enough */
-	cd_color_uvw_set_planckian_locus (&d1, cct);
-	cd_color_xyz_to_yxy (&illuminant_xyz, &yxy);
-	cd_color_yxy_to_uvw (&yxy, &d2);
-	val = cd_color_uvw_get_chroma_difference (&d1, &d2);
+	val = fabs (duv);
 	if (val > 5.4e-3) {
 		g_set_error (error,
 			     CD_IT8_ERROR,
@@ -386,50 +854,119 @@ cd_it8_utils_calculate_cri_from_cmf (CdIt8 *cmf,
 		return FALSE;
 	}
 
-	/* get the XYZ for each color sample under the reference illuminant */
-	samples = cd_it8_get_spectrum_array (tcs);
-	for (i = 0; i < 8; i++) {
-		sample = g_ptr_array_index (samples, i);
-		ret = cd_it8_utils_calculate_xyz_from_cmf (cmf,
-							   reference_illuminant,
-							   sample,
-							   &sample_xyz,
-							   1.f,
-							   error);
-		if (!ret)
-			return FALSE;
-		cd_color_xyz_to_uvw (&sample_xyz,
-				     &illuminant_xyz,
-				     &reference_uvw[i]);
-	}
-
-	/* get the XYZ for each color sample under the unknown illuminant */
-	samples = cd_it8_get_spectrum_array (tcs);
-	for (i = 0; i < 8; i++) {
-		sample = g_ptr_array_index (samples, i);
-		ret = cd_it8_utils_calculate_xyz_from_cmf (cmf,
-							   illuminant,
-							   sample,
-							   &sample_xyz,
-							   resolution,
-							   error);
-		if (!ret)
-			return FALSE;
-		cd_color_xyz_to_uvw (&sample_xyz,
-				     &illuminant_xyz,
-				     &unknown_uvw[i]);
-	}
+	/* get the UVW for each color sample under both illuminants */
+	cd_it8_utils_cri_get_tcs_uvw (cri, reference, &illuminant_xyz, reference_uvw);
+	cd_it8_utils_cri_get_tcs_uvw (cri, light, &illuminant_xyz, unknown_uvw);
 
 	/* add up all the Ri's and take the average to get the CRI */
-	for (i = 0; i < 8; i++) {
+	for (i = 0; i < CD_IT8_UTILS_CRI_TCS_SIZE; i++) {
 		val = cd_color_uvw_get_chroma_difference (&reference_uvw[i],
 							  &unknown_uvw[i]);
 		ri_sum += 100 - (4.6 * val);
 	}
-	*value = ri_sum / 8;
+	*value = ri_sum / CD_IT8_UTILS_CRI_TCS_SIZE;
 	return TRUE;
 }
 
+/**
+ * cd_it8_utils_cri_calculate:
+ * @cri: a #CdIt8UtilsCri
+ * @illuminant: The illuminant
+ * @value: The CRI result
+ * @error: A #GError, or %NULL
+ *
+ * This calculates the CRI for a specific illuminant using the CMF and
+ * test color samples of the context.
+ *
+ * Return value: %TRUE if a CRI value was set.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_utils_cri_calculate (const CdIt8UtilsCri *cri,
+			    CdSpectrum *illuminant,
+			    gdouble *value,
+			    GError **error)
+{
+	return cd_it8_utils_cri_calculate_batch (cri, &illuminant, value, 1, error);
+}
+
+/**
+ * cd_it8_utils_cri_calculate_batch:
+ * @cri: a #CdIt8UtilsCri
+ * @illuminants: (array length=n_illuminants): The illuminants
+ * @values: (array length=n_illuminants): The CRI results
+ * @n_illuminants: the number of illuminants
+ * @error: A #GError, or %NULL
+ *
+ * This calculates the CRI for many illuminants, stopping at the first one
+ * that cannot be evaluated. The context is not modified and so can be
+ * shared between threads.
+ *
+ * Return value: %TRUE if all the CRI values were set.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_utils_cri_calculate_batch (const CdIt8UtilsCri *cri,
+				  CdSpectrum **illuminants,
+				  gdouble *values,
+				  guint n_illuminants,
+				  GError **error)
+{
+	guint i;
+	g_autofree gdouble *buf = NULL;
+
+	g_return_val_if_fail (cri != NULL, FALSE);
+	g_return_val_if_fail (illuminants != NULL || n_illuminants == 0, FALSE);
+	g_return_val_if_fail (values != NULL || n_illuminants == 0, FALSE);
+
+	/* the test and reference illuminants on the grid */
+	buf = g_new (gdouble, cri->size * 2);
+	for (i = 0; i < n_illuminants; i++) {
+		if (!cd_it8_utils_cri_calculate_internal (cri,
+							  illuminants[i],
+							  buf,
+							  buf + cri->size,
+							  &values[i],
+							  error)) {
+			if (n_illuminants > 1)
+				g_prefix_error (error, "illuminant %u: ", i);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * cd_it8_utils_calculate_cri_from_cmf:
+ * @cmf: The color match function
+ * @tcs: The CIE TCS test patches
+ * @illuminant: The illuminant
+ * @value: The CRI result
+ * @resolution: The resolution in nm, typically 1.0
+ * @error: A #GError, or %NULL
+ *
+ * This calculates the CRI for a specific illuminant.
+ *
+ * Return value: %TRUE if a XYZ value was set.
+ **/
+gboolean
+cd_it8_utils_calculate_cri_from_cmf (CdIt8 *cmf,
+				     CdIt8 *tcs,
+				     CdSpectrum *illuminant,
+				     gdouble *value,
+				     gdouble resolution,
+				     GError **error)
+{
+	g_autoptr(CdIt8UtilsCri) cri = NULL;
+
+	cri = cd_it8_utils_cri_new (cmf, tcs, resolution, error);
+	if (cri == NULL)
+		return FALSE;
+	return cd_it8_utils_cri_calculate (cri, illuminant, value, error);
+}
+
 /**
  * _cd_color_rgb_is_gray:
  * @rgb: The sample color
@@ -440,7 +977,7 @@ cd_it8_utils_calculate_cri_from_cmf (CdIt8 *cmf,
  * Return value: %TRUE if the color is gray.
  **/
 static gboolean
-_cd_color_rgb_is_gray (CdColorRGB *rgb, gdouble delta)
+_cd_color_rgb_is_gray (const CdColorRGB *rgb, gdouble delta)
 {
 	if (ABS (rgb->R - rgb->G) > delta)
 		return FALSE;
@@ -466,27 +1003,27 @@ _cd_color_rgb_is_gray (CdColorRGB *rgb, gdouble delta)
 gboolean
 cd_it8_utils_calculate_gamma (CdIt8 *it8, gdouble *gamma_y, GError **error)
 {
-	CdColorRGB rgb;
-	CdColorXYZ xyz;
 	cmsToneCurve *curve;
-	gdouble len;
+	const gdouble *data_rgb;
+	const gdouble *data_xyz;
 	gdouble max = 0.f;
 	guint cnt = 0;
 	guint i;
+	guint len;
 	gdouble gamma_tmp = 0.f;
 	g_autofree cmsFloat32Number *data_y = NULL;
 
 	/* find the grey gamma ramp */
-	len = cd_it8_get_data_size (it8);
+	data_rgb = cd_it8_get_data_rgb (it8, &len);
+	data_xyz = cd_it8_get_data_xyz (it8, NULL);
 	data_y = g_new0 (cmsFloat32Number, len);
 	for (i = 0; i < len; i++) {
-		cd_it8_get_data_item (it8, i, &rgb, &xyz);
 		/* ignore if not R == G == B */
-		if (!_cd_color_rgb_is_gray (&rgb, 0.01f)) {
+		if (!_cd_color_rgb_is_gray ((const CdColorRGB *) (data_rgb + i * 3), 0.01f)) {
 			cnt = 0;
 			continue;
 		}
-		data_y[cnt++]  = xyz.Y;
+		data_y[cnt++]  = data_xyz[i * 3 + 1];
 	}
 
 	/* we didn't get any measurements */
@@ -533,3 +1070,416 @@ cd_it8_utils_calculate_gamma (CdIt8 *it8, gdouble *gamma_y, GError **error)
 	cmsFreeToneCurve (curve);
 	return TRUE;
 }
+
+/* one fitted tone response curve */
+typedef struct {
+	gboolean		 valid;
+	gdouble			 gamma;
+	gdouble			 r2;
+	GArray			*residuals;	/* of gdouble */
+} CdIt8UtilsGammaFit;
+
+struct _CdIt8UtilsGamma {
+	CdIt8UtilsGammaFit	 fits[CD_IT8_UTILS_GAMMA_CHANNEL_LAST];
+};
+
+/* the patches with only this channel lit, including black */
+static gboolean
+cd_it8_utils_gamma_is_on_ramp (const gdouble *rgb, CdIt8UtilsGammaChannel channel)
+{
+	const gdouble delta = 0.01f;
+
+	switch (channel) {
+	case CD_IT8_UTILS_GAMMA_CHANNEL_RED:
+		return rgb[1] < delta && rgb[2] < delta;
+	case CD_IT8_UTILS_GAMMA_CHANNEL_GREEN:
+		return rgb[0] < delta && rgb[2] < delta;
+	case CD_IT8_UTILS_GAMMA_CHANNEL_BLUE:
+		return rgb[0] < delta && rgb[1] < delta;
+	case CD_IT8_UTILS_GAMMA_CHANNEL_GRAY:
+		return _cd_color_rgb_is_gray ((const CdColorRGB *) rgb, delta);
+	default:
+		return FALSE;
+	}
+}
+
+static void
+cd_it8_utils_gamma_fit (CdIt8UtilsGammaFit *fit,
+			const gdouble *data_rgb,
+			const gdouble *data_xyz,
+			guint len,
+			CdIt8UtilsGammaChannel channel)
+{
+	gdouble max = 0.f;
+	gdouble mean = 0.f;
+	gdouble ss_res = 0.f;
+	gdouble ss_tot = 0.f;
+	gdouble sxx = 0.f;
+	gdouble sxy = 0.f;
+	guint i;
+	guint idx = channel == CD_IT8_UTILS_GAMMA_CHANNEL_GRAY ? 0 : channel;
+	guint n = 0;
+	guint n_log = 0;
+	g_autofree gdouble *x = g_new (gdouble, len);
+	g_autofree gdouble *y = g_new (gdouble, len);
+
+	/* gather the ramp */
+	for (i = 0; i < len; i++) {
+		if (!cd_it8_utils_gamma_is_on_ramp (data_rgb + i * 3, channel))
+			continue;
+		x[n] = data_rgb[i * 3 + idx];
+		y[n] = data_xyz[i * 3 + 1];
+		if (y[n] > max)
+			max = y[n];
+		n++;
+	}
+	if (n < 3 || max <= 0.1f)
+		return;
+
+	/* y = x^gamma is linear in log space, so this is one least squares
+	 * fit through the origin that can be done in a single pass */
+	for (i = 0; i < n; i++) {
+		gdouble lx;
+		y[i] /= max;
+		if (x[i] <= 0.f || x[i] >= 1.f || y[i] <= 0.f)
+			continue;
+		lx = log (x[i]);
+		sxx += lx * lx;
+		sxy += lx * log (y[i]);
+		n_log++;
+	}
+	if (n_log < 2 || sxx <= 0.f)
+		return;
+	fit->gamma = sxy / sxx;
+
+	/* how well the curve follows the measurements */
+	for (i = 0; i < n; i++)
+		mean += y[i] / n;
+	fit->residuals = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), n);
+	for (i = 0; i < n; i++) {
+		gdouble r = y[i] - pow (x[i], fit->gamma);
+		ss_res += r * r;
+		ss_tot += (y[i] - mean) * (y[i] - mean);
+		g_array_append_val (fit->residuals, r);
+	}
+	fit->r2 = ss_tot > 0.f ? 1.f - ss_res / ss_tot : 1.f;
+	fit->valid = TRUE;
+}
+
+/**
+ * cd_it8_utils_gamma_new:
+ * @it8: The measured data
+ * @error: A #GError, or %NULL
+ *
+ * Fits a power law to the red, green, blue and gray ramps found in the
+ * measurements, using the luminance of each patch normalized to the
+ * brightest patch on the ramp.
+ *
+ * Return value: (transfer full): the fits, or %NULL if no ramp was found
+ *
+ * Since: 1.4.10
+ **/
+CdIt8UtilsGamma *
+cd_it8_utils_gamma_new (CdIt8 *it8, GError **error)
+{
+	const gdouble *data_rgb;
+	const gdouble *data_xyz;
+	gboolean found = FALSE;
+	guint i;
+	guint len = 0;
+	g_autoptr(CdIt8UtilsGamma) gamma = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8 (it8), NULL);
+
+	data_rgb = cd_it8_get_data_rgb (it8, &len);
+	data_xyz = cd_it8_get_data_xyz (it8, NULL);
+	gamma = g_new0 (CdIt8UtilsGamma, 1);
+	for (i = 0; i < CD_IT8_UTILS_GAMMA_CHANNEL_LAST && len > 0; i++) {
+		cd_it8_utils_gamma_fit (&gamma->fits[i], data_rgb, data_xyz, len, i);
+		if (gamma->fits[i].valid)
+			found = TRUE;
+	}
+	if (!found) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "Unable to detect gamma measurements");
+		return NULL;
+	}
+	return g_steal_pointer (&gamma);
+}
+
+typedef struct {
+	CdIt8			**it8s;
+	CdIt8UtilsGamma		**results;
+} CdIt8UtilsGammaBatch;
+
+static void
+cd_it8_utils_gamma_thread_cb (gpointer data, gpointer user_data)
+{
+	CdIt8UtilsGammaBatch *batch = (CdIt8UtilsGammaBatch *) user_data;
+	guint idx = GPOINTER_TO_UINT (data) - 1;
+	batch->results[idx] = cd_it8_utils_gamma_new (batch->it8s[idx], NULL);
+}
+
+/**
+ * cd_it8_utils_gamma_new_batch:
+ * @it8s: (array length=n_it8s): The measured data
+ * @results: (out caller-allocates) (array length=n_it8s): The fits
+ * @n_it8s: The number of measurement sets
+ *
+ * Fits the tone response curves of many measurement sets, which are
+ * shared between worker threads. Sets without any ramp get %NULL.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_utils_gamma_new_batch (CdIt8 **it8s,
+			      CdIt8UtilsGamma **results,
+			      guint n_it8s)
+{
+	CdIt8UtilsGammaBatch batch = { it8s, results };
+	GThreadPool *pool;
+	guint i;
+	guint n_threads;
+
+	g_return_if_fail (it8s != NULL || n_it8s == 0);
+	g_return_if_fail (results != NULL || n_it8s == 0);
+
+	n_threads = MIN (n_it8s, g_get_num_processors ());
+	if (n_threads <= 1) {
+		for (i = 0; i < n_it8s; i++)
+			results[i] = cd_it8_utils_gamma_new (it8s[i], NULL);
+		return;
+	}
+	pool = g_thread_pool_new (cd_it8_utils_gamma_thread_cb, &batch,
+				  (gint) n_threads, TRUE, NULL);
+	for (i = 0; i < n_it8s; i++)
+		g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+	g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/**
+ * cd_it8_utils_gamma_get_fit:
+ * @gamma: a #CdIt8UtilsGamma
+ * @channel: a #CdIt8UtilsGammaChannel, e.g. %CD_IT8_UTILS_GAMMA_CHANNEL_RED
+ * @value: (out) (optional): the fitted exponent
+ * @r2: (out) (optional): the coefficient of determination of the fit
+ *
+ * Gets the fit for one channel.
+ *
+ * Return value: %TRUE if the channel had enough measurements
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_utils_gamma_get_fit (const CdIt8UtilsGamma *gamma,
+			    CdIt8UtilsGammaChannel channel,
+			    gdouble *value,
+			    gdouble *r2)
+{
+	g_return_val_if_fail (gamma != NULL, FALSE);
+	g_return_val_if_fail (channel < CD_IT8_UTILS_GAMMA_CHANNEL_LAST, FALSE);
+
+	if (!gamma->fits[channel].valid)
+		return FALSE;
+	if (value != NULL)
+		*value = gamma->fits[channel].gamma;
+	if (r2 != NULL)
+		*r2 = gamma->fits[channel].r2;
+	return TRUE;
+}
+
+/**
+ * cd_it8_utils_gamma_get_residuals:
+ * @gamma: a #CdIt8UtilsGamma
+ * @channel: a #CdIt8UtilsGammaChannel, e.g. %CD_IT8_UTILS_GAMMA_CHANNEL_RED
+ * @len: (out) (optional): the number of residuals
+ *
+ * Gets the normalized luminance minus the fitted curve for each patch on
+ * the ramp, in the order of the measurements.
+ *
+ * Return value: (array length=len): the residuals, or %NULL
+ *
+ * Since: 1.4.10
+ **/
+const gdouble *
+cd_it8_utils_gamma_get_residuals (const CdIt8UtilsGamma *gamma,
+				  CdIt8UtilsGammaChannel channel,
+				  guint *len)
+{
+	g_return_val_if_fail (gamma != NULL, NULL);
+	g_return_val_if_fail (channel < CD_IT8_UTILS_GAMMA_CHANNEL_LAST, NULL);
+
+	if (!gamma->fits[channel].valid) {
+		if (len != NULL)
+			*len = 0;
+		return NULL;
+	}
+	if (len != NULL)
+		*len = gamma->fits[channel].residuals->len;
+	return (const gdouble *) gamma->fits[channel].residuals->data;
+}
+
+/**
+ * cd_it8_utils_gamma_free:
+ * @gamma: a #CdIt8UtilsGamma
+ *
+ * Frees the fits.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_it8_utils_gamma_free (CdIt8UtilsGamma *gamma)
+{
+	guint i;
+	for (i = 0; i < CD_IT8_UTILS_GAMMA_CHANNEL_LAST; i++) {
+		if (gamma->fits[i].residuals != NULL)
+			g_array_unref (gamma->fits[i].residuals);
+	}
+	g_free (gamma);
+}
+
+/**
+ * cd_it8_utils_verify_profile:
+ * @it8_measured: The measured data, of kind %CD_IT8_KIND_TI3
+ * @icc: The RGB profile to verify
+ * @delta_e: (out caller-allocates) (array): The ΔE2000 for each patch
+ * @error: A #GError, or %NULL
+ *
+ * This compares each measured patch with the color the profile predicts
+ * for its device values. All the patches are converted with one transform,
+ * which is split between the worker threads for large charts.
+ *
+ * The prediction uses the relative colorimetric intent, and the measured
+ * values are made relative to the brightest patch, so charts measured
+ * in absolute units can be used directly.
+ *
+ * @delta_e must have space for cd_it8_get_data_size() values, which are
+ * in the same order as the patches.
+ *
+ * Return value: %TRUE if the chart could be compared.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_it8_utils_verify_profile (CdIt8 *it8_measured,
+			     CdIcc *icc,
+			     gdouble *delta_e,
+			     GError **error)
+{
+	const CdColorXYZ *white = NULL;
+	const CdColorXYZ *xyz;
+	const gdouble *data_rgb;
+	guint i;
+	guint len = 0;
+	g_autofree CdColorLab *lab_measured = NULL;
+	g_autofree CdColorLab *lab_profile = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8 (it8_measured), FALSE);
+	g_return_val_if_fail (CD_IS_ICC (icc), FALSE);
+	g_return_val_if_fail (delta_e != NULL, FALSE);
+
+	/* check it's the right kind */
+	if (cd_it8_get_kind (it8_measured) != CD_IT8_KIND_TI3) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "measured data has to be of type TI3");
+		return FALSE;
+	}
+	if (cd_icc_get_colorspace (icc) != CD_COLORSPACE_RGB) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_FAILED,
+			     "profile has to be RGB, not %s",
+			     cd_colorspace_to_string (cd_icc_get_colorspace (icc)));
+		return FALSE;
+	}
+	data_rgb = cd_it8_get_data_rgb (it8_measured, &len);
+	xyz = (const CdColorXYZ *) cd_it8_get_data_xyz (it8_measured, NULL);
+	if (len == 0) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "measured data has no patches");
+		return FALSE;
+	}
+
+	/* the brightest patch is the reference white */
+	for (i = 0; i < len; i++) {
+		if (white == NULL || xyz[i].Y > white->Y)
+			white = &xyz[i];
+	}
+	if (white->Y <= 0.f) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_FAILED,
+				     "measured data has no white patch");
+		return FALSE;
+	}
+	lab_measured = g_new (CdColorLab, len);
+	cd_color_xyz_to_lab_array (xyz, white, lab_measured, len);
+
+	/* predict every patch in one go */
+	transform = cd_transform_new ();
+	cd_transform_set_input_icc (transform, icc);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB_DOUBLE);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_LAB_DOUBLE);
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	lab_profile = g_new (CdColorLab, len);
+	if (!cd_transform_process_array (transform, data_rgb, lab_profile,
+					 len, NULL, error))
+		return FALSE;
+	cd_color_lab_delta_e2000_array (lab_measured, lab_profile, delta_e, len);
+	return TRUE;
+}
+
+static gint
+cd_it8_utils_sort_double_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble value_a = *((const gdouble *) a);
+	gdouble value_b = *((const gdouble *) b);
+	if (value_a < value_b)
+		return -1;
+	if (value_a > value_b)
+		return 1;
+	return 0;
+}
+
+/**
+ * cd_it8_utils_get_percentile:
+ * @values: (array length=len): The values, in any order
+ * @len: The number of values
+ * @percentile: The percentile, from 0 to 100
+ *
+ * This finds the value below which @percentile percent of @values fall,
+ * interpolating between the two closest values. For instance a
+ * @percentile of 50 is the median and 100 is the maximum.
+ *
+ * Return value: the value, or 0 if @len is 0
+ *
+ * Since: 1.4.10
+ **/
+gdouble
+cd_it8_utils_get_percentile (const gdouble *values, guint len, gdouble percentile)
+{
+	gdouble pos;
+	guint idx;
+	g_autofree gdouble *sorted = NULL;
+
+	g_return_val_if_fail (values != NULL || len == 0, 0.f);
+	g_return_val_if_fail (percentile >= 0.f && percentile <= 100.f, 0.f);
+
+	if (len == 0)
+		return 0.f;
+	sorted = g_new (gdouble, len);
+	memcpy (sorted, values, sizeof (gdouble) * len);
+	qsort (sorted, len, sizeof (gdouble), cd_it8_utils_sort_double_cb);
+	pos = percentile / 100.f * (len - 1);
+	idx = (guint) pos;
+	if (idx + 1 >= len)
+		return sorted[len - 1];
+	return sorted[idx] + (pos - idx) * (sorted[idx + 1] - sorted[idx]);
+}
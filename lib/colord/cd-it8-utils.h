@@ -28,16 +28,42 @@
 
 #include <glib-object.h>
 
+#include "cd-icc.h"
 #include "cd-it8.h"
 #include "cd-spectrum.h"
 
 G_BEGIN_DECLS
 
+typedef struct _CdIt8UtilsPlan	CdIt8UtilsPlan;
+typedef struct _CdIt8UtilsCri	CdIt8UtilsCri;
+typedef struct _CdIt8UtilsGamma	CdIt8UtilsGamma;
+
+/**
+ * CdIt8UtilsGammaChannel:
+ *
+ * The ramps a tone response curve can be fitted to.
+ **/
+typedef enum {
+	CD_IT8_UTILS_GAMMA_CHANNEL_RED,				/* Since: 1.4.10 */
+	CD_IT8_UTILS_GAMMA_CHANNEL_GREEN,			/* Since: 1.4.10 */
+	CD_IT8_UTILS_GAMMA_CHANNEL_BLUE,			/* Since: 1.4.10 */
+	CD_IT8_UTILS_GAMMA_CHANNEL_GRAY,			/* Since: 1.4.10 */
+	/*< private >*/
+	CD_IT8_UTILS_GAMMA_CHANNEL_LAST
+} CdIt8UtilsGammaChannel;
+
 gboolean	 cd_it8_utils_calculate_ccmx		(CdIt8		*it8_reference,
 							 CdIt8		*it8_measured,
 							 CdIt8		*it8_ccmx,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_it8_utils_calculate_ccmx_lsq	(CdIt8		*it8_reference,
+							 CdIt8		*it8_measured,
+							 const gdouble	*weights,
+							 CdIt8		*it8_ccmx,
+							 gdouble	*loo_error,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_it8_utils_calculate_xyz_from_cmf	(CdIt8		*cmf,
 							 CdSpectrum	*illuminant,
 							 CdSpectrum	*spectrum,
@@ -45,6 +71,18 @@ gboolean	 cd_it8_utils_calculate_xyz_from_cmf	(CdIt8		*cmf,
 							 gdouble	 resolution,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+CdIt8UtilsPlan	*cd_it8_utils_plan_new			(CdIt8		*cmf,
+							 CdSpectrum	*illuminant,
+							 gdouble	 resolution,
+							 GError		**error);
+void		 cd_it8_utils_plan_free			(CdIt8UtilsPlan	*plan);
+void		 cd_it8_utils_plan_calculate_xyz	(const CdIt8UtilsPlan *plan,
+							 CdSpectrum	*spectrum,
+							 CdColorXYZ	*value);
+void		 cd_it8_utils_plan_calculate_xyz_batch	(const CdIt8UtilsPlan *plan,
+							 CdSpectrum	**spectra,
+							 CdColorXYZ	*values,
+							 guint		 n_spectra);
 gboolean	 cd_it8_utils_calculate_cri_from_cmf	(CdIt8		*cmf,
 							 CdIt8		*tcs,
 							 CdSpectrum	*illuminant,
@@ -52,9 +90,50 @@ gboolean	 cd_it8_utils_calculate_cri_from_cmf	(CdIt8		*cmf,
 							 gdouble	 resolution,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+CdIt8UtilsCri	*cd_it8_utils_cri_new			(CdIt8		*cmf,
+							 CdIt8		*tcs,
+							 gdouble	 resolution,
+							 GError		**error);
+void		 cd_it8_utils_cri_free			(CdIt8UtilsCri	*cri);
+gboolean	 cd_it8_utils_cri_calculate		(const CdIt8UtilsCri *cri,
+							 CdSpectrum	*illuminant,
+							 gdouble	*value,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_it8_utils_cri_calculate_batch	(const CdIt8UtilsCri *cri,
+							 CdSpectrum	**illuminants,
+							 gdouble	*values,
+							 guint		 n_illuminants,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_it8_utils_calculate_gamma		(CdIt8		*it8,
 							 gdouble	*gamma_y,
 							 GError		**error);
+CdIt8UtilsGamma	*cd_it8_utils_gamma_new			(CdIt8		*it8,
+							 GError		**error);
+void		 cd_it8_utils_gamma_new_batch		(CdIt8		**it8s,
+							 CdIt8UtilsGamma **results,
+							 guint		 n_it8s);
+gboolean	 cd_it8_utils_gamma_get_fit		(const CdIt8UtilsGamma *gamma,
+							 CdIt8UtilsGammaChannel channel,
+							 gdouble	*value,
+							 gdouble	*r2);
+const gdouble	*cd_it8_utils_gamma_get_residuals	(const CdIt8UtilsGamma *gamma,
+							 CdIt8UtilsGammaChannel channel,
+							 guint		*len);
+void		 cd_it8_utils_gamma_free		(CdIt8UtilsGamma *gamma);
+gboolean	 cd_it8_utils_verify_profile		(CdIt8		*it8_measured,
+							 CdIcc		*icc,
+							 gdouble	*delta_e,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gdouble		 cd_it8_utils_get_percentile		(const gdouble	*values,
+							 guint		 len,
+							 gdouble	 percentile);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdIt8UtilsPlan, cd_it8_utils_plan_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdIt8UtilsCri, cd_it8_utils_cri_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdIt8UtilsGamma, cd_it8_utils_gamma_free)
 
 G_END_DECLS
 
@@ -31,10 +31,12 @@
 
 #include <glib.h>
 #include <lcms2.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cd-it8.h"
+#include "cd-it8-reader.h"
 #include "cd-color.h"
 #include "cd-context-lcms.h"
 
@@ -62,11 +64,19 @@ typedef struct
 	gchar			*originator;
 	gchar			*title;
 	GPtrArray		*array_spectra;
-	GPtrArray		*array_rgb;
-	GPtrArray		*array_xyz;
+	GArray			*array_rgb;	/* of CdColorRGB */
+	GArray			*array_xyz;	/* of CdColorXYZ */
 	GPtrArray		*options;
+	guint			 index_size;	/* cells per axis, 0 if not built */
+	gdouble			 index_min[3];
+	gdouble			 index_scale[3];
+	guint			*index_offsets;	/* index_size^3 + 1 */
+	guint			*index_patches;	/* sorted by cell */
 } CdIt8Private;
 
+/* the index has at most this many cells along each axis */
+#define CD_IT8_INDEX_SIZE_MAX		32
+
 enum {
 	PROP_0,
 	PROP_KIND,
@@ -99,28 +109,28 @@ cd_it8_error_quark (void)
 }
 
 /**
- * _cmsIT8GetPropertyDbl:
+ * _cd_it8_reader_get_property_dbl:
  *
  * This gets a property ensuring the decimal point is '.' rather than what is
  * specified in LC_NUMERIC
  **/
 static gdouble
-_cmsIT8GetPropertyDbl (cmsHANDLE it8_lcms, const gchar *key)
+_cd_it8_reader_get_property_dbl (CdIt8Reader *reader, const gchar *key)
 {
 	const gchar *value;
-	value = cmsIT8GetProperty (it8_lcms, key);
+	value = cd_it8_reader_get_property (reader, key);
 	if (value == NULL)
 		return -1;
 	return g_ascii_strtod (value, NULL);
 }
 
 static guint
-_cmsIT8GetPropertyInt (cmsHANDLE it8_lcms, const gchar *key)
+_cd_it8_reader_get_property_int (CdIt8Reader *reader, const gchar *key)
 {
 	const gchar *value;
 	guint64 tmp;
 
-	value = cmsIT8GetProperty (it8_lcms, key);
+	value = cd_it8_reader_get_property (reader, key);
 	if (value == NULL)
 		return 0;
 	tmp = g_ascii_strtoull (value, NULL, 10);
@@ -130,81 +140,286 @@ _cmsIT8GetPropertyInt (cmsHANDLE it8_lcms, const gchar *key)
 	return tmp;
 }
 
-/**
- * _cmsIT8GetDataRowColDbl:
- *
- * This gets a data value ensuring the decimal point is '.' rather than what is
- * specified in LC_NUMERIC
- **/
-static gdouble
-_cmsIT8GetDataRowColDbl (cmsHANDLE it8_lcms, gint row, gint col)
+/* reads the next set, where running out of sets is an error */
+static gboolean
+_cd_it8_reader_read_set (CdIt8Reader *reader, gdouble *values, GError **error)
 {
-	const char *value;
-	value = cmsIT8GetDataRowCol (it8_lcms, row, col);
-	if (value == NULL)
-		return -1;
-	return g_ascii_strtod (value, NULL);
+	g_autoptr(GError) error_local = NULL;
+
+	if (cd_it8_reader_next_set (reader, values, &error_local))
+		return TRUE;
+	if (error_local != NULL) {
+		g_propagate_error (error, g_steal_pointer (&error_local));
+		return FALSE;
+	}
+	g_set_error_literal (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_INVALID_FORMAT,
+			     "Invalid format, not enough sets");
+	return FALSE;
 }
 
-/**
- * _cmsIT8WriteFloat:
+/* values at or above this are formatted with printf() */
+#define CD_IT8_WRITER_FAST_MAX		1000000.0
+
+/* the amount of data written to the stream in one go */
+#define CD_IT8_WRITER_BUFFER_SIZE	32768
+
+/*
+ * cd_it8_writer_append_dbl:
  *
  * We can't use g_ascii_dtostr() as this produces very inefficient
- * strings for storage. Instead write the string with 13 decimal places
+ * strings for storage. Instead write the string with 12 decimal places
  * and then manually remove trailing zeros more than one as ArgyllCMS
  * doesn't support integers as floats (!)
- **/
+ *
+ * Typical sample values are formatted using integer arithmetic, which also
+ * means the decimal point is always '.' whatever is specified in LC_NUMERIC.
+ */
 static void
-_cmsIT8WriteFloat (gchar *buffer, gsize buffer_size, gdouble value)
+cd_it8_writer_append_dbl (GString *str, gdouble value)
 {
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+	gdouble whole;
+	guint64 fract;
+	guint32 ival;
+	guint len = 0;
 	guint i;
-	memset (buffer, '\0', buffer_size);
-	g_ascii_formatd (buffer, buffer_size, "%.12f", value);
-	for (i = G_ASCII_DTOSTR_BUF_SIZE - 1; i > 2; i--) {
-		if (buffer[i] == '\0')
-			continue;
-		if (buffer[i] != '0')
-			break;
-		if (buffer[i-1] == '.')
-			break;
-		buffer[i] = '\0';
+
+	/* slow path */
+	if (!isfinite (value) || fabs (value) >= CD_IT8_WRITER_FAST_MAX) {
+		memset (buffer, '\0', sizeof (buffer));
+		g_ascii_formatd (buffer, sizeof (buffer), "%.12f", value);
+		for (i = sizeof (buffer) - 1; i > 2; i--) {
+			if (buffer[i] == '\0')
+				continue;
+			if (buffer[i] != '0')
+				break;
+			if (buffer[i-1] == '.')
+				break;
+			buffer[i] = '\0';
+		}
+		g_string_append (str, buffer);
+		return;
+	}
+
+	/* split into the integer part and 12 rounded decimal places */
+	if (signbit (value)) {
+		g_string_append_c (str, '-');
+		value = -value;
+	}
+	whole = floor (value);
+	ival = (guint32) whole;
+	fract = (guint64) ((value - whole) * 1e12 + 0.5);
+	if (fract >= G_GUINT64_CONSTANT (1000000000000)) {
+		fract -= G_GUINT64_CONSTANT (1000000000000);
+		ival++;
+	}
+
+	/* integer part, written backwards */
+	do {
+		buffer[len++] = (gchar) ('0' + ival % 10);
+		ival /= 10;
+	} while (ival > 0);
+	while (len > 0)
+		g_string_append_c (str, buffer[--len]);
+	g_string_append_c (str, '.');
+
+	/* decimal places, keeping at least one */
+	for (i = 12; i > 0; i--) {
+		buffer[i - 1] = (gchar) ('0' + fract % 10);
+		fract /= 10;
 	}
+	len = 12;
+	while (len > 1 && buffer[len - 1] == '0')
+		len--;
+	g_string_append_len (str, buffer, len);
+}
+
+/* streams a CGATS file in the same layout as cmsIT8SaveToMem() */
+typedef struct {
+	GOutputStream	*stream;
+	GCancellable	*cancellable;
+	GPtrArray	*options;	/* not owned */
+	gchar		*sheet_type;
+	GPtrArray	*header;	/* of "KEY\tvalue" */
+	GPtrArray	*formats;
+	GString		*buf;
+	gboolean	 header_done;
+	gboolean	 in_data;
+	guint		 col;
+} CdIt8Writer;
+
+static CdIt8Writer *
+cd_it8_writer_new (GOutputStream *stream,
+		   GPtrArray *options,
+		   GCancellable *cancellable)
+{
+	CdIt8Writer *writer = g_new0 (CdIt8Writer, 1);
+	writer->stream = g_object_ref (stream);
+	if (cancellable != NULL)
+		writer->cancellable = g_object_ref (cancellable);
+	writer->options = options;
+	writer->sheet_type = g_strdup ("CGATS.17");
+	writer->header = g_ptr_array_new_with_free_func (g_free);
+	writer->formats = g_ptr_array_new_with_free_func (g_free);
+	writer->buf = g_string_sized_new (CD_IT8_WRITER_BUFFER_SIZE);
+	return writer;
 }
 
-/**
- * _cmsIT8SetPropertyDbl:
- *
- * This sets a property ensuring the decimal point is '.' rather than what is
- * specified in LC_NUMERIC
- **/
 static void
-_cmsIT8SetPropertyDbl (cmsHANDLE it8_lcms, const gchar *key, gdouble value)
+cd_it8_writer_free (CdIt8Writer *writer)
 {
-	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
-	_cmsIT8WriteFloat (buffer, G_ASCII_DTOSTR_BUF_SIZE, value);
-	cmsIT8SetPropertyUncooked (it8_lcms, key, buffer);
+	g_object_unref (writer->stream);
+	if (writer->cancellable != NULL)
+		g_object_unref (writer->cancellable);
+	g_free (writer->sheet_type);
+	g_ptr_array_unref (writer->header);
+	g_ptr_array_unref (writer->formats);
+	g_string_free (writer->buf, TRUE);
+	g_free (writer);
 }
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CdIt8Writer, cd_it8_writer_free)
+
 static void
-_cmsIT8SetPropertyInt (cmsHANDLE it8_lcms, const gchar *key, gint value)
+cd_it8_writer_set_sheet_type (CdIt8Writer *writer, const gchar *sheet_type)
 {
-	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
-	g_ascii_formatd (buffer, G_ASCII_DTOSTR_BUF_SIZE, "%.0f", value);
-	cmsIT8SetPropertyUncooked (it8_lcms, key, buffer);
+	g_free (writer->sheet_type);
+	writer->sheet_type = g_strdup (sheet_type);
 }
 
-/**
- * _cmsIT8SetDataRowColDbl:
+static void
+cd_it8_writer_set_property_str (CdIt8Writer *writer,
+				const gchar *key,
+				const gchar *value)
+{
+	g_ptr_array_add (writer->header,
+			 g_strdup_printf ("%s\t\"%s\"", key, value));
+}
+
+static void
+cd_it8_writer_set_property_dbl (CdIt8Writer *writer,
+				const gchar *key,
+				gdouble value)
+{
+	GString *str = g_string_new (key);
+	g_string_append_c (str, '\t');
+	cd_it8_writer_append_dbl (str, value);
+	g_ptr_array_add (writer->header, g_string_free (str, FALSE));
+}
+
+static void
+cd_it8_writer_set_property_int (CdIt8Writer *writer,
+				const gchar *key,
+				guint value)
+{
+	g_ptr_array_add (writer->header,
+			 g_strdup_printf ("%s\t%u", key, value));
+}
+
+static void
+cd_it8_writer_set_data_format (CdIt8Writer *writer, const gchar *label)
+{
+	g_ptr_array_add (writer->formats, g_strdup (label));
+}
+
+static gboolean
+cd_it8_writer_flush (CdIt8Writer *writer, GError **error)
+{
+	if (writer->buf->len == 0)
+		return TRUE;
+	if (!g_output_stream_write_all (writer->stream,
+					writer->buf->str,
+					writer->buf->len,
+					NULL,
+					writer->cancellable,
+					error))
+		return FALSE;
+	g_string_truncate (writer->buf, 0);
+	return TRUE;
+}
+
+static void
+cd_it8_writer_write_header (CdIt8Writer *writer)
+{
+	guint i;
+
+	if (writer->header_done)
+		return;
+	writer->header_done = TRUE;
+
+	g_string_append_printf (writer->buf, "%s\n", writer->sheet_type);
+	for (i = 0; i < writer->header->len; i++) {
+		g_string_append (writer->buf, g_ptr_array_index (writer->header, i));
+		g_string_append_c (writer->buf, '\n');
+	}
+	for (i = 0; writer->options != NULL && i < writer->options->len; i++) {
+		g_string_append_printf (writer->buf, "%s\t\"YES\"\n",
+					(const gchar *) g_ptr_array_index (writer->options, i));
+	}
+	if (writer->formats->len == 0)
+		return;
+	g_string_append (writer->buf, "BEGIN_DATA_FORMAT\n ");
+	for (i = 0; i < writer->formats->len; i++) {
+		if (i > 0)
+			g_string_append_c (writer->buf, '\t');
+		g_string_append (writer->buf, g_ptr_array_index (writer->formats, i));
+	}
+	g_string_append (writer->buf, "\nEND_DATA_FORMAT\n");
+}
+
+/*
+ * cd_it8_writer_begin_data:
  *
- * This sets a data value ensuring the decimal point is '.' rather than what is
- * specified in LC_NUMERIC
- **/
+ * Writes the header, any options and the data format. No more properties
+ * can be set after this is called.
+ */
 static void
-_cmsIT8SetDataRowColDbl (cmsHANDLE it8_lcms, gint row, gint col, gdouble value)
+cd_it8_writer_begin_data (CdIt8Writer *writer)
 {
-	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
-	_cmsIT8WriteFloat (buffer, G_ASCII_DTOSTR_BUF_SIZE, value);
-	cmsIT8SetDataRowCol (it8_lcms, row, col, buffer);
+	cd_it8_writer_write_header (writer);
+	g_string_append (writer->buf, "BEGIN_DATA\n");
+	writer->in_data = TRUE;
+}
+
+static void
+cd_it8_writer_add_dbl (CdIt8Writer *writer, gdouble value)
+{
+	g_string_append_c (writer->buf, writer->col++ == 0 ? ' ' : '\t');
+	cd_it8_writer_append_dbl (writer->buf, value);
+}
+
+static void
+cd_it8_writer_add_str (CdIt8Writer *writer, const gchar *value)
+{
+	g_string_append_c (writer->buf, writer->col++ == 0 ? ' ' : '\t');
+	if (value == NULL) {
+		g_string_append (writer->buf, "\"\"");
+	} else if (strchr (value, ' ') != NULL) {
+		g_string_append_printf (writer->buf, "\"%s\"", value);
+	} else {
+		g_string_append (writer->buf, value);
+	}
+}
+
+static gboolean
+cd_it8_writer_end_row (CdIt8Writer *writer, GError **error)
+{
+	g_string_append_c (writer->buf, '\n');
+	writer->col = 0;
+	if (writer->buf->len < CD_IT8_WRITER_BUFFER_SIZE)
+		return TRUE;
+	return cd_it8_writer_flush (writer, error);
+}
+
+static gboolean
+cd_it8_writer_finish (CdIt8Writer *writer, GError **error)
+{
+	cd_it8_writer_write_header (writer);
+	if (writer->in_data)
+		g_string_append (writer->buf, "END_DATA\n");
+	return cd_it8_writer_flush (writer, error);
 }
 
 /**
@@ -425,8 +640,97 @@ cd_it8_get_spectral (CdIt8 *it8)
 	return priv->spectral;
 }
 
+static void
+cd_it8_index_invalidate (CdIt8 *it8)
+{
+	CdIt8Private *priv = GET_PRIVATE (it8);
+	priv->index_size = 0;
+	g_clear_pointer (&priv->index_offsets, g_free);
+	g_clear_pointer (&priv->index_patches, g_free);
+}
+
+static guint
+cd_it8_index_get_cell (CdIt8Private *priv, guint axis, gdouble value)
+{
+	gdouble tmp = (value - priv->index_min[axis]) * priv->index_scale[axis];
+	if (tmp <= 0.f)
+		return 0;
+	if (tmp >= priv->index_size - 1)
+		return priv->index_size - 1;
+	return (guint) tmp;
+}
+
+static guint
+cd_it8_index_get_cell_for_rgb (CdIt8Private *priv, const CdColorRGB *rgb)
+{
+	guint r = cd_it8_index_get_cell (priv, 0, rgb->R);
+	guint g = cd_it8_index_get_cell (priv, 1, rgb->G);
+	guint b = cd_it8_index_get_cell (priv, 2, rgb->B);
+	return (r * priv->index_size + g) * priv->index_size + b;
+}
+
+/* buckets the readings into a uniform grid over the RGB bounding box */
+static void
+cd_it8_index_build (CdIt8 *it8)
+{
+	CdIt8Private *priv = GET_PRIVATE (it8);
+	const CdColorRGB *rgb;
+	gdouble max[3];
+	guint cells;
+	guint i;
+	guint j;
+	guint size = 1;
+	g_autofree guint *cell_for_patch = NULL;
+
+	/* aim for about one reading per cell */
+	while (size * size * size < priv->array_rgb->len &&
+	       size < CD_IT8_INDEX_SIZE_MAX)
+		size++;
+
+	/* get the bounding box */
+	rgb = &g_array_index (priv->array_rgb, CdColorRGB, 0);
+	priv->index_min[0] = max[0] = rgb->R;
+	priv->index_min[1] = max[1] = rgb->G;
+	priv->index_min[2] = max[2] = rgb->B;
+	for (i = 1; i < priv->array_rgb->len; i++) {
+		const gdouble *tmp;
+		tmp = &g_array_index (priv->array_rgb, CdColorRGB, i).R;
+		for (j = 0; j < 3; j++) {
+			priv->index_min[j] = MIN (priv->index_min[j], tmp[j]);
+			max[j] = MAX (max[j], tmp[j]);
+		}
+	}
+	priv->index_size = size;
+	for (j = 0; j < 3; j++) {
+		gdouble range = max[j] - priv->index_min[j];
+		priv->index_scale[j] = range > 0.f ? size / range : 0.f;
+	}
+
+	/* counting sort, which keeps the readings in order in each cell */
+	cells = size * size * size;
+	priv->index_offsets = g_new0 (guint, cells + 1);
+	priv->index_patches = g_new (guint, priv->array_rgb->len);
+	cell_for_patch = g_new (guint, priv->array_rgb->len);
+	for (i = 0; i < priv->array_rgb->len; i++) {
+		rgb = &g_array_index (priv->array_rgb, CdColorRGB, i);
+		cell_for_patch[i] = cd_it8_index_get_cell_for_rgb (priv, rgb);
+		priv->index_offsets[cell_for_patch[i] + 1]++;
+	}
+	for (i = 0; i < cells; i++)
+		priv->index_offsets[i + 1] += priv->index_offsets[i];
+	for (i = 0; i < priv->array_rgb->len; i++) {
+		guint cell = cell_for_patch[i];
+		priv->index_patches[priv->index_offsets[cell]++] = i;
+	}
+
+	/* the offsets now point to the end of each cell, so shift them back */
+	for (i = cells; i > 0; i--)
+		priv->index_offsets[i] = priv->index_offsets[i - 1];
+	priv->index_offsets[0] = 0;
+}
+
 static gboolean
-cd_it8_load_ti1_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_load_ti1_cal (CdIt8 *it8, CdIt8Reader *reader, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdColorRGB *rgb;
@@ -434,8 +738,9 @@ cd_it8_load_ti1_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	const gchar *tmp;
 	guint i;
 	guint number_of_sets = 0;
+	g_autofree gdouble *values = NULL;
 
-	tmp = cmsIT8GetProperty (it8_lcms, "COLOR_REP");
+	tmp = cd_it8_reader_get_property (reader, "COLOR_REP");
 	if (g_strcmp0 (tmp, "RGB") != 0) {
 		g_set_error (error,
 			     CD_IT8_ERROR,
@@ -443,9 +748,16 @@ cd_it8_load_ti1_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			     "Invalid data format: %s", tmp);
 		return FALSE;
 	}
+	if (cd_it8_reader_get_number_of_fields (reader) < 4) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "Invalid format, RGB fields required");
+		return FALSE;
+	}
 
 	/* copy out data entries */
-	number_of_sets = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_SETS");
+	number_of_sets = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_SETS");
 	if (number_of_sets == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -454,11 +766,16 @@ cd_it8_load_ti1_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 		return FALSE;
 	}
 
+	values = g_new0 (gdouble, cd_it8_reader_get_number_of_fields (reader));
+	g_array_set_size (priv->array_rgb, number_of_sets);
+	g_array_set_size (priv->array_xyz, number_of_sets);
 	for (i = 0; i < number_of_sets; i++) {
-		rgb = cd_color_rgb_new ();
-		rgb->R = _cmsIT8GetDataRowColDbl (it8_lcms, i, 1);
-		rgb->G = _cmsIT8GetDataRowColDbl (it8_lcms, i, 2);
-		rgb->B = _cmsIT8GetDataRowColDbl (it8_lcms, i, 3);
+		if (!_cd_it8_reader_read_set (reader, values, error))
+			return FALSE;
+		rgb = &g_array_index (priv->array_rgb, CdColorRGB, i);
+		rgb->R = values[1];
+		rgb->G = values[2];
+		rgb->B = values[3];
 
 		/* ti1 files don't have NORMALIZED_TO_Y_100 so guess on
 		 * the asumption the first patch isn't black */
@@ -469,16 +786,14 @@ cd_it8_load_ti1_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			rgb->G /= 100.0f;
 			rgb->B /= 100.0f;
 		}
-		g_ptr_array_add (priv->array_rgb, rgb);
-		xyz = cd_color_xyz_new ();
+		xyz = &g_array_index (priv->array_xyz, CdColorXYZ, i);
 		cd_color_xyz_set (xyz, 0.0, 0.0, 0.0);
-		g_ptr_array_add (priv->array_xyz, xyz);
 	}
 	return TRUE;
 }
 
 static gboolean
-cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_load_ti3 (CdIt8 *it8, CdIt8Reader *reader, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdColorRGB *rgb;
@@ -488,8 +803,9 @@ cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	gboolean scaled_to_y100 = FALSE;
 	guint i;
 	guint number_of_sets = 0;
+	g_autofree gdouble *values = NULL;
 
-	tmp = cmsIT8GetProperty (it8_lcms, "COLOR_REP");
+	tmp = cd_it8_reader_get_property (reader, "COLOR_REP");
 	if (g_strcmp0 (tmp, "RGB_XYZ") != 0) {
 		g_set_error (error,
 			     CD_IT8_ERROR,
@@ -497,12 +813,19 @@ cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			     "Invalid data format: %s", tmp);
 		return FALSE;
 	}
+	if (cd_it8_reader_get_number_of_fields (reader) < 7) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "Invalid format, RGB and XYZ fields required");
+		return FALSE;
+	}
 
 	/* if normalized, then scale back up */
-	tmp = cmsIT8GetProperty (it8_lcms, "NORMALIZED_TO_Y_100");
+	tmp = cd_it8_reader_get_property (reader, "NORMALIZED_TO_Y_100");
 	if (g_strcmp0 (tmp, "YES") == 0) {
 		scaled_to_y100 = TRUE;
-		tmp = cmsIT8GetProperty (it8_lcms, "LUMINANCE_XYZ_CDM2");
+		tmp = cd_it8_reader_get_property (reader, "LUMINANCE_XYZ_CDM2");
 		if (!cd_it8_parse_luminance (tmp, &luminance, error))
 			return FALSE;
 	} else {
@@ -510,14 +833,14 @@ cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* set spectral flag */
-	tmp = cmsIT8GetProperty (it8_lcms, "INSTRUMENT_TYPE_SPECTRAL");
+	tmp = cd_it8_reader_get_property (reader, "INSTRUMENT_TYPE_SPECTRAL");
 	cd_it8_set_spectral (it8, g_strcmp0 (tmp, "YES") == 0);
 
 	/* set instrument */
-	cd_it8_set_instrument (it8, cmsIT8GetProperty (it8_lcms, "TARGET_INSTRUMENT"));
+	cd_it8_set_instrument (it8, cd_it8_reader_get_property (reader, "TARGET_INSTRUMENT"));
 
 	/* copy out data entries */
-	number_of_sets = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_SETS");
+	number_of_sets = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_SETS");
 	if (number_of_sets == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -525,21 +848,25 @@ cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 				     "Invalid format, NUMBER_OF_SETS required");
 		return FALSE;
 	}
+	values = g_new0 (gdouble, cd_it8_reader_get_number_of_fields (reader));
+	g_array_set_size (priv->array_rgb, number_of_sets);
+	g_array_set_size (priv->array_xyz, number_of_sets);
 	for (i = 0; i < number_of_sets; i++) {
-		rgb = cd_color_rgb_new ();
-		rgb->R = _cmsIT8GetDataRowColDbl (it8_lcms, i, 1);
-		rgb->G = _cmsIT8GetDataRowColDbl (it8_lcms, i, 2);
-		rgb->B = _cmsIT8GetDataRowColDbl (it8_lcms, i, 3);
+		if (!_cd_it8_reader_read_set (reader, values, error))
+			return FALSE;
+		rgb = &g_array_index (priv->array_rgb, CdColorRGB, i);
+		rgb->R = values[1];
+		rgb->G = values[2];
+		rgb->B = values[3];
 		if (scaled_to_y100) {
 			rgb->R /= 100.0f;
 			rgb->G /= 100.0f;
 			rgb->B /= 100.0f;
 		}
-		g_ptr_array_add (priv->array_rgb, rgb);
-		xyz = cd_color_xyz_new ();
-		xyz->X = _cmsIT8GetDataRowColDbl (it8_lcms, i, 4);
-		xyz->Y = _cmsIT8GetDataRowColDbl (it8_lcms, i, 5);
-		xyz->Z = _cmsIT8GetDataRowColDbl (it8_lcms, i, 6);
+		xyz = &g_array_index (priv->array_xyz, CdColorXYZ, i);
+		xyz->X = values[4];
+		xyz->Y = values[5];
+		xyz->Z = values[6];
 		if (scaled_to_y100) {
 			xyz->X /= 100.0f;
 			xyz->Y /= 100.0f;
@@ -548,19 +875,21 @@ cd_it8_load_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			xyz->Y *= luminance.Y;
 			xyz->Z *= luminance.Z;
 		}
-		g_ptr_array_add (priv->array_xyz, xyz);
 	}
 	return TRUE;
 }
 
 static gboolean
-cd_it8_load_ccmx (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_load_ccmx (CdIt8 *it8, CdIt8Reader *reader, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	const gchar *tmp;
+	gdouble *m = &priv->matrix.m00;
+	gdouble values[3];
+	guint i;
 
 	/* check color format */
-	tmp = cmsIT8GetProperty (it8_lcms, "COLOR_REP");
+	tmp = cd_it8_reader_get_property (reader, "COLOR_REP");
 	if (g_strcmp0 (tmp, "XYZ") != 0) {
 		g_set_error (error,
 			     CD_IT8_ERROR,
@@ -568,39 +897,45 @@ cd_it8_load_ccmx (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			     "Invalid CCMX data format: %s", tmp);
 		return FALSE;
 	}
+	if (cd_it8_reader_get_number_of_fields (reader) != 3) {
+		g_set_error (error,
+			     CD_IT8_ERROR,
+			     CD_IT8_ERROR_INVALID_FORMAT,
+			     "Invalid CCMX: fields != 3 (%u)",
+			     cd_it8_reader_get_number_of_fields (reader));
+		return FALSE;
+	}
 
 	/* set instrument */
-	cd_it8_set_instrument (it8, cmsIT8GetProperty (it8_lcms, "INSTRUMENT"));
+	cd_it8_set_instrument (it8, cd_it8_reader_get_property (reader, "INSTRUMENT"));
 
 	/* just load the matrix */
-	priv->matrix.m00 = _cmsIT8GetDataRowColDbl (it8_lcms, 0, 0);
-	priv->matrix.m01 = _cmsIT8GetDataRowColDbl (it8_lcms, 0, 1);
-	priv->matrix.m02 = _cmsIT8GetDataRowColDbl (it8_lcms, 0, 2);
-	priv->matrix.m10 = _cmsIT8GetDataRowColDbl (it8_lcms, 1, 0);
-	priv->matrix.m11 = _cmsIT8GetDataRowColDbl (it8_lcms, 1, 1);
-	priv->matrix.m12 = _cmsIT8GetDataRowColDbl (it8_lcms, 1, 2);
-	priv->matrix.m20 = _cmsIT8GetDataRowColDbl (it8_lcms, 2, 0);
-	priv->matrix.m21 = _cmsIT8GetDataRowColDbl (it8_lcms, 2, 1);
-	priv->matrix.m22 = _cmsIT8GetDataRowColDbl (it8_lcms, 2, 2);
+	for (i = 0; i < 3; i++) {
+		if (!_cd_it8_reader_read_set (reader, values, error))
+			return FALSE;
+		m[i * 3 + 0] = values[0];
+		m[i * 3 + 1] = values[1];
+		m[i * 3 + 2] = values[2];
+	}
 	return TRUE;
 }
 
 static gboolean
-cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_load_ccss_spect (CdIt8 *it8, CdIt8Reader *reader, GError **error)
 {
 	const gchar *tmp;
 	gboolean has_index;
 	gdouble spectral_end;
 	gdouble spectral_norm;
 	gdouble spectral_start;
-	guint i;
 	guint j;
 	guint number_of_fields;
 	guint number_of_sets;
 	guint spectral_bands;
+	g_autofree gdouble *values = NULL;
 
 	/* get spectra endpoints */
-	tmp = cmsIT8GetProperty (it8_lcms, "SPECTRAL_START_NM");
+	tmp = cd_it8_reader_get_property (reader, "SPECTRAL_START_NM");
 	if (tmp == NULL) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -608,8 +943,8 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 				     "Invalid format, SPECTRAL_START_NM required");
 		return FALSE;
 	}
-	spectral_start = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_START_NM");
-	spectral_end = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_END_NM");
+	spectral_start = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_START_NM");
+	spectral_end = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_END_NM");
 	if (spectral_end == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -619,7 +954,7 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* get number of bands */
-	spectral_bands = _cmsIT8GetPropertyInt (it8_lcms, "SPECTRAL_BANDS");
+	spectral_bands = _cd_it8_reader_get_property_int (reader, "SPECTRAL_BANDS");
 	if (spectral_bands == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -636,13 +971,13 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* get spectral norm */
-	spectral_norm = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_NORM");
+	spectral_norm = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_NORM");
 	if (spectral_norm < 0.f)
 		spectral_norm = 1.f;
 
 	/* ArgyllCMS seems to support an index in the CCSS file, and not in the
 	 * SPECT or CMF but like any good library support each mode */
-	number_of_fields = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS");
+	number_of_fields = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_FIELDS");
 	if (number_of_fields == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -664,7 +999,7 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* read out the arrays of data */
-	number_of_sets = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_SETS");
+	number_of_sets = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_SETS");
 	if (number_of_sets == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -672,21 +1007,22 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 				     "Invalid format, NUMBER_OF_SETS required");
 		return FALSE;
 	}
+	values = g_new0 (gdouble, number_of_fields);
 	for (j = 0; j < (guint) number_of_sets; j++) {
 		g_autoptr(CdSpectrum) spectrum = NULL;
+		if (!_cd_it8_reader_read_set (reader, values, error))
+			return FALSE;
 		spectrum = cd_spectrum_sized_new (spectral_bands);
 		if (has_index) {
 			cd_spectrum_set_id (spectrum,
-					    cmsIT8GetDataRowCol(it8_lcms, j, 0));
+					    cd_it8_reader_get_string (reader, 0));
 		} else {
 			g_autofree gchar *label = NULL;
 			label = g_strdup_printf ("%u", j + 1);
 			cd_spectrum_set_id (spectrum, label);
 		}
-		for (i = has_index; i < number_of_fields; i++) {
-			cd_spectrum_add_value (spectrum,
-					      _cmsIT8GetDataRowColDbl (it8_lcms, j, i));
-		}
+		g_array_append_vals (cd_spectrum_get_data (spectrum),
+				     values + has_index, spectral_bands);
 		cd_spectrum_set_start (spectrum, spectral_start);
 		cd_spectrum_set_end (spectrum, spectral_end);
 		cd_spectrum_set_norm (spectrum, spectral_norm);
@@ -696,19 +1032,19 @@ cd_it8_load_ccss_spect (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 }
 
 static gboolean
-cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_load_cmf (CdIt8 *it8, CdIt8Reader *reader, GError **error)
 {
 	gdouble spectral_end;
 	gdouble spectral_norm;
 	gdouble spectral_start;
-	guint i;
 	guint j;
 	guint number_of_fields;
 	guint number_of_sets;
 	guint spectral_bands;
+	g_autofree gdouble *values = NULL;
 
 	/* get spectra endpoints */
-	spectral_start = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_START_NM");
+	spectral_start = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_START_NM");
 	if (spectral_start == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -716,7 +1052,7 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 				     "Invalid format, SPECTRAL_START_NM required");
 		return FALSE;
 	}
-	spectral_end = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_END_NM");
+	spectral_end = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_END_NM");
 	if (spectral_end == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -726,7 +1062,7 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* get number of bands */
-	spectral_bands = _cmsIT8GetPropertyInt (it8_lcms, "SPECTRAL_BANDS");
+	spectral_bands = _cd_it8_reader_get_property_int (reader, "SPECTRAL_BANDS");
 	if (spectral_bands == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -743,12 +1079,12 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* get spectral norm */
-	spectral_norm = _cmsIT8GetPropertyDbl (it8_lcms, "SPECTRAL_NORM");
+	spectral_norm = _cd_it8_reader_get_property_dbl (reader, "SPECTRAL_NORM");
 	if (spectral_norm < 0.f)
 		spectral_norm = 1.f;
 
 	/* CMF files are un-indexed and implicitly XYZ */
-	number_of_fields = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS");
+	number_of_fields = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_FIELDS");
 	if (number_of_fields == 0) {
 		g_set_error_literal (error,
 				     CD_IT8_ERROR,
@@ -766,7 +1102,7 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	}
 
 	/* read out the arrays of data */
-	number_of_sets = _cmsIT8GetPropertyInt (it8_lcms, "NUMBER_OF_SETS");
+	number_of_sets = _cd_it8_reader_get_property_int (reader, "NUMBER_OF_SETS");
 	if (number_of_sets != 3) {
 		g_set_error (error,
 			     CD_IT8_ERROR,
@@ -775,8 +1111,11 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			     number_of_sets);
 		return FALSE;
 	}
+	values = g_new0 (gdouble, number_of_fields);
 	for (j = 0; j < (guint) number_of_sets; j++) {
 		g_autoptr(CdSpectrum) spectrum = NULL;
+		if (!_cd_it8_reader_read_set (reader, values, error))
+			return FALSE;
 		spectrum = cd_spectrum_sized_new (spectral_bands);
 		if (j == 0)
 			cd_spectrum_set_id (spectrum, "X");
@@ -784,10 +1123,8 @@ cd_it8_load_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			cd_spectrum_set_id (spectrum, "Y");
 		else
 			cd_spectrum_set_id (spectrum, "Z");
-		for (i = 0; i < number_of_fields; i++) {
-			cd_spectrum_add_value (spectrum,
-					      _cmsIT8GetDataRowColDbl (it8_lcms, j, i));
-		}
+		g_array_append_vals (cd_spectrum_get_data (spectrum),
+				     values, number_of_fields);
 		cd_spectrum_set_start (spectrum, spectral_start);
 		cd_spectrum_set_end (spectrum, spectral_end);
 		cd_spectrum_set_norm (spectrum, spectral_norm);
@@ -825,71 +1162,37 @@ cd_it8_has_option (CdIt8 *it8, const gchar *option)
 	return FALSE;
 }
 
-/**
- * cd_it8_load_from_data:
- * @it8: a #CdIt8 instance.
- * @data: (array length=size): text data
- * @size: the size of text data
- * @error: a #GError, or %NULL
- *
- * Loads a it8 file from data.
- *
- * Return value: %TRUE if a valid it8 file was read.
- *
- * Since: 0.1.20
- **/
-gboolean
-cd_it8_load_from_data (CdIt8 *it8,
-		       const gchar *data,
-		       gsize size,
-		       GError **error)
+static gboolean
+cd_it8_load_from_bytes (CdIt8 *it8, GBytes *bytes, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	cmsHANDLE it8_lcms = NULL;
+	GPtrArray *props;
 	const gchar *tmp;
-	gboolean ret = TRUE;
-	gchar **props = NULL;
 	guint i;
-	g_autoptr(GError) error_local = NULL;
-
-	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
-	g_return_val_if_fail (data != NULL, FALSE);
-	g_return_val_if_fail (size > 0, FALSE);
+	g_autoptr(CdIt8Reader) reader = NULL;
 
 	/* clear old data */
-	g_ptr_array_set_size (priv->array_rgb, 0);
-	g_ptr_array_set_size (priv->array_xyz, 0);
+	g_array_set_size (priv->array_rgb, 0);
+	g_array_set_size (priv->array_xyz, 0);
 	g_ptr_array_set_size (priv->options, 0);
+	cd_it8_index_invalidate (it8);
 	cd_mat33_clear (&priv->matrix);
 
-	/* load the it8 data */
-	it8_lcms = cmsIT8LoadFromMem (priv->context_lcms, (void *) data, size);
-	if (it8_lcms == NULL) {
-		ret = cd_context_lcms_error_check (priv->context_lcms, &error_local);
-		if (!ret) {
-			g_set_error_literal (error,
-					     CD_IT8_ERROR,
-					     CD_IT8_ERROR_FAILED,
-					     error_local->message);
-			goto out;
-		}
-		ret = FALSE;
-		g_set_error_literal (error,
-				     CD_IT8_ERROR,
-				     CD_IT8_ERROR_FAILED,
-				     "Failed to load but no error set");
-		goto out;
-	}
+	/* read up to the start of the data */
+	reader = cd_it8_reader_new (bytes);
+	if (!cd_it8_reader_parse_header (reader, error))
+		return FALSE;
 
 	/* add options */
-	cmsIT8EnumProperties (it8_lcms, &props);
-	for (i = 0; props[i] != NULL; i++) {
-		if (g_str_has_prefix (props[i], "TYPE_"))
-			cd_it8_add_option (it8, props[i]);
+	props = cd_it8_reader_get_properties (reader);
+	for (i = 0; i < props->len; i++) {
+		const gchar *prop = g_ptr_array_index (props, i);
+		if (g_str_has_prefix (prop, "TYPE_"))
+			cd_it8_add_option (it8, prop);
 	}
 
 	/* get sheet type */
-	tmp = cmsIT8GetSheetType (it8_lcms);
+	tmp = cd_it8_reader_get_sheet_type (reader);
 	if (g_str_has_prefix (tmp, "CTI1")) {
 		cd_it8_set_kind (it8, CD_IT8_KIND_TI1);
 	} else if (g_str_has_prefix (tmp, "CTI3")) {
@@ -905,55 +1208,76 @@ cd_it8_load_from_data (CdIt8 *it8,
 	} else if (g_str_has_prefix (tmp, "CAL")) {
 		cd_it8_set_kind (it8, CD_IT8_KIND_CAL);
 	} else {
-		ret = FALSE;
 		g_set_error (error,
 			     CD_IT8_ERROR,
 			     CD_IT8_ERROR_UNKNOWN_KIND,
 			     "Unknown sheet type: %s", tmp);
-		goto out;
+		return FALSE;
 	}
 
 	/* get ti1 and ti3 specific data */
 	switch (priv->kind) {
 	case CD_IT8_KIND_TI1:
 	case CD_IT8_KIND_CAL:
-		ret = cd_it8_load_ti1_cal (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		if (!cd_it8_load_ti1_cal (it8, reader, error))
+			return FALSE;
 		break;
 	case CD_IT8_KIND_TI3:
-		ret = cd_it8_load_ti3 (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		if (!cd_it8_load_ti3 (it8, reader, error))
+			return FALSE;
 		break;
 	case CD_IT8_KIND_CCMX:
-		ret = cd_it8_load_ccmx (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		if (!cd_it8_load_ccmx (it8, reader, error))
+			return FALSE;
 		break;
 	case CD_IT8_KIND_CCSS:
 	case CD_IT8_KIND_SPECT:
-		ret = cd_it8_load_ccss_spect (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		if (!cd_it8_load_ccss_spect (it8, reader, error))
+			return FALSE;
 		break;
 	case CD_IT8_KIND_CMF:
-		ret = cd_it8_load_cmf (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		if (!cd_it8_load_cmf (it8, reader, error))
+			return FALSE;
 		break;
 	default:
 		break;
 	}
 
 	/* set common bits */
-	cd_it8_set_title (it8, cmsIT8GetProperty (it8_lcms, "DISPLAY"));
-	cd_it8_set_originator (it8, cmsIT8GetProperty (it8_lcms, "ORIGINATOR"));
-	cd_it8_set_reference (it8, cmsIT8GetProperty (it8_lcms, "REFERENCE"));
-out:
-	if (it8_lcms != NULL)
-		cmsIT8Free (it8_lcms);
-	return ret;
+	cd_it8_set_title (it8, cd_it8_reader_get_property (reader, "DISPLAY"));
+	cd_it8_set_originator (it8, cd_it8_reader_get_property (reader, "ORIGINATOR"));
+	cd_it8_set_reference (it8, cd_it8_reader_get_property (reader, "REFERENCE"));
+	return TRUE;
+}
+
+/**
+ * cd_it8_load_from_data:
+ * @it8: a #CdIt8 instance.
+ * @data: (array length=size): text data
+ * @size: the size of text data
+ * @error: a #GError, or %NULL
+ *
+ * Loads a it8 file from data.
+ *
+ * Return value: %TRUE if a valid it8 file was read.
+ *
+ * Since: 0.1.20
+ **/
+gboolean
+cd_it8_load_from_data (CdIt8 *it8,
+		       const gchar *data,
+		       gsize size,
+		       GError **error)
+{
+	g_autoptr(GBytes) bytes = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (size > 0, FALSE);
+
+	/* the data is only needed for the duration of the call */
+	bytes = g_bytes_new_static (data, size);
+	return cd_it8_load_from_bytes (it8, bytes, error);
 }
 
 /**
@@ -962,7 +1286,8 @@ out:
  * @file: a #GFile
  * @error: a #GError, or %NULL
  *
- * Loads a it8 file from disk.
+ * Loads a it8 file from disk. Local files are mapped into memory
+ * rather than copied.
  *
  * Return value: %TRUE if a valid it8 file was read.
  *
@@ -971,20 +1296,37 @@ out:
 gboolean
 cd_it8_load_from_file (CdIt8 *it8, GFile *file, GError **error)
 {
+	gchar *data = NULL;
 	gsize size = 0;
-	g_autofree gchar *data = NULL;
+	g_autofree gchar *path = NULL;
+	g_autoptr(GBytes) bytes = NULL;
 
 	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
-	/* load file */
-	if (!g_file_load_contents (file, NULL, &data, &size, NULL, error))
+	/* map local files, otherwise load the file */
+	path = g_file_get_path (file);
+	if (path != NULL) {
+		g_autoptr(GMappedFile) mapped = NULL;
+		mapped = g_mapped_file_new (path, FALSE, NULL);
+		if (mapped != NULL)
+			bytes = g_mapped_file_get_bytes (mapped);
+	}
+	if (bytes == NULL) {
+		if (!g_file_load_contents (file, NULL, &data, &size, NULL, error))
+			return FALSE;
+		bytes = g_bytes_new_take (data, size);
+	}
+	if (g_bytes_get_size (bytes) == 0) {
+		g_set_error_literal (error,
+				     CD_IT8_ERROR,
+				     CD_IT8_ERROR_INVALID_FORMAT,
+				     "No data");
 		return FALSE;
+	}
 
 	/* load data */
-	if (!cd_it8_load_from_data (it8, data, size, error))
-		return FALSE;
-	return TRUE;
+	return cd_it8_load_from_bytes (it8, bytes, error);
 }
 
 static gboolean
@@ -1010,7 +1352,7 @@ cd_it8_convert_xyz_to_string (CdColorXYZ *src)
 }
 
 static gboolean
-cd_it8_save_to_file_ti1_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_save_to_file_ti1_ti3 (CdIt8 *it8, CdIt8Writer *writer, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdColorRGB *rgb_tmp;
@@ -1026,14 +1368,14 @@ cd_it8_save_to_file_ti1_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	cd_color_xyz_clear (&lumi_xyz);
 	if (priv->normalized) {
 		for (i = 0; i < priv->array_rgb->len; i++) {
-			rgb_tmp = g_ptr_array_index (priv->array_rgb, i);
+			rgb_tmp = &g_array_index (priv->array_rgb, CdColorRGB, i);
 
 			/* is this 100% white? */
 			is_white = cd_it8_color_match (rgb_tmp, 1.0f, 1.0f, 1.0f);
 			if (!is_white)
 				continue;
 			luminance_samples++;
-			xyz_tmp = g_ptr_array_index (priv->array_xyz, i);
+			xyz_tmp = &g_array_index (priv->array_xyz, CdColorXYZ, i);
 			lumi_xyz.X += xyz_tmp->X;
 			lumi_xyz.Y += xyz_tmp->Y;
 			lumi_xyz.Z += xyz_tmp->Z;
@@ -1058,142 +1400,144 @@ cd_it8_save_to_file_ti1_ti3 (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 
 	/* write data */
 	if (priv->kind == CD_IT8_KIND_TI1) {
-		cmsIT8SetSheetType (it8_lcms, "CTI1   ");
-		cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-				      "Calibration Target chart information 1");
+		cd_it8_writer_set_sheet_type (writer, "CTI1   ");
+		cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+						"Calibration Target chart information 1");
 	} else if (priv->kind == CD_IT8_KIND_TI3) {
-		cmsIT8SetSheetType (it8_lcms, "CTI3   ");
-		cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-				      "Calibration Target chart information 3");
+		cd_it8_writer_set_sheet_type (writer, "CTI3   ");
+		cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+						"Calibration Target chart information 3");
 	}
 	if (priv->kind == CD_IT8_KIND_TI3) {
-		cmsIT8SetPropertyStr (it8_lcms, "DEVICE_CLASS",
-				      "DISPLAY");
+		cd_it8_writer_set_property_str (writer, "DEVICE_CLASS",
+						"DISPLAY");
 	}
-	cmsIT8SetPropertyStr (it8_lcms, "COLOR_REP", "RGB_XYZ");
+	cd_it8_writer_set_property_str (writer, "COLOR_REP", "RGB_XYZ");
 	if (priv->instrument != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "TARGET_INSTRUMENT",
-				      priv->instrument);
+		cd_it8_writer_set_property_str (writer, "TARGET_INSTRUMENT",
+						priv->instrument);
 	}
-	cmsIT8SetPropertyStr (it8_lcms, "INSTRUMENT_TYPE_SPECTRAL",
-			      priv->spectral ? "YES" : "NO");
+	cd_it8_writer_set_property_str (writer, "INSTRUMENT_TYPE_SPECTRAL",
+					priv->spectral ? "YES" : "NO");
 	if (priv->normalized) {
-		cmsIT8SetPropertyStr (it8_lcms, "NORMALIZED_TO_Y_100", "YES");
-		cmsIT8SetPropertyStr (it8_lcms, "LUMINANCE_XYZ_CDM2", lumi_str);
+		cd_it8_writer_set_property_str (writer, "NORMALIZED_TO_Y_100", "YES");
+		cd_it8_writer_set_property_str (writer, "LUMINANCE_XYZ_CDM2", lumi_str);
 	} else {
-		cmsIT8SetPropertyStr (it8_lcms, "NORMALIZED_TO_Y_100", "NO");
-	}
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS", 7);
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_SETS", priv->array_rgb->len);
-	cmsIT8SetDataFormat (it8_lcms, 0, "SAMPLE_ID");
-	cmsIT8SetDataFormat (it8_lcms, 1, "RGB_R");
-	cmsIT8SetDataFormat (it8_lcms, 2, "RGB_G");
-	cmsIT8SetDataFormat (it8_lcms, 3, "RGB_B");
-	cmsIT8SetDataFormat (it8_lcms, 4, "XYZ_X");
-	cmsIT8SetDataFormat (it8_lcms, 5, "XYZ_Y");
-	cmsIT8SetDataFormat (it8_lcms, 6, "XYZ_Z");
+		cd_it8_writer_set_property_str (writer, "NORMALIZED_TO_Y_100", "NO");
+	}
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_FIELDS", 7);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_SETS", priv->array_rgb->len);
+	cd_it8_writer_set_data_format (writer, "SAMPLE_ID");
+	cd_it8_writer_set_data_format (writer, "RGB_R");
+	cd_it8_writer_set_data_format (writer, "RGB_G");
+	cd_it8_writer_set_data_format (writer, "RGB_B");
+	cd_it8_writer_set_data_format (writer, "XYZ_X");
+	cd_it8_writer_set_data_format (writer, "XYZ_Y");
+	cd_it8_writer_set_data_format (writer, "XYZ_Z");
 
 	/* write to the it8 file */
+	cd_it8_writer_begin_data (writer);
 	for (i = 0; i < priv->array_rgb->len; i++) {
-		rgb_tmp = g_ptr_array_index (priv->array_rgb, i);
-		xyz_tmp = g_ptr_array_index (priv->array_xyz, i);
+		rgb_tmp = &g_array_index (priv->array_rgb, CdColorRGB, i);
+		xyz_tmp = &g_array_index (priv->array_xyz, CdColorXYZ, i);
 
-		_cmsIT8SetDataRowColDbl(it8_lcms, i, 0, i + 1);
+		cd_it8_writer_add_dbl (writer, i + 1);
 		if (priv->normalized) {
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 1, rgb_tmp->R * 100.0f);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 2, rgb_tmp->G * 100.0f);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 3, rgb_tmp->B * 100.0f);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 4, xyz_tmp->X * normalize);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 5, xyz_tmp->Y * normalize);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 6, xyz_tmp->Z * normalize);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->R * 100.0f);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->G * 100.0f);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->B * 100.0f);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->X * normalize);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->Y * normalize);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->Z * normalize);
 		} else {
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 1, rgb_tmp->R);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 2, rgb_tmp->G);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 3, rgb_tmp->B);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 4, xyz_tmp->X);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 5, xyz_tmp->Y);
-			_cmsIT8SetDataRowColDbl(it8_lcms, i, 6, xyz_tmp->Z);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->R);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->G);
+			cd_it8_writer_add_dbl (writer, rgb_tmp->B);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->X);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->Y);
+			cd_it8_writer_add_dbl (writer, xyz_tmp->Z);
 		}
+		if (!cd_it8_writer_end_row (writer, error))
+			return FALSE;
 	}
 	return TRUE;
 }
 
 static gboolean
-cd_it8_save_to_file_cal (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_save_to_file_cal (CdIt8 *it8, CdIt8Writer *writer, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdColorRGB *rgb_tmp;
-	gboolean ret = TRUE;
 	guint i;
 
 	/* write data */
-	cmsIT8SetSheetType (it8_lcms, "CAL    ");
-	cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-			      "Device Calibration Curves");
-	cmsIT8SetPropertyStr (it8_lcms, "DEVICE_CLASS", "DISPLAY");
-	cmsIT8SetPropertyStr (it8_lcms, "COLOR_REP", "RGB");
+	cd_it8_writer_set_sheet_type (writer, "CAL    ");
+	cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+					"Device Calibration Curves");
+	cd_it8_writer_set_property_str (writer, "DEVICE_CLASS", "DISPLAY");
+	cd_it8_writer_set_property_str (writer, "COLOR_REP", "RGB");
 	if (priv->instrument != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "TARGET_INSTRUMENT",
-				      priv->instrument);
+		cd_it8_writer_set_property_str (writer, "TARGET_INSTRUMENT",
+						priv->instrument);
 	}
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS", 4);
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_SETS", priv->array_rgb->len);
-	cmsIT8SetDataFormat (it8_lcms, 0, "RGB_I");
-	cmsIT8SetDataFormat (it8_lcms, 1, "RGB_R");
-	cmsIT8SetDataFormat (it8_lcms, 2, "RGB_G");
-	cmsIT8SetDataFormat (it8_lcms, 3, "RGB_B");
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_FIELDS", 4);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_SETS", priv->array_rgb->len);
+	cd_it8_writer_set_data_format (writer, "RGB_I");
+	cd_it8_writer_set_data_format (writer, "RGB_R");
+	cd_it8_writer_set_data_format (writer, "RGB_G");
+	cd_it8_writer_set_data_format (writer, "RGB_B");
 
 	/* write to the it8 file */
+	cd_it8_writer_begin_data (writer);
 	for (i = 0; i < priv->array_rgb->len; i++) {
-		rgb_tmp = g_ptr_array_index (priv->array_rgb, i);
-		_cmsIT8SetDataRowColDbl(it8_lcms, i, 0, 1.0f / (gdouble) (priv->array_rgb->len - 1) * (gdouble) i);
-		_cmsIT8SetDataRowColDbl(it8_lcms, i, 1, rgb_tmp->R);
-		_cmsIT8SetDataRowColDbl(it8_lcms, i, 2, rgb_tmp->G);
-		_cmsIT8SetDataRowColDbl(it8_lcms, i, 3, rgb_tmp->B);
+		rgb_tmp = &g_array_index (priv->array_rgb, CdColorRGB, i);
+		cd_it8_writer_add_dbl (writer, 1.0f / (gdouble) (priv->array_rgb->len - 1) * (gdouble) i);
+		cd_it8_writer_add_dbl (writer, rgb_tmp->R);
+		cd_it8_writer_add_dbl (writer, rgb_tmp->G);
+		cd_it8_writer_add_dbl (writer, rgb_tmp->B);
+		if (!cd_it8_writer_end_row (writer, error))
+			return FALSE;
 	}
-
-	return ret;
+	return TRUE;
 }
 
 static gboolean
-cd_it8_save_to_file_ccmx (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_save_to_file_ccmx (CdIt8 *it8, CdIt8Writer *writer, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	gboolean ret = TRUE;
+	guint i;
+	guint j;
 
-	cmsIT8SetSheetType (it8_lcms, "CCMX   ");
-	cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-			      "Device Correction Matrix");
+	cd_it8_writer_set_sheet_type (writer, "CCMX   ");
+	cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+					"Device Correction Matrix");
 
-	cmsIT8SetPropertyStr (it8_lcms, "COLOR_REP", "XYZ");
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS", 3);
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_SETS", 3);
-	cmsIT8SetDataFormat (it8_lcms, 0, "XYZ_X");
-	cmsIT8SetDataFormat (it8_lcms, 1, "XYZ_Y");
-	cmsIT8SetDataFormat (it8_lcms, 2, "XYZ_Z");
+	cd_it8_writer_set_property_str (writer, "COLOR_REP", "XYZ");
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_FIELDS", 3);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_SETS", 3);
+	cd_it8_writer_set_data_format (writer, "XYZ_X");
+	cd_it8_writer_set_data_format (writer, "XYZ_Y");
+	cd_it8_writer_set_data_format (writer, "XYZ_Z");
 
 	/* save instrument */
 	if (priv->instrument != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "INSTRUMENT",
-				      priv->instrument);
+		cd_it8_writer_set_property_str (writer, "INSTRUMENT",
+						priv->instrument);
 	}
 
 	/* just save the matrix */
-	_cmsIT8SetDataRowColDbl (it8_lcms, 0, 0, priv->matrix.m00);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 0, 1, priv->matrix.m01);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 0, 2, priv->matrix.m02);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 1, 0, priv->matrix.m10);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 1, 1, priv->matrix.m11);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 1, 2, priv->matrix.m12);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 2, 0, priv->matrix.m20);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 2, 1, priv->matrix.m21);
-	_cmsIT8SetDataRowColDbl (it8_lcms, 2, 2, priv->matrix.m22);
-
-	return ret;
+	cd_it8_writer_begin_data (writer);
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < 3; i++)
+			cd_it8_writer_add_dbl (writer, cd_mat33_get_data (&priv->matrix)[j * 3 + i]);
+		if (!cd_it8_writer_end_row (writer, error))
+			return FALSE;
+	}
+	return TRUE;
 }
 
 static gboolean
-cd_it8_save_to_file_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_save_to_file_cmf (CdIt8 *it8, CdIt8Writer *writer, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdSpectrum *spectrum;
@@ -1202,9 +1546,9 @@ cd_it8_save_to_file_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	guint number_of_sets;
 	guint spectral_bands;
 
-	cmsIT8SetSheetType (it8_lcms, "CMF    ");
-	cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-			      "Color Match Function");
+	cd_it8_writer_set_sheet_type (writer, "CMF    ");
+	cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+					"Color Match Function");
 
 	/* check data is valid */
 	number_of_sets = priv->array_spectra->len;
@@ -1219,11 +1563,11 @@ cd_it8_save_to_file_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	/* all the arrays have to have the same length */
 	spectrum = g_ptr_array_index (priv->array_spectra, 0);
 	spectral_bands = cd_spectrum_get_size (spectrum);
-	_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_START_NM", cd_spectrum_get_start (spectrum));
-	_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_END_NM", cd_spectrum_get_end (spectrum));
-	_cmsIT8SetPropertyInt (it8_lcms, "SPECTRAL_BANDS", spectral_bands);
-	_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_NORM", cd_spectrum_get_norm (spectrum));
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS", spectral_bands);
+	cd_it8_writer_set_property_dbl (writer, "SPECTRAL_START_NM", cd_spectrum_get_start (spectrum));
+	cd_it8_writer_set_property_dbl (writer, "SPECTRAL_END_NM", cd_spectrum_get_end (spectrum));
+	cd_it8_writer_set_property_int (writer, "SPECTRAL_BANDS", spectral_bands);
+	cd_it8_writer_set_property_dbl (writer, "SPECTRAL_NORM", cd_spectrum_get_norm (spectrum));
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_FIELDS", spectral_bands);
 
 	/* set DATA_FORMAT (using an ID if there are more than one spectra */
 	spectrum = g_ptr_array_index (priv->array_spectra, 0);
@@ -1231,28 +1575,31 @@ cd_it8_save_to_file_cmf (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 		g_autofree gchar *label = NULL;
 		label = g_strdup_printf ("SPEC_%.0f",
 					 cd_spectrum_get_wavelength (spectrum, i));
-		cmsIT8SetDataFormat (it8_lcms, i, label);
+		cd_it8_writer_set_data_format (writer, label);
 	}
 
 	/* set DATA */
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_SETS", number_of_sets);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_SETS", number_of_sets);
+	cd_it8_writer_begin_data (writer);
 	for (j = 0; j < number_of_sets; j++) {
 		spectrum = g_ptr_array_index (priv->array_spectra, j);
 		for (i = 0; i < spectral_bands; i++) {
 			if (!priv->normalized) {
-				_cmsIT8SetDataRowColDbl (it8_lcms, j, i,
-							 cd_spectrum_get_value (spectrum, i));
+				cd_it8_writer_add_dbl (writer,
+						       cd_spectrum_get_value (spectrum, i));
 			} else {
-				_cmsIT8SetDataRowColDbl (it8_lcms, j, i,
-							 cd_spectrum_get_value_raw (spectrum, i));
+				cd_it8_writer_add_dbl (writer,
+						       cd_spectrum_get_value_raw (spectrum, i));
 			}
 		}
+		if (!cd_it8_writer_end_row (writer, error))
+			return FALSE;
 	}
 	return TRUE;
 }
 
 static gboolean
-cd_it8_save_to_file_ccss_sp (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
+cd_it8_save_to_file_ccss_sp (CdIt8 *it8, CdIt8Writer *writer, GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
 	CdSpectrum *spectrum;
@@ -1264,19 +1611,19 @@ cd_it8_save_to_file_ccss_sp (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 
 	switch (priv->kind) {
 	case CD_IT8_KIND_CCSS:
-		cmsIT8SetSheetType (it8_lcms, "CCSS   ");
-		cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-				      "Colorimeter Calibration Spectral Set");
+		cd_it8_writer_set_sheet_type (writer, "CCSS   ");
+		cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+						"Colorimeter Calibration Spectral Set");
 		break;
 	case CD_IT8_KIND_CMF:
-		cmsIT8SetSheetType (it8_lcms, "CMF    ");
-		cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-				      "Color Match Function");
+		cd_it8_writer_set_sheet_type (writer, "CMF    ");
+		cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+						"Color Match Function");
 		break;
 	case CD_IT8_KIND_SPECT:
-		cmsIT8SetSheetType (it8_lcms, "SPECT  ");
-		cmsIT8SetPropertyStr (it8_lcms, "DESCRIPTOR",
-				      "Spectral Power");
+		cd_it8_writer_set_sheet_type (writer, "SPECT  ");
+		cd_it8_writer_set_property_str (writer, "DESCRIPTOR",
+						"Spectral Power");
 		break;
 	default:
 		break;
@@ -1297,16 +1644,16 @@ cd_it8_save_to_file_ccss_sp (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 	/* all the arrays have to have the same length */
 	spectrum = g_ptr_array_index (priv->array_spectra, 0);
 	spectral_bands = cd_spectrum_get_size (spectrum);
-	_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_START_NM", cd_spectrum_get_start (spectrum));
-	_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_END_NM", cd_spectrum_get_end (spectrum));
-	_cmsIT8SetPropertyInt (it8_lcms, "SPECTRAL_BANDS", spectral_bands);
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_FIELDS", spectral_bands + has_index);
+	cd_it8_writer_set_property_dbl (writer, "SPECTRAL_START_NM", cd_spectrum_get_start (spectrum));
+	cd_it8_writer_set_property_dbl (writer, "SPECTRAL_END_NM", cd_spectrum_get_end (spectrum));
+	cd_it8_writer_set_property_int (writer, "SPECTRAL_BANDS", spectral_bands);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_FIELDS", spectral_bands + has_index);
 	if (priv->normalized)
-		_cmsIT8SetPropertyDbl (it8_lcms, "SPECTRAL_NORM", cd_spectrum_get_norm (spectrum));
+		cd_it8_writer_set_property_dbl (writer, "SPECTRAL_NORM", cd_spectrum_get_norm (spectrum));
 
 	/* set DATA_FORMAT (using an ID if there are more than one spectra */
 	if (has_index)
-		cmsIT8SetDataFormat (it8_lcms, 0, "SAMPLE_ID");
+		cd_it8_writer_set_data_format (writer, "SAMPLE_ID");
 	spectrum = g_ptr_array_index (priv->array_spectra, 0);
 	for (i = 0; i < spectral_bands; i++) {
 		g_autofree gchar *label = NULL;
@@ -1320,143 +1667,153 @@ cd_it8_save_to_file_ccss_sp (CdIt8 *it8, cmsHANDLE it8_lcms, GError **error)
 			label = g_strdup_printf ("SPEC_%.0f",
 						 cd_spectrum_get_wavelength (spectrum, i));
 		}
-		cmsIT8SetDataFormat (it8_lcms, i + has_index, label);
+		cd_it8_writer_set_data_format (writer, label);
 	}
 
 	/* set DATA */
-	_cmsIT8SetPropertyInt (it8_lcms, "NUMBER_OF_SETS", number_of_sets);
+	cd_it8_writer_set_property_int (writer, "NUMBER_OF_SETS", number_of_sets);
+	cd_it8_writer_begin_data (writer);
 	for (j = 0; j < number_of_sets; j++) {
 		spectrum = g_ptr_array_index (priv->array_spectra, j);
-		if (has_index) {
-			cmsIT8SetDataRowCol (it8_lcms, j, 0,
-					     cd_spectrum_get_id (spectrum));
-		}
+		if (has_index)
+			cd_it8_writer_add_str (writer, cd_spectrum_get_id (spectrum));
 		for (i = 0; i < spectral_bands; i++) {
 			if (!priv->normalized) {
-				_cmsIT8SetDataRowColDbl (it8_lcms, j, i + has_index,
-							 cd_spectrum_get_value (spectrum, i));
+				cd_it8_writer_add_dbl (writer,
+						       cd_spectrum_get_value (spectrum, i));
 			} else {
-				_cmsIT8SetDataRowColDbl (it8_lcms, j, i + has_index,
-							 cd_spectrum_get_value_raw (spectrum, i));
+				cd_it8_writer_add_dbl (writer,
+						       cd_spectrum_get_value_raw (spectrum, i));
 			}
 		}
+		if (!cd_it8_writer_end_row (writer, error))
+			return FALSE;
 	}
 	return TRUE;
 }
 
 /**
- * cd_it8_save_to_data:
+ * cd_it8_save_to_stream:
  * @it8: a #CdIt8 instance.
- * @data: (array length=size): a pointer to returned data
- * @size: size of @data
+ * @stream: a #GOutputStream
+ * @cancellable: a #GCancellable, or %NULL
  * @error: a #GError, or %NULL
  *
- * Saves a it8 file to an area of memory.
+ * Saves a it8 file to a stream. The samples are formatted and written as
+ * they are generated, so large measurement sets do not have to be held in
+ * memory as a whole. The stream is not closed.
  *
  * Return value: %TRUE if it8 file was saved.
  *
- * Since: 0.1.26
+ * Since: 1.4.10
  **/
 gboolean
-cd_it8_save_to_data (CdIt8 *it8,
-		     gchar **data,
-		     gsize *size,
-		     GError **error)
+cd_it8_save_to_stream (CdIt8 *it8,
+		       GOutputStream *stream,
+		       GCancellable *cancellable,
+		       GError **error)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	cmsHANDLE it8_lcms = NULL;
-	const gchar *tmp;
-	gboolean ret;
-	GDateTime *datetime = NULL;
-	cmsUInt32Number size_tmp = 0;
-	guint i;
-	g_autofree gchar *data_tmp = NULL;
-	g_autofree gchar *date_str = NULL;
+	gboolean ret = TRUE;
+	g_autoptr(CdIt8Writer) writer = NULL;
 
 	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
 
 	/* set common data */
-	it8_lcms = cmsIT8Alloc (priv->context_lcms);
+	writer = cd_it8_writer_new (stream, priv->options, cancellable);
 	if (priv->title != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "DISPLAY",
-				      priv->title);
+		cd_it8_writer_set_property_str (writer, "DISPLAY",
+						priv->title);
 	}
 	if (priv->originator != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "ORIGINATOR",
-				      priv->originator);
+		cd_it8_writer_set_property_str (writer, "ORIGINATOR",
+						priv->originator);
 	}
 	if (priv->reference != NULL) {
-		cmsIT8SetPropertyStr (it8_lcms, "REFERENCE",
-				      priv->reference);
+		cd_it8_writer_set_property_str (writer, "REFERENCE",
+						priv->reference);
 	}
 
 	/* set time and date in crazy ArgllCMS format, e.g.
 	 * 'Wed Dec 19 18:47:57 2012' */
 	if (priv->enable_created) {
-		datetime = g_date_time_new_now_local ();
+		g_autoptr(GDateTime) datetime = g_date_time_new_now_local ();
+		g_autofree gchar *date_str = NULL;
 		date_str = g_date_time_format (datetime, "%a %b %d %H:%M:%S %Y");
-		cmsIT8SetPropertyStr (it8_lcms, "CREATED", date_str);
+		cd_it8_writer_set_property_str (writer, "CREATED", date_str);
 	}
 
 	/* set ti1 and ti3 specific data */
 	switch (priv->kind) {
 	case CD_IT8_KIND_TI1:
 	case CD_IT8_KIND_TI3:
-		ret = cd_it8_save_to_file_ti1_ti3 (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		ret = cd_it8_save_to_file_ti1_ti3 (it8, writer, error);
 		break;
 	case CD_IT8_KIND_CAL:
-		ret = cd_it8_save_to_file_cal (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		ret = cd_it8_save_to_file_cal (it8, writer, error);
 		break;
 	case CD_IT8_KIND_CCMX:
-		ret = cd_it8_save_to_file_ccmx (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		ret = cd_it8_save_to_file_ccmx (it8, writer, error);
 		break;
 	case CD_IT8_KIND_CMF:
-		ret = cd_it8_save_to_file_cmf (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		ret = cd_it8_save_to_file_cmf (it8, writer, error);
 		break;
 	case CD_IT8_KIND_CCSS:
 	case CD_IT8_KIND_SPECT:
-		ret = cd_it8_save_to_file_ccss_sp (it8, it8_lcms, error);
-		if (!ret)
-			goto out;
+		ret = cd_it8_save_to_file_ccss_sp (it8, writer, error);
 		break;
 	default:
 		break;
 	}
+	if (!ret)
+		return FALSE;
 
-	/* save any options */
-	for (i = 0; i < priv->options->len; i++) {
-		tmp = g_ptr_array_index (priv->options, i);
-		cmsIT8SetPropertyStr (it8_lcms, tmp, "YES");
-	}
+	/* write the rest of the file */
+	return cd_it8_writer_finish (writer, error);
+}
 
-	/* write the file */
-	ret = cmsIT8SaveToMem (it8_lcms, NULL, &size_tmp);
-	g_assert (ret);
-	data_tmp = g_malloc (size_tmp);
-	ret = cmsIT8SaveToMem (it8_lcms, data_tmp, &size_tmp);
-	g_assert (ret);
+/**
+ * cd_it8_save_to_data:
+ * @it8: a #CdIt8 instance.
+ * @data: (array length=size): a pointer to returned data
+ * @size: size of @data
+ * @error: a #GError, or %NULL
+ *
+ * Saves a it8 file to an area of memory.
+ *
+ * Return value: %TRUE if it8 file was saved.
+ *
+ * Since: 0.1.26
+ **/
+gboolean
+cd_it8_save_to_data (CdIt8 *it8,
+		     gchar **data,
+		     gsize *size,
+		     GError **error)
+{
+	gsize size_tmp;
+	g_autoptr(GOutputStream) stream = NULL;
+
+	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
+
+	stream = g_memory_output_stream_new_resizable ();
+	if (!cd_it8_save_to_stream (it8, stream, NULL, error))
+		return FALSE;
+
+	/* NUL terminate for the caller */
+	if (!g_output_stream_write_all (stream, "", 1, NULL, NULL, error))
+		return FALSE;
+	if (!g_output_stream_close (stream, NULL, error))
+		return FALSE;
+	size_tmp = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream));
 
 	/* save for caller */
 	if (data != NULL)
-		*data = g_strdup (data_tmp);
-
-	/* LCMS allocates an extra byte for the '\0' byte */
+		*data = g_memory_output_stream_steal_data (G_MEMORY_OUTPUT_STREAM (stream));
 	if (size != NULL)
 		*size = size_tmp - 1;
-out:
-	if (it8_lcms != NULL)
-		cmsIT8Free (it8_lcms);
-	if (datetime != NULL)
-		g_date_time_unref (datetime);
-	return ret;
+	return TRUE;
 }
 
 /**
@@ -1474,20 +1831,25 @@ out:
 gboolean
 cd_it8_save_to_file (CdIt8 *it8, GFile *file, GError **error)
 {
-	gsize size = 0;
-	g_autofree gchar *data = NULL;
+	g_autoptr(GFileOutputStream) stream = NULL;
 
 	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
 	g_return_val_if_fail (G_IS_FILE (file), FALSE);
 
-	/* get data */
-	if (!cd_it8_save_to_data (it8, &data, &size, error))
+	/* write directly to the file */
+	stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+				 NULL, error);
+	if (stream == NULL)
 		return FALSE;
+	if (!cd_it8_save_to_stream (it8, G_OUTPUT_STREAM (stream), NULL, error)) {
+		g_autoptr(GCancellable) cancellable = g_cancellable_new ();
 
-	/* save file */
-	return g_file_replace_contents (file, data, size, NULL,
-					FALSE, G_FILE_CREATE_NONE,
-					NULL, NULL, error);
+		/* closing cancelled leaves any existing file untouched */
+		g_cancellable_cancel (cancellable);
+		g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, NULL);
+		return FALSE;
+	}
+	return g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error);
 }
 
 /**
@@ -1651,28 +2013,25 @@ void
 cd_it8_add_data (CdIt8 *it8, const CdColorRGB *rgb, const CdColorXYZ *xyz)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	CdColorRGB *rgb_tmp;
-	CdColorXYZ *xyz_tmp;
+	CdColorRGB rgb_tmp;
+	CdColorXYZ xyz_tmp;
 
 	g_return_if_fail (CD_IS_IT8 (it8));
 
 	/* add RGB */
-	if (rgb != NULL) {
-		rgb_tmp = cd_color_rgb_dup (rgb);
-	} else {
-		rgb_tmp = cd_color_rgb_new ();
-		cd_color_rgb_set (rgb_tmp, 0.0f, 0.0f, 0.0f);
-	}
-	g_ptr_array_add (priv->array_rgb, rgb_tmp);
+	if (rgb != NULL)
+		cd_color_rgb_copy (rgb, &rgb_tmp);
+	else
+		cd_color_rgb_set (&rgb_tmp, 0.0f, 0.0f, 0.0f);
+	g_array_append_val (priv->array_rgb, rgb_tmp);
 
 	/* add XYZ */
-	if (xyz != NULL) {
-		xyz_tmp = cd_color_xyz_dup (xyz);
-	} else {
-		xyz_tmp = cd_color_xyz_new ();
-		cd_color_xyz_set (xyz_tmp, 0.0f, 0.0f, 0.0f);
-	}
-	g_ptr_array_add (priv->array_xyz, xyz_tmp);
+	if (xyz != NULL)
+		cd_color_xyz_copy (xyz, &xyz_tmp);
+	else
+		cd_color_xyz_set (&xyz_tmp, 0.0f, 0.0f, 0.0f);
+	g_array_append_val (priv->array_xyz, xyz_tmp);
+	cd_it8_index_invalidate (it8);
 }
 
 /**
@@ -1716,19 +2075,77 @@ cd_it8_get_data_item (CdIt8 *it8, guint idx, CdColorRGB *rgb, CdColorXYZ *xyz)
 
 	g_return_val_if_fail (CD_IS_IT8 (it8), FALSE);
 
-	if (idx > priv->array_xyz->len)
+	if (idx >= priv->array_xyz->len)
 		return FALSE;
 	if (rgb != NULL) {
-		rgb_tmp = g_ptr_array_index (priv->array_rgb, idx);
+		rgb_tmp = &g_array_index (priv->array_rgb, CdColorRGB, idx);
 		cd_color_rgb_copy (rgb_tmp, rgb);
 	}
 	if (xyz != NULL) {
-		xyz_tmp = g_ptr_array_index (priv->array_xyz, idx);
+		xyz_tmp = &g_array_index (priv->array_xyz, CdColorXYZ, idx);
 		cd_color_xyz_copy (xyz_tmp, xyz);
 	}
 	return TRUE;
 }
 
+/**
+ * cd_it8_get_data_rgb:
+ * @it8: a #CdIt8 instance.
+ * @size: (out) (allow-none): the number of readings, or %NULL
+ *
+ * Gets all the RGB values without copying them. The values are stored as
+ * consecutive R, G, B triplets, one for each reading, in the same order
+ * as cd_it8_get_data_item().
+ *
+ * The returned data is only valid until the readings are next changed.
+ *
+ * Return value: (transfer none): the RGB values, or %NULL if empty
+ *
+ * Since: 1.4.10
+ **/
+const gdouble *
+cd_it8_get_data_rgb (CdIt8 *it8, guint *size)
+{
+	CdIt8Private *priv = GET_PRIVATE (it8);
+
+	g_return_val_if_fail (CD_IS_IT8 (it8), NULL);
+
+	if (size != NULL)
+		*size = priv->array_rgb->len;
+	if (priv->array_rgb->len == 0)
+		return NULL;
+	return &g_array_index (priv->array_rgb, CdColorRGB, 0).R;
+}
+
+/**
+ * cd_it8_get_data_xyz:
+ * @it8: a #CdIt8 instance.
+ * @size: (out) (allow-none): the number of readings, or %NULL
+ *
+ * Gets all the XYZ values without copying them. The values are stored as
+ * consecutive X, Y, Z triplets, one for each reading, in the same order
+ * as cd_it8_get_data_item().
+ *
+ * The returned data is only valid until the readings are next changed.
+ *
+ * Return value: (transfer none): the XYZ values, or %NULL if empty
+ *
+ * Since: 1.4.10
+ **/
+const gdouble *
+cd_it8_get_data_xyz (CdIt8 *it8, guint *size)
+{
+	CdIt8Private *priv = GET_PRIVATE (it8);
+
+	g_return_val_if_fail (CD_IS_IT8 (it8), NULL);
+
+	if (size != NULL)
+		*size = priv->array_xyz->len;
+	if (priv->array_xyz->len == 0)
+		return NULL;
+	return &g_array_index (priv->array_xyz, CdColorXYZ, 0).X;
+}
+
 /**
  * cd_it8_get_xyz_for_rgb:
  * @it8: a #CdIt8 instance.
@@ -1737,7 +2154,13 @@ cd_it8_get_data_item (CdIt8 *it8, guint idx, CdColorRGB *rgb, CdColorXYZ *xyz)
  * @B: the blue value
  * @delta: the smallest difference between colors, e.g. 0.01f
  *
- * Gets the XYZ value for a specific RGB value.
+ * Gets the XYZ value for a specific RGB value. If more than one reading
+ * matches then the first one is returned.
+ *
+ * An index of the readings is built on the first call, which makes
+ * subsequent lookups fast even for large charts.
+ *
+ * The returned value is only valid until the readings are next changed.
  *
  * Return value: (transfer none): A CdColorXYZ, or %NULL if the sample does not exist.
  *
@@ -1747,24 +2170,58 @@ CdColorXYZ *
 cd_it8_get_xyz_for_rgb (CdIt8 *it8, gdouble R, gdouble G, gdouble B, gdouble delta)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	CdColorXYZ *xyz_tmp;
-	guint i;
-	const CdColorRGB *rgb_tmp;
+	CdColorRGB hi;
+	CdColorRGB lo;
+	guint best = G_MAXUINT;
+	guint lo_cell[3];
+	guint hi_cell[3];
+	guint r, g, b;
 
 	g_return_val_if_fail (CD_IS_IT8 (it8), NULL);
 
-	for (i = 0; i < priv->array_xyz->len; i++) {
-		rgb_tmp = g_ptr_array_index (priv->array_rgb, i);
-		if (ABS (rgb_tmp->R - R) > delta)
-			continue;
-		if (ABS (rgb_tmp->G - G) > delta)
-			continue;
-		if (ABS (rgb_tmp->B - B) > delta)
-			continue;
-		xyz_tmp = g_ptr_array_index (priv->array_xyz, i);
-		return xyz_tmp;
+	if (priv->array_xyz->len == 0)
+		return NULL;
+	if (priv->index_size == 0)
+		cd_it8_index_build (it8);
+
+	/* only check the cells that overlap the search box */
+	cd_color_rgb_set (&lo, R - delta, G - delta, B - delta);
+	cd_color_rgb_set (&hi, R + delta, G + delta, B + delta);
+	lo_cell[0] = cd_it8_index_get_cell (priv, 0, lo.R);
+	lo_cell[1] = cd_it8_index_get_cell (priv, 1, lo.G);
+	lo_cell[2] = cd_it8_index_get_cell (priv, 2, lo.B);
+	hi_cell[0] = cd_it8_index_get_cell (priv, 0, hi.R);
+	hi_cell[1] = cd_it8_index_get_cell (priv, 1, hi.G);
+	hi_cell[2] = cd_it8_index_get_cell (priv, 2, hi.B);
+	for (r = lo_cell[0]; r <= hi_cell[0]; r++) {
+		for (g = lo_cell[1]; g <= hi_cell[1]; g++) {
+			for (b = lo_cell[2]; b <= hi_cell[2]; b++) {
+				guint cell = (r * priv->index_size + g) * priv->index_size + b;
+				guint i;
+				for (i = priv->index_offsets[cell];
+				     i < priv->index_offsets[cell + 1]; i++) {
+					guint idx = priv->index_patches[i];
+					const CdColorRGB *rgb_tmp;
+
+					/* the cell is in order, so nothing later is better */
+					if (idx >= best)
+						break;
+					rgb_tmp = &g_array_index (priv->array_rgb, CdColorRGB, idx);
+					if (ABS (rgb_tmp->R - R) > delta)
+						continue;
+					if (ABS (rgb_tmp->G - G) > delta)
+						continue;
+					if (ABS (rgb_tmp->B - B) > delta)
+						continue;
+					best = idx;
+					break;
+				}
+			}
+		}
 	}
-	return NULL;
+	if (best == G_MAXUINT)
+		return NULL;
+	return &g_array_index (priv->array_xyz, CdColorXYZ, best);
 }
 
 /**
@@ -2038,11 +2495,11 @@ static void
 cd_it8_init (CdIt8 *it8)
 {
 	CdIt8Private *priv = GET_PRIVATE (it8);
-	priv->context_lcms = cd_context_lcms_new ();
+	priv->context_lcms = cd_context_lcms_get_shared ();
 
 	cd_mat33_clear (&priv->matrix);
-	priv->array_rgb = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_rgb_free);
-	priv->array_xyz = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_xyz_free);
+	priv->array_rgb = g_array_new (FALSE, FALSE, sizeof (CdColorRGB));
+	priv->array_xyz = g_array_new (FALSE, FALSE, sizeof (CdColorXYZ));
 	priv->array_spectra = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_spectrum_free);
 	priv->options = g_ptr_array_new_with_free_func (g_free);
 	priv->enable_created = TRUE;
@@ -2064,8 +2521,10 @@ cd_it8_finalize (GObject *object)
 
 	cd_context_lcms_free (priv->context_lcms);
 	g_ptr_array_unref (priv->array_spectra);
-	g_ptr_array_unref (priv->array_rgb);
-	g_ptr_array_unref (priv->array_xyz);
+	g_array_unref (priv->array_rgb);
+	g_array_unref (priv->array_xyz);
+	g_free (priv->index_offsets);
+	g_free (priv->index_patches);
 	g_ptr_array_unref (priv->options);
 	g_free (priv->originator);
 	g_free (priv->title);
@@ -112,6 +112,11 @@ gboolean	 cd_it8_save_to_data		(CdIt8		*it8,
 						 gsize		*size,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_it8_save_to_stream		(CdIt8		*it8,
+						 GOutputStream	*stream,
+						 GCancellable	*cancellable,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 
 /* setters */
 void		 cd_it8_set_kind		(CdIt8		*it8,
@@ -157,6 +162,10 @@ gboolean	 cd_it8_get_data_item		(CdIt8		*it8,
 						 guint		 idx,
 						 CdColorRGB	*rgb,
 						 CdColorXYZ	*xyz);
+const gdouble	*cd_it8_get_data_rgb		(CdIt8		*it8,
+						 guint		*size);
+const gdouble	*cd_it8_get_data_xyz		(CdIt8		*it8,
+						 guint		*size);
 GPtrArray	*cd_it8_get_spectrum_array	(CdIt8		*it8);
 CdSpectrum	*cd_it8_get_spectrum_by_id	(CdIt8		*it8,
 						 const gchar	*id);
@@ -346,6 +346,38 @@ cd_mat33_vector_multiply (const CdMat3x3 *mat_src, const CdVec3 *vec_src, CdVec3
 		       mat_src->m22 * vec_src->v2;
 }
 
+/**
+ * cd_mat33_vector_multiply_many:
+ * @mat_src: the matrix source
+ * @vec_src: (array length=len): the vector sources
+ * @vec_dest: (array length=len): the destination vectors
+ * @len: the number of vectors
+ *
+ * Multiplies a matrix with each vector in an array, for instance to apply a
+ * correction matrix to a stream of readings.
+ * The arguments @vec_src and @vec_dest can be the same value.
+ **/
+void
+cd_mat33_vector_multiply_many (const CdMat3x3 *mat_src,
+			       const CdVec3 *vec_src,
+			       CdVec3 *vec_dest,
+			       guint len)
+{
+	const gdouble m00 = mat_src->m00, m01 = mat_src->m01, m02 = mat_src->m02;
+	const gdouble m10 = mat_src->m10, m11 = mat_src->m11, m12 = mat_src->m12;
+	const gdouble m20 = mat_src->m20, m21 = mat_src->m21, m22 = mat_src->m22;
+	guint i;
+
+	for (i = 0; i < len; i++) {
+		gdouble v0 = vec_src[i].v0;
+		gdouble v1 = vec_src[i].v1;
+		gdouble v2 = vec_src[i].v2;
+		vec_dest[i].v0 = m00 * v0 + m01 * v1 + m02 * v2;
+		vec_dest[i].v1 = m10 * v0 + m11 * v1 + m12 * v2;
+		vec_dest[i].v2 = m20 * v0 + m21 * v1 + m22 * v2;
+	}
+}
+
 /**
  * cd_mat33_scalar_multiply:
  * @mat_src: the source
@@ -382,21 +414,20 @@ cd_mat33_scalar_multiply (const CdMat3x3 *mat_src,
 void
 cd_mat33_matrix_multiply (const CdMat3x3 *mat_src1, const CdMat3x3 *mat_src2, CdMat3x3 *mat_dest)
 {
-	guint8 i, j, k;
-	gdouble *src1 = cd_mat33_get_data (mat_src1);
-	gdouble *src2 = cd_mat33_get_data (mat_src2);
-	gdouble *dest = cd_mat33_get_data (mat_dest);
+	const CdMat3x3 *a = mat_src1;
+	const CdMat3x3 *b = mat_src2;
 	g_return_if_fail (mat_src1 != mat_dest);
 	g_return_if_fail (mat_src2 != mat_dest);
 
-	cd_mat33_clear (mat_dest);
-	for (i = 0; i < 3; i++) {
-		for (j = 0; j < 3; j++) {
-			for (k = 0; k < 3; k++) {
-				dest[3 * i + j] += src1[i * 3 + k] * src2[k * 3 + j];
-			}
-		}
-	}
+	mat_dest->m00 = a->m00 * b->m00 + a->m01 * b->m10 + a->m02 * b->m20;
+	mat_dest->m01 = a->m00 * b->m01 + a->m01 * b->m11 + a->m02 * b->m21;
+	mat_dest->m02 = a->m00 * b->m02 + a->m01 * b->m12 + a->m02 * b->m22;
+	mat_dest->m10 = a->m10 * b->m00 + a->m11 * b->m10 + a->m12 * b->m20;
+	mat_dest->m11 = a->m10 * b->m01 + a->m11 * b->m11 + a->m12 * b->m21;
+	mat_dest->m12 = a->m10 * b->m02 + a->m11 * b->m12 + a->m12 * b->m22;
+	mat_dest->m20 = a->m20 * b->m00 + a->m21 * b->m10 + a->m22 * b->m20;
+	mat_dest->m21 = a->m20 * b->m01 + a->m21 * b->m11 + a->m22 * b->m21;
+	mat_dest->m22 = a->m20 * b->m02 + a->m21 * b->m12 + a->m22 * b->m22;
 }
 
 /**
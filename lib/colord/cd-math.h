@@ -77,6 +77,10 @@ void		 cd_mat33_scalar_multiply	(const CdMat3x3		*mat_src,
 void		 cd_mat33_vector_multiply	(const CdMat3x3		*mat_src,
 						 const CdVec3		*vec_src,
 						 CdVec3			*vec_dest);
+void		 cd_mat33_vector_multiply_many	(const CdMat3x3		*mat_src,
+						 const CdVec3		*vec_src,
+						 CdVec3			*vec_dest,
+						 guint			 len);
 void		 cd_mat33_matrix_multiply	(const CdMat3x3		*mat_src1,
 						 const CdMat3x3		*mat_src2,
 						 CdMat3x3		*mat_dest);
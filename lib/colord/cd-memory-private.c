@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "cd-memory-private.h"
+
+/*
+ * cd_memory_get_hash_table_size:
+ *
+ * Estimates the heap used by a table of string keys and values. Strings
+ * shared between tables are counted once for every table that holds them,
+ * so the total is an upper bound.
+ */
+gsize
+cd_memory_get_hash_table_size (GHashTable *hash)
+{
+	GHashTableIter iter;
+	const gchar *key;
+	const gchar *value;
+	gsize size = g_hash_table_size (hash) * 3 * sizeof (gpointer);
+
+	g_hash_table_iter_init (&iter, hash);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &value)) {
+		size += strlen (key) + 1;
+		if (value != NULL)
+			size += strlen (value) + 1;
+	}
+	return size;
+}
@@ -0,0 +1,53 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (CD_COMPILATION)
+#error "You cannot include this file externaly"
+#endif
+
+#ifndef __CD_PROFILE_PRIVATE_H
+#define __CD_PROFILE_PRIVATE_H
+
+#include <gio/gio.h>
+
+#include "cd-profile.h"
+
+G_BEGIN_DECLS
+
+gboolean	 cd_profile_connect_from_properties	(CdProfile	*profile,
+							 GDBusConnection *connection,
+							 const gchar	*name_owner,
+							 GVariant	*properties,
+							 GError		**error);
+gboolean	 cd_profile_connect_shared		(CdProfile	*profile,
+							 GDBusConnection *connection,
+							 const gchar	*name_owner,
+							 GVariant	*properties,
+							 GError		**error);
+void		 cd_profile_shared_properties_changed	(CdProfile	*profile,
+							 GVariant	*changed_properties);
+void		 cd_profile_shared_signal		(CdProfile	*profile,
+							 const gchar	*signal_name,
+							 GVariant	*parameters);
+
+G_END_DECLS
+
+#endif /* __CD_PROFILE_PRIVATE_H */
@@ -37,11 +37,12 @@
 
 #include "cd-profile.h"
 #include "cd-profile-sync.h"
+#include "cd-sync-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainLoop	*loop;
+	gboolean	 done;
 	gboolean	 ret;
 	CdProfile	*profile;
 } CdProfileHelper;
@@ -54,7 +55,7 @@ cd_profile_connect_finish_sync (CdProfile *profile,
 	helper->ret = cd_profile_connect_finish (profile,
 						 res,
 						 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -78,20 +79,21 @@ cd_profile_connect_sync (CdProfile *profile,
 			 GError **error)
 {
 	CdProfileHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdProfileHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = g_main_context_ref_thread_default ();
 	helper.error = error;
 
 	/* run async method */
 	cd_profile_connect (profile, cancellable,
 			    (GAsyncReadyCallback) cd_profile_connect_finish_sync,
 			    &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
 
 	return helper.ret;
 }
@@ -106,7 +108,7 @@ cd_profile_set_property_finish_sync (CdProfile *profile,
 	helper->ret = cd_profile_set_property_finish (profile,
 						 res,
 						 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -134,20 +136,21 @@ cd_profile_set_property_sync (CdProfile *profile,
 			      GError **error)
 {
 	CdProfileHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdProfileHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_profile_set_property (profile, key, value, cancellable,
 				 (GAsyncReadyCallback) cd_profile_set_property_finish_sync,
 				 &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -162,7 +165,7 @@ cd_profile_install_system_wide_finish_sync (CdProfile *profile,
 	helper->ret = cd_profile_install_system_wide_finish (profile,
 						 res,
 						 helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -186,20 +189,21 @@ cd_profile_install_system_wide_sync (CdProfile *profile,
 				     GError **error)
 {
 	CdProfileHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdProfileHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_profile_install_system_wide (profile, cancellable,
 					(GAsyncReadyCallback) cd_profile_install_system_wide_finish_sync,
 					&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -38,6 +38,7 @@
 #include <string.h>
 
 #include "cd-profile.h"
+#include "cd-profile-private.h"
 
 static void	cd_profile_class_init	(CdProfileClass	*klass);
 static void	cd_profile_init		(CdProfile	*profile);
@@ -62,6 +63,8 @@ typedef struct
 	gchar			*format;
 	gchar			*title;
 	GDBusProxy		*proxy;
+	GDBusConnection		*connection;	/* shared mode */
+	gchar			*name_owner;
 	CdProfileKind		 kind;
 	CdColorspace		 colorspace;
 	CdObjectScope		 scope;
@@ -151,7 +154,7 @@ cd_profile_get_id (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->id;
 }
 
@@ -170,7 +173,7 @@ cd_profile_get_filename (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->filename;
 }
 
@@ -190,7 +193,7 @@ cd_profile_has_access (CdProfile *profile)
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 
 	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
-	g_return_val_if_fail (priv->proxy != NULL, FALSE);
+	g_return_val_if_fail (cd_profile_get_connected (profile), FALSE);
 
 	/* virtual profile */
 	if (priv->filename == NULL)
@@ -215,7 +218,7 @@ cd_profile_get_qualifier (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->qualifier;
 }
 
@@ -234,7 +237,7 @@ cd_profile_get_format (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->format;
 }
 
@@ -253,7 +256,7 @@ cd_profile_get_title (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->title;
 }
 
@@ -272,7 +275,7 @@ cd_profile_get_kind (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), CD_PROFILE_KIND_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_PROFILE_KIND_UNKNOWN);
+	g_return_val_if_fail (cd_profile_get_connected (profile), CD_PROFILE_KIND_UNKNOWN);
 	return priv->kind;
 }
 
@@ -291,7 +294,7 @@ cd_profile_get_scope (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), CD_OBJECT_SCOPE_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_OBJECT_SCOPE_UNKNOWN);
+	g_return_val_if_fail (cd_profile_get_connected (profile), CD_OBJECT_SCOPE_UNKNOWN);
 	return priv->scope;
 }
 
@@ -310,7 +313,7 @@ cd_profile_get_owner (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), G_MAXUINT);
-	g_return_val_if_fail (priv->proxy != NULL, G_MAXUINT);
+	g_return_val_if_fail (cd_profile_get_connected (profile), G_MAXUINT);
 	return priv->owner;
 }
 
@@ -329,7 +332,7 @@ cd_profile_get_warnings (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return priv->warnings;
 }
 
@@ -348,7 +351,7 @@ cd_profile_get_created (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), 0);
-	g_return_val_if_fail (priv->proxy != NULL, 0);
+	g_return_val_if_fail (cd_profile_get_connected (profile), 0);
 	return priv->created;
 }
 
@@ -368,7 +371,7 @@ cd_profile_get_age (CdProfile *profile)
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 
 	g_return_val_if_fail (CD_IS_PROFILE (profile), 0);
-	g_return_val_if_fail (priv->proxy != NULL, 0);
+	g_return_val_if_fail (cd_profile_get_connected (profile), 0);
 
 	if (priv->created == 0)
 		return 0;
@@ -390,7 +393,7 @@ cd_profile_get_colorspace (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), CD_COLORSPACE_UNKNOWN);
-	g_return_val_if_fail (priv->proxy != NULL, CD_COLORSPACE_UNKNOWN);
+	g_return_val_if_fail (cd_profile_get_connected (profile), CD_COLORSPACE_UNKNOWN);
 	return priv->colorspace;
 }
 
@@ -409,7 +412,7 @@ cd_profile_get_has_vcgt (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
-	g_return_val_if_fail (priv->proxy != NULL, FALSE);
+	g_return_val_if_fail (cd_profile_get_connected (profile), FALSE);
 	return priv->has_vcgt;
 }
 
@@ -429,7 +432,7 @@ cd_profile_get_is_system_wide (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
-	g_return_val_if_fail (priv->proxy != NULL, FALSE);
+	g_return_val_if_fail (cd_profile_get_connected (profile), FALSE);
 	return priv->is_system_wide;
 }
 
@@ -449,7 +452,7 @@ cd_profile_get_metadata (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return g_hash_table_ref (priv->metadata);
 }
 
@@ -469,7 +472,7 @@ cd_profile_get_metadata_item (CdProfile *profile, const gchar *key)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
-	g_return_val_if_fail (priv->proxy != NULL, NULL);
+	g_return_val_if_fail (cd_profile_get_connected (profile), NULL);
 	return g_hash_table_lookup (priv->metadata, key);
 }
 
@@ -782,6 +785,245 @@ cd_profile_connect_cb (GObject *source_object,
 	g_task_return_boolean (task, TRUE);
 }
 
+typedef struct {
+	gchar			*method_name;
+	GVariant		*parameters;
+	GAsyncReadyCallback	 callback;
+	GTask			*task;
+} CdProfileCallHelper;
+
+static void
+cd_profile_call_helper_free (CdProfileCallHelper *helper)
+{
+	if (helper->parameters != NULL)
+		g_variant_unref (helper->parameters);
+	if (helper->task != NULL)
+		g_object_unref (helper->task);
+	g_free (helper->method_name);
+	g_free (helper);
+}
+
+static void
+cd_profile_call_proxy_cb (GObject *source_object,
+			  GAsyncResult *res,
+			  gpointer user_data)
+{
+	CdProfileCallHelper *helper = (CdProfileCallHelper *) user_data;
+	CdProfile *profile = CD_PROFILE (g_task_get_source_object (helper->task));
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_autoptr(GDBusProxy) proxy = NULL;
+	g_autoptr(GError) error = NULL;
+
+	proxy = g_dbus_proxy_new_finish (res, &error);
+	if (proxy == NULL) {
+		g_task_return_new_error (helper->task,
+					 CD_PROFILE_ERROR,
+					 CD_PROFILE_ERROR_INTERNAL,
+					 "failed to create proxy for %s: %s",
+					 priv->object_path, error->message);
+		cd_profile_call_helper_free (helper);
+		return;
+	}
+
+	/* another call may have created one first */
+	if (priv->proxy == NULL)
+		priv->proxy = g_steal_pointer (&proxy);
+	g_dbus_proxy_call (priv->proxy,
+			   helper->method_name,
+			   helper->parameters,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   g_task_get_cancellable (helper->task),
+			   helper->callback,
+			   g_steal_pointer (&helper->task));
+	cd_profile_call_helper_free (helper);
+}
+
+/*
+ * cd_profile_call:
+ *
+ * Calls a method on the profile, taking ownership of @task. Objects connected
+ * in shared mode only create a proxy on first use, and it never loads
+ * properties or subscribes to signals as the #CdClient dispatches those for
+ * all objects.
+ */
+static void
+cd_profile_call (CdProfile *profile,
+		 const gchar *method_name,
+		 GVariant *parameters,
+		 GCancellable *cancellable,
+		 GAsyncReadyCallback callback,
+		 GTask *task)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	CdProfileCallHelper *helper;
+
+	if (priv->proxy != NULL) {
+		g_dbus_proxy_call (priv->proxy,
+				   method_name,
+				   parameters,
+				   G_DBUS_CALL_FLAGS_NONE,
+				   -1,
+				   cancellable,
+				   callback,
+				   task);
+		return;
+	}
+	helper = g_new0 (CdProfileCallHelper, 1);
+	helper->method_name = g_strdup (method_name);
+	if (parameters != NULL)
+		helper->parameters = g_variant_ref_sink (parameters);
+	helper->callback = callback;
+	helper->task = task;
+	g_dbus_proxy_new (priv->connection,
+			  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+			  G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+			  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+			  NULL,
+			  priv->name_owner,
+			  priv->object_path,
+			  COLORD_DBUS_INTERFACE_PROFILE,
+			  cancellable,
+			  cd_profile_call_proxy_cb,
+			  helper);
+}
+
+/*
+ * cd_profile_connect_shared:
+ *
+ * Like cd_profile_connect_from_properties() but without creating a proxy or
+ * adding any match rules; the caller is expected to forward property changes
+ * and signals using cd_profile_shared_properties_changed() and
+ * cd_profile_shared_signal().
+ */
+gboolean
+cd_profile_connect_shared (CdProfile *profile,
+			 GDBusConnection *connection,
+			 const gchar *name_owner,
+			 GVariant *properties,
+			 GError **error)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_autoptr(GVariant) id = NULL;
+
+	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
+
+	/* already connected */
+	if (cd_profile_get_connected (profile))
+		return TRUE;
+
+	/* if the profile is missing, then fail */
+	id = g_variant_lookup_value (properties, CD_PROFILE_PROPERTY_ID, NULL);
+	if (id == NULL) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "Failed to connect to missing profile %s",
+			     cd_profile_get_object_path (profile));
+		return FALSE;
+	}
+	priv->connection = g_object_ref (connection);
+	priv->name_owner = g_strdup (name_owner);
+	cd_profile_dbus_properties_changed_cb (NULL, properties, NULL, profile);
+	return TRUE;
+}
+
+/*
+ * cd_profile_shared_properties_changed:
+ */
+void
+cd_profile_shared_properties_changed (CdProfile *profile, GVariant *changed_properties)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_return_if_fail (CD_IS_PROFILE (profile));
+	if (priv->connection == NULL)
+		return;
+	cd_profile_dbus_properties_changed_cb (NULL, changed_properties, NULL, profile);
+}
+
+/*
+ * cd_profile_shared_signal:
+ */
+void
+cd_profile_shared_signal (CdProfile *profile,
+			const gchar *signal_name,
+			GVariant *parameters)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_return_if_fail (CD_IS_PROFILE (profile));
+	if (priv->connection == NULL)
+		return;
+	cd_profile_dbus_signal_cb (NULL, NULL, (gchar *) signal_name, parameters, profile);
+}
+
+/*
+ * cd_profile_connect_from_properties:
+ *
+ * Connects to the object using properties that were already fetched, for
+ * instance by cd_client_get_snapshot(). Using the unique name of the daemon
+ * and not loading the properties means no method calls are made.
+ */
+gboolean
+cd_profile_connect_from_properties (CdProfile *profile,
+				    GDBusConnection *connection,
+				    const gchar *name_owner,
+				    GVariant *properties,
+				    GError **error)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GVariant) id = NULL;
+
+	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
+
+	/* already connected */
+	if (cd_profile_get_connected (profile))
+		return TRUE;
+
+	/* if the profile is missing, then fail */
+	id = g_variant_lookup_value (properties, CD_PROFILE_PROPERTY_ID, NULL);
+	if (id == NULL) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "Failed to connect to missing profile %s",
+			     cd_profile_get_object_path (profile));
+		return FALSE;
+	}
+
+	priv->proxy = g_dbus_proxy_new_sync (connection,
+					     G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+					     NULL,
+					     name_owner,
+					     priv->object_path,
+					     COLORD_DBUS_INTERFACE_PROFILE,
+					     NULL,
+					     &error_local);
+	if (priv->proxy == NULL) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "Failed to connect to profile %s: %s",
+			     cd_profile_get_object_path (profile),
+			     error_local->message);
+		return FALSE;
+	}
+	cd_profile_dbus_properties_changed_cb (priv->proxy, properties, NULL, profile);
+
+	/* get signals from DBus */
+	g_signal_connect_object (priv->proxy,
+				 "g-signal",
+				 G_CALLBACK (cd_profile_dbus_signal_cb),
+				 profile, 0);
+
+	/* watch if any remote properties change */
+	g_signal_connect_object (priv->proxy,
+				 "g-properties-changed",
+				 G_CALLBACK (cd_profile_dbus_properties_changed_cb),
+				 profile, 0);
+	return TRUE;
+}
+
 /**
  * cd_profile_connect:
  * @profile: a #CdProfile instance.
@@ -808,7 +1050,7 @@ cd_profile_connect (CdProfile *profile,
 	task = g_task_new (profile, cancellable, callback, user_data);
 
 	/* already connected */
-	if (priv->proxy != NULL) {
+	if (cd_profile_get_connected (profile)) {
 		g_task_return_boolean (task, TRUE);
 		return;
 	}
@@ -893,26 +1135,23 @@ cd_profile_set_property (CdProfile *profile,
 			 GAsyncReadyCallback callback,
 			 gpointer user_data)
 {
-	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (key != NULL);
 	g_return_if_fail (value != NULL);
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_profile_get_connected (profile));
 
 	task = g_task_new (profile, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "SetProperty",
-			   g_variant_new ("(ss)",
-			   		  key,
-			   		  value),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_profile_set_property_cb,
-			   task);
+	cd_profile_call (profile,
+			 "SetProperty",
+			 g_variant_new ("(ss)",
+					key,
+					value),
+			 cancellable,
+			 cd_profile_set_property_cb,
+			 task);
 }
 
 /**********************************************************************/
@@ -978,22 +1217,19 @@ cd_profile_install_system_wide (CdProfile *profile,
 				GAsyncReadyCallback callback,
 				gpointer user_data)
 {
-	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	GTask *task = NULL;
 
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
-	g_return_if_fail (priv->proxy != NULL);
+	g_return_if_fail (cd_profile_get_connected (profile));
 
 	task = g_task_new (profile, cancellable, callback, user_data);
-	g_dbus_proxy_call (priv->proxy,
-			   "InstallSystemWide",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   -1,
-			   cancellable,
-			   cd_profile_install_system_wide_cb,
-			   task);
+	cd_profile_call (profile,
+			 "InstallSystemWide",
+			 NULL,
+			 cancellable,
+			 cd_profile_install_system_wide_cb,
+			 task);
 }
 
 /**********************************************************************/
@@ -1031,7 +1267,7 @@ cd_profile_get_connected (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
-	return priv->proxy != NULL;
+	return priv->proxy != NULL || priv->connection != NULL;
 }
 
 /**
@@ -1127,6 +1363,166 @@ cd_profile_load_icc (CdProfile *profile,
 	return g_object_ref (icc);
 }
 
+/* parsed profiles shared by the CdProfile objects used in one thread */
+#define CD_PROFILE_ICC_CACHE_SIZE	16
+#define CD_PROFILE_ICC_CACHE_ATTRIBUTES	G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+					G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+					G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+					G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+					G_FILE_ATTRIBUTE_UNIX_INODE
+
+typedef struct {
+	CdIcc			*icc;
+	CdIccLoadFlags		 flags;
+	gchar			*filename;
+	guint64			 mtime;		/* in microseconds */
+	guint64			 inode;
+	guint32			 device;
+	goffset			 size;
+} CdProfileIccCacheItem;
+
+static void
+cd_profile_icc_cache_item_free (CdProfileIccCacheItem *item)
+{
+	g_object_unref (item->icc);
+	g_free (item->filename);
+	g_free (item);
+}
+
+/* lazily decoded tags are not safe to share between threads */
+static GPrivate cd_profile_icc_cache = G_PRIVATE_INIT ((GDestroyNotify) g_hash_table_unref);
+
+static GHashTable *
+cd_profile_icc_cache_get (void)
+{
+	GHashTable *cache = g_private_get (&cd_profile_icc_cache);
+	if (cache == NULL) {
+		cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) cd_profile_icc_cache_item_free);
+		g_private_set (&cd_profile_icc_cache, cache);
+	}
+	return cache;
+}
+
+static gboolean
+cd_profile_icc_cache_stat (GFile *file,
+			   CdProfileIccCacheItem *item,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	g_autoptr(GFileInfo) info = NULL;
+
+	info = g_file_query_info (file, CD_PROFILE_ICC_CACHE_ATTRIBUTES,
+				  G_FILE_QUERY_INFO_NONE, cancellable, error);
+	if (info == NULL)
+		return FALSE;
+	item->size = g_file_info_get_size (info);
+	item->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		      g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	item->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	item->device = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+	return TRUE;
+}
+
+/**
+ * cd_profile_load_icc_shared:
+ * @profile: a #CdProfile instance.
+ * @flags: options for loading the profile
+ * @cancellable: A #GCancellable, or %NULL
+ * @error: A #GError or %NULL
+ *
+ * Loads a local ICC object from the abstract profile, like
+ * cd_profile_load_icc(), but reuses the object from an earlier call in the
+ * same thread if the file is unchanged and was parsed with at least @flags.
+ *
+ * The returned object is shared with other callers in the same thread and
+ * must not be modified. The file is read into memory rather than mapped,
+ * so a cached object does not keep the file open.
+ *
+ * Return value: (transfer full): A shared #CdIcc object, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdIcc *
+cd_profile_load_icc_shared (CdProfile *profile,
+			    CdIccLoadFlags flags,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	CdProfileIccCacheItem *item;
+	GHashTable *cache;
+	gsize len = 0;
+	g_autofree gchar *data = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GError) error_local = NULL;
+	CdProfileIccCacheItem stat_now = { NULL };
+
+	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
+
+	/* not a local profile */
+	if (priv->filename == NULL) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "%s has no local instance",
+			     priv->id);
+		return NULL;
+	}
+	file = g_file_new_for_path (priv->filename);
+	if (!cd_profile_icc_cache_stat (file, &stat_now, cancellable, &error_local)) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "failed to query %s: %s",
+			     priv->filename, error_local->message);
+		return NULL;
+	}
+
+	/* already parsed from the same file */
+	cache = cd_profile_icc_cache_get ();
+	item = g_hash_table_lookup (cache, priv->filename);
+	if (item != NULL) {
+		if (item->mtime == stat_now.mtime &&
+		    item->size == stat_now.size &&
+		    item->inode == stat_now.inode &&
+		    item->device == stat_now.device) {
+			if ((item->flags & flags) == flags)
+				return g_object_ref (item->icc);
+
+			/* keep anything parsed for earlier callers */
+			flags |= item->flags;
+		}
+		g_hash_table_remove (cache, priv->filename);
+	}
+
+	/* parse a private copy of the data */
+	if (!g_file_load_contents (file, cancellable, &data, &len, NULL, &error_local)) {
+		g_set_error (error,
+			     CD_PROFILE_ERROR,
+			     CD_PROFILE_ERROR_INTERNAL,
+			     "failed to load %s: %s",
+			     priv->filename, error_local->message);
+		return NULL;
+	}
+	icc = cd_icc_new ();
+	if (!cd_icc_load_data (icc, (const guint8 *) data, len, flags, error))
+		return NULL;
+	cd_icc_set_filename (icc, priv->filename);
+
+	/* add to the cache */
+	if (g_hash_table_size (cache) >= CD_PROFILE_ICC_CACHE_SIZE)
+		g_hash_table_remove_all (cache);
+	item = g_new0 (CdProfileIccCacheItem, 1);
+	*item = stat_now;
+	item->icc = g_object_ref (icc);
+	item->flags = flags;
+	item->filename = g_strdup (priv->filename);
+	g_hash_table_insert (cache, g_strdup (priv->filename), item);
+	return g_steal_pointer (&icc);
+}
+
 /*
  * _cd_profile_set_property:
  */
@@ -1161,7 +1557,7 @@ cd_profile_get_property (GObject *object, guint prop_id, GValue *value, GParamSp
 		g_value_set_string (value, priv->object_path);
 		break;
 	case PROP_CONNECTED:
-		g_value_set_boolean (value, priv->proxy != NULL);
+		g_value_set_boolean (value, cd_profile_get_connected (profile));
 		break;
 	case PROP_ID:
 		g_value_set_string (value, priv->id);
@@ -1477,6 +1873,9 @@ cd_profile_finalize (GObject *object)
 	g_free (priv->format);
 	g_free (priv->title);
 	g_strfreev (priv->warnings);
+	g_free (priv->name_owner);
+	if (priv->connection != NULL)
+		g_object_unref (priv->connection);
 	if (priv->proxy != NULL)
 		g_object_unref (priv->proxy);
 
@@ -122,6 +122,11 @@ CdIcc		*cd_profile_load_icc			(CdProfile	*profile,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+CdIcc		*cd_profile_load_icc_shared		(CdProfile	*profile,
+							 CdIccLoadFlags	 flags,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -37,14 +37,16 @@
 
 #include "cd-sensor.h"
 #include "cd-sensor-sync.h"
+#include "cd-sync-private.h"
 
 /* tiny helper to help us do the async operation */
 typedef struct {
 	GError		**error;
-	GMainLoop	*loop;
+	gboolean	 done;
 	gboolean	 ret;
 	CdColorXYZ	*sample;
 	CdSpectrum	*spectrum;
+	GPtrArray	*samples;
 } CdSensorHelper;
 
 static void
@@ -55,7 +57,7 @@ cd_sensor_connect_finish_sync (CdSensor *sensor,
 	helper->ret = cd_sensor_connect_finish (sensor,
 						res,
 						helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -79,20 +81,21 @@ cd_sensor_connect_sync (CdSensor *sensor,
 			GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = g_main_context_ref_thread_default ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_connect (sensor, cancellable,
 			   (GAsyncReadyCallback) cd_sensor_connect_finish_sync,
 			   &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
 
 	return helper.ret;
 }
@@ -107,7 +110,7 @@ cd_sensor_lock_finish_sync (CdSensor *sensor,
 	helper->ret = cd_sensor_lock_finish (sensor,
 					     res,
 					     helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -131,20 +134,21 @@ cd_sensor_lock_sync (CdSensor *sensor,
 		     GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_lock (sensor, cancellable,
 			(GAsyncReadyCallback) cd_sensor_lock_finish_sync,
 			&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -159,7 +163,7 @@ cd_sensor_unlock_finish_sync (CdSensor *sensor,
 	helper->ret = cd_sensor_unlock_finish (sensor,
 					       res,
 					       helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -183,20 +187,21 @@ cd_sensor_unlock_sync (CdSensor *sensor,
 		       GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_unlock (sensor, cancellable,
 			  (GAsyncReadyCallback) cd_sensor_unlock_finish_sync,
 			  &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -211,7 +216,7 @@ cd_sensor_set_options_finish_sync (CdSensor *sensor,
 	helper->ret = cd_sensor_set_options_finish (sensor,
 						    res,
 						    helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -237,20 +242,21 @@ cd_sensor_set_options_sync (CdSensor *sensor,
 			    GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_set_options (sensor, values, cancellable,
 			       (GAsyncReadyCallback) cd_sensor_set_options_finish_sync,
 			       &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.ret;
 }
@@ -265,7 +271,7 @@ cd_sensor_get_sample_finish_sync (CdSensor *sensor,
 	helper->sample = cd_sensor_get_sample_finish (sensor,
 						      res,
 						      helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -291,26 +297,92 @@ cd_sensor_get_sample_sync (CdSensor *sensor,
 			   GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_get_sample (sensor, cap, cancellable,
 			      (GAsyncReadyCallback) cd_sensor_get_sample_finish_sync,
 			      &helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.sample;
 }
 
 /**********************************************************************/
 
+static void
+cd_sensor_get_samples_finish_sync (CdSensor *sensor,
+				   GAsyncResult *res,
+				   CdSensorHelper *helper)
+{
+	helper->samples = cd_sensor_get_samples_finish (sensor,
+							res,
+							helper->error);
+	helper->done = TRUE;
+}
+
+/**
+ * cd_sensor_get_samples_sync:
+ * @sensor: a #CdSensor instance.
+ * @cap: The device capability, e.g. %CD_SENSOR_CAP_LCD.
+ * @start: when the first patch is shown, from g_get_monotonic_time()
+ * @count: the number of patches
+ * @period: how long each patch is shown for, in ms
+ * @settle: how long to wait after showing a patch before sampling it, in ms
+ * @cancellable: a #GCancellable or %NULL
+ * @error: a #GError, or %NULL.
+ *
+ * Gets a sample for each patch of a fixed schedule.
+ *
+ * WARNING: This function is synchronous, and may block.
+ * Do not use it in GUI applications.
+ *
+ * Return value: (element-type CdColorXYZ) (transfer container): the XYZ
+ * readings, or %NULL for error.
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_sensor_get_samples_sync (CdSensor *sensor,
+			    CdSensorCap cap,
+			    gint64 start,
+			    guint count,
+			    guint period,
+			    guint settle,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	CdSensorHelper helper;
+	GMainContext *context;
+
+	/* create temp object */
+	memset (&helper, 0, sizeof (CdSensorHelper));
+	context = cd_sync_context_push ();
+	helper.error = error;
+
+	/* run async method */
+	cd_sensor_get_samples (sensor, cap, start, count, period, settle,
+			       cancellable,
+			       (GAsyncReadyCallback) cd_sensor_get_samples_finish_sync,
+			       &helper);
+	cd_sync_context_run (context, &helper.done);
+
+	/* free temp object */
+	cd_sync_context_pop (context);
+
+	return helper.samples;
+}
+
+/**********************************************************************/
+
 static void
 cd_sensor_get_spectrum_finish_sync (CdSensor *sensor,
 				    GAsyncResult *res,
@@ -319,7 +391,7 @@ cd_sensor_get_spectrum_finish_sync (CdSensor *sensor,
 	helper->spectrum = cd_sensor_get_spectrum_finish (sensor,
 							  res,
 							  helper->error);
-	g_main_loop_quit (helper->loop);
+	helper->done = TRUE;
 }
 
 /**
@@ -345,20 +417,21 @@ cd_sensor_get_spectrum_sync (CdSensor *sensor,
 			   GError **error)
 {
 	CdSensorHelper helper;
+	GMainContext *context;
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (CdSensorHelper));
-	helper.loop = g_main_loop_new (NULL, FALSE);
+	context = cd_sync_context_push ();
 	helper.error = error;
 
 	/* run async method */
 	cd_sensor_get_spectrum (sensor, cap, cancellable,
 				(GAsyncReadyCallback) cd_sensor_get_spectrum_finish_sync,
 				&helper);
-	g_main_loop_run (helper.loop);
+	cd_sync_context_run (context, &helper.done);
 
 	/* free temp object */
-	g_main_loop_unref (helper.loop);
+	cd_sync_context_pop (context);
 
 	return helper.spectrum;
 }
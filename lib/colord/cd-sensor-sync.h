@@ -54,6 +54,15 @@ CdColorXYZ	*cd_sensor_get_sample_sync		(CdSensor	*sensor,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+GPtrArray	*cd_sensor_get_samples_sync		(CdSensor	*sensor,
+							 CdSensorCap	 cap,
+							 gint64		 start,
+							 guint		 count,
+							 guint		 period,
+							 guint		 settle,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 CdSpectrum	*cd_sensor_get_spectrum_sync		(CdSensor	*sensor,
 							 CdSensorCap	 cap,
 							 GCancellable	*cancellable,
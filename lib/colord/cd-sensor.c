@@ -1050,6 +1050,116 @@ cd_sensor_get_sample (CdSensor *sensor,
 
 /**********************************************************************/
 
+/**
+ * cd_sensor_get_samples_finish:
+ * @sensor: a #CdSensor instance.
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: (element-type CdColorXYZ) (transfer container): the XYZ
+ * readings, one for each patch, or %NULL
+ *
+ * Since: 1.4.10
+ **/
+GPtrArray *
+cd_sensor_get_samples_finish (CdSensor *sensor,
+			      GAsyncResult *res,
+			      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, sensor), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+cd_sensor_get_samples_cb (GObject *source_object,
+			  GAsyncResult *res,
+			  gpointer user_data)
+{
+	GPtrArray *samples;
+	CdColorXYZ *xyz;
+	GVariantIter iter;
+	gdouble x, y, z;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GVariant) result = NULL;
+	g_autoptr(GVariant) array = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object),
+					   res,
+					   &error);
+	if (result == NULL) {
+		cd_sensor_fixup_dbus_error (error);
+		g_task_return_error (task, error);
+		error = NULL;
+		return;
+	}
+
+	/* success */
+	samples = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_xyz_free);
+	array = g_variant_get_child_value (result, 0);
+	g_variant_iter_init (&iter, array);
+	while (g_variant_iter_next (&iter, "(ddd)", &x, &y, &z)) {
+		xyz = cd_color_xyz_new ();
+		cd_color_xyz_set (xyz, x, y, z);
+		g_ptr_array_add (samples, xyz);
+	}
+	g_task_return_pointer (task, samples, (GDestroyNotify) g_ptr_array_unref);
+}
+
+/**
+ * cd_sensor_get_samples:
+ * @sensor: a #CdSensor instance.
+ * @cap: a #CdSensorCap
+ * @start: when the first patch is shown, from g_get_monotonic_time()
+ * @count: the number of patches
+ * @period: how long each patch is shown for, in ms
+ * @settle: how long to wait after showing a patch before sampling it, in ms
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets a color sample for each patch of a fixed schedule. The caller
+ * shows patch n at @start plus n times @period, without waiting for the
+ * result, and the sensor samples each patch once it has settled.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_sensor_get_samples (CdSensor *sensor,
+		       CdSensorCap cap,
+		       gint64 start,
+		       guint count,
+		       guint period,
+		       guint settle,
+		       GCancellable *cancellable,
+		       GAsyncReadyCallback callback,
+		       gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	GTask *task = NULL;
+
+	g_return_if_fail (CD_IS_SENSOR (sensor));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_return_if_fail (priv->proxy != NULL);
+
+	/* the whole schedule has to fit in the call timeout */
+	task = g_task_new (sensor, cancellable, callback, user_data);
+	g_dbus_proxy_call (priv->proxy,
+			   "GetSamples",
+			   g_variant_new ("(sxuuu)",
+					  cd_sensor_cap_to_string (cap),
+					  start, count, period, settle),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   G_MAXINT,
+			   cancellable,
+			   cd_sensor_get_samples_cb,
+			   task);
+}
+
+/**********************************************************************/
+
 /**
  * cd_sensor_get_spectrum_finish:
  * @sensor: a #CdSensor instance.
@@ -1077,10 +1187,10 @@ cd_sensor_get_spectrum_cb (GObject *source_object,
 			   gpointer user_data)
 {
 	CdSpectrum *sp;
-	GVariantIter iter;
+	const gdouble *values;
 	gdouble sp_start = 0.f;
 	gdouble sp_end = 0.f;
-	gdouble tmp;
+	gsize len = 0;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GTask) task = G_TASK (user_data);
 	g_autoptr(GVariant) result = NULL;
@@ -1096,16 +1206,15 @@ cd_sensor_get_spectrum_cb (GObject *source_object,
 		return;
 	}
 
-	/* create object from data */
-	sp = cd_spectrum_new ();
+	/* create object from data, copying the values in one block */
 	g_variant_get_child (result, 0, "d", &sp_start);
 	g_variant_get_child (result, 1, "d", &sp_end);
+	data = g_variant_get_child_value (result, 2);
+	values = g_variant_get_fixed_array (data, &len, sizeof (gdouble));
+	sp = cd_spectrum_sized_new (len);
 	cd_spectrum_set_start (sp, sp_start);
 	cd_spectrum_set_end (sp, sp_end);
-	data = g_variant_get_child_value (result, 2);
-	g_variant_iter_init (&iter, data);
-	while (g_variant_iter_loop (&iter, "d", &tmp))
-		cd_spectrum_add_value (sp, tmp);
+	g_array_append_vals (cd_spectrum_get_data (sp), values, len);
 
 	/* success */
 	g_task_return_pointer (task, sp, (GDestroyNotify) cd_spectrum_free);
@@ -1151,6 +1260,137 @@ cd_sensor_get_spectrum (CdSensor *sensor,
 
 /**********************************************************************/
 
+typedef struct {
+	CdSpectrum	*spectrum;
+	CdColorXYZ	 value;
+} CdSensorSpectrumSample;
+
+static void
+cd_sensor_spectrum_sample_free (CdSensorSpectrumSample *sample)
+{
+	cd_spectrum_free (sample->spectrum);
+	g_free (sample);
+}
+
+/**
+ * cd_sensor_get_spectrum_sample_finish:
+ * @sensor: a #CdSensor instance.
+ * @res: the #GAsyncResult
+ * @value: (out caller-allocates): the XYZ value of the spectrum
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: the spectrum, or %NULL
+ *
+ * Since: 1.4.10
+ **/
+CdSpectrum *
+cd_sensor_get_spectrum_sample_finish (CdSensor *sensor,
+				      GAsyncResult *res,
+				      CdColorXYZ *value,
+				      GError **error)
+{
+	CdSensorSpectrumSample *sample;
+	CdSpectrum *sp;
+
+	g_return_val_if_fail (g_task_is_valid (res, sensor), NULL);
+	g_return_val_if_fail (value != NULL, NULL);
+
+	sample = g_task_propagate_pointer (G_TASK (res), error);
+	if (sample == NULL)
+		return NULL;
+	cd_color_xyz_copy (&sample->value, value);
+	sp = g_steal_pointer (&sample->spectrum);
+	g_free (sample);
+	return sp;
+}
+
+static void
+cd_sensor_get_spectrum_sample_cb (GObject *source_object,
+				  GAsyncResult *res,
+				  gpointer user_data)
+{
+	CdSensorSpectrumSample *sample;
+	const gdouble *values;
+	gdouble sp_start = 0.f;
+	gdouble sp_end = 0.f;
+	gsize len = 0;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GVariant) result = NULL;
+	g_autoptr(GVariant) data = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source_object),
+					   res,
+					   &error);
+	if (result == NULL) {
+		cd_sensor_fixup_dbus_error (error);
+		g_task_return_error (task, error);
+		error = NULL;
+		return;
+	}
+
+	/* create object from data, copying the values in one block */
+	sample = g_new0 (CdSensorSpectrumSample, 1);
+	g_variant_get_child (result, 0, "d", &sp_start);
+	g_variant_get_child (result, 1, "d", &sp_end);
+	data = g_variant_get_child_value (result, 2);
+	values = g_variant_get_fixed_array (data, &len, sizeof (gdouble));
+	sample->spectrum = cd_spectrum_sized_new (len);
+	cd_spectrum_set_start (sample->spectrum, sp_start);
+	cd_spectrum_set_end (sample->spectrum, sp_end);
+	g_array_append_vals (cd_spectrum_get_data (sample->spectrum), values, len);
+	g_variant_get_child (result, 3, "d", &sample->value.X);
+	g_variant_get_child (result, 4, "d", &sample->value.Y);
+	g_variant_get_child (result, 5, "d", &sample->value.Z);
+
+	/* success */
+	g_task_return_pointer (task, sample,
+			       (GDestroyNotify) cd_sensor_spectrum_sample_free);
+}
+
+/**
+ * cd_sensor_get_spectrum_sample:
+ * @sensor: a #CdSensor instance.
+ * @cap: a #CdSensorCap
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets a color spectrum from a sensor, along with the XYZ value which is
+ * calculated by the daemon using the CIE 1931 2 degree observer.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_sensor_get_spectrum_sample (CdSensor *sensor,
+			       CdSensorCap cap,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	GTask *task = NULL;
+
+	g_return_if_fail (CD_IS_SENSOR (sensor));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_return_if_fail (priv->proxy != NULL);
+
+	task = g_task_new (sensor, cancellable, callback, user_data);
+	g_dbus_proxy_call (priv->proxy,
+			   "GetSpectrumSample",
+			   g_variant_new ("(s)",
+					  cd_sensor_cap_to_string (cap)),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   -1,
+			   cancellable,
+			   cd_sensor_get_spectrum_sample_cb,
+			   task);
+}
+
+/**********************************************************************/
+
 /**
  * cd_sensor_get_object_path:
  * @sensor: a #CdSensor instance.
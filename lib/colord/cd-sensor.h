@@ -104,6 +104,19 @@ CdColorXYZ	*cd_sensor_get_sample_finish		(CdSensor	*sensor,
 							 GAsyncResult	*res,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_sensor_get_samples			(CdSensor	*sensor,
+							 CdSensorCap	 cap,
+							 gint64		 start,
+							 guint		 count,
+							 guint		 period,
+							 guint		 settle,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GPtrArray	*cd_sensor_get_samples_finish		(CdSensor	*sensor,
+							 GAsyncResult	*res,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 void		 cd_sensor_get_spectrum			(CdSensor	*sensor,
 							 CdSensorCap	 cap,
 							 GCancellable	*cancellable,
@@ -113,6 +126,16 @@ CdSpectrum	*cd_sensor_get_spectrum_finish		(CdSensor	*sensor,
 							 GAsyncResult	*res,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_sensor_get_spectrum_sample		(CdSensor	*sensor,
+							 CdSensorCap	 cap,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+CdSpectrum	*cd_sensor_get_spectrum_sample_finish	(CdSensor	*sensor,
+							 GAsyncResult	*res,
+							 CdColorXYZ	*value,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 /* getters */
 const gchar	*cd_sensor_get_object_path		(CdSensor	*sensor);
@@ -29,10 +29,10 @@
 #include "config.h"
 
 #include <math.h>
+#include <string.h>
 #include <glib-object.h>
 
 #include "cd-color.h"
-#include "cd-interp-linear.h"
 #include "cd-spectrum.h"
 
 /* this is private */
@@ -56,7 +56,6 @@ CdSpectrum *
 cd_spectrum_dup (const CdSpectrum *spectrum)
 {
 	CdSpectrum *dest;
-	gdouble tmp;
 	guint i;
 
 	g_return_val_if_fail (spectrum != NULL, NULL);
@@ -66,10 +65,9 @@ cd_spectrum_dup (const CdSpectrum *spectrum)
 	dest->start = spectrum->start;
 	dest->end = spectrum->end;
 	dest->norm = spectrum->norm;
-	for (i = 0; i < spectrum->data->len; i++) {
-		tmp = cd_spectrum_get_value_raw (spectrum, i);
-		cd_spectrum_add_value (dest, tmp);
-	}
+	g_array_set_size (dest->data, spectrum->data->len);
+	memcpy (dest->data->data, spectrum->data->data,
+		spectrum->data->len * sizeof (gdouble));
 	for (i = 0; i < 3; i++)
 		dest->wavelength_cal[i] = spectrum->wavelength_cal[i];
 	return dest;
@@ -218,8 +216,8 @@ cd_spectrum_get_wavelength (const CdSpectrum *spectrum, guint idx)
 	/* use wavelength_cal to work out wavelength */
 	return spectrum->start +
 		spectrum->wavelength_cal[0] * (gdouble) idx +
-		spectrum->wavelength_cal[1] * pow (idx, 2) +
-		spectrum->wavelength_cal[2] * pow (idx, 3);
+		spectrum->wavelength_cal[1] * (gdouble) idx * idx +
+		spectrum->wavelength_cal[2] * (gdouble) idx * idx * idx;
 }
 
 /**
@@ -388,6 +386,41 @@ cd_spectrum_sized_new (guint reserved_size)
 	return spectrum;
 }
 
+/* the number of Planckian spectra to keep around */
+#define CD_SPECTRUM_PLANCKIAN_CACHE_SIZE_MAX	256
+
+/* this is always the size of a Planckian spectrum */
+#define CD_SPECTRUM_PLANCKIAN_SIZE		531
+
+typedef struct {
+	gdouble			 temperature;
+	gdouble			 start;
+	gdouble			 end;
+	gdouble			 values[CD_SPECTRUM_PLANCKIAN_SIZE];
+} CdSpectrumPlanckianItem;
+
+G_LOCK_DEFINE_STATIC (cd_spectrum_planckian_cache);
+static GHashTable *cd_spectrum_planckian_cache = NULL; /* key:CdSpectrumPlanckianItem */
+
+static guint
+cd_spectrum_planckian_item_hash (gconstpointer data)
+{
+	const CdSpectrumPlanckianItem *item = data;
+	return g_double_hash (&item->temperature) ^
+	       (g_double_hash (&item->start) * 31) ^
+	       (g_double_hash (&item->end) * 961);
+}
+
+static gboolean
+cd_spectrum_planckian_item_equal (gconstpointer a, gconstpointer b)
+{
+	const CdSpectrumPlanckianItem *item1 = a;
+	const CdSpectrumPlanckianItem *item2 = b;
+	return item1->temperature == item2->temperature &&
+	       item1->start == item2->start &&
+	       item1->end == item2->end;
+}
+
 /**
  * cd_spectrum_planckian_new_full:
  * @temperature: the temperature in Kelvin
@@ -397,6 +430,9 @@ cd_spectrum_sized_new (guint reserved_size)
  *
  * Allocates a Planckian spectrum at a specific temperature.
  *
+ * The values are cached for the whole process, so asking for the same
+ * spectrum again does not evaluate Planck's law again.
+ *
  * Return value: A newly allocated #CdSpectrum object
  *
  * Since: 1.3.1
@@ -408,8 +444,11 @@ cd_spectrum_planckian_new_full (gdouble temperature,
 				gdouble resolution)
 {
 	CdSpectrum *s = NULL;
+	CdSpectrumPlanckianItem *item;
+	CdSpectrumPlanckianItem key;
 	const gdouble c1 = 3.74183e-16;	/* 2pi * h * c^2 */
 	const gdouble c2 = 1.4388e-2;	/* h * c / k */
+	gdouble c2_t;
 	gdouble wl;
 	gdouble norm;
 	gdouble tmp;
@@ -420,19 +459,58 @@ cd_spectrum_planckian_new_full (gdouble temperature,
 		return NULL;
 
 	/* create spectrum with 1nm resolution */
-	s = cd_spectrum_sized_new (531);
+	s = cd_spectrum_sized_new (CD_SPECTRUM_PLANCKIAN_SIZE);
 	s->id = g_strdup_printf ("Planckian@%.0fK", temperature);
 	cd_spectrum_set_start (s, start);
 	cd_spectrum_set_end (s, end);
 
+	/* already calculated */
+	key.temperature = temperature;
+	key.start = start;
+	key.end = end;
+	G_LOCK (cd_spectrum_planckian_cache);
+	if (cd_spectrum_planckian_cache != NULL) {
+		item = g_hash_table_lookup (cd_spectrum_planckian_cache, &key);
+		if (item != NULL) {
+			g_array_append_vals (s->data, item->values,
+					     CD_SPECTRUM_PLANCKIAN_SIZE);
+			G_UNLOCK (cd_spectrum_planckian_cache);
+			return s;
+		}
+	}
+	G_UNLOCK (cd_spectrum_planckian_cache);
+
 	/* see http://www.create.uwe.ac.uk/ardtalks/Schanda_paper.pdf, page 42 */
+	item = g_new (CdSpectrumPlanckianItem, 1);
+	item->temperature = temperature;
+	item->start = start;
+	item->end = end;
+	c2_t = c2 / temperature;
 	wl = 560 * 1e-9;
-	norm = 0.01 * (c1 * pow (wl, -5.0)) / (exp (c2 / (wl * temperature)) - 1.0);
-	for (i = 0; i < s->reserved_size; i++) {
+	norm = 0.01 * (c1 * pow (wl, -5.0)) / expm1 (c2_t / wl);
+	for (i = 0; i < CD_SPECTRUM_PLANCKIAN_SIZE; i++) {
 		wl = cd_spectrum_get_wavelength (s, i) * 1e-9;
-		tmp = (c1 * pow (wl, -5.0)) / (exp (c2 / (wl * temperature)) - 1.0);
-		cd_spectrum_add_value (s, tmp / norm);
+		tmp = wl * wl;
+		tmp = c1 / (tmp * tmp * wl * expm1 (c2_t / wl));
+		item->values[i] = tmp / norm;
 	}
+	g_array_append_vals (s->data, item->values, CD_SPECTRUM_PLANCKIAN_SIZE);
+
+	/* save for next time, dropping everything when full */
+	G_LOCK (cd_spectrum_planckian_cache);
+	if (cd_spectrum_planckian_cache == NULL) {
+		cd_spectrum_planckian_cache =
+			g_hash_table_new_full (cd_spectrum_planckian_item_hash,
+					       cd_spectrum_planckian_item_equal,
+					       g_free, NULL);
+	}
+	if (g_hash_table_size (cd_spectrum_planckian_cache) >= CD_SPECTRUM_PLANCKIAN_CACHE_SIZE_MAX)
+		g_hash_table_remove_all (cd_spectrum_planckian_cache);
+	if (g_hash_table_contains (cd_spectrum_planckian_cache, item))
+		g_free (item);
+	else
+		g_hash_table_add (cd_spectrum_planckian_cache, item);
+	G_UNLOCK (cd_spectrum_planckian_cache);
 	return s;
 }
 
@@ -597,9 +675,10 @@ cd_spectrum_set_norm (CdSpectrum *spectrum, gdouble norm)
 gdouble
 cd_spectrum_get_value_for_nm (const CdSpectrum *spectrum, gdouble wavelength)
 {
-	guint i;
+	gdouble x0, x1;
+	gdouble step;
+	guint lo, hi;
 	guint size;
-	g_autoptr(CdInterp) interp = NULL;
 
 	g_return_val_if_fail (spectrum != NULL, -1.f);
 
@@ -611,19 +690,246 @@ cd_spectrum_get_value_for_nm (const CdSpectrum *spectrum, gdouble wavelength)
 		return cd_spectrum_get_value (spectrum, 0);
 	if (wavelength > spectrum->end)
 		return cd_spectrum_get_value (spectrum, size - 1);
+	if (size == 1)
+		return cd_spectrum_get_value (spectrum, 0);
 
-	/* add all the data points */
-	interp = cd_interp_linear_new ();
-	for (i = 0; i < size; i++) {
-		cd_interp_insert (interp,
-				  cd_spectrum_get_wavelength (spectrum, i),
-				  cd_spectrum_get_value (spectrum, i));
+	/* find the first segment that ends at or after the wavelength */
+	if (spectrum->wavelength_cal[0] < 0 ||
+	    (spectrum->wavelength_cal[1] == 0.f &&
+	     spectrum->wavelength_cal[2] == 0.f)) {
+		/* evenly spaced, so index directly */
+		step = cd_spectrum_get_wavelength (spectrum, 1) - spectrum->start;
+		if (step > 0.f)
+			lo = (guint) MAX (ceil ((wavelength - spectrum->start) / step) - 1, 0);
+		else
+			lo = 0;
+		lo = MIN (lo, size - 2);
+	} else {
+		/* the wavelengths only increase, so use a binary search */
+		lo = 0;
+		hi = size - 2;
+		while (lo < hi) {
+			guint mid = lo + (hi - lo) / 2;
+			if (cd_spectrum_get_wavelength (spectrum, mid + 1) >= wavelength)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+	}
+
+	/* interpolate linearly */
+	x0 = cd_spectrum_get_wavelength (spectrum, lo);
+	x1 = cd_spectrum_get_wavelength (spectrum, lo + 1);
+	return cd_spectrum_get_value (spectrum, lo) +
+		((wavelength - x0) / (x1 - x0)) *
+		(cd_spectrum_get_value (spectrum, lo + 1) -
+		 cd_spectrum_get_value (spectrum, lo));
+}
+
+/* a moving interval, so ascending lookups do not search each time */
+typedef struct {
+	const CdSpectrum	*spectrum;
+	const gdouble		*data;
+	guint			 size;
+	guint			 lo;
+	gdouble			 x0;
+	gdouble			 x1;
+} CdSpectrumCursor;
+
+static void
+cd_spectrum_cursor_init (CdSpectrumCursor *cursor, const CdSpectrum *spectrum)
+{
+	cursor->spectrum = spectrum;
+	cursor->data = (const gdouble *) spectrum->data->data;
+	cursor->size = spectrum->data->len;
+	cursor->lo = 0;
+	cursor->x0 = 0.f;
+	cursor->x1 = 0.f;
+	if (cursor->size > 1) {
+		cursor->x0 = cd_spectrum_get_wavelength (spectrum, 0);
+		cursor->x1 = cd_spectrum_get_wavelength (spectrum, 1);
+	}
+}
+
+/* the same as cd_spectrum_get_value_for_nm() when called in ascending order */
+static gdouble
+cd_spectrum_cursor_get_value (CdSpectrumCursor *cursor, gdouble wavelength)
+{
+	const CdSpectrum *spectrum = cursor->spectrum;
+	gdouble y0;
+	gdouble y1;
+
+	/* out of bounds */
+	if (cursor->size == 0)
+		return 1.f;
+	if (wavelength < spectrum->start)
+		return cursor->data[0] * spectrum->norm;
+	if (wavelength > spectrum->end)
+		return cursor->data[cursor->size - 1] * spectrum->norm;
+	if (cursor->size == 1)
+		return cursor->data[0] * spectrum->norm;
+
+	/* move on to the first segment that ends at or after the wavelength */
+	while (cursor->lo < cursor->size - 2 && cursor->x1 < wavelength) {
+		cursor->lo++;
+		cursor->x0 = cursor->x1;
+		cursor->x1 = cd_spectrum_get_wavelength (spectrum, cursor->lo + 1);
+	}
+
+	/* interpolate linearly */
+	y0 = cursor->data[cursor->lo] * spectrum->norm;
+	y1 = cursor->data[cursor->lo + 1] * spectrum->norm;
+	return y0 + ((wavelength - cursor->x0) / (cursor->x1 - cursor->x0)) * (y1 - y0);
+}
+
+/* both spectra map each index to the same wavelength */
+static gboolean
+cd_spectrum_has_same_grid (const CdSpectrum *s1, const CdSpectrum *s2)
+{
+	gboolean linear1;
+	gboolean linear2;
+	guint i;
+
+	if (s1->data->len != s2->data->len)
+		return FALSE;
+	if (fabs (s1->start - s2->start) > 0.01f)
+		return FALSE;
+	if (fabs (s1->end - s2->end) > 0.01f)
+		return FALSE;
+	if (s1->data->len < 2)
+		return TRUE;
+	linear1 = s1->wavelength_cal[0] < 0 ||
+		  (s1->wavelength_cal[1] == 0.f && s1->wavelength_cal[2] == 0.f);
+	linear2 = s2->wavelength_cal[0] < 0 ||
+		  (s2->wavelength_cal[1] == 0.f && s2->wavelength_cal[2] == 0.f);
+	if (linear1 && linear2) {
+		return fabs (cd_spectrum_get_wavelength (s1, 1) -
+			     cd_spectrum_get_wavelength (s2, 1)) < 0.01f;
+	}
+	for (i = 0; i < 3; i++) {
+		if (s1->wavelength_cal[i] != s2->wavelength_cal[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* the number of points stepping from start to end would produce */
+static guint
+cd_spectrum_get_steps (gdouble start, gdouble end, gdouble resolution)
+{
+	gdouble nm;
+	guint n = 0;
+	for (nm = start; nm <= end; nm += resolution)
+		n++;
+	return n;
+}
+
+/**
+ * cd_spectrum_get_values_for_range:
+ * @spectrum: a #CdSpectrum instance
+ * @start: the first wavelength in nm
+ * @resolution: the step size in nm
+ * @values: (array length=n_values): the destination buffer
+ * @n_values: the number of values to get
+ *
+ * Gets the values from the spectral data for evenly spaced wavelengths,
+ * which is much faster than calling cd_spectrum_get_value_for_nm() for
+ * each wavelength.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_spectrum_get_values_for_range (const CdSpectrum *spectrum,
+				  gdouble start,
+				  gdouble resolution,
+				  gdouble *values,
+				  guint n_values)
+{
+	CdSpectrumCursor cursor;
+	gdouble nm;
+	guint i;
+
+	g_return_if_fail (spectrum != NULL);
+	g_return_if_fail (values != NULL || n_values == 0);
+
+	cd_spectrum_cursor_init (&cursor, spectrum);
+	for (i = 0, nm = start; i < n_values; i++, nm += resolution)
+		values[i] = cd_spectrum_cursor_get_value (&cursor, nm);
+}
+
+/**
+ * cd_spectrum_multiply_in_place:
+ * @s1: a #CdSpectrum instance, possibly an illuminant.
+ * @s2: a #CdSpectrum instance, possibly an absorption spectrum.
+ *
+ * Multiplies @s1 by @s2 at each of the wavelengths of @s1. If the spectra
+ * have the same wavelengths no interpolation is done.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_spectrum_multiply_in_place (CdSpectrum *s1, const CdSpectrum *s2)
+{
+	CdSpectrumCursor cursor;
+	gdouble *d1;
+	guint i;
+
+	g_return_if_fail (s1 != NULL);
+	g_return_if_fail (s2 != NULL);
+
+	d1 = (gdouble *) s1->data->data;
+	if (cd_spectrum_has_same_grid (s1, s2)) {
+		const gdouble *d2 = (const gdouble *) s2->data->data;
+		gdouble norm = s2->norm;
+		for (i = 0; i < s1->data->len; i++)
+			d1[i] *= d2[i] * norm;
+		return;
 	}
+	cd_spectrum_cursor_init (&cursor, s2);
+	for (i = 0; i < s1->data->len; i++) {
+		gdouble nm = cd_spectrum_get_wavelength (s1, i);
+		d1[i] *= cd_spectrum_cursor_get_value (&cursor, nm);
+	}
+}
+
+/**
+ * cd_spectrum_subtract_in_place:
+ * @s1: a #CdSpectrum instance, e.g. a sample
+ * @s2: a #CdSpectrum instance, e.g. a dark calibration
+ *
+ * Subtracts @s2 from @s1 at each of the wavelengths of @s1. If the spectra
+ * have the same wavelengths no interpolation is done.
+ *
+ * The normalization of @s1 is applied to the data and reset to 1.0.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_spectrum_subtract_in_place (CdSpectrum *s1, const CdSpectrum *s2)
+{
+	CdSpectrumCursor cursor;
+	gdouble *d1;
+	gdouble norm;
+	guint i;
 
-	/* get the interpolated value */
-	if (!cd_interp_prepare (interp, NULL))
-		return -1.f;
-	return cd_interp_eval (interp, wavelength, NULL);
+	g_return_if_fail (s1 != NULL);
+	g_return_if_fail (s2 != NULL);
+
+	d1 = (gdouble *) s1->data->data;
+	norm = s1->norm;
+	s1->norm = 1.f;
+	if (cd_spectrum_has_same_grid (s1, s2)) {
+		const gdouble *d2 = (const gdouble *) s2->data->data;
+		gdouble norm2 = s2->norm;
+		for (i = 0; i < s1->data->len; i++)
+			d1[i] = d1[i] * norm - d2[i] * norm2;
+		return;
+	}
+	cd_spectrum_cursor_init (&cursor, s2);
+	for (i = 0; i < s1->data->len; i++) {
+		gdouble nm = cd_spectrum_get_wavelength (s1, i);
+		d1[i] = d1[i] * norm - cd_spectrum_cursor_get_value (&cursor, nm);
+	}
 }
 
 /**
@@ -729,15 +1035,29 @@ CdSpectrum *
 cd_spectrum_multiply (CdSpectrum *s1, CdSpectrum *s2, gdouble resolution)
 {
 	CdSpectrum *s;
-	gdouble i;
+	CdSpectrumCursor c1;
+	CdSpectrumCursor c2;
+	gdouble *d;
+	gdouble start;
+	gdouble end;
+	gdouble nm;
+	guint i;
+	guint n;
 
-	s = cd_spectrum_new ();
+	start = MAX (s1->start, s2->start);
+	end = MIN (s1->end, s2->end);
+	n = cd_spectrum_get_steps (start, end, resolution);
+	s = cd_spectrum_sized_new (n);
 	s->id = g_strdup_printf ("%s✕%s", s1->id, s2->id);
-	s->start = MAX (s1->start, s2->start);
-	s->end = MIN (s1->end, s2->end);
-	for (i = s->start; i <= s->end; i += resolution) {
-		cd_spectrum_add_value (s, cd_spectrum_get_value_for_nm (s1, i) *
-					  cd_spectrum_get_value_for_nm (s2, i));
+	s->start = start;
+	s->end = end;
+	g_array_set_size (s->data, n);
+	d = (gdouble *) s->data->data;
+	cd_spectrum_cursor_init (&c1, s1);
+	cd_spectrum_cursor_init (&c2, s2);
+	for (i = 0, nm = start; i < n; i++, nm += resolution) {
+		d[i] = cd_spectrum_cursor_get_value (&c1, nm) *
+		       cd_spectrum_cursor_get_value (&c2, nm);
 	}
 	return s;
 }
@@ -757,8 +1077,9 @@ CdSpectrum *
 cd_spectrum_multiply_scalar (CdSpectrum *spectrum, gdouble value)
 {
 	CdSpectrum *s = cd_spectrum_dup (spectrum);
-	for (guint i = 0; i < spectrum->data->len; i++)
-		cd_spectrum_add_value (s, cd_spectrum_get_value (spectrum, i) * value);
+	gdouble *d = (gdouble *) s->data->data;
+	for (guint i = 0; i < s->data->len; i++)
+		d[i] *= value;
 	return s;
 }
 
@@ -779,10 +1100,14 @@ CdSpectrum *
 cd_spectrum_subtract (CdSpectrum *s1, CdSpectrum *s2, gdouble resolution)
 {
 	CdSpectrum *s;
+	CdSpectrumCursor c1;
+	CdSpectrumCursor c2;
+	gdouble *d;
 	gdouble max;
 	gdouble min;
 	gdouble nm;
 	guint i;
+	guint n;
 
 	g_return_val_if_fail (s1 != NULL, NULL);
 	g_return_val_if_fail (s2 != NULL, NULL);
@@ -797,10 +1122,11 @@ cd_spectrum_subtract (CdSpectrum *s1, CdSpectrum *s2, gdouble resolution)
 		s->end = s1->end;
 		for (i = 0; i < 3; i++)
 			s->wavelength_cal[i] = s1->wavelength_cal[i];
+		g_array_set_size (s->data, s1->data->len);
+		d = (gdouble *) s->data->data;
 		for (i = 0; i < s1->data->len; i++) {
-			gdouble tmp;
-			tmp = cd_spectrum_get_value (s1, i) - cd_spectrum_get_value (s2, i);
-			cd_spectrum_add_value (s, tmp);
+			d[i] = g_array_index (s1->data, gdouble, i) * s1->norm -
+			       g_array_index (s2->data, gdouble, i) * s2->norm;
 		}
 		return s;
 	}
@@ -808,15 +1134,18 @@ cd_spectrum_subtract (CdSpectrum *s1, CdSpectrum *s2, gdouble resolution)
 	/* resample */
 	min = MIN (cd_spectrum_get_start (s1), cd_spectrum_get_start (s2));
 	max = MAX (cd_spectrum_get_end (s1), cd_spectrum_get_end (s2));
-	s = cd_spectrum_new ();
+	n = cd_spectrum_get_steps (min, max, resolution);
+	s = cd_spectrum_sized_new (n);
 	s->id = g_strdup_printf ("%s-%s", s1->id, s2->id);
 	s->start = min;
 	s->end = max;
-	for (nm = min; nm <= max; nm += resolution) {
-		gdouble tmp;
-		tmp = cd_spectrum_get_value_for_nm (s1, nm) -
-			cd_spectrum_get_value_for_nm (s2, nm);
-		cd_spectrum_add_value (s, tmp);
+	g_array_set_size (s->data, n);
+	d = (gdouble *) s->data->data;
+	cd_spectrum_cursor_init (&c1, s1);
+	cd_spectrum_cursor_init (&c2, s2);
+	for (i = 0, nm = min; i < n; i++, nm += resolution) {
+		d[i] = cd_spectrum_cursor_get_value (&c1, nm) -
+		       cd_spectrum_cursor_get_value (&c2, nm);
 	}
 	return s;
 }
@@ -958,16 +1287,15 @@ cd_spectrum_resample (CdSpectrum *spectrum,
 		      gdouble end,
 		      gdouble resolution)
 {
-	gdouble nm;
 	CdSpectrum *sp;
+	guint n;
 
+	n = cd_spectrum_get_steps (start, end, resolution);
 	sp = cd_spectrum_new ();
 	cd_spectrum_set_start (sp, start);
-	for (nm = start; nm <= end; nm += resolution) {
-		gdouble tmp;
-		tmp = cd_spectrum_get_value_for_nm (spectrum, nm);
-		cd_spectrum_add_value (sp, tmp);
-	}
+	g_array_set_size (sp->data, n);
+	cd_spectrum_get_values_for_range (spectrum, start, resolution,
+					  (gdouble *) sp->data->data, n);
 	cd_spectrum_set_end (sp, end);
 	return sp;
 }
@@ -986,6 +1314,8 @@ cd_spectrum_resample (CdSpectrum *spectrum,
 CdSpectrum *
 cd_spectrum_resample_to_size (CdSpectrum *spectrum, guint size)
 {
+	CdSpectrumCursor cursor;
+	gdouble *d;
 	gdouble inc;
 	guint i;
 	CdSpectrum *sp;
@@ -995,10 +1325,222 @@ cd_spectrum_resample_to_size (CdSpectrum *spectrum, guint size)
 	cd_spectrum_set_end (sp, spectrum->end);
 
 	inc = (spectrum->end - spectrum->start) / (gdouble) (size - 1);
+	g_array_set_size (sp->data, size);
+	d = (gdouble *) sp->data->data;
+	cd_spectrum_cursor_init (&cursor, spectrum);
 	for (i = 0; i < size; i++) {
 		gdouble nm = spectrum->start + ((gdouble) i * inc);
-		gdouble tmp = cd_spectrum_get_value_for_nm (spectrum, nm);
-		cd_spectrum_add_value (sp, tmp);
+		d[i] = cd_spectrum_cursor_get_value (&cursor, nm);
 	}
 	return sp;
 }
+
+/*
+ * Reference data, such as observers and illuminants, is precompiled into
+ * a native-endian file of evenly spaced samples that can be mapped as-is:
+ * a header, then n_values rows of n_channels doubles.
+ */
+#define CD_SPECTRUM_REFERENCE_MAGIC		"CDSPREF1"
+#define CD_SPECTRUM_REFERENCE_BYTE_ORDER	0x01020304
+
+typedef struct {
+	gchar			 magic[8];
+	guint32			 byte_order;
+	guint32			 n_channels;
+	guint32			 n_values;
+	guint32			 reserved;
+	gdouble			 start;
+	gdouble			 resolution;
+} CdSpectrumReferenceHeader;
+
+G_LOCK_DEFINE_STATIC (cd_spectrum_reference_cache);
+static GHashTable *cd_spectrum_reference_cache = NULL; /* filename:GBytes */
+
+/**
+ * cd_spectrum_reference_to_bytes:
+ * @spectra: (element-type CdSpectrum): the channels, e.g. X, Y and Z
+ * @start: the first wavelength in nm
+ * @end: the last wavelength in nm
+ * @resolution: the step size in nm
+ *
+ * Resamples spectra into the precompiled format used by
+ * cd_spectrum_get_reference(), which is normally done when building.
+ *
+ * Return value: (transfer full): the file contents, or %NULL for invalid
+ *
+ * Since: 1.4.10
+ **/
+GBytes *
+cd_spectrum_reference_to_bytes (GPtrArray *spectra,
+				gdouble start,
+				gdouble end,
+				gdouble resolution)
+{
+	CdSpectrumReferenceHeader *hdr;
+	gdouble *data;
+	gsize size;
+	guint i;
+	guint j;
+	guint n;
+	g_autofree gdouble *values = NULL;
+
+	g_return_val_if_fail (spectra != NULL, NULL);
+
+	if (spectra->len == 0 || resolution <= 0.f || end < start)
+		return NULL;
+	n = cd_spectrum_get_steps (start, end, resolution);
+	size = sizeof (CdSpectrumReferenceHeader) +
+	       sizeof (gdouble) * n * spectra->len;
+	hdr = g_malloc0 (size);
+	memcpy (hdr->magic, CD_SPECTRUM_REFERENCE_MAGIC, sizeof (hdr->magic));
+	hdr->byte_order = CD_SPECTRUM_REFERENCE_BYTE_ORDER;
+	hdr->n_channels = spectra->len;
+	hdr->n_values = n;
+	hdr->start = start;
+	hdr->resolution = resolution;
+
+	/* interleave the channels so any range is contiguous */
+	data = (gdouble *) (hdr + 1);
+	values = g_new (gdouble, n);
+	for (j = 0; j < spectra->len; j++) {
+		cd_spectrum_get_values_for_range (g_ptr_array_index (spectra, j),
+						  start, resolution, values, n);
+		for (i = 0; i < n; i++)
+			data[i * spectra->len + j] = values[i];
+	}
+	return g_bytes_new_take (hdr, size);
+}
+
+/* maps each file once and keeps it for the whole process */
+static GBytes *
+cd_spectrum_reference_load (const gchar *filename)
+{
+	GBytes *bytes;
+	const CdSpectrumReferenceHeader *hdr;
+	g_autoptr(GMappedFile) mapped = NULL;
+
+	G_LOCK (cd_spectrum_reference_cache);
+	if (cd_spectrum_reference_cache == NULL) {
+		cd_spectrum_reference_cache =
+			g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) g_bytes_unref);
+	}
+	bytes = g_hash_table_lookup (cd_spectrum_reference_cache, filename);
+	if (bytes != NULL) {
+		g_bytes_ref (bytes);
+		G_UNLOCK (cd_spectrum_reference_cache);
+		return bytes;
+	}
+
+	/* check the header before trusting the sizes */
+	mapped = g_mapped_file_new (filename, FALSE, NULL);
+	if (mapped == NULL) {
+		G_UNLOCK (cd_spectrum_reference_cache);
+		return NULL;
+	}
+	bytes = g_mapped_file_get_bytes (mapped);
+	hdr = g_bytes_get_data (bytes, NULL);
+	if (g_bytes_get_size (bytes) < sizeof (CdSpectrumReferenceHeader) ||
+	    memcmp (hdr->magic, CD_SPECTRUM_REFERENCE_MAGIC, sizeof (hdr->magic)) != 0 ||
+	    hdr->byte_order != CD_SPECTRUM_REFERENCE_BYTE_ORDER ||
+	    hdr->n_channels == 0 || hdr->n_values == 0 ||
+	    hdr->resolution <= 0.f ||
+	    g_bytes_get_size (bytes) != sizeof (CdSpectrumReferenceHeader) +
+			sizeof (gdouble) * (gsize) hdr->n_channels * hdr->n_values) {
+		g_bytes_unref (bytes);
+		G_UNLOCK (cd_spectrum_reference_cache);
+		return NULL;
+	}
+	g_hash_table_insert (cd_spectrum_reference_cache,
+			     g_strdup (filename),
+			     g_bytes_ref (bytes));
+	G_UNLOCK (cd_spectrum_reference_cache);
+	return bytes;
+}
+
+/**
+ * cd_spectrum_get_reference:
+ * @id: a reference name, e.g. "CIE1931-2deg-XYZ" or "CIE-D65", or an
+ *      absolute filename
+ * @start: the first wavelength in nm
+ * @end: the last wavelength in nm
+ * @resolution: the step size in nm
+ * @n_channels: (out) (optional): the number of values for each wavelength
+ *
+ * Gets precompiled reference data for evenly spaced wavelengths, with the
+ * channels of each wavelength stored together, e.g. X, Y and Z for an
+ * observer. This avoids parsing the CGATS data files each time.
+ *
+ * If the wavelengths fall on the stored grid the returned data points into
+ * the mapped file and nothing is copied, otherwise the data is linearly
+ * interpolated, clamping values outside the stored range.
+ *
+ * Return value: (transfer full): #gdouble values, or %NULL if not found
+ *
+ * Since: 1.4.10
+ **/
+GBytes *
+cd_spectrum_get_reference (const gchar *id,
+			   gdouble start,
+			   gdouble end,
+			   gdouble resolution,
+			   guint *n_channels)
+{
+	const CdSpectrumReferenceHeader *hdr;
+	const gdouble *src;
+	gdouble *dest;
+	gdouble pos;
+	gdouble idx;
+	guint i;
+	guint j;
+	guint n;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+
+	g_return_val_if_fail (id != NULL, NULL);
+
+	if (resolution <= 0.f || end < start)
+		return NULL;
+	if (g_path_is_absolute (id)) {
+		filename = g_strdup (id);
+	} else {
+		g_autofree gchar *basename = g_strdup_printf ("%s.ref", id);
+		filename = g_build_filename (DATADIR, "colord", "ref", basename, NULL);
+	}
+	bytes = cd_spectrum_reference_load (filename);
+	if (bytes == NULL)
+		return NULL;
+	hdr = g_bytes_get_data (bytes, NULL);
+	src = (const gdouble *) (hdr + 1);
+	n = cd_spectrum_get_steps (start, end, resolution);
+	if (n_channels != NULL)
+		*n_channels = hdr->n_channels;
+
+	/* on the stored grid, so just return that part of the file */
+	idx = (start - hdr->start) / hdr->resolution;
+	if (fabs (resolution - hdr->resolution) < 1e-6 &&
+	    fabs (idx - round (idx)) < 1e-6 &&
+	    round (idx) >= 0 &&
+	    (guint) round (idx) + n <= hdr->n_values) {
+		return g_bytes_new_from_bytes (bytes,
+					       sizeof (CdSpectrumReferenceHeader) +
+					       sizeof (gdouble) * (gsize) round (idx) * hdr->n_channels,
+					       sizeof (gdouble) * (gsize) n * hdr->n_channels);
+	}
+
+	/* resample */
+	dest = g_new (gdouble, (gsize) n * hdr->n_channels);
+	for (i = 0; i < n; i++) {
+		guint lo;
+		pos = (start + (gdouble) i * resolution - hdr->start) / hdr->resolution;
+		pos = CLAMP (pos, 0.f, (gdouble) (hdr->n_values - 1));
+		lo = MIN ((guint) pos, hdr->n_values > 1 ? hdr->n_values - 2 : 0);
+		pos -= lo;
+		for (j = 0; j < hdr->n_channels; j++) {
+			gdouble y0 = src[lo * hdr->n_channels + j];
+			gdouble y1 = hdr->n_values > 1 ? src[(lo + 1) * hdr->n_channels + j] : y0;
+			dest[i * hdr->n_channels + j] = y0 + pos * (y1 - y0);
+		}
+	}
+	return g_bytes_new_take (dest, sizeof (gdouble) * (gsize) n * hdr->n_channels);
+}
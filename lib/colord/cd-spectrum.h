@@ -77,6 +77,11 @@ gdouble		 cd_spectrum_get_wavelength	(const CdSpectrum	*spectrum,
 						 guint			 idx);
 gdouble		 cd_spectrum_get_value_for_nm	(const CdSpectrum	*spectrum,
 						 gdouble		 wavelength);
+void		 cd_spectrum_get_values_for_range (const CdSpectrum	*spectrum,
+						 gdouble		 start,
+						 gdouble		 resolution,
+						 gdouble		*values,
+						 guint			 n_values);
 
 void		 cd_spectrum_set_id		(CdSpectrum		*spectrum,
 						 const gchar		*id);
@@ -106,12 +111,25 @@ CdSpectrum	*cd_spectrum_multiply		(CdSpectrum		*s1,
 						 gdouble		 resolution);
 CdSpectrum	*cd_spectrum_multiply_scalar	(CdSpectrum		*spectrum,
 						 gdouble		 value);
+void		 cd_spectrum_multiply_in_place	(CdSpectrum		*s1,
+						 const CdSpectrum	*s2);
+void		 cd_spectrum_subtract_in_place	(CdSpectrum		*s1,
+						 const CdSpectrum	*s2);
 CdSpectrum	*cd_spectrum_resample		(CdSpectrum		*spectrum,
 						 gdouble		 start,
 						 gdouble		 end,
 						 gdouble		 resolution);
 CdSpectrum	*cd_spectrum_resample_to_size	(CdSpectrum		*spectrum,
 						 guint			 size);
+GBytes		*cd_spectrum_reference_to_bytes	(GPtrArray		*spectra,
+						 gdouble		 start,
+						 gdouble		 end,
+						 gdouble		 resolution);
+GBytes		*cd_spectrum_get_reference	(const gchar		*id,
+						 gdouble		 start,
+						 gdouble		 end,
+						 gdouble		 resolution,
+						 guint			*n_channels);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdSpectrum, cd_spectrum_free)
 
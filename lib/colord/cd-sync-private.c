@@ -0,0 +1,73 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "cd-sync-private.h"
+
+/* each thread keeps one context for the sync helpers, so a call does not
+ * have to create a main loop and does not dispatch unrelated sources that
+ * are attached to the caller's context */
+static GPrivate cd_sync_context = G_PRIVATE_INIT ((GDestroyNotify) g_main_context_unref);
+
+/*
+ * cd_sync_context_push:
+ *
+ * Makes the private context of this thread the thread-default, so that the
+ * completion of any async method started afterwards is dispatched there.
+ *
+ * Only use this for method calls; objects that subscribe to signals while it
+ * is pushed would never have them delivered once it has been popped.
+ */
+GMainContext *
+cd_sync_context_push (void)
+{
+	GMainContext *context = g_private_get (&cd_sync_context);
+	if (context == NULL) {
+		context = g_main_context_new ();
+		g_private_set (&cd_sync_context, context);
+	}
+	g_main_context_push_thread_default (context);
+	return context;
+}
+
+/*
+ * cd_sync_context_pop:
+ */
+void
+cd_sync_context_pop (GMainContext *context)
+{
+	g_main_context_pop_thread_default (context);
+}
+
+/*
+ * cd_sync_context_run:
+ *
+ * Iterates the context until the async callback has set @done.
+ */
+void
+cd_sync_context_run (GMainContext *context, const gboolean *done)
+{
+	while (!*done)
+		g_main_context_iteration (context, TRUE);
+}
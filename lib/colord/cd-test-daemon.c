@@ -1013,6 +1013,7 @@ colord_sensor_func (void)
 	CdSensor *sensor;
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(CdSensor) group = NULL;
 	GHashTable *hash;
 	GPtrArray *array;
 
@@ -1049,9 +1050,21 @@ colord_sensor_func (void)
 	g_assert_cmpstr (cd_sensor_get_vendor (sensor), ==, "Acme Corp");
 	g_assert_cmpstr (cd_sensor_get_model (sensor), ==, "Dummy Sensor #1");
 	g_assert_cmpstr (cd_sensor_get_object_path (sensor), ==, "/org/freedesktop/ColorManager/sensors/dummy");
-	g_assert_cmpint (cd_sensor_get_caps (sensor), ==, 126);
+	g_assert_cmpint (cd_sensor_get_caps (sensor), ==, 32894);
 	g_assert (cd_sensor_has_cap (sensor, CD_SENSOR_CAP_PROJECTOR));
 
+	/* a group needs two different sensors */
+	group = cd_client_create_sensor_group_sync (client, array, NULL, &error);
+	g_assert (error != NULL);
+	g_assert (group == NULL);
+	g_clear_error (&error);
+	g_ptr_array_add (array, g_object_ref (sensor));
+	group = cd_client_create_sensor_group_sync (client, array, NULL, &error);
+	g_assert (error != NULL);
+	g_assert (group == NULL);
+	g_clear_error (&error);
+	g_ptr_array_remove_index (array, 1);
+
 #if 0
 	/* get a sample async */
 	ret = cd_sensor_get_sample (sensor,
@@ -1752,6 +1765,86 @@ colord_device_async_func (void)
 	g_object_unref (device_tmp);
 }
 
+static void
+colord_client_snapshot_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	CdDevice *device_tmp;
+	CdDevice *device = CD_DEVICE (user_data);
+	gboolean found = FALSE;
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) profiles = NULL;
+
+	ret = cd_client_get_snapshot_finish (CD_CLIENT (object), res,
+					     &devices, &profiles, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (profiles != NULL);
+
+	/* the device is returned already connected, with its properties */
+	for (guint i = 0; i < devices->len; i++) {
+		device_tmp = g_ptr_array_index (devices, i);
+		g_assert (cd_device_get_connected (device_tmp));
+		if (g_strcmp0 (cd_device_get_object_path (device_tmp),
+			       cd_device_get_object_path (device)) != 0)
+			continue;
+		g_assert_cmpstr (cd_device_get_id (device_tmp), ==, "device_snapshot");
+		g_assert_cmpstr (cd_device_get_model (device_tmp), ==, "Cray");
+		g_assert_cmpint (cd_device_get_kind (device_tmp), ==, CD_DEVICE_KIND_DISPLAY);
+		found = TRUE;
+	}
+	g_assert (found);
+
+	cd_test_loop_quit ();
+}
+
+static void
+colord_client_snapshot_func (void)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(CdClient) client = NULL;
+	g_autoptr(CdDevice) device = NULL;
+	g_autoptr(GHashTable) device_props = NULL;
+
+	/* no running colord to use */
+	if (!has_colord_process) {
+		g_print ("[DISABLED] ");
+		return;
+	}
+
+	client = cd_client_new ();
+	ret = cd_client_connect_sync (client, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	device_props = g_hash_table_new_full (g_str_hash, g_str_equal,
+					      g_free, g_free);
+	g_hash_table_insert (device_props,
+			     g_strdup (CD_DEVICE_PROPERTY_KIND),
+			     g_strdup (cd_device_kind_to_string (CD_DEVICE_KIND_DISPLAY)));
+	g_hash_table_insert (device_props,
+			     g_strdup (CD_DEVICE_PROPERTY_MODEL),
+			     g_strdup ("Cray"));
+	device = cd_client_create_device_sync (client,
+					       "device_snapshot",
+					       CD_OBJECT_SCOPE_TEMP,
+					       device_props,
+					       NULL,
+					       &error);
+	g_assert_no_error (error);
+	g_assert (device != NULL);
+
+	/* get everything in one call */
+	cd_client_get_snapshot (client, NULL, colord_client_snapshot_cb, device);
+	cd_test_loop_run_with_timeout (1500);
+
+	ret = cd_client_delete_device_sync (client, device, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
 static void
 colord_client_systemwide_func (void)
 {
@@ -2764,6 +2857,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/colord/client{standard-space}", colord_client_standard_space_func);
 	g_test_add_func ("/colord/client{async}", colord_client_async_func);
 	g_test_add_func ("/colord/device{async}", colord_device_async_func);
+	g_test_add_func ("/colord/client{snapshot}", colord_client_snapshot_func);
 	if (g_test_thorough ())
 		g_test_add_func ("/colord/client{systemwide}", colord_client_systemwide_func);
 	g_test_add_func ("/colord/client{fd-pass}", colord_client_fd_pass_func);
@@ -23,8 +23,10 @@
 
 #include <math.h>
 #include <locale.h>
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <utime.h>
 #include <math.h>
 #include <lcms2.h>
 
@@ -36,16 +38,21 @@
 #include "cd-dom.h"
 #include "cd-edid.h"
 #include "cd-icc.h"
+#include "cd-icc-private.h"
 #include "cd-icc-store.h"
 #include "cd-icc-utils.h"
 #include "cd-interp-akima.h"
 #include "cd-interp.h"
 #include "cd-interp-linear.h"
 #include "cd-it8.h"
+#include "cd-it8-reader.h"
+#include "cd-it8-store.h"
 #include "cd-it8-utils.h"
 #include "cd-math.h"
 #include "cd-spectrum.h"
 #include "cd-transform.h"
+#include "cd-transform-private.h"
+#include "cd-transform-stream.h"
 #include "cd-version.h"
 
 #include "cd-test-shared.h"
@@ -56,11 +63,14 @@ colord_it8_cri_util_func (void)
 	CdIt8 *cmf;
 	CdIt8 *tcs;
 	CdIt8 *test;
+	CdSpectrum *batch[2];
 	CdSpectrum *f4;
+	g_autoptr(CdIt8UtilsCri) cri = NULL;
 	g_autoptr(GError) error = NULL;
 	GFile *file;
 	gboolean ret;
 	gdouble value = 0.f;
+	gdouble values[2];
 
 	/* load a CMF */
 	cmf = cd_it8_new ();
@@ -112,6 +122,18 @@ colord_it8_cri_util_func (void)
 	g_assert_cmpfloat (value, <, 52);
 	g_assert_cmpfloat (value, >, 50);
 
+	/* the context gives the same result for every illuminant in a batch */
+	cri = cd_it8_utils_cri_new (cmf, tcs, 1.0f, &error);
+	g_assert_no_error (error);
+	g_assert (cri != NULL);
+	batch[0] = f4;
+	batch[1] = f4;
+	ret = cd_it8_utils_cri_calculate_batch (cri, batch, values, 2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (ABS (values[0] - value), <, 0.01);
+	g_assert_cmpfloat (ABS (values[1] - value), <, 0.01);
+
 	g_object_unref (test);
 	g_object_unref (cmf);
 	g_object_unref (tcs);
@@ -122,12 +144,15 @@ static void
 colord_it8_spectra_util_func (void)
 {
 	CdColorXYZ value;
+	CdColorXYZ values[2];
+	CdSpectrum *batch[2];
 	CdSpectrum *data;
 	GFile *file;
 	gboolean ret;
 	gchar *filename;
 	g_autoptr(CdIt8) cmf = NULL;
 	g_autoptr(CdIt8) spectra = NULL;
+	g_autoptr(CdIt8UtilsPlan) plan = NULL;
 	g_autoptr(CdSpectrum) unity = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) array = NULL;
@@ -168,12 +193,27 @@ colord_it8_spectra_util_func (void)
 	g_assert_cmpfloat (value.Y, <, 1.f + 0.01);
 	g_assert_cmpfloat (value.Z, >, 0.813050f - 0.01);
 	g_assert_cmpfloat (value.Z, <, 0.813050f + 0.01);
+
+	/* the plan gives the same result for every spectrum in a batch */
+	plan = cd_it8_utils_plan_new (cmf, unity, 1.f, &error);
+	g_assert_no_error (error);
+	g_assert (plan != NULL);
+	batch[0] = data;
+	batch[1] = data;
+	cd_it8_utils_plan_calculate_xyz_batch (plan, batch, values, 2);
+	cd_color_xyz_normalize (&values[1], 1.0, &values[1]);
+	g_assert_cmpfloat (fabs (values[1].X - value.X), <, 0.0001f);
+	g_assert_cmpfloat (fabs (values[1].Y - value.Y), <, 0.0001f);
+	g_assert_cmpfloat (fabs (values[1].Z - value.Z), <, 0.0001f);
 }
 
 static void
 colord_spectrum_planckian_func (void)
 {
 	g_autoptr(CdSpectrum) s = NULL;
+	g_autoptr(CdSpectrum) s2 = NULL;
+	g_autoptr(CdSpectrum) s3 = NULL;
+	g_autoptr(CdSpectrum) s4 = NULL;
 	guint i;
 
 	s = cd_spectrum_planckian_new (2940);
@@ -188,6 +228,90 @@ colord_spectrum_planckian_func (void)
 		g_assert_cmpfloat (cd_spectrum_get_value (s, i), >, 1.f);
 		g_assert_cmpfloat (cd_spectrum_get_value (s, i), <, 241.f);
 	}
+
+	/* the cached copy is identical, with its own data */
+	s2 = cd_spectrum_planckian_new (2940);
+	g_assert (s2 != s);
+	g_assert_cmpstr (cd_spectrum_get_id (s2), ==, "Planckian@2940K");
+	g_assert_cmpint (cd_spectrum_get_size (s2), ==, 531);
+	for (i = 0; i < cd_spectrum_get_size (s); i++)
+		g_assert_cmpfloat (cd_spectrum_get_value (s2, i), ==, cd_spectrum_get_value (s, i));
+	cd_spectrum_set_value (s2, 0, 0.f);
+	s3 = cd_spectrum_planckian_new (2940);
+	g_assert_cmpfloat (cd_spectrum_get_value (s3, 0), >, 1.f);
+
+	/* a different range is not confused with it */
+	s4 = cd_spectrum_planckian_new_full (2940, 400, 700, 1);
+	g_assert_cmpfloat (ABS (cd_spectrum_get_start (s4) - 400.f), <, 0.0001f);
+	g_assert_cmpfloat (cd_spectrum_get_value (s4, 0), !=, cd_spectrum_get_value (s, 0));
+}
+
+static void
+colord_spectrum_reference_func (void)
+{
+	const gdouble *data;
+	gboolean ret;
+	gsize len;
+	guint i;
+	guint n_channels = 0;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GBytes) ref1 = NULL;
+	g_autoptr(GBytes) ref2 = NULL;
+	g_autoptr(GBytes) ref3 = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) spectra = NULL;
+
+	/* a ramp and a constant channel */
+	spectra = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_spectrum_free);
+	for (i = 0; i < 2; i++) {
+		CdSpectrum *sp = cd_spectrum_new ();
+		guint j;
+		cd_spectrum_set_start (sp, 400);
+		for (j = 0; j <= 10; j++)
+			cd_spectrum_add_value (sp, i == 0 ? j : 2.f);
+		cd_spectrum_set_end (sp, 410);
+		g_ptr_array_add (spectra, sp);
+	}
+	blob = cd_spectrum_reference_to_bytes (spectra, 400, 410, 1);
+	g_assert (blob != NULL);
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	filename = g_build_filename (tmpdir, "test.ref", NULL);
+	ret = g_file_set_contents (filename,
+				   g_bytes_get_data (blob, NULL),
+				   (gssize) g_bytes_get_size (blob),
+				   &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* on the stored grid the data is shared with the mapped file */
+	ref1 = cd_spectrum_get_reference (filename, 402, 405, 1, &n_channels);
+	g_assert (ref1 != NULL);
+	g_assert_cmpint (n_channels, ==, 2);
+	data = g_bytes_get_data (ref1, &len);
+	g_assert_cmpint (len, ==, sizeof (gdouble) * 4 * 2);
+	for (i = 0; i < 4; i++) {
+		g_assert_cmpfloat (ABS (data[i * 2 + 0] - (2.f + i)), <, 0.0001f);
+		g_assert_cmpfloat (ABS (data[i * 2 + 1] - 2.f), <, 0.0001f);
+	}
+	ref2 = cd_spectrum_get_reference (filename, 402, 405, 1, NULL);
+	g_assert (g_bytes_get_data (ref2, NULL) == data);
+
+	/* off the grid the data is interpolated */
+	ref3 = cd_spectrum_get_reference (filename, 400.5, 402.5, 0.5, NULL);
+	g_assert (ref3 != NULL);
+	data = g_bytes_get_data (ref3, &len);
+	g_assert_cmpint (len, ==, sizeof (gdouble) * 5 * 2);
+	for (i = 0; i < 5; i++)
+		g_assert_cmpfloat (ABS (data[i * 2 + 0] - (0.5f + i * 0.5f)), <, 0.0001f);
+
+	/* not found */
+	g_assert (cd_spectrum_get_reference ("/not/going/to/exist.ref", 400, 410, 1, NULL) == NULL);
+
+	g_remove (filename);
+	g_remove (tmpdir);
 }
 
 static void
@@ -198,6 +322,8 @@ colord_spectrum_subtract_func (void)
 	g_autoptr(CdSpectrum) s2 = NULL;
 	g_autoptr(CdSpectrum) s3 = NULL;
 	g_autoptr(CdSpectrum) s4 = NULL;
+	g_autoptr(CdSpectrum) s5 = NULL;
+	gdouble values[7];
 
 	/* source data */
 	s1 = cd_spectrum_new ();
@@ -247,6 +373,25 @@ colord_spectrum_subtract_func (void)
 	g_assert_cmpint (cd_spectrum_get_size (s4), ==, 6);
 	g_assert_cmpint (cd_spectrum_get_value_raw (s4, 0), ==, 1);
 	g_assert_cmpint (cd_spectrum_get_value_raw (s4, 5), ==, 4);
+
+	/* subtract in place, with the same grid */
+	s5 = cd_spectrum_dup (s1);
+	cd_spectrum_subtract_in_place (s5, s2);
+	g_assert_cmpint (cd_spectrum_get_size (s5), ==, 4);
+	g_assert_cmpint (cd_spectrum_get_value (s5, 0), ==, 1);
+	g_assert_cmpint (cd_spectrum_get_value (s5, 3), ==, -1);
+
+	/* multiply in place, requiring resampling */
+	cd_spectrum_multiply_in_place (s5, s3);
+	g_assert_cmpint (cd_spectrum_get_size (s5), ==, 4);
+	g_assert_cmpint (cd_spectrum_get_value (s5, 0), ==, 10);
+	g_assert_cmpint (cd_spectrum_get_value (s5, 2), ==, 30);
+
+	/* get values into a buffer */
+	cd_spectrum_get_values_for_range (s1, 360, 70, values, 7);
+	g_assert_cmpfloat (ABS (values[0] - 11.f), <, 0.001f);
+	g_assert_cmpfloat (ABS (values[1] - 11.5f), <, 0.001f);
+	g_assert_cmpfloat (ABS (values[6] - 14.f), <, 0.001f);
 }
 
 static void
@@ -504,6 +649,215 @@ colord_it8_spect_func (void)
 	g_object_unref (file);
 }
 
+static void
+colord_it8_store_copy (const gchar *tmpdir, const gchar *src, const gchar *dest)
+{
+	gboolean ret;
+	gsize len = 0;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *filename_dest = NULL;
+
+	filename = cd_test_get_filename (src);
+	ret = g_file_get_contents (filename, &data, &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	filename_dest = g_build_filename (tmpdir, dest, NULL);
+	ret = g_file_set_contents (filename_dest, data, len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static void
+colord_it8_store_func (void)
+{
+	const CdMat3x3 *matrix;
+	gboolean ret;
+	g_autoptr(CdIt8) it8 = NULL;
+	g_autoptr(CdIt8) it8_tmp = NULL;
+	g_autoptr(CdIt8Store) store = NULL;
+	g_autoptr(CdIt8Store) store_index = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) filenames = NULL;
+	g_autofree gchar *filename_bogus = NULL;
+	g_autofree gchar *filename_dell = NULL;
+	g_autofree gchar *filename_huey = NULL;
+	g_autofree gchar *filename_index = NULL;
+	g_autofree gchar *filename_ccss = NULL;
+	g_autofree gchar *filename_deep = NULL;
+	g_autofree gchar *filename_generic = NULL;
+	g_autofree gchar *subdir = NULL;
+	g_autofree gchar *subdir_deep = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autofree gchar *data_generic = NULL;
+	const gchar *data_dell =
+		"CCMX   \n"
+		"DESCRIPTOR \"Dell U2413 & i1 DisplayPro\"\n"
+		"INSTRUMENT \"i1 DisplayPro, ColorMunki Display\"\n"
+		"DISPLAY \"Dell U2413\"\n"
+		"TECHNOLOGY \"LCD White LED IPS\"\n"
+		"REFERENCE \"i1 Pro 2\"\n"
+		"COLOR_REP \"XYZ\"\n"
+		"NUMBER_OF_FIELDS 3\n"
+		"BEGIN_DATA_FORMAT\n"
+		"XYZ_X XYZ_Y XYZ_Z\n"
+		"END_DATA_FORMAT\n"
+		"NUMBER_OF_SETS 3\n"
+		"BEGIN_DATA\n"
+		"1.0 0.0 0.0\n"
+		"0.0 1.0 0.0\n"
+		"0.0 0.0 1.0\n"
+		"END_DATA\n";
+
+	/* set up a location with some corrections, and one broken file */
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (tmpdir != NULL);
+	subdir = g_build_filename (tmpdir, "dell", NULL);
+	g_assert_cmpint (g_mkdir (subdir, 0700), ==, 0);
+	colord_it8_store_copy (tmpdir, "calibration.ccmx", "huey.ccmx");
+	colord_it8_store_copy (tmpdir, "test.ccss", "test.ccss");
+	filename_dell = g_build_filename (subdir, "u2413.ccmx", NULL);
+	ret = g_file_set_contents (filename_dell, data_dell, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	filename_bogus = g_build_filename (tmpdir, "bogus.ccmx", NULL);
+	ret = g_file_set_contents (filename_bogus, "bogus", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	filename_huey = g_build_filename (tmpdir, "huey.ccmx", NULL);
+	filename_ccss = g_build_filename (tmpdir, "test.ccss", NULL);
+
+	/* a matrix that does not say which instrument it is for */
+	data_generic = g_strdup (data_dell);
+	memcpy (g_strstr_len (data_generic, -1, "INSTRUMENT"), "#", 1);
+	filename_generic = g_build_filename (tmpdir, "generic.ccmx", NULL);
+	ret = g_file_set_contents (filename_generic, data_generic, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* too deep to be searched, but does not stop the rest */
+	subdir_deep = g_build_filename (subdir, "a", "b", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (subdir_deep, 0700), ==, 0);
+	filename_deep = g_build_filename (subdir_deep, "deep.ccmx", NULL);
+	ret = g_file_set_contents (filename_deep, data_dell, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* only the header is parsed */
+	store = cd_it8_store_new ();
+	filename_index = g_build_filename (tmpdir, "cache", "index.ini", NULL);
+	ret = cd_it8_store_set_index (store, filename_index, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_it8_store_search_location (store, tmpdir, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_it8_store_get_size (store), ==, 4);
+	g_assert (g_file_test (filename_index, G_FILE_TEST_EXISTS));
+
+	/* a file for every kind of display */
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, "huey",
+					CD_SENSOR_CAP_LCD, NULL);
+	g_assert_cmpint (filenames->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (filenames, 0), ==, filename_huey);
+	g_ptr_array_unref (filenames);
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, "ColorHug",
+					CD_SENSOR_CAP_LCD, NULL);
+	g_assert_cmpint (filenames->len, ==, 0);
+	g_ptr_array_unref (filenames);
+
+	/* only used when not asking for an instrument */
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, NULL,
+					CD_SENSOR_CAP_LCD_WHITE_LED, NULL);
+	g_assert_cmpint (filenames->len, ==, 3);
+	g_ptr_array_unref (filenames);
+
+	/* the second instrument, and a specific technology */
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, "colormunki-display",
+					CD_SENSOR_CAP_LCD_WHITE_LED, "DELL U2413");
+	g_assert_cmpint (filenames->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (filenames, 0), ==, filename_dell);
+	g_ptr_array_unref (filenames);
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, "ColorMunki Display",
+					CD_SENSOR_CAP_LCD, NULL);
+	g_assert_cmpint (filenames->len, ==, 1);
+	g_ptr_array_unref (filenames);
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCMX, "ColorMunki Display",
+					CD_SENSOR_CAP_CRT, NULL);
+	g_assert_cmpint (filenames->len, ==, 0);
+	g_ptr_array_unref (filenames);
+
+	/* spectral sets are for any instrument */
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCSS, "i1 DisplayPro",
+					CD_SENSOR_CAP_LCD, "test display model");
+	g_assert_cmpint (filenames->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (filenames, 0), ==, filename_ccss);
+	g_ptr_array_unref (filenames);
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_CCSS, NULL,
+					CD_SENSOR_CAP_PROJECTOR, NULL);
+	g_assert_cmpint (filenames->len, ==, 0);
+	g_ptr_array_unref (filenames);
+
+	/* all files, with the best display match first */
+	filenames = cd_it8_store_query (store, CD_IT8_KIND_UNKNOWN, NULL,
+					CD_SENSOR_CAP_UNKNOWN, "test display model");
+	g_assert_cmpint (filenames->len, ==, 4);
+	g_assert_cmpstr (g_ptr_array_index (filenames, 0), ==, filename_ccss);
+	g_ptr_array_unref (filenames);
+
+	/* the full file is only parsed once */
+	it8 = cd_it8_store_find (store, CD_IT8_KIND_CCMX, "Huey",
+				 CD_SENSOR_CAP_LCD, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (it8 != NULL);
+	matrix = cd_it8_get_matrix (it8);
+	g_assert_cmpfloat (ABS (matrix->m00 - 1.3139f), <, 0.01f);
+	it8_tmp = cd_it8_store_load (store, filename_huey, &error);
+	g_assert_no_error (error);
+	g_assert (it8_tmp == it8);
+	g_clear_object (&it8_tmp);
+	it8_tmp = cd_it8_store_find (store, CD_IT8_KIND_CCMX, "ColorHug",
+				     CD_SENSOR_CAP_LCD, NULL, &error);
+	g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_FAILED);
+	g_assert (it8_tmp == NULL);
+	g_clear_error (&error);
+
+	/* the same results come from the index */
+	store_index = cd_it8_store_new ();
+	ret = cd_it8_store_set_index (store_index, filename_index, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_it8_store_search_location (store_index, tmpdir, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_it8_store_get_size (store_index), ==, 4);
+	filenames = cd_it8_store_query (store_index, CD_IT8_KIND_CCMX, "i1 DisplayPro",
+					CD_SENSOR_CAP_LCD_WHITE_LED, NULL);
+	g_assert_cmpint (filenames->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (filenames, 0), ==, filename_dell);
+
+	/* remove temp files */
+	g_remove (filename_index);
+	g_free (filename_index);
+	filename_index = g_build_filename (tmpdir, "cache", NULL);
+	g_remove (filename_index);
+	g_remove (filename_deep);
+	g_remove (subdir_deep);
+	g_free (subdir_deep);
+	subdir_deep = g_build_filename (subdir, "a", NULL);
+	g_remove (subdir_deep);
+	g_remove (filename_dell);
+	g_remove (subdir);
+	g_remove (filename_generic);
+	g_remove (filename_bogus);
+	g_remove (filename_huey);
+	g_remove (filename_ccss);
+	ret = g_remove (tmpdir);
+	g_assert (!ret);
+}
+
 static void
 colord_it8_ccss_func (void)
 {
@@ -556,12 +910,89 @@ colord_it8_ccss_func (void)
 	g_object_unref (file);
 }
 
+static void
+colord_it8_reader_func (void)
+{
+	const gchar *data =
+		"CTI3   # comment\n"
+		"DESCRIPTOR \"Calibration Target chart information 3\"\n"
+		"KEYWORD \"TYPE_LCD\"\n"
+		"TYPE_LCD \"YES\"\n"
+		"NUMBER_OF_FIELDS 4\n"
+		"BEGIN_DATA_FORMAT\n"
+		"SAMPLE_ID RGB_R RGB_G RGB_B\n"
+		"END_DATA_FORMAT\n"
+		"NUMBER_OF_SETS 2\n"
+		"BEGIN_DATA\n"
+		"A1 0.1 0.2 0.3\n"
+		"A2 1.0 1.0\n"
+		"END_DATA\n";
+	const gchar *bad[] = {
+		"CCMX\nNUMBER_OF_FIELDS 4000000000\nBEGIN_DATA\n1 2 3\nEND_DATA\n",
+		"CCMX\nNUMBER_OF_FIELDS 3\nNUMBER_OF_SETS 4000000000\n"
+		"BEGIN_DATA\n1 2 3\nEND_DATA\n" };
+	gboolean ret;
+	gdouble values[4];
+	GPtrArray *props;
+	g_autoptr(CdIt8Reader) reader = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GError) error = NULL;
+
+	bytes = g_bytes_new_static (data, strlen (data));
+	reader = cd_it8_reader_new (bytes);
+	ret = cd_it8_reader_parse_header (reader, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* test header */
+	g_assert_cmpstr (cd_it8_reader_get_sheet_type (reader), ==, "CTI3");
+	g_assert_cmpstr (cd_it8_reader_get_property (reader, "DESCRIPTOR"), ==,
+			 "Calibration Target chart information 3");
+	g_assert_cmpstr (cd_it8_reader_get_property (reader, "TYPE_LCD"), ==, "YES");
+	g_assert_cmpstr (cd_it8_reader_get_property (reader, "KEYWORD"), ==, NULL);
+	props = cd_it8_reader_get_properties (reader);
+	g_assert_cmpint (props->len, ==, 4);
+	g_assert_cmpint (cd_it8_reader_get_number_of_fields (reader), ==, 4);
+	g_assert_cmpint (cd_it8_reader_get_number_of_sets (reader), ==, 2);
+	g_assert_cmpstr (cd_it8_reader_get_field_name (reader, 1), ==, "RGB_R");
+	g_assert_cmpint (cd_it8_reader_find_field (reader, "RGB_B"), ==, 3);
+	g_assert_cmpint (cd_it8_reader_find_field (reader, "XYZ_X"), ==, -1);
+
+	/* test first set */
+	ret = cd_it8_reader_next_set (reader, values, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (cd_it8_reader_get_string (reader, 0), ==, "A1");
+	g_assert_cmpfloat (ABS (values[1] - 0.1f), <, 0.001f);
+	g_assert_cmpfloat (ABS (values[3] - 0.3f), <, 0.001f);
+
+	/* the second set is truncated */
+	ret = cd_it8_reader_next_set (reader, values, &error);
+	g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_INVALID_FORMAT);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* absurd counts are rejected before anything is allocated */
+	for (guint i = 0; i < G_N_ELEMENTS (bad); i++) {
+		g_autoptr(CdIt8Reader) reader_bad = NULL;
+		g_autoptr(GBytes) bytes_bad = NULL;
+		bytes_bad = g_bytes_new_static (bad[i], strlen (bad[i]));
+		reader_bad = cd_it8_reader_new (bytes_bad);
+		ret = cd_it8_reader_parse_header (reader_bad, &error);
+		g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_INVALID_FORMAT);
+		g_assert (!ret);
+		g_clear_error (&error);
+	}
+}
+
 static void
 colord_it8_raw_func (void)
 {
 	CdColorRGB rgb;
 	CdColorXYZ xyz;
 	CdIt8 *it8;
+	const gdouble *data_rgb;
+	const gdouble *data_xyz;
 	gboolean ret;
 	gchar *data;
 	gchar *filename;
@@ -570,6 +1001,7 @@ colord_it8_raw_func (void)
 	GFile *file;
 	GFile *file_new;
 	gsize data_len;
+	guint size = 0;
 
 	it8 = cd_it8_new ();
 	g_assert (it8 != NULL);
@@ -620,6 +1052,17 @@ colord_it8_raw_func (void)
 	g_assert_cmpfloat (ABS (xyz.X - 145.46f), <, 0.01f);
 	g_assert_cmpfloat (ABS (xyz.Y - 99.88f), <, 0.01f);
 	g_assert_cmpfloat (ABS (xyz.Z - 116.59f), <, 0.01f);
+	ret = cd_it8_get_data_item (it8, 5, &rgb, &xyz);
+	g_assert (!ret);
+
+	/* test bulk values */
+	data_rgb = cd_it8_get_data_rgb (it8, &size);
+	g_assert (data_rgb != NULL);
+	g_assert_cmpint (size, ==, 5);
+	g_assert_cmpfloat (ABS (data_rgb[1 * 3 + 0] - 1.0f), <, 0.01f);
+	data_xyz = cd_it8_get_data_xyz (it8, NULL);
+	g_assert (data_xyz != NULL);
+	g_assert_cmpfloat (ABS (data_xyz[1 * 3 + 1] - 99.88f), <, 0.01f);
 
 	/* remove temp file */
 	ret = g_file_delete (file_new, NULL, &error);
@@ -674,6 +1117,63 @@ colord_it8_locale_func (void)
 	setlocale (LC_NUMERIC, orig_locale);
 }
 
+static void
+colord_it8_stream_func (void)
+{
+	CdColorRGB rgb;
+	CdColorXYZ xyz;
+	gboolean ret;
+	gsize data_len;
+	guint i;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *data_large = NULL;
+	g_autoptr(CdIt8) it8 = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOutputStream) stream = NULL;
+
+	/* check the float formatting, including the carry and slow path */
+	it8 = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	cd_it8_set_enable_created (it8, FALSE);
+	cd_color_rgb_set (&rgb, 0.5, 1.0 / 3.0, 0.0);
+	cd_color_xyz_set (&xyz, -2.25, 99.9999999999999, 10000000.0);
+	cd_it8_add_data (it8, &rgb, &xyz);
+	ret = cd_it8_save_to_data (it8, &data, &data_len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (data_len, ==, strlen (data));
+	g_assert_cmpstr (data, ==, "CTI3   \n"
+				   "DESCRIPTOR	\"Calibration Target chart information 3\"\n"
+				   "DEVICE_CLASS	\"DISPLAY\"\n"
+				   "COLOR_REP	\"RGB_XYZ\"\n"
+				   "INSTRUMENT_TYPE_SPECTRAL	\"NO\"\n"
+				   "NORMALIZED_TO_Y_100	\"NO\"\n"
+				   "NUMBER_OF_FIELDS	7\n"
+				   "NUMBER_OF_SETS	1\n"
+				   "BEGIN_DATA_FORMAT\n"
+				   " SAMPLE_ID	RGB_R	RGB_G	RGB_B	XYZ_X	XYZ_Y	XYZ_Z\n"
+				   "END_DATA_FORMAT\n"
+				   "BEGIN_DATA\n"
+				   " 1.0	0.5	0.333333333333	0.0	-2.25	100.0	10000000.0\n"
+				   "END_DATA\n");
+
+	/* a set larger than the write buffer matches the in-memory version */
+	for (i = 0; i < 5000; i++) {
+		cd_color_rgb_set (&rgb, i / 5000.f, 0.25f, 0.75f);
+		cd_color_xyz_set (&xyz, i * 0.1f, i * 0.01f, 1.f / (i + 1));
+		cd_it8_add_data (it8, &rgb, &xyz);
+	}
+	ret = cd_it8_save_to_data (it8, &data_large, &data_len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	stream = g_memory_output_stream_new_resizable ();
+	ret = cd_it8_save_to_stream (it8, stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)), ==, data_len);
+	g_assert (memcmp (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream)),
+			  data_large, data_len) == 0);
+}
+
 static void
 colord_it8_normalized_func (void)
 {
@@ -743,6 +1243,7 @@ colord_it8_ccmx_util_func (void)
 	CdIt8 *ref;
 	gboolean ret;
 	gchar *filename;
+	gdouble loo_error = -1.f;
 	g_autoptr(GError) error = NULL;
 	GFile *file;
 
@@ -772,11 +1273,81 @@ colord_it8_ccmx_util_func (void)
 	g_assert_no_error (error);
 	g_assert (ret);
 
+	/* calculate CCMX using every patch */
+	ret = cd_it8_utils_calculate_ccmx_lsq (ref, meas, NULL, ccmx, &loo_error, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (loo_error, >, 0.f);
+	g_assert_cmpfloat (loo_error, <, 10.f);
+
 	g_object_unref (ref);
 	g_object_unref (meas);
 	g_object_unref (ccmx);
 }
 
+static void
+colord_it8_ccmx_lsq_func (void)
+{
+	CdColorXYZ xyz;
+	CdMat3x3 mat;
+	const CdMat3x3 *tmp;
+	gboolean ret;
+	gdouble loo_error = -1.f;
+	gdouble weights[9];
+	guint i;
+	g_autoptr(CdIt8) ccmx = NULL;
+	g_autoptr(CdIt8) meas = NULL;
+	g_autoptr(CdIt8) ref = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* make the reference an exact transform of the measured values */
+	cd_mat33_init (&mat,
+		       1.1f, 0.1f, 0.0f,
+		       0.05f, 0.9f, 0.02f,
+		       0.0f, 0.03f, 1.2f);
+	ref = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	meas = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	for (i = 0; i < 8; i++) {
+		CdVec3 src;
+		CdVec3 dest;
+		cd_vec3_init (&src,
+			      10.f + i * 7.f,
+			      20.f + (i % 3) * 11.f,
+			      5.f + (i % 5) * 13.f);
+		cd_mat33_vector_multiply (&mat, &src, &dest);
+		cd_color_xyz_set (&xyz, src.v0, src.v1, src.v2);
+		cd_it8_add_data (meas, NULL, &xyz);
+		cd_color_xyz_set (&xyz, dest.v0, dest.v1, dest.v2);
+		cd_it8_add_data (ref, NULL, &xyz);
+		weights[i] = 1.f;
+	}
+
+	/* add a bad reading that is ignored */
+	cd_color_xyz_set (&xyz, 50.f, 50.f, 50.f);
+	cd_it8_add_data (meas, NULL, &xyz);
+	cd_color_xyz_set (&xyz, 10.f, 90.f, 10.f);
+	cd_it8_add_data (ref, NULL, &xyz);
+	weights[8] = 0.f;
+
+	ccmx = cd_it8_new_with_kind (CD_IT8_KIND_CCMX);
+	ret = cd_it8_utils_calculate_ccmx_lsq (ref, meas, weights, ccmx, &loo_error, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = cd_it8_get_matrix (ccmx);
+	g_assert_cmpfloat (ABS (tmp->m00 - 1.1f), <, 0.0001f);
+	g_assert_cmpfloat (ABS (tmp->m01 - 0.1f), <, 0.0001f);
+	g_assert_cmpfloat (ABS (tmp->m12 - 0.02f), <, 0.0001f);
+	g_assert_cmpfloat (ABS (tmp->m22 - 1.2f), <, 0.0001f);
+	g_assert_cmpfloat (loo_error, <, 0.0001f);
+
+	/* not enough patches */
+	for (i = 0; i < 9; i++)
+		weights[i] = i < 2 ? 1.f : 0.f;
+	ret = cd_it8_utils_calculate_ccmx_lsq (ref, meas, weights, ccmx, NULL, &error);
+	g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_FAILED);
+	g_assert (!ret);
+}
+
 static void
 colord_it8_ccmx_func (void)
 {
@@ -1006,6 +1577,13 @@ colord_enum_func (void)
 		g_assert_cmpint (enum_tmp, ==, i);
 	}
 #endif
+
+	/* out of range values and unknown strings use the first entry */
+	g_assert_cmpstr (cd_colorspace_to_string (CD_COLORSPACE_LAST), ==, "unknown");
+	g_assert_cmpint (cd_colorspace_from_string ("moo"), ==, CD_COLORSPACE_UNKNOWN);
+	g_assert_cmpint (cd_colorspace_from_string (NULL), ==, CD_COLORSPACE_UNKNOWN);
+	g_assert_cmpstr (cd_profile_quality_to_string (CD_PROFILE_QUALITY_LAST), ==, "high");
+	g_assert_cmpint (cd_profile_quality_from_string ("moo"), ==, CD_PROFILE_QUALITY_HIGH);
 }
 
 static void
@@ -1046,6 +1624,67 @@ colord_dom_func (void)
 	g_assert_cmpstr (cd_dom_get_node_attribute (tmp, "wrap"), ==, "false");
 }
 
+static gboolean
+colord_dom_stream_cb (CdDom *dom, const GNode *node, gpointer user_data, GError **error)
+{
+	GString *str = (GString *) user_data;
+	g_string_append (str, cd_dom_get_node_data (node));
+	return TRUE;
+}
+
+static void
+colord_dom_path_func (void)
+{
+	g_autoptr(CdDom) dom = NULL;
+	g_autoptr(CdDomPath) path = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) markup = NULL;
+	g_autoptr(GString) str = NULL;
+	const GNode *tmp;
+	gboolean ret;
+	guint i;
+
+	/* wide enough to use the child index */
+	markup = g_string_new ("<list>");
+	for (i = 0; i < 20; i++)
+		g_string_append_printf (markup, "<item%u>%u</item%u>", i, i, i);
+	g_string_append (markup, "<item5>dupe</item5></list>");
+
+	dom = cd_dom_new ();
+	ret = cd_dom_parse_xml_data (dom, markup->str, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = cd_dom_get_node (dom, NULL, "list/item19");
+	g_assert (tmp != NULL);
+	g_assert_cmpstr (cd_dom_get_node_data (tmp), ==, "19");
+	tmp = cd_dom_get_node (dom, NULL, "list/item5");
+	g_assert_cmpstr (cd_dom_get_node_data (tmp), ==, "5");
+	g_assert (cd_dom_get_node (dom, NULL, "list/item20") == NULL);
+	g_assert (cd_dom_get_node (dom, NULL, "list/") == NULL);
+
+	/* precompiled */
+	path = cd_dom_path_new ("list/item7");
+	tmp = cd_dom_get_node_for_path (dom, NULL, path);
+	g_assert (tmp != NULL);
+	g_assert_cmpstr (cd_dom_get_node_data (tmp), ==, "7");
+	g_clear_object (&dom);
+	g_clear_pointer (&path, cd_dom_path_free);
+
+	/* streaming, where matching nodes are not kept */
+	dom = cd_dom_new ();
+	path = cd_dom_path_new ("named/color/name");
+	str = g_string_new (NULL);
+	ret = cd_dom_parse_xml_data_stream (dom,
+					    "<named><color><name>a</name></color>"
+					    "<color><name>b</name></color></named>",
+					    -1, path, colord_dom_stream_cb, str, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (str->str, ==, "ab");
+	g_assert (cd_dom_get_node (dom, NULL, "named/color") != NULL);
+	g_assert (cd_dom_get_node (dom, NULL, "named/color/name") == NULL);
+}
+
 static void
 colord_dom_color_func (void)
 {
@@ -1125,7 +1764,12 @@ colord_dom_localized_func (void)
 static void
 colord_color_func (void)
 {
+	CdColorLab lab1;
+	CdColorLab lab2;
+	CdColorLab lab_src1[2];
+	CdColorLab lab_src2[2];
 	CdColorUVW uvw;
+	gdouble de[2];
 	g_autoptr(CdColorXYZ) xyz = NULL;
 	CdColorXYZ xyz_src;
 	CdColorYxy yxy;
@@ -1156,14 +1800,138 @@ colord_color_func (void)
 	g_assert_cmpfloat (ABS (xyz->X - 2.0), <, 0.01);
 	g_assert_cmpfloat (ABS (xyz->Y - 1.0), <, 0.01);
 	g_assert_cmpfloat (ABS (xyz->Z - 0.5), <, 0.01);
+
+	/* CIEDE2000, using a pair from the Sharma test data */
+	cd_color_lab_set (&lab1, 50.0000, 2.6772, -79.7751);
+	cd_color_lab_set (&lab2, 50.0000, 0.0000, -82.7485);
+	g_assert_cmpfloat (ABS (cd_color_lab_delta_e2000 (&lab1, &lab2) - 2.0425), <, 0.0001);
+	g_assert_cmpfloat (cd_color_lab_delta_e2000 (&lab1, &lab1), <, 0.0001);
+	g_assert_cmpfloat (ABS (cd_color_lab_delta_e94 (&lab1, &lab2) - 1.3950), <, 0.0001);
+	g_assert_cmpfloat (ABS (cd_color_lab_delta_e76 (&lab1, &lab2) - 4.0011), <, 0.0001);
+
+	/* the batch versions give the same answers */
+	lab_src1[0] = lab1;
+	lab_src1[1] = lab2;
+	lab_src2[0] = lab2;
+	lab_src2[1] = lab2;
+	cd_color_lab_delta_e76_array (lab_src1, lab_src2, de, 2);
+	g_assert_cmpfloat (ABS (de[0] - cd_color_lab_delta_e76 (&lab1, &lab2)), <, 0.0001);
+	g_assert_cmpfloat (de[1], <, 0.0001);
+	cd_color_lab_delta_e94_array (lab_src1, lab_src2, de, 2);
+	g_assert_cmpfloat (ABS (de[0] - cd_color_lab_delta_e94 (&lab1, &lab2)), <, 0.0001);
+	g_assert_cmpfloat (de[1], <, 0.0001);
+	cd_color_lab_delta_e2000_array (lab_src1, lab_src2, de, 2);
+	g_assert_cmpfloat (ABS (de[0] - cd_color_lab_delta_e2000 (&lab1, &lab2)), <, 0.0001);
+	g_assert_cmpfloat (de[1], <, 0.0001);
+}
+
+
+static void
+colord_color_array_func (void)
+{
+	CdColorLab lab[3];
+	CdColorUVW uvw[3];
+	CdColorUVW uvw_tmp;
+	CdColorXYZ wp;
+	CdColorXYZ xyz[3];
+	CdColorXYZ xyz_tmp[3];
+	CdColorYxy yxy[3];
+	CdColorYxy yxy_tmp;
+	gdouble cct[3];
+	guint i;
+
+	cd_color_xyz_set (&wp, 0.9642, 1.0, 0.8249);
+	cd_color_xyz_set (&xyz[0], 0.2, 0.3, 0.4);
+	cd_color_xyz_set (&xyz[1], 0.0, 0.0, 0.0);
+	cd_color_xyz_copy (&wp, &xyz[2]);
+
+	/* Yxy matches the single color versions */
+	cd_color_xyz_to_yxy_array (xyz, yxy, 3);
+	for (i = 0; i < 3; i++) {
+		cd_color_xyz_to_yxy (&xyz[i], &yxy_tmp);
+		g_assert_cmpfloat (ABS (yxy[i].x - yxy_tmp.x), <, 0.0001);
+		g_assert_cmpfloat (ABS (yxy[i].y - yxy_tmp.y), <, 0.0001);
+		g_assert_cmpfloat (ABS (yxy[i].Y - yxy_tmp.Y), <, 0.0001);
+	}
+	cd_color_yxy_to_xyz_array (yxy, xyz_tmp, 3);
+	for (i = 0; i < 3; i++) {
+		g_assert_cmpfloat (ABS (xyz_tmp[i].X - xyz[i].X), <, 0.0001);
+		g_assert_cmpfloat (ABS (xyz_tmp[i].Z - xyz[i].Z), <, 0.0001);
+	}
+
+	/* Lab, where the whitepoint itself is neutral */
+	cd_color_xyz_to_lab_array (xyz, &wp, lab, 3);
+	g_assert_cmpfloat (ABS (lab[0].L - 61.654), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[0].a - -38.740), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[0].b - -23.240), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[1].L), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[2].L - 100.0), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[2].a), <, 0.001);
+	g_assert_cmpfloat (ABS (lab[2].b), <, 0.001);
+	cd_color_lab_to_xyz_array (lab, &wp, xyz_tmp, 3);
+	for (i = 0; i < 3; i++) {
+		g_assert_cmpfloat (ABS (xyz_tmp[i].X - xyz[i].X), <, 0.0001);
+		g_assert_cmpfloat (ABS (xyz_tmp[i].Y - xyz[i].Y), <, 0.0001);
+		g_assert_cmpfloat (ABS (xyz_tmp[i].Z - xyz[i].Z), <, 0.0001);
+	}
+
+	/* UVW and CCT, skipping black which has no chromaticity */
+	cd_color_xyz_to_uvw_array (xyz, &wp, uvw, 3);
+	cd_color_xyz_to_cct_array (xyz, cct, 3);
+	for (i = 0; i < 3; i += 2) {
+		cd_color_xyz_to_uvw (&xyz[i], &wp, &uvw_tmp);
+		g_assert_cmpfloat (ABS (uvw[i].U - uvw_tmp.U), <, 0.0001);
+		g_assert_cmpfloat (ABS (uvw[i].V - uvw_tmp.V), <, 0.0001);
+		g_assert_cmpfloat (ABS (uvw[i].W - uvw_tmp.W), <, 0.0001);
+		g_assert_cmpfloat (ABS (cct[i] - cd_color_xyz_to_cct (&xyz[i])), <, 0.0001);
+	}
 }
 
+static void
+colord_color_cct_func (void)
+{
+	CdColorUVW uvw;
+	CdColorXYZ xyz[3];
+	gdouble cct[3];
+	gdouble duv[3];
+	gdouble sum;
+	gdouble tmp;
+
+	/* D65 sits slightly above the locus */
+	cd_color_xyz_set (&xyz[0], 0.95047, 1.0, 1.08883);
+	tmp = cd_color_xyz_to_cct_duv (&xyz[0], &duv[0]);
+	g_assert_cmpfloat (ABS (tmp - 6504), <, 5);
+	g_assert_cmpfloat (ABS (duv[0] - 0.0032), <, 0.0002);
+
+	/* a point on the locus itself */
+	cd_color_uvw_set_planckian_locus (&uvw, 4000);
+	sum = 2 * uvw.U - 8 * uvw.V + 4;
+	cd_color_xyz_set (&xyz[1],
+			  3 * uvw.U / (2 * uvw.V),
+			  1.0,
+			  (sum - 3 * uvw.U - 2 * uvw.V) / (2 * uvw.V));
+	tmp = cd_color_xyz_to_cct_duv (&xyz[1], &duv[1]);
+	g_assert_cmpfloat (ABS (tmp - 4000), <, 1);
+	g_assert_cmpfloat (ABS (duv[1]), <, 0.0001);
+
+	/* too red */
+	cd_color_xyz_set (&xyz[2], 1.0, 0.2, 0.0);
+	g_assert_cmpfloat (cd_color_xyz_to_cct_duv (&xyz[2], NULL), <, 0);
+
+	/* batch */
+	cd_color_xyz_to_cct_duv_array (xyz, cct, duv, 3);
+	g_assert_cmpfloat (ABS (cct[0] - 6504), <, 5);
+	g_assert_cmpfloat (ABS (cct[1] - 4000), <, 1);
+	g_assert_cmpfloat (cct[2], <, 0);
+}
 
 static void
 cd_test_math_func (void)
 {
 	CdMat3x3 mat = { 0 };
 	CdMat3x3 matsrc = { 0 };
+	CdVec3 vecs[4];
+	guint i;
 
 	/* matrix */
 	mat.m00 = 1.00f;
@@ -1183,11 +1951,24 @@ cd_test_math_func (void)
 	g_assert_cmpfloat (mat.m11, >, 3.9f);
 	g_assert_cmpfloat (mat.m22, <, 0.001f);
 	g_assert_cmpfloat (mat.m22, >, -0.001f);
+
+	/* multiply many vectors, in place */
+	cd_mat33_init (&mat, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+	for (i = 0; i < 4; i++)
+		cd_vec3_init (&vecs[i], i, 1, 0);
+	cd_mat33_vector_multiply_many (&mat, vecs, vecs, 4);
+	for (i = 0; i < 4; i++) {
+		g_assert_cmpfloat (ABS (vecs[i].v0 - (1 * i + 2)), <, 0.001f);
+		g_assert_cmpfloat (ABS (vecs[i].v1 - (4 * i + 5)), <, 0.001f);
+		g_assert_cmpfloat (ABS (vecs[i].v2 - (7 * i + 8)), <, 0.001f);
+	}
 }
 
 static void
 colord_color_interpolate_func (void)
 {
+	g_autoptr(GArray) flat = NULL;
+	g_autoptr(GArray) result_flat = NULL;
 	g_autoptr(GPtrArray) array = NULL;
 	g_autoptr(GPtrArray) result = NULL;
 	guint i;
@@ -1207,6 +1988,20 @@ colord_color_interpolate_func (void)
 	result = cd_color_rgb_array_interpolate (array, 10);
 	g_assert (result != NULL);
 	g_assert_cmpint (result->len, ==, 10);
+	g_assert (cd_color_rgb_array_is_monotonic (result));
+
+	/* the contiguous version gives the same values */
+	flat = cd_color_rgb_garray_from_array (array);
+	g_assert_cmpint (flat->len, ==, array->len);
+	result_flat = cd_color_rgb_garray_interpolate (flat, 10);
+	g_assert (result_flat != NULL);
+	g_assert_cmpint (result_flat->len, ==, 10);
+	g_assert (cd_color_rgb_garray_is_monotonic (result_flat));
+	for (i = 0; i < result->len; i++) {
+		rgb = g_ptr_array_index (result, i);
+		g_assert_cmpfloat (ABS (rgb->R - g_array_index (result_flat, CdColorRGB, i).R), <, 0.0001);
+		g_assert_cmpfloat (ABS (rgb->B - g_array_index (result_flat, CdColorRGB, i).B), <, 0.0001);
+	}
 }
 
 static void
@@ -1340,6 +2135,8 @@ colord_interp_akima_func (void)
 	g_autoptr(GError) error = NULL;
 	guint i;
 	guint new_length = 10;
+	gdouble xs[20];
+	gdouble ys[20];
 	const gdouble data[] = { 0.100000, 0.232810, 0.329704, 0.372559,
 				 0.370252, 0.470252, 0.672559, 0.829704,
 				 0.932810, 1.000000 };
@@ -1369,6 +2166,71 @@ colord_interp_akima_func (void)
 		g_assert_cmpfloat (y, <, data[i] + 0.01);
 		g_assert_cmpfloat (y, >, data[i] - 0.01);
 	}
+
+	/* check values in one pass, in both directions */
+	for (i = 0; i < new_length; i++) {
+		xs[i] = (gdouble) i / (gdouble) (new_length - 1);
+		xs[new_length * 2 - i - 1] = xs[i];
+	}
+	ret = cd_interp_eval_many (interp, xs, ys, new_length * 2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < new_length; i++) {
+		g_assert_cmpfloat (ys[i], <, data[i] + 0.01);
+		g_assert_cmpfloat (ys[i], >, data[i] - 0.01);
+		g_assert_cmpfloat (ys[new_length * 2 - i - 1], ==, ys[i]);
+	}
+}
+
+static void
+colord_interp_monotone_func (void)
+{
+	g_autoptr(CdInterp) interp = NULL;
+	gboolean ret;
+	gdouble y;
+	g_autoptr(GError) error = NULL;
+	guint i;
+	gdouble xs[100];
+	gdouble ys[100];
+
+	/* check name */
+	interp = cd_interp_monotone_new ();
+	g_assert_cmpint (cd_interp_get_kind (interp), ==, CD_INTERP_KIND_MONOTONE);
+	g_assert_cmpstr (cd_interp_kind_to_string (cd_interp_get_kind (interp)), ==, "monotone");
+
+	/* insert the data that makes Akima overshoot */
+	cd_interp_insert (interp, 0.00, 0.10);
+	cd_interp_insert (interp, 0.25, 0.35);
+	cd_interp_insert (interp, 0.50, 0.40);
+	cd_interp_insert (interp, 0.75, 0.80);
+	cd_interp_insert (interp, 1.00, 1.00);
+
+	/* prepare */
+	ret = cd_interp_prepare (interp, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* passes through the points */
+	y = cd_interp_eval (interp, 0.5, &error);
+	g_assert_no_error (error);
+	g_assert_cmpfloat (ABS (y - 0.40), <, 0.0001);
+
+	/* the result is monotonic */
+	for (i = 0; i < 100; i++)
+		xs[i] = (gdouble) i / 99.f;
+	ret = cd_interp_eval_many (interp, xs, ys, 100, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 1; i < 100; i++)
+		g_assert_cmpfloat (ys[i], >=, ys[i - 1]);
+	g_assert_cmpfloat (ABS (ys[99] - 1.00), <, 0.0001);
+
+	/* the same as evaluating each point */
+	for (i = 0; i < 100; i++) {
+		y = cd_interp_eval (interp, xs[i], &error);
+		g_assert_no_error (error);
+		g_assert_cmpfloat (ABS (y - ys[i]), <, 0.0001);
+	}
 }
 
 static void
@@ -1387,6 +2249,51 @@ colord_buffer_func (void)
 	g_assert_cmpint (cd_buffer_read_uint16_le (buffer), ==, 8192);
 }
 
+static void
+colord_buffer_array_func (void)
+{
+	const guint16 values16[3] = { 0x0102, 0x0304, 0xff00 };
+	const guint32 values32[3] = { 0x01020304, 0x05060708, 0xff000000 };
+	guint8 buffer[13];
+	guint16 dest16[3];
+	guint32 dest32[3];
+	guint i;
+
+	/* use an unaligned buffer */
+	cd_buffer_write_uint16_be_array (buffer + 1, values16, 3);
+	g_assert_cmpint (buffer[1], ==, 0x01);
+	g_assert_cmpint (buffer[2], ==, 0x02);
+	g_assert_cmpint (buffer[5], ==, 0xff);
+	cd_buffer_read_uint16_be_array (buffer + 1, dest16, 3);
+	for (i = 0; i < 3; i++)
+		g_assert_cmpint (dest16[i], ==, cd_buffer_read_uint16_be (buffer + 1 + i * 2));
+	g_assert (memcmp (dest16, values16, sizeof (values16)) == 0);
+
+	cd_buffer_write_uint16_le_array (buffer + 1, values16, 3);
+	g_assert_cmpint (buffer[1], ==, 0x02);
+	g_assert_cmpint (buffer[2], ==, 0x01);
+	cd_buffer_read_uint16_le_array (buffer + 1, dest16, 3);
+	g_assert (memcmp (dest16, values16, sizeof (values16)) == 0);
+
+	cd_buffer_write_uint32_be_array (buffer + 1, values32, 3);
+	g_assert_cmpint (buffer[1], ==, 0x01);
+	g_assert_cmpint (buffer[4], ==, 0x04);
+	g_assert_cmpint (buffer[9], ==, 0xff);
+	cd_buffer_read_uint32_be_array (buffer + 1, dest32, 3);
+	for (i = 0; i < 3; i++)
+		g_assert_cmpint (dest32[i], ==, cd_buffer_read_uint32_be (buffer + 1 + i * 4));
+	g_assert (memcmp (dest32, values32, sizeof (values32)) == 0);
+
+	cd_buffer_write_uint32_le_array (buffer + 1, values32, 3);
+	g_assert_cmpint (buffer[1], ==, 0x04);
+	g_assert_cmpint (buffer[12], ==, 0xff);
+	cd_buffer_read_uint32_le_array (buffer + 1, dest32, 3);
+	g_assert (memcmp (dest32, values32, sizeof (values32)) == 0);
+
+	/* nothing to do */
+	cd_buffer_read_uint32_le_array (NULL, NULL, 0);
+}
+
 /* 1. create a valid profile with metadata and model and save it
  * 2. open profile, delete meta and dscm tags, and resave
  * 3. open profile and verify meta and dscm information is not present */
@@ -1449,7 +2356,9 @@ colord_icc_clear_func (void)
 static void
 colord_icc_func (void)
 {
+	CdColorRGB *rgb_new;
 	CdIcc *icc;
+	CdIcc *icc_tmp;
 	const CdColorRGB *rgb_tmp;
 	const CdColorXYZ *xyz_tmp;
 	const gchar *str;
@@ -1464,6 +2373,10 @@ colord_icc_func (void)
 	GHashTable *metadata;
 	gpointer handle;
 	GPtrArray *array;
+	guint i;
+	guint16 ramp_red[256];
+	guint16 ramp_green[256];
+	guint16 ramp_blue[256];
 
 	/* test invalid */
 	icc = cd_icc_new ();
@@ -1511,6 +2424,26 @@ colord_icc_func (void)
 	g_assert_cmpfloat (rgb_tmp->R, >, 0.98);
 	g_assert_cmpfloat (rgb_tmp->G, >, 0.98);
 	g_assert_cmpfloat (rgb_tmp->B, >, 0.08);
+
+	/* the gamma ramp version is close to the evaluated curve */
+	ret = cd_icc_get_vcgt_uint16 (icc, 256, ramp_red, ramp_green, ramp_blue, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < 256; i++) {
+		rgb_tmp = g_ptr_array_index (array, i);
+		g_assert_cmpint (ABS ((gint) ramp_red[i] - (gint) (rgb_tmp->R * 0xffff)), <, 0x100);
+		g_assert_cmpint (ABS ((gint) ramp_green[i] - (gint) (rgb_tmp->G * 0xffff)), <, 0x100);
+		g_assert_cmpint (ABS ((gint) ramp_blue[i] - (gint) (rgb_tmp->B * 0xffff)), <, 0x100);
+	}
+	g_ptr_array_unref (array);
+
+	/* a single entry is still allowed */
+	array = cd_icc_get_vcgt (icc, 1, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	rgb_tmp = g_ptr_array_index (array, 0);
+	g_assert_cmpfloat (rgb_tmp->R, <, 0.02);
 	g_ptr_array_unref (array);
 
 	/* check profile properties */
@@ -1547,6 +2480,45 @@ colord_icc_func (void)
 	g_assert_cmpint (warnings->len, ==, 0);
 	g_array_unref (warnings);
 
+	/* denser sampling finds nothing more on a good profile */
+	warnings = cd_icc_get_warnings_full (icc, 256);
+	g_assert_cmpint (warnings->len, ==, 0);
+	g_array_unref (warnings);
+
+	/* the cached warnings are not used once the profile is modified */
+	icc_tmp = cd_icc_new ();
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	ret = cd_icc_load_file (icc_tmp, file, CD_ICC_LOAD_FLAGS_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (file);
+	g_free (filename);
+	warnings = cd_icc_get_warnings (icc_tmp);
+	g_assert_cmpint (warnings->len, ==, 0);
+	g_array_unref (warnings);
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_color_rgb_free);
+	for (i = 0; i < 16; i++) {
+		rgb_new = cd_color_rgb_new ();
+		cd_color_rgb_set (rgb_new, 1.f - i / 15.f, 1.f - i / 15.f, 1.f - i / 15.f);
+		g_ptr_array_add (array, rgb_new);
+	}
+	ret = cd_icc_set_vcgt (icc_tmp, array, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_ptr_array_unref (array);
+	warnings = cd_icc_get_warnings (icc_tmp);
+	g_assert_cmpint (warnings->len, ==, 1);
+	g_assert_cmpint (g_array_index (warnings, CdProfileWarning, 0), ==,
+			 CD_PROFILE_WARNING_VCGT_NON_MONOTONIC);
+	g_array_unref (warnings);
+	warnings = cd_icc_get_warnings_full (icc_tmp, 64);
+	g_assert_cmpint (warnings->len, ==, 1);
+	g_assert_cmpint (g_array_index (warnings, CdProfileWarning, 0), ==,
+			 CD_PROFILE_WARNING_VCGT_NON_MONOTONIC);
+	g_array_unref (warnings);
+	g_object_unref (icc_tmp);
+
 	/* marshall to a string */
 	tmp = cd_icc_to_string (icc);
 	g_assert_cmpstr (tmp, !=, NULL);
@@ -1601,6 +2573,78 @@ colord_icc_edid_func (void)
 	g_object_unref (icc);
 }
 
+static void
+colord_icc_edid_cache_func (void)
+{
+	const gchar *fn;
+	gboolean ret;
+	gsize length = 0;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *filename_cache = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(CdEdid) edid = NULL;
+	g_autoptr(CdIcc) icc1 = NULL;
+	g_autoptr(CdIcc) icc2 = NULL;
+	g_autoptr(CdIcc) icc3 = NULL;
+	g_autoptr(GBytes) data_edid = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) cache_dir = NULL;
+
+	/* parse an EDID */
+	filename = cd_test_get_filename ("LG-L225W-External.bin");
+	ret = g_file_get_contents (filename, &data, &length, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	data_edid = g_bytes_new (data, length);
+	edid = cd_edid_new ();
+	ret = cd_edid_parse (edid, data_edid, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	cache_dir = g_file_new_for_path (tmpdir);
+
+	/* generate the profile, which is saved */
+	icc1 = cd_icc_new ();
+	ret = cd_icc_create_from_edid_data_cached (icc1, edid, cache_dir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	dir = g_dir_open (tmpdir, 0, &error);
+	g_assert_no_error (error);
+	fn = g_dir_read_name (dir);
+	g_assert (fn != NULL);
+	filename_cache = g_build_filename (tmpdir, fn, NULL);
+	g_assert (g_dir_read_name (dir) == NULL);
+
+	/* load the profile from the cache */
+	icc2 = cd_icc_new ();
+	ret = cd_icc_create_from_edid_data_cached (icc2, edid, cache_dir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (cd_icc_get_metadata_item (icc2, CD_PROFILE_METADATA_EDID_MD5), ==,
+			 cd_edid_get_checksum (edid));
+	g_assert_cmpstr (cd_icc_get_metadata_item (icc2, CD_PROFILE_METADATA_DATA_SOURCE), ==,
+			 CD_PROFILE_METADATA_DATA_SOURCE_EDID);
+
+	/* a corrupt cache is regenerated */
+	ret = g_file_set_contents (filename_cache, "hello", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc3 = cd_icc_new ();
+	ret = cd_icc_create_from_edid_data_cached (icc3, edid, cache_dir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (cd_icc_get_metadata_item (icc3, CD_PROFILE_METADATA_EDID_MD5), ==,
+			 cd_edid_get_checksum (edid));
+
+	/* remove the cache */
+	g_assert_cmpint (g_remove (filename_cache), ==, 0);
+	g_assert_cmpint (g_remove (tmpdir), ==, 0);
+}
+
 static void
 colord_icc_characterization_func (void)
 {
@@ -1635,6 +2679,182 @@ colord_icc_characterization_func (void)
 	g_object_unref (icc);
 }
 
+static void
+colord_icc_release_handle_func (void)
+{
+	const gchar *tmp;
+	gboolean ret;
+	g_autofree gchar *filename = NULL;
+	g_auto(GStrv) tags = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GArray) warnings = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	icc = cd_icc_new ();
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_METADATA, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the descriptor still works without the handle */
+	g_assert (cd_icc_release_handle (icc));
+	g_assert (!cd_icc_release_handle (icc));
+	tmp = cd_icc_get_description (icc, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (tmp, ==, "Huey, LENOVO - 6464Y1H - 15\" (2009-12-23)");
+	tags = cd_icc_get_tags (icc, &error);
+	g_assert_no_error (error);
+	g_assert (tags != NULL && tags[0] != NULL);
+	warnings = cd_icc_get_warnings (icc);
+	g_assert (warnings != NULL);
+	g_assert_cmpint (cd_icc_get_kind (icc), ==, CD_PROFILE_KIND_DISPLAY_DEVICE);
+
+	/* reloaded on demand */
+	g_assert (cd_icc_get_handle (icc) != NULL);
+	g_assert (cd_icc_release_handle (icc));
+}
+
+static gint
+colord_icc_named_colors_sort_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble de_a = *((const gdouble *) a);
+	gdouble de_b = *((const gdouble *) b);
+	if (de_a < de_b)
+		return -1;
+	if (de_a > de_b)
+		return 1;
+	return 0;
+}
+
+static void
+colord_icc_named_colors_func (void)
+{
+	cmsHPROFILE lcms_profile;
+	cmsNAMEDCOLORLIST *nc2;
+	cmsUInt32Number len = 0;
+	const CdColorSwatch *swatch_tmp;
+	gboolean ret;
+	const guint n_colors = 500;
+	g_autofree guint8 *data = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GRand) rand = g_rand_new_with_seed (0);
+
+	/* a color book of random colors */
+	lcms_profile = cmsCreateLab4Profile (NULL);
+	cmsSetDeviceClass (lcms_profile, cmsSigNamedColorClass);
+	nc2 = cmsAllocNamedColorList (NULL, n_colors, 0, "", "");
+	for (guint i = 0; i < n_colors; i++) {
+		cmsCIELab lab;
+		cmsUInt16Number pcs[3];
+		g_autofree gchar *name = g_strdup_printf ("Color %u", i);
+		lab.L = g_rand_double_range (rand, 0.f, 100.f);
+		lab.a = g_rand_double_range (rand, -100.f, 100.f);
+		lab.b = g_rand_double_range (rand, -100.f, 100.f);
+		cmsFloat2LabEncoded (pcs, &lab);
+		g_assert (cmsAppendNamedColor (nc2, name, pcs, NULL));
+	}
+	g_assert (cmsWriteTag (lcms_profile, cmsSigNamedColor2Tag, nc2));
+	cmsFreeNamedColorList (nc2);
+	g_assert (cmsSaveProfileToMem (lcms_profile, NULL, &len));
+	data = g_malloc (len);
+	g_assert (cmsSaveProfileToMem (lcms_profile, data, &len));
+	cmsCloseProfile (lcms_profile);
+
+	icc = cd_icc_new ();
+	ret = cd_icc_load_data (icc, data, len, CD_ICC_LOAD_FLAGS_NAMED_COLORS, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = cd_icc_get_named_colors (icc);
+	g_assert_cmpint (array->len, ==, n_colors);
+
+	/* by name */
+	g_assert (cd_icc_get_named_color_by_name (icc, "Color 42") ==
+		  g_ptr_array_index (array, 42));
+	g_assert (cd_icc_get_named_color_by_name (icc, "Color 999") == NULL);
+
+	/* the nearest match agrees with comparing every color */
+	for (guint j = 0; j < 20; j++) {
+		CdColorLab lab;
+		g_autofree gdouble *de_all = g_new (gdouble, n_colors);
+		g_autoptr(GPtrArray) nearest = NULL;
+
+		cd_color_lab_set (&lab,
+				  g_rand_double_range (rand, 0.f, 100.f),
+				  g_rand_double_range (rand, -100.f, 100.f),
+				  g_rand_double_range (rand, -100.f, 100.f));
+		for (guint i = 0; i < n_colors; i++) {
+			CdColorSwatch *swatch = g_ptr_array_index (array, i);
+			de_all[i] = cd_color_lab_delta_e2000 (&lab, cd_color_swatch_get_value (swatch));
+		}
+		qsort (de_all, n_colors, sizeof (gdouble), colord_icc_named_colors_sort_cb);
+		nearest = cd_icc_get_named_colors_nearest (icc, &lab, 5);
+		g_assert_cmpint (nearest->len, ==, 5);
+		for (guint i = 0; i < nearest->len; i++) {
+			CdColorSwatch *swatch = g_ptr_array_index (nearest, i);
+			gdouble de = cd_color_lab_delta_e2000 (&lab, cd_color_swatch_get_value (swatch));
+			g_assert_cmpfloat (ABS (de - de_all[i]), <, 0.0001);
+		}
+	}
+
+	/* asking for more than there are */
+	swatch_tmp = cd_icc_get_named_color_by_name (icc, "Color 0");
+	g_ptr_array_unref (array);
+	array = cd_icc_get_named_colors_nearest (icc,
+						 cd_color_swatch_get_value (swatch_tmp),
+						 n_colors + 1);
+	g_assert_cmpint (array->len, ==, n_colors);
+	g_assert (g_ptr_array_index (array, 0) == swatch_tmp);
+}
+
+static gpointer
+colord_icc_threads_cb (gpointer user_data)
+{
+	CdIcc *icc = CD_ICC (user_data);
+	g_autoptr(GArray) warnings = NULL;
+
+	g_assert (cd_icc_get_handle (icc) != NULL);
+	warnings = cd_icc_get_warnings (icc);
+	g_assert (warnings != NULL);
+	cd_icc_get_copyright (icc, NULL, NULL);
+	return (gpointer) cd_icc_get_description (icc, "en_GB", NULL);
+}
+
+static void
+colord_icc_threads_func (void)
+{
+	GThread *threads[8];
+	const gchar *tmp = NULL;
+	gboolean ret;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	icc = cd_icc_new ();
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_METADATA, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_icc_release_handle (icc));
+
+	/* every reader gets the same cached value */
+	for (guint i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("icc", colord_icc_threads_cb, icc);
+	for (guint i = 0; i < G_N_ELEMENTS (threads); i++) {
+		const gchar *value = g_thread_join (threads[i]);
+		g_assert (value != NULL);
+		if (tmp == NULL)
+			tmp = value;
+		g_assert (value == tmp);
+	}
+	g_assert (cd_icc_get_description (icc, "en_GB", NULL) == tmp);
+}
+
 static void
 colord_icc_empty_func (void)
 {
@@ -1664,7 +2884,9 @@ static void
 colord_icc_corrupt_dict_func (void)
 {
 	CdIcc *icc;
+	g_autoptr(CdIcc) icc_ok = NULL;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
 	gboolean ret;
 	gchar *filename;
 	int fd;
@@ -1685,6 +2907,16 @@ colord_icc_corrupt_dict_func (void)
 	ret = g_close (fd, &error);
 	g_assert_no_error (error);
 	g_assert (ret);
+	g_free (filename);
+
+	/* the error does not leak into another profile on the shared context */
+	icc_ok = cd_icc_new ();
+	g_assert (cd_icc_get_context (icc_ok) == cd_icc_get_context (icc));
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	ret = cd_icc_load_file (icc_ok, file, CD_ICC_LOAD_FLAGS_ALL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
 
 	g_free (filename);
 	g_object_unref (icc);
@@ -1761,6 +2993,11 @@ colord_icc_save_func (void)
 	str = cd_icc_get_description (icc, "fr.UTF-8", &error);
 	g_assert_no_error (error);
 	g_assert_cmpstr (str, ==, "Couleurs crayon");
+
+	/* the default was never read before saving, but is kept */
+	str = cd_icc_get_description (icc, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (str, ==, "Huey, LENOVO - 6464Y1H - 15\" (2009-12-23)");
 	str = cd_icc_get_characterization_data (icc);
 	g_assert_cmpstr (str, ==, "[TI3]");
 
@@ -1776,6 +3013,149 @@ colord_icc_save_func (void)
 	g_object_unref (icc);
 }
 
+static void
+colord_icc_save_stream_func (void)
+{
+	gboolean ret;
+	cmsUInt8Number profile_id[16];
+	cmsUInt8Number profile_id_lcms[16];
+	const gchar *str;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIcc) icc_new = NULL;
+	g_autoptr(GBytes) data = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GOutputStream) stream = NULL;
+
+	icc = cd_icc_new ();
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_METADATA, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cd_icc_add_metadata (icc, "SelfTest", "true");
+	cd_icc_set_description (icc, "fr.UTF-8", "Couleurs crayon");
+
+	/* write to a stream that cannot seek */
+	stream = g_memory_output_stream_new_resizable ();
+	ret = cd_icc_save_stream (icc, stream, CD_ICC_SAVE_FLAGS_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_output_stream_close (stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	data = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+
+	/* parse it again */
+	icc_new = cd_icc_new ();
+	ret = cd_icc_load_data (icc_new,
+				g_bytes_get_data (data, NULL),
+				g_bytes_get_size (data),
+				CD_ICC_LOAD_FLAGS_METADATA |
+				CD_ICC_LOAD_FLAGS_TRANSLATIONS,
+				&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_icc_get_size (icc_new), ==, g_bytes_get_size (data));
+	g_assert_cmpstr (cd_icc_get_metadata_item (icc_new, "SelfTest"), ==, "true");
+	str = cd_icc_get_description (icc_new, "fr.UTF-8", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (str, ==, "Couleurs crayon");
+	str = cd_icc_get_description (icc_new, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (str, ==, "Huey, LENOVO - 6464Y1H - 15\" (2009-12-23)");
+
+	/* the profile ID matches what lcms calculates */
+	cmsGetHeaderProfileID (cd_icc_get_handle (icc_new), profile_id);
+	ret = cmsMD5computeID (cd_icc_get_handle (icc_new));
+	g_assert (ret);
+	cmsGetHeaderProfileID (cd_icc_get_handle (icc_new), profile_id_lcms);
+	g_assert (memcmp (profile_id, profile_id_lcms, 16) == 0);
+
+	/* translations that were loaded up front but never read are kept */
+	g_object_unref (icc_new);
+	icc_new = cd_icc_new ();
+	ret = cd_icc_load_data (icc_new,
+				g_bytes_get_data (data, NULL),
+				g_bytes_get_size (data),
+				CD_ICC_LOAD_FLAGS_TRANSLATIONS,
+				&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_bytes_unref (data);
+	data = cd_icc_save_data (icc_new, CD_ICC_SAVE_FLAGS_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (data != NULL);
+	g_object_unref (icc_new);
+	icc_new = cd_icc_new ();
+	ret = cd_icc_load_data (icc_new,
+				g_bytes_get_data (data, NULL),
+				g_bytes_get_size (data),
+				CD_ICC_LOAD_FLAGS_NONE,
+				&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	str = cd_icc_get_description (icc_new, "fr.UTF-8", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (str, ==, "Couleurs crayon");
+}
+
+static void
+colord_icc_peek_func (void)
+{
+	gboolean ret;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIcc) icc_full = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	icc_full = cd_icc_new ();
+	ret = cd_icc_load_file (icc_full, file, CD_ICC_LOAD_FLAGS_METADATA, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* only parse the header */
+	icc = cd_icc_new ();
+	ret = cd_icc_peek_file (icc, file, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_icc_get_handle (icc) == NULL);
+	g_assert_cmpstr (cd_icc_get_filename (icc), ==, filename);
+	g_assert_cmpint (cd_icc_get_size (icc), ==, cd_icc_get_size (icc_full));
+	g_assert_cmpint (cd_icc_get_kind (icc), ==, cd_icc_get_kind (icc_full));
+	g_assert_cmpint (cd_icc_get_colorspace (icc), ==, cd_icc_get_colorspace (icc_full));
+	g_assert_cmpfloat_with_epsilon (cd_icc_get_version (icc),
+					cd_icc_get_version (icc_full), 0.001);
+	g_assert_cmpstr (cd_icc_get_checksum (icc), ==, cd_icc_get_checksum (icc_full));
+	g_assert_cmpstr (cd_icc_get_description (icc, NULL, NULL), ==,
+			 cd_icc_get_description (icc_full, NULL, NULL));
+	g_assert_cmpstr (cd_icc_get_metadata_item (icc, "EDID_md5"), ==,
+			 cd_icc_get_metadata_item (icc_full, "EDID_md5"));
+	g_assert (cd_icc_get_metadata_item (icc, "EDID_md5") != NULL);
+
+	/* tags other than the description need a full load */
+	g_assert_cmpstr (cd_icc_get_copyright (icc, NULL, &error), ==, NULL);
+	g_assert_error (error, CD_ICC_ERROR, CD_ICC_ERROR_NO_DATA);
+	g_clear_error (&error);
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_icc_get_handle (icc) != NULL);
+	g_assert_cmpstr (cd_icc_get_copyright (icc, NULL, NULL), ==,
+			 cd_icc_get_copyright (icc_full, NULL, NULL));
+
+	/* not an ICC profile */
+	g_clear_object (&icc);
+	icc = cd_icc_new ();
+	ret = cd_icc_peek_data (icc, (const guint8 *) filename, strlen (filename), &error);
+	g_assert_error (error, CD_ICC_ERROR, CD_ICC_ERROR_FAILED_TO_PARSE);
+	g_assert (!ret);
+}
+
 static void
 colord_icc_localized_func (void)
 {
@@ -1969,46 +3349,1326 @@ colord_transform_func (void)
 	}
 	g_timer_destroy (timer);
 
+	/* do the whole image inline even though threads are enabled */
+	cd_transform_set_inline_threshold (transform, G_MAXUINT);
+	g_assert_cmpint (cd_transform_get_inline_threshold (transform), ==, G_MAXUINT);
+	memset (img_data_out, 0, height * width * 3);
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_out,
+				    width,
+				    height,
+				    width,
+				    NULL,
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (memcmp (img_data_out,
+				 img_data_check,
+				 height * width * 3), ==, 0);
+
 	g_free (img_data_in);
 	g_free (img_data_out);
 	g_free (img_data_check);
 	g_object_unref (transform);
 }
 
-#include <glib/gstdio.h>
-
 static void
-_copy_files (const gchar *src, const gchar *dest)
+colord_transform_depth_func (void)
 {
 	gboolean ret;
-	g_autofree gchar *data = NULL;
+	guint i;
+	guint16 data16[4] = { 0x1234, 0x8000, 0xffff, 0x4242 };
+	guint16 data16_out[4] = { 0, 0, 0, 0 };
+	gfloat dataf[3] = { 0.25f, 0.5f, 0.75f };
+	gfloat dataf_out[3];
+	guint8 data8_out[3];
+	g_autoptr(CdTransform) transform = NULL;
 	g_autoptr(GError) error = NULL;
-	gsize len;
 
-	ret = g_file_get_contents (src, &data, &len, &error);
+	/* sRGB to sRGB at 16 bit depth, leaving the alpha alone */
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGBA64);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGBA64);
+	ret = cd_transform_process (transform, data16, data16_out, 1, 1, 1, NULL, &error);
+	g_assert_no_error (error);
 	g_assert (ret);
+	for (i = 0; i < 3; i++)
+		g_assert_cmpint (ABS ((gint) data16_out[i] - (gint) data16[i]), <, 0x20);
+
+	/* float input to 8 bit output */
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB_FLOAT);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	ret = cd_transform_process (transform, dataf, data8_out, 1, 1, 1, NULL, &error);
 	g_assert_no_error (error);
-	ret = g_file_set_contents (dest, data, len, &error);
 	g_assert (ret);
+	for (i = 0; i < 3; i++)
+		g_assert_cmpint (ABS ((gint) data8_out[i] - (gint) (dataf[i] * 255)), <=, 1);
+
+	/* float to float */
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB_FLOAT);
+	ret = cd_transform_process (transform, dataf, dataf_out, 1, 1, 1, NULL, &error);
 	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < 3; i++)
+		g_assert_cmpfloat (ABS (dataf_out[i] - dataf[i]), <, 0.01f);
+
+	/* check the strings */
+	g_assert_cmpstr (cd_pixel_format_to_string (CD_PIXEL_FORMAT_RGBA64), ==, "rgba64");
+	g_assert_cmpint (cd_pixel_format_from_string ("rgb-float"), ==, CD_PIXEL_FORMAT_RGB_FLOAT);
 }
 
 static void
-colord_icc_store_added_cb (CdIccStore *store, CdIcc *icc, guint *cnt)
+colord_transform_stride_func (void)
 {
-	g_debug ("Got ::added(%s)", cd_icc_get_checksum (icc));
-	(*cnt)++;
-	cd_test_loop_quit ();
+	const guint height = 16;
+	const guint width = 20;
+	const gsize rowstride_padded = 64;
+	gboolean ret;
+	guint x, y, c;
+	g_autofree guint8 *img_packed = NULL;
+	g_autofree guint8 *img_padded = NULL;
+	g_autofree guint8 *img_planar = NULL;
+	g_autofree guint8 *img_out = NULL;
+	g_autofree guint8 *img_check = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* the same image as packed, padded and planar */
+	img_packed = g_new0 (guint8, width * height * 3);
+	img_padded = g_new0 (guint8, rowstride_padded * height);
+	img_planar = g_new0 (guint8, width * height * 3);
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			for (c = 0; c < 3; c++) {
+				guint8 val = (x * 11 + y * 7 + c * 91) % 0xff;
+				img_packed[(y * width + x) * 3 + c] = val;
+				img_padded[y * rowstride_padded + x * 3 + c] = val;
+				img_planar[c * width * height + y * width + x] = val;
+			}
+		}
+	}
+
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	img_check = g_new0 (guint8, width * height * 3);
+	ret = cd_transform_process (transform,
+				    img_packed, img_check,
+				    width, height, width,
+				    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* padded input to packed output */
+	img_out = g_new0 (guint8, width * height * 3);
+	ret = cd_transform_process_full (transform,
+					 img_padded, img_out,
+					 width, height,
+					 rowstride_padded, width * 3,
+					 0, 0,
+					 NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (memcmp (img_out, img_check, width * height * 3), ==, 0);
+
+	/* planar input to packed output */
+	memset (img_out, 0, width * height * 3);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24_PLANAR);
+	ret = cd_transform_process_full (transform,
+					 img_planar, img_out,
+					 width, height,
+					 width, width * 3,
+					 width * height, 0,
+					 NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (memcmp (img_out, img_check, width * height * 3), ==, 0);
+
+	/* not possible with the old API */
+	ret = cd_transform_process (transform,
+				    img_planar, img_out,
+				    width, height, width,
+				    NULL, &error);
+	g_assert_error (error, CD_TRANSFORM_ERROR, CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM);
+	g_assert (!ret);
 }
 
 static void
-colord_icc_store_removed_cb (CdIccStore *store, CdIcc *icc, guint *cnt)
+colord_transform_lut3d_func (void)
+{
+	const guint lut_size = 5;
+	const gfloat *lut_data;
+	const guint16 *shaper_data;
+	gboolean ret;
+	gsize len;
+	guint i;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GBytes) lut = NULL;
+	g_autoptr(GBytes) shaper = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* sRGB to sRGB is the identity, so every entry is its lattice point */
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	cd_transform_set_max_threads (transform, 0);
+	cd_transform_set_inline_threshold (transform, 0);
+	lut = cd_transform_get_lut3d (transform, lut_size, CD_PIXEL_FORMAT_RGB_FLOAT, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (lut != NULL);
+	lut_data = g_bytes_get_data (lut, &len);
+	g_assert_cmpint (len, ==, lut_size * lut_size * lut_size * 3 * sizeof (gfloat));
+	for (i = 0; i < lut_size; i++) {
+		gfloat x = (gfloat) i / (gfloat) (lut_size - 1);
+		g_assert_cmpfloat (ABS (lut_data[i * 3 + 0] - x), <, 0.01f);
+		g_assert_cmpfloat (ABS (lut_data[i * lut_size * 3 + 1] - x), <, 0.01f);
+		g_assert_cmpfloat (ABS (lut_data[i * lut_size * lut_size * 3 + 2] - x), <, 0.01f);
+	}
+
+	/* half float with shaper curves */
+	g_clear_pointer (&lut, g_bytes_unref);
+	ret = cd_transform_get_lut3d_full (transform, lut_size, 256,
+					   CD_PIXEL_FORMAT_RGBA_HALF,
+					   &lut, &shaper, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (g_bytes_get_size (lut), ==, lut_size * lut_size * lut_size * 4 * 2);
+	shaper_data = g_bytes_get_data (shaper, &len);
+	g_assert_cmpint (len, ==, 256 * 4 * 2);
+	g_assert_cmpint (shaper_data[0], ==, 0x0000);
+	g_assert_cmpint (shaper_data[255 * 4 + 0], ==, 0x3c00);
+	g_assert_cmpint (shaper_data[255 * 4 + 3], ==, 0x3c00);
+
+	/* not a format we can use */
+	g_clear_pointer (&lut, g_bytes_unref);
+	lut = cd_transform_get_lut3d (transform, lut_size, CD_PIXEL_FORMAT_RGB24, NULL, &error);
+	g_assert_error (error, CD_TRANSFORM_ERROR, CD_TRANSFORM_ERROR_INVALID_COLORSPACE);
+	g_assert (lut == NULL);
+}
+
+static void
+colord_transform_array_func (void)
+{
+	const guint n_colors = 2500;
+	gboolean ret;
+	guint i;
+	CdColorLab lab;
+	g_autofree CdColorRGB *rgb = NULL;
+	g_autofree CdColorLab *labs = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* sRGB to Lab */
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB_DOUBLE);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_LAB_DOUBLE);
+	cd_transform_set_max_threads (transform, 4);
+	rgb = g_new0 (CdColorRGB, n_colors);
+	labs = g_new0 (CdColorLab, n_colors);
+	for (i = 0; i < n_colors; i++)
+		cd_color_rgb_set (&rgb[i], (gdouble) i / n_colors, 0.5f, 1.f - (gdouble) i / n_colors);
+	cd_color_rgb_set (&rgb[0], 1.f, 1.f, 1.f);
+	ret = cd_transform_process_array (transform, rgb, labs, n_colors, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* white */
+	g_assert_cmpfloat (ABS (labs[0].L - 100.f), <, 0.1f);
+	g_assert_cmpfloat (ABS (labs[0].a), <, 0.1f);
+	g_assert_cmpfloat (ABS (labs[0].b), <, 0.1f);
+
+	/* the same as doing each color on its own, including the partial row */
+	for (i = 0; i < n_colors; i += 97) {
+		ret = cd_transform_process_array (transform, &rgb[i], &lab, 1, NULL, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_assert_cmpfloat (ABS (lab.L - labs[i].L), <, 0.0001f);
+		g_assert_cmpfloat (ABS (lab.a - labs[i].a), <, 0.0001f);
+		g_assert_cmpfloat (ABS (lab.b - labs[i].b), <, 0.0001f);
+	}
+}
+
+typedef struct {
+	guint8		*data;
+	guint		 rows_done;
+	guint		 width;
+} ColordTransformStreamHelper;
+
+static void
+colord_transform_stream_cb (const guint8 *data, guint n_rows, gsize rowstride, gpointer user_data)
+{
+	ColordTransformStreamHelper *helper = (ColordTransformStreamHelper *) user_data;
+	g_assert_cmpint (rowstride, ==, helper->width * 3);
+	memcpy (helper->data + helper->rows_done * rowstride, data, n_rows * rowstride);
+	helper->rows_done += n_rows;
+}
+
+static void
+colord_transform_stream_func (void)
+{
+	const guint height = 100;
+	const guint width = 50;
+	const guint chunk_rows = 7;
+	gboolean ret;
+	guint i;
+	ColordTransformStreamHelper helper;
+	g_autofree guint8 *img_data_in = NULL;
+	g_autofree guint8 *img_data_out = NULL;
+	g_autofree guint8 *img_data_check = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(CdTransformStream) stream = NULL;
+	g_autoptr(GError) error = NULL;
+
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_max_threads (transform, 4);
+
+	img_data_in = g_new0 (guint8, height * width * 3);
+	img_data_out = g_new0 (guint8, height * width * 3);
+	img_data_check = g_new0 (guint8, height * width * 3);
+	for (i = 0; i < height * width * 3; i++)
+		img_data_in[i] = (i * 13) % 0xff;
+	ret = cd_transform_process (transform,
+				    img_data_in, img_data_check,
+				    width, height, width,
+				    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* write a few rows at a time with only a small number in flight */
+	helper.data = img_data_out;
+	helper.rows_done = 0;
+	helper.width = width;
+	stream = cd_transform_stream_new (transform, width, colord_transform_stream_cb, &helper);
+	cd_transform_stream_set_max_rows (stream, 16);
+	g_assert_cmpint (cd_transform_stream_get_max_rows (stream), ==, 16);
+	for (i = 0; i < height; i += chunk_rows) {
+		ret = cd_transform_stream_write (stream,
+						 img_data_in + i * width * 3,
+						 MIN (chunk_rows, height - i),
+						 width * 3,
+						 NULL, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_assert_cmpint (i + MIN (chunk_rows, height - i) - helper.rows_done, <=, 16 + chunk_rows);
+	}
+	ret = cd_transform_stream_close (stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (helper.rows_done, ==, height);
+	g_assert_cmpint (memcmp (img_data_out, img_data_check, height * width * 3), ==, 0);
+
+	/* closed */
+	ret = cd_transform_stream_write (stream, img_data_in, 1, width * 3, NULL, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CLOSED);
+	g_assert (!ret);
+}
+
+static void
+colord_transform_devicelink_func (void)
+{
+	gboolean ret;
+	guint8 data_in[3] = { 127, 32, 64 };
+	guint8 data_out[3];
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+	const gchar *fn;
+
+	/* the profile needs a checksum to be cacheable */
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	icc = cd_icc_new ();
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_FALLBACK_MD5, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_icc (transform, icc);
+	cd_transform_set_cache_directory (transform, tmpdir);
+	g_assert_cmpstr (cd_transform_get_cache_directory (transform), ==, tmpdir);
+	ret = cd_transform_process (transform, data_in, data_out, 1, 1, 1, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* a device link was written */
+	dir = g_dir_open (tmpdir, 0, &error);
+	g_assert_no_error (error);
+	fn = g_dir_read_name (dir);
+	g_assert (fn != NULL);
+	g_assert (g_str_has_suffix (fn, ".icc"));
+	g_free (filename);
+	filename = g_build_filename (tmpdir, fn, NULL);
+	g_assert_cmpint (g_remove (filename), ==, 0);
+	g_assert_cmpint (g_remove (tmpdir), ==, 0);
+}
+
+static void
+colord_transform_proof_stream_cb (const guint8 *data, guint n_rows, gsize rowstride, gpointer user_data)
+{
+	memcpy (user_data, data, n_rows * rowstride);
+}
+
+static void
+colord_transform_proof_func (void)
+{
+	CdColorRGB alarm;
+	gboolean ret;
+	guint8 data_in[6] = { 255, 0, 0, 128, 128, 128 };
+	guint8 data_out[6];
+	g_autofree gchar *filename = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(CdTransformStream) stream = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	/* the laptop panel cannot show saturated sRGB red */
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	file = g_file_new_for_path (filename);
+	icc = cd_icc_new ();
+	ret = cd_icc_load_file (icc, file, CD_ICC_LOAD_FLAGS_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_proof_icc (transform, icc);
+	g_assert (cd_transform_get_proof_icc (transform) == icc);
+	cd_transform_set_gamut_check (transform, TRUE);
+	g_assert (cd_transform_get_gamut_check (transform));
+	cd_color_rgb_set (&alarm, 0.f, 1.f, 0.f);
+	cd_transform_set_gamut_alarm (transform, &alarm);
+	g_assert_cmpfloat (cd_transform_get_gamut_alarm (transform)->G, >, 0.99f);
+	ret = cd_transform_process (transform, data_in, data_out, 2, 1, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* only the red pixel has been replaced */
+	g_assert_cmpint (cd_transform_get_gamut_alarm_count (transform), ==, 1);
+	g_assert_cmpint (data_out[0], ==, 0);
+	g_assert_cmpint (data_out[1], ==, 255);
+	g_assert_cmpint (data_out[2], ==, 0);
+	g_assert_cmpint (data_out[4], !=, 255);
+
+	/* soft-proofing without the check does not count anything */
+	cd_transform_set_gamut_check (transform, FALSE);
+	ret = cd_transform_process (transform, data_in, data_out, 2, 1, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_transform_get_gamut_alarm_count (transform), ==, 0);
+	g_assert_cmpint (data_out[1], !=, 255);
+
+	/* the rows converted by a stream are counted too */
+	cd_transform_set_gamut_check (transform, TRUE);
+	memset (data_out, 0, sizeof (data_out));
+	stream = cd_transform_stream_new (transform, 2, colord_transform_proof_stream_cb, data_out);
+	ret = cd_transform_stream_write (stream, data_in, 1, sizeof (data_in), NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_transform_stream_close (stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_transform_get_gamut_alarm_count (transform), ==, 1);
+	g_assert_cmpint (data_out[1], ==, 255);
+}
+
+static void
+colord_transform_lut_func (void)
+{
+	const guint height = 64;
+	const guint width = 256;
+	gboolean ret;
+	guint i;
+	g_autofree guint8 *img_data_in = NULL;
+	g_autofree guint8 *img_data_out = NULL;
+	g_autofree guint8 *img_data_check = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGBA32);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_BGRA32);
+
+	/* get the exact result */
+	img_data_in = g_new0 (guint8, height * width * 4);
+	img_data_out = g_new0 (guint8, height * width * 4);
+	img_data_check = g_new0 (guint8, height * width * 4);
+	for (i = 0; i < height * width * 4; i++)
+		img_data_in[i] = (i * 7) % 0xff;
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_check,
+				    width, height, width,
+				    NULL,
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* use the LUT, which should be close for sRGB to sRGB */
+	cd_transform_set_lut_size (transform, 33);
+	g_assert_cmpint (cd_transform_get_lut_size (transform), ==, 33);
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_out,
+				    width, height, width,
+				    NULL,
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < height * width * 4; i++) {
+		if (i % 4 == 3)
+			continue;
+		g_assert_cmpint (ABS ((gint) img_data_out[i] - (gint) img_data_check[i]), <=, 1);
+	}
+}
+
+static void
+colord_transform_shaper_func (void)
+{
+	const guint height = 64;
+	const guint width = 256;
+	cmsHPROFILE srgb;
+	cmsHTRANSFORM lcms_transform;
+	CdColorYxy blue;
+	CdColorYxy green;
+	CdColorYxy red;
+	CdColorYxy white;
+	gboolean ret;
+	guint i;
+	g_autofree guint8 *img_data_in = NULL;
+	g_autofree guint8 *img_data_out = NULL;
+	g_autofree guint8 *img_data_check = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* a typical display profile */
+	icc = cd_icc_new ();
+	cd_color_yxy_set (&red, 1.0f, 0.569336f, 0.332031f);
+	cd_color_yxy_set (&green, 1.0f, 0.311523f, 0.543945f);
+	cd_color_yxy_set (&blue, 1.0f, 0.149414f, 0.131836f);
+	cd_color_yxy_set (&white, 1.0f, 0.313477f, 0.329102f);
+	ret = cd_icc_create_from_edid (icc, 2.2f, &red, &green, &blue, &white, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* sRGB to the display */
+	transform = cd_transform_new ();
+	cd_transform_set_output_icc (transform, icc);
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGBA32);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_BGRA32);
+	ret = cd_transform_prepare (transform, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_transform_get_use_shaper (transform));
+
+	img_data_in = g_new0 (guint8, height * width * 4);
+	img_data_out = g_new0 (guint8, height * width * 4);
+	img_data_check = g_new0 (guint8, height * width * 4);
+	for (i = 0; i < height * width * 4; i++)
+		img_data_in[i] = (i * 7) % 0xff;
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_out,
+				    width, height, width,
+				    NULL,
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* compare with what lcms does */
+	srgb = cmsCreate_sRGBProfile ();
+	lcms_transform = cmsCreateTransform (srgb,
+					     TYPE_RGBA_8,
+					     cd_icc_get_handle (icc),
+					     TYPE_BGRA_8,
+					     INTENT_PERCEPTUAL,
+					     0);
+	g_assert (lcms_transform != NULL);
+	cmsDoTransform (lcms_transform, img_data_in, img_data_check, height * width);
+	cmsDeleteTransform (lcms_transform);
+	cmsCloseProfile (srgb);
+	for (i = 0; i < height * width * 4; i++) {
+		if (i % 4 == 3)
+			continue;
+		g_assert_cmpint (ABS ((gint) img_data_out[i] - (gint) img_data_check[i]), <=, 1);
+	}
+
+	/* absolute colorimetric needs the full pipeline */
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_ABSOLUTE_COLORIMETRIC);
+	ret = cd_transform_prepare (transform, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_transform_get_use_shaper (transform));
+
+	/* as does a non-packed format */
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB48);
+	ret = cd_transform_prepare (transform, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_transform_get_use_shaper (transform));
+}
+
+static void
+colord_transform_swizzle_func (void)
+{
+	gboolean ret;
+	guint8 data_in[8] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+	guint8 data_out[8] = { 0 };
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* sRGB to sRGB is a copy */
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGBA32);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGBA32);
+	ret = cd_transform_process (transform, data_in, data_out, 2, 1, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_transform_get_use_swizzle (transform));
+	g_assert (memcmp (data_in, data_out, sizeof (data_in)) == 0);
+
+	/* only the channel order differs */
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_BGRA32);
+	ret = cd_transform_process (transform, data_in, data_out, 2, 1, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_transform_get_use_swizzle (transform));
+	g_assert_cmpint (data_out[0], ==, 30);
+	g_assert_cmpint (data_out[1], ==, 20);
+	g_assert_cmpint (data_out[2], ==, 10);
+	g_assert_cmpint (data_out[3], ==, 40);
+	g_assert_cmpint (data_out[4], ==, 70);
+	g_assert_cmpint (data_out[7], ==, 80);
+
+	/* dropping the alpha channel */
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_ARGB32);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	memset (data_out, 0, sizeof (data_out));
+	ret = cd_transform_process (transform, data_in, data_out, 2, 1, 2, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_transform_get_use_swizzle (transform));
+	g_assert_cmpint (data_out[0], ==, 20);
+	g_assert_cmpint (data_out[1], ==, 30);
+	g_assert_cmpint (data_out[2], ==, 40);
+	g_assert_cmpint (data_out[3], ==, 60);
+
+	/* the same profile object on both sides */
+	icc = cd_icc_new ();
+	ret = cd_icc_create_default (icc, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cd_transform_set_input_icc (transform, icc);
+	cd_transform_set_output_icc (transform, icc);
+	ret = cd_transform_prepare (transform, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_transform_get_use_swizzle (transform));
+
+	/* but not when converting to another space */
+	cd_transform_set_output_icc (transform, NULL);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_LAB_DOUBLE);
+	ret = cd_transform_prepare (transform, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_transform_get_use_swizzle (transform));
+}
+
+typedef struct {
+	gboolean	 ret;
+	goffset		 current;
+	goffset		 total;
+	GError		*error;
+} ColordTransformHelper;
+
+static void
+colord_transform_progress_cb (goffset current, goffset total, gpointer user_data)
+{
+	ColordTransformHelper *helper = (ColordTransformHelper *) user_data;
+	g_assert_cmpint (current, >=, helper->current);
+	helper->current = current;
+	helper->total = total;
+}
+
+static void
+colord_transform_process_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	ColordTransformHelper *helper = (ColordTransformHelper *) user_data;
+	helper->ret = cd_transform_process_finish (CD_TRANSFORM (source),
+						   res,
+						   &helper->error);
+	cd_test_loop_quit ();
+}
+
+static void
+colord_transform_async_func (void)
+{
+	const guint height = 256;
+	const guint width = 256;
+	gboolean ret;
+	guint i;
+	ColordTransformHelper helper = { FALSE, 0, 0, NULL };
+	g_autofree guint8 *img_data_in = NULL;
+	g_autofree guint8 *img_data_out = NULL;
+	g_autofree guint8 *img_data_check = NULL;
+	g_autoptr(CdTransform) transform = NULL;
+	g_autoptr(GCancellable) cancellable = NULL;
+	g_autoptr(GError) error = NULL;
+
+	transform = cd_transform_new ();
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_PERCEPTUAL);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_RGB24);
+	cd_transform_set_max_threads (transform, 4);
+	cd_transform_set_inline_threshold (transform, 0);
+
+	/* get the reference result */
+	img_data_in = g_new0 (guint8, height * width * 3);
+	img_data_out = g_new0 (guint8, height * width * 3);
+	img_data_check = g_new0 (guint8, height * width * 3);
+	for (i = 0; i < height * width * 3; i++)
+		img_data_in[i] = i % 0xff;
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_check,
+				    width, height, width,
+				    NULL,
+				    &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* process in a thread */
+	cd_transform_process_async (transform,
+				    img_data_in,
+				    img_data_out,
+				    width, height, width,
+				    NULL,
+				    colord_transform_progress_cb,
+				    &helper,
+				    colord_transform_process_cb,
+				    &helper);
+	cd_test_loop_run_with_timeout (5000);
+	g_assert_no_error (helper.error);
+	g_assert (helper.ret);
+	g_assert_cmpint (memcmp (img_data_out,
+				 img_data_check,
+				 height * width * 3), ==, 0);
+
+	/* the last progress update is delivered before completion */
+	g_assert_cmpint (helper.total, ==, width * height);
+	g_assert_cmpint (helper.current, ==, helper.total);
+
+	/* already cancelled */
+	cancellable = g_cancellable_new ();
+	g_cancellable_cancel (cancellable);
+	ret = cd_transform_process (transform,
+				    img_data_in,
+				    img_data_out,
+				    width, height, width,
+				    cancellable,
+				    &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert (!ret);
+}
+
+#include <glib/gstdio.h>
+
+static void
+_copy_files (const gchar *src, const gchar *dest)
+{
+	gboolean ret;
+	g_autofree gchar *data = NULL;
+	g_autoptr(GError) error = NULL;
+	gsize len;
+
+	ret = g_file_get_contents (src, &data, &len, &error);
+	g_assert (ret);
+	g_assert_no_error (error);
+	ret = g_file_set_contents (dest, data, len, &error);
+	g_assert (ret);
+	g_assert_no_error (error);
+}
+
+static void
+colord_icc_store_added_cb (CdIccStore *store, CdIcc *icc, guint *cnt)
+{
+	g_debug ("Got ::added(%s)", cd_icc_get_checksum (icc));
+	(*cnt)++;
+	cd_test_loop_quit ();
+}
+
+static void
+colord_icc_store_removed_cb (CdIccStore *store, CdIcc *icc, guint *cnt)
 {
 	g_debug ("Got ::removed(%s)", cd_icc_get_checksum (icc));
 	(*cnt)++;
 	cd_test_loop_quit ();
 }
 
+static void
+colord_icc_store_parallel_func (void)
+{
+	gboolean ret;
+	guint added = 0;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *filename2 = NULL;
+	g_autofree gchar *root = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	filename2 = cd_test_get_filename ("crayons.icc");
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (root != NULL);
+
+	/* enough copies to be loaded by more than one thread */
+	for (guint i = 0; i < 16; i++) {
+		g_autofree gchar *basename = g_strdup_printf ("profile-%02u.icc", i);
+		g_autofree gchar *dest = g_build_filename (root, basename, NULL);
+		_copy_files (i % 2 == 0 ? filename1 : filename2, dest);
+	}
+
+	/* the duplicates are still only added once */
+	store = cd_icc_store_new ();
+	g_signal_connect (store, "added",
+			  G_CALLBACK (colord_icc_store_added_cb),
+			  &added);
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (added, ==, 2);
+	array = cd_icc_store_get_all (store);
+	g_assert_cmpint (array->len, ==, 2);
+
+	for (guint i = 0; i < 16; i++) {
+		g_autofree gchar *basename = g_strdup_printf ("profile-%02u.icc", i);
+		g_autofree gchar *dest = g_build_filename (root, basename, NULL);
+		g_unlink (dest);
+	}
+	g_remove (root);
+}
+
+static void
+colord_icc_store_changed_cb (CdIccStore *store, guint *cnt)
+{
+	(*cnt)++;
+	cd_test_loop_quit ();
+}
+
+static void
+colord_icc_store_changes_func (void)
+{
+	gboolean ret;
+	guint added = 0;
+	guint changed = 0;
+	guint removed = 0;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *filename2 = NULL;
+	g_autofree gchar *root = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+	const gchar *basenames[] = { "one.icc", "two.icc", "three.icc", NULL };
+
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	filename2 = cd_test_get_filename ("crayons.icc");
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (root != NULL);
+
+	store = cd_icc_store_new ();
+	g_signal_connect (store, "added",
+			  G_CALLBACK (colord_icc_store_added_cb),
+			  &added);
+	g_signal_connect (store, "removed",
+			  G_CALLBACK (colord_icc_store_removed_cb),
+			  &removed);
+	g_signal_connect (store, "changed",
+			  G_CALLBACK (colord_icc_store_changed_cb),
+			  &changed);
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* several files appearing at once are dealt with together */
+	for (guint i = 0; basenames[i] != NULL; i++) {
+		g_autofree gchar *dest = g_build_filename (root, basenames[i], NULL);
+		_copy_files (i == 1 ? filename2 : filename1, dest);
+	}
+	cd_test_loop_run_with_timeout (5000);
+	cd_test_loop_quit ();
+	g_assert_cmpint (added, ==, 2);
+	g_assert_cmpint (removed, ==, 0);
+	g_assert_cmpint (changed, ==, 1);
+
+	/* and so are removals */
+	for (guint i = 0; basenames[i] != NULL; i++) {
+		g_autofree gchar *dest = g_build_filename (root, basenames[i], NULL);
+		g_unlink (dest);
+	}
+	cd_test_loop_run_with_timeout (5000);
+	cd_test_loop_quit ();
+	g_assert_cmpint (added, ==, 2);
+	g_assert_cmpint (removed, ==, 2);
+	g_assert_cmpint (changed, ==, 2);
+	g_remove (root);
+}
+
+static void
+colord_icc_store_cold_func (void)
+{
+	gboolean ret;
+	guint added = 0;
+	guint changed = 0;
+	guint removed = 0;
+	g_autofree gchar *dest = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *root = NULL;
+	g_autofree gchar *subdir = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (root != NULL);
+	subdir = g_build_filename (root, "vendor", NULL);
+	g_assert_cmpint (g_mkdir (subdir, 0700), ==, 0);
+
+	store = cd_icc_store_new ();
+	g_signal_connect (store, "added",
+			  G_CALLBACK (colord_icc_store_added_cb),
+			  &added);
+	g_signal_connect (store, "removed",
+			  G_CALLBACK (colord_icc_store_removed_cb),
+			  &removed);
+	g_signal_connect (store, "changed",
+			  G_CALLBACK (colord_icc_store_changed_cb),
+			  &changed);
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	cd_icc_store_set_sweep_interval (store, 1);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_COLD,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the subdirectory has no monitor, so is found by the sweep */
+	dest = g_build_filename (subdir, "one.icc", NULL);
+	_copy_files (filename, dest);
+	cd_test_loop_run_with_timeout (5000);
+	cd_test_loop_quit ();
+	g_assert_cmpint (added, ==, 1);
+	g_assert_cmpint (removed, ==, 0);
+	g_assert_cmpint (changed, ==, 1);
+	icc = cd_icc_store_find_by_filename (store, dest);
+	g_assert (icc != NULL);
+
+	/* and so is a removal */
+	g_unlink (dest);
+	cd_test_loop_run_with_timeout (5000);
+	cd_test_loop_quit ();
+	g_assert_cmpint (added, ==, 1);
+	g_assert_cmpint (removed, ==, 1);
+	g_assert_cmpint (changed, ==, 2);
+	g_remove (subdir);
+	g_remove (root);
+}
+
+static void
+colord_icc_store_bundle_func (void)
+{
+	CdIcc *icc;
+	gboolean ret;
+	gint exit_status = -1;
+	gsize len;
+	g_autofree gchar *bundle_fn = NULL;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *file1 = NULL;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *filename2 = NULL;
+	g_autofree gchar *profiles = NULL;
+	g_autofree gchar *root = NULL;
+	g_autofree gchar *src = NULL;
+	g_autofree gchar *src1 = NULL;
+	g_autofree gchar *xml = NULL;
+	g_autofree gchar *xml_fn = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	filename2 = cd_test_get_filename ("crayons.icc");
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (root != NULL);
+	src = g_build_filename (root, "src", NULL);
+	profiles = g_build_filename (root, "profiles", NULL);
+	g_mkdir (src, 0700);
+	g_mkdir (profiles, 0700);
+
+	/* the file on disk has no tags, but the same header and size */
+	ret = g_file_get_contents (filename1, &data, &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, >, 128);
+	src1 = g_build_filename (src, "t61.icc", NULL);
+	_copy_files (filename1, src1);
+	file1 = g_build_filename (profiles, "t61.icc", NULL);
+	memset (data + 128, 0, len - 128);
+	ret = g_file_set_contents (file1, data, len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* build the bundle */
+	bundle_fn = g_build_filename (root, "profiles.gresource", NULL);
+	xml_fn = g_build_filename (root, "profiles.gresource.xml", NULL);
+	xml = g_strdup_printf ("<gresources><gresource prefix=\"/org/freedesktop/colord/bundle%s\">"
+			       "<file compressed=\"true\">t61.icc</file>"
+			       "</gresource></gresources>", profiles);
+	ret = g_file_set_contents (xml_fn, xml, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	{
+		const gchar *argv[] = { "glib-compile-resources",
+					"--sourcedir", src,
+					"--target", bundle_fn,
+					xml_fn, NULL };
+		ret = g_spawn_sync (NULL, (gchar **) argv, NULL,
+				    G_SPAWN_SEARCH_PATH |
+				    G_SPAWN_STDOUT_TO_DEV_NULL |
+				    G_SPAWN_STDERR_TO_DEV_NULL,
+				    NULL, NULL, NULL, NULL,
+				    &exit_status, NULL);
+	}
+	if (!ret || exit_status != 0) {
+		g_test_skip ("glib-compile-resources not available");
+		goto out;
+	}
+
+	/* the profile is read from the bundle */
+	store = cd_icc_store_new ();
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	ret = cd_icc_store_add_cache_file (store, bundle_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, profiles,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_assert_cmpstr (cd_icc_get_checksum (icc), ==, "9ace8cce8baac8d492a93a2a232d7702");
+	g_assert (cd_icc_get_description (icc, NULL, NULL) != NULL);
+	g_object_unref (icc);
+	g_clear_object (&store);
+
+	/* the same size is not enough when the header is different */
+	memset (data, 0, len);
+	ret = g_file_set_contents (file1, data, len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	store = cd_icc_store_new ();
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	ret = cd_icc_store_add_cache_file (store, bundle_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, profiles,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc == NULL);
+	g_clear_object (&store);
+
+	/* the bundle is not used once the file has been changed */
+	_copy_files (filename2, file1);
+	store = cd_icc_store_new ();
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_NONE);
+	ret = cd_icc_store_add_cache_file (store, bundle_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, profiles,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_assert_cmpstr (cd_icc_get_checksum (icc), !=, "9ace8cce8baac8d492a93a2a232d7702");
+	g_object_unref (icc);
+out:
+	g_unlink (bundle_fn);
+	g_unlink (xml_fn);
+	g_unlink (src1);
+	g_unlink (file1);
+	g_remove (src);
+	g_remove (profiles);
+	g_remove (root);
+}
+
+static void
+colord_icc_store_index_func (void)
+{
+	CdIcc *icc;
+	gboolean ret;
+	guint added = 0;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *file1 = NULL;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *index_fn = NULL;
+	g_autofree gchar *root = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) tags = NULL;
+
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (root != NULL);
+	file1 = g_build_filename (root, "ibm-t61.icc", NULL);
+	_copy_files (filename1, file1);
+	index_fn = g_build_filename (root, "index", "profiles.ini", NULL);
+
+	/* parse the profile, and write the index when the store goes away */
+	store = cd_icc_store_new ();
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_FALLBACK_MD5);
+	ret = cd_icc_store_set_index (store, index_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_assert (cd_icc_get_handle (icc) != NULL);
+	checksum = g_strdup (cd_icc_get_checksum (icc));
+	g_clear_object (&store);
+	g_assert (g_file_test (index_fn, G_FILE_TEST_EXISTS));
+
+	/* the same profile is added without being parsed */
+	store = cd_icc_store_new ();
+	g_signal_connect (store, "added",
+			  G_CALLBACK (colord_icc_store_added_cb),
+			  &added);
+	cd_icc_store_set_load_flags (store, CD_ICC_LOAD_FLAGS_FALLBACK_MD5);
+	ret = cd_icc_store_set_index (store, index_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (added, ==, 1);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_assert (cd_icc_get_handle (icc) == NULL);
+	g_assert_cmpstr (cd_icc_get_checksum (icc), ==, checksum);
+	g_assert_cmpint (cd_icc_get_kind (icc), ==, CD_PROFILE_KIND_DISPLAY_DEVICE);
+	g_assert_cmpstr (cd_icc_get_description (icc, NULL, NULL), ==,
+			 "Huey, LENOVO - 6464Y1H - 15\" (2009-12-23)");
+	tags = cd_icc_get_tags (icc, &error);
+	g_assert_no_error (error);
+	g_assert (tags != NULL);
+	g_assert (g_strv_contains ((const gchar * const *) tags, "vcgt"));
+	g_clear_object (&store);
+
+	g_unlink (index_fn);
+	index_fn[strlen (index_fn) - 13] = '\0';
+	g_remove (index_fn);
+	g_unlink (file1);
+	g_remove (root);
+}
+
+static void
+colord_icc_store_checksum_cache_func (void)
+{
+	gboolean ret;
+	gchar *tmp;
+	g_autofree gchar *cache_fn = NULL;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *file1 = NULL;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *root = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	file1 = g_build_filename (root, "profile.icc", NULL);
+	_copy_files (filename1, file1);
+	cache_fn = g_build_filename (root, "cache", "checksums.ini", NULL);
+
+	/* the checksum is computed and saved when the store goes away */
+	store = cd_icc_store_new ();
+	ret = cd_icc_store_set_checksum_cache (store, cache_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_object (&store);
+	ret = g_file_get_contents (cache_fn, &data, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	tmp = g_strstr_len (data, -1, "9ace8cce8baac8d492a93a2a232d7702");
+	g_assert (tmp != NULL);
+
+	/* prove the cached value is used rather than hashing the file again */
+	memset (tmp, '0', 32);
+	ret = g_file_set_contents (cache_fn, data, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	store = cd_icc_store_new ();
+	ret = cd_icc_store_set_checksum_cache (store, cache_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, root,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_assert_cmpstr (cd_icc_get_checksum (icc), ==, "00000000000000000000000000000000");
+	g_clear_object (&store);
+
+	g_assert_cmpint (g_unlink (file1), ==, 0);
+	g_assert_cmpint (g_unlink (cache_fn), ==, 0);
+	g_free (data);
+	data = g_path_get_dirname (cache_fn);
+	g_assert_cmpint (g_remove (data), ==, 0);
+	g_assert_cmpint (g_remove (root), ==, 0);
+}
+
+static void
+colord_icc_store_duplicate_func (void)
+{
+	FILE *fp;
+	GStatBuf st;
+	gboolean ret;
+	guchar header[128] = { 0 };
+	struct utimbuf times;
+	g_autofree gchar *cache_fn = NULL;
+	g_autofree gchar *file1 = NULL;
+	g_autofree gchar *file2 = NULL;
+	g_autofree gchar *filename1 = NULL;
+	g_autofree gchar *root = NULL;
+	g_autofree gchar *sysdir = NULL;
+	g_autofree gchar *userdir = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdIccStore) store = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	root = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	filename1 = cd_test_get_filename ("ibm-t61.icc");
+	sysdir = g_build_filename (root, "system", NULL);
+	userdir = g_build_filename (root, "user", NULL);
+	g_assert_cmpint (g_mkdir (sysdir, 0700), ==, 0);
+	g_assert_cmpint (g_mkdir (userdir, 0700), ==, 0);
+	file1 = g_build_filename (sysdir, "profile.icc", NULL);
+	file2 = g_build_filename (userdir, "profile.icc", NULL);
+	_copy_files (filename1, file1);
+	_copy_files (filename1, file2);
+	cache_fn = g_build_filename (root, "checksums.ini", NULL);
+
+	/* both checksums get cached */
+	store = cd_icc_store_new ();
+	ret = cd_icc_store_set_checksum_cache (store, cache_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, sysdir,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, userdir,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_object (&store);
+
+	/* break the copy without changing what it looks like to stat() */
+	g_assert_cmpint (g_stat (file2, &st), ==, 0);
+	fp = fopen (file2, "r+b");
+	g_assert (fp != NULL);
+	g_assert_cmpint (fwrite (header, 1, sizeof (header), fp), ==, sizeof (header));
+	fclose (fp);
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime;
+	g_assert_cmpint (g_utime (file2, &times), ==, 0);
+
+	/* the copy is known to be a duplicate so is never parsed */
+	store = cd_icc_store_new ();
+	ret = cd_icc_store_set_checksum_cache (store, cache_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, sysdir,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_icc_store_search_location (store, userdir,
+					    CD_ICC_STORE_SEARCH_FLAGS_NONE,
+					    NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = cd_icc_store_get_all (store);
+	g_assert_cmpint (array->len, ==, 1);
+	icc = cd_icc_store_find_by_filename (store, file1);
+	g_assert (icc != NULL);
+	g_clear_object (&store);
+
+	g_assert_cmpint (g_unlink (file1), ==, 0);
+	g_assert_cmpint (g_unlink (file2), ==, 0);
+	g_assert_cmpint (g_unlink (cache_fn), ==, 0);
+	g_assert_cmpint (g_remove (sysdir), ==, 0);
+	g_assert_cmpint (g_remove (userdir), ==, 0);
+	g_assert_cmpint (g_remove (root), ==, 0);
+}
+
 static void
 colord_icc_store_func (void)
 {
@@ -2148,6 +4808,72 @@ colord_icc_store_func (void)
 	g_object_unref (store);
 }
 
+static void
+colord_icc_vcgt_batch_func (void)
+{
+	CdIcc *iccs[4];
+	GBytes *data;
+	const guint16 *ramp;
+	gboolean ret;
+	gsize len;
+	guint i;
+	guint j;
+	guint sizes[] = { 256, 256, 1024, 256 };
+	guint16 ramp_red[1024];
+	guint16 ramp_green[1024];
+	guint16 ramp_blue[1024];
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) results = NULL;
+
+	/* the same profile loaded three times, and one without a VCGT */
+	filename = cd_test_get_filename ("ibm-t61.icc");
+	for (i = 0; i < 3; i++) {
+		g_autoptr(GFile) file = g_file_new_for_path (filename);
+		iccs[i] = cd_icc_new ();
+		ret = cd_icc_load_file (iccs[i], file,
+					CD_ICC_LOAD_FLAGS_NONE,
+					NULL, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	iccs[3] = cd_icc_new ();
+	ret = cd_icc_create_default (iccs[3], &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	results = cd_icc_get_vcgt_batch (iccs, sizes, 4);
+	g_assert (results != NULL);
+	g_assert_cmpint (results->len, ==, 4);
+
+	/* same checksum and size share one buffer */
+	g_assert (g_ptr_array_index (results, 0) != NULL);
+	g_assert (g_ptr_array_index (results, 0) == g_ptr_array_index (results, 1));
+	g_assert (g_ptr_array_index (results, 2) != NULL);
+	g_assert (g_ptr_array_index (results, 2) != g_ptr_array_index (results, 0));
+	g_assert (g_ptr_array_index (results, 3) == NULL);
+
+	/* matches the single-output version */
+	for (i = 1; i < 3; i++) {
+		data = g_ptr_array_index (results, i);
+		ramp = g_bytes_get_data (data, &len);
+		g_assert_cmpint (len, ==, sizeof (guint16) * sizes[i] * 3);
+		ret = cd_icc_get_vcgt_uint16 (iccs[i], sizes[i],
+					      ramp_red, ramp_green, ramp_blue,
+					      &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		for (j = 0; j < sizes[i]; j++) {
+			g_assert_cmpint (ramp[j], ==, ramp_red[j]);
+			g_assert_cmpint (ramp[sizes[i] + j], ==, ramp_green[j]);
+			g_assert_cmpint (ramp[sizes[i] * 2 + j], ==, ramp_blue[j]);
+		}
+	}
+
+	for (i = 0; i < 4; i++)
+		g_object_unref (iccs[i]);
+}
+
 static void
 colord_icc_util_func (void)
 {
@@ -2155,6 +4881,10 @@ colord_icc_util_func (void)
 	CdIcc *icc_reference;
 	gboolean ret;
 	gdouble coverage = 0;
+	gdouble coverage_reverse = 0;
+	gdouble volume = 0;
+	g_autoptr(GArray) triangles = NULL;
+	g_autoptr(GArray) vertices = NULL;
 	g_autoptr(GError) error = NULL;
 
 	icc_reference = cd_icc_new ();
@@ -2177,6 +4907,32 @@ colord_icc_util_func (void)
 	g_assert_cmpfloat (coverage, >, 0.99);
 	g_assert_cmpfloat (coverage, <, 1.01);
 
+	/* both directions at a different resolution */
+	ret = cd_icc_utils_get_coverage_full (icc_reference,
+					      icc_measured,
+					      17,
+					      &coverage,
+					      &coverage_reverse,
+					      &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (coverage, >, 0.99);
+	g_assert_cmpfloat (coverage_reverse, >, 0.99);
+
+	/* sRGB gamut hull */
+	ret = cd_icc_utils_get_gamut_hull (icc_reference, 9, &vertices, &triangles, &volume, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (vertices->len, ==, 9 * 9 * 9 - 7 * 7 * 7);
+	g_assert_cmpint (triangles->len, ==, 6 * 8 * 8 * 2 * 3);
+	g_assert_cmpfloat (volume, >, 820000);
+	g_assert_cmpfloat (volume, <, 845000);
+	ret = cd_icc_utils_get_gamut_volume (icc_reference, &volume, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpfloat (volume, >, 820000);
+	g_assert_cmpfloat (volume, <, 845000);
+
 	g_object_unref (icc_reference);
 	g_object_unref (icc_measured);
 }
@@ -2186,6 +4942,7 @@ colord_edid_func (void)
 {
 	CdEdid *edid;
 	gboolean ret;
+	g_autoptr(CdEdid) edid2 = NULL;
 	GBytes *data_edid;
 	gchar *data;
 	gchar *filename;
@@ -2218,6 +4975,15 @@ colord_edid_func (void)
 	g_assert_cmpint (cd_edid_get_width (edid), ==, 47);
 	g_assert_cmpfloat (cd_edid_get_gamma (edid), >=, 2.2f - 0.01);
 	g_assert_cmpfloat (cd_edid_get_gamma (edid), <, 2.2f + 0.01);
+
+	/* the vendor name is cached for the next EDID */
+	edid2 = cd_edid_new ();
+	data_edid = g_bytes_new (data, length);
+	ret = cd_edid_parse (edid2, data_edid, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_bytes_unref (data_edid);
+	g_assert_cmpstr (cd_edid_get_vendor_name (edid2), ==, "LG");
 	g_free (data);
 
 	/* Lenovo T61 internal Panel */
@@ -2379,6 +5145,13 @@ colord_it8_gamma_func (void)
 	}
 	cmsFreeToneCurve (curve);
 
+	/* find grey, which needs the index to be rebuilt */
+	tmp = cd_it8_get_xyz_for_rgb (it8, 0.5f, 0.5f, 0.5f, 0.01f);
+	g_assert (tmp != NULL);
+	g_assert_cmpfloat (ABS (tmp->X - 1.0f), <, 0.01);
+	tmp = cd_it8_get_xyz_for_rgb (it8, 0.55f, 0.5f, 0.5f, 0.01f);
+	g_assert (tmp == NULL);
+
 	/* find the data and estimate */
 	ret = cd_it8_utils_calculate_gamma (it8, &gamma_est, &error);
 	g_assert_no_error (error);
@@ -2387,6 +5160,131 @@ colord_it8_gamma_func (void)
 	g_assert_cmpfloat (gamma_est, >, 2.3);
 }
 
+static void
+colord_it8_gamma_fit_func (void)
+{
+	CdIt8 *it8s[3];
+	CdIt8UtilsGamma *results[3];
+	const gdouble *residuals;
+	gdouble gamma_est = 0.f;
+	gdouble r2 = 0.f;
+	guint i;
+	guint j;
+	guint len = 0;
+	g_autoptr(CdIt8) it8 = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	g_autoptr(CdIt8) it8_empty = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	g_autoptr(CdIt8UtilsGamma) gamma = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* red, green and gray ramps with different curves, but no blue */
+	for (i = 1; i <= 10; i++) {
+		CdColorRGB rgb;
+		CdColorXYZ xyz;
+		gdouble slice = 0.1f * (gdouble) i;
+		cd_color_rgb_set (&rgb, slice, 0.f, 0.f);
+		cd_color_xyz_set (&xyz, 0.f, 20.f * pow (slice, 2.2), 0.f);
+		cd_it8_add_data (it8, &rgb, &xyz);
+		cd_color_rgb_set (&rgb, 0.f, slice, 0.f);
+		cd_color_xyz_set (&xyz, 0.f, 70.f * pow (slice, 2.4), 0.f);
+		cd_it8_add_data (it8, &rgb, &xyz);
+		cd_color_rgb_set (&rgb, slice, slice, slice);
+		cd_color_xyz_set (&xyz, 0.f, 100.f * pow (slice, 2.0), 0.f);
+		cd_it8_add_data (it8, &rgb, &xyz);
+	}
+	gamma = cd_it8_utils_gamma_new (it8, &error);
+	g_assert_no_error (error);
+	g_assert (gamma != NULL);
+	g_assert (cd_it8_utils_gamma_get_fit (gamma, CD_IT8_UTILS_GAMMA_CHANNEL_RED, &gamma_est, &r2));
+	g_assert_cmpfloat (ABS (gamma_est - 2.2f), <, 0.001f);
+	g_assert_cmpfloat (r2, >, 0.999f);
+	g_assert (cd_it8_utils_gamma_get_fit (gamma, CD_IT8_UTILS_GAMMA_CHANNEL_GREEN, &gamma_est, NULL));
+	g_assert_cmpfloat (ABS (gamma_est - 2.4f), <, 0.001f);
+	g_assert (cd_it8_utils_gamma_get_fit (gamma, CD_IT8_UTILS_GAMMA_CHANNEL_GRAY, &gamma_est, NULL));
+	g_assert_cmpfloat (ABS (gamma_est - 2.0f), <, 0.001f);
+	g_assert (!cd_it8_utils_gamma_get_fit (gamma, CD_IT8_UTILS_GAMMA_CHANNEL_BLUE, NULL, NULL));
+	residuals = cd_it8_utils_gamma_get_residuals (gamma, CD_IT8_UTILS_GAMMA_CHANNEL_RED, &len);
+	g_assert_cmpint (len, ==, 10);
+	for (j = 0; j < len; j++)
+		g_assert_cmpfloat (ABS (residuals[j]), <, 0.001f);
+
+	/* no ramps at all */
+	g_assert (cd_it8_utils_gamma_new (it8_empty, &error) == NULL);
+	g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_FAILED);
+
+	/* many sets at once */
+	it8s[0] = it8;
+	it8s[1] = it8_empty;
+	it8s[2] = it8;
+	cd_it8_utils_gamma_new_batch (it8s, results, 3);
+	g_assert (results[0] != NULL);
+	g_assert (results[1] == NULL);
+	g_assert (results[2] != NULL);
+	g_assert (cd_it8_utils_gamma_get_fit (results[2], CD_IT8_UTILS_GAMMA_CHANNEL_GREEN, &gamma_est, NULL));
+	g_assert_cmpfloat (ABS (gamma_est - 2.4f), <, 0.001f);
+	cd_it8_utils_gamma_free (results[0]);
+	cd_it8_utils_gamma_free (results[2]);
+}
+
+static void
+colord_it8_verify_func (void)
+{
+	CdColorRGB rgb[125];
+	CdColorXYZ xyz[125];
+	gboolean ret;
+	gdouble delta_e[125];
+	gdouble values[] = { 4.f, 1.f, 3.f, 2.f };
+	guint i;
+	g_autoptr(CdIcc) icc = cd_icc_new ();
+	g_autoptr(CdIt8) it8 = cd_it8_new_with_kind (CD_IT8_KIND_TI3);
+	g_autoptr(CdIt8) it8_ccmx = cd_it8_new_with_kind (CD_IT8_KIND_CCMX);
+	g_autoptr(CdTransform) transform = cd_transform_new ();
+	g_autoptr(GError) error = NULL;
+
+	/* percentiles interpolate between the sorted values */
+	g_assert_cmpfloat (ABS (cd_it8_utils_get_percentile (values, 4, 0.f) - 1.f), <, 0.001);
+	g_assert_cmpfloat (ABS (cd_it8_utils_get_percentile (values, 4, 50.f) - 2.5f), <, 0.001);
+	g_assert_cmpfloat (ABS (cd_it8_utils_get_percentile (values, 4, 100.f) - 4.f), <, 0.001);
+	g_assert_cmpfloat (cd_it8_utils_get_percentile (values, 0, 50.f), ==, 0.f);
+
+	/* make a chart that exactly matches sRGB */
+	ret = cd_icc_create_default (icc, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < 125; i++) {
+		cd_color_rgb_set (&rgb[i],
+				  (gdouble) (i % 5) / 4.f,
+				  (gdouble) ((i / 5) % 5) / 4.f,
+				  (gdouble) (i / 25) / 4.f);
+	}
+	cd_transform_set_input_icc (transform, icc);
+	cd_transform_set_input_pixel_format (transform, CD_PIXEL_FORMAT_RGB_DOUBLE);
+	cd_transform_set_output_pixel_format (transform, CD_PIXEL_FORMAT_XYZ_DOUBLE);
+	cd_transform_set_rendering_intent (transform, CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC);
+	ret = cd_transform_process_array (transform, rgb, xyz, 125, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* one patch was printed wrongly */
+	xyz[62].X *= 1.2f;
+	for (i = 0; i < 125; i++)
+		cd_it8_add_data (it8, &rgb[i], &xyz[i]);
+	ret = cd_it8_utils_verify_profile (it8, icc, delta_e, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; i < 125; i++) {
+		if (i == 62)
+			g_assert_cmpfloat (delta_e[i], >, 2.f);
+		else
+			g_assert_cmpfloat (delta_e[i], <, 0.5f);
+	}
+	g_assert_cmpfloat (cd_it8_utils_get_percentile (delta_e, 125, 95.f), <, 0.5f);
+
+	/* only measurements can be verified */
+	ret = cd_it8_utils_verify_profile (it8_ccmx, icc, delta_e, &error);
+	g_assert_error (error, CD_IT8_ERROR, CD_IT8_ERROR_FAILED);
+	g_assert (!ret);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -2399,41 +5297,78 @@ main (int argc, char **argv)
 	/* tests go here */
 	g_test_add_func ("/colord/spectrum", colord_spectrum_func);
 	g_test_add_func ("/colord/spectrum{planckian}", colord_spectrum_planckian_func);
+	g_test_add_func ("/colord/spectrum{reference}", colord_spectrum_reference_func);
 	g_test_add_func ("/colord/spectrum{subtract}", colord_spectrum_subtract_func);
 	g_test_add_func ("/colord/spectrum{cx}", colord_spect_cx_func);
 	g_test_add_func ("/colord/edid", colord_edid_func);
 	g_test_add_func ("/colord/transform", colord_transform_func);
+	g_test_add_func ("/colord/transform{async}", colord_transform_async_func);
+	g_test_add_func ("/colord/transform{lut}", colord_transform_lut_func);
+	g_test_add_func ("/colord/transform{shaper}", colord_transform_shaper_func);
+	g_test_add_func ("/colord/transform{swizzle}", colord_transform_swizzle_func);
+	g_test_add_func ("/colord/transform{depth}", colord_transform_depth_func);
+	g_test_add_func ("/colord/transform{stride}", colord_transform_stride_func);
+	g_test_add_func ("/colord/transform{lut3d}", colord_transform_lut3d_func);
+	g_test_add_func ("/colord/transform{array}", colord_transform_array_func);
+	g_test_add_func ("/colord/transform{stream}", colord_transform_stream_func);
+	g_test_add_func ("/colord/transform{devicelink}", colord_transform_devicelink_func);
+	g_test_add_func ("/colord/transform{proof}", colord_transform_proof_func);
 	g_test_add_func ("/colord/icc", colord_icc_func);
 	g_test_add_func ("/colord/icc{util}", colord_icc_util_func);
+	g_test_add_func ("/colord/icc{vcgt-batch}", colord_icc_vcgt_batch_func);
 	g_test_add_func ("/colord/icc{localized}", colord_icc_localized_func);
 	g_test_add_func ("/colord/icc{edid}", colord_icc_edid_func);
+	g_test_add_func ("/colord/icc{edid-cache}", colord_icc_edid_cache_func);
 	g_test_add_func ("/colord/icc{characterization}", colord_icc_characterization_func);
 	g_test_add_func ("/colord/icc{save}", colord_icc_save_func);
+	g_test_add_func ("/colord/icc{save-stream}", colord_icc_save_stream_func);
+	g_test_add_func ("/colord/icc{peek}", colord_icc_peek_func);
+	g_test_add_func ("/colord/icc{release-handle}", colord_icc_release_handle_func);
+	g_test_add_func ("/colord/icc{threads}", colord_icc_threads_func);
+	g_test_add_func ("/colord/icc{named-colors}", colord_icc_named_colors_func);
 	g_test_add_func ("/colord/icc{empty}", colord_icc_empty_func);
 	g_test_add_func ("/colord/icc{corrupt-dict}", colord_icc_corrupt_dict_func);
 	g_test_add_func ("/colord/icc{clear}", colord_icc_clear_func);
 	g_test_add_func ("/colord/icc{tags}", colord_icc_tags_func);
 	g_test_add_func ("/colord/icc-store", colord_icc_store_func);
+	g_test_add_func ("/colord/icc-store{parallel}", colord_icc_store_parallel_func);
+	g_test_add_func ("/colord/icc-store{checksum-cache}", colord_icc_store_checksum_cache_func);
+	g_test_add_func ("/colord/icc-store{duplicate}", colord_icc_store_duplicate_func);
+	g_test_add_func ("/colord/icc-store{index}", colord_icc_store_index_func);
+	g_test_add_func ("/colord/icc-store{bundle}", colord_icc_store_bundle_func);
+	g_test_add_func ("/colord/icc-store{changes}", colord_icc_store_changes_func);
+	g_test_add_func ("/colord/icc-store{cold}", colord_icc_store_cold_func);
 	g_test_add_func ("/colord/buffer", colord_buffer_func);
+	g_test_add_func ("/colord/buffer{array}", colord_buffer_array_func);
 	g_test_add_func ("/colord/enum", colord_enum_func);
 	g_test_add_func ("/colord/dom", colord_dom_func);
+	g_test_add_func ("/colord/dom{path}", colord_dom_path_func);
 	g_test_add_func ("/colord/dom{color}", colord_dom_color_func);
 	g_test_add_func ("/colord/dom{localized}", colord_dom_localized_func);
 	g_test_add_func ("/colord/interp{linear}", colord_interp_linear_func);
 	g_test_add_func ("/colord/interp{akima}", colord_interp_akima_func);
+	g_test_add_func ("/colord/interp{monotone}", colord_interp_monotone_func);
 	g_test_add_func ("/colord/color", colord_color_func);
+	g_test_add_func ("/colord/color{array}", colord_color_array_func);
+	g_test_add_func ("/colord/color{cct}", colord_color_cct_func);
 	g_test_add_func ("/colord/color{interpolate}", colord_color_interpolate_func);
 	g_test_add_func ("/colord/color{blackbody}", colord_color_blackbody_func);
 	g_test_add_func ("/colord/math", cd_test_math_func);
+	g_test_add_func ("/colord/it8{reader}", colord_it8_reader_func);
 	g_test_add_func ("/colord/it8{raw}", colord_it8_raw_func);
 	g_test_add_func ("/colord/it8{gamma}", colord_it8_gamma_func);
+	g_test_add_func ("/colord/it8{gamma-fit}", colord_it8_gamma_fit_func);
+	g_test_add_func ("/colord/it8{verify}", colord_it8_verify_func);
 	g_test_add_func ("/colord/it8{locale}", colord_it8_locale_func);
+	g_test_add_func ("/colord/it8{stream}", colord_it8_stream_func);
 	g_test_add_func ("/colord/it8{normalized}", colord_it8_normalized_func);
 	g_test_add_func ("/colord/it8{ccmx}", colord_it8_ccmx_func);
 	g_test_add_func ("/colord/it8{ccmx-util}", colord_it8_ccmx_util_func);
+	g_test_add_func ("/colord/it8{ccmx-lsq}", colord_it8_ccmx_lsq_func);
 	g_test_add_func ("/colord/it8{spectra-util}", colord_it8_spectra_util_func);
 	g_test_add_func ("/colord/it8{cri-util}", colord_it8_cri_util_func);
 	g_test_add_func ("/colord/it8{ccss}", colord_it8_ccss_func);
+	g_test_add_func ("/colord/it8{store}", colord_it8_store_func);
 	g_test_add_func ("/colord/it8{spect}", colord_it8_spect_func);
 
 	return g_test_run ();
@@ -0,0 +1,48 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (CD_COMPILATION)
+#error "You cannot include this file externaly"
+#endif
+
+#ifndef __CD_TRACE_PRIVATE_H
+#define __CD_TRACE_PRIVATE_H
+
+/*
+ * Static probes in the "colord" provider, built with -Dusdt=true.
+ * These cost a single nop until something attaches, for instance:
+ *
+ *   bpftrace -e 'usdt:/usr/libexec/colord:colord:profile_load_end
+ *                { printf("%s\n", str(arg0)); }'
+ *
+ * Spans are pairs of NAME_begin and NAME_end probes. Arguments are not
+ * evaluated at all when the probes are compiled out.
+ */
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define CD_TRACE1(name, a)		DTRACE_PROBE1 (colord, name, a)
+#define CD_TRACE2(name, a, b)		DTRACE_PROBE2 (colord, name, a, b)
+#else
+#define CD_TRACE1(name, a)		do { } while (0)
+#define CD_TRACE2(name, a, b)		do { } while (0)
+#endif
+
+#endif /* __CD_TRACE_PRIVATE_H */
@@ -0,0 +1,53 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (CD_COMPILATION)
+#error "You cannot include this file externaly"
+#endif
+
+#ifndef __CD_TRANSFORM_PRIVATE_H
+#define __CD_TRANSFORM_PRIVATE_H
+
+#include <glib.h>
+
+#include "cd-transform.h"
+
+G_BEGIN_DECLS
+
+gboolean	 cd_transform_prepare		(CdTransform	*transform,
+						 GError		**error);
+guint		 cd_transform_get_bpp_input	(CdTransform	*transform);
+guint		 cd_transform_get_bpp_output	(CdTransform	*transform);
+gboolean	 cd_transform_get_use_shaper	(CdTransform	*transform);
+gboolean	 cd_transform_get_use_swizzle	(CdTransform	*transform);
+guint64		 cd_transform_process_chunk	(CdTransform	*transform,
+						 const guint8	*data_in,
+						 guint8		*data_out,
+						 guint		 width,
+						 guint		 n_rows,
+						 gsize		 rowstride_in,
+						 gsize		 rowstride_out);
+void		 cd_transform_set_gamut_alarm_count (CdTransform	*transform,
+						 guint64	 gamut_alarm_count);
+
+G_END_DECLS
+
+#endif /* __CD_TRANSFORM_PRIVATE_H */
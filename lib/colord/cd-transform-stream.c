@@ -0,0 +1,414 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:cd-transform-stream
+ * @short_description: Transform an image a few rows at a time
+ *
+ * This object allows images that are too large to fit in memory to be
+ * converted using a #CdTransform. Rows are written to the stream as they
+ * are decoded, converted by a pool of worker threads, and then passed back
+ * to the caller in the same order they were written.
+ *
+ * The number of rows in flight is bounded, so the memory used does not
+ * depend on the size of the image.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <lcms2.h>
+#include <string.h>
+
+#include "cd-transform-private.h"
+#include "cd-transform-stream.h"
+
+static void	cd_transform_stream_finalize	(GObject		*object);
+
+#define GET_PRIVATE(o) (cd_transform_stream_get_instance_private (o))
+
+/* by default keep about this many rows being processed */
+#define CD_TRANSFORM_STREAM_MAX_ROWS_DEFAULT	256
+
+typedef struct {
+	guint8			*data_in;
+	guint8			*data_out;
+	guint			 n_rows;
+	guint64			 gamut_alarm_count;
+	gboolean		 done;
+} CdTransformStreamChunk;
+
+/**
+ * CdTransformStreamPrivate:
+ *
+ * Private #CdTransformStream data
+ **/
+typedef struct
+{
+	CdTransform		*transform;
+	CdTransformStreamFunc	 func;
+	gpointer		 user_data;
+	GThreadPool		*pool;
+	GQueue			*chunks;	/* in write order */
+	GMutex			 mutex;
+	GCond			 cond;
+	guint			 width;
+	guint			 max_rows;
+	guint			 rows_in_flight;
+	gsize			 rowstride_in;
+	gsize			 rowstride_out;
+	guint64			 gamut_alarm_count;
+	gboolean		 prepared;
+	gboolean		 closed;
+} CdTransformStreamPrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE (CdTransformStream, cd_transform_stream, G_TYPE_OBJECT)
+
+static void
+cd_transform_stream_chunk_free (CdTransformStreamChunk *chunk)
+{
+	g_free (chunk->data_in);
+	g_free (chunk->data_out);
+	g_free (chunk);
+}
+
+static void
+cd_transform_stream_process_func (gpointer data, gpointer user_data)
+{
+	CdTransformStreamChunk *chunk = (CdTransformStreamChunk *) data;
+	CdTransformStream *stream = CD_TRANSFORM_STREAM (user_data);
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+
+	chunk->gamut_alarm_count =
+		cd_transform_process_chunk (priv->transform,
+					    chunk->data_in,
+					    chunk->data_out,
+					    priv->width,
+					    chunk->n_rows,
+					    priv->rowstride_in,
+					    priv->rowstride_out);
+
+	/* the input is no longer required */
+	g_clear_pointer (&chunk->data_in, g_free);
+
+	g_mutex_lock (&priv->mutex);
+	chunk->done = TRUE;
+	g_cond_broadcast (&priv->cond);
+	g_mutex_unlock (&priv->mutex);
+}
+
+/* emits completed chunks in order, waiting until no more than @max_rows
+ * are still in flight */
+static void
+cd_transform_stream_flush (CdTransformStream *stream, guint max_rows)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+
+	g_mutex_lock (&priv->mutex);
+	for (;;) {
+		CdTransformStreamChunk *chunk = g_queue_peek_head (priv->chunks);
+		if (chunk == NULL)
+			break;
+		if (!chunk->done) {
+			if (priv->rows_in_flight <= max_rows)
+				break;
+			g_cond_wait (&priv->cond, &priv->mutex);
+			continue;
+		}
+		g_queue_pop_head (priv->chunks);
+		priv->rows_in_flight -= chunk->n_rows;
+
+		/* only counted in order, from the thread that writes */
+		priv->gamut_alarm_count += chunk->gamut_alarm_count;
+		cd_transform_set_gamut_alarm_count (priv->transform,
+						    priv->gamut_alarm_count);
+
+		/* do not call out with the lock held */
+		g_mutex_unlock (&priv->mutex);
+		priv->func (chunk->data_out,
+			    chunk->n_rows,
+			    priv->rowstride_out,
+			    priv->user_data);
+		cd_transform_stream_chunk_free (chunk);
+		g_mutex_lock (&priv->mutex);
+	}
+	g_mutex_unlock (&priv->mutex);
+}
+
+static gboolean
+cd_transform_stream_prepare (CdTransformStream *stream, GError **error)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+	CdPixelFormat format_in = cd_transform_get_input_pixel_format (priv->transform);
+	CdPixelFormat format_out = cd_transform_get_output_pixel_format (priv->transform);
+	guint max_threads;
+
+	if (priv->prepared)
+		return TRUE;
+	if (!cd_transform_prepare (priv->transform, error))
+		return FALSE;
+	if (T_PLANAR (format_in) || T_PLANAR (format_out)) {
+		g_set_error_literal (error,
+				     CD_TRANSFORM_ERROR,
+				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+				     "planar formats cannot be streamed");
+		return FALSE;
+	}
+	priv->rowstride_in = (gsize) priv->width * cd_transform_get_bpp_input (priv->transform);
+	priv->rowstride_out = (gsize) priv->width * cd_transform_get_bpp_output (priv->transform);
+	cd_transform_set_gamut_alarm_count (priv->transform, 0);
+
+	/* use the same number of threads as the transform would */
+	max_threads = cd_transform_get_max_threads (priv->transform);
+	priv->pool = g_thread_pool_new (cd_transform_stream_process_func,
+					stream,
+					MAX (max_threads, 1),
+					TRUE,
+					error);
+	if (priv->pool == NULL)
+		return FALSE;
+	priv->prepared = TRUE;
+	return TRUE;
+}
+
+/**
+ * cd_transform_stream_set_max_rows:
+ * @stream: a #CdTransformStream instance.
+ * @max_rows: the number of rows
+ *
+ * Sets the maximum number of rows that can be waiting to be converted or
+ * passed back to the caller before cd_transform_stream_write() blocks.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_stream_set_max_rows (CdTransformStream *stream, guint max_rows)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+	g_return_if_fail (CD_IS_TRANSFORM_STREAM (stream));
+	g_return_if_fail (max_rows > 0);
+	priv->max_rows = max_rows;
+}
+
+/**
+ * cd_transform_stream_get_max_rows:
+ * @stream: a #CdTransformStream instance.
+ *
+ * Gets the maximum number of rows that can be in flight.
+ *
+ * Return value: the number of rows
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_transform_stream_get_max_rows (CdTransformStream *stream)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+	g_return_val_if_fail (CD_IS_TRANSFORM_STREAM (stream), 0);
+	return priv->max_rows;
+}
+
+/**
+ * cd_transform_stream_write:
+ * @stream: a #CdTransformStream instance.
+ * @data: the rows to convert
+ * @n_rows: the number of rows in @data
+ * @rowstride: the number of bytes between the start of each row in @data
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Queues some rows to be converted. The data is copied, so @data can be
+ * reused as soon as this function returns.
+ *
+ * Any rows that have already been converted are passed to the
+ * #CdTransformStreamFunc from this function, and if too many rows are in
+ * flight this blocks until some have completed.
+ *
+ * Return value: %TRUE if the rows were queued
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_stream_write (CdTransformStream *stream,
+			   gconstpointer data,
+			   guint n_rows,
+			   gsize rowstride,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	CdTransformStreamChunk *chunk;
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+	const guint8 *p = data;
+	guint i;
+
+	g_return_val_if_fail (CD_IS_TRANSFORM_STREAM (stream), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	if (priv->closed) {
+		g_set_error_literal (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_CLOSED,
+				     "stream is already closed");
+		return FALSE;
+	}
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+	if (n_rows == 0)
+		return TRUE;
+	if (!cd_transform_stream_prepare (stream, error))
+		return FALSE;
+	if (rowstride < priv->rowstride_in) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_INVALID_ARGUMENT,
+			     "rowstride %" G_GSIZE_FORMAT " is smaller than row size %" G_GSIZE_FORMAT,
+			     rowstride, priv->rowstride_in);
+		return FALSE;
+	}
+
+	/* copy the rows so the caller can reuse the buffer */
+	chunk = g_new0 (CdTransformStreamChunk, 1);
+	chunk->n_rows = n_rows;
+	chunk->data_in = g_malloc (priv->rowstride_in * n_rows);
+	chunk->data_out = g_malloc (priv->rowstride_out * n_rows);
+	for (i = 0; i < n_rows; i++) {
+		memcpy (chunk->data_in + i * priv->rowstride_in,
+			p + i * rowstride,
+			priv->rowstride_in);
+	}
+	g_mutex_lock (&priv->mutex);
+	g_queue_push_tail (priv->chunks, chunk);
+	priv->rows_in_flight += n_rows;
+	g_mutex_unlock (&priv->mutex);
+	if (!g_thread_pool_push (priv->pool, chunk, error)) {
+		g_mutex_lock (&priv->mutex);
+		g_queue_remove (priv->chunks, chunk);
+		priv->rows_in_flight -= n_rows;
+		g_mutex_unlock (&priv->mutex);
+		cd_transform_stream_chunk_free (chunk);
+		return FALSE;
+	}
+
+	/* pass back anything that is ready, blocking if too much is queued */
+	cd_transform_stream_flush (stream, priv->max_rows);
+	return TRUE;
+}
+
+/**
+ * cd_transform_stream_close:
+ * @stream: a #CdTransformStream instance.
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Waits for all the queued rows to be converted and passed to the
+ * #CdTransformStreamFunc. No more rows can be written after this.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_stream_close (CdTransformStream *stream,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+
+	g_return_val_if_fail (CD_IS_TRANSFORM_STREAM (stream), FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	if (priv->closed)
+		return TRUE;
+	priv->closed = TRUE;
+	cd_transform_stream_flush (stream, 0);
+	return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+static void
+cd_transform_stream_class_init (CdTransformStreamClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = cd_transform_stream_finalize;
+}
+
+static void
+cd_transform_stream_init (CdTransformStream *stream)
+{
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+	priv->chunks = g_queue_new ();
+	priv->max_rows = CD_TRANSFORM_STREAM_MAX_ROWS_DEFAULT;
+	g_mutex_init (&priv->mutex);
+	g_cond_init (&priv->cond);
+}
+
+static void
+cd_transform_stream_finalize (GObject *object)
+{
+	CdTransformStream *stream = CD_TRANSFORM_STREAM (object);
+	CdTransformStreamPrivate *priv = GET_PRIVATE (stream);
+
+	/* wait for the workers, but do not emit anything */
+	if (priv->pool != NULL)
+		g_thread_pool_free (priv->pool, FALSE, TRUE);
+	g_queue_free_full (priv->chunks, (GDestroyNotify) cd_transform_stream_chunk_free);
+	g_mutex_clear (&priv->mutex);
+	g_cond_clear (&priv->cond);
+	g_object_unref (priv->transform);
+
+	G_OBJECT_CLASS (cd_transform_stream_parent_class)->finalize (object);
+}
+
+/**
+ * cd_transform_stream_new:
+ * @transform: a #CdTransform instance.
+ * @width: the width of each row in pixels
+ * @func: (scope call): the function to call with the converted rows
+ * @user_data: user data for @func
+ *
+ * Creates a new #CdTransformStream object. The transform must not be
+ * modified while the stream is in use.
+ *
+ * Return value: a new CdTransformStream object.
+ *
+ * Since: 1.4.10
+ **/
+CdTransformStream *
+cd_transform_stream_new (CdTransform *transform,
+			 guint width,
+			 CdTransformStreamFunc func,
+			 gpointer user_data)
+{
+	CdTransformStream *stream;
+	CdTransformStreamPrivate *priv;
+
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), NULL);
+	g_return_val_if_fail (width > 0, NULL);
+	g_return_val_if_fail (func != NULL, NULL);
+
+	stream = g_object_new (CD_TYPE_TRANSFORM_STREAM, NULL);
+	priv = GET_PRIVATE (stream);
+	priv->transform = g_object_ref (transform);
+	priv->width = width;
+	priv->func = func;
+	priv->user_data = user_data;
+	return CD_TRANSFORM_STREAM (stream);
+}
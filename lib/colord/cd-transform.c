@@ -33,10 +33,14 @@
 #include "config.h"
 
 #include <glib.h>
+#include <math.h>
+#include <string.h>
 #include <lcms2.h>
 
 #include "cd-context-lcms.h"
+#include "cd-math.h"
 #include "cd-transform.h"
+#include "cd-transform-private.h"
 
 static void	cd_transform_class_init		(CdTransformClass	*klass);
 static void	cd_transform_init		(CdTransform		*transform);
@@ -44,6 +48,52 @@ static void	cd_transform_finalize		(GObject		*object);
 
 #define GET_PRIVATE(o) (cd_transform_get_instance_private (o))
 
+/* a compiled transform that can be shared between CdTransform instances */
+typedef struct {
+	gchar			*key;
+	cmsContext		 context_lcms;
+	cmsHTRANSFORM		 lcms_transform;
+	guint			 refcount;
+} CdTransformCacheItem;
+
+/* the number of unused compiled transforms to keep around */
+#define CD_TRANSFORM_CACHE_SIZE_MAX		32
+
+static GMutex	 cd_transform_cache_mutex;
+static GQueue	 cd_transform_cache = G_QUEUE_INIT;	/* most recent first */
+
+/* a precomputed 3D lookup table for 8 bit RGB formats */
+typedef struct {
+	guint			 size;
+	guint16			*table;		/* size^3 RGB entries */
+	guint			 index[256];
+	guint			 frac[256];	/* 0..65536 */
+	guint			 in_offset[3];
+	guint			 out_offset[3];
+} CdTransformLut;
+
+/* the number of steps in the output curves of the matrix/shaper kernel,
+ * which are indexed by sqrt(value) to give more precision near black */
+#define CD_TRANSFORM_SHAPER_ENCODE_SIZE		4096
+
+/* a precomputed matrix/shaper kernel for 8 bit RGB formats */
+typedef struct {
+	gfloat			 decode[3][256];
+	gfloat			 matrix[9];
+	guint8			 encode[3][CD_TRANSFORM_SHAPER_ENCODE_SIZE + 1];
+	guint			 in_offset[3];
+	guint			 out_offset[3];
+} CdTransformShaper;
+
+/* an identity colour conversion that only has to reorder the channels */
+typedef struct {
+	gboolean		 copy;		/* same pixel format */
+	gboolean		 swap_rb;	/* RGBA32 <-> BGRA32 */
+	guint			 n_channels;
+	guint			 in_offset[4];
+	guint			 out_offset[4];
+} CdTransformSwizzle;
+
 /**
  * CdTransformPrivate:
  *
@@ -54,18 +104,37 @@ typedef struct
 	CdIcc			*input_icc;
 	CdIcc			*output_icc;
 	CdIcc			*abstract_icc;
+	CdIcc			*proof_icc;
 	CdPixelFormat		 input_pixel_format;
 	CdPixelFormat		 output_pixel_format;
 	CdRenderingIntent	 rendering_intent;
 	cmsContext		 context_lcms;
 	cmsHPROFILE		 srgb;
+	cmsHPROFILE		 xyz;
+	cmsHPROFILE		 lab;
 	cmsHTRANSFORM		 lcms_transform;
+	CdTransformCacheItem	*cache_item;
+	CdTransformLut		*lut;
+	CdTransformShaper	*shaper;
+	CdTransformSwizzle	*swizzle;
+	guint			 lut_size;
+	gchar			*cache_directory;
 	gboolean		 bpc;
 	guint			 max_threads;
+	guint			 inline_threshold;
 	guint			 bpp_input;
 	guint			 bpp_output;
+	GThreadPool		*pool;
+	gboolean		 gamut_check;
+	CdColorRGB		 gamut_alarm;
+	cmsContext		 context_gamut;
+	cmsHTRANSFORM		 gamut_transform;
+	guint64			 gamut_alarm_count;
 } CdTransformPrivate;
 
+/* images smaller than this are not worth handing to the pool */
+#define CD_TRANSFORM_INLINE_THRESHOLD_DEFAULT	(128 * 128)
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdTransform, cd_transform, G_TYPE_OBJECT)
 
 enum {
@@ -96,13 +165,44 @@ cd_transform_error_quark (void)
 	return quark;
 }
 
+/* must be called with cd_transform_cache_mutex held */
+static void
+cd_transform_cache_item_unref (CdTransformCacheItem *item)
+{
+	if (--item->refcount > 0)
+		return;
+	cmsDeleteTransform (item->lcms_transform);
+	cd_context_lcms_free (item->context_lcms);
+	g_free (item->key);
+	g_free (item);
+}
+
 static void
 cd_transform_invalidate (CdTransform *transform)
 {
 	CdTransformPrivate *priv = GET_PRIVATE (transform);
-	if (priv->lcms_transform != NULL)
+	if (priv->cache_item != NULL) {
+		g_mutex_lock (&cd_transform_cache_mutex);
+		cd_transform_cache_item_unref (priv->cache_item);
+		g_mutex_unlock (&cd_transform_cache_mutex);
+		priv->cache_item = NULL;
+	} else if (priv->lcms_transform != NULL) {
 		cmsDeleteTransform (priv->lcms_transform);
+	}
 	priv->lcms_transform = NULL;
+	if (priv->gamut_transform != NULL) {
+		cmsDeleteTransform (priv->gamut_transform);
+		priv->gamut_transform = NULL;
+	}
+	if (priv->lut != NULL) {
+		g_free (priv->lut->table);
+		g_free (priv->lut);
+		priv->lut = NULL;
+	}
+	g_free (priv->shaper);
+	priv->shaper = NULL;
+	g_free (priv->swizzle);
+	priv->swizzle = NULL;
 }
 
 /**
@@ -244,6 +344,155 @@ cd_transform_get_abstract_icc (CdTransform *transform)
 	return priv->abstract_icc;
 }
 
+/**
+ * cd_transform_set_proof_icc:
+ * @transform: a #CdTransform instance.
+ * @icc: a #CdIcc instance or %NULL.
+ *
+ * Sets the profile of the device to simulate, for instance a printing press.
+ * When set, the transform soft-proofs the input on the output device, using
+ * relative colorimetric to map the proofed result to the output profile.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_proof_icc (CdTransform *transform, CdIcc *icc)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+	g_return_if_fail (icc == NULL || CD_IS_ICC (icc));
+
+	/* no change */
+	if (priv->proof_icc == icc)
+		return;
+
+	if (priv->proof_icc != NULL)
+		g_clear_object (&priv->proof_icc);
+	if (icc != NULL)
+		priv->proof_icc = g_object_ref (icc);
+	cd_transform_invalidate (transform);
+}
+
+/**
+ * cd_transform_get_proof_icc:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the profile of the device that is being simulated.
+ *
+ * Return value: (transfer none): The proofing profile, or %NULL
+ *
+ * Since: 1.4.10
+ **/
+CdIcc *
+cd_transform_get_proof_icc (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), NULL);
+	return priv->proof_icc;
+}
+
+/**
+ * cd_transform_set_gamut_check:
+ * @transform: a #CdTransform instance.
+ * @gamut_check: if out-of-gamut pixels should be marked
+ *
+ * Sets if pixels that cannot be reproduced by the proofing profile should
+ * be replaced by the gamut alarm colour, and counted.
+ * This has no effect unless cd_transform_set_proof_icc() has been used.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_gamut_check (CdTransform *transform, gboolean gamut_check)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+
+	priv->gamut_check = gamut_check;
+	cd_transform_invalidate (transform);
+}
+
+/**
+ * cd_transform_get_gamut_check:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets if out-of-gamut pixels are marked with the gamut alarm colour.
+ *
+ * Return value: %TRUE if the gamut check is enabled
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_get_gamut_check (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), FALSE);
+	return priv->gamut_check;
+}
+
+/**
+ * cd_transform_set_gamut_alarm:
+ * @transform: a #CdTransform instance.
+ * @alarm: the colour to use for out-of-gamut pixels
+ *
+ * Sets the colour, in the output colorspace, that is used to replace any
+ * pixels that are out of the gamut of the proofing profile.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_gamut_alarm (CdTransform *transform, const CdColorRGB *alarm)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+	g_return_if_fail (alarm != NULL);
+
+	cd_color_rgb_copy (alarm, &priv->gamut_alarm);
+	cd_transform_invalidate (transform);
+}
+
+/**
+ * cd_transform_get_gamut_alarm:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the colour used for out-of-gamut pixels.
+ *
+ * Return value: the gamut alarm colour
+ *
+ * Since: 1.4.10
+ **/
+const CdColorRGB *
+cd_transform_get_gamut_alarm (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), NULL);
+	return &priv->gamut_alarm;
+}
+
+/**
+ * cd_transform_get_gamut_alarm_count:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the number of pixels that were out of the gamut of the proofing
+ * profile in the last call to cd_transform_process() or
+ * cd_transform_process_full(), or in the rows passed back so far by the
+ * last #CdTransformStream that used the transform.
+ *
+ * Return value: the number of out-of-gamut pixels
+ *
+ * Since: 1.4.10
+ **/
+guint64
+cd_transform_get_gamut_alarm_count (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), 0);
+	return priv->gamut_alarm_count;
+}
+
 /**
  * cd_transform_set_input_pixel_format:
  * @transform: a #CdTransform instance.
@@ -434,16 +683,147 @@ cd_transform_get_max_threads (CdTransform *transform)
 	return priv->max_threads;
 }
 
-/* map lcms intent to colord type */
-const struct {
-	gint					lcms;
-	CdRenderingIntent			colord;
-} map_rendering_intent[] = {
-	{ INTENT_PERCEPTUAL,		CD_RENDERING_INTENT_PERCEPTUAL },
-	{ INTENT_ABSOLUTE_COLORIMETRIC,	CD_RENDERING_INTENT_ABSOLUTE_COLORIMETRIC },
-	{ INTENT_RELATIVE_COLORIMETRIC,	CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC },
-	{ INTENT_SATURATION,		CD_RENDERING_INTENT_SATURATION },
-	{ 0,				CD_RENDERING_INTENT_LAST }
+/**
+ * cd_transform_set_inline_threshold:
+ * @transform: a #CdTransform instance.
+ * @inline_threshold: number of pixels, or 0 to always use the worker threads
+ *
+ * Sets the image size below which the transform is done in the calling
+ * thread rather than being split up between the worker threads.
+ *
+ * Small images are faster to convert inline as the cost of waking up the
+ * worker threads is larger than the cost of the pixel conversion itself.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_inline_threshold (CdTransform *transform, guint inline_threshold)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+	priv->inline_threshold = inline_threshold;
+}
+
+/**
+ * cd_transform_get_inline_threshold:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the image size below which the transform is done in the calling thread.
+ *
+ * Return value: number of pixels
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_transform_get_inline_threshold (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), 0);
+	return priv->inline_threshold;
+}
+
+/**
+ * cd_transform_set_lut_size:
+ * @transform: a #CdTransform instance.
+ * @lut_size: number of grid points in each dimension, or 0 to disable
+ *
+ * Sets the size of the 3D lookup table used to approximate the transform.
+ *
+ * When set, and both pixel formats are 8 bit RGB, the transform is sampled
+ * into a lookup table once and then each pixel is evaluated using
+ * tetrahedral interpolation rather than the full lcms pipeline.
+ * This is much faster for large images, at the cost of a small loss of
+ * accuracy. Typical values are 17, 33 or 65.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_lut_size (CdTransform *transform, guint lut_size)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+	g_return_if_fail (lut_size == 0 || (lut_size >= 2 && lut_size <= 256));
+
+	if (priv->lut_size == lut_size)
+		return;
+	priv->lut_size = lut_size;
+	cd_transform_invalidate (transform);
+}
+
+/**
+ * cd_transform_get_lut_size:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the size of the 3D lookup table used to approximate the transform.
+ *
+ * Return value: number of grid points, or 0 if disabled
+ *
+ * Since: 1.4.10
+ **/
+guint
+cd_transform_get_lut_size (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), 0);
+	return priv->lut_size;
+}
+
+/**
+ * cd_transform_set_cache_directory:
+ * @transform: a #CdTransform instance.
+ * @cache_directory: (nullable): a directory, or %NULL to disable
+ *
+ * Sets a directory where the compiled transform can be saved as a device
+ * link profile. When another transform with the same profiles, pixel
+ * formats, rendering intent and black point compensation is set up, even
+ * in a different process, the device link is loaded rather than the
+ * transform being compiled again.
+ *
+ * Only profiles that have a checksum are cached.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_set_cache_directory (CdTransform *transform, const gchar *cache_directory)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+
+	/* no change */
+	if (g_strcmp0 (priv->cache_directory, cache_directory) == 0)
+		return;
+	g_free (priv->cache_directory);
+	priv->cache_directory = g_strdup (cache_directory);
+	cd_transform_invalidate (transform);
+}
+
+/**
+ * cd_transform_get_cache_directory:
+ * @transform: a #CdTransform instance.
+ *
+ * Gets the directory used to save compiled transforms.
+ *
+ * Return value: the directory, or %NULL if unset
+ *
+ * Since: 1.4.10
+ **/
+const gchar *
+cd_transform_get_cache_directory (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), NULL);
+	return priv->cache_directory;
+}
+
+/* map colord type to lcms intent, indexed by #CdRenderingIntent */
+static const gint map_rendering_intent[CD_RENDERING_INTENT_LAST] = {
+	[CD_RENDERING_INTENT_UNKNOWN]			= -1,
+	[CD_RENDERING_INTENT_PERCEPTUAL]		= INTENT_PERCEPTUAL,
+	[CD_RENDERING_INTENT_ABSOLUTE_COLORIMETRIC]	= INTENT_ABSOLUTE_COLORIMETRIC,
+	[CD_RENDERING_INTENT_RELATIVE_COLORIMETRIC]	= INTENT_RELATIVE_COLORIMETRIC,
+	[CD_RENDERING_INTENT_SATURATION]		= INTENT_SATURATION,
 };
 
 static guint
@@ -457,41 +837,91 @@ cd_transform_get_bpp (CdPixelFormat format)
 	case CD_PIXEL_FORMAT_BGRA32:
 	case CD_PIXEL_FORMAT_RGBA32:
 		return 4;
+	case CD_PIXEL_FORMAT_RGB48:
+	case CD_PIXEL_FORMAT_RGB_HALF:
+		return 6;
+	case CD_PIXEL_FORMAT_RGBA64:
+	case CD_PIXEL_FORMAT_CMYK64:
+	case CD_PIXEL_FORMAT_RGBA_HALF:
+		return 8;
+	case CD_PIXEL_FORMAT_RGB_FLOAT:
+		return 12;
+	case CD_PIXEL_FORMAT_RGBA_FLOAT:
+		return 16;
+	case CD_PIXEL_FORMAT_RGB_DOUBLE:
+	case CD_PIXEL_FORMAT_XYZ_DOUBLE:
+	case CD_PIXEL_FORMAT_LAB_DOUBLE:
+		return 24;
+	/* for planar formats this is the size of one sample in a plane */
+	case CD_PIXEL_FORMAT_RGB24_PLANAR:
+	case CD_PIXEL_FORMAT_CMYK32_PLANAR:
+		return 1;
+	case CD_PIXEL_FORMAT_RGB48_PLANAR:
+		return 2;
+	case CD_PIXEL_FORMAT_RGB_FLOAT_PLANAR:
+		return 4;
 	case CD_PIXEL_FORMAT_UNKNOWN:
 	default:
 		return 0;
 	}
 }
 
-static gboolean
-cd_transform_setup (CdTransform *transform, GError **error)
+static gint
+cd_transform_get_lcms_intent (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	gint intent = -1;
+
+	/* find native rendering intent */
+	if (priv->rendering_intent < CD_RENDERING_INTENT_LAST)
+		intent = map_rendering_intent[priv->rendering_intent];
+	g_assert (intent >= 0);
+	return intent;
+}
+
+static cmsHPROFILE
+cd_transform_get_default_profile (CdTransform *transform, cmsUInt32Number format)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	switch (T_COLORSPACE (format)) {
+	case PT_XYZ:
+		g_debug ("no profile, assume XYZ for format");
+		if (priv->xyz == NULL)
+			priv->xyz = cmsCreateXYZProfileTHR (priv->context_lcms);
+		return priv->xyz;
+	case PT_Lab:
+		g_debug ("no profile, assume D50 Lab for format");
+		if (priv->lab == NULL)
+			priv->lab = cmsCreateLab4ProfileTHR (priv->context_lcms, NULL);
+		return priv->lab;
+	default:
+		g_debug ("no profile, assume sRGB");
+		return priv->srgb;
+	}
+}
+
+static cmsHTRANSFORM
+cd_transform_create_lcms (CdTransform *transform,
+			  cmsContext context_lcms,
+			  cmsUInt32Number format_in,
+			  cmsUInt32Number format_out,
+			  GError **error)
 {
 	CdTransformPrivate *priv = GET_PRIVATE (transform);
 	cmsHPROFILE profile_in;
 	cmsHPROFILE profile_out;
+	cmsHTRANSFORM lcms_transform;
 	cmsUInt32Number lcms_flags = 0;
-	gboolean ret = TRUE;
-	gint lcms_intent = -1;
-	guint i;
+	gint lcms_intent = cd_transform_get_lcms_intent (transform);
 	g_autoptr(GError) error_local = NULL;
 
-	/* find native rendering intent */
-	for (i = 0; map_rendering_intent[i].colord != CD_RENDERING_INTENT_LAST; i++) {
-		if (map_rendering_intent[i].colord == priv->rendering_intent) {
-			lcms_intent = map_rendering_intent[i].lcms;
-			break;
-		}
-	}
-	g_assert (lcms_intent != -1);
-
 	/* get input profile */
 	if (priv->input_icc != NULL) {
 		g_debug ("using input profile of %s",
 			 cd_icc_get_filename (priv->input_icc));
 		profile_in = cd_icc_get_handle (priv->input_icc);
 	} else {
-		g_debug ("no input profile, assume sRGB");
-		profile_in = priv->srgb;
+		profile_in = cd_transform_get_default_profile (transform, format_in);
 	}
 
 	/* get output profile */
@@ -500,8 +930,7 @@ cd_transform_setup (CdTransform *transform, GError **error)
 			 cd_icc_get_filename (priv->output_icc));
 		profile_out = cd_icc_get_handle (priv->output_icc);
 	} else {
-		g_debug ("no output profile, assume sRGB");
-		profile_out = priv->srgb;
+		profile_out = cd_transform_get_default_profile (transform, format_out);
 	}
 
 	/* get flags */
@@ -509,134 +938,1497 @@ cd_transform_setup (CdTransform *transform, GError **error)
 		lcms_flags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
 
 	/* get abstract profile */
-	if (priv->abstract_icc != NULL) {
-		cmsHPROFILE profiles[3];
+	if (priv->abstract_icc != NULL &&
+	    cd_icc_get_colorspace (priv->abstract_icc) != CD_COLORSPACE_LAB) {
+		g_set_error_literal (error,
+				     CD_TRANSFORM_ERROR,
+				     CD_TRANSFORM_ERROR_INVALID_COLORSPACE,
+				     "abstract colorspace has to be Lab");
+		return NULL;
+	}
 
-		if (cd_icc_get_colorspace (priv->abstract_icc) != CD_COLORSPACE_LAB) {
-			ret = FALSE;
-			g_set_error_literal (error,
-					     CD_TRANSFORM_ERROR,
-					     CD_TRANSFORM_ERROR_INVALID_COLORSPACE,
-					     "abstract colorspace has to be Lab");
-			goto out;
+	if (priv->proof_icc != NULL) {
+		cmsBool bpcs[5];
+		cmsFloat64Number adaptation[5];
+		cmsHPROFILE profiles[5];
+		cmsUInt32Number intents[5];
+		cmsUInt32Number n = 0;
+		cmsUInt32Number gamut_pos;
+
+		/* this is what cmsCreateProofingTransformTHR() does, but
+		 * with room for the abstract profile before the proof */
+		profiles[n++] = profile_in;
+		if (priv->abstract_icc != NULL)
+			profiles[n++] = cd_icc_get_handle (priv->abstract_icc);
+		gamut_pos = n;
+		profiles[n++] = cd_icc_get_handle (priv->proof_icc);
+		profiles[n++] = cd_icc_get_handle (priv->proof_icc);
+		profiles[n++] = profile_out;
+		for (guint i = 0; i < n; i++) {
+			intents[i] = lcms_intent;
+			bpcs[i] = priv->bpc;
+			adaptation[i] = 1.f;
 		}
+		intents[n - 2] = INTENT_RELATIVE_COLORIMETRIC;
+		intents[n - 1] = INTENT_RELATIVE_COLORIMETRIC;
+		lcms_flags |= cmsFLAGS_SOFTPROOFING;
+		if (priv->gamut_check) {
+			cmsUInt16Number alarm_codes[cmsMAXCHANNELS] = { 0 };
+			alarm_codes[0] = priv->gamut_alarm.R * 0xffff;
+			alarm_codes[1] = priv->gamut_alarm.G * 0xffff;
+			alarm_codes[2] = priv->gamut_alarm.B * 0xffff;
+			cmsSetAlarmCodesTHR (context_lcms, alarm_codes);
+			lcms_flags |= cmsFLAGS_GAMUTCHECK;
+		}
+		lcms_transform = cmsCreateExtendedTransform (context_lcms,
+							     n,
+							     profiles,
+							     bpcs,
+							     intents,
+							     adaptation,
+							     cd_icc_get_handle (priv->proof_icc),
+							     gamut_pos,
+							     format_in,
+							     format_out,
+							     lcms_flags);
+	} else if (priv->abstract_icc != NULL) {
+		cmsHPROFILE profiles[3];
 
 		/* generate a devicelink */
 		profiles[0] = profile_in;
 		profiles[1] = cd_icc_get_handle (priv->abstract_icc);
 		profiles[2] = profile_out;
-		priv->lcms_transform = cmsCreateMultiprofileTransformTHR (priv->context_lcms,
-									  profiles,
-									  3,
-									  priv->input_pixel_format,
-									  priv->output_pixel_format,
-									  lcms_intent,
-									  lcms_flags);
+		lcms_transform = cmsCreateMultiprofileTransformTHR (context_lcms,
+								    profiles,
+								    3,
+								    format_in,
+								    format_out,
+								    lcms_intent,
+								    lcms_flags);
 
 	} else {
 		/* create basic transform */
-		priv->lcms_transform = cmsCreateTransformTHR (priv->context_lcms,
-							      profile_in,
-							      priv->input_pixel_format,
-							      profile_out,
-							      priv->output_pixel_format,
-							      lcms_intent,
-							      lcms_flags);
+		lcms_transform = cmsCreateTransformTHR (context_lcms,
+							profile_in,
+							format_in,
+							profile_out,
+							format_out,
+							lcms_intent,
+							lcms_flags);
 	}
 
-	/* find the bpp value */
-	priv->bpp_input = cd_transform_get_bpp (priv->input_pixel_format);
-	priv->bpp_output = cd_transform_get_bpp (priv->input_pixel_format);
-
 	/* failed? */
-	if (priv->lcms_transform == NULL) {
-		ret = cd_context_lcms_error_check (priv->context_lcms, &error_local);
-		if (!ret) {
+	if (lcms_transform == NULL) {
+		if (!cd_context_lcms_error_check (context_lcms, &error_local)) {
 			g_set_error_literal (error,
 					     CD_TRANSFORM_ERROR,
 					     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
 					     error_local->message);
-			goto out;
+			return NULL;
 		}
-		ret = FALSE;
 		g_set_error_literal (error,
 				     CD_TRANSFORM_ERROR,
 				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
 				     "failed to setup transform, unspecified error");
-		goto out;
-	}
-out:
-	return ret;
-}
-
-typedef struct {
-	guint8	*p_in;
-	guint8	*p_out;
-	guint	 width;
-	guint	 rowstride;
-	guint	 rows_to_process;
-} CdTransformJob;
-
-static void
-cd_transform_process_func (gpointer data, gpointer user_data)
-{
-	CdTransformJob *job = (CdTransformJob *) data;
-	CdTransform *transform = CD_TRANSFORM (user_data);
-	CdTransformPrivate *priv = GET_PRIVATE (transform);
-	guint i;
-
-	for (i = 0; i < job->rows_to_process; i++) {
-		cmsDoTransformStride (priv->lcms_transform,
-				      job->p_in,
-				      job->p_out,
-				      job->width,
-				      job->rowstride);
-		job->p_in += job->rowstride;
-		job->p_out += job->rowstride;
+		return NULL;
 	}
-	g_slice_free (CdTransformJob, job);
+	return lcms_transform;
 }
 
+/* a transform to a NULL profile that outputs 0xff for out-of-gamut pixels */
 static gboolean
-cd_transform_set_max_threads_default (CdTransform *transform, GError **error)
+cd_transform_setup_gamut_count (CdTransform *transform, GError **error)
 {
 	CdTransformPrivate *priv = GET_PRIVATE (transform);
-	gchar *tmp;
-	g_autofree gchar *data = NULL;
+	cmsBool bpcs[3];
+	cmsFloat64Number adaptation[3];
+	cmsHPROFILE profile_null;
+	cmsHPROFILE profiles[3];
+	cmsUInt16Number alarm_codes[cmsMAXCHANNELS] = { 0xffff };
+	cmsUInt32Number intents[3];
+	cmsUInt32Number n = 0;
+	g_autoptr(GError) error_local = NULL;
 
-	/* use "cpu cores" to work out best number of threads */
-	if (!g_file_get_contents ("/proc/cpuinfo", &data, NULL, error))
-		return FALSE;
-	tmp = g_strstr_len (data, -1, "cpu cores\t: ");
-	if (tmp == NULL) {
-		/* some processors do not provide this info */
-		priv->max_threads = 1;
-		return TRUE;
+	/* this uses its own context as the alarm codes are per-context */
+	if (priv->context_gamut == NULL)
+		priv->context_gamut = cd_context_lcms_new ();
+	cmsSetAlarmCodesTHR (priv->context_gamut, alarm_codes);
+	profile_null = cmsCreateNULLProfileTHR (priv->context_gamut);
+	if (priv->input_icc != NULL) {
+		profiles[n++] = cd_icc_get_handle (priv->input_icc);
+	} else {
+		profiles[n++] = cd_transform_get_default_profile (transform,
+								  priv->input_pixel_format);
 	}
-	priv->max_threads = g_ascii_strtoull (tmp + 12, NULL, 10);
-	if (priv->max_threads == 0) {
-		priv->max_threads = 1;
+	if (priv->abstract_icc != NULL)
+		profiles[n++] = cd_icc_get_handle (priv->abstract_icc);
+	profiles[n++] = profile_null;
+	for (guint i = 0; i < n; i++) {
+		intents[i] = cd_transform_get_lcms_intent (transform);
+		bpcs[i] = priv->bpc;
+		adaptation[i] = 1.f;
+	}
+	priv->gamut_transform = cmsCreateExtendedTransform (priv->context_gamut,
+							    n,
+							    profiles,
+							    bpcs,
+							    intents,
+							    adaptation,
+							    cd_icc_get_handle (priv->proof_icc),
+							    n - 1,
+							    priv->input_pixel_format,
+							    TYPE_GRAY_8,
+							    cmsFLAGS_GAMUTCHECK);
+	cmsCloseProfile (profile_null);
+	if (priv->gamut_transform == NULL) {
+		if (!cd_context_lcms_error_check (priv->context_gamut, &error_local)) {
+			g_set_error_literal (error,
+					     CD_TRANSFORM_ERROR,
+					     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+					     error_local->message);
+			return FALSE;
+		}
 		g_set_error_literal (error,
 				     CD_TRANSFORM_ERROR,
-				     CD_TRANSFORM_ERROR_LAST,
-				     "Failed to parse number of cores");
+				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+				     "failed to setup gamut check transform");
 		return FALSE;
 	}
 	return TRUE;
 }
 
-/**
- * cd_transform_process:
- * @transform: a #CdTransform instance.
+static gchar *
+cd_transform_get_cache_key (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdIcc *iccs[] = { priv->input_icc,
+			  priv->abstract_icc,
+			  priv->proof_icc,
+			  priv->output_icc };
+	GString *key = g_string_new (NULL);
+	guint i;
+
+	/* profiles without a checksum cannot be shared */
+	for (i = 0; i < G_N_ELEMENTS (iccs); i++) {
+		const gchar *checksum;
+		if (iccs[i] == NULL) {
+			g_string_append (key, "none:");
+			continue;
+		}
+		checksum = cd_icc_get_checksum (iccs[i]);
+		if (checksum == NULL) {
+			g_string_free (key, TRUE);
+			return NULL;
+		}
+		g_string_append_printf (key, "%s:", checksum);
+	}
+	g_string_append_printf (key, "%08x:%08x:%u:%i",
+				priv->input_pixel_format,
+				priv->output_pixel_format,
+				priv->rendering_intent,
+				priv->bpc);
+	if (priv->proof_icc != NULL && priv->gamut_check) {
+		g_string_append_printf (key, ":%04x%04x%04x",
+					(guint) (priv->gamut_alarm.R * 0xffff),
+					(guint) (priv->gamut_alarm.G * 0xffff),
+					(guint) (priv->gamut_alarm.B * 0xffff));
+	}
+	return g_string_free (key, FALSE);
+}
+
+static gboolean
+cd_transform_get_rgb_offsets (CdPixelFormat format, guint *offsets)
+{
+	switch (format) {
+	case CD_PIXEL_FORMAT_RGB24:
+	case CD_PIXEL_FORMAT_RGBA32:
+		offsets[0] = 0;
+		offsets[1] = 1;
+		offsets[2] = 2;
+		return TRUE;
+	case CD_PIXEL_FORMAT_BGRA32:
+		offsets[0] = 2;
+		offsets[1] = 1;
+		offsets[2] = 0;
+		return TRUE;
+	case CD_PIXEL_FORMAT_ARGB32:
+		offsets[0] = 1;
+		offsets[1] = 2;
+		offsets[2] = 3;
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+cd_transform_setup_lut (CdTransform *transform, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdTransformLut *lut;
+	cmsHTRANSFORM lcms_transform;
+	guint i, r, g, b;
+	guint n = priv->lut_size;
+	guint16 *p;
+	g_autofree guint16 *grid = NULL;
+
+	/* only 8 bit RGB is supported */
+	lut = g_new0 (CdTransformLut, 1);
+	if (!cd_transform_get_rgb_offsets (priv->input_pixel_format, lut->in_offset) ||
+	    !cd_transform_get_rgb_offsets (priv->output_pixel_format, lut->out_offset)) {
+		g_debug ("no LUT for pixel formats 0x%08x->0x%08x",
+			 priv->input_pixel_format,
+			 priv->output_pixel_format);
+		g_free (lut);
+		return TRUE;
+	}
+
+	/* sample the transform at 16 bit precision */
+	lcms_transform = cd_transform_create_lcms (transform,
+						   priv->context_lcms,
+						   TYPE_RGB_16,
+						   TYPE_RGB_16,
+						   error);
+	if (lcms_transform == NULL) {
+		g_free (lut);
+		return FALSE;
+	}
+	grid = g_new (guint16, n * n * n * 3);
+	p = grid;
+	for (r = 0; r < n; r++) {
+		for (g = 0; g < n; g++) {
+			for (b = 0; b < n; b++) {
+				*p++ = (r * 0xffff) / (n - 1);
+				*p++ = (g * 0xffff) / (n - 1);
+				*p++ = (b * 0xffff) / (n - 1);
+			}
+		}
+	}
+	lut->size = n;
+	lut->table = g_new (guint16, n * n * n * 3);
+	cmsDoTransform (lcms_transform, grid, lut->table, n * n * n);
+	cmsDeleteTransform (lcms_transform);
+
+	/* precompute the grid cell and position inside it for each value */
+	for (i = 0; i < 256; i++) {
+		guint x = i * (n - 1);
+		lut->index[i] = x / 255;
+		lut->frac[i] = ((x % 255) * 0x10000 + 127) / 255;
+		if (lut->index[i] == n - 1) {
+			lut->index[i] = n - 2;
+			lut->frac[i] = 0x10000;
+		}
+	}
+	priv->lut = lut;
+	return TRUE;
+}
+
+static void
+cd_transform_process_line_lut (CdTransform *transform,
+			       const guint8 *p_in,
+			       guint8 *p_out,
+			       guint width)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	const CdTransformLut *lut = priv->lut;
+	const guint db = 3;
+	const guint dg = lut->size * db;
+	const guint dr = lut->size * dg;
+	guint i, j;
+
+	for (i = 0; i < width; i++) {
+		const guint16 *c0;
+		guint8 r = p_in[lut->in_offset[0]];
+		guint8 g = p_in[lut->in_offset[1]];
+		guint8 b = p_in[lut->in_offset[2]];
+		guint fr = lut->frac[r];
+		guint fg = lut->frac[g];
+		guint fb = lut->frac[b];
+		guint o1, o2, o3;
+		guint w0, w1, w2, w3;
+
+		/* find which of the six tetrahedra in the cube to use */
+		c0 = lut->table + lut->index[r] * dr + lut->index[g] * dg + lut->index[b] * db;
+		if (fr >= fg) {
+			if (fg >= fb) {
+				o1 = dr; o2 = dr + dg;
+				w0 = 0x10000 - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+			} else if (fr >= fb) {
+				o1 = dr; o2 = dr + db;
+				w0 = 0x10000 - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+			} else {
+				o1 = db; o2 = dr + db;
+				w0 = 0x10000 - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+			}
+		} else {
+			if (fb >= fg) {
+				o1 = db; o2 = dg + db;
+				w0 = 0x10000 - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+			} else if (fb >= fr) {
+				o1 = dg; o2 = dg + db;
+				w0 = 0x10000 - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+			} else {
+				o1 = dg; o2 = dr + dg;
+				w0 = 0x10000 - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+			}
+		}
+		o3 = dr + dg + db;
+
+		/* the weights add up to 0x10000 so this cannot overflow */
+		for (j = 0; j < 3; j++) {
+			guint32 v = c0[j] * w0 + c0[o1 + j] * w1 + c0[o2 + j] * w2 + c0[o3 + j] * w3;
+			v = (v + 0x8000) >> 16;
+			p_out[lut->out_offset[j]] = (v * 0xff + 0x7fff) / 0xffff;
+		}
+		p_in += priv->bpp_input;
+		p_out += priv->bpp_output;
+	}
+}
+
+static gboolean
+cd_transform_shaper_get_matrix (cmsHPROFILE profile, CdMat3x3 *mat)
+{
+	const cmsCIEXYZ *xyz[3];
+
+	xyz[0] = cmsReadTag (profile, cmsSigRedColorantTag);
+	xyz[1] = cmsReadTag (profile, cmsSigGreenColorantTag);
+	xyz[2] = cmsReadTag (profile, cmsSigBlueColorantTag);
+	if (xyz[0] == NULL || xyz[1] == NULL || xyz[2] == NULL)
+		return FALSE;
+
+	/* the colorants are the columns of the RGB to XYZ matrix */
+	cd_mat33_init (mat,
+		       xyz[0]->X, xyz[1]->X, xyz[2]->X,
+		       xyz[0]->Y, xyz[1]->Y, xyz[2]->Y,
+		       xyz[0]->Z, xyz[1]->Z, xyz[2]->Z);
+	return TRUE;
+}
+
+static gboolean
+cd_transform_shaper_is_supported (cmsHPROFILE profile, gint intent, gint direction)
+{
+	if (cmsGetColorSpace (profile) != cmsSigRgbData)
+		return FALSE;
+	if (cmsGetDeviceClass (profile) == cmsSigLinkClass)
+		return FALSE;
+	if (!cmsIsMatrixShaper (profile))
+		return FALSE;
+
+	/* lcms prefers the LUT-based tags if they exist */
+	if (cmsIsCLUT (profile, intent, direction))
+		return FALSE;
+	return TRUE;
+}
+
+static void
+cd_transform_process_line_shaper (CdTransform *transform,
+				  const guint8 *p_in,
+				  guint8 *p_out,
+				  guint width)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	const CdTransformShaper *shaper = priv->shaper;
+	const gfloat *m = shaper->matrix;
+	guint i, j;
+
+	for (i = 0; i < width; i++) {
+		gfloat r = shaper->decode[0][p_in[shaper->in_offset[0]]];
+		gfloat g = shaper->decode[1][p_in[shaper->in_offset[1]]];
+		gfloat b = shaper->decode[2][p_in[shaper->in_offset[2]]];
+		for (j = 0; j < 3; j++) {
+			gfloat v = m[j * 3 + 0] * r + m[j * 3 + 1] * g + m[j * 3 + 2] * b;
+			v = CLAMP (v, 0.f, 1.f);
+			p_out[shaper->out_offset[j]] =
+				shaper->encode[j][(guint) (sqrtf (v) * CD_TRANSFORM_SHAPER_ENCODE_SIZE + 0.5f)];
+		}
+		p_in += priv->bpp_input;
+		p_out += priv->bpp_output;
+	}
+}
+
+/* the ICC tags can only describe what lcms does for the simple cases,
+ * so compare against the compiled transform on a coarse grid */
+static gboolean
+cd_transform_shaper_verify (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdTransformShaper *shaper = priv->shaper;
+	const guint n = 9;
+	guint i, j, r, g, b;
+	guint8 *p;
+	g_autofree guint8 *data_in = NULL;
+	g_autofree guint8 *data_ref = NULL;
+	g_autofree guint8 *data_out = NULL;
+
+	data_in = g_new0 (guint8, n * n * n * priv->bpp_input);
+	data_ref = g_new0 (guint8, n * n * n * priv->bpp_output);
+	data_out = g_new0 (guint8, n * n * n * priv->bpp_output);
+	p = data_in;
+	for (r = 0; r < n; r++) {
+		for (g = 0; g < n; g++) {
+			for (b = 0; b < n; b++) {
+				p[shaper->in_offset[0]] = (r * 0xff) / (n - 1);
+				p[shaper->in_offset[1]] = (g * 0xff) / (n - 1);
+				p[shaper->in_offset[2]] = (b * 0xff) / (n - 1);
+				p += priv->bpp_input;
+			}
+		}
+	}
+	cmsDoTransform (priv->lcms_transform, data_in, data_ref, n * n * n);
+	cd_transform_process_line_shaper (transform, data_in, data_out, n * n * n);
+	for (i = 0; i < n * n * n; i++) {
+		for (j = 0; j < 3; j++) {
+			guint off = i * priv->bpp_output + shaper->out_offset[j];
+			if (ABS ((gint) data_out[off] - (gint) data_ref[off]) > 1) {
+				g_debug ("matrix/shaper differs from lcms: %u != %u",
+					 data_out[off], data_ref[off]);
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_transform_setup_shaper (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdMat3x3 mat_in;
+	CdMat3x3 mat_out;
+	CdMat3x3 mat_out_inv;
+	CdMat3x3 mat;
+	CdTransformShaper *shaper;
+	cmsHPROFILE profile_in;
+	cmsHPROFILE profile_out;
+	const cmsTagSignature trc[] = { cmsSigRedTRCTag,
+					cmsSigGreenTRCTag,
+					cmsSigBlueTRCTag };
+	const gdouble *data;
+	gint intent = cd_transform_get_lcms_intent (transform);
+	guint i, j;
+
+	/* anything in the middle needs the full pipeline */
+	if (priv->abstract_icc != NULL || priv->proof_icc != NULL)
+		return FALSE;
+
+	/* absolute colorimetric also scales by the media white */
+	if (intent == INTENT_ABSOLUTE_COLORIMETRIC)
+		return FALSE;
+
+	/* only 8 bit RGB is supported */
+	shaper = g_new0 (CdTransformShaper, 1);
+	if (!cd_transform_get_rgb_offsets (priv->input_pixel_format, shaper->in_offset) ||
+	    !cd_transform_get_rgb_offsets (priv->output_pixel_format, shaper->out_offset)) {
+		g_free (shaper);
+		return FALSE;
+	}
+
+	/* both profiles have to be a matrix and three curves */
+	if (priv->input_icc != NULL)
+		profile_in = cd_icc_get_handle (priv->input_icc);
+	else
+		profile_in = cd_transform_get_default_profile (transform, priv->input_pixel_format);
+	if (priv->output_icc != NULL)
+		profile_out = cd_icc_get_handle (priv->output_icc);
+	else
+		profile_out = cd_transform_get_default_profile (transform, priv->output_pixel_format);
+	if (!cd_transform_shaper_is_supported (profile_in, intent, LCMS_USED_AS_INPUT) ||
+	    !cd_transform_shaper_is_supported (profile_out, intent, LCMS_USED_AS_OUTPUT) ||
+	    !cd_transform_shaper_get_matrix (profile_in, &mat_in) ||
+	    !cd_transform_shaper_get_matrix (profile_out, &mat_out) ||
+	    !cd_mat33_reciprocal (&mat_out, &mat_out_inv)) {
+		g_free (shaper);
+		return FALSE;
+	}
+
+	/* fuse RGB->XYZ->RGB into one matrix */
+	cd_mat33_matrix_multiply (&mat_out_inv, &mat_in, &mat);
+	data = cd_mat33_get_data (&mat);
+	for (i = 0; i < 9; i++)
+		shaper->matrix[i] = data[i];
+
+	/* sample the curves, inverting the output ones */
+	for (i = 0; i < 3; i++) {
+		const cmsToneCurve *curve_in = cmsReadTag (profile_in, trc[i]);
+		const cmsToneCurve *curve_out = cmsReadTag (profile_out, trc[i]);
+		cmsToneCurve *curve_rev;
+		if (curve_in == NULL || curve_out == NULL) {
+			g_free (shaper);
+			return FALSE;
+		}
+		curve_rev = cmsReverseToneCurve (curve_out);
+		if (curve_rev == NULL) {
+			g_free (shaper);
+			return FALSE;
+		}
+		for (j = 0; j < 256; j++)
+			shaper->decode[i][j] = cmsEvalToneCurveFloat (curve_in, j / 255.f);
+		for (j = 0; j <= CD_TRANSFORM_SHAPER_ENCODE_SIZE; j++) {
+			gfloat x = (gfloat) j / CD_TRANSFORM_SHAPER_ENCODE_SIZE;
+			gfloat v = cmsEvalToneCurveFloat (curve_rev, x * x);
+			shaper->encode[i][j] = CLAMP (v, 0.f, 1.f) * 0xff + 0.5f;
+		}
+		cmsFreeToneCurve (curve_rev);
+	}
+
+	/* fall back to lcms if anything else would have been done */
+	priv->shaper = shaper;
+	if (!cd_transform_shaper_verify (transform)) {
+		g_free (priv->shaper);
+		priv->shaper = NULL;
+		return FALSE;
+	}
+	g_debug ("using matrix/shaper for 0x%08x->0x%08x",
+		 priv->input_pixel_format,
+		 priv->output_pixel_format);
+	return TRUE;
+}
+
+static gboolean
+cd_transform_get_alpha_offset (CdPixelFormat format, guint *offset)
+{
+	switch (format) {
+	case CD_PIXEL_FORMAT_RGBA32:
+	case CD_PIXEL_FORMAT_BGRA32:
+		*offset = 3;
+		return TRUE;
+	case CD_PIXEL_FORMAT_ARGB32:
+		*offset = 0;
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+cd_transform_is_identity (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	cmsHPROFILE profile;
+	gint intent = cd_transform_get_lcms_intent (transform);
+
+	/* anything in the middle can change the colors */
+	if (priv->abstract_icc != NULL || priv->proof_icc != NULL)
+		return FALSE;
+
+	/* both default to sRGB, or are the same profile */
+	if (priv->input_icc == NULL && priv->output_icc == NULL) {
+		profile = priv->srgb;
+	} else if (priv->input_icc != NULL && priv->output_icc != NULL) {
+		if (priv->input_icc != priv->output_icc) {
+			const gchar *checksum_in = cd_icc_get_checksum (priv->input_icc);
+			const gchar *checksum_out = cd_icc_get_checksum (priv->output_icc);
+			if (checksum_in == NULL || g_strcmp0 (checksum_in, checksum_out) != 0)
+				return FALSE;
+		}
+		profile = cd_icc_get_handle (priv->input_icc);
+	} else {
+		return FALSE;
+	}
+
+	/* a LUT-based profile does not round trip exactly */
+	if (!cd_transform_shaper_is_supported (profile, intent, LCMS_USED_AS_INPUT) ||
+	    !cd_transform_shaper_is_supported (profile, intent, LCMS_USED_AS_OUTPUT))
+		return FALSE;
+	return TRUE;
+}
+
+static gboolean
+cd_transform_setup_swizzle (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdTransformSwizzle *swizzle;
+
+	/* only 8 bit RGB is supported */
+	swizzle = g_new0 (CdTransformSwizzle, 1);
+	if (!cd_transform_get_rgb_offsets (priv->input_pixel_format, swizzle->in_offset) ||
+	    !cd_transform_get_rgb_offsets (priv->output_pixel_format, swizzle->out_offset)) {
+		g_free (swizzle);
+		return FALSE;
+	}
+	if (!cd_transform_is_identity (transform)) {
+		g_free (swizzle);
+		return FALSE;
+	}
+
+	/* alpha is carried over if both formats have it */
+	swizzle->n_channels = 3;
+	if (cd_transform_get_alpha_offset (priv->input_pixel_format, &swizzle->in_offset[3]) &&
+	    cd_transform_get_alpha_offset (priv->output_pixel_format, &swizzle->out_offset[3]))
+		swizzle->n_channels = 4;
+	swizzle->copy = priv->input_pixel_format == priv->output_pixel_format;
+	swizzle->swap_rb = (priv->input_pixel_format == CD_PIXEL_FORMAT_RGBA32 &&
+			    priv->output_pixel_format == CD_PIXEL_FORMAT_BGRA32) ||
+			   (priv->input_pixel_format == CD_PIXEL_FORMAT_BGRA32 &&
+			    priv->output_pixel_format == CD_PIXEL_FORMAT_RGBA32);
+	g_debug ("using %s for 0x%08x->0x%08x",
+		 swizzle->copy ? "copy" : "swizzle",
+		 priv->input_pixel_format,
+		 priv->output_pixel_format);
+	priv->swizzle = swizzle;
+	return TRUE;
+}
+
+static void
+cd_transform_process_line_swizzle (CdTransform *transform,
+				   const guint8 *p_in,
+				   guint8 *p_out,
+				   guint width)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	const CdTransformSwizzle *swizzle = priv->swizzle;
+	guint i, j;
+
+	/* the conversion can be in-place */
+	if (swizzle->copy) {
+		if (p_in != p_out)
+			memmove (p_out, p_in, (gsize) width * priv->bpp_input);
+		return;
+	}
+
+	/* swap bytes 0 and 2 of each pixel a whole word at a time */
+	if (swizzle->swap_rb) {
+		for (i = 0; i < width; i++) {
+			guint32 v;
+			memcpy (&v, p_in, sizeof (v));
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+			v = (v & 0xff00ff00) | ((v >> 16) & 0x000000ff) | ((v & 0x000000ff) << 16);
+#else
+			v = (v & 0x00ff00ff) | ((v >> 16) & 0x0000ff00) | ((v & 0x0000ff00) << 16);
+#endif
+			memcpy (p_out, &v, sizeof (v));
+			p_in += 4;
+			p_out += 4;
+		}
+		return;
+	}
+	for (i = 0; i < width; i++) {
+		guint8 tmp[4];
+		for (j = 0; j < swizzle->n_channels; j++)
+			tmp[j] = p_in[swizzle->in_offset[j]];
+		for (j = 0; j < swizzle->n_channels; j++)
+			p_out[swizzle->out_offset[j]] = tmp[j];
+		p_in += priv->bpp_input;
+		p_out += priv->bpp_output;
+	}
+}
+
+static cmsHTRANSFORM
+cd_transform_load_devicelink (CdTransform *transform,
+			      cmsContext context_lcms,
+			      const gchar *filename)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	cmsHPROFILE devicelink;
+	cmsHTRANSFORM lcms_transform;
+
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+		return NULL;
+	devicelink = cmsOpenProfileFromFileTHR (context_lcms, filename, "r");
+	if (devicelink == NULL) {
+		g_debug ("failed to load cached device link %s", filename);
+		cd_context_lcms_error_clear (context_lcms);
+		return NULL;
+	}
+
+	/* black point compensation is already part of the device link pipeline */
+	lcms_transform = cmsCreateTransformTHR (context_lcms,
+						devicelink,
+						priv->input_pixel_format,
+						NULL,
+						priv->output_pixel_format,
+						cd_transform_get_lcms_intent (transform),
+						0);
+	cmsCloseProfile (devicelink);
+	if (lcms_transform == NULL) {
+		g_debug ("failed to use cached device link %s", filename);
+		cd_context_lcms_error_clear (context_lcms);
+		return NULL;
+	}
+	g_debug ("using cached device link %s", filename);
+	return lcms_transform;
+}
+
+static void
+cd_transform_save_devicelink (CdTransform *transform,
+			      cmsHTRANSFORM lcms_transform,
+			      const gchar *filename)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	cmsHPROFILE devicelink;
+	cmsUInt32Number len = 0;
+	g_autofree gchar *data = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	devicelink = cmsTransform2DeviceLink (lcms_transform, 4.3, 0);
+	if (devicelink == NULL) {
+		g_debug ("failed to create device link for %s", filename);
+		return;
+	}
+	if (!cmsSaveProfileToMem (devicelink, NULL, &len) || len == 0) {
+		cmsCloseProfile (devicelink);
+		return;
+	}
+	data = g_malloc (len);
+	if (!cmsSaveProfileToMem (devicelink, data, &len)) {
+		cmsCloseProfile (devicelink);
+		return;
+	}
+	cmsCloseProfile (devicelink);
+
+	/* this is atomic, so other processes never see a partial file */
+	if (g_mkdir_with_parents (priv->cache_directory, 0700) != 0) {
+		g_debug ("failed to create %s", priv->cache_directory);
+		return;
+	}
+	if (!g_file_set_contents (filename, data, len, &error_local)) {
+		g_debug ("failed to save device link: %s", error_local->message);
+		return;
+	}
+	g_debug ("saved device link %s", filename);
+}
+
+/* creates the transform, using a device link from the disk cache if possible */
+static cmsHTRANSFORM
+cd_transform_create_lcms_cached (CdTransform *transform,
+				 cmsContext context_lcms,
+				 const gchar *key,
+				 GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	cmsHTRANSFORM lcms_transform;
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *filename = NULL;
+
+	/* the gamut check is not part of a device link */
+	if (priv->cache_directory == NULL || priv->proof_icc != NULL) {
+		return cd_transform_create_lcms (transform,
+						 context_lcms,
+						 priv->input_pixel_format,
+						 priv->output_pixel_format,
+						 error);
+	}
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	basename = g_strdup_printf ("%s.icc", checksum);
+	filename = g_build_filename (priv->cache_directory, basename, NULL);
+	lcms_transform = cd_transform_load_devicelink (transform, context_lcms, filename);
+	if (lcms_transform != NULL)
+		return lcms_transform;
+
+	/* build it the slow way, and save it for next time */
+	lcms_transform = cd_transform_create_lcms (transform,
+						   context_lcms,
+						   priv->input_pixel_format,
+						   priv->output_pixel_format,
+						   error);
+	if (lcms_transform == NULL)
+		return NULL;
+	cd_transform_save_devicelink (transform, lcms_transform, filename);
+	return lcms_transform;
+}
+
+static gboolean
+cd_transform_setup_lcms (CdTransform *transform, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdTransformCacheItem *item;
+	GList *l;
+	g_autofree gchar *key = NULL;
+
+	/* find the bpp value */
+	priv->bpp_input = cd_transform_get_bpp (priv->input_pixel_format);
+	priv->bpp_output = cd_transform_get_bpp (priv->output_pixel_format);
+	if (priv->bpp_input == 0 || priv->bpp_output == 0) {
+		g_set_error (error,
+			     CD_TRANSFORM_ERROR,
+			     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+			     "pixel format 0x%08x->0x%08x not supported",
+			     priv->input_pixel_format,
+			     priv->output_pixel_format);
+		return FALSE;
+	}
+
+	/* not possible to share this with other instances */
+	key = cd_transform_get_cache_key (transform);
+	if (key == NULL) {
+		priv->lcms_transform = cd_transform_create_lcms (transform,
+								 priv->context_lcms,
+								 priv->input_pixel_format,
+								 priv->output_pixel_format,
+								 error);
+		return priv->lcms_transform != NULL;
+	}
+
+	/* already compiled by this or another instance */
+	g_mutex_lock (&cd_transform_cache_mutex);
+	for (l = cd_transform_cache.head; l != NULL; l = l->next) {
+		item = (CdTransformCacheItem *) l->data;
+		if (g_strcmp0 (item->key, key) != 0)
+			continue;
+		g_queue_unlink (&cd_transform_cache, l);
+		g_queue_push_head_link (&cd_transform_cache, l);
+		item->refcount++;
+		priv->cache_item = item;
+		priv->lcms_transform = item->lcms_transform;
+		g_mutex_unlock (&cd_transform_cache_mutex);
+		return TRUE;
+	}
+	g_mutex_unlock (&cd_transform_cache_mutex);
+
+	/* the cached transform may outlive this instance so it needs
+	 * to own a lcms context too */
+	item = g_new0 (CdTransformCacheItem, 1);
+	item->context_lcms = cd_context_lcms_new ();
+	item->lcms_transform = cd_transform_create_lcms_cached (transform,
+								item->context_lcms,
+								key,
+								error);
+	if (item->lcms_transform == NULL) {
+		cd_context_lcms_free (item->context_lcms);
+		g_free (item);
+		return FALSE;
+	}
+	item->key = g_steal_pointer (&key);
+	item->refcount = 2;
+
+	/* add to the cache, dropping the least recently used entries */
+	g_mutex_lock (&cd_transform_cache_mutex);
+	g_queue_push_head (&cd_transform_cache, item);
+	while (g_queue_get_length (&cd_transform_cache) > CD_TRANSFORM_CACHE_SIZE_MAX)
+		cd_transform_cache_item_unref (g_queue_pop_tail (&cd_transform_cache));
+	g_mutex_unlock (&cd_transform_cache_mutex);
+	priv->cache_item = item;
+	priv->lcms_transform = item->lcms_transform;
+	return TRUE;
+}
+
+static gboolean
+cd_transform_setup (CdTransform *transform, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	if (!cd_transform_setup_lcms (transform, error))
+		return FALSE;
+	if (priv->proof_icc != NULL && priv->gamut_check) {
+		if (!cd_transform_setup_gamut_count (transform, error))
+			return FALSE;
+	}
+	if (priv->lut_size > 0)
+		return cd_transform_setup_lut (transform, error);
+	if (cd_transform_setup_swizzle (transform))
+		return TRUE;
+	cd_transform_setup_shaper (transform);
+	return TRUE;
+}
+
+/* the image is split into tiles of roughly this many pixels */
+#define CD_TRANSFORM_TILE_PIXELS		(64 * 1024)
+
+typedef struct _CdTransformProgress CdTransformProgress;
+
+typedef struct {
+	CdTransform	*transform;
+	GMutex		 mutex;
+	GCond		 cond;
+	guint		 pending;
+	const guint8	*data_in;
+	guint8		*data_out;
+	guint		 width;
+	guint		 height;
+	gsize		 rowstride_in;
+	gsize		 rowstride_out;
+	gsize		 planestride_in;
+	gsize		 planestride_out;
+	guint		 tile_rows;
+	guint		 n_tiles;
+	gint		 next_tile;
+	gint		 tiles_done;
+	GCancellable	*cancellable;
+	CdTransformProgress *progress;
+	guint64		 gamut_alarm_count;	/* protected by mutex */
+} CdTransformBatch;
+
+/* progress is reported from the pool threads, but the callback is only
+ * ever called from one idle source in the context of the caller, so the
+ * values arrive in order and never after the task has completed */
+struct _CdTransformProgress {
+	GMutex			 mutex;
+	GCond			 cond;
+	GFileProgressCallback	 cb;
+	gpointer		 data;
+	GMainContext		*context;
+	GSource			*source;	/* pending, or %NULL */
+	goffset			 current;
+	goffset			 total;
+	gboolean		 delivering;
+	gboolean		 finished;
+};
+
+static CdTransformProgress *
+cd_transform_progress_new (GFileProgressCallback cb,
+			   gpointer data,
+			   GMainContext *context)
+{
+	CdTransformProgress *progress = g_new0 (CdTransformProgress, 1);
+	g_mutex_init (&progress->mutex);
+	g_cond_init (&progress->cond);
+	progress->cb = cb;
+	progress->data = data;
+	progress->context = g_main_context_ref (context);
+	return progress;
+}
+
+static void
+cd_transform_progress_free (CdTransformProgress *progress)
+{
+	g_mutex_clear (&progress->mutex);
+	g_cond_clear (&progress->cond);
+	g_main_context_unref (progress->context);
+	g_free (progress);
+}
+
+static gboolean
+cd_transform_progress_idle_cb (gpointer user_data)
+{
+	CdTransformProgress *progress = (CdTransformProgress *) user_data;
+	goffset current;
+	goffset total;
+
+	g_mutex_lock (&progress->mutex);
+	g_source_unref (progress->source);
+	progress->source = NULL;
+	progress->delivering = TRUE;
+	current = progress->current;
+	total = progress->total;
+	g_mutex_unlock (&progress->mutex);
+	progress->cb (current, total, progress->data);
+
+	/* let the worker return the task */
+	g_mutex_lock (&progress->mutex);
+	progress->delivering = FALSE;
+	g_cond_broadcast (&progress->cond);
+	g_mutex_unlock (&progress->mutex);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_transform_progress_update (CdTransformProgress *progress,
+			      goffset current,
+			      goffset total)
+{
+	g_mutex_lock (&progress->mutex);
+	if (!progress->finished) {
+		progress->current = MAX (progress->current, current);
+		progress->total = total;
+		if (progress->source == NULL) {
+			progress->source = g_idle_source_new ();
+			g_source_set_priority (progress->source, G_PRIORITY_DEFAULT);
+			g_source_set_callback (progress->source,
+					       cd_transform_progress_idle_cb,
+					       progress, NULL);
+			g_source_attach (progress->source, progress->context);
+		}
+	}
+	g_mutex_unlock (&progress->mutex);
+}
+
+/* called from the worker before the task is returned: this waits for the
+ * last update to be delivered in the context of the caller, which has to
+ * be running for the completion callback to be dispatched anyway */
+static void
+cd_transform_progress_finish (CdTransformProgress *progress)
+{
+	g_mutex_lock (&progress->mutex);
+	progress->finished = TRUE;
+	while (progress->source != NULL || progress->delivering)
+		g_cond_wait (&progress->cond, &progress->mutex);
+	g_mutex_unlock (&progress->mutex);
+}
+
+static void
+cd_transform_batch_tile_done (CdTransformBatch *batch)
+{
+	guint done;
+
+	/* only report when the percentage actually changes */
+	done = (guint) g_atomic_int_add (&batch->tiles_done, 1) + 1;
+	if (batch->progress == NULL)
+		return;
+	if (done != batch->n_tiles &&
+	    (done * 100) / batch->n_tiles == ((done - 1) * 100) / batch->n_tiles)
+		return;
+	cd_transform_progress_update (batch->progress,
+				      (goffset) MIN (done * batch->tile_rows, batch->height) * batch->width,
+				      (goffset) batch->height * batch->width);
+}
+
+static void
+cd_transform_count_gamut_alarm (CdTransformBatch *batch,
+				const guint8 *p_in,
+				guint rows_to_process)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (batch->transform);
+	guint64 cnt = 0;
+	g_autofree guint8 *alarm = g_new (guint8, batch->width);
+
+	for (guint i = 0; i < rows_to_process; i++) {
+		cmsDoTransformLineStride (priv->gamut_transform,
+					  p_in, alarm,
+					  batch->width, 1,
+					  batch->rowstride_in, batch->width,
+					  batch->planestride_in, 0);
+		for (guint j = 0; j < batch->width; j++) {
+			if (alarm[j] > 0)
+				cnt++;
+		}
+		p_in += batch->rowstride_in;
+	}
+	g_mutex_lock (&batch->mutex);
+	batch->gamut_alarm_count += cnt;
+	g_mutex_unlock (&batch->mutex);
+}
+
+static void
+cd_transform_process_rows (CdTransformBatch *batch,
+			   const guint8 *p_in,
+			   guint8 *p_out,
+			   guint rows_to_process)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (batch->transform);
+	guint i;
+
+	/* this has to be done first as the conversion can be in-place */
+	if (priv->gamut_transform != NULL)
+		cd_transform_count_gamut_alarm (batch, p_in, rows_to_process);
+
+	/* swizzle, matrix/shaper and LUT are only ever used for packed formats */
+	if (priv->swizzle != NULL) {
+		for (i = 0; i < rows_to_process; i++) {
+			cd_transform_process_line_swizzle (batch->transform,
+							   p_in,
+							   p_out,
+							   batch->width);
+			p_in += batch->rowstride_in;
+			p_out += batch->rowstride_out;
+		}
+		return;
+	}
+	if (priv->shaper != NULL) {
+		for (i = 0; i < rows_to_process; i++) {
+			cd_transform_process_line_shaper (batch->transform,
+							  p_in,
+							  p_out,
+							  batch->width);
+			p_in += batch->rowstride_in;
+			p_out += batch->rowstride_out;
+		}
+		return;
+	}
+	if (priv->lut != NULL) {
+		for (i = 0; i < rows_to_process; i++) {
+			cd_transform_process_line_lut (batch->transform,
+						       p_in,
+						       p_out,
+						       batch->width);
+			p_in += batch->rowstride_in;
+			p_out += batch->rowstride_out;
+		}
+		return;
+	}
+	cmsDoTransformLineStride (priv->lcms_transform,
+				  p_in,
+				  p_out,
+				  batch->width,
+				  rows_to_process,
+				  batch->rowstride_in,
+				  batch->rowstride_out,
+				  batch->planestride_in,
+				  batch->planestride_out);
+}
+
+static void
+cd_transform_process_tiles (CdTransformBatch *batch)
+{
+	/* keep taking the next unclaimed tile until there are none left, so
+	 * that a thread that is delayed does not hold up the others */
+	for (;;) {
+		guint rows_to_process;
+		guint tile;
+		gsize row;
+		if (g_cancellable_is_cancelled (batch->cancellable))
+			break;
+		tile = (guint) g_atomic_int_add (&batch->next_tile, 1);
+		if (tile >= batch->n_tiles)
+			break;
+		row = (gsize) tile * batch->tile_rows;
+		rows_to_process = MIN (batch->tile_rows, batch->height - row);
+		cd_transform_process_rows (batch,
+					   batch->data_in + row * batch->rowstride_in,
+					   batch->data_out + row * batch->rowstride_out,
+					   rows_to_process);
+		cd_transform_batch_tile_done (batch);
+	}
+}
+
+static void
+cd_transform_process_func (gpointer data, gpointer user_data)
+{
+	CdTransformBatch *batch = (CdTransformBatch *) data;
+
+	cd_transform_process_tiles (batch);
+
+	/* wake up the caller when the last worker is done */
+	g_mutex_lock (&batch->mutex);
+	if (--batch->pending == 0)
+		g_cond_signal (&batch->cond);
+	g_mutex_unlock (&batch->mutex);
+}
+
+static gboolean
+cd_transform_ensure_pool (CdTransform *transform, guint n_workers, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	/* the pool is kept for the lifetime of the transform */
+	if (priv->pool != NULL) {
+		if (g_thread_pool_get_max_threads (priv->pool) == (gint) n_workers)
+			return TRUE;
+		return g_thread_pool_set_max_threads (priv->pool,
+						      n_workers,
+						      error);
+	}
+	priv->pool = g_thread_pool_new (cd_transform_process_func,
+					transform,
+					n_workers,
+					TRUE,
+					error);
+	return priv->pool != NULL;
+}
+
+/* returns the CPU limit of the cgroup we are running in, or 0 for none */
+static guint
+cd_transform_get_cgroup_cpu_limit (void)
+{
+	guint64 period = 0;
+	guint64 quota = 0;
+	g_autofree gchar *data = NULL;
+	g_auto(GStrv) split = NULL;
+
+	/* cgroup v2 uses "$MAX $PERIOD" where $MAX can be "max" */
+	if (g_file_get_contents ("/sys/fs/cgroup/cpu.max", &data, NULL, NULL)) {
+		split = g_strsplit (g_strstrip (data), " ", -1);
+		if (g_strv_length (split) != 2 || g_strcmp0 (split[0], "max") == 0)
+			return 0;
+		quota = g_ascii_strtoull (split[0], NULL, 10);
+		period = g_ascii_strtoull (split[1], NULL, 10);
+	} else if (g_file_get_contents ("/sys/fs/cgroup/cpu/cpu.cfs_quota_us",
+					&data, NULL, NULL)) {
+		gint64 tmp = g_ascii_strtoll (data, NULL, 10);
+		g_autofree gchar *data_period = NULL;
+		if (tmp <= 0)
+			return 0;
+		quota = (guint64) tmp;
+		if (!g_file_get_contents ("/sys/fs/cgroup/cpu/cpu.cfs_period_us",
+					  &data_period, NULL, NULL))
+			return 0;
+		period = g_ascii_strtoull (data_period, NULL, 10);
+	}
+	if (quota == 0 || period == 0)
+		return 0;
+	return MAX ((quota + period - 1) / period, 1);
+}
+
+static gboolean
+cd_transform_set_max_threads_default (CdTransform *transform, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	guint cgroup_limit;
+
+	/* this uses the affinity mask of the process, and so includes
+	 * every online CPU on all sockets that we are allowed to use */
+	priv->max_threads = g_get_num_processors ();
+
+	/* do not oversubscribe a container with a CPU quota */
+	cgroup_limit = cd_transform_get_cgroup_cpu_limit ();
+	if (cgroup_limit > 0 && cgroup_limit < priv->max_threads) {
+		g_debug ("limiting threads from %u to %u by cgroup quota",
+			 priv->max_threads, cgroup_limit);
+		priv->max_threads = cgroup_limit;
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_transform_ensure (CdTransform *transform, GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+
+	/* check stuff that should have been set */
+	if (priv->rendering_intent == CD_RENDERING_INTENT_UNKNOWN) {
+		g_set_error_literal (error,
+				     CD_TRANSFORM_ERROR,
+				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+				     "rendering intent not set");
+		return FALSE;
+	}
+	if (priv->input_pixel_format == CD_PIXEL_FORMAT_UNKNOWN ||
+	    priv->output_pixel_format == CD_PIXEL_FORMAT_UNKNOWN) {
+		g_set_error_literal (error,
+				     CD_TRANSFORM_ERROR,
+				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+				     "pixel format not set");
+		return FALSE;
+	}
+
+	/* get the best number of threads */
+	if (priv->max_threads == 0) {
+		if (!cd_transform_set_max_threads_default (transform, error))
+			return FALSE;
+	}
+
+	/* setup the transform if required */
+	if (priv->lcms_transform == NULL) {
+		if (!cd_transform_setup (transform, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_transform_prepare:
+ *
+ * Sets up the transform ready for cd_transform_process_chunk().
+ **/
+gboolean
+cd_transform_prepare (CdTransform *transform, GError **error)
+{
+	return cd_transform_ensure (transform, error);
+}
+
+/**
+ * cd_transform_get_bpp_input:
+ *
+ * Returns the number of bytes in each input pixel, which is only known
+ * once the transform has been set up.
+ **/
+guint
+cd_transform_get_bpp_input (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	return priv->bpp_input;
+}
+
+/**
+ * cd_transform_get_bpp_output:
+ *
+ * Returns the number of bytes in each output pixel, which is only known
+ * once the transform has been set up.
+ **/
+guint
+cd_transform_get_bpp_output (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	return priv->bpp_output;
+}
+
+/**
+ * cd_transform_get_use_shaper:
+ *
+ * Returns %TRUE if the matrix/shaper kernel is used rather than lcms.
+ **/
+gboolean
+cd_transform_get_use_shaper (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	return priv->shaper != NULL;
+}
+
+/**
+ * cd_transform_get_use_swizzle:
+ *
+ * Returns %TRUE if the conversion only copies or reorders the channels.
+ **/
+gboolean
+cd_transform_get_use_swizzle (CdTransform *transform)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	return priv->swizzle != NULL;
+}
+
+/**
+ * cd_transform_process_chunk:
+ *
+ * Converts some rows in the calling thread without using the worker pool.
+ * The transform must have been set up using cd_transform_prepare().
+ *
+ * Returns: the number of out-of-gamut pixels in the rows, or 0 if the
+ * gamut check is not enabled
+ **/
+guint64
+cd_transform_process_chunk (CdTransform *transform,
+			    const guint8 *data_in,
+			    guint8 *data_out,
+			    guint width,
+			    guint n_rows,
+			    gsize rowstride_in,
+			    gsize rowstride_out)
+{
+	CdTransformBatch batch = { 0 };
+	batch.transform = transform;
+	batch.width = width;
+	batch.height = n_rows;
+	batch.rowstride_in = rowstride_in;
+	batch.rowstride_out = rowstride_out;
+	g_mutex_init (&batch.mutex);
+	cd_transform_process_rows (&batch, data_in, data_out, n_rows);
+	g_mutex_clear (&batch.mutex);
+	return batch.gamut_alarm_count;
+}
+
+/**
+ * cd_transform_set_gamut_alarm_count:
+ *
+ * Sets the value returned by cd_transform_get_gamut_alarm_count() when
+ * the rows were converted using cd_transform_process_chunk().
+ **/
+void
+cd_transform_set_gamut_alarm_count (CdTransform *transform, guint64 gamut_alarm_count)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	priv->gamut_alarm_count = gamut_alarm_count;
+}
+
+/* converts the legacy rowstride in pixels to bytes */
+static gboolean
+cd_transform_get_rowstride_bytes (CdTransform *transform,
+				  guint rowstride,
+				  gsize *rowstride_in,
+				  gsize *rowstride_out,
+				  GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	if (T_PLANAR (priv->input_pixel_format) ||
+	    T_PLANAR (priv->output_pixel_format)) {
+		g_set_error_literal (error,
+				     CD_TRANSFORM_ERROR,
+				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+				     "planar formats need cd_transform_process_full()");
+		return FALSE;
+	}
+	*rowstride_in = (gsize) rowstride * priv->bpp_input;
+	*rowstride_out = (gsize) rowstride * priv->bpp_output;
+	return TRUE;
+}
+
+static gboolean
+cd_transform_process_internal (CdTransform *transform,
+			       gconstpointer data_in,
+			       gpointer data_out,
+			       guint width,
+			       guint height,
+			       gsize rowstride_in,
+			       gsize rowstride_out,
+			       gsize planestride_in,
+			       gsize planestride_out,
+			       GCancellable *cancellable,
+			       CdTransformProgress *progress,
+			       GError **error)
+{
+	CdTransformBatch batch;
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	guint i;
+	guint n_workers;
+
+	if (!cd_transform_ensure (transform, error))
+		return FALSE;
+
+	/* split the image into tiles: there are many more tiles than
+	 * threads so that all the cores stay busy until the very end */
+	g_mutex_init (&batch.mutex);
+	g_cond_init (&batch.cond);
+	batch.transform = transform;
+	batch.pending = 0;
+	batch.data_in = data_in;
+	batch.data_out = data_out;
+	batch.width = width;
+	batch.height = height;
+	batch.rowstride_in = rowstride_in;
+	batch.rowstride_out = rowstride_out;
+	batch.planestride_in = planestride_in;
+	batch.planestride_out = planestride_out;
+	batch.tile_rows = MAX (CD_TRANSFORM_TILE_PIXELS / width, 1);
+	batch.tile_rows = MIN (batch.tile_rows,
+			       MAX (height / (priv->max_threads * 4), 1));
+	batch.n_tiles = (height + batch.tile_rows - 1) / batch.tile_rows;
+	batch.next_tile = 0;
+	batch.tiles_done = 0;
+	batch.cancellable = cancellable;
+	batch.progress = progress;
+	batch.gamut_alarm_count = 0;
+
+	/* non-threaded conversion */
+	if (priv->max_threads == 1 ||
+	    (guint64) width * height <= priv->inline_threshold)
+		n_workers = 0;
+	else
+		n_workers = MIN (priv->max_threads, batch.n_tiles) - 1;
+
+	/* the calling thread does its share of the tiles too, and does all of
+	 * them if no workers could be started */
+	if (n_workers > 0) {
+		g_autoptr(GError) error_local = NULL;
+		if (!cd_transform_ensure_pool (transform, n_workers, &error_local)) {
+			g_debug ("CdTransform: processing inline: %s",
+				 error_local->message);
+			n_workers = 0;
+		}
+	}
+	for (i = 0; i < n_workers; i++) {
+		g_autoptr(GError) error_local = NULL;
+		g_mutex_lock (&batch.mutex);
+		batch.pending++;
+		g_mutex_unlock (&batch.mutex);
+		if (!g_thread_pool_push (priv->pool, &batch, &error_local)) {
+			g_debug ("CdTransform: using %u of %u workers: %s",
+				 i, n_workers, error_local->message);
+			g_mutex_lock (&batch.mutex);
+			batch.pending--;
+			g_mutex_unlock (&batch.mutex);
+			break;
+		}
+	}
+	cd_transform_process_tiles (&batch);
+
+	/* wait for the workers to finish */
+	g_mutex_lock (&batch.mutex);
+	while (batch.pending > 0)
+		g_cond_wait (&batch.cond, &batch.mutex);
+	priv->gamut_alarm_count = batch.gamut_alarm_count;
+	g_mutex_unlock (&batch.mutex);
+	g_mutex_clear (&batch.mutex);
+	g_cond_clear (&batch.cond);
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+	return TRUE;
+}
+
+/**
+ * cd_transform_process:
+ * @transform: a #CdTransform instance.
  * @data_in: the data buffer to convert
  * @data_out: the data buffer to return, which can be the same as @data_in
  * @width: the width of @data_in
  * @height: the height of @data_in
  * @rowstride: the rowstride of @data_in, typically the same as @width
- * @cancellable: A %GError, or %NULL
- * @error: A %GCancellable, or %NULL
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
  *
  * Processes a block of data through the transform.
+ * The data can use any of the packed 8 bit, 16 bit, half-float or float pixel
+ * formats, and the input and output formats do not have to be the same depth.
+ * Use cd_transform_process_full() for planar formats or when the input and
+ * output rowstrides are different.
  * Once the transform has been setup it is cached and only re-created if any
  * of the formats, input, output or abstract profiles are changed.
  *
@@ -654,14 +2446,8 @@ cd_transform_process (CdTransform *transform,
 		      GCancellable *cancellable,
 		      GError **error)
 {
-	CdTransformJob *job;
-	CdTransformPrivate *priv = GET_PRIVATE (transform);
-	gboolean ret = TRUE;
-	GThreadPool *pool = NULL;
-	guint8 *p_in;
-	guint8 *p_out;
-	guint i;
-	guint rows_to_process;
+	gsize rowstride_in = 0;
+	gsize rowstride_out = 0;
 
 	g_return_val_if_fail (CD_IS_TRANSFORM (transform), FALSE);
 	g_return_val_if_fail (data_in != NULL, FALSE);
@@ -669,89 +2455,741 @@ cd_transform_process (CdTransform *transform,
 	g_return_val_if_fail (width != 0, FALSE);
 	g_return_val_if_fail (height != 0, FALSE);
 	g_return_val_if_fail (rowstride != 0, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
 
-	/* check stuff that should have been set */
-	if (priv->rendering_intent == CD_RENDERING_INTENT_UNKNOWN) {
-		ret = FALSE;
+	if (!cd_transform_ensure (transform, error))
+		return FALSE;
+	if (!cd_transform_get_rowstride_bytes (transform,
+					       rowstride,
+					       &rowstride_in,
+					       &rowstride_out,
+					       error))
+		return FALSE;
+	return cd_transform_process_internal (transform,
+					      data_in,
+					      data_out,
+					      width,
+					      height,
+					      rowstride_in,
+					      rowstride_out,
+					      0, 0,
+					      cancellable,
+					      NULL,
+					      error);
+}
+
+/**
+ * cd_transform_process_full:
+ * @transform: a #CdTransform instance.
+ * @data_in: the data buffer to convert
+ * @data_out: the data buffer to return, which can be the same as @data_in
+ * @width: the width of the image in pixels
+ * @height: the height of the image in pixels
+ * @rowstride_in: the number of bytes between the start of each row in @data_in
+ * @rowstride_out: the number of bytes between the start of each row in @data_out
+ * @planestride_in: the number of bytes between each plane in @data_in, or 0
+ * @planestride_out: the number of bytes between each plane in @data_out, or 0
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Processes a block of data through the transform, where the input and
+ * output buffers may have a different layout, for instance when reading
+ * from a padded buffer and writing into a tightly packed one.
+ *
+ * For planar pixel formats such as %CD_PIXEL_FORMAT_RGB24_PLANAR each
+ * channel is stored in its own plane, and each plane starts the plane
+ * stride after the one before it. The plane strides are ignored for
+ * packed pixel formats.
+ *
+ * Return value: %TRUE if the pixels were successfully transformed.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_process_full (CdTransform *transform,
+			   gconstpointer data_in,
+			   gpointer data_out,
+			   guint width,
+			   guint height,
+			   gsize rowstride_in,
+			   gsize rowstride_out,
+			   gsize planestride_in,
+			   gsize planestride_out,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), FALSE);
+	g_return_val_if_fail (data_in != NULL, FALSE);
+	g_return_val_if_fail (data_out != NULL, FALSE);
+	g_return_val_if_fail (width != 0, FALSE);
+	g_return_val_if_fail (height != 0, FALSE);
+	g_return_val_if_fail (rowstride_in != 0, FALSE);
+	g_return_val_if_fail (rowstride_out != 0, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	return cd_transform_process_internal (transform,
+					      data_in,
+					      data_out,
+					      width,
+					      height,
+					      rowstride_in,
+					      rowstride_out,
+					      planestride_in,
+					      planestride_out,
+					      cancellable,
+					      NULL,
+					      error);
+}
+
+typedef struct {
+	gpointer		 data_in;
+	gpointer		 data_out;
+	guint			 width;
+	guint			 height;
+	guint			 rowstride;
+	CdTransformProgress	*progress;	/* nullable */
+} CdTransformProcessHelper;
+
+static void
+cd_transform_process_helper_free (CdTransformProcessHelper *helper)
+{
+	if (helper->progress != NULL)
+		cd_transform_progress_free (helper->progress);
+	g_free (helper);
+}
+
+static void
+cd_transform_process_thread_cb (GTask *task,
+				gpointer source_object,
+				gpointer task_data,
+				GCancellable *cancellable)
+{
+	CdTransform *transform = CD_TRANSFORM (source_object);
+	CdTransformProcessHelper *helper = (CdTransformProcessHelper *) task_data;
+	gsize rowstride_in = 0;
+	gsize rowstride_out = 0;
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+
+	ret = cd_transform_ensure (transform, &error) &&
+	      cd_transform_get_rowstride_bytes (transform,
+						helper->rowstride,
+						&rowstride_in,
+						&rowstride_out,
+						&error) &&
+	      cd_transform_process_internal (transform,
+					     helper->data_in,
+					     helper->data_out,
+					     helper->width,
+					     helper->height,
+					     rowstride_in,
+					     rowstride_out,
+					     0, 0,
+					     cancellable,
+					     helper->progress,
+					     &error);
+
+	/* no progress callback can run after the completion callback */
+	if (helper->progress != NULL)
+		cd_transform_progress_finish (helper->progress);
+	if (!ret) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+}
+
+/* rows are not worth splitting any smaller than this */
+#define CD_TRANSFORM_ARRAY_ROW_SIZE		1024
+
+/**
+ * cd_transform_process_array:
+ * @transform: a #CdTransform instance.
+ * @colors_in: an array of colors to convert
+ * @colors_out: an array of colors to return, which can be the same as @colors_in
+ * @n_colors: the number of colors in @colors_in
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Converts an array of colors through the transform in one call. This is
+ * much faster than converting each color as a 1x1 image as the transform
+ * is only set up once, and large arrays are split between the worker threads.
+ *
+ * The %CD_PIXEL_FORMAT_RGB_DOUBLE, %CD_PIXEL_FORMAT_XYZ_DOUBLE and
+ * %CD_PIXEL_FORMAT_LAB_DOUBLE pixel formats have the same layout as
+ * #CdColorRGB, #CdColorXYZ and #CdColorLab, so arrays of those can be
+ * passed directly. If no input or output profile is set for XYZ or Lab
+ * formats then a built-in XYZ or D50 Lab profile is used.
+ *
+ * Return value: %TRUE if the colors were successfully transformed.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_process_array (CdTransform *transform,
+			    gconstpointer colors_in,
+			    gpointer colors_out,
+			    guint n_colors,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	guint n_rows;
+	guint remainder;
+
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), FALSE);
+	g_return_val_if_fail (colors_in != NULL, FALSE);
+	g_return_val_if_fail (colors_out != NULL, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	if (n_colors == 0)
+		return TRUE;
+	if (!cd_transform_ensure (transform, error))
+		return FALSE;
+	if (T_PLANAR (priv->input_pixel_format) ||
+	    T_PLANAR (priv->output_pixel_format)) {
 		g_set_error_literal (error,
 				     CD_TRANSFORM_ERROR,
 				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
-				     "rendering intent not set");
-		goto out;
+				     "planar formats cannot be used for arrays");
+		return FALSE;
 	}
-	if (priv->input_pixel_format == CD_PIXEL_FORMAT_UNKNOWN ||
-	    priv->output_pixel_format == CD_PIXEL_FORMAT_UNKNOWN) {
-		ret = FALSE;
+
+	/* treat the array as an image with fixed-size rows so that it can
+	 * be split into tiles, and do any partial row at the end */
+	n_rows = n_colors / CD_TRANSFORM_ARRAY_ROW_SIZE;
+	remainder = n_colors % CD_TRANSFORM_ARRAY_ROW_SIZE;
+	if (n_rows > 0) {
+		if (!cd_transform_process_internal (transform,
+						    colors_in,
+						    colors_out,
+						    CD_TRANSFORM_ARRAY_ROW_SIZE,
+						    n_rows,
+						    CD_TRANSFORM_ARRAY_ROW_SIZE * priv->bpp_input,
+						    CD_TRANSFORM_ARRAY_ROW_SIZE * priv->bpp_output,
+						    0, 0,
+						    cancellable,
+						    NULL,
+						    error))
+			return FALSE;
+	}
+	if (remainder > 0) {
+		gsize offset = (gsize) n_rows * CD_TRANSFORM_ARRAY_ROW_SIZE;
+		if (!cd_transform_process_internal (transform,
+						    (const guint8 *) colors_in + offset * priv->bpp_input,
+						    (guint8 *) colors_out + offset * priv->bpp_output,
+						    remainder,
+						    1,
+						    remainder * priv->bpp_input,
+						    remainder * priv->bpp_output,
+						    0, 0,
+						    cancellable,
+						    NULL,
+						    error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_transform_process_async:
+ * @transform: a #CdTransform instance.
+ * @data_in: the data buffer to convert
+ * @data_out: the data buffer to return, which can be the same as @data_in
+ * @width: the width of @data_in
+ * @height: the height of @data_in
+ * @rowstride: the rowstride of @data_in, typically the same as @width
+ * @cancellable: A %GCancellable, or %NULL
+ * @progress_callback: (scope async) (nullable): function to call with progress information, or %NULL
+ * @progress_callback_data: (closure progress_callback): user data to pass to @progress_callback
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Processes a block of data through the transform without blocking the
+ * caller. The buffers must remain valid, and the transform must not be
+ * modified, until the operation has completed.
+ *
+ * The transform is split into tiles, and @cancellable is checked before
+ * each tile is started. The @progress_callback is called in the thread-default
+ * main context of the caller with the number of pixels processed so far.
+ * Updates that arrive faster than the caller's context runs are merged,
+ * and the last update is always delivered before @callback is called.
+ *
+ * Since: 1.4.10
+ **/
+void
+cd_transform_process_async (CdTransform *transform,
+			    gpointer data_in,
+			    gpointer data_out,
+			    guint width,
+			    guint height,
+			    guint rowstride,
+			    GCancellable *cancellable,
+			    GFileProgressCallback progress_callback,
+			    gpointer progress_callback_data,
+			    GAsyncReadyCallback callback,
+			    gpointer user_data)
+{
+	CdTransformProcessHelper *helper;
+	g_autoptr(GTask) task = NULL;
+
+	g_return_if_fail (CD_IS_TRANSFORM (transform));
+	g_return_if_fail (data_in != NULL);
+	g_return_if_fail (data_out != NULL);
+	g_return_if_fail (width != 0);
+	g_return_if_fail (height != 0);
+	g_return_if_fail (rowstride != 0);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	helper = g_new0 (CdTransformProcessHelper, 1);
+	helper->data_in = data_in;
+	helper->data_out = data_out;
+	helper->width = width;
+	helper->height = height;
+	helper->rowstride = rowstride;
+	if (progress_callback != NULL) {
+		g_autoptr(GMainContext) context = g_main_context_ref_thread_default ();
+		helper->progress = cd_transform_progress_new (progress_callback,
+							      progress_callback_data,
+							      context);
+	}
+
+	task = g_task_new (G_OBJECT (transform), cancellable, callback, user_data);
+	g_task_set_task_data (task, helper, (GDestroyNotify) cd_transform_process_helper_free);
+	g_task_run_in_thread (task, cd_transform_process_thread_cb);
+}
+
+/**
+ * cd_transform_process_finish:
+ * @transform: a #CdTransform instance.
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: %TRUE if the pixels were successfully transformed.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_process_finish (CdTransform *transform,
+			     GAsyncResult *res,
+			     GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, transform), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/* the largest 3D LUT we generate, which is 256MiB for RGBA_FLOAT */
+#define CD_TRANSFORM_LUT3D_SIZE_MAX		256
+
+/* the number of neutral samples used to build the shaper curves */
+#define CD_TRANSFORM_SHAPER_SAMPLES		4096
+
+static gboolean
+cd_transform_lut3d_format_supported (CdPixelFormat format)
+{
+	switch (format) {
+	case CD_PIXEL_FORMAT_RGB48:
+	case CD_PIXEL_FORMAT_RGBA64:
+	case CD_PIXEL_FORMAT_RGB_HALF:
+	case CD_PIXEL_FORMAT_RGBA_HALF:
+	case CD_PIXEL_FORMAT_RGB_FLOAT:
+	case CD_PIXEL_FORMAT_RGBA_FLOAT:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* IEEE 754 binary16, rounding to nearest */
+static guint16
+cd_transform_float_to_half (gfloat value)
+{
+	union { gfloat f; guint32 u; } tmp = { value };
+	guint32 sign = (tmp.u >> 16) & 0x8000;
+	guint32 mant = tmp.u & 0x7fffff;
+	gint32 exp = (gint32) ((tmp.u >> 23) & 0xff);
+	guint32 half;
+	guint shift;
+
+	/* infinity or NaN */
+	if (exp == 0xff)
+		return sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+
+	/* overflow */
+	exp = exp - 127 + 15;
+	if (exp >= 0x1f)
+		return sign | 0x7c00;
+
+	/* denormal or zero */
+	if (exp <= 0) {
+		if (exp < -10)
+			return sign;
+		mant |= 0x800000;
+		shift = 14 - exp;
+		half = mant >> shift;
+		if ((mant >> (shift - 1)) & 1)
+			half++;
+		return sign | half;
+	}
+
+	/* a carry out of the mantissa correctly bumps the exponent */
+	half = sign | ((guint32) exp << 10) | (mant >> 13);
+	if (mant & 0x1000)
+		half++;
+	return half;
+}
+
+static void
+cd_transform_lut3d_pack (CdPixelFormat format,
+			 gpointer data,
+			 guint idx,
+			 const gfloat *rgb)
+{
+	guint c;
+
+	switch (format) {
+	case CD_PIXEL_FORMAT_RGB48:
+	case CD_PIXEL_FORMAT_RGBA64:
+	{
+		guint n = format == CD_PIXEL_FORMAT_RGB48 ? 3 : 4;
+		guint16 *tmp = (guint16 *) data + idx * n;
+		for (c = 0; c < 3; c++)
+			tmp[c] = CLAMP (rgb[c], 0.f, 1.f) * 0xffff + 0.5f;
+		if (n == 4)
+			tmp[3] = 0xffff;
+		break;
+	}
+	case CD_PIXEL_FORMAT_RGB_HALF:
+	case CD_PIXEL_FORMAT_RGBA_HALF:
+	{
+		guint n = format == CD_PIXEL_FORMAT_RGB_HALF ? 3 : 4;
+		guint16 *tmp = (guint16 *) data + idx * n;
+		for (c = 0; c < 3; c++)
+			tmp[c] = cd_transform_float_to_half (rgb[c]);
+		if (n == 4)
+			tmp[3] = 0x3c00;
+		break;
+	}
+	case CD_PIXEL_FORMAT_RGB_FLOAT:
+	case CD_PIXEL_FORMAT_RGBA_FLOAT:
+	{
+		guint n = format == CD_PIXEL_FORMAT_RGB_FLOAT ? 3 : 4;
+		gfloat *tmp = (gfloat *) data + idx * n;
+		for (c = 0; c < 3; c++)
+			tmp[c] = rgb[c];
+		if (n == 4)
+			tmp[3] = 1.f;
+		break;
+	}
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/* the transform does not touch the alpha channel when there is none
+ * in the input, so make the LUT entries opaque */
+static void
+cd_transform_lut3d_set_opaque (CdPixelFormat format, gpointer data, guint n_pixels)
+{
+	guint i;
+
+	switch (format) {
+	case CD_PIXEL_FORMAT_RGBA64:
+		for (i = 0; i < n_pixels; i++)
+			((guint16 *) data)[i * 4 + 3] = 0xffff;
+		break;
+	case CD_PIXEL_FORMAT_RGBA_HALF:
+		for (i = 0; i < n_pixels; i++)
+			((guint16 *) data)[i * 4 + 3] = 0x3c00;
+		break;
+	case CD_PIXEL_FORMAT_RGBA_FLOAT:
+		for (i = 0; i < n_pixels; i++)
+			((gfloat *) data)[i * 4 + 3] = 1.f;
+		break;
+	default:
+		break;
+	}
+}
+
+/* a copy of the transform that takes RGB_FLOAT input */
+static CdTransform *
+cd_transform_lut3d_transform_new (CdTransform *transform, CdPixelFormat format)
+{
+	CdTransformPrivate *priv = GET_PRIVATE (transform);
+	CdTransform *tmp = cd_transform_new ();
+
+	cd_transform_set_input_icc (tmp, priv->input_icc);
+	cd_transform_set_output_icc (tmp, priv->output_icc);
+	cd_transform_set_abstract_icc (tmp, priv->abstract_icc);
+	cd_transform_set_proof_icc (tmp, priv->proof_icc);
+	cd_transform_set_rendering_intent (tmp, priv->rendering_intent);
+	cd_transform_set_bpc (tmp, priv->bpc);
+	cd_transform_set_gamut_check (tmp, priv->gamut_check);
+	cd_transform_set_gamut_alarm (tmp, &priv->gamut_alarm);
+	cd_transform_set_max_threads (tmp, priv->max_threads);
+	cd_transform_set_inline_threshold (tmp, priv->inline_threshold);
+	cd_transform_set_cache_directory (tmp, priv->cache_directory);
+	cd_transform_set_input_pixel_format (tmp, CD_PIXEL_FORMAT_RGB_FLOAT);
+	cd_transform_set_output_pixel_format (tmp, format);
+	return tmp;
+}
+
+/* measure the neutral response of each output channel, normalised to
+ * 0.0..1.0 and forced to be monotonic so that it can be inverted */
+static gboolean
+cd_transform_lut3d_measure_shaper (CdTransform *transform,
+				   gfloat *curve,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	const guint n = CD_TRANSFORM_SHAPER_SAMPLES;
+	guint c, i;
+	g_autofree gfloat *ramp = NULL;
+	g_autoptr(CdTransform) tmp = NULL;
+
+	ramp = g_new (gfloat, n * 3);
+	for (i = 0; i < n; i++) {
+		for (c = 0; c < 3; c++)
+			ramp[i * 3 + c] = (gfloat) i / (gfloat) (n - 1);
+	}
+	tmp = cd_transform_lut3d_transform_new (transform, CD_PIXEL_FORMAT_RGB_FLOAT);
+	if (!cd_transform_process_full (tmp, ramp, curve, n, 1,
+					n * 3 * sizeof (gfloat),
+					n * 3 * sizeof (gfloat),
+					0, 0, cancellable, error))
+		return FALSE;
+
+	for (c = 0; c < 3; c++) {
+		gfloat lo = curve[c];
+		gfloat hi = curve[(n - 1) * 3 + c];
+		gfloat last = 0.f;
+
+		/* flat or inverted response, so fall back to a linear shaper */
+		if (hi - lo < 1e-3f) {
+			for (i = 0; i < n; i++)
+				curve[i * 3 + c] = ramp[i * 3 + c];
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			gfloat val = (curve[i * 3 + c] - lo) / (hi - lo);
+			last = MAX (last, CLAMP (val, 0.f, 1.f));
+			curve[i * 3 + c] = last;
+		}
+		curve[(n - 1) * 3 + c] = 1.f;
+	}
+	return TRUE;
+}
+
+static gfloat
+cd_transform_lut3d_shaper_eval (const gfloat *curve, guint c, gfloat x)
+{
+	const guint n = CD_TRANSFORM_SHAPER_SAMPLES;
+	gfloat pos = CLAMP (x, 0.f, 1.f) * (n - 1);
+	guint i = MIN ((guint) pos, n - 2);
+	gfloat frac = pos - i;
+	return curve[i * 3 + c] * (1.f - frac) + curve[(i + 1) * 3 + c] * frac;
+}
+
+static gfloat
+cd_transform_lut3d_shaper_invert (const gfloat *curve, guint c, gfloat y)
+{
+	const guint n = CD_TRANSFORM_SHAPER_SAMPLES;
+	guint lo = 0;
+	guint hi = n - 1;
+	gfloat v0, v1;
+
+	/* find the first sample at or above the value */
+	if (y <= curve[c])
+		return 0.f;
+	while (hi - lo > 1) {
+		guint mid = (lo + hi) / 2;
+		if (curve[mid * 3 + c] < y)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	v0 = curve[lo * 3 + c];
+	v1 = curve[hi * 3 + c];
+	if (v1 <= v0)
+		return (gfloat) hi / (gfloat) (n - 1);
+	return ((gfloat) lo + (y - v0) / (v1 - v0)) / (gfloat) (n - 1);
+}
+
+/**
+ * cd_transform_get_lut3d_full:
+ * @transform: a #CdTransform instance.
+ * @lut_size: the number of lattice points along each axis, e.g. 33
+ * @shaper_size: the number of entries in each shaper curve, or 0 for none
+ * @format: the pixel format of the table entries
+ * @lut: (out): the 3D lookup table
+ * @shaper: (out) (optional): the 1D shaper curves, or %NULL
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Bakes the transform into a 3D lookup table suitable for uploading as a
+ * GPU texture. The table holds @lut_size cubed entries in @format with
+ * red varying fastest, then green, then blue, which is the layout that
+ * glTexImage3D() and similar APIs expect. Alpha is always opaque.
+ *
+ * If @shaper_size is non-zero then three 1D shaper curves are also
+ * generated from the neutral response of the transform, stored as
+ * @shaper_size RGB entries in @format. The input should be passed
+ * through the shaper before being used to index the 3D table, which
+ * spaces the lattice points evenly in the output and so gives a more
+ * accurate result for a given @lut_size.
+ *
+ * The table is generated with the worker threads set using
+ * cd_transform_set_max_threads().
+ *
+ * Only the 16 bit, half float and float RGB and RGBA formats are
+ * supported.
+ *
+ * Return value: %TRUE if the table was generated
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+cd_transform_get_lut3d_full (CdTransform *transform,
+			     guint lut_size,
+			     guint shaper_size,
+			     CdPixelFormat format,
+			     GBytes **lut,
+			     GBytes **shaper,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	guint b, c, g, i, r;
+	guint bpp;
+	guint n_pixels;
+	g_autofree gfloat *coords = NULL;
+	g_autofree gfloat *curve = NULL;
+	g_autofree gfloat *lattice = NULL;
+	g_autofree guint8 *data = NULL;
+	g_autofree guint8 *shaper_data = NULL;
+	g_autoptr(CdTransform) tmp = NULL;
+
+	g_return_val_if_fail (CD_IS_TRANSFORM (transform), FALSE);
+	g_return_val_if_fail (lut != NULL, FALSE);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
+
+	if (!cd_transform_lut3d_format_supported (format)) {
+		g_set_error (error,
+			     CD_TRANSFORM_ERROR,
+			     CD_TRANSFORM_ERROR_INVALID_COLORSPACE,
+			     "pixel format %s not supported for a 3D LUT",
+			     cd_pixel_format_to_string (format));
+		return FALSE;
+	}
+	if (lut_size < 2 || lut_size > CD_TRANSFORM_LUT3D_SIZE_MAX) {
+		g_set_error (error,
+			     CD_TRANSFORM_ERROR,
+			     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
+			     "3D LUT size %u invalid, expected 2 to %u",
+			     lut_size, (guint) CD_TRANSFORM_LUT3D_SIZE_MAX);
+		return FALSE;
+	}
+	if (shaper_size == 1) {
 		g_set_error_literal (error,
 				     CD_TRANSFORM_ERROR,
 				     CD_TRANSFORM_ERROR_FAILED_TO_SETUP_TRANSFORM,
-				     "pixel format not set");
-		goto out;
+				     "shaper needs at least 2 entries");
+		return FALSE;
 	}
 
-	/* get the best number of threads */
-	if (priv->max_threads == 0) {
-		ret = cd_transform_set_max_threads_default (transform, error);
-		if (!ret)
-			goto out;
+	/* get the shaper curves */
+	if (shaper_size > 0) {
+		curve = g_new (gfloat, CD_TRANSFORM_SHAPER_SAMPLES * 3);
+		if (!cd_transform_lut3d_measure_shaper (transform, curve,
+							cancellable, error))
+			return FALSE;
 	}
 
-	/* setup the transform if required */
-	if (priv->lcms_transform == NULL) {
-		ret = cd_transform_setup (transform, error);
-		if (!ret)
-			goto out;
+	/* the input value for each lattice point on each axis */
+	lattice = g_new (gfloat, lut_size * 3);
+	for (i = 0; i < lut_size; i++) {
+		gfloat x = (gfloat) i / (gfloat) (lut_size - 1);
+		for (c = 0; c < 3; c++) {
+			lattice[i * 3 + c] = curve != NULL ?
+				cd_transform_lut3d_shaper_invert (curve, c, x) : x;
+		}
 	}
 
-	/* non-threaded conversion */
-	if (priv->max_threads == 1) {
-		p_in = data_in;
-		p_out = data_out;
-		for (i = 0; i < height; i++) {
-			cmsDoTransformStride (priv->lcms_transform,
-					      p_in,
-					      p_out,
-					      width,
-					      rowstride);
-			p_in += rowstride * priv->bpp_input;
-			p_out += rowstride * priv->bpp_output;
+	/* treat the lattice as an image of lut_size by lut_size^2 so that
+	 * the rows are split between the worker threads */
+	n_pixels = lut_size * lut_size * lut_size;
+	coords = g_new (gfloat, n_pixels * 3);
+	for (b = 0; b < lut_size; b++) {
+		for (g = 0; g < lut_size; g++) {
+			for (r = 0; r < lut_size; r++) {
+				gfloat *tmp_rgb = &coords[((b * lut_size + g) * lut_size + r) * 3];
+				tmp_rgb[0] = lattice[r * 3 + 0];
+				tmp_rgb[1] = lattice[g * 3 + 1];
+				tmp_rgb[2] = lattice[b * 3 + 2];
+			}
 		}
-		goto out;
-	}
-
-	/* create a threadpool for each line of the image */
-	pool = g_thread_pool_new (cd_transform_process_func,
-				  transform,
-				  priv->max_threads,
-				  TRUE,
-				  error);
-	if (pool == NULL)
-		goto out;
-
-	/* do conversion */
-	p_in = data_in;
-	p_out = data_out;
-	rows_to_process = height / priv->max_threads;
-	for (i = 0; i < height; i += rows_to_process) {
-		job = g_slice_new (CdTransformJob);
-		job->p_in = p_in;
-		job->p_out = p_out;
-		job->width = width;
-		job->rowstride = rowstride;
-		if (i + rows_to_process > height)
-			job->rows_to_process = height - i;
-		else
-			job->rows_to_process = rows_to_process;
-		ret = g_thread_pool_push (pool, job, error);
-		if (!ret)
-			goto out;
-		p_in += rowstride * rows_to_process * priv->bpp_input;
-		p_out += rowstride * rows_to_process * priv->bpp_output;
 	}
-out:
-	if (pool != NULL)
-		g_thread_pool_free (pool, FALSE, TRUE);
-	return ret;
+	bpp = cd_transform_get_bpp (format);
+	data = g_malloc0 ((gsize) n_pixels * bpp);
+	tmp = cd_transform_lut3d_transform_new (transform, format);
+	if (!cd_transform_process_full (tmp, coords, data,
+					lut_size, lut_size * lut_size,
+					lut_size * 3 * sizeof (gfloat),
+					lut_size * bpp,
+					0, 0, cancellable, error))
+		return FALSE;
+	cd_transform_lut3d_set_opaque (format, data, n_pixels);
+
+	/* sample the shaper curves */
+	if (shaper_size > 0) {
+		shaper_data = g_malloc0 ((gsize) shaper_size * bpp);
+		for (i = 0; i < shaper_size; i++) {
+			gfloat x = (gfloat) i / (gfloat) (shaper_size - 1);
+			gfloat rgb[3];
+			for (c = 0; c < 3; c++)
+				rgb[c] = cd_transform_lut3d_shaper_eval (curve, c, x);
+			cd_transform_lut3d_pack (format, shaper_data, i, rgb);
+		}
+	}
+
+	/* success */
+	*lut = g_bytes_new_take (g_steal_pointer (&data), (gsize) n_pixels * bpp);
+	if (shaper != NULL) {
+		*shaper = shaper_data != NULL ?
+			g_bytes_new_take (g_steal_pointer (&shaper_data),
+					  (gsize) shaper_size * bpp) : NULL;
+	}
+	return TRUE;
+}
+
+/**
+ * cd_transform_get_lut3d:
+ * @transform: a #CdTransform instance.
+ * @lut_size: the number of lattice points along each axis, e.g. 33
+ * @format: the pixel format of the table entries
+ * @cancellable: A %GCancellable, or %NULL
+ * @error: A %GError, or %NULL
+ *
+ * Bakes the transform into a 3D lookup table without any shaper curves.
+ * See cd_transform_get_lut3d_full() for details.
+ *
+ * Return value: (transfer full): the 3D lookup table, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+GBytes *
+cd_transform_get_lut3d (CdTransform *transform,
+			guint lut_size,
+			CdPixelFormat format,
+			GCancellable *cancellable,
+			GError **error)
+{
+	GBytes *lut = NULL;
+	if (!cd_transform_get_lut3d_full (transform, lut_size, 0, format,
+					  &lut, NULL, cancellable, error))
+		return NULL;
+	return lut;
 }
 
 static void
@@ -897,6 +3335,8 @@ cd_transform_init (CdTransform *transform)
 	priv->output_pixel_format = CD_PIXEL_FORMAT_UNKNOWN;
 	priv->srgb = cmsCreate_sRGBProfileTHR (priv->context_lcms);
 	priv->max_threads = 1;
+	priv->inline_threshold = CD_TRANSFORM_INLINE_THRESHOLD_DEFAULT;
+	cd_color_rgb_set (&priv->gamut_alarm, 0.5f, 0.5f, 0.5f);
 }
 
 static void
@@ -905,16 +3345,26 @@ cd_transform_finalize (GObject *object)
 	CdTransform *transform = CD_TRANSFORM (object);
 	CdTransformPrivate *priv = GET_PRIVATE (transform);
 
+	if (priv->pool != NULL)
+		g_thread_pool_free (priv->pool, TRUE, TRUE);
 	cmsCloseProfile (priv->srgb);
+	if (priv->xyz != NULL)
+		cmsCloseProfile (priv->xyz);
+	if (priv->lab != NULL)
+		cmsCloseProfile (priv->lab);
 	if (priv->input_icc != NULL)
 		g_object_unref (priv->input_icc);
 	if (priv->output_icc != NULL)
 		g_object_unref (priv->output_icc);
 	if (priv->abstract_icc != NULL)
 		g_object_unref (priv->abstract_icc);
-	if (priv->lcms_transform != NULL)
-		cmsDeleteTransform (priv->lcms_transform);
+	if (priv->proof_icc != NULL)
+		g_object_unref (priv->proof_icc);
+	cd_transform_invalidate (transform);
 	cd_context_lcms_free (priv->context_lcms);
+	if (priv->context_gamut != NULL)
+		cd_context_lcms_free (priv->context_gamut);
+	g_free (priv->cache_directory);
 
 	G_OBJECT_CLASS (cd_transform_parent_class)->finalize (object);
 }
@@ -99,6 +99,25 @@ gboolean	 cd_transform_get_bpc			(CdTransform	*transform);
 void		 cd_transform_set_max_threads		(CdTransform	*transform,
 							 guint		 max_threads);
 guint		 cd_transform_get_max_threads		(CdTransform	*transform);
+void		 cd_transform_set_inline_threshold	(CdTransform	*transform,
+							 guint		 inline_threshold);
+guint		 cd_transform_get_inline_threshold	(CdTransform	*transform);
+void		 cd_transform_set_lut_size		(CdTransform	*transform,
+							 guint		 lut_size);
+guint		 cd_transform_get_lut_size		(CdTransform	*transform);
+void		 cd_transform_set_cache_directory	(CdTransform	*transform,
+							 const gchar	*cache_directory);
+const gchar	*cd_transform_get_cache_directory	(CdTransform	*transform);
+void		 cd_transform_set_proof_icc		(CdTransform	*transform,
+							 CdIcc		*icc);
+CdIcc		*cd_transform_get_proof_icc		(CdTransform	*transform);
+void		 cd_transform_set_gamut_check		(CdTransform	*transform,
+							 gboolean	 gamut_check);
+gboolean	 cd_transform_get_gamut_check		(CdTransform	*transform);
+void		 cd_transform_set_gamut_alarm		(CdTransform	*transform,
+							 const CdColorRGB *alarm);
+const CdColorRGB *cd_transform_get_gamut_alarm		(CdTransform	*transform);
+guint64		 cd_transform_get_gamut_alarm_count	(CdTransform	*transform);
 gboolean	 cd_transform_process			(CdTransform	*transform,
 							 gpointer	 data_in,
 							 gpointer	 data_out,
@@ -108,6 +127,55 @@ gboolean	 cd_transform_process			(CdTransform	*transform,
 							 GCancellable	*cancellable,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_transform_process_full		(CdTransform	*transform,
+							 gconstpointer	 data_in,
+							 gpointer	 data_out,
+							 guint		 width,
+							 guint		 height,
+							 gsize		 rowstride_in,
+							 gsize		 rowstride_out,
+							 gsize		 planestride_in,
+							 gsize		 planestride_out,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_transform_process_array		(CdTransform	*transform,
+							 gconstpointer	 colors_in,
+							 gpointer	 colors_out,
+							 guint		 n_colors,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_transform_process_async		(CdTransform	*transform,
+							 gpointer	 data_in,
+							 gpointer	 data_out,
+							 guint		 width,
+							 guint		 height,
+							 guint		 rowstride,
+							 GCancellable	*cancellable,
+							 GFileProgressCallback progress_callback,
+							 gpointer	 progress_callback_data,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 cd_transform_process_finish		(CdTransform	*transform,
+							 GAsyncResult	*res,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_transform_get_lut3d_full		(CdTransform	*transform,
+							 guint		 lut_size,
+							 guint		 shaper_size,
+							 CdPixelFormat	 format,
+							 GBytes		**lut,
+							 GBytes		**shaper,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+GBytes		*cd_transform_get_lut3d			(CdTransform	*transform,
+							 guint		 lut_size,
+							 CdPixelFormat	 format,
+							 GCancellable	*cancellable,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -51,6 +51,7 @@
 #include <colord/cd-quirk.h>
 #include <colord/cd-spectrum.h>
 #include <colord/cd-transform.h>
+#include <colord/cd-transform-stream.h>
 
 #undef __COLORD_H_INSIDE__
 
@@ -48,8 +48,11 @@
 #include <colord/cd-icc-utils.h>
 #include <colord/cd-interp-akima.h>
 #include <colord/cd-interp-linear.h>
+#include <colord/cd-interp-monotone.h>
 #include <colord/cd-interp.h>
 #include <colord/cd-it8.h>
+#include <colord/cd-it8-reader.h>
+#include <colord/cd-it8-store.h>
 #include <colord/cd-it8-utils.h>
 #include <colord/cd-math.h>
 #include <colord/cd-profile.h>
@@ -59,6 +62,7 @@
 #include <colord/cd-sensor-sync.h>
 #include <colord/cd-spectrum.h>
 #include <colord/cd-transform.h>
+#include <colord/cd-transform-stream.h>
 #include <colord/cd-version.h>
 
 #undef __COLORD_H_INSIDE__
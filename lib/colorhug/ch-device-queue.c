@@ -43,16 +43,23 @@ static void	ch_device_queue_finalize	(GObject     *object);
  **/
 typedef struct
 {
-	GPtrArray		*data_array;
-	GHashTable		*devices_in_use;
+	GHashTable		*devices;	/* platform-id : ChDeviceQueueDevice */
+	guint			 n_pending;	/* queued but not written */
+	guint			 n_in_flight;	/* written, waiting for the reply */
+	guint			 n_total;	/* for the progress */
+	guint			 n_complete;
 } ChDeviceQueuePrivate;
 
 enum {
 	SIGNAL_DEVICE_FAILED,
 	SIGNAL_PROGRESS_CHANGED,
+	SIGNAL_DEVICE_PROGRESS_CHANGED,
 	SIGNAL_LAST
 };
 
+/* only used with CH_DEVICE_QUEUE_PROCESS_FLAGS_RETRY_ERRORS */
+#define CH_DEVICE_QUEUE_MAX_RETRIES	2
+
 G_DEFINE_TYPE_WITH_PRIVATE (ChDeviceQueue, ch_device_queue, G_TYPE_OBJECT)
 
 typedef gboolean (*ChDeviceQueueParseFunc)	(guint8		*output_buffer,
@@ -60,16 +67,7 @@ typedef gboolean (*ChDeviceQueueParseFunc)	(guint8		*output_buffer,
 						 gpointer	 user_data,
 						 GError		**error);
 
-typedef enum {
-	CH_DEVICE_QUEUE_DATA_STATE_PENDING,
-	CH_DEVICE_QUEUE_DATA_STATE_WAITING_FOR_HW,
-	CH_DEVICE_QUEUE_DATA_STATE_CANCELLED,
-	CH_DEVICE_QUEUE_DATA_STATE_COMPLETE,
-	CH_DEVICE_QUEUE_DATA_STATE_UNKNOWN
-} ChDeviceQueueDataState;
-
 typedef struct {
-	ChDeviceQueueDataState	 state;
 	GUsbDevice		*device;
 	guint8			 cmd;
 	guint8			*buffer_in;
@@ -80,8 +78,17 @@ typedef struct {
 	ChDeviceQueueParseFunc	 parse_func;
 	gpointer		 user_data;
 	GDestroyNotify		 user_data_destroy_func;
+	guint			 retries;
 } ChDeviceQueueData;
 
+/* commands are only ever sent to one device one at a time, in order */
+typedef struct {
+	GQueue			 pending;	/* of ChDeviceQueueData */
+	ChDeviceQueueData	*in_flight;
+	guint			 n_total;	/* for the progress */
+	guint			 n_complete;
+} ChDeviceQueueDevice;
+
 typedef struct {
 	ChDeviceQueue		*device_queue;
 	ChDeviceQueueProcessFlags process_flags;
@@ -92,7 +99,13 @@ typedef struct {
 
 static guint signals[SIGNAL_LAST] = { 0 };
 
-static gboolean ch_device_queue_process_data (GTask *task, ChDeviceQueueData *data);
+static void ch_device_queue_process_data (GTask *task, ChDeviceQueueDevice *item);
+static void ch_device_queue_verify_flash_internal (ChDeviceQueue *device_queue,
+						   GUsbDevice *device,
+						   guint16 address,
+						   GBytes *blob,
+						   gsize offset,
+						   gsize len);
 
 static void
 ch_device_queue_data_free (ChDeviceQueueData *data)
@@ -106,6 +119,16 @@ ch_device_queue_data_free (ChDeviceQueueData *data)
 	g_free (data);
 }
 
+static void
+ch_device_queue_device_free (ChDeviceQueueDevice *item)
+{
+	g_queue_foreach (&item->pending, (GFunc) ch_device_queue_data_free, NULL);
+	g_queue_clear (&item->pending);
+	if (item->in_flight != NULL)
+		ch_device_queue_data_free (item->in_flight);
+	g_free (item);
+}
+
 static void
 ch_device_queue_task_data_free (ChDeviceQueueTaskData *data)
 {
@@ -115,21 +138,40 @@ ch_device_queue_task_data_free (ChDeviceQueueTaskData *data)
 }
 
 static void
-ch_device_queue_device_force_complete (ChDeviceQueue *device_queue, GUsbDevice *device)
+ch_device_queue_device_force_complete (ChDeviceQueue *device_queue,
+				       ChDeviceQueueDevice *item)
 {
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
 	ChDeviceQueueData *data;
-	const gchar *device_id;
-	const gchar *device_id_tmp;
-	guint i;
 
-	/* go through the list of commands and cancel them all */
-	device_id = g_usb_device_get_platform_id (device);
-	for (i = 0; i < priv->data_array->len; i++) {
-		data = g_ptr_array_index (priv->data_array, i);
-		device_id_tmp = g_usb_device_get_platform_id (data->device);
-		if (g_strcmp0 (device_id_tmp, device_id) == 0)
-			data->state = CH_DEVICE_QUEUE_DATA_STATE_CANCELLED;
+	/* cancel all the commands that were not yet sent */
+	while ((data = g_queue_pop_head (&item->pending)) != NULL) {
+		ch_device_queue_data_free (data);
+		priv->n_pending--;
+		priv->n_complete++;
+		item->n_complete++;
+	}
+}
+
+static void
+ch_device_queue_device_update_progress (ChDeviceQueue *device_queue,
+					GUsbDevice *device,
+					ChDeviceQueueDevice *item)
+{
+	guint percentage;
+
+	if (item->n_total == 0)
+		return;
+	percentage = (item->n_complete * 100) / item->n_total;
+	g_signal_emit (device_queue,
+		       signals[SIGNAL_DEVICE_PROGRESS_CHANGED], 0,
+		       device,
+		       percentage);
+
+	/* the next run starts the progress again */
+	if (item->n_complete == item->n_total) {
+		item->n_total = 0;
+		item->n_complete = 0;
 	}
 }
 
@@ -137,72 +179,43 @@ static void
 ch_device_queue_update_progress (ChDeviceQueue *device_queue)
 {
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
-	guint complete = 0;
-	guint i;
 	guint percentage;
-	ChDeviceQueueData *data;
 
 	/* no devices */
-	if (priv->data_array->len == 0)
+	if (priv->n_total == 0)
 		return;
 
-	/* find out how many commands are complete */
-	for (i = 0; i < priv->data_array->len; i++) {
-		data = g_ptr_array_index (priv->data_array, i);
-		if (data->state == CH_DEVICE_QUEUE_DATA_STATE_COMPLETE ||
-		    data->state == CH_DEVICE_QUEUE_DATA_STATE_CANCELLED)
-			complete++;
-	}
-
 	/* emit a signal with our progress */
-	percentage = (complete * 100) / priv->data_array->len;
+	percentage = (priv->n_complete * 100) / priv->n_total;
 	g_signal_emit (device_queue,
 		       signals[SIGNAL_PROGRESS_CHANGED], 0,
 		       percentage);
 }
 
-static guint
-ch_device_queue_count_in_state (ChDeviceQueue *device_queue,
-				ChDeviceQueueDataState state)
-{
-	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
-	guint i;
-	guint cnt = 0;
-	ChDeviceQueueData *data;
-
-	/* find any data objects in a specific state */
-	for (i = 0; i < priv->data_array->len; i++) {
-		data = g_ptr_array_index (priv->data_array, i);
-		if (data->state == state)
-			cnt++;
-	}
-	return cnt;
-}
-
 static void
 ch_device_queue_process_write_command_cb (GObject *source,
 					  GAsyncResult *res,
 					  gpointer user_data)
 {
 	ChDeviceQueueData *data;
+	ChDeviceQueueDevice *item;
 	GTask *task = G_TASK (user_data);
 	ChDeviceQueueTaskData *tdata = g_task_get_task_data (task);
 	ChDeviceQueue *device_queue = CH_DEVICE_QUEUE (tdata->device_queue);
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
-	const gchar *device_id;
 	const gchar *tmp;
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
-	guint i;
-	guint pending_commands;
 	ChError last_error_code = 0;
 	GUsbDevice *device = G_USB_DEVICE (source);
 	g_autofree gchar *error_msg = NULL;
 
 	/* mark it as not in use */
-	device_id = g_usb_device_get_platform_id (device);
-	data = g_hash_table_lookup (priv->devices_in_use, device_id);
-	g_hash_table_remove (priv->devices_in_use, device_id);
+	item = g_hash_table_lookup (priv->devices,
+				    g_usb_device_get_platform_id (device));
+	data = item->in_flight;
+	item->in_flight = NULL;
+	priv->n_in_flight--;
 
 	/* get data */
 	ret = ch_device_write_command_finish (device, res, &error);
@@ -213,6 +226,25 @@ ch_device_queue_process_write_command_cb (GObject *source,
 					data->user_data,
 					&error);
 	}
+
+	/* send it again, ahead of anything else for this device */
+	if (!ret &&
+	    (tdata->process_flags & CH_DEVICE_QUEUE_PROCESS_FLAGS_RETRY_ERRORS) > 0 &&
+	    data->retries < CH_DEVICE_QUEUE_MAX_RETRIES &&
+	    !g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+		data->retries++;
+		g_debug ("retrying command 0x%02x on %s: %s",
+			 data->cmd,
+			 g_usb_device_get_platform_id (device),
+			 error->message);
+		g_queue_push_head (&item->pending, data);
+		priv->n_pending++;
+		ch_device_queue_process_data (task, item);
+		return;
+	}
+	ch_device_queue_data_free (data);
+	priv->n_complete++;
+	item->n_complete++;
 	if (!ret) {
 		/* tell the client the device has failed */
 		g_debug ("emit device-failed: %s", error->message);
@@ -230,31 +262,23 @@ ch_device_queue_process_write_command_cb (GObject *source,
 
 		/* should we mark complete other commands as complete */
 		if ((tdata->process_flags & CH_DEVICE_QUEUE_PROCESS_FLAGS_CONTINUE_ERRORS) == 0) {
-			ch_device_queue_device_force_complete (device_queue, device);
+			ch_device_queue_device_force_complete (device_queue, item);
+			ch_device_queue_device_update_progress (device_queue, device, item);
 			ch_device_queue_update_progress (device_queue);
 			goto out;
 		}
 	}
 
 	/* update progress */
-	data->state = CH_DEVICE_QUEUE_DATA_STATE_COMPLETE;
+	ch_device_queue_device_update_progress (device_queue, device, item);
 	ch_device_queue_update_progress (device_queue);
 
-	/* is there another pending command for this device */
-	for (i = 0; i < priv->data_array->len; i++) {
-		data = g_ptr_array_index (priv->data_array, i);
-		ret = ch_device_queue_process_data (task, data);
-		if (ret)
-			break;
-	}
+	/* send the next pending command for this device */
+	ch_device_queue_process_data (task, item);
 out:
 	/* any more pending commands? */
-	pending_commands = ch_device_queue_count_in_state (device_queue,
-							   CH_DEVICE_QUEUE_DATA_STATE_PENDING);
-	pending_commands += ch_device_queue_count_in_state (device_queue,
-							    CH_DEVICE_QUEUE_DATA_STATE_WAITING_FOR_HW);
-	g_debug ("Pending commands: %u", pending_commands);
-	if (pending_commands == 0) {
+	g_debug ("Pending commands: %u", priv->n_pending + priv->n_in_flight);
+	if (priv->n_pending + priv->n_in_flight == 0) {
 
 		/* should we return the process with an error, or just
 		 * rely on the signal? */
@@ -279,13 +303,9 @@ out:
 			g_task_return_boolean (task, TRUE);
 		}
 
-		/* remove all commands from the queue, as they are done */
-#if 0
-/* FIXME: some sort of race uncovered in the port to GTask means that we try
- * to remove data objects before they are marked complete; for now disable */
-
-		g_ptr_array_set_size (priv->data_array, 0);
-#endif
+		/* the next run starts the progress again */
+		priv->n_total = 0;
+		priv->n_complete = 0;
 		g_object_unref (task);
 	}
 }
@@ -293,25 +313,26 @@ out:
 /**
  * ch_device_queue_process_data:
  *
- * Returns TRUE if the command was submitted
+ * Writes the next pending command if the device is idle.
  **/
-static gboolean
-ch_device_queue_process_data (GTask *task, ChDeviceQueueData *data)
+static void
+ch_device_queue_process_data (GTask *task, ChDeviceQueueDevice *item)
 {
 	ChDeviceQueue *device_queue = CH_DEVICE_QUEUE (g_task_get_source_object (task));
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
-	ChDeviceQueueData *data_tmp;
-	const gchar *device_id;
+	ChDeviceQueueData *data;
 
-	/* is this command already complete? */
-	if (data->state == CH_DEVICE_QUEUE_DATA_STATE_COMPLETE)
-		return FALSE;
+	/* is this device already busy, or is there nothing to do? */
+	if (item->in_flight != NULL)
+		return;
+	data = g_queue_pop_head (&item->pending);
+	if (data == NULL)
+		return;
 
-	/* is this device already busy? */
-	device_id = g_usb_device_get_platform_id (data->device);
-	data_tmp = g_hash_table_lookup (priv->devices_in_use, device_id);
-	if (data_tmp != NULL)
-		return FALSE;
+	/* mark this as in use, TODO: retries? */
+	item->in_flight = data;
+	priv->n_pending--;
+	priv->n_in_flight++;
 
 	/* write this command and wait for a response */
 	ch_device_write_command_async (data->device,
@@ -323,12 +344,6 @@ ch_device_queue_process_data (GTask *task, ChDeviceQueueData *data)
 				       g_task_get_cancellable (task),
 				       ch_device_queue_process_write_command_cb,
 				       task);
-	/* mark this as in use */
-	g_hash_table_insert (priv->devices_in_use, g_strdup (device_id), data);
-
-	/* remove this from the command queue -- TODO: retries? */
-	data->state = CH_DEVICE_QUEUE_DATA_STATE_WAITING_FOR_HW;
-	return TRUE;
 }
 
 /**
@@ -351,9 +366,9 @@ ch_device_queue_process_async (ChDeviceQueue		*device_queue,
 {
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
 	ChDeviceQueueTaskData *tdata;
-	ChDeviceQueueData *data;
+	ChDeviceQueueDevice *item;
+	GHashTableIter iter;
 	GTask *task = NULL;
-	guint i;
 
 	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
@@ -365,15 +380,16 @@ ch_device_queue_process_async (ChDeviceQueue		*device_queue,
 	tdata->failures = g_ptr_array_new_with_free_func (g_free);
 	g_task_set_task_data (task, tdata, (GDestroyNotify) ch_device_queue_task_data_free);
 
-	/* go through the list of commands and try to submit them all */
+	/* start the first command on each device */
 	ch_device_queue_update_progress (device_queue);
-	for (i = 0; i < priv->data_array->len; i++) {
-		data = g_ptr_array_index (priv->data_array, i);
-		ch_device_queue_process_data (task, data);
-	}
+	g_hash_table_iter_init (&iter, priv->devices);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item))
+		ch_device_queue_process_data (task, item);
 
 	/* is anything pending? */
-	if (g_hash_table_size (priv->devices_in_use) == 0) {
+	if (priv->n_in_flight == 0) {
+		priv->n_total = 0;
+		priv->n_complete = 0;
 		g_task_return_boolean (task, TRUE);
 		g_object_unref (task);
 	}
@@ -466,6 +482,26 @@ ch_device_queue_process (ChDeviceQueue	*device_queue,
 
 /**********************************************************************/
 
+/* commands that replace the whole of a device setting, so only the last
+ * of several queued back-to-back has any effect */
+static gboolean
+ch_device_queue_cmd_is_setting (guint8 cmd)
+{
+	switch (cmd) {
+	case CH_CMD_SET_COLOR_SELECT:
+	case CH_CMD_SET_DAC_VALUE:
+	case CH_CMD_SET_INTEGRAL_TIME:
+	case CH_CMD_SET_MEASURE_MODE:
+	case CH_CMD_SET_MULTIPLIER:
+	case CH_CMD_SET_POST_SCALE:
+	case CH_CMD_SET_PRE_SCALE:
+		return TRUE;
+	default:
+		break;
+	}
+	return FALSE;
+}
+
 static void
 ch_device_queue_add_internal (ChDeviceQueue		*device_queue,
 			      GUsbDevice		*device,
@@ -480,13 +516,31 @@ ch_device_queue_add_internal (ChDeviceQueue		*device_queue,
 			      GDestroyNotify		 user_data_destroy_func)
 {
 	ChDeviceQueueData *data;
+	ChDeviceQueueDevice *item;
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
+	const gchar *device_id;
 
 	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
 	g_return_if_fail (G_USB_IS_DEVICE (device));
 
+	/* just update the previous command if it sets the same thing */
+	device_id = g_usb_device_get_platform_id (device);
+	item = g_hash_table_lookup (priv->devices, device_id);
+	if (item != NULL &&
+	    buffer_in_len > 0 && buffer_out == NULL &&
+	    parse_func == NULL && user_data == NULL &&
+	    ch_device_queue_cmd_is_setting (cmd)) {
+		data = g_queue_peek_tail (&item->pending);
+		if (data != NULL && data->cmd == cmd &&
+		    data->buffer_out == NULL && data->parse_func == NULL &&
+		    data->buffer_in_len == buffer_in_len) {
+			g_debug ("coalescing command 0x%02x", cmd);
+			memcpy (data->buffer_in, buffer_in, buffer_in_len);
+			return;
+		}
+	}
+
 	data = g_new0 (ChDeviceQueueData, 1);
-	data->state = CH_DEVICE_QUEUE_DATA_STATE_PENDING;
 	data->parse_func = parse_func;
 	data->user_data = user_data;
 	data->user_data_destroy_func = user_data_destroy_func;
@@ -498,7 +552,17 @@ ch_device_queue_add_internal (ChDeviceQueue		*device_queue,
 	data->buffer_out = buffer_out;
 	data->buffer_out_len = buffer_out_len;
 	data->buffer_out_destroy_func = buffer_out_destroy_func;
-	g_ptr_array_add (priv->data_array, data);
+
+	/* add to the end of the queue for this device */
+	if (item == NULL) {
+		item = g_new0 (ChDeviceQueueDevice, 1);
+		g_queue_init (&item->pending);
+		g_hash_table_insert (priv->devices, g_strdup (device_id), item);
+	}
+	g_queue_push_tail (&item->pending, data);
+	priv->n_pending++;
+	priv->n_total++;
+	item->n_total++;
 }
 
 /**
@@ -924,9 +988,6 @@ ch_device_queue_buffer_to_get_calibration_cb (guint8 *output_buffer,
 					      GError **error)
 {
 	ChDeviceQueueGetCalibrationHelper *helper = (void *) user_data;
-	ChPackedFloat pf_tmp;
-	gdouble *calibration_tmp;
-	guint i;
 
 	/* check buffer size */
 	if (output_buffer_size != 60) {
@@ -938,11 +999,9 @@ ch_device_queue_buffer_to_get_calibration_cb (guint8 *output_buffer,
 
 	/* convert back into floating point */
 	if (helper->calibration != NULL) {
-		calibration_tmp = cd_mat33_get_data (helper->calibration);
-		for (i = 0; i < 9; i++) {
-			memcpy (&pf_tmp, &output_buffer[i*4], sizeof (pf_tmp));
-			ch_packed_float_to_double (&pf_tmp, &calibration_tmp[i]);
-		}
+		ch_packed_float_to_double_array (output_buffer,
+						 cd_mat33_get_data (helper->calibration),
+						 9);
 	}
 
 	/* get the supported types */
@@ -1031,10 +1090,7 @@ ch_device_queue_set_calibration (ChDeviceQueue *device_queue,
 				 guint8 types,
 				 const gchar *description)
 {
-	ChPackedFloat pf_tmp;
-	gdouble *calibration_tmp;
 	guint8 buffer[9*4 + 2 + 1 + CH_CALIBRATION_DESCRIPTION_LEN];
-	guint i;
 
 	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
 	g_return_if_fail (G_USB_IS_DEVICE (device));
@@ -1046,11 +1102,8 @@ ch_device_queue_set_calibration (ChDeviceQueue *device_queue,
 	memcpy (buffer, &calibration_index, sizeof(guint16));
 
 	/* convert from float to signed value */
-	for (i = 0; i < 9; i++) {
-		calibration_tmp = cd_mat33_get_data (calibration);
-		ch_double_to_packed_float (calibration_tmp[i], &pf_tmp);
-		memcpy (&buffer[i*4 + 2], &pf_tmp, sizeof (pf_tmp));
-	}
+	ch_double_to_packed_float_array (cd_mat33_get_data (calibration),
+					 buffer + 2, 9);
 
 	/* write types */
 	buffer[9*4 + 2] = types;
@@ -1148,6 +1201,16 @@ ch_device_queue_set_calibration_ccmx (ChDeviceQueue *device_queue,
 	return TRUE;
 }
 
+static gboolean
+ch_device_queue_is_erased (const guint8 *data, gsize len)
+{
+	for (gsize i = 0; i < len; i++) {
+		if (data[i] != 0xff)
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * ch_device_queue_write_firmware:
  * @device_queue:		A #ChDeviceQueue
@@ -1157,6 +1220,13 @@ ch_device_queue_set_calibration_ccmx (ChDeviceQueue *device_queue,
  *
  * Writes new firmware to the device.
  *
+ * The flash must be erased before it is written, and an erase of the whole
+ * runcode region is queued before the writes for this reason. Blocks of
+ * @data that only contain 0xff are not written at all, as erased flash
+ * already reads back as 0xff, so the queue should not be processed with
+ * %CH_DEVICE_QUEUE_PROCESS_FLAGS_CONTINUE_ERRORS, which would carry on
+ * writing after the erase has failed.
+ *
  * NOTE: This command is available on hardware version: 1 & 2
  *
  * Since: 0.1.29
@@ -1192,6 +1262,12 @@ ch_device_queue_write_firmware (ChDeviceQueue	*device_queue,
 	do {
 		if (idx + chunk_len > len)
 			chunk_len = len - idx;
+
+		/* the padding is already in the erased state */
+		if (ch_device_queue_is_erased (data + idx, chunk_len)) {
+			idx += chunk_len;
+			continue;
+		}
 		g_debug ("Writing at %04x size %" G_GSIZE_FORMAT,
 			 runcode_addr + idx,
 			 chunk_len);
@@ -1226,6 +1302,7 @@ ch_device_queue_verify_firmware (ChDeviceQueue	*device_queue,
 	gsize chunk_len;
 	guint idx;
 	guint16 runcode_addr;
+	g_autoptr(GBytes) blob = NULL;
 
 	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
 	g_return_if_fail (G_USB_IS_DEVICE (device));
@@ -1235,21 +1312,56 @@ ch_device_queue_verify_firmware (ChDeviceQueue	*device_queue,
 	idx = 0;
 	chunk_len = 60;
 	runcode_addr = ch_device_get_runcode_address (device);
+	blob = g_bytes_new (data, len);
 	do {
 		if (idx + chunk_len > len)
 			chunk_len = len - idx;
 		g_debug ("Verifying at %04x size %" G_GSIZE_FORMAT,
 			 runcode_addr + idx,
 			 chunk_len);
-		ch_device_queue_verify_flash (device_queue,
-					      device,
-					      runcode_addr + idx,
-					      data + idx,
-					      chunk_len);
+		ch_device_queue_verify_flash_internal (device_queue,
+						       device,
+						       runcode_addr + idx,
+						       blob,
+						       idx,
+						       chunk_len);
 		idx += chunk_len;
 	} while (idx < len);
 }
 
+/**
+ * ch_device_queue_update_firmware:
+ * @device_queue:		A #ChDeviceQueue
+ * @device:			A #GUsbDevice
+ * @data: (array length=len):	Firmware binary data
+ * @len:			Size of @data
+ *
+ * Erases, writes and verifies new firmware and then boots into it.
+ *
+ * The commands for each device are sent independently, so when several
+ * devices are being updated at once a failure only stops that device, and
+ * ::device-progress-changed can be used to show the progress of each.
+ * The device has to be in bootloader mode.
+ *
+ * NOTE: This command is available on hardware version: 1 & 2
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_device_queue_update_firmware (ChDeviceQueue	*device_queue,
+				 GUsbDevice	*device,
+				 const guint8	*data,
+				 gsize		 len)
+{
+	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+	g_return_if_fail (data != NULL);
+
+	ch_device_queue_write_firmware (device_queue, device, data, len);
+	ch_device_queue_verify_firmware (device_queue, device, data, len);
+	ch_device_queue_boot_flash (device_queue, device);
+}
+
 /**
  * ch_device_queue_read_firmware:
  * @device_queue:		A #ChDeviceQueue
@@ -2431,6 +2543,7 @@ typedef struct {
 	guint16		 address;
 	guint8		*data;
 	gsize		 len;
+	GBytes		*blob;		/* owns @data when verifying */
 } ChDeviceQueueReadFlashHelper;
 
 static gboolean
@@ -2563,30 +2676,18 @@ static void
 ch_device_queue_verify_flash_helper_destroy (gpointer data)
 {
 	ChDeviceQueueReadFlashHelper *helper = (ChDeviceQueueReadFlashHelper *) data;
-	g_free (helper->data);
+	g_bytes_unref (helper->blob);
 	g_free (helper);
 }
 
-/**
- * ch_device_queue_verify_flash:
- * @device_queue:		A #ChDeviceQueue
- * @device:			A #GUsbDevice
- * @address:			The device EEPROM address
- * @data: (array length=len):	Binary data
- * @len:			The length of @data
- *
- * Verify flash code from the device.
- *
- * NOTE: This command is available on hardware version: 1 & 2
- *
- * Since: 0.1.29
- **/
-void
-ch_device_queue_verify_flash (ChDeviceQueue *device_queue,
-			      GUsbDevice *device,
-			      guint16 address,
-			      const guint8 *data,
-			      gsize len)
+/* all the chunks of one image share the same copy of the data */
+static void
+ch_device_queue_verify_flash_internal (ChDeviceQueue *device_queue,
+				       GUsbDevice *device,
+				       guint16 address,
+				       GBytes *blob,
+				       gsize offset,
+				       gsize len)
 {
 	ChDeviceQueueReadFlashHelper *helper;
 	guint16 addr_le;
@@ -2601,7 +2702,8 @@ ch_device_queue_verify_flash (ChDeviceQueue *device_queue,
 	/* create a helper structure as the checksum needs an extra
 	 * byte for the checksum */
 	helper = g_new0 (ChDeviceQueueReadFlashHelper, 1);
-	helper->data = g_memdup (data, len + 1);
+	helper->blob = g_bytes_ref (blob);
+	helper->data = (guint8 *) g_bytes_get_data (blob, NULL) + offset;
 	helper->len = len;
 	helper->address = address;
 
@@ -2619,6 +2721,32 @@ ch_device_queue_verify_flash (ChDeviceQueue *device_queue,
 				      ch_device_queue_verify_flash_helper_destroy);
 }
 
+/**
+ * ch_device_queue_verify_flash:
+ * @device_queue:		A #ChDeviceQueue
+ * @device:			A #GUsbDevice
+ * @address:			The device EEPROM address
+ * @data: (array length=len):	Binary data
+ * @len:			The length of @data
+ *
+ * Verify flash code from the device.
+ *
+ * NOTE: This command is available on hardware version: 1 & 2
+ *
+ * Since: 0.1.29
+ **/
+void
+ch_device_queue_verify_flash (ChDeviceQueue *device_queue,
+			      GUsbDevice *device,
+			      guint16 address,
+			      const guint8 *data,
+			      gsize len)
+{
+	g_autoptr(GBytes) blob = g_bytes_new (data, len);
+	ch_device_queue_verify_flash_internal (device_queue, device,
+					       address, blob, 0, len);
+}
+
 /**
  * ch_device_queue_erase_flash:
  * @device_queue:			A #ChDeviceQueue
@@ -3054,7 +3182,7 @@ ch_device_queue_write_sram (ChDeviceQueue *device_queue,
 			 idx, chunk_len);
 		ch_device_queue_write_sram_internal (device_queue,
 						     device,
-						     idx,
+						     address + idx,
 						     data + idx,
 						     chunk_len);
 		idx += chunk_len;
@@ -3122,7 +3250,7 @@ ch_device_queue_read_sram (ChDeviceQueue *device_queue,
 			 idx, chunk_len);
 		ch_device_queue_read_sram_internal (device_queue,
 						    device,
-						    idx,
+						    address + idx,
 						    data + idx,
 						    chunk_len);
 		idx += chunk_len;
@@ -3131,6 +3259,79 @@ ch_device_queue_read_sram (ChDeviceQueue *device_queue,
 
 /**********************************************************************/
 
+/**
+ * ch_device_queue_get_stats_string:
+ * @device_queue:	A #ChDeviceQueue
+ * @device:		A #GUsbDevice
+ *
+ * Gets a text dump of the transport statistics for every command that has
+ * been sent to the device, suitable for showing in a command line tool.
+ *
+ * Returns: (transfer full): a string
+ *
+ * Since: 1.4.10
+ **/
+gchar *
+ch_device_queue_get_stats_string (ChDeviceQueue *device_queue,
+				  GUsbDevice *device)
+{
+	GString *str;
+	guint cmd;
+	guint i;
+
+	g_return_val_if_fail (CH_IS_DEVICE_QUEUE (device_queue), NULL);
+	g_return_val_if_fail (G_USB_IS_DEVICE (device), NULL);
+
+	str = g_string_new ("");
+	for (cmd = 0x00; cmd <= 0xff; cmd++) {
+		ChDeviceCommandStats stats;
+		if (!ch_device_get_command_stats (device, cmd, &stats))
+			continue;
+		g_string_append_printf (str,
+					"%-24s requests:%u failures:%u retries:%u timeouts:%u "
+					"out:%" G_GUINT64_FORMAT " in:%" G_GUINT64_FORMAT " "
+					"avg:%.2fms max:%.2fms\n",
+					ch_command_to_string (cmd),
+					stats.n_requests,
+					stats.n_failures,
+					stats.n_retries,
+					stats.n_timeouts,
+					stats.bytes_out,
+					stats.bytes_in,
+					(gdouble) stats.latency_total / stats.n_requests / 1000.f,
+					(gdouble) stats.latency_max / 1000.f);
+		g_string_append (str, "\t");
+		for (i = 0; i < CH_DEVICE_LATENCY_BUCKETS; i++) {
+			if (i == 0)
+				g_string_append (str, "<1ms");
+			else if (i == CH_DEVICE_LATENCY_BUCKETS - 1)
+				g_string_append_printf (str, " >=%ums", 1u << (i - 1));
+			else
+				g_string_append_printf (str, " <%ums", 1u << i);
+			g_string_append_printf (str, ":%u", stats.latency_histogram[i]);
+		}
+		g_string_append (str, "\n");
+	}
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * ch_device_queue_reset_stats:
+ * @device_queue:	A #ChDeviceQueue
+ * @device:		A #GUsbDevice
+ *
+ * Clears the transport statistics for the device.
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_device_queue_reset_stats (ChDeviceQueue *device_queue, GUsbDevice *device)
+{
+	g_return_if_fail (CH_IS_DEVICE_QUEUE (device_queue));
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+	ch_device_reset_command_stats (device);
+}
+
 static void
 ch_device_queue_class_init (ChDeviceQueueClass *klass)
 {
@@ -3167,17 +3368,32 @@ ch_device_queue_class_init (ChDeviceQueueClass *klass)
 			      G_STRUCT_OFFSET (ChDeviceQueueClass, progress_changed),
 			      NULL, NULL, g_cclosure_marshal_generic,
 			      G_TYPE_NONE, 1, G_TYPE_UINT);
+
+	/**
+	 * ChDeviceQueueClass::device-progress-changed:
+	 * @device_queue: the #ChDeviceQueue instance that emitted the signal
+	 * @device: the device
+	 * @percentage: the percentage of commands complete for @device
+	 *
+	 * The ::device-progress-changed signal is emitted when a command
+	 * for a specific device has completed.
+	 *
+	 * Since: 1.4.10
+	 **/
+	signals[SIGNAL_DEVICE_PROGRESS_CHANGED] =
+		g_signal_new ("device-progress-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (ChDeviceQueueClass, device_progress_changed),
+			      NULL, NULL, g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 2, G_TYPE_OBJECT, G_TYPE_UINT);
 }
 
 static void
 ch_device_queue_init (ChDeviceQueue *device_queue)
 {
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
-	priv->data_array = g_ptr_array_new_with_free_func ((GDestroyNotify) ch_device_queue_data_free);
-	priv->devices_in_use = g_hash_table_new_full (g_str_hash,
-								    g_str_equal,
-								    g_free,
-								    NULL);
+	priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					       (GDestroyNotify) ch_device_queue_device_free);
 }
 
 static void
@@ -3186,8 +3402,7 @@ ch_device_queue_finalize (GObject *object)
 	ChDeviceQueue *device_queue = CH_DEVICE_QUEUE (object);
 	ChDeviceQueuePrivate *priv = GET_PRIVATE (device_queue);
 
-	g_ptr_array_unref (priv->data_array);
-	g_hash_table_unref (priv->devices_in_use);
+	g_hash_table_unref (priv->devices);
 
 	G_OBJECT_CLASS (ch_device_queue_parent_class)->finalize (object);
 }
@@ -48,9 +48,11 @@ struct _ChDeviceQueueClass
 						 const gchar	*error_message);
 	void		(* progress_changed)	(ChDeviceQueue	*device_queue,
 						 guint		 percentage);
+	void		(* device_progress_changed) (ChDeviceQueue *device_queue,
+						 GUsbDevice	*device,
+						 guint		 percentage);
 
 	/* padding for future expansion */
-	void (*_ch_reserved1) (void);
 	void (*_ch_reserved2) (void);
 	void (*_ch_reserved3) (void);
 	void (*_ch_reserved4) (void);
@@ -76,12 +78,18 @@ struct _ChDeviceQueueClass
  *	%CH_DEVICE_QUEUE_PROCESS_FLAGS_CONTINUE_ERRORS is not used then
  *	other commands to the same device will not be submitted.
  *
+ * CH_DEVICE_QUEUE_PROCESS_FLAGS_RETRY_ERRORS:
+ * 	Send a failed command to the device again before treating it
+ *	as a failure, for example when flashing a device on a busy hub.
+ *	Since: 1.4.10
+ *
  * Flags for controlling processing options
  **/
 typedef enum {
 	CH_DEVICE_QUEUE_PROCESS_FLAGS_NONE		= 0,
 	CH_DEVICE_QUEUE_PROCESS_FLAGS_CONTINUE_ERRORS	= 1 << 0,
-	CH_DEVICE_QUEUE_PROCESS_FLAGS_NONFATAL_ERRORS	= 1 << 1
+	CH_DEVICE_QUEUE_PROCESS_FLAGS_NONFATAL_ERRORS	= 1 << 1,
+	CH_DEVICE_QUEUE_PROCESS_FLAGS_RETRY_ERRORS	= 1 << 2
 } ChDeviceQueueProcessFlags;
 
 ChDeviceQueue	*ch_device_queue_new		(void);
@@ -314,11 +322,21 @@ void		 ch_device_queue_verify_firmware	(ChDeviceQueue	*device_queue,
 							 GUsbDevice	*device,
 							 const guint8	*data,
 							 gsize		 len);
+void		 ch_device_queue_update_firmware	(ChDeviceQueue	*device_queue,
+							 GUsbDevice	*device,
+							 const guint8	*data,
+							 gsize		 len);
 void		 ch_device_queue_read_firmware		(ChDeviceQueue	*device_queue,
 							 GUsbDevice	*device,
 							 guint8		**data,
 							 gsize		*len);
 
+/* transport statistics */
+gchar		*ch_device_queue_get_stats_string	(ChDeviceQueue	*device_queue,
+							 GUsbDevice	*device);
+void		 ch_device_queue_reset_stats		(ChDeviceQueue	*device_queue,
+							 GUsbDevice	*device);
+
 G_END_DECLS
 
 #endif /* __CH_DEVICE_QUEUE_H */
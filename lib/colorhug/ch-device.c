@@ -163,15 +163,30 @@ ch_print_data_buffer (const gchar *title,
 	g_print ("%c[%dm\n", 0x1B, 0);
 }
 
+/* recycled task data, shared by all the commands sent to one device */
+#define CH_DEVICE_TASK_DATA_POOL_MAX	8
+
+typedef struct {
+	volatile gint		 ref_count;
+	GMutex			 mutex;
+	gpointer		 free[CH_DEVICE_TASK_DATA_POOL_MAX];
+	guint			 n_free;
+} ChDeviceTaskDataPool;
+
 typedef struct {
-	guint8			*buffer;
-	guint8			*buffer_orig;
+	ChDeviceTaskDataPool	*pool;
+	guint8			 buffer[CH_USB_HID_EP_SIZE];
+	guint8			 buffer_orig[CH_USB_HID_EP_SIZE];
 	guint8			*buffer_out;
 	gsize			 buffer_out_len;
 	guint8			 cmd;
 	guint			 retried_cnt;
 	guint8			 report_type;	/* only for Sensor HID */
 	guint			 report_length;	/* only for Sensor HID */
+	gint64			 start_time;	/* for the stats */
+	gsize			 bytes_out;
+	gsize			 bytes_in;
+	gboolean		 timed_out;
 } ChDeviceTaskData;
 
 /**
@@ -195,12 +210,182 @@ ch_device_write_command_finish (GUsbDevice *device,
 	return g_task_propagate_boolean (G_TASK (res), error);
 }
 
+static void
+ch_device_task_data_pool_unref (ChDeviceTaskDataPool *pool)
+{
+	if (!g_atomic_int_dec_and_test (&pool->ref_count))
+		return;
+	while (pool->n_free > 0)
+		g_free (pool->free[--pool->n_free]);
+	g_mutex_clear (&pool->mutex);
+	g_free (pool);
+}
+
+static ChDeviceTaskData *
+ch_device_task_data_new (GUsbDevice *device)
+{
+	ChDeviceTaskData *tdata = NULL;
+	ChDeviceTaskDataPool *pool;
+	static GMutex mutex;
+
+	/* get the pool for this device */
+	g_mutex_lock (&mutex);
+	pool = g_object_get_data (G_OBJECT (device), "ChDeviceTaskDataPool");
+	if (pool == NULL) {
+		pool = g_new0 (ChDeviceTaskDataPool, 1);
+		pool->ref_count = 1;
+		g_mutex_init (&pool->mutex);
+		g_object_set_data_full (G_OBJECT (device), "ChDeviceTaskDataPool", pool,
+					(GDestroyNotify) ch_device_task_data_pool_unref);
+	}
+	g_atomic_int_inc (&pool->ref_count);
+	g_mutex_unlock (&mutex);
+
+	/* reuse a previous allocation if possible */
+	g_mutex_lock (&pool->mutex);
+	if (pool->n_free > 0)
+		tdata = pool->free[--pool->n_free];
+	g_mutex_unlock (&pool->mutex);
+	if (tdata == NULL)
+		tdata = g_new (ChDeviceTaskData, 1);
+	memset (tdata, 0, sizeof(ChDeviceTaskData));
+	tdata->pool = pool;
+	return tdata;
+}
+
 static void
 ch_device_task_data_free (ChDeviceTaskData *tdata)
 {
-	g_free (tdata->buffer);
-	g_free (tdata->buffer_orig);
+	ChDeviceTaskDataPool *pool = tdata->pool;
+
+	/* keep a few around for the next commands */
+	g_mutex_lock (&pool->mutex);
+	if (pool->n_free < CH_DEVICE_TASK_DATA_POOL_MAX) {
+		pool->free[pool->n_free++] = tdata;
+		tdata = NULL;
+	}
+	g_mutex_unlock (&pool->mutex);
 	g_free (tdata);
+	ch_device_task_data_pool_unref (pool);
+}
+
+G_LOCK_DEFINE_STATIC (ch_device_stats);
+
+static guint
+ch_device_stats_get_bucket (gint64 latency)
+{
+	gint64 msecs = latency / 1000;
+	guint idx = 0;
+
+	/* bucket n holds the latencies from 2^(n-1) to 2^n ms */
+	while (msecs > 0 && idx < CH_DEVICE_LATENCY_BUCKETS - 1) {
+		msecs >>= 1;
+		idx++;
+	}
+	return idx;
+}
+
+static void
+ch_device_stats_record (GUsbDevice *device,
+			ChDeviceTaskData *tdata,
+			const GError *error)
+{
+	ChDeviceCommandStats *stats;
+	GHashTable *cmds;
+	gint64 latency = g_get_monotonic_time () - tdata->start_time;
+
+	G_LOCK (ch_device_stats);
+	cmds = g_object_get_data (G_OBJECT (device), "ChDeviceStats");
+	if (cmds == NULL) {
+		cmds = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					      NULL, g_free);
+		g_object_set_data_full (G_OBJECT (device), "ChDeviceStats", cmds,
+					(GDestroyNotify) g_hash_table_unref);
+	}
+	stats = g_hash_table_lookup (cmds, GUINT_TO_POINTER (tdata->cmd));
+	if (stats == NULL) {
+		stats = g_new0 (ChDeviceCommandStats, 1);
+		g_hash_table_insert (cmds, GUINT_TO_POINTER (tdata->cmd), stats);
+	}
+	stats->n_requests++;
+	if (error != NULL)
+		stats->n_failures++;
+	if (tdata->timed_out)
+		stats->n_timeouts++;
+	stats->n_retries += tdata->retried_cnt;
+	stats->bytes_out += tdata->bytes_out;
+	stats->bytes_in += tdata->bytes_in;
+	stats->latency_total += latency;
+	stats->latency_max = MAX (stats->latency_max, latency);
+	stats->latency_histogram[ch_device_stats_get_bucket (latency)]++;
+	G_UNLOCK (ch_device_stats);
+}
+
+/* takes ownership of @error and the @task reference */
+static void
+ch_device_task_return (GTask *task, GError *error)
+{
+	ChDeviceTaskData *tdata = g_task_get_task_data (task);
+
+	ch_device_stats_record (G_USB_DEVICE (g_task_get_source_object (task)),
+				tdata, error);
+	if (error != NULL)
+		g_task_return_error (task, error);
+	else
+		g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * ch_device_get_command_stats:
+ * @device: A #GUsbDevice
+ * @cmd: The command, e.g. %CH_CMD_TAKE_READING_RAW
+ * @stats: (out caller-allocates): A #ChDeviceCommandStats
+ *
+ * Gets the transport statistics for all the requests of a given type sent
+ * to the device by ch_device_write_command_async().
+ *
+ * Returns: %TRUE if the command has been sent at least once
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+ch_device_get_command_stats (GUsbDevice *device,
+			     ChCmd cmd,
+			     ChDeviceCommandStats *stats)
+{
+	ChDeviceCommandStats *tmp = NULL;
+	GHashTable *cmds;
+
+	g_return_val_if_fail (G_USB_IS_DEVICE (device), FALSE);
+	g_return_val_if_fail (stats != NULL, FALSE);
+
+	G_LOCK (ch_device_stats);
+	cmds = g_object_get_data (G_OBJECT (device), "ChDeviceStats");
+	if (cmds != NULL)
+		tmp = g_hash_table_lookup (cmds, GUINT_TO_POINTER (cmd));
+	if (tmp != NULL)
+		*stats = *tmp;
+	G_UNLOCK (ch_device_stats);
+	return tmp != NULL;
+}
+
+/**
+ * ch_device_reset_command_stats:
+ * @device: A #GUsbDevice
+ *
+ * Clears the transport statistics for the device.
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_device_reset_command_stats (GUsbDevice *device)
+{
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+
+	G_LOCK (ch_device_stats);
+	g_object_set_data (G_OBJECT (device), "ChDeviceStats", NULL);
+	G_UNLOCK (ch_device_stats);
 }
 
 static void ch_device_request_cb (GObject *source_object, GAsyncResult *res, gpointer user_data);
@@ -223,13 +408,16 @@ ch_device_reply_cb (GObject *source_object,
 							     res,
 							     &error);
 	if ((gssize) actual_len < 0) {
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_INVALID_VALUE,
-					 "%s", error->message);
-		g_object_unref (task);
+		tdata->timed_out = g_error_matches (error,
+						    G_USB_DEVICE_ERROR,
+						    G_USB_DEVICE_ERROR_TIMED_OUT);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "%s", error->message));
+		g_error_free (error);
 		return;
 	}
+	tdata->bytes_in += actual_len;
 
 	/* parse the reply */
 	if (g_getenv ("COLORHUG_VERBOSE") != NULL) {
@@ -262,7 +450,7 @@ ch_device_reply_cb (GObject *source_object,
 							       CH_DEVICE_USB_TIMEOUT,
 							       g_task_get_cancellable (task),
 							       ch_device_request_cb,
-							       tdata);
+							       task);
 			/* we're re-using the tdata, so don't deallocate it */
 			return;
 		}
@@ -279,11 +467,10 @@ ch_device_reply_cb (GObject *source_object,
 				       actual_len,
 				       tdata->buffer_out_len + CH_BUFFER_OUTPUT_DATA,
 				       CH_USB_HID_EP_SIZE);
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 error_enum,
-					 "%s", msg);
-		g_object_unref (task);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  error_enum,
+							  "%s", msg));
+		g_free (msg);
 		return;
 	}
 
@@ -295,8 +482,7 @@ ch_device_reply_cb (GObject *source_object,
 	}
 
 	/* success */
-	g_task_return_boolean (task, TRUE);
-	g_object_unref (task);
+	ch_device_task_return (task, NULL);
 }
 
 static void
@@ -315,13 +501,16 @@ ch_device_request_cb (GObject *source_object,
 							     res,
 							     &error);
 	if (actual_len < CH_USB_HID_EP_SIZE) {
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_INVALID_VALUE,
-					 "%s", error->message);
-		g_object_unref (task);
+		tdata->timed_out = g_error_matches (error,
+						    G_USB_DEVICE_ERROR,
+						    G_USB_DEVICE_ERROR_TIMED_OUT);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "%s", error->message));
+		g_clear_error (&error);
 		return;
 	}
+	tdata->bytes_out += actual_len;
 
 	/* request the reply */
 	g_usb_device_interrupt_transfer_async (device,
@@ -334,22 +523,255 @@ ch_device_request_cb (GObject *source_object,
 					       task);
 }
 
-static gboolean
-ch_device_emulate_cb (gpointer user_data)
+/* the state of an emulated device, used when COLORHUG_EMULATE is set */
+typedef struct {
+	GRand			*rand;
+	guint			 latency;	/* ms */
+	guint			 jitter;	/* ms */
+	gdouble			 error_rate;	/* 0.0 to 1.0 */
+	guint8			 color_select;
+	guint8			 multiplier;
+	guint8			 leds;
+	guint16			 integral_time;
+	guint32			 serial_number;
+	guint8			*flash;		/* allocated on first use */
+	guint8			*sram;		/* allocated on first use */
+	guint8			*calibration;	/* allocated on first use */
+} ChDeviceEmulate;
+
+#define CH_EMULATE_CALIBRATION_SIZE	(9 * 4 + 1 + CH_CALIBRATION_DESCRIPTION_LEN)
+
+static void
+ch_device_emulate_free (ChDeviceEmulate *emulate)
 {
-	GTask *task = G_TASK (user_data);
-	ChDeviceTaskData *tdata = g_task_get_task_data (task);
+	g_rand_free (emulate->rand);
+	g_free (emulate->flash);
+	g_free (emulate->sram);
+	g_free (emulate->calibration);
+	g_free (emulate);
+}
+
+static guint
+ch_device_emulate_getenv_uint (const gchar *name, guint default_value)
+{
+	const gchar *tmp = g_getenv (name);
+	if (tmp == NULL)
+		return default_value;
+	return g_ascii_strtoull (tmp, NULL, 10);
+}
 
+static ChDeviceEmulate *
+ch_device_emulate_get (GUsbDevice *device)
+{
+	ChDeviceEmulate *emulate;
+	const gchar *tmp;
+
+	emulate = g_object_get_data (G_OBJECT (device), "ChDeviceEmulate");
+	if (emulate != NULL)
+		return emulate;
+
+	/* set up a new device that looks like a fresh ColorHug */
+	emulate = g_new0 (ChDeviceEmulate, 1);
+	tmp = g_getenv ("COLORHUG_EMULATE_SEED");
+	if (tmp != NULL)
+		emulate->rand = g_rand_new_with_seed (g_ascii_strtoull (tmp, NULL, 10));
+	else
+		emulate->rand = g_rand_new ();
+	emulate->latency = ch_device_emulate_getenv_uint ("COLORHUG_EMULATE_LATENCY", 20);
+	emulate->jitter = ch_device_emulate_getenv_uint ("COLORHUG_EMULATE_JITTER", 0);
+	emulate->error_rate = ch_device_emulate_getenv_uint ("COLORHUG_EMULATE_ERROR_RATE", 0) / 100.f;
+	emulate->color_select = CH_COLOR_SELECT_WHITE;
+	emulate->multiplier = CH_FREQ_SCALE_100;
+	emulate->integral_time = CH_INTEGRAL_TIME_VALUE_MAX;
+	emulate->serial_number = 42;
+	g_object_set_data_full (G_OBJECT (device), "ChDeviceEmulate", emulate,
+				(GDestroyNotify) ch_device_emulate_free);
+	return emulate;
+}
+
+static guint8 *
+ch_device_emulate_get_memory (guint8 **mem, gsize size, guint8 fill)
+{
+	if (*mem == NULL) {
+		*mem = g_malloc (size);
+		memset (*mem, fill, size);
+	}
+	return *mem;
+}
+
+/* how long the real hardware would take to answer, in ms */
+static guint
+ch_device_emulate_get_duration (ChDeviceEmulate *emulate, guint8 cmd)
+{
+	guint duration = emulate->latency;
+	guint integration = emulate->integral_time / (CH_INTEGRAL_TIME_VALUE_100MS / 100);
+
+	if (emulate->jitter > 0)
+		duration += g_rand_int_range (emulate->rand, 0, emulate->jitter + 1);
+	switch (cmd) {
+	case CH_CMD_TAKE_READING_RAW:
+		return duration + integration;
+	case CH_CMD_TAKE_READINGS:
+	case CH_CMD_TAKE_READING_XYZ:
+		return duration + integration * 3;
+	case CH_CMD_ERASE_FLASH:
+		return duration + 20;
+	case CH_CMD_WRITE_FLASH:
+		return duration + 2;
+	default:
+		break;
+	}
+	return duration;
+}
+
+/* a mid-grey patch with a little noise, from 0.0 to 1.0 */
+static gdouble
+ch_device_emulate_reading (ChDeviceEmulate *emulate, ChColorSelect color_select)
+{
+	const gdouble response[] = { 0.25, 0.75, 0.20, 0.30 };
+	return response[color_select & 0x03] *
+	       g_rand_double_range (emulate->rand, 0.99, 1.01);
+}
+
+static ChError
+ch_device_emulate_process (ChDeviceEmulate *emulate, ChDeviceTaskData *tdata)
+{
+	const gdouble freq_scale[] = { 0.f, 0.2f, 0.02f, 1.f };
+	const guint8 *in = tdata->buffer_orig + CH_BUFFER_INPUT_DATA;
+	gdouble rgb[3];
+	guint8 reply[CH_USB_HID_EP_SIZE] = { 0 };
+	guint8 *mem;
+	guint16 addr;
+	guint16 len;
+	guint32 tmp32;
+	guint i;
+
+	memcpy (&addr, in, 2);
+	addr = GUINT16_FROM_LE (addr);
 	switch (tdata->cmd) {
+	case CH_CMD_GET_COLOR_SELECT:
+		reply[0] = emulate->color_select;
+		break;
+	case CH_CMD_SET_COLOR_SELECT:
+		emulate->color_select = in[0];
+		break;
+	case CH_CMD_GET_MULTIPLIER:
+		reply[0] = emulate->multiplier;
+		break;
+	case CH_CMD_SET_MULTIPLIER:
+		emulate->multiplier = in[0];
+		break;
+	case CH_CMD_GET_LEDS:
+		reply[0] = emulate->leds;
+		break;
+	case CH_CMD_SET_LEDS:
+		emulate->leds = in[0];
+		break;
+	case CH_CMD_GET_INTEGRAL_TIME:
+		len = GUINT16_TO_LE (emulate->integral_time);
+		memcpy (reply, &len, 2);
+		break;
+	case CH_CMD_SET_INTEGRAL_TIME:
+		memcpy (&len, in, 2);
+		emulate->integral_time = GUINT16_FROM_LE (len);
+		break;
 	case CH_CMD_GET_SERIAL_NUMBER:
-		tdata->buffer_out[6] = 42;
+		tmp32 = GUINT32_TO_LE (emulate->serial_number);
+		memcpy (reply, &tmp32, 4);
+		break;
+	case CH_CMD_SET_SERIAL_NUMBER:
+		memcpy (&tmp32, in, 4);
+		emulate->serial_number = GUINT32_FROM_LE (tmp32);
 		break;
 	case CH_CMD_GET_FIRMWARE_VERSION:
-		tdata->buffer_out[0] = 0x01;
-		tdata->buffer_out[4] = 0x01;
+		reply[0] = 0x01;
+		reply[4] = 0x01;
 		break;
 	case CH_CMD_GET_HARDWARE_VERSION:
-		tdata->buffer_out[0] = 0xff;
+		reply[0] = 0xff;
+		break;
+	case CH_CMD_TAKE_READING_RAW:
+		/* scaled like the real sensor output */
+		tmp32 = ch_device_emulate_reading (emulate, emulate->color_select) *
+			emulate->integral_time *
+			freq_scale[emulate->multiplier & 0x03];
+		tmp32 = GUINT32_TO_LE (tmp32);
+		memcpy (reply, &tmp32, 4);
+		break;
+	case CH_CMD_TAKE_READINGS:
+	case CH_CMD_TAKE_READING_XYZ:
+		rgb[0] = ch_device_emulate_reading (emulate, CH_COLOR_SELECT_RED);
+		rgb[1] = ch_device_emulate_reading (emulate, CH_COLOR_SELECT_GREEN);
+		rgb[2] = ch_device_emulate_reading (emulate, CH_COLOR_SELECT_BLUE);
+		ch_double_to_packed_float_array (rgb, reply, 3);
+		break;
+	case CH_CMD_GET_CALIBRATION:
+		if (addr >= CH_CALIBRATION_MAX)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->calibration,
+						    CH_CALIBRATION_MAX * CH_EMULATE_CALIBRATION_SIZE,
+						    0x00);
+		memcpy (reply, mem + addr * CH_EMULATE_CALIBRATION_SIZE,
+			CH_EMULATE_CALIBRATION_SIZE);
+		break;
+	case CH_CMD_SET_CALIBRATION:
+		if (addr >= CH_CALIBRATION_MAX)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->calibration,
+						    CH_CALIBRATION_MAX * CH_EMULATE_CALIBRATION_SIZE,
+						    0x00);
+		memcpy (mem + addr * CH_EMULATE_CALIBRATION_SIZE, in + 2,
+			CH_EMULATE_CALIBRATION_SIZE);
+		break;
+	case CH_CMD_ERASE_FLASH:
+		memcpy (&len, in + 2, 2);
+		len = GUINT16_FROM_LE (len);
+		if ((guint) addr + len > 0x10000)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->flash, 0x10000, 0xff);
+		memset (mem + addr, 0xff, len);
+		break;
+	case CH_CMD_WRITE_FLASH:
+		len = in[2];
+		if (len > CH_FLASH_TRANSFER_BLOCK_SIZE)
+			return CH_ERROR_INVALID_LENGTH;
+		if ((guint) addr + len > 0x10000)
+			return CH_ERROR_INVALID_ADDRESS;
+		for (i = 0, tmp32 = 0; i < len; i++)
+			tmp32 ^= in[4 + i];
+		if (tmp32 != in[3])
+			return CH_ERROR_INVALID_CHECKSUM;
+		mem = ch_device_emulate_get_memory (&emulate->flash, 0x10000, 0xff);
+		memcpy (mem + addr, in + 4, len);
+		break;
+	case CH_CMD_READ_FLASH:
+		len = in[2];
+		if (len > CH_USB_HID_EP_SIZE - CH_BUFFER_OUTPUT_DATA - 1)
+			return CH_ERROR_INVALID_LENGTH;
+		if ((guint) addr + len > 0x10000)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->flash, 0x10000, 0xff);
+		for (i = 0; i < len; i++)
+			reply[0] ^= mem[addr + i];
+		memcpy (reply + 1, mem + addr, len);
+		break;
+	case CH_CMD_WRITE_SRAM:
+		len = in[2];
+		if (len > CH_USB_HID_EP_SIZE - CH_BUFFER_INPUT_DATA - 3)
+			return CH_ERROR_INVALID_LENGTH;
+		if ((guint) addr + len > 0x10000)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->sram, 0x10000, 0x00);
+		memcpy (mem + addr, in + 3, len);
+		break;
+	case CH_CMD_READ_SRAM:
+		len = in[2];
+		if (len > CH_USB_HID_EP_SIZE - CH_BUFFER_OUTPUT_DATA)
+			return CH_ERROR_INVALID_LENGTH;
+		if ((guint) addr + len > 0x10000)
+			return CH_ERROR_INVALID_ADDRESS;
+		mem = ch_device_emulate_get_memory (&emulate->sram, 0x10000, 0x00);
+		memcpy (reply, mem + addr, len);
 		break;
 	default:
 		g_debug ("Ignoring command %s",
@@ -357,13 +779,70 @@ ch_device_emulate_cb (gpointer user_data)
 		break;
 	}
 
+	/* copy */
+	if (tdata->buffer_out != NULL) {
+		memcpy (tdata->buffer_out, reply,
+			MIN (tdata->buffer_out_len, sizeof(reply)));
+	}
+	return CH_ERROR_NONE;
+}
+
+static gboolean
+ch_device_emulate_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	ChDeviceTaskData *tdata = g_task_get_task_data (task);
+	GUsbDevice *device = G_USB_DEVICE (g_task_get_source_object (task));
+	ChDeviceEmulate *emulate = ch_device_emulate_get (device);
+	ChError error_enum;
+
+	/* inject a transport failure */
+	if (emulate->error_rate > 0.f &&
+	    g_rand_double (emulate->rand) < emulate->error_rate) {
+		tdata->timed_out = TRUE;
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "Emulated timeout for %s",
+							  ch_command_to_string (tdata->cmd)));
+		return G_SOURCE_REMOVE;
+	}
+
+	/* update the device state and get the reply */
+	error_enum = ch_device_emulate_process (emulate, tdata);
+	tdata->bytes_out += CH_USB_HID_EP_SIZE;
+	tdata->bytes_in += CH_USB_HID_EP_SIZE;
+	if (error_enum != CH_ERROR_NONE) {
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  error_enum,
+							  "Invalid read: retval=0x%02x [%s] "
+							  "cmd=0x%02x [%s]",
+							  error_enum,
+							  ch_strerror (error_enum),
+							  tdata->cmd,
+							  ch_command_to_string (tdata->cmd)));
+		return G_SOURCE_REMOVE;
+	}
+
 	/* success */
-	g_task_return_boolean (task, TRUE);
-	g_object_unref (task);
+	ch_device_task_return (task, NULL);
 
 	return G_SOURCE_REMOVE;
 }
 
+static void
+ch_device_emulate_async (GUsbDevice *device, GTask *task)
+{
+	ChDeviceEmulate *emulate = ch_device_emulate_get (device);
+	ChDeviceTaskData *tdata = g_task_get_task_data (task);
+	g_autoptr(GSource) source = NULL;
+
+	/* complete in the context of the caller so that many emulated
+	 * devices can be driven from different threads */
+	source = g_timeout_source_new (ch_device_emulate_get_duration (emulate, tdata->cmd));
+	g_source_set_callback (source, ch_device_emulate_cb, task, NULL);
+	g_source_attach (source, g_main_context_get_thread_default ());
+}
+
 #define CH_REPORT_ALS				0x00
 #define CH_REPORT_HID_SENSOR			0x01
 #define CH_REPORT_SENSOR_SETTINGS		0x02
@@ -388,18 +867,20 @@ ch_device_sensor_hid_set_cb (GObject *source_object,
 							   res,
 							   &error);
 	if (actual_len != tdata->report_length) {
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_INVALID_VALUE,
-					 "%s", error->message);
-		g_object_unref (task);
+		tdata->timed_out = g_error_matches (error,
+						    G_USB_DEVICE_ERROR,
+						    G_USB_DEVICE_ERROR_TIMED_OUT);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "%s", error->message));
+		g_clear_error (&error);
 		return;
 	}
+	tdata->bytes_out += actual_len;
 //	ch_print_data_buffer ("reply", tdata->buffer, tdata->report_length);
 
 	/* success */
-	g_task_return_boolean (task, TRUE);
-	g_object_unref (task);
+	ch_device_task_return (task, NULL);
 }
 
 static void
@@ -418,20 +899,22 @@ ch_device_sensor_hid_report_cb (GObject *source_object,
 							     res,
 							     &error);
 	if ((gssize) actual_len < 0) {
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_INVALID_VALUE,
-					 "%s", error->message);
-		g_object_unref (task);
+		tdata->timed_out = g_error_matches (error,
+						    G_USB_DEVICE_ERROR,
+						    G_USB_DEVICE_ERROR_TIMED_OUT);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "%s", error->message));
+		g_error_free (error);
 		return;
 	}
+	tdata->bytes_in += actual_len;
 
 	/* copy out tdata */
 	memcpy (tdata->buffer_out, tdata->buffer + 3, 4);
 
 	/* success */
-	g_task_return_boolean (task, TRUE);
-	g_object_unref (task);
+	ch_device_task_return (task, NULL);
 }
 
 static void
@@ -451,13 +934,16 @@ ch_device_sensor_hid_get_cb (GObject *source_object,
 							   res,
 							   &error);
 	if (actual_len != tdata->report_length) {
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_INVALID_VALUE,
-					 "%s", error->message);
-		g_object_unref (task);
+		tdata->timed_out = g_error_matches (error,
+						    G_USB_DEVICE_ERROR,
+						    G_USB_DEVICE_ERROR_TIMED_OUT);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_INVALID_VALUE,
+							  "%s", error->message));
+		g_clear_error (&error);
 		return;
 	}
+	tdata->bytes_in += actual_len;
 //	ch_print_data_buffer ("reply", tdata->buffer, tdata->report_length);
 
 	switch (tdata->cmd) {
@@ -514,19 +1000,16 @@ ch_device_sensor_hid_get_cb (GObject *source_object,
 		another_request_required = TRUE;
 		break;
 	default:
-		g_task_return_new_error (task,
-					 CH_DEVICE_ERROR,
-					 CH_ERROR_UNKNOWN_CMD,
-					 "No Sensor HID support for 0x%02x",
-					 tdata->cmd);
-		g_object_unref (task);
+		ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+							  CH_ERROR_UNKNOWN_CMD,
+							  "No Sensor HID support for 0x%02x",
+							  tdata->cmd));
 		return;
 	}
 
 	/* getting the value was enough */
 	if (!another_request_required) {
-		g_task_return_boolean (task, TRUE);
-		g_object_unref (task);
+		ch_device_task_return (task, NULL);
 		return;
 	}
 
@@ -581,21 +1064,21 @@ ch_device_write_command_async (GUsbDevice *device,
 
 	task = g_task_new (device, cancellable, callback, user_data);
 
-	tdata = g_new0 (ChDeviceTaskData, 1);
+	tdata = ch_device_task_data_new (device);
 	tdata->buffer_out = buffer_out;
 	tdata->buffer_out_len = buffer_out_len;
-	tdata->buffer = g_new0 (guint8, CH_USB_HID_EP_SIZE);
 	g_task_set_task_data (task, tdata, (GDestroyNotify) ch_device_task_data_free);
 
 	/* set command */
 	tdata->cmd = cmd;
+	tdata->start_time = g_get_monotonic_time ();
 	tdata->buffer[CH_BUFFER_INPUT_CMD] = tdata->cmd;
 	if (buffer_in != NULL) {
 		memcpy (tdata->buffer + CH_BUFFER_INPUT_DATA,
 			buffer_in,
 			buffer_in_len);
 	}
-	tdata->buffer_orig = g_memdup (tdata->buffer, CH_USB_HID_EP_SIZE);
+	memcpy (tdata->buffer_orig, tdata->buffer, CH_USB_HID_EP_SIZE);
 
 	/* request */
 	if (g_getenv ("COLORHUG_VERBOSE") != NULL) {
@@ -606,7 +1089,7 @@ ch_device_write_command_async (GUsbDevice *device,
 
 	/* dummy hardware */
 	if (g_getenv ("COLORHUG_EMULATE") != NULL) {
-		g_timeout_add (20, ch_device_emulate_cb, tdata);
+		ch_device_emulate_async (device, task);
 		return;
 	}
 
@@ -640,12 +1123,10 @@ ch_device_write_command_async (GUsbDevice *device,
 			tdata->report_length = 14;
 			break;
 		default:
-			g_task_return_new_error (task,
-						 CH_DEVICE_ERROR,
-						 CH_ERROR_UNKNOWN_CMD,
-						 "No Sensor HID support for 0x%02x",
-						 tdata->cmd);
-			g_object_unref (task);
+			ch_device_task_return (task, g_error_new (CH_DEVICE_ERROR,
+								  CH_ERROR_UNKNOWN_CMD,
+								  "No Sensor HID support for 0x%02x",
+								  tdata->cmd));
 			return;
 		}
 
@@ -2456,9 +2937,6 @@ ch_device_get_spectrum_full (GUsbDevice *device,
 	g_return_val_if_fail (G_USB_DEVICE (device), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	/* populate ahead of time for each chunk */
-	sp = cd_spectrum_new ();
-
 	if (protocol_ver != 2) {
 		g_set_error_literal (error,
 				     CH_DEVICE_ERROR,
@@ -2467,6 +2945,9 @@ ch_device_get_spectrum_full (GUsbDevice *device,
 		return NULL;
 	}
 
+	/* populate ahead of time for each chunk */
+	sp = cd_spectrum_sized_new (CH_CCD_SPECTRAL_RESOLUTION);
+
 	/* i = address in SRAM */
 	for (i = 0; i < CH_SPECTRUM_STORAGE_SIZE; i += CH_EP0_TRANSFER_SIZE_V2) {
 		ret = g_usb_device_control_transfer (device,
@@ -2504,8 +2985,8 @@ ch_device_get_spectrum_full (GUsbDevice *device,
 	if (!ch_device_check_status (device, cancellable, error))
 		return NULL;
 
-	/* return copy */
-	return cd_spectrum_dup (sp);
+	/* success */
+	return g_steal_pointer (&sp);
 }
 
 /**
@@ -2528,6 +3009,294 @@ ch_device_get_spectrum (GUsbDevice *device, GCancellable *cancellable, GError **
 					    cancellable, error);
 }
 
+typedef struct {
+	guint16			*buffers;
+	guint			 n_readings;
+	ChSpectrumKind		 kind;
+	guint			 n_started;	/* integrations requested */
+	guint			 n_complete;	/* readings in @buffers */
+	guint			 n_pending;	/* transfers in flight */
+	GError			*error;
+} ChDeviceSpectralHelper;
+
+typedef struct {
+	GTask			*task;
+	guint8			 buf[2];
+} ChDeviceSpectralStatus;
+
+static void
+ch_device_spectral_helper_free (ChDeviceSpectralHelper *helper)
+{
+	if (helper->error != NULL)
+		g_error_free (helper->error);
+	g_free (helper);
+}
+
+static void
+ch_device_spectral_set_error (ChDeviceSpectralHelper *helper, GError *error)
+{
+	/* only the first failure is interesting */
+	if (helper->error != NULL) {
+		g_error_free (error);
+		return;
+	}
+	helper->error = error;
+}
+
+static void
+ch_device_spectral_check_done (GTask *task)
+{
+	ChDeviceSpectralHelper *helper = g_task_get_task_data (task);
+
+	/* the caller owns the buffers, so wait for every transfer */
+	if (helper->n_pending > 0)
+		return;
+	if (helper->error != NULL) {
+		g_task_return_error (task, helper->error);
+		helper->error = NULL;
+		g_object_unref (task);
+		return;
+	}
+	if (helper->n_complete < helper->n_readings)
+		return;
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+static void
+ch_device_spectral_status_cb (GObject *source_object,
+			      GAsyncResult *res,
+			      gpointer user_data)
+{
+	ChDeviceSpectralStatus *status = (ChDeviceSpectralStatus *) user_data;
+	GTask *task = status->task;
+	ChDeviceSpectralHelper *helper = g_task_get_task_data (task);
+	GError *error = NULL;
+	gssize actual_len;
+
+	helper->n_pending--;
+	actual_len = g_usb_device_control_transfer_finish (G_USB_DEVICE (source_object),
+							   res, &error);
+	if (actual_len < 0) {
+		ch_device_spectral_set_error (helper, error);
+	} else if (actual_len != sizeof(status->buf)) {
+		ch_device_spectral_set_error (helper,
+					      g_error_new (G_USB_DEVICE_ERROR,
+							   G_USB_DEVICE_ERROR_IO,
+							   "Invalid size, got %" G_GSSIZE_FORMAT,
+							   actual_len));
+	} else if (status->buf[0] != CH_ERROR_NONE) {
+		ch_device_spectral_set_error (helper,
+					      g_error_new (G_USB_DEVICE_ERROR,
+							   G_USB_DEVICE_ERROR_IO,
+							   "Failed, %s(0x%02x) status was %s(0x%02x)",
+							   ch_command_to_string (status->buf[1]),
+							   status->buf[1],
+							   ch_strerror (status->buf[0]),
+							   status->buf[0]));
+	} else {
+		helper->n_complete++;
+	}
+	g_free (status);
+	ch_device_spectral_check_done (task);
+}
+
+static void
+ch_device_spectral_read_cb (GObject *source_object,
+			    GAsyncResult *res,
+			    gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	ChDeviceSpectralHelper *helper = g_task_get_task_data (task);
+	GError *error = NULL;
+	gssize actual_len;
+
+	helper->n_pending--;
+	actual_len = g_usb_device_control_transfer_finish (G_USB_DEVICE (source_object),
+							   res, &error);
+	if (actual_len < 0) {
+		ch_device_spectral_set_error (helper, error);
+	} else if (actual_len != CH_EP0_TRANSFER_SIZE_V2) {
+		ch_device_spectral_set_error (helper,
+					      g_error_new (G_USB_DEVICE_ERROR,
+							   G_USB_DEVICE_ERROR_IO,
+							   "Failed to get spectrum data, got %" G_GSSIZE_FORMAT,
+							   actual_len));
+	}
+	ch_device_spectral_check_done (task);
+}
+
+static void ch_device_spectral_take_cb (GObject *source_object, GAsyncResult *res, gpointer user_data);
+
+static void
+ch_device_spectral_submit_take (GTask *task)
+{
+	ChDeviceSpectralHelper *helper = g_task_get_task_data (task);
+	GUsbDevice *device = G_USB_DEVICE (g_task_get_source_object (task));
+
+	helper->n_started++;
+	helper->n_pending++;
+	g_usb_device_control_transfer_async (device,
+					     G_USB_DEVICE_DIRECTION_DEVICE_TO_HOST,
+					     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+					     G_USB_DEVICE_RECIPIENT_INTERFACE,
+					     CH_CMD_TAKE_READING_SPECTRAL,
+					     helper->kind,	/* wValue */
+					     CH_USB_INTERFACE,	/* idx */
+					     NULL,		/* data */
+					     0,			/* length */
+					     CH_DEVICE_USB_TIMEOUT,
+					     g_task_get_cancellable (task),
+					     ch_device_spectral_take_cb,
+					     task);
+}
+
+static void
+ch_device_spectral_take_cb (GObject *source_object,
+			    GAsyncResult *res,
+			    gpointer user_data)
+{
+	ChDeviceSpectralStatus *status;
+	GTask *task = G_TASK (user_data);
+	ChDeviceSpectralHelper *helper = g_task_get_task_data (task);
+	GUsbDevice *device = G_USB_DEVICE (source_object);
+	GError *error = NULL;
+	guint8 *dest;
+	guint16 i;
+
+	helper->n_pending--;
+	if (g_usb_device_control_transfer_finish (device, res, &error) < 0) {
+		ch_device_spectral_set_error (helper, error);
+		ch_device_spectral_check_done (task);
+		return;
+	}
+
+	/* something else already failed, so do not queue any more */
+	if (helper->error != NULL) {
+		ch_device_spectral_check_done (task);
+		return;
+	}
+
+	/* read the SRAM straight into the caller buffer; EP0 requests are
+	 * handled in order so this finishes before the next integration
+	 * can overwrite the storage slot */
+	dest = (guint8 *) (helper->buffers +
+			   (helper->n_started - 1) * CH_CCD_SPECTRAL_RESOLUTION);
+	for (i = 0; i < CH_SPECTRUM_STORAGE_SIZE; i += CH_EP0_TRANSFER_SIZE_V2) {
+		helper->n_pending++;
+		g_usb_device_control_transfer_async (device,
+						     G_USB_DEVICE_DIRECTION_DEVICE_TO_HOST,
+						     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+						     G_USB_DEVICE_RECIPIENT_INTERFACE,
+						     CH_CMD_READ_SRAM,
+						     i + (helper->kind * CH_SPECTRUM_STORAGE_SIZE),/* wValue */
+						     CH_USB_INTERFACE,	/* idx */
+						     dest + i,		/* data */
+						     CH_EP0_TRANSFER_SIZE_V2,/* length */
+						     CH_DEVICE_USB_TIMEOUT,
+						     g_task_get_cancellable (task),
+						     ch_device_spectral_read_cb,
+						     task);
+	}
+
+	/* check status */
+	status = g_new0 (ChDeviceSpectralStatus, 1);
+	status->task = task;
+	helper->n_pending++;
+	g_usb_device_control_transfer_async (device,
+					     G_USB_DEVICE_DIRECTION_DEVICE_TO_HOST,
+					     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+					     G_USB_DEVICE_RECIPIENT_INTERFACE,
+					     CH_CMD_GET_ERROR,
+					     0x00,		/* wValue */
+					     CH_USB_INTERFACE,	/* idx */
+					     status->buf,	/* data */
+					     sizeof(status->buf),/* length */
+					     CH_DEVICE_USB_TIMEOUT,
+					     g_task_get_cancellable (task),
+					     ch_device_spectral_status_cb,
+					     status);
+
+	/* start the next integration without waiting for the readout */
+	if (helper->n_started < helper->n_readings)
+		ch_device_spectral_submit_take (task);
+}
+
+/**
+ * ch_device_take_readings_spectral_async:
+ * @device: A #GUsbDevice
+ * @kind: A #ChSpectrumKind, e.g. %CH_SPECTRUM_KIND_RAW
+ * @buffers: caller-allocated storage for the readings
+ * @n_readings: the number of readings to take
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: A #GAsyncReadyCallback that will be called when finished.
+ * @user_data: User data passed to @callback
+ *
+ * Takes @n_readings spectral readings, writing the raw CCD values of each
+ * one into @buffers which must hold @n_readings multiplied by
+ * %CH_CCD_SPECTRAL_RESOLUTION values and stay valid until @callback is run.
+ *
+ * The next integration is requested as soon as the previous one has
+ * finished, without waiting for its SRAM readout to complete.
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_device_take_readings_spectral_async (GUsbDevice *device,
+					ChSpectrumKind kind,
+					guint16 *buffers,
+					guint n_readings,
+					GCancellable *cancellable,
+					GAsyncReadyCallback callback,
+					gpointer user_data)
+{
+	ChDeviceSpectralHelper *helper;
+	GTask *task;
+
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+	g_return_if_fail (buffers != NULL);
+	g_return_if_fail (n_readings > 0);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	if (ch_device_get_protocol_ver (device) != 2) {
+		g_task_return_new_error (task,
+					 CH_DEVICE_ERROR,
+					 CH_ERROR_NOT_IMPLEMENTED,
+					 "Taking spectral data is not supported");
+		g_object_unref (task);
+		return;
+	}
+
+	helper = g_new0 (ChDeviceSpectralHelper, 1);
+	helper->buffers = buffers;
+	helper->n_readings = n_readings;
+	helper->kind = kind;
+	g_task_set_task_data (task, helper, (GDestroyNotify) ch_device_spectral_helper_free);
+	ch_device_spectral_submit_take (task);
+}
+
+/**
+ * ch_device_take_readings_spectral_finish:
+ * @device: a #GUsbDevice instance.
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: %TRUE if all the readings were taken.
+ *
+ * Since: 1.4.10
+ **/
+gboolean
+ch_device_take_readings_spectral_finish (GUsbDevice *device,
+					 GAsyncResult *res,
+					 GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, device), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
 /**
  * ch_device_save_sram:
  * @device: A #GUsbDevice
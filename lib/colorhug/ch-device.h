@@ -36,6 +36,28 @@ G_BEGIN_DECLS
 
 #define CH_DEVICE_ERROR		(ch_device_error_quark ())
 
+#define CH_DEVICE_LATENCY_BUCKETS	12
+
+/**
+ * ChDeviceCommandStats:
+ *
+ * The transport statistics for one command type. Latencies are in
+ * microseconds, and bucket n of the histogram counts the requests that
+ * took between 2^(n-1) and 2^n milliseconds, with bucket 0 holding the
+ * requests that took less than 1ms.
+ **/
+typedef struct {
+	guint		 n_requests;
+	guint		 n_failures;
+	guint		 n_retries;
+	guint		 n_timeouts;
+	guint64		 bytes_out;
+	guint64		 bytes_in;
+	gint64		 latency_total;
+	gint64		 latency_max;
+	guint		 latency_histogram[CH_DEVICE_LATENCY_BUCKETS];
+} ChDeviceCommandStats;
+
 GQuark		 ch_device_error_quark		(void);
 gboolean	 ch_device_open			(GUsbDevice	*device,
 						 GError		**error)
@@ -58,6 +80,10 @@ gboolean	 ch_device_write_command_finish	(GUsbDevice	*device,
 						 GAsyncResult	*res,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 ch_device_get_command_stats	(GUsbDevice	*device,
+						 ChCmd		 cmd,
+						 ChDeviceCommandStats *stats);
+void		 ch_device_reset_command_stats	(GUsbDevice	*device);
 gboolean	 ch_device_write_command	(GUsbDevice	*device,
 						 guint8		 cmd,
 						 const guint8	*buffer_in,
@@ -170,6 +196,16 @@ CdSpectrum	*ch_device_get_spectrum_full	(GUsbDevice	*device,
 						 ChSpectrumKind	 kind,
 						 GCancellable	*cancellable,
 						 GError		**error);
+void		 ch_device_take_readings_spectral_async (GUsbDevice *device,
+						 ChSpectrumKind	 kind,
+						 guint16	*buffers,
+						 guint		 n_readings,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+gboolean	 ch_device_take_readings_spectral_finish (GUsbDevice *device,
+						 GAsyncResult	*res,
+						 GError		**error);
 gboolean	 ch_device_set_spectrum_full	(GUsbDevice	*device,
 						 ChSpectrumKind	 kind,
 						 CdSpectrum	*sp,
@@ -22,7 +22,6 @@
 #include "config.h"
 
 #include <glib.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "ch-inhx32.h"
@@ -31,14 +30,27 @@
 #define	CH_RECORD_TYPE_EOF		1
 #define	CH_RECORD_TYPE_EXTENDED		4
 
-static guint8
-ch_inhx32_parse_uint8 (const gchar *data, guint pos)
+/* the nibble value plus one, so that zero means not a hex digit */
+static const guint8 ch_inhx32_hex_table[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/* never reads past a NUL as that is not a hex digit */
+static gboolean
+ch_inhx32_parse_uint8 (const gchar *data, guint8 *value)
 {
-	gchar buffer[3];
-	buffer[0] = data[pos+0];
-	buffer[1] = data[pos+1];
-	buffer[2] = '\0';
-	return g_ascii_strtoull (buffer, NULL, 16);
+	guint8 hi = ch_inhx32_hex_table[(guint8) data[0]];
+	guint8 lo;
+	if (hi == 0)
+		return FALSE;
+	lo = ch_inhx32_hex_table[(guint8) data[1]];
+	if (lo == 0)
+		return FALSE;
+	*value = ((hi - 1) << 4) | (lo - 1);
+	return TRUE;
 }
 
 /**
@@ -63,102 +75,94 @@ ch_inhx32_to_bin_full (const gchar *in_buffer,
 		       guint16 runcode_addr,
 		       GError **error)
 {
+	const gchar *ptr;
 	gboolean verbose;
-	gchar *ptr;
-	gint checksum;
-	gint end;
-	gint i;
-	gint offset = 0;
-	guint8 data_tmp;
-	guint addr32 = 0;
-	guint addr32_last = 0;
+	gsize buf_size;
+	gsize len = 0;
+	guint addr_first = G_MAXUINT;
 	guint addr_high = 0;
-	guint addr_low = 0;
-	guint j;
-	guint len_tmp;
-	guint type;
-	g_autoptr(GString) string = NULL;
+	guint addr32;
+	guint i;
+	guint8 record[5 + 255];
+	guint8 checksum;
+	g_autofree guint8 *buf = NULL;
 
 	g_return_val_if_fail (in_buffer != NULL, FALSE);
 	g_return_val_if_fail (runcode_addr > 0, FALSE);
 
-	/* only if set */
+	/* only addresses from the runcode up to 0xfff0 are used, and holes
+	 * are filled with 0x00 as we can't write 0xffff to pic14 */
 	verbose = g_getenv ("VERBOSE") != NULL;
-	string = g_string_new ("");
-	while (TRUE) {
+	buf_size = runcode_addr < 0xfff0 ? 0xfff0 - runcode_addr : 0;
+	buf_size = MAX (buf_size, (gsize) runcode_addr);
+	buf = g_malloc0 (buf_size);
+
+	ptr = strchr (in_buffer, ':');
+	if (ptr == NULL) {
+		g_set_error_literal (error, 1, 0,
+				     "invalid inhx32 syntax");
+		return FALSE;
+	}
+	while (ptr != NULL) {
+		guint len_tmp;
 
-		/* length, 16-bit address, type */
-		if (sscanf (&in_buffer[offset], ":%02x%04x%02x",
-			    &len_tmp, &addr_low, &type) != 3) {
+		/* length, 16-bit address, type, data, checksum */
+		ptr++;
+		if (!ch_inhx32_parse_uint8 (ptr, &record[0])) {
 			g_set_error_literal (error, 1, 0,
 					     "invalid inhx32 syntax");
 			return FALSE;
 		}
-
-		/* position of checksum */
-		end = offset + 9 + len_tmp * 2;
-
-		/* verify checksum */
+		len_tmp = record[0];
 		checksum = 0;
-		for (i = offset + 1; i < end; i += 2) {
-			data_tmp = ch_inhx32_parse_uint8 (in_buffer, i);
-			checksum = (checksum + (0x100 - data_tmp)) & 0xff;
+		for (i = 0; i < len_tmp + 5; i++) {
+			if (!ch_inhx32_parse_uint8 (ptr + i * 2, &record[i])) {
+				g_set_error_literal (error, 1, 0,
+						     "invalid inhx32 syntax");
+				return FALSE;
+			}
+			checksum += record[i];
 		}
-		if (ch_inhx32_parse_uint8 (in_buffer, end) != checksum)  {
+		if (checksum != 0) {
 			g_set_error_literal (error, 1, 0,
 					     "invalid checksum");
 			return FALSE;
 		}
 
 		/* process different record types */
-		switch (type) {
+		switch (record[3]) {
 		case CH_RECORD_TYPE_DATA:
-			/* if not contiguous with previous record,
-			 * issue accumulated hex data (if any) and start anew. */
-			if ((addr_high + addr_low) != addr32)
-				addr32 = addr_high + addr_low;
-
-			/* Parse bytes from line into hexBuf */
-			for (i = offset + 9; i < end; i += 2) {
-				if (addr32 >= runcode_addr &&
-				    addr32 < 0xfff0) {
-
-					/* find out if there are any
-					 * holes in the hex record */
-					len_tmp = addr32 - addr32_last;
-					if (addr32_last > 0x0 && len_tmp > 1) {
-						for (j = 1; j < len_tmp; j++) {
-							if (verbose) {
-								g_debug ("Filling address 0x%04x",
-									 addr32_last + j);
-							}
-							/* although 0xff might be clearer,
-							 * we can't write 0xffff to pic14 */
-							g_string_append_c (string, 0x00);
-						}
-					}
-					data_tmp = ch_inhx32_parse_uint8 (in_buffer, i);
-					g_string_append_c (string, data_tmp);
-					if (verbose)
-						g_debug ("Writing address 0x%04x", addr32);
-					addr32_last = addr32;
-				} else {
-					if (verbose)
-						g_debug ("Ignoring address 0x%04x", addr32);
+			addr32 = addr_high + ((guint) record[1] << 8) + record[2];
+			for (i = 0; i < len_tmp; i++, addr32++) {
+				gsize pos;
+				if (addr32 < runcode_addr || addr32 >= 0xfff0)
+					continue;
+				if (addr_first == G_MAXUINT)
+					addr_first = addr32;
+				if (addr32 < addr_first) {
+					g_set_error (error, 1, 0,
+						     "address 0x%04x is before 0x%04x",
+						     addr32, addr_first);
+					return FALSE;
 				}
-				addr32++;
+				pos = addr32 - addr_first;
+				buf[pos] = record[4 + i];
+				len = MAX (len, pos + 1);
+			}
+			if (verbose) {
+				g_debug ("Record at 0x%04x size %u",
+					 addr32 - len_tmp, len_tmp);
 			}
 			break;
 		case CH_RECORD_TYPE_EOF:
 			break;
 		case CH_RECORD_TYPE_EXTENDED:
-			if (sscanf (&in_buffer[offset+9], "%04x", &addr_high) != 1) {
+			if (len_tmp != 2) {
 				g_set_error_literal (error, 1, 0,
 						     "invalid hex syntax");
 				return FALSE;
 			}
-			addr_high <<= 16;
-			addr32 = addr_high + addr_low;
+			addr_high = (((guint) record[4] << 8) + record[5]) << 16;
 			break;
 		default:
 			g_set_error_literal (error, 1, 0,
@@ -167,21 +171,17 @@ ch_inhx32_to_bin_full (const gchar *in_buffer,
 		}
 
 		/* advance to start of next line */
-		ptr = strchr (&in_buffer[end+2], ':');
-		if (ptr == NULL)
-			break;
-		offset = ptr - in_buffer;
+		ptr = strchr (ptr + (len_tmp + 5) * 2, ':');
 	}
 
 	/* pad out to device size so we can read back a verifiable blob */
-	for (i = string->len; i < runcode_addr; i++)
-		g_string_append_len (string, "\0", 1);
+	len = MAX (len, (gsize) runcode_addr);
 
 	/* save data */
 	if (out_size != NULL)
-		*out_size = string->len;
+		*out_size = len;
 	if (out_buffer != NULL)
-		*out_buffer = g_memdup (string->str, string->len);
+		*out_buffer = g_realloc (g_steal_pointer (&buf), len);
 	return TRUE;
 }
 
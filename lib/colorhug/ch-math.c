@@ -23,6 +23,7 @@
 
 #include <glib.h>
 #include <math.h>
+#include <string.h>
 
 #include "ch-math.h"
 #include "ch-common.h"
@@ -101,6 +102,67 @@ ch_double_to_packed_float (gdouble value, ChPackedFloat *pf)
 	ch_packed_float_set_value (pf, value * (gdouble) 0x10000);
 }
 
+/**
+ * ch_packed_float_to_double_array:
+ *
+ * @data: packed floats in device byte order
+ * @values: an array of at least @n_values doubles
+ * @n_values: the number of values to convert
+ *
+ * Converts a contiguous array of packed floats, for instance a calibration
+ * matrix as sent by the device, to doubles.
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_packed_float_to_double_array (const guint8 *data,
+				 gdouble *values,
+				 guint n_values)
+{
+	guint i;
+
+	g_return_if_fail (data != NULL || n_values == 0);
+	g_return_if_fail (values != NULL || n_values == 0);
+
+	/* no branches or calls in the loop so it can be vectorized */
+	for (i = 0; i < n_values; i++) {
+		guint32 tmp;
+		memcpy (&tmp, data + i * sizeof(ChPackedFloat), sizeof(tmp));
+		values[i] = (gint32) GUINT32_FROM_LE (tmp) / (gdouble) 0x10000;
+	}
+}
+
+/**
+ * ch_double_to_packed_float_array:
+ *
+ * @values: an array of doubles
+ * @data: a buffer of at least @n_values packed floats
+ * @n_values: the number of values to convert
+ *
+ * Converts an array of doubles to contiguous packed floats in device byte
+ * order. Values that do not fit in a packed float are clamped.
+ *
+ * Since: 1.4.10
+ **/
+void
+ch_double_to_packed_float_array (const gdouble *values,
+				 guint8 *data,
+				 guint n_values)
+{
+	guint i;
+
+	g_return_if_fail (values != NULL || n_values == 0);
+	g_return_if_fail (data != NULL || n_values == 0);
+
+	for (i = 0; i < n_values; i++) {
+		gdouble val = CLAMP (values[i],
+				      G_MININT32 / (gdouble) 0x10000,
+				      G_MAXINT32 / (gdouble) 0x10000);
+		guint32 tmp = GUINT32_TO_LE ((gint32) (val * (gdouble) 0x10000));
+		memcpy (data + i * sizeof(ChPackedFloat), &tmp, sizeof(tmp));
+	}
+}
+
 /**
  * ch_packed_float_add:
  *
@@ -56,6 +56,13 @@ void		 ch_packed_float_to_double	(const ChPackedFloat	*pf,
 void		 ch_double_to_packed_float	(gdouble		 value,
 						 ChPackedFloat		*pf);
 
+void		 ch_packed_float_to_double_array (const guint8		*data,
+						 gdouble		*values,
+						 guint			 n_values);
+void		 ch_double_to_packed_float_array (const gdouble		*values,
+						 guint8			*data,
+						 guint			 n_values);
+
 ChError		 ch_packed_float_add		(const ChPackedFloat	*pf1,
 						 const ChPackedFloat	*pf2,
 						 ChPackedFloat		*result);
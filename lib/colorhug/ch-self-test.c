@@ -32,6 +32,7 @@
 #include "ch-hash.h"
 #include "ch-device.h"
 #include "ch-device-queue.h"
+#include "ch-inhx32.h"
 
 static void
 ch_test_hash_func (void)
@@ -299,6 +300,32 @@ ch_test_math_convert_func (void)
 	g_assert_cmpfloat (value, <, +32767.9999);
 }
 
+static void
+ch_test_math_convert_array_func (void)
+{
+	ChPackedFloat pf;
+	const gdouble values[] = { 3.1415927, -2.5, 0.0, 0.000015, 32767.0, 1e9 };
+	gdouble result[G_N_ELEMENTS (values)];
+	guint8 data[G_N_ELEMENTS (values) * sizeof (ChPackedFloat)];
+	guint i;
+
+	/* test the layout matches the scalar version */
+	ch_double_to_packed_float_array (values, data, G_N_ELEMENTS (values));
+	for (i = 0; i < 5; i++) {
+		ch_double_to_packed_float (values[i], &pf);
+		g_assert_cmpint (memcmp (data + i * 4, &pf, 4), ==, 0);
+	}
+
+	/* test round trip */
+	ch_packed_float_to_double_array (data, result, G_N_ELEMENTS (values));
+	for (i = 0; i < 5; i++)
+		g_assert_cmpfloat (ABS (result[i] - values[i]), <, 0.00002);
+
+	/* test out of range values are clamped */
+	g_assert_cmpfloat (result[5], >, 32767.9999);
+	g_assert_cmpfloat (result[5], <, 32768.0);
+}
+
 static void
 ch_test_math_add_func (void)
 {
@@ -1254,6 +1281,44 @@ ch_test_firmware_func (void)
 	g_assert_cmpint (device_mode, ==, CH_DEVICE_MODE_FIRMWARE2);
 }
 
+static void
+ch_test_inhx32_func (void)
+{
+	gboolean ret;
+	gsize len = 0;
+	g_autofree guint8 *data = NULL;
+	g_autoptr(GError) error = NULL;
+	const gchar *hex =
+		":04400000DEADBEEF84\n"
+		":02400800123470\r\n"
+		":02001000556633\n"
+		":00000001FF\n";
+
+	/* the hole is filled and the record before the runcode is ignored */
+	ret = ch_inhx32_to_bin_full (hex, &data, &len, 0x4000, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, ==, 0x4000);
+	g_assert_cmpint (data[0], ==, 0xde);
+	g_assert_cmpint (data[3], ==, 0xef);
+	g_assert_cmpint (data[4], ==, 0x00);
+	g_assert_cmpint (data[8], ==, 0x12);
+	g_assert_cmpint (data[9], ==, 0x34);
+	g_clear_pointer (&data, g_free);
+
+	/* bad checksum */
+	ret = ch_inhx32_to_bin_full (":04400000DEADBEEF85\n", &data, &len,
+				     0x4000, &error);
+	g_assert_error (error, 1, 0);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* truncated */
+	ret = ch_inhx32_to_bin_full (":0440", &data, &len, 0x4000, &error);
+	g_assert_error (error, 1, 0);
+	g_assert (!ret);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1266,6 +1331,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/ColorHug/hash", ch_test_hash_func);
 	g_test_add_func ("/ColorHug/device-queue", ch_test_device_queue_func);
 	g_test_add_func ("/ColorHug/math-convert", ch_test_math_convert_func);
+	g_test_add_func ("/ColorHug/math-convert-array", ch_test_math_convert_array_func);
 	g_test_add_func ("/ColorHug/math-add", ch_test_math_add_func);
 	g_test_add_func ("/ColorHug/math-multiply", ch_test_math_multiply_func);
 	g_test_add_func ("/ColorHug/state", ch_test_state_func);
@@ -1274,6 +1340,7 @@ main (int argc, char **argv)
 	g_test_add_func ("/ColorHug/reading-xyz", ch_test_reading_xyz_func);
 	g_test_add_func ("/ColorHug/device-incomplete-request", ch_test_incomplete_request_func);
 	g_test_add_func ("/ColorHug/firmware", ch_test_firmware_func);
+	g_test_add_func ("/ColorHug/inhx32", ch_test_inhx32_func);
 
 	return g_test_run ();
 }
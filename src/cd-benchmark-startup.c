@@ -0,0 +1,558 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <locale.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "cd-common.h"
+
+#define CD_BENCHMARK_PROFILES_PER_DIR	100
+#define CD_BENCHMARK_DIRS_PER_VENDOR	10
+#define CD_BENCHMARK_TIMEOUT		600	/* s */
+
+typedef struct {
+	gchar		*root_dir;
+	gchar		*daemon;
+	gchar		*provision_filename;
+	GPtrArray	*profile_ids;		/* of gchar */
+	guint		 n_profiles;
+	guint		 n_devices;
+	guint		 n_mappings;
+	gboolean	 json;
+	gboolean	 first_result;
+} CdBenchmarkPriv;
+
+/* what one run of the daemon cost */
+typedef struct {
+	GMainLoop	*loop;
+	GTimer		*timer;
+	guint		 n_profiles;
+	guint		 profiles_added;
+	guint		 signals;
+	gdouble		 time_name;
+	gdouble		 time_profiles;
+	gdouble		 time_complete;
+	guint64		 sql_statements;
+	guint64		 peak_rss;		/* kB */
+	gboolean	 timed_out;
+} CdBenchmarkRun;
+
+static gboolean
+cd_benchmark_mkdir (const gchar *path, GError **error)
+{
+	if (g_mkdir_with_parents (path, 0700) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "failed to create %s", path);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* one real profile is written and then only the profile ID is changed, as
+ * parsing the header is what the daemon does for each file at startup */
+static gboolean
+cd_benchmark_create_profiles (CdBenchmarkPriv *priv, GError **error)
+{
+	const guint8 *template_data;
+	gsize template_len = 0;
+	g_autofree guint8 *data = NULL;
+	g_autoptr(CdIcc) icc = cd_icc_new ();
+	g_autoptr(GBytes) blob = NULL;
+
+	if (!cd_icc_create_default (icc, error))
+		return FALSE;
+	cd_icc_set_description (icc, NULL, "Benchmark");
+	blob = cd_icc_save_data (icc, CD_ICC_SAVE_FLAGS_NONE, error);
+	if (blob == NULL)
+		return FALSE;
+	template_data = g_bytes_get_data (blob, &template_len);
+	if (template_len < 128) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "profile too small: %" G_GSIZE_FORMAT,
+			     template_len);
+		return FALSE;
+	}
+	data = g_malloc (template_len);
+	memcpy (data, template_data, template_len);
+
+	/* nested like a vendor tree, so the directory walk is measured too */
+	for (guint i = 0; i < priv->n_profiles; i++) {
+		guint dir = i / CD_BENCHMARK_PROFILES_PER_DIR;
+		g_autofree gchar *basename = NULL;
+		g_autofree gchar *dirname = NULL;
+		g_autofree gchar *filename = NULL;
+		g_autoptr(GString) profile_id = g_string_new ("icc-");
+
+		dirname = g_strdup_printf ("%s/usr/share/color/icc/vendor%03u/model%03u",
+					   priv->root_dir,
+					   dir / CD_BENCHMARK_DIRS_PER_VENDOR,
+					   dir % CD_BENCHMARK_DIRS_PER_VENDOR);
+		if (!cd_benchmark_mkdir (dirname, error))
+			return FALSE;
+
+		/* the 16 byte profile ID is at offset 84 */
+		memset (data + 84, 0, 16);
+		data[84] = 0xcd;
+		data[96] = (i >> 24) & 0xff;
+		data[97] = (i >> 16) & 0xff;
+		data[98] = (i >> 8) & 0xff;
+		data[99] = i & 0xff;
+		for (guint j = 84; j < 100; j++)
+			g_string_append_printf (profile_id, "%02x", data[j]);
+		g_ptr_array_add (priv->profile_ids,
+				 g_string_free (g_steal_pointer (&profile_id), FALSE));
+
+		basename = g_strdup_printf ("profile%06u.icc", i);
+		filename = g_build_filename (dirname, basename, NULL);
+		if (!g_file_set_contents (filename, (const gchar *) data,
+					  template_len, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* devices and mappings are written to the databases by the daemon itself
+ * using the provisioning file on the first run */
+static gboolean
+cd_benchmark_create_provision (CdBenchmarkPriv *priv, GError **error)
+{
+	guint mapping = 0;
+	g_autoptr(GKeyFile) keyfile = g_key_file_new ();
+
+	for (guint i = 0; i < priv->n_devices; i++) {
+		guint n_mappings = priv->n_mappings / priv->n_devices;
+		g_autofree gchar *group = NULL;
+		g_autofree gchar *model = NULL;
+		g_autoptr(GPtrArray) profiles = g_ptr_array_new ();
+
+		group = g_strdup_printf ("Device xrandr-benchmark-%05u", i);
+		model = g_strdup_printf ("Model %u", i);
+		g_key_file_set_string (keyfile, group, CD_DEVICE_PROPERTY_KIND, "display");
+		g_key_file_set_string (keyfile, group, CD_DEVICE_PROPERTY_VENDOR, "Benchmark");
+		g_key_file_set_string (keyfile, group, CD_DEVICE_PROPERTY_MODEL, model);
+
+		/* spread the remainder over the first few devices */
+		if (i < priv->n_mappings % priv->n_devices)
+			n_mappings++;
+		for (guint j = 0; j < n_mappings && priv->profile_ids->len > 0; j++) {
+			g_ptr_array_add (profiles,
+					 g_ptr_array_index (priv->profile_ids,
+							    mapping++ % priv->profile_ids->len));
+		}
+		if (profiles->len > 0) {
+			g_key_file_set_string_list (keyfile, group,
+						    "Profiles",
+						    (const gchar * const *) profiles->pdata,
+						    profiles->len);
+		}
+	}
+	priv->provision_filename = g_build_filename (priv->root_dir, "provision.conf", NULL);
+	return g_key_file_save_to_file (keyfile, priv->provision_filename, error);
+}
+
+static void
+cd_benchmark_name_appeared_cb (GDBusConnection *connection,
+			       const gchar *name,
+			       const gchar *name_owner,
+			       gpointer user_data)
+{
+	CdBenchmarkRun *run = (CdBenchmarkRun *) user_data;
+	run->time_name = g_timer_elapsed (run->timer, NULL);
+}
+
+static void
+cd_benchmark_check_done (CdBenchmarkRun *run)
+{
+	if (run->time_profiles > 0.f && run->time_complete > 0.f)
+		g_main_loop_quit (run->loop);
+}
+
+static void
+cd_benchmark_signal_cb (GDBusConnection *connection,
+			const gchar *sender_name,
+			const gchar *object_path,
+			const gchar *interface_name,
+			const gchar *signal_name,
+			GVariant *parameters,
+			gpointer user_data)
+{
+	CdBenchmarkRun *run = (CdBenchmarkRun *) user_data;
+
+	/* only count what the daemon sends */
+	if (g_strcmp0 (sender_name, "org.freedesktop.DBus") == 0)
+		return;
+	run->signals++;
+
+	if (g_strcmp0 (signal_name, "ProfileAdded") == 0) {
+		if (++run->profiles_added == run->n_profiles)
+			run->time_profiles = g_timer_elapsed (run->timer, NULL);
+	} else if (g_strcmp0 (signal_name, "PropertiesChanged") == 0) {
+		const gchar *interface = NULL;
+		const gchar *stage = NULL;
+		g_autoptr(GVariant) changed = NULL;
+		g_variant_get (parameters, "(&s@a{sv}as)", &interface, &changed, NULL);
+		if (g_strcmp0 (interface, COLORD_DBUS_INTERFACE) == 0 &&
+		    g_variant_lookup (changed, CD_CLIENT_PROPERTY_STARTUP_STAGE, "&s", &stage) &&
+		    g_strcmp0 (stage, "complete") == 0)
+			run->time_complete = g_timer_elapsed (run->timer, NULL);
+	}
+	cd_benchmark_check_done (run);
+}
+
+static gboolean
+cd_benchmark_timeout_cb (gpointer user_data)
+{
+	CdBenchmarkRun *run = (CdBenchmarkRun *) user_data;
+	run->timed_out = TRUE;
+	g_main_loop_quit (run->loop);
+	return G_SOURCE_REMOVE;
+}
+
+/* the daemon counts every sqlite3_step, query and commit it makes */
+static gboolean
+cd_benchmark_get_sql_statements (GDBusConnection *connection,
+				 guint64 *statements,
+				 GError **error)
+{
+	const gchar *name;
+	GVariantIter iter;
+	guint64 count;
+	g_autoptr(GVariant) metrics = NULL;
+	g_autoptr(GVariant) reply = NULL;
+
+	reply = g_dbus_connection_call_sync (connection,
+					     COLORD_DBUS_SERVICE,
+					     COLORD_DBUS_PATH,
+					     COLORD_DBUS_INTERFACE,
+					     "GetMetrics",
+					     NULL,
+					     G_VARIANT_TYPE ("(a{s(tttat)})"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, error);
+	if (reply == NULL)
+		return FALSE;
+	metrics = g_variant_get_child_value (reply, 0);
+	g_variant_iter_init (&iter, metrics);
+	*statements = 0;
+	while (g_variant_iter_next (&iter, "{&s(tttat)}", &name, &count, NULL, NULL, NULL)) {
+		if (g_str_has_prefix (name, "sqlite."))
+			*statements += count;
+	}
+	return TRUE;
+}
+
+/* the high water mark of the resident set, in kB */
+static guint64
+cd_benchmark_get_peak_rss (const gchar *pid)
+{
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (pid == NULL)
+		return 0;
+	filename = g_strdup_printf ("/proc/%s/status", pid);
+	if (!g_file_get_contents (filename, &data, NULL, NULL))
+		return 0;
+	lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], "VmHWM:"))
+			return g_ascii_strtoull (lines[i] + 6, NULL, 10);
+	}
+	return 0;
+}
+
+static gboolean
+cd_benchmark_run_daemon (CdBenchmarkPriv *priv,
+			 GDBusConnection *connection,
+			 const gchar *bus_address,
+			 gboolean provision,
+			 CdBenchmarkRun *run,
+			 GError **error)
+{
+	guint signal_id;
+	guint timeout_id;
+	guint watch_id;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GPtrArray) argv = g_ptr_array_new ();
+	g_autoptr(GSubprocess) subprocess = NULL;
+	g_autoptr(GSubprocessLauncher) launcher = NULL;
+
+	run->loop = g_main_loop_new (NULL, FALSE);
+	run->n_profiles = priv->n_profiles;
+
+	/* subscribe before the process exists so nothing is missed */
+	signal_id = g_dbus_connection_signal_subscribe (connection,
+							NULL, NULL, NULL, NULL, NULL,
+							G_DBUS_SIGNAL_FLAGS_NONE,
+							cd_benchmark_signal_cb,
+							run, NULL);
+	watch_id = g_bus_watch_name_on_connection (connection,
+						   COLORD_DBUS_SERVICE,
+						   G_BUS_NAME_WATCHER_FLAGS_NONE,
+						   cd_benchmark_name_appeared_cb,
+						   NULL, run, NULL);
+	if (priv->n_profiles == 0)
+		run->time_profiles = G_MINDOUBLE;
+
+	g_ptr_array_add (argv, priv->daemon);
+	g_ptr_array_add (argv, "--root-dir");
+	g_ptr_array_add (argv, priv->root_dir);
+	if (provision) {
+		g_ptr_array_add (argv, "--provision");
+		g_ptr_array_add (argv, priv->provision_filename);
+	}
+	g_ptr_array_add (argv, NULL);
+	launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+	g_subprocess_launcher_setenv (launcher, "DBUS_SYSTEM_BUS_ADDRESS", bus_address, TRUE);
+	run->timer = g_timer_new ();
+	subprocess = g_subprocess_launcher_spawnv (launcher,
+						   (const gchar * const *) argv->pdata,
+						   error);
+	if (subprocess == NULL) {
+		g_dbus_connection_signal_unsubscribe (connection, signal_id);
+		g_bus_unwatch_name (watch_id);
+		return FALSE;
+	}
+
+	timeout_id = g_timeout_add_seconds (CD_BENCHMARK_TIMEOUT,
+					    cd_benchmark_timeout_cb, run);
+	g_main_loop_run (run->loop);
+	if (!run->timed_out)
+		g_source_remove (timeout_id);
+	g_dbus_connection_signal_unsubscribe (connection, signal_id);
+	g_bus_unwatch_name (watch_id);
+
+	/* sample before the daemon starts to shut down */
+	run->peak_rss = cd_benchmark_get_peak_rss (g_subprocess_get_identifier (subprocess));
+	if (!run->timed_out &&
+	    !cd_benchmark_get_sql_statements (connection, &run->sql_statements, &error_local))
+		g_warning ("failed to get metrics: %s", error_local->message);
+
+	g_subprocess_send_signal (subprocess, SIGTERM);
+	if (!g_subprocess_wait (subprocess, NULL, error))
+		return FALSE;
+	if (run->timed_out) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_TIMED_OUT,
+			     "startup did not complete in %us: %u/%u profiles",
+			     (guint) CD_BENCHMARK_TIMEOUT,
+			     run->profiles_added, run->n_profiles);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+cd_benchmark_run_clear (CdBenchmarkRun *run)
+{
+	if (run->loop != NULL)
+		g_main_loop_unref (run->loop);
+	if (run->timer != NULL)
+		g_timer_destroy (run->timer);
+}
+
+static void
+cd_benchmark_print_result (CdBenchmarkPriv *priv,
+			   const gchar *variant,
+			   CdBenchmarkRun *run,
+			   const gchar *error_msg)
+{
+	if (priv->json) {
+		g_autofree gchar *error_esc = NULL;
+		g_print ("%s\n  {\"name\": \"startup\", \"variant\": \"%s\", "
+			 "\"profiles\": %u, \"devices\": %u, \"mappings\": %u, "
+			 "\"time_name\": %.6f, \"time_profiles\": %.6f, "
+			 "\"time_complete\": %.6f, \"peak_rss_kb\": %" G_GUINT64_FORMAT ", "
+			 "\"sql_statements\": %" G_GUINT64_FORMAT ", \"signals\": %u",
+			 priv->first_result ? "" : ",",
+			 variant, priv->n_profiles, priv->n_devices, priv->n_mappings,
+			 run->time_name, run->time_profiles, run->time_complete,
+			 run->peak_rss, run->sql_statements, run->signals);
+		if (error_msg != NULL) {
+			error_esc = g_strescape (error_msg, NULL);
+			g_print (", \"error\": \"%s\"", error_esc);
+		}
+		g_print ("}");
+	} else {
+		g_print ("startup,%s,%u,%u,%u,%.6f,%.6f,%.6f,%" G_GUINT64_FORMAT ",%"
+			 G_GUINT64_FORMAT ",%u,%s\n",
+			 variant, priv->n_profiles, priv->n_devices, priv->n_mappings,
+			 run->time_name, run->time_profiles, run->time_complete,
+			 run->peak_rss, run->sql_statements, run->signals,
+			 error_msg != NULL ? error_msg : "");
+	}
+	priv->first_result = FALSE;
+}
+
+static gboolean
+cd_benchmark_rmtree (const gchar *path)
+{
+	const gchar *name;
+	g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+
+	if (dir != NULL) {
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			g_autofree gchar *fn = g_build_filename (path, name, NULL);
+			if (g_file_test (fn, G_FILE_TEST_IS_DIR) &&
+			    !g_file_test (fn, G_FILE_TEST_IS_SYMLINK)) {
+				cd_benchmark_rmtree (fn);
+			} else {
+				g_unlink (fn);
+			}
+		}
+	}
+	return g_rmdir (path) == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+	CdBenchmarkPriv priv = { 0 };
+	const gchar *bus_address;
+	const gchar *variants[] = { "cold", "warm", NULL };
+	gboolean json = FALSE;
+	gboolean keep = FALSE;
+	gint n_devices = 100;
+	gint n_mappings = -1;
+	gint n_profiles = 1000;
+	gint retval = EXIT_SUCCESS;
+	g_autofree gchar *daemon = NULL;
+	g_autofree gchar *lib_dir = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOptionContext) context = NULL;
+	g_autoptr(GTestDBus) bus = NULL;
+	const GOptionEntry options[] = {
+		{ "json", '\0', 0, G_OPTION_ARG_NONE, &json,
+		  "Output JSON rather than CSV", NULL },
+		{ "profiles", '\0', 0, G_OPTION_ARG_INT, &n_profiles,
+		  "Number of profiles to create", "N" },
+		{ "devices", '\0', 0, G_OPTION_ARG_INT, &n_devices,
+		  "Number of devices to create", "N" },
+		{ "mappings", '\0', 0, G_OPTION_ARG_INT, &n_mappings,
+		  "Number of device to profile mappings, default one per profile", "N" },
+		{ "daemon", '\0', 0, G_OPTION_ARG_FILENAME, &daemon,
+		  "The colord binary to start", "FILENAME" },
+		{ "keep", '\0', 0, G_OPTION_ARG_NONE, &keep,
+		  "Do not delete the synthetic root afterwards", NULL },
+		{ NULL }
+	};
+
+	setlocale (LC_ALL, "");
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context,
+				      "Measures how long the daemon takes to start");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse arguments: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	if (daemon == NULL) {
+		g_printerr ("No --daemon specified\n");
+		return EXIT_FAILURE;
+	}
+
+	/* the numbers are printed in the C locale */
+	setlocale (LC_NUMERIC, "C");
+
+	priv.json = json;
+	priv.first_result = TRUE;
+	priv.daemon = daemon;
+	priv.n_profiles = MAX (n_profiles, 0);
+	priv.n_devices = MAX (n_devices, 1);
+	priv.n_mappings = n_mappings < 0 ? priv.n_profiles : (guint) n_mappings;
+	priv.profile_ids = g_ptr_array_new_with_free_func (g_free);
+	priv.root_dir = g_dir_make_tmp ("colord-benchmark-XXXXXX", &error);
+	if (priv.root_dir == NULL) {
+		g_printerr ("%s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	lib_dir = g_build_filename (priv.root_dir, LOCALSTATEDIR, "lib", "colord", NULL);
+	if (!cd_benchmark_mkdir (lib_dir, &error) ||
+	    !cd_benchmark_create_profiles (&priv, &error) ||
+	    !cd_benchmark_create_provision (&priv, &error)) {
+		g_printerr ("failed to create data: %s\n", error->message);
+		retval = EXIT_FAILURE;
+		goto out;
+	}
+
+	/* a private bus, so the real daemon is not disturbed */
+	bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+	g_test_dbus_up (bus);
+	bus_address = g_test_dbus_get_bus_address (bus);
+	connection = g_dbus_connection_new_for_address_sync (bus_address,
+							     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+							     G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+							     NULL, NULL, &error);
+	if (connection == NULL) {
+		g_printerr ("failed to connect to %s: %s\n", bus_address, error->message);
+		retval = EXIT_FAILURE;
+		goto out;
+	}
+
+	if (priv.json)
+		g_print ("[");
+	else
+		g_print ("name,variant,profiles,devices,mappings,time_name,"
+			 "time_profiles,time_complete,peak_rss_kb,sql_statements,"
+			 "signals,error\n");
+
+	/* the first run writes the databases and the caches, the second
+	 * is what every boot after that looks like */
+	for (guint i = 0; variants[i] != NULL; i++) {
+		CdBenchmarkRun run = { 0 };
+		g_autoptr(GError) error_local = NULL;
+		if (!cd_benchmark_run_daemon (&priv, connection, bus_address,
+					      i == 0, &run, &error_local)) {
+			cd_benchmark_print_result (&priv, variants[i], &run,
+						   error_local->message);
+			retval = EXIT_FAILURE;
+		} else {
+			cd_benchmark_print_result (&priv, variants[i], &run, NULL);
+		}
+		cd_benchmark_run_clear (&run);
+	}
+	if (priv.json)
+		g_print ("\n]\n");
+
+	g_dbus_connection_close_sync (connection, NULL, NULL);
+	g_test_dbus_down (bus);
+out:
+	if (keep)
+		g_printerr ("synthetic data kept in %s\n", priv.root_dir);
+	else
+		cd_benchmark_rmtree (priv.root_dir);
+	g_free (priv.root_dir);
+	g_free (priv.provision_filename);
+	g_ptr_array_unref (priv.profile_ids);
+	return retval;
+}
@@ -25,6 +25,8 @@
 #include <polkit/polkit.h>
 
 #include "cd-common.h"
+#include "cd-metrics.h"
+#include "cd-trace-private.h"
 
 #if !defined(POLKIT_HAS_AUTOPTR_MACROS)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PolkitAuthorizationResult, g_object_unref)
@@ -61,30 +63,591 @@ cd_main_ensure_dbus_path (const gchar *object_path)
 	return object_path_tmp;
 }
 
-guint
-cd_main_get_sender_uid (GDBusConnection *connection,
-			const gchar *sender,
-			GError **error)
+/* bumped whenever a device or profile is added, removed or changed */
+static guint64 cd_object_generation = 1;
+G_LOCK_DEFINE_STATIC (cd_object_generation);
+
+/* also read from the bus worker thread */
+guint64
+cd_object_generation_get (void)
+{
+	guint64 generation;
+	G_LOCK (cd_object_generation);
+	generation = cd_object_generation;
+	G_UNLOCK (cd_object_generation);
+	return generation;
+}
+
+void
+cd_object_generation_bump (void)
+{
+	G_LOCK (cd_object_generation);
+	cd_object_generation++;
+	G_UNLOCK (cd_object_generation);
+}
+
+/* nonzero while a method call is being handled; property changes made
+ * then are sent before the reply so the caller sees them in order */
+static guint cd_object_dispatch_depth = 0;
+
+void
+cd_object_dispatch_push (void)
+{
+	cd_object_dispatch_depth++;
+}
+
+void
+cd_object_dispatch_pop (void)
+{
+	g_return_if_fail (cd_object_dispatch_depth > 0);
+	cd_object_dispatch_depth--;
+}
+
+gboolean
+cd_object_dispatch_active (void)
+{
+	return cd_object_dispatch_depth > 0;
+}
+
+/* sql : sqlite3_stmt, keyed by the SQL text */
+GHashTable *
+cd_sqlite_statements_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal,
+				      NULL, (GDestroyNotify) sqlite3_finalize);
+}
+
+/*
+ * Gets a compiled statement for @sql, parsing and planning it only on the
+ * first use. The statement is reset with no bindings, and @sql must be a
+ * static string as it is used as the key.
+ */
+sqlite3_stmt *
+cd_sqlite_prepare (sqlite3 *db,
+		   GHashTable *statements,
+		   const gchar *sql,
+		   GError **error)
+{
+	sqlite3_stmt *stmt;
+	gint rc;
+
+	stmt = g_hash_table_lookup (statements, sql);
+	if (stmt != NULL) {
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
+		return stmt;
+	}
+	rc = sqlite3_prepare_v3 (db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db));
+		return NULL;
+	}
+	g_hash_table_insert (statements, (gpointer) sql, stmt);
+	return stmt;
+}
+
+/* runs a statement that returns no rows */
+gboolean
+cd_sqlite_step (sqlite3 *db, sqlite3_stmt *stmt, GError **error)
+{
+	gint rc;
+	gint64 start = g_get_monotonic_time ();
+
+	CD_TRACE1 (sqlite_step_begin, sqlite3_sql (stmt));
+	rc = sqlite3_step (stmt);
+	CD_TRACE2 (sqlite_step_end, sqlite3_sql (stmt), rc);
+	cd_metrics_add ("sqlite.step", start);
+	if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db));
+		sqlite3_reset (stmt);
+		return FALSE;
+	}
+	sqlite3_reset (stmt);
+	return TRUE;
+}
+
+/* runs a statement, returning the first column of every row */
+GPtrArray *
+cd_sqlite_get_strings (sqlite3 *db, sqlite3_stmt *stmt, GError **error)
+{
+	gint rc;
+	gint64 start = g_get_monotonic_time ();
+	g_autoptr(GPtrArray) array = g_ptr_array_new_with_free_func (g_free);
+
+	CD_TRACE1 (sqlite_query_begin, sqlite3_sql (stmt));
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+		g_ptr_array_add (array, g_strdup ((const gchar *) sqlite3_column_text (stmt, 0)));
+	CD_TRACE2 (sqlite_query_end, sqlite3_sql (stmt), rc);
+	cd_metrics_add ("sqlite.query", start);
+	if (rc != SQLITE_DONE) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db));
+		sqlite3_reset (stmt);
+		return NULL;
+	}
+	sqlite3_reset (stmt);
+	return g_steal_pointer (&array);
+}
+
+/*
+ * Opens a write transaction if one is not already pending, and schedules
+ * @func to commit it after CD_SQLITE_BATCH_TIMEOUT. Writes made in the
+ * meantime are coalesced into the same transaction.
+ */
+gboolean
+cd_sqlite_batch_begin (sqlite3 *db,
+		       guint *commit_id,
+		       GSourceFunc func,
+		       gpointer user_data,
+		       GError **error)
+{
+	gint rc;
+
+	if (*commit_id != 0)
+		return TRUE;
+
+	/* a failed commit leaves its transaction open to be retried */
+	if (!sqlite3_get_autocommit (db)) {
+		*commit_id = g_timeout_add (CD_SQLITE_BATCH_TIMEOUT, func, user_data);
+		g_source_set_name_by_id (*commit_id, "[CdSqlite] commit");
+		return TRUE;
+	}
+	rc = sqlite3_exec (db, "BEGIN;", NULL, NULL, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db));
+		return FALSE;
+	}
+	*commit_id = g_timeout_add (CD_SQLITE_BATCH_TIMEOUT, func, user_data);
+	g_source_set_name_by_id (*commit_id, "[CdSqlite] commit");
+	return TRUE;
+}
+
+/*
+ * Commits the pending write transaction, if any. On failure the writes are
+ * kept in the open transaction and the commit timer keeps running, so the
+ * commit is tried again rather than the writes being lost.
+ */
+gboolean
+cd_sqlite_batch_commit (sqlite3 *db, guint *commit_id, GError **error)
+{
+	gint rc;
+	gint64 start;
+
+	if (*commit_id == 0)
+		return TRUE;
+	start = g_get_monotonic_time ();
+	CD_TRACE1 (sqlite_commit_begin, sqlite3_db_filename (db, "main"));
+	rc = sqlite3_exec (db, "COMMIT;", NULL, NULL, NULL);
+	CD_TRACE2 (sqlite_commit_end, sqlite3_db_filename (db, "main"), rc);
+	cd_metrics_add ("sqlite.commit", start);
+	if (rc != SQLITE_OK) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db));
+		return FALSE;
+	}
+	g_source_remove (*commit_id);
+	*commit_id = 0;
+	return TRUE;
+}
+
+/* discards the pending write transaction, if any */
+void
+cd_sqlite_batch_rollback (sqlite3 *db, guint *commit_id)
+{
+	if (*commit_id != 0) {
+		g_source_remove (*commit_id);
+		*commit_id = 0;
+	}
+	if (!sqlite3_get_autocommit (db))
+		sqlite3_exec (db, "ROLLBACK;", NULL, NULL, NULL);
+}
+
+/*
+ * Splits @qualifier like "RGB.Plain.300dpi" into atoms, with 0 for a missing
+ * part. Profiles intern their qualifiers; queries come from any caller so
+ * are only looked up, and strings nobody interned become UNKNOWN.
+ */
+void
+cd_qualifier_to_atoms (const gchar *qualifier, gboolean intern, GQuark *atoms)
+{
+	guint i;
+	g_auto(GStrv) split = NULL;
+
+	/* so a wildcard query is never UNKNOWN */
+	g_quark_from_static_string ("*");
+
+	split = g_strsplit (qualifier, ".", CD_QUALIFIER_ATOMS_MAX);
+	for (i = 0; i < CD_QUALIFIER_ATOMS_MAX && split[i] != NULL; i++) {
+		if (intern) {
+			atoms[i] = g_quark_from_string (split[i]);
+			continue;
+		}
+		atoms[i] = g_quark_try_string (split[i]);
+		if (atoms[i] == 0)
+			atoms[i] = CD_QUALIFIER_ATOM_UNKNOWN;
+	}
+	for (; i < CD_QUALIFIER_ATOMS_MAX; i++)
+		atoms[i] = 0;
+}
+
+gboolean
+cd_qualifier_atoms_match (const GQuark *query, const GQuark *qualifier)
+{
+	GQuark wildcard = g_quark_from_static_string ("*");
+
+	/* ensure all substrings match */
+	for (guint i = 0; i < CD_QUALIFIER_ATOMS_MAX; i++) {
+		if (query[i] == wildcard || qualifier[i] == wildcard)
+			continue;
+		if (query[i] == qualifier[i] && query[i] != CD_QUALIFIER_ATOM_UNKNOWN)
+			continue;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Returns a refcounted copy of @str from the daemon-wide pool, so the same
+ * metadata key or value held by many devices and profiles is stored once.
+ * Free with cd_string_pool_release().
+ */
+gchar *
+cd_string_pool_intern (const gchar *str)
+{
+	if (str == NULL)
+		return NULL;
+	return g_ref_string_new_intern (str);
+}
+
+void
+cd_string_pool_release (gpointer str)
+{
+	if (str == NULL)
+		return;
+	g_ref_string_release (str);
+}
+
+/* how long a polkit decision is reused for the same sender and action */
+#define CD_MAIN_AUTH_CACHE_TIMEOUT	5	/* s */
+
+/* the name of the data set on an invocation with the polkit decision */
+#define CD_MAIN_AUTH_DECISION_KEY	"cd-main-auth-decision"
+
+/* the name of the data set on an invocation once credentials were fetched */
+#define CD_MAIN_CREDENTIALS_KEY		"cd-main-credentials"
+
+typedef enum {
+	CD_MAIN_AUTH_UNKNOWN,
+	CD_MAIN_AUTH_ALLOWED,
+	CD_MAIN_AUTH_DENIED
+} CdMainAuth;
+
+typedef struct {
+	gboolean		 authorized;
+	gint64			 expires;	/* monotonic, us */
+} CdMainAuthCacheItem;
+
+typedef struct {
+	gchar			*action_id;
+	GError			*error;		/* NULL if authorized */
+} CdMainAuthDecision;
+
+typedef struct {
+	GDBusMethodInvocation	*invocation;
+	GDBusInterfaceMethodCallFunc method_call;
+	GObject			*owner;
+	gchar			*action_id;	/* NULL for credentials */
+} CdMainDispatchHelper;
+
+/* all keyed by the unique name of the sender, which is never reused */
+static GHashTable	*cd_main_auth_cache = NULL;	/* "sender\x1faction" */
+static GHashTable	*cd_main_credentials_cache = NULL;	/* sender */
+static PolkitAuthority	*cd_main_authority = NULL;
+G_LOCK_DEFINE_STATIC (cd_main_auth_cache);
+
+static void
+cd_main_auth_cache_invalidate (const gchar *sender)
+{
+	GHashTableIter iter;
+	const gchar *key;
+	gsize len = strlen (sender);
+
+	G_LOCK (cd_main_auth_cache);
+	g_hash_table_remove (cd_main_credentials_cache, sender);
+	g_hash_table_iter_init (&iter, cd_main_auth_cache);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL)) {
+		if (strncmp (key, sender, len) == 0 && key[len] == '\x1f')
+			g_hash_table_iter_remove (&iter);
+	}
+	G_UNLOCK (cd_main_auth_cache);
+}
+
+static void
+cd_main_auth_cache_name_owner_changed_cb (GDBusConnection *connection,
+					  const gchar *sender_name,
+					  const gchar *object_path,
+					  const gchar *interface_name,
+					  const gchar *signal_name,
+					  GVariant *parameters,
+					  gpointer user_data)
+{
+	const gchar *name;
+	const gchar *old_owner;
+	const gchar *new_owner;
+
+	/* only unique names that have left the bus */
+	g_variant_get (parameters, "(&s&s&s)", &name, &old_owner, &new_owner);
+	if (name[0] != ':' || new_owner[0] != '\0')
+		return;
+	cd_main_auth_cache_invalidate (name);
+}
+
+/* nothing can be cached until we know when the sender goes away */
+static void
+cd_main_auth_cache_ensure (GDBusConnection *connection)
+{
+	G_LOCK (cd_main_auth_cache);
+	if (cd_main_auth_cache != NULL) {
+		G_UNLOCK (cd_main_auth_cache);
+		return;
+	}
+	cd_main_auth_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, g_free);
+	cd_main_credentials_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+							   (GDestroyNotify) cd_main_credentials_unref);
+	G_UNLOCK (cd_main_auth_cache);
+	g_dbus_connection_signal_subscribe (connection,
+					    "org.freedesktop.DBus",
+					    "org.freedesktop.DBus",
+					    "NameOwnerChanged",
+					    "/org/freedesktop/DBus",
+					    NULL,
+					    G_DBUS_SIGNAL_FLAGS_NONE,
+					    cd_main_auth_cache_name_owner_changed_cb,
+					    NULL, NULL);
+}
+
+static gboolean
+cd_main_auth_cache_lookup (const gchar *sender,
+			   const gchar *action_id,
+			   gboolean *authorized)
+{
+	CdMainAuthCacheItem *item;
+	gboolean ret = FALSE;
+	g_autofree gchar *key = g_strdup_printf ("%s\x1f%s", sender, action_id);
+
+	G_LOCK (cd_main_auth_cache);
+	item = g_hash_table_lookup (cd_main_auth_cache, key);
+	if (item != NULL) {
+		if (item->expires > g_get_monotonic_time ()) {
+			*authorized = item->authorized;
+			ret = TRUE;
+		} else {
+			g_hash_table_remove (cd_main_auth_cache, key);
+		}
+	}
+	G_UNLOCK (cd_main_auth_cache);
+	return ret;
+}
+
+static void
+cd_main_auth_cache_add (const gchar *sender,
+			const gchar *action_id,
+			PolkitAuthorizationResult *result)
+{
+	CdMainAuthCacheItem *item;
+
+	/* the user may well try again and mean it this time */
+	if (polkit_authorization_result_get_dismissed (result))
+		return;
+
+	item = g_new0 (CdMainAuthCacheItem, 1);
+	item->authorized = polkit_authorization_result_get_is_authorized (result);
+	item->expires = g_get_monotonic_time () +
+			CD_MAIN_AUTH_CACHE_TIMEOUT * G_USEC_PER_SEC;
+	G_LOCK (cd_main_auth_cache);
+	g_hash_table_insert (cd_main_auth_cache,
+			     g_strdup_printf ("%s\x1f%s", sender, action_id),
+			     item);
+	G_UNLOCK (cd_main_auth_cache);
+}
+
+static void
+cd_main_authority_changed_cb (PolkitAuthority *authority, gpointer user_data)
 {
-	guint uid = G_MAXUINT;
+	/* the policy or the sessions changed, so ask again */
+	G_LOCK (cd_main_auth_cache);
+	g_hash_table_remove_all (cd_main_auth_cache);
+	G_UNLOCK (cd_main_auth_cache);
+}
+
+static PolkitAuthority *
+cd_main_get_authority (GError **error)
+{
+	g_autoptr(GError) error_local = NULL;
+
+	if (cd_main_authority != NULL)
+		return cd_main_authority;
+	cd_main_authority = polkit_authority_get_sync (NULL, &error_local);
+	if (cd_main_authority == NULL) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_FAILED_TO_AUTHENTICATE,
+			     "failed to get polkit authorit: %s",
+			     error_local->message);
+		return NULL;
+	}
+	g_signal_connect (cd_main_authority, "changed",
+			  G_CALLBACK (cd_main_authority_changed_cb), NULL);
+	return cd_main_authority;
+}
+
+CdMainCredentials *
+cd_main_credentials_ref (CdMainCredentials *credentials)
+{
+	g_atomic_int_inc (&credentials->refcount);
+	return credentials;
+}
+
+void
+cd_main_credentials_unref (CdMainCredentials *credentials)
+{
+	if (!g_atomic_int_dec_and_test (&credentials->refcount))
+		return;
+	g_free (credentials->seat);
+	g_free (credentials->cmdline);
+	g_free (credentials);
+}
+
+/* parses the reply from GetConnectionCredentials */
+static CdMainCredentials *
+cd_main_credentials_new_from_variant (GVariant *value)
+{
+	CdMainCredentials *credentials;
+	g_autoptr(GVariant) dict = NULL;
+
+	credentials = g_new0 (CdMainCredentials, 1);
+	credentials->refcount = 1;
+	credentials->uid = G_MAXUINT;
+	credentials->pid = G_MAXUINT;
+	dict = g_variant_get_child_value (value, 0);
+	g_variant_lookup (dict, "UnixUserID", "u", &credentials->uid);
+	g_variant_lookup (dict, "ProcessID", "u", &credentials->pid);
+	return credentials;
+}
+
+static CdMainCredentials *
+cd_main_credentials_cache_lookup (const gchar *sender)
+{
+	CdMainCredentials *credentials;
+
+	G_LOCK (cd_main_auth_cache);
+	credentials = g_hash_table_lookup (cd_main_credentials_cache, sender);
+	if (credentials != NULL)
+		cd_main_credentials_ref (credentials);
+	G_UNLOCK (cd_main_auth_cache);
+	return credentials;
+}
+
+/* only what is already cached, so it never blocks on the bus daemon */
+CdMainCredentials *
+cd_main_peek_sender_credentials (const gchar *sender)
+{
+	CdMainCredentials *credentials = NULL;
+
+	if (sender == NULL)
+		return NULL;
+	G_LOCK (cd_main_auth_cache);
+	if (cd_main_credentials_cache != NULL)
+		credentials = g_hash_table_lookup (cd_main_credentials_cache, sender);
+	if (credentials != NULL)
+		cd_main_credentials_ref (credentials);
+	G_UNLOCK (cd_main_auth_cache);
+	return credentials;
+}
+
+static void
+cd_main_credentials_cache_add (const gchar *sender, CdMainCredentials *credentials)
+{
+	/* only unique names are guaranteed to keep the same owner */
+	if (sender == NULL || sender[0] != ':')
+		return;
+	G_LOCK (cd_main_auth_cache);
+	g_hash_table_insert (cd_main_credentials_cache,
+			     g_strdup (sender),
+			     cd_main_credentials_ref (credentials));
+	G_UNLOCK (cd_main_auth_cache);
+}
+
+CdMainCredentials *
+cd_main_get_sender_credentials (GDBusConnection *connection,
+				const gchar *sender,
+				GError **error)
+{
+	CdMainCredentials *credentials;
 	g_autoptr(GVariant) value = NULL;
 
-	/* call into DBus to get the user ID that issued the request */
+	/* already asked */
+	cd_main_auth_cache_ensure (connection);
+	credentials = cd_main_credentials_cache_lookup (sender);
+	if (credentials != NULL)
+		return credentials;
+
+	/* call into DBus to get the user and process that issued the request */
 	value = g_dbus_connection_call_sync (connection,
 					     "org.freedesktop.DBus",
 					     "/org/freedesktop/DBus",
 					     "org.freedesktop.DBus",
-					     "GetConnectionUnixUser",
+					     "GetConnectionCredentials",
 					     g_variant_new ("(s)",
 							    sender),
-					     NULL,
+					     G_VARIANT_TYPE ("(a{sv})"),
 					     G_DBUS_CALL_FLAGS_NONE,
 					     200,
 					     NULL,
 					     error);
-	if (value != NULL)
-		g_variant_get (value, "(u)", &uid);
-	return uid;
+	if (value == NULL)
+		return NULL;
+	credentials = cd_main_credentials_new_from_variant (value);
+	cd_main_credentials_cache_add (sender, credentials);
+	return credentials;
+}
+
+guint
+cd_main_get_sender_uid (GDBusConnection *connection,
+			const gchar *sender,
+			GError **error)
+{
+	g_autoptr(CdMainCredentials) credentials = NULL;
+
+	credentials = cd_main_get_sender_credentials (connection, sender, error);
+	if (credentials == NULL)
+		return G_MAXUINT;
+	if (credentials->uid == G_MAXUINT) {
+		g_set_error (error,
+			     G_DBUS_ERROR,
+			     G_DBUS_ERROR_FAILED,
+			     "no user ID for %s", sender);
+	}
+	return credentials->uid;
 }
 
 guint
@@ -92,38 +655,30 @@ cd_main_get_sender_pid (GDBusConnection *connection,
 			const gchar *sender,
 			GError **error)
 {
-	guint pid = G_MAXUINT;
-	g_autoptr(GVariant) value = NULL;
+	g_autoptr(CdMainCredentials) credentials = NULL;
 
-	/* call into DBus to get the user ID that issued the request */
-	value = g_dbus_connection_call_sync (connection,
-					     "org.freedesktop.DBus",
-					     "/org/freedesktop/DBus",
-					     "org.freedesktop.DBus",
-					     "GetConnectionUnixProcessID",
-					     g_variant_new ("(s)",
-							    sender),
-					     NULL,
-					     G_DBUS_CALL_FLAGS_NONE,
-					     200,
-					     NULL,
-					     error);
-	if (value != NULL)
-		g_variant_get (value, "(u)", &pid);
-	return pid;
+	credentials = cd_main_get_sender_credentials (connection, sender, error);
+	if (credentials == NULL)
+		return G_MAXUINT;
+	if (credentials->pid == G_MAXUINT) {
+		g_set_error (error,
+			     G_DBUS_ERROR,
+			     G_DBUS_ERROR_FAILED,
+			     "no process ID for %s", sender);
+	}
+	return credentials->pid;
 }
 
-gboolean
-cd_main_sender_authenticated (GDBusConnection *connection,
+/* decide without asking polkit if possible */
+static CdMainAuth
+cd_main_sender_auth_precheck (GDBusConnection *connection,
 			      const gchar *sender,
 			      const gchar *action_id,
 			      GError **error)
 {
+	gboolean authorized = FALSE;
 	guint uid;
 	g_autoptr(GError) error_local = NULL;
-	g_autoptr(PolkitAuthority) authority = NULL;
-	g_autoptr(PolkitAuthorizationResult) result = NULL;
-	g_autoptr(PolkitSubject) subject = NULL;
 
 	/* uid 0 is allowed to do all actions */
 	uid = cd_main_get_sender_uid (connection, sender, &error_local);
@@ -134,14 +689,14 @@ cd_main_sender_authenticated (GDBusConnection *connection,
 			     "could not get uid to authenticate %s: %s",
 			     action_id,
 			     error_local->message);
-		return FALSE;
+		return CD_MAIN_AUTH_DENIED;
 	}
 
 	/* the root user can always do all actions */
 	if (uid == 0) {
 		g_debug ("CdCommon: not checking %s for %s as uid 0",
 			 action_id, sender);
-		return TRUE;
+		return CD_MAIN_AUTH_ALLOWED;
 	}
 
 #ifdef HAVE_GETUID
@@ -149,29 +704,32 @@ cd_main_sender_authenticated (GDBusConnection *connection,
 	if (uid == getuid ()) {
 		g_debug ("CdCommon: not checking %s for %s as running as daemon user",
 			 action_id, sender);
-		return TRUE;
+		return CD_MAIN_AUTH_ALLOWED;
 	}
 #endif
 
-	/* get authority */
-	authority = polkit_authority_get_sync (NULL, &error_local);
-	if (authority == NULL) {
+	/* polkit answered recently */
+	if (!cd_main_auth_cache_lookup (sender, action_id, &authorized))
+		return CD_MAIN_AUTH_UNKNOWN;
+	g_debug ("CdCommon: using cached %s for %s", action_id, sender);
+	if (!authorized) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
 			     CD_CLIENT_ERROR_FAILED_TO_AUTHENTICATE,
-			     "failed to get polkit authorit: %s",
-			     error_local->message);
-		return FALSE;
+			     "failed to obtain %s auth",
+			     action_id);
+		return CD_MAIN_AUTH_DENIED;
 	}
+	return CD_MAIN_AUTH_ALLOWED;
+}
 
-	/* do authorization async */
-	subject = polkit_system_bus_name_new (sender);
-	result = polkit_authority_check_authorization_sync (authority, subject,
-			action_id,
-			NULL,
-			POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
-			NULL,
-			&error_local);
+static gboolean
+cd_main_sender_auth_result (const gchar *sender,
+			    const gchar *action_id,
+			    PolkitAuthorizationResult *result,
+			    const GError *error_local,
+			    GError **error)
+{
 	if (result == NULL) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
@@ -181,6 +739,7 @@ cd_main_sender_authenticated (GDBusConnection *connection,
 			     error_local->message);
 		return FALSE;
 	}
+	cd_main_auth_cache_add (sender, action_id, result);
 
 	/* did not auth */
 	if (!polkit_authorization_result_get_is_authorized (result)) {
@@ -194,6 +753,248 @@ cd_main_sender_authenticated (GDBusConnection *connection,
 	return TRUE;
 }
 
+gboolean
+cd_main_sender_authenticated (GDBusConnection *connection,
+			      const gchar *sender,
+			      const gchar *action_id,
+			      GError **error)
+{
+	PolkitAuthority *authority;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	switch (cd_main_sender_auth_precheck (connection, sender, action_id, error)) {
+	case CD_MAIN_AUTH_ALLOWED:
+		return TRUE;
+	case CD_MAIN_AUTH_DENIED:
+		return FALSE;
+	default:
+		break;
+	}
+
+	/* get authority */
+	authority = cd_main_get_authority (error);
+	if (authority == NULL)
+		return FALSE;
+
+	/* do authorization */
+	subject = polkit_system_bus_name_new (sender);
+	result = polkit_authority_check_authorization_sync (authority, subject,
+			action_id,
+			NULL,
+			POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+			NULL,
+			&error_local);
+	return cd_main_sender_auth_result (sender, action_id, result,
+					   error_local, error);
+}
+
+static void
+cd_main_auth_decision_free (CdMainAuthDecision *decision)
+{
+	if (decision->error != NULL)
+		g_error_free (decision->error);
+	g_free (decision->action_id);
+	g_free (decision);
+}
+
+static void
+cd_main_dispatch_helper_free (CdMainDispatchHelper *helper)
+{
+	if (helper->owner != NULL)
+		g_object_unref (helper->owner);
+	g_free (helper->action_id);
+	g_free (helper);
+}
+
+/* calls the method handler again with the same invocation */
+static void
+cd_main_dispatch_helper_redispatch (CdMainDispatchHelper *helper)
+{
+	GDBusMethodInvocation *invocation = helper->invocation;
+	helper->method_call (g_dbus_method_invocation_get_connection (invocation),
+			     g_dbus_method_invocation_get_sender (invocation),
+			     g_dbus_method_invocation_get_object_path (invocation),
+			     g_dbus_method_invocation_get_interface_name (invocation),
+			     g_dbus_method_invocation_get_method_name (invocation),
+			     g_dbus_method_invocation_get_parameters (invocation),
+			     invocation,
+			     g_dbus_method_invocation_get_user_data (invocation));
+	cd_main_dispatch_helper_free (helper);
+}
+
+static void
+cd_main_invocation_ensure_credentials_cb (GObject *source,
+					  GAsyncResult *res,
+					  gpointer user_data)
+{
+	CdMainDispatchHelper *helper = (CdMainDispatchHelper *) user_data;
+	GDBusMethodInvocation *invocation = helper->invocation;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* on failure the synchronous fallback reports the error */
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (value != NULL) {
+		g_autoptr(CdMainCredentials) credentials = NULL;
+		credentials = cd_main_credentials_new_from_variant (value);
+		cd_main_credentials_cache_add (g_dbus_method_invocation_get_sender (invocation),
+					       credentials);
+	} else {
+		g_debug ("CdCommon: failed to get credentials: %s", error->message);
+	}
+	g_object_set_data (G_OBJECT (invocation),
+			   CD_MAIN_CREDENTIALS_KEY,
+			   GINT_TO_POINTER (TRUE));
+	cd_main_dispatch_helper_redispatch (helper);
+}
+
+/*
+ * Makes sure the credentials of the sender are cached without blocking
+ * the daemon. If this returns %FALSE the caller must return without
+ * using @invocation, and @method_call is called again with the same
+ * @invocation once the bus daemon has replied.
+ */
+gboolean
+cd_main_invocation_ensure_credentials (GDBusMethodInvocation *invocation,
+				       GDBusInterfaceMethodCallFunc method_call,
+				       GObject *owner)
+{
+	CdMainDispatchHelper *helper;
+	GDBusConnection *connection = g_dbus_method_invocation_get_connection (invocation);
+	const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+	g_autoptr(CdMainCredentials) credentials = NULL;
+
+	/* not worth caching, or already tried */
+	if (sender == NULL || sender[0] != ':')
+		return TRUE;
+	if (g_object_get_data (G_OBJECT (invocation), CD_MAIN_CREDENTIALS_KEY) != NULL)
+		return TRUE;
+	cd_main_auth_cache_ensure (connection);
+	credentials = cd_main_credentials_cache_lookup (sender);
+	if (credentials != NULL)
+		return TRUE;
+
+	helper = g_new0 (CdMainDispatchHelper, 1);
+	helper->invocation = invocation;
+	helper->method_call = method_call;
+	helper->owner = owner != NULL ? g_object_ref (owner) : NULL;
+	g_dbus_connection_call (connection,
+				"org.freedesktop.DBus",
+				"/org/freedesktop/DBus",
+				"org.freedesktop.DBus",
+				"GetConnectionCredentials",
+				g_variant_new ("(s)", sender),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				200,
+				NULL,
+				cd_main_invocation_ensure_credentials_cb,
+				helper);
+	return FALSE;
+}
+
+static void
+cd_main_invocation_authenticated_cb (GObject *source,
+				     GAsyncResult *res,
+				     gpointer user_data)
+{
+	CdMainDispatchHelper *helper = (CdMainDispatchHelper *) user_data;
+	CdMainAuthDecision *decision;
+	GDBusMethodInvocation *invocation = helper->invocation;
+	const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
+
+	/* save the answer on the invocation */
+	result = polkit_authority_check_authorization_finish (POLKIT_AUTHORITY (source),
+							      res, &error_local);
+	decision = g_new0 (CdMainAuthDecision, 1);
+	decision->action_id = g_strdup (helper->action_id);
+	cd_main_sender_auth_result (sender, helper->action_id, result,
+				    error_local, &decision->error);
+	g_object_set_data_full (G_OBJECT (invocation),
+				CD_MAIN_AUTH_DECISION_KEY,
+				decision,
+				(GDestroyNotify) cd_main_auth_decision_free);
+
+	/* dispatch the method again, which now picks up the decision */
+	cd_main_dispatch_helper_redispatch (helper);
+}
+
+/*
+ * Like cd_main_sender_authenticated() but without blocking the daemon
+ * while polkit decides. If the answer is not already known this returns
+ * %FALSE *without* setting @error, and the caller must return without
+ * using @invocation. When polkit has answered, @method_call is called
+ * again with the same @invocation and this then returns the decision.
+ * @owner is kept alive while waiting, e.g. the user data of @method_call.
+ */
+gboolean
+cd_main_invocation_authenticated (GDBusMethodInvocation *invocation,
+				  const gchar *action_id,
+				  GDBusInterfaceMethodCallFunc method_call,
+				  GObject *owner,
+				  GError **error)
+{
+	CdMainAuthDecision *decision;
+	CdMainDispatchHelper *helper;
+	GDBusConnection *connection = g_dbus_method_invocation_get_connection (invocation);
+	PolkitAuthority *authority;
+	const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	/* dispatched again with the answer from polkit */
+	decision = g_object_steal_data (G_OBJECT (invocation),
+					CD_MAIN_AUTH_DECISION_KEY);
+	if (decision != NULL &&
+	    g_strcmp0 (decision->action_id, action_id) == 0) {
+		gboolean ret = decision->error == NULL;
+		if (!ret)
+			g_propagate_error (error, g_steal_pointer (&decision->error));
+		cd_main_auth_decision_free (decision);
+		return ret;
+	}
+	if (decision != NULL)
+		cd_main_auth_decision_free (decision);
+
+	/* the uid is needed first */
+	if (!cd_main_invocation_ensure_credentials (invocation, method_call, owner))
+		return FALSE;
+
+	switch (cd_main_sender_auth_precheck (connection, sender, action_id, error)) {
+	case CD_MAIN_AUTH_ALLOWED:
+		return TRUE;
+	case CD_MAIN_AUTH_DENIED:
+		return FALSE;
+	default:
+		break;
+	}
+
+	/* get authority */
+	authority = cd_main_get_authority (error);
+	if (authority == NULL)
+		return FALSE;
+
+	/* ask polkit and carry on with other requests */
+	g_debug ("CdCommon: checking %s for %s", action_id, sender);
+	helper = g_new0 (CdMainDispatchHelper, 1);
+	helper->invocation = invocation;
+	helper->method_call = method_call;
+	helper->owner = owner != NULL ? g_object_ref (owner) : NULL;
+	helper->action_id = g_strdup (action_id);
+	subject = polkit_system_bus_name_new (sender);
+	polkit_authority_check_authorization (authority, subject,
+			action_id,
+			NULL,
+			POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION,
+			NULL,
+			cd_main_invocation_authenticated_cb,
+			helper);
+	return FALSE;
+}
+
 
 gboolean
 cd_main_mkdir_with_parents (const gchar *filename, GError **error)
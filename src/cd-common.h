@@ -40,12 +40,47 @@
 
 #define CD_CLIENT_ERROR			cd_client_error_quark()
 
+/* how long writes are batched before being committed */
+#define CD_SQLITE_BATCH_TIMEOUT		100	/* ms */
+
+/* a qualifier is 'colorspace.format.resolution', each part an atom */
+#define CD_QUALIFIER_ATOMS_MAX		3
+#define CD_QUALIFIER_ATOM_UNKNOWN	G_MAXUINT32	/* never interned */
+
+/* what the bus daemon knows about a sender, cached until it leaves */
+typedef struct {
+	guint			 uid;
+	guint			 pid;
+	gchar			*seat;		/* set by the daemon */
+	gboolean		 seat_valid;
+	gchar			*cmdline;	/* set by the daemon */
+	gboolean		 cmdline_valid;
+	gint			 refcount;
+} CdMainCredentials;
+
 GQuark		 cd_client_error_quark		(void);
 gboolean	 cd_main_sender_authenticated	(GDBusConnection *connection,
 						 const gchar	*sender,
 						 const gchar	*action_id,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_main_invocation_authenticated (GDBusMethodInvocation *invocation,
+						 const gchar	*action_id,
+						 GDBusInterfaceMethodCallFunc method_call,
+						 GObject	*owner,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+CdMainCredentials *cd_main_get_sender_credentials (GDBusConnection *connection,
+						 const gchar	*sender,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+CdMainCredentials *cd_main_peek_sender_credentials (const gchar	*sender);
+CdMainCredentials *cd_main_credentials_ref	(CdMainCredentials *credentials);
+void		 cd_main_credentials_unref	(CdMainCredentials *credentials);
+gboolean	 cd_main_invocation_ensure_credentials (GDBusMethodInvocation *invocation,
+						 GDBusInterfaceMethodCallFunc method_call,
+						 GObject	*owner)
+						 G_GNUC_WARN_UNUSED_RESULT;
 guint		 cd_main_get_sender_uid		(GDBusConnection *connection,
 						 const gchar	*sender,
 						 GError		**error)
@@ -58,6 +93,44 @@ gchar		*cd_main_ensure_dbus_path	(const gchar	*object_path);
 gboolean	 cd_main_mkdir_with_parents	(const gchar	*filename,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+guint64		 cd_object_generation_get	(void);
+void		 cd_object_generation_bump	(void);
+void		 cd_object_dispatch_push	(void);
+void		 cd_object_dispatch_pop		(void);
+gboolean	 cd_object_dispatch_active	(void);
+GHashTable	*cd_sqlite_statements_new	(void);
+sqlite3_stmt	*cd_sqlite_prepare		(sqlite3	*db,
+						 GHashTable	*statements,
+						 const gchar	*sql,
+						 GError		**error);
+gboolean	 cd_sqlite_step			(sqlite3	*db,
+						 sqlite3_stmt	*stmt,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+GPtrArray	*cd_sqlite_get_strings		(sqlite3	*db,
+						 sqlite3_stmt	*stmt,
+						 GError		**error);
+gboolean	 cd_sqlite_batch_begin		(sqlite3	*db,
+						 guint		*commit_id,
+						 GSourceFunc	 func,
+						 gpointer	 user_data,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_sqlite_batch_commit		(sqlite3	*db,
+						 guint		*commit_id,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_sqlite_batch_rollback	(sqlite3	*db,
+						 guint		*commit_id);
+void		 cd_qualifier_to_atoms		(const gchar	*qualifier,
+						 gboolean	 intern,
+						 GQuark		*atoms);
+gboolean	 cd_qualifier_atoms_match	(const GQuark	*query,
+						 const GQuark	*qualifier);
+gchar		*cd_string_pool_intern		(const gchar	*str);
+void		 cd_string_pool_release		(gpointer	 str);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(CdMainCredentials, cd_main_credentials_unref)
 
 #endif /* __CD_COMMON_H__ */
 
@@ -33,22 +33,236 @@ static void     cd_device_array_finalize	(GObject     *object);
 typedef struct
 {
 	GPtrArray			*array;
+	GHashTable			*keys;		/* CdDevice : CdDeviceArrayKeys */
+	GHashTable			*id_hash;	/* id : GPtrArray of CdDevice */
+	GHashTable			*object_path_hash;
+	GHashTable			*metadata_hash;	/* key : value : GPtrArray of CdDevice */
+	GHashTable			*variants;	/* uid : GVariant */
 } CdDeviceArrayPrivate;
 
+/* the values the device was indexed with, so it can be found again */
+typedef struct {
+	gchar				*id;
+	gchar				*object_path;
+	GHashTable			*metadata;
+} CdDeviceArrayKeys;
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdDeviceArray, cd_device_array, G_TYPE_OBJECT)
 
 static gpointer cd_device_array_object = NULL;
 
+static void
+cd_device_array_keys_free (CdDeviceArrayKeys *keys)
+{
+	g_free (keys->id);
+	g_free (keys->object_path);
+	g_hash_table_unref (keys->metadata);
+	g_free (keys);
+}
+
+static GHashTable *
+cd_device_array_index_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal,
+				      g_free, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+cd_device_array_index_insert (GHashTable *index,
+			      const gchar *key,
+			      CdDevice *device)
+{
+	GPtrArray *devices;
+
+	if (key == NULL)
+		return;
+	devices = g_hash_table_lookup (index, key);
+	if (devices == NULL) {
+		devices = g_ptr_array_new ();
+		g_hash_table_insert (index, g_strdup (key), devices);
+	}
+	g_ptr_array_add (devices, device);
+}
+
+static void
+cd_device_array_index_remove (GHashTable *index,
+			      const gchar *key,
+			      CdDevice *device)
+{
+	GPtrArray *devices;
+
+	if (key == NULL)
+		return;
+	devices = g_hash_table_lookup (index, key);
+	if (devices == NULL)
+		return;
+	g_ptr_array_remove (devices, device);
+	if (devices->len == 0)
+		g_hash_table_remove (index, key);
+}
+
+static void
+cd_device_array_index_metadata (CdDeviceArray *device_array,
+				const gchar *key,
+				const gchar *value,
+				CdDevice *device,
+				gboolean add)
+{
+	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
+	GHashTable *values = g_hash_table_lookup (priv->metadata_hash, key);
+
+	if (add) {
+		if (values == NULL) {
+			values = cd_device_array_index_new ();
+			g_hash_table_insert (priv->metadata_hash, g_strdup (key), values);
+		}
+		cd_device_array_index_insert (values, value, device);
+		return;
+	}
+	if (values == NULL)
+		return;
+	cd_device_array_index_remove (values, value, device);
+	if (g_hash_table_size (values) == 0)
+		g_hash_table_remove (priv->metadata_hash, key);
+}
+
+static void
+cd_device_array_index_string (GHashTable *index,
+			      gchar **key_old,
+			      const gchar *key_new,
+			      CdDevice *device)
+{
+	/* unchanged keys keep their position, so the first match is stable */
+	if (g_strcmp0 (*key_old, key_new) == 0)
+		return;
+	cd_device_array_index_remove (index, *key_old, device);
+	cd_device_array_index_insert (index, key_new, device);
+	g_free (*key_old);
+	*key_old = g_strdup (key_new);
+}
+
+/* these are what cd_device_get_metadata() returns */
+static GHashTable *
+cd_device_array_get_metadata (CdDevice *device)
+{
+	GHashTable *metadata;
+	g_autoptr(GList) keys = NULL;
+	const gchar *fields[] = { CD_DEVICE_PROPERTY_MODEL,
+				  CD_DEVICE_PROPERTY_VENDOR,
+				  CD_DEVICE_PROPERTY_SERIAL,
+				  NULL };
+	g_autoptr(GHashTable) hash = NULL;
+
+	metadata = g_hash_table_new (g_str_hash, g_str_equal);
+	g_object_get (device, "metadata", &hash, NULL);
+	keys = g_hash_table_get_keys (hash);
+	for (GList *l = keys; l != NULL; l = l->next) {
+		const gchar *value = cd_device_get_metadata (device, l->data);
+		if (value != NULL)
+			g_hash_table_insert (metadata, l->data, (gpointer) value);
+	}
+	for (guint i = 0; fields[i] != NULL; i++) {
+		const gchar *value = cd_device_get_metadata (device, fields[i]);
+		if (value != NULL)
+			g_hash_table_insert (metadata, (gpointer) fields[i], (gpointer) value);
+	}
+	return metadata;
+}
+
+static void
+cd_device_array_reindex (CdDeviceArray *device_array, CdDevice *device)
+{
+	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
+	CdDeviceArrayKeys *keys;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	g_autoptr(GHashTable) metadata = NULL;
+
+	keys = g_hash_table_lookup (priv->keys, device);
+	if (keys == NULL)
+		return;
+	cd_device_array_index_string (priv->id_hash, &keys->id,
+				      cd_device_get_id (device), device);
+	if (g_strcmp0 (keys->object_path, cd_device_get_object_path (device)) != 0)
+		g_hash_table_remove_all (priv->variants);
+	cd_device_array_index_string (priv->object_path_hash, &keys->object_path,
+				      cd_device_get_object_path (device), device);
+
+	/* metadata that was removed or changed */
+	metadata = cd_device_array_get_metadata (device);
+	g_hash_table_iter_init (&iter, keys->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_strcmp0 (g_hash_table_lookup (metadata, key), value) == 0)
+			continue;
+		cd_device_array_index_metadata (device_array, key, value, device, FALSE);
+		g_hash_table_iter_remove (&iter);
+	}
+
+	/* metadata that was added or changed */
+	g_hash_table_iter_init (&iter, metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_hash_table_contains (keys->metadata, key))
+			continue;
+		cd_device_array_index_metadata (device_array, key, value, device, TRUE);
+		g_hash_table_insert (keys->metadata, g_strdup (key), g_strdup (value));
+	}
+}
+
+static void
+cd_device_array_notify_cb (CdDevice *device,
+			   GParamSpec *pspec,
+			   CdDeviceArray *device_array)
+{
+	cd_device_array_reindex (device_array, device);
+}
+
+static void
+cd_device_array_unindex (CdDeviceArray *device_array, CdDevice *device)
+{
+	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
+	CdDeviceArrayKeys *keys;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	keys = g_hash_table_lookup (priv->keys, device);
+	if (keys == NULL)
+		return;
+	g_signal_handlers_disconnect_by_func (device,
+					      G_CALLBACK (cd_device_array_notify_cb),
+					      device_array);
+	cd_device_array_index_remove (priv->id_hash, keys->id, device);
+	cd_device_array_index_remove (priv->object_path_hash, keys->object_path, device);
+	g_hash_table_iter_init (&iter, keys->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		cd_device_array_index_metadata (device_array, key, value, device, FALSE);
+	g_hash_table_remove (priv->keys, device);
+}
+
 void
 cd_device_array_add (CdDeviceArray *device_array, CdDevice *device)
 {
 	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
+	CdDeviceArrayKeys *keys;
 
 	g_return_if_fail (CD_IS_DEVICE_ARRAY (device_array));
 	g_return_if_fail (CD_IS_DEVICE (device));
 
 	g_ptr_array_add (priv->array,
 			 g_object_ref (device));
+	g_hash_table_remove_all (priv->variants);
+
+	/* keep the indexes up to date as the device changes */
+	if (g_hash_table_contains (priv->keys, device))
+		return;
+	keys = g_new0 (CdDeviceArrayKeys, 1);
+	keys->metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_insert (priv->keys, device, keys);
+	cd_device_array_reindex (device_array, device);
+	g_signal_connect (device, "notify",
+			  G_CALLBACK (cd_device_array_notify_cb),
+			  device_array);
 }
 
 void
@@ -59,8 +273,11 @@ cd_device_array_remove (CdDeviceArray *device_array, CdDevice *device)
 	g_return_if_fail (CD_IS_DEVICE_ARRAY (device_array));
 	g_return_if_fail (CD_IS_DEVICE (device));
 
-	g_ptr_array_remove (priv->array,
-			    device);
+	if (!g_ptr_array_remove (priv->array, device))
+		return;
+	g_hash_table_remove_all (priv->variants);
+	if (!g_ptr_array_find (priv->array, device, NULL))
+		cd_device_array_unindex (device_array, device);
 }
 
 CdDevice *
@@ -71,23 +288,22 @@ cd_device_array_get_by_id_owner (CdDeviceArray *device_array,
 {
 	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
 	CdDevice *device_tmp;
+	GPtrArray *devices;
 	guint i;
 
 	/* find device */
-	for (i = 0; i < priv->array->len; i++) {
-		device_tmp = g_ptr_array_index (priv->array, i);
-		if (cd_device_get_owner (device_tmp) != owner)
-			continue;
-		if (g_strcmp0 (cd_device_get_id (device_tmp), id) == 0)
+	if (id == NULL)
+		return NULL;
+	devices = g_hash_table_lookup (priv->id_hash, id);
+	if (devices == NULL)
+		return NULL;
+	for (i = 0; i < devices->len; i++) {
+		device_tmp = g_ptr_array_index (devices, i);
+		if (cd_device_get_owner (device_tmp) == owner)
 			return g_object_ref (device_tmp);
 	}
-	if (flags & CD_DEVICE_ARRAY_FLAG_OWNER_OPTIONAL) {
-		for (i = 0; i < priv->array->len; i++) {
-			device_tmp = g_ptr_array_index (priv->array, i);
-			if (g_strcmp0 (cd_device_get_id (device_tmp), id) == 0)
-				return g_object_ref (device_tmp);
-		}
-	}
+	if (flags & CD_DEVICE_ARRAY_FLAG_OWNER_OPTIONAL)
+		return g_object_ref (g_ptr_array_index (devices, 0));
 	return NULL;
 }
 
@@ -96,16 +312,15 @@ cd_device_array_get_by_object_path (CdDeviceArray *device_array,
 				     const gchar *object_path)
 {
 	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
-	CdDevice *device_tmp;
-	guint i;
+	GPtrArray *devices;
 
 	/* find device */
-	for (i = 0; i < priv->array->len; i++) {
-		device_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (cd_device_get_object_path (device_tmp), object_path) == 0)
-			return g_object_ref (device_tmp);
-	}
-	return NULL;
+	if (object_path == NULL)
+		return NULL;
+	devices = g_hash_table_lookup (priv->object_path_hash, object_path);
+	if (devices == NULL)
+		return NULL;
+	return g_object_ref (g_ptr_array_index (devices, 0));
 }
 
 CdDevice *
@@ -119,10 +334,20 @@ cd_device_array_get_by_property (CdDeviceArray *device_array,
 	guint i;
 
 	/* find device */
+	if (value != NULL) {
+		GHashTable *values = g_hash_table_lookup (priv->metadata_hash, key);
+		GPtrArray *devices;
+		if (values == NULL)
+			return NULL;
+		devices = g_hash_table_lookup (values, value);
+		if (devices == NULL)
+			return NULL;
+		return g_object_ref (g_ptr_array_index (devices, 0));
+	}
 	for (i = 0; i < priv->array->len; i++) {
 		device_tmp = g_ptr_array_index (priv->array, i);
 		value_tmp = cd_device_get_metadata (device_tmp, key);
-		if (g_strcmp0 (value_tmp, value) == 0)
+		if (value_tmp == NULL)
 			return g_object_ref (device_tmp);
 	}
 	return NULL;
@@ -157,6 +382,49 @@ cd_device_array_get_by_kind (CdDeviceArray *device_array,
 	return array_tmp;
 }
 
+/**
+ * cd_device_array_get_variant:
+ *
+ * Returns the object paths of the devices visible to @uid. The reply is
+ * cached until a device is added, removed or changes object path.
+ *
+ * Return value: (transfer full): a non-floating 'ao' #GVariant
+ **/
+GVariant *
+cd_device_array_get_variant (CdDeviceArray *device_array, guint uid)
+{
+	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
+	CdDevice *device;
+	GVariant *value;
+	guint length = 0;
+	g_autofree GVariant **variant_array = NULL;
+
+	value = g_hash_table_lookup (priv->variants, GUINT_TO_POINTER (uid));
+	if (value != NULL)
+		return g_variant_ref (value);
+
+	/* copy the object paths */
+	variant_array = g_new0 (GVariant *, priv->array->len + 1);
+	for (guint i = 0; i < priv->array->len; i++) {
+		device = g_ptr_array_index (priv->array, i);
+
+		/* only show devices created by root and the calling
+		 * user, but if called *by* root return all devices
+		 * from all users */
+		if (uid != 0) {
+			if (cd_device_get_owner (device) != 0 &&
+			    cd_device_get_owner (device) != uid)
+				continue;
+		}
+		variant_array[length++] = g_variant_new_object_path (cd_device_get_object_path (device));
+	}
+	value = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE_OBJECT_PATH,
+							 variant_array,
+							 length));
+	g_hash_table_insert (priv->variants, GUINT_TO_POINTER (uid), value);
+	return g_variant_ref (value);
+}
+
 static void
 cd_device_array_class_init (CdDeviceArrayClass *klass)
 {
@@ -169,6 +437,14 @@ cd_device_array_init (CdDeviceArray *device_array)
 {
 	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
 	priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	priv->keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					    NULL, (GDestroyNotify) cd_device_array_keys_free);
+	priv->id_hash = cd_device_array_index_new ();
+	priv->object_path_hash = cd_device_array_index_new ();
+	priv->metadata_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, (GDestroyNotify) g_hash_table_unref);
+	priv->variants = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						NULL, (GDestroyNotify) g_variant_unref);
 }
 
 static void
@@ -177,7 +453,17 @@ cd_device_array_finalize (GObject *object)
 	CdDeviceArray *device_array = CD_DEVICE_ARRAY (object);
 	CdDeviceArrayPrivate *priv = GET_PRIVATE (device_array);
 
+	for (guint i = 0; i < priv->array->len; i++) {
+		g_signal_handlers_disconnect_by_func (g_ptr_array_index (priv->array, i),
+						      G_CALLBACK (cd_device_array_notify_cb),
+						      device_array);
+	}
 	g_ptr_array_unref (priv->array);
+	g_hash_table_unref (priv->keys);
+	g_hash_table_unref (priv->id_hash);
+	g_hash_table_unref (priv->object_path_hash);
+	g_hash_table_unref (priv->metadata_hash);
+	g_hash_table_unref (priv->variants);
 
 	G_OBJECT_CLASS (cd_device_array_parent_class)->finalize (object);
 }
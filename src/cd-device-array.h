@@ -60,6 +60,8 @@ CdDevice	*cd_device_array_get_by_property	(CdDeviceArray	*device_array,
 GPtrArray	*cd_device_array_get_array		(CdDeviceArray	*device_array);
 GPtrArray	*cd_device_array_get_by_kind		(CdDeviceArray	*device_array,
 							 CdDeviceKind	 kind);
+GVariant	*cd_device_array_get_variant		(CdDeviceArray	*device_array,
+							 guint		 uid);
 
 G_END_DECLS
 
@@ -35,12 +35,63 @@ static void     cd_device_db_finalize	(GObject        *object);
 typedef struct
 {
 	sqlite3			*db;
+	GHashTable		*statements;	/* sql : sqlite3_stmt */
+	guint			 commit_id;
 } CdDeviceDbPrivate;
 
 static gpointer cd_device_db_object = NULL;
 
 G_DEFINE_TYPE_WITH_PRIVATE (CdDeviceDb, cd_device_db, G_TYPE_OBJECT)
 
+/* commits any writes still waiting in the batch */
+gboolean
+cd_device_db_flush (CdDeviceDb *ddb, GError **error)
+{
+	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
+	if (priv->db == NULL)
+		return TRUE;
+	return cd_sqlite_batch_commit (priv->db, &priv->commit_id, error);
+}
+
+/* discards any writes still waiting in the batch */
+void
+cd_device_db_rollback (CdDeviceDb *ddb)
+{
+	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	g_return_if_fail (CD_IS_DEVICE_DB (ddb));
+	if (priv->db == NULL)
+		return;
+	cd_sqlite_batch_rollback (priv->db, &priv->commit_id);
+}
+
+static gboolean
+cd_device_db_commit_cb (gpointer user_data)
+{
+	CdDeviceDb *ddb = CD_DEVICE_DB (user_data);
+	g_autoptr(GError) error = NULL;
+	if (!cd_device_db_flush (ddb, &error)) {
+		g_warning ("CdDeviceDb: failed to commit, retrying: %s", error->message);
+		return G_SOURCE_CONTINUE;
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* opens a write transaction, committed by a flush or after a timeout */
+gboolean
+cd_device_db_begin (CdDeviceDb *ddb, GError **error)
+{
+	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
+	if (priv->db == NULL)
+		return TRUE;
+	return cd_sqlite_batch_begin (priv->db,
+				      &priv->commit_id,
+				      cd_device_db_commit_cb,
+				      ddb,
+				      error);
+}
+
 gboolean  
 cd_device_db_load (CdDeviceDb *ddb,
 		    const gchar *filename,
@@ -72,8 +123,8 @@ cd_device_db_load (CdDeviceDb *ddb,
 		return FALSE;
 	}
 
-	/* we don't need to keep doing fsync */
-	sqlite3_exec (priv->db, "PRAGMA synchronous=OFF",
+	/* write-ahead logging only needs an fsync at checkpoints */
+	sqlite3_exec (priv->db, "PRAGMA journal_mode=WAL;PRAGMA synchronous=NORMAL;",
 		      NULL, NULL, NULL);
 
 	/* check devices */
@@ -131,32 +182,23 @@ cd_device_db_add (CdDeviceDb *ddb,
 		  GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdDeviceDb: add device %s", device_id);
-	statement = sqlite3_mprintf ("INSERT INTO devices (device_id) "
-				     "VALUES ('%q')",
-				     device_id);
+	if (!cd_device_db_begin (ddb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "INSERT INTO devices (device_id) VALUES (?1);",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
 
 	/* insert the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	return cd_sqlite_step (priv->db, stmt, error);
 }
 
 gboolean  
@@ -167,33 +209,27 @@ cd_device_db_set_property (CdDeviceDb *ddb,
 			   GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdDeviceDb: add device property %s [%s=%s]",
 		 device_id, property, value);
-	statement = sqlite3_mprintf ("INSERT OR REPLACE INTO properties_v2 (device_id, property, value) "
-				     "VALUES ('%q', '%q', '%q');",
-				     device_id, property, value);
+	if (!cd_device_db_begin (ddb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "INSERT OR REPLACE INTO properties_v2 (device_id, property, value) "
+				  "VALUES (?1, ?2, ?3);",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, property, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, value, -1, SQLITE_TRANSIENT);
 
 	/* insert the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	return cd_sqlite_step (priv->db, stmt, error);
 }
 
 gboolean  
@@ -202,60 +238,30 @@ cd_device_db_remove (CdDeviceDb *ddb,
 		     GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gboolean ret = TRUE;
-	gchar *statement1 = NULL;
-	gchar *statement2 = NULL;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	/* remove the entry */
 	g_debug ("CdDeviceDb: remove device %s", device_id);
-	statement1 = sqlite3_mprintf ("DELETE FROM devices WHERE "
-				     "device_id = '%q';",
-				     device_id);
-	rc = sqlite3_exec (priv->db, statement1, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-	statement2 = sqlite3_mprintf ("DELETE FROM properties_v2 WHERE "
-				     "device_id = '%q';",
-				     device_id);
-	rc = sqlite3_exec (priv->db, statement2, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-out:
-	sqlite3_free (statement1);
-	sqlite3_free (statement2);
-	return ret;
-}
-
-static gint
-cd_device_db_sqlite_cb (void *data,
-			gint argc,
-			gchar **argv,
-			gchar **col_name)
-{
-	GPtrArray *array = (GPtrArray *) data;
-
-	/* should only be one entry */
-	g_debug ("CdDeviceDb: got sql result %s", argv[0]);
-	g_ptr_array_add (array, g_strdup (argv[0]));
-	return 0;
+	if (!cd_device_db_begin (ddb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "DELETE FROM devices WHERE device_id = ?1;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "DELETE FROM properties_v2 WHERE device_id = ?1;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	return cd_sqlite_step (priv->db, stmt, error);
 }
 
 gchar *
@@ -265,35 +271,24 @@ cd_device_db_get_property (CdDeviceDb *ddb,
 			   GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gchar *statement;
-	gint rc;
-	gchar *value = NULL;
+	sqlite3_stmt *stmt;
 	g_autoptr(GPtrArray) array_tmp = NULL;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), NULL);
 	g_return_val_if_fail (priv->db != NULL, NULL);
 
 	g_debug ("CdDeviceDb: get property %s for %s", property, device_id);
-	statement = sqlite3_mprintf ("SELECT value FROM properties_v2 WHERE "
-				     "device_id = '%q' AND "
-				     "property = '%q' LIMIT 1;",
-				     device_id, property);
-
-	/* remove the entry */
-	array_tmp = g_ptr_array_new_with_free_func (g_free);
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_device_db_sqlite_cb,
-			   array_tmp,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
-	}
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT value FROM properties_v2 WHERE "
+				  "device_id = ?1 AND property = ?2 LIMIT 1;",
+				  error);
+	if (stmt == NULL)
+		return NULL;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, property, -1, SQLITE_TRANSIENT);
+	array_tmp = cd_sqlite_get_strings (priv->db, stmt, error);
+	if (array_tmp == NULL)
+		return NULL;
 
 	/* never set */
 	if (array_tmp->len == 0) {
@@ -302,14 +297,11 @@ cd_device_db_get_property (CdDeviceDb *ddb,
 			     CD_CLIENT_ERROR_INTERNAL,
 			     "no such property %s for %s",
 			     property, device_id);
-		goto out;
+		return NULL;
 	}
 
 	/* success */
-	value = g_strdup (g_ptr_array_index (array_tmp, 0));
-out:
-	sqlite3_free (statement);
-	return value;
+	return g_strdup (g_ptr_array_index (array_tmp, 0));
 }
 
 GPtrArray *
@@ -317,37 +309,19 @@ cd_device_db_get_devices (CdDeviceDb *ddb,
 			  GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gchar *statement;
-	gint rc;
-	GPtrArray *array = NULL;
-	g_autoptr(GPtrArray) array_tmp = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), NULL);
 	g_return_val_if_fail (priv->db != NULL, NULL);
 
 	/* get all the devices */
 	g_debug ("CdDeviceDb: get devices");
-	statement = sqlite3_mprintf ("SELECT device_id FROM devices;");
-	array_tmp = g_ptr_array_new_with_free_func (g_free);
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_device_db_sqlite_cb,
-			   array_tmp,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
-	}
-
-	/* success */
-	array = g_ptr_array_ref (array_tmp);
-out:
-	sqlite3_free (statement);
-	return array;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT device_id FROM devices;",
+				  error);
+	if (stmt == NULL)
+		return NULL;
+	return cd_sqlite_get_strings (priv->db, stmt, error);
 }
 
 GPtrArray *
@@ -356,39 +330,93 @@ cd_device_db_get_properties (CdDeviceDb *ddb,
 			     GError  **error)
 {
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
-	gchar *statement;
-	gint rc;
-	GPtrArray *array = NULL;
-	g_autoptr(GPtrArray) array_tmp = NULL;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), NULL);
 	g_return_val_if_fail (priv->db != NULL, NULL);
 
-	/* get all the devices */
+	/* get all the device properties */
 	g_debug ("CdDeviceDb: get properties for device %s", device_id);
-	statement = sqlite3_mprintf ("SELECT property FROM properties_v2 "
-				     "WHERE device_id = '%q';",
-				     device_id);
-	array_tmp = g_ptr_array_new_with_free_func (g_free);
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_device_db_sqlite_cb,
-			   array_tmp,
-			   NULL);
-	if (rc != SQLITE_OK) {
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT property FROM properties_v2 WHERE device_id = ?1;",
+				  error);
+	if (stmt == NULL)
+		return NULL;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	return cd_sqlite_get_strings (priv->db, stmt, error);
+}
+
+/*
+ * Loads every device and all of its properties using one query, calling
+ * @func once per device in the order the devices were added.
+ */
+gboolean
+cd_device_db_load_all (CdDeviceDb *ddb,
+		       CdDeviceDbLoadFunc func,
+		       gpointer user_data,
+		       GError  **error)
+{
+	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	sqlite3_stmt *stmt;
+	gint rc;
+	g_autofree gchar *device_id = NULL;
+	g_autoptr(GHashTable) properties = NULL;
+
+	g_return_val_if_fail (CD_IS_DEVICE_DB (ddb), FALSE);
+	g_return_val_if_fail (priv->db != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	g_debug ("CdDeviceDb: load all devices");
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT d.device_id, p.property, p.value "
+				  "FROM devices d LEFT JOIN properties_v2 p "
+				  "ON p.device_id = d.device_id "
+				  "ORDER BY d.rowid;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		const gchar *id = (const gchar *) sqlite3_column_text (stmt, 0);
+		const gchar *property = (const gchar *) sqlite3_column_text (stmt, 1);
+		const gchar *value = (const gchar *) sqlite3_column_text (stmt, 2);
+
+		if (id == NULL)
+			continue;
+
+		/* the rows for each device are adjacent */
+		if (g_strcmp0 (id, device_id) != 0) {
+			if (device_id != NULL)
+				func (device_id, properties, user_data);
+			g_free (device_id);
+			device_id = g_strdup (id);
+			if (properties != NULL)
+				g_hash_table_unref (properties);
+			properties = g_hash_table_new_full (g_str_hash,
+							    g_str_equal,
+							    g_free,
+							    g_free);
+		}
+
+		/* no properties for this device */
+		if (property == NULL || value == NULL)
+			continue;
+		g_hash_table_insert (properties,
+				     g_strdup (property),
+				     g_strdup (value));
+	}
+	if (rc != SQLITE_DONE) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
 			     CD_CLIENT_ERROR_INTERNAL,
 			     "SQL error: %s",
 			     sqlite3_errmsg(priv->db));
-		goto out;
+		sqlite3_reset (stmt);
+		return FALSE;
 	}
-
-	/* success */
-	array = g_ptr_array_ref (array_tmp);
-out:
-	sqlite3_free (statement);
-	return array;
+	sqlite3_reset (stmt);
+	if (device_id != NULL)
+		func (device_id, properties, user_data);
+	return TRUE;
 }
 
 static void
@@ -401,6 +429,8 @@ cd_device_db_class_init (CdDeviceDbClass *klass)
 static void
 cd_device_db_init (CdDeviceDb *ddb)
 {
+	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	priv->statements = cd_sqlite_statements_new ();
 }
 
 static void
@@ -408,8 +438,14 @@ cd_device_db_finalize (GObject *object)
 {
 	CdDeviceDb *ddb = CD_DEVICE_DB (object);
 	CdDeviceDbPrivate *priv = GET_PRIVATE (ddb);
+	g_autoptr(GError) error = NULL;
+
+	/* write out anything still batched */
+	if (!cd_device_db_flush (ddb, &error))
+		g_warning ("CdDeviceDb: failed to commit: %s", error->message);
 
 	/* close the database */
+	g_hash_table_unref (priv->statements);
 	sqlite3_close (priv->db);
 
 	G_OBJECT_CLASS (cd_device_db_parent_class)->finalize (object);
@@ -34,6 +34,11 @@ struct _CdDeviceDbClass
 	GObjectClass	parent_class;
 };
 
+/* called once per device with a hash of property : value */
+typedef void	(*CdDeviceDbLoadFunc)		(const gchar	*device_id,
+						 GHashTable	*properties,
+						 gpointer	 user_data);
+
 CdDeviceDb	*cd_device_db_new		(void);
 
 gboolean	 cd_device_db_load		(CdDeviceDb	*ddb,
@@ -69,6 +74,18 @@ GPtrArray	*cd_device_db_get_properties	(CdDeviceDb	*ddb,
 						 const gchar	*device_id,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_device_db_load_all		(CdDeviceDb	*ddb,
+						 CdDeviceDbLoadFunc func,
+						 gpointer	 user_data,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_device_db_begin		(CdDeviceDb	*ddb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_device_db_flush		(CdDeviceDb	*ddb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_device_db_rollback		(CdDeviceDb	*ddb);
 
 G_END_DECLS
 
@@ -32,10 +32,12 @@
 #include "cd-common.h"
 #include "cd-device.h"
 #include "cd-mapping-db.h"
+#include "cd-memory-private.h"
 #include "cd-device-db.h"
 #include "cd-profile-array.h"
 #include "cd-profile.h"
 #include "cd-inhibit.h"
+#include "cd-metrics.h"
 
 static void cd_device_finalize			 (GObject *object);
 static void cd_device_dbus_emit_property_changed (CdDevice *device,
@@ -45,6 +47,8 @@ static void cd_device_dbus_emit_device_changed	 (CdDevice *device);
 
 #define GET_PRIVATE(o) (cd_device_get_instance_private (o))
 
+#define CD_DEVICE_QUALIFIER_CACHE_MAX	64	/* distinct queries */
+
 typedef struct
 {
 	CdObjectScope			 object_scope;
@@ -62,7 +66,8 @@ typedef struct
 	CdDeviceKind			 kind;
 	gchar				*object_path;
 	GDBusConnection			*connection;
-	GPtrArray			*profiles; /* of CdDeviceProfileItem */
+	GPtrArray			*profiles; /* of CdDeviceProfileItem, newest first */
+	GHashTable			*profiles_by_path; /* object path : CdDeviceProfileItem */
 	guint				 registration_id;
 	guint				 watcher_id;
 	guint64				 created;
@@ -72,8 +77,17 @@ typedef struct
 	gboolean			 enabled;
 	gboolean			 embedded;
 	GHashTable			*metadata;
+	GVariant			*metadata_variant;
+	GVariant			*profiles_variant;
+	GVariant			*inhibitors_variant;
+	gboolean			 inhibited;
+	GHashTable			*qualifier_cache;	/* key : CdProfile or NULL */
+	guint				 qualifier_cache_serial;
 	guint				 owner;
 	gchar				*seat;
+	GHashTable			*pending_properties;	/* name : GVariant */
+	gboolean			 pending_changed;
+	guint				 pending_id;
 } CdDevicePrivate;
 
 enum {
@@ -85,6 +99,7 @@ enum {
 	PROP_0,
 	PROP_OBJECT_PATH,
 	PROP_ID,
+	PROP_METADATA,
 	PROP_LAST
 };
 
@@ -95,6 +110,7 @@ typedef struct {
 } CdDeviceProfileItem;
 
 static guint signals[SIGNAL_LAST] = { 0 };
+static gint cd_device_live_count = 0;
 G_DEFINE_TYPE_WITH_PRIVATE (CdDevice, cd_device, G_TYPE_OBJECT)
 
 GQuark
@@ -292,6 +308,7 @@ cd_device_set_id (CdDevice *device, const gchar *id)
 
 	/* now calculate this again */
 	cd_device_set_object_path (device);
+	g_object_notify (G_OBJECT (device), "id");
 
 	/* find initial enabled state */
 	enabled_str = cd_device_db_get_property (priv->device_db,
@@ -315,55 +332,64 @@ cd_device_reset_modified (CdDevice *device)
 	priv->require_modified_signal = TRUE;
 }
 
+/* sends everything that changed since the last flush as one
+ * PropertiesChanged, followed by a single Changed if required */
 static void
-cd_device_dbus_emit_property_changed (CdDevice *device,
-				      const gchar *property_name,
-				      GVariant *property_value)
+cd_device_dbus_flush_changes (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
 	GVariantBuilder builder;
 	GVariantBuilder invalidated_builder;
 
+	if (priv->pending_id != 0) {
+		g_source_remove (priv->pending_id);
+		priv->pending_id = 0;
+	}
+
 	/* not yet connected */
-	if (priv->connection == NULL)
+	if (priv->connection == NULL) {
+		g_hash_table_remove_all (priv->pending_properties);
+		priv->pending_changed = FALSE;
 		return;
+	}
 
 	/* build the dict */
-	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder,
-			       "{sv}",
-			       property_name,
-			       property_value);
-	if (priv->require_modified_signal) {
-		g_variant_builder_add (&builder,
-				       "{sv}",
-				       CD_DEVICE_PROPERTY_MODIFIED,
-				       g_variant_new_uint64 (priv->modified));
-		priv->require_modified_signal = FALSE;
+	if (g_hash_table_size (priv->pending_properties) > 0) {
+		g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
+		g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+		g_hash_table_iter_init (&iter, priv->pending_properties);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			g_variant_builder_add (&builder, "{sv}",
+					       (const gchar *) key,
+					       (GVariant *) value);
+		}
+		if (priv->require_modified_signal) {
+			g_variant_builder_add (&builder,
+					       "{sv}",
+					       CD_DEVICE_PROPERTY_MODIFIED,
+					       g_variant_new_uint64 (priv->modified));
+			priv->require_modified_signal = FALSE;
+		}
+		g_dbus_connection_emit_signal (priv->connection,
+					       NULL,
+					       priv->object_path,
+					       "org.freedesktop.DBus.Properties",
+					       "PropertiesChanged",
+					       g_variant_new ("(sa{sv}as)",
+					       COLORD_DBUS_INTERFACE_DEVICE,
+					       &builder,
+					       &invalidated_builder),
+					       NULL);
+		g_variant_builder_clear (&builder);
+		g_variant_builder_clear (&invalidated_builder);
+		g_hash_table_remove_all (priv->pending_properties);
 	}
-	g_dbus_connection_emit_signal (priv->connection,
-				       NULL,
-				       priv->object_path,
-				       "org.freedesktop.DBus.Properties",
-				       "PropertiesChanged",
-				       g_variant_new ("(sa{sv}as)",
-				       COLORD_DBUS_INTERFACE_DEVICE,
-				       &builder,
-				       &invalidated_builder),
-				       NULL);
-	g_variant_builder_clear (&builder);
-	g_variant_builder_clear (&invalidated_builder);
-}
-
-static void
-cd_device_dbus_emit_device_changed (CdDevice *device)
-{
-	CdDevicePrivate *priv = GET_PRIVATE (device);
-
-	/* not yet connected */
-	if (priv->connection == NULL)
+	if (!priv->pending_changed)
 		return;
+	priv->pending_changed = FALSE;
 
 	/* emit signal */
 	g_debug ("CdDevice: emit Changed on %s",
@@ -389,46 +415,70 @@ cd_device_dbus_emit_device_changed (CdDevice *device)
 }
 
 static gboolean
-cd_device_match_qualifier (const gchar *qual1, const gchar *qual2)
+cd_device_dbus_flush_changes_cb (gpointer user_data)
 {
-	guint i;
-	g_auto(GStrv) split1 = NULL;
-	g_auto(GStrv) split2 = NULL;
+	CdDevice *device = CD_DEVICE (user_data);
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	priv->pending_id = 0;
+	cd_device_dbus_flush_changes (device);
+	return G_SOURCE_REMOVE;
+}
 
-	/* split into substring */
-	split1 = g_strsplit (qual1, ".", 3);
-	split2 = g_strsplit (qual2, ".", 3);
+static void
+cd_device_dbus_queue_changes (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
 
-	/* ensure all substrings match */
-	for (i = 0; i < 3; i++) {
+	/* the caller has to see the change before the method returns */
+	if (cd_object_dispatch_active ()) {
+		cd_device_dbus_flush_changes (device);
+		return;
+	}
+	if (priv->pending_id == 0) {
+		priv->pending_id = g_idle_add (cd_device_dbus_flush_changes_cb, device);
+		g_source_set_name_by_id (priv->pending_id, "[CdDevice] flush changes");
+	}
+}
 
-		/* wildcard in query */
-		if (g_strcmp0 (split1[i], "*") == 0)
-			continue;
+static void
+cd_device_dbus_emit_property_changed (CdDevice *device,
+				      const gchar *property_name,
+				      GVariant *property_value)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
 
-		/* wildcard in qualifier */
-		if (g_strcmp0 (split2[i], "*") == 0)
-			continue;
+	/* not yet connected */
+	if (priv->connection == NULL)
+		return;
+	cd_object_generation_bump ();
 
-		/* exact match */
-		if (g_strcmp0 (split1[i], split2[i]) == 0)
-			continue;
+	/* later values replace earlier ones in the same flush */
+	g_hash_table_insert (priv->pending_properties,
+			     g_strdup (property_name),
+			     g_variant_ref_sink (property_value));
+	cd_device_dbus_queue_changes (device);
+}
 
-		/* failed to match substring */
-		return FALSE;
-	}
+static void
+cd_device_dbus_emit_device_changed (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
 
-	/* success */
-	return TRUE;
+	/* not yet connected */
+	if (priv->connection == NULL)
+		return;
+	priv->pending_changed = TRUE;
+	cd_device_dbus_queue_changes (device);
 }
 
 static CdProfile *
 cd_device_find_by_qualifier (const gchar *regex,
+			     const GQuark *atoms,
 			     GPtrArray *array,
 			     CdDeviceRelation relation)
 {
 	CdDeviceProfileItem *item;
-	const gchar *qualifier;
+	const GQuark *qualifier;
 	gboolean ret;
 	guint i;
 
@@ -446,40 +496,116 @@ cd_device_find_by_qualifier (const gchar *regex,
 		}
 
 		/* match with a regex */
-		qualifier = cd_profile_get_qualifier (item->profile);
+		qualifier = cd_profile_get_qualifier_atoms (item->profile);
 		if (qualifier == NULL) {
 			g_debug ("no qualifier for %s, skipping",
 				 cd_profile_get_id (item->profile));
 			continue;
 		}
-		ret = cd_device_match_qualifier (regex,
-						 qualifier);
+		ret = cd_qualifier_atoms_match (atoms, qualifier);
 		g_debug ("%s regex '%s' for '%s'",
 			 ret ? "matched" : "unmatched",
 			 regex,
-			 qualifier);
+			 cd_profile_get_qualifier (item->profile));
 		if (ret)
 			return item->profile;
 	}
 	return  NULL;
 }
 
+static void
+cd_device_qualifier_cache_free (gpointer data)
+{
+	if (data != NULL)
+		g_object_unref (data);
+}
+
+/* each regex is prefixed with its length, as they can contain anything */
+static gchar *
+cd_device_qualifier_cache_key (gchar **regexes)
+{
+	GString *key = g_string_new (NULL);
+	for (guint i = 0; regexes[i] != NULL; i++)
+		g_string_append_printf (key, "%" G_GSIZE_FORMAT ":%s", strlen (regexes[i]), regexes[i]);
+	return g_string_free (key, FALSE);
+}
+
 static CdProfile *
-cd_device_find_profile_by_object_path (GPtrArray *array, const gchar *object_path)
+cd_device_get_profile_for_qualifiers (CdDevice *device, gchar **regexes)
 {
-	CdDeviceProfileItem *item;
-	gboolean ret;
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	CdProfile *profile = NULL;
+	gpointer cached;
 	guint i;
+	guint len = g_strv_length (regexes);
+	g_autofree gchar *key = NULL;
+	g_autofree GQuark *atoms = NULL;
+
+	/* the profile list is unchanged since the last identical query */
+	if (priv->qualifier_cache_serial != cd_profile_get_qualifier_serial ()) {
+		g_hash_table_remove_all (priv->qualifier_cache);
+		priv->qualifier_cache_serial = cd_profile_get_qualifier_serial ();
+	}
+	key = cd_device_qualifier_cache_key (regexes);
+	if (g_hash_table_lookup_extended (priv->qualifier_cache, key, NULL, &cached)) {
+		g_debug ("using cached result for qualifiers");
+		return cached;
+	}
 
-	/* find using an object path */
-	for (i = 0; i < array->len; i++) {
-		item = g_ptr_array_index (array, i);
-		ret = (g_strcmp0 (object_path,
-				  cd_profile_get_object_path (item->profile)) == 0);
-		if (ret)
-			return item->profile;
+	/* split each query once, not once per profile */
+	atoms = g_new (GQuark, len * CD_QUALIFIER_ATOMS_MAX);
+	for (i = 0; i < len; i++)
+		cd_qualifier_to_atoms (regexes[i], FALSE, &atoms[i * CD_QUALIFIER_ATOMS_MAX]);
+
+	/* search each regex against the profiles for this device */
+	for (i = 0; profile == NULL && i < len; i++) {
+		if (i == 0)
+			g_debug ("searching [hard]");
+		profile = cd_device_find_by_qualifier (regexes[i],
+						       &atoms[i * CD_QUALIFIER_ATOMS_MAX],
+						       priv->profiles,
+						       CD_DEVICE_RELATION_HARD);
 	}
-	return NULL;
+	for (i = 0; profile == NULL && i < len; i++) {
+		if (i == 0)
+			g_debug ("searching [soft]");
+		profile = cd_device_find_by_qualifier (regexes[i],
+						       &atoms[i * CD_QUALIFIER_ATOMS_MAX],
+						       priv->profiles,
+						       CD_DEVICE_RELATION_SOFT);
+	}
+
+	/* callers can send anything, so don't let this grow unbounded */
+	if (g_hash_table_size (priv->qualifier_cache) >= CD_DEVICE_QUALIFIER_CACHE_MAX)
+		g_hash_table_remove_all (priv->qualifier_cache);
+	g_hash_table_insert (priv->qualifier_cache,
+			     g_steal_pointer (&key),
+			     profile != NULL ? g_object_ref (profile) : NULL);
+	return profile;
+}
+
+static CdDeviceProfileItem *
+cd_device_find_profile_item (CdDevice *device, const gchar *object_path)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	if (object_path == NULL)
+		return NULL;
+	return g_hash_table_lookup (priv->profiles_by_path, object_path);
+}
+
+static void
+cd_device_insert_profile_item (CdDevice *device, CdDeviceProfileItem *item)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	guint i;
+
+	/* after any with the same timestamp, as a stable sort would */
+	for (i = 0; i < priv->profiles->len; i++) {
+		CdDeviceProfileItem *item_tmp = g_ptr_array_index (priv->profiles, i);
+		if (item_tmp->timestamp < item->timestamp)
+			break;
+	}
+	g_ptr_array_insert (priv->profiles, (gint) i, item);
 }
 
 static GVariant *
@@ -535,6 +661,28 @@ cd_device_get_profiles_as_variant (CdDevice *device)
 				    priv->profiles->len);
 }
 
+static GVariant *
+cd_device_get_profiles_cached (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+
+	/* only rebuilt when the profile list changes */
+	if (priv->profiles_variant == NULL)
+		priv->profiles_variant = g_variant_ref_sink (cd_device_get_profiles_as_variant (device));
+	return priv->profiles_variant;
+}
+
+static void
+cd_device_emit_profiles_changed (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_clear_pointer (&priv->profiles_variant, g_variant_unref);
+	g_hash_table_remove_all (priv->qualifier_cache);
+	cd_device_dbus_emit_property_changed (device,
+					      CD_DEVICE_PROPERTY_PROFILES,
+					      cd_device_get_profiles_cached (device));
+}
+
 gboolean
 cd_device_remove_profile (CdDevice *device,
 			  const gchar *profile_object_path,
@@ -542,19 +690,11 @@ cd_device_remove_profile (CdDevice *device,
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	CdDeviceProfileItem *item;
-	gboolean ret = FALSE;
-	guint i;
+	gboolean ret;
 
 	/* check the profile exists on this device */
-	for (i = 0; i < priv->profiles->len; i++) {
-		item = g_ptr_array_index (priv->profiles, i);
-		if (g_strcmp0 (profile_object_path,
-			       cd_profile_get_object_path (item->profile)) == 0) {
-			ret = TRUE;
-			break;
-		}
-	}
-	if (!ret) {
+	item = cd_device_find_profile_item (device, profile_object_path);
+	if (item == NULL) {
 		g_set_error (error,
 			     CD_DEVICE_ERROR,
 			     CD_DEVICE_ERROR_PROFILE_DOES_NOT_EXIST,
@@ -565,6 +705,8 @@ cd_device_remove_profile (CdDevice *device,
 	}
 
 	/* remove from the arrays */
+	g_hash_table_remove (priv->profiles_by_path, profile_object_path);
+	cd_profile_array_release (priv->profile_array, item->profile);
 	ret = g_ptr_array_remove (priv->profiles, item);
 	g_assert (ret);
 
@@ -572,9 +714,7 @@ cd_device_remove_profile (CdDevice *device,
 	cd_device_reset_modified (device);
 
 	/* emit */
-	cd_device_dbus_emit_property_changed (device,
-					      "Profiles",
-					      cd_device_get_profiles_as_variant (device));
+	cd_device_emit_profiles_changed (device);
 
 	/* emit global signal */
 	cd_device_dbus_emit_device_changed (device);
@@ -585,19 +725,12 @@ static CdDeviceRelation
 cd_device_find_profile_relation (CdDevice *device,
 				 const gchar *profile_object_path)
 {
-	CdDevicePrivate *priv = GET_PRIVATE (device);
 	CdDeviceProfileItem *item;
-	guint i;
 
-	/* search profiles */
-	for (i = 0; i < priv->profiles->len; i++) {
-		item = g_ptr_array_index (priv->profiles, i);
-		if (g_strcmp0 (profile_object_path,
-			       cd_profile_get_object_path (item->profile)) == 0) {
-			return item->relation;
-		}
-	}
-	return CD_DEVICE_RELATION_UNKNOWN;
+	item = cd_device_find_profile_item (device, profile_object_path);
+	if (item == NULL)
+		return CD_DEVICE_RELATION_UNKNOWN;
+	return item->relation;
 }
 
 static const gchar *
@@ -610,21 +743,6 @@ _cd_device_relation_to_string (CdDeviceRelation device_relation)
 	return "unknown";
 }
 
-static gint
-cd_device_profile_item_sort_cb (gconstpointer a, gconstpointer b)
-{
-	gint64 tmp;
-	CdDeviceProfileItem **item_a = (CdDeviceProfileItem **) a;
-	CdDeviceProfileItem **item_b = (CdDeviceProfileItem **) b;
-
-	tmp = (gint64) (*item_b)->timestamp - (gint64) (*item_a)->timestamp;
-	if (tmp < 0)
-		return -1;
-	if (tmp > 0)
-		return 1;
-	return 0;
-}
-
 gboolean
 cd_device_add_profile (CdDevice *device,
 		       CdDeviceRelation relation,
@@ -635,7 +753,6 @@ cd_device_add_profile (CdDevice *device,
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	CdDeviceProfileItem *item;
 	gboolean create_item = TRUE;
-	guint i;
 	g_autoptr(CdProfile) profile = NULL;
 
 	/* is it available */
@@ -651,22 +768,19 @@ cd_device_add_profile (CdDevice *device,
 	}
 
 	/* check it does not already exist */
-	for (i = 0; i < priv->profiles->len; i++) {
-		item = g_ptr_array_index (priv->profiles, i);
-		if (g_strcmp0 (cd_profile_get_object_path (profile),
-			       cd_profile_get_object_path (item->profile)) == 0) {
-
-			/* if we soft added this profile, and now the
-			 * user hard adds it as well then we need to
-			 * change the kind and not re-add it */
-			if (relation == CD_DEVICE_RELATION_HARD &&
-			    item->relation == CD_DEVICE_RELATION_SOFT) {
-				g_debug ("CdDevice: converting %s hard->soft",
-					 cd_profile_get_id (profile));
-				item->relation = CD_DEVICE_RELATION_HARD;
-				create_item = FALSE;
-				break;
-			}
+	item = cd_device_find_profile_item (device, cd_profile_get_object_path (profile));
+	if (item != NULL) {
+
+		/* if we soft added this profile, and now the
+		 * user hard adds it as well then we need to
+		 * change the kind and not re-add it */
+		if (relation == CD_DEVICE_RELATION_HARD &&
+		    item->relation == CD_DEVICE_RELATION_SOFT) {
+			g_debug ("CdDevice: converting %s hard->soft",
+				 cd_profile_get_id (profile));
+			item->relation = CD_DEVICE_RELATION_HARD;
+			create_item = FALSE;
+		} else {
 			g_set_error (error,
 				     CD_DEVICE_ERROR,
 				     CD_DEVICE_ERROR_PROFILE_ALREADY_ADDED,
@@ -684,20 +798,20 @@ cd_device_add_profile (CdDevice *device,
 			 priv->id);
 		item = g_new0 (CdDeviceProfileItem, 1);
 		item->profile = g_object_ref (profile);
+		cd_profile_array_hold (priv->profile_array, profile);
 		item->relation = relation;
 		item->timestamp = timestamp;
-		g_ptr_array_add (priv->profiles, item);
-		g_ptr_array_sort (priv->profiles,
-				  cd_device_profile_item_sort_cb);
+		cd_device_insert_profile_item (device, item);
+		g_hash_table_insert (priv->profiles_by_path,
+				     g_strdup (cd_profile_get_object_path (profile)),
+				     item);
 	}
 
 	/* reset modification time */
 	cd_device_reset_modified (device);
 
 	/* emit */
-	cd_device_dbus_emit_property_changed (device,
-					      "Profiles",
-					      cd_device_get_profiles_as_variant (device));
+	cd_device_emit_profiles_changed (device);
 
 	/* emit global signal */
 	cd_device_dbus_emit_device_changed (device);
@@ -752,6 +866,15 @@ cd_device_get_metadata_as_variant (CdDevice *device)
 	return g_variant_builder_end (&builder);
 }
 
+static GVariant *
+cd_device_get_metadata_cached (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	if (priv->metadata_variant == NULL)
+		priv->metadata_variant = g_variant_ref_sink (cd_device_get_metadata_as_variant (device));
+	return priv->metadata_variant;
+}
+
 static void
 cd_device_string_remove_suffix (gchar *vendor, const gchar *suffix)
 {
@@ -873,11 +996,12 @@ cd_device_set_property_internal (CdDevice *device,
 		/* add to metadata */
 		is_metadata = TRUE;
 		g_hash_table_insert (priv->metadata,
-				     g_strdup (property),
-				     g_strdup (value));
+				     cd_string_pool_intern (property),
+				     cd_string_pool_intern (value));
+		g_clear_pointer (&priv->metadata_variant, g_variant_unref);
 		cd_device_dbus_emit_property_changed (device,
 						      CD_DEVICE_PROPERTY_METADATA,
-						      cd_device_get_metadata_as_variant (device));
+						      cd_device_get_metadata_cached (device));
 	}
 
 	/* set this externally so we can add disk devices at startup
@@ -894,6 +1018,7 @@ cd_device_set_property_internal (CdDevice *device,
 						      property,
 						      cd_device_get_nullable_for_string (value));
 	}
+	g_object_notify (G_OBJECT (device), "metadata");
 	return TRUE;
 }
 
@@ -910,6 +1035,125 @@ cd_device_get_metadata (CdDevice *device, const gchar *key)
 	return g_hash_table_lookup (priv->metadata, key);
 }
 
+static void
+cd_device_state_add (GVariantBuilder *builder, const gchar *key, const gchar *value)
+{
+	if (value == NULL)
+		return;
+	g_variant_builder_add (builder, "{ss}", key, value);
+}
+
+/**
+ * cd_device_get_state:
+ *
+ * Gets everything needed to recreate the device later with
+ * cd_device_set_state(), which is the same as what a plugin sets using
+ * cd_device_set_property_internal().
+ *
+ * Return value: a floating (sa{ss}) of the ID and properties
+ **/
+GVariant *
+cd_device_get_state (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	GHashTableIter iter;
+	GVariantBuilder builder;
+	gpointer key, value;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+	if (priv->kind != CD_DEVICE_KIND_UNKNOWN) {
+		cd_device_state_add (&builder, CD_DEVICE_PROPERTY_KIND,
+				     cd_device_kind_to_string (priv->kind));
+	}
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_MODEL, priv->model);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_VENDOR, priv->vendor);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_SERIAL, priv->serial);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_COLORSPACE, priv->colorspace);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_FORMAT, priv->format);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_MODE, priv->mode);
+	cd_device_state_add (&builder, CD_DEVICE_PROPERTY_SEAT, priv->seat);
+	if (priv->embedded)
+		cd_device_state_add (&builder, CD_DEVICE_PROPERTY_EMBEDDED, "");
+	g_hash_table_iter_init (&iter, priv->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		cd_device_state_add (&builder, key, value);
+	return g_variant_new ("(sa{ss})", priv->id, &builder);
+}
+
+/* the number of devices not yet finalized, to find leaks */
+guint
+cd_device_get_live_count (void)
+{
+	return (guint) g_atomic_int_get (&cd_device_live_count);
+}
+
+static gsize
+cd_device_get_string_size (const gchar *str)
+{
+	return str != NULL ? strlen (str) + 1 : 0;
+}
+
+/* an estimate of the heap used, including the cached property values */
+gsize
+cd_device_get_memory_size (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	GHashTableIter iter;
+	const gchar *key;
+	gsize size = sizeof (CdDevice) + sizeof (CdDevicePrivate);
+
+	g_return_val_if_fail (CD_IS_DEVICE (device), 0);
+
+	size += cd_device_get_string_size (priv->id);
+	size += cd_device_get_string_size (priv->model);
+	size += cd_device_get_string_size (priv->serial);
+	size += cd_device_get_string_size (priv->vendor);
+	size += cd_device_get_string_size (priv->colorspace);
+	size += cd_device_get_string_size (priv->format);
+	size += cd_device_get_string_size (priv->mode);
+	size += cd_device_get_string_size (priv->seat);
+	size += cd_device_get_string_size (priv->object_path);
+	size += priv->profiles->len * (sizeof (gpointer) + sizeof (CdDeviceProfileItem));
+	g_hash_table_iter_init (&iter, priv->profiles_by_path);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+		size += 3 * sizeof (gpointer) + strlen (key) + 1;
+	size += cd_memory_get_hash_table_size (priv->metadata);
+	g_hash_table_iter_init (&iter, priv->qualifier_cache);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+		size += 3 * sizeof (gpointer) + strlen (key) + 1;
+	if (priv->metadata_variant != NULL)
+		size += g_variant_get_size (priv->metadata_variant);
+	if (priv->profiles_variant != NULL)
+		size += g_variant_get_size (priv->profiles_variant);
+	if (priv->inhibitors_variant != NULL)
+		size += g_variant_get_size (priv->inhibitors_variant);
+	return size;
+}
+
+/**
+ * cd_device_set_state:
+ * @state: a (sa{ss}) from cd_device_get_state()
+ *
+ * Sets the ID and properties of a new device. Nothing is saved
+ * to the database.
+ **/
+gboolean
+cd_device_set_state (CdDevice *device, GVariant *state, GError **error)
+{
+	const gchar *id;
+	const gchar *key;
+	const gchar *value;
+	g_autoptr(GVariantIter) iter = NULL;
+
+	g_variant_get (state, "(&sa{ss})", &id, &iter);
+	cd_device_set_id (device, id);
+	while (g_variant_iter_next (iter, "{&s&s}", &key, &value)) {
+		if (!cd_device_set_property_internal (device, key, value, FALSE, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 gboolean
 cd_device_make_default (CdDevice *device,
 		        const gchar *profile_object_path,
@@ -917,13 +1161,11 @@ cd_device_make_default (CdDevice *device,
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
 	CdDeviceProfileItem *item;
-	CdProfile *profile;
-	guint i;
+	guint idx;
 
 	/* find profile */
-	profile = cd_device_find_profile_by_object_path (priv->profiles,
-							 profile_object_path);
-	if (profile == NULL) {
+	item = cd_device_find_profile_item (device, profile_object_path);
+	if (item == NULL) {
 		g_set_error (error,
 			     CD_DEVICE_ERROR,
 			     CD_DEVICE_ERROR_PROFILE_DOES_NOT_EXIST,
@@ -933,24 +1175,18 @@ cd_device_make_default (CdDevice *device,
 	}
 
 	/* make the profile first in the array */
-	for (i=1; i<priv->profiles->len; i++) {
-		item = g_ptr_array_index (priv->profiles, i);
-		if (item->profile == profile) {
-			item->timestamp = g_get_real_time ();
-			item->relation = CD_DEVICE_RELATION_HARD;
-			g_ptr_array_sort (priv->profiles,
-					  cd_device_profile_item_sort_cb);
-			break;
-		}
+	if (g_ptr_array_find (priv->profiles, item, &idx) && idx > 0) {
+		g_ptr_array_steal_index (priv->profiles, idx);
+		item->timestamp = g_get_real_time ();
+		item->relation = CD_DEVICE_RELATION_HARD;
+		cd_device_insert_profile_item (device, item);
 	}
 
 	/* reset modification time */
 	cd_device_reset_modified (device);
 
 	/* emit */
-	cd_device_dbus_emit_property_changed (device,
-					      "Profiles",
-					      cd_device_get_profiles_as_variant (device));
+	cd_device_emit_profiles_changed (device);
 
 	/* emit global signal */
 	cd_device_dbus_emit_device_changed (device);
@@ -1000,6 +1236,15 @@ cd_device_set_enabled (CdDevice *device,
 	return TRUE;
 }
 
+static void	cd_device_dbus_method_call_timed (GDBusConnection *connection,
+						  const gchar *sender,
+						  const gchar *object_path,
+						  const gchar *interface_name,
+						  const gchar *method_name,
+						  GVariant *parameters,
+						  GDBusMethodInvocation *invocation,
+						  gpointer user_data);
+
 static void
 cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 			    const gchar *object_path, const gchar *interface_name,
@@ -1017,17 +1262,19 @@ cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	const gchar *property_name = NULL;
 	const gchar *property_value = NULL;
 	gboolean ret;
-	guint i = 0;
 	g_autoptr(GError) error = NULL;
 
 	/* return '' */
 	if (g_strcmp0 (method_name, "AddProfile") == 0) {
 
 		/* require auth */
-		ret = cd_main_sender_authenticated (connection,
-						    sender,
-						    "org.freedesktop.color-manager.modify-device",
-						    &error);
+		ret = cd_main_invocation_authenticated (invocation,
+							"org.freedesktop.color-manager.modify-device",
+							cd_device_dbus_method_call_timed,
+							G_OBJECT (device),
+							&error);
+		if (!ret && error == NULL)
+			return;
 		if (!ret) {
 			g_dbus_method_invocation_return_error (invocation,
 							       CD_DEVICE_ERROR,
@@ -1180,8 +1427,7 @@ cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 			 sender, strv_debug);
 
 		/* are we profiling? */
-		ret = cd_inhibit_valid (priv->inhibit);
-		if (!ret) {
+		if (priv->inhibited) {
 			g_debug ("CdDevice: returning no results for profiling");
 			g_dbus_method_invocation_return_error (invocation,
 							       CD_DEVICE_ERROR,
@@ -1192,20 +1438,7 @@ cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 		}
 
 		/* search each regex against the profiles for this device */
-		for (i = 0; profile == NULL && regexes[i] != NULL; i++) {
-			if (i == 0)
-				g_debug ("searching [hard]");
-			profile = cd_device_find_by_qualifier (regexes[i],
-							       priv->profiles,
-							       CD_DEVICE_RELATION_HARD);
-		}
-		for (i = 0; profile == NULL && regexes[i] != NULL; i++) {
-			if (i == 0)
-				g_debug ("searching [soft]");
-			profile = cd_device_find_by_qualifier (regexes[i],
-							       priv->profiles,
-							       CD_DEVICE_RELATION_SOFT);
-		}
+		profile = cd_device_get_profile_for_qualifiers (device, regexes);
 		if (profile == NULL) {
 			g_dbus_method_invocation_return_error (invocation,
 							       CD_DEVICE_ERROR,
@@ -1225,10 +1458,13 @@ cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	if (g_strcmp0 (method_name, "MakeProfileDefault") == 0) {
 
 		/* require auth */
-		ret = cd_main_sender_authenticated (connection,
-						    sender,
-						    "org.freedesktop.color-manager.modify-device",
-						    &error);
+		ret = cd_main_invocation_authenticated (invocation,
+							"org.freedesktop.color-manager.modify-device",
+							cd_device_dbus_method_call_timed,
+							G_OBJECT (device),
+							&error);
+		if (!ret && error == NULL)
+			return;
 		if (!ret) {
 			g_dbus_method_invocation_return_error (invocation,
 							       CD_DEVICE_ERROR,
@@ -1399,22 +1635,57 @@ cd_device_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	g_critical ("failed to process device method %s", method_name);
 }
 
+/* records how long each method handler takes */
+static void
+cd_device_dbus_method_call_timed (GDBusConnection *connection, const gchar *sender,
+				  const gchar *object_path, const gchar *interface_name,
+				  const gchar *method_name, GVariant *parameters,
+				  GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	gint64 start = g_get_monotonic_time ();
+	cd_object_dispatch_push ();
+	cd_device_dbus_method_call (connection, sender, object_path, interface_name,
+				    method_name, parameters, invocation, user_data);
+	cd_object_dispatch_pop ();
+	cd_metrics_add_method ("Device", method_name, start);
+}
+
 static void
 cd_device_inhibit_changed_cb (CdInhibit *inhibit,
 			      gpointer user_data)
 {
 	CdDevice *device = CD_DEVICE (user_data);
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+
+	/* the profile list itself is unchanged, so reuse it */
+	priv->inhibited = !cd_inhibit_valid (inhibit);
+	g_clear_pointer (&priv->inhibitors_variant, g_variant_unref);
+	g_hash_table_remove_all (priv->qualifier_cache);
 
 	/* emit */
 	g_debug ("Emitting Device.Profiles as inhibit changed");
 	cd_device_dbus_emit_property_changed (device,
-					      "Profiles",
-					      cd_device_get_profiles_as_variant (device));
+					      CD_DEVICE_PROPERTY_PROFILES,
+					      cd_device_get_profiles_cached (device));
 
 	/* emit global signal */
 	cd_device_dbus_emit_device_changed (device);
 }
 
+static GVariant *
+cd_device_get_inhibitors_cached (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_auto(GStrv) bus_names = NULL;
+
+	/* only rebuilt when an inhibitor is added or removed */
+	if (priv->inhibitors_variant == NULL) {
+		bus_names = cd_inhibit_get_bus_names (priv->inhibit);
+		priv->inhibitors_variant = g_variant_ref_sink (g_variant_new_strv ((const gchar * const *) bus_names, -1));
+	}
+	return priv->inhibitors_variant;
+}
+
 static GVariant *
 cd_device_dbus_get_property (GDBusConnection *connection_, const gchar *sender,
 			     const gchar *object_path, const gchar *interface_name,
@@ -1423,7 +1694,6 @@ cd_device_dbus_get_property (GDBusConnection *connection_, const gchar *sender,
 {
 	CdDevice *device = CD_DEVICE (user_data);
 	CdDevicePrivate *priv = GET_PRIVATE (device);
-	g_auto(GStrv) bus_names = NULL;
 
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_CREATED) == 0)
 		return g_variant_new_uint64 (priv->created);
@@ -1448,9 +1718,9 @@ cd_device_dbus_get_property (GDBusConnection *connection_, const gchar *sender,
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_ID) == 0)
 		return g_variant_new_string (priv->id);
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_PROFILES) == 0)
-		return cd_device_get_profiles_as_variant (device);
+		return g_variant_ref (cd_device_get_profiles_cached (device));
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_METADATA) == 0)
-		return cd_device_get_metadata_as_variant (device);
+		return g_variant_ref (cd_device_get_metadata_cached (device));
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_SCOPE) == 0)
 		return g_variant_new_string (cd_object_scope_to_string (priv->object_scope));
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_OWNER) == 0)
@@ -1459,10 +1729,8 @@ cd_device_dbus_get_property (GDBusConnection *connection_, const gchar *sender,
 		return cd_device_get_nullable_for_string (priv->seat);
 	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_EMBEDDED) == 0)
 		return g_variant_new_boolean (priv->embedded);
-	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_PROFILING_INHIBITORS) == 0) {
-		bus_names = cd_inhibit_get_bus_names (priv->inhibit);
-		return g_variant_new_strv ((const gchar * const *) bus_names, -1);
-	}
+	if (g_strcmp0 (property_name, CD_DEVICE_PROPERTY_PROFILING_INHIBITORS) == 0)
+		return g_variant_ref (cd_device_get_inhibitors_cached (device));
 
 	/* return an error */
 	g_set_error (error,
@@ -1473,6 +1741,39 @@ cd_device_dbus_get_property (GDBusConnection *connection_, const gchar *sender,
 	return NULL;
 }
 
+GVariant *
+cd_device_get_properties (CdDevice *device,
+			  GDBusInterfaceInfo *info,
+			  const gchar *sender)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	GDBusPropertyInfo *property;
+	GVariantBuilder builder;
+
+	/* the same values Properties.GetAll() would return */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	for (guint i = 0; info->properties[i] != NULL; i++) {
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GVariant) value = NULL;
+
+		property = info->properties[i];
+		if ((property->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE) == 0)
+			continue;
+		value = cd_device_dbus_get_property (priv->connection, sender,
+						     priv->object_path, info->name,
+						     property->name, &error, device);
+		if (value == NULL) {
+			g_debug ("CdDevice: failed to get %s: %s",
+				 property->name,
+				 error != NULL ? error->message : "unknown");
+			continue;
+		}
+		g_variant_take_ref (value);
+		g_variant_builder_add (&builder, "{sv}", property->name, value);
+	}
+	return g_variant_builder_end (&builder);
+}
+
 gboolean
 cd_device_register_object (CdDevice *device,
 			   GDBusConnection *connection,
@@ -1483,7 +1784,7 @@ cd_device_register_object (CdDevice *device,
 	g_autoptr(GError) error_local = NULL;
 
 	static const GDBusInterfaceVTable interface_vtable = {
-		cd_device_dbus_method_call,
+		cd_device_dbus_method_call_timed,
 		cd_device_dbus_get_property,
 		NULL
 	};
@@ -1511,6 +1812,18 @@ cd_device_register_object (CdDevice *device,
 	return TRUE;
 }
 
+/* so that another device can be registered at the same object path */
+void
+cd_device_unregister_object (CdDevice *device)
+{
+	CdDevicePrivate *priv = GET_PRIVATE (device);
+	if (priv->registration_id == 0)
+		return;
+	g_dbus_connection_unregister_object (priv->connection,
+					     priv->registration_id);
+	priv->registration_id = 0;
+}
+
 static void
 cd_device_name_vanished_cb (GDBusConnection *connection,
 			    const gchar *name,
@@ -1549,6 +1862,9 @@ cd_device_get_property (GObject *object, guint prop_id, GValue *value, GParamSpe
 	case PROP_ID:
 		g_value_set_string (value, priv->id);
 		break;
+	case PROP_METADATA:
+		g_value_set_boxed (value, priv->metadata);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -1601,6 +1917,16 @@ cd_device_class_init (CdDeviceClass *klass)
 				     G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_ID, pspec);
 
+	/**
+	 * CdDevice:metadata:
+	 *
+	 * The device metadata, as a string to string hash table.
+	 */
+	pspec = g_param_spec_boxed ("metadata", NULL, NULL,
+				    G_TYPE_HASH_TABLE,
+				    G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_METADATA, pspec);
+
 	/**
 	 * CdDevice::invalidate:
 	 **/
@@ -1623,7 +1949,9 @@ static void
 cd_device_init (CdDevice *device)
 {
 	CdDevicePrivate *priv = GET_PRIVATE (device);
+	g_atomic_int_inc (&cd_device_live_count);
 	priv->profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_device_profiles_item_free);
+	priv->profiles_by_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	priv->profile_array = cd_profile_array_new ();
 	priv->created = g_get_real_time ();
 	priv->modified = g_get_real_time ();
@@ -1636,8 +1964,12 @@ cd_device_init (CdDevice *device)
 			  device);
 	priv->metadata = g_hash_table_new_full (g_str_hash,
 							 g_str_equal,
-							 g_free,
-							 g_free);
+							 cd_string_pool_release,
+							 cd_string_pool_release);
+	priv->qualifier_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, cd_device_qualifier_cache_free);
+	priv->pending_properties = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  g_free, (GDestroyNotify) g_variant_unref);
 }
 
 static void
@@ -1664,12 +1996,28 @@ cd_device_finalize (GObject *object)
 	g_free (priv->serial);
 	g_free (priv->seat);
 	g_free (priv->object_path);
+	g_hash_table_unref (priv->profiles_by_path);
+	for (guint i = 0; i < priv->profiles->len; i++) {
+		CdDeviceProfileItem *item = g_ptr_array_index (priv->profiles, i);
+		cd_profile_array_release (priv->profile_array, item->profile);
+	}
 	g_ptr_array_unref (priv->profiles);
 	g_object_unref (priv->profile_array);
 	g_object_unref (priv->mapping_db);
 	g_object_unref (priv->device_db);
 	g_object_unref (priv->inhibit);
 	g_hash_table_unref (priv->metadata);
+	if (priv->metadata_variant != NULL)
+		g_variant_unref (priv->metadata_variant);
+	if (priv->profiles_variant != NULL)
+		g_variant_unref (priv->profiles_variant);
+	if (priv->inhibitors_variant != NULL)
+		g_variant_unref (priv->inhibitors_variant);
+	g_hash_table_unref (priv->qualifier_cache);
+	if (priv->pending_id != 0)
+		g_source_remove (priv->pending_id);
+	g_hash_table_unref (priv->pending_properties);
+	g_atomic_int_add (&cd_device_live_count, -1);
 
 	G_OBJECT_CLASS (cd_device_parent_class)->finalize (object);
 }
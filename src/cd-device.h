@@ -83,6 +83,10 @@ gboolean	 cd_device_register_object		(CdDevice	*device,
 							 GDBusInterfaceInfo *info,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_device_unregister_object		(CdDevice	*device);
+GVariant	*cd_device_get_properties		(CdDevice	*device,
+							 GDBusInterfaceInfo *info,
+							 const gchar	*sender);
 void		 cd_device_watch_sender			(CdDevice	*device,
 							 const gchar	*sender);
 gboolean	 cd_device_set_property_internal	(CdDevice	*device,
@@ -92,6 +96,13 @@ gboolean	 cd_device_set_property_internal	(CdDevice	*device,
 							 GError		**error);
 const gchar	*cd_device_get_metadata			(CdDevice	*device,
 							 const gchar	*key);
+GVariant	*cd_device_get_state			(CdDevice	*device);
+guint		 cd_device_get_live_count		(void);
+gsize		 cd_device_get_memory_size		(CdDevice	*device);
+gboolean	 cd_device_set_state			(CdDevice	*device,
+							 GVariant	*state,
+							 GError		**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -33,6 +33,7 @@ static void     cd_inhibit_finalize	(GObject     *object);
 typedef struct
 {
 	GPtrArray			*array;
+	GHashTable			*hash;	/* sender : CdInhibitItem */
 } CdInhibitPrivate;
 
 typedef struct {
@@ -88,17 +89,8 @@ static CdInhibitItem *
 cd_inhibit_get_by_sender (CdInhibit *inhibit,
 			  const gchar *sender)
 {
-	CdInhibitItem *item_tmp;
 	CdInhibitPrivate *priv = GET_PRIVATE (inhibit);
-	guint i;
-
-	/* find sender */
-	for (i = 0; i < priv->array->len; i++) {
-		item_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (item_tmp->sender, sender) == 0)
-			return item_tmp;
-	}
-	return NULL;
+	return g_hash_table_lookup (priv->hash, sender);
 }
 
 gboolean
@@ -120,6 +112,7 @@ cd_inhibit_remove (CdInhibit *inhibit, const gchar *sender, GError **error)
 	}
  
 	/* remove */
+	g_hash_table_remove (priv->hash, sender);
 	if (!g_ptr_array_remove (priv->array, item)) {
 		g_set_error (error, 1, 0,
 			     "cannot remove inhibit item for %s",
@@ -179,6 +172,7 @@ cd_inhibit_add (CdInhibit *inhibit, const gchar *sender, GError **error)
 					     g_object_ref (inhibit),
 					     g_object_unref);
 	g_ptr_array_add (priv->array, item);
+	g_hash_table_insert (priv->hash, item->sender, item);
 
 	/* emit signal */
 	g_debug ("CdInhibit: emit changed");
@@ -205,6 +199,7 @@ cd_inhibit_init (CdInhibit *inhibit)
 {
 	CdInhibitPrivate *priv = GET_PRIVATE (inhibit);
 	priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_inhibit_item_free);
+	priv->hash = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static void
@@ -213,6 +208,7 @@ cd_inhibit_finalize (GObject *object)
 	CdInhibit *inhibit = CD_INHIBIT (object);
 	CdInhibitPrivate *priv = GET_PRIVATE (inhibit);
 
+	g_hash_table_unref (priv->hash);
 	g_ptr_array_unref (priv->array);
 
 	G_OBJECT_CLASS (cd_inhibit_parent_class)->finalize (object);
@@ -19,12 +19,21 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+/* for memfd_create() and the F_ADD_SEALS fcntl */
+#define _GNU_SOURCE
+
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <gio/gio.h>
 #ifdef __unix__
 #include <gio/gunixfdlist.h>
+#include <glib-unix.h>
+#include <signal.h>
 #endif
 #include <glib/gi18n.h>
 #include <locale.h>
@@ -34,26 +43,42 @@
 #endif
 
 #include "cd-common.h"
+#include "cd-context-lcms.h"
+#include "cd-dbus-interfaces.h"
 #include "cd-debug.h"
 #include "cd-device-array.h"
 #include "cd-device-db.h"
 #include "cd-device.h"
 #include "cd-mapping-db.h"
+#include "cd-metrics.h"
 #include "cd-plugin.h"
 #include "cd-profile-array.h"
 #include "cd-profile-db.h"
 #include "cd-profile.h"
+#include "cd-icc-private.h"
+#include "cd-icc-store-private.h"
 #include "cd-icc-store.h"
+#include "cd-provision.h"
+#include "cd-sensor-cache.h"
 #include "cd-sensor-client.h"
+#include "cd-state.h"
+#include "cd-trace-private.h"
 
 #include "colord-resources.h"
 
+typedef enum {
+	CD_MAIN_STARTUP_STAGE_STARTING,
+	CD_MAIN_STARTUP_STAGE_CORE,
+	CD_MAIN_STARTUP_STAGE_PROFILES,
+	CD_MAIN_STARTUP_STAGE_COMPLETE
+} CdMainStartupStage;
+
 typedef struct {
 	GDBusConnection		*connection;
-	GDBusNodeInfo		*introspection_daemon;
-	GDBusNodeInfo		*introspection_device;
-	GDBusNodeInfo		*introspection_profile;
-	GDBusNodeInfo		*introspection_sensor;
+	GDBusInterfaceInfo	*introspection_daemon;
+	GDBusInterfaceInfo	*introspection_device;
+	GDBusInterfaceInfo	*introspection_profile;
+	GDBusInterfaceInfo	*introspection_sensor;
 	CdDeviceArray		*devices_array;
 	CdProfileArray		*profiles_array;
 	CdIccStore		*icc_store;
@@ -62,14 +87,166 @@ typedef struct {
 	CdProfileDb		*profile_db;
 	CdSensorClient		*sensor_client;
 	GPtrArray		*sensors;
+	GVariant		*sensors_variant;	/* cached GetSensors() reply */
 	GPtrArray		*plugins;
 	GMainLoop		*loop;
-	gboolean		 create_dummy_sensor;
+	guint			 create_dummy_sensors;
+	guint			 max_profile_objects;	/* 0 for unlimited */
 	gboolean		 always_use_xrandr_name;
 	gchar			*system_vendor;
 	gchar			*system_model;
+	GPtrArray		*devices_added;		/* object paths */
+	GPtrArray		*profiles_added;	/* object paths */
+	guint			 added_id;
+	CdMainStartupStage	 startup_stage;
+	guint			 startup_step;
+	guint			 startup_id;
+	GHashTable		*snapshot_fds;		/* uid : CdMainSnapshotFd */
+	GHashTable		*edids;			/* MD5 : CdEdid */
+	guint			 sensor_group_idx;
+	struct _CdMainReadSnapshot *read_snapshot;	/* under cd_main_read_snapshot */
+	gint			 read_snapshot_pending;
+	guint			 read_filter_id;
+	GHashTable		*plugin_device_ids;	/* id */
+	GHashTable		*restored_devices;	/* id : CdDevice */
+	GHashTable		*imported_files;	/* filename : sender */
+	guint			 name_owner_changed_id;
+	guint			 restored_id;
+	gchar			*root_dir;
 } CdMainPrivate;
 
+#define CD_MAIN_ADDED_DELAY		100 /* ms */
+#define CD_MAIN_SNAPSHOT_VERSION	1
+#define CD_MAIN_STATE_FILENAME		LOCALSTATEDIR "/lib/colord/state.gvariant"
+#define CD_MAIN_RESTORED_TIMEOUT	10 /* s */
+
+/* everything the daemon reads or writes can be moved below --root-dir, which
+ * lets the benchmarks and tests run against synthetic data */
+static gchar *
+cd_main_get_path (CdMainPrivate *priv, const gchar *path)
+{
+	if (priv->root_dir == NULL)
+		return g_strdup (path);
+	return g_build_filename (priv->root_dir, path, NULL);
+}
+
+static gboolean
+cd_main_icc_store_search_kind (CdMainPrivate *priv,
+			       CdIccStoreSearchKind search_kind,
+			       CdIccStoreSearchFlags search_flags,
+			       GError **error)
+{
+	g_autoptr(GPtrArray) locations = NULL;
+
+	if (priv->root_dir == NULL) {
+		return cd_icc_store_search_kind (priv->icc_store,
+						 search_kind,
+						 search_flags,
+						 NULL,
+						 error);
+	}
+
+	/* the same locations, but below the root */
+	locations = cd_icc_store_get_search_locations (search_kind);
+	for (guint i = 0; i < locations->len; i++) {
+		g_autofree gchar *location = NULL;
+		location = cd_main_get_path (priv, g_ptr_array_index (locations, i));
+		if (!cd_icc_store_search_location (priv->icc_store,
+						   location,
+						   search_flags,
+						   NULL,
+						   error))
+			return FALSE;
+
+		/* only create the first location */
+		search_flags &= ~CD_ICC_STORE_SEARCH_FLAGS_CREATE_LOCATION;
+	}
+	return TRUE;
+}
+
+/* only files in the directories the store watches get an add event */
+static gboolean
+cd_main_icc_store_is_search_location (CdMainPrivate *priv, const gchar *filename)
+{
+	const CdIccStoreSearchKind search_kinds[] = {
+		CD_ICC_STORE_SEARCH_KIND_SYSTEM,
+		CD_ICC_STORE_SEARCH_KIND_MACHINE,
+		CD_ICC_STORE_SEARCH_KIND_LAST };
+
+	for (guint j = 0; search_kinds[j] != CD_ICC_STORE_SEARCH_KIND_LAST; j++) {
+		g_autoptr(GPtrArray) locations = NULL;
+		locations = cd_icc_store_get_search_locations (search_kinds[j]);
+		for (guint i = 0; i < locations->len; i++) {
+			g_autofree gchar *location = NULL;
+			g_autofree gchar *prefix = NULL;
+			location = cd_main_get_path (priv, g_ptr_array_index (locations, i));
+			prefix = g_strconcat (location, G_DIR_SEPARATOR_S, NULL);
+			if (g_str_has_prefix (filename, prefix))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void
+cd_main_emit_added (CdMainPrivate *priv,
+		    GPtrArray *object_paths,
+		    const gchar *signal_name)
+{
+	GVariantBuilder builder;
+
+	if (object_paths->len == 0)
+		return;
+	g_debug ("CdMain: Emitting %s(%u)", signal_name, object_paths->len);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("ao"));
+	for (guint i = 0; i < object_paths->len; i++) {
+		g_variant_builder_add_value (&builder,
+					     g_variant_new_object_path (g_ptr_array_index (object_paths, i)));
+	}
+	g_dbus_connection_emit_signal (priv->connection,
+				       NULL,
+				       COLORD_DBUS_PATH,
+				       COLORD_DBUS_INTERFACE,
+				       signal_name,
+				       g_variant_new ("(ao)", &builder),
+				       NULL);
+	g_ptr_array_set_size (object_paths, 0);
+}
+
+static gboolean
+cd_main_added_cb (gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	priv->added_id = 0;
+	cd_main_emit_added (priv, priv->devices_added, "DevicesAdded");
+	cd_main_emit_added (priv, priv->profiles_added, "ProfilesAdded");
+	return G_SOURCE_REMOVE;
+}
+
+/* objects added in a short window are also announced in one signal */
+static void
+cd_main_queue_added (CdMainPrivate *priv,
+		     GPtrArray *object_paths,
+		     const gchar *object_path)
+{
+	cd_object_generation_bump ();
+	g_ptr_array_add (object_paths, g_strdup (object_path));
+	if (priv->added_id == 0) {
+		priv->added_id = g_timeout_add (CD_MAIN_ADDED_DELAY,
+						cd_main_added_cb,
+						priv);
+	}
+}
+
+static void
+cd_main_queue_removed (GPtrArray *object_paths, const gchar *object_path)
+{
+	guint idx;
+	if (g_ptr_array_find_with_equal_func (object_paths, object_path,
+					      g_str_equal, &idx))
+		g_ptr_array_remove_index (object_paths, idx);
+}
+
 static void
 cd_main_profile_removed (CdMainPrivate *priv, CdProfile *profile)
 {
@@ -79,9 +256,15 @@ cd_main_profile_removed (CdMainPrivate *priv, CdProfile *profile)
 	g_autofree gchar *object_path_tmp = NULL;
 	g_autoptr(GPtrArray) devices = NULL;
 
+	/* the store add for an import is no longer expected */
+	if (cd_profile_get_scope (profile) == CD_OBJECT_SCOPE_NORMAL &&
+	    cd_profile_get_filename (profile) != NULL)
+		g_hash_table_remove (priv->imported_files, cd_profile_get_filename (profile));
+
 	/* remove from the array before emitting */
 	object_path_tmp = g_strdup (cd_profile_get_object_path (profile));
 	cd_profile_array_remove (priv->profiles_array, profile);
+	cd_main_queue_removed (priv->profiles_added, object_path_tmp);
 
 	/* try to remove this profile from all devices */
 	devices = cd_device_array_get_array (priv->devices_array);
@@ -101,6 +284,7 @@ cd_main_profile_removed (CdMainPrivate *priv, CdProfile *profile)
 	}
 
 	/* emit signal */
+	cd_object_generation_bump ();
 	g_debug ("CdMain: Emitting ProfileRemoved(%s)", object_path_tmp);
 	g_info ("Profile removed: %s", cd_profile_get_id (profile));
 	g_dbus_connection_emit_signal (priv->connection,
@@ -134,6 +318,7 @@ cd_main_device_removed (CdMainPrivate *priv, CdDevice *device)
 	/* remove from the array before emitting */
 	object_path_tmp = g_strdup (cd_device_get_object_path (device));
 	g_debug ("CdMain: Removing device %s", object_path_tmp);
+	cd_main_queue_removed (priv->devices_added, object_path_tmp);
 	cd_device_array_remove (priv->devices_array, device);
 
 	/* remove from the device database */
@@ -150,6 +335,7 @@ cd_main_device_removed (CdMainPrivate *priv, CdDevice *device)
 	}
 
 	/* emit signal */
+	cd_object_generation_bump ();
 	g_debug ("CdMain: Emitting DeviceRemoved(%s)", object_path_tmp);
 	g_info ("device removed: %s", cd_device_get_id (device));
 	g_dbus_connection_emit_signal (priv->connection,
@@ -160,6 +346,11 @@ cd_main_device_removed (CdMainPrivate *priv, CdDevice *device)
 				       g_variant_new ("(o)",
 						      object_path_tmp),
 				       &error);
+
+	/* this may drop the last reference */
+	g_hash_table_remove (priv->plugin_device_ids, cd_device_get_id (device));
+	if (g_hash_table_lookup (priv->restored_devices, cd_device_get_id (device)) == device)
+		g_hash_table_remove (priv->restored_devices, cd_device_get_id (device));
 }
 
 static void
@@ -242,9 +433,9 @@ cd_main_create_profile (CdMainPrivate *priv,
 }
 
 static gboolean
-cd_main_auto_add_from_md (CdMainPrivate *priv,
-			  CdDevice *device,
-			  CdProfile *profile)
+cd_main_auto_add_from_md_real (CdMainPrivate *priv,
+			       CdDevice *device,
+			       CdProfile *profile)
 {
 	const gchar *device_id;
 	const gchar *profile_id;
@@ -298,6 +489,18 @@ cd_main_auto_add_from_md (CdMainPrivate *priv,
 	return TRUE;
 }
 
+static gboolean
+cd_main_auto_add_from_md (CdMainPrivate *priv,
+			  CdDevice *device,
+			  CdProfile *profile)
+{
+	gboolean ret;
+	CD_TRACE2 (auto_add_md_begin, cd_device_get_id (device), cd_profile_get_id (profile));
+	ret = cd_main_auto_add_from_md_real (priv, device, profile);
+	CD_TRACE2 (auto_add_md_end, cd_device_get_id (device), ret);
+	return ret;
+}
+
 static gboolean
 cd_main_auto_add_from_db (CdMainPrivate *priv,
 			  CdDevice *device,
@@ -420,7 +623,7 @@ cd_main_device_register_on_bus (CdMainPrivate *priv,
 	/* register object */
 	if (!cd_device_register_object (device,
 					priv->connection,
-					priv->introspection_device->interfaces[0],
+					priv->introspection_device,
 					error))
 		return FALSE;
 
@@ -436,6 +639,8 @@ cd_main_device_register_on_bus (CdMainPrivate *priv,
 				       g_variant_new ("(o)",
 						      cd_device_get_object_path (device)),
 				       NULL);
+	cd_main_queue_added (priv, priv->devices_added,
+			     cd_device_get_object_path (device));
 	return TRUE;
 }
 
@@ -450,6 +655,7 @@ cd_main_device_add (CdMainPrivate *priv,
 
 	/* create an object */
 	g_debug ("CdMain: Adding device %s", cd_device_get_object_path (device));
+	CD_TRACE1 (device_add_begin, cd_device_get_id (device));
 
 	/* different persistent scope */
 	scope = cd_device_get_scope (device);
@@ -460,8 +666,10 @@ cd_main_device_add (CdMainPrivate *priv,
 		ret = cd_device_db_add (priv->device_db,
 					cd_device_get_id (device),
 					error);
-		if (!ret)
+		if (!ret) {
+			CD_TRACE1 (device_add_end, cd_device_get_id (device));
 			return FALSE;
+		}
 	}
 
 	/* profile is no longer valid */
@@ -477,6 +685,7 @@ cd_main_device_add (CdMainPrivate *priv,
 	/* auto add profiles from the database and metadata */
 	cd_main_device_auto_add_from_db (priv, device);
 	cd_main_device_auto_add_from_md (priv, device);
+	CD_TRACE1 (device_add_end, cd_device_get_id (device));
 	return TRUE;
 }
 
@@ -517,19 +726,15 @@ cd_main_create_device (CdMainPrivate *priv,
 		       const gchar *sender,
 		       const gchar *device_id,
 		       guint owner,
-		       guint process,
+		       const gchar *seat,
 		       CdObjectScope scope,
 		       CdDeviceMode mode,
 		       GError **error)
 {
-	g_autofree gchar *seat = NULL;
 	g_autoptr(CdDevice) device_tmp = NULL;
 
 	g_assert (priv->connection != NULL);
 
-	/* get the seat of the process that is creating the device */
-	seat = cd_main_get_seat_for_process (process);
-
 	/* create an object */
 	device_tmp = cd_device_new ();
 	cd_device_set_owner (device_tmp, owner);
@@ -550,6 +755,17 @@ cd_main_create_device (CdMainPrivate *priv,
 	return g_object_ref (device_tmp);
 }
 
+/* the seat of the process that is creating the device */
+static const gchar *
+cd_main_credentials_get_seat (CdMainCredentials *credentials)
+{
+	if (!credentials->seat_valid) {
+		credentials->seat = cd_main_get_seat_for_process (credentials->pid);
+		credentials->seat_valid = TRUE;
+	}
+	return credentials->seat;
+}
+
 static GVariant *
 cd_main_device_array_to_variant (GPtrArray *array, guint uid)
 {
@@ -583,29 +799,6 @@ cd_main_device_array_to_variant (GPtrArray *array, guint uid)
 				    length);
 }
 
-static GVariant *
-cd_main_profile_array_to_variant (GPtrArray *array)
-{
-	CdProfile *profile;
-	guint i;
-	guint length = 0;
-	g_autofree GVariant **variant_array = NULL;
-
-	/* copy the object paths */
-	variant_array = g_new0 (GVariant *, array->len + 1);
-	for (i = 0; i < array->len; i++) {
-		profile = g_ptr_array_index (array, i);
-		variant_array[length] = g_variant_new_object_path (
-			cd_profile_get_object_path (profile));
-		length++;
-	}
-
-	/* format the value */
-	return g_variant_new_array (G_VARIANT_TYPE_OBJECT_PATH,
-				    variant_array,
-				    length);
-}
-
 static GVariant *
 cd_main_sensor_array_to_variant (GPtrArray *array)
 {
@@ -699,6 +892,25 @@ typedef enum {
 	CD_LOGGING_FLAG_LAST
 } CdLoggingFlags;
 
+static void
+cd_main_profile_emit_added (CdMainPrivate *priv,
+			    const gchar *profile_id,
+			    const gchar *object_path,
+			    CdLoggingFlags logging)
+{
+	g_debug ("CdMain: Emitting ProfileAdded(%s)", object_path);
+	if ((logging & CD_LOGGING_FLAG_SYSLOG) > 0)
+		g_info ("Profile added: %s", profile_id);
+	g_dbus_connection_emit_signal (priv->connection,
+				       NULL,
+				       COLORD_DBUS_PATH,
+				       COLORD_DBUS_INTERFACE,
+				       "ProfileAdded",
+				       g_variant_new ("(o)", object_path),
+				       NULL);
+	cd_main_queue_added (priv, priv->profiles_added, object_path);
+}
+
 static gboolean
 cd_main_profile_register_on_bus (CdMainPrivate *priv,
 				 CdProfile *profile,
@@ -708,23 +920,15 @@ cd_main_profile_register_on_bus (CdMainPrivate *priv,
 	/* register object */
 	if (!cd_profile_register_object (profile,
 					 priv->connection,
-					 priv->introspection_profile->interfaces[0],
+					 priv->introspection_profile,
 					 error))
 		return FALSE;
 
 	/* emit signal */
-	g_debug ("CdMain: Emitting ProfileAdded(%s)",
-		 cd_profile_get_object_path (profile));
-	if ((logging & CD_LOGGING_FLAG_SYSLOG) > 0)
-		g_info ("Profile added: %s", cd_profile_get_id (profile));
-	g_dbus_connection_emit_signal (priv->connection,
-				       NULL,
-				       COLORD_DBUS_PATH,
-				       COLORD_DBUS_INTERFACE,
-				       "ProfileAdded",
-				       g_variant_new ("(o)",
-						      cd_profile_get_object_path (profile)),
-				       NULL);
+	cd_main_profile_emit_added (priv,
+				    cd_profile_get_id (profile),
+				    cd_profile_get_object_path (profile),
+				    logging);
 	return TRUE;
 }
 
@@ -814,6 +1018,284 @@ cd_main_get_cmdline_for_pid (guint pid)
 	return cmdline;
 }
 
+static const gchar *
+cd_main_credentials_get_cmdline (CdMainCredentials *credentials)
+{
+	if (!credentials->cmdline_valid) {
+		credentials->cmdline = cd_main_get_cmdline_for_pid (credentials->pid);
+		credentials->cmdline_valid = TRUE;
+	}
+	return credentials->cmdline;
+}
+
+/* returns a floating (a(oa{sv})a(oa{sv})) of everything @uid can see */
+static GVariant *
+cd_main_get_snapshot (CdMainPrivate *priv, guint uid, const gchar *sender)
+{
+	GVariantBuilder devices_builder;
+	GVariantBuilder profiles_builder;
+	guint i;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) profiles = NULL;
+
+	/* devices, filtered exactly like GetDevices() */
+	g_variant_builder_init (&devices_builder, G_VARIANT_TYPE ("a(oa{sv})"));
+	devices = cd_device_array_get_array (priv->devices_array);
+	for (i = 0; i < devices->len; i++) {
+		CdDevice *device_tmp = g_ptr_array_index (devices, i);
+		if (uid != 0 &&
+		    cd_device_get_owner (device_tmp) != 0 &&
+		    cd_device_get_owner (device_tmp) != uid)
+			continue;
+		g_variant_builder_add (&devices_builder, "(o@a{sv})",
+				       cd_device_get_object_path (device_tmp),
+				       cd_device_get_properties (device_tmp,
+								 priv->introspection_device,
+								 sender));
+	}
+
+	/* all profiles, like GetProfiles() */
+	g_variant_builder_init (&profiles_builder, G_VARIANT_TYPE ("a(oa{sv})"));
+	profiles = cd_profile_array_get_array (priv->profiles_array);
+	for (i = 0; i < profiles->len; i++) {
+		CdProfile *profile_tmp = g_ptr_array_index (profiles, i);
+		g_variant_builder_add (&profiles_builder, "(o@a{sv})",
+				       cd_profile_get_object_path (profile_tmp),
+				       cd_profile_get_properties (profile_tmp,
+								  priv->introspection_profile,
+								  sender));
+	}
+	return g_variant_new ("(a(oa{sv})a(oa{sv}))",
+			      &devices_builder,
+			      &profiles_builder);
+}
+
+typedef struct {
+	guint64		 generation;
+	gint		 fd;
+} CdMainSnapshotFd;
+
+static void
+cd_main_snapshot_fd_free (CdMainSnapshotFd *snapshot_fd)
+{
+	close (snapshot_fd->fd);
+	g_free (snapshot_fd);
+}
+
+/* writes the snapshot into a sealed memfd, so it can be shared read-only
+ * with every client until something changes */
+static gint
+cd_main_snapshot_fd_create (GVariant *snapshot, GError **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+	const guint8 *data;
+	gint fd;
+	gsize len;
+	gsize done = 0;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GVariant) normal = NULL;
+
+	normal = g_variant_get_normal_form (snapshot);
+	bytes = g_variant_get_data_as_bytes (normal);
+	data = g_bytes_get_data (bytes, &len);
+	fd = memfd_create ("colord-snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "failed to create memfd: %s",
+			     g_strerror (errno));
+		return -1;
+	}
+	while (done < len) {
+		gssize wrote = write (fd, data + done, len - done);
+		if (wrote < 0) {
+			if (errno == EINTR)
+				continue;
+			g_set_error (error,
+				     CD_CLIENT_ERROR,
+				     CD_CLIENT_ERROR_INTERNAL,
+				     "failed to write memfd: %s",
+				     g_strerror (errno));
+			close (fd);
+			return -1;
+		}
+		done += (gsize) wrote;
+	}
+	if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+				    F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "failed to seal memfd: %s",
+			     g_strerror (errno));
+		close (fd);
+		return -1;
+	}
+	return fd;
+#else
+	g_set_error_literal (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_NOT_SUPPORTED,
+			     "memfd is not supported");
+	return -1;
+#endif
+}
+
+static void
+cd_main_get_snapshot_fd (CdMainPrivate *priv,
+			 GDBusMethodInvocation *invocation,
+			 guint uid,
+			 const gchar *sender)
+{
+	CdMainSnapshotFd *snapshot_fd;
+	guint64 generation = cd_object_generation_get ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GUnixFDList) fd_list = NULL;
+
+	/* reuse the sealed copy if nothing has changed */
+	snapshot_fd = g_hash_table_lookup (priv->snapshot_fds, GUINT_TO_POINTER (uid));
+	if (snapshot_fd == NULL || snapshot_fd->generation != generation) {
+		GVariant *snapshot;
+		gint fd;
+		snapshot = g_variant_new ("(ut@(a(oa{sv})a(oa{sv})))",
+					  (guint32) CD_MAIN_SNAPSHOT_VERSION,
+					  generation,
+					  cd_main_get_snapshot (priv, uid, sender));
+		g_variant_ref_sink (snapshot);
+		fd = cd_main_snapshot_fd_create (snapshot, &error);
+		g_variant_unref (snapshot);
+		if (fd < 0) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		snapshot_fd = g_new0 (CdMainSnapshotFd, 1);
+		snapshot_fd->generation = generation;
+		snapshot_fd->fd = fd;
+		g_hash_table_insert (priv->snapshot_fds, GUINT_TO_POINTER (uid), snapshot_fd);
+	}
+
+	/* the list holds a duplicate, so the cached fd stays open */
+	fd_list = g_unix_fd_list_new ();
+	if (g_unix_fd_list_append (fd_list, snapshot_fd->fd, &error) < 0) {
+		g_dbus_method_invocation_return_gerror (invocation, error);
+		return;
+	}
+	g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+								 g_variant_new ("(ht)", 0, generation),
+								 fd_list);
+}
+
+static void cd_main_add_sensor (CdMainPrivate *priv, CdSensor *sensor);
+static void cd_main_remove_sensor (CdMainPrivate *priv, CdSensor *sensor);
+
+static void
+cd_main_sensor_group_invalidate_cb (CdSensor *sensor, gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	g_debug ("CdMain: sensor group '%s' invalidated",
+		 cd_sensor_get_id (sensor));
+	cd_main_remove_sensor (priv, sensor);
+}
+
+static void	cd_main_daemon_method_call_timed (GDBusConnection *connection,
+						  const gchar *sender,
+						  const gchar *object_path,
+						  const gchar *interface_name,
+						  const gchar *method_name,
+						  GVariant *parameters,
+						  GDBusMethodInvocation *invocation,
+						  gpointer user_data);
+
+static void
+cd_main_memory_stats_add (GVariantBuilder *builder,
+			  const gchar *tag,
+			  guint64 count,
+			  guint64 bytes)
+{
+	g_variant_builder_add (builder, "{s(tt)}", tag, count, bytes);
+}
+
+/* returns a floating a{s(tt)} of subsystem : (count, estimated bytes) */
+static GVariant *
+cd_main_get_memory_stats (CdMainPrivate *priv)
+{
+	GVariantBuilder builder;
+	gsize bytes = 0;
+	gsize bytes_handles = 0;
+	gsize bytes_mapped = 0;
+	guint n_handles = 0;
+	guint n_mapped = 0;
+	int sqlite_cur = 0;
+	int sqlite_count = 0;
+	int sqlite_hiwtr = 0;
+	int sqlite_pages = 0;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) iccs = NULL;
+	g_autoptr(GPtrArray) profiles = NULL;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(tt)}"));
+
+	/* the live objects can be more than the ones we hold, and a gap
+	 * between the two that grows over time is a leak */
+	if (priv->icc_store != NULL) {
+		iccs = cd_icc_store_get_all (priv->icc_store);
+		for (guint i = 0; i < iccs->len; i++) {
+			gboolean has_handle = FALSE;
+			gsize tmp = cd_icc_get_memory_size (g_ptr_array_index (iccs, i),
+							    &has_handle);
+			bytes += tmp;
+			if (has_handle) {
+				bytes_handles += tmp;
+				n_handles++;
+			}
+		}
+	}
+	cd_main_memory_stats_add (&builder, "icc", cd_icc_get_live_count (), 0);
+	cd_main_memory_stats_add (&builder, "icc.store", iccs != NULL ? iccs->len : 0, bytes);
+	cd_main_memory_stats_add (&builder, "icc.handles", n_handles, bytes_handles);
+	cd_main_memory_stats_add (&builder, "lcms.contexts",
+				  cd_context_lcms_get_live_count (), 0);
+
+	bytes = 0;
+	profiles = cd_profile_array_get_array (priv->profiles_array);
+	for (guint i = 0; i < profiles->len; i++) {
+		gsize mapped = 0;
+		bytes += cd_profile_get_memory_size (g_ptr_array_index (profiles, i),
+						     &mapped);
+		if (mapped > 0) {
+			bytes_mapped += mapped;
+			n_mapped++;
+		}
+	}
+	cd_main_memory_stats_add (&builder, "profile", cd_profile_get_live_count (), 0);
+	cd_main_memory_stats_add (&builder, "profile.registered", profiles->len, bytes);
+	cd_main_memory_stats_add (&builder, "profile.mapped", n_mapped, bytes_mapped);
+
+	bytes = 0;
+	devices = cd_device_array_get_array (priv->devices_array);
+	for (guint i = 0; i < devices->len; i++)
+		bytes += cd_device_get_memory_size (g_ptr_array_index (devices, i));
+	cd_main_memory_stats_add (&builder, "device", cd_device_get_live_count (), 0);
+	cd_main_memory_stats_add (&builder, "device.registered", devices->len, bytes);
+
+	cd_main_memory_stats_add (&builder, "sensor", priv->sensors->len,
+				  priv->sensors_variant != NULL ?
+				  g_variant_get_size (priv->sensors_variant) : 0);
+	cd_main_memory_stats_add (&builder, "edid", g_hash_table_size (priv->edids), 0);
+
+	/* everything SQLite allocates, of which the page cache is a part;
+	 * without SQLITE_CONFIG_PAGECACHE the pages are all overflow bytes */
+	sqlite3_status (SQLITE_STATUS_MALLOC_COUNT, &sqlite_count, &sqlite_hiwtr, FALSE);
+	sqlite3_status (SQLITE_STATUS_MEMORY_USED, &sqlite_cur, &sqlite_hiwtr, FALSE);
+	cd_main_memory_stats_add (&builder, "sqlite", (guint64) sqlite_count, (guint64) sqlite_cur);
+	sqlite3_status (SQLITE_STATUS_PAGECACHE_USED, &sqlite_pages, &sqlite_hiwtr, FALSE);
+	sqlite3_status (SQLITE_STATUS_PAGECACHE_OVERFLOW, &sqlite_cur, &sqlite_hiwtr, FALSE);
+	cd_main_memory_stats_add (&builder, "sqlite.pagecache", (guint64) sqlite_pages, (guint64) sqlite_cur);
+
+	return g_variant_builder_end (&builder);
+}
+
 static void
 cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 			    const gchar *object_path, const gchar *interface_name,
@@ -834,18 +1316,24 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 	gboolean register_on_bus = TRUE;
 	gboolean ret;
 	guint i;
-	guint pid;
 	guint uid;
 	g_autoptr(GError) error = NULL;
-	g_autofree gchar *cmdline = NULL;
+	const gchar *cmdline;
 	g_autofree gchar *device_id_fallback = NULL;
 	g_autofree gchar *filename = NULL;
 	g_autoptr(CdDevice) device = NULL;
+	g_autoptr(CdMainCredentials) credentials = NULL;
 	g_autoptr(CdProfile) profile = NULL;
 	g_autoptr(GPtrArray) array = NULL;
 	g_autoptr(GVariantIter) iter = NULL;
 	g_autoptr(GVariant) dict = NULL;
 
+	/* ask the bus daemon without blocking if not already known */
+	if (!cd_main_invocation_ensure_credentials (invocation,
+						    cd_main_daemon_method_call_timed,
+						    NULL))
+		return;
+
 	/* get the owner of the message */
 	uid = cd_main_get_sender_uid (connection, sender, &error);
 	if (uid == G_MAXUINT) {
@@ -859,25 +1347,57 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 
 	/* return 'as' */
 	if (g_strcmp0 (method_name, "GetDevices") == 0) {
+		g_autoptr(GVariant) devices = NULL;
 
 		g_debug ("CdMain: %s:GetDevices()", sender);
 
 		/* format the value */
-		array = cd_device_array_get_array (priv->devices_array);
-		value = cd_main_device_array_to_variant (array, uid);
-		tuple = g_variant_new_tuple (&value, 1);
+		devices = cd_device_array_get_variant (priv->devices_array, uid);
+		tuple = g_variant_new_tuple (&devices, 1);
 		g_dbus_method_invocation_return_value (invocation, tuple);
 		return;
 	}
 
+	/* return 'a(oa{sv})a(oa{sv})' */
+	if (g_strcmp0 (method_name, "GetSnapshot") == 0) {
+		g_debug ("CdMain: %s:GetSnapshot()", sender);
+		value = cd_main_get_snapshot (priv, uid, sender);
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
+	/* return 'ht' */
+	if (g_strcmp0 (method_name, "GetSnapshotFd") == 0) {
+		g_debug ("CdMain: %s:GetSnapshotFd()", sender);
+		cd_main_get_snapshot_fd (priv, invocation, uid, sender);
+		return;
+	}
+
+	/* return 'a{s(tt)}' */
+	if (g_strcmp0 (method_name, "GetMemoryStats") == 0) {
+		g_debug ("CdMain: %s:GetMemoryStats()", sender);
+		value = g_variant_new ("(@a{s(tt)})", cd_main_get_memory_stats (priv));
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
+	/* return 'a{s(tttat)}' */
+	if (g_strcmp0 (method_name, "GetMetrics") == 0) {
+		g_debug ("CdMain: %s:GetMetrics()", sender);
+		value = g_variant_new ("(@a{s(tttat)})", cd_metrics_get_variant ());
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
 	/* return 'as' */
 	if (g_strcmp0 (method_name, "GetSensors") == 0) {
 
 		g_debug ("CdMain: %s:GetSensors()", sender);
 
 		/* format the value */
-		value = cd_main_sensor_array_to_variant (priv->sensors);
-		tuple = g_variant_new_tuple (&value, 1);
+		if (priv->sensors_variant == NULL)
+			priv->sensors_variant = g_variant_ref_sink (cd_main_sensor_array_to_variant (priv->sensors));
+		tuple = g_variant_new_tuple (&priv->sensors_variant, 1);
 		g_dbus_method_invocation_return_value (invocation, tuple);
 		return;
 	}
@@ -915,11 +1435,10 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		g_variant_get (parameters, "(&s)", &scope_tmp);
 		g_debug ("CdMain: %s:GetProfilesByKind(%s)",
 			 sender, scope_tmp);
-		array = cd_profile_array_get_by_kind (priv->profiles_array,
-						      cd_profile_kind_from_string (scope_tmp));
+		value = cd_profile_array_get_variant_by_kind (priv->profiles_array,
+							      cd_profile_kind_from_string (scope_tmp));
 
 		/* format the value */
-		value = cd_main_profile_array_to_variant (array);
 		tuple = g_variant_new_tuple (&value, 1);
 		g_dbus_method_invocation_return_value (invocation, tuple);
 		return;
@@ -977,6 +1496,68 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		return;
 	}
 
+	/* return 'o' */
+	if (g_strcmp0 (method_name, "CreateSensorGroup") == 0) {
+
+		g_autoptr(CdSensor) group = NULL;
+		g_autoptr(GPtrArray) members = NULL;
+		g_autofree gchar *group_id = NULL;
+		const gchar *member_path;
+
+		/* require auth */
+		ret = cd_main_sender_authenticated (connection,
+						    sender,
+						    "org.freedesktop.color-manager.sensor-lock",
+						    &error);
+		if (!ret) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+
+		/* find each sensor */
+		members = g_ptr_array_new ();
+		g_variant_get (parameters, "(ao)", &iter);
+		g_debug ("CdMain: %s:CreateSensorGroup(%" G_GSIZE_FORMAT ")",
+			 sender, g_variant_iter_n_children (iter));
+		while (g_variant_iter_next (iter, "&o", &member_path)) {
+			CdSensor *member = NULL;
+			for (i = 0; i < priv->sensors->len; i++) {
+				CdSensor *sensor_tmp = g_ptr_array_index (priv->sensors, i);
+				if (g_strcmp0 (cd_sensor_get_object_path (sensor_tmp),
+					       member_path) == 0) {
+					member = sensor_tmp;
+					break;
+				}
+			}
+			if (member == NULL) {
+				g_dbus_method_invocation_return_error (invocation,
+								       CD_CLIENT_ERROR,
+								       CD_CLIENT_ERROR_NOT_FOUND,
+								       "sensor %s does not exist",
+								       member_path);
+				return;
+			}
+			g_ptr_array_add (members, member);
+		}
+
+		/* the group goes away with the client that made it */
+		group_id = g_strdup_printf ("group-%u", priv->sensor_group_idx++);
+		group = cd_sensor_new_group (group_id, members, &error);
+		if (group == NULL) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		cd_sensor_watch_sender (group, sender);
+		g_signal_connect (group, "invalidate",
+				  G_CALLBACK (cd_main_sensor_group_invalidate_cb),
+				  priv);
+		cd_main_add_sensor (priv, group);
+		g_dbus_method_invocation_return_value (invocation,
+						       g_variant_new ("(o)",
+								      cd_sensor_get_object_path (group)));
+		return;
+	}
+
 	/* return 'o' */
 	if (g_strcmp0 (method_name, "FindSensorById") == 0) {
 
@@ -1102,11 +1683,12 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 
 	/* return 'as' */
 	if (g_strcmp0 (method_name, "GetProfiles") == 0) {
+		g_autoptr(GVariant) profiles = NULL;
 
 		/* format the value */
 		g_debug ("CdMain: %s:GetProfiles()", sender);
-		value = cd_profile_array_get_variant (priv->profiles_array);
-		tuple = g_variant_new_tuple (&value, 1);
+		profiles = cd_profile_array_get_variant (priv->profiles_array);
+		tuple = g_variant_new_tuple (&profiles, 1);
 		g_dbus_method_invocation_return_value (invocation, tuple);
 		return;
 	}
@@ -1115,12 +1697,14 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 	if (g_strcmp0 (method_name, "CreateDevice") == 0) {
 
 		/* require auth */
-		ret = cd_main_sender_authenticated (connection,
-						    sender,
-						    "org.freedesktop.color-manager.create-device",
-						    &error);
+		ret = cd_main_invocation_authenticated (invocation,
+							"org.freedesktop.color-manager.create-device",
+							cd_main_daemon_method_call_timed,
+							NULL,
+							&error);
 		if (!ret) {
-			g_dbus_method_invocation_return_gerror (invocation, error);
+			if (error != NULL)
+				g_dbus_method_invocation_return_gerror (invocation, error);
 			return;
 		}
 
@@ -1210,13 +1794,13 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		}
 
 		/* get the process that sent the message */
-		pid = cd_main_get_sender_pid (connection, sender, &error);
-		if (pid == G_MAXUINT) {
+		credentials = cd_main_get_sender_credentials (connection, sender, &error);
+		if (credentials == NULL || credentials->pid == G_MAXUINT) {
 			g_dbus_method_invocation_return_error (invocation,
 							       CD_CLIENT_ERROR,
 							       CD_CLIENT_ERROR_INTERNAL,
 							       "failed to get process ID: %s",
-							       error->message);
+							       error != NULL ? error->message : sender);
 			return;
 		}
 
@@ -1225,7 +1809,7 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 						sender,
 						device_id,
 						uid,
-						pid,
+						cd_main_credentials_get_seat (credentials),
 						scope,
 						CD_DEVICE_MODE_UNKNOWN,
 						&error);
@@ -1258,7 +1842,7 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		}
 
 		/* add any extra metadata */
-		cmdline = cd_main_get_cmdline_for_pid (pid);
+		cmdline = cd_main_credentials_get_cmdline (credentials);
 		if (cmdline != NULL) {
 			ret = cd_device_set_property_internal (device,
 							       CD_DEVICE_METADATA_OWNER_CMDLINE,
@@ -1385,12 +1969,14 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		gint32 fd_handle = 0;
 
 		/* require auth */
-		ret = cd_main_sender_authenticated (connection,
-						    sender,
-						    "org.freedesktop.color-manager.create-profile",
-						    &error);
+		ret = cd_main_invocation_authenticated (invocation,
+							"org.freedesktop.color-manager.create-profile",
+							cd_main_daemon_method_call_timed,
+							NULL,
+							&error);
 		if (!ret) {
-			g_dbus_method_invocation_return_gerror (invocation, error);
+			if (error != NULL)
+				g_dbus_method_invocation_return_gerror (invocation, error);
 			return;
 		}
 
@@ -1543,6 +2129,21 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 			return;
 		}
 
+		/* a persistent profile for a file the store has not seen yet
+		 * in a directory it has already searched is an import, so the
+		 * store does not add a second object */
+		if (scope == CD_OBJECT_SCOPE_NORMAL && filename != NULL &&
+		    priv->startup_stage >= CD_MAIN_STARTUP_STAGE_PROFILES &&
+		    cd_main_icc_store_is_search_location (priv, filename)) {
+			g_autoptr(CdIcc) icc = NULL;
+			icc = cd_icc_store_find_by_filename (priv->icc_store, filename);
+			if (icc == NULL) {
+				g_hash_table_insert (priv->imported_files,
+						     g_strdup (filename),
+						     g_strdup (sender));
+			}
+		}
+
 		/* format the value */
 		value = g_variant_new_object_path (cd_profile_get_object_path (profile));
 		tuple = g_variant_new_tuple (&value, 1);
@@ -1554,10 +2155,37 @@ cd_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 	g_critical ("failed to process method %s", method_name);
 }
 
-static GVariant *
-cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
-			     const gchar *object_path, const gchar *interface_name,
-			     const gchar *property_name, GError **error,
+/* records how long each method handler takes */
+static void
+cd_main_daemon_method_call_timed (GDBusConnection *connection, const gchar *sender,
+				  const gchar *object_path, const gchar *interface_name,
+				  const gchar *method_name, GVariant *parameters,
+				  GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	gint64 start = g_get_monotonic_time ();
+	cd_object_dispatch_push ();
+	cd_main_daemon_method_call (connection, sender, object_path, interface_name,
+				    method_name, parameters, invocation, user_data);
+	cd_object_dispatch_pop ();
+	cd_metrics_add_method ("Daemon", method_name, start);
+}
+
+static const gchar *
+cd_main_startup_stage_to_string (CdMainStartupStage stage)
+{
+	if (stage == CD_MAIN_STARTUP_STAGE_CORE)
+		return "core";
+	if (stage == CD_MAIN_STARTUP_STAGE_PROFILES)
+		return "profiles";
+	if (stage == CD_MAIN_STARTUP_STAGE_COMPLETE)
+		return "complete";
+	return "starting";
+}
+
+static GVariant *
+cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
+			     const gchar *object_path, const gchar *interface_name,
+			     const gchar *property_name, GError **error,
 			     gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
@@ -1568,6 +2196,8 @@ cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
 		return g_variant_new_string (priv->system_vendor);
 	if (g_strcmp0 (property_name, CD_CLIENT_PROPERTY_SYSTEM_MODEL) == 0)
 		return g_variant_new_string (priv->system_model);
+	if (g_strcmp0 (property_name, CD_CLIENT_PROPERTY_STARTUP_STAGE) == 0)
+		return g_variant_new_string (cd_main_startup_stage_to_string (priv->startup_stage));
 
 	/* return an error */
 	g_set_error (error,
@@ -1578,6 +2208,443 @@ cd_main_daemon_get_property (GDBusConnection *connection_, const gchar *sender,
 	return NULL;
 }
 
+/* what the hot read methods need, copied on the main thread so they can
+ * be answered from the bus worker thread while the main loop is busy */
+typedef struct _CdMainReadSnapshot {
+	gint			 refcount;
+	guint64			 generation;
+	GVariant		*profiles;	/* 'ao' of all profiles */
+	GPtrArray		*objects;	/* CdMainReadObject */
+	GPtrArray		*devices;	/* CdMainReadObject */
+	GHashTable		*device_ids;	/* id : GPtrArray of CdMainReadObject */
+	GHashTable		*profile_ids;	/* id : GPtrArray of CdMainReadObject */
+} CdMainReadSnapshot;
+
+typedef struct {
+	guint			 owner;
+	gchar			*object_path;
+} CdMainReadObject;
+
+G_LOCK_DEFINE_STATIC (cd_main_read_snapshot);
+
+static void
+cd_main_read_object_free (CdMainReadObject *obj)
+{
+	g_free (obj->object_path);
+	g_free (obj);
+}
+
+static CdMainReadSnapshot *
+cd_main_read_snapshot_ref (CdMainReadSnapshot *snapshot)
+{
+	g_atomic_int_inc (&snapshot->refcount);
+	return snapshot;
+}
+
+static void
+cd_main_read_snapshot_unref (CdMainReadSnapshot *snapshot)
+{
+	if (!g_atomic_int_dec_and_test (&snapshot->refcount))
+		return;
+	if (snapshot->profiles != NULL)
+		g_variant_unref (snapshot->profiles);
+	g_hash_table_unref (snapshot->device_ids);
+	g_hash_table_unref (snapshot->profile_ids);
+	g_ptr_array_unref (snapshot->devices);
+	g_ptr_array_unref (snapshot->objects);
+	g_free (snapshot);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CdMainReadSnapshot, cd_main_read_snapshot_unref)
+
+static void
+cd_main_read_snapshot_add (CdMainReadSnapshot *snapshot,
+			   GHashTable *ids,
+			   const gchar *id,
+			   guint owner,
+			   const gchar *object_path)
+{
+	CdMainReadObject *obj;
+	GPtrArray *objects;
+
+	obj = g_new0 (CdMainReadObject, 1);
+	obj->owner = owner;
+	obj->object_path = g_strdup (object_path);
+	g_ptr_array_add (snapshot->objects, obj);
+	if (ids == snapshot->device_ids)
+		g_ptr_array_add (snapshot->devices, obj);
+	if (id == NULL)
+		return;
+	objects = g_hash_table_lookup (ids, id);
+	if (objects == NULL) {
+		objects = g_ptr_array_new ();
+		g_hash_table_insert (ids, g_strdup (id), objects);
+	}
+	g_ptr_array_add (objects, obj);
+}
+
+static CdMainReadSnapshot *
+cd_main_read_snapshot_new (CdMainPrivate *priv)
+{
+	CdMainReadSnapshot *snapshot;
+	guint i;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) profiles = NULL;
+
+	snapshot = g_new0 (CdMainReadSnapshot, 1);
+	snapshot->refcount = 1;
+	snapshot->generation = cd_object_generation_get ();
+	snapshot->objects = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_main_read_object_free);
+	snapshot->devices = g_ptr_array_new ();
+	snapshot->device_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, (GDestroyNotify) g_ptr_array_unref);
+	snapshot->profile_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) g_ptr_array_unref);
+	devices = cd_device_array_get_array (priv->devices_array);
+	for (i = 0; i < devices->len; i++) {
+		CdDevice *device_tmp = g_ptr_array_index (devices, i);
+		cd_main_read_snapshot_add (snapshot, snapshot->device_ids,
+					   cd_device_get_id (device_tmp),
+					   cd_device_get_owner (device_tmp),
+					   cd_device_get_object_path (device_tmp));
+	}
+
+	/* profiles only in the index are loaded by the main thread */
+	profiles = cd_profile_array_get_array (priv->profiles_array);
+	for (i = 0; i < profiles->len; i++) {
+		CdProfile *profile_tmp = g_ptr_array_index (profiles, i);
+		cd_main_read_snapshot_add (snapshot, snapshot->profile_ids,
+					   cd_profile_get_id (profile_tmp),
+					   cd_profile_get_owner (profile_tmp),
+					   cd_profile_get_object_path (profile_tmp));
+	}
+	snapshot->profiles = cd_profile_array_get_variant (priv->profiles_array);
+	return snapshot;
+}
+
+static gboolean
+cd_main_read_snapshot_publish_cb (gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	CdMainReadSnapshot *snapshot = cd_main_read_snapshot_new (priv);
+	CdMainReadSnapshot *snapshot_old;
+
+	G_LOCK (cd_main_read_snapshot);
+	snapshot_old = priv->read_snapshot;
+	priv->read_snapshot = snapshot;
+	G_UNLOCK (cd_main_read_snapshot);
+	if (snapshot_old != NULL)
+		cd_main_read_snapshot_unref (snapshot_old);
+	g_atomic_int_set (&priv->read_snapshot_pending, FALSE);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_main_read_snapshot_invalidate (CdMainPrivate *priv)
+{
+	CdMainReadSnapshot *snapshot_old;
+
+	G_LOCK (cd_main_read_snapshot);
+	snapshot_old = priv->read_snapshot;
+	priv->read_snapshot = NULL;
+	G_UNLOCK (cd_main_read_snapshot);
+	if (snapshot_old != NULL)
+		cd_main_read_snapshot_unref (snapshot_old);
+}
+
+/* returns NULL if out of date, in which case the main thread answers */
+static CdMainReadSnapshot *
+cd_main_read_snapshot_get (CdMainPrivate *priv)
+{
+	CdMainReadSnapshot *snapshot = NULL;
+
+	G_LOCK (cd_main_read_snapshot);
+	if (priv->read_snapshot != NULL &&
+	    priv->read_snapshot->generation == cd_object_generation_get ())
+		snapshot = cd_main_read_snapshot_ref (priv->read_snapshot);
+	G_UNLOCK (cd_main_read_snapshot);
+
+	/* rebuilt after the method calls that are already queued */
+	if (snapshot == NULL &&
+	    g_atomic_int_compare_and_exchange (&priv->read_snapshot_pending, FALSE, TRUE))
+		g_idle_add (cd_main_read_snapshot_publish_cb, priv);
+	return snapshot;
+}
+
+static const gchar *
+cd_main_read_snapshot_find (GHashTable *ids, const gchar *id, guint uid)
+{
+	CdMainReadObject *obj;
+	GPtrArray *objects = g_hash_table_lookup (ids, id);
+
+	/* prefer the one for the owner, like the arrays */
+	if (objects == NULL)
+		return NULL;
+	for (guint i = 0; i < objects->len; i++) {
+		obj = g_ptr_array_index (objects, i);
+		if (obj->owner == uid)
+			return obj->object_path;
+	}
+	obj = g_ptr_array_index (objects, 0);
+	return obj->object_path;
+}
+
+/* only returns found values; misses are left for the main thread */
+static GVariant *
+cd_main_read_snapshot_lookup (CdMainReadSnapshot *snapshot,
+			      const gchar *method_name,
+			      GVariant *parameters,
+			      guint uid)
+{
+	const gchar *id = NULL;
+	const gchar *object_path;
+
+	if (g_strcmp0 (method_name, "GetProfiles") == 0)
+		return g_variant_new ("(@ao)", snapshot->profiles);
+	if (g_strcmp0 (method_name, "GetDevices") == 0) {
+		GVariantBuilder builder;
+		g_variant_builder_init (&builder, G_VARIANT_TYPE_OBJECT_PATH_ARRAY);
+		for (guint i = 0; i < snapshot->devices->len; i++) {
+			CdMainReadObject *obj = g_ptr_array_index (snapshot->devices, i);
+			if (uid != 0 && obj->owner != 0 && obj->owner != uid)
+				continue;
+			g_variant_builder_add (&builder, "o", obj->object_path);
+		}
+		return g_variant_new ("(ao)", &builder);
+	}
+	if (parameters == NULL ||
+	    !g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(s)")))
+		return NULL;
+	g_variant_get (parameters, "(&s)", &id);
+	if (g_strcmp0 (method_name, "FindDeviceById") == 0) {
+		object_path = cd_main_read_snapshot_find (snapshot->device_ids, id, uid);
+	} else if (g_strcmp0 (method_name, "FindProfileById") == 0) {
+		object_path = cd_main_read_snapshot_find (snapshot->profile_ids, id, uid);
+	} else {
+		return NULL;
+	}
+	if (object_path == NULL)
+		return NULL;
+	return g_variant_new ("(o)", object_path);
+}
+
+/* calls that cannot change what is in the snapshot */
+static gboolean
+cd_main_read_method_is_query (const gchar *interface_name, const gchar *method_name)
+{
+	const gchar *daemon_queries[] = {
+		"FindDeviceByProperty",
+		"FindProfileByFilename",
+		"FindProfileByProperty",
+		"GetMemoryStats",
+		"GetMetrics",
+		"GetProfilesByKind",
+		"GetSensors",
+		"GetSnapshot",
+		"GetSnapshotFd",
+		"GetStandardSpace",
+		NULL };
+
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Properties") == 0)
+		return g_strcmp0 (method_name, "Set") != 0;
+	if (g_strcmp0 (interface_name, "org.freedesktop.DBus.Introspectable") == 0 ||
+	    g_strcmp0 (interface_name, "org.freedesktop.DBus.Peer") == 0)
+		return TRUE;
+	if (g_strcmp0 (interface_name, COLORD_DBUS_INTERFACE) == 0)
+		return g_strv_contains (daemon_queries, method_name);
+	return FALSE;
+}
+
+static GDBusMessage *
+cd_main_read_filter_cb (GDBusConnection *connection,
+			GDBusMessage *message,
+			gboolean incoming,
+			gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	const gchar *method_name;
+	gint64 start = g_get_monotonic_time ();
+	GVariant *value;
+	g_autoptr(CdMainCredentials) credentials = NULL;
+	g_autoptr(CdMainReadSnapshot) snapshot = NULL;
+	g_autoptr(GDBusMessage) reply = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* only method calls that expect a reply */
+	if (!incoming ||
+	    g_dbus_message_get_message_type (message) != G_DBUS_MESSAGE_TYPE_METHOD_CALL ||
+	    (g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) > 0)
+		return message;
+
+	/* anything else may change what the readers see, and has to be
+	 * answered first if the same client queued a read behind it */
+	method_name = g_dbus_message_get_member (message);
+	if (g_strcmp0 (g_dbus_message_get_path (message), COLORD_DBUS_PATH) != 0 ||
+	    g_strcmp0 (g_dbus_message_get_interface (message), COLORD_DBUS_INTERFACE) != 0 ||
+	    (g_strcmp0 (method_name, "GetDevices") != 0 &&
+	     g_strcmp0 (method_name, "GetProfiles") != 0 &&
+	     g_strcmp0 (method_name, "FindDeviceById") != 0 &&
+	     g_strcmp0 (method_name, "FindProfileById") != 0)) {
+		if (g_str_has_prefix (g_dbus_message_get_path (message), COLORD_DBUS_PATH) &&
+		    !cd_main_read_method_is_query (g_dbus_message_get_interface (message),
+						   method_name))
+			cd_main_read_snapshot_invalidate (priv);
+		return message;
+	}
+
+	/* the owner has to be known already, as asking would block */
+	credentials = cd_main_peek_sender_credentials (g_dbus_message_get_sender (message));
+	if (credentials == NULL || credentials->uid == G_MAXUINT)
+		return message;
+	snapshot = cd_main_read_snapshot_get (priv);
+	if (snapshot == NULL)
+		return message;
+	value = cd_main_read_snapshot_lookup (snapshot,
+					      method_name,
+					      g_dbus_message_get_body (message),
+					      credentials->uid);
+	if (value == NULL)
+		return message;
+
+	/* answer from this thread */
+	reply = g_dbus_message_new_method_reply (message);
+	g_dbus_message_set_body (reply, value);
+	if (!g_dbus_connection_send_message (connection,
+					     reply,
+					     G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+					     NULL,
+					     &error)) {
+		g_debug ("CdMain: failed to reply to %s: %s",
+			 method_name, error->message);
+		return message;
+	}
+	cd_metrics_add_method ("Daemon", method_name, start);
+	g_object_unref (message);
+	return NULL;
+}
+
+static gchar **
+cd_main_profiles_subtree_enumerate (GDBusConnection *connection,
+				    const gchar *sender,
+				    const gchar *object_path,
+				    gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	GPtrArray *nodes = g_ptr_array_new ();
+	GVariantIter iter;
+	const gchar *path;
+	g_autoptr(GVariant) profiles = NULL;
+
+	/* includes the profiles that are only in the index */
+	profiles = cd_profile_array_get_variant (priv->profiles_array);
+	g_variant_iter_init (&iter, profiles);
+	while (g_variant_iter_next (&iter, "&o", &path))
+		g_ptr_array_add (nodes, g_path_get_basename (path));
+	g_ptr_array_add (nodes, NULL);
+	return (gchar **) g_ptr_array_free (nodes, FALSE);
+}
+
+static GDBusInterfaceInfo **
+cd_main_profiles_subtree_introspect (GDBusConnection *connection,
+				     const gchar *sender,
+				     const gchar *object_path,
+				     const gchar *node,
+				     gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	GDBusInterfaceInfo **infos;
+
+	if (node == NULL)
+		return NULL;
+	infos = g_new0 (GDBusInterfaceInfo *, 2);
+	infos[0] = g_dbus_interface_info_ref (priv->introspection_profile);
+	return infos;
+}
+
+typedef struct {
+	CdProfileArray		*profiles_array;
+	CdProfile		*profile;
+} CdMainSubtreeHelper;
+
+static gboolean
+cd_main_profiles_subtree_release_cb (gpointer user_data)
+{
+	CdMainSubtreeHelper *helper = (CdMainSubtreeHelper *) user_data;
+	cd_profile_array_release (helper->profiles_array, helper->profile);
+	g_object_unref (helper->profiles_array);
+	g_object_unref (helper->profile);
+	g_free (helper);
+	return G_SOURCE_REMOVE;
+}
+
+static const GDBusInterfaceVTable *
+cd_main_profiles_subtree_dispatch (GDBusConnection *connection,
+				   const gchar *sender,
+				   const gchar *object_path,
+				   const gchar *interface_name,
+				   const gchar *node,
+				   gpointer *out_user_data,
+				   gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	CdMainSubtreeHelper *helper;
+	CdProfile *profile;
+	g_autofree gchar *path = NULL;
+
+	if (node == NULL ||
+	    g_strcmp0 (interface_name, COLORD_DBUS_INTERFACE_PROFILE) != 0)
+		return NULL;
+
+	/* loading registers the object, so later calls go straight to it */
+	path = g_build_filename (object_path, node, NULL);
+	profile = cd_profile_array_get_by_object_path (priv->profiles_array, path);
+	if (profile == NULL)
+		return NULL;
+
+	/* the method call is dispatched from an idle at the default
+	 * priority, so keep the ref and stop the array evicting the profile
+	 * until a lower priority idle has run after it */
+	cd_profile_array_hold (priv->profiles_array, profile);
+	helper = g_new0 (CdMainSubtreeHelper, 1);
+	helper->profiles_array = g_object_ref (priv->profiles_array);
+	helper->profile = profile;
+	g_idle_add_full (G_PRIORITY_LOW,
+			 cd_main_profiles_subtree_release_cb,
+			 helper, NULL);
+	*out_user_data = profile;
+	return cd_profile_get_interface_vtable ();
+}
+
+static gboolean
+cd_main_imported_file_match_sender_cb (gpointer key, gpointer value, gpointer user_data)
+{
+	return g_strcmp0 (value, user_data) == 0;
+}
+
+/* an importer that has gone away will not get its file added */
+static void
+cd_main_name_owner_changed_cb (GDBusConnection *connection,
+			       const gchar *sender_name,
+			       const gchar *object_path,
+			       const gchar *interface_name,
+			       const gchar *signal_name,
+			       GVariant *parameters,
+			       gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	const gchar *name = NULL;
+	const gchar *new_owner = NULL;
+
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+		return;
+	g_variant_get (parameters, "(&s&s&s)", &name, NULL, &new_owner);
+	if (name[0] != ':' || new_owner[0] != '\0')
+		return;
+	g_hash_table_foreach_remove (priv->imported_files,
+				     cd_main_imported_file_match_sender_cb,
+				     (gpointer) name);
+}
+
 static void
 cd_main_on_bus_acquired_cb (GDBusConnection *connection,
 			    const gchar *name,
@@ -1586,49 +2653,74 @@ cd_main_on_bus_acquired_cb (GDBusConnection *connection,
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	guint registration_id;
 	static const GDBusInterfaceVTable interface_vtable = {
-		cd_main_daemon_method_call,
+		cd_main_daemon_method_call_timed,
 		cd_main_daemon_get_property,
 		NULL
 	};
+	static const GDBusSubtreeVTable profiles_vtable = {
+		cd_main_profiles_subtree_enumerate,
+		cd_main_profiles_subtree_introspect,
+		cd_main_profiles_subtree_dispatch,
+	};
 
 	priv->connection = g_object_ref (connection);
+
+	/* answer the hot read methods without the main loop */
+	priv->read_filter_id = g_dbus_connection_add_filter (connection,
+							     cd_main_read_filter_cb,
+							     priv,
+							     NULL);
 	registration_id = g_dbus_connection_register_object (connection,
 							     COLORD_DBUS_PATH,
-							     priv->introspection_daemon->interfaces[0],
+							     priv->introspection_daemon,
 							     &interface_vtable,
 							     priv,  /* user_data */
 							     NULL,  /* user_data_free_func */
 							     NULL); /* GError** */
 	g_assert (registration_id > 0);
+
+	/* forget the imports of clients that have gone away */
+	priv->name_owner_changed_id =
+		g_dbus_connection_signal_subscribe (connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    NULL, /* arg0 */
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    cd_main_name_owner_changed_cb,
+						    priv, NULL);
+
+	/* profiles only in the index have no registered object */
+	if (priv->max_profile_objects > 0) {
+		registration_id = g_dbus_connection_register_subtree (connection,
+								      COLORD_DBUS_PATH "/profiles",
+								      &profiles_vtable,
+								      G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
+								      priv,  /* user_data */
+								      NULL,  /* user_data_free_func */
+								      NULL); /* GError** */
+		g_assert (registration_id > 0);
+	}
 }
 
-static void
-cd_main_icc_store_added_cb (CdIccStore *icc_store,
-			    CdIcc *icc,
-			    gpointer user_data)
+static CdProfile *
+cd_main_profile_new_from_icc (CdIcc *icc, GError **error)
 {
-	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	const gchar *checksum;
-	const gchar *filename;
-	gboolean ret;
-	g_autoptr(GError) error = NULL;
+	const gchar *filename = cd_icc_get_filename (icc);
 	g_autofree gchar *profile_id = NULL;
 	g_autoptr(CdProfile) profile = NULL;
 
 	/* create profile */
 	profile = cd_profile_new ();
-	filename = cd_icc_get_filename (icc);
 	if (g_str_has_prefix (filename, "/usr/share/color") ||
 	    g_str_has_prefix (filename, "/var/lib/color"))
 		cd_profile_set_is_system_wide (profile, TRUE);
 
 	/* parse the profile name */
-	ret = cd_profile_load_from_icc (profile, icc, &error);
-	if (!ret) {
-		g_warning ("CdIccStore: failed to add profile '%s': %s",
-			   filename, error->message);
-		return;
-	}
+	if (!cd_profile_load_from_icc (profile, icc, error))
+		return NULL;
 
 	/* ensure profiles have the checksum metadata item */
 	checksum = cd_profile_get_checksum (profile);
@@ -1641,6 +2733,118 @@ cd_main_icc_store_added_cb (CdIccStore *icc_store,
 	/* just add it to the bus with the title as the ID */
 	profile_id = g_strdup_printf ("icc-%s", cd_icc_get_checksum (icc));
 	cd_profile_set_id (profile, profile_id);
+	return g_steal_pointer (&profile);
+}
+
+static CdProfile *
+cd_main_profile_load_cb (CdProfileArray *profile_array,
+			 const gchar *filename,
+			 gpointer user_data,
+			 GError **error)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	gint64 start = g_get_monotonic_time ();
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdProfile) profile = NULL;
+
+	icc = cd_icc_store_find_by_filename (priv->icc_store, filename);
+	if (icc == NULL) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_NOT_FOUND,
+			     "%s is no longer in the store",
+			     filename);
+		return NULL;
+	}
+	profile = cd_main_profile_new_from_icc (icc, error);
+	if (profile == NULL)
+		return NULL;
+	if (!cd_main_add_profile (priv, profile, error))
+		return NULL;
+
+	/* ProfileAdded was emitted when it was indexed */
+	if (!cd_profile_register_object (profile,
+					 priv->connection,
+					 priv->introspection_profile,
+					 error)) {
+		cd_profile_array_remove (priv->profiles_array, profile);
+		return NULL;
+	}
+	g_debug ("CdMain: loaded %s on demand", cd_profile_get_id (profile));
+	cd_metrics_add ("profiles.loaded", start);
+	return g_steal_pointer (&profile);
+}
+
+static void
+cd_main_icc_store_add_index (CdMainPrivate *priv, CdIcc *icc)
+{
+	g_autofree gchar *object_path = NULL;
+	g_autofree gchar *path_tmp = NULL;
+	g_autofree gchar *profile_id = NULL;
+	g_autoptr(GHashTable) metadata = NULL;
+
+	/* only what is needed to find the profile without loading it */
+	metadata = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_FILE_CHECKSUM,
+			     (gpointer) cd_icc_get_checksum (icc));
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_MAPPING_DEVICE_ID,
+			     (gpointer) cd_icc_get_metadata_item (icc, CD_PROFILE_METADATA_MAPPING_DEVICE_ID));
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_EDID_MD5,
+			     (gpointer) cd_icc_get_metadata_item (icc, CD_PROFILE_METADATA_EDID_MD5));
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_STANDARD_SPACE,
+			     (gpointer) cd_icc_get_metadata_item (icc, CD_PROFILE_METADATA_STANDARD_SPACE));
+
+	/* the same path as used by the profile with no owner */
+	profile_id = g_strdup_printf ("icc-%s", cd_icc_get_checksum (icc));
+	path_tmp = cd_main_ensure_dbus_path (profile_id);
+	object_path = g_build_filename (COLORD_DBUS_PATH, "profiles", path_tmp, NULL);
+	if (!cd_profile_array_add_index (priv->profiles_array,
+					 profile_id,
+					 cd_icc_get_filename (icc),
+					 object_path,
+					 cd_icc_get_kind (icc),
+					 metadata))
+		return;
+	cd_main_profile_emit_added (priv, profile_id, object_path, CD_LOGGING_FLAG_NONE);
+}
+
+static void
+cd_main_icc_store_added_cb (CdIccStore *icc_store,
+			    CdIcc *icc,
+			    gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	const gchar *filename;
+	gboolean ret;
+	gint64 start = g_get_monotonic_time ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(CdProfile) profile = NULL;
+
+	/* already registered by the client that imported it */
+	filename = cd_icc_get_filename (icc);
+	if (g_hash_table_remove (priv->imported_files, filename)) {
+		g_debug ("CdMain: %s already added by the importer", filename);
+		return;
+	}
+
+	/* only loaded when something looks it up */
+	if (priv->max_profile_objects > 0) {
+		cd_main_icc_store_add_index (priv, icc);
+		cd_metrics_add ("icc-store.added", start);
+		return;
+	}
+
+	/* create profile */
+	profile = cd_main_profile_new_from_icc (icc, &error);
+	if (profile == NULL) {
+		g_warning ("CdIccStore: failed to add profile '%s': %s",
+			   filename, error->message);
+		return;
+	}
 	ret = cd_main_add_profile (priv, profile, &error);
 	if (!ret) {
 		g_warning ("CdMain: failed to add profile: %s",
@@ -1658,6 +2862,32 @@ cd_main_icc_store_added_cb (CdIccStore *icc_store,
 			   error->message);
 		return;
 	}
+	cd_metrics_add ("icc-store.added", start);
+}
+
+static void
+cd_main_icc_store_add_bundles (CdMainPrivate *priv, const gchar *path)
+{
+	const gchar *fn;
+	g_autoptr(GDir) dir = NULL;
+
+	/* the directory is optional */
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *filename = NULL;
+		g_autoptr(GError) error = NULL;
+		if (!g_str_has_suffix (fn, ".gresource"))
+			continue;
+		filename = g_build_filename (path, fn, NULL);
+		if (!cd_icc_store_add_cache_file (priv->icc_store, filename, &error)) {
+			g_warning ("CdMain: failed to load profile bundle: %s",
+				   error->message);
+			continue;
+		}
+		g_debug ("CdMain: using profile bundle %s", filename);
+	}
 }
 
 static void
@@ -1667,31 +2897,63 @@ cd_main_icc_store_removed_cb (CdIccStore *icc_store,
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
 	CdProfile *profile;
+	gint64 start = g_get_monotonic_time ();
+
+	/* file monitor events */
+	g_hash_table_remove (priv->imported_files, cd_icc_get_filename (icc));
+
+	/* not loaded, or unloaded along with the index entry */
+	cd_object_generation_bump ();
+	if (cd_profile_array_remove_index (priv->profiles_array,
+					   cd_icc_get_filename (icc))) {
+		cd_metrics_add ("icc-store.removed", start);
+		return;
+	}
 
 	/* check the profile should be invalidated automatically */
 	profile = cd_profile_array_get_by_filename (priv->profiles_array,
 						    cd_icc_get_filename (icc));
-	if (profile == NULL)
+	if (profile == NULL) {
+		cd_metrics_add ("icc-store.removed", start);
 		return;
+	}
 	g_debug ("%s removed, so invalidating", cd_icc_get_filename (icc));
 	cd_profile_array_remove (priv->profiles_array, profile);
+	cd_metrics_add ("icc-store.removed", start);
+}
+
+/* all the profiles from one batch of file monitor events are in, so
+ * announce them now rather than waiting for the batch timeout */
+static void
+cd_main_icc_store_changed_cb (CdIccStore *icc_store, gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	if (priv->added_id == 0)
+		return;
+	g_source_remove (priv->added_id);
+	cd_main_added_cb (priv);
 }
 
 static void
-cd_main_add_disk_device (CdMainPrivate *priv, const gchar *device_id)
+cd_main_add_disk_device (const gchar *device_id,
+			 GHashTable *properties,
+			 gpointer user_data)
 {
-	const gchar *property;
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	GHashTableIter iter;
+	gpointer property;
+	gpointer value;
 	gboolean ret;
-	guint i;
+	g_autofree gchar *seat = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(CdDevice) device = NULL;
-	g_autoptr(GPtrArray) array_properties = NULL;
 
+	seat = cd_main_get_seat_for_process (0);
 	device = cd_main_create_device (priv,
 					NULL,
 					device_id,
 					0,
-					0,
+					seat,
 					CD_OBJECT_SCOPE_DISK,
 					CD_DEVICE_MODE_VIRTUAL,
 					&error);
@@ -1705,27 +2967,8 @@ cd_main_add_disk_device (CdMainPrivate *priv, const gchar *device_id)
 		 cd_device_get_object_path (device));
 
 	/* set properties on the device */
-	array_properties = cd_device_db_get_properties (priv->device_db,
-							device_id,
-							&error);
-	if (array_properties == NULL) {
-		g_warning ("CdMain: failed to get props for device %s: %s",
-			   device_id, error->message);
-		return;
-	}
-	for (i = 0; i < array_properties->len; i++) {
-		g_autofree gchar *value = NULL;
-		property = g_ptr_array_index (array_properties, i);
-		value = cd_device_db_get_property (priv->device_db,
-						   device_id,
-						   property,
-						   &error);
-		if (value == NULL) {
-			g_warning ("CdMain: failed to get value: %s",
-				   error->message);
-			g_clear_error (&error);
-			return;
-		}
+	g_hash_table_iter_init (&iter, properties);
+	while (g_hash_table_iter_next (&iter, &property, &value)) {
 		ret = cd_device_set_property_internal (device,
 						       property,
 						       value,
@@ -1756,7 +2999,7 @@ cd_main_sensor_register_on_bus (CdMainPrivate *priv,
 	/* register object */
 	if (!cd_sensor_register_object (sensor,
 					priv->connection,
-					priv->introspection_sensor->interfaces[0],
+					priv->introspection_sensor,
 					error))
 		return FALSE;
 
@@ -1789,11 +3032,13 @@ cd_main_add_sensor (CdMainPrivate *priv, CdSensor *sensor)
 	}
 	g_debug ("CdMain: add sensor: %s", id);
 	g_ptr_array_add (priv->sensors, g_object_ref (sensor));
+	g_clear_pointer (&priv->sensors_variant, g_variant_unref);
 
 	/* register on bus */
 	ret = cd_main_sensor_register_on_bus (priv, sensor, &error);
 	if (!ret) {
 		g_ptr_array_remove (priv->sensors, sensor);
+		g_clear_pointer (&priv->sensors_variant, g_variant_unref);
 		g_warning ("CdMain: failed to emit SensorAdded: %s",
 			   error->message);
 		return;
@@ -1829,6 +3074,14 @@ cd_main_plugin_phase (CdMainPrivate *priv, CdPluginPhase phase)
 
 	g_assert (function != NULL);
 
+	/* restore the state of every coldplugged device in one transaction */
+	if (phase == CD_PLUGIN_PHASE_COLDPLUG) {
+		g_autoptr(GError) error = NULL;
+		if (!cd_device_db_begin (priv->device_db, &error) ||
+		    !cd_mapping_db_begin (priv->mapping_db, &error))
+			g_warning ("CdMain: failed to begin coldplug: %s", error->message);
+	}
+
 	/* run each plugin */
 	for (i = 0; i < priv->plugins->len; i++) {
 		plugin = g_ptr_array_index (priv->plugins, i);
@@ -1843,6 +3096,237 @@ cd_main_plugin_phase (CdMainPrivate *priv, CdPluginPhase phase)
 		plugin_func (plugin);
 		g_debug ("finished %s", function);
 	}
+
+	/* no need to wait for the batch timeout */
+	if (phase == CD_PLUGIN_PHASE_COLDPLUG) {
+		g_autoptr(GError) error = NULL;
+		if (!cd_device_db_flush (priv->device_db, &error) ||
+		    !cd_mapping_db_flush (priv->mapping_db, &error))
+			g_warning ("CdMain: failed to commit coldplug: %s", error->message);
+	}
+}
+
+static void
+cd_main_set_startup_stage (CdMainPrivate *priv, CdMainStartupStage stage)
+{
+	GVariantBuilder builder;
+	GVariantBuilder invalidated_builder;
+	const gchar *stage_str = cd_main_startup_stage_to_string (stage);
+
+	priv->startup_stage = stage;
+	g_info ("Startup stage: %s", stage_str);
+
+	/* tell clients waiting for the daemon to be ready */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
+	g_variant_builder_add (&builder,
+			       "{sv}",
+			       CD_CLIENT_PROPERTY_STARTUP_STAGE,
+			       g_variant_new_string (stage_str));
+	g_dbus_connection_emit_signal (priv->connection,
+				       NULL,
+				       COLORD_DBUS_PATH,
+				       "org.freedesktop.DBus.Properties",
+				       "PropertiesChanged",
+				       g_variant_new ("(sa{sv}as)",
+				       COLORD_DBUS_INTERFACE,
+				       &builder,
+				       &invalidated_builder),
+				       NULL);
+}
+
+/* plugin devices from the last run are shown before the slow coldplug */
+static void
+cd_main_state_restore (CdMainPrivate *priv)
+{
+	g_autofree gchar *filename = cd_main_get_path (priv, CD_MAIN_STATE_FILENAME);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+
+	devices = cd_state_load (filename, &error);
+	if (devices == NULL) {
+		g_debug ("CdMain: not restoring state: %s", error->message);
+		return;
+	}
+	for (guint i = 0; i < devices->len; i++) {
+		CdDevice *device = g_ptr_array_index (devices, i);
+		const gchar *id = cd_device_get_id (device);
+		g_autoptr(CdDevice) device_tmp = NULL;
+
+		device_tmp = cd_device_array_get_by_id_owner (priv->devices_array, id, 0,
+							      CD_DEVICE_ARRAY_FLAG_OWNER_OPTIONAL);
+		if (device_tmp != NULL)
+			continue;
+		cd_device_set_mode (device, CD_DEVICE_MODE_PHYSICAL);
+		if (!cd_main_device_add (priv, device, NULL, &error) ||
+		    !cd_main_device_register_on_bus (priv, device, &error)) {
+			g_warning ("CdMain: failed to restore device %s: %s",
+				   id, error->message);
+			g_clear_error (&error);
+			continue;
+		}
+		g_hash_table_add (priv->plugin_device_ids, g_strdup (id));
+		g_hash_table_insert (priv->restored_devices, g_strdup (id), g_object_ref (device));
+	}
+	g_debug ("CdMain: restored %u devices", g_hash_table_size (priv->restored_devices));
+}
+
+static void
+cd_main_state_save (CdMainPrivate *priv)
+{
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) devices = g_ptr_array_new ();
+
+	array = cd_device_array_get_array (priv->devices_array);
+	for (guint i = 0; i < array->len; i++) {
+		CdDevice *device = g_ptr_array_index (array, i);
+		if (g_hash_table_contains (priv->plugin_device_ids, cd_device_get_id (device)))
+			g_ptr_array_add (devices, device);
+	}
+	filename = cd_main_get_path (priv, CD_MAIN_STATE_FILENAME);
+	if (!cd_state_save (filename, devices, &error))
+		g_warning ("CdMain: failed to save state: %s", error->message);
+}
+
+/* the plugin found the device again, so keep the same object path */
+static void
+cd_main_state_replace (CdMainPrivate *priv, CdDevice *restored, CdDevice *device)
+{
+	g_autoptr(CdDevice) restored_ref = g_object_ref (restored);
+	g_autoptr(GError) error = NULL;
+
+	g_debug ("CdMain: replacing restored device %s", cd_device_get_id (device));
+	g_hash_table_remove (priv->restored_devices, cd_device_get_id (restored));
+	cd_device_unregister_object (restored);
+	cd_device_array_remove (priv->devices_array, restored);
+	if (!cd_main_device_add (priv, device, NULL, &error) ||
+	    !cd_device_register_object (device,
+					priv->connection,
+					priv->introspection_device,
+					&error)) {
+		g_warning ("CdMain: failed to replace device: %s", error->message);
+		cd_device_array_remove (priv->devices_array, device);
+		g_hash_table_remove (priv->plugin_device_ids, cd_device_get_id (device));
+		g_dbus_connection_emit_signal (priv->connection,
+					       NULL,
+					       COLORD_DBUS_PATH,
+					       COLORD_DBUS_INTERFACE,
+					       "DeviceRemoved",
+					       g_variant_new ("(o)",
+							      cd_device_get_object_path (restored)),
+					       NULL);
+		cd_object_generation_bump ();
+		return;
+	}
+
+	/* the properties may be different */
+	cd_object_generation_bump ();
+	g_dbus_connection_emit_signal (priv->connection,
+				       NULL,
+				       COLORD_DBUS_PATH,
+				       COLORD_DBUS_INTERFACE,
+				       "DeviceChanged",
+				       g_variant_new ("(o)",
+						      cd_device_get_object_path (device)),
+				       NULL);
+}
+
+/* anything not found again by now has gone away while we were not running */
+static gboolean
+cd_main_state_restored_timeout_cb (gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	g_autoptr(GList) devices = NULL;
+
+	priv->restored_id = 0;
+	devices = g_hash_table_get_values (priv->restored_devices);
+	g_list_foreach (devices, (GFunc) g_object_ref, NULL);
+	for (GList *l = devices; l != NULL; l = l->next) {
+		CdDevice *device = CD_DEVICE (l->data);
+		g_debug ("CdMain: restored device %s not found",
+			 cd_device_get_id (device));
+		cd_main_device_removed (priv, device);
+		g_object_unref (device);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* each step runs from an idle so that method calls are answered in between */
+static gboolean
+cd_main_startup_cb (gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	gboolean ret;
+	const gchar *bundle_dirs[] = { DATADIR "/colord/bundles",
+				       LOCALSTATEDIR "/lib/colord/bundles",
+				       NULL };
+	g_autoptr(GError) error = NULL;
+
+	switch (priv->startup_step++) {
+	case 0:
+		/* profiles in bundles and system directories */
+		for (guint i = 0; bundle_dirs[i] != NULL; i++) {
+			g_autofree gchar *path = cd_main_get_path (priv, bundle_dirs[i]);
+			cd_main_icc_store_add_bundles (priv, path);
+		}
+
+		/* vendor trees can have thousands of subdirectories, and
+		 * only change when packages are installed */
+		ret = cd_main_icc_store_search_kind (priv,
+						     CD_ICC_STORE_SEARCH_KIND_SYSTEM,
+						     CD_ICC_STORE_SEARCH_FLAGS_COLD,
+						     &error);
+		if (!ret) {
+			g_warning ("CdMain: failed to search system directories: %s",
+				    error->message);
+		}
+		return G_SOURCE_CONTINUE;
+	case 1:
+		ret = cd_main_icc_store_search_kind (priv,
+						     CD_ICC_STORE_SEARCH_KIND_MACHINE,
+						     CD_ICC_STORE_SEARCH_FLAGS_NONE,
+						     &error);
+		if (!ret) {
+			g_warning ("CdMain: failed to search machine directories: %s",
+				    error->message);
+		}
+		cd_main_set_startup_stage (priv, CD_MAIN_STARTUP_STAGE_PROFILES);
+		return G_SOURCE_CONTINUE;
+	default:
+		break;
+	}
+
+	/* add sensor devices */
+	cd_sensor_client_coldplug (priv->sensor_client);
+
+	/* coldplug plugin devices */
+	cd_main_plugin_phase (priv, CD_PLUGIN_PHASE_COLDPLUG);
+
+	/* some plugins add devices asynchronously, so allow some time */
+	if (g_hash_table_size (priv->restored_devices) > 0) {
+		priv->restored_id = g_timeout_add_seconds (CD_MAIN_RESTORED_TIMEOUT,
+							   cd_main_state_restored_timeout_cb,
+							   priv);
+	}
+
+	/* add dummy sensors, where the first is always called "dummy" */
+	for (guint i = 0; i < priv->create_dummy_sensors; i++) {
+		g_autoptr(CdSensor) sensor = cd_sensor_new ();
+		cd_sensor_set_kind (sensor, CD_SENSOR_KIND_DUMMY);
+		if (!cd_sensor_load (sensor, &error)) {
+			g_warning ("CdMain: failed to load dummy sensor: %s",
+				    error->message);
+			break;
+		}
+		if (i > 0)
+			cd_sensor_set_index (sensor, i);
+		cd_main_add_sensor (priv, sensor);
+	}
+	cd_main_set_startup_stage (priv, CD_MAIN_STARTUP_STAGE_COMPLETE);
+	priv->startup_id = 0;
+	return G_SOURCE_REMOVE;
 }
 
 static void
@@ -1851,79 +3335,55 @@ cd_main_on_name_acquired_cb (GDBusConnection *connection,
 			     gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
-	const gchar *device_id;
 	gboolean ret;
-	guint i;
+	g_autofree gchar *filename = NULL;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(CdSensor) sensor = NULL;
-	g_autoptr(GPtrArray) array_devices = NULL;
 
 	g_debug ("CdMain: acquired name: %s", name);
 
-	/* add system profiles */
+	/* set up the profile store, which is searched later */
 	priv->icc_store = cd_icc_store_new ();
 	cd_icc_store_set_load_flags (priv->icc_store, CD_ICC_LOAD_FLAGS_FALLBACK_MD5);
+	cd_icc_store_set_metadata_only (priv->icc_store, TRUE);
 	cd_icc_store_set_cache (priv->icc_store, cd_get_resource ());
+	filename = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/checksums.ini");
+	if (!cd_icc_store_set_checksum_cache (priv->icc_store, filename, &error)) {
+		g_warning ("CdMain: failed to load checksum cache: %s",
+			   error->message);
+		g_clear_error (&error);
+	}
+	g_free (filename);
+	filename = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/profiles.ini");
+	if (!cd_icc_store_set_index (priv->icc_store, filename, &error)) {
+		g_warning ("CdMain: failed to load profile index: %s",
+			   error->message);
+		g_clear_error (&error);
+	}
 	g_signal_connect (priv->icc_store, "added",
 			  G_CALLBACK (cd_main_icc_store_added_cb),
 			  user_data);
 	g_signal_connect (priv->icc_store, "removed",
 			  G_CALLBACK (cd_main_icc_store_removed_cb),
 			  user_data);
+	g_signal_connect (priv->icc_store, "changed",
+			  G_CALLBACK (cd_main_icc_store_changed_cb),
+			  user_data);
 
-	/* search locations for ICC profiles */
-	ret = cd_icc_store_search_kind (priv->icc_store,
-					CD_ICC_STORE_SEARCH_KIND_SYSTEM,
-					CD_ICC_STORE_SEARCH_FLAGS_NONE,
-					NULL,
-					&error);
-	if (!ret) {
-		g_warning ("CdMain: failed to search system directories: %s",
-			    error->message);
-		return;
-	}
-	ret = cd_icc_store_search_kind (priv->icc_store,
-					CD_ICC_STORE_SEARCH_KIND_MACHINE,
-					CD_ICC_STORE_SEARCH_FLAGS_NONE,
-					NULL,
-					&error);
+	/* add disk devices; profiles are matched to them as they appear */
+	ret = cd_device_db_load_all (priv->device_db,
+				     cd_main_add_disk_device,
+				     priv,
+				     &error);
 	if (!ret) {
-		g_warning ("CdMain: failed to search machine directories: %s",
-			    error->message);
-		return;
-	}
-
-	/* add disk devices */
-	array_devices = cd_device_db_get_devices (priv->device_db, &error);
-	if (array_devices == NULL) {
 		g_warning ("CdMain: failed to get the disk devices: %s",
 			    error->message);
-		return;
-	}
-	for (i = 0; i < array_devices->len; i++) {
-		device_id = g_ptr_array_index (array_devices, i);
-		cd_main_add_disk_device (priv, device_id);
+		g_clear_error (&error);
 	}
+	cd_main_state_restore (priv);
+	cd_main_set_startup_stage (priv, CD_MAIN_STARTUP_STAGE_CORE);
 
-	/* add sensor devices */
-	cd_sensor_client_coldplug (priv->sensor_client);
-
-	/* coldplug plugin devices */
-	cd_main_plugin_phase (priv, CD_PLUGIN_PHASE_COLDPLUG);
-
-	/* add dummy sensor */
-	if (priv->create_dummy_sensor) {
-		sensor = cd_sensor_new ();
-		cd_sensor_set_kind (sensor, CD_SENSOR_KIND_DUMMY);
-		ret = cd_sensor_load (sensor, &error);
-		if (!ret) {
-			g_warning ("CdMain: failed to load dummy sensor: %s",
-				    error->message);
-			g_clear_error (&error);
-		} else {
-			cd_main_add_sensor (priv, sensor);
-		}
-	}
+	/* load everything else without blocking the bus */
+	priv->startup_id = g_idle_add (cd_main_startup_cb, priv);
 }
 
 static void
@@ -1947,11 +3407,16 @@ cd_main_client_sensor_added_cb (CdSensorClient *sensor_client_,
 }
 
 static void
-cd_main_client_sensor_removed_cb (CdSensorClient *sensor_client_,
-				  CdSensor *sensor,
-				  gpointer user_data)
+cd_main_remove_sensor (CdMainPrivate *priv, CdSensor *sensor)
 {
-	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	g_autoptr(CdSensor) sensor_ref = g_object_ref (sensor);
+
+	/* a group is no use without all of its members */
+	for (guint i = priv->sensors->len; i > 0; i--) {
+		CdSensor *group = g_ptr_array_index (priv->sensors, i - 1);
+		if (cd_sensor_has_member (group, sensor))
+			cd_main_remove_sensor (priv, group);
+	}
 
 	/* emit signal */
 	g_debug ("CdMain: Emitting SensorRemoved(%s)",
@@ -1966,6 +3431,16 @@ cd_main_client_sensor_removed_cb (CdSensorClient *sensor_client_,
 						      cd_sensor_get_object_path (sensor)),
 				       NULL);
 	g_ptr_array_remove (priv->sensors, sensor);
+	g_clear_pointer (&priv->sensors_variant, g_variant_unref);
+}
+
+static void
+cd_main_client_sensor_removed_cb (CdSensorClient *sensor_client_,
+				  CdSensor *sensor,
+				  gpointer user_data)
+{
+	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	cd_main_remove_sensor (priv, sensor);
 }
 
 static gboolean
@@ -1976,25 +3451,6 @@ cd_main_timed_exit_cb (gpointer user_data)
 	return G_SOURCE_REMOVE;
 }
 
-static GDBusNodeInfo *
-cd_main_load_introspection (const gchar *filename, GError **error)
-{
-	g_autoptr(GBytes) data = NULL;
-	g_autofree gchar *path = NULL;
-
-	/* lookup data */
-	path = g_build_filename ("/org/freedesktop/colord", filename, NULL);
-	data = g_resource_lookup_data (cd_get_resource (),
-				       path,
-				       G_RESOURCE_LOOKUP_FLAGS_NONE,
-				       error);
-	if (data == NULL)
-		return NULL;
-
-	/* build introspection from XML */
-	return g_dbus_node_info_new_for_xml (g_bytes_get_data (data, NULL), error);
-}
-
 static void
 cd_main_plugin_free (CdPlugin *plugin)
 {
@@ -2009,14 +3465,22 @@ cd_main_plugin_device_added_cb (CdPlugin *plugin,
 				gpointer user_data)
 {
 	CdMainPrivate *priv = (CdMainPrivate *) user_data;
+	CdDevice *restored;
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
 
 	cd_device_set_mode (device, CD_DEVICE_MODE_PHYSICAL);
+	g_hash_table_add (priv->plugin_device_ids, g_strdup (cd_device_get_id (device)));
+	restored = g_hash_table_lookup (priv->restored_devices, cd_device_get_id (device));
+	if (restored != NULL) {
+		cd_main_state_replace (priv, restored, device);
+		return;
+	}
 	ret = cd_main_device_add (priv, device, NULL, &error);
 	if (!ret) {
 		g_warning ("CdMain: failed to add device: %s",
 			   error->message);
+		g_hash_table_remove (priv->plugin_device_ids, cd_device_get_id (device));
 		return;
 	}
 
@@ -2029,6 +3493,23 @@ cd_main_plugin_device_added_cb (CdPlugin *plugin,
 	}
 }
 
+static void
+cd_main_plugin_devices_added_cb (CdPlugin *plugin,
+				 GPtrArray *devices,
+				 gpointer user_data)
+{
+	guint i;
+
+	/* the database transaction is opened by the coldplug phase */
+	g_debug ("CdMain: adding %u devices from %s",
+		 devices->len, g_module_name (plugin->module));
+	for (i = 0; i < devices->len; i++) {
+		cd_main_plugin_device_added_cb (plugin,
+						g_ptr_array_index (devices, i),
+						user_data);
+	}
+}
+
 static void
 cd_main_plugin_device_removed_cb (CdPlugin *plugin,
 				  CdDevice *device,
@@ -2090,6 +3571,7 @@ cd_main_load_plugin (CdMainPrivate *priv,
 	plugin->module = module;
 	plugin->device_added = cd_main_plugin_device_added_cb;
 	plugin->device_removed = cd_main_plugin_device_removed_cb;
+	plugin->devices_added = cd_main_plugin_devices_added_cb;
 
 	/* add to array */
 	g_ptr_array_add (priv->plugins, plugin);
@@ -2145,10 +3627,12 @@ cd_main_load_plugins (CdMainPrivate *priv)
 }
 
 static CdEdid *
-cd_main_get_edid_for_output (const gchar *output_name)
+cd_main_get_edid_for_output (CdMainPrivate *priv, const gchar *output_name)
 {
+	CdEdid *edid_cached;
 	gboolean ret;
 	gsize len = 0;
+	g_autofree gchar *checksum = NULL;
 	g_autoptr(GBytes) data = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *edid_data = NULL;
@@ -2187,6 +3671,13 @@ cd_main_get_edid_for_output (const gchar *output_name)
 		return NULL;
 	}
 
+	/* the same monitor has already been parsed */
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+						(const guchar *) edid_data, len);
+	edid_cached = g_hash_table_lookup (priv->edids, checksum);
+	if (edid_cached != NULL)
+		return g_object_ref (edid_cached);
+
 	/* parse EDID */
 	edid = cd_edid_new ();
 	data = g_bytes_new (edid_data, len);
@@ -2194,6 +3685,9 @@ cd_main_get_edid_for_output (const gchar *output_name)
 		g_warning ("failed to get edid data: %s", error->message);
 		return NULL;
 	}
+	g_hash_table_insert (priv->edids,
+			     g_steal_pointer (&checksum),
+			     g_object_ref (edid));
 	return g_object_ref (edid);
 }
 
@@ -2213,7 +3707,7 @@ cd_main_get_display_id (CdEdid *edid)
 }
 
 static gboolean
-cd_main_check_duplicate_edids (void)
+cd_main_check_duplicate_edids (CdMainPrivate *priv)
 {
 	const gchar *fn;
 	gboolean use_xrandr_mode = FALSE;
@@ -2228,13 +3722,14 @@ cd_main_check_duplicate_edids (void)
 	hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	while (!use_xrandr_mode && (fn = g_dir_read_name (dir)) != NULL) {
 		gpointer old_output;
+		g_autofree gchar *display_id = NULL;
 		g_autoptr(CdEdid) edid = NULL;
-		edid = cd_main_get_edid_for_output (fn);
+		edid = cd_main_get_edid_for_output (priv, fn);
 		if (edid == NULL)
 			continue;
+		display_id = cd_main_get_display_id (edid);
 		g_debug ("display %s has ID '%s' from MD5 %s",
-			 fn, cd_main_get_display_id (edid),
-			 cd_edid_get_checksum (edid));
+			 fn, display_id, cd_edid_get_checksum (edid));
 		old_output = g_hash_table_lookup (hash, cd_edid_get_checksum (edid));
 		if (old_output != NULL) {
 			g_debug ("output %s has duplicate EDID", fn);
@@ -2345,8 +3840,14 @@ main (int argc, char *argv[])
 	CdMainPrivate *priv = NULL;
 	gboolean immediate_exit = FALSE;
 	gboolean create_dummy_sensor = FALSE;
+	gint create_dummy_sensors = 0;
 	gboolean ret;
 	gboolean timed_exit = FALSE;
+	gint max_profile_objects = 0;
+	g_autofree gchar *provision_filename = NULL;
+	g_autofree gchar *root_dir = NULL;
+	g_autofree gchar *db_filename = NULL;
+	g_autofree gchar *provision_checksum = NULL;
 	GOptionContext *context;
 	guint owner_id = 0;
 	guint retval = 1;
@@ -2360,6 +3861,18 @@ main (int argc, char *argv[])
 		{ "create-dummy-sensor", '\0', 0, G_OPTION_ARG_NONE, &create_dummy_sensor,
 		  /* TRANSLATORS: exit straight away, used for automatic profiling */
 		  _("Create a dummy sensor for testing"), NULL },
+		{ "create-dummy-sensors", '\0', 0, G_OPTION_ARG_INT, &create_dummy_sensors,
+		  /* TRANSLATORS: used for benchmarking clients without hardware */
+		  _("Create a number of dummy sensors for testing"), NULL },
+		{ "max-profile-objects", '\0', 0, G_OPTION_ARG_INT, &max_profile_objects,
+		  /* TRANSLATORS: used on systems with a very large number of profiles */
+		  _("Only keep this many profile objects loaded when idle"), NULL },
+		{ "provision", '\0', 0, G_OPTION_ARG_FILENAME, &provision_filename,
+		  /* TRANSLATORS: a file of devices and profiles to set up at startup */
+		  _("Load devices and profile mappings from a file"), NULL },
+		{ "root-dir", '\0', 0, G_OPTION_ARG_FILENAME, &root_dir,
+		  /* TRANSLATORS: used for benchmarking against synthetic data */
+		  _("Use an alternate root for all databases and profiles"), NULL },
 		{ NULL}
 	};
 	g_autoptr(GError) error = NULL;
@@ -2385,10 +3898,34 @@ main (int argc, char *argv[])
 
 	/* create new objects */
 	priv = g_new0 (CdMainPrivate, 1);
-	priv->create_dummy_sensor = create_dummy_sensor;
+	priv->root_dir = g_steal_pointer (&root_dir);
+	cd_profile_set_root_dir (priv->root_dir);
+	priv->create_dummy_sensors = MAX (create_dummy_sensors, 0);
+	if (create_dummy_sensor && priv->create_dummy_sensors == 0)
+		priv->create_dummy_sensors = 1;
 	priv->loop = g_main_loop_new (NULL, FALSE);
 	priv->devices_array = cd_device_array_new ();
 	priv->profiles_array = cd_profile_array_new ();
+	priv->max_profile_objects = MAX (max_profile_objects, 0);
+	if (priv->max_profile_objects > 0) {
+		cd_profile_array_set_load_func (priv->profiles_array,
+						cd_main_profile_load_cb,
+						priv);
+		cd_profile_array_set_max_loaded (priv->profiles_array,
+						 priv->max_profile_objects);
+	}
+	priv->devices_added = g_ptr_array_new_with_free_func (g_free);
+	priv->profiles_added = g_ptr_array_new_with_free_func (g_free);
+	priv->snapshot_fds = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						    NULL, (GDestroyNotify) cd_main_snapshot_fd_free);
+	priv->edids = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     g_free, (GDestroyNotify) g_object_unref);
+	priv->plugin_device_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+							 g_free, NULL);
+	priv->restored_devices = g_hash_table_new_full (g_str_hash, g_str_equal,
+							g_free, (GDestroyNotify) g_object_unref);
+	priv->imported_files = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, g_free);
 	priv->sensors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	priv->sensor_client = cd_sensor_client_new ();
 	g_signal_connect (priv->sensor_client, "sensor-added",
@@ -2400,9 +3937,8 @@ main (int argc, char *argv[])
 
 	/* connect to the mapping db */
 	priv->mapping_db = cd_mapping_db_new ();
-	ret = cd_mapping_db_load (priv->mapping_db,
-				  LOCALSTATEDIR "/lib/colord/mapping.db",
-				  &error);
+	db_filename = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/mapping.db");
+	ret = cd_mapping_db_load (priv->mapping_db, db_filename, &error);
 	if (!ret) {
 		g_warning ("CdMain: failed to load mapping database: %s",
 			   error->message);
@@ -2411,56 +3947,56 @@ main (int argc, char *argv[])
 
 	/* connect to the device db */
 	priv->device_db = cd_device_db_new ();
-	ret = cd_device_db_load (priv->device_db,
-				 LOCALSTATEDIR "/lib/colord/storage.db",
-				 &error);
+	g_free (db_filename);
+	db_filename = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/storage.db");
+	ret = cd_device_db_load (priv->device_db, db_filename, &error);
 	if (!ret) {
 		g_warning ("CdMain: failed to load device database: %s",
 			   error->message);
 		goto out;
 	}
 
+	/* write any provisioned devices and mappings before they are loaded */
+	if (provision_filename == NULL)
+		provision_filename = cd_main_get_path (priv, SYSCONFDIR "/colord/provision.conf");
+	provision_checksum = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/provision.sha256");
+	ret = cd_provision_apply (provision_filename,
+				  provision_checksum,
+				  priv->device_db,
+				  priv->mapping_db,
+				  NULL,
+				  &error);
+	if (!ret) {
+		g_warning ("CdMain: failed to provision from %s: %s",
+			   provision_filename, error->message);
+		g_clear_error (&error);
+	}
+
 	/* connect to the profile db */
 	priv->profile_db = cd_profile_db_new ();
-	ret = cd_profile_db_load (priv->profile_db,
-				  LOCALSTATEDIR "/lib/colord/storage.db",
-				  &error);
+	ret = cd_profile_db_load (priv->profile_db, db_filename, &error);
 	if (!ret) {
 		g_warning ("CdMain: failed to load profile database: %s",
 			   error->message);
 		goto out;
 	}
 
-	/* load introspection from file */
-	priv->introspection_daemon = cd_main_load_introspection (COLORD_DBUS_INTERFACE ".xml",
-								 &error);
-	if (priv->introspection_daemon == NULL) {
-		g_warning ("CdMain: failed to load daemon introspection: %s",
-			   error->message);
-		goto out;
-	}
-	priv->introspection_device = cd_main_load_introspection (COLORD_DBUS_INTERFACE_DEVICE ".xml",
-								 &error);
-	if (priv->introspection_device == NULL) {
-		g_warning ("CdMain: failed to load device introspection: %s",
-			   error->message);
-		goto out;
-	}
-	priv->introspection_profile = cd_main_load_introspection (COLORD_DBUS_INTERFACE_PROFILE ".xml",
-								  &error);
-	if (priv->introspection_profile == NULL) {
-		g_warning ("CdMain: failed to load profile introspection: %s",
-			   error->message);
-		goto out;
-	}
-	priv->introspection_sensor = cd_main_load_introspection (COLORD_DBUS_INTERFACE_SENSOR ".xml",
-								 &error);
-	if (priv->introspection_sensor == NULL) {
-		g_warning ("CdMain: failed to load sensor introspection: %s",
+	/* load any saved sensor calibration */
+	g_free (db_filename);
+	db_filename = cd_main_get_path (priv, LOCALSTATEDIR "/lib/colord/sensors.ini");
+	ret = cd_sensor_cache_load (db_filename, &error);
+	if (!ret) {
+		g_warning ("CdMain: failed to load sensor cache: %s",
 			   error->message);
-		goto out;
+		g_clear_error (&error);
 	}
 
+	/* compiled in at build time, so activation does no XML parsing */
+	priv->introspection_daemon = (GDBusInterfaceInfo *) &cd_color_manager_interface;
+	priv->introspection_device = (GDBusInterfaceInfo *) &cd_color_manager_device_interface;
+	priv->introspection_profile = (GDBusInterfaceInfo *) &cd_color_manager_profile_interface;
+	priv->introspection_sensor = (GDBusInterfaceInfo *) &cd_color_manager_sensor_interface;
+
 	/* own the object */
 	owner_id = g_bus_own_name (G_BUS_TYPE_SYSTEM,
 				   COLORD_DBUS_SERVICE,
@@ -2478,6 +4014,11 @@ main (int argc, char *argv[])
 	else if (timed_exit)
 		g_timeout_add_seconds (5, cd_main_timed_exit_cb, priv->loop);
 
+#ifdef __unix__
+	/* exit cleanly so that batched database writes are committed */
+	g_unix_signal_add (SIGTERM, cd_main_timed_exit_cb, priv->loop);
+#endif
+
 	/* If the user has two or more outputs attached with identical EDID data
 	 * then the client tools cannot tell them apart. By setting this value
 	 * the 'xrandr-' style device-id is always used and the monitors will
@@ -2486,7 +4027,7 @@ main (int argc, char *argv[])
 	 * xrandr output name, rather than the monitor itself. This means that
 	 * if the monitor cables are swapped then the wrong profile would be
 	 * used. */
-	priv->always_use_xrandr_name = cd_main_check_duplicate_edids ();
+	priv->always_use_xrandr_name = cd_main_check_duplicate_edids (priv);
 
 	/* load plugins */
 	priv->plugins = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_main_plugin_free);
@@ -2502,9 +4043,25 @@ main (int argc, char *argv[])
 	g_info ("Daemon ready for requests");
 	g_main_loop_run (priv->loop);
 
+	/* so the next activation can show the plugin devices straight away */
+	cd_main_state_save (priv);
+
 	/* run the plugins */
 	cd_main_plugin_phase (priv, CD_PLUGIN_PHASE_DESTROY);
 
+	/* the database singletons may outlive us, so commit the last batch
+	 * rather than relying on them being finalized */
+	if (!cd_device_db_flush (priv->device_db, &error) ||
+	    !cd_profile_db_flush (priv->profile_db, &error)) {
+		g_warning ("CdMain: failed to commit on exit: %s", error->message);
+		g_clear_error (&error);
+	}
+	if (!cd_mapping_db_close (priv->mapping_db, &error)) {
+		g_warning ("CdMain: failed to close mapping database: %s",
+			   error->message);
+		g_clear_error (&error);
+	}
+
 	/* success */
 	retval = 0;
 out:
@@ -2512,11 +4069,15 @@ out:
 	g_option_context_free (context);
 	if (owner_id > 0)
 		g_bus_unown_name (owner_id);
+	cd_profile_set_root_dir (NULL);
 	if (priv != NULL) {
+		g_free (priv->root_dir);
 		if (priv->loop != NULL)
 			g_main_loop_unref (priv->loop);
 		if (priv->sensors != NULL)
 			g_ptr_array_unref (priv->sensors);
+		if (priv->sensors_variant != NULL)
+			g_variant_unref (priv->sensors_variant);
 		if (priv->plugins != NULL)
 			g_ptr_array_unref (priv->plugins);
 		if (priv->sensor_client != NULL)
@@ -2533,16 +4094,34 @@ out:
 			g_object_unref (priv->devices_array);
 		if (priv->profiles_array != NULL)
 			g_object_unref (priv->profiles_array);
+		if (priv->added_id != 0)
+			g_source_remove (priv->added_id);
+		if (priv->startup_id != 0)
+			g_source_remove (priv->startup_id);
+		if (priv->devices_added != NULL)
+			g_ptr_array_unref (priv->devices_added);
+		if (priv->profiles_added != NULL)
+			g_ptr_array_unref (priv->profiles_added);
+		if (priv->snapshot_fds != NULL)
+			g_hash_table_unref (priv->snapshot_fds);
+		if (priv->edids != NULL)
+			g_hash_table_unref (priv->edids);
+		if (priv->restored_id != 0)
+			g_source_remove (priv->restored_id);
+		if (priv->restored_devices != NULL)
+			g_hash_table_unref (priv->restored_devices);
+		if (priv->plugin_device_ids != NULL)
+			g_hash_table_unref (priv->plugin_device_ids);
+		if (priv->imported_files != NULL)
+			g_hash_table_unref (priv->imported_files);
+		if (priv->read_filter_id != 0)
+			g_dbus_connection_remove_filter (priv->connection, priv->read_filter_id);
+		if (priv->name_owner_changed_id != 0)
+			g_dbus_connection_signal_unsubscribe (priv->connection, priv->name_owner_changed_id);
+		if (priv->read_snapshot != NULL)
+			cd_main_read_snapshot_unref (priv->read_snapshot);
 		if (priv->connection != NULL)
 			g_object_unref (priv->connection);
-		if (priv->introspection_daemon != NULL)
-			g_dbus_node_info_unref (priv->introspection_daemon);
-		if (priv->introspection_device != NULL)
-			g_dbus_node_info_unref (priv->introspection_device);
-		if (priv->introspection_profile != NULL)
-			g_dbus_node_info_unref (priv->introspection_profile);
-		if (priv->introspection_sensor != NULL)
-			g_dbus_node_info_unref (priv->introspection_sensor);
 		g_free (priv->system_vendor);
 		g_free (priv->system_model);
 		g_free (priv);
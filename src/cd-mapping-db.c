@@ -37,12 +37,237 @@ static void     cd_mapping_db_finalize	(GObject        *object);
 typedef struct
 {
 	sqlite3			*db;
+	GHashTable		*statements;	/* sql : sqlite3_stmt */
+	guint			 commit_id;
+	guint			 item_serial;
+	GHashTable		*devices;	/* device_id : profile_id : CdMappingDbItem */
+	GHashTable		*profiles;	/* profile_id : device_id : CdMappingDbItem */
+	gchar			*filename;
+	GCancellable		*check_cancellable;
+	gboolean		 read_only;	/* writes only go to the index */
+	gboolean		 dirty;		/* index has writes not on disk */
 } CdMappingDbPrivate;
 
+/* one row of mappings_v2, shared by both indexes */
+typedef struct {
+	gchar			*device_id;
+	gchar			*profile_id;
+	guint64			 timestamp;
+	guint			 serial;	/* insertion order, for ties */
+} CdMappingDbItem;
+
 static gpointer cd_mapping_db_object = NULL;
 
+/* written after an orderly close, so the next open can skip the check */
+#define CD_MAPPING_DB_CLEAN_SUFFIX	".clean"
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdMappingDb, cd_mapping_db, G_TYPE_OBJECT)
 
+/* commits any writes still waiting in the batch */
+gboolean
+cd_mapping_db_flush (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
+	if (priv->db == NULL)
+		return TRUE;
+	return cd_sqlite_batch_commit (priv->db, &priv->commit_id, error);
+}
+
+
+static gboolean
+cd_mapping_db_commit_cb (gpointer user_data)
+{
+	CdMappingDb *mdb = CD_MAPPING_DB (user_data);
+	g_autoptr(GError) error = NULL;
+	if (!cd_mapping_db_flush (mdb, &error)) {
+		g_warning ("CdMappingDb: failed to commit, retrying: %s", error->message);
+		return G_SOURCE_CONTINUE;
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* opens a write transaction, committed by a flush or after a timeout */
+gboolean
+cd_mapping_db_begin (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
+	if (priv->db == NULL)
+		return TRUE;
+	return cd_sqlite_batch_begin (priv->db,
+				      &priv->commit_id,
+				      cd_mapping_db_commit_cb,
+				      mdb,
+				      error);
+}
+
+static void
+cd_mapping_db_item_free (CdMappingDbItem *item)
+{
+	g_free (item->device_id);
+	g_free (item->profile_id);
+	g_free (item);
+}
+
+static CdMappingDbItem *
+cd_mapping_db_index_lookup (CdMappingDb *mdb,
+			    const gchar *device_id,
+			    const gchar *profile_id)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	GHashTable *profiles;
+
+	profiles = g_hash_table_lookup (priv->devices, device_id);
+	if (profiles == NULL)
+		return NULL;
+	return g_hash_table_lookup (profiles, profile_id);
+}
+
+static void
+cd_mapping_db_index_set (CdMappingDb *mdb,
+			 const gchar *device_id,
+			 const gchar *profile_id,
+			 guint64 timestamp)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	CdMappingDbItem *item;
+	GHashTable *devices;
+	GHashTable *profiles;
+
+	/* already exists */
+	item = cd_mapping_db_index_lookup (mdb, device_id, profile_id);
+	if (item != NULL) {
+		item->timestamp = timestamp;
+		return;
+	}
+
+	item = g_new0 (CdMappingDbItem, 1);
+	item->device_id = g_strdup (device_id);
+	item->profile_id = g_strdup (profile_id);
+	item->timestamp = timestamp;
+	item->serial = priv->item_serial++;
+
+	/* the device index owns the item */
+	profiles = g_hash_table_lookup (priv->devices, device_id);
+	if (profiles == NULL) {
+		profiles = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						  (GDestroyNotify) cd_mapping_db_item_free);
+		g_hash_table_insert (priv->devices, g_strdup (device_id), profiles);
+	}
+	devices = g_hash_table_lookup (priv->profiles, profile_id);
+	if (devices == NULL) {
+		devices = g_hash_table_new (g_str_hash, g_str_equal);
+		g_hash_table_insert (priv->profiles, g_strdup (profile_id), devices);
+	}
+	g_hash_table_insert (devices, item->device_id, item);
+	g_hash_table_insert (profiles, item->profile_id, item);
+}
+
+static void
+cd_mapping_db_index_remove (CdMappingDb *mdb,
+			    const gchar *device_id,
+			    const gchar *profile_id)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	GHashTable *devices;
+	GHashTable *profiles;
+
+	devices = g_hash_table_lookup (priv->profiles, profile_id);
+	if (devices != NULL) {
+		g_hash_table_remove (devices, device_id);
+		if (g_hash_table_size (devices) == 0)
+			g_hash_table_remove (priv->profiles, profile_id);
+	}
+	profiles = g_hash_table_lookup (priv->devices, device_id);
+	if (profiles != NULL) {
+		g_hash_table_remove (profiles, profile_id);
+		if (g_hash_table_size (profiles) == 0)
+			g_hash_table_remove (priv->devices, device_id);
+	}
+}
+
+static gint
+cd_mapping_db_item_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const CdMappingDbItem *item_a = *((CdMappingDbItem **) a);
+	const CdMappingDbItem *item_b = *((CdMappingDbItem **) b);
+	if (item_a->timestamp < item_b->timestamp)
+		return -1;
+	if (item_a->timestamp > item_b->timestamp)
+		return 1;
+	if (item_a->serial < item_b->serial)
+		return -1;
+	if (item_a->serial > item_b->serial)
+		return 1;
+	return 0;
+}
+
+/* returns the device or profile IDs of @items, oldest first */
+static GPtrArray *
+cd_mapping_db_index_get_ids (GHashTable *items, gboolean want_devices)
+{
+	CdMappingDbItem *item;
+	GHashTableIter iter;
+	GPtrArray *array;
+	guint i;
+	g_autoptr(GPtrArray) sorted = g_ptr_array_new ();
+
+	array = g_ptr_array_new_with_free_func (g_free);
+	if (items == NULL)
+		return array;
+
+	/* a zero timestamp means the user explicitly removed it */
+	g_hash_table_iter_init (&iter, items);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item)) {
+		if (item->timestamp > 0)
+			g_ptr_array_add (sorted, item);
+	}
+	g_ptr_array_sort (sorted, cd_mapping_db_item_sort_cb);
+	for (i = 0; i < sorted->len; i++) {
+		item = g_ptr_array_index (sorted, i);
+		g_ptr_array_add (array, g_strdup (want_devices ? item->device_id :
+								 item->profile_id));
+	}
+	return array;
+}
+
+/* reads all of mappings_v2 so lookups never have to touch the disk */
+static gboolean
+cd_mapping_db_index_load (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	sqlite3_stmt *stmt;
+	gint rc;
+
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT device, profile, timestamp FROM mappings_v2 ORDER BY rowid;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		const gchar *device_id = (const gchar *) sqlite3_column_text (stmt, 0);
+		const gchar *profile_id = (const gchar *) sqlite3_column_text (stmt, 1);
+		if (device_id == NULL || profile_id == NULL)
+			continue;
+		cd_mapping_db_index_set (mdb, device_id, profile_id,
+					 (guint64) sqlite3_column_int64 (stmt, 2));
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg(priv->db));
+		sqlite3_reset (stmt);
+		return FALSE;
+	}
+	sqlite3_reset (stmt);
+	g_debug ("CdMappingDb: loaded mappings for %u devices",
+		 g_hash_table_size (priv->devices));
+	return TRUE;
+}
+
 static gint
 cd_mapping_db_convert_cb (void *data, gint argc, gchar **argv, gchar **col_name)
 {
@@ -61,10 +286,7 @@ cd_mapping_db_convert_cb (void *data, gint argc, gchar **argv, gchar **col_name)
 }
 
 static gboolean
-cd_mapping_db_open (CdMappingDb *mdb,
-		    const gchar *filename,
-		    gboolean retry,
-		    GError  **error)
+cd_mapping_db_open (CdMappingDb *mdb, GError **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
 	gint rc;
@@ -74,13 +296,13 @@ cd_mapping_db_open (CdMappingDb *mdb,
 	g_return_val_if_fail (priv->db == NULL, FALSE);
 
 	/* ensure the path exists */
-	path = g_path_get_dirname (filename);
+	path = g_path_get_dirname (priv->filename);
 	if (!cd_main_mkdir_with_parents (path, error))
 		return FALSE;
 
-	g_debug ("CdMappingDb: trying to open database '%s'", filename);
-	g_info ("Using mapping database file %s", filename);
-	rc = sqlite3_open (filename, &priv->db);
+	g_debug ("CdMappingDb: trying to open database '%s'", priv->filename);
+	g_info ("Using mapping database file %s", priv->filename);
+	rc = sqlite3_open (priv->filename, &priv->db);
 	if (rc != SQLITE_OK) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
@@ -88,64 +310,255 @@ cd_mapping_db_open (CdMappingDb *mdb,
 			     "Can't open database: %s\n",
 			     sqlite3_errmsg (priv->db));
 		sqlite3_close (priv->db);
+		priv->db = NULL;
 		return FALSE;
 	}
+	return TRUE;
+}
 
-	/* sanity check of the database */
-	rc = sqlite3_exec (priv->db, "PRAGMA quick_check", NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		/* Database appears to be mangled, so wipe it and try again */
-		sqlite3_close (priv->db);
-		priv->db = NULL;
+static void
+cd_mapping_db_close (CdMappingDb *mdb)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+
+	/* anything still batched is discarded */
+	if (priv->commit_id != 0) {
+		g_source_remove (priv->commit_id);
+		priv->commit_id = 0;
+	}
+	g_hash_table_remove_all (priv->statements);
+	sqlite3_close (priv->db);
+	priv->db = NULL;
+}
+
+/* replaces the contents of mappings_v2 with the in-memory index */
+static gboolean
+cd_mapping_db_index_save (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	CdMappingDbItem *item;
+	GHashTable *profiles;
+	GHashTableIter iter;
+	GHashTableIter iter_profiles;
+	sqlite3_stmt *stmt;
+	guint i;
+	g_autoptr(GPtrArray) items = g_ptr_array_new ();
+
+	/* keep the insertion order for mappings with the same timestamp */
+	g_hash_table_iter_init (&iter, priv->devices);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profiles)) {
+		g_hash_table_iter_init (&iter_profiles, profiles);
+		while (g_hash_table_iter_next (&iter_profiles, NULL, (gpointer *) &item))
+			g_ptr_array_add (items, item);
+	}
+	g_ptr_array_sort (items, cd_mapping_db_item_sort_cb);
+
+	if (!cd_mapping_db_begin (mdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "DELETE FROM mappings_v2;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	for (i = 0; i < items->len; i++) {
+		item = g_ptr_array_index (items, i);
+		stmt = cd_sqlite_prepare (priv->db, priv->statements,
+					  "INSERT OR REPLACE INTO mappings_v2 (device, profile, timestamp) "
+					  "VALUES (?1, ?2, ?3);",
+					  error);
+		if (stmt == NULL)
+			return FALSE;
+		sqlite3_bind_text (stmt, 1, item->device_id, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_text (stmt, 2, item->profile_id, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64 (stmt, 3, (gint64) item->timestamp);
+		if (!cd_sqlite_step (priv->db, stmt, error))
+			return FALSE;
+	}
+	return cd_mapping_db_flush (mdb, error);
+}
+
+static gboolean cd_mapping_db_setup (CdMappingDb *mdb, GError **error);
+
+/* throws away a damaged file, keeping whatever is already in the index */
+static gboolean
+cd_mapping_db_recreate (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	const gchar *suffixes[] = { "", "-wal", "-shm", NULL };
+	guint i;
 
-		if (retry) {
-			if (g_unlink (filename) != 0) {
-				g_set_error (error,
-					     CD_CLIENT_ERROR,
-					     CD_CLIENT_ERROR_INTERNAL,
-					     "Cannot remove damaged database: %s",
-					     g_strerror (errno));
-				return FALSE;
-			}
-
-			return cd_mapping_db_open (mdb, filename, FALSE, error);
-		} else {
+	cd_mapping_db_close (mdb);
+	for (i = 0; suffixes[i] != NULL; i++) {
+		g_autofree gchar *tmp = g_strconcat (priv->filename, suffixes[i], NULL);
+		if (g_unlink (tmp) != 0 && errno != ENOENT) {
 			g_set_error (error,
 				     CD_CLIENT_ERROR,
 				     CD_CLIENT_ERROR_INTERNAL,
-				     "Cannot open mapping database: %s",
-				     sqlite3_errmsg(priv->db));
+				     "Cannot remove damaged database: %s",
+				     g_strerror (errno));
 			return FALSE;
 		}
 	}
+	if (!cd_mapping_db_open (mdb, error))
+		return FALSE;
+	return cd_mapping_db_setup (mdb, error);
+}
 
-	return TRUE;
+static gint
+cd_mapping_db_check_row_cb (void *data, gint argc, gchar **argv, gchar **col_name)
+{
+	gchar **result = (gchar **) data;
+	if (*result == NULL && argc > 0)
+		*result = g_strdup (argv[0] != NULL ? argv[0] : "");
+	return 0;
 }
 
-gboolean
-cd_mapping_db_load (CdMappingDb *mdb,
-		    const gchar *filename,
-		    GError  **error)
+/* runs on a private read-only connection so the main one stays usable */
+static void
+cd_mapping_db_check_thread_cb (GTask *task,
+			       gpointer source_object,
+			       gpointer task_data,
+			       GCancellable *cancellable)
 {
-	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	const gchar *statement;
+	const gchar *filename = (const gchar *) task_data;
 	gint rc;
-	g_autofree gchar *path = NULL;
+	sqlite3 *db = NULL;
+	g_autofree gchar *result = NULL;
 
+	rc = sqlite3_open_v2 (filename, &db, SQLITE_OPEN_READONLY, NULL);
+	if (rc == SQLITE_OK) {
+		rc = sqlite3_exec (db, "PRAGMA quick_check",
+				   cd_mapping_db_check_row_cb, &result, NULL);
+	}
+	if (rc != SQLITE_OK) {
+		g_task_return_new_error (task,
+					 CD_CLIENT_ERROR,
+					 CD_CLIENT_ERROR_INTERNAL,
+					 "SQL error: %s",
+					 sqlite3_errmsg (db));
+		sqlite3_close (db);
+		return;
+	}
+	sqlite3_close (db);
+	if (g_strcmp0 (result, "ok") != 0) {
+		g_task_return_new_error (task,
+					 CD_CLIENT_ERROR,
+					 CD_CLIENT_ERROR_INTERNAL,
+					 "Integrity check failed: %s",
+					 result);
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+cd_mapping_db_check_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	CdMappingDb *mdb;
+	CdMappingDbPrivate *priv;
+	GTask *task = G_TASK (res);
+	g_autoptr(GError) error = NULL;
+
+	/* the database was closed while the check was running */
+	if (g_cancellable_is_cancelled (g_task_get_cancellable (task)))
+		return;
+
+	mdb = CD_MAPPING_DB (user_data);
+	priv = GET_PRIVATE (mdb);
+	g_clear_object (&priv->check_cancellable);
+	if (!g_task_propagate_boolean (task, &error)) {
+		g_warning ("CdMappingDb: %s is damaged, recreating: %s",
+			   priv->filename, error->message);
+		g_clear_error (&error);
+		if (!cd_mapping_db_recreate (mdb, &error)) {
+			g_warning ("CdMappingDb: failed to recreate: %s",
+				   error->message);
+			return;
+		}
+		priv->dirty = TRUE;
+	}
+
+	/* write out everything changed while the file was being checked */
+	priv->read_only = FALSE;
+	if (priv->dirty) {
+		if (!cd_mapping_db_index_save (mdb, &error)) {
+			g_warning ("CdMappingDb: failed to save mappings: %s",
+				   error->message);
+			return;
+		}
+		priv->dirty = FALSE;
+	}
+	g_debug ("CdMappingDb: integrity check complete");
+}
+
+/*
+ * Checking a large file can take a long time on slow storage, so after an
+ * unclean exit the index loaded from the file is used read-only while
+ * the check runs in a thread. Writes are only made to the index until the
+ * check completes, and are then written back in one transaction.
+ */
+static void
+cd_mapping_db_check_start (CdMappingDb *mdb)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	g_autoptr(GTask) task = NULL;
+
+	g_debug ("CdMappingDb: not closed cleanly, checking %s", priv->filename);
+	priv->read_only = TRUE;
+	priv->check_cancellable = g_cancellable_new ();
+	task = g_task_new (NULL, priv->check_cancellable,
+			   cd_mapping_db_check_cb, mdb);
+	g_task_set_task_data (task, g_strdup (priv->filename), g_free);
+	g_task_run_in_thread (task, cd_mapping_db_check_thread_cb);
+}
+
+/* TRUE when writes are only being made to the in-memory index */
+gboolean
+cd_mapping_db_get_read_only (CdMappingDb *mdb)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
-	g_return_val_if_fail (priv->db == NULL, FALSE);
+	return priv->read_only;
+}
 
-	if (!cd_mapping_db_open (mdb, filename, TRUE, error))
-		return FALSE;
+/*
+ * Discards any writes still waiting in the batch, and reloads the index
+ * to match. Writes made while the file is being checked only exist in the
+ * index and cannot be rolled back.
+ */
+void
+cd_mapping_db_rollback (CdMappingDb *mdb)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (CD_IS_MAPPING_DB (mdb));
+	if (priv->db == NULL || priv->read_only)
+		return;
+	cd_sqlite_batch_rollback (priv->db, &priv->commit_id);
+	g_hash_table_remove_all (priv->profiles);
+	g_hash_table_remove_all (priv->devices);
+	if (!cd_mapping_db_index_load (mdb, &error))
+		g_warning ("CdMappingDb: failed to reload: %s", error->message);
+}
+
+static gboolean
+cd_mapping_db_setup (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	const gchar *statement;
+	gint rc;
 
-	/* we don't need to keep doing fsync */
-	rc = sqlite3_exec (priv->db, "PRAGMA synchronous=OFF",
+	/* write-ahead logging only needs an fsync at checkpoints */
+	rc = sqlite3_exec (priv->db, "PRAGMA journal_mode=WAL;PRAGMA synchronous=NORMAL;",
 			   NULL, NULL, NULL);
 	if (rc != SQLITE_OK) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
 			     CD_CLIENT_ERROR_INTERNAL,
-			     "Failed to turn off synchronous operations: SQL error: %s",
+			     "Failed to enable write-ahead logging: SQL error: %s",
 			     sqlite3_errmsg(priv->db));
 		return FALSE;
 	}
@@ -212,6 +625,54 @@ cd_mapping_db_load (CdMappingDb *mdb,
 			return FALSE;
 		}
 	}
+	return cd_mapping_db_index_load (mdb, error);
+}
+
+gboolean
+cd_mapping_db_load (CdMappingDb *mdb,
+		    const gchar *filename,
+		    GError  **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	gboolean clean;
+	g_autofree gchar *marker = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
+	g_return_val_if_fail (priv->db == NULL, FALSE);
+
+	/* a new file, or one closed by the last run, needs no check */
+	g_free (priv->filename);
+	priv->filename = g_strdup (filename);
+	marker = g_strconcat (filename, CD_MAPPING_DB_CLEAN_SUFFIX, NULL);
+	clean = g_file_test (marker, G_FILE_TEST_EXISTS) ||
+		!g_file_test (filename, G_FILE_TEST_EXISTS);
+	if (g_unlink (marker) != 0 && errno != ENOENT) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "Cannot remove %s: %s",
+			     marker, g_strerror (errno));
+		return FALSE;
+	}
+
+	if (!cd_mapping_db_open (mdb, error))
+		return FALSE;
+	if (!cd_mapping_db_setup (mdb, &error_local)) {
+		if (clean) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+
+		/* database appears to be mangled, so wipe it and try again */
+		g_warning ("CdMappingDb: %s is damaged, recreating: %s",
+			   filename, error_local->message);
+		g_hash_table_remove_all (priv->profiles);
+		g_hash_table_remove_all (priv->devices);
+		return cd_mapping_db_recreate (mdb, error);
+	}
+	if (!clean)
+		cd_mapping_db_check_start (mdb);
 	return TRUE;
 }
 
@@ -226,6 +687,13 @@ cd_mapping_db_empty (CdMappingDb *mdb,
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
+	if (priv->read_only) {
+		g_hash_table_remove_all (priv->profiles);
+		g_hash_table_remove_all (priv->devices);
+		priv->dirty = TRUE;
+		return TRUE;
+	}
+
 	statement = "DELETE FROM mappings_v2;";
 	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
 	if (rc != SQLITE_OK) {
@@ -236,45 +704,67 @@ cd_mapping_db_empty (CdMappingDb *mdb,
 			     sqlite3_errmsg(priv->db));
 		return FALSE;
 	}
+	g_hash_table_remove_all (priv->profiles);
+	g_hash_table_remove_all (priv->devices);
 	return TRUE;
 }
 
+/**
+ * cd_mapping_db_add_full:
+ *
+ * Adds a mapping with an explicit timestamp, which lets a caller adding
+ * several profiles at once choose their order without relying on the
+ * clock advancing between calls.
+ **/
 gboolean
-cd_mapping_db_add (CdMappingDb *mdb,
-		   const gchar *device_id,
-		   const gchar *profile_id,
-		   GError  **error)
+cd_mapping_db_add_full (CdMappingDb *mdb,
+			const gchar *device_id,
+			const gchar *profile_id,
+			gint64 timestamp,
+			GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
-	gint64 timestamp;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdMappingDb: add %s<=>%s",
 		 device_id, profile_id);
-	timestamp = g_get_real_time ();
-	statement = sqlite3_mprintf ("INSERT OR REPLACE INTO mappings_v2 (device, profile, timestamp) "
-				     "VALUES ('%q', '%q', %"G_GINT64_FORMAT")",
-				     device_id, profile_id, timestamp);
 
-	/* insert the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
+	/* the file is still being checked, so only update the index */
+	if (priv->read_only) {
+		cd_mapping_db_index_set (mdb, device_id, profile_id, (guint64) timestamp);
+		priv->dirty = TRUE;
+		return TRUE;
 	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	if (!cd_mapping_db_begin (mdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "INSERT OR REPLACE INTO mappings_v2 (device, profile, timestamp) "
+				  "VALUES (?1, ?2, ?3);",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, profile_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 3, timestamp);
+
+	/* insert the entry */
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	cd_mapping_db_index_set (mdb, device_id, profile_id, (guint64) timestamp);
+	return TRUE;
+}
+
+gboolean
+cd_mapping_db_add (CdMappingDb *mdb,
+		   const gchar *device_id,
+		   const gchar *profile_id,
+		   GError  **error)
+{
+	return cd_mapping_db_add_full (mdb, device_id, profile_id,
+				       g_get_real_time (), error);
 }
 
 /**
@@ -292,33 +782,36 @@ cd_mapping_db_clear_timestamp (CdMappingDb *mdb,
 			       GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdMappingDb: clearing timestamp %s<=>%s",
 		 device_id, profile_id);
-	statement = sqlite3_mprintf ("INSERT OR REPLACE INTO mappings_v2 (device, profile, timestamp) "
-				     "VALUES ('%q', '%q', 0);",
-				     device_id, profile_id);
 
-	/* update the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
+	/* the file is still being checked, so only update the index */
+	if (priv->read_only) {
+		cd_mapping_db_index_set (mdb, device_id, profile_id, 0);
+		priv->dirty = TRUE;
+		return TRUE;
 	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	if (!cd_mapping_db_begin (mdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "INSERT OR REPLACE INTO mappings_v2 (device, profile, timestamp) "
+				  "VALUES (?1, ?2, 0);",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, profile_id, -1, SQLITE_TRANSIENT);
+
+	/* update the entry */
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	cd_mapping_db_index_set (mdb, device_id, profile_id, 0);
+	return TRUE;
 }
 
 /**
@@ -334,46 +827,35 @@ cd_mapping_db_remove (CdMappingDb *mdb,
 		      GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdMappingDb: remove %s<=>%s", device_id, profile_id);
-	statement = sqlite3_mprintf ("DELETE FROM mappings_v2 WHERE "
-				     "device = '%q' AND profile = '%q';",
-				     device_id, profile_id);
 
-	/* remove the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
+	/* the file is still being checked, so only update the index */
+	if (priv->read_only) {
+		cd_mapping_db_index_remove (mdb, device_id, profile_id);
+		priv->dirty = TRUE;
+		return TRUE;
 	}
-out:
-	sqlite3_free (statement);
-	return ret;
-}
-
-static gint
-cd_mapping_db_sqlite_cb (void *data,
-			 gint argc,
-			 gchar **argv,
-			 gchar **col_name)
-{
-	GPtrArray *array = (GPtrArray *) data;
+	if (!cd_mapping_db_begin (mdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "DELETE FROM mappings_v2 WHERE "
+				  "device = ?1 AND profile = ?2;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, profile_id, -1, SQLITE_TRANSIENT);
 
-	/* should only be one entry */
-	g_debug ("CdMappingDb: got sql entry %s", argv[0]);
-	g_ptr_array_add (array, g_strdup (argv[0]));
-	return 0;
+	/* remove the entry */
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	cd_mapping_db_index_remove (mdb, device_id, profile_id);
+	return TRUE;
 }
 
 /**
@@ -388,40 +870,14 @@ cd_mapping_db_get_profiles (CdMappingDb *mdb,
 			    GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gchar *statement;
-	gint rc;
-	GPtrArray *array = NULL;
-	g_autoptr(GPtrArray) array_tmp = NULL;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), NULL);
 	g_return_val_if_fail (priv->db != NULL, NULL);
 
 	g_debug ("CdMappingDb: get profiles for %s", device_id);
-	statement = sqlite3_mprintf ("SELECT profile FROM mappings_v2 WHERE "
-				     "device = '%q' AND timestamp > 0 "
-				     "ORDER BY timestamp ASC;", device_id);
-
-	/* remove the entry */
-	array_tmp = g_ptr_array_new_with_free_func (g_free);
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_mapping_db_sqlite_cb,
-			   array_tmp,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
-	}
-
-	/* success */
-	array = g_ptr_array_ref (array_tmp);
-out:
-	sqlite3_free (statement);
-	return array;
+	return cd_mapping_db_index_get_ids (g_hash_table_lookup (priv->devices,
+								 device_id),
+					    FALSE);
 }
 
 /**
@@ -436,54 +892,14 @@ cd_mapping_db_get_devices (CdMappingDb *mdb,
 			   GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gchar *statement;
-	gint rc;
-	GPtrArray *array = NULL;
-	g_autoptr(GPtrArray) array_tmp = NULL;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), NULL);
 	g_return_val_if_fail (priv->db != NULL, NULL);
 
 	g_debug ("CdMappingDb: get devices for %s", profile_id);
-	statement = sqlite3_mprintf ("SELECT device FROM mappings_v2 WHERE "
-				     "profile = '%q' AND timestamp > 0 "
-				     "ORDER BY timestamp ASC;", profile_id);
-
-	/* remove the entry */
-	array_tmp = g_ptr_array_new_with_free_func (g_free);
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_mapping_db_sqlite_cb,
-			   array_tmp,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
-	}
-
-	/* success */
-	array = g_ptr_array_ref (array_tmp);
-out:
-	sqlite3_free (statement);
-	return array;
-}
-
-static gint
-cd_mapping_db_sqlite_timestamp_cb (void *data,
-				   gint argc,
-				   gchar **argv,
-				   gchar **col_name)
-{
-	guint64 *timestamp = (guint64 *) data;
-
-	/* should only be one entry */
-	g_debug ("CdMappingDb: got sql entry %s", argv[0]);
-	*timestamp = g_ascii_strtoull (argv[0], NULL, 10);
-	return 0;
+	return cd_mapping_db_index_get_ids (g_hash_table_lookup (priv->profiles,
+								 profile_id),
+					    TRUE);
 }
 
 /**
@@ -500,46 +916,25 @@ cd_mapping_db_get_timestamp (CdMappingDb *mdb,
 			     GError  **error)
 {
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
-	gchar *statement;
-	gint rc;
-	guint64 timestamp = G_MAXUINT64;
+	CdMappingDbItem *item;
 
 	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), G_MAXUINT64);
 	g_return_val_if_fail (priv->db != NULL, G_MAXUINT64);
 
 	g_debug ("CdMappingDb: get checksum for %s<->%s",
 		 device_id, profile_id);
-	statement = sqlite3_mprintf ("SELECT timestamp FROM mappings_v2 WHERE "
-				     "device = '%q' AND profile = '%q' "
-				     "LIMIT 1;", device_id, profile_id);
-
-	/* query the checksum */
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_mapping_db_sqlite_timestamp_cb,
-			   &timestamp,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
-	}
 
 	/* nothing found */
-	if (timestamp == G_MAXUINT64) {
+	item = cd_mapping_db_index_lookup (mdb, device_id, profile_id);
+	if (item == NULL) {
 		g_set_error (error,
 			     CD_CLIENT_ERROR,
 			     CD_CLIENT_ERROR_INTERNAL,
 			     "device and profile %s<>%s not found",
 			     device_id, profile_id);
-		goto out;
+		return G_MAXUINT64;
 	}
-out:
-	sqlite3_free (statement);
-	return timestamp;
+	return item->timestamp;
 }
 
 static void
@@ -552,6 +947,71 @@ cd_mapping_db_class_init (CdMappingDbClass *klass)
 static void
 cd_mapping_db_init (CdMappingDb *mdb)
 {
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	priv->statements = cd_sqlite_statements_new ();
+	priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) g_hash_table_unref);
+	priv->profiles = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free, (GDestroyNotify) g_hash_table_unref);
+}
+
+/**
+ * cd_mapping_db_close:
+ *
+ * Writes out anything still batched and closes the database. If that all
+ * succeeds, and the file was not still being checked, a marker is written
+ * so the next load can skip the integrity check.
+ *
+ * The daemon keeps the singleton until it exits, so this has to be called
+ * explicitly rather than relying on the object being finalized.
+ **/
+gboolean
+cd_mapping_db_close (CdMappingDb *mdb, GError **error)
+{
+	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	gboolean clean = FALSE;
+	gboolean ret = TRUE;
+	g_autofree gchar *marker = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	g_return_val_if_fail (CD_IS_MAPPING_DB (mdb), FALSE);
+
+	if (priv->db == NULL)
+		return TRUE;
+
+	/* the result of an unfinished check is ignored */
+	if (priv->check_cancellable != NULL) {
+		g_cancellable_cancel (priv->check_cancellable);
+		g_clear_object (&priv->check_cancellable);
+	}
+
+	/* write out anything still batched, but an unchecked file is
+	 * never marked as clean */
+	if (priv->read_only) {
+		if (priv->dirty)
+			ret = cd_mapping_db_index_save (mdb, &error_local);
+	} else {
+		ret = cd_mapping_db_flush (mdb, &error_local);
+		clean = ret;
+	}
+
+	/* close the database */
+	g_hash_table_remove_all (priv->statements);
+	if (sqlite3_close (priv->db) != SQLITE_OK) {
+		g_warning ("CdMappingDb: failed to close: %s",
+			   sqlite3_errmsg (priv->db));
+		clean = FALSE;
+	}
+	priv->db = NULL;
+	if (!ret) {
+		g_propagate_prefixed_error (error, g_steal_pointer (&error_local),
+					    "failed to write mappings: ");
+		return FALSE;
+	}
+	if (!clean)
+		return TRUE;
+	marker = g_strconcat (priv->filename, CD_MAPPING_DB_CLEAN_SUFFIX, NULL);
+	return g_file_set_contents (marker, "", 0, error);
 }
 
 static void
@@ -559,9 +1019,16 @@ cd_mapping_db_finalize (GObject *object)
 {
 	CdMappingDb *mdb = CD_MAPPING_DB (object);
 	CdMappingDbPrivate *priv = GET_PRIVATE (mdb);
+	g_autoptr(GError) error = NULL;
 
-	/* close the database */
-	sqlite3_close (priv->db);
+	if (!cd_mapping_db_close (mdb, &error))
+		g_warning ("CdMappingDb: %s", error->message);
+
+	/* the device index owns the items */
+	g_hash_table_unref (priv->profiles);
+	g_hash_table_unref (priv->devices);
+	g_hash_table_unref (priv->statements);
+	g_free (priv->filename);
 
 	G_OBJECT_CLASS (cd_mapping_db_parent_class)->finalize (object);
 }
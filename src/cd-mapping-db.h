@@ -53,6 +53,12 @@ gboolean	 cd_mapping_db_add		(CdMappingDb	*mdb,
 						 const gchar	*profile_id,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_mapping_db_add_full		(CdMappingDb	*mdb,
+						 const gchar	*device_id,
+						 const gchar	*profile_id,
+						 gint64		 timestamp,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 cd_mapping_db_remove		(CdMappingDb	*mdb,
 						 const gchar	*device_id,
 						 const gchar	*profile_id,
@@ -71,6 +77,17 @@ guint64		 cd_mapping_db_get_timestamp	(CdMappingDb	*mdb,
 						 const gchar	*profile_id,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_mapping_db_begin		(CdMappingDb	*mdb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_mapping_db_flush		(CdMappingDb	*mdb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+void		 cd_mapping_db_rollback		(CdMappingDb	*mdb);
+gboolean	 cd_mapping_db_get_read_only	(CdMappingDb	*mdb);
+gboolean	 cd_mapping_db_close		(CdMappingDb	*mdb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -0,0 +1,126 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "cd-metrics.h"
+
+/* durations are all in microseconds */
+typedef struct {
+	guint64			 count;
+	guint64			 total;
+	guint64			 max;
+	guint64			 buckets[CD_METRICS_BUCKETS];
+} CdMetricsItem;
+
+G_LOCK_DEFINE_STATIC (cd_metrics);
+static GHashTable *cd_metrics_items = NULL;	/* name : CdMetricsItem */
+
+/* records one sample, where bucket N counts durations below 2^N us */
+void
+cd_metrics_add_duration (const gchar *name, gint64 duration)
+{
+	CdMetricsItem *item;
+	guint idx;
+
+	if (duration < 0)
+		duration = 0;
+	idx = 0;
+	if (duration > 0)
+		idx = MIN (g_bit_storage ((gulong) duration), CD_METRICS_BUCKETS - 1);
+
+	G_LOCK (cd_metrics);
+	if (cd_metrics_items == NULL) {
+		cd_metrics_items = g_hash_table_new_full (g_str_hash,
+							  g_str_equal,
+							  g_free,
+							  g_free);
+	}
+	item = g_hash_table_lookup (cd_metrics_items, name);
+	if (item == NULL) {
+		item = g_new0 (CdMetricsItem, 1);
+		g_hash_table_insert (cd_metrics_items, g_strdup (name), item);
+	}
+	item->count++;
+	item->total += (guint64) duration;
+	item->max = MAX (item->max, (guint64) duration);
+	item->buckets[idx]++;
+	G_UNLOCK (cd_metrics);
+}
+
+/* records the time since @start, from g_get_monotonic_time() */
+void
+cd_metrics_add (const gchar *name, gint64 start)
+{
+	cd_metrics_add_duration (name, g_get_monotonic_time () - start);
+}
+
+void
+cd_metrics_add_method (const gchar *interface_name,
+		       const gchar *method_name,
+		       gint64 start)
+{
+	g_autofree gchar *name = NULL;
+	name = g_strdup_printf ("dbus.%s.%s", interface_name, method_name);
+	cd_metrics_add (name, start);
+}
+
+/* returns a floating a{s(tttat)} of name : (count, total, max, buckets) */
+GVariant *
+cd_metrics_get_variant (void)
+{
+	CdMetricsItem *item;
+	GHashTableIter iter;
+	GVariantBuilder builder;
+	const gchar *name;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s(tttat)}"));
+	G_LOCK (cd_metrics);
+	if (cd_metrics_items != NULL) {
+		g_hash_table_iter_init (&iter, cd_metrics_items);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &name,
+					       (gpointer *) &item)) {
+			GVariant *buckets;
+			buckets = g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+							     item->buckets,
+							     CD_METRICS_BUCKETS,
+							     sizeof (guint64));
+			g_variant_builder_add (&builder, "{s(ttt@at)}",
+					       name,
+					       item->count,
+					       item->total,
+					       item->max,
+					       buckets);
+		}
+	}
+	G_UNLOCK (cd_metrics);
+	return g_variant_builder_end (&builder);
+}
+
+void
+cd_metrics_reset (void)
+{
+	G_LOCK (cd_metrics);
+	g_clear_pointer (&cd_metrics_items, g_hash_table_unref);
+	G_UNLOCK (cd_metrics);
+}
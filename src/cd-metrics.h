@@ -0,0 +1,39 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __CD_METRICS_H__
+#define __CD_METRICS_H__
+
+#include <glib.h>
+
+#define CD_METRICS_BUCKETS		24	/* last one is >= 2^22 us */
+
+void		 cd_metrics_add			(const gchar	*name,
+						 gint64		 start);
+void		 cd_metrics_add_duration	(const gchar	*name,
+						 gint64		 duration);
+void		 cd_metrics_add_method		(const gchar	*interface_name,
+						 const gchar	*method_name,
+						 gint64		 start);
+GVariant	*cd_metrics_get_variant		(void);
+void		 cd_metrics_reset		(void);
+
+#endif /* __CD_METRICS_H__ */
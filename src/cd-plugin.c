@@ -32,6 +32,24 @@ cd_plugin_device_added (CdPlugin *plugin, CdDevice *device)
 	plugin->device_added (plugin, device, plugin->user_data);
 }
 
+/* adds all the devices found at coldplug in one go */
+void
+cd_plugin_devices_added (CdPlugin *plugin, GPtrArray *devices)
+{
+	guint i;
+
+	g_return_if_fail (plugin != NULL);
+	g_return_if_fail (devices != NULL);
+	if (devices->len == 0)
+		return;
+	if (plugin->devices_added == NULL) {
+		for (i = 0; i < devices->len; i++)
+			cd_plugin_device_added (plugin, g_ptr_array_index (devices, i));
+		return;
+	}
+	plugin->devices_added (plugin, devices, plugin->user_data);
+}
+
 void
 cd_plugin_device_removed (CdPlugin *plugin, CdDevice *device)
 {
@@ -37,6 +37,9 @@ typedef void		 (*CdPluginFunc)		(CdPlugin	*plugin);
 typedef void		 (*CdPluginDeviceFunc)		(CdPlugin	*plugin,
 							 CdDevice	*device,
 							 gpointer	 user_data);
+typedef void		 (*CdPluginDevicesFunc)		(CdPlugin	*plugin,
+							 GPtrArray	*devices,
+							 gpointer	 user_data);
 typedef gboolean	 (*CdPluginEnabledFunc)	(void);
 
 struct CdPlugin {
@@ -45,6 +48,7 @@ struct CdPlugin {
 	gpointer		 user_data;
 	CdPluginDeviceFunc	 device_added;
 	CdPluginDeviceFunc	 device_removed;
+	CdPluginDevicesFunc	 devices_added;
 };
 
 typedef enum {
@@ -67,6 +71,8 @@ void		 cd_plugin_device_added			(CdPlugin	*plugin,
 							 CdDevice	*device);
 void		 cd_plugin_device_removed		(CdPlugin	*plugin,
 							 CdDevice	*device);
+void		 cd_plugin_devices_added		(CdPlugin	*plugin,
+							 GPtrArray	*devices);
 
 /* optional function which returns false if plugin should not be enabled */
 gboolean	 cd_plugin_config_enabled		(void);
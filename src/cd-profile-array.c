@@ -30,22 +30,535 @@ static void     cd_profile_array_finalize	(GObject     *object);
 
 #define GET_PRIVATE(o) (cd_profile_array_get_instance_private (o))
 
+/* loaded index entries are only evicted after being unused this long */
+#define CD_PROFILE_ARRAY_IDLE_TIMEOUT	30	/* s */
+
+/* the metadata kept for profiles that are not loaded */
+static const gchar *cd_profile_array_entry_keys[] = {
+	CD_PROFILE_METADATA_FILE_CHECKSUM,
+	CD_PROFILE_METADATA_MAPPING_DEVICE_ID,
+	CD_PROFILE_METADATA_EDID_MD5,
+	CD_PROFILE_METADATA_STANDARD_SPACE };
+#define CD_PROFILE_ARRAY_ENTRY_KEYS	G_N_ELEMENTS (cd_profile_array_entry_keys)
+
+/* a profile on disk that is only made into a CdProfile when looked up */
+typedef struct {
+	gchar				*id;		/* all pooled */
+	gchar				*filename;
+	gchar				*basename;
+	gchar				*object_path;
+	gchar				*metadata[CD_PROFILE_ARRAY_ENTRY_KEYS];
+	CdProfileKind			 kind;
+	CdProfile			*profile;	/* borrowed, NULL if not loaded */
+	GList				*lru_link;	/* in loaded */
+	gint64				 last_used;
+	gboolean			 loading;
+} CdProfileArrayEntry;
+
 typedef struct
 {
 	GPtrArray			*array;
+	GHashTable			*keys;		/* CdProfile : CdProfileArrayKeys */
+	GHashTable			*id_hash;	/* id : GPtrArray of CdProfile */
+	GHashTable			*filename_hash;
+	GHashTable			*basename_hash;
+	GHashTable			*object_path_hash;
+	GHashTable			*metadata_hash;	/* key : value : GPtrArray of CdProfile */
+	GVariant			*variant;	/* cached 'ao' of all profiles */
+	GPtrArray			*entries;	/* CdProfileArrayEntry */
+	GHashTable			*entry_id_hash;	/* id : CdProfileArrayEntry */
+	GHashTable			*entry_filename_hash;
+	GHashTable			*entry_basename_hash;
+	GHashTable			*entry_object_path_hash;
+	GHashTable			*entry_metadata_hash[CD_PROFILE_ARRAY_ENTRY_KEYS]; /* value : GPtrArray of CdProfileArrayEntry */
+	GQueue				 loaded;	/* CdProfileArrayEntry, newest first */
+	guint				 max_loaded;
+	guint				 evict_id;
+	CdProfileArrayLoadFunc		 load_func;
+	gpointer			 load_func_data;
 } CdProfileArrayPrivate;
 
+/* the values the profile was indexed with, so it can be found again */
+typedef struct {
+	gchar				*id;
+	gchar				*filename;
+	gchar				*basename;
+	gchar				*object_path;
+	GHashTable			*metadata;
+	CdProfileArrayEntry		*entry;		/* if loaded from the index */
+	guint				 users;		/* devices and D-Bus calls */
+} CdProfileArrayKeys;
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdProfileArray, cd_profile_array, G_TYPE_OBJECT)
 
 static gpointer cd_profile_array_object = NULL;
 
+static void
+cd_profile_array_keys_free (CdProfileArrayKeys *keys)
+{
+	g_free (keys->id);
+	g_free (keys->filename);
+	g_free (keys->basename);
+	g_free (keys->object_path);
+	g_hash_table_unref (keys->metadata);
+	g_free (keys);
+}
+
+static void
+cd_profile_array_entry_free (CdProfileArrayEntry *entry)
+{
+	cd_string_pool_release (entry->id);
+	cd_string_pool_release (entry->filename);
+	cd_string_pool_release (entry->basename);
+	cd_string_pool_release (entry->object_path);
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++)
+		cd_string_pool_release (entry->metadata[i]);
+	g_free (entry);
+}
+
+static void
+cd_profile_array_entry_hash_insert (GHashTable *hash,
+				    const gchar *key,
+				    CdProfileArrayEntry *entry)
+{
+	/* the first entry wins, as for the profile indexes */
+	if (key == NULL || g_hash_table_contains (hash, key))
+		return;
+	g_hash_table_insert (hash, (gpointer) key, entry);
+}
+
+static void
+cd_profile_array_entry_hash_remove (GHashTable *hash,
+				    const gchar *key,
+				    CdProfileArrayEntry *entry)
+{
+	if (key == NULL || g_hash_table_lookup (hash, key) != entry)
+		return;
+	g_hash_table_remove (hash, key);
+}
+
+static void
+cd_profile_array_entry_metadata_insert (CdProfileArray *profile_array,
+					CdProfileArrayEntry *entry)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++) {
+		GPtrArray *entries;
+		if (entry->metadata[i] == NULL)
+			continue;
+		entries = g_hash_table_lookup (priv->entry_metadata_hash[i],
+					       entry->metadata[i]);
+		if (entries == NULL) {
+			entries = g_ptr_array_new ();
+			g_hash_table_insert (priv->entry_metadata_hash[i],
+					     cd_string_pool_intern (entry->metadata[i]),
+					     entries);
+		}
+		g_ptr_array_add (entries, entry);
+	}
+}
+
+static void
+cd_profile_array_entry_metadata_remove (CdProfileArray *profile_array,
+					CdProfileArrayEntry *entry)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++) {
+		GPtrArray *entries;
+		if (entry->metadata[i] == NULL)
+			continue;
+		entries = g_hash_table_lookup (priv->entry_metadata_hash[i],
+					       entry->metadata[i]);
+		if (entries == NULL)
+			continue;
+		g_ptr_array_remove (entries, entry);
+		if (entries->len == 0)
+			g_hash_table_remove (priv->entry_metadata_hash[i],
+					     entry->metadata[i]);
+	}
+}
+
+static gint
+cd_profile_array_entry_key_index (const gchar *key)
+{
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++) {
+		if (g_strcmp0 (cd_profile_array_entry_keys[i], key) == 0)
+			return (gint) i;
+	}
+	return -1;
+}
+
+static void
+cd_profile_array_entry_touch (CdProfileArray *profile_array,
+			      CdProfileArrayEntry *entry)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+
+	entry->last_used = g_get_monotonic_time ();
+	if (entry->lru_link == NULL)
+		return;
+	g_queue_unlink (&priv->loaded, entry->lru_link);
+	g_queue_push_head_link (&priv->loaded, entry->lru_link);
+}
+
+static gboolean cd_profile_array_evict_cb (gpointer user_data);
+
+static void
+cd_profile_array_evict (CdProfileArray *profile_array)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	GList *l;
+	GList *prev;
+	gboolean pending = FALSE;
+	gint64 now = g_get_monotonic_time ();
+
+	if (priv->max_loaded == 0)
+		return;
+
+	/* least recently used first, stopping at the first one still fresh */
+	for (l = priv->loaded.tail;
+	     l != NULL && priv->loaded.length > priv->max_loaded;
+	     l = prev) {
+		CdProfileArrayEntry *entry = l->data;
+		CdProfileArrayKeys *keys = g_hash_table_lookup (priv->keys, entry->profile);
+		prev = l->prev;
+
+		/* in use by a device or a D-Bus call */
+		if (keys != NULL && keys->users > 0)
+			continue;
+		if (now - entry->last_used < CD_PROFILE_ARRAY_IDLE_TIMEOUT * G_USEC_PER_SEC) {
+			pending = TRUE;
+			break;
+		}
+		g_debug ("CdProfileArray: evicting idle profile %s", entry->id);
+		cd_profile_array_remove (profile_array, entry->profile);
+	}
+
+	/* try again once the rest have been idle for long enough, as there
+	 * may be no more loads to trigger it */
+	if (pending && priv->evict_id == 0) {
+		priv->evict_id = g_timeout_add_seconds (CD_PROFILE_ARRAY_IDLE_TIMEOUT,
+							cd_profile_array_evict_cb,
+							profile_array);
+		g_source_set_name_by_id (priv->evict_id, "[CdProfileArray] evict");
+	}
+}
+
+static gboolean
+cd_profile_array_evict_cb (gpointer user_data)
+{
+	CdProfileArray *profile_array = CD_PROFILE_ARRAY (user_data);
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	priv->evict_id = 0;
+	cd_profile_array_evict (profile_array);
+	return G_SOURCE_REMOVE;
+}
+
+/* stops @profile being evicted until cd_profile_array_release() */
+void
+cd_profile_array_hold (CdProfileArray *profile_array, CdProfile *profile)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayKeys *keys;
+
+	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
+	g_return_if_fail (CD_IS_PROFILE (profile));
+	keys = g_hash_table_lookup (priv->keys, profile);
+	if (keys != NULL)
+		keys->users++;
+}
+
+void
+cd_profile_array_release (CdProfileArray *profile_array, CdProfile *profile)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayKeys *keys;
+
+	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
+	g_return_if_fail (CD_IS_PROFILE (profile));
+	keys = g_hash_table_lookup (priv->keys, profile);
+	if (keys == NULL || keys->users == 0)
+		return;
+	if (--keys->users == 0 && keys->entry != NULL)
+		cd_profile_array_evict (profile_array);
+}
+
+static CdProfile *
+cd_profile_array_entry_load (CdProfileArray *profile_array,
+			     CdProfileArrayEntry *entry)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	g_autoptr(CdProfile) profile = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* already loaded */
+	if (entry->profile != NULL) {
+		cd_profile_array_entry_touch (profile_array, entry);
+		return g_object_ref (entry->profile);
+	}
+	if (priv->load_func == NULL)
+		return NULL;
+
+	/* the profile gets linked to the entry when added to the array */
+	entry->loading = TRUE;
+	profile = priv->load_func (profile_array,
+				   entry->filename,
+				   priv->load_func_data,
+				   &error);
+	if (profile != NULL && entry->profile == NULL)
+		cd_profile_array_add (profile_array, profile);
+	entry->loading = FALSE;
+	if (profile == NULL) {
+		g_warning ("CdProfileArray: failed to load %s: %s",
+			   entry->filename, error->message);
+		return NULL;
+	}
+	cd_profile_array_entry_touch (profile_array, entry);
+	cd_profile_array_evict (profile_array);
+	return g_steal_pointer (&profile);
+}
+
+static CdProfile *
+cd_profile_array_entry_lookup (CdProfileArray *profile_array,
+			       GHashTable *entry_hash,
+			       const gchar *key)
+{
+	CdProfileArrayEntry *entry;
+
+	if (key == NULL)
+		return NULL;
+	entry = g_hash_table_lookup (entry_hash, key);
+	if (entry == NULL)
+		return NULL;
+	return cd_profile_array_entry_load (profile_array, entry);
+}
+
+static CdProfile *
+cd_profile_array_ref_used (CdProfileArray *profile_array, CdProfile *profile)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayKeys *keys = g_hash_table_lookup (priv->keys, profile);
+
+	/* keep recently used profiles from being evicted */
+	if (keys != NULL && keys->entry != NULL)
+		cd_profile_array_entry_touch (profile_array, keys->entry);
+	return g_object_ref (profile);
+}
+
+static GHashTable *
+cd_profile_array_index_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal,
+				      g_free, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+cd_profile_array_index_insert (GHashTable *index,
+			       const gchar *key,
+			       CdProfile *profile)
+{
+	GPtrArray *profiles;
+
+	if (key == NULL)
+		return;
+	profiles = g_hash_table_lookup (index, key);
+	if (profiles == NULL) {
+		profiles = g_ptr_array_new ();
+		g_hash_table_insert (index, g_strdup (key), profiles);
+	}
+	g_ptr_array_add (profiles, profile);
+}
+
+static void
+cd_profile_array_index_remove (GHashTable *index,
+			       const gchar *key,
+			       CdProfile *profile)
+{
+	GPtrArray *profiles;
+
+	if (key == NULL)
+		return;
+	profiles = g_hash_table_lookup (index, key);
+	if (profiles == NULL)
+		return;
+	g_ptr_array_remove (profiles, profile);
+	if (profiles->len == 0)
+		g_hash_table_remove (index, key);
+}
+
+static GPtrArray *
+cd_profile_array_index_lookup (GHashTable *index, const gchar *key)
+{
+	if (key == NULL)
+		return NULL;
+	return g_hash_table_lookup (index, key);
+}
+
+static void
+cd_profile_array_index_metadata (CdProfileArray *profile_array,
+				 const gchar *key,
+				 const gchar *value,
+				 CdProfile *profile,
+				 gboolean add)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	GHashTable *values = g_hash_table_lookup (priv->metadata_hash, key);
+
+	if (add) {
+		if (values == NULL) {
+			values = cd_profile_array_index_new ();
+			g_hash_table_insert (priv->metadata_hash, g_strdup (key), values);
+		}
+		cd_profile_array_index_insert (values, value, profile);
+		return;
+	}
+	if (values == NULL)
+		return;
+	cd_profile_array_index_remove (values, value, profile);
+	if (g_hash_table_size (values) == 0)
+		g_hash_table_remove (priv->metadata_hash, key);
+}
+
+static void
+cd_profile_array_index_string (GHashTable *index,
+			       gchar **key_old,
+			       const gchar *key_new,
+			       CdProfile *profile)
+{
+	/* unchanged keys keep their position, so the first match is stable */
+	if (g_strcmp0 (*key_old, key_new) == 0)
+		return;
+	cd_profile_array_index_remove (index, *key_old, profile);
+	cd_profile_array_index_insert (index, key_new, profile);
+	g_free (*key_old);
+	*key_old = g_strdup (key_new);
+}
+
+static void
+cd_profile_array_reindex (CdProfileArray *profile_array, CdProfile *profile)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayKeys *keys;
+	GHashTable *metadata;
+	GHashTableIter iter;
+	const gchar *filename;
+	gpointer key;
+	gpointer value;
+	g_autofree gchar *basename = NULL;
+
+	keys = g_hash_table_lookup (priv->keys, profile);
+	if (keys == NULL)
+		return;
+	filename = cd_profile_get_filename (profile);
+	if (filename != NULL)
+		basename = g_path_get_basename (filename);
+	cd_profile_array_index_string (priv->id_hash, &keys->id,
+				       cd_profile_get_id (profile), profile);
+	cd_profile_array_index_string (priv->filename_hash, &keys->filename,
+				       filename, profile);
+	cd_profile_array_index_string (priv->basename_hash, &keys->basename,
+				       basename, profile);
+	if (g_strcmp0 (keys->object_path, cd_profile_get_object_path (profile)) != 0)
+		g_clear_pointer (&priv->variant, g_variant_unref);
+	cd_profile_array_index_string (priv->object_path_hash, &keys->object_path,
+				       cd_profile_get_object_path (profile), profile);
+
+	/* metadata that was removed or changed */
+	metadata = cd_profile_get_metadata (profile);
+	g_hash_table_iter_init (&iter, keys->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_strcmp0 (g_hash_table_lookup (metadata, key), value) == 0)
+			continue;
+		cd_profile_array_index_metadata (profile_array, key, value, profile, FALSE);
+		g_hash_table_iter_remove (&iter);
+	}
+
+	/* metadata that was added or changed */
+	g_hash_table_iter_init (&iter, metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (value == NULL || g_hash_table_contains (keys->metadata, key))
+			continue;
+		cd_profile_array_index_metadata (profile_array, key, value, profile, TRUE);
+		g_hash_table_insert (keys->metadata, g_strdup (key), g_strdup (value));
+	}
+}
+
+static void
+cd_profile_array_notify_cb (CdProfile *profile,
+			    GParamSpec *pspec,
+			    CdProfileArray *profile_array)
+{
+	cd_profile_array_reindex (profile_array, profile);
+}
+
+static void
+cd_profile_array_unindex (CdProfileArray *profile_array, CdProfile *profile)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayKeys *keys;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	keys = g_hash_table_lookup (priv->keys, profile);
+	if (keys == NULL)
+		return;
+	g_signal_handlers_disconnect_by_func (profile,
+					      G_CALLBACK (cd_profile_array_notify_cb),
+					      profile_array);
+	cd_profile_array_index_remove (priv->id_hash, keys->id, profile);
+	cd_profile_array_index_remove (priv->filename_hash, keys->filename, profile);
+	cd_profile_array_index_remove (priv->basename_hash, keys->basename, profile);
+	cd_profile_array_index_remove (priv->object_path_hash, keys->object_path, profile);
+	g_hash_table_iter_init (&iter, keys->metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		cd_profile_array_index_metadata (profile_array, key, value, profile, FALSE);
+
+	/* back to only being in the index */
+	if (keys->entry != NULL) {
+		keys->entry->profile = NULL;
+		g_queue_delete_link (&priv->loaded, keys->entry->lru_link);
+		keys->entry->lru_link = NULL;
+	}
+	g_hash_table_remove (priv->keys, profile);
+}
+
 void
 cd_profile_array_add (CdProfileArray *profile_array, CdProfile *profile)
 {
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayEntry *entry = NULL;
+	CdProfileArrayKeys *keys;
+	const gchar *filename;
+
 	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_ptr_array_add (priv->array, g_object_ref (profile));
+	g_clear_pointer (&priv->variant, g_variant_unref);
+
+	/* keep the indexes up to date as the profile changes */
+	if (g_hash_table_contains (priv->keys, profile))
+		return;
+	keys = g_new0 (CdProfileArrayKeys, 1);
+	keys->metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_insert (priv->keys, profile, keys);
+
+	/* being loaded from the index */
+	filename = cd_profile_get_filename (profile);
+	if (filename != NULL)
+		entry = g_hash_table_lookup (priv->entry_filename_hash, filename);
+	if (entry != NULL && entry->loading && entry->profile == NULL) {
+		entry->profile = profile;
+		g_queue_push_head (&priv->loaded, entry);
+		entry->lru_link = priv->loaded.head;
+		keys->entry = entry;
+	}
+	cd_profile_array_reindex (profile_array, profile);
+	g_signal_connect (profile, "notify",
+			  G_CALLBACK (cd_profile_array_notify_cb),
+			  profile_array);
 }
 
 void
@@ -54,7 +567,11 @@ cd_profile_array_remove (CdProfileArray *profile_array, CdProfile *profile)
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
 	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
 	g_return_if_fail (CD_IS_PROFILE (profile));
-	g_ptr_array_remove (priv->array, profile);
+	if (!g_ptr_array_remove (priv->array, profile))
+		return;
+	g_clear_pointer (&priv->variant, g_variant_unref);
+	if (!g_ptr_array_find (priv->array, profile, NULL))
+		cd_profile_array_unindex (profile_array, profile);
 }
 
 CdProfile *
@@ -64,47 +581,30 @@ cd_profile_array_get_by_id_owner (CdProfileArray *profile_array,
 {
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
 	CdProfile *profile_tmp;
+	GPtrArray *profiles;
 	guint i;
 
-	/* find profile */
-	for (i = 0; i < priv->array->len; i++) {
-		profile_tmp = g_ptr_array_index (priv->array, i);
-		if (cd_profile_get_owner (profile_tmp) != owner)
-			continue;
-		if (g_strcmp0 (cd_profile_get_id (profile_tmp), id) == 0)
-			return g_object_ref (profile_tmp);
-	}
-	for (i = 0; i < priv->array->len; i++) {
-		profile_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (cd_profile_get_id (profile_tmp), id) == 0)
-			return g_object_ref (profile_tmp);
+	/* find profile, preferring the one for the owner */
+	profiles = cd_profile_array_index_lookup (priv->id_hash, id);
+	if (profiles == NULL)
+		return cd_profile_array_entry_lookup (profile_array, priv->entry_id_hash, id);
+	for (i = 0; i < profiles->len; i++) {
+		profile_tmp = g_ptr_array_index (profiles, i);
+		if (cd_profile_get_owner (profile_tmp) == owner)
+			return cd_profile_array_ref_used (profile_array, profile_tmp);
 	}
-	return NULL;
+	return cd_profile_array_ref_used (profile_array, g_ptr_array_index (profiles, 0));
 }
 
 static CdProfile *
-cd_profile_array_get_by_basename (CdProfileArray *profile_array,
-				  const gchar *filename)
+cd_profile_array_get_first (CdProfileArray *profile_array,
+			    GHashTable *index,
+			    const gchar *key)
 {
-	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
-	CdProfile *profile = NULL;
-	CdProfile *profile_tmp;
-	const gchar *tmp;
-	gchar *basename;
-	guint i;
-
-	/* find profile */
-	for (i = 0; i < priv->array->len && profile == NULL; i++) {
-		profile_tmp = g_ptr_array_index (priv->array, i);
-		tmp = cd_profile_get_filename (profile_tmp);
-		if (tmp == NULL)
-			continue;
-		basename = g_path_get_basename (tmp);
-		if (g_strcmp0 (basename, filename) == 0)
-			profile = g_object_ref (profile_tmp);
-		g_free (basename);
-	}
-	return profile;
+	GPtrArray *profiles = cd_profile_array_index_lookup (index, key);
+	if (profiles == NULL)
+		return NULL;
+	return cd_profile_array_ref_used (profile_array, g_ptr_array_index (profiles, 0));
 }
 
 CdProfile *
@@ -112,20 +612,48 @@ cd_profile_array_get_by_filename (CdProfileArray *profile_array,
 				  const gchar *filename)
 {
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
-	CdProfile *profile_tmp;
-	guint i;
+	CdProfile *profile;
 
 	g_return_val_if_fail (filename != NULL, NULL);
 
 	/* support getting the file without the path */
-	if (filename[0] != '/')
-		return cd_profile_array_get_by_basename (profile_array, filename);
+	if (filename[0] != '/') {
+		profile = cd_profile_array_get_first (profile_array,
+						      priv->basename_hash,
+						      filename);
+		if (profile != NULL)
+			return profile;
+		return cd_profile_array_entry_lookup (profile_array,
+						      priv->entry_basename_hash,
+						      filename);
+	}
+	profile = cd_profile_array_get_first (profile_array,
+					      priv->filename_hash,
+					      filename);
+	if (profile != NULL)
+		return profile;
+	return cd_profile_array_entry_lookup (profile_array,
+					      priv->entry_filename_hash,
+					      filename);
+}
 
-	/* find profile */
-	for (i = 0; i < priv->array->len; i++) {
-		profile_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (cd_profile_get_filename (profile_tmp), filename) == 0)
-			return g_object_ref (profile_tmp);
+static CdProfile *
+cd_profile_array_entry_lookup_metadata (CdProfileArray *profile_array,
+					const gchar *key,
+					const gchar *value)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	GPtrArray *entries;
+	gint idx = cd_profile_array_entry_key_index (key);
+
+	/* only a few keys are kept for profiles that are not loaded */
+	if (idx < 0)
+		return NULL;
+	entries = g_hash_table_lookup (priv->entry_metadata_hash[idx], value);
+	for (guint i = 0; entries != NULL && i < entries->len; i++) {
+		CdProfileArrayEntry *entry = g_ptr_array_index (entries, i);
+		if (entry->profile == NULL)
+			return cd_profile_array_entry_load (profile_array, entry);
 	}
 	return NULL;
 }
@@ -144,9 +672,22 @@ cd_profile_array_get_by_property (CdProfileArray *profile_array,
 		return cd_profile_array_get_by_filename (profile_array, value);
 
 	/* find profile */
+	if (value != NULL) {
+		GHashTable *values = g_hash_table_lookup (priv->metadata_hash, key);
+		if (values != NULL) {
+			profile_tmp = cd_profile_array_get_first (profile_array,
+								  values,
+								  value);
+			if (profile_tmp != NULL)
+				return profile_tmp;
+		}
+		return cd_profile_array_entry_lookup_metadata (profile_array,
+							       key,
+							       value);
+	}
 	for (i = 0; i < priv->array->len; i++) {
 		profile_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (cd_profile_get_metadata_item (profile_tmp, key), value) == 0)
+		if (cd_profile_get_metadata_item (profile_tmp, key) == NULL)
 			return g_object_ref (profile_tmp);
 	}
 	return NULL;
@@ -185,11 +726,36 @@ cd_profile_array_get_by_metadata (CdProfileArray *profile_array,
 
 	/* find profile */
 	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	if (value != NULL) {
+		GHashTable *values = g_hash_table_lookup (priv->metadata_hash, key);
+		GPtrArray *profiles = NULL;
+		GPtrArray *entries = NULL;
+		gint idx = cd_profile_array_entry_key_index (key);
+		if (values != NULL)
+			profiles = cd_profile_array_index_lookup (values, value);
+		for (i = 0; profiles != NULL && i < profiles->len; i++)
+			g_ptr_array_add (array, g_object_ref (g_ptr_array_index (profiles, i)));
+
+		/* add the indexed matches, loading any that are not loaded yet;
+		 * a loaded profile may not carry the indexed metadata itself */
+		if (idx >= 0)
+			entries = g_hash_table_lookup (priv->entry_metadata_hash[idx], value);
+		for (i = 0; entries != NULL && i < entries->len; i++) {
+			CdProfileArrayEntry *entry = g_ptr_array_index (entries, i);
+			if (entry->profile != NULL &&
+			    g_ptr_array_find (array, entry->profile, NULL))
+				continue;
+			profile_tmp = cd_profile_array_entry_load (profile_array, entry);
+			if (profile_tmp != NULL)
+				g_ptr_array_add (array, profile_tmp);
+		}
+		return array;
+	}
 	for (i = 0; i < priv->array->len; i++) {
 		profile_tmp = g_ptr_array_index (priv->array, i);
 		hash_tmp = cd_profile_get_metadata (profile_tmp);
 		value_tmp = g_hash_table_lookup (hash_tmp, key);
-		if (g_strcmp0 (value_tmp, value) == 0)
+		if (value_tmp == NULL)
 			g_ptr_array_add (array, g_object_ref (profile_tmp));
 	}
 	return array;
@@ -200,17 +766,23 @@ cd_profile_array_get_by_object_path (CdProfileArray *profile_array,
 				     const gchar *object_path)
 {
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
-	CdProfile *profile = NULL;
-	CdProfile *profile_tmp;
-	guint i;
+	CdProfile *profile;
 
-	/* find profile */
-	for (i = 0; i < priv->array->len; i++) {
-		profile_tmp = g_ptr_array_index (priv->array, i);
-		if (g_strcmp0 (cd_profile_get_object_path (profile_tmp), object_path) == 0)
-			return g_object_ref (profile_tmp);
-	}
-	return profile;
+	profile = cd_profile_array_get_first (profile_array,
+					      priv->object_path_hash,
+					      object_path);
+	if (profile != NULL)
+		return profile;
+	return cd_profile_array_entry_lookup (profile_array,
+					      priv->entry_object_path_hash,
+					      object_path);
+}
+
+GPtrArray *
+cd_profile_array_get_array (CdProfileArray *profile_array)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	return g_ptr_array_ref (priv->array);
 }
 
 GVariant *
@@ -220,18 +792,149 @@ cd_profile_array_get_variant (CdProfileArray *profile_array)
 	CdProfile *profile;
 	GVariant **variant_array = NULL;
 	guint i;
+	guint length = 0;
+
+	/* rebuilt only when a profile is added, removed or moved */
+	if (priv->variant != NULL)
+		return g_variant_ref (priv->variant);
 
 	/* copy the object paths */
-	variant_array = g_new0 (GVariant *, priv->array->len + 1);
+	variant_array = g_new0 (GVariant *, priv->array->len + priv->entries->len + 1);
 	for (i = 0; i < priv->array->len; i++) {
 		profile = g_ptr_array_index (priv->array, i);
-		variant_array[i] = g_variant_new_object_path (cd_profile_get_object_path (profile));
+		variant_array[length++] = g_variant_new_object_path (cd_profile_get_object_path (profile));
+	}
+
+	/* profiles that are only in the index */
+	for (i = 0; i < priv->entries->len; i++) {
+		CdProfileArrayEntry *entry = g_ptr_array_index (priv->entries, i);
+		if (entry->profile != NULL)
+			continue;
+		variant_array[length++] = g_variant_new_object_path (entry->object_path);
 	}
 
 	/* format the value */
-	return g_variant_new_array (G_VARIANT_TYPE_OBJECT_PATH,
-				    variant_array,
-				    priv->array->len);
+	priv->variant = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE_OBJECT_PATH,
+								 variant_array,
+								 length));
+	g_free (variant_array);
+	return g_variant_ref (priv->variant);
+}
+
+GVariant *
+cd_profile_array_get_variant_by_kind (CdProfileArray *profile_array,
+				      CdProfileKind kind)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_OBJECT_PATH_ARRAY);
+	for (i = 0; i < priv->array->len; i++) {
+		CdProfile *profile = g_ptr_array_index (priv->array, i);
+		if (cd_profile_get_kind (profile) != kind)
+			continue;
+		g_variant_builder_add (&builder, "o", cd_profile_get_object_path (profile));
+	}
+	for (i = 0; i < priv->entries->len; i++) {
+		CdProfileArrayEntry *entry = g_ptr_array_index (priv->entries, i);
+		if (entry->profile != NULL || entry->kind != kind)
+			continue;
+		g_variant_builder_add (&builder, "o", entry->object_path);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/*
+ * Sets the function used to load profiles that are only in the index. It
+ * has to add the new profile to @profile_array before returning it.
+ */
+void
+cd_profile_array_set_load_func (CdProfileArray *profile_array,
+				CdProfileArrayLoadFunc func,
+				gpointer user_data)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
+	priv->load_func = func;
+	priv->load_func_data = user_data;
+}
+
+/* no more than @max_loaded index entries are kept loaded once idle */
+void
+cd_profile_array_set_max_loaded (CdProfileArray *profile_array,
+				 guint max_loaded)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	g_return_if_fail (CD_IS_PROFILE_ARRAY (profile_array));
+	priv->max_loaded = max_loaded;
+	cd_profile_array_evict (profile_array);
+}
+
+gboolean
+cd_profile_array_add_index (CdProfileArray *profile_array,
+			    const gchar *id,
+			    const gchar *filename,
+			    const gchar *object_path,
+			    CdProfileKind kind,
+			    GHashTable *metadata)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayEntry *entry;
+	g_autofree gchar *basename = NULL;
+
+	g_return_val_if_fail (CD_IS_PROFILE_ARRAY (profile_array), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (object_path != NULL, FALSE);
+
+	/* already known */
+	if (g_hash_table_contains (priv->entry_filename_hash, filename))
+		return FALSE;
+
+	basename = g_path_get_basename (filename);
+	entry = g_new0 (CdProfileArrayEntry, 1);
+	entry->id = cd_string_pool_intern (id);
+	entry->filename = cd_string_pool_intern (filename);
+	entry->basename = cd_string_pool_intern (basename);
+	entry->object_path = cd_string_pool_intern (object_path);
+	entry->kind = kind;
+	for (guint i = 0; metadata != NULL && i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++) {
+		const gchar *value = g_hash_table_lookup (metadata, cd_profile_array_entry_keys[i]);
+		entry->metadata[i] = cd_string_pool_intern (value);
+	}
+	g_ptr_array_add (priv->entries, entry);
+	cd_profile_array_entry_metadata_insert (profile_array, entry);
+	cd_profile_array_entry_hash_insert (priv->entry_id_hash, entry->id, entry);
+	cd_profile_array_entry_hash_insert (priv->entry_filename_hash, entry->filename, entry);
+	cd_profile_array_entry_hash_insert (priv->entry_basename_hash, entry->basename, entry);
+	cd_profile_array_entry_hash_insert (priv->entry_object_path_hash, entry->object_path, entry);
+	g_clear_pointer (&priv->variant, g_variant_unref);
+	return TRUE;
+}
+
+gboolean
+cd_profile_array_remove_index (CdProfileArray *profile_array,
+			       const gchar *filename)
+{
+	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
+	CdProfileArrayEntry *entry;
+
+	g_return_val_if_fail (CD_IS_PROFILE_ARRAY (profile_array), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	entry = g_hash_table_lookup (priv->entry_filename_hash, filename);
+	if (entry == NULL)
+		return FALSE;
+	if (entry->profile != NULL)
+		cd_profile_array_remove (profile_array, entry->profile);
+	cd_profile_array_entry_hash_remove (priv->entry_id_hash, entry->id, entry);
+	cd_profile_array_entry_hash_remove (priv->entry_filename_hash, entry->filename, entry);
+	cd_profile_array_entry_hash_remove (priv->entry_basename_hash, entry->basename, entry);
+	cd_profile_array_entry_hash_remove (priv->entry_object_path_hash, entry->object_path, entry);
+	cd_profile_array_entry_metadata_remove (profile_array, entry);
+	g_ptr_array_remove (priv->entries, entry);
+	g_clear_pointer (&priv->variant, g_variant_unref);
+	return TRUE;
 }
 
 static void
@@ -246,6 +949,25 @@ cd_profile_array_init (CdProfileArray *profile_array)
 {
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
 	priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	priv->keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					    NULL, (GDestroyNotify) cd_profile_array_keys_free);
+	priv->id_hash = cd_profile_array_index_new ();
+	priv->filename_hash = cd_profile_array_index_new ();
+	priv->basename_hash = cd_profile_array_index_new ();
+	priv->object_path_hash = cd_profile_array_index_new ();
+	priv->metadata_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, (GDestroyNotify) g_hash_table_unref);
+	priv->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_profile_array_entry_free);
+	priv->entry_id_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->entry_filename_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->entry_basename_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->entry_object_path_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++) {
+		priv->entry_metadata_hash[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+								      cd_string_pool_release,
+								      (GDestroyNotify) g_ptr_array_unref);
+	}
+	g_queue_init (&priv->loaded);
 }
 
 static void
@@ -254,7 +976,30 @@ cd_profile_array_finalize (GObject *object)
 	CdProfileArray *profile_array = CD_PROFILE_ARRAY (object);
 	CdProfileArrayPrivate *priv = GET_PRIVATE (profile_array);
 
+	if (priv->evict_id != 0)
+		g_source_remove (priv->evict_id);
+	for (guint i = 0; i < priv->array->len; i++) {
+		g_signal_handlers_disconnect_by_func (g_ptr_array_index (priv->array, i),
+						      G_CALLBACK (cd_profile_array_notify_cb),
+						      profile_array);
+	}
 	g_ptr_array_unref (priv->array);
+	g_hash_table_unref (priv->keys);
+	g_hash_table_unref (priv->id_hash);
+	g_hash_table_unref (priv->filename_hash);
+	g_hash_table_unref (priv->basename_hash);
+	g_hash_table_unref (priv->object_path_hash);
+	g_hash_table_unref (priv->metadata_hash);
+	if (priv->variant != NULL)
+		g_variant_unref (priv->variant);
+	g_queue_clear (&priv->loaded);
+	g_hash_table_unref (priv->entry_id_hash);
+	g_hash_table_unref (priv->entry_filename_hash);
+	g_hash_table_unref (priv->entry_basename_hash);
+	g_hash_table_unref (priv->entry_object_path_hash);
+	for (guint i = 0; i < CD_PROFILE_ARRAY_ENTRY_KEYS; i++)
+		g_hash_table_unref (priv->entry_metadata_hash[i]);
+	g_ptr_array_unref (priv->entries);
 
 	G_OBJECT_CLASS (cd_profile_array_parent_class)->finalize (object);
 }
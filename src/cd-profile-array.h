@@ -36,12 +36,21 @@ struct _CdProfileArrayClass
 	GObjectClass		 parent_class;
 };
 
+typedef CdProfile	*(*CdProfileArrayLoadFunc)		(CdProfileArray	*profile_array,
+								 const gchar	*filename,
+								 gpointer	 user_data,
+								 GError		**error);
+
 CdProfileArray	*cd_profile_array_new			(void);
 
 void		 cd_profile_array_add			(CdProfileArray	*profile_array,
 							 CdProfile	*profile);
 void		 cd_profile_array_remove		(CdProfileArray	*profile_array,
 							 CdProfile	*profile);
+void		 cd_profile_array_hold			(CdProfileArray	*profile_array,
+							 CdProfile	*profile);
+void		 cd_profile_array_release		(CdProfileArray	*profile_array,
+							 CdProfile	*profile);
 CdProfile	*cd_profile_array_get_by_id_owner	(CdProfileArray	*profile_array,
 							 const gchar	*id,
 							 guint		 owner);
@@ -57,7 +66,23 @@ GPtrArray	*cd_profile_array_get_by_kind		(CdProfileArray	*profile_array,
 GPtrArray	*cd_profile_array_get_by_metadata	(CdProfileArray	*profile_array,
 							 const gchar	*key,
 							 const gchar	*value);
+GPtrArray	*cd_profile_array_get_array		(CdProfileArray	*profile_array);
 GVariant	*cd_profile_array_get_variant		(CdProfileArray	*profile_array);
+GVariant	*cd_profile_array_get_variant_by_kind	(CdProfileArray	*profile_array,
+							 CdProfileKind	 kind);
+void		 cd_profile_array_set_load_func		(CdProfileArray	*profile_array,
+							 CdProfileArrayLoadFunc func,
+							 gpointer	 user_data);
+void		 cd_profile_array_set_max_loaded	(CdProfileArray	*profile_array,
+							 guint		 max_loaded);
+gboolean	 cd_profile_array_add_index		(CdProfileArray	*profile_array,
+							 const gchar	*id,
+							 const gchar	*filename,
+							 const gchar	*object_path,
+							 CdProfileKind	 kind,
+							 GHashTable	*metadata);
+gboolean	 cd_profile_array_remove_index		(CdProfileArray	*profile_array,
+							 const gchar	*filename);
 
 G_END_DECLS
 
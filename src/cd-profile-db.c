@@ -35,12 +35,97 @@ static void cd_profile_db_finalize	(GObject *object);
 typedef struct
 {
 	sqlite3			*db;
+	GHashTable		*statements;	/* sql : sqlite3_stmt */
+	GHashTable		*cache;		/* uid:property:profile_id : value */
+	guint			 commit_id;
 } CdProfileDbPrivate;
 
 static gpointer cd_profile_db_object = NULL;
 
 G_DEFINE_TYPE_WITH_PRIVATE (CdProfileDb, cd_profile_db, G_TYPE_OBJECT)
 
+/* property names never contain ':', so the profile ID goes last */
+static gchar *
+cd_profile_db_cache_key (const gchar *profile_id, const gchar *property, guint uid)
+{
+	return g_strdup_printf ("%u:%s:%s", uid, property, profile_id);
+}
+
+/* reads every stored property so lookups never have to touch the database */
+static gboolean
+cd_profile_db_cache_load (CdProfileDb *pdb, GError **error)
+{
+	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
+	sqlite3_stmt *stmt;
+	gint rc;
+
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "SELECT profile_id, property, uid, value "
+				  "FROM properties_pu;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		const gchar *profile_id = (const gchar *) sqlite3_column_text (stmt, 0);
+		const gchar *property = (const gchar *) sqlite3_column_text (stmt, 1);
+		guint uid = (guint) sqlite3_column_int64 (stmt, 2);
+		const gchar *value = (const gchar *) sqlite3_column_text (stmt, 3);
+
+		if (profile_id == NULL || property == NULL)
+			continue;
+		g_hash_table_insert (priv->cache,
+				     cd_profile_db_cache_key (profile_id, property, uid),
+				     g_strdup (value));
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INTERNAL,
+			     "SQL error: %s",
+			     sqlite3_errmsg(priv->db));
+		sqlite3_reset (stmt);
+		return FALSE;
+	}
+	sqlite3_reset (stmt);
+	g_debug ("CdProfileDb: cached %u properties",
+		 g_hash_table_size (priv->cache));
+	return TRUE;
+}
+
+/* commits any writes still waiting in the batch */
+gboolean
+cd_profile_db_flush (CdProfileDb *pdb, GError **error)
+{
+	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
+	g_return_val_if_fail (CD_IS_PROFILE_DB (pdb), FALSE);
+	if (priv->db == NULL)
+		return TRUE;
+	return cd_sqlite_batch_commit (priv->db, &priv->commit_id, error);
+}
+
+static gboolean
+cd_profile_db_commit_cb (gpointer user_data)
+{
+	CdProfileDb *pdb = CD_PROFILE_DB (user_data);
+	g_autoptr(GError) error = NULL;
+	if (!cd_profile_db_flush (pdb, &error)) {
+		g_warning ("CdProfileDb: failed to commit, retrying: %s", error->message);
+		return G_SOURCE_CONTINUE;
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+cd_profile_db_begin (CdProfileDb *pdb, GError **error)
+{
+	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
+	return cd_sqlite_batch_begin (priv->db,
+				      &priv->commit_id,
+				      cd_profile_db_commit_cb,
+				      pdb,
+				      error);
+}
+
 gboolean
 cd_profile_db_load (CdProfileDb *pdb,
 		    const gchar *filename,
@@ -72,8 +157,9 @@ cd_profile_db_load (CdProfileDb *pdb,
 		return FALSE;
 	}
 
-	/* we don't need to keep doing fsync */
-	sqlite3_exec (priv->db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
+	/* write-ahead logging only needs an fsync at checkpoints */
+	sqlite3_exec (priv->db, "PRAGMA journal_mode=WAL;PRAGMA synchronous=NORMAL;",
+		      NULL, NULL, NULL);
 
 	/* check schema */
 	rc = sqlite3_exec (priv->db, "SELECT * FROM properties_pu LIMIT 1", NULL, NULL, NULL);
@@ -86,7 +172,7 @@ cd_profile_db_load (CdProfileDb *pdb,
 			    "PRIMARY KEY (profile_id, property, uid));";
 		sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
 	}
-	return TRUE;
+	return cd_profile_db_cache_load (pdb, error);
 }
 
 gboolean
@@ -109,6 +195,7 @@ cd_profile_db_empty (CdProfileDb *pdb, GError **error)
 			     sqlite3_errmsg(priv->db));
 		return FALSE;
 	}
+	g_hash_table_remove_all (priv->cache);
 	return TRUE;
 }
 
@@ -121,34 +208,33 @@ cd_profile_db_set_property (CdProfileDb *pdb,
 			    GError  **error)
 {
 	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	sqlite3_stmt *stmt;
 
 	g_return_val_if_fail (CD_IS_PROFILE_DB (pdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	g_debug ("CdProfileDb: add profile property %s [%s=%s]",
 		 profile_id, property, value);
-	statement = sqlite3_mprintf ("INSERT OR REPLACE INTO properties_pu (profile_id, "
-				     "property, uid, value) "
-				     "VALUES ('%q', '%q', '%u', '%q');",
-				     profile_id, property, uid, value);
+	if (!cd_profile_db_begin (pdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "INSERT OR REPLACE INTO properties_pu (profile_id, "
+				  "property, uid, value) VALUES (?1, ?2, ?3, ?4);",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, profile_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 2, property, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 3, uid);
+	sqlite3_bind_text (stmt, 4, value, -1, SQLITE_TRANSIENT);
 
 	/* insert the entry */
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	g_hash_table_insert (priv->cache,
+			     cd_profile_db_cache_key (profile_id, property, uid),
+			     g_strdup (value));
+	return TRUE;
 }
 
 gboolean
@@ -159,47 +245,30 @@ cd_profile_db_remove (CdProfileDb *pdb,
 		      GError  **error)
 {
 	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
-	gboolean ret = TRUE;
-	gchar *statement = NULL;
-	gint rc;
+	sqlite3_stmt *stmt;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (CD_IS_PROFILE_DB (pdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
 	/* remove the entry */
 	g_debug ("CdProfileDb: remove profile %s", profile_id);
-	statement = sqlite3_mprintf ("DELETE FROM properties_pu WHERE "
-				     "profile_id = '%q' AND "
-				     "uid = '%i' AND "
-				     "property = '%q' LIMIT 1;",
-				     profile_id, uid, property);
-	rc = sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		ret = FALSE;
-		goto out;
-	}
-out:
-	sqlite3_free (statement);
-	return ret;
-}
-
-static gint
-cd_profile_db_sqlite_cb (void *data,
-			gint argc,
-			gchar **argv,
-			gchar **col_name)
-{
-	gchar **value = (gchar **) data;
-
-	/* should only be one entry */
-	g_debug ("CdProfileDb: got sql result %s", argv[0]);
-	*value = g_strdup (argv[0]);
-	return 0;
+	if (!cd_profile_db_begin (pdb, error))
+		return FALSE;
+	stmt = cd_sqlite_prepare (priv->db, priv->statements,
+				  "DELETE FROM properties_pu WHERE "
+				  "profile_id = ?1 AND uid = ?2 AND property = ?3;",
+				  error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_text (stmt, 1, profile_id, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_int64 (stmt, 2, uid);
+	sqlite3_bind_text (stmt, 3, property, -1, SQLITE_TRANSIENT);
+	if (!cd_sqlite_step (priv->db, stmt, error))
+		return FALSE;
+	key = cd_profile_db_cache_key (profile_id, property, uid);
+	g_hash_table_remove (priv->cache, key);
+	return TRUE;
 }
 
 gboolean
@@ -211,38 +280,21 @@ cd_profile_db_get_property (CdProfileDb *pdb,
 			   GError  **error)
 {
 	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
-	gboolean ret = TRUE;
-	gchar *statement;
-	gint rc;
+	const gchar *tmp;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (CD_IS_PROFILE_DB (pdb), FALSE);
 	g_return_val_if_fail (priv->db != NULL, FALSE);
 
+	/* the cache holds every row, so a miss means there is no entry */
 	g_debug ("CdProfileDb: get property %s for %s", property, profile_id);
-	statement = sqlite3_mprintf ("SELECT value FROM properties_pu WHERE "
-				     "profile_id = '%q' AND "
-				     "uid = '%i' AND "
-				     "property = '%q' LIMIT 1;",
-				     profile_id, uid, property);
-
-	/* retrieve the entry */
-	rc = sqlite3_exec (priv->db,
-			   statement,
-			   cd_profile_db_sqlite_cb,
-			   value,
-			   NULL);
-	if (rc != SQLITE_OK) {
-		ret = FALSE;
-		g_set_error (error,
-			     CD_CLIENT_ERROR,
-			     CD_CLIENT_ERROR_INTERNAL,
-			     "SQL error: %s",
-			     sqlite3_errmsg(priv->db));
-		goto out;
+	key = cd_profile_db_cache_key (profile_id, property, uid);
+	tmp = g_hash_table_lookup (priv->cache, key);
+	if (tmp != NULL) {
+		g_debug ("CdProfileDb: got cached result %s", tmp);
+		*value = g_strdup (tmp);
 	}
-out:
-	sqlite3_free (statement);
-	return ret;
+	return TRUE;
 }
 
 static void
@@ -255,6 +307,9 @@ cd_profile_db_class_init (CdProfileDbClass *klass)
 static void
 cd_profile_db_init (CdProfileDb *pdb)
 {
+	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
+	priv->statements = cd_sqlite_statements_new ();
+	priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 static void
@@ -262,8 +317,15 @@ cd_profile_db_finalize (GObject *object)
 {
 	CdProfileDb *pdb = CD_PROFILE_DB (object);
 	CdProfileDbPrivate *priv = GET_PRIVATE (pdb);
+	g_autoptr(GError) error = NULL;
+
+	/* write out anything still batched */
+	if (!cd_profile_db_flush (pdb, &error))
+		g_warning ("CdProfileDb: failed to commit: %s", error->message);
 
 	/* close the database */
+	g_hash_table_unref (priv->statements);
+	g_hash_table_unref (priv->cache);
 	sqlite3_close (priv->db);
 
 	G_OBJECT_CLASS (cd_profile_db_parent_class)->finalize (object);
@@ -64,6 +64,9 @@ gboolean	 cd_profile_db_remove		(CdProfileDb	*pdb,
 						 guint		 uid,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 cd_profile_db_flush		(CdProfileDb	*pdb,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
 
@@ -32,8 +32,11 @@
 #include <math.h>
 
 #include "cd-common.h"
+#include "cd-memory-private.h"
+#include "cd-metrics.h"
 #include "cd-profile.h"
 #include "cd-profile-db.h"
+#include "cd-trace-private.h"
 
 #include "colord-resources.h"
 
@@ -43,6 +46,9 @@ static void	cd_profile_set_filename	(CdProfile	*profile,
 
 #define GET_PRIVATE(o) (cd_profile_get_instance_private (o))
 
+/* set from --root-dir, and the same for every profile */
+static gchar *cd_profile_root_dir = NULL;
+
 typedef struct
 {
 	CdObjectScope			 object_scope;
@@ -50,6 +56,7 @@ typedef struct
 	gchar				*id;
 	gchar				*object_path;
 	gchar				*qualifier;
+	GQuark				 qualifier_atoms[CD_QUALIFIER_ATOMS_MAX];
 	gchar				*format;
 	gchar				*checksum;
 	gchar				*title;
@@ -67,6 +74,10 @@ typedef struct
 	GMappedFile			*mapped_file;
 	guint				 score;
 	CdProfileDb			*db;
+	GVariant			*metadata_variant;
+	GHashTable			*pending_properties;	/* name : GVariant */
+	gboolean			 pending_changed;
+	guint				 pending_id;
 } CdProfilePrivate;
 
 enum {
@@ -81,10 +92,13 @@ enum {
 	PROP_QUALIFIER,
 	PROP_TITLE,
 	PROP_FILENAME,
+	PROP_METADATA,
 	PROP_LAST
 };
 
 static guint signals[SIGNAL_LAST] = { 0 };
+static guint cd_profile_qualifier_serial = 0;
+static gint cd_profile_live_count = 0;
 G_DEFINE_TYPE_WITH_PRIVATE (CdProfile, cd_profile, G_TYPE_OBJECT)
 
 GQuark
@@ -220,8 +234,10 @@ cd_profile_set_metadata (CdProfile *profile,
 	if (g_strcmp0 (property, "CreatorApp") == 0)
 		property = CD_PROFILE_METADATA_CMF_PRODUCT;
 	g_hash_table_insert (priv->metadata,
-			     g_strdup (property),
-			     g_strdup (value));
+			     cd_string_pool_intern (property),
+			     cd_string_pool_intern (value));
+	g_clear_pointer (&priv->metadata_variant, g_variant_unref);
+	g_object_notify (G_OBJECT (profile), "metadata");
 }
 
 void
@@ -288,6 +304,7 @@ cd_profile_set_id (CdProfile *profile, const gchar *id)
 
 	/* now calculate this again */
 	cd_profile_set_object_path (profile);
+	g_object_notify (G_OBJECT (profile), "id");
 }
 
 const gchar *
@@ -298,48 +315,57 @@ cd_profile_get_filename (CdProfile *profile)
 	return priv->filename;
 }
 
+/* sends everything that changed since the last flush as one
+ * PropertiesChanged, followed by a single Changed if required */
 static void
-cd_profile_dbus_emit_property_changed (CdProfile *profile,
-				       const gchar *property_name,
-				       GVariant *property_value)
+cd_profile_dbus_flush_changes (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
 	GVariantBuilder builder;
 	GVariantBuilder invalidated_builder;
 
+	if (priv->pending_id != 0) {
+		g_source_remove (priv->pending_id);
+		priv->pending_id = 0;
+	}
+
 	/* not yet connected */
-	if (priv->connection == NULL)
+	if (priv->connection == NULL) {
+		g_hash_table_remove_all (priv->pending_properties);
+		priv->pending_changed = FALSE;
 		return;
+	}
 
 	/* build the dict */
-	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder,
-			       "{sv}",
-			       property_name,
-			       property_value);
-	g_dbus_connection_emit_signal (priv->connection,
-				       NULL,
-				       priv->object_path,
-				       "org.freedesktop.DBus.Properties",
-				       "PropertiesChanged",
-				       g_variant_new ("(sa{sv}as)",
-				       COLORD_DBUS_INTERFACE_PROFILE,
-				       &builder,
-				       &invalidated_builder),
-				       NULL);
-	g_variant_builder_clear (&builder);
-	g_variant_builder_clear (&invalidated_builder);
-}
-
-static void
-cd_profile_dbus_emit_profile_changed (CdProfile *profile)
-{
-	CdProfilePrivate *priv = GET_PRIVATE (profile);
-
-	/* not yet connected */
-	if (priv->connection == NULL)
+	if (g_hash_table_size (priv->pending_properties) > 0) {
+		g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
+		g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+		g_hash_table_iter_init (&iter, priv->pending_properties);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			g_variant_builder_add (&builder, "{sv}",
+					       (const gchar *) key,
+					       (GVariant *) value);
+		}
+		g_dbus_connection_emit_signal (priv->connection,
+					       NULL,
+					       priv->object_path,
+					       "org.freedesktop.DBus.Properties",
+					       "PropertiesChanged",
+					       g_variant_new ("(sa{sv}as)",
+					       COLORD_DBUS_INTERFACE_PROFILE,
+					       &builder,
+					       &invalidated_builder),
+					       NULL);
+		g_variant_builder_clear (&builder);
+		g_variant_builder_clear (&invalidated_builder);
+		g_hash_table_remove_all (priv->pending_properties);
+	}
+	if (!priv->pending_changed)
 		return;
+	priv->pending_changed = FALSE;
 
 	/* emit signal */
 	g_debug ("CdProfile: emit Changed on %s",
@@ -364,6 +390,79 @@ cd_profile_dbus_emit_profile_changed (CdProfile *profile)
 				       NULL);
 }
 
+static gboolean
+cd_profile_dbus_flush_changes_cb (gpointer user_data)
+{
+	CdProfile *profile = CD_PROFILE (user_data);
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	priv->pending_id = 0;
+	cd_profile_dbus_flush_changes (profile);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_profile_dbus_queue_changes (CdProfile *profile)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+
+	/* the caller has to see the change before the method returns */
+	if (cd_object_dispatch_active ()) {
+		cd_profile_dbus_flush_changes (profile);
+		return;
+	}
+	if (priv->pending_id == 0) {
+		priv->pending_id = g_idle_add (cd_profile_dbus_flush_changes_cb, profile);
+		g_source_set_name_by_id (priv->pending_id, "[CdProfile] flush changes");
+	}
+}
+
+static void
+cd_profile_dbus_emit_property_changed (CdProfile *profile,
+				       const gchar *property_name,
+				       GVariant *property_value)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+
+	/* not yet connected */
+	if (priv->connection == NULL)
+		return;
+	cd_object_generation_bump ();
+
+	/* later values replace earlier ones in the same flush */
+	g_hash_table_insert (priv->pending_properties,
+			     g_strdup (property_name),
+			     g_variant_ref_sink (property_value));
+	cd_profile_dbus_queue_changes (profile);
+}
+
+static void
+cd_profile_dbus_emit_profile_changed (CdProfile *profile)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+
+	/* not yet connected */
+	if (priv->connection == NULL)
+		return;
+	priv->pending_changed = TRUE;
+	cd_profile_dbus_queue_changes (profile);
+}
+
+/* the profile directories can be moved below --root-dir */
+void
+cd_profile_set_root_dir (const gchar *root_dir)
+{
+	g_free (cd_profile_root_dir);
+	cd_profile_root_dir = g_strdup (root_dir);
+}
+
+static gchar *
+cd_profile_get_path (const gchar *path)
+{
+	if (cd_profile_root_dir == NULL)
+		return g_strdup (path);
+	return g_build_filename (cd_profile_root_dir, path, NULL);
+}
+
 static gboolean
 cd_profile_install_system_wide (CdProfile *profile, GError **error)
 {
@@ -372,6 +471,8 @@ cd_profile_install_system_wide (CdProfile *profile, GError **error)
 	g_autoptr(GError) error_local = NULL;
 	g_autofree gchar *basename = NULL;
 	g_autofree gchar *filename = NULL;
+	g_autofree gchar *datadir = NULL;
+	g_autofree gchar *system_profiles_dir = NULL;
 	g_autoptr(GFile) file_dest = NULL;
 	g_autoptr(GFile) file = NULL;
 
@@ -385,8 +486,8 @@ cd_profile_install_system_wide (CdProfile *profile, GError **error)
 	}
 
 	/* is profile already installed in /var/lib/color */
-	if (g_str_has_prefix (priv->filename,
-			      CD_SYSTEM_PROFILES_DIR)) {
+	system_profiles_dir = cd_profile_get_path (CD_SYSTEM_PROFILES_DIR);
+	if (g_str_has_prefix (priv->filename, system_profiles_dir)) {
 		g_set_error (error,
 			     CD_PROFILE_ERROR,
 			     CD_PROFILE_ERROR_ALREADY_INSTALLED,
@@ -396,8 +497,8 @@ cd_profile_install_system_wide (CdProfile *profile, GError **error)
 	}
 
 	/* is profile already installed in /usr/share/color */
-	if (g_str_has_prefix (priv->filename,
-			      DATADIR "/color")) {
+	datadir = cd_profile_get_path (DATADIR "/color");
+	if (g_str_has_prefix (priv->filename, datadir)) {
 		g_set_error (error,
 			     CD_PROFILE_ERROR,
 			     CD_PROFILE_ERROR_ALREADY_INSTALLED,
@@ -408,8 +509,7 @@ cd_profile_install_system_wide (CdProfile *profile, GError **error)
 
 	/* copy */
 	basename = g_path_get_basename (priv->filename);
-	filename = g_build_filename (CD_SYSTEM_PROFILES_DIR,
-				     basename, NULL);
+	filename = g_build_filename (system_profiles_dir, basename, NULL);
 	file_dest = g_file_new_for_path (filename);
 
 	/* try to write a mapped file first, else copy the file */
@@ -475,6 +575,15 @@ cd_profile_get_metadata_as_variant (CdProfile *profile)
 	return g_variant_builder_end (&builder);
 }
 
+static GVariant *
+cd_profile_get_metadata_cached (CdProfile *profile)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	if (priv->metadata_variant == NULL)
+		priv->metadata_variant = g_variant_ref_sink (cd_profile_get_metadata_as_variant (profile));
+	return priv->metadata_variant;
+}
+
 static GVariant *
 cd_profile_get_nullable_for_string (const gchar *value)
 {
@@ -562,7 +671,7 @@ cd_profile_set_property_internal (CdProfile *profile,
 		cd_profile_set_metadata (profile, property, value);
 		cd_profile_dbus_emit_property_changed (profile,
 						       CD_PROFILE_PROPERTY_METADATA,
-						       cd_profile_get_metadata_as_variant (profile));
+						       cd_profile_get_metadata_cached (profile));
 		return TRUE;
 	}
 
@@ -673,6 +782,21 @@ cd_profile_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	g_critical ("failed to process method %s", method_name);
 }
 
+/* records how long each method handler takes */
+static void
+cd_profile_dbus_method_call_timed (GDBusConnection *connection, const gchar *sender,
+				   const gchar *object_path, const gchar *interface_name,
+				   const gchar *method_name, GVariant *parameters,
+				   GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	gint64 start = g_get_monotonic_time ();
+	cd_object_dispatch_push ();
+	cd_profile_dbus_method_call (connection, sender, object_path, interface_name,
+				     method_name, parameters, invocation, user_data);
+	cd_object_dispatch_pop ();
+	cd_metrics_add_method ("Profile", method_name, start);
+}
+
 static GVariant *
 cd_profile_dbus_get_property (GDBusConnection *connection, const gchar *sender,
 			     const gchar *object_path, const gchar *interface_name,
@@ -716,7 +840,7 @@ cd_profile_dbus_get_property (GDBusConnection *connection, const gchar *sender,
 	if (g_strcmp0 (property_name, CD_PROFILE_PROPERTY_IS_SYSTEM_WIDE) == 0)
 		return g_variant_new_boolean (priv->is_system_wide);
 	if (g_strcmp0 (property_name, CD_PROFILE_PROPERTY_METADATA) == 0)
-		return cd_profile_get_metadata_as_variant (profile);
+		return g_variant_ref (cd_profile_get_metadata_cached (profile));
 	if (g_strcmp0 (property_name, CD_PROFILE_PROPERTY_CREATED) == 0)
 		return g_variant_new_int64 (priv->created);
 	if (g_strcmp0 (property_name, CD_PROFILE_PROPERTY_SCOPE) == 0)
@@ -740,6 +864,52 @@ cd_profile_dbus_get_property (GDBusConnection *connection, const gchar *sender,
 	return NULL;
 }
 
+GVariant *
+cd_profile_get_properties (CdProfile *profile,
+			   GDBusInterfaceInfo *info,
+			   const gchar *sender)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	GDBusPropertyInfo *property;
+	GVariantBuilder builder;
+
+	/* the same values Properties.GetAll() would return */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	for (guint i = 0; info->properties[i] != NULL; i++) {
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GVariant) value = NULL;
+
+		property = info->properties[i];
+		if ((property->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE) == 0)
+			continue;
+		value = cd_profile_dbus_get_property (priv->connection, sender,
+						      priv->object_path, info->name,
+						      property->name, &error, profile);
+		if (value == NULL) {
+			g_debug ("CdProfile: failed to get %s: %s",
+				 property->name,
+				 error != NULL ? error->message : "unknown");
+			continue;
+		}
+		g_variant_take_ref (value);
+		g_variant_builder_add (&builder, "{sv}", property->name, value);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static const GDBusInterfaceVTable cd_profile_interface_vtable = {
+	cd_profile_dbus_method_call_timed,
+	cd_profile_dbus_get_property,
+	NULL
+};
+
+/* used to dispatch calls for profiles that are not registered yet */
+const GDBusInterfaceVTable *
+cd_profile_get_interface_vtable (void)
+{
+	return &cd_profile_interface_vtable;
+}
+
 gboolean
 cd_profile_register_object (CdProfile *profile,
 			    GDBusConnection *connection,
@@ -749,18 +919,12 @@ cd_profile_register_object (CdProfile *profile,
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	g_autoptr(GError) error_local = NULL;
 
-	static const GDBusInterfaceVTable interface_vtable = {
-		cd_profile_dbus_method_call,
-		cd_profile_dbus_get_property,
-		NULL
-	};
-
 	priv->connection = connection;
 	priv->registration_id = g_dbus_connection_register_object (
 		connection,
 		priv->object_path,
 		info,
-		&interface_vtable,
+		&cd_profile_interface_vtable,
 		profile,  /* user_data */
 		NULL,  /* user_data_free_func */
 		&error_local); /* GError** */
@@ -845,8 +1009,12 @@ cd_profile_set_from_profile (CdProfile *profile, CdIcc *icc, GError **error)
 		value = g_hash_table_lookup (metadata, key);
 		g_debug ("Adding metadata %s=%s", key, value);
 		g_hash_table_insert (priv->metadata,
-				     g_strdup (key),
-				     g_strdup (value));
+				     cd_string_pool_intern (key),
+				     cd_string_pool_intern (value));
+	}
+	if (keys != NULL) {
+		g_clear_pointer (&priv->metadata_variant, g_variant_unref);
+		g_object_notify (G_OBJECT (profile), "metadata");
 	}
 
 	/* set the format from the metadata */
@@ -870,17 +1038,34 @@ cd_profile_set_from_profile (CdProfile *profile, CdIcc *icc, GError **error)
 
 	/* get the profile created time and date */
 	lcms_profile = cd_icc_get_handle (icc);
-	ret = cmsGetHeaderCreationDateTime (lcms_profile, &created);
-	if (ret) {
-		created.tm_isdst = -1;
-		priv->created = mktime (&created);
+	if (lcms_profile == NULL) {
+		g_autoptr(GDateTime) dt = NULL;
+		g_auto(GStrv) tags = NULL;
+
+		/* added from the index without being parsed */
+		dt = cd_icc_get_created (icc);
+		if (dt != NULL) {
+			priv->created = g_date_time_to_unix (dt);
+		} else {
+			g_warning ("failed to get created time");
+			priv->created = 0;
+		}
+		tags = cd_icc_get_tags (icc, NULL);
+		priv->has_vcgt = tags != NULL &&
+				 g_strv_contains ((const gchar * const *) tags, "vcgt");
 	} else {
-		g_warning ("failed to get created time");
-		priv->created = 0;
-	}
+		ret = cmsGetHeaderCreationDateTime (lcms_profile, &created);
+		if (ret) {
+			created.tm_isdst = -1;
+			priv->created = mktime (&created);
+		} else {
+			g_warning ("failed to get created time");
+			priv->created = 0;
+		}
 
-	/* do we have vcgt */
-	priv->has_vcgt = cmsIsTag (lcms_profile, cmsSigVcgtTag);
+		/* do we have vcgt */
+		priv->has_vcgt = cmsIsTag (lcms_profile, cmsSigVcgtTag);
+	}
 
 	/* get the checksum for the profile if we can */
 	priv->checksum = g_strdup (cd_icc_get_checksum (icc));
@@ -904,6 +1089,51 @@ cd_profile_get_warnings (CdProfile *profile)
 	return (const gchar **) priv->warnings;
 }
 
+/* the number of profiles not yet finalized, to find leaks */
+guint
+cd_profile_get_live_count (void)
+{
+	return (guint) g_atomic_int_get (&cd_profile_live_count);
+}
+
+static gsize
+cd_profile_get_string_size (const gchar *str)
+{
+	return str != NULL ? strlen (str) + 1 : 0;
+}
+
+/* an estimate of the heap used, with the mapped ICC data kept apart as it
+ * is only resident once it has been read */
+gsize
+cd_profile_get_memory_size (CdProfile *profile, gsize *mapped)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	gsize size = sizeof (CdProfile) + sizeof (CdProfilePrivate);
+
+	g_return_val_if_fail (CD_IS_PROFILE (profile), 0);
+
+	size += cd_profile_get_string_size (priv->filename);
+	size += cd_profile_get_string_size (priv->id);
+	size += cd_profile_get_string_size (priv->object_path);
+	size += cd_profile_get_string_size (priv->qualifier);
+	size += cd_profile_get_string_size (priv->format);
+	size += cd_profile_get_string_size (priv->checksum);
+	size += cd_profile_get_string_size (priv->title);
+	if (priv->warnings != NULL) {
+		for (guint i = 0; priv->warnings[i] != NULL; i++)
+			size += strlen (priv->warnings[i]) + 1 + sizeof (gchar *);
+	}
+	size += cd_memory_get_hash_table_size (priv->metadata);
+	if (priv->metadata_variant != NULL)
+		size += g_variant_get_size (priv->metadata_variant);
+	if (mapped != NULL) {
+		*mapped = 0;
+		if (priv->mapped_file != NULL)
+			*mapped = g_mapped_file_get_length (priv->mapped_file);
+	}
+	return size;
+}
+
 static void
 cd_profile_emit_parsed_property_changed (CdProfile *profile)
 {
@@ -926,7 +1156,7 @@ cd_profile_emit_parsed_property_changed (CdProfile *profile)
 					       g_variant_new_boolean (priv->has_vcgt));
 	cd_profile_dbus_emit_property_changed (profile,
 					       CD_PROFILE_PROPERTY_METADATA,
-					       cd_profile_get_metadata_as_variant (profile));
+					       cd_profile_get_metadata_cached (profile));
 	cd_profile_dbus_emit_property_changed (profile,
 					       CD_PROFILE_PROPERTY_QUALIFIER,
 					       cd_profile_get_nullable_for_string (priv->qualifier));
@@ -941,17 +1171,24 @@ cd_profile_emit_parsed_property_changed (CdProfile *profile)
 gboolean
 cd_profile_load_from_icc (CdProfile *profile, CdIcc *icc, GError **error)
 {
+	gboolean ret;
+	gint64 start = g_get_monotonic_time ();
+
 	g_return_val_if_fail (CD_IS_PROFILE (profile), FALSE);
 
 	/* save filename */
 	cd_profile_set_filename (profile, cd_icc_get_filename (icc));
 
 	/* set the virtual profile from the lcms profile */
-	if (!cd_profile_set_from_profile (profile, icc, error))
+	CD_TRACE1 (profile_load_begin, cd_icc_get_filename (icc));
+	ret = cd_profile_set_from_profile (profile, icc, error);
+	CD_TRACE2 (profile_load_end, cd_icc_get_filename (icc), ret);
+	if (!ret)
 		return FALSE;
 
 	/* emit all the things that could have changed */
 	cd_profile_emit_parsed_property_changed (profile);
+	cd_metrics_add ("icc.load", start);
 	return TRUE;
 }
 
@@ -962,6 +1199,7 @@ cd_profile_load_from_fd (CdProfile *profile,
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	gboolean ret;
+	gint64 start = g_get_monotonic_time ();
 	g_autoptr(GError) error_local = NULL;
 	g_autoptr(CdIcc) icc = NULL;
 
@@ -1007,6 +1245,7 @@ cd_profile_load_from_fd (CdProfile *profile,
 
 	/* emit all the things that could have changed */
 	cd_profile_emit_parsed_property_changed (profile);
+	cd_metrics_add ("icc.load-fd", start);
 	return TRUE;
 }
 
@@ -1015,6 +1254,7 @@ cd_profile_load_from_filename (CdProfile *profile, const gchar *filename, GError
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
 	gboolean ret = FALSE;
+	gint64 start = g_get_monotonic_time ();
 	g_autoptr(GError) error_local = NULL;
 	g_autoptr(CdIcc) icc = NULL;
 	g_autoptr(GFile) file = NULL;
@@ -1063,6 +1303,7 @@ cd_profile_load_from_filename (CdProfile *profile, const gchar *filename, GError
 
 	/* emit all the things that could have changed */
 	cd_profile_emit_parsed_property_changed (profile);
+	cd_metrics_add ("icc.load-file", start);
 	return TRUE;
 }
 
@@ -1081,6 +1322,28 @@ cd_profile_set_qualifier (CdProfile *profile, const gchar *qualifier)
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_free (priv->qualifier);
 	priv->qualifier = g_strdup (qualifier);
+	if (qualifier != NULL)
+		cd_qualifier_to_atoms (qualifier, TRUE, priv->qualifier_atoms);
+	cd_profile_qualifier_serial++;
+}
+
+/* the parsed qualifier, or %NULL if none is set */
+const GQuark *
+cd_profile_get_qualifier_atoms (CdProfile *profile)
+{
+	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_return_val_if_fail (CD_IS_PROFILE (profile), NULL);
+	if (priv->qualifier == NULL)
+		return NULL;
+	return priv->qualifier_atoms;
+}
+
+/* bumped whenever any profile changes qualifier, so cached matches
+ * can be checked without watching every profile */
+guint
+cd_profile_get_qualifier_serial (void)
+{
+	return cd_profile_qualifier_serial;
 }
 
 void
@@ -1099,6 +1362,7 @@ cd_profile_set_filename (CdProfile *profile, const gchar *filename)
 	g_return_if_fail (CD_IS_PROFILE (profile));
 	g_free (priv->filename);
 	priv->filename = g_strdup (filename);
+	g_object_notify (G_OBJECT (profile), "filename");
 }
 
 const gchar *
@@ -1211,6 +1475,12 @@ cd_profile_get_property (GObject *object, guint prop_id, GValue *value, GParamSp
 	case PROP_ID:
 		g_value_set_string (value, priv->id);
 		break;
+	case PROP_FILENAME:
+		g_value_set_string (value, priv->filename);
+		break;
+	case PROP_METADATA:
+		g_value_set_boxed (value, priv->metadata);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -1263,6 +1533,26 @@ cd_profile_class_init (CdProfileClass *klass)
 				     G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_ID, pspec);
 
+	/**
+	 * CdProfile:filename:
+	 *
+	 * The ICC profile filename, or %NULL if the profile has no file.
+	 */
+	pspec = g_param_spec_string ("filename", NULL, NULL,
+				     NULL,
+				     G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_FILENAME, pspec);
+
+	/**
+	 * CdProfile:metadata:
+	 *
+	 * The profile metadata, as a string to string hash table.
+	 */
+	pspec = g_param_spec_boxed ("metadata", NULL, NULL,
+				    G_TYPE_HASH_TABLE,
+				    G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_METADATA, pspec);
+
 	/**
 	 * CdProfile::invalidate:
 	 **/
@@ -1278,11 +1568,14 @@ static void
 cd_profile_init (CdProfile *profile)
 {
 	CdProfilePrivate *priv = GET_PRIVATE (profile);
+	g_atomic_int_inc (&cd_profile_live_count);
 	priv->db = cd_profile_db_new ();
 	priv->metadata = g_hash_table_new_full (g_str_hash,
 							 g_str_equal,
-							 g_free,
-							 g_free);
+							 cd_string_pool_release,
+							 cd_string_pool_release);
+	priv->pending_properties = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  g_free, (GDestroyNotify) g_variant_unref);
 }
 
 static void
@@ -1309,6 +1602,12 @@ cd_profile_finalize (GObject *object)
 	g_object_unref (priv->db);
 	g_strfreev (priv->warnings);
 	g_hash_table_unref (priv->metadata);
+	if (priv->metadata_variant != NULL)
+		g_variant_unref (priv->metadata_variant);
+	if (priv->pending_id != 0)
+		g_source_remove (priv->pending_id);
+	g_hash_table_unref (priv->pending_properties);
+	g_atomic_int_add (&cd_profile_live_count, -1);
 
 	G_OBJECT_CLASS (cd_profile_parent_class)->finalize (object);
 }
@@ -41,6 +41,7 @@ struct _CdProfileClass
 
 CdProfile	*cd_profile_new				(void);
 GQuark		 cd_profile_error_quark			(void);
+void		 cd_profile_set_root_dir		(const gchar	*root_dir);
 
 /* accessors */
 const gchar	*cd_profile_get_id			(CdProfile	*profile);
@@ -73,9 +74,15 @@ gboolean	 cd_profile_register_object		(CdProfile	*profile,
 							 GDBusInterfaceInfo *info,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
+const GDBusInterfaceVTable *cd_profile_get_interface_vtable	(void);
+GVariant	*cd_profile_get_properties		(CdProfile	*profile,
+							 GDBusInterfaceInfo *info,
+							 const gchar	*sender);
 const gchar	*cd_profile_get_qualifier		(CdProfile	*profile);
 void		 cd_profile_set_qualifier		(CdProfile	*profile,
 							 const gchar	*qualifier);
+const GQuark	*cd_profile_get_qualifier_atoms		(CdProfile	*profile);
+guint		 cd_profile_get_qualifier_serial	(void);
 void		 cd_profile_set_format			(CdProfile	*profile,
 							 const gchar	*format);
 const gchar	*cd_profile_get_checksum		(CdProfile	*profile);
@@ -96,6 +103,9 @@ gboolean	 cd_profile_set_property_internal	(CdProfile	*profile,
 							 guint		 sender_uid,
 							 GError		**error);
 const gchar	**cd_profile_get_warnings		(CdProfile	*profile);
+guint		 cd_profile_get_live_count		(void);
+gsize		 cd_profile_get_memory_size		(CdProfile	*profile,
+							 gsize		*mapped);
 
 G_END_DECLS
 
@@ -0,0 +1,289 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "cd-common.h"
+#include "cd-provision.h"
+
+#define CD_PROVISION_GROUP_PREFIX	"Device "
+#define CD_PROVISION_KEY_PROFILES	"Profiles"
+
+/* profiles can be listed by ID or by the absolute path of the ICC file */
+static gchar *
+cd_provision_get_profile_id (const gchar *value, GError **error)
+{
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	if (!g_path_is_absolute (value))
+		return g_strdup (value);
+
+	/* use the same ID the ICC store will give the profile */
+	icc = cd_icc_new ();
+	file = g_file_new_for_path (value);
+	if (!cd_icc_load_file (icc, file,
+			       CD_ICC_LOAD_FLAGS_FALLBACK_MD5,
+			       NULL, error))
+		return NULL;
+	return g_strdup_printf ("icc-%s", cd_icc_get_checksum (icc));
+}
+
+typedef struct {
+	gchar		*device_id;
+	gchar		*profile_id;
+	gint64		 timestamp;
+} CdProvisionMapping;
+
+static void
+cd_provision_mapping_free (CdProvisionMapping *mapping)
+{
+	g_free (mapping->device_id);
+	g_free (mapping->profile_id);
+	g_free (mapping);
+}
+
+static gboolean
+cd_provision_add_device (GKeyFile *keyfile,
+			 const gchar *group,
+			 CdDeviceDb *ddb,
+			 GHashTable *existing,
+			 GError **error)
+{
+	const gchar *device_id = group + strlen (CD_PROVISION_GROUP_PREFIX);
+	g_auto(GStrv) keys = NULL;
+
+	/* added by an earlier provision or over D-Bus */
+	if (!g_hash_table_contains (existing, device_id)) {
+		if (!cd_device_db_add (ddb, device_id, error))
+			return FALSE;
+	}
+
+	/* every other key is a device property */
+	keys = g_key_file_get_keys (keyfile, group, NULL, error);
+	if (keys == NULL)
+		return FALSE;
+	for (guint i = 0; keys[i] != NULL; i++) {
+		g_autofree gchar *value = NULL;
+		if (g_strcmp0 (keys[i], CD_PROVISION_KEY_PROFILES) == 0)
+			continue;
+		value = g_key_file_get_string (keyfile, group, keys[i], error);
+		if (value == NULL)
+			return FALSE;
+		if (!cd_device_db_set_property (ddb, device_id,
+						keys[i], value, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+cd_provision_get_mappings (GKeyFile *keyfile,
+			   const gchar *group,
+			   gint64 timestamp,
+			   GPtrArray *mappings,
+			   GError **error)
+{
+	const gchar *device_id = group + strlen (CD_PROVISION_GROUP_PREFIX);
+	g_auto(GStrv) profiles = NULL;
+
+	if (device_id[0] == '\0') {
+		g_set_error (error,
+			     CD_CLIENT_ERROR,
+			     CD_CLIENT_ERROR_INPUT_INVALID,
+			     "no device ID in [%s]", group);
+		return FALSE;
+	}
+
+	/* the first profile listed is the newest, and so the default */
+	profiles = g_key_file_get_string_list (keyfile, group,
+					       CD_PROVISION_KEY_PROFILES,
+					       NULL, NULL);
+	if (profiles == NULL)
+		return TRUE;
+	for (guint i = 0; profiles[i] != NULL; i++) {
+		CdProvisionMapping *mapping;
+		g_autofree gchar *profile_id = NULL;
+		profile_id = cd_provision_get_profile_id (profiles[i], error);
+		if (profile_id == NULL)
+			return FALSE;
+		mapping = g_new0 (CdProvisionMapping, 1);
+		mapping->device_id = g_strdup (device_id);
+		mapping->profile_id = g_steal_pointer (&profile_id);
+		mapping->timestamp = timestamp - i;
+		g_ptr_array_add (mappings, mapping);
+	}
+	return TRUE;
+}
+
+/*
+ * The mapping index cannot be rolled back while the mapping database is
+ * still being checked, so everything that can fail is done before the
+ * first mapping is written, and the devices are committed before that.
+ */
+static gboolean
+cd_provision_write (GKeyFile *keyfile,
+		    CdDeviceDb *ddb,
+		    CdMappingDb *mdb,
+		    GError **error)
+{
+	gint64 timestamp = g_get_real_time ();
+	g_auto(GStrv) groups = NULL;
+	g_autoptr(GHashTable) existing = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) mappings = NULL;
+
+	/* check every group and resolve the profiles before writing */
+	mappings = g_ptr_array_new_with_free_func ((GDestroyNotify) cd_provision_mapping_free);
+	groups = g_key_file_get_groups (keyfile, NULL);
+	for (guint i = 0; groups[i] != NULL; i++) {
+		if (!g_str_has_prefix (groups[i], CD_PROVISION_GROUP_PREFIX)) {
+			g_debug ("CdProvision: ignoring [%s]", groups[i]);
+			continue;
+		}
+		if (!cd_provision_get_mappings (keyfile, groups[i], timestamp,
+						mappings, error)) {
+			g_prefix_error (error, "failed to provision [%s]: ",
+					groups[i]);
+			return FALSE;
+		}
+	}
+
+	/* commit what is already batched so a rollback only drops our writes */
+	if (!cd_device_db_flush (ddb, error))
+		return FALSE;
+	if (!cd_mapping_db_flush (mdb, error))
+		return FALSE;
+
+	/* the file may have been applied before, so only update those */
+	devices = cd_device_db_get_devices (ddb, error);
+	if (devices == NULL)
+		return FALSE;
+	existing = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < devices->len; i++)
+		g_hash_table_add (existing, g_ptr_array_index (devices, i));
+
+	/* write everything in one transaction per database */
+	if (!cd_device_db_begin (ddb, error))
+		return FALSE;
+	for (guint i = 0; groups[i] != NULL; i++) {
+		if (!g_str_has_prefix (groups[i], CD_PROVISION_GROUP_PREFIX))
+			continue;
+		if (!cd_provision_add_device (keyfile, groups[i], ddb,
+					      existing, error)) {
+			g_prefix_error (error, "failed to provision [%s]: ",
+					groups[i]);
+			return FALSE;
+		}
+	}
+	if (!cd_device_db_flush (ddb, error))
+		return FALSE;
+
+	/* the devices are on disk, so a failure here leaves no stamp and
+	 * the mappings are written again on the next start */
+	if (!cd_mapping_db_begin (mdb, error))
+		return FALSE;
+	for (guint i = 0; i < mappings->len; i++) {
+		CdProvisionMapping *mapping = g_ptr_array_index (mappings, i);
+		if (!cd_mapping_db_add_full (mdb,
+					     mapping->device_id,
+					     mapping->profile_id,
+					     mapping->timestamp,
+					     error))
+			return FALSE;
+	}
+	return cd_mapping_db_flush (mdb, error);
+}
+
+/**
+ * cd_provision_apply:
+ * @filename: the provisioning keyfile, which need not exist
+ * @stamp_filename: where the checksum of the last applied file is kept
+ * @ddb: the device database
+ * @mdb: the mapping database
+ * @applied: (out) (optional): set to %TRUE if the databases were changed
+ * @error: a #GError, or %NULL
+ *
+ * Writes the devices and hard mappings listed in @filename straight into
+ * the databases in one batch, so that a fleet of machines can be set up
+ * without a client having to make a D-Bus call per device and profile.
+ * The devices are then created by the normal load of the device database.
+ *
+ * Devices that are already in the database get their listed properties
+ * updated. Applying a file that is unchanged since the last time does
+ * nothing.
+ **/
+gboolean
+cd_provision_apply (const gchar *filename,
+		    const gchar *stamp_filename,
+		    CdDeviceDb *ddb,
+		    CdMappingDb *mdb,
+		    gboolean *applied,
+		    GError **error)
+{
+	gsize len = 0;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *stamp = NULL;
+	g_autoptr(GKeyFile) keyfile = NULL;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp_filename != NULL, FALSE);
+
+	if (applied != NULL)
+		*applied = FALSE;
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+		return TRUE;
+	if (!g_file_get_contents (filename, &data, &len, error))
+		return FALSE;
+
+	/* already applied */
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+						(const guchar *) data, len);
+	if (g_file_get_contents (stamp_filename, &stamp, NULL, NULL) &&
+	    g_strcmp0 (g_strstrip (stamp), checksum) == 0) {
+		g_debug ("CdProvision: %s unchanged", filename);
+		return TRUE;
+	}
+
+	keyfile = g_key_file_new ();
+	if (!g_key_file_load_from_data (keyfile, data, len,
+					G_KEY_FILE_NONE, error))
+		return FALSE;
+
+	/* write everything in one transaction */
+	if (!cd_provision_write (keyfile, ddb, mdb, error)) {
+		cd_device_db_rollback (ddb);
+		cd_mapping_db_rollback (mdb);
+		return FALSE;
+	}
+
+	/* only record the file once it is all on disk */
+	if (!g_file_set_contents (stamp_filename, checksum, -1, error))
+		return FALSE;
+	g_debug ("CdProvision: applied %s", filename);
+	if (applied != NULL)
+		*applied = TRUE;
+	return TRUE;
+}
@@ -0,0 +1,38 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __CD_PROVISION_H__
+#define __CD_PROVISION_H__
+
+#include <glib.h>
+
+#include "cd-device-db.h"
+#include "cd-mapping-db.h"
+
+gboolean	 cd_provision_apply		(const gchar	*filename,
+						 const gchar	*stamp_filename,
+						 CdDeviceDb	*ddb,
+						 CdMappingDb	*mdb,
+						 gboolean	*applied,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
+
+#endif /* __CD_PROVISION_H__ */
@@ -33,10 +33,16 @@
 #include "cd-device-array.h"
 #include "cd-device-db.h"
 #include "cd-device.h"
+#include "cd-icc-private.h"
 #include "cd-mapping-db.h"
+#include "cd-memory-private.h"
+#include "cd-metrics.h"
 #include "cd-profile-array.h"
 #include "cd-profile-db.h"
 #include "cd-profile.h"
+#include "cd-provision.h"
+#include "cd-sensor-cache.h"
+#include "cd-state.h"
 
 static void
 colord_common_func (void)
@@ -59,6 +65,62 @@ colord_common_func (void)
 	g_free (tmp);
 }
 
+static void
+colord_string_pool_func (void)
+{
+	gchar *str1;
+	gchar *str2;
+
+	/* the same string is shared */
+	str1 = cd_string_pool_intern ("EDID_md5");
+	str2 = cd_string_pool_intern ("EDID_md5");
+	g_assert_cmpstr (str1, ==, "EDID_md5");
+	g_assert (str1 == str2);
+	cd_string_pool_release (str2);
+	cd_string_pool_release (str1);
+
+	/* NULL is passed through */
+	g_assert (cd_string_pool_intern (NULL) == NULL);
+	cd_string_pool_release (NULL);
+}
+
+static void
+colord_qualifier_func (void)
+{
+	GQuark profile[CD_QUALIFIER_ATOMS_MAX];
+	GQuark query[CD_QUALIFIER_ATOMS_MAX];
+
+	cd_qualifier_to_atoms ("RGB.Plain.300dpi", TRUE, profile);
+
+	/* exact match */
+	cd_qualifier_to_atoms ("RGB.Plain.300dpi", FALSE, query);
+	g_assert (cd_qualifier_atoms_match (query, profile));
+
+	/* wildcards in the query */
+	cd_qualifier_to_atoms ("RGB.*.300dpi", FALSE, query);
+	g_assert (cd_qualifier_atoms_match (query, profile));
+	cd_qualifier_to_atoms ("*.*.*", FALSE, query);
+	g_assert (cd_qualifier_atoms_match (query, profile));
+
+	/* a value no profile uses never matches */
+	cd_qualifier_to_atoms ("RGB.Plain.qualifier-nobody-uses", FALSE, query);
+	g_assert (!cd_qualifier_atoms_match (query, profile));
+
+	/* wildcards in the profile */
+	cd_qualifier_to_atoms ("RGB.*.*", TRUE, profile);
+	cd_qualifier_to_atoms ("RGB.Glossy.qualifier-nobody-uses", FALSE, query);
+	g_assert (cd_qualifier_atoms_match (query, profile));
+	cd_qualifier_to_atoms ("CMYK.Glossy.600dpi", FALSE, query);
+	g_assert (!cd_qualifier_atoms_match (query, profile));
+
+	/* blank parts only match blank parts */
+	cd_qualifier_to_atoms ("RGB..", TRUE, profile);
+	cd_qualifier_to_atoms ("RGB..", FALSE, query);
+	g_assert (cd_qualifier_atoms_match (query, profile));
+	cd_qualifier_to_atoms ("RGB.Plain.", FALSE, query);
+	g_assert (!cd_qualifier_atoms_match (query, profile));
+}
+
 static void
 colord_profile_func (void)
 {
@@ -171,6 +233,8 @@ colord_device_array_func (void)
 	CdDevice *device;
 	gboolean ret;
 	GError *error = NULL;
+	GVariant *value;
+	const gchar *object_path;
 	gchar *db_filename, *tmpdir;
 
 	/* create device database */
@@ -210,7 +274,41 @@ colord_device_array_func (void)
 						     "/org/freedesktop/ColorManager/devices/dave");
 	g_assert (device != NULL);
 	g_assert_cmpstr (cd_device_get_id (device), ==, "dave");
+	value = cd_device_array_get_variant (device_array, 0);
+	g_assert_cmpint (g_variant_n_children (value), ==, 1);
+	g_variant_get_child (value, 0, "&o", &object_path);
+	g_assert_cmpstr (object_path, ==, "/org/freedesktop/ColorManager/devices/dave");
+	g_variant_unref (value);
+
+	/* the lookups follow changes made after the device was added */
+	ret = cd_device_set_property_internal (device, "XRANDR_name", "LVDS1", FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cd_device_set_id (device, "dave2");
 	g_object_unref (device);
+	device = cd_device_array_get_by_property (device_array, "XRANDR_name", "LVDS1");
+	g_assert (device != NULL);
+	g_assert_cmpstr (cd_device_get_id (device), ==, "dave2");
+	g_object_unref (device);
+	device = cd_device_array_get_by_id_owner (device_array, "dave", 0, CD_DEVICE_ARRAY_FLAG_OWNER_OPTIONAL);
+	g_assert (device == NULL);
+	device = cd_device_array_get_by_object_path (device_array,
+						     "/org/freedesktop/ColorManager/devices/dave2");
+	g_assert (device != NULL);
+	value = cd_device_array_get_variant (device_array, 0);
+	g_assert_cmpint (g_variant_n_children (value), ==, 1);
+	g_variant_get_child (value, 0, "&o", &object_path);
+	g_assert_cmpstr (object_path, ==, "/org/freedesktop/ColorManager/devices/dave2");
+	g_variant_unref (value);
+
+	/* and removals */
+	cd_device_array_remove (device_array, device);
+	g_object_unref (device);
+	device = cd_device_array_get_by_property (device_array, "XRANDR_name", "LVDS1");
+	g_assert (device == NULL);
+	value = cd_device_array_get_variant (device_array, 0);
+	g_assert_cmpint (g_variant_n_children (value), ==, 0);
+	g_variant_unref (value);
 
 	g_remove (db_filename);
 	g_remove (tmpdir);
@@ -221,6 +319,113 @@ colord_device_array_func (void)
 	g_object_unref (ddb);
 }
 
+static CdProfile *
+colord_profile_array_index_load_cb (CdProfileArray *profile_array,
+				    const gchar *filename,
+				    gpointer user_data,
+				    GError **error)
+{
+	guint *cnt = (guint *) user_data;
+	g_autoptr(CdProfile) profile = cd_profile_new ();
+
+	(*cnt)++;
+	cd_profile_set_id (profile, "icc-deadbeef");
+	cd_profile_set_filename (profile, filename);
+	cd_profile_array_add (profile_array, profile);
+	return g_steal_pointer (&profile);
+}
+
+static void
+colord_profile_array_index_func (void)
+{
+	const gchar *object_path = "/org/freedesktop/ColorManager/profiles/icc_deadbeef";
+	gboolean found = FALSE;
+	gboolean ret;
+	guint cnt = 0;
+	GVariantIter iter;
+	const gchar *tmp;
+	g_autoptr(CdProfile) profile = NULL;
+	g_autoptr(CdProfileArray) profile_array = NULL;
+	g_autoptr(GHashTable) metadata = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	profile_array = cd_profile_array_new ();
+	cd_profile_array_set_load_func (profile_array,
+					colord_profile_array_index_load_cb,
+					&cnt);
+	cd_profile_array_set_max_loaded (profile_array, 1);
+
+	/* add to the index */
+	metadata = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_MAPPING_DEVICE_ID,
+			     (gpointer) "xrandr-deadbeef");
+	g_hash_table_insert (metadata,
+			     (gpointer) CD_PROFILE_METADATA_EDID_MD5,
+			     (gpointer) "f00f00f00f00f00f00f00f00f00f00f0");
+	ret = cd_profile_array_add_index (profile_array,
+					  "icc-deadbeef",
+					  "/tmp/deadbeef.icc",
+					  object_path,
+					  CD_PROFILE_KIND_DISPLAY_DEVICE,
+					  metadata);
+	g_assert (ret);
+	ret = cd_profile_array_add_index (profile_array,
+					  "icc-deadbeef",
+					  "/tmp/deadbeef.icc",
+					  object_path,
+					  CD_PROFILE_KIND_DISPLAY_DEVICE,
+					  metadata);
+	g_assert (!ret);
+
+	/* listed without being loaded */
+	value = cd_profile_array_get_variant (profile_array);
+	g_variant_iter_init (&iter, value);
+	while (g_variant_iter_next (&iter, "&o", &tmp)) {
+		if (g_strcmp0 (tmp, object_path) == 0)
+			found = TRUE;
+	}
+	g_assert (found);
+	g_assert_cmpint (cnt, ==, 0);
+
+	/* loaded when found by the indexed metadata */
+	profile = cd_profile_array_get_by_property (profile_array,
+						    CD_PROFILE_METADATA_MAPPING_DEVICE_ID,
+						    "xrandr-deadbeef");
+	g_assert (profile != NULL);
+	g_assert_cmpstr (cd_profile_get_filename (profile), ==, "/tmp/deadbeef.icc");
+	g_assert_cmpint (cnt, ==, 1);
+	g_clear_object (&profile);
+
+	/* but only once */
+	profile = cd_profile_array_get_by_filename (profile_array, "deadbeef.icc");
+	g_assert (profile != NULL);
+	g_assert_cmpint (cnt, ==, 1);
+	g_clear_object (&profile);
+	array = cd_profile_array_get_by_metadata (profile_array,
+						  CD_PROFILE_METADATA_EDID_MD5,
+						  "f00f00f00f00f00f00f00f00f00f00f0");
+	g_assert_cmpint (array->len, ==, 1);
+	g_assert_cmpint (cnt, ==, 1);
+	g_clear_pointer (&array, g_ptr_array_unref);
+
+	/* removing the file drops the loaded profile */
+	ret = cd_profile_array_remove_index (profile_array, "/tmp/deadbeef.icc");
+	g_assert (ret);
+	profile = cd_profile_array_get_by_filename (profile_array, "/tmp/deadbeef.icc");
+	g_assert (profile == NULL);
+	ret = cd_profile_array_remove_index (profile_array, "/tmp/deadbeef.icc");
+	g_assert (!ret);
+	array = cd_profile_array_get_by_metadata (profile_array,
+						  CD_PROFILE_METADATA_MAPPING_DEVICE_ID,
+						  "xrandr-deadbeef");
+	g_assert_cmpint (array->len, ==, 0);
+
+	cd_profile_array_set_load_func (profile_array, NULL, NULL);
+	cd_profile_array_set_max_loaded (profile_array, 0);
+}
+
 static void
 cd_mapping_db_alter_func (void)
 {
@@ -414,6 +619,107 @@ cd_mapping_db_func (void)
 	g_free (tmpdir);
 }
 
+static void
+cd_mapping_db_check_func (void)
+{
+	CdMappingDb *mdb;
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autofree gchar *db_filename = NULL;
+	g_autofree gchar *marker = NULL;
+	g_autofree gchar *tmpdir = NULL;
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	db_filename = g_strdup_printf ("%s/mapping.db", tmpdir);
+	marker = g_strdup_printf ("%s/mapping.db.clean", tmpdir);
+
+	/* a new file does not need checking */
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_mapping_db_get_read_only (mdb));
+	ret = cd_mapping_db_add (mdb, "device1", "profile1", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* an orderly close leaves the marker without waiting for finalize */
+	ret = cd_mapping_db_close (mdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (g_file_test (marker, G_FILE_TEST_EXISTS));
+	g_object_unref (mdb);
+
+	/* which is removed on open */
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_mapping_db_get_read_only (mdb));
+	g_assert (!g_file_test (marker, G_FILE_TEST_EXISTS));
+	g_object_unref (mdb);
+
+	/* without the marker the check runs in the background */
+	g_assert_cmpint (g_unlink (marker), ==, 0);
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (cd_mapping_db_get_read_only (mdb));
+	ret = cd_mapping_db_add (mdb, "device1", "profile2", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = cd_mapping_db_get_profiles (mdb, "device1", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 2);
+	g_clear_pointer (&array, g_ptr_array_unref);
+	while (cd_mapping_db_get_read_only (mdb))
+		g_main_context_iteration (NULL, TRUE);
+	g_object_unref (mdb);
+
+	/* the write made during the check was saved */
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = cd_mapping_db_get_profiles (mdb, "device1", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 2);
+	g_clear_pointer (&array, g_ptr_array_unref);
+	g_object_unref (mdb);
+
+	/* a damaged file is replaced */
+	g_assert_cmpint (g_unlink (marker), ==, 0);
+	ret = g_file_set_contents (db_filename, "not a database", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!cd_mapping_db_get_read_only (mdb));
+	array = cd_mapping_db_get_profiles (mdb, "device1", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 0);
+	g_object_unref (mdb);
+
+	g_remove (marker);
+	g_remove (db_filename);
+	g_remove (tmpdir);
+}
+
+static void
+cd_device_db_load_all_cb (const gchar *device_id,
+			  GHashTable *properties,
+			  gpointer user_data)
+{
+	GString *str = (GString *) user_data;
+	g_string_append_printf (str, "%s[%u];", device_id,
+				g_hash_table_size (properties));
+}
+
 static void
 cd_device_db_func (void)
 {
@@ -421,6 +727,7 @@ cd_device_db_func (void)
 	GError *error = NULL;
 	gboolean ret;
 	GPtrArray *array;
+	GString *str;
 	gchar *value;
 	gchar *db_filename, *tmpdir;
 
@@ -504,6 +811,14 @@ cd_device_db_func (void)
 	g_assert_cmpint (array->len, ==, 1);
 	g_ptr_array_unref (array);
 
+	/* load everything in one pass */
+	str = g_string_new (NULL);
+	ret = cd_device_db_load_all (ddb, cd_device_db_load_all_cb, str, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (str->str, ==, "device2[1];device3[0];");
+	g_string_free (str, TRUE);
+
 	/* remove devices */
 	ret = cd_device_db_remove (ddb, "device2", &error);
 	g_assert_no_error (error);
@@ -537,6 +852,70 @@ cd_device_db_func (void)
 	g_object_unref (ddb);
 }
 
+static gint
+cd_device_db_batch_count (const gchar *filename)
+{
+	gint cnt = -1;
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt = NULL;
+
+	/* a separate connection only sees committed writes */
+	g_assert_cmpint (sqlite3_open (filename, &db), ==, SQLITE_OK);
+	g_assert_cmpint (sqlite3_prepare_v2 (db, "SELECT COUNT(*) FROM devices;",
+					     -1, &stmt, NULL), ==, SQLITE_OK);
+	if (sqlite3_step (stmt) == SQLITE_ROW)
+		cnt = sqlite3_column_int (stmt, 0);
+	sqlite3_finalize (stmt);
+	sqlite3_close (db);
+	return cnt;
+}
+
+static void
+cd_device_db_batch_func (void)
+{
+	gboolean ret;
+	g_autofree gchar *db_filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(CdDeviceDb) ddb = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (tmpdir != NULL);
+	db_filename = g_build_filename (tmpdir, "device.db", NULL);
+	ddb = cd_device_db_new ();
+	ret = cd_device_db_load (ddb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* writes are visible on the same connection straight away */
+	ret = cd_device_db_add (ddb, "device1", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_device_db_add (ddb, "device2", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = cd_device_db_get_devices (ddb, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 2);
+
+	/* but only reach the file when the batch is committed */
+	g_assert_cmpint (cd_device_db_batch_count (db_filename), ==, 0);
+	ret = cd_device_db_flush (ddb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (cd_device_db_batch_count (db_filename), ==, 2);
+
+	/* nothing to commit */
+	ret = cd_device_db_flush (ddb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	g_remove (db_filename);
+	g_remove (tmpdir);
+}
+
 static void
 cd_profile_db_func (void)
 {
@@ -609,6 +988,42 @@ cd_profile_db_func (void)
 	g_assert (ret);
 	g_assert_cmpstr (value, ==, "My Display Profile");
 	g_free (value);
+	value = NULL;
+
+	/* values are read back from disk into the cache */
+	ret = cd_profile_db_flush (pdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (pdb);
+	pdb = cd_profile_db_new ();
+	ret = cd_profile_db_load (pdb, db_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_profile_db_get_property (pdb,
+					  "profile-test",
+					  "Title",
+					  500,
+					  &value,
+					  &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (value, ==, "My Display Profile");
+	g_free (value);
+	value = NULL;
+
+	/* removing the entry also removes it from the cache */
+	ret = cd_profile_db_remove (pdb, "profile-test", "Title", 500, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_profile_db_get_property (pdb,
+					  "profile-test",
+					  "Title",
+					  500,
+					  &value,
+					  &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpstr (value, ==, NULL);
 
 	g_remove (db_filename);
 	g_remove (tmpdir);
@@ -618,6 +1033,376 @@ cd_profile_db_func (void)
 	g_object_unref (pdb);
 }
 
+static void
+cd_memory_func (void)
+{
+	gsize size;
+	guint n_devices = cd_device_get_live_count ();
+	guint n_iccs = cd_icc_get_live_count ();
+	guint n_profiles = cd_profile_get_live_count ();
+	g_autoptr(CdDevice) device = NULL;
+	g_autoptr(CdIcc) icc = NULL;
+	g_autoptr(CdProfile) profile = NULL;
+	g_autoptr(GHashTable) hash = NULL;
+
+	/* two pointers and the strings, with the table overhead */
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	g_assert_cmpint (cd_memory_get_hash_table_size (hash), ==, 0);
+	g_hash_table_insert (hash, (gpointer) "key", (gpointer) "value");
+	g_assert_cmpint (cd_memory_get_hash_table_size (hash), ==,
+			 3 * sizeof (gpointer) + 4 + 6);
+
+	/* live objects are counted until they are finalized */
+	profile = cd_profile_new ();
+	device = cd_device_new ();
+	icc = cd_icc_new ();
+	g_assert_cmpint (cd_profile_get_live_count (), ==, n_profiles + 1);
+	g_assert_cmpint (cd_device_get_live_count (), ==, n_devices + 1);
+	g_assert_cmpint (cd_icc_get_live_count (), ==, n_iccs + 1);
+
+	/* the estimates grow with what the object holds */
+	size = cd_profile_get_memory_size (profile, NULL);
+	cd_profile_set_id (profile, "dave");
+	g_assert_cmpint (cd_profile_get_memory_size (profile, NULL), >=, size + 5);
+	size = cd_device_get_memory_size (device);
+	cd_device_set_id (device, "dave");
+	g_assert_cmpint (cd_device_get_memory_size (device), >, size);
+	g_assert_cmpint (cd_icc_get_memory_size (icc, NULL), >, 0);
+
+	g_clear_object (&profile);
+	g_clear_object (&device);
+	g_clear_object (&icc);
+	g_assert_cmpint (cd_profile_get_live_count (), ==, n_profiles);
+	g_assert_cmpint (cd_device_get_live_count (), ==, n_devices);
+	g_assert_cmpint (cd_icc_get_live_count (), ==, n_iccs);
+}
+
+static void
+cd_metrics_func (void)
+{
+	guint64 count = 0;
+	guint64 total = 0;
+	guint64 max = 0;
+	g_autoptr(GVariant) buckets = NULL;
+	g_autoptr(GVariant) metrics = NULL;
+	const guint64 *buckets_data;
+	gsize buckets_len;
+
+	cd_metrics_reset ();
+	cd_metrics_add_duration ("test.foo", 0);
+	cd_metrics_add_duration ("test.foo", 3);
+	cd_metrics_add_duration ("test.foo", 1000);
+
+	metrics = g_variant_ref_sink (cd_metrics_get_variant ());
+	g_assert_cmpint (g_variant_n_children (metrics), ==, 1);
+	g_assert (g_variant_lookup (metrics, "test.foo", "(ttt@at)",
+				    &count, &total, &max, &buckets));
+	g_assert_cmpint (count, ==, 3);
+	g_assert_cmpint (total, ==, 1003);
+	g_assert_cmpint (max, ==, 1000);
+
+	/* 0us, then 2..3us, then 512..1023us */
+	buckets_data = g_variant_get_fixed_array (buckets, &buckets_len, sizeof (guint64));
+	g_assert_cmpint (buckets_len, ==, CD_METRICS_BUCKETS);
+	g_assert_cmpint (buckets_data[0], ==, 1);
+	g_assert_cmpint (buckets_data[2], ==, 1);
+	g_assert_cmpint (buckets_data[10], ==, 1);
+	cd_metrics_reset ();
+}
+
+static void
+cd_sensor_cache_func (void)
+{
+	GKeyFile *keyfile;
+	gboolean ret;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GBytes) blob_tmp = NULL;
+	g_autoptr(GError) error = NULL;
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (tmpdir != NULL);
+	filename = g_build_filename (tmpdir, "sensors.ini", NULL);
+
+	/* a missing file is an empty cache */
+	cd_sensor_cache_reset ();
+	ret = cd_sensor_cache_load (filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_tmp = cd_sensor_cache_lookup ("huey-123", "Calibration");
+	g_assert (blob_tmp == NULL);
+
+	/* store, then reload from disk */
+	blob = g_bytes_new_static ("hello", 5);
+	ret = cd_sensor_cache_store ("huey-123", "Calibration", blob, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cd_sensor_cache_reset ();
+	ret = cd_sensor_cache_load (filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_tmp = cd_sensor_cache_lookup ("huey-123", "Calibration");
+	g_assert (blob_tmp != NULL);
+	g_assert (g_bytes_equal (blob, blob_tmp));
+	g_clear_pointer (&blob_tmp, g_bytes_unref);
+
+	/* a different serial number is not found */
+	blob_tmp = cd_sensor_cache_lookup ("huey-456", "Calibration");
+	g_assert (blob_tmp == NULL);
+
+	/* tamper with the data, which should not match the checksum */
+	keyfile = g_key_file_new ();
+	ret = g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_key_file_set_string (keyfile, "huey-123", "Calibration", "d29ybGQ=");
+	ret = g_key_file_save_to_file (keyfile, filename, &error);
+	g_key_file_unref (keyfile);
+	g_assert_no_error (error);
+	g_assert (ret);
+	cd_sensor_cache_reset ();
+	ret = cd_sensor_cache_load (filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_tmp = cd_sensor_cache_lookup ("huey-123", "Calibration");
+	g_assert (blob_tmp == NULL);
+
+	cd_sensor_cache_reset ();
+	g_remove (filename);
+	g_remove (tmpdir);
+}
+
+static void
+cd_provision_func (void)
+{
+	gboolean applied = FALSE;
+	gboolean ret;
+	guint64 ts1, ts2;
+	g_autofree gchar *ddb_filename = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *mdb_filename = NULL;
+	g_autofree gchar *stamp_filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autofree gchar *value = NULL;
+	g_autoptr(CdDeviceDb) ddb = NULL;
+	g_autoptr(CdMappingDb) mdb = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (tmpdir != NULL);
+	filename = g_build_filename (tmpdir, "provision.conf", NULL);
+	stamp_filename = g_build_filename (tmpdir, "provision.sha256", NULL);
+	ddb_filename = g_build_filename (tmpdir, "storage.db", NULL);
+	mdb_filename = g_build_filename (tmpdir, "mapping.db", NULL);
+	ddb = cd_device_db_new ();
+	ret = cd_device_db_load (ddb, ddb_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	mdb = cd_mapping_db_new ();
+	ret = cd_mapping_db_load (mdb, mdb_filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* a missing file is nothing to do */
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!applied);
+
+	ret = g_file_set_contents (filename,
+				   "[Device xrandr-Dell-U2415]\n"
+				   "Kind=display\n"
+				   "Model=U2415\n"
+				   "Profiles=icc-first;icc-second;\n",
+				   -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (applied);
+
+	/* device properties */
+	value = cd_device_db_get_property (ddb, "xrandr-Dell-U2415", "Model", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (value, ==, "U2415");
+
+	/* the first profile listed is the newest */
+	array = cd_mapping_db_get_profiles (mdb, "xrandr-Dell-U2415", &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 2);
+	ts1 = cd_mapping_db_get_timestamp (mdb, "xrandr-Dell-U2415", "icc-first", &error);
+	g_assert_no_error (error);
+	ts2 = cd_mapping_db_get_timestamp (mdb, "xrandr-Dell-U2415", "icc-second", &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (ts1, >, ts2);
+
+	/* a changed file is applied again while the device is still stored */
+	ret = g_file_set_contents (filename,
+				   "[Device xrandr-Dell-U2415]\n"
+				   "Kind=display\n"
+				   "Model=U2415b\n"
+				   "Profiles=icc-first;icc-second;\n"
+				   "[Device xrandr-Dell-U2715]\n"
+				   "Kind=display\n",
+				   -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (applied);
+	g_free (value);
+	value = cd_device_db_get_property (ddb, "xrandr-Dell-U2415", "Model", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (value, ==, "U2415b");
+	ret = cd_device_db_remove (ddb, "xrandr-Dell-U2715", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* an unchanged file is not applied again, even if the db changed */
+	ret = cd_device_db_remove (ddb, "xrandr-Dell-U2415", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!applied);
+	g_ptr_array_unref (array);
+	array = cd_device_db_get_devices (ddb, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 0);
+
+	/* a group without a device ID is an error */
+	ret = g_file_set_contents (filename, "[Device ]\nKind=display\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_error (error, CD_CLIENT_ERROR, CD_CLIENT_ERROR_INPUT_INVALID);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* and nothing written before the error is kept */
+	ret = g_file_set_contents (filename,
+				   "[Device xrandr-Dell-U2415]\n"
+				   "Kind=display\n"
+				   "Profiles=icc-third;\n"
+				   "[Device ]\n"
+				   "Kind=display\n",
+				   -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_provision_apply (filename, stamp_filename, ddb, mdb,
+				  &applied, &error);
+	g_assert_error (error, CD_CLIENT_ERROR, CD_CLIENT_ERROR_INPUT_INVALID);
+	g_assert (!ret);
+	g_clear_error (&error);
+	ret = cd_device_db_flush (ddb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_ptr_array_unref (array);
+	array = cd_device_db_get_devices (ddb, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (array->len, ==, 0);
+	ts1 = cd_mapping_db_get_timestamp (mdb, "xrandr-Dell-U2415", "icc-third", NULL);
+	g_assert_cmpint (ts1, ==, G_MAXUINT64);
+
+	g_remove (filename);
+	g_remove (stamp_filename);
+	g_remove (ddb_filename);
+	g_remove (mdb_filename);
+	g_remove (tmpdir);
+}
+
+static void
+cd_state_func (void)
+{
+	CdDevice *device_tmp;
+	gboolean ret;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(CdDevice) device = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) devices_new = NULL;
+	g_autoptr(GVariant) state = NULL;
+	g_autoptr(GVariant) state_new = NULL;
+
+	tmpdir = g_dir_make_tmp ("colord-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert (tmpdir != NULL);
+	filename = g_build_filename (tmpdir, "state.gvariant", NULL);
+
+	/* a device like the camera plugin would add */
+	device = cd_device_new ();
+	cd_device_set_id (device, "camera-dave");
+	ret = cd_device_set_property_internal (device, CD_DEVICE_PROPERTY_KIND,
+					       "camera", FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_device_set_property_internal (device, CD_DEVICE_PROPERTY_MODEL,
+					       "Dave 2000", FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_device_set_property_internal (device, CD_DEVICE_PROPERTY_EMBEDDED,
+					       NULL, FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = cd_device_set_property_internal (device, "XRANDR_name",
+					       "LVDS1", FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	devices = g_ptr_array_new ();
+	g_ptr_array_add (devices, device);
+	ret = cd_state_save (filename, devices, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the boot ID is not available in all build environments */
+	if (!g_file_test ("/proc/sys/kernel/random/boot_id", G_FILE_TEST_EXISTS)) {
+		g_remove (filename);
+		g_remove (tmpdir);
+		g_test_skip ("no boot ID");
+		return;
+	}
+
+	/* load it back */
+	devices_new = cd_state_load (filename, &error);
+	g_assert_no_error (error);
+	g_assert (devices_new != NULL);
+	g_assert_cmpint (devices_new->len, ==, 1);
+	device_tmp = g_ptr_array_index (devices_new, 0);
+	g_assert_cmpstr (cd_device_get_id (device_tmp), ==, "camera-dave");
+	g_assert_cmpint (cd_device_get_kind (device_tmp), ==, CD_DEVICE_KIND_CAMERA);
+	g_assert_cmpstr (cd_device_get_model (device_tmp), ==, "Dave 2000");
+	g_assert_cmpstr (cd_device_get_metadata (device_tmp, "XRANDR_name"), ==, "LVDS1");
+	state = g_variant_ref_sink (cd_device_get_state (device));
+	state_new = g_variant_ref_sink (cd_device_get_state (device_tmp));
+	g_assert_cmpint (g_variant_get_size (state_new), ==, g_variant_get_size (state));
+
+	/* a file that is not a snapshot is rejected */
+	ret = g_file_set_contents (filename, "hello", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_pointer (&devices_new, g_ptr_array_unref);
+	devices_new = cd_state_load (filename, &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (devices_new == NULL);
+
+	g_remove (filename);
+	g_remove (tmpdir);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -628,14 +1413,24 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/colord/common", colord_common_func);
+	g_test_add_func ("/colord/qualifier", colord_qualifier_func);
+	g_test_add_func ("/colord/string-pool", colord_string_pool_func);
 	g_test_add_func ("/colord/mapping-db{alter}", cd_mapping_db_alter_func);
 	g_test_add_func ("/colord/mapping-db{convert}", cd_mapping_db_convert_func);
 	g_test_add_func ("/colord/mapping-db", cd_mapping_db_func);
+	g_test_add_func ("/colord/mapping-db{check}", cd_mapping_db_check_func);
 	g_test_add_func ("/colord/device-db", cd_device_db_func);
+	g_test_add_func ("/colord/device-db{batch}", cd_device_db_batch_func);
 	g_test_add_func ("/colord/profile", colord_profile_func);
 	g_test_add_func ("/colord/profile-db", cd_profile_db_func);
 	g_test_add_func ("/colord/device", colord_device_func);
 	g_test_add_func ("/colord/device-array", colord_device_array_func);
+	g_test_add_func ("/colord/profile-array{index}", colord_profile_array_index_func);
+	g_test_add_func ("/colord/memory", cd_memory_func);
+	g_test_add_func ("/colord/metrics", cd_metrics_func);
+	g_test_add_func ("/colord/sensor-cache", cd_sensor_cache_func);
+	g_test_add_func ("/colord/provision", cd_provision_func);
+	g_test_add_func ("/colord/state", cd_state_func);
 	return g_test_run ();
 }
 
@@ -0,0 +1,147 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "cd-sensor-cache.h"
+
+/* calibration data keyed by "<kind>-<serial>", shared with the lock threads */
+G_LOCK_DEFINE_STATIC (cd_sensor_cache);
+static GKeyFile *cd_sensor_cache_keyfile = NULL;
+static gchar *cd_sensor_cache_filename = NULL;
+
+static GKeyFile *
+cd_sensor_cache_get_keyfile (void)
+{
+	if (cd_sensor_cache_keyfile == NULL)
+		cd_sensor_cache_keyfile = g_key_file_new ();
+	return cd_sensor_cache_keyfile;
+}
+
+/* loads the cache, where a missing file is not an error */
+gboolean
+cd_sensor_cache_load (const gchar *filename, GError **error)
+{
+	gboolean ret = TRUE;
+	GKeyFile *keyfile;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	G_LOCK (cd_sensor_cache);
+	keyfile = cd_sensor_cache_get_keyfile ();
+	g_free (cd_sensor_cache_filename);
+	cd_sensor_cache_filename = g_strdup (filename);
+	if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+		ret = g_key_file_load_from_file (keyfile, filename,
+						 G_KEY_FILE_NONE, error);
+	}
+	G_UNLOCK (cd_sensor_cache);
+	return ret;
+}
+
+static gchar *
+cd_sensor_cache_get_checksum_key (const gchar *key)
+{
+	return g_strdup_printf ("%s-Checksum", key);
+}
+
+/* returns NULL if the entry is missing or no longer matches its checksum */
+GBytes *
+cd_sensor_cache_lookup (const gchar *id, const gchar *key)
+{
+	GKeyFile *keyfile;
+	gsize len = 0;
+	guchar *data = NULL;
+	GBytes *blob = NULL;
+	g_autofree gchar *checksum_key = NULL;
+	g_autofree gchar *checksum_actual = NULL;
+	g_autofree gchar *checksum_expected = NULL;
+	g_autofree gchar *encoded = NULL;
+
+	g_return_val_if_fail (id != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	G_LOCK (cd_sensor_cache);
+	keyfile = cd_sensor_cache_get_keyfile ();
+	checksum_key = cd_sensor_cache_get_checksum_key (key);
+	encoded = g_key_file_get_string (keyfile, id, key, NULL);
+	if (encoded == NULL)
+		goto out;
+	checksum_expected = g_key_file_get_string (keyfile, id, checksum_key, NULL);
+	data = g_base64_decode (encoded, &len);
+	checksum_actual = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, len);
+	if (g_strcmp0 (checksum_actual, checksum_expected) != 0) {
+		g_debug ("cached %s for %s is corrupt, ignoring", key, id);
+		g_key_file_remove_key (keyfile, id, key, NULL);
+		g_key_file_remove_key (keyfile, id, checksum_key, NULL);
+		g_free (data);
+		goto out;
+	}
+	blob = g_bytes_new_take (data, len);
+out:
+	G_UNLOCK (cd_sensor_cache);
+	return blob;
+}
+
+/* adds or replaces an entry, saving the cache if it was loaded from disk */
+gboolean
+cd_sensor_cache_store (const gchar *id,
+		       const gchar *key,
+		       GBytes *blob,
+		       GError **error)
+{
+	GKeyFile *keyfile;
+	const guint8 *data;
+	gboolean ret = TRUE;
+	gsize len = 0;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *checksum_key = NULL;
+	g_autofree gchar *encoded = NULL;
+
+	g_return_val_if_fail (id != NULL, FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (blob != NULL, FALSE);
+
+	data = g_bytes_get_data (blob, &len);
+	encoded = g_base64_encode (data, len);
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, len);
+	checksum_key = cd_sensor_cache_get_checksum_key (key);
+
+	G_LOCK (cd_sensor_cache);
+	keyfile = cd_sensor_cache_get_keyfile ();
+	g_key_file_set_string (keyfile, id, key, encoded);
+	g_key_file_set_string (keyfile, id, checksum_key, checksum);
+	if (cd_sensor_cache_filename != NULL)
+		ret = g_key_file_save_to_file (keyfile, cd_sensor_cache_filename, error);
+	G_UNLOCK (cd_sensor_cache);
+	return ret;
+}
+
+void
+cd_sensor_cache_reset (void)
+{
+	G_LOCK (cd_sensor_cache);
+	g_clear_pointer (&cd_sensor_cache_keyfile, g_key_file_unref);
+	g_clear_pointer (&cd_sensor_cache_filename, g_free);
+	G_UNLOCK (cd_sensor_cache);
+}
@@ -32,13 +32,22 @@ static void     cd_sensor_client_finalize	(GObject	*object);
 
 #define GET_PRIVATE(o) (cd_sensor_client_get_instance_private (o))
 
+/* a backend that takes longer than this to coldplug is ignored */
+#define CD_SENSOR_CLIENT_LOAD_TIMEOUT	10 /* s */
+
 typedef struct
 {
 	GUdevClient			*gudev_client;
 	GPtrArray			*array_sensors;
+	GPtrArray			*array_pending;	/* of GTask */
 	guint				 idx;
 } CdSensorClientPrivate;
 
+typedef struct {
+	CdSensor			*sensor;
+	guint				 timeout_id;
+} CdSensorClientLoadHelper;
+
 enum {
 	SIGNAL_SENSOR_ADDED,
 	SIGNAL_SENSOR_REMOVED,
@@ -68,65 +77,133 @@ cd_sensor_client_get_by_id (CdSensorClient *sensor_client,
 	return sensor;
 }
 
+static void
+cd_sensor_client_load_helper_free (CdSensorClientLoadHelper *helper)
+{
+	g_object_unref (helper->sensor);
+	g_free (helper);
+}
+
+/* loading the module and the backend coldplug can both block */
+static void
+cd_sensor_client_load_thread_cb (GTask *task,
+				 gpointer source_object,
+				 gpointer task_data,
+				 GCancellable *cancellable)
+{
+	CdSensorClientLoadHelper *helper = (CdSensorClientLoadHelper *) task_data;
+	g_autoptr(GError) error = NULL;
+
+	if (!cd_sensor_load (helper->sensor, &error)) {
+		/* not fatal, non-native devices are still usable */
+		g_debug ("CdSensorClient: failed to load native sensor: %s",
+			 error->message);
+	}
+	g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+cd_sensor_client_load_timeout_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	CdSensorClientLoadHelper *helper = g_task_get_task_data (task);
+
+	g_warning ("CdSensorClient: %s took more than %us to load, ignoring",
+		   cd_sensor_get_device_path (helper->sensor),
+		   (guint) CD_SENSOR_CLIENT_LOAD_TIMEOUT);
+	helper->timeout_id = 0;
+	g_cancellable_cancel (g_task_get_cancellable (task));
+	return G_SOURCE_REMOVE;
+}
+
+static void
+cd_sensor_client_load_cb (GObject *source_object,
+			  GAsyncResult *res,
+			  gpointer user_data)
+{
+	CdSensorClient *sensor_client = CD_SENSOR_CLIENT (source_object);
+	CdSensorClientPrivate *priv = GET_PRIVATE (sensor_client);
+	CdSensorClientLoadHelper *helper = g_task_get_task_data (G_TASK (res));
+	g_autoptr(CdSensor) sensor = g_object_ref (helper->sensor);
+	g_autoptr(GError) error = NULL;
+
+	if (helper->timeout_id != 0) {
+		g_source_remove (helper->timeout_id);
+		helper->timeout_id = 0;
+	}
+	g_ptr_array_remove (priv->array_pending, res);
+
+	/* timed out, or removed before it finished loading */
+	if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+		g_debug ("CdSensorClient: not adding %s: %s",
+			 cd_sensor_get_device_path (sensor),
+			 error->message);
+		return;
+	}
+
+	/* signal the addition */
+	g_debug ("emit: added");
+	g_signal_emit (sensor_client, signals[SIGNAL_SENSOR_ADDED], 0, sensor);
+
+	/* keep track so we can remove with the same device */
+	g_ptr_array_add (priv->array_sensors, g_object_ref (sensor));
+}
+
 static gboolean
 cd_sensor_client_add (CdSensorClient *sensor_client,
 		      GUdevDevice *device)
 {
 	CdSensorClientPrivate *priv = GET_PRIVATE (sensor_client);
-	CdSensor *sensor = NULL;
+	CdSensorClientLoadHelper *helper;
 	const gchar *device_file;
 	const gchar *tmp;
-	gboolean ret = FALSE;
+	g_autoptr(CdSensor) sensor = NULL;
+	g_autoptr(GCancellable) cancellable = NULL;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GTask) task = NULL;
 
 	/* interesting device? */
 	tmp = g_udev_device_get_property (device, "COLORD_SENSOR_KIND");
 	if (tmp == NULL)
-		goto out;
+		return FALSE;
 	tmp = g_udev_device_get_property (device, "COLORD_IGNORE");
 	if (tmp != NULL)
-		goto out;
+		return FALSE;
 
 	/* actual device? */
 	device_file = g_udev_device_get_device_file (device);
 	if (device_file == NULL)
-		goto out;
+		return FALSE;
 
 	/* get data */
 	g_debug ("adding color management device: %s [%s]",
 		 g_udev_device_get_sysfs_path (device),
 		 device_file);
 	sensor = cd_sensor_new ();
-	ret = cd_sensor_set_from_device (sensor, device, &error);
-	if (!ret) {
+	if (!cd_sensor_set_from_device (sensor, device, &error)) {
 		g_warning ("CdSensorClient: failed to set CM sensor: %s",
 			   error->message);
-		goto out;
+		return FALSE;
 	}
 
 	/* set the index */
-	cd_sensor_set_index (sensor, priv->idx);
-
-	/* load the sensor */
-	ret = cd_sensor_load (sensor, &error);
-	if (!ret) {
-		/* not fatal, non-native devices are still usable */
-		g_debug ("CdSensorClient: failed to load native sensor: %s",
-			 error->message);
-		g_clear_error (&error);
-	}
-
-	/* signal the addition */
-	g_debug ("emit: added");
-	g_signal_emit (sensor_client, signals[SIGNAL_SENSOR_ADDED], 0, sensor);
-	priv->idx++;
-
-	/* keep track so we can remove with the same device */
-	g_ptr_array_add (priv->array_sensors, g_object_ref (sensor));
-out:
-	if (sensor != NULL)
-		g_object_unref (sensor);
-	return ret;
+	cd_sensor_set_index (sensor, priv->idx++);
+
+	/* load the sensor without blocking the daemon */
+	helper = g_new0 (CdSensorClientLoadHelper, 1);
+	helper->sensor = g_object_ref (sensor);
+	cancellable = g_cancellable_new ();
+	task = g_task_new (sensor_client, cancellable,
+			   cd_sensor_client_load_cb, NULL);
+	g_task_set_task_data (task, helper,
+			      (GDestroyNotify) cd_sensor_client_load_helper_free);
+	g_task_set_return_on_cancel (task, TRUE);
+	helper->timeout_id = g_timeout_add_seconds (CD_SENSOR_CLIENT_LOAD_TIMEOUT,
+						    cd_sensor_client_load_timeout_cb,
+						    task);
+	g_ptr_array_add (priv->array_pending, g_object_ref (task));
+	g_task_run_in_thread (task, cd_sensor_client_load_thread_cb);
+	return TRUE;
 }
 
 static void
@@ -148,6 +225,14 @@ cd_sensor_client_remove (CdSensorClient *sensor_client,
 	device_path = g_udev_device_get_sysfs_path (device);
 	g_debug ("removing color management device: %s [%s]",
 		 device_path, device_file);
+	for (i = 0; i < priv->array_pending->len; i++) {
+		GTask *task = g_ptr_array_index (priv->array_pending, i);
+		CdSensorClientLoadHelper *helper = g_task_get_task_data (task);
+		if (g_strcmp0 (cd_sensor_get_device_path (helper->sensor), device_path) == 0) {
+			g_cancellable_cancel (g_task_get_cancellable (task));
+			goto out;
+		}
+	}
 	for (i = 0; i < priv->array_sensors->len; i++) {
 		sensor = g_ptr_array_index (priv->array_sensors, i);
 		if (g_strcmp0 (cd_sensor_get_device_path (sensor), device_path) == 0) {
@@ -238,6 +323,7 @@ cd_sensor_client_init (CdSensorClient *sensor_client)
 	CdSensorClientPrivate *priv = GET_PRIVATE (sensor_client);
 	const gchar *subsystems[] = {"usb", "video4linux", NULL};
 	priv->array_sensors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	priv->array_pending = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	priv->gudev_client = g_udev_client_new (subsystems);
 	g_signal_connect (priv->gudev_client, "uevent",
 			  G_CALLBACK (cd_sensor_client_uevent_cb), sensor_client);
@@ -251,6 +337,7 @@ cd_sensor_client_finalize (GObject *object)
 
 	g_object_unref (priv->gudev_client);
 	g_ptr_array_unref (priv->array_sensors);
+	g_ptr_array_unref (priv->array_pending);
 
 	G_OBJECT_CLASS (cd_sensor_client_parent_class)->finalize (object);
 }
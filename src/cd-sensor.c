@@ -25,10 +25,14 @@
 #include <gio/gio.h>
 #include <sys/time.h>
 #include <gmodule.h>
+#include <string.h>
 #include <colord-private.h>
 
 #include "cd-common.h"
+#include "cd-metrics.h"
 #include "cd-sensor.h"
+#include "cd-sensor-cache.h"
+#include "cd-trace-private.h"
 
 static void cd_sensor_finalize			 (GObject *object);
 
@@ -104,8 +108,24 @@ typedef struct
 	GHashTable			*options;
 	GHashTable			*metadata;
 	GUsbContext			*usb_ctx;
+	gint64				 sample_start;
+	gchar				*stream_sender;
+	CdSensorCap			 stream_cap;
+	guint				 stream_interval;	/* ms */
+	guint				 stream_id;
+	gboolean			 stream_pending;
+	GPtrArray			*members;	/* of CdSensor, for groups */
+	GArray				*corrections;	/* of CdMat3x3, per member */
+	CdSensor			*group;		/* not ref'd */
+	guint				 owner_watcher_id;
+	gpointer			 batch;		/* CdSensorBatchHelper, or %NULL */
 } CdSensorPrivate;
 
+enum {
+	SIGNAL_INVALIDATE,
+	SIGNAL_LAST
+};
+
 enum {
 	PROP_0,
 	PROP_OBJECT_PATH,
@@ -122,6 +142,8 @@ enum {
 	PROP_LAST
 };
 
+static guint signals[SIGNAL_LAST] = { 0 };
+
 G_DEFINE_TYPE_WITH_PRIVATE (CdSensor, cd_sensor, G_TYPE_OBJECT)
 
 GQuark
@@ -249,6 +271,57 @@ cd_sensor_set_serial (CdSensor *sensor, const gchar *serial)
 					      g_variant_new_string (serial));
 }
 
+static gchar *
+cd_sensor_get_cache_id (CdSensor *sensor)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	if (priv->serial == NULL)
+		return NULL;
+	return g_strdup_printf ("%s-%s",
+				cd_sensor_kind_to_string (priv->kind),
+				priv->serial);
+}
+
+/**
+ * cd_sensor_get_cached_data:
+ * @sensor: a valid #CdSensor instance
+ * @key: the cache key, e.g. "Calibration"
+ *
+ * Gets data previously saved for this physical device, which is
+ * identified by the sensor kind and the serial number.
+ *
+ * Return value: (transfer full): the data, or %NULL if not cached
+ **/
+GBytes *
+cd_sensor_get_cached_data (CdSensor *sensor, const gchar *key)
+{
+	g_autofree gchar *id = cd_sensor_get_cache_id (sensor);
+	if (id == NULL)
+		return NULL;
+	return cd_sensor_cache_lookup (id, key);
+}
+
+/**
+ * cd_sensor_set_cached_data:
+ * @sensor: a valid #CdSensor instance
+ * @key: the cache key, e.g. "Calibration"
+ * @data: the data to save
+ *
+ * Saves data for this physical device so that it does not have to be
+ * read from the hardware again the next time the sensor is locked.
+ * The serial number has to be set before calling this.
+ **/
+void
+cd_sensor_set_cached_data (CdSensor *sensor, const gchar *key, GBytes *data)
+{
+	g_autofree gchar *id = cd_sensor_get_cache_id (sensor);
+	g_autoptr(GError) error = NULL;
+	if (id == NULL)
+		return;
+	if (!cd_sensor_cache_store (id, key, data, &error))
+		g_warning ("failed to save sensor cache: %s", error->message);
+}
+
 /**
  * cd_sensor_set_kind:
  * @sensor: a valid #CdSensor instance
@@ -440,6 +513,13 @@ cd_sensor_set_state (CdSensor *sensor, CdSensorState state)
 		priv->set_state_id = 0;
 	}
 
+	if (priv->state == state)
+		return;
+
+	/* backends go back to idle after each sample, but the sensor stays
+	 * measuring until the stream has been stopped */
+	if (state == CD_SENSOR_STATE_IDLE && priv->stream_sender != NULL)
+		return;
 	priv->state = state;
 	cd_sensor_dbus_emit_property_changed (sensor,
 					      "State",
@@ -566,6 +646,8 @@ cd_sensor_get_sample_cb (GObject *source_object,
 
 	/* get the result */
 	sample = priv->desc->get_sample_finish (sensor, res, &error);
+	CD_TRACE2 (sensor_sample_end, priv->id, sample != NULL);
+	cd_metrics_add ("sensor.get-sample", priv->sample_start);
 	if (sample == NULL) {
 		g_dbus_method_invocation_return_gerror (invocation, error);
 		return;
@@ -577,6 +659,29 @@ cd_sensor_get_sample_cb (GObject *source_object,
 	g_dbus_method_invocation_return_value (invocation, result);
 }
 
+/* the observer is only loaded the first time it is needed, and then kept
+ * for all sensors so that each reading is just three dot products */
+static const CdIt8UtilsPlan *
+cd_sensor_get_xyz_plan (GError **error)
+{
+	static CdIt8UtilsPlan *plan = NULL;
+	g_autoptr(CdIt8) cmf = NULL;
+	g_autoptr(CdSpectrum) unity = NULL;
+	g_autoptr(GFile) file = NULL;
+
+	if (plan != NULL)
+		return plan;
+	cmf = cd_it8_new ();
+	file = g_file_new_for_path (DATADIR "/colord/cmf/CIE1931-2deg-XYZ.cmf");
+	if (!cd_it8_load_from_file (cmf, file, error))
+		return NULL;
+
+	/* an empty spectrum is 1.0 everywhere, so the sample is the source */
+	unity = cd_spectrum_new ();
+	plan = cd_it8_utils_plan_new (cmf, unity, 1.f, error);
+	return plan;
+}
+
 static void
 cd_sensor_get_spectrum_cb (GObject *source_object,
 			   GAsyncResult *res,
@@ -585,8 +690,10 @@ cd_sensor_get_spectrum_cb (GObject *source_object,
 	CdSensor *sensor = CD_SENSOR (source_object);
 	CdSensorPrivate *priv = GET_PRIVATE (sensor);
 	GDBusMethodInvocation *invocation = (GDBusMethodInvocation *) user_data;
+	GArray *raw;
+	GVariant *data;
 	GVariant *result = NULL;
-	GVariantBuilder data;
+	gdouble *values;
 	guint i;
 	g_autoptr(CdSpectrum) sp = NULL;
 	g_autoptr(GError) error = NULL;
@@ -596,16 +703,27 @@ cd_sensor_get_spectrum_cb (GObject *source_object,
 
 	/* get the result */
 	sp = priv->desc->get_spectrum_finish (sensor, res, &error);
+	cd_metrics_add ("sensor.get-spectrum", priv->sample_start);
 	if (sp == NULL) {
 		g_dbus_method_invocation_return_gerror (invocation, error);
 		return;
 	}
 
-	/* build data array */
-	g_variant_builder_init (&data, G_VARIANT_TYPE ("ad"));
-	for (i = 0; i < cd_spectrum_get_size (sp); i++) {
-		g_variant_builder_add (&data, "d",
-				       cd_spectrum_get_value (sp, i));
+	/* build data array as one block, only copying when it has to be
+	 * normalized as the wire format has no separate norm value */
+	raw = cd_spectrum_get_data (sp);
+	if (cd_spectrum_get_norm (sp) == 1.f) {
+		data = g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+						  raw->data, raw->len,
+						  sizeof (gdouble));
+	} else {
+		values = g_new (gdouble, raw->len);
+		for (i = 0; i < raw->len; i++)
+			values[i] = cd_spectrum_get_value (sp, i);
+		data = g_variant_new_from_data (G_VARIANT_TYPE ("ad"),
+						values,
+						raw->len * sizeof (gdouble),
+						TRUE, g_free, values);
 	}
 
 	/* return value */
@@ -613,10 +731,26 @@ cd_sensor_get_spectrum_cb (GObject *source_object,
 		 cd_spectrum_get_start (sp),
 		 cd_spectrum_get_end (sp),
 		 cd_spectrum_get_size (sp));
-	result = g_variant_new ("(ddad)",
-				cd_spectrum_get_start (sp),
-				cd_spectrum_get_end (sp),
-				&data);
+	if (g_strcmp0 (g_dbus_method_invocation_get_method_name (invocation),
+		       "GetSpectrumSample") == 0) {
+		CdColorXYZ xyz;
+		const CdIt8UtilsPlan *plan = cd_sensor_get_xyz_plan (NULL);
+
+		/* checked before the reading was taken */
+		g_assert (plan != NULL);
+		cd_it8_utils_plan_calculate_xyz (plan, sp, &xyz);
+		g_debug ("returning XYZ %f, %f, %f", xyz.X, xyz.Y, xyz.Z);
+		result = g_variant_new ("(dd@adddd)",
+					cd_spectrum_get_start (sp),
+					cd_spectrum_get_end (sp),
+					data,
+					xyz.X, xyz.Y, xyz.Z);
+	} else {
+		result = g_variant_new ("(dd@ad)",
+					cd_spectrum_get_start (sp),
+					cd_spectrum_get_end (sp),
+					data);
+	}
 	g_dbus_method_invocation_return_value (invocation, result);
 }
 
@@ -656,6 +790,7 @@ cd_sensor_lock_cb (GObject *source_object,
 
 	/* get the result */
 	ret = priv->desc->lock_finish (sensor, res, &error);
+	CD_TRACE2 (sensor_lock_end, priv->id, ret);
 	if (!ret) {
 		g_dbus_method_invocation_return_error (invocation,
 						       CD_SENSOR_ERROR,
@@ -739,6 +874,667 @@ cd_sensor_unlock_quietly_cb (GObject *source_object,
 	cd_sensor_set_locked (sensor, FALSE);
 }
 
+static gboolean cd_sensor_stream_sample_cb (gpointer user_data);
+
+static void
+cd_sensor_stream_stop (CdSensor *sensor, const gchar *reason)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+
+	if (priv->stream_sender == NULL)
+		return;
+	if (priv->stream_id != 0) {
+		g_source_remove (priv->stream_id);
+		priv->stream_id = 0;
+	}
+
+	/* emit signal */
+	g_debug ("CdSensor: emit StreamStopped(%s) on %s",
+		 reason, priv->object_path);
+	if (priv->connection != NULL) {
+		g_dbus_connection_emit_signal (priv->connection,
+					       priv->stream_sender,
+					       priv->object_path,
+					       COLORD_DBUS_INTERFACE_SENSOR,
+					       "StreamStopped",
+					       g_variant_new ("(s)", reason),
+					       NULL);
+	}
+	g_clear_pointer (&priv->stream_sender, g_free);
+
+	/* any sample in flight sets this when it completes */
+	if (!priv->stream_pending)
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+}
+
+static void
+cd_sensor_stream_sample_done_cb (GObject *source_object,
+				 GAsyncResult *res,
+				 gpointer user_data)
+{
+	CdSensor *sensor = CD_SENSOR (source_object);
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_autoptr(CdColorXYZ) sample = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* get the result */
+	priv->stream_pending = FALSE;
+	sample = priv->desc->get_sample_finish (sensor, res, &error);
+	CD_TRACE2 (sensor_sample_end, priv->id, sample != NULL);
+	cd_metrics_add ("sensor.get-sample", priv->sample_start);
+
+	/* stopped while the sample was being taken */
+	if (priv->stream_sender == NULL) {
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+		return;
+	}
+	if (sample == NULL) {
+		cd_sensor_stream_stop (sensor, error->message);
+		return;
+	}
+
+	/* only the client that started the stream gets the samples */
+	if (priv->connection != NULL) {
+		g_dbus_connection_emit_signal (priv->connection,
+					       priv->stream_sender,
+					       priv->object_path,
+					       COLORD_DBUS_INTERFACE_SENSOR,
+					       "Sample",
+					       g_variant_new ("(ddd)",
+							      sample->X,
+							      sample->Y,
+							      sample->Z),
+					       NULL);
+	}
+
+	/* the sensor stays in the measuring state between samples */
+	priv->stream_id = g_timeout_add (priv->stream_interval,
+					 cd_sensor_stream_sample_cb,
+					 sensor);
+	g_source_set_name_by_id (priv->stream_id, "[CdSensor] stream");
+}
+
+static gboolean
+cd_sensor_stream_sample_cb (gpointer user_data)
+{
+	CdSensor *sensor = CD_SENSOR (user_data);
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+
+	/* the same check GetSample does for each sample */
+	priv->stream_id = 0;
+	if (!priv->locked) {
+		cd_sensor_stream_stop (sensor, "sensor is not yet locked");
+		return G_SOURCE_REMOVE;
+	}
+	priv->stream_pending = TRUE;
+	priv->sample_start = g_get_monotonic_time ();
+	CD_TRACE1 (sensor_sample_begin, priv->id);
+	priv->desc->get_sample_async (sensor,
+				      priv->stream_cap,
+				      NULL,
+				      cd_sensor_stream_sample_done_cb,
+				      NULL);
+	return G_SOURCE_REMOVE;
+}
+
+typedef struct {
+	CdSensor		*sensor;
+	GDBusMethodInvocation	*invocation;
+	CdSensorCap		 cap;
+	gint64			 start;		/* us, monotonic */
+	guint			 count;
+	guint			 period;	/* ms */
+	guint			 settle;	/* ms */
+	GArray			*samples;	/* of CdColorXYZ */
+	guint			 timeout_id;	/* waiting for the patch to settle */
+	gchar			*cancelled;	/* reason, while a sample is in flight */
+} CdSensorBatchHelper;
+
+/* a schedule longer than any real patch set, which also bounds the
+ * allocation made for the reply */
+#define CD_SENSOR_BATCH_SAMPLES_MAX		10000
+
+static void
+cd_sensor_batch_helper_free (CdSensorBatchHelper *helper)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (helper->sensor);
+	if (priv->batch == helper)
+		priv->batch = NULL;
+	g_free (helper->cancelled);
+	g_object_unref (helper->sensor);
+	g_array_unref (helper->samples);
+	g_free (helper);
+}
+
+static gboolean cd_sensor_batch_sample_cb (gpointer user_data);
+
+/* waits until the patch for the next sample has settled */
+static void
+cd_sensor_batch_next (CdSensorBatchHelper *helper)
+{
+	GVariantBuilder builder;
+	gint64 due;
+	gint64 now;
+	guint delay = 0;
+	guint i;
+
+	/* all done */
+	if (helper->samples->len == helper->count) {
+		cd_sensor_set_state (helper->sensor, CD_SENSOR_STATE_IDLE);
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ddd)"));
+		for (i = 0; i < helper->samples->len; i++) {
+			CdColorXYZ *xyz = &g_array_index (helper->samples, CdColorXYZ, i);
+			g_variant_builder_add (&builder, "(ddd)", xyz->X, xyz->Y, xyz->Z);
+		}
+		g_dbus_method_invocation_return_value (helper->invocation,
+						       g_variant_new ("(a(ddd))", &builder));
+		cd_sensor_batch_helper_free (helper);
+		return;
+	}
+
+	due = helper->start +
+	      ((gint64) helper->samples->len * helper->period + helper->settle) * 1000;
+	now = g_get_monotonic_time ();
+	if (due > now)
+		delay = (guint) ((due - now) / 1000);
+	helper->timeout_id = g_timeout_add (delay, cd_sensor_batch_sample_cb, helper);
+}
+
+/* fails the running GetSamples, which completes straight away unless a
+ * sample is in flight, in which case it completes when that returns */
+static void
+cd_sensor_batch_cancel (CdSensor *sensor, const gchar *reason)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	CdSensorBatchHelper *helper = priv->batch;
+
+	if (helper == NULL)
+		return;
+	if (helper->timeout_id == 0) {
+		if (helper->cancelled == NULL)
+			helper->cancelled = g_strdup (reason);
+		return;
+	}
+	g_source_remove (helper->timeout_id);
+	helper->timeout_id = 0;
+	cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+	g_dbus_method_invocation_return_error (helper->invocation,
+					       CD_SENSOR_ERROR,
+					       CD_SENSOR_ERROR_INTERNAL,
+					       "cancelled: %s", reason);
+	cd_sensor_batch_helper_free (helper);
+}
+
+static void
+cd_sensor_batch_sample_done_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	CdSensorBatchHelper *helper = (CdSensorBatchHelper *) user_data;
+	CdSensor *sensor = CD_SENSOR (source_object);
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	gint64 deadline;
+	g_autoptr(CdColorXYZ) sample = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* get the result */
+	sample = priv->desc->get_sample_finish (sensor, res, &error);
+	CD_TRACE2 (sensor_sample_end, priv->id, sample != NULL);
+	cd_metrics_add ("sensor.get-sample", priv->sample_start);
+	if (sample == NULL) {
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+		g_dbus_method_invocation_return_gerror (helper->invocation, error);
+		cd_sensor_batch_helper_free (helper);
+		return;
+	}
+
+	/* unlocked, or the caller went away */
+	if (helper->cancelled != NULL) {
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       CD_SENSOR_ERROR,
+						       CD_SENSOR_ERROR_INTERNAL,
+						       "cancelled: %s",
+						       helper->cancelled);
+		cd_sensor_batch_helper_free (helper);
+		return;
+	}
+
+	/* the client has already moved on to the next patch */
+	deadline = helper->start +
+		   (gint64) (helper->samples->len + 1) * helper->period * 1000;
+	if (g_get_monotonic_time () > deadline) {
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_IDLE);
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       CD_SENSOR_ERROR,
+						       CD_SENSOR_ERROR_INTERNAL,
+						       "sample %u overran its %ums period",
+						       helper->samples->len,
+						       helper->period);
+		cd_sensor_batch_helper_free (helper);
+		return;
+	}
+	g_array_append_val (helper->samples, *sample);
+	cd_sensor_batch_next (helper);
+}
+
+static gboolean
+cd_sensor_batch_sample_cb (gpointer user_data)
+{
+	CdSensorBatchHelper *helper = (CdSensorBatchHelper *) user_data;
+	CdSensorPrivate *priv = GET_PRIVATE (helper->sensor);
+
+	helper->timeout_id = 0;
+	priv->sample_start = g_get_monotonic_time ();
+	CD_TRACE1 (sensor_sample_begin, priv->id);
+	priv->desc->get_sample_async (helper->sensor,
+				      helper->cap,
+				      NULL,
+				      cd_sensor_batch_sample_done_cb,
+				      helper);
+	return G_SOURCE_REMOVE;
+}
+
+/* a group drives all of its members at the same time and only
+ * completes once the slowest one has replied */
+typedef struct {
+	guint			 pending;
+	guint			 count;
+	GError			*error;
+	CdColorXYZ		 sum;
+} CdSensorGroupHelper;
+
+static void
+cd_sensor_group_helper_free (CdSensorGroupHelper *helper)
+{
+	if (helper->error != NULL)
+		g_error_free (helper->error);
+	g_free (helper);
+}
+
+static void
+cd_sensor_group_helper_add_error (CdSensorGroupHelper *helper,
+				  CdSensor *member,
+				  const GError *error)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (member);
+	if (helper->error != NULL)
+		return;
+	helper->error = g_error_new (error->domain, error->code,
+				     "%s: %s", priv->id, error->message);
+}
+
+static GTask *
+cd_sensor_group_task_new (CdSensor *sensor,
+			  GCancellable *cancellable,
+			  GAsyncReadyCallback callback,
+			  gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	CdSensorGroupHelper *helper = g_new0 (CdSensorGroupHelper, 1);
+	GTask *task = g_task_new (sensor, cancellable, callback, user_data);
+
+	/* hold the task until the last member completes */
+	helper->pending = priv->members->len + 1;
+	g_task_set_task_data (task, helper,
+			      (GDestroyNotify) cd_sensor_group_helper_free);
+	return task;
+}
+
+/* returns TRUE when this was the last outstanding member */
+static gboolean
+cd_sensor_group_task_complete (GTask *task)
+{
+	CdSensorGroupHelper *helper = g_task_get_task_data (task);
+	return --helper->pending == 0;
+}
+
+static void
+cd_sensor_group_lock_finish_task (GTask *task)
+{
+	CdSensor *sensor = g_task_get_source_object (task);
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	CdSensorGroupHelper *helper = g_task_get_task_data (task);
+
+	if (!cd_sensor_group_task_complete (task))
+		return;
+
+	/* success */
+	if (helper->error == NULL) {
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	/* a partial group is no use, so release the ones that worked */
+	for (guint i = 0; i < priv->members->len; i++) {
+		CdSensor *member = g_ptr_array_index (priv->members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		if (!priv_member->locked)
+			continue;
+		if (priv_member->desc->unlock_async == NULL) {
+			cd_sensor_set_locked (member, FALSE);
+			continue;
+		}
+		priv_member->desc->unlock_async (member,
+						 NULL,
+						 cd_sensor_unlock_quietly_cb,
+						 NULL);
+	}
+	g_task_return_error (task, g_steal_pointer (&helper->error));
+}
+
+static void
+cd_sensor_group_lock_cb (GObject *source_object,
+			 GAsyncResult *res,
+			 gpointer user_data)
+{
+	CdSensor *member = CD_SENSOR (source_object);
+	CdSensorPrivate *priv_member = GET_PRIVATE (member);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GError) error = NULL;
+
+	cd_sensor_set_state (member, CD_SENSOR_STATE_IDLE);
+	if (priv_member->desc->lock_finish (member, res, &error)) {
+		cd_sensor_set_locked (member, TRUE);
+	} else {
+		cd_sensor_group_helper_add_error (g_task_get_task_data (task),
+						  member, error);
+	}
+	cd_sensor_group_lock_finish_task (task);
+}
+
+static void
+cd_sensor_group_lock_async (CdSensor *sensor,
+			    GCancellable *cancellable,
+			    GAsyncReadyCallback callback,
+			    gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_autoptr(GTask) task = NULL;
+
+	task = cd_sensor_group_task_new (sensor, cancellable, callback, user_data);
+	for (guint i = 0; i < priv->members->len; i++) {
+		CdSensor *member = g_ptr_array_index (priv->members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		if (priv_member->desc->lock_async == NULL) {
+			cd_sensor_set_locked (member, TRUE);
+			cd_sensor_group_lock_finish_task (task);
+			continue;
+		}
+		priv_member->desc->lock_async (member,
+					       cancellable,
+					       cd_sensor_group_lock_cb,
+					       g_object_ref (task));
+	}
+	cd_sensor_group_lock_finish_task (task);
+}
+
+static gboolean
+cd_sensor_group_bool_finish (CdSensor *sensor, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, sensor), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+static void
+cd_sensor_group_unlock_finish_task (GTask *task)
+{
+	CdSensorGroupHelper *helper = g_task_get_task_data (task);
+
+	if (!cd_sensor_group_task_complete (task))
+		return;
+	if (helper->error != NULL) {
+		g_task_return_error (task, g_steal_pointer (&helper->error));
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+cd_sensor_group_unlock_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	CdSensor *member = CD_SENSOR (source_object);
+	CdSensorPrivate *priv_member = GET_PRIVATE (member);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GError) error = NULL;
+
+	cd_sensor_set_state (member, CD_SENSOR_STATE_IDLE);
+	if (!priv_member->desc->unlock_finish (member, res, &error)) {
+		cd_sensor_group_helper_add_error (g_task_get_task_data (task),
+						  member, error);
+	}
+	cd_sensor_set_locked (member, FALSE);
+	cd_sensor_group_unlock_finish_task (task);
+}
+
+static void
+cd_sensor_group_unlock_async (CdSensor *sensor,
+			      GCancellable *cancellable,
+			      GAsyncReadyCallback callback,
+			      gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_autoptr(GTask) task = NULL;
+
+	task = cd_sensor_group_task_new (sensor, cancellable, callback, user_data);
+	for (guint i = 0; i < priv->members->len; i++) {
+		CdSensor *member = g_ptr_array_index (priv->members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		if (!priv_member->locked ||
+		    priv_member->desc->unlock_async == NULL) {
+			cd_sensor_set_locked (member, FALSE);
+			cd_sensor_group_unlock_finish_task (task);
+			continue;
+		}
+		priv_member->desc->unlock_async (member,
+						 cancellable,
+						 cd_sensor_group_unlock_cb,
+						 g_object_ref (task));
+	}
+	cd_sensor_group_unlock_finish_task (task);
+}
+
+static void
+cd_sensor_group_sample_finish_task (GTask *task)
+{
+	CdSensorGroupHelper *helper = g_task_get_task_data (task);
+	CdColorXYZ *result;
+
+	if (!cd_sensor_group_task_complete (task))
+		return;
+	if (helper->error != NULL) {
+		g_task_return_error (task, g_steal_pointer (&helper->error));
+		return;
+	}
+
+	/* the group reads as the mean of the corrected members */
+	result = cd_color_xyz_new ();
+	cd_color_xyz_set (result,
+			  helper->sum.X / helper->count,
+			  helper->sum.Y / helper->count,
+			  helper->sum.Z / helper->count);
+	g_task_return_pointer (task, result, (GDestroyNotify) cd_color_xyz_free);
+}
+
+static void
+cd_sensor_group_sample_cb (GObject *source_object,
+			   GAsyncResult *res,
+			   gpointer user_data)
+{
+	CdSensor *member = CD_SENSOR (source_object);
+	CdSensorPrivate *priv_member = GET_PRIVATE (member);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	CdSensor *sensor = g_task_get_source_object (task);
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	CdSensorGroupHelper *helper = g_task_get_task_data (task);
+	CdColorXYZ corrected;
+	guint idx = 0;
+	g_autoptr(CdColorXYZ) sample = NULL;
+	g_autoptr(GError) error = NULL;
+
+	cd_sensor_set_state (member, CD_SENSOR_STATE_IDLE);
+	sample = priv_member->desc->get_sample_finish (member, res, &error);
+	if (sample == NULL) {
+		cd_sensor_group_helper_add_error (helper, member, error);
+		cd_sensor_group_sample_finish_task (task);
+		return;
+	}
+
+	/* bring each unit onto the same scale before combining */
+	g_ptr_array_find (priv->members, member, &idx);
+	cd_mat33_vector_multiply (&g_array_index (priv->corrections, CdMat3x3, idx),
+				  (const CdVec3 *) sample,
+				  (CdVec3 *) &corrected);
+	g_debug ("%s: %f, %f, %f corrected to %f, %f, %f",
+		 priv_member->id,
+		 sample->X, sample->Y, sample->Z,
+		 corrected.X, corrected.Y, corrected.Z);
+	helper->sum.X += corrected.X;
+	helper->sum.Y += corrected.Y;
+	helper->sum.Z += corrected.Z;
+	helper->count++;
+	cd_sensor_group_sample_finish_task (task);
+}
+
+static void
+cd_sensor_group_get_sample_async (CdSensor *sensor,
+				  CdSensorCap cap,
+				  GCancellable *cancellable,
+				  GAsyncReadyCallback callback,
+				  gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_autoptr(GTask) task = NULL;
+
+	/* a member may still be busy from a failed sample */
+	for (guint i = 0; i < priv->members->len; i++) {
+		CdSensor *member = g_ptr_array_index (priv->members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		if (priv_member->state != CD_SENSOR_STATE_IDLE) {
+			g_task_report_new_error (sensor, callback, user_data,
+						 cd_sensor_group_get_sample_async,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_IN_USE,
+						 "%s not idle: %s",
+						 priv_member->id,
+						 cd_sensor_state_to_string (priv_member->state));
+			return;
+		}
+	}
+
+	/* fire them all at once */
+	task = cd_sensor_group_task_new (sensor, cancellable, callback, user_data);
+	for (guint i = 0; i < priv->members->len; i++) {
+		CdSensor *member = g_ptr_array_index (priv->members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		cd_sensor_set_state (member, CD_SENSOR_STATE_MEASURING);
+		priv_member->desc->get_sample_async (member,
+						     cap,
+						     cancellable,
+						     cd_sensor_group_sample_cb,
+						     g_object_ref (task));
+	}
+	cd_sensor_group_sample_finish_task (task);
+}
+
+static CdColorXYZ *
+cd_sensor_group_get_sample_finish (CdSensor *sensor,
+				   GAsyncResult *res,
+				   GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, sensor), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/* options are "correction-N" with the nine values of a 3x3 matrix,
+ * applied to the XYZ of member N before it is combined */
+static void
+cd_sensor_group_set_options_async (CdSensor *sensor,
+				   GHashTable *options,
+				   GCancellable *cancellable,
+				   GAsyncReadyCallback callback,
+				   gpointer user_data)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	g_autoptr(GArray) corrections = NULL;
+	g_autoptr(GTask) task = NULL;
+
+	task = g_task_new (sensor, cancellable, callback, user_data);
+	corrections = g_array_sized_new (FALSE, FALSE, sizeof (CdMat3x3),
+					 priv->corrections->len);
+	g_array_append_vals (corrections,
+			     priv->corrections->data,
+			     priv->corrections->len);
+	g_hash_table_iter_init (&iter, options);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const gchar *tmp;
+		const gdouble *data;
+		gchar *endptr = NULL;
+		gsize len = 0;
+		guint64 idx;
+
+		if (!g_str_has_prefix (key, "correction-")) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_NO_SUPPORT,
+						 "option %s is not supported",
+						 (const gchar *) key);
+			return;
+		}
+		tmp = (const gchar *) key + strlen ("correction-");
+		idx = g_ascii_strtoull (tmp, &endptr, 10);
+		if (endptr == tmp || *endptr != '\0' ||
+		    idx >= priv->members->len) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_NO_SUPPORT,
+						 "no group member for %s",
+						 (const gchar *) key);
+			return;
+		}
+		if (!g_variant_is_of_type (value, G_VARIANT_TYPE ("ad"))) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_NO_SUPPORT,
+						 "%s needs type ad",
+						 (const gchar *) key);
+			return;
+		}
+		data = g_variant_get_fixed_array (value, &len, sizeof (gdouble));
+		if (len != 9) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_NO_SUPPORT,
+						 "%s needs 9 values, got %" G_GSIZE_FORMAT,
+						 (const gchar *) key, len);
+			return;
+		}
+		memcpy (cd_mat33_get_data (&g_array_index (corrections, CdMat3x3, idx)),
+			data, 9 * sizeof (gdouble));
+	}
+
+	/* only apply if every option was valid */
+	g_array_unref (priv->corrections);
+	priv->corrections = g_steal_pointer (&corrections);
+	g_task_return_boolean (task, TRUE);
+}
+
+static CdSensorIface cd_sensor_group_iface = {
+	.get_sample_async = cd_sensor_group_get_sample_async,
+	.get_sample_finish = cd_sensor_group_get_sample_finish,
+	.lock_async = cd_sensor_group_lock_async,
+	.lock_finish = cd_sensor_group_bool_finish,
+	.unlock_async = cd_sensor_group_unlock_async,
+	.unlock_finish = cd_sensor_group_bool_finish,
+	.set_options_async = cd_sensor_group_set_options_async,
+	.set_options_finish = cd_sensor_group_bool_finish,
+};
+
 static void
 cd_sensor_name_vanished_cb (GDBusConnection *connection,
 			     const gchar *name,
@@ -749,6 +1545,8 @@ cd_sensor_name_vanished_cb (GDBusConnection *connection,
 
 	/* dummy */
 	g_debug ("locked sender has vanished without doing Unlock()!");
+	cd_sensor_stream_stop (sensor, "sensor unlocked");
+	cd_sensor_batch_cancel (sensor, "locked sender has vanished");
 	if (priv->desc == NULL ||
 	    priv->desc->unlock_async == NULL) {
 		cd_sensor_set_locked (sensor, FALSE);
@@ -780,6 +1578,16 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	gchar *key;
 	g_autoptr(GError) error = NULL;
 
+	/* members are only driven through their group */
+	if (priv->group != NULL) {
+		g_dbus_method_invocation_return_error (invocation,
+						       CD_SENSOR_ERROR,
+						       CD_SENSOR_ERROR_IN_USE,
+						       "sensor is part of %s",
+						       cd_sensor_get_id (priv->group));
+		return;
+	}
+
 	/* return '' */
 	if (g_strcmp0 (method_name, "Lock") == 0) {
 
@@ -825,6 +1633,7 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 		}
 
 		/* proxy */
+		CD_TRACE1 (sensor_lock_begin, priv->id);
 		priv->desc->lock_async (sensor,
 					NULL,
 					cd_sensor_lock_cb,
@@ -863,6 +1672,8 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 			g_bus_unwatch_name (priv->watcher_id);
 			priv->watcher_id = 0;
 		}
+		cd_sensor_stream_stop (sensor, "sensor unlocked");
+		cd_sensor_batch_cancel (sensor, "sensor unlocked");
 
 		/* no support */
 		if (priv->desc == NULL ||
@@ -936,6 +1747,8 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 		}
 
 		/* proxy */
+		priv->sample_start = g_get_monotonic_time ();
+		CD_TRACE1 (sensor_sample_begin, priv->id);
 		priv->desc->get_sample_async (sensor,
 					      cap,
 					      NULL,
@@ -944,10 +1757,111 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 		return;
 	}
 
-	/* return 'ddad' */
-	if (g_strcmp0 (method_name, "GetSpectrum") == 0) {
+	/* return 'a(ddd)' */
+	if (g_strcmp0 (method_name, "GetSamples") == 0) {
+
+		CdSensorBatchHelper *helper;
+		gint64 start = 0;
+		guint count = 0;
+		guint period = 0;
+		guint settle = 0;
+
+		g_debug ("CdSensor %s:GetSamples()", sender);
+
+		/* check locked */
+		if (!priv->locked) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_NOT_LOCKED,
+							       "sensor is not yet locked");
+			return;
+		}
+
+		/*  check idle */
+		if (priv->state != CD_SENSOR_STATE_IDLE) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_IN_USE,
+							       "sensor not idle: %s",
+							       cd_sensor_state_to_string (priv->state));
+			return;
+		}
+
+		/* no support */
+		if (priv->desc == NULL ||
+		    priv->desc->get_sample_async == NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_NO_SUPPORT,
+							       "no sensor->get_sample");
+			return;
+		}
+
+		/* get the type */
+		g_variant_get (parameters, "(&sxuuu)",
+			       &cap_tmp, &start, &count, &period, &settle);
+		cap = cd_sensor_cap_from_string (cap_tmp);
+		if (cap == CD_SENSOR_CAP_UNKNOWN) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "cap '%s' unknown",
+							       cap_tmp);
+			return;
+		}
+
+		/* check type */
+		if (cap == CD_SENSOR_CAP_SPECTRAL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "cannot return spectral");
+			return;
+		}
+
+		/* check schedule */
+		if (count == 0 || settle >= period) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "schedule invalid: %u samples, "
+							       "%ums settle in %ums period",
+							       count, settle, period);
+			return;
+		}
+
+		/* the reply is allocated up front */
+		if (count > CD_SENSOR_BATCH_SAMPLES_MAX) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INVALID_VALUE,
+							       "%u samples requested, maximum is %u",
+							       count,
+							       (guint) CD_SENSOR_BATCH_SAMPLES_MAX);
+			return;
+		}
+
+		/* take each sample as its patch settles */
+		helper = g_new0 (CdSensorBatchHelper, 1);
+		helper->sensor = g_object_ref (sensor);
+		helper->invocation = invocation;
+		helper->cap = cap;
+		helper->start = start;
+		helper->count = count;
+		helper->period = period;
+		helper->settle = settle;
+		helper->samples = g_array_sized_new (FALSE, FALSE, sizeof (CdColorXYZ), count);
+		priv->batch = helper;
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
+		cd_sensor_batch_next (helper);
+		return;
+	}
+
+	/* return 'ddad' or 'ddadddd' */
+	if (g_strcmp0 (method_name, "GetSpectrum") == 0 ||
+	    g_strcmp0 (method_name, "GetSpectrumSample") == 0) {
 
-		g_debug ("CdSensor %s:GetSpectrum()", sender);
+		g_debug ("CdSensor %s:%s()", sender, method_name);
 
 		/* check locked */
 		if (!priv->locked) {
@@ -1002,7 +1916,19 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 			return;
 		}
 
+		/* do not take a reading that cannot be converted */
+		if (g_strcmp0 (method_name, "GetSpectrumSample") == 0 &&
+		    cd_sensor_get_xyz_plan (&error) == NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "failed to load observer: %s",
+							       error->message);
+			return;
+		}
+
 		/* proxy */
+		priv->sample_start = g_get_monotonic_time ();
 		priv->desc->get_spectrum_async (sensor,
 						cap,
 						NULL,
@@ -1011,6 +1937,93 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 		return;
 	}
 
+	/* return '' */
+	if (g_strcmp0 (method_name, "StartStream") == 0) {
+
+		guint interval = 0;
+
+		g_debug ("CdSensor %s:StartStream()", sender);
+
+		/* check locked */
+		if (!priv->locked) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_NOT_LOCKED,
+							       "sensor is not yet locked");
+			return;
+		}
+
+		/*  check idle */
+		if (priv->state != CD_SENSOR_STATE_IDLE) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_IN_USE,
+							       "sensor not idle: %s",
+							       cd_sensor_state_to_string (priv->state));
+			return;
+		}
+
+		/* no support */
+		if (priv->desc == NULL ||
+		    priv->desc->get_sample_async == NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_NO_SUPPORT,
+							       "no sensor->get_sample");
+			return;
+		}
+
+		/* get the type */
+		g_variant_get (parameters, "(&su)", &cap_tmp, &interval);
+		cap = cd_sensor_cap_from_string (cap_tmp);
+		if (cap == CD_SENSOR_CAP_UNKNOWN) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "cap '%s' unknown",
+							       cap_tmp);
+			return;
+		}
+
+		/* check type */
+		if (cap == CD_SENSOR_CAP_SPECTRAL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "cannot stream spectral");
+			return;
+		}
+
+		/* take samples until stopped or unlocked */
+		priv->stream_sender = g_strdup (sender);
+		priv->stream_cap = cap;
+		priv->stream_interval = interval;
+		cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
+		priv->stream_id = g_idle_add (cd_sensor_stream_sample_cb, sensor);
+		g_source_set_name_by_id (priv->stream_id, "[CdSensor] stream");
+		g_dbus_method_invocation_return_value (invocation, NULL);
+		return;
+	}
+
+	/* return '' */
+	if (g_strcmp0 (method_name, "StopStream") == 0) {
+
+		g_debug ("CdSensor %s:StopStream()", sender);
+
+		/* check running */
+		if (g_strcmp0 (priv->stream_sender, sender) != 0) {
+			g_dbus_method_invocation_return_error (invocation,
+							       CD_SENSOR_ERROR,
+							       CD_SENSOR_ERROR_INTERNAL,
+							       "no stream started by %s",
+							       sender);
+			return;
+		}
+		cd_sensor_stream_stop (sensor, "");
+		g_dbus_method_invocation_return_value (invocation, NULL);
+		return;
+	}
+
 	/* return '' */
 	if (g_strcmp0 (method_name, "SetOptions") == 0) {
 
@@ -1069,6 +2082,19 @@ cd_sensor_dbus_method_call (GDBusConnection *connection, const gchar *sender,
 	g_critical ("failed to process sensor method %s", method_name);
 }
 
+/* records how long each method handler takes */
+static void
+cd_sensor_dbus_method_call_timed (GDBusConnection *connection, const gchar *sender,
+				  const gchar *object_path, const gchar *interface_name,
+				  const gchar *method_name, GVariant *parameters,
+				  GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	gint64 start = g_get_monotonic_time ();
+	cd_sensor_dbus_method_call (connection, sender, object_path, interface_name,
+				    method_name, parameters, invocation, user_data);
+	cd_metrics_add_method ("Sensor", method_name, start);
+}
+
 static GVariant *
 cd_sensor_get_options_as_variant (CdSensor *sensor)
 {
@@ -1198,7 +2224,7 @@ cd_sensor_register_object (CdSensor *sensor,
 	g_autoptr(GError) error_local = NULL;
 
 	static const GDBusInterfaceVTable interface_vtable = {
-		cd_sensor_dbus_method_call,
+		cd_sensor_dbus_method_call_timed,
 		cd_sensor_dbus_get_property,
 		NULL
 	};
@@ -1611,6 +2637,19 @@ cd_sensor_class_init (CdSensorClass *klass)
 				      FALSE,
 				      G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_LOCKED, pspec);
+
+	/**
+	 * CdSensor::invalidate:
+	 *
+	 * The ::invalidate signal is emitted when the client that created
+	 * the sensor group leaves the bus, so the group should be removed.
+	 **/
+	signals[SIGNAL_INVALIDATE] =
+		g_signal_new ("invalidate",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (CdSensorClass, invalidate),
+			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 }
 
 static void
@@ -1647,6 +2686,32 @@ cd_sensor_finalize (GObject *object)
 		g_bus_unwatch_name (priv->watcher_id);
 	if (priv->set_state_id > 0)
 		g_source_remove (priv->set_state_id);
+	if (priv->stream_id != 0)
+		g_source_remove (priv->stream_id);
+	if (priv->owner_watcher_id != 0)
+		g_bus_unwatch_name (priv->owner_watcher_id);
+	if (priv->members != NULL) {
+		for (guint i = 0; i < priv->members->len; i++) {
+			CdSensor *member = g_ptr_array_index (priv->members, i);
+			CdSensorPrivate *priv_member = GET_PRIVATE (member);
+			priv_member->group = NULL;
+
+			/* the group was removed while still locked */
+			if (!priv_member->locked)
+				continue;
+			if (priv_member->desc->unlock_async == NULL) {
+				cd_sensor_set_locked (member, FALSE);
+				continue;
+			}
+			priv_member->desc->unlock_async (member,
+							 NULL,
+							 cd_sensor_unlock_quietly_cb,
+							 NULL);
+		}
+		g_ptr_array_unref (priv->members);
+		g_array_unref (priv->corrections);
+	}
+	g_free (priv->stream_sender);
 	g_free (priv->model);
 	g_free (priv->vendor);
 	g_free (priv->serial);
@@ -1662,6 +2727,140 @@ cd_sensor_finalize (GObject *object)
 	G_OBJECT_CLASS (cd_sensor_parent_class)->finalize (object);
 }
 
+static void
+cd_sensor_owner_vanished_cb (GDBusConnection *connection,
+			     const gchar *name,
+			     gpointer user_data)
+{
+	CdSensor *sensor = CD_SENSOR (user_data);
+	g_debug ("CdSensor: emit 'invalidate' as %s vanished", name);
+	g_signal_emit (sensor, signals[SIGNAL_INVALIDATE], 0);
+}
+
+/**
+ * cd_sensor_watch_sender:
+ *
+ * Emits ::invalidate when @sender leaves the bus.
+ **/
+void
+cd_sensor_watch_sender (CdSensor *sensor, const gchar *sender)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_return_if_fail (CD_IS_SENSOR (sensor));
+	g_return_if_fail (sender != NULL);
+	priv->owner_watcher_id = g_bus_watch_name (G_BUS_TYPE_SYSTEM,
+						   sender,
+						   G_BUS_NAME_WATCHER_FLAGS_NONE,
+						   NULL,
+						   cd_sensor_owner_vanished_cb,
+						   sensor,
+						   NULL);
+}
+
+/**
+ * cd_sensor_has_member:
+ *
+ * Checks if a sensor is one of the members of a sensor group.
+ *
+ * Returns: %TRUE if @member is part of the group @sensor
+ **/
+gboolean
+cd_sensor_has_member (CdSensor *sensor, CdSensor *member)
+{
+	CdSensorPrivate *priv = GET_PRIVATE (sensor);
+	g_return_val_if_fail (CD_IS_SENSOR (sensor), FALSE);
+	if (priv->members == NULL)
+		return FALSE;
+	return g_ptr_array_find (priv->members, member, NULL);
+}
+
+/**
+ * cd_sensor_new_group:
+ * @id: the sensor ID for the group
+ * @members: (element-type CdSensor): at least two physical sensors
+ * @error: a #GError, or %NULL
+ *
+ * Creates a sensor that locks and samples all of @members at the same
+ * time, returning the mean of their readings after each has been
+ * multiplied by its own correction matrix.
+ *
+ * Returns: a new #CdSensor, or %NULL for error
+ **/
+CdSensor *
+cd_sensor_new_group (const gchar *id, GPtrArray *members, GError **error)
+{
+	CdSensorPrivate *priv;
+	g_autoptr(CdSensor) sensor = NULL;
+	guint64 caps = G_MAXUINT64;
+
+	g_return_val_if_fail (id != NULL, NULL);
+	g_return_val_if_fail (members != NULL, NULL);
+
+	if (members->len < 2) {
+		g_set_error_literal (error,
+				     CD_SENSOR_ERROR,
+				     CD_SENSOR_ERROR_NO_SUPPORT,
+				     "a group needs at least two sensors");
+		return NULL;
+	}
+	for (guint i = 0; i < members->len; i++) {
+		CdSensor *member = g_ptr_array_index (members, i);
+		CdSensorPrivate *priv_member = GET_PRIVATE (member);
+		if (priv_member->members != NULL ||
+		    priv_member->group != NULL ||
+		    priv_member->locked) {
+			g_set_error (error,
+				     CD_SENSOR_ERROR,
+				     CD_SENSOR_ERROR_IN_USE,
+				     "%s is already in use",
+				     priv_member->id);
+			return NULL;
+		}
+		if (priv_member->desc == NULL ||
+		    priv_member->desc->get_sample_async == NULL) {
+			g_set_error (error,
+				     CD_SENSOR_ERROR,
+				     CD_SENSOR_ERROR_NO_SUPPORT,
+				     "%s cannot take samples",
+				     priv_member->id);
+			return NULL;
+		}
+		for (guint j = 0; j < i; j++) {
+			if (g_ptr_array_index (members, j) == member) {
+				g_set_error (error,
+					     CD_SENSOR_ERROR,
+					     CD_SENSOR_ERROR_NO_SUPPORT,
+					     "%s is listed twice",
+					     priv_member->id);
+				return NULL;
+			}
+		}
+		caps &= priv_member->caps;
+	}
+
+	/* only what every member can do, and spectra are not combined */
+	sensor = cd_sensor_new ();
+	priv = GET_PRIVATE (sensor);
+	cd_sensor_set_id (sensor, id);
+	priv->native = TRUE;
+	priv->caps = caps & ~cd_bitfield_value (CD_SENSOR_CAP_SPECTRAL);
+	priv->model = g_strdup_printf ("Sensor group (%u units)", members->len);
+	priv->desc = &cd_sensor_group_iface;
+	priv->members = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	priv->corrections = g_array_sized_new (FALSE, FALSE,
+					       sizeof (CdMat3x3),
+					       members->len);
+	for (guint i = 0; i < members->len; i++) {
+		CdSensor *member = g_ptr_array_index (members, i);
+		CdMat3x3 identity;
+		cd_mat33_set_identity (&identity);
+		g_array_append_val (priv->corrections, identity);
+		g_ptr_array_add (priv->members, g_object_ref (member));
+		GET_PRIVATE (member)->group = sensor;
+	}
+	return g_steal_pointer (&sensor);
+}
+
 CdSensor *
 cd_sensor_new (void)
 {
@@ -43,6 +43,7 @@ G_DECLARE_DERIVABLE_TYPE (CdSensor, cd_sensor, CD, SENSOR, GObject)
 struct _CdSensorClass
 {
 	GObjectClass	 parent_class;
+	void		 (* invalidate)		(CdSensor	*sensor);
 };
 
 typedef enum {
@@ -55,6 +56,9 @@ typedef enum {
 #define CD_SENSOR_NO_VALUE			-1.0f
 
 CdSensor	*cd_sensor_new			(void);
+CdSensor	*cd_sensor_new_group		(const gchar		*id,
+						 GPtrArray		*members,
+						 GError			**error);
 GQuark		 cd_sensor_error_quark		(void);
 
 /* accessors */
@@ -76,6 +80,10 @@ GUsbDevice	*cd_sensor_open_usb_device	(CdSensor		*sensor,
 						 gint			 config,
 						 gint			 interface,
 						 GError			**error);
+void		 cd_sensor_watch_sender	(CdSensor		*sensor,
+						 const gchar		*sender);
+gboolean	 cd_sensor_has_member		(CdSensor		*sensor,
+						 CdSensor		*member);
 void		 cd_sensor_button_pressed	(CdSensor		*sensor);
 gboolean	 cd_sensor_dump			(CdSensor		*sensor,
 						 GString		*data,
@@ -95,6 +103,11 @@ void		 cd_sensor_set_mode		(CdSensor		*sensor,
 CdSensorCap	 cd_sensor_get_mode		(CdSensor		*sensor);
 void		 cd_sensor_set_serial		(CdSensor		*sensor,
 						 const gchar		*serial);
+GBytes		*cd_sensor_get_cached_data	(CdSensor		*sensor,
+						 const gchar		*key);
+void		 cd_sensor_set_cached_data	(CdSensor		*sensor,
+						 const gchar		*key,
+						 GBytes			*data);
 void		 cd_sensor_add_option		(CdSensor		*sensor,
 						 const gchar		*key,
 						 GVariant		*value);
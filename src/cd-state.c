@@ -0,0 +1,152 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#include "cd-common.h"
+#include "cd-device.h"
+#include "cd-state.h"
+
+/* bump this if the format or the meaning of any field changes */
+#define CD_STATE_VERSION		1
+#define CD_STATE_FORMAT			"(usa(sa{ss}))"
+#define CD_STATE_BOOT_ID_FILENAME	"/proc/sys/kernel/random/boot_id"
+
+/* devices may have been added or removed across a reboot */
+static gchar *
+cd_state_get_boot_id (void)
+{
+	gchar *boot_id = NULL;
+	if (!g_file_get_contents (CD_STATE_BOOT_ID_FILENAME, &boot_id, NULL, NULL))
+		return g_strdup ("");
+	return g_strstrip (boot_id);
+}
+
+/**
+ * cd_state_save:
+ *
+ * Writes the devices that were added by plugins, so that they can be
+ * restored straight away the next time the daemon is activated.
+ **/
+gboolean
+cd_state_save (const gchar *filename, GPtrArray *devices, GError **error)
+{
+	GVariantBuilder builder;
+	g_autofree gchar *boot_id = cd_state_get_boot_id ();
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GVariant) state = NULL;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sa{ss})"));
+	for (guint i = 0; i < devices->len; i++) {
+		CdDevice *device = g_ptr_array_index (devices, i);
+		g_variant_builder_add_value (&builder, cd_device_get_state (device));
+	}
+	state = g_variant_ref_sink (g_variant_new ("(us@a(sa{ss}))",
+						   (guint32) CD_STATE_VERSION,
+						   boot_id,
+						   g_variant_builder_end (&builder)));
+
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) < 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     g_io_error_from_errno (errno),
+			     "failed to create %s: %s",
+			     dirname, g_strerror (errno));
+		return FALSE;
+	}
+	return g_file_set_contents (filename,
+				    g_variant_get_data (state),
+				    g_variant_get_size (state),
+				    error);
+}
+
+/**
+ * cd_state_load:
+ *
+ * Loads the devices written by cd_state_save(), as long as the file is
+ * from this version of the daemon and from the current boot.
+ *
+ * Return value: (element-type CdDevice): devices that are not yet registered
+ **/
+GPtrArray *
+cd_state_load (const gchar *filename, GError **error)
+{
+	const gchar *boot_id_saved;
+	guint32 version;
+	gsize len;
+	gchar *data = NULL;
+	g_autofree gchar *boot_id = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GVariant) state = NULL;
+	g_autoptr(GVariant) state_devices = NULL;
+	GVariantIter iter;
+	GVariant *device_state;
+
+	if (!g_file_get_contents (filename, &data, &len, error))
+		return NULL;
+	bytes = g_bytes_new_take (data, len);
+	state = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CD_STATE_FORMAT),
+							      bytes, FALSE));
+	if (!g_variant_is_normal_form (state)) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_INVALID_DATA,
+			     "%s is not valid", filename);
+		return NULL;
+	}
+
+	/* only trust the file from the same daemon and boot */
+	g_variant_get (state, "(u&s@a(sa{ss}))", &version, &boot_id_saved, &state_devices);
+	if (version != CD_STATE_VERSION) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_INVALID_DATA,
+			     "%s is version %u, expected %u",
+			     filename, version, (guint) CD_STATE_VERSION);
+		return NULL;
+	}
+	boot_id = cd_state_get_boot_id ();
+	if (boot_id[0] == '\0' || g_strcmp0 (boot_id, boot_id_saved) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_INVALID_DATA,
+			     "%s is from a previous boot", filename);
+		return NULL;
+	}
+
+	/* recreate each device with the properties it had */
+	devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_variant_iter_init (&iter, state_devices);
+	while ((device_state = g_variant_iter_next_value (&iter)) != NULL) {
+		g_autoptr(GVariant) device_state_tmp = device_state;
+		g_autoptr(CdDevice) device = cd_device_new ();
+		if (!cd_device_set_state (device, device_state, error))
+			return NULL;
+		g_ptr_array_add (devices, g_steal_pointer (&device));
+	}
+	return g_steal_pointer (&devices);
+}
@@ -92,8 +92,9 @@ cd_plugin_is_device_embedded (GUdevDevice *device)
 	return embedded;
 }
 
+/* devices are added to @coldplug if set, rather than emitted one by one */
 static void
-cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device)
+cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device, GPtrArray *coldplug)
 {
 	const gchar *seat;
 	g_autofree gchar *id = NULL;
@@ -181,6 +182,10 @@ cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device)
 			     g_strdup (g_udev_device_get_sysfs_path (udev_device)),
 			     g_object_ref (device));
 
+	if (coldplug != NULL) {
+		g_ptr_array_add (coldplug, g_object_ref (device));
+		return;
+	}
 	g_debug ("CdPlugin: emit add: %s", id);
 	cd_plugin_device_added (plugin, device);
 }
@@ -211,7 +216,7 @@ cd_plugin_uevent_cb (GUdevClient *udev_client,
 
 	/* add */
 	if (g_strcmp0 (action, "add") == 0) {
-		cd_plugin_add (plugin, udev_device);
+		cd_plugin_add (plugin, udev_device, NULL);
 		return;
 	}
 }
@@ -222,13 +227,14 @@ cd_plugin_coldplug (CdPlugin *plugin)
 	GList *devices;
 	GList *l;
 	GUdevDevice *udev_device;
+	g_autoptr(GPtrArray) coldplug = g_ptr_array_new_with_free_func (g_object_unref);
 
 	/* add all USB scanner devices */
 	devices = g_udev_client_query_by_subsystem (plugin->priv->udev_client,
 						    "usb");
 	for (l = devices; l != NULL; l = l->next) {
 		udev_device = l->data;
-		cd_plugin_add (plugin, udev_device);
+		cd_plugin_add (plugin, udev_device, coldplug);
 	}
 	g_list_foreach (devices, (GFunc) g_object_unref, NULL);
 	g_list_free (devices);
@@ -238,11 +244,15 @@ cd_plugin_coldplug (CdPlugin *plugin)
 						    "video4linux");
 	for (l = devices; l != NULL; l = l->next) {
 		udev_device = l->data;
-		cd_plugin_add (plugin, udev_device);
+		cd_plugin_add (plugin, udev_device, coldplug);
 	}
 	g_list_foreach (devices, (GFunc) g_object_unref, NULL);
 	g_list_free (devices);
 
+	/* add everything found in one batch */
+	g_debug ("CdPlugin: emit add for %u devices", coldplug->len);
+	cd_plugin_devices_added (plugin, coldplug);
+
 	/* watch udev for changes */
 	g_signal_connect (plugin->priv->udev_client, "uevent",
 			  G_CALLBACK (cd_plugin_uevent_cb), plugin);
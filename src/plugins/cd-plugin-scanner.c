@@ -70,8 +70,9 @@ cd_plugin_get_scanner_id_for_udev_device (GUdevDevice *udev_device)
 	return g_string_free (string, FALSE);
 }
 
+/* devices are added to @coldplug if set, rather than emitted one by one */
 static void
-cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device)
+cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device, GPtrArray *coldplug)
 {
 	const gchar *devclass;
 	const gchar *seat;
@@ -154,6 +155,10 @@ cd_plugin_add (CdPlugin *plugin, GUdevDevice *udev_device)
 			     g_strdup (g_udev_device_get_sysfs_path (udev_device)),
 			     g_object_ref (device));
 
+	if (coldplug != NULL) {
+		g_ptr_array_add (coldplug, g_object_ref (device));
+		return;
+	}
 	g_debug ("CdPlugin: emit add: %s", id);
 	cd_plugin_device_added (plugin, device);
 }
@@ -184,7 +189,7 @@ cd_plugin_uevent_cb (GUdevClient *udev_client,
 
 	/* add */
 	if (g_strcmp0 (action, "add") == 0) {
-		cd_plugin_add (plugin, udev_device);
+		cd_plugin_add (plugin, udev_device, NULL);
 		return;
 	}
 }
@@ -195,17 +200,22 @@ cd_plugin_coldplug (CdPlugin *plugin)
 	GList *devices;
 	GList *l;
 	GUdevDevice *udev_device;
+	g_autoptr(GPtrArray) coldplug = g_ptr_array_new_with_free_func (g_object_unref);
 
 	/* add all USB scanner devices */
 	devices = g_udev_client_query_by_subsystem (plugin->priv->udev_client,
 						    "usb");
 	for (l = devices; l != NULL; l = l->next) {
 		udev_device = l->data;
-		cd_plugin_add (plugin, udev_device);
+		cd_plugin_add (plugin, udev_device, coldplug);
 	}
 	g_list_foreach (devices, (GFunc) g_object_unref, NULL);
 	g_list_free (devices);
 
+	/* add everything found in one batch */
+	g_debug ("CdPlugin: emit add for %u devices", coldplug->len);
+	cd_plugin_devices_added (plugin, coldplug);
+
 	/* watch udev for changes */
 	g_signal_connect (plugin->priv->udev_client, "uevent",
 			  G_CALLBACK (cd_plugin_uevent_cb), plugin);
@@ -36,11 +36,27 @@ typedef enum {
 	CD_SENSOR_ARGYLL_POS_LAST
 } CdSensorArgyllPos;
 
+/* where the long-running spotread process is in its prompt cycle */
+typedef enum {
+	CD_SENSOR_ARGYLL_STATE_STOPPED,
+	CD_SENSOR_ARGYLL_STATE_STARTING,	/* waiting for the first prompt */
+	CD_SENSOR_ARGYLL_STATE_READY,		/* prompt shown, nothing sent */
+	CD_SENSOR_ARGYLL_STATE_MEASURING,	/* key sent, waiting for result */
+	CD_SENSOR_ARGYLL_STATE_STOPPING,
+	CD_SENSOR_ARGYLL_STATE_LAST
+} CdSensorArgyllState;
+
 typedef struct {
-	gboolean			 done_startup;
 	CdSpawn				*spawn;
 	guint				 communication_port;
 	CdSensorArgyllPos		 pos_required;
+	CdSensorArgyllState		 state;
+	CdSensorCap			 cap;		/* what spotread was started for */
+	GTask				*task;		/* the sample in progress */
+	GTask				*unlock_task;
+	guint				 exit_id;
+	guint				 stdout_id;
+	guint				 timeout_id;
 } CdSensorArgyllPrivate;
 
 static CdSensorArgyllPrivate *
@@ -49,69 +65,133 @@ cd_sensor_argyll_get_private (CdSensor *sensor)
 	return g_object_get_data (G_OBJECT (sensor), "priv");
 }
 
-/* async task for the sensor readings */
-typedef struct {
-	gboolean		 ret;
-	CdColorXYZ		*sample;
-	CdSensor		*sensor;
-	guint			 exit_id;
-	guint			 stdout_id;
-	guint			 timeout_id;
-} CdSensorTaskData;
+static gboolean cd_sensor_argyll_spawn (CdSensor *sensor, GError **error);
+
+static void
+cd_sensor_argyll_return_sample (CdSensor *sensor, CdColorXYZ *sample)
+{
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
+	g_autoptr(GTask) task = g_steal_pointer (&priv->task);
+
+	if (priv->timeout_id > 0) {
+		g_source_remove (priv->timeout_id);
+		priv->timeout_id = 0;
+	}
+	g_task_return_pointer (task, sample, (GDestroyNotify) cd_color_xyz_free);
+}
 
 static void
-cd_sensor_task_data_free (CdSensorTaskData *data)
+cd_sensor_argyll_return_error (CdSensor *sensor,
+			       CdSensorError code,
+			       const gchar *message)
 {
-	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (data->sensor);
-
-	/* disconnect handlers */
-	if (data->exit_id > 0)
-		g_signal_handler_disconnect (priv->spawn, data->exit_id);
-	if (data->stdout_id > 0)
-		g_signal_handler_disconnect (priv->spawn, data->stdout_id);
-	if (data->timeout_id > 0)
-		g_source_remove (data->timeout_id);
-	g_object_unref (data->sensor);
-	g_free (data);
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
+	g_autoptr(GTask) task = g_steal_pointer (&priv->task);
+
+	if (priv->timeout_id > 0) {
+		g_source_remove (priv->timeout_id);
+		priv->timeout_id = 0;
+	}
+	g_task_return_new_error (task, CD_SENSOR_ERROR, code, "%s", message);
 }
 
 static gboolean
-cd_sensor_get_sample_timeout_cb (GTask *task)
+cd_sensor_get_sample_timeout_cb (gpointer user_data)
 {
-	g_task_return_new_error (task,
-				 CD_SENSOR_ERROR,
-				 CD_SENSOR_ERROR_INTERNAL,
-				 "spotread timed out");
-	g_object_unref (task);
+	CdSensor *sensor = CD_SENSOR (user_data);
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
+
+	/* the process is in an unknown state now */
+	priv->timeout_id = 0;
+	cd_sensor_argyll_return_error (sensor, CD_SENSOR_ERROR_INTERNAL,
+				       "spotread timed out");
+	priv->state = CD_SENSOR_ARGYLL_STATE_STOPPING;
+	cd_spawn_kill (priv->spawn);
 	return G_SOURCE_REMOVE;
 }
 
 static void
-cd_sensor_get_sample_exit_cb (CdSpawn *spawn,
-			      CdSpawnExitType exit_type,
-			      GTask *task)
+cd_sensor_argyll_exit_cb (CdSpawn *spawn,
+			  CdSpawnExitType exit_type,
+			  CdSensor *sensor)
 {
-	g_task_return_new_error (task,
-				 CD_SENSOR_ERROR,
-				 CD_SENSOR_ERROR_INTERNAL,
-				 "spotread exited unexpectedly");
-	g_object_unref (task);
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
+	CdSensorArgyllState state = priv->state;
+	g_autoptr(GError) error = NULL;
+
+	priv->state = CD_SENSOR_ARGYLL_STATE_STOPPED;
+
+	/* killed by the unlock */
+	if (priv->unlock_task != NULL) {
+		g_autoptr(GTask) task = g_steal_pointer (&priv->unlock_task);
+		if (exit_type != CD_SPAWN_EXIT_TYPE_SIGTERM) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_INTERNAL,
+						 "exited without sigterm");
+			return;
+		}
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	/* nothing was waiting */
+	if (priv->task == NULL)
+		return;
+
+	/* restarted for a different display type or after a timeout */
+	if (state == CD_SENSOR_ARGYLL_STATE_STOPPING) {
+		if (!cd_sensor_argyll_spawn (sensor, &error)) {
+			cd_sensor_argyll_return_error (sensor,
+						       CD_SENSOR_ERROR_INTERNAL,
+						       error->message);
+		}
+		return;
+	}
+	cd_sensor_argyll_return_error (sensor, CD_SENSOR_ERROR_INTERNAL,
+				       "spotread exited unexpectedly");
+}
+
+/* reads three numbers after the label, allowing any spacing and commas */
+static gboolean
+cd_sensor_argyll_parse_xyz (const gchar *line, CdColorXYZ *xyz)
+{
+	const gchar *tmp;
+	gchar *endptr = NULL;
+	gdouble values[3];
+	guint i;
+
+	tmp = g_strstr_len (line, -1, "XYZ:");
+	if (tmp == NULL)
+		return FALSE;
+	tmp += 4;
+	for (i = 0; i < 3; i++) {
+		while (*tmp == ' ' || *tmp == ',' || *tmp == '\t')
+			tmp++;
+		values[i] = g_ascii_strtod (tmp, &endptr);
+		if (endptr == tmp)
+			return FALSE;
+		tmp = endptr;
+	}
+	cd_color_xyz_set (xyz, values[0], values[1], values[2]);
+	return TRUE;
 }
 
 static void
-cd_sensor_get_sample_stdout_cb (CdSpawn *spawn, const gchar *line, GTask *task)
+cd_sensor_argyll_stdout_cb (CdSpawn *spawn, const gchar *line, CdSensor *sensor)
 {
-	CdSensorTaskData *data = g_task_get_task_data (task);
-	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (data->sensor);
-	g_autoptr(GError) error = NULL;
-	g_auto(GStrv) parts = NULL;
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
 
 	g_debug ("line='%s'", line);
 
 	/* ready to go, no measurement */
 	if (g_str_has_prefix (line, "Place instrument on spot to be measured")) {
-		if (priv->pos_required == CD_SENSOR_ARGYLL_POS_UNKNOWN)
+		priv->state = CD_SENSOR_ARGYLL_STATE_READY;
+		if (priv->task != NULL &&
+		    priv->pos_required == CD_SENSOR_ARGYLL_POS_UNKNOWN) {
 			cd_spawn_send_stdin (spawn, "");
+			priv->state = CD_SENSOR_ARGYLL_STATE_MEASURING;
+		}
 		return;
 	}
 
@@ -121,36 +201,36 @@ cd_sensor_get_sample_stdout_cb (CdSpawn *spawn, const gchar *line, GTask *task)
 		return;
 	}
 
+	/* everything else is a reply to a request */
+	if (priv->task == NULL)
+		return;
+
 	/* got measurement */
 	if (g_str_has_prefix (line, " Result is XYZ:")) {
-		CdColorXYZ *sample;
-		parts = g_strsplit_set (line, " ,", -1);
-		sample = cd_color_xyz_new ();
-		sample->X = g_ascii_strtod (parts[4], NULL);
-		sample->Y = g_ascii_strtod (parts[5], NULL);
-		sample->Z = g_ascii_strtod (parts[6], NULL);
-		g_task_return_pointer (task, sample, (GDestroyNotify) cd_color_xyz_free);
-		g_object_unref (task);
+		g_autoptr(CdColorXYZ) sample = cd_color_xyz_new ();
+		if (!cd_sensor_argyll_parse_xyz (line, sample)) {
+			cd_sensor_argyll_return_error (sensor,
+						       CD_SENSOR_ERROR_INTERNAL,
+						       "failed to parse spotread result");
+			return;
+		}
+		cd_sensor_argyll_return_sample (sensor, g_steal_pointer (&sample));
 		return;
 	}
 
 	/* failed */
 	if (g_str_has_prefix (line, "Instrument initialisation failed")) {
-		g_task_return_new_error (task,
-					 CD_SENSOR_ERROR,
-					 CD_SENSOR_ERROR_INTERNAL,
-					 "failed to contact hardware (replug)");
-		g_object_unref (task);
+		cd_sensor_argyll_return_error (sensor,
+					       CD_SENSOR_ERROR_INTERNAL,
+					       "failed to contact hardware (replug)");
 		return;
 	}
 
 	/* need surface */
 	if (g_strcmp0 (line, "(Sensor should be in surface position)") == 0) {
-		g_task_return_new_error (task,
-					 CD_SENSOR_ERROR,
-					 CD_SENSOR_ERROR_REQUIRED_POSITION_SURFACE,
-					 "Move to surface position");
-		g_object_unref (task);
+		cd_sensor_argyll_return_error (sensor,
+					       CD_SENSOR_ERROR_REQUIRED_POSITION_SURFACE,
+					       "Move to surface position");
 		return;
 	}
 
@@ -164,11 +244,9 @@ cd_sensor_get_sample_stdout_cb (CdSpawn *spawn, const gchar *line, GTask *task)
 			priv->pos_required = CD_SENSOR_ARGYLL_POS_CALIBRATE;
 			return;
 		}
-		g_task_return_new_error (task,
-					 CD_SENSOR_ERROR,
-					 CD_SENSOR_ERROR_REQUIRED_POSITION_CALIBRATE,
-					 "Move to calibration position");
-		g_object_unref (task);
+		cd_sensor_argyll_return_error (sensor,
+					       CD_SENSOR_ERROR_REQUIRED_POSITION_CALIBRATE,
+					       "Move to calibration position");
 		return;
 	}
 }
@@ -211,6 +289,29 @@ cd_sensor_get_y_arg_for_cap (CdSensorCap cap)
 	return arg;
 }
 
+static gboolean
+cd_sensor_argyll_spawn (CdSensor *sensor, GError **error)
+{
+	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
+	const gchar *envp[] = { "ARGYLL_NOT_INTERACTIVE=1", NULL };
+	g_autoptr(GPtrArray) argv = NULL;
+
+	argv = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (argv, g_strdup ("spotread"));
+	g_ptr_array_add (argv, g_strdup ("-d"));
+	g_ptr_array_add (argv, g_strdup_printf ("-c%u", priv->communication_port));
+	g_ptr_array_add (argv, g_strdup ("-N")); //no autocal
+	g_ptr_array_add (argv, g_strdup (cd_sensor_get_y_arg_for_cap (priv->cap)));
+	g_ptr_array_add (argv, NULL);
+	if (!cd_spawn_argv (priv->spawn,
+			    (gchar **) argv->pdata,
+			    (gchar **) envp,
+			    error))
+		return FALSE;
+	priv->state = CD_SENSOR_ARGYLL_STATE_STARTING;
+	return TRUE;
+}
+
 void
 cd_sensor_get_sample_async (CdSensor *sensor,
 			    CdSensorCap cap,
@@ -219,63 +320,65 @@ cd_sensor_get_sample_async (CdSensor *sensor,
 			    gpointer user_data)
 {
 	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
-	CdSensorTaskData *data;
-	GTask *task = NULL;
-	const gchar *envp[] = { "ARGYLL_NOT_INTERACTIVE=1", NULL };
-	gboolean ret;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(GPtrArray) argv = NULL;
+	g_autoptr(GTask) task = NULL;
 
 	g_return_if_fail (CD_IS_SENSOR (sensor));
 
 	task = g_task_new (sensor, cancellable, callback, user_data);
 
-	/* set state */
-	data = g_new0 (CdSensorTaskData, 1);
-	data->sensor = g_object_ref (sensor);
-	g_task_set_task_data (task, data, (GDestroyNotify) cd_sensor_task_data_free);
+	/* spotread only handles one request at a time */
+	if (priv->task != NULL || priv->unlock_task != NULL) {
+		g_task_return_new_error (task,
+					 CD_SENSOR_ERROR,
+					 CD_SENSOR_ERROR_IN_USE,
+					 "spotread is busy");
+		return;
+	}
+	priv->task = g_steal_pointer (&task);
 
 	/* set state */
 	cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
 
-	/* connect before spotread produces values */
-	data->exit_id = g_signal_connect (priv->spawn,
-					  "exit",
-					  G_CALLBACK (cd_sensor_get_sample_exit_cb),
-					  task);
-	data->stdout_id = g_signal_connect (priv->spawn,
-					    "stdout",
-					    G_CALLBACK (cd_sensor_get_sample_stdout_cb),
-					    task);
-
-	/* if spotread is not already running then execute */
-	if (!cd_spawn_is_running (priv->spawn)) {
-		argv = g_ptr_array_new_with_free_func (g_free);
-		g_ptr_array_add (argv, g_strdup ("spotread"));
-		g_ptr_array_add (argv, g_strdup ("-d"));
-		g_ptr_array_add (argv, g_strdup_printf ("-c%u", priv->communication_port));
-		g_ptr_array_add (argv, g_strdup ("-N")); //no autocal
-		g_ptr_array_add (argv, g_strdup (cd_sensor_get_y_arg_for_cap (cap)));
-		g_ptr_array_add (argv, NULL);
-		ret = cd_spawn_argv (priv->spawn,
-				     (gchar **) argv->pdata,
-				     (gchar **) envp,
-				     &error);
-		if (!ret) {
-			g_task_return_new_error (task,
-						 CD_SENSOR_ERROR,
-						 CD_SENSOR_ERROR_INTERNAL,
-						 "%s", error->message);
-			return;
+	/* cover the case where spotread crashes */
+	priv->timeout_id = g_timeout_add (CD_SENSOR_ARGYLL_MAX_SAMPLE_TIME,
+					  cd_sensor_get_sample_timeout_cb,
+					  sensor);
+
+	switch (priv->state) {
+	case CD_SENSOR_ARGYLL_STATE_STOPPED:
+		priv->cap = cap;
+		if (!cd_sensor_argyll_spawn (sensor, &error)) {
+			cd_sensor_argyll_return_error (sensor,
+						       CD_SENSOR_ERROR_INTERNAL,
+						       error->message);
+		}
+		break;
+	case CD_SENSOR_ARGYLL_STATE_READY:
+		/* the display type is fixed when spotread starts */
+		if (cap != priv->cap) {
+			priv->cap = cap;
+			priv->state = CD_SENSOR_ARGYLL_STATE_STOPPING;
+			cd_spawn_kill (priv->spawn);
+			break;
 		}
-	} else {
 		cd_spawn_send_stdin (priv->spawn, "");
+		priv->state = CD_SENSOR_ARGYLL_STATE_MEASURING;
+		break;
+	case CD_SENSOR_ARGYLL_STATE_STARTING:
+		/* already started for the old display type, so restart */
+		if (cap != priv->cap) {
+			priv->cap = cap;
+			priv->state = CD_SENSOR_ARGYLL_STATE_STOPPING;
+			cd_spawn_kill (priv->spawn);
+		}
+		/* otherwise sent as soon as the first prompt is shown */
+		break;
+	default:
+		/* used when the exit handler restarts spotread */
+		priv->cap = cap;
+		break;
 	}
-
-	/* cover the case where spotread crashes */
-	data->timeout_id = g_timeout_add (CD_SENSOR_ARGYLL_MAX_SAMPLE_TIME,
-					  (GSourceFunc) cd_sensor_get_sample_timeout_cb,
-					  task);
 }
 
 CdColorXYZ *
@@ -288,6 +391,10 @@ cd_sensor_get_sample_finish (CdSensor *sensor, GAsyncResult *res, GError **error
 static void
 cd_sensor_unref_private (CdSensorArgyllPrivate *priv)
 {
+	g_signal_handler_disconnect (priv->spawn, priv->exit_id);
+	g_signal_handler_disconnect (priv->spawn, priv->stdout_id);
+	if (priv->timeout_id > 0)
+		g_source_remove (priv->timeout_id);
 	g_object_unref (priv->spawn);
 	g_free (priv);
 }
@@ -413,25 +520,6 @@ cd_sensor_find_device_details (CdSensor *sensor, GError **error)
 	return TRUE;
 }
 
-static void
-cd_sensor_unlock_exit_cb (CdSpawn *spawn,
-			  CdSpawnExitType exit_type,
-			  GTask *task)
-{
-	if (exit_type != CD_SPAWN_EXIT_TYPE_SIGTERM) {
-		g_task_return_new_error (task,
-					 CD_SENSOR_ERROR,
-					 CD_SENSOR_ERROR_INTERNAL,
-					 "exited without sigterm");
-		g_object_unref (task);
-		return;
-	}
-
-	/* success */
-	g_task_return_boolean (task, TRUE);
-	g_object_unref (task);
-}
-
 void
 cd_sensor_unlock_async (CdSensor *sensor,
 			GCancellable *cancellable,
@@ -439,32 +527,28 @@ cd_sensor_unlock_async (CdSensor *sensor,
 			gpointer user_data)
 {
 	CdSensorArgyllPrivate *priv = cd_sensor_argyll_get_private (sensor);
-	CdSensorTaskData *data;
-	GTask *task = NULL;
+	g_autoptr(GTask) task = NULL;
 
 	g_return_if_fail (CD_IS_SENSOR (sensor));
 
 	task = g_task_new (sensor, cancellable, callback, user_data);
 
-	/* set state */
-	data = g_new0 (CdSensorTaskData, 1);
-	data->sensor = g_object_ref (sensor);
-	g_task_set_task_data (task, data, (GDestroyNotify) cd_sensor_task_data_free);
+	/* never started */
+	if (priv->state == CD_SENSOR_ARGYLL_STATE_STOPPED) {
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
 
-	/* wait for exit */
-	data->exit_id = g_signal_connect (priv->spawn,
-					  "exit",
-					  G_CALLBACK (cd_sensor_unlock_exit_cb),
-					  task);
-	/* kill spotread */
+	/* kill spotread, and wait for exit */
 	if (!cd_spawn_kill (priv->spawn)) {
 		g_task_return_new_error (task,
 					 CD_SENSOR_ERROR,
 					 CD_SENSOR_ERROR_INTERNAL,
 					 "failed to kill spotread");
-		g_object_unref (task);
 		return;
 	}
+	priv->state = CD_SENSOR_ARGYLL_STATE_STOPPING;
+	priv->unlock_task = g_steal_pointer (&task);
 }
 
 gboolean
@@ -481,6 +565,17 @@ cd_sensor_coldplug (CdSensor *sensor, GError **error)
 	g_object_set_data_full (G_OBJECT (sensor), "priv", priv,
 				(GDestroyNotify) cd_sensor_unref_private);
 
+	/* spotread keeps running between samples, so watch it for the
+	 * lifetime of the sensor */
+	priv->exit_id = g_signal_connect (priv->spawn,
+					  "exit",
+					  G_CALLBACK (cd_sensor_argyll_exit_cb),
+					  sensor);
+	priv->stdout_id = g_signal_connect (priv->spawn,
+					    "stdout",
+					    G_CALLBACK (cd_sensor_argyll_stdout_cb),
+					    sensor);
+
 	/* try to map find the correct communication port */
 	return cd_sensor_find_device_details (sensor, error);
 }
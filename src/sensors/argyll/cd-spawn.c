@@ -39,13 +39,13 @@
 #include <fcntl.h>
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #include "cd-spawn.h"
 
 static void     cd_spawn_finalize	(GObject       *object);
 
 #define CD_SPAWN_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), CD_TYPE_SPAWN, CdSpawnPrivate))
-#define CD_SPAWN_POLL_DELAY	50 /* ms */
 #define CD_SPAWN_SIGKILL_DELAY	2500 /* ms */
 
 struct CdSpawnPrivate
@@ -54,12 +54,15 @@ struct CdSpawnPrivate
 	gint			 stdin_fd;
 	gint			 stdout_fd;
 	gint			 stderr_fd;
-	guint			 poll_id;
+	guint			 stdout_id;
+	guint			 stderr_id;
+	guint			 child_id;
 	guint			 kill_id;
 	gboolean		 finished;
 	gboolean		 allow_sigkill;
 	CdSpawnExitType		 exit;
 	GString			*stdout_buf;
+	gsize			 stdout_scanned;	/* bytes known to have no newline */
 	GString			*stderr_buf;
 };
 
@@ -77,49 +80,79 @@ G_DEFINE_TYPE (CdSpawn, cd_spawn, G_TYPE_OBJECT)
 static gboolean
 cd_spawn_read_fd_into_buffer (gint fd, GString *string)
 {
-	gint bytes_read;
+	gssize bytes_read;
 	gchar buffer[BUFSIZ];
 
-	/* ITS4: ignore, we manually NULL terminate and GString cannot overflow */
-	while ((bytes_read = read (fd, buffer, BUFSIZ-1)) > 0) {
-		buffer[bytes_read] = '\0';
-		g_string_append (string, buffer);
-	}
-
-	return TRUE;
+	/* returns FALSE when the other end has been closed */
+	while ((bytes_read = read (fd, buffer, BUFSIZ)) > 0)
+		g_string_append_len (string, buffer, bytes_read);
+	return bytes_read != 0;
 }
 
-static gboolean
+static void
 cd_spawn_emit_whole_lines (CdSpawn *spawn, GString *string)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	g_auto(GStrv) lines = NULL;
+	const gchar *nl;
+	gsize start = 0;
+
+	/* only scan what was appended since last time, the last line may
+	 * still be incomplete */
+	nl = memchr (string->str + spawn->priv->stdout_scanned, '\n',
+		     string->len - spawn->priv->stdout_scanned);
+	while (nl != NULL) {
+		gsize end = nl - string->str;
+		string->str[end] = '\0';
+		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, string->str + start);
+		start = end + 1;
+		nl = memchr (string->str + start, '\n', string->len - start);
+	}
 
-	/* if nothing then don't emit */
-	if (string->len == 0)
-		return FALSE;
+	/* remove the text we've processed */
+	if (start > 0)
+		g_string_erase (string, 0, start);
+	spawn->priv->stdout_scanned = string->len;
+}
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
-		return FALSE;
+static void
+cd_spawn_emit_stderr (CdSpawn *spawn)
+{
+	/* emit all lines on standard out in one callback, as it's all probably
+	* related to the error that just happened */
+	if (spawn->priv->stderr_buf->len != 0) {
+		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
+		g_string_set_size (spawn->priv->stderr_buf, 0);
+	}
+}
 
-	/* find size */
-	size = g_strv_length (lines);
+static gboolean
+cd_spawn_stdout_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	CdSpawn *spawn = CD_SPAWN (user_data);
+	gboolean ret;
 
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
+	/* all usual output goes on standard out, only bad libraries bitch to stderr */
+	ret = cd_spawn_read_fd_into_buffer (fd, spawn->priv->stdout_buf);
+	cd_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
+	if (!ret || (condition & (G_IO_HUP | G_IO_ERR)) > 0) {
+		spawn->priv->stdout_id = 0;
+		return G_SOURCE_REMOVE;
 	}
+	return G_SOURCE_CONTINUE;
+}
 
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
-	return TRUE;
+static gboolean
+cd_spawn_stderr_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	CdSpawn *spawn = CD_SPAWN (user_data);
+	gboolean ret;
+
+	ret = cd_spawn_read_fd_into_buffer (fd, spawn->priv->stderr_buf);
+	cd_spawn_emit_stderr (spawn);
+	if (!ret || (condition & (G_IO_HUP | G_IO_ERR)) > 0) {
+		spawn->priv->stderr_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
 }
 
 static const gchar *
@@ -136,58 +169,36 @@ cd_spawn_exit_type_enum_to_string (CdSpawnExitType type)
 	return "unknown";
 }
 
-static gboolean
-cd_spawn_check_child (CdSpawn *spawn)
+static void
+cd_spawn_child_exited_cb (GPid pid, gint status, gpointer user_data)
 {
-	pid_t pid;
-	int status;
+	CdSpawn *spawn = CD_SPAWN (user_data);
 	gint retval;
-	static guint limit_printing = 0;
+
+	/* the source is destroyed after this callback returns */
+	spawn->priv->child_id = 0;
 
 	/* this shouldn't happen */
 	if (spawn->priv->finished) {
 		g_warning ("finished twice!");
-		return G_SOURCE_REMOVE;
+		return;
 	}
 
+	/* disconnect the fd watches as there will be no more updates, but
+	 * first get anything the child wrote just before exiting */
 	cd_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
 	cd_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
-
-	/* emit all lines on standard out in one callback, as it's all probably
-	* related to the error that just happened */
-	if (spawn->priv->stderr_buf->len != 0) {
-		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
-		g_string_set_size (spawn->priv->stderr_buf, 0);
-	}
-
-	/* all usual output goes on standard out, only bad libraries bitch to stderr */
+	cd_spawn_emit_stderr (spawn);
 	cd_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
-
-	/* Only print one in twenty times to avoid filling the screen */
-	if (limit_printing++ % 20 == 0)
-		g_debug ("polling child_pid=%ld (1/20)", (long)spawn->priv->child_pid);
-
-	/* check if the child exited */
-	pid = waitpid (spawn->priv->child_pid, &status, WNOHANG);
-	if (pid == -1) {
-		g_warning ("failed to get the child PID data for %ld", (long)spawn->priv->child_pid);
-		return G_SOURCE_CONTINUE;
-	}
-	if (pid == 0) {
-		/* process still exist, but has not changed state */
-		return G_SOURCE_CONTINUE;
+	if (spawn->priv->stdout_id != 0) {
+		g_source_remove (spawn->priv->stdout_id);
+		spawn->priv->stdout_id = 0;
 	}
-	if (pid != spawn->priv->child_pid) {
-		g_warning ("some other process id was returned: got %ld and wanted %ld",
-			     (long)pid, (long)spawn->priv->child_pid);
-		return G_SOURCE_CONTINUE;
-	}
-
-	/* disconnect the poll as there will be no more updates */
-	if (spawn->priv->poll_id > 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
+	if (spawn->priv->stderr_id != 0) {
+		g_source_remove (spawn->priv->stderr_id);
+		spawn->priv->stderr_id = 0;
 	}
+	g_spawn_close_pid (pid);
 
 	/* child exited, close resources */
 	close (spawn->priv->stdin_fd);
@@ -212,12 +223,6 @@ cd_spawn_check_child (CdSpawn *spawn)
 			spawn->priv->exit = CD_SPAWN_EXIT_TYPE_SIGKILL;
 		}
 	} else {
-		/* check we are dead and buried */
-		if (!WIFEXITED (status)) {
-			g_warning ("the process did not exit, but waitpid() returned!");
-			return G_SOURCE_CONTINUE;
-		}
-
 		/* get the exit code */
 		retval = WEXITSTATUS (status);
 		if (retval == 0) {
@@ -246,7 +251,6 @@ cd_spawn_check_child (CdSpawn *spawn)
 	/* don't emit if we just closed an invalid dispatcher */
 	g_debug ("emitting exit %s", cd_spawn_exit_type_enum_to_string (spawn->priv->exit));
 	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
-	return G_SOURCE_REMOVE;
 }
 
 static gboolean
@@ -432,14 +436,25 @@ cd_spawn_argv (CdSpawn *spawn, gchar **argv, gchar **envp, GError **error)
 	}
 
 	/* sanity check */
-	if (spawn->priv->poll_id != 0) {
-		g_warning ("trying to set timeout when already set");
-		g_source_remove (spawn->priv->poll_id);
+	if (spawn->priv->child_id != 0) {
+		g_warning ("trying to watch child when already set");
+		g_source_remove (spawn->priv->child_id);
 	}
 
-	/* poll quickly */
-	spawn->priv->poll_id = g_timeout_add (CD_SPAWN_POLL_DELAY, (GSourceFunc) cd_spawn_check_child, spawn);
-	g_source_set_name_by_id (spawn->priv->poll_id, "[CdSpawn] main poll");
+	/* woken up only when there is output or the child exits */
+	g_string_set_size (spawn->priv->stdout_buf, 0);
+	spawn->priv->stdout_scanned = 0;
+	spawn->priv->stdout_id = g_unix_fd_add (spawn->priv->stdout_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						cd_spawn_stdout_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stdout_id, "[CdSpawn] stdout");
+	spawn->priv->stderr_id = g_unix_fd_add (spawn->priv->stderr_fd,
+						G_IO_IN | G_IO_HUP | G_IO_ERR,
+						cd_spawn_stderr_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->stderr_id, "[CdSpawn] stderr");
+	spawn->priv->child_id = g_child_watch_add (spawn->priv->child_pid,
+						   cd_spawn_child_exited_cb, spawn);
+	g_source_set_name_by_id (spawn->priv->child_id, "[CdSpawn] child");
 	return TRUE;
 }
 
@@ -497,10 +512,18 @@ cd_spawn_finalize (GObject *object)
 
 	g_return_if_fail (spawn->priv != NULL);
 
-	/* disconnect the poll in case we were cancelled before completion */
-	if (spawn->priv->poll_id != 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
+	/* disconnect the watches in case we were cancelled before completion */
+	if (spawn->priv->stdout_id != 0) {
+		g_source_remove (spawn->priv->stdout_id);
+		spawn->priv->stdout_id = 0;
+	}
+	if (spawn->priv->stderr_id != 0) {
+		g_source_remove (spawn->priv->stderr_id);
+		spawn->priv->stderr_id = 0;
+	}
+	if (spawn->priv->child_id != 0) {
+		g_source_remove (spawn->priv->child_id);
+		spawn->priv->child_id = 0;
 	}
 
 	/* disconnect the SIGKILL check */
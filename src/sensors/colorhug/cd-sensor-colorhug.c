@@ -29,16 +29,25 @@
 
 #include "cd-sensor.h"
 
+/* in adaptive mode patches are measured with the short time first, and only
+ * measured again with the full integral time if they are darker than this */
+#define CD_SENSOR_COLORHUG_INTEGRAL_TIME_SHORT	CH_INTEGRAL_TIME_VALUE_100MS
+#define CD_SENSOR_COLORHUG_ADAPTIVE_MIN_Y	5.f /* cd/m^2 */
+
 typedef struct
 {
 	GUsbDevice			*device;
 	ChDeviceQueue			*device_queue;
+	gboolean			 integral_time_adaptive;
+	guint16				 integral_time;
 } CdSensorColorhugPrivate;
 
 /* async task for the sensor readings */
 typedef struct {
 	CdSensor			*sensor;
 	CdColorXYZ			 xyz;
+	guint16				 calibration_index;
+	guint16				 integral_time;
 	guint32				 serial_number;
 	ChSha1				 sha1;
 } CdSensorTaskData;
@@ -58,6 +67,9 @@ cd_sensor_task_data_free (CdSensorTaskData *data)
 	g_free (data);
 }
 
+static void
+cd_sensor_colorhug_queue_reading (GTask *task, guint16 integral_time);
+
 static void
 cd_sensor_colorhug_get_sample_cb (GObject *object,
 				  GAsyncResult *res,
@@ -79,12 +91,47 @@ cd_sensor_colorhug_get_sample_cb (GObject *object,
 	g_debug ("finished values: red=%0.6lf, green=%0.6lf, blue=%0.6lf",
 		 data->xyz.X, data->xyz.Y, data->xyz.Z);
 
+	/* too dark to trust the short reading */
+	if (data->integral_time < CH_INTEGRAL_TIME_VALUE_MAX &&
+	    data->xyz.Y < CD_SENSOR_COLORHUG_ADAPTIVE_MIN_Y) {
+		g_debug ("Y=%0.3lf below threshold, using full integral time",
+			 data->xyz.Y);
+		cd_sensor_colorhug_queue_reading (task, CH_INTEGRAL_TIME_VALUE_MAX);
+		return;
+	}
+
 	/* save result */
 	g_task_return_pointer (task,
 			       cd_color_xyz_dup (&data->xyz),
 			       (GDestroyNotify) cd_color_xyz_free);
 }
 
+static void
+cd_sensor_colorhug_queue_reading (GTask *task, guint16 integral_time)
+{
+	CdSensorTaskData *data = g_task_get_task_data (task);
+	CdSensorColorhugPrivate *priv = cd_sensor_colorhug_get_private (data->sensor);
+
+	/* only the original ColorHug has a configurable integral time */
+	if (cd_sensor_get_kind (data->sensor) != CD_SENSOR_KIND_COLORHUG) {
+		integral_time = CH_INTEGRAL_TIME_VALUE_MAX;
+	} else if (priv->integral_time != integral_time) {
+		ch_device_queue_set_integral_time (priv->device_queue,
+						   priv->device,
+						   integral_time);
+		priv->integral_time = integral_time;
+	}
+	data->integral_time = integral_time;
+	ch_device_queue_take_readings_xyz (priv->device_queue,
+					   priv->device,
+					   data->calibration_index,
+					   &data->xyz);
+	ch_device_queue_process_async (priv->device_queue,
+				       CH_DEVICE_QUEUE_PROCESS_FLAGS_NONE,
+				       g_task_get_cancellable (task),
+				       cd_sensor_colorhug_get_sample_cb,
+				       g_object_ref (task));
+}
 
 void
 cd_sensor_get_sample_async (CdSensor *sensor,
@@ -131,19 +178,14 @@ cd_sensor_get_sample_async (CdSensor *sensor,
 	/* set state */
 	data = g_new0 (CdSensorTaskData, 1);
 	data->sensor = g_object_ref (sensor);
+	data->calibration_index = calibration_index;
 	g_task_set_task_data (task, data, (GDestroyNotify) cd_sensor_task_data_free);
 
 	/* request */
 	cd_sensor_set_state (sensor, CD_SENSOR_STATE_STARTING);
-	ch_device_queue_take_readings_xyz (priv->device_queue,
-					   priv->device,
-					   calibration_index,
-					   &data->xyz);
-	ch_device_queue_process_async (priv->device_queue,
-				       CH_DEVICE_QUEUE_PROCESS_FLAGS_NONE,
-				       g_task_get_cancellable (task),
-				       cd_sensor_colorhug_get_sample_cb,
-				       g_object_ref (task));
+	cd_sensor_colorhug_queue_reading (task, priv->integral_time_adaptive ?
+						CD_SENSOR_COLORHUG_INTEGRAL_TIME_SHORT :
+						CH_INTEGRAL_TIME_VALUE_MAX);
 }
 
 CdColorXYZ *
@@ -275,6 +317,7 @@ cd_sensor_lock_async (CdSensor *sensor,
 		ch_device_queue_set_integral_time (priv->device_queue,
 						   priv->device,
 						   CH_INTEGRAL_TIME_VALUE_MAX);
+		priv->integral_time = CH_INTEGRAL_TIME_VALUE_MAX;
 		ch_device_queue_set_multiplier (priv->device_queue,
 						priv->device,
 						CH_FREQ_SCALE_100);
@@ -465,9 +508,31 @@ cd_sensor_set_options_async (CdSensor *sensor,
 			     GAsyncReadyCallback callback,
 			     gpointer user_data)
 {
+	CdSensorColorhugPrivate *priv = cd_sensor_colorhug_get_private (sensor);
+	GVariant *value;
 	g_autoptr(GTask) task = NULL;
 	g_return_if_fail (CD_IS_SENSOR (sensor));
 	task = g_task_new (sensor, cancellable, callback, user_data);
+
+	/* this only affects the daemon, so is not saved to the EEPROM */
+	value = g_hash_table_lookup (options, "integral-time-adaptive");
+	if (value != NULL) {
+		if (!g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_INTERNAL,
+						 "integral-time-adaptive needs a boolean");
+			return;
+		}
+		priv->integral_time_adaptive = g_variant_get_boolean (value);
+		cd_sensor_add_option (sensor, "integral-time-adaptive", value);
+		g_hash_table_remove (options, "integral-time-adaptive");
+		if (g_hash_table_size (options) == 0) {
+			g_task_return_boolean (task, TRUE);
+			return;
+		}
+	}
+
 	g_task_set_task_data (task,
 			      g_hash_table_ref (options),
 			      (GDestroyNotify) g_hash_table_unref);
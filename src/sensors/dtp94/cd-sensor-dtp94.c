@@ -34,6 +34,7 @@
 typedef struct
 {
 	GUsbDevice			*device;
+	gboolean			 setup_done;	/* survives unlocking */
 } CdSensorDtp94Private;
 
 #define DTP94_CONTROL_MESSAGE_TIMEOUT	50000 /* ms */
@@ -45,28 +46,27 @@ cd_sensor_dtp94_get_private (CdSensor *sensor)
 }
 
 static void
-cd_sensor_dtp94_sample_thread_cb (GTask *task,
-				  gpointer source_object,
-				  gpointer task_data,
-				  GCancellable *cancellable)
+cd_sensor_dtp94_sample_cb (GObject *source,
+			   GAsyncResult *res,
+			   gpointer user_data)
 {
-	CdSensor *sensor = CD_SENSOR (source_object);
-	CdSensorCap cap = GPOINTER_TO_UINT (task_data);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(GError) error = NULL;
+	CdSensor *sensor = CD_SENSOR (g_task_get_source_object (task));
 	CdSensorDtp94Private *priv = cd_sensor_dtp94_get_private (sensor);
 	CdColorXYZ *sample;
-	g_autoptr(GError) error = NULL;
 
-	/* take a measurement from the sensor */
-	cd_sensor_set_state_in_idle (sensor, CD_SENSOR_STATE_MEASURING);
-	sample = dtp94_device_take_sample (priv->device, cap, &error);
+	sample = dtp94_device_take_sample_finish (G_USB_DEVICE (source), res, &error);
 	if (sample == NULL) {
+		/* something else may have changed the settings */
+		priv->setup_done = FALSE;
 		g_task_return_new_error (task,
 					 CD_SENSOR_ERROR,
 					 CD_SENSOR_ERROR_NO_DATA,
 					 "%s", error->message);
 		return;
 	}
-	g_task_return_pointer (task, sample, NULL);
+	g_task_return_pointer (task, sample, (GDestroyNotify) cd_color_xyz_free);
 }
 
 void
@@ -76,11 +76,19 @@ cd_sensor_get_sample_async (CdSensor *sensor,
 			    GAsyncReadyCallback callback,
 			    gpointer user_data)
 {
-	g_autoptr(GTask) task = NULL;
+	CdSensorDtp94Private *priv = cd_sensor_dtp94_get_private (sensor);
+	GTask *task = NULL;
+
 	g_return_if_fail (CD_IS_SENSOR (sensor));
+
+	/* take a measurement from the sensor without tying up a thread */
 	task = g_task_new (sensor, cancellable, callback, user_data);
-	g_task_set_task_data (task, GUINT_TO_POINTER (cap), NULL);
-	g_task_run_in_thread (task, cd_sensor_dtp94_sample_thread_cb);
+	cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
+	dtp94_device_take_sample_async (priv->device,
+					cap,
+					cancellable,
+					cd_sensor_dtp94_sample_cb,
+					task);
 }
 
 CdColorXYZ *
@@ -114,6 +122,12 @@ cd_sensor_dtp94_lock_thread_cb (GTask *task,
 		return;
 	}
 
+	/* the device keeps its settings while plugged in */
+	if (priv->setup_done) {
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
 	/* set state */
 	cd_sensor_set_state_in_idle (sensor, CD_SENSOR_STATE_STARTING);
 
@@ -136,6 +150,7 @@ cd_sensor_dtp94_lock_thread_cb (GTask *task,
 		return;
 	}
 	cd_sensor_set_serial (sensor, serial);
+	priv->setup_done = TRUE;
 
 	/* success */
 	g_task_return_boolean (task, TRUE);
@@ -41,6 +41,9 @@
 #define DTP94_MAX_READ_RETRIES		5
 #define DTP94_CONTROL_MESSAGE_TIMEOUT	50000 /* ms */
 
+/* the mode command last accepted, so it is only sent when it changes */
+#define DTP94_DEVICE_MODE_KEY		"dtp94-mode"
+
 /**
  * dtp94_device_error_quark:
  **/
@@ -115,30 +118,9 @@ dtp94_device_send_data (GUsbDevice *device,
 }
 
 static gboolean
-dtp94_device_send_cmd_issue (GUsbDevice *device,
-			     const gchar *command,
-			     GError **error)
+dtp94_device_check_cmd_reply (guint8 *buffer, gsize reply_read, GError **error)
 {
-	gboolean ret;
-	gsize reply_read;
-	guint8 buffer[128];
 	guint8 rc;
-	guint command_len;
-
-	g_return_val_if_fail (G_USB_IS_DEVICE (device), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	/* sent command raw */
-	command_len = strlen (command);
-	ret = dtp94_device_send_data (device,
-				      (const guint8 *) command,
-				      command_len,
-				      buffer,
-				      sizeof (buffer),
-				      &reply_read,
-				      error);
-	if (!ret)
-		return FALSE;
 
 	/* device busy */
 	rc = dtp94_rc_parse (buffer, reply_read);
@@ -164,6 +146,34 @@ dtp94_device_send_cmd_issue (GUsbDevice *device,
 	return TRUE;
 }
 
+static gboolean
+dtp94_device_send_cmd_issue (GUsbDevice *device,
+			     const gchar *command,
+			     GError **error)
+{
+	gboolean ret;
+	gsize reply_read;
+	guint8 buffer[128];
+	guint command_len;
+
+	g_return_val_if_fail (G_USB_IS_DEVICE (device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* sent command raw */
+	command_len = strlen (command);
+	ret = dtp94_device_send_data (device,
+				      (const guint8 *) command,
+				      command_len,
+				      buffer,
+				      sizeof (buffer),
+				      &reply_read,
+				      error);
+	if (!ret)
+		return FALSE;
+
+	return dtp94_device_check_cmd_reply (buffer, reply_read, error);
+}
+
 /**
  * dtp94_device_send_cmd:
  *
@@ -212,6 +222,9 @@ dtp94_device_setup (GUsbDevice *device, GError **error)
 	g_return_val_if_fail (G_USB_IS_DEVICE (device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* the reset forgets the mode */
+	g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY, NULL);
+
 	/* reset device */
 	if (!dtp94_device_send_cmd (device, "0PR\r", error))
 		return FALSE;
@@ -247,53 +260,29 @@ dtp94_device_setup (GUsbDevice *device, GError **error)
 	return TRUE;
 }
 
-/**
- * dtp94_device_take_sample:
- *
- * Since: 0.1.29
- **/
-CdColorXYZ *
-dtp94_device_take_sample (GUsbDevice *device, CdSensorCap cap, GError **error)
+static const gchar *
+dtp94_device_get_mode_cmd (CdSensorCap cap)
 {
-	CdColorXYZ *result = NULL;
-	gboolean ret = FALSE;
-	gchar *tmp;
-	gsize reply_read;
-	guint8 buffer[128];
-
-	g_return_val_if_fail (G_USB_IS_DEVICE (device), NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* set hardware support */
 	switch (cap) {
 	case CD_SENSOR_CAP_CRT:
 	case CD_SENSOR_CAP_PLASMA:
 		/* CRT = 01 */
-		ret = dtp94_device_send_cmd (device, "0116CF\r", error);
-		break;
+		return "0116CF\r";
 	case CD_SENSOR_CAP_LCD:
 		/* LCD = 02 */
-		ret = dtp94_device_send_cmd (device, "0216CF\r", error);
-		break;
+		return "0216CF\r";
 	default:
-		g_set_error (error,
-			     DTP94_DEVICE_ERROR,
-			     DTP94_DEVICE_ERROR_NO_SUPPORT,
-			     "DTP94 cannot measure in %s mode",
-			     cd_sensor_cap_to_string (cap));
 		break;
 	}
-	if (!ret)
-		return NULL;
+	return NULL;
+}
+
+static CdColorXYZ *
+dtp94_device_parse_sample (guint8 *buffer, gsize reply_read, GError **error)
+{
+	CdColorXYZ *result;
+	gchar *tmp;
 
-	/* get sample */
-	ret = dtp94_device_send_data (device,
-				      (const guint8 *) "RM\r", 3,
-				      buffer, sizeof (buffer),
-				      &reply_read,
-				      error);
-	if (!ret)
-		return NULL;
 	tmp = g_strstr_len ((const gchar *) buffer, reply_read, "\r");
 	if (tmp == NULL || memcmp (tmp + 1, "<00>", 4) != 0) {
 		buffer[reply_read] = '\0';
@@ -319,6 +308,242 @@ dtp94_device_take_sample (GUsbDevice *device, CdSensorCap cap, GError **error)
 	return result;
 }
 
+/* the mode command is retried while the device is busy, then the
+ * reading is fetched; each step is a write followed by a read */
+typedef struct {
+	const gchar	*command;
+	guint8		 buffer[129];
+	guint		 retries;
+	gboolean	 reading;
+} Dtp94DeviceSampleHelper;
+
+static void dtp94_device_take_sample_write (GTask *task);
+
+static void
+dtp94_device_take_sample_read_cb (GObject *source,
+				  GAsyncResult *res,
+				  gpointer user_data)
+{
+	GUsbDevice *device = G_USB_DEVICE (source);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	Dtp94DeviceSampleHelper *helper = g_task_get_task_data (task);
+	CdColorXYZ *result;
+	gssize reply_read;
+	GError *error = NULL;
+
+	reply_read = g_usb_device_interrupt_transfer_finish (device, res, &error);
+	if (reply_read < 0) {
+		g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY, NULL);
+		g_task_return_error (task, error);
+		return;
+	}
+	if (reply_read == 0) {
+		g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY, NULL);
+		g_task_return_new_error (task,
+					 DTP94_DEVICE_ERROR,
+					 DTP94_DEVICE_ERROR_INTERNAL,
+					 "failed to get data from device");
+		return;
+	}
+	cd_buffer_debug (CD_BUFFER_KIND_RESPONSE,
+			 helper->buffer, (gsize) reply_read);
+
+	/* got the reading */
+	if (helper->reading) {
+		result = dtp94_device_parse_sample (helper->buffer,
+						    (gsize) reply_read,
+						    &error);
+		if (result == NULL) {
+			g_task_return_error (task, error);
+			return;
+		}
+		g_task_return_pointer (task, result,
+				       (GDestroyNotify) cd_color_xyz_free);
+		return;
+	}
+
+	/* repeat until the device is ready */
+	if (!dtp94_device_check_cmd_reply (helper->buffer,
+					   (gsize) reply_read,
+					   &error)) {
+		if (helper->retries++ < DTP94_MAX_READ_RETRIES &&
+		    g_error_matches (error,
+				     DTP94_DEVICE_ERROR,
+				     DTP94_DEVICE_ERROR_NO_DATA)) {
+			g_debug ("ignoring %s", error->message);
+			g_clear_error (&error);
+			dtp94_device_take_sample_write (g_steal_pointer (&task));
+			return;
+		}
+		g_task_return_error (task, error);
+		return;
+	}
+	g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY,
+			   (gpointer) helper->command);
+
+	/* get sample */
+	helper->command = "RM\r";
+	helper->reading = TRUE;
+	dtp94_device_take_sample_write (g_steal_pointer (&task));
+}
+
+static void
+dtp94_device_take_sample_write_cb (GObject *source,
+				   GAsyncResult *res,
+				   gpointer user_data)
+{
+	GUsbDevice *device = G_USB_DEVICE (source);
+	GTask *task = G_TASK (user_data);
+	Dtp94DeviceSampleHelper *helper = g_task_get_task_data (task);
+	GError *error = NULL;
+
+	if (g_usb_device_interrupt_transfer_finish (device, res, &error) < 0) {
+		g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY, NULL);
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	/* leave room for the NUL used when reporting errors */
+	g_usb_device_interrupt_transfer_async (device,
+					       0x81,
+					       helper->buffer,
+					       sizeof (helper->buffer) - 1,
+					       DTP94_CONTROL_MESSAGE_TIMEOUT,
+					       g_task_get_cancellable (task),
+					       dtp94_device_take_sample_read_cb,
+					       task);
+}
+
+static void
+dtp94_device_take_sample_write (GTask *task)
+{
+	GUsbDevice *device = g_task_get_source_object (task);
+	Dtp94DeviceSampleHelper *helper = g_task_get_task_data (task);
+	gsize command_len = strlen (helper->command);
+
+	cd_buffer_debug (CD_BUFFER_KIND_REQUEST,
+			 (const guint8 *) helper->command, command_len);
+	g_usb_device_interrupt_transfer_async (device,
+					       0x2,
+					       (guint8 *) helper->command,
+					       command_len,
+					       DTP94_CONTROL_MESSAGE_TIMEOUT,
+					       g_task_get_cancellable (task),
+					       dtp94_device_take_sample_write_cb,
+					       task);
+}
+
+/**
+ * dtp94_device_take_sample_async:
+ *
+ * Takes a sample like dtp94_device_take_sample() but without blocking,
+ * driving the transfers from the thread-default main context.
+ *
+ * Since: 1.4.10
+ **/
+void
+dtp94_device_take_sample_async (GUsbDevice *device,
+				CdSensorCap cap,
+				GCancellable *cancellable,
+				GAsyncReadyCallback callback,
+				gpointer user_data)
+{
+	Dtp94DeviceSampleHelper *helper;
+	GTask *task;
+
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	helper = g_new0 (Dtp94DeviceSampleHelper, 1);
+	g_task_set_task_data (task, helper, g_free);
+
+	/* set hardware support */
+	helper->command = dtp94_device_get_mode_cmd (cap);
+	if (helper->command == NULL) {
+		g_task_return_new_error (task,
+					 DTP94_DEVICE_ERROR,
+					 DTP94_DEVICE_ERROR_NO_SUPPORT,
+					 "DTP94 cannot measure in %s mode",
+					 cd_sensor_cap_to_string (cap));
+		g_object_unref (task);
+		return;
+	}
+
+	/* already in this mode, so just get the sample */
+	if (g_object_get_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY) == helper->command) {
+		helper->command = "RM\r";
+		helper->reading = TRUE;
+	}
+	dtp94_device_take_sample_write (task);
+}
+
+/**
+ * dtp94_device_take_sample_finish:
+ *
+ * Gets the result of dtp94_device_take_sample_async().
+ *
+ * Returns: the measured color, or %NULL for error
+ *
+ * Since: 1.4.10
+ **/
+CdColorXYZ *
+dtp94_device_take_sample_finish (GUsbDevice *device,
+				 GAsyncResult *res,
+				 GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, device), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * dtp94_device_take_sample:
+ *
+ * Since: 0.1.29
+ **/
+CdColorXYZ *
+dtp94_device_take_sample (GUsbDevice *device, CdSensorCap cap, GError **error)
+{
+	const gchar *command;
+	gboolean ret;
+	gsize reply_read;
+	guint8 buffer[128];
+
+	g_return_val_if_fail (G_USB_IS_DEVICE (device), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* set hardware support */
+	command = dtp94_device_get_mode_cmd (cap);
+	if (command == NULL) {
+		g_set_error (error,
+			     DTP94_DEVICE_ERROR,
+			     DTP94_DEVICE_ERROR_NO_SUPPORT,
+			     "DTP94 cannot measure in %s mode",
+			     cd_sensor_cap_to_string (cap));
+		return NULL;
+	}
+
+	/* only change the mode when required */
+	if (g_object_get_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY) != command) {
+		if (!dtp94_device_send_cmd (device, command, error))
+			return NULL;
+		g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY,
+				   (gpointer) command);
+	}
+
+	/* get sample */
+	ret = dtp94_device_send_data (device,
+				      (const guint8 *) "RM\r", 3,
+				      buffer, sizeof (buffer),
+				      &reply_read,
+				      error);
+	if (!ret) {
+		g_object_set_data (G_OBJECT (device), DTP94_DEVICE_MODE_KEY, NULL);
+		return NULL;
+	}
+	return dtp94_device_parse_sample (buffer, reply_read, error);
+}
+
 /**
  * dtp94_device_get_serial:
  *
@@ -54,6 +54,15 @@ CdColorXYZ	*dtp94_device_take_sample	(GUsbDevice	*device,
 						 CdSensorCap	 cap,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+void		 dtp94_device_take_sample_async	(GUsbDevice	*device,
+						 CdSensorCap	 cap,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+CdColorXYZ	*dtp94_device_take_sample_finish (GUsbDevice	*device,
+						 GAsyncResult	*res,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 gchar		*dtp94_device_get_serial	(GUsbDevice	*device,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
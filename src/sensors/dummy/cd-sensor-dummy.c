@@ -27,11 +27,18 @@
 
 #include "cd-sensor.h"
 
+/* used unless the "latency" option is set, to look like real hardware */
+#define CD_SENSOR_DUMMY_LATENCY_DEFAULT		2000	/* ms */
+
 typedef struct
 {
 	gboolean			 done_startup;
 	CdColorRGB			 sample_fake;
 	cmsHTRANSFORM			 transform_fake;
+	gdouble				 latency;	/* ms */
+	gdouble				 jitter;	/* ms */
+	gdouble				 temperature;	/* K */
+	GRand				*rand;
 } CdSensorDummyPrivate;
 
 static CdSensorDummyPrivate *
@@ -40,14 +47,35 @@ cd_sensor_dummy_get_private (CdSensor *sensor)
 	return g_object_get_data (G_OBJECT (sensor), "priv");
 }
 
+/* completes the task after the configured latency and jitter */
+static void
+cd_sensor_dummy_complete_later (CdSensor *sensor, GTask *task, GSourceFunc func)
+{
+	CdSensorDummyPrivate *priv = cd_sensor_dummy_get_private (sensor);
+	gdouble delay = priv->latency;
+
+	if (priv->jitter > 0.f)
+		delay += g_rand_double_range (priv->rand, 0.f, priv->jitter);
+	if (delay < 1.f) {
+		g_idle_add (func, task);
+		return;
+	}
+	g_timeout_add ((guint) delay, func, task);
+}
+
 static gboolean
 cd_sensor_get_ambient_wait_cb (GTask *unowned_task)
 {
 	g_autoptr(GTask) task = unowned_task;
+	CdSensor *sensor = CD_SENSOR (g_task_get_source_object (task));
+	CdSensorDummyPrivate *priv = cd_sensor_dummy_get_private (sensor);
 	CdColorXYZ *sample = NULL;
 
+	/* a fixed reading unless jitter is wanted */
 	sample = cd_color_xyz_new ();
 	sample->X = 7.7f;
+	if (priv->jitter > 0.f)
+		sample->X += g_rand_double_range (priv->rand, -0.5f, 0.5f);
 	sample->Y = CD_SENSOR_NO_VALUE;
 	sample->Z = CD_SENSOR_NO_VALUE;
 	g_task_return_pointer (task, sample, (GDestroyNotify) cd_color_xyz_free);
@@ -101,11 +129,14 @@ cd_sensor_get_sample_async (CdSensor *sensor,
 	/* set state */
 	cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
 
-	/* just complete in idle */
-	if (cap != CD_SENSOR_CAP_AMBIENT)
-		g_timeout_add_seconds (2, (GSourceFunc) cd_sensor_get_sample_wait_cb, g_steal_pointer(&task));
-	else
-		g_timeout_add_seconds (2, (GSourceFunc) cd_sensor_get_ambient_wait_cb, g_steal_pointer(&task));
+	/* complete later, like real hardware */
+	if (cap != CD_SENSOR_CAP_AMBIENT) {
+		cd_sensor_dummy_complete_later (sensor, g_steal_pointer (&task),
+						(GSourceFunc) cd_sensor_get_sample_wait_cb);
+	} else {
+		cd_sensor_dummy_complete_later (sensor, g_steal_pointer (&task),
+						(GSourceFunc) cd_sensor_get_ambient_wait_cb);
+	}
 }
 
 CdColorXYZ *
@@ -115,6 +146,64 @@ cd_sensor_get_sample_finish (CdSensor *sensor, GAsyncResult *res, GError **error
 	return g_task_propagate_pointer (G_TASK (res), error);
 }
 
+static gboolean
+cd_sensor_get_spectrum_wait_cb (GTask *unowned_task)
+{
+	g_autoptr(GTask) task = unowned_task;
+	CdSensor *sensor = CD_SENSOR (g_task_get_source_object (task));
+	CdSensorDummyPrivate *priv = cd_sensor_dummy_get_private (sensor);
+	CdColorXYZ xyz;
+	CdSpectrum *sp;
+
+	/* never setup */
+	if (priv->transform_fake == NULL) {
+		g_task_return_new_error (task,
+					 CD_SENSOR_ERROR,
+					 CD_SENSOR_ERROR_NO_SUPPORT,
+					 "no fake transfor set up");
+		return G_SOURCE_REMOVE;
+	}
+
+	/* a black body across the visible range, as bright as the fake sample */
+	sp = cd_spectrum_planckian_new_full (priv->temperature, 380.f, 780.f, 1.f);
+	if (sp == NULL) {
+		g_task_return_new_error (task,
+					 CD_SENSOR_ERROR,
+					 CD_SENSOR_ERROR_INTERNAL,
+					 "failed to create %.0fK spectrum",
+					 priv->temperature);
+		return G_SOURCE_REMOVE;
+	}
+	cmsDoTransform (priv->transform_fake, &priv->sample_fake, &xyz, 1);
+	cd_spectrum_set_norm (sp, xyz.Y / 100.f);
+	g_task_return_pointer (task, sp, (GDestroyNotify) cd_spectrum_free);
+	return G_SOURCE_REMOVE;
+}
+
+void
+cd_sensor_get_spectrum_async (CdSensor *sensor,
+			      CdSensorCap cap,
+			      GCancellable *cancellable,
+			      GAsyncReadyCallback callback,
+			      gpointer user_data)
+{
+	g_autoptr(GTask) task = NULL;
+
+	g_return_if_fail (CD_IS_SENSOR (sensor));
+
+	task = g_task_new (sensor, cancellable, callback, user_data);
+	cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
+	cd_sensor_dummy_complete_later (sensor, g_steal_pointer (&task),
+					(GSourceFunc) cd_sensor_get_spectrum_wait_cb);
+}
+
+CdSpectrum *
+cd_sensor_get_spectrum_finish (CdSensor *sensor, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, sensor), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
 gboolean
 cd_sensor_set_options_finish (CdSensor *sensor, GAsyncResult *res, GError **error)
 {
@@ -159,6 +248,14 @@ cd_sensor_set_options_async (CdSensor *sensor,
 			priv->sample_fake.G = g_variant_get_double (value);
 		} else if (g_strcmp0 (key_name, "sample[blue]") == 0) {
 			priv->sample_fake.B = g_variant_get_double (value);
+		} else if (g_strcmp0 (key_name, "latency") == 0) {
+			priv->latency = MAX (g_variant_get_double (value), 0.f);
+		} else if (g_strcmp0 (key_name, "jitter") == 0) {
+			priv->jitter = MAX (g_variant_get_double (value), 0.f);
+		} else if (g_strcmp0 (key_name, "seed") == 0) {
+			g_rand_set_seed (priv->rand, (guint32) g_variant_get_double (value));
+		} else if (g_strcmp0 (key_name, "spectrum[temperature]") == 0) {
+			priv->temperature = g_variant_get_double (value);
 		} else {
 			g_task_return_new_error (task,
 						 CD_SENSOR_ERROR,
@@ -178,6 +275,7 @@ cd_sensor_unref_private (CdSensorDummyPrivate *priv)
 {
 	if (priv->transform_fake != NULL)
 		cmsDeleteTransform (priv->transform_fake);
+	g_rand_free (priv->rand);
 	g_free (priv);
 }
 
@@ -216,6 +314,7 @@ cd_sensor_coldplug (CdSensor *sensor, GError **error)
 					       CD_SENSOR_CAP_SPOT,
 					       CD_SENSOR_CAP_PRINTER,
 					       CD_SENSOR_CAP_AMBIENT,
+					       CD_SENSOR_CAP_SPECTRAL,
 					       -1);
 	g_object_set (sensor,
 		      "id", "dummy",
@@ -231,6 +330,9 @@ cd_sensor_coldplug (CdSensor *sensor, GError **error)
 	priv = g_new0 (CdSensorDummyPrivate, 1);
 	priv->transform_fake = cd_sensor_get_fake_transform (priv);
 	cd_color_rgb_set (&priv->sample_fake, 0.1, 0.2, 0.3);
+	priv->latency = CD_SENSOR_DUMMY_LATENCY_DEFAULT;
+	priv->temperature = 6500.f;
+	priv->rand = g_rand_new_with_seed (0);
 	g_object_set_data_full (G_OBJECT (sensor), "priv", priv,
 				(GDestroyNotify) cd_sensor_unref_private);
 	return TRUE;
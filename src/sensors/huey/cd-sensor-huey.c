@@ -45,22 +45,17 @@ cd_sensor_huey_get_private (CdSensor *sensor)
 }
 
 static void
-cd_sensor_huey_get_ambient_thread_cb (GTask *task,
-				      gpointer source_object,
-				      gpointer task_data,
-				      GCancellable *cancellable)
+cd_sensor_huey_get_ambient_cb (GObject *source,
+			       GAsyncResult *res,
+			       gpointer user_data)
 {
+	g_autoptr(GTask) task = G_TASK (user_data);
 	g_autoptr(GError) error = NULL;
-	CdSensor *sensor = CD_SENSOR (source_object);
-	CdSensorHueyPrivate *priv = cd_sensor_huey_get_private (sensor);
 	CdColorXYZ sample;
 
-	/* set state */
-	cd_sensor_set_state_in_idle (sensor, CD_SENSOR_STATE_MEASURING);
-
-	/* hit hardware */
 	cd_color_xyz_clear (&sample);
-	sample.X = huey_device_get_ambient (priv->device, &error);
+	sample.X = huey_device_get_ambient_finish (G_USB_DEVICE (source),
+						   res, &error);
 	if (sample.X < 0) {
 		g_task_return_new_error (task,
 					 CD_SENSOR_ERROR,
@@ -76,20 +71,15 @@ cd_sensor_huey_get_ambient_thread_cb (GTask *task,
 }
 
 static void
-cd_sensor_huey_sample_thread_cb (GTask *task,
-				 gpointer source_object,
-				 gpointer task_data,
-				 GCancellable *cancellable)
+cd_sensor_huey_sample_cb (GObject *source,
+			  GAsyncResult *res,
+			  gpointer user_data)
 {
-	CdSensor *sensor = CD_SENSOR (source_object);
-	CdSensorHueyPrivate *priv = cd_sensor_huey_get_private (sensor);
-	CdSensorCap cap = GPOINTER_TO_UINT (task_data);
-	CdColorXYZ *sample;
+	g_autoptr(GTask) task = G_TASK (user_data);
 	g_autoptr(GError) error = NULL;
+	CdColorXYZ *sample;
 
-	/* measure */
-	cd_sensor_set_state_in_idle (sensor, CD_SENSOR_STATE_MEASURING);
-	sample = huey_ctx_take_sample (priv->ctx, cap, &error);
+	sample = huey_ctx_take_sample_finish (HUEY_CTX (source), res, &error);
 	if (sample == NULL) {
 		g_task_return_new_error (task,
 					 CD_SENSOR_ERROR,
@@ -99,7 +89,7 @@ cd_sensor_huey_sample_thread_cb (GTask *task,
 	}
 
 	/* save result */
-	g_task_return_pointer (task, sample, NULL);
+	g_task_return_pointer (task, sample, (GDestroyNotify) cd_color_xyz_free);
 }
 
 void
@@ -109,14 +99,26 @@ cd_sensor_get_sample_async (CdSensor *sensor,
 			    GAsyncReadyCallback callback,
 			    gpointer user_data)
 {
-	g_autoptr(GTask) task = NULL;
+	CdSensorHueyPrivate *priv = cd_sensor_huey_get_private (sensor);
+	GTask *task = NULL;
+
 	g_return_if_fail (CD_IS_SENSOR (sensor));
+
+	/* the transfers are driven from the main context, so no thread
+	 * is tied up while the device integrates */
 	task = g_task_new (sensor, cancellable, callback, user_data);
-	g_task_set_task_data (task, GUINT_TO_POINTER (cap), NULL);
+	cd_sensor_set_state (sensor, CD_SENSOR_STATE_MEASURING);
 	if (cap == CD_SENSOR_CAP_AMBIENT) {
-		g_task_run_in_thread (task, cd_sensor_huey_get_ambient_thread_cb);
+		huey_device_get_ambient_async (priv->device,
+					       cancellable,
+					       cd_sensor_huey_get_ambient_cb,
+					       task);
 	} else {
-		g_task_run_in_thread (task, cd_sensor_huey_sample_thread_cb);
+		huey_ctx_take_sample_async (priv->ctx,
+					    cap,
+					    cancellable,
+					    cd_sensor_huey_sample_cb,
+					    task);
 	}
 }
 
@@ -127,6 +129,36 @@ cd_sensor_get_sample_finish (CdSensor *sensor, GAsyncResult *res, GError **error
 	return g_task_propagate_pointer (G_TASK (res), error);
 }
 
+static gboolean
+cd_sensor_huey_setup_from_cache (CdSensor *sensor)
+{
+	CdSensorHueyPrivate *priv = cd_sensor_huey_get_private (sensor);
+	gfloat calibration_value = 0.f;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GError) error = NULL;
+
+	blob = cd_sensor_get_cached_data (sensor, "Calibration");
+	if (blob == NULL)
+		return FALSE;
+	if (!huey_ctx_set_calibration_blob (priv->ctx, blob, &error)) {
+		g_debug ("ignoring cached calibration: %s", error->message);
+		return FALSE;
+	}
+	if (!huey_device_read_register_float (priv->device,
+					      HUEY_EEPROM_ADDR_AMBIENT_CALIB_VALUE,
+					      &calibration_value,
+					      &error)) {
+		g_debug ("failed to verify cached calibration: %s", error->message);
+		return FALSE;
+	}
+	if (calibration_value != huey_ctx_get_calibration_value (priv->ctx)) {
+		g_debug ("cached calibration is stale");
+		return FALSE;
+	}
+	g_debug ("using cached calibration");
+	return TRUE;
+}
+
 static void
 cd_sensor_huey_lock_thread_cb (GTask *task,
 			       gpointer source_object,
@@ -178,13 +210,19 @@ cd_sensor_huey_lock_thread_cb (GTask *task,
 	cd_sensor_set_serial (sensor, serial_number_tmp);
 	g_debug ("Serial number: %s", serial_number_tmp);
 
-	/* setup sensor */
-	if (!huey_ctx_setup (priv->ctx, &error)) {
-		g_task_return_new_error (task,
-					 CD_SENSOR_ERROR,
-					 CD_SENSOR_ERROR_INTERNAL,
-					 "%s", error->message);
-		goto out;
+	/* setup sensor, skipping the slow EEPROM reads if the ambient value
+	 * still matches what was saved for this serial number */
+	if (!cd_sensor_huey_setup_from_cache (sensor)) {
+		g_autoptr(GBytes) blob = NULL;
+		if (!huey_ctx_setup (priv->ctx, &error)) {
+			g_task_return_new_error (task,
+						 CD_SENSOR_ERROR,
+						 CD_SENSOR_ERROR_INTERNAL,
+						 "%s", error->message);
+			goto out;
+		}
+		blob = huey_ctx_get_calibration_blob (priv->ctx);
+		cd_sensor_set_cached_data (sensor, "Calibration", blob);
 	}
 
 	/* spin the LEDs */
@@ -24,6 +24,7 @@
 #include <glib.h>
 #include <lcms2.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "huey-ctx.h"
 #include "huey-device.h"
@@ -51,6 +52,24 @@ static void	huey_ctx_finalize	(GObject	*object);
  * indicates we doing something wrong. */
 #define HUEY_XYZ_POST_MULTIPLY_FACTOR	3.428
 
+/* A reading is accurate enough when the counters are at least this full,
+ * and the gain for the first reading starts this far below the last one
+ * so that a much darker patch does not take too long to measure. */
+#define HUEY_ADAPTIVE_MIN_RAW		(HUEY_POLL_FREQUENCY / 8)
+#define HUEY_ADAPTIVE_START_DIVISOR	4
+
+typedef struct {
+	guint16	R;
+	guint16	G;
+	guint16	B;
+} HueyCtxMultiplier;
+
+typedef struct {
+	guint32	R;
+	guint32	G;
+	guint32	B;
+} HueyCtxDeviceRaw;
+
 typedef struct
 {
 	CdMat3x3		 calibration_crt;
@@ -58,6 +77,7 @@ typedef struct
 	CdVec3			 dark_offset;
 	gchar			*unlock_string;
 	gfloat			 calibration_value;
+	HueyCtxMultiplier	 last_multiplier;	/* zero if no sample yet */
 	GUsbDevice		*device;
 } HueyCtxPrivate;
 
@@ -167,6 +187,87 @@ huey_ctx_get_dark_offset (HueyCtx *ctx)
 	return &priv->dark_offset;
 }
 
+/* version 1: LCD matrix, CRT matrix, dark offset, ambient calibration */
+#define HUEY_CTX_CALIBRATION_FORMAT	"(u@ad@ad@add)"
+#define HUEY_CTX_CALIBRATION_VERSION	1
+
+/* the values read by huey_ctx_setup(), to be restored without the EEPROM */
+GBytes *
+huey_ctx_get_calibration_blob (HueyCtx *ctx)
+{
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	g_autoptr(GVariant) value = NULL;
+
+	g_return_val_if_fail (HUEY_IS_CTX (ctx), NULL);
+
+	value = g_variant_new (HUEY_CTX_CALIBRATION_FORMAT,
+			       (guint32) HUEY_CTX_CALIBRATION_VERSION,
+			       g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+							  cd_mat33_get_data (&priv->calibration_lcd),
+							  9, sizeof (gdouble)),
+			       g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+							  cd_mat33_get_data (&priv->calibration_crt),
+							  9, sizeof (gdouble)),
+			       g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+							  &priv->dark_offset,
+							  3, sizeof (gdouble)),
+			       (gdouble) priv->calibration_value);
+	g_variant_ref_sink (value);
+	return g_variant_get_data_as_bytes (value);
+}
+
+gboolean
+huey_ctx_set_calibration_blob (HueyCtx *ctx, GBytes *blob, GError **error)
+{
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	const gdouble *crt;
+	const gdouble *dark;
+	const gdouble *lcd;
+	gdouble calibration_value;
+	gsize crt_len = 0;
+	gsize dark_len = 0;
+	gsize lcd_len = 0;
+	guint32 version = 0;
+	g_autoptr(GVariant) crt_value = NULL;
+	g_autoptr(GVariant) dark_value = NULL;
+	g_autoptr(GVariant) lcd_value = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	g_return_val_if_fail (HUEY_IS_CTX (ctx), FALSE);
+	g_return_val_if_fail (blob != NULL, FALSE);
+
+	value = g_variant_new_from_bytes (G_VARIANT_TYPE (HUEY_CTX_CALIBRATION_FORMAT),
+					  blob, FALSE);
+	g_variant_ref_sink (value);
+	if (!g_variant_is_normal_form (value)) {
+		g_set_error_literal (error,
+				     CD_SENSOR_ERROR,
+				     CD_SENSOR_ERROR_INTERNAL,
+				     "calibration data is invalid");
+		return FALSE;
+	}
+	g_variant_get (value, HUEY_CTX_CALIBRATION_FORMAT,
+		       &version, &lcd_value, &crt_value, &dark_value,
+		       &calibration_value);
+	lcd = g_variant_get_fixed_array (lcd_value, &lcd_len, sizeof (gdouble));
+	crt = g_variant_get_fixed_array (crt_value, &crt_len, sizeof (gdouble));
+	dark = g_variant_get_fixed_array (dark_value, &dark_len, sizeof (gdouble));
+	if (version != HUEY_CTX_CALIBRATION_VERSION ||
+	    lcd_len != 9 || crt_len != 9 || dark_len != 3) {
+		g_set_error (error,
+			     CD_SENSOR_ERROR,
+			     CD_SENSOR_ERROR_INTERNAL,
+			     "calibration data version %u is not supported",
+			     version);
+		return FALSE;
+	}
+	memcpy (cd_mat33_get_data (&priv->calibration_lcd), lcd, sizeof (gdouble) * 9);
+	memcpy (cd_mat33_get_data (&priv->calibration_crt), crt, sizeof (gdouble) * 9);
+	memcpy (&priv->dark_offset, dark, sizeof (gdouble) * 3);
+	priv->calibration_value = calibration_value;
+	return TRUE;
+}
+
 const gchar *
 huey_ctx_get_unlock_string (HueyCtx *ctx)
 {
@@ -175,18 +276,6 @@ huey_ctx_get_unlock_string (HueyCtx *ctx)
 	return priv->unlock_string;
 }
 
-typedef struct {
-	guint16	R;
-	guint16	G;
-	guint16	B;
-} HueyCtxMultiplier;
-
-typedef struct {
-	guint32	R;
-	guint32	G;
-	guint32	B;
-} HueyCtxDeviceRaw;
-
 static gboolean
 huey_ctx_sample_for_threshold (HueyCtx *ctx,
 			       HueyCtxMultiplier *threshold,
@@ -272,73 +361,71 @@ huey_ctx_convert_device_RGB_to_XYZ (CdColorRGB *src,
 }
 
 
-CdColorXYZ *
-huey_ctx_take_sample (HueyCtx *ctx, CdSensorCap cap, GError **error)
+static guint16
+huey_ctx_multiplier_scale (guint16 multiplier, guint32 raw)
+{
+	gdouble tmp;
+
+	/* no reading, so nothing better to use */
+	if (raw == 0)
+		return multiplier;
+	tmp = (gdouble) multiplier * HUEY_POLL_FREQUENCY / (gdouble) raw;
+
+	/* don't allow a value of zero */
+	return CLAMP ((guint) tmp, 1, G_MAXUINT16);
+}
+
+/* try to fill the 16 bit register for accuracy, given the raw values
+ * that were read using @multiplier */
+static void
+huey_ctx_multiplier_for_raw (const HueyCtxDeviceRaw *raw,
+			     HueyCtxMultiplier *multiplier)
+{
+	multiplier->R = huey_ctx_multiplier_scale (multiplier->R, raw->R);
+	multiplier->G = huey_ctx_multiplier_scale (multiplier->G, raw->G);
+	multiplier->B = huey_ctx_multiplier_scale (multiplier->B, raw->B);
+	g_debug ("using multiplier factor: red=%i, green=%i, blue=%i",
+		 multiplier->R, multiplier->G, multiplier->B);
+}
+
+/* patches in a run change gradually, so predict from the last sample */
+static void
+huey_ctx_multiplier_for_start (HueyCtx *ctx, HueyCtxMultiplier *multiplier)
+{
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	multiplier->R = MAX (priv->last_multiplier.R / HUEY_ADAPTIVE_START_DIVISOR, 1);
+	multiplier->G = MAX (priv->last_multiplier.G / HUEY_ADAPTIVE_START_DIVISOR, 1);
+	multiplier->B = MAX (priv->last_multiplier.B / HUEY_ADAPTIVE_START_DIVISOR, 1);
+}
+
+/* if the counters are full enough a second reading is not needed */
+static gboolean
+huey_ctx_raw_is_accurate (const HueyCtxDeviceRaw *raw)
+{
+	return raw->R >= HUEY_ADAPTIVE_MIN_RAW &&
+	       raw->G >= HUEY_ADAPTIVE_MIN_RAW &&
+	       raw->B >= HUEY_ADAPTIVE_MIN_RAW;
+}
+
+static CdColorXYZ *
+huey_ctx_raw_to_xyz (HueyCtx *ctx,
+		     CdSensorCap cap,
+		     const HueyCtxMultiplier *multiplier,
+		     const HueyCtxDeviceRaw *color_native)
 {
 	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
 	CdColorRGB values;
 	CdColorXYZ color_result;
 	CdMat3x3 *device_calibration;
 	CdVec3 *temp;
-	gboolean ret;
-	HueyCtxDeviceRaw color_native;
-	HueyCtxMultiplier multiplier;
-
-	g_return_val_if_fail (HUEY_IS_CTX (ctx), NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* no hardware support */
-	if (cap == CD_SENSOR_CAP_PROJECTOR) {
-		g_set_error_literal (error,
-				     G_IO_ERROR,
-				     G_IO_ERROR_NOT_SUPPORTED,
-				     "Huey cannot measure in projector mode");
-		return NULL;
-	}
-
-	/* set this to one value for a quick approximate value */
-	multiplier.R = 1;
-	multiplier.G = 1;
-	multiplier.B = 1;
-	ret = huey_ctx_sample_for_threshold (ctx,
-					     &multiplier,
-					     &color_native,
-					     error);
-	if (!ret)
-		return NULL;
-	g_debug ("initial values: red=%u, green=%u, blue=%u",
-		 color_native.R, color_native.G, color_native.B);
 
-	/* try to fill the 16 bit register for accuracy */
-	if (color_native.R != 0)
-		multiplier.R = HUEY_POLL_FREQUENCY / color_native.R;
-	if (color_native.G != 0)
-		multiplier.G = HUEY_POLL_FREQUENCY / color_native.G;
-	if (color_native.B != 0)
-		multiplier.B = HUEY_POLL_FREQUENCY / color_native.B;
-
-	/* don't allow a value of zero */
-	if (multiplier.R == 0)
-		multiplier.R = 1;
-	if (multiplier.G == 0)
-		multiplier.G = 1;
-	if (multiplier.B == 0)
-		multiplier.B = 1;
-	g_debug ("using multiplier factor: red=%i, green=%i, blue=%i",
-		 multiplier.R, multiplier.G, multiplier.B);
-	ret = huey_ctx_sample_for_threshold (ctx,
-					     &multiplier,
-					     &color_native,
-					     error);
-	if (!ret)
-		return NULL;
 	g_debug ("raw values: red=%u, green=%u, blue=%u",
-		 color_native.R, color_native.G, color_native.B);
+		 color_native->R, color_native->G, color_native->B);
 
 	/* get DeviceRGB values */
-	values.R = (gdouble) multiplier.R * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native.R);
-	values.G = (gdouble) multiplier.G * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native.G);
-	values.B = (gdouble) multiplier.B * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native.B);
+	values.R = (gdouble) multiplier->R * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native->R);
+	values.G = (gdouble) multiplier->G * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native->G);
+	values.B = (gdouble) multiplier->B * 0.5f * HUEY_POLL_FREQUENCY / ((gdouble) color_native->B);
 	g_debug ("scaled values: red=%0.6lf, green=%0.6lf, blue=%0.6lf",
 		 values.R, values.G, values.B);
 
@@ -384,6 +471,204 @@ huey_ctx_take_sample (HueyCtx *ctx, CdSensorCap cap, GError **error)
 	return cd_color_xyz_dup (&color_result);
 }
 
+CdColorXYZ *
+huey_ctx_take_sample (HueyCtx *ctx, CdSensorCap cap, GError **error)
+{
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	gboolean ret;
+	HueyCtxDeviceRaw color_native;
+	HueyCtxMultiplier multiplier;
+
+	g_return_val_if_fail (HUEY_IS_CTX (ctx), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* no hardware support */
+	if (cap == CD_SENSOR_CAP_PROJECTOR) {
+		g_set_error_literal (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_NOT_SUPPORTED,
+				     "Huey cannot measure in projector mode");
+		return NULL;
+	}
+
+	/* start low for a quick approximate value */
+	huey_ctx_multiplier_for_start (ctx, &multiplier);
+	ret = huey_ctx_sample_for_threshold (ctx,
+					     &multiplier,
+					     &color_native,
+					     error);
+	if (!ret)
+		return NULL;
+	g_debug ("initial values: red=%u, green=%u, blue=%u",
+		 color_native.R, color_native.G, color_native.B);
+
+	/* try to fill the 16 bit register for accuracy */
+	if (!huey_ctx_raw_is_accurate (&color_native)) {
+		huey_ctx_multiplier_for_raw (&color_native, &multiplier);
+		ret = huey_ctx_sample_for_threshold (ctx,
+						     &multiplier,
+						     &color_native,
+						     error);
+		if (!ret)
+			return NULL;
+	}
+	priv->last_multiplier = multiplier;
+	return huey_ctx_raw_to_xyz (ctx, cap, &multiplier, &color_native);
+}
+
+/* each sample is up to two passes of three reads: one approximate pass
+ * at a low gain, then if needed one with the gain that fills the 16 bit
+ * counters */
+typedef struct {
+	CdSensorCap		 cap;
+	HueyCtxMultiplier	 multiplier;
+	HueyCtxDeviceRaw	 raw;
+	guint			 pass;
+	guint			 channel;
+} HueyCtxSampleHelper;
+
+static void huey_ctx_take_sample_send (GTask *task);
+
+static void
+huey_ctx_take_sample_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	g_autoptr(GTask) task = G_TASK (user_data);
+	HueyCtx *ctx = g_task_get_source_object (task);
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	HueyCtxSampleHelper *helper = g_task_get_task_data (task);
+	const guint8 *reply;
+	gsize reply_len = 0;
+	guint32 value;
+	GError *error = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+
+	bytes = huey_device_send_data_finish (G_USB_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_task_return_error (task, error);
+		return;
+	}
+	reply = g_bytes_get_data (bytes, &reply_len);
+	if (reply_len < 6) {
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_FAILED,
+					 "short read: %" G_GSIZE_FORMAT,
+					 reply_len);
+		return;
+	}
+	value = cd_buffer_read_uint32_be (reply + 2);
+	switch (helper->channel++) {
+	case 0:
+		helper->raw.R = value;
+		break;
+	case 1:
+		helper->raw.G = value;
+		break;
+	default:
+		helper->raw.B = value;
+		break;
+	}
+
+	/* more channels to read */
+	if (helper->channel < 3) {
+		huey_ctx_take_sample_send (g_steal_pointer (&task));
+		return;
+	}
+
+	/* re-measure with the better gain if the counters were not full */
+	if (helper->pass++ == 0 && !huey_ctx_raw_is_accurate (&helper->raw)) {
+		g_debug ("initial values: red=%u, green=%u, blue=%u",
+			 helper->raw.R, helper->raw.G, helper->raw.B);
+		huey_ctx_multiplier_for_raw (&helper->raw, &helper->multiplier);
+		helper->channel = 0;
+		huey_ctx_take_sample_send (g_steal_pointer (&task));
+		return;
+	}
+	priv->last_multiplier = helper->multiplier;
+	g_task_return_pointer (task,
+			       huey_ctx_raw_to_xyz (ctx,
+						    helper->cap,
+						    &helper->multiplier,
+						    &helper->raw),
+			       (GDestroyNotify) cd_color_xyz_free);
+}
+
+static void
+huey_ctx_take_sample_send (GTask *task)
+{
+	HueyCtx *ctx = g_task_get_source_object (task);
+	HueyCtxPrivate *priv = GET_PRIVATE (ctx);
+	HueyCtxSampleHelper *helper = g_task_get_task_data (task);
+	guint8 request[HUEY_DEVICE_PACKET_SIZE] = { 0x00 };
+
+	/* the first command measures and returns red, the others
+	 * just read back the latched values */
+	cd_buffer_write_uint16_be (request + 1, helper->multiplier.R);
+	cd_buffer_write_uint16_be (request + 3, helper->multiplier.G);
+	cd_buffer_write_uint16_be (request + 5, helper->multiplier.B);
+	switch (helper->channel) {
+	case 0:
+		request[0] = HUEY_CMD_SENSOR_MEASURE_RGB;
+		break;
+	case 1:
+		request[0] = HUEY_CMD_READ_GREEN;
+		break;
+	default:
+		request[0] = HUEY_CMD_READ_BLUE;
+		break;
+	}
+	huey_device_send_data_async (priv->device,
+				     request,
+				     g_task_get_cancellable (task),
+				     huey_ctx_take_sample_cb,
+				     task);
+}
+
+/**
+ * huey_ctx_take_sample_async:
+ *
+ * Takes a sample in the same way as huey_ctx_take_sample() but without
+ * blocking the caller, so several devices can be measured at once.
+ **/
+void
+huey_ctx_take_sample_async (HueyCtx *ctx,
+			    CdSensorCap cap,
+			    GCancellable *cancellable,
+			    GAsyncReadyCallback callback,
+			    gpointer user_data)
+{
+	HueyCtxSampleHelper *helper;
+	GTask *task;
+
+	g_return_if_fail (HUEY_IS_CTX (ctx));
+
+	task = g_task_new (ctx, cancellable, callback, user_data);
+
+	/* no hardware support */
+	if (cap == CD_SENSOR_CAP_PROJECTOR) {
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_NOT_SUPPORTED,
+					 "Huey cannot measure in projector mode");
+		g_object_unref (task);
+		return;
+	}
+
+	/* start low for a quick approximate value */
+	helper = g_new0 (HueyCtxSampleHelper, 1);
+	helper->cap = cap;
+	huey_ctx_multiplier_for_start (ctx, &helper->multiplier);
+	g_task_set_task_data (task, helper, g_free);
+	huey_ctx_take_sample_send (task);
+}
+
+CdColorXYZ *
+huey_ctx_take_sample_finish (HueyCtx *ctx, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, ctx), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
 static void
 huey_ctx_get_property (GObject *object,
 		       guint prop_id,
@@ -53,6 +53,15 @@ CdColorXYZ	*huey_ctx_take_sample		(HueyCtx	*ctx,
 						 CdSensorCap	 cap,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+void		 huey_ctx_take_sample_async	(HueyCtx	*ctx,
+						 CdSensorCap	 cap,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+CdColorXYZ	*huey_ctx_take_sample_finish	(HueyCtx	*ctx,
+						 GAsyncResult	*res,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 GUsbDevice	*huey_ctx_get_device		(HueyCtx	*ctx);
 void		 huey_ctx_set_device		(HueyCtx	*ctx,
 						 GUsbDevice	*device);
@@ -64,6 +73,10 @@ const CdMat3x3	*huey_ctx_get_calibration_crt	(HueyCtx	*ctx);
 gfloat		 huey_ctx_get_calibration_value	(HueyCtx	*ctx);
 const CdVec3	*huey_ctx_get_dark_offset	(HueyCtx	*ctx);
 const gchar	*huey_ctx_get_unlock_string	(HueyCtx	*ctx);
+GBytes		*huey_ctx_get_calibration_blob	(HueyCtx	*ctx);
+gboolean	 huey_ctx_set_calibration_blob	(HueyCtx	*ctx,
+						 GBytes		*blob,
+						 GError		**error);
 
 G_END_DECLS
 
@@ -33,6 +33,64 @@
 /* fudge factor to convert the value of HUEY_CMD_GET_AMBIENT to Lux */
 #define HUEY_AMBIENT_UNITS_TO_LUX	125.0f
 
+/* returns FALSE with @retry set if the device wants the read repeated */
+static gboolean
+huey_device_check_reply (const guint8 *request,
+			 const guint8 *reply,
+			 gsize reply_read,
+			 gboolean *retry,
+			 GError **error)
+{
+	*retry = FALSE;
+
+	/* the second byte seems to be the command again */
+	cd_buffer_debug (CD_BUFFER_KIND_RESPONSE,
+			 reply, reply_read);
+	if (reply[1] != request[0]) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "wrong command reply, got 0x%02x, "
+			     "expected 0x%02x",
+			     reply[1],
+			     request[0]);
+		return FALSE;
+	}
+
+	/* the first byte is status */
+	if (reply[0] == HUEY_RC_SUCCESS)
+		return TRUE;
+
+	/* failure, the return buffer is set to "Locked" */
+	if (reply[0] == HUEY_RC_LOCKED) {
+		g_set_error_literal (error,
+				     G_IO_ERROR,
+				     G_IO_ERROR_NOT_INITIALIZED,
+				     "the device is locked");
+		return FALSE;
+	}
+
+	/* failure, the return buffer is set to "NoCmd" */
+	if (reply[0] == HUEY_RC_ERROR) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "failed to issue command: %s", &reply[2]);
+		return FALSE;
+	}
+
+	/* we ignore retry */
+	if (reply[0] != HUEY_RC_RETRY) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_FAILED,
+			     "return value unknown: 0x%02x", reply[0]);
+		return FALSE;
+	}
+	*retry = TRUE;
+	return FALSE;
+}
+
 gboolean
 huey_device_send_data (GUsbDevice *device,
 		       const guint8 *request,
@@ -43,6 +101,7 @@ huey_device_send_data (GUsbDevice *device,
 		       GError **error)
 {
 	gboolean ret;
+	gboolean retry;
 	guint i;
 
 	g_return_val_if_fail (G_USB_IS_DEVICE (device), FALSE);
@@ -86,51 +145,11 @@ huey_device_send_data (GUsbDevice *device,
 						       error);
 		if (!ret)
 			return FALSE;
-
-		/* the second byte seems to be the command again */
-		cd_buffer_debug (CD_BUFFER_KIND_RESPONSE,
-				 reply, *reply_read);
-		if (reply[1] != request[0]) {
-			g_set_error (error,
-				     G_IO_ERROR,
-				     G_IO_ERROR_FAILED,
-				     "wrong command reply, got 0x%02x, "
-				     "expected 0x%02x",
-				     reply[1],
-				     request[0]);
-			return FALSE;
-		}
-
-		/* the first byte is status */
-		if (reply[0] == HUEY_RC_SUCCESS)
+		if (huey_device_check_reply (request, reply, *reply_read,
+					     &retry, error))
 			return TRUE;
-
-		/* failure, the return buffer is set to "Locked" */
-		if (reply[0] == HUEY_RC_LOCKED) {
-			g_set_error_literal (error,
-					     G_IO_ERROR,
-					     G_IO_ERROR_NOT_INITIALIZED,
-					     "the device is locked");
-			return FALSE;
-		}
-
-		/* failure, the return buffer is set to "NoCmd" */
-		if (reply[0] == HUEY_RC_ERROR) {
-			g_set_error (error,
-				     G_IO_ERROR,
-				     G_IO_ERROR_FAILED,
-				     "failed to issue command: %s", &reply[2]);
+		if (!retry)
 			return FALSE;
-		}
-
-		/* we ignore retry */
-		if (reply[0] != HUEY_RC_RETRY) {
-			g_set_error (error,
-				     G_IO_ERROR,
-				     G_IO_ERROR_FAILED,
-				     "return value unknown: 0x%02x", reply[0]);
-			return FALSE;
-		}
 	}
 
 	/* no success */
@@ -142,6 +161,143 @@ huey_device_send_data (GUsbDevice *device,
 	return FALSE;
 }
 
+typedef struct {
+	guint8		 request[HUEY_DEVICE_PACKET_SIZE];
+	guint8		 reply[HUEY_DEVICE_PACKET_SIZE];
+	guint		 retries;
+} HueyDeviceSendHelper;
+
+static void huey_device_send_data_read (GTask *task);
+
+static void
+huey_device_send_data_read_cb (GObject *source,
+			       GAsyncResult *res,
+			       gpointer user_data)
+{
+	GUsbDevice *device = G_USB_DEVICE (source);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	HueyDeviceSendHelper *helper = g_task_get_task_data (task);
+	gboolean retry;
+	gssize reply_read;
+	GError *error = NULL;
+
+	reply_read = g_usb_device_interrupt_transfer_finish (device, res, &error);
+	if (reply_read < 0) {
+		g_task_return_error (task, error);
+		return;
+	}
+	if (huey_device_check_reply (helper->request, helper->reply,
+				     (gsize) reply_read, &retry, &error)) {
+		g_task_return_pointer (task,
+				       g_bytes_new (helper->reply, (gsize) reply_read),
+				       (GDestroyNotify) g_bytes_unref);
+		return;
+	}
+	if (!retry) {
+		g_task_return_error (task, error);
+		return;
+	}
+	if (++helper->retries >= HUEY_MAX_READ_RETRIES) {
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_FAILED,
+					 "gave up retrying after %i reads",
+					 HUEY_MAX_READ_RETRIES);
+		return;
+	}
+	huey_device_send_data_read (g_steal_pointer (&task));
+}
+
+static void
+huey_device_send_data_read (GTask *task)
+{
+	GUsbDevice *device = g_task_get_source_object (task);
+	HueyDeviceSendHelper *helper = g_task_get_task_data (task);
+
+	g_usb_device_interrupt_transfer_async (device,
+					       0x81,
+					       helper->reply,
+					       sizeof (helper->reply),
+					       HUEY_CONTROL_MESSAGE_TIMEOUT,
+					       g_task_get_cancellable (task),
+					       huey_device_send_data_read_cb,
+					       task);
+}
+
+static void
+huey_device_send_data_write_cb (GObject *source,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GUsbDevice *device = G_USB_DEVICE (source);
+	GTask *task = G_TASK (user_data);
+	GError *error = NULL;
+
+	if (g_usb_device_control_transfer_finish (device, res, &error) < 0) {
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+	huey_device_send_data_read (task);
+}
+
+/**
+ * huey_device_send_data_async:
+ *
+ * Sends a packet to the device and reads the reply without blocking,
+ * retrying the read in the same way as huey_device_send_data().
+ **/
+void
+huey_device_send_data_async (GUsbDevice *device,
+			     const guint8 *request,
+			     GCancellable *cancellable,
+			     GAsyncReadyCallback callback,
+			     gpointer user_data)
+{
+	HueyDeviceSendHelper *helper;
+	GTask *task;
+
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+	g_return_if_fail (request != NULL);
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	helper = g_new0 (HueyDeviceSendHelper, 1);
+	memcpy (helper->request, request, sizeof (helper->request));
+	g_task_set_task_data (task, helper, g_free);
+
+	cd_buffer_debug (CD_BUFFER_KIND_REQUEST,
+			 helper->request, sizeof (helper->request));
+	g_usb_device_control_transfer_async (device,
+					     G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
+					     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+					     G_USB_DEVICE_RECIPIENT_INTERFACE,
+					     0x09,
+					     0x0200,
+					     0,
+					     helper->request,
+					     sizeof (helper->request),
+					     HUEY_CONTROL_MESSAGE_TIMEOUT,
+					     cancellable,
+					     huey_device_send_data_write_cb,
+					     task);
+}
+
+/**
+ * huey_device_send_data_finish:
+ *
+ * Gets the result of huey_device_send_data_async().
+ *
+ * Returns: the reply packet, or %NULL for error
+ **/
+GBytes *
+huey_device_send_data_finish (GUsbDevice *device,
+			      GAsyncResult *res,
+			      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, device), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
 gchar *
 huey_device_get_status (GUsbDevice *device, GError **error)
 {
@@ -317,6 +473,77 @@ huey_device_get_ambient (GUsbDevice *device, GError **error)
 	return (gdouble) cd_buffer_read_uint16_be (reply+5) / HUEY_AMBIENT_UNITS_TO_LUX;
 }
 
+static void
+huey_device_get_ambient_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	g_autoptr(GTask) task = G_TASK (user_data);
+	const guint8 *reply;
+	gdouble *value;
+	gsize reply_len = 0;
+	GError *error = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+
+	bytes = huey_device_send_data_finish (G_USB_DEVICE (source), res, &error);
+	if (bytes == NULL) {
+		g_task_return_error (task, error);
+		return;
+	}
+	reply = g_bytes_get_data (bytes, &reply_len);
+	if (reply_len < 7) {
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_FAILED,
+					 "short read: %" G_GSIZE_FORMAT,
+					 reply_len);
+		return;
+	}
+
+	/* parse the value */
+	value = g_new (gdouble, 1);
+	*value = (gdouble) cd_buffer_read_uint16_be (reply+5) / HUEY_AMBIENT_UNITS_TO_LUX;
+	g_task_return_pointer (task, value, g_free);
+}
+
+void
+huey_device_get_ambient_async (GUsbDevice *device,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	GTask *task;
+	const guint8 request[] = { HUEY_CMD_GET_AMBIENT,
+				   0x03,
+				   0x00, /* just use LCD mode */
+				   0x00,
+				   0x00,
+				   0x00,
+				   0x00,
+				   0x00 };
+
+	g_return_if_fail (G_USB_IS_DEVICE (device));
+
+	task = g_task_new (device, cancellable, callback, user_data);
+	huey_device_send_data_async (device, request, cancellable,
+				     huey_device_get_ambient_cb, task);
+}
+
+gdouble
+huey_device_get_ambient_finish (GUsbDevice *device,
+				GAsyncResult *res,
+				GError **error)
+{
+	gdouble value;
+	g_autofree gdouble *tmp = NULL;
+
+	g_return_val_if_fail (g_task_is_valid (res, device), -1);
+
+	tmp = g_task_propagate_pointer (G_TASK (res), error);
+	if (tmp == NULL)
+		return -1.f;
+	value = *tmp;
+	return value;
+}
+
 gboolean
 huey_device_read_register_byte (GUsbDevice *device,
 				guint8 addr,
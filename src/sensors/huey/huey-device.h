@@ -28,6 +28,8 @@
 
 G_BEGIN_DECLS
 
+#define HUEY_DEVICE_PACKET_SIZE		8
+
 gboolean	 huey_device_send_data		(GUsbDevice	*device,
 						 const guchar	*request,
 						 gsize		 request_len,
@@ -36,6 +38,15 @@ gboolean	 huey_device_send_data		(GUsbDevice	*device,
 						 gsize		*reply_read,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+void		 huey_device_send_data_async	(GUsbDevice	*device,
+						 const guint8	*request,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+GBytes		*huey_device_send_data_finish	(GUsbDevice	*device,
+						 GAsyncResult	*res,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 huey_device_set_leds		(GUsbDevice	*device,
 						 guint8		 value,
 						 GError		**error)
@@ -55,6 +66,14 @@ gboolean	 huey_device_unlock		(GUsbDevice	*device,
 gdouble		 huey_device_get_ambient	(GUsbDevice	*device,
 						 GError		**error)
 						 G_GNUC_WARN_UNUSED_RESULT;
+void		 huey_device_get_ambient_async	(GUsbDevice	*device,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+gdouble		 huey_device_get_ambient_finish	(GUsbDevice	*device,
+						 GAsyncResult	*res,
+						 GError		**error)
+						 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 huey_device_read_register_byte (GUsbDevice	*device,
 						 guint8		 addr,
 						 guint8		 *value,
@@ -414,6 +414,7 @@ cd_sensor_munki_lock_thread_cb (GSimpleAsyncResult *res,
 	g_autoptr(GError) error = NULL;
 	gint retval;
 	guint8 buffer[36];
+	guint32 params[6];
 	libusb_device_handle *handle;
 
 	/* try to find the USB device */
@@ -452,13 +453,12 @@ cd_sensor_munki_lock_thread_cb (GSimpleAsyncResult *res,
 						 libusb_strerror (retval));
 		goto out;
 	}
-	priv->firmware_revision = g_strdup_printf ("%i.%i",
-						   cd_buffer_read_uint32_le (buffer),
-						   cd_buffer_read_uint32_le (buffer+4));
-	priv->tick_duration = cd_buffer_read_uint32_le (buffer+8);
-	priv->min_int = cd_buffer_read_uint32_le (buffer+0x0c);
-	priv->eeprom_blocks = cd_buffer_read_uint32_le (buffer+0x10);
-	priv->eeprom_blocksize = cd_buffer_read_uint32_le (buffer+0x14);
+	cd_buffer_read_uint32_le_array (buffer, params, 6);
+	priv->firmware_revision = g_strdup_printf ("%i.%i", params[0], params[1]);
+	priv->tick_duration = params[2];
+	priv->min_int = params[3];
+	priv->eeprom_blocks = params[4];
+	priv->eeprom_blocksize = params[5];
 
 	/* get chip ID */
 	retval = libusb_control_transfer (handle,